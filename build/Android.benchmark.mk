@@ -0,0 +1,168 @@
+#
+# Copyright (C) 2013 The Android Open Source Project
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+# Micro-benchmarks of runtime hot paths, see test/Benchmarks/Benchmarks.java. They run on the
+# non-debug runtime, once with compiled code and once with the interpreter, and print a tab
+# separated table of results per configuration. The garbage collector and the compile throughput
+# of dex2oat have their own benchmarks below.
+
+LIBARTBENCHMARK_SRC_FILES := \
+	test/Benchmarks/benchmarks_jni.cc
+
+# The natives only go through JNI, so unlike libarttest they don't link against the runtime.
+# $(1): target or host
+define build-libartbenchmark
+  ifneq ($(1),target)
+    ifneq ($(1),host)
+      $$(error expected target or host for argument 1, received $(1))
+    endif
+  endif
+
+  art_target_or_host := $(1)
+
+  include $(CLEAR_VARS)
+  ifeq ($$(art_target_or_host),target)
+   include external/stlport/libstlport.mk
+  endif
+
+  LOCAL_CPP_EXTENSION := $(ART_CPP_EXTENSION)
+  LOCAL_MODULE := libartbenchmark
+  ifeq ($$(art_target_or_host),target)
+    LOCAL_MODULE_TAGS := tests
+  endif
+  LOCAL_SRC_FILES := $(LIBARTBENCHMARK_SRC_FILES)
+  LOCAL_C_INCLUDES += $(ART_C_INCLUDES)
+  LOCAL_ADDITIONAL_DEPENDENCIES := $(LOCAL_PATH)/build/Android.common.mk
+  LOCAL_ADDITIONAL_DEPENDENCIES += $(LOCAL_PATH)/build/Android.benchmark.mk
+  ifeq ($$(art_target_or_host),target)
+    LOCAL_CLANG := $(ART_TARGET_CLANG)
+    LOCAL_CFLAGS := $(ART_TARGET_CFLAGS) $(ART_TARGET_NON_DEBUG_CFLAGS)
+    LOCAL_MODULE_PATH := $(ART_TEST_OUT)
+    include $(BUILD_SHARED_LIBRARY)
+  else # host
+    LOCAL_CLANG := $(ART_HOST_CLANG)
+    LOCAL_CFLAGS := $(ART_HOST_CFLAGS) $(ART_HOST_NON_DEBUG_CFLAGS)
+    include $(BUILD_HOST_SHARED_LIBRARY)
+  endif
+endef
+
+ifeq ($(ART_BUILD_TARGET),true)
+  $(eval $(call build-libartbenchmark,target))
+endif
+ifeq ($(WITH_HOST_DALVIK),true)
+  ifeq ($(ART_BUILD_HOST),true)
+    $(eval $(call build-libartbenchmark,host))
+  endif
+endif
+
+# Pushed to the device with the rest of the test files.
+test-art-target-dependencies: $(ART_TEST_OUT)/libartbenchmark.so
+
+ART_BENCHMARK_DEX := art-benchmark-dex-Benchmarks
+ART_BENCHMARK_HOST_TARGETS :=
+ART_BENCHMARK_TARGET_TARGETS :=
+
+$(HOST_OUT_JAVA_LIBRARIES)/$(ART_BENCHMARK_DEX).odex: $(HOST_OUT_JAVA_LIBRARIES)/$(ART_BENCHMARK_DEX).jar $(HOST_CORE_IMG_OUT) | $(DEX2OAT)
+	$(DEX2OAT) --runtime-arg -Xms16m --runtime-arg -Xmx16m --boot-image=$(HOST_CORE_IMG_OUT) --dex-file=$(PWD)/$< --oat-file=$(PWD)/$@ --instruction-set=$(HOST_ARCH) --host --host-prefix="" --android-root=$(HOST_OUT)
+
+# $(1): configuration name
+# $(2): runtime arguments
+define declare-art-benchmark-targets
+.PHONY: art-benchmarks-target-$(1)
+art-benchmarks-target-$(1): test-art-target-sync
+	adb shell dalvikvm -XXlib:libart.so -Ximage:$(ART_TEST_DIR)/core.art $(2) -classpath $(ART_TEST_DIR)/$(ART_BENCHMARK_DEX).jar -Djava.library.path=$(ART_TEST_DIR) Benchmarks target-$(1)
+
+.PHONY: art-benchmarks-host-$(1)
+art-benchmarks-host-$(1): $(HOST_OUT_JAVA_LIBRARIES)/$(ART_BENCHMARK_DEX).odex $(HOST_OUT_SHARED_LIBRARIES)/libartbenchmark$(ART_HOST_SHLIB_EXTENSION) $(HOST_OUT_SHARED_LIBRARIES)/libart$(ART_HOST_SHLIB_EXTENSION) test-art-host-dependencies
+	mkdir -p /tmp/android-data/art-benchmarks-host-$(1)
+	ANDROID_DATA=/tmp/android-data/art-benchmarks-host-$(1) \
+	  ANDROID_ROOT=$(HOST_OUT) \
+	  LD_LIBRARY_PATH=$(HOST_OUT_SHARED_LIBRARIES) \
+	  dalvikvm -XXlib:libart$(ART_HOST_SHLIB_EXTENSION) -Ximage:$(shell pwd)/$(HOST_CORE_IMG_OUT) $(2) -classpath $(HOST_OUT_JAVA_LIBRARIES)/$(ART_BENCHMARK_DEX).jar -Djava.library.path=$(HOST_OUT_SHARED_LIBRARIES) Benchmarks host-$(1)
+	$(hide) rm -r /tmp/android-data/art-benchmarks-host-$(1)
+
+ART_BENCHMARK_TARGET_TARGETS += art-benchmarks-target-$(1)
+ART_BENCHMARK_HOST_TARGETS += art-benchmarks-host-$(1)
+endef
+$(eval $(call declare-art-benchmark-targets,default,))
+$(eval $(call declare-art-benchmark-targets,interpreter,-Xint))
+
+# "mm art-benchmarks" to build and run the benchmarks on host and device
+.PHONY: art-benchmarks
+art-benchmarks: art-benchmarks-host art-benchmarks-target
+
+.PHONY: art-benchmarks-host
+art-benchmarks-host: $(ART_BENCHMARK_HOST_TARGETS)
+
+.PHONY: art-benchmarks-target
+art-benchmarks-target: $(ART_BENCHMARK_TARGET_TARGETS)
+
+# "mm art-gc-benchmarks" runs test/GcBenchmark/GcBenchmark.java once per allocation profile, each
+# in a fresh runtime with a fixed heap size. Extra "<name>=<value>" profile overrides can be given
+# in ART_GC_BENCHMARK_ARGS. The runtime logs the collectors' pause percentiles when it shuts down:
+# to the console on the host, and to logcat on the device.
+ART_GC_BENCHMARK_DEX := art-benchmark-dex-GcBenchmark
+ART_GC_BENCHMARK_PROFILES := young mixed graph large throttled
+ART_GC_BENCHMARK_RUNTIME_ARGS := -Xms64m -Xmx64m -XX:DumpGCPerformanceOnShutdown
+ART_GC_BENCHMARK_ARGS ?=
+ART_GC_BENCHMARK_HOST_TARGETS :=
+ART_GC_BENCHMARK_TARGET_TARGETS :=
+
+$(HOST_OUT_JAVA_LIBRARIES)/$(ART_GC_BENCHMARK_DEX).odex: $(HOST_OUT_JAVA_LIBRARIES)/$(ART_GC_BENCHMARK_DEX).jar $(HOST_CORE_IMG_OUT) | $(DEX2OAT)
+	$(DEX2OAT) --runtime-arg -Xms16m --runtime-arg -Xmx16m --boot-image=$(HOST_CORE_IMG_OUT) --dex-file=$(PWD)/$< --oat-file=$(PWD)/$@ --instruction-set=$(HOST_ARCH) --host --host-prefix="" --android-root=$(HOST_OUT)
+
+# $(1): profile name
+define declare-art-gc-benchmark-targets
+.PHONY: art-gc-benchmarks-target-$(1)
+art-gc-benchmarks-target-$(1): test-art-target-sync
+	adb shell dalvikvm -XXlib:libart.so -Ximage:$(ART_TEST_DIR)/core.art $(ART_GC_BENCHMARK_RUNTIME_ARGS) -classpath $(ART_TEST_DIR)/$(ART_GC_BENCHMARK_DEX).jar GcBenchmark target $(1) $(ART_GC_BENCHMARK_ARGS)
+
+.PHONY: art-gc-benchmarks-host-$(1)
+art-gc-benchmarks-host-$(1): $(HOST_OUT_JAVA_LIBRARIES)/$(ART_GC_BENCHMARK_DEX).odex $(HOST_OUT_SHARED_LIBRARIES)/libart$(ART_HOST_SHLIB_EXTENSION) test-art-host-dependencies
+	mkdir -p /tmp/android-data/art-gc-benchmarks-host-$(1)
+	ANDROID_DATA=/tmp/android-data/art-gc-benchmarks-host-$(1) \
+	  ANDROID_ROOT=$(HOST_OUT) \
+	  LD_LIBRARY_PATH=$(HOST_OUT_SHARED_LIBRARIES) \
+	  dalvikvm -XXlib:libart$(ART_HOST_SHLIB_EXTENSION) -Ximage:$(shell pwd)/$(HOST_CORE_IMG_OUT) $(ART_GC_BENCHMARK_RUNTIME_ARGS) -classpath $(HOST_OUT_JAVA_LIBRARIES)/$(ART_GC_BENCHMARK_DEX).jar GcBenchmark host $(1) $(ART_GC_BENCHMARK_ARGS)
+	$(hide) rm -r /tmp/android-data/art-gc-benchmarks-host-$(1)
+
+ART_GC_BENCHMARK_TARGET_TARGETS += art-gc-benchmarks-target-$(1)
+ART_GC_BENCHMARK_HOST_TARGETS += art-gc-benchmarks-host-$(1)
+endef
+$(foreach profile,$(ART_GC_BENCHMARK_PROFILES),$(eval $(call declare-art-gc-benchmark-targets,$(profile))))
+
+.PHONY: art-gc-benchmarks
+art-gc-benchmarks: art-gc-benchmarks-host art-gc-benchmarks-target
+
+.PHONY: art-gc-benchmarks-host
+art-gc-benchmarks-host: $(ART_GC_BENCHMARK_HOST_TARGETS)
+
+.PHONY: art-gc-benchmarks-target
+art-gc-benchmarks-target: $(ART_GC_BENCHMARK_TARGET_TARGETS)
+
+# "mm art-dex2oat-benchmark" to time compiling the boot class path for the target with the
+# non-debug dex2oat, over ART_DEX2OAT_BENCHMARK_RUNS runs per thread count. The JSON report is
+# left in $(ART_DEX2OAT_BENCHMARK_OUT)/report.json, see tools/dex2oat-benchmark.py.
+ART_DEX2OAT_BENCHMARK_RUNS ?= 5
+ART_DEX2OAT_BENCHMARK_OUT := $(TARGET_OUT_INTERMEDIATES)/art-dex2oat-benchmark
+ART_DEX2OAT_BENCHMARK_DEX2OAT := $(HOST_OUT_EXECUTABLES)/dex2oat$(HOST_EXECUTABLE_SUFFIX)
+
+.PHONY: art-dex2oat-benchmark
+art-dex2oat-benchmark: $(TARGET_BOOT_DEX_FILES) $(ART_DEX2OAT_BENCHMARK_DEX2OAT) $(HOST_OUT_SHARED_LIBRARIES)/libart-compiler$(HOST_SHLIB_SUFFIX)
+	mkdir -p $(ART_DEX2OAT_BENCHMARK_OUT)
+	art/tools/dex2oat-benchmark.py --runs=$(ART_DEX2OAT_BENCHMARK_RUNS) --output=$(ART_DEX2OAT_BENCHMARK_OUT)/report.json -- \
+	  $(ART_DEX2OAT_BENCHMARK_DEX2OAT) --runtime-arg -Xms256m --runtime-arg -Xmx256m --image-classes=$(PRELOADED_CLASSES) $(addprefix --dex-file=,$(TARGET_BOOT_DEX_FILES)) $(addprefix --dex-location=,$(TARGET_BOOT_DEX_LOCATIONS)) --oat-file=$(ART_DEX2OAT_BENCHMARK_OUT)/boot.oat --oat-location=$(TARGET_BOOT_OAT) --image=$(ART_DEX2OAT_BENCHMARK_OUT)/boot.art --base=$(IMG_TARGET_BASE_ADDRESS) --instruction-set=$(TARGET_ARCH) --host-prefix=$(PRODUCT_OUT) --android-root=$(PRODUCT_OUT)/system
+	@echo art-dex2oat-benchmark report: $(ART_DEX2OAT_BENCHMARK_OUT)/report.json
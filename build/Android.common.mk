@@ -68,6 +68,18 @@ ifeq ($(WITH_ART_SEA_IR_MODE), true)
 ART_SEA_IR_MODE := true
 endif
 
+#
+# Used to enable per-lock contention logging, dumped on SIGQUIT
+#
+ART_LOCK_CONTENTION_LOGGING := false
+ifneq ($(wildcard art/LOCK_CONTENTION_LOGGING),)
+$(info Enabling ART_LOCK_CONTENTION_LOGGING because of existence of art/LOCK_CONTENTION_LOGGING)
+ART_LOCK_CONTENTION_LOGGING := true
+endif
+ifeq ($(WITH_ART_LOCK_CONTENTION_LOGGING),true)
+ART_LOCK_CONTENTION_LOGGING := true
+endif
+
 #
 # Used to enable portable mode
 #
@@ -125,6 +137,10 @@ ifeq ($(ART_SEA_IR_MODE),true)
   art_cflags += -DART_SEA_IR_MODE=1
 endif
 
+ifeq ($(ART_LOCK_CONTENTION_LOGGING),true)
+  art_cflags += -DART_LOCK_CONTENTION_LOGGING=1
+endif
+
 ifeq ($(HOST_OS),linux)
   art_non_debug_cflags := \
 	-Wframe-larger-than=1728
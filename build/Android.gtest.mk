@@ -17,6 +17,7 @@
 LOCAL_PATH := art
 
 TEST_COMMON_SRC_FILES := \
+	compiler/dex/arena_allocator_test.cc \
 	compiler/driver/compiler_driver_test.cc \
 	compiler/elf_writer_test.cc \
 	compiler/image_test.cc \
@@ -24,6 +25,8 @@ TEST_COMMON_SRC_FILES := \
 	compiler/oat_test.cc \
 	compiler/output_stream_test.cc \
 	compiler/utils/dedupe_set_test.cc \
+	compiler/utils/magic_divide_test.cc \
+	compiler/utils/spill_space_test.cc \
 	compiler/utils/arm/managed_register_arm_test.cc \
 	compiler/utils/x86/managed_register_x86_test.cc \
 	runtime/barrier_test.cc \
@@ -36,25 +39,37 @@ TEST_COMMON_SRC_FILES := \
 	runtime/base/unix_file/random_access_file_utils_test.cc \
 	runtime/base/unix_file/string_file_test.cc \
 	runtime/class_linker_test.cc \
+	runtime/cycle_clock_test.cc \
 	runtime/dex_file_test.cc \
 	runtime/dex_instruction_visitor_test.cc \
 	runtime/dex_method_iterator_test.cc \
 	runtime/entrypoints/math_entrypoints_test.cc \
 	runtime/exception_test.cc \
+	runtime/fault_handler_test.cc \
+	runtime/gc/accounting/card_table_test.cc \
 	runtime/gc/accounting/space_bitmap_test.cc \
+	runtime/gc/gc_event_log_test.cc \
 	runtime/gc/heap_test.cc \
 	runtime/gc/space/space_test.cc \
 	runtime/gtest_test.cc \
 	runtime/indenter_test.cc \
 	runtime/indirect_reference_table_test.cc \
 	runtime/intern_table_test.cc \
+	runtime/interpreter/decoded_code_test.cc \
 	runtime/jni_internal_test.cc \
 	runtime/mem_map_test.cc \
+	runtime/member_index_test.cc \
+	runtime/method_profile_test.cc \
 	runtime/mirror/dex_cache_test.cc \
 	runtime/mirror/object_test.cc \
+	runtime/numa_test.cc \
 	runtime/reference_table_test.cc \
 	runtime/runtime_test.cc \
+	runtime/startup_page_profile_test.cc \
+	runtime/startup_timeline_test.cc \
 	runtime/thread_pool_test.cc \
+	runtime/thread_stack_cache_test.cc \
+	runtime/utf_test.cc \
 	runtime/utils_test.cc \
 	runtime/verifier/method_verifier_test.cc \
 	runtime/verifier/reg_type_test.cc \
@@ -65,7 +80,8 @@ TEST_COMMON_SRC_FILES += \
 	compiler/utils/scoped_hashtable_test.cc \
 	compiler/sea_ir/types/type_data_test.cc \
 	compiler/sea_ir/types/type_inference_visitor_test.cc \
-	compiler/sea_ir/ir/regions_test.cc
+	compiler/sea_ir/ir/regions_test.cc \
+	compiler/sea_ir/opt/value_optimizer_test.cc
 endif
 
 TEST_TARGET_SRC_FILES := \
@@ -73,7 +89,8 @@ TEST_TARGET_SRC_FILES := \
 
 TEST_HOST_SRC_FILES := \
 	$(TEST_COMMON_SRC_FILES) \
-	compiler/utils/x86/assembler_x86_test.cc
+	compiler/utils/x86/assembler_x86_test.cc \
+	compiler/utils/x86_64/assembler_x86_64_test.cc
 
 ART_HOST_TEST_EXECUTABLES :=
 ART_TARGET_TEST_EXECUTABLES :=
@@ -59,12 +59,14 @@ LIBART_COMPILER_SRC_FILES := \
 	dex/ssa_transformation.cc \
 	driver/compiler_driver.cc \
 	driver/dex_compilation_unit.cc \
+	driver/incremental_compilation.cc \
 	jni/portable/jni_compiler.cc \
 	jni/quick/arm/calling_convention_arm.cc \
 	jni/quick/mips/calling_convention_mips.cc \
 	jni/quick/x86/calling_convention_x86.cc \
 	jni/quick/calling_convention.cc \
 	jni/quick/jni_compiler.cc \
+	llvm/compilation_cache.cc \
 	llvm/compiler_llvm.cc \
 	llvm/gbc_expander.cc \
 	llvm/generated/art_module.cc \
@@ -80,10 +82,13 @@ LIBART_COMPILER_SRC_FILES := \
 	utils/arm/assembler_arm.cc \
 	utils/arm/managed_register_arm.cc \
 	utils/assembler.cc \
+	utils/magic_divide.cc \
 	utils/mips/assembler_mips.cc \
 	utils/mips/managed_register_mips.cc \
+	utils/spill_space.cc \
 	utils/x86/assembler_x86.cc \
 	utils/x86/managed_register_x86.cc \
+	utils/x86_64/assembler_x86_64.cc \
 	buffered_output_stream.cc \
 	elf_fixup.cc \
 	elf_stripper.cc \
@@ -103,6 +108,7 @@ LIBART_COMPILER_SRC_FILES += \
 	sea_ir/code_gen/code_gen_data.cc \
 	sea_ir/types/type_inference.cc \
 	sea_ir/types/type_inference_visitor.cc \
+	sea_ir/opt/value_optimizer.cc \
 	sea_ir/debug/dot_gen.cc
 endif
 
@@ -203,11 +209,12 @@ $$(ENUM_OPERATOR_OUT_GEN): $$(GENERATED_SRC_DIR)/%_operator_out.cc : $(LOCAL_PAT
   LOCAL_ADDITIONAL_DEPENDENCIES += $(LOCAL_PATH)/Android.mk
   ifeq ($$(art_target_or_host),target)
     LOCAL_SHARED_LIBRARIES += libcutils
+    LOCAL_STATIC_LIBRARIES += libz
     include $(LLVM_GEN_INTRINSICS_MK)
     include $(LLVM_DEVICE_BUILD_MK)
     include $(BUILD_SHARED_LIBRARY)
   else # host
-    LOCAL_STATIC_LIBRARIES += libcutils
+    LOCAL_STATIC_LIBRARIES += libcutils libz
     include $(LLVM_GEN_INTRINSICS_MK)
     include $(LLVM_HOST_BUILD_MK)
     include $(BUILD_HOST_SHARED_LIBRARY)
@@ -21,21 +21,22 @@
 namespace art {
 
 BufferedOutputStream::BufferedOutputStream(OutputStream* out)
-    : OutputStream(out->GetLocation()), out_(out), used_(0) {}
+    : OutputStream(out->GetLocation()), out_(out), buffer_(kBufferSize), used_(0), position_(-1) {}
 
 bool BufferedOutputStream::WriteFully(const void* buffer, int64_t byte_count) {
-  if (byte_count > kBufferSize) {
-    Flush();
-    return out_->WriteFully(buffer, byte_count);
+  if (position_ != -1) {
+    position_ += byte_count;
   }
   if (used_ + byte_count > kBufferSize) {
-    bool success = Flush();
-    if (!success) {
-      return false;
-    }
+    struct iovec iov[2];
+    iov[0].iov_base = &buffer_[0];
+    iov[0].iov_len = used_;
+    iov[1].iov_base = const_cast<void*>(buffer);
+    iov[1].iov_len = byte_count;
+    used_ = 0;
+    return out_->WriteFullyGathered(iov, 2);
   }
-  const uint8_t* src = reinterpret_cast<const uint8_t*>(buffer);
-  memcpy(&buffer_[used_], src, byte_count);
+  memcpy(&buffer_[used_], buffer, byte_count);
   used_ += byte_count;
   return true;
 }
@@ -50,10 +51,27 @@ bool BufferedOutputStream::Flush() {
 }
 
 off_t BufferedOutputStream::Seek(off_t offset, Whence whence) {
+  if (whence == kSeekCurrent && offset > 0 && static_cast<size_t>(offset) < kMaxBufferedPadding) {
+    if (position_ == -1) {
+      off_t flushed_position = out_->Seek(0, kSeekCurrent);
+      if (flushed_position == -1) {
+        return -1;
+      }
+      position_ = flushed_position + used_;
+    }
+    if (used_ + offset > kBufferSize && !Flush()) {
+      return -1;
+    }
+    memset(&buffer_[used_], 0, offset);
+    used_ += offset;
+    position_ += offset;
+    return position_;
+  }
   if (!Flush()) {
     return -1;
   }
-  return out_->Seek(offset, whence);
+  position_ = out_->Seek(offset, whence);
+  return position_;
 }
 
 }  // namespace art
@@ -19,10 +19,15 @@
 
 #include "output_stream.h"
 
+#include <vector>
+
 #include "globals.h"
 
 namespace art {
 
+// Buffers small writes and padding to the stream it owns. Writes that don't fit in what is left
+// of the buffer are passed on gathered with what is buffered, without copying them. Seeking
+// anywhere but a short way forward writes out what is buffered first.
 class BufferedOutputStream : public OutputStream {
  public:
   explicit BufferedOutputStream(OutputStream* out);
@@ -36,16 +41,25 @@ class BufferedOutputStream : public OutputStream {
   virtual off_t Seek(off_t offset, Whence whence);
 
  private:
-  static const size_t kBufferSize = 8 * KB;
+  // Large enough that the oat writer's many small writes reach the file in a few hundred system
+  // calls for a boot oat file.
+  static const size_t kBufferSize = 1 * MB;
+
+  // Seeking forward less than this is padding, which is buffered as zeroes. Seeking further
+  // leaves a hole in the file.
+  static const size_t kMaxBufferedPadding = kPageSize;
 
   bool Flush();
 
   OutputStream* const out_;
 
-  uint8_t buffer_[kBufferSize];
+  std::vector<uint8_t> buffer_;
 
   size_t used_;
 
+  // The position of the end of what is buffered, or -1 until it is needed.
+  off_t position_;
+
   DISALLOW_COPY_AND_ASSIGN(BufferedOutputStream);
 };
 
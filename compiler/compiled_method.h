@@ -154,6 +154,27 @@ class CompiledMethod : public CompiledCode {
     return *gc_map_;
   }
 
+  // For quick code compiled with OSR entries, the dex PCs of the loop headers the code can be
+  // entered at from the interpreter.
+  const std::vector<uint32_t>& GetOsrDexPcs() const {
+    return osr_dex_pcs_;
+  }
+
+  void SetOsrDexPcs(const std::vector<uint32_t>& osr_dex_pcs) {
+    osr_dex_pcs_ = osr_dex_pcs;
+  }
+
+  // For quick code compiled for the hot method compiler, the literals holding the targets of
+  // static and direct calls: pairs of a literal's offset in the code and the target's dex method
+  // index.
+  const std::vector<uint32_t>& GetCallSites() const {
+    return call_sites_;
+  }
+
+  void SetCallSites(const std::vector<uint32_t>& call_sites) {
+    call_sites_ = call_sites;
+  }
+
  private:
   // For quick code, the size of the activation used by the code.
   const size_t frame_size_in_bytes_;
@@ -169,6 +190,10 @@ class CompiledMethod : public CompiledCode {
   // For quick code, a map keyed by native PC indices to bitmaps describing what dalvik registers
   // are live. For portable code, the key is a dalvik PC.
   std::vector<uint8_t>* gc_map_;
+  // For quick code, the loop header dex PCs with an OSR entry, sorted.
+  std::vector<uint32_t> osr_dex_pcs_;
+  // For quick code, the call site literals the runtime patches, see GetCallSites.
+  std::vector<uint32_t> call_sites_;
 };
 
 }  // namespace art
@@ -14,11 +14,14 @@
  * limitations under the License.
  */
 
+#include <sys/mman.h>
+
 #include "compiler_internals.h"
 #include "dex_file-inl.h"
 #include "arena_allocator.h"
 #include "base/logging.h"
 #include "base/mutex.h"
+#include "utils.h"
 
 namespace art {
 
@@ -75,45 +78,169 @@ void Arena::Reset() {
   }
 }
 
+void Arena::Release() {
+  if (bytes_allocated_) {
+    // Only whole pages can be given back, the partial pages at either end are zeroed by hand.
+    uint8_t* used_end = Begin() + bytes_allocated_;
+    uint8_t* page_begin = reinterpret_cast<uint8_t*>(RoundUp(reinterpret_cast<uintptr_t>(Begin()),
+                                                             kPageSize));
+    uint8_t* page_end = reinterpret_cast<uint8_t*>(RoundDown(reinterpret_cast<uintptr_t>(used_end),
+                                                             kPageSize));
+    if (page_begin < page_end) {
+      memset(Begin(), 0, page_begin - Begin());
+      if (madvise(page_begin, page_end - page_begin, MADV_DONTNEED) == -1) {
+        memset(page_begin, 0, page_end - page_begin);
+      }
+      memset(page_end, 0, used_end - page_end);
+    } else {
+      memset(Begin(), 0, bytes_allocated_);
+    }
+    bytes_allocated_ = 0;
+  }
+}
+
 ArenaPool::ArenaPool()
     : lock_("Arena pool lock"),
-      free_arenas_(nullptr) {
+      free_arenas_(nullptr),
+      thread_caches_(nullptr),
+      num_arenas_created_(0),
+      num_allocators_(0),
+      total_bytes_used_(0),
+      max_bytes_used_(0),
+      num_allocations_(0),
+      total_dex_code_units_(0) {
+  memset(&alloc_stats_[0], 0, sizeof(alloc_stats_));
+  CHECK_PTHREAD_CALL(pthread_key_create, (&thread_cache_key_, NULL), "arena pool thread cache key");
 }
 
-ArenaPool::~ArenaPool() {
-  while (free_arenas_ != nullptr) {
-    auto* arena = free_arenas_;
-    free_arenas_ = free_arenas_->next_;
+void ArenaPool::DeleteArenas(Arena* arenas) {
+  while (arenas != nullptr) {
+    Arena* arena = arenas;
+    arenas = arenas->next_;
     delete arena;
   }
 }
 
+ArenaPool::~ArenaPool() {
+  DeleteArenas(free_arenas_);
+  while (thread_caches_ != nullptr) {
+    ThreadCache* cache = thread_caches_;
+    thread_caches_ = cache->next;
+    DeleteArenas(cache->free_arenas);
+    delete cache;
+  }
+  CHECK_PTHREAD_CALL(pthread_key_delete, (thread_cache_key_), "delete arena pool thread cache key");
+}
+
+ArenaPool::ThreadCache* ArenaPool::GetThreadCache() {
+  ThreadCache* cache = static_cast<ThreadCache*>(pthread_getspecific(thread_cache_key_));
+  if (UNLIKELY(cache == nullptr)) {
+    cache = new ThreadCache;
+    cache->free_arenas = nullptr;
+    cache->num_free_arenas = 0;
+    {
+      MutexLock lock(Thread::Current(), lock_);
+      cache->next = thread_caches_;
+      thread_caches_ = cache;
+    }
+    CHECK_PTHREAD_CALL(pthread_setspecific, (thread_cache_key_, cache), "arena pool thread cache");
+  }
+  return cache;
+}
+
 Arena* ArenaPool::AllocArena(size_t size) {
-  Thread* self = Thread::Current();
   Arena* ret = nullptr;
-  {
-    MutexLock lock(self, lock_);
+  ThreadCache* cache = GetThreadCache();
+  if (cache->free_arenas != nullptr && LIKELY(cache->free_arenas->Size() >= size)) {
+    ret = cache->free_arenas;
+    cache->free_arenas = ret->next_;
+    --cache->num_free_arenas;
+  } else {
+    MutexLock lock(Thread::Current(), lock_);
     if (free_arenas_ != nullptr && LIKELY(free_arenas_->Size() >= size)) {
       ret = free_arenas_;
       free_arenas_ = free_arenas_->next_;
+    } else {
+      ++num_arenas_created_;
     }
   }
   if (ret == nullptr) {
     ret = new Arena(size);
   }
+  // Only the part handed out since the arena was last zeroed needs zeroing.
   ret->Reset();
   return ret;
 }
 
 void ArenaPool::FreeArena(Arena* arena) {
-  Thread* self = Thread::Current();
-  {
-    MutexLock lock(self, lock_);
-    arena->next_ = free_arenas_;
-    free_arenas_ = arena;
+  ThreadCache* cache = GetThreadCache();
+  if (cache->num_free_arenas < kMaxCachedArenasPerThread) {
+    arena->next_ = cache->free_arenas;
+    cache->free_arenas = arena;
+    ++cache->num_free_arenas;
+    return;
+  }
+  MutexLock lock(Thread::Current(), lock_);
+  arena->next_ = free_arenas_;
+  free_arenas_ = arena;
+}
+
+void ArenaPool::RecordAllocatorStats(const ArenaAllocator& allocator) {
+  size_t bytes_used = allocator.BytesUsed();
+  MutexLock lock(Thread::Current(), lock_);
+  ++num_allocators_;
+  total_bytes_used_ += bytes_used;
+  max_bytes_used_ = std::max(max_bytes_used_, bytes_used);
+  num_allocations_ += allocator.num_allocations_;
+  total_dex_code_units_ += allocator.dex_code_units_;
+  for (int i = 0; i < ArenaAllocator::kNumAllocKinds; i++) {
+    alloc_stats_[i] += allocator.alloc_stats_[i];
+  }
+}
+
+void ArenaPool::ReleaseIdleArenas() {
+  MutexLock lock(Thread::Current(), lock_);
+  for (Arena* arena = free_arenas_; arena != nullptr; arena = arena->next_) {
+    arena->Release();
+  }
+  for (ThreadCache* cache = thread_caches_; cache != nullptr; cache = cache->next) {
+    for (Arena* arena = cache->free_arenas; arena != nullptr; arena = arena->next_) {
+      arena->Release();
+    }
   }
 }
 
+void ArenaPool::Dump(std::ostream& os) const {
+  MutexLock lock(Thread::Current(), lock_);
+  os << "Arena pool: " << num_arenas_created_ << " arenas for " << num_allocators_
+     << " allocators, used: " << PrettySize(total_bytes_used_);
+  if (num_allocators_ != 0) {
+    os << ", avg: " << PrettySize(total_bytes_used_ / num_allocators_)
+       << ", max: " << PrettySize(max_bytes_used_);
+  }
+  if (total_dex_code_units_ != 0) {
+    os << ", per dex code unit: " << total_bytes_used_ / total_dex_code_units_ << " bytes";
+  }
+  os << "\n";
+  if (ArenaAllocator::kCountAllocations && num_allocations_ != 0) {
+    os << "Number of allocations: " << num_allocations_ << "\n";
+    os << "===== Allocation by kind\n";
+    for (int i = 0; i < ArenaAllocator::kNumAllocKinds; i++) {
+      os << alloc_names[i] << std::setw(10) << alloc_stats_[i] << "\n";
+    }
+  }
+}
+
+size_t ArenaAllocator::BytesUsed() const {
+  size_t total = ptr_ - begin_;
+  if (arena_head_ != nullptr) {
+    for (Arena* arena = arena_head_->next_; arena != nullptr; arena = arena->next_) {
+      total += arena->bytes_allocated_;
+    }
+  }
+  return total;
+}
+
 size_t ArenaAllocator::BytesAllocated() const {
   size_t total = 0;
   for (int i = 0; i < kNumAllocKinds; i++) {
@@ -128,7 +255,9 @@ ArenaAllocator::ArenaAllocator(ArenaPool* pool)
     end_(nullptr),
     ptr_(nullptr),
     arena_head_(nullptr),
-    num_allocations_(0) {
+    num_allocations_(0),
+    dex_code_units_(0) {
+  memset(&free_chunks_[0], 0, sizeof(free_chunks_));
   memset(&alloc_stats_[0], 0, sizeof(alloc_stats_));
 }
 
@@ -141,6 +270,7 @@ void ArenaAllocator::UpdateBytesAllocated() {
 }
 
 ArenaAllocator::~ArenaAllocator() {
+  pool_->RecordAllocatorStats(*this);
   // Reclaim all the arenas by giving them back to the thread pool.
   UpdateBytesAllocated();
   while (arena_head_ != nullptr) {
@@ -160,6 +290,69 @@ void ArenaAllocator::ObtainNewArenaForAllocation(size_t allocation_size) {
   end_ = new_arena->End();
 }
 
+void* ArenaAllocator::Realloc(void* ptr, size_t old_bytes, size_t new_bytes,
+                              ArenaAllocKind kind) {
+  old_bytes = (old_bytes + 3) & ~3;
+  new_bytes = (new_bytes + 3) & ~3;
+  DCHECK_GE(new_bytes, old_bytes);
+  uint8_t* old_ptr = static_cast<uint8_t*>(ptr);
+  if (old_ptr >= begin_ && old_ptr + old_bytes == ptr_ && old_ptr + new_bytes <= end_) {
+    // Past ptr_ the arena is still zeroed.
+    ptr_ = old_ptr + new_bytes;
+    if (kCountAllocations) {
+      alloc_stats_[kind] += new_bytes - old_bytes;
+    }
+    return ptr;
+  }
+  void* new_ptr = AllocFromFreeChunks(new_bytes);
+  if (new_ptr == nullptr) {
+    new_ptr = Alloc(new_bytes, kind);
+    if (UNLIKELY(new_ptr == nullptr)) {
+      return nullptr;
+    }
+  } else if (kCountAllocations) {
+    alloc_stats_[kind] += new_bytes;
+    ++num_allocations_;
+  }
+  memcpy(new_ptr, ptr, old_bytes);
+  Free(ptr, old_bytes);
+  return new_ptr;
+}
+
+void ArenaAllocator::Free(void* ptr, size_t bytes) {
+  if (bytes < sizeof(FreeChunk)) {
+    return;  // Too small to track.
+  }
+  DCHECK_ALIGNED(ptr, 4);
+  FreeChunk* chunk = static_cast<FreeChunk*>(ptr);
+  size_t bucket = 31 - CLZ(static_cast<uint32_t>(bytes));
+  chunk->next = free_chunks_[bucket];
+  chunk->size = bytes;
+  free_chunks_[bucket] = chunk;
+}
+
+void* ArenaAllocator::AllocFromFreeChunks(size_t bytes) {
+  if (bytes < sizeof(FreeChunk)) {
+    return nullptr;
+  }
+  size_t bucket = 32 - CLZ(static_cast<uint32_t>(bytes - 1));
+  while (bucket < kNumFreeChunkBuckets && free_chunks_[bucket] == nullptr) {
+    ++bucket;
+  }
+  if (bucket == kNumFreeChunkBuckets) {
+    return nullptr;
+  }
+  FreeChunk* chunk = free_chunks_[bucket];
+  free_chunks_[bucket] = chunk->next;
+  size_t chunk_size = chunk->size;
+  DCHECK_GE(chunk_size, bytes);
+  uint8_t* ret = reinterpret_cast<uint8_t*>(chunk);
+  memset(ret, 0, bytes);
+  // Keep the tail of a chunk much bigger than needed.
+  Free(ret + bytes, chunk_size - bytes);
+  return ret;
+}
+
 // Dump memory usage stats.
 void ArenaAllocator::DumpMemStats(std::ostream& os) const {
   size_t malloc_bytes = 0;
@@ -17,9 +17,12 @@
 #ifndef ART_COMPILER_DEX_ARENA_ALLOCATOR_H_
 #define ART_COMPILER_DEX_ARENA_ALLOCATOR_H_
 
+#include <pthread.h>
 #include <stdint.h>
 #include <stddef.h>
 
+#include <iosfwd>
+
 #include "base/mutex.h"
 #include "compiler_enums.h"
 #include "mem_map.h"
@@ -36,6 +39,8 @@ class Arena {
   explicit Arena(size_t size = kDefaultSize);
   ~Arena();
   void Reset();
+  // Gives the pages of the used part back to the kernel, leaving the arena zeroed.
+  void Release();
   uint8_t* Begin() {
     return memory_;
   }
@@ -63,19 +68,6 @@ class Arena {
   DISALLOW_COPY_AND_ASSIGN(Arena);
 };
 
-class ArenaPool {
- public:
-  ArenaPool();
-  ~ArenaPool();
-  Arena* AllocArena(size_t size);
-  void FreeArena(Arena* arena);
-
- private:
-  Mutex lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
-  Arena* free_arenas_ GUARDED_BY(lock_);
-  DISALLOW_COPY_AND_ASSIGN(ArenaPool);
-};
-
 class ArenaAllocator {
  public:
   // Type of allocation for memory tuning.
@@ -120,11 +112,38 @@ class ArenaAllocator {
     return ret;
   }
 
+  // Grows the allocation at ptr, which must have come from this allocator, from old_bytes to
+  // new_bytes, returning zeroed memory past old_bytes. The last allocation grows in place,
+  // otherwise a freed chunk is reused if one is big enough and ptr is freed in turn.
+  void* Realloc(void* ptr, size_t old_bytes, size_t new_bytes, ArenaAllocKind kind);
+
+  // Makes the allocation at ptr, which must have come from this allocator, available to later
+  // Reallocs. The arenas themselves are only reclaimed when the allocator goes away.
+  void Free(void* ptr, size_t bytes);
+
+  // Records the size of the code the allocations are for, see ArenaPool::Dump.
+  void AddDexCodeUnits(size_t code_units) {
+    dex_code_units_ += code_units;
+  }
+
   void ObtainNewArenaForAllocation(size_t allocation_size);
   size_t BytesAllocated() const;
+  // Bytes handed out from the arenas, whether or not allocations are counted.
+  size_t BytesUsed() const;
   void DumpMemStats(std::ostream& os) const;
 
  private:
+  // Header written over a freed allocation.
+  struct FreeChunk {
+    FreeChunk* next;
+    size_t size;
+  };
+  // Freed chunks are bucketed by the floor of their size's log2, so any chunk in the bucket of
+  // the ceiling of a request's log2, or a later one, is big enough for it.
+  static constexpr size_t kNumFreeChunkBuckets = 32;
+
+  // Returns a zeroed chunk of at least bytes from the free chunks, or null if there is none.
+  void* AllocFromFreeChunks(size_t bytes);
   void UpdateBytesAllocated();
 
   ArenaPool* pool_;
@@ -132,14 +151,66 @@ class ArenaAllocator {
   uint8_t* end_;
   uint8_t* ptr_;
   Arena* arena_head_;
+  FreeChunk* free_chunks_[kNumFreeChunkBuckets];
 
   // Statistics.
   size_t num_allocations_;
   size_t alloc_stats_[kNumAllocKinds];   // Bytes used by various allocation kinds.
+  size_t dex_code_units_;
 
+  friend class ArenaPool;
   DISALLOW_COPY_AND_ASSIGN(ArenaAllocator);
 };  // ArenaAllocator
 
+class ArenaPool {
+ public:
+  ArenaPool();
+  ~ArenaPool();
+  Arena* AllocArena(size_t size) LOCKS_EXCLUDED(lock_);
+  void FreeArena(Arena* arena) LOCKS_EXCLUDED(lock_);
+
+  // Adds the usage of an allocator that is going away to the pool's statistics.
+  void RecordAllocatorStats(const ArenaAllocator& allocator) LOCKS_EXCLUDED(lock_);
+
+  // Releases the memory of all free arenas, keeping the arenas for reuse. Must not be called
+  // while arenas are being allocated or freed, as the per-thread caches aren't locked.
+  void ReleaseIdleArenas() LOCKS_EXCLUDED(lock_);
+
+  // Dumps the memory used by all the allocators that used this pool.
+  void Dump(std::ostream& os) const LOCKS_EXCLUDED(lock_);
+
+ private:
+  // Free arenas kept by each thread, so that a thread compiling method after method can reuse
+  // its arenas without taking the lock.
+  struct ThreadCache {
+    Arena* free_arenas;
+    size_t num_free_arenas;
+    ThreadCache* next;
+  };
+  static constexpr size_t kMaxCachedArenasPerThread = 4;
+
+  ThreadCache* GetThreadCache() LOCKS_EXCLUDED(lock_);
+  static void DeleteArenas(Arena* arenas);
+
+  pthread_key_t thread_cache_key_;
+
+  mutable Mutex lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
+  Arena* free_arenas_ GUARDED_BY(lock_);
+  // All the thread caches, so that they can be released and deleted with the pool.
+  ThreadCache* thread_caches_ GUARDED_BY(lock_);
+
+  // Statistics.
+  size_t num_arenas_created_ GUARDED_BY(lock_);
+  size_t num_allocators_ GUARDED_BY(lock_);
+  size_t total_bytes_used_ GUARDED_BY(lock_);
+  size_t max_bytes_used_ GUARDED_BY(lock_);
+  size_t num_allocations_ GUARDED_BY(lock_);
+  size_t alloc_stats_[ArenaAllocator::kNumAllocKinds] GUARDED_BY(lock_);
+  size_t total_dex_code_units_ GUARDED_BY(lock_);
+
+  DISALLOW_COPY_AND_ASSIGN(ArenaPool);
+};
+
 struct MemStats {
    public:
      void Dump(std::ostream& os) const {
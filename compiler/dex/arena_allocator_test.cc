@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "common_test.h"
+#include "compiler_internals.h"
+
+namespace art {
+
+class ArenaAllocatorTest : public testing::Test {};
+
+TEST_F(ArenaAllocatorTest, ReallocLastAllocationInPlace) {
+  ArenaPool pool;
+  ArenaAllocator arena(&pool);
+  uint32_t* words = static_cast<uint32_t*>(arena.Alloc(4 * sizeof(uint32_t),
+                                                       ArenaAllocator::kAllocMisc));
+  for (size_t i = 0; i < 4; ++i) {
+    words[i] = i + 1;
+  }
+  uint32_t* grown = static_cast<uint32_t*>(arena.Realloc(words, 4 * sizeof(uint32_t),
+                                                         8 * sizeof(uint32_t),
+                                                         ArenaAllocator::kAllocMisc));
+  EXPECT_EQ(words, grown);
+  for (size_t i = 0; i < 4; ++i) {
+    EXPECT_EQ(i + 1, grown[i]);
+  }
+  for (size_t i = 4; i < 8; ++i) {
+    EXPECT_EQ(0U, grown[i]);
+  }
+}
+
+TEST_F(ArenaAllocatorTest, ReallocReusesFreedChunks) {
+  ArenaPool pool;
+  ArenaAllocator arena(&pool);
+  uint32_t* first = static_cast<uint32_t*>(arena.Alloc(16 * sizeof(uint32_t),
+                                                       ArenaAllocator::kAllocMisc));
+  first[15] = 42;
+  uint32_t* second = static_cast<uint32_t*>(arena.Alloc(4 * sizeof(uint32_t),
+                                                        ArenaAllocator::kAllocMisc));
+  // first is no longer the last allocation, so it moves and its storage is freed.
+  uint32_t* moved = static_cast<uint32_t*>(arena.Realloc(first, 16 * sizeof(uint32_t),
+                                                         32 * sizeof(uint32_t),
+                                                         ArenaAllocator::kAllocMisc));
+  EXPECT_NE(first, moved);
+  EXPECT_EQ(42U, moved[15]);
+  EXPECT_EQ(0U, moved[31]);
+  // Growing second past the allocation after it now fits in first's old storage.
+  second[0] = 7;
+  uint32_t* reused = static_cast<uint32_t*>(arena.Realloc(second, 4 * sizeof(uint32_t),
+                                                          8 * sizeof(uint32_t),
+                                                          ArenaAllocator::kAllocMisc));
+  EXPECT_EQ(first, reused);
+  EXPECT_EQ(7U, reused[0]);
+  for (size_t i = 1; i < 8; ++i) {
+    EXPECT_EQ(0U, reused[i]);
+  }
+}
+
+TEST_F(ArenaAllocatorTest, GrowableStorage) {
+  ArenaPool pool;
+  ArenaAllocator arena(&pool);
+  GrowableArray<size_t> list(&arena, 1);
+  ArenaBitVector* bits = new (&arena) ArenaBitVector(&arena, 32, true);
+  for (size_t i = 0; i < 1000; ++i) {
+    list.Insert(i);
+    if (i % 3 == 0) {
+      bits->SetBit(i);
+    }
+  }
+  ASSERT_EQ(1000U, list.Size());
+  for (size_t i = 0; i < 1000; ++i) {
+    EXPECT_EQ(i, list.Get(i));
+    EXPECT_EQ(i % 3 == 0, bits->IsBitSet(i));
+  }
+}
+
+}  // namespace art
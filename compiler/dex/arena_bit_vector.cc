@@ -67,14 +67,10 @@ void ArenaBitVector::SetBit(unsigned int num) {
     /* Round up to word boundaries for "num+1" bits */
     unsigned int new_size = (num + 1 + 31) >> 5;
     DCHECK_GT(new_size, storage_size_);
-    uint32_t *new_storage =
-        static_cast<uint32_t*>(arena_->Alloc(new_size * sizeof(uint32_t),
-                                             ArenaAllocator::kAllocGrowableBitMap));
-    memcpy(new_storage, storage_, storage_size_ * sizeof(uint32_t));
-    // Zero out the new storage words.
-    memset(&new_storage[storage_size_], 0, (new_size - storage_size_) * sizeof(uint32_t));
-    // TOTO: collect stats on space wasted because of resize.
-    storage_ = new_storage;
+    // The new storage words come back zeroed.
+    storage_ = static_cast<uint32_t*>(arena_->Realloc(storage_, storage_size_ * sizeof(uint32_t),
+                                                      new_size * sizeof(uint32_t),
+                                                      ArenaAllocator::kAllocGrowableBitMap));
     storage_size_ = new_size;
   }
 
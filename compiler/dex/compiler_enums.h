@@ -80,6 +80,7 @@ enum ResourceEncodingPos {
 
 // Shared pseudo opcodes - must be < 0.
 enum LIRPseudoOpcode {
+  kPseudoLoopHeadAlign = -17,
   kPseudoExportedPC = -16,
   kPseudoSafepointPC = -15,
   kPseudoIntrinsicRetry = -14,
@@ -114,6 +115,7 @@ enum ExtendedMIROpcode {
   kMirOpCheck,
   kMirOpCheckPart2,
   kMirOpSelect,
+  kMirOpVectorLoop,
   kMirOpLast,
 };
 
@@ -128,6 +130,7 @@ enum MIROptimizationFlagPositons {
   kMIRIgnoreSuspendCheck,
   kMIRDup,
   kMIRMark,                           // Temporary node mark.
+  kMIRIgnoreCheckCast,                // Check-cast is known to succeed.
 };
 
 // For successor_block_list.
@@ -318,15 +321,6 @@ enum SpecialCaseHandler {
   kIdentity,
 };
 
-enum DividePattern {
-  DivideNone,
-  Divide3,
-  Divide5,
-  Divide7,
-};
-
-std::ostream& operator<<(std::ostream& os, const DividePattern& pattern);
-
 // Memory barrier types (see "The JSR-133 Cookbook for Compiler Writers").
 enum MemBarrierKind {
   kLoadStore,
@@ -57,6 +57,7 @@ struct CompilationUnit {
       disable_opt(0),
       enable_debug(0),
       verbose(false),
+      linear_scan_promotion(false),
       compiler_backend(kNoBackend),
       instruction_set(kNone),
       num_dalvik_registers(0),
@@ -86,8 +87,10 @@ struct CompilationUnit {
   uint32_t disable_opt;                // opt_control_vector flags.
   uint32_t enable_debug;               // debugControlVector flags.
   bool verbose;
+  bool linear_scan_promotion;          // Promote by live interval rather than by use count.
   CompilerBackend compiler_backend;
   InstructionSet instruction_set;
+  InstructionSetFeatures instruction_set_features;
 
   // TODO: much of this info available elsewhere.  Go to the original source?
   int num_dalvik_registers;        // method->registers_size.
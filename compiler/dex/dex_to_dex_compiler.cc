@@ -16,6 +16,7 @@
 
 #include "base/logging.h"
 #include "base/mutex.h"
+#include "class_linker.h"
 #include "dex_file-inl.h"
 #include "dex_instruction-inl.h"
 #include "driver/compiler_driver.h"
@@ -24,6 +25,7 @@
 #include "mirror/art_method-inl.h"
 #include "mirror/class-inl.h"
 #include "mirror/dex_cache.h"
+#include "scoped_thread_state_change.h"
 
 namespace art {
 namespace optimizer {
@@ -88,6 +90,14 @@ class DexCompiler {
   void CompileInvokeVirtual(Instruction* inst, uint32_t dex_pc,
                             Instruction::Code new_opcode, bool is_range);
 
+  // Compiles a super method invocation into a quick super method invocation.
+  // The method index is replaced by the index of the method in the vtable of
+  // the super class of the compiled method's class, which is where invoke-super
+  // dispatches. Only done when the driver could sharpen the call, that is when
+  // that vtable entry is known to be the resolved method.
+  void CompileInvokeSuper(Instruction* inst, uint32_t dex_pc,
+                          Instruction::Code new_opcode, bool is_range);
+
   CompilerDriver& driver_;
   const DexCompilationUnit& unit_;
   const DexToDexCompilationLevel dex_to_dex_compilation_level_;
@@ -151,6 +161,14 @@ void DexCompiler::Compile() {
         CompileInvokeVirtual(inst, dex_pc, Instruction::INVOKE_VIRTUAL_RANGE_QUICK, true);
         break;
 
+      case Instruction::INVOKE_SUPER:
+        CompileInvokeSuper(inst, dex_pc, Instruction::INVOKE_SUPER_QUICK, false);
+        break;
+
+      case Instruction::INVOKE_SUPER_RANGE:
+        CompileInvokeSuper(inst, dex_pc, Instruction::INVOKE_SUPER_RANGE_QUICK, true);
+        break;
+
       default:
         // Nothing to do.
         break;
@@ -272,6 +290,54 @@ void DexCompiler::CompileInvokeVirtual(Instruction* inst,
   }
 }
 
+void DexCompiler::CompileInvokeSuper(Instruction* inst,
+                                     uint32_t dex_pc,
+                                     Instruction::Code new_opcode,
+                                     bool is_range) {
+  if (!kEnableQuickening || !PerformOptimizations()) {
+    return;
+  }
+  uint32_t method_idx = is_range ? inst->VRegB_3rc() : inst->VRegB_35c();
+  MethodReference target_method(&GetDexFile(), method_idx);
+  InvokeType invoke_type = kSuper;
+  int vtable_idx;
+  uintptr_t direct_code;
+  uintptr_t direct_method;
+  bool fast_path = driver_.ComputeInvokeInfo(&unit_, dex_pc, invoke_type,
+                                             target_method, vtable_idx,
+                                             direct_code, direct_method,
+                                             false);
+  // Super calls are only fast once sharpened to a direct call of the resolved method.
+  if (!fast_path || invoke_type != kDirect || target_method.dex_file != &GetDexFile() ||
+      target_method.dex_method_index != method_idx) {
+    return;
+  }
+  {
+    ScopedObjectAccess soa(Thread::Current());
+    mirror::ArtMethod* method =
+        unit_.GetClassLinker()->FindDexCache(GetDexFile())->GetResolvedMethod(method_idx);
+    DCHECK(method != NULL);
+    vtable_idx = method->GetMethodIndex();
+  }
+  if (vtable_idx >= 0 && IsUint(16, vtable_idx)) {
+    VLOG(compiler) << "Quickening " << Instruction::Name(inst->Opcode())
+                   << "(" << PrettyMethod(method_idx, GetDexFile(), true) << ")"
+                   << " to " << Instruction::Name(new_opcode)
+                   << " by replacing method index " << method_idx
+                   << " by vtable index " << vtable_idx
+                   << " at dex pc " << StringPrintf("0x%x", dex_pc) << " in method "
+                   << PrettyMethod(unit_.GetDexMethodIndex(), GetDexFile(), true);
+    // We are modifying 4 consecutive bytes.
+    inst->SetOpcode(new_opcode);
+    // Replace method index by vtable index.
+    if (is_range) {
+      inst->SetVRegB_3rc(static_cast<uint16_t>(vtable_idx));
+    } else {
+      inst->SetVRegB_35c(static_cast<uint16_t>(vtable_idx));
+    }
+  }
+}
+
 }  // namespace optimizer
 }  // namespace art
 
@@ -83,6 +83,13 @@ static uint32_t kCompilerOptimizerDisableFlags = 0 |  // Disable specific optimi
   // (1 << kBBOpt) |
   // (1 << kMatch) |
   // (1 << kPromoteCompilerTemps) |
+  // (1 << kBarrierElimination) |
+  // (1 << kTypeCheckElimination) |
+  // (1 << kScalarReplacement) |
+  // (1 << kImplicitNullChecks) |
+  // (1 << kImplicitStackOverflowChecks) |
+  // (1 << kImplicitSuspendChecks) |
+  // (1 << kFramelessLeafMethods) |
   0;
 
 static uint32_t kCompilerDebugFlags = 0 |     // Enable debug/testing modes
@@ -124,6 +131,7 @@ static CompiledMethod* CompileMethod(CompilerDriver& compiler,
   cu.compiler_driver = &compiler;
   cu.class_linker = class_linker;
   cu.instruction_set = compiler.GetInstructionSet();
+  cu.instruction_set_features = compiler.GetInstructionSetFeatures();
   cu.compiler_backend = compiler_backend;
   DCHECK((cu.instruction_set == kThumb2) ||
          (cu.instruction_set == kX86) ||
@@ -132,6 +140,7 @@ static CompiledMethod* CompileMethod(CompilerDriver& compiler,
 
   /* Adjust this value accordingly once inlining is performed */
   cu.num_dalvik_registers = code_item->registers_size_;
+  cu.arena.AddDexCodeUnits(code_item->insns_size_in_code_units_);
   // TODO: set this from command line
   cu.compiler_flip_match = false;
   bool use_match = !cu.compiler_method_match.empty();
@@ -150,6 +159,8 @@ static CompiledMethod* CompileMethod(CompilerDriver& compiler,
    * MIR and backend flags?  Need command-line setting as well.
    */
 
+  cu.linear_scan_promotion = compiler.UseLinearScanPromotion(dex_file, method_idx);
+
   if (compiler_backend == kPortable) {
     // Fused long branches not currently usseful in bitcode.
     cu.disable_opt |= (1 << kBranchFusing);
@@ -170,6 +181,13 @@ static CompiledMethod* CompileMethod(CompilerDriver& compiler,
         (1 << kPromoteCompilerTemps));
   }
 
+  if (cu.instruction_set != kThumb2 ||
+      Runtime::Current()->GetCompilerFilter() < Runtime::kBalanced) {
+    // Latencies are only modeled for the in-order ARM cores, and scheduling isn't worth the
+    // compile time when optimizing for space.
+    cu.disable_opt |= (1 << kInstructionScheduling);
+  }
+
   cu.mir_graph.reset(new MIRGraph(&cu, &cu.arena));
 
   /* Gathering opcode stats? */
@@ -182,17 +200,27 @@ static CompiledMethod* CompileMethod(CompilerDriver& compiler,
                               class_loader, dex_file);
 
 #if !defined(ART_USE_PORTABLE_COMPILER)
-  if (cu.mir_graph->SkipCompilation(Runtime::Current()->GetCompilerFilter())) {
+  if (!compiler.IsProfiledHot(dex_file, method_idx) &&
+      cu.mir_graph->SkipCompilation(Runtime::Current()->GetCompilerFilter())) {
     return NULL;
   }
 #endif
 
+  /* Inline calls to trivial accessors */
+  cu.mir_graph->InlineCalls();
+
   /* Do a code layout pass */
   cu.mir_graph->CodeLayout();
 
   /* Perform SSA transformation for the whole method */
   cu.mir_graph->SSATransformation();
 
+  /* Run simple array loops four elements at a time */
+  cu.mir_graph->VectorizeLoops();
+
+  /* Replace allocations that don't escape their block by their fields */
+  cu.mir_graph->ScalarReplacement();
+
   /* Do constant propagation */
   cu.mir_graph->PropagateConstants();
 
@@ -202,6 +230,15 @@ static CompiledMethod* CompileMethod(CompilerDriver& compiler,
   /* Perform null check elimination */
   cu.mir_graph->NullCheckElimination();
 
+  /* Perform range check elimination in loops */
+  cu.mir_graph->BoundsCheckElimination();
+
+  /* Remove checks made redundant by dominating ones */
+  cu.mir_graph->GlobalValueNumbering();
+
+  /* Remove type checks made redundant by dominating ones */
+  cu.mir_graph->TypeCheckElimination();
+
   /* Combine basic blocks where possible */
   cu.mir_graph->BasicBlockCombine();
 
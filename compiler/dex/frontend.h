@@ -56,6 +56,18 @@ enum opt_control_vector {
   kMatch,
   kPromoteCompilerTemps,
   kBranchFusing,
+  kMethodInlining,
+  kBoundsCheckElimination,
+  kGlobalValueNumbering,
+  kVectorization,
+  kInstructionScheduling,
+  kBarrierElimination,
+  kTypeCheckElimination,
+  kScalarReplacement,
+  kImplicitNullChecks,
+  kImplicitStackOverflowChecks,
+  kImplicitSuspendChecks,
+  kFramelessLeafMethods,
 };
 
 // Force code generation paths for testing.
@@ -95,11 +95,11 @@ class GrowableArray {
       if (new_length > target_length) {
          target_length = new_length;
       }
-      T* new_array = static_cast<T*>(arena_->Alloc(sizeof(T) * target_length,
+      // The old storage is handed back to the arena for other lists to grow into.
+      elem_list_ = static_cast<T*>(arena_->Realloc(elem_list_, sizeof(T) * num_allocated_,
+                                                   sizeof(T) * target_length,
                                                    ArenaAllocator::kAllocGrowableArray));
-      memcpy(new_array, elem_list_, sizeof(T) * num_allocated_);
       num_allocated_ = target_length;
-      elem_list_ = new_array;
     };
 
     // NOTE: does not return storage, just resets use count.
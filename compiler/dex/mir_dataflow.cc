@@ -840,6 +840,9 @@ const int MIRGraph::oat_data_flow_attributes_[kMirOpLast] = {
 
   // 113 MIR_SELECT
   DF_DA | DF_UB,
+
+  // 114 MIR_VECTOR_LOOP
+  DF_DA | DF_UB | DF_CORE_A | DF_CORE_B,
 };
 
 /* Return the base virtual register for a SSA name */
@@ -69,6 +69,7 @@ const char* MIRGraph::extended_mir_op_names_[kMirOpLast - kMirOpFirst] = {
   "Check1",
   "Check2",
   "Select",
+  "VectorLoop",
 };
 
 MIRGraph::MIRGraph(CompilationUnit* cu, ArenaAllocator* arena)
@@ -90,7 +91,6 @@ MIRGraph::MIRGraph(CompilationUnit* cu, ArenaAllocator* arena)
       i_dom_list_(NULL),
       def_block_matrix_(NULL),
       temp_block_v_(NULL),
-      temp_dalvik_register_v_(NULL),
       temp_ssa_register_v_(NULL),
       block_list_(arena, 100, kGrowableArrayBlockList),
       try_block_addr_(NULL),
@@ -107,6 +107,10 @@ MIRGraph::MIRGraph(CompilationUnit* cu, ArenaAllocator* arena)
       method_sreg_(0),
       attributes_(METHOD_IS_LEAF),  // Start with leaf assumption, change on encountering invoke.
       checkstats_(NULL),
+      gvn_null_checks_eliminated_(0),
+      gvn_range_checks_eliminated_(0),
+      type_checks_eliminated_(0),
+      allocations_replaced_(0),
       special_case_(kNoHandler),
       arena_(arena) {
   try_block_addr_ = new (arena_) ArenaBitVector(arena_, 0, true /* expandable */);
@@ -612,6 +616,12 @@ void MIRGraph::InlineMethod(const DexFile::CodeItem* code_item, uint32_t access_
       def_count_ += (df_flags & DF_A_WIDE) ? 2 : 1;
     }
 
+    if ((opcode >= Instruction::IPUT && opcode <= Instruction::IPUT_SHORT) ||
+        opcode == Instruction::IPUT_QUICK || opcode == Instruction::IPUT_WIDE_QUICK ||
+        opcode == Instruction::IPUT_OBJECT_QUICK) {
+      attributes_ |= METHOD_STORES_FIELDS;
+    }
+
     // Check for inline data block signatures
     if (opcode == Instruction::NOP) {
       // A simple NOP will have a width of 1 at this point, embedded data NOP > 1.
@@ -153,10 +153,12 @@ enum DataFlowAttributePos {
 enum OatMethodAttributes {
   kIsLeaf,            // Method is leaf.
   kHasLoop,           // Method contains simple loop.
+  kStoresFields,      // Method stores to instance fields.
 };
 
 #define METHOD_IS_LEAF          (1 << kIsLeaf)
 #define METHOD_HAS_LOOP         (1 << kHasLoop)
+#define METHOD_STORES_FIELDS    (1 << kStoresFields)
 
 // Minimum field size to contain Dalvik v_reg number.
 #define VREG_NUM_WIDTH 16
@@ -180,6 +182,7 @@ enum OatMethodAttributes {
 #define MIR_CALLEE                      (1 << kMIRCallee)
 #define MIR_IGNORE_SUSPEND_CHECK        (1 << kMIRIgnoreSuspendCheck)
 #define MIR_DUP                         (1 << kMIRDup)
+#define MIR_IGNORE_CHECK_CAST           (1 << kMIRIgnoreCheckCast)
 
 #define BLOCK_NAME_LEN 80
 
@@ -228,6 +231,28 @@ struct SSARepresentation {
   bool* fp_def;
 };
 
+// Element-wise operation of a vectorized loop, on vector registers numbered from 0.
+struct VectorLoopOp {
+  Instruction::Code opcode;  // AGET, APUT or the three address form of the arithmetic.
+  int dest;                  // Vector register written, unused by APUT.
+  int src1;                  // Vector register read, the array number for AGET.
+  int src2;                  // Vector register read, the array number for APUT.
+};
+
+/*
+ * An iteration of a loop matched by MIRGraph::VectorizeLoops, run on four 32-bit elements at
+ * once.  The kMirOpVectorLoop using it has the index, the arrays and the bound as uses.
+ */
+struct VectorLoopInfo {
+  static constexpr int kMaxOps = 16;
+  static constexpr int kMaxArrays = 3;
+  static constexpr int kMaxRegs = 4;
+  int num_ops;
+  int num_arrays;
+  bool bound_is_length;      // The bound is an array whose length the loop runs to.
+  VectorLoopOp ops[kMaxOps];
+};
+
 /*
  * The Midlevel Intermediate Representation node, which may be largely considered a
  * wrapper around a Dalvik byte code.
@@ -246,6 +271,8 @@ struct MIR {
     MIR* throw_insn;
     // Saved opcode for NOP'd MIRs
     Instruction::Code original_opcode;
+    // The loop a kMirOpVectorLoop runs.
+    VectorLoopInfo* vector_loop;
   } meta;
 };
 
@@ -544,6 +571,10 @@ class MIRGraph {
     return attributes_ & METHOD_IS_LEAF;
   }
 
+  bool MethodStoresFields() {
+    return attributes_ & METHOD_STORES_FIELDS;
+  }
+
   RegLocation GetRegLocation(int index) {
     DCHECK((index >= 0) && (index > num_ssa_regs_));
     return reg_location_[index];
@@ -570,6 +601,7 @@ class MIRGraph {
   }
 
   void BasicBlockCombine();
+  void InlineCalls();
   void CodeLayout();
   void DumpCheckStats();
   void PropagateConstants();
@@ -580,6 +612,11 @@ class MIRGraph {
   void SSATransformation();
   void CheckForDominanceFrontier(BasicBlock* dom_bb, const BasicBlock* succ_bb);
   void NullCheckElimination();
+  void BoundsCheckElimination();
+  void GlobalValueNumbering();
+  void TypeCheckElimination();
+  void ScalarReplacement();
+  void VectorizeLoops();
   bool SetFp(int index, bool is_fp);
   bool SetCore(int index, bool is_core);
   bool SetRef(int index, bool is_ref);
@@ -615,7 +652,7 @@ class MIRGraph {
 
  private:
   int FindCommonParent(int block1, int block2);
-  void ComputeSuccLineIn(ArenaBitVector* dest, const ArenaBitVector* src1,
+  bool ComputeSuccLineIn(ArenaBitVector* dest, const ArenaBitVector* src1,
                          const ArenaBitVector* src2);
   void HandleLiveInUse(ArenaBitVector* use_v, ArenaBitVector* def_v,
                        ArenaBitVector* live_in_v, int dalvik_reg_id);
@@ -660,6 +697,14 @@ class MIRGraph {
   void SetConstantWide(int ssa_reg, int64_t value);
   int GetSSAUseCount(int s_reg);
   bool BasicBlockOpt(BasicBlock* bb);
+  bool InlineFieldAccessor(MIR* mir);
+  bool ScalarReplaceAllocation(MIR* new_instance);
+  void AddNaturalLoop(BasicBlock* header, BasicBlock* back_edge_source, ArenaBitVector* body);
+  bool IsNonNegativeInductionVariable(int s_reg, BasicBlock* in_range_bb, MIR** ssa_defs,
+                                      BasicBlock** ssa_def_blocks);
+  void EliminateLoopRangeChecks(BasicBlock* header, ArenaBitVector* body, MIR** ssa_defs,
+                                BasicBlock** ssa_def_blocks);
+  bool VectorizeLoop(BasicBlock* header, BasicBlock** ssa_def_blocks);
   bool EliminateNullChecks(BasicBlock* bb);
   void NullCheckEliminationInit(BasicBlock* bb);
   bool BuildExtendedBBList(struct BasicBlock* bb);
@@ -695,7 +740,6 @@ class MIRGraph {
   int* i_dom_list_;
   ArenaBitVector** def_block_matrix_;    // num_dalvik_register x num_blocks.
   ArenaBitVector* temp_block_v_;
-  ArenaBitVector* temp_dalvik_register_v_;
   ArenaBitVector* temp_ssa_register_v_;  // num_ssa_regs.
   static const int kInvalidEntry = -1;
   GrowableArray<BasicBlock*> block_list_;
@@ -718,6 +762,10 @@ class MIRGraph {
   int method_sreg_;
   unsigned int attributes_;
   Checkstats* checkstats_;
+  int gvn_null_checks_eliminated_;                // Checks removed by GlobalValueNumbering.
+  int gvn_range_checks_eliminated_;
+  int type_checks_eliminated_;                    // Removed by TypeCheckElimination.
+  int allocations_replaced_;                      // Removed by ScalarReplacement.
   SpecialCaseHandler special_case_;
   ArenaAllocator* arena_;
 };
@@ -14,6 +14,9 @@
  * limitations under the License.
  */
 
+#include <map>
+#include <set>
+
 #include "compiler_internals.h"
 #include "local_value_numbering.h"
 #include "dataflow_iterator-inl.h"
@@ -214,11 +217,15 @@ bool MIRGraph::BasicBlockOpt(BasicBlock* bb) {
     return true;
   }
   int num_temps = 0;
+  // GlobalValueNumbering already covered the extended basic block unless it was disabled.
+  const bool use_lvn = (cu_->disable_opt & (1 << kGlobalValueNumbering)) != 0;
   LocalValueNumbering local_valnum(cu_);
   while (bb != NULL) {
     for (MIR* mir = bb->first_mir_insn; mir != NULL; mir = mir->next) {
       // TUNING: use the returned value number for CSE.
-      local_valnum.GetValueNumber(mir);
+      if (use_lvn) {
+        local_valnum.GetValueNumber(mir);
+      }
       // Look for interesting opcodes, skip otherwise
       Instruction::Code opcode = mir->dalvikInsn.opcode;
       switch (opcode) {
@@ -822,6 +829,19 @@ void MIRGraph::DumpCheckStats() {
               << stats->range_checks_eliminated << " of " << stats->range_checks << " -> "
               << (eliminated/checks) * 100.0 << "%";
   }
+  if (gvn_null_checks_eliminated_ > 0 || gvn_range_checks_eliminated_ > 0) {
+    LOG(INFO) << "GVN Checks: " << PrettyMethod(cu_->method_idx, *cu_->dex_file) << " "
+              << gvn_null_checks_eliminated_ << " null, " << gvn_range_checks_eliminated_
+              << " range";
+  }
+  if (type_checks_eliminated_ > 0) {
+    LOG(INFO) << "Type Checks: " << PrettyMethod(cu_->method_idx, *cu_->dex_file) << " "
+              << type_checks_eliminated_ << " check-cast or instance-of";
+  }
+  if (allocations_replaced_ > 0) {
+    LOG(INFO) << "Scalar Replacement: " << PrettyMethod(cu_->method_idx, *cu_->dex_file) << " "
+              << allocations_replaced_ << " allocations";
+  }
 }
 
 bool MIRGraph::BuildExtendedBBList(struct BasicBlock* bb) {
@@ -854,6 +874,1265 @@ bool MIRGraph::BuildExtendedBBList(struct BasicBlock* bb) {
 }
 
 
+/* Collect the blocks of the natural loop of header into body, given the source of a back edge */
+void MIRGraph::AddNaturalLoop(BasicBlock* header, BasicBlock* back_edge_source,
+                              ArenaBitVector* body) {
+  body->SetBit(header->id);
+  if (body->IsBitSet(back_edge_source->id)) {
+    return;
+  }
+  GrowableArray<BasicBlock*> work_list(arena_, 8, kGrowableArrayMisc);
+  body->SetBit(back_edge_source->id);
+  work_list.Insert(back_edge_source);
+  for (size_t i = 0; i < work_list.Size(); i++) {
+    GrowableArray<BasicBlock*>::Iterator iter(work_list.Get(i)->predecessors);
+    for (BasicBlock* pred_bb = iter.Next(); pred_bb != NULL; pred_bb = iter.Next()) {
+      if (!body->IsBitSet(pred_bb->id)) {
+        body->SetBit(pred_bb->id);
+        work_list.Insert(pred_bb);
+      }
+    }
+  }
+}
+
+/*
+ * An SSA name defined by a Phi of the loop header is a non-negative induction variable if every
+ * operand is a non-negative constant, the Phi itself, or the Phi plus one computed where the Phi
+ * is known to be below an array length (and so can't overflow).
+ */
+bool MIRGraph::IsNonNegativeInductionVariable(int s_reg, BasicBlock* in_range_bb,
+                                              MIR** ssa_defs, BasicBlock** ssa_def_blocks) {
+  MIR* phi = ssa_defs[s_reg];
+  for (int i = 0; i < phi->ssa_rep->num_uses; i++) {
+    int use = phi->ssa_rep->uses[i];
+    if (use == s_reg) {
+      continue;
+    }
+    if (is_constant_v_->IsBitSet(use)) {
+      if (ConstantValue(use) < 0) {
+        return false;
+      }
+      continue;
+    }
+    MIR* def = ssa_defs[use];
+    if (def == NULL) {
+      return false;
+    }
+    // A vector loop only moves a non-negative start index up to an array length.
+    if ((static_cast<int>(def->dalvikInsn.opcode) == kMirOpVectorLoop) &&
+        is_constant_v_->IsBitSet(def->ssa_rep->uses[0]) &&
+        (ConstantValue(def->ssa_rep->uses[0]) >= 0)) {
+      continue;
+    }
+    Instruction::Code opcode = def->dalvikInsn.opcode;
+    if (((opcode != Instruction::ADD_INT_LIT8) && (opcode != Instruction::ADD_INT_LIT16)) ||
+        (def->ssa_rep->uses[0] != s_reg) || (static_cast<int32_t>(def->dalvikInsn.vC) != 1) ||
+        !ssa_def_blocks[use]->dominators->IsBitSet(in_range_bb->id)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/*
+ * Remove range checks of array accesses in a loop body indexed by a non-negative induction
+ * variable that a dominating test of the loop keeps below the array's length.  The array must
+ * be defined outside the loop, so the array whose length was tested is the one accessed.
+ */
+void MIRGraph::EliminateLoopRangeChecks(BasicBlock* header, ArenaBitVector* body,
+                                        MIR** ssa_defs, BasicBlock** ssa_def_blocks) {
+  ArenaBitVector::Iterator test_iter(body);
+  for (int test_id = test_iter.Next(); test_id != -1; test_id = test_iter.Next()) {
+    BasicBlock* test_bb = GetBasicBlock(test_id);
+    MIR* test = test_bb->last_mir_insn;
+    if ((test == NULL) || (test->ssa_rep == NULL) || (test->ssa_rep->num_uses != 2)) {
+      continue;
+    }
+    // Find the successor in which index < length holds.
+    int index_use;
+    BasicBlock* in_range_bb;
+    switch (test->dalvikInsn.opcode) {
+      case Instruction::IF_GE:
+        index_use = 0;
+        in_range_bb = test_bb->fall_through;
+        break;
+      case Instruction::IF_LT:
+        index_use = 0;
+        in_range_bb = test_bb->taken;
+        break;
+      case Instruction::IF_LE:
+        index_use = 1;
+        in_range_bb = test_bb->fall_through;
+        break;
+      case Instruction::IF_GT:
+        index_use = 1;
+        in_range_bb = test_bb->taken;
+        break;
+      default:
+        continue;
+    }
+    if ((in_range_bb == NULL) || (test_bb->taken == test_bb->fall_through) ||
+        (Predecessors(in_range_bb) != 1) || !body->IsBitSet(in_range_bb->id)) {
+      continue;
+    }
+    int index_sreg = test->ssa_rep->uses[index_use];
+    int length_sreg = test->ssa_rep->uses[1 - index_use];
+    MIR* index_def = ssa_defs[index_sreg];
+    MIR* length_def = ssa_defs[length_sreg];
+    if ((index_def == NULL) || (ssa_def_blocks[index_sreg] != header) ||
+        (static_cast<int>(index_def->dalvikInsn.opcode) != kMirOpPhi) ||
+        (length_def == NULL) || (length_def->dalvikInsn.opcode != Instruction::ARRAY_LENGTH)) {
+      continue;
+    }
+    int array_sreg = length_def->ssa_rep->uses[0];
+    if ((ssa_def_blocks[array_sreg] != NULL) && body->IsBitSet(ssa_def_blocks[array_sreg]->id)) {
+      continue;
+    }
+    if (!IsNonNegativeInductionVariable(index_sreg, in_range_bb, ssa_defs, ssa_def_blocks)) {
+      continue;
+    }
+    ArenaBitVector::Iterator access_iter(body);
+    for (int bb_id = access_iter.Next(); bb_id != -1; bb_id = access_iter.Next()) {
+      BasicBlock* bb = GetBasicBlock(bb_id);
+      if ((bb->dominators == NULL) || !bb->dominators->IsBitSet(in_range_bb->id)) {
+        continue;
+      }
+      for (MIR* mir = bb->first_mir_insn; mir != NULL; mir = mir->next) {
+        int df_attributes = oat_data_flow_attributes_[mir->dalvikInsn.opcode];
+        if (((df_attributes & DF_HAS_RANGE_CHKS) == 0) || (mir->ssa_rep == NULL)) {
+          continue;
+        }
+        // The array is the null checked use, the index the use after it.
+        int array_use = (df_attributes & DF_NULL_CHK_0) ? 0 :
+            ((df_attributes & DF_NULL_CHK_1) ? 1 : 2);
+        if ((mir->ssa_rep->uses[array_use] != array_sreg) ||
+            (mir->ssa_rep->uses[array_use + 1] != index_sreg)) {
+          continue;
+        }
+        mir->optimization_flags |= MIR_IGNORE_RANGE_CHECK;
+        // The check half of a split access is compiled with its own flags.
+        MIR* check_half = mir->meta.throw_insn;
+        if ((check_half != NULL) &&
+            (static_cast<int>(check_half->dalvikInsn.opcode) == kMirOpCheck)) {
+          check_half->optimization_flags |= MIR_IGNORE_RANGE_CHECK;
+        }
+      }
+    }
+  }
+}
+
+void MIRGraph::BoundsCheckElimination() {
+  if (cu_->disable_opt & (1 << kBoundsCheckElimination)) {
+    return;
+  }
+  // Map SSA names to their definitions, names without one are the method's incoming values.
+  MIR** ssa_defs = static_cast<MIR**>(arena_->Alloc(sizeof(MIR*) * GetNumSSARegs(),
+                                                    ArenaAllocator::kAllocDFInfo));
+  BasicBlock** ssa_def_blocks =
+      static_cast<BasicBlock**>(arena_->Alloc(sizeof(BasicBlock*) * GetNumSSARegs(),
+                                              ArenaAllocator::kAllocDFInfo));
+  AllNodesIterator def_iter(this, false /* not iterative */);
+  for (BasicBlock* bb = def_iter.Next(); bb != NULL; bb = def_iter.Next()) {
+    for (MIR* mir = bb->first_mir_insn; mir != NULL; mir = mir->next) {
+      if (mir->ssa_rep == NULL) {
+        continue;
+      }
+      for (int i = 0; i < mir->ssa_rep->num_defs; i++) {
+        ssa_defs[mir->ssa_rep->defs[i]] = mir;
+        ssa_def_blocks[mir->ssa_rep->defs[i]] = bb;
+      }
+    }
+  }
+  // Find the natural loops, a back edge is one whose target dominates its source.
+  ArenaBitVector** loop_bodies = static_cast<ArenaBitVector**>(
+      arena_->Alloc(sizeof(ArenaBitVector*) * GetNumBlocks(), ArenaAllocator::kAllocDFInfo));
+  AllNodesIterator iter(this, false /* not iterative */);
+  for (BasicBlock* bb = iter.Next(); bb != NULL; bb = iter.Next()) {
+    if ((bb->block_type == kDead) || (bb->dominators == NULL)) {
+      continue;
+    }
+    GrowableArray<BasicBlock*> successors(arena_, 2, kGrowableArrayMisc);
+    if (bb->taken != NULL) {
+      successors.Insert(bb->taken);
+    }
+    if (bb->fall_through != NULL) {
+      successors.Insert(bb->fall_through);
+    }
+    if (bb->successor_block_list.block_list_type != kNotUsed) {
+      GrowableArray<SuccessorBlockInfo*>::Iterator succ_iter(bb->successor_block_list.blocks);
+      for (SuccessorBlockInfo* info = succ_iter.Next(); info != NULL; info = succ_iter.Next()) {
+        successors.Insert(info->block);
+      }
+    }
+    for (size_t i = 0; i < successors.Size(); i++) {
+      BasicBlock* header = successors.Get(i);
+      if (!bb->dominators->IsBitSet(header->id)) {
+        continue;
+      }
+      if (loop_bodies[header->id] == NULL) {
+        loop_bodies[header->id] =
+            new (arena_) ArenaBitVector(arena_, GetNumBlocks(), false, kBitMapMisc);
+      }
+      AddNaturalLoop(header, bb, loop_bodies[header->id]);
+    }
+  }
+  for (int i = 0; i < GetNumBlocks(); i++) {
+    if (loop_bodies[i] != NULL) {
+      EliminateLoopRangeChecks(GetBasicBlock(i), loop_bodies[i], ssa_defs, ssa_def_blocks);
+    }
+  }
+  if (cu_->enable_debug & (1 << kDebugDumpCFG)) {
+    DumpCFG("/sdcard/4_post_bce_cfg/", false);
+  }
+}
+
+/*
+ * Value number the whole method by walking the dominator tree, each block starting from the
+ * value map its immediate dominator ended with.  Only null and range check facts are used, which
+ * hold for SSA names wherever their check dominates, so no memory versions need merging.
+ */
+void MIRGraph::GlobalValueNumbering() {
+  if (cu_->disable_opt & (1 << kGlobalValueNumbering)) {
+    return;
+  }
+  // Value names are 16 bits, give up on methods that might run out of them.
+  size_t num_mirs = 0;
+  AllNodesIterator count_iter(this, false /* not iterative */);
+  for (BasicBlock* bb = count_iter.Next(); bb != NULL; bb = count_iter.Next()) {
+    for (MIR* mir = bb->first_mir_insn; mir != NULL; mir = mir->next) {
+      num_mirs++;
+    }
+  }
+  if (GetNumSSARegs() + 3 * num_mirs >= ARRAY_REF) {
+    cu_->disable_opt |= (1 << kGlobalValueNumbering);
+    return;
+  }
+  // Children share their parent's map, only siblings after the first need a copy.
+  std::vector<std::pair<BasicBlock*, LocalValueNumbering*> > work_stack;
+  work_stack.push_back(std::make_pair(GetEntryBlock(), new LocalValueNumbering(cu_)));
+  while (!work_stack.empty()) {
+    BasicBlock* bb = work_stack.back().first;
+    LocalValueNumbering* valnum = work_stack.back().second;
+    work_stack.pop_back();
+    for (MIR* mir = bb->first_mir_insn; mir != NULL; mir = mir->next) {
+      int old_flags = mir->optimization_flags;
+      valnum->GetValueNumber(mir);
+      int new_flags = mir->optimization_flags & ~old_flags;
+      if (new_flags & MIR_IGNORE_NULL_CHECK) {
+        gvn_null_checks_eliminated_++;
+      }
+      if (new_flags & MIR_IGNORE_RANGE_CHECK) {
+        gvn_range_checks_eliminated_++;
+      }
+    }
+    bool gave_away = false;
+    if (bb->i_dominated != NULL) {
+      ArenaBitVector::Iterator iter(bb->i_dominated);
+      for (int child_id = iter.Next(); child_id != -1; child_id = iter.Next()) {
+        LocalValueNumbering* child_valnum = gave_away ? new LocalValueNumbering(*valnum) : valnum;
+        work_stack.push_back(std::make_pair(GetBasicBlock(child_id), child_valnum));
+        gave_away = true;
+      }
+    }
+    if (!gave_away) {
+      delete valnum;
+    }
+  }
+}
+
+// What a dominating check-cast, instance-of branch or new-instance proved about a reference.
+struct TypeFact {
+  int s_reg;
+  uint32_t type_idx;   // The reference is an instance of this type...
+  bool non_null;       // ...and, if set, isn't null.
+};
+
+// Returns a fact proving s_reg an instance of type_idx, and not null if need_non_null is set, or
+// NULL if there is none.
+static const TypeFact* FindTypeFact(CompilerDriver* driver, const DexFile& dex_file,
+                                    const std::vector<TypeFact>& facts, int s_reg,
+                                    uint32_t type_idx, bool need_non_null) {
+  for (size_t i = 0; i < facts.size(); i++) {
+    const TypeFact& fact = facts[i];
+    if (fact.s_reg == s_reg && (fact.non_null || !need_non_null) &&
+        driver->IsAssignableType(dex_file, type_idx, fact.type_idx)) {
+      return &fact;
+    }
+  }
+  return NULL;
+}
+
+/*
+ * Drop check-casts, and fold instance-ofs, of references whose type a dominating check
+ * already proved.  Facts come from check-cast, which leaves its SSA name an instance of the
+ * type or null, from the non-zero side of a branch on an instance-of, and from new-instance.
+ * A fact for a type proves any check against its supertypes too.  Like GlobalValueNumbering,
+ * the dominator tree is walked with each block starting from the facts its immediate
+ * dominator ended with.
+ */
+void MIRGraph::TypeCheckElimination() {
+  if (cu_->disable_opt & (1 << kTypeCheckElimination)) {
+    return;
+  }
+  // Map SSA names to their definitions, and find the halves of throwing instructions which
+  // were split for a try block: code generation puts them back together from the first half,
+  // so the second half can't be changed on its own.
+  MIR** ssa_defs = static_cast<MIR**>(arena_->Alloc(sizeof(MIR*) * GetNumSSARegs(),
+                                                    ArenaAllocator::kAllocDFInfo));
+  std::set<MIR*> split_mirs;
+  bool has_checks = false;
+  AllNodesIterator def_iter(this, false /* not iterative */);
+  for (BasicBlock* bb = def_iter.Next(); bb != NULL; bb = def_iter.Next()) {
+    for (MIR* mir = bb->first_mir_insn; mir != NULL; mir = mir->next) {
+      int opcode = mir->dalvikInsn.opcode;
+      if (opcode == kMirOpCheck) {
+        split_mirs.insert(mir->meta.throw_insn);
+      } else if (opcode == Instruction::CHECK_CAST || opcode == Instruction::INSTANCE_OF) {
+        has_checks = true;
+      }
+      if (mir->ssa_rep != NULL) {
+        for (int i = 0; i < mir->ssa_rep->num_defs; i++) {
+          ssa_defs[mir->ssa_rep->defs[i]] = mir;
+        }
+      }
+    }
+  }
+  if (!has_checks) {
+    return;
+  }
+  CompilerDriver* driver = cu_->compiler_driver;
+  const DexFile& dex_file = *cu_->dex_file;
+  std::vector<std::pair<BasicBlock*, std::vector<TypeFact> > > work_stack;
+  work_stack.push_back(std::make_pair(GetEntryBlock(), std::vector<TypeFact>()));
+  while (!work_stack.empty()) {
+    BasicBlock* bb = work_stack.back().first;
+    std::vector<TypeFact> facts;
+    facts.swap(work_stack.back().second);
+    work_stack.pop_back();
+    // A block only entered from the non-zero side of a branch on an instance-of knows its
+    // operand's type.
+    if (bb->predecessors->Size() == 1) {
+      BasicBlock* pred = bb->predecessors->Get(0);
+      MIR* branch = pred->last_mir_insn;
+      if (branch != NULL && pred->taken != pred->fall_through &&
+          ((branch->dalvikInsn.opcode == Instruction::IF_NEZ && pred->taken == bb) ||
+           (branch->dalvikInsn.opcode == Instruction::IF_EQZ && pred->fall_through == bb))) {
+        MIR* def = ssa_defs[branch->ssa_rep->uses[0]];
+        if (def != NULL && def->dalvikInsn.opcode == Instruction::INSTANCE_OF) {
+          TypeFact fact = { def->ssa_rep->uses[0], def->dalvikInsn.vC, true };
+          facts.push_back(fact);
+        }
+      }
+    }
+    for (MIR* mir = bb->first_mir_insn; mir != NULL; mir = mir->next) {
+      if (mir->ssa_rep == NULL || split_mirs.count(mir) != 0) {
+        continue;
+      }
+      switch (mir->dalvikInsn.opcode) {
+        case Instruction::CHECK_CAST: {
+          int s_reg = mir->ssa_rep->uses[0];
+          uint32_t type_idx = mir->dalvikInsn.vB;
+          if (FindTypeFact(driver, dex_file, facts, s_reg, type_idx, false) != NULL) {
+            mir->optimization_flags |= MIR_IGNORE_CHECK_CAST;
+            type_checks_eliminated_++;
+          } else {
+            TypeFact fact = { s_reg, type_idx, false };
+            facts.push_back(fact);
+          }
+          break;
+        }
+        case Instruction::INSTANCE_OF:
+          // Null isn't an instance of anything, so only a fact that the reference isn't null
+          // settles the answer.
+          if (FindTypeFact(driver, dex_file, facts, mir->ssa_rep->uses[0], mir->dalvikInsn.vC,
+                           true) != NULL) {
+            mir->dalvikInsn.opcode = Instruction::CONST;
+            mir->dalvikInsn.vB = 1;
+            mir->ssa_rep->num_uses = 0;
+            type_checks_eliminated_++;
+          }
+          break;
+        case Instruction::NEW_INSTANCE: {
+          TypeFact fact = { mir->ssa_rep->defs[0], mir->dalvikInsn.vB, true };
+          facts.push_back(fact);
+          break;
+        }
+        case Instruction::MOVE_OBJECT:
+        case Instruction::MOVE_OBJECT_FROM16:
+        case Instruction::MOVE_OBJECT_16: {
+          // A copy knows what its source does.
+          size_t num_facts = facts.size();
+          for (size_t i = 0; i < num_facts; i++) {
+            if (facts[i].s_reg == mir->ssa_rep->uses[0]) {
+              TypeFact fact = { mir->ssa_rep->defs[0], facts[i].type_idx, facts[i].non_null };
+              facts.push_back(fact);
+            }
+          }
+          break;
+        }
+        default:
+          break;
+      }
+    }
+    if (bb->i_dominated != NULL) {
+      ArenaBitVector::Iterator iter(bb->i_dominated);
+      for (int child_id = iter.Next(); child_id != -1; child_id = iter.Next()) {
+        work_stack.push_back(std::make_pair(GetBasicBlock(child_id), facts));
+      }
+    }
+  }
+}
+
+/*
+ * A field store of a constructor that only stores its arguments: the store's opcode, the field
+ * and the first argument word holding the value, counting the receiver as word 0.
+ */
+struct ConstructorStore {
+  Instruction::Code opcode;
+  uint32_t field_idx;
+  uint32_t arg;
+};
+
+static bool IsObjectConstructor(const DexFile& dex_file, uint32_t method_idx) {
+  const DexFile::MethodId& method_id = dex_file.GetMethodId(method_idx);
+  return (strcmp(dex_file.GetMethodName(method_id), "<init>") == 0) &&
+      (strcmp(dex_file.GetMethodDeclaringClassDescriptor(method_id), "Ljava/lang/Object;") == 0);
+}
+
+/*
+ * Match Object's constructor, or one which calls another constructor of the same kind without
+ * arguments and otherwise only stores its arguments to fields of the new object, collecting the
+ * stores.  Sub-word stores aren't matched, as the field would hold a truncated value.
+ */
+static bool MatchArgumentConstructor(CompilerDriver* driver, const MethodReference& target,
+                                     std::vector<ConstructorStore>* stores) {
+  if (IsObjectConstructor(*target.dex_file, target.dex_method_index)) {
+    return true;
+  }
+  uint32_t access_flags = 0;
+  const DexFile::CodeItem* code_item = driver->GetInlineCodeItem(target, access_flags);
+  if ((code_item == NULL) || ((access_flags & (kAccConstructor | kAccStatic)) != kAccConstructor) ||
+      (code_item->tries_size_ != 0)) {
+    return false;
+  }
+  const uint32_t this_reg = code_item->registers_size_ - code_item->ins_size_;
+  bool called_constructor = false;
+  for (uint32_t dex_pc = 0; dex_pc < code_item->insns_size_in_code_units_;) {
+    const Instruction* insn = Instruction::At(code_item->insns_ + dex_pc);
+    switch (insn->Opcode()) {
+      case Instruction::RETURN_VOID:
+        return called_constructor;
+      case Instruction::INVOKE_DIRECT: {
+        std::vector<ConstructorStore> callee_stores;
+        MethodReference callee(target.dex_file, insn->VRegB_35c());
+        if (called_constructor || (insn->VRegA_35c() != 1) || (insn->VRegC_35c() != this_reg) ||
+            !MatchArgumentConstructor(driver, callee, &callee_stores) || !callee_stores.empty()) {
+          return false;
+        }
+        called_constructor = true;
+        break;
+      }
+      case Instruction::IPUT:
+      case Instruction::IPUT_WIDE:
+      case Instruction::IPUT_OBJECT: {
+        const uint32_t value_reg = insn->VRegA_22c();
+        if ((insn->VRegB_22c() != this_reg) || (value_reg <= this_reg)) {
+          return false;
+        }
+        ConstructorStore store = { insn->Opcode(), insn->VRegC_22c(), value_reg - this_reg };
+        stores->push_back(store);
+        break;
+      }
+      default:
+        return false;
+    }
+    dex_pc += insn->SizeInCodeUnits();
+  }
+  return false;
+}
+
+/*
+ * The value a field of an allocation being replaced holds: the SSA names last stored to it, or
+ * none while it holds its default of zero.  A stored value is read back from the Dalvik
+ * register it was stored from, so it is lost once that register is written.
+ */
+struct ScalarField {
+  int offset;
+  bool wide;
+  int num_sregs;
+  int sregs[2];
+  bool lost;
+};
+
+static ScalarField* FindScalarField(CompilerDriver* driver, DexCompilationUnit* m_unit,
+                                    uint32_t field_idx, bool wide,
+                                    std::vector<ScalarField>* fields) {
+  int offset;
+  bool is_volatile;
+  if (!driver->ComputeInstanceFieldInfo(field_idx, m_unit, offset, is_volatile, false) ||
+      is_volatile) {
+    return NULL;
+  }
+  for (size_t i = 0; i < fields->size(); i++) {
+    if ((*fields)[i].offset == offset) {
+      return ((*fields)[i].wide == wide) ? &(*fields)[i] : NULL;
+    }
+  }
+  ScalarField field = { offset, wide, 0, { INVALID_SREG, INVALID_SREG }, false };
+  fields->push_back(field);
+  return &fields->back();
+}
+
+/*
+ * Replace the new-instance by its fields if the rest of its block only uses the new object as
+ * the object of iget and iput and the receiver of a constructor matched by
+ * MatchArgumentConstructor, and no load needs a value whose register was written since it was
+ * stored.  The caller checked there are no other uses.
+ */
+bool MIRGraph::ScalarReplaceAllocation(MIR* new_instance) {
+  CompilerDriver* driver = cu_->compiler_driver;
+  DexCompilationUnit* m_unit = GetCurrentDexCompilationUnit();
+  const int obj_sreg = new_instance->ssa_rep->defs[0];
+  std::vector<ScalarField> fields;
+  std::vector<std::pair<MIR*, ScalarField> > loads;
+  std::vector<MIR*> stores;
+  for (MIR* mir = new_instance->next; mir != NULL; mir = mir->next) {
+    SSARepresentation* ssa_rep = mir->ssa_rep;
+    if (ssa_rep == NULL) {
+      continue;
+    }
+    int obj_use = -1;
+    for (int i = 0; i < ssa_rep->num_uses; i++) {
+      if (ssa_rep->uses[i] == obj_sreg) {
+        if (obj_use != -1) {
+          return false;
+        }
+        obj_use = i;
+      }
+    }
+    if (obj_use != -1) {
+      const Instruction::Code opcode = mir->dalvikInsn.opcode;
+      switch (opcode) {
+        case Instruction::IGET:
+        case Instruction::IGET_WIDE:
+        case Instruction::IGET_OBJECT: {
+          ScalarField* field = FindScalarField(driver, m_unit, mir->dalvikInsn.vC,
+                                               opcode == Instruction::IGET_WIDE, &fields);
+          if ((field == NULL) || field->lost) {
+            return false;
+          }
+          loads.push_back(std::make_pair(mir, *field));
+          break;
+        }
+        case Instruction::IPUT:
+        case Instruction::IPUT_WIDE:
+        case Instruction::IPUT_OBJECT: {
+          const bool wide = (opcode == Instruction::IPUT_WIDE);
+          const int num_value_uses = wide ? 2 : 1;
+          ScalarField* field = FindScalarField(driver, m_unit, mir->dalvikInsn.vC, wide, &fields);
+          if ((obj_use != num_value_uses) || (field == NULL)) {
+            return false;
+          }
+          field->num_sregs = num_value_uses;
+          field->sregs[0] = ssa_rep->uses[0];
+          field->sregs[1] = wide ? ssa_rep->uses[1] : INVALID_SREG;
+          field->lost = false;
+          stores.push_back(mir);
+          break;
+        }
+        case Instruction::INVOKE_DIRECT:
+        case Instruction::INVOKE_DIRECT_RANGE: {
+          std::vector<ConstructorStore> constructor_stores;
+          MethodReference target(cu_->dex_file, mir->dalvikInsn.vB);
+          if ((obj_use != 0) ||
+              !MatchArgumentConstructor(driver, target, &constructor_stores)) {
+            return false;
+          }
+          for (size_t i = 0; i < constructor_stores.size(); i++) {
+            const ConstructorStore& store = constructor_stores[i];
+            const bool wide = (store.opcode == Instruction::IPUT_WIDE);
+            ScalarField* field = FindScalarField(driver, m_unit, store.field_idx, wide, &fields);
+            if ((field == NULL) ||
+                (static_cast<int>(store.arg) + (wide ? 1 : 0) >= ssa_rep->num_uses)) {
+              return false;
+            }
+            field->num_sregs = wide ? 2 : 1;
+            field->sregs[0] = ssa_rep->uses[store.arg];
+            field->sregs[1] = wide ? ssa_rep->uses[store.arg + 1] : INVALID_SREG;
+            field->lost = false;
+          }
+          stores.push_back(mir);
+          break;
+        }
+        default:
+          return false;
+      }
+    }
+    for (int i = 0; i < ssa_rep->num_defs; i++) {
+      const int v_reg = SRegToVReg(ssa_rep->defs[i]);
+      for (size_t j = 0; j < fields.size(); j++) {
+        for (int k = 0; k < fields[j].num_sregs; k++) {
+          if (SRegToVReg(fields[j].sregs[k]) == v_reg) {
+            fields[j].lost = true;
+          }
+        }
+      }
+    }
+  }
+  for (size_t i = 0; i < loads.size(); i++) {
+    MIR* mir = loads[i].first;
+    const ScalarField& field = loads[i].second;
+    SSARepresentation* ssa_rep = mir->ssa_rep;
+    if (field.num_sregs == 0) {
+      mir->dalvikInsn.opcode = field.wide ? Instruction::CONST_WIDE : Instruction::CONST;
+      mir->dalvikInsn.vB = 0;
+      mir->dalvikInsn.vB_wide = 0;
+      ssa_rep->num_uses = 0;
+      continue;
+    }
+    switch (mir->dalvikInsn.opcode) {
+      case Instruction::IGET_WIDE:
+        mir->dalvikInsn.opcode = Instruction::MOVE_WIDE;
+        break;
+      case Instruction::IGET_OBJECT:
+        mir->dalvikInsn.opcode = Instruction::MOVE_OBJECT;
+        break;
+      default:
+        mir->dalvikInsn.opcode = Instruction::MOVE;
+        break;
+    }
+    mir->dalvikInsn.vB = SRegToVReg(field.sregs[0]);
+    ssa_rep->num_uses = field.num_sregs;
+    ssa_rep->uses = static_cast<int*>(arena_->Alloc(sizeof(int) * field.num_sregs,
+                                                    ArenaAllocator::kAllocDFInfo));
+    ssa_rep->fp_use = static_cast<bool*>(arena_->Alloc(sizeof(bool) * field.num_sregs,
+                                                       ArenaAllocator::kAllocDFInfo));
+    for (int j = 0; j < field.num_sregs; j++) {
+      ssa_rep->uses[j] = field.sregs[j];
+    }
+  }
+  for (size_t i = 0; i < stores.size(); i++) {
+    MIR* mir = stores[i];
+    mir->meta.original_opcode = mir->dalvikInsn.opcode;
+    mir->dalvikInsn.opcode = static_cast<Instruction::Code>(kMirOpNop);
+    mir->ssa_rep->num_uses = 0;
+    mir->ssa_rep->num_defs = 0;
+  }
+  // The GC maps still say the register holds a reference, so leave null rather than a stale
+  // value in it.
+  new_instance->dalvikInsn.opcode = Instruction::CONST;
+  new_instance->dalvikInsn.vB = 0;
+  return true;
+}
+
+/*
+ * Replace allocations that never escape the block they are made in by the values of their
+ * fields, see ScalarReplaceAllocation, when removing them is unobservable, see
+ * CompilerDriver::CanRemoveAllocation.  Loads become moves from the registers the stored values
+ * are still in, or constants for fields not stored yet, and the stores and the constructor call
+ * are dropped.  Must run before constant propagation and use counting, which then see the
+ * rewritten instructions.
+ */
+void MIRGraph::ScalarReplacement() {
+  if (cu_->disable_opt & (1 << kScalarReplacement)) {
+    return;
+  }
+  // Find the allocations, their blocks, and the halves of throwing instructions which were split
+  // for a try block, which code generation puts back together.
+  std::map<int, std::pair<MIR*, BasicBlock*> > allocations;
+  std::set<MIR*> split_mirs;
+  AllNodesIterator iter(this, false /* not iterative */);
+  for (BasicBlock* bb = iter.Next(); bb != NULL; bb = iter.Next()) {
+    for (MIR* mir = bb->first_mir_insn; mir != NULL; mir = mir->next) {
+      if (static_cast<int>(mir->dalvikInsn.opcode) == kMirOpCheck) {
+        split_mirs.insert(mir->meta.throw_insn);
+      } else if ((mir->dalvikInsn.opcode == Instruction::NEW_INSTANCE) && (mir->ssa_rep != NULL)) {
+        allocations[mir->ssa_rep->defs[0]] = std::make_pair(mir, bb);
+      }
+    }
+  }
+  if (allocations.empty()) {
+    return;
+  }
+  // An allocation used in another block, by a Phi or by a split instruction escapes.
+  std::set<int> escaped;
+  AllNodesIterator use_iter(this, false /* not iterative */);
+  for (BasicBlock* bb = use_iter.Next(); bb != NULL; bb = use_iter.Next()) {
+    for (MIR* mir = bb->first_mir_insn; mir != NULL; mir = mir->next) {
+      if (mir->ssa_rep == NULL) {
+        continue;
+      }
+      for (int i = 0; i < mir->ssa_rep->num_uses; i++) {
+        std::map<int, std::pair<MIR*, BasicBlock*> >::iterator it =
+            allocations.find(mir->ssa_rep->uses[i]);
+        if ((it != allocations.end()) &&
+            ((it->second.second != bb) || (split_mirs.count(mir) != 0) ||
+             (static_cast<int>(mir->dalvikInsn.opcode) >= kMirOpFirst))) {
+          escaped.insert(it->first);
+        }
+      }
+    }
+  }
+  const DexFile& dex_file = *cu_->dex_file;
+  for (std::map<int, std::pair<MIR*, BasicBlock*> >::iterator it = allocations.begin();
+       it != allocations.end(); ++it) {
+    MIR* new_instance = it->second.first;
+    if ((escaped.count(it->first) == 0) && (split_mirs.count(new_instance) == 0) &&
+        cu_->compiler_driver->CanRemoveAllocation(cu_->method_idx, dex_file,
+                                                  new_instance->dalvikInsn.vB) &&
+        ScalarReplaceAllocation(new_instance)) {
+      allocations_replaced_++;
+    }
+  }
+}
+
+static bool IsGoto(const MIR* mir) {
+  return (mir->dalvikInsn.opcode == Instruction::GOTO) ||
+      (mir->dalvikInsn.opcode == Instruction::GOTO_16) ||
+      (mir->dalvikInsn.opcode == Instruction::GOTO_32);
+}
+
+/* Return the three address form of arithmetic a vector loop can do, NOP if it can't */
+static Instruction::Code VectorArithOpcode(Instruction::Code opcode, InstructionSet isa) {
+  switch (opcode) {
+    case Instruction::ADD_INT:
+    case Instruction::ADD_INT_2ADDR:
+      return Instruction::ADD_INT;
+    case Instruction::SUB_INT:
+    case Instruction::SUB_INT_2ADDR:
+      return Instruction::SUB_INT;
+    case Instruction::AND_INT:
+    case Instruction::AND_INT_2ADDR:
+      return Instruction::AND_INT;
+    case Instruction::OR_INT:
+    case Instruction::OR_INT_2ADDR:
+      return Instruction::OR_INT;
+    case Instruction::XOR_INT:
+    case Instruction::XOR_INT_2ADDR:
+      return Instruction::XOR_INT;
+    case Instruction::MUL_INT:
+    case Instruction::MUL_INT_2ADDR:
+      // SSE2 has no packed 32-bit multiply.
+      return (isa == kThumb2) ? Instruction::MUL_INT : Instruction::NOP;
+    // NEON flushes denormals to zero, which Java float arithmetic doesn't allow.
+    case Instruction::ADD_FLOAT:
+    case Instruction::ADD_FLOAT_2ADDR:
+      return (isa == kX86) ? Instruction::ADD_FLOAT : Instruction::NOP;
+    case Instruction::SUB_FLOAT:
+    case Instruction::SUB_FLOAT_2ADDR:
+      return (isa == kX86) ? Instruction::SUB_FLOAT : Instruction::NOP;
+    case Instruction::MUL_FLOAT:
+    case Instruction::MUL_FLOAT_2ADDR:
+      return (isa == kX86) ? Instruction::MUL_FLOAT : Instruction::NOP;
+    default:
+      return Instruction::NOP;
+  }
+}
+
+/*
+ * Replace the SSA name of a vector operand by the number of the earlier op defining it.  Values
+ * from outside of the vector ops, such as the index, aren't supported.
+ */
+static bool FindVectorValue(const int* value_sregs, int num_values, int* operand) {
+  for (int i = 0; i < num_values; i++) {
+    if (value_sregs[i] == *operand) {
+      *operand = i;
+      return true;
+    }
+  }
+  return false;
+}
+
+/*
+ * Match a loop of header computing "for (; i < bound; i++) c[i] = a[i] op b[i] ..." on 32-bit
+ * elements, with the bound and the arrays defined outside of the loop, and put a
+ * kMirOpVectorLoop doing as many of its iterations as it can four at a time at the end of its
+ * preheader.  The vector loop only runs iterations which index every array in range and hands
+ * the index it stopped at to the header's Phi, so the original loop does the rest and throws
+ * wherever it would have.
+ *
+ * The only Phi of the header is the index, so nothing else is carried from one iteration to
+ * the next.  Java arrays are either the same array or don't overlap at all, and every access
+ * uses the same index, so iterations neither see each other's stores nor need an overlap check.
+ */
+bool MIRGraph::VectorizeLoop(BasicBlock* header, BasicBlock** ssa_def_blocks) {
+  MIR* phi = header->first_mir_insn;
+  if ((header->block_type != kDalvikByteCode) || (phi == NULL) ||
+      (static_cast<int>(phi->dalvikInsn.opcode) != kMirOpPhi) ||
+      (phi->ssa_rep->num_uses != 2) || (Predecessors(header) != 2) ||
+      (header->successor_block_list.block_list_type != kNotUsed)) {
+    return false;
+  }
+  // The test either follows the Phi or, for "i < a.length", the work half of the array-length.
+  BasicBlock* test_bb = header;
+  MIR* test = phi->next;
+  MIR* length = NULL;
+  if ((test != NULL) && (static_cast<int>(test->dalvikInsn.opcode) == kMirOpCheck) &&
+      (test->next == NULL)) {
+    length = test->meta.throw_insn;
+    test_bb = header->fall_through;
+    if ((length->dalvikInsn.opcode != Instruction::ARRAY_LENGTH) || (test_bb == NULL) ||
+        (test_bb->first_mir_insn != length) || (Predecessors(test_bb) != 1) ||
+        (test_bb->successor_block_list.block_list_type != kNotUsed)) {
+      return false;
+    }
+    test = length->next;
+  }
+  if ((test == NULL) || (test->next != NULL) || (test->ssa_rep == NULL) ||
+      (test->ssa_rep->num_uses != 2) || (test_bb->taken == test_bb->fall_through)) {
+    return false;
+  }
+  int index_use;
+  BasicBlock* body_bb;
+  switch (test->dalvikInsn.opcode) {
+    case Instruction::IF_GE:
+      index_use = 0;
+      body_bb = test_bb->fall_through;
+      break;
+    case Instruction::IF_LT:
+      index_use = 0;
+      body_bb = test_bb->taken;
+      break;
+    case Instruction::IF_LE:
+      index_use = 1;
+      body_bb = test_bb->fall_through;
+      break;
+    case Instruction::IF_GT:
+      index_use = 1;
+      body_bb = test_bb->taken;
+      break;
+    default:
+      return false;
+  }
+  int index_sreg = phi->ssa_rep->defs[0];
+  int bound_sreg = test->ssa_rep->uses[1 - index_use];
+  if (test->ssa_rep->uses[index_use] != index_sreg) {
+    return false;
+  }
+  if (length != NULL) {
+    if (bound_sreg != length->ssa_rep->defs[0]) {
+      return false;
+    }
+    bound_sreg = length->ssa_rep->uses[0];
+  }
+
+  // The body is a straight line of blocks, left only to throw, which ends back at the header.
+  ArenaBitVector* loop_blocks =
+      new (arena_) ArenaBitVector(arena_, GetNumBlocks(), false, kBitMapMisc);
+  loop_blocks->SetBit(header->id);
+  loop_blocks->SetBit(test_bb->id);
+  static const size_t kMaxBodyBlocks = 16;
+  BasicBlock* body[kMaxBodyBlocks];
+  size_t num_body_blocks = 0;
+  BasicBlock* latch = NULL;
+  for (BasicBlock* bb = body_bb; latch == NULL;) {
+    if ((bb == NULL) || (bb->block_type != kDalvikByteCode) || (Predecessors(bb) != 1) ||
+        loop_blocks->IsBitSet(bb->id) || (num_body_blocks == kMaxBodyBlocks) ||
+        (bb->successor_block_list.block_list_type != kNotUsed)) {
+      return false;
+    }
+    loop_blocks->SetBit(bb->id);
+    body[num_body_blocks++] = bb;
+    BasicBlock* next_bb = bb->fall_through;
+    MIR* last = bb->last_mir_insn;
+    if ((last != NULL) && (static_cast<int>(last->dalvikInsn.opcode) == kMirOpCheck)) {
+      if ((bb->taken == NULL) || (bb->taken->block_type != kExceptionHandling)) {
+        return false;
+      }
+    } else if ((last != NULL) && IsGoto(last)) {
+      next_bb = bb->taken;
+    } else if (bb->taken != NULL) {
+      return false;
+    }
+    if (next_bb == header) {
+      latch = bb;
+    } else {
+      bb = next_bb;
+    }
+  }
+
+  // The preheader must only lead to the header, so the vector loop can go at its end.
+  int* incoming = reinterpret_cast<int*>(phi->dalvikInsn.vB);
+  int entry_use = (incoming[0] == latch->id) ? 1 : 0;
+  if (incoming[1 - entry_use] != latch->id) {
+    return false;
+  }
+  BasicBlock* preheader = GetBasicBlock(incoming[entry_use]);
+  MIR* entry_goto = preheader->last_mir_insn;
+  if ((entry_goto != NULL) && !IsGoto(entry_goto)) {
+    entry_goto = NULL;
+  }
+  BasicBlock* entry_edge = (entry_goto != NULL) ? preheader->taken : preheader->fall_through;
+  BasicBlock* other_edge = (entry_goto != NULL) ? preheader->fall_through : preheader->taken;
+  if ((preheader->block_type != kDalvikByteCode) || loop_blocks->IsBitSet(preheader->id) ||
+      (preheader->successor_block_list.block_list_type != kNotUsed) ||
+      (entry_edge != header) || (other_edge != NULL)) {
+    return false;
+  }
+  BasicBlock* bound_def_bb = ssa_def_blocks[bound_sreg];
+  if ((bound_def_bb != NULL) && loop_blocks->IsBitSet(bound_def_bb->id)) {
+    return false;
+  }
+
+  // Translate the body, naming values by the SSA name of the op defining them for now.
+  const InstructionSet isa = cu_->instruction_set;
+  // Each array is held in a core temp through the loop, on top of the index and the count.
+  const int max_arrays = (isa == kX86) ? 2 : VectorLoopInfo::kMaxArrays;
+  int array_sregs[VectorLoopInfo::kMaxArrays];
+  int value_sregs[VectorLoopInfo::kMaxOps];
+  VectorLoopInfo info;
+  info.num_ops = 0;
+  info.num_arrays = 0;
+  info.bound_is_length = (length != NULL);
+  int next_index_sreg = phi->ssa_rep->uses[1 - entry_use];
+  bool stored = false;
+  bool incremented = false;
+  for (size_t i = 0; i < num_body_blocks; i++) {
+    for (MIR* mir = body[i]->first_mir_insn; mir != NULL; mir = mir->next) {
+      Instruction::Code opcode = mir->dalvikInsn.opcode;
+      if ((opcode == Instruction::NOP) || IsGoto(mir) ||
+          (static_cast<int>(opcode) == kMirOpCheck) || (static_cast<int>(opcode) == kMirOpNop)) {
+        continue;
+      }
+      if ((opcode == Instruction::ADD_INT_LIT8) || (opcode == Instruction::ADD_INT_LIT16)) {
+        if (incremented || (mir->ssa_rep->uses[0] != index_sreg) ||
+            (mir->ssa_rep->defs[0] != next_index_sreg) ||
+            (static_cast<int32_t>(mir->dalvikInsn.vC) != 1)) {
+          return false;
+        }
+        incremented = true;
+        continue;
+      }
+      // The store must be the last access.
+      if (stored || (info.num_ops == VectorLoopInfo::kMaxOps)) {
+        return false;
+      }
+      VectorLoopOp* op = &info.ops[info.num_ops];
+      int array_sreg = INVALID_SREG;
+      if (opcode == Instruction::AGET) {
+        if (mir->ssa_rep->uses[1] != index_sreg) {
+          return false;
+        }
+        op->opcode = opcode;
+        op->dest = mir->ssa_rep->defs[0];
+        array_sreg = mir->ssa_rep->uses[0];
+      } else if (opcode == Instruction::APUT) {
+        if (mir->ssa_rep->uses[2] != index_sreg) {
+          return false;
+        }
+        op->opcode = opcode;
+        op->dest = INVALID_SREG;
+        op->src1 = mir->ssa_rep->uses[0];
+        array_sreg = mir->ssa_rep->uses[1];
+        stored = true;
+      } else {
+        op->opcode = VectorArithOpcode(opcode, isa);
+        if (op->opcode == Instruction::NOP) {
+          return false;
+        }
+        op->dest = mir->ssa_rep->defs[0];
+        op->src1 = mir->ssa_rep->uses[0];
+        op->src2 = mir->ssa_rep->uses[1];
+      }
+      if (array_sreg != INVALID_SREG) {
+        BasicBlock* array_def_bb = ssa_def_blocks[array_sreg];
+        if ((array_def_bb != NULL) && loop_blocks->IsBitSet(array_def_bb->id)) {
+          return false;
+        }
+        int array = 0;
+        while ((array < info.num_arrays) && (array_sregs[array] != array_sreg)) {
+          array++;
+        }
+        if (array == info.num_arrays) {
+          if (info.num_arrays == max_arrays) {
+            return false;
+          }
+          array_sregs[info.num_arrays++] = array_sreg;
+        }
+        if (opcode == Instruction::AGET) {
+          op->src1 = array;
+        } else {
+          op->src2 = array;
+        }
+      }
+      value_sregs[info.num_ops++] = op->dest;
+    }
+  }
+  if (!stored || !incremented) {
+    return false;
+  }
+
+  // Replace SSA names by the ops defining them, and find the last op reading each value.
+  int last_uses[VectorLoopInfo::kMaxOps];
+  for (int i = 0; i < info.num_ops; i++) {
+    VectorLoopOp* op = &info.ops[i];
+    last_uses[i] = -1;
+    if (op->opcode != Instruction::AGET) {
+      if (!FindVectorValue(value_sregs, i, &op->src1)) {
+        return false;
+      }
+      last_uses[op->src1] = i;
+    }
+    if ((op->opcode != Instruction::AGET) && (op->opcode != Instruction::APUT)) {
+      if (!FindVectorValue(value_sregs, i, &op->src2)) {
+        return false;
+      }
+      last_uses[op->src2] = i;
+    }
+  }
+
+  // Assign vector registers, the result takes its first operand's register if that dies.
+  int regs[VectorLoopInfo::kMaxOps];
+  bool reg_in_use[VectorLoopInfo::kMaxRegs] = { false };
+  for (int i = 0; i < info.num_ops; i++) {
+    VectorLoopOp* op = &info.ops[i];
+    int free_reg = -1;
+    if (op->opcode != Instruction::AGET) {
+      int src1_def = op->src1;
+      op->src1 = regs[src1_def];
+      if (last_uses[src1_def] == i) {
+        reg_in_use[op->src1] = false;
+        free_reg = op->src1;
+      }
+    }
+    if (op->opcode == Instruction::APUT) {
+      continue;
+    }
+    for (int reg = 0; (free_reg < 0) && (reg < VectorLoopInfo::kMaxRegs); reg++) {
+      if (!reg_in_use[reg]) {
+        free_reg = reg;
+      }
+    }
+    if (free_reg < 0) {
+      return false;
+    }
+    // The second operand's register is only freed now, two address targets overwrite dest first.
+    if (op->opcode != Instruction::AGET) {
+      int src2_def = op->src2;
+      op->src2 = regs[src2_def];
+      if ((last_uses[src2_def] == i) && (regs[src2_def] != op->src1)) {
+        reg_in_use[op->src2] = false;
+      }
+    }
+    op->dest = free_reg;
+    regs[i] = free_reg;
+    reg_in_use[free_reg] = (last_uses[i] >= 0);
+  }
+
+  // Build the vector loop, which defines a new name for the index the header's Phi starts from.
+  MIR* vector_loop = static_cast<MIR*>(arena_->Alloc(sizeof(MIR), ArenaAllocator::kAllocMIR));
+  vector_loop->dalvikInsn.opcode = static_cast<Instruction::Code>(kMirOpVectorLoop);
+  int v_reg = SRegToVReg(index_sreg);
+  vector_loop->dalvikInsn.vA = v_reg;
+  vector_loop->offset = header->start_offset;
+  vector_loop->m_unit_index = phi->m_unit_index;
+  vector_loop->meta.vector_loop =
+      static_cast<VectorLoopInfo*>(arena_->Alloc(sizeof(VectorLoopInfo),
+                                                 ArenaAllocator::kAllocDFInfo));
+  *vector_loop->meta.vector_loop = info;
+  SSARepresentation* ssa_rep =
+      static_cast<SSARepresentation*>(arena_->Alloc(sizeof(SSARepresentation),
+                                                    ArenaAllocator::kAllocDFInfo));
+  ssa_rep->num_uses = info.num_arrays + 2;
+  ssa_rep->uses = static_cast<int*>(arena_->Alloc(sizeof(int) * ssa_rep->num_uses,
+                                                  ArenaAllocator::kAllocDFInfo));
+  ssa_rep->fp_use = static_cast<bool*>(arena_->Alloc(sizeof(bool) * ssa_rep->num_uses,
+                                                     ArenaAllocator::kAllocDFInfo));
+  ssa_rep->uses[0] = phi->ssa_rep->uses[entry_use];
+  for (int i = 0; i < info.num_arrays; i++) {
+    ssa_rep->uses[i + 1] = array_sregs[i];
+  }
+  ssa_rep->uses[info.num_arrays + 1] = bound_sreg;
+  ssa_rep->num_defs = 1;
+  ssa_rep->defs = static_cast<int*>(arena_->Alloc(sizeof(int), ArenaAllocator::kAllocDFInfo));
+  ssa_rep->fp_def = static_cast<bool*>(arena_->Alloc(sizeof(bool), ArenaAllocator::kAllocDFInfo));
+  ssa_rep->defs[0] = AddNewSReg(v_reg);
+  vector_loop->ssa_rep = ssa_rep;
+  if (entry_goto == NULL) {
+    AppendMIR(preheader, vector_loop);
+  } else if (entry_goto->prev == NULL) {
+    PrependMIR(preheader, vector_loop);
+  } else {
+    InsertMIRAfter(preheader, entry_goto->prev, vector_loop);
+  }
+  phi->ssa_rep->uses[entry_use] = ssa_rep->defs[0];
+  preheader->data_flow_info->vreg_to_ssa_map[v_reg] = ssa_rep->defs[0];
+  return true;
+}
+
+void MIRGraph::VectorizeLoops() {
+  if ((cu_->disable_opt & (1 << kVectorization)) || (cu_->compiler_backend == kPortable) ||
+      ((cu_->instruction_set != kThumb2) && (cu_->instruction_set != kX86))) {
+    return;
+  }
+  // Map SSA names to the blocks defining them, names without one are the method's incoming values.
+  BasicBlock** ssa_def_blocks =
+      static_cast<BasicBlock**>(arena_->Alloc(sizeof(BasicBlock*) * GetNumSSARegs(),
+                                              ArenaAllocator::kAllocDFInfo));
+  AllNodesIterator def_iter(this, false /* not iterative */);
+  for (BasicBlock* bb = def_iter.Next(); bb != NULL; bb = def_iter.Next()) {
+    for (MIR* mir = bb->first_mir_insn; mir != NULL; mir = mir->next) {
+      if (mir->ssa_rep == NULL) {
+        continue;
+      }
+      for (int i = 0; i < mir->ssa_rep->num_defs; i++) {
+        ssa_def_blocks[mir->ssa_rep->defs[i]] = bb;
+      }
+    }
+  }
+  int num_vectorized = 0;
+  AllNodesIterator iter(this, false /* not iterative */);
+  for (BasicBlock* bb = iter.Next(); bb != NULL; bb = iter.Next()) {
+    if (VectorizeLoop(bb, ssa_def_blocks)) {
+      num_vectorized++;
+    }
+  }
+  if (cu_->verbose && (num_vectorized != 0)) {
+    LOG(INFO) << "Vectorized " << num_vectorized << " loops in "
+              << PrettyMethod(cu_->method_idx, *cu_->dex_file);
+  }
+}
+
+/*
+ * Match a callee that only reads or writes a field of its receiver, i.e. one of
+ * "iget* vX, this, field; return* vX" and "iput* arg, this, field; return-void".
+ */
+static bool MatchFieldAccessor(const DexFile::CodeItem* code_item, uint32_t access_flags,
+                               Instruction::Code* opcode, uint32_t* field_idx) {
+  const uint32_t kBailFlags = kAccStatic | kAccSynchronized | kAccDeclaredSynchronized;
+  if ((code_item == NULL) || ((access_flags & kBailFlags) != 0) || (code_item->tries_size_ != 0)) {
+    return false;
+  }
+  const Instruction* insn = Instruction::At(code_item->insns_);
+  if (code_item->insns_size_in_code_units_ != insn->SizeInCodeUnits() + 1) {
+    return false;
+  }
+  const Instruction* ret = insn->Next();
+  const uint32_t this_reg = code_item->registers_size_ - code_item->ins_size_;
+  Instruction::Code code = insn->Opcode();
+  if ((code >= Instruction::IGET) && (code <= Instruction::IGET_SHORT)) {
+    if ((ret->Opcode() != Instruction::RETURN) && (ret->Opcode() != Instruction::RETURN_WIDE) &&
+        (ret->Opcode() != Instruction::RETURN_OBJECT)) {
+      return false;
+    }
+    if ((code_item->ins_size_ != 1) || (insn->VRegB_22c() != this_reg) ||
+        (ret->VRegA_11x() != insn->VRegA_22c())) {
+      return false;
+    }
+  } else if ((code >= Instruction::IPUT) && (code <= Instruction::IPUT_SHORT)) {
+    const uint32_t ins_size = (code == Instruction::IPUT_WIDE) ? 3 : 2;
+    if ((ret->Opcode() != Instruction::RETURN_VOID) || (code_item->ins_size_ != ins_size) ||
+        (insn->VRegB_22c() != this_reg) || (insn->VRegA_22c() != this_reg + 1)) {
+      return false;
+    }
+  } else {
+    return false;
+  }
+  *opcode = code;
+  *field_idx = insn->VRegC_22c();
+  return true;
+}
+
+/*
+ * Replace a statically bound call to a trivial getter or setter with the field access itself.
+ * The field access keeps the invoke's offset, so a null receiver throws at the same dex pc and
+ * the invoke's mapping table and GC map entries still apply.  Must run before the SSA
+ * transformation.
+ */
+bool MIRGraph::InlineFieldAccessor(MIR* mir) {
+  Instruction::Code opcode = mir->dalvikInsn.opcode;
+  InvokeType type;
+  switch (opcode) {
+    case Instruction::INVOKE_VIRTUAL:
+    case Instruction::INVOKE_VIRTUAL_RANGE:
+      type = kVirtual;
+      break;
+    case Instruction::INVOKE_DIRECT:
+    case Instruction::INVOKE_DIRECT_RANGE:
+      type = kDirect;
+      break;
+    default:
+      return false;
+  }
+  const bool is_range = (opcode == Instruction::INVOKE_VIRTUAL_RANGE) ||
+      (opcode == Instruction::INVOKE_DIRECT_RANGE);
+  DexCompilationUnit* m_unit = GetCurrentDexCompilationUnit();
+  MethodReference target_method(m_unit->GetDexFile(), mir->dalvikInsn.vB);
+  int vtable_idx;
+  uintptr_t direct_code;
+  uintptr_t direct_method;
+  if (!cu_->compiler_driver->ComputeInvokeInfo(m_unit, mir->offset, type, target_method,
+                                               vtable_idx, direct_code, direct_method, false) ||
+      (type != kDirect) || (target_method.dex_file != m_unit->GetDexFile())) {
+    return false;
+  }
+  uint32_t access_flags = 0;
+  const DexFile::CodeItem* code_item =
+      cu_->compiler_driver->GetInlineCodeItem(target_method, access_flags);
+  Instruction::Code field_opcode;
+  uint32_t field_idx;
+  if (!MatchFieldAccessor(code_item, access_flags, &field_opcode, &field_idx)) {
+    return false;
+  }
+  const bool is_put = (field_opcode >= Instruction::IPUT);
+  int field_offset;
+  bool is_volatile;
+  if (!cu_->compiler_driver->ComputeInstanceFieldInfo(field_idx, m_unit, field_offset,
+                                                      is_volatile, is_put)) {
+    // The caller can't access the field directly, keep the call.
+    return false;
+  }
+  const uint32_t receiver_reg = is_range ? mir->dalvikInsn.vC : mir->dalvikInsn.arg[0];
+  DecodedInstruction* insn = &mir->dalvikInsn;
+  if (is_put) {
+    const uint32_t value_reg = is_range ? mir->dalvikInsn.vC + 1 : mir->dalvikInsn.arg[1];
+    insn->vA = value_reg;
+  } else {
+    // Only inline getters whose result is used, the move-result is in the invoke's block.
+    MIR* move_result = mir->next;
+    if ((move_result == NULL) ||
+        ((move_result->dalvikInsn.opcode != Instruction::MOVE_RESULT) &&
+         (move_result->dalvikInsn.opcode != Instruction::MOVE_RESULT_WIDE) &&
+         (move_result->dalvikInsn.opcode != Instruction::MOVE_RESULT_OBJECT))) {
+      return false;
+    }
+    insn->vA = move_result->dalvikInsn.vA;
+    move_result->meta.original_opcode = move_result->dalvikInsn.opcode;
+    move_result->dalvikInsn.opcode = static_cast<Instruction::Code>(kMirOpNop);
+  }
+  insn->opcode = field_opcode;
+  insn->vB = receiver_reg;
+  insn->vC = field_idx;
+  // The check half of the split invoke is compiled with the work half's opcode but its own
+  // operands.
+  MIR* check_half = mir->meta.throw_insn;
+  if ((check_half != NULL) &&
+      (static_cast<int>(check_half->dalvikInsn.opcode) == kMirOpCheck)) {
+    check_half->dalvikInsn = *insn;
+    check_half->dalvikInsn.opcode = static_cast<Instruction::Code>(kMirOpCheck);
+  }
+  if (cu_->verbose) {
+    LOG(INFO) << "Inlined " << PrettyMethod(target_method.dex_method_index, *cu_->dex_file)
+              << " at 0x" << std::hex << mir->offset;
+  }
+  return true;
+}
+
+void MIRGraph::InlineCalls() {
+  if (cu_->disable_opt & (1 << kMethodInlining)) {
+    return;
+  }
+  AllNodesIterator iter(this, false /* not iterative */);
+  for (BasicBlock* bb = iter.Next(); bb != NULL; bb = iter.Next()) {
+    if (bb->block_type != kDalvikByteCode) {
+      continue;
+    }
+    for (MIR* mir = bb->first_mir_insn; mir != NULL; mir = mir->next) {
+      InlineFieldAccessor(mir);
+    }
+  }
+}
+
 void MIRGraph::BasicBlockOptimization() {
   if (!(cu_->disable_opt & (1 << kBBOpt))) {
     DCHECK_EQ(cu_->num_compiler_temps, 0);
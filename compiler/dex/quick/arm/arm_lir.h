@@ -448,6 +448,20 @@ enum ArmOpcode {
   kThumb2LdrdPcRel8,  // ldrd rt, rt2, pc +-/1024.
   kThumb2LdrdI8,     // ldrd rt, rt2, [rn +-/1024].
   kThumb2StrdI8,     // strd rt, rt2, [rn +-/1024].
+  kThumb2Vld1Q32,    // vld1.32 {qd}, [rn] [111110010D10] rn[19-16] rd[15-12] [101010001111].
+  kThumb2Vld1Q32Wb,  // vld1.32 {qd}, [rn]! [111110010D10] rn[19-16] rd[15-12] [101010001101].
+  kThumb2Vst1Q32Wb,  // vst1.32 {qd}, [rn]! [111110010D00] rn[19-16] rd[15-12] [101010001101].
+  kThumb2VaddQI32,   // vadd.i32 qd, qn, qm [111011110D10] rn[19-16] rd[15-12] [1000NQM0] rm[3-0].
+  kThumb2VsubQI32,   // vsub.i32 qd, qn, qm [111111110D10] rn[19-16] rd[15-12] [1000NQM0] rm[3-0].
+  kThumb2VmulQI32,   // vmul.i32 qd, qn, qm [111011110D10] rn[19-16] rd[15-12] [1001NQM1] rm[3-0].
+  kThumb2VandQ,      // vand qd, qn, qm [111011110D00] rn[19-16] rd[15-12] [0001NQM1] rm[3-0].
+  kThumb2VorrQ,      // vorr qd, qn, qm [111011110D10] rn[19-16] rd[15-12] [0001NQM1] rm[3-0].
+  kThumb2VeorQ,      // veor qd, qn, qm [111111110D00] rn[19-16] rd[15-12] [0001NQM1] rm[3-0].
+  kThumb2SdivRRR,    // sdiv [111110111001] rn[19..16] [1111] rd[11..8] [1111] rm[3..0].
+  kThumb2UdivRRR,    // udiv [111110111011] rn[19..16] [1111] rd[11..8] [1111] rm[3..0].
+  kThumb2Mls,        // mls [111110110000] rn[19-16] ra[15-12] rd[11-8] [0001] rm[3-0].
+  kThumb2Ldrexd,     // ldrexd [111010001101] rn[19-16] rt[15-12] rt2[11-8] [011111111].
+  kThumb2Strexd,     // strexd [111010001100] rn[19-16] rt[15-12] rt2[11-8] [0111] rd[3-0].
   kArmLast,
 };
 
@@ -987,6 +987,64 @@ const ArmEncodingMap ArmMir2Lir::EncodingMap[kArmLast] = {
                  kFmtBitBlt, 7, 0,
                  IS_QUAD_OP | REG_USE0 | REG_USE1 | REG_USE2 | IS_STORE,
                  "strd", "!0C, !1C, [!2C, #!3E]", 4),
+    ENCODING_MAP(kThumb2Vld1Q32, 0xf9200a8f,
+                 kFmtDfp, 22, 12, kFmtBitBlt, 19, 16, kFmtUnused, -1, -1,
+                 kFmtUnused, -1, -1, IS_BINARY_OP | REG_DEF0_USE1 | IS_LOAD,
+                 "vld1.32", "{!0q}, [!1C]", 4),
+    ENCODING_MAP(kThumb2Vld1Q32Wb, 0xf9200a8d,
+                 kFmtDfp, 22, 12, kFmtBitBlt, 19, 16, kFmtUnused, -1, -1,
+                 kFmtUnused, -1, -1, IS_BINARY_OP | REG_DEF0 | REG_DEF1 | REG_USE1 | IS_LOAD,
+                 "vld1.32", "{!0q}, [!1C]!!", 4),
+    ENCODING_MAP(kThumb2Vst1Q32Wb, 0xf9000a8d,
+                 kFmtDfp, 22, 12, kFmtBitBlt, 19, 16, kFmtUnused, -1, -1,
+                 kFmtUnused, -1, -1, IS_BINARY_OP | REG_USE0 | REG_DEF1 | REG_USE1 | IS_STORE,
+                 "vst1.32", "{!0q}, [!1C]!!", 4),
+    ENCODING_MAP(kThumb2VaddQI32, 0xef200840,
+                 kFmtDfp, 22, 12, kFmtDfp, 7, 16, kFmtDfp, 5, 0,
+                 kFmtUnused, -1, -1, IS_TERTIARY_OP | REG_DEF0_USE12,
+                 "vadd.i32", "!0q, !1q, !2q", 4),
+    ENCODING_MAP(kThumb2VsubQI32, 0xff200840,
+                 kFmtDfp, 22, 12, kFmtDfp, 7, 16, kFmtDfp, 5, 0,
+                 kFmtUnused, -1, -1, IS_TERTIARY_OP | REG_DEF0_USE12,
+                 "vsub.i32", "!0q, !1q, !2q", 4),
+    ENCODING_MAP(kThumb2VmulQI32, 0xef200950,
+                 kFmtDfp, 22, 12, kFmtDfp, 7, 16, kFmtDfp, 5, 0,
+                 kFmtUnused, -1, -1, IS_TERTIARY_OP | REG_DEF0_USE12,
+                 "vmul.i32", "!0q, !1q, !2q", 4),
+    ENCODING_MAP(kThumb2VandQ, 0xef000150,
+                 kFmtDfp, 22, 12, kFmtDfp, 7, 16, kFmtDfp, 5, 0,
+                 kFmtUnused, -1, -1, IS_TERTIARY_OP | REG_DEF0_USE12,
+                 "vand", "!0q, !1q, !2q", 4),
+    ENCODING_MAP(kThumb2VorrQ, 0xef200150,
+                 kFmtDfp, 22, 12, kFmtDfp, 7, 16, kFmtDfp, 5, 0,
+                 kFmtUnused, -1, -1, IS_TERTIARY_OP | REG_DEF0_USE12,
+                 "vorr", "!0q, !1q, !2q", 4),
+    ENCODING_MAP(kThumb2VeorQ, 0xff000150,
+                 kFmtDfp, 22, 12, kFmtDfp, 7, 16, kFmtDfp, 5, 0,
+                 kFmtUnused, -1, -1, IS_TERTIARY_OP | REG_DEF0_USE12,
+                 "veor", "!0q, !1q, !2q", 4),
+    // sdiv and udiv are only present on cores with the kHwDiv instruction set feature.
+    ENCODING_MAP(kThumb2SdivRRR,  0xfb90f0f0,
+                 kFmtBitBlt, 11, 8, kFmtBitBlt, 19, 16, kFmtBitBlt, 3, 0,
+                 kFmtUnused, -1, -1, IS_TERTIARY_OP | REG_DEF0_USE12,
+                 "sdiv", "!0C, !1C, !2C", 4),
+    ENCODING_MAP(kThumb2UdivRRR,  0xfbb0f0f0,
+                 kFmtBitBlt, 11, 8, kFmtBitBlt, 19, 16, kFmtBitBlt, 3, 0,
+                 kFmtUnused, -1, -1, IS_TERTIARY_OP | REG_DEF0_USE12,
+                 "udiv", "!0C, !1C, !2C", 4),
+    ENCODING_MAP(kThumb2Mls,  0xfb000010,
+                 kFmtBitBlt, 11, 8, kFmtBitBlt, 19, 16, kFmtBitBlt, 3, 0,
+                 kFmtBitBlt, 15, 12,
+                 IS_QUAD_OP | REG_DEF0 | REG_USE1 | REG_USE2 | REG_USE3,
+                 "mls", "!0C, !1C, !2C, !3C", 4),
+    ENCODING_MAP(kThumb2Ldrexd,      0xe8d0007f,
+                 kFmtBitBlt, 15, 12, kFmtBitBlt, 11, 8, kFmtBitBlt, 19, 16,
+                 kFmtUnused, -1, -1, IS_TERTIARY_OP | REG_DEF01_USE2 | IS_LOAD,
+                 "ldrexd", "!0C, !1C, [!2C]", 4),
+    ENCODING_MAP(kThumb2Strexd,      0xe8c00070,
+                 kFmtBitBlt, 3, 0, kFmtBitBlt, 15, 12, kFmtBitBlt, 11, 8,
+                 kFmtBitBlt, 19, 16, IS_QUAD_OP | REG_DEF0 | REG_USE1 | REG_USE2 | REG_USE3 |
+                 IS_STORE, "strexd", "!0C, !1C, !2C, [!3C]", 4),
 };
 
 /*
@@ -997,6 +1055,230 @@ const ArmEncodingMap ArmMir2Lir::EncodingMap[kArmLast] = {
  */
 #define PADDING_MOV_R5_R5               0x1C2D
 
+static int PcRelLoadDelta(LIR* lir) {
+  return lir->target->offset - ((lir->offset + 4) & ~3);
+}
+
+static int BranchDelta(LIR* lir) {
+  return lir->target->offset - (lir->offset + 4);
+}
+
+static int AdrDisplacement(LIR* lir) {
+  Mir2Lir::SwitchTable *tab_rec = reinterpret_cast<Mir2Lir::SwitchTable*>(lir->operands[2]);
+  int target_disp = tab_rec ? tab_rec->offset : lir->target->offset;
+  return target_disp - ((lir->offset + 4) & ~3);
+}
+
+static bool IsPcRelLoad(LIR* lir) {
+  return lir->opcode == kThumbLdrPcRel ||
+      lir->opcode == kThumb2LdrPcRel12 ||
+      lir->opcode == kThumbAddPcRel ||
+      lir->opcode == kThumb2LdrdPcRel8 ||
+      ((lir->opcode == kThumb2Vldrd) && (lir->operands[1] == r15pc)) ||
+      ((lir->opcode == kThumb2Vldrs) && (lir->operands[1] == r15pc));
+}
+
+static bool IsPcRelLoadOutOfRange(LIR* lir, int delta) {
+  return ((lir->opcode == kThumb2LdrPcRel12) && (delta > 4091)) ||
+      ((lir->opcode == kThumb2LdrdPcRel8) && (delta > 1020)) ||
+      ((lir->opcode == kThumb2Vldrs) && (delta > 1020)) ||
+      ((lir->opcode == kThumb2Vldrd) && (delta > 1020));
+}
+
+/*
+ * Replace an out-of-range pc-relative load with an Adr of the literal
+ * followed by a load relative to it.  Returns the new Adr.
+ */
+LIR* ArmMir2Lir::ExpandPcRelLoad(LIR* lir) {
+  /*
+   * Note: because rARM_LR may be used to fix up out-of-range
+   * vldrs/vldrd we include REG_DEF_LR in the resource
+   * masks for these instructions.
+   */
+  int base_reg = ((lir->opcode == kThumb2LdrdPcRel8) || (lir->opcode == kThumb2LdrPcRel12))
+      ?  lir->operands[0] : rARM_LR;
+
+  // Add new Adr to generate the address.
+  LIR* new_adr = RawLIR(lir->dalvik_offset, kThumb2Adr,
+             base_reg, 0, 0, 0, 0, lir->target);
+  InsertLIRBefore(lir, new_adr);
+
+  // Convert to normal load.
+  if (lir->opcode == kThumb2LdrPcRel12) {
+    lir->opcode = kThumb2LdrRRI12;
+  } else if (lir->opcode == kThumb2LdrdPcRel8) {
+    lir->opcode = kThumb2LdrdI8;
+  }
+  // Change the load to be relative to the new Adr base.
+  if (lir->opcode == kThumb2LdrdI8) {
+    lir->operands[3] = 0;
+    lir->operands[2] = base_reg;
+  } else {
+    lir->operands[2] = 0;
+    lir->operands[1] = base_reg;
+  }
+  SetupResourceMasks(lir);
+  return new_adr;
+}
+
+/*
+ * Replace an out-of-range cb[n]z with a cmp rx, #0 / b[eq/ne] tgt pair.
+ * Returns the new branch.
+ */
+LIR* ArmMir2Lir::ExpandCompareAndBranch(LIR* lir) {
+  LIR* new_inst =
+    RawLIR(lir->dalvik_offset, kThumbBCond, 0,
+           (lir->opcode == kThumb2Cbz) ? kArmCondEq : kArmCondNe,
+           0, 0, 0, lir->target);
+  InsertLIRAfter(lir, new_inst);
+  /* Convert the cb[n]z to a cmp rx, #0 ] */
+  lir->opcode = kThumbCmpRI8;
+  /* operand[0] is src1 in both cb[n]z & CmpRI8 */
+  lir->operands[1] = 0;
+  lir->target = 0;
+  SetupResourceMasks(lir);
+  return new_inst;
+}
+
+/*
+ * The standard push/pop multiple instruction requires at least two
+ * registers in the list.  If we've got just one, switch to the
+ * single-reg encoding.
+ */
+void ArmMir2Lir::ConvertToSingleRegPushPop(LIR* lir) {
+  lir->opcode = (lir->opcode == kThumb2Push) ? kThumb2Push1 :
+      kThumb2Pop1;
+  int reg = 0;
+  while (lir->operands[0]) {
+    if (lir->operands[0] & 0x1) {
+      break;
+    } else {
+      reg++;
+      lir->operands[0] >>= 1;
+    }
+  }
+  lir->operands[0] = reg;
+  SetupResourceMasks(lir);
+}
+
+/*
+ * Replace an out-of-range Adr with ldimm16l, ldimm16h, add tgt, pc, operands[0].
+ */
+void ArmMir2Lir::ExpandAdr(LIR* lir) {
+  // TUNING: if this case fires often, it can be improved.  Not expected to be common.
+  SwitchTable *tab_rec = reinterpret_cast<SwitchTable*>(lir->operands[2]);
+  LIR *new_mov16L =
+      RawLIR(lir->dalvik_offset, kThumb2MovImm16LST,
+             lir->operands[0], 0, reinterpret_cast<uintptr_t>(lir),
+             reinterpret_cast<uintptr_t>(tab_rec), 0, lir->target);
+  InsertLIRBefore(lir, new_mov16L);
+  LIR *new_mov16H =
+      RawLIR(lir->dalvik_offset, kThumb2MovImm16HST,
+             lir->operands[0], 0, reinterpret_cast<uintptr_t>(lir),
+             reinterpret_cast<uintptr_t>(tab_rec), 0, lir->target);
+  InsertLIRBefore(lir, new_mov16H);
+  if (ARM_LOWREG(lir->operands[0])) {
+    lir->opcode = kThumbAddRRLH;
+  } else {
+    lir->opcode = kThumbAddRRHH;
+  }
+  lir->operands[1] = rARM_PC;
+  SetupResourceMasks(lir);
+}
+
+/*
+ * Widen or rewrite a single pc-relative instruction if the current offsets
+ * say it has to be, exactly as AssembleInstructions would.  New pc-relative
+ * instructions are added to 'fixups'.  Useless branches are only removed
+ * when 'offsets_exact' says no instruction changed size since offsets were
+ * last assigned, as that can't be undone.  Returns whether code size changed.
+ */
+bool ArmMir2Lir::RelaxInstruction(LIR* lir, bool offsets_exact, GrowableArray<LIR*>* fixups) {
+  bool remove_useless_branches =
+      offsets_exact && !(cu_->disable_opt & (1 << kSafeOptimizations));
+  if (IsPcRelLoad(lir)) {
+    if (IsPcRelLoadOutOfRange(lir, PcRelLoadDelta(lir))) {
+      fixups->Insert(ExpandPcRelLoad(lir));
+      return true;
+    }
+  } else if (lir->opcode == kThumb2Cbnz || lir->opcode == kThumb2Cbz) {
+    int delta = BranchDelta(lir);
+    if (delta > 126 || delta < 0) {
+      fixups->Insert(ExpandCompareAndBranch(lir));
+      return true;
+    }
+  } else if (lir->opcode == kThumb2Push || lir->opcode == kThumb2Pop) {
+    if (__builtin_popcount(lir->operands[0]) == 1) {
+      ConvertToSingleRegPushPop(lir);
+      return true;
+    }
+  } else if (lir->opcode == kThumbBCond) {
+    int delta = BranchDelta(lir);
+    if (delta > 254 || delta < -256) {
+      lir->opcode = kThumb2BCond;
+      SetupResourceMasks(lir);
+      return true;
+    }
+  } else if (lir->opcode == kThumb2BUncond) {
+    if (remove_useless_branches && (BranchDelta(lir) >> 1) == 0) {
+      lir->flags.is_nop = true;
+      return true;
+    }
+  } else if (lir->opcode == kThumbBUncond) {
+    int delta = BranchDelta(lir);
+    if (delta > 2046 || delta < -2048) {
+      lir->opcode = kThumb2BUncond;
+      lir->operands[0] = 0;
+      SetupResourceMasks(lir);
+      return true;
+    } else if (remove_useless_branches && (delta >> 1) == -1) {
+      lir->flags.is_nop = true;
+      return true;
+    }
+  } else if (lir->opcode == kThumb2Adr) {
+    if (AdrDisplacement(lir) >= 4096) {
+      ExpandAdr(lir);
+      return true;
+    }
+  }
+  return false;
+}
+
+/*
+ * Resolve all out-of-range pc-relative instructions before assembly, so
+ * that AssembleInstructions doesn't have to restart over the whole method
+ * for each one it finds.  Only the pc-relative instructions are revisited,
+ * and offsets are reassigned once per pass rather than after every change.
+ * Instructions only ever grow or disappear, so this reaches a fixed point.
+ * Returns the number of passes.
+ */
+int ArmMir2Lir::RelaxInstructions() {
+  GrowableArray<LIR*> fixups(arena_, 64);
+  for (LIR* lir = first_lir_insn_; lir != NULL; lir = NEXT_LIR(lir)) {
+    if (lir->opcode >= 0 && lir->flags.pcRelFixup) {
+      fixups.Insert(lir);
+    }
+  }
+  int passes = 0;
+  bool changed;
+  do {
+    changed = false;
+    passes++;
+    // Instructions added by this pass are checked in the next one, with exact offsets.
+    size_t count = fixups.Size();
+    for (size_t i = 0; i < count; i++) {
+      LIR* lir = fixups.Get(i);
+      if (!lir->flags.is_nop && RelaxInstruction(lir, !changed, &fixups)) {
+        changed = true;
+      }
+    }
+    if (changed) {
+      AssignOffsets();
+    }
+  } while (changed);
+  return passes;
+}
+
 /*
  * Assemble the LIR into binary instruction format.  Note that we may
  * discover that pc-relative displacements may not fit the selected
@@ -1032,12 +1314,7 @@ AssemblerStatus ArmMir2Lir::AssembleInstructions(uintptr_t start_addr) {
      * is an iterative process.
      */
     if (lir->flags.pcRelFixup) {
-      if (lir->opcode == kThumbLdrPcRel ||
-          lir->opcode == kThumb2LdrPcRel12 ||
-          lir->opcode == kThumbAddPcRel ||
-          lir->opcode == kThumb2LdrdPcRel8 ||
-          ((lir->opcode == kThumb2Vldrd) && (lir->operands[1] == r15pc)) ||
-          ((lir->opcode == kThumb2Vldrs) && (lir->operands[1] == r15pc))) {
+      if (IsPcRelLoad(lir)) {
         /*
          * PC-relative loads are mostly used to load immediates
          * that are too large to materialize directly in one shot.
@@ -1058,38 +1335,8 @@ AssemblerStatus ArmMir2Lir::AssembleInstructions(uintptr_t start_addr) {
           LOG(FATAL) << "Unexpected pc-rel offset " << delta;
         }
         // Now, check for the difficult cases
-        if (((lir->opcode == kThumb2LdrPcRel12) && (delta > 4091)) ||
-            ((lir->opcode == kThumb2LdrdPcRel8) && (delta > 1020)) ||
-            ((lir->opcode == kThumb2Vldrs) && (delta > 1020)) ||
-            ((lir->opcode == kThumb2Vldrd) && (delta > 1020))) {
-          /*
-           * Note: because rARM_LR may be used to fix up out-of-range
-           * vldrs/vldrd we include REG_DEF_LR in the resource
-           * masks for these instructions.
-           */
-          int base_reg = ((lir->opcode == kThumb2LdrdPcRel8) || (lir->opcode == kThumb2LdrPcRel12))
-              ?  lir->operands[0] : rARM_LR;
-
-          // Add new Adr to generate the address.
-          LIR* new_adr = RawLIR(lir->dalvik_offset, kThumb2Adr,
-                     base_reg, 0, 0, 0, 0, lir->target);
-          InsertLIRBefore(lir, new_adr);
-
-          // Convert to normal load.
-          if (lir->opcode == kThumb2LdrPcRel12) {
-            lir->opcode = kThumb2LdrRRI12;
-          } else if (lir->opcode == kThumb2LdrdPcRel8) {
-            lir->opcode = kThumb2LdrdI8;
-          }
-          // Change the load to be relative to the new Adr base.
-          if (lir->opcode == kThumb2LdrdI8) {
-            lir->operands[3] = 0;
-            lir->operands[2] = base_reg;
-          } else {
-            lir->operands[2] = 0;
-            lir->operands[1] = base_reg;
-          }
-          SetupResourceMasks(lir);
+        if (IsPcRelLoadOutOfRange(lir, delta)) {
+          ExpandPcRelLoad(lir);
           res = kRetryAll;
         } else {
           if ((lir->opcode == kThumb2Vldrs) ||
@@ -1107,46 +1354,14 @@ AssemblerStatus ArmMir2Lir::AssembleInstructions(uintptr_t start_addr) {
         uintptr_t target = target_lir->offset;
         int delta = target - pc;
         if (delta > 126 || delta < 0) {
-          /*
-           * Convert to cmp rx,#0 / b[eq/ne] tgt pair
-           * Make new branch instruction and insert after
-           */
-          LIR* new_inst =
-            RawLIR(lir->dalvik_offset, kThumbBCond, 0,
-                   (lir->opcode == kThumb2Cbz) ? kArmCondEq : kArmCondNe,
-                   0, 0, 0, lir->target);
-          InsertLIRAfter(lir, new_inst);
-          /* Convert the cb[n]z to a cmp rx, #0 ] */
-          lir->opcode = kThumbCmpRI8;
-          /* operand[0] is src1 in both cb[n]z & CmpRI8 */
-          lir->operands[1] = 0;
-          lir->target = 0;
-          SetupResourceMasks(lir);
+          ExpandCompareAndBranch(lir);
           res = kRetryAll;
         } else {
           lir->operands[1] = delta >> 1;
         }
       } else if (lir->opcode == kThumb2Push || lir->opcode == kThumb2Pop) {
         if (__builtin_popcount(lir->operands[0]) == 1) {
-          /*
-           * The standard push/pop multiple instruction
-           * requires at least two registers in the list.
-           * If we've got just one, switch to the single-reg
-           * encoding.
-           */
-          lir->opcode = (lir->opcode == kThumb2Push) ? kThumb2Push1 :
-              kThumb2Pop1;
-          int reg = 0;
-          while (lir->operands[0]) {
-            if (lir->operands[0] & 0x1) {
-              break;
-            } else {
-              reg++;
-              lir->operands[0] >>= 1;
-            }
-          }
-          lir->operands[0] = reg;
-          SetupResourceMasks(lir);
+          ConvertToSingleRegPushPop(lir);
           res = kRetryAll;
         }
       } else if (lir->opcode == kThumbBCond || lir->opcode == kThumb2BCond) {
@@ -1227,25 +1442,7 @@ AssemblerStatus ArmMir2Lir::AssembleInstructions(uintptr_t start_addr) {
         if (disp < 4096) {
           lir->operands[1] = disp;
         } else {
-          // convert to ldimm16l, ldimm16h, add tgt, pc, operands[0]
-          // TUNING: if this case fires often, it can be improved.  Not expected to be common.
-          LIR *new_mov16L =
-              RawLIR(lir->dalvik_offset, kThumb2MovImm16LST,
-                     lir->operands[0], 0, reinterpret_cast<uintptr_t>(lir),
-                     reinterpret_cast<uintptr_t>(tab_rec), 0, lir->target);
-          InsertLIRBefore(lir, new_mov16L);
-          LIR *new_mov16H =
-              RawLIR(lir->dalvik_offset, kThumb2MovImm16HST,
-                     lir->operands[0], 0, reinterpret_cast<uintptr_t>(lir),
-                     reinterpret_cast<uintptr_t>(tab_rec), 0, lir->target);
-          InsertLIRBefore(lir, new_mov16H);
-          if (ARM_LOWREG(lir->operands[0])) {
-            lir->opcode = kThumbAddRRLH;
-          } else {
-            lir->opcode = kThumbAddRRHH;
-          }
-          lir->operands[1] = rARM_PC;
-          SetupResourceMasks(lir);
+          ExpandAdr(lir);
           res = kRetryAll;
         }
       } else if (lir->opcode == kThumb2MovImm16LST) {
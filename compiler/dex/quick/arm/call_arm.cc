@@ -289,6 +289,93 @@ void ArmMir2Lir::GenSpecialCase(BasicBlock* bb, MIR* mir,
   }
 }
 
+/*
+ * Classifies the instructions of a method whose only spill is lr: those of the entry and exit
+ * sequences, the stores to the homes of Dalvik registers, and the rest.
+ */
+enum FrameUse {
+  kFrameSetUp,
+  kFrameHomeStore,
+  kFrameNotUsed,
+  kFrameUsed,
+};
+
+static FrameUse GetFrameUse(LIR* lir, bool in_sequence, uint64_t flags) {
+  if (in_sequence) {
+    return kFrameSetUp;
+  }
+  if ((flags & IS_STORE) && (lir->def_mask & ENCODE_DALVIK_REG) && lir->def_mask != ENCODE_ALL) {
+    return kFrameHomeStore;
+  }
+  // Anything else that touches sp reads the homes, and a def of lr is a call.
+  if (((lir->use_mask | lir->def_mask) & (ENCODE_ARM_REG_SP | ENCODE_ARM_REG_LR)) != 0) {
+    return kFrameUsed;
+  }
+  return kFrameNotUsed;
+}
+
+/*
+ * A frameless method's only Dalvik block keeps the arguments in the registers they arrive in.
+ * If it also never had to reload a value from the frame, call or throw, then its stores to the
+ * frame are dead and the entry and exit sequences can go: the method returns with a bx lr, like
+ * the special cases.
+ */
+bool ArmMir2Lir::RemoveFrame() {
+  // The exit sequence has already turned the spill of lr into a pop of pc.
+  if ((core_spill_mask_ & ~((1 << rARM_LR) | (1 << rARM_PC))) != 0 || num_fp_spills_ != 0 ||
+      throw_launchpads_.Size() != 0 || suspend_launchpads_.Size() != 0 ||
+      intrinsic_launchpads_.Size() != 0) {
+    return false;
+  }
+  bool in_sequence = false;
+  LIR* last_exit_lir = NULL;
+  for (LIR* lir = first_lir_insn_; lir != NULL; lir = lir->next) {
+    if (lir->flags.is_nop) {
+      continue;
+    }
+    if (lir->opcode == kPseudoMethodEntry || lir->opcode == kPseudoMethodExit) {
+      in_sequence = true;
+    } else if (lir->opcode == kPseudoNormalBlockLabel) {
+      in_sequence = false;
+    } else if (lir->opcode == kPseudoSafepointPC) {
+      return false;
+    } else if (!is_pseudo_opcode(lir->opcode)) {
+      if (GetFrameUse(lir, in_sequence, GetTargetInstFlags(lir->opcode)) == kFrameUsed) {
+        return false;
+      }
+      if (in_sequence) {
+        last_exit_lir = lir;
+      }
+    }
+  }
+  if (last_exit_lir == NULL) {
+    return false;
+  }
+  in_sequence = false;
+  for (LIR* lir = first_lir_insn_; lir != NULL; lir = lir->next) {
+    if (lir->flags.is_nop) {
+      continue;
+    }
+    if (lir->opcode == kPseudoMethodEntry || lir->opcode == kPseudoMethodExit) {
+      in_sequence = true;
+    } else if (lir->opcode == kPseudoNormalBlockLabel) {
+      in_sequence = false;
+    } else if (!is_pseudo_opcode(lir->opcode) &&
+               GetFrameUse(lir, in_sequence, GetTargetInstFlags(lir->opcode)) != kFrameNotUsed) {
+      NopLIR(lir);
+    }
+  }
+  InsertLIRAfter(last_exit_lir, RawLIR(last_exit_lir->dalvik_offset, kThumbBx, rARM_LR));
+  core_spill_mask_ = 0;
+  num_core_spills_ = 0;
+  fp_spill_mask_ = 0;
+  num_fp_spills_ = 0;
+  frame_size_ = 0;
+  core_vmap_table_.clear();
+  fp_vmap_table_.clear();
+  return true;
+}
+
 /*
  * The sparse table in the literal pool is an array of <key,displacement>
  * pairs.  For each set, we'll load them as a pair using ldmia.
@@ -308,9 +395,8 @@ void ArmMir2Lir::GenSpecialCase(BasicBlock* bb, MIR* mir,
  *   add   rARM_PC, r_disp   ; This is the branch from which we compute displacement
  *   cbnz  r_idx, lp
  */
-void ArmMir2Lir::GenSparseSwitch(MIR* mir, uint32_t table_offset,
+void ArmMir2Lir::GenSparseSwitch(MIR* mir, const uint16_t* table,
                                  RegLocation rl_src) {
-  const uint16_t* table = cu_->insns + current_dalvik_offset_ + table_offset;
   if (cu_->verbose) {
     DumpSparseSwitchTable(table);
   }
@@ -356,9 +442,8 @@ void ArmMir2Lir::GenSparseSwitch(MIR* mir, uint32_t table_offset,
 }
 
 
-void ArmMir2Lir::GenPackedSwitch(MIR* mir, uint32_t table_offset,
+void ArmMir2Lir::GenPackedSwitch(MIR* mir, const uint16_t* table,
                                  RegLocation rl_src) {
-  const uint16_t* table = cu_->insns + current_dalvik_offset_ + table_offset;
   if (cu_->verbose) {
     DumpPackedSwitchTable(table);
   }
@@ -571,8 +656,13 @@ void ArmMir2Lir::GenEntrySequence(RegLocation* ArgLocs, RegLocation rl_method) {
   bool skip_overflow_check = (mir_graph_->MethodIsLeaf() &&
                             (static_cast<size_t>(frame_size_) <
                             Thread::kStackOverflowReservedBytes));
+  bool implicit_overflow_check = !skip_overflow_check && UseImplicitStackOverflowCheck();
   NewLIR0(kPseudoMethodEntry);
-  if (!skip_overflow_check) {
+  if (implicit_overflow_check) {
+    /* Probe below sp before anything is pushed, so a fault throws from the caller */
+    OpRegRegImm(kOpSub, r12, rARM_SP, Thread::kStackOverflowProbeBytes);
+    MarkImplicitStackOverflowCheck(LoadWordDisp(r12, 0, r12));
+  } else if (!skip_overflow_check) {
     /* Load stack limit */
     LoadWordDisp(rARM_SELF, Thread::StackEndOffset().Int32Value(), r12);
   }
@@ -587,7 +677,7 @@ void ArmMir2Lir::GenEntrySequence(RegLocation* ArgLocs, RegLocation rl_method) {
      */
     NewLIR1(kThumb2VPushCS, num_fp_spills_);
   }
-  if (!skip_overflow_check) {
+  if (!skip_overflow_check && !implicit_overflow_check) {
     OpRegRegImm(kOpSub, rARM_LR, rARM_SP, frame_size_ - (spill_count * 4));
     GenRegRegCheck(kCondCc, rARM_LR, r12, kThrowStackOverflow);
     OpRegCopy(rARM_SP, rARM_LR);     // Establish stack
@@ -26,8 +26,8 @@ class ArmMir2Lir : public Mir2Lir {
     ArmMir2Lir(CompilationUnit* cu, MIRGraph* mir_graph, ArenaAllocator* arena);
 
     // Required for target - codegen helpers.
-    bool SmallLiteralDivRem(Instruction::Code dalvik_opcode, bool is_div, RegLocation rl_src,
-                                    RegLocation rl_dest, int lit);
+    bool MagicLiteralDivRem(Instruction::Code dalvik_opcode, bool is_div, RegLocation rl_src,
+                            RegLocation rl_dest, int lit);
     int LoadHelper(ThreadOffset offset);
     LIR* LoadBaseDisp(int rBase, int displacement, int r_dest, OpSize size, int s_reg);
     LIR* LoadBaseDispWide(int rBase, int displacement, int r_dest_lo, int r_dest_hi,
@@ -72,6 +72,8 @@ class ArmMir2Lir : public Mir2Lir {
 
     // Required for target - miscellaneous.
     AssemblerStatus AssembleInstructions(uintptr_t start_addr);
+    int RelaxInstructions();
+    int GetInstructionLatency(LIR* lir);
     void DumpResourceMask(LIR* lir, uint64_t mask, const char* prefix);
     void SetupTargetResourceMasks(LIR* lir);
     const char* GetTargetInstFmt(int opcode);
@@ -81,6 +83,8 @@ class ArmMir2Lir : public Mir2Lir {
     uint64_t GetTargetInstFlags(int opcode);
     int GetInsnSize(LIR* lir);
     bool IsUnconditionalBranch(LIR* lir);
+    bool IsMemBarrier(LIR* lir);
+    void MergeMemBarriers(LIR* barrier, LIR* earlier);
 
     // Required for target - Dalvik-level generators.
     void GenArithImmOpLong(Instruction::Code opcode, RegLocation rl_dest,
@@ -104,6 +108,7 @@ class ArmMir2Lir : public Mir2Lir {
                   RegLocation rl_src2);
     void GenConversion(Instruction::Code opcode, RegLocation rl_dest, RegLocation rl_src);
     bool GenInlinedCas32(CallInfo* info, bool need_write_barrier);
+    bool GenInlinedCas64(CallInfo* info);
     bool GenInlinedMinMaxInt(CallInfo* info, bool is_min);
     bool GenInlinedSqrt(CallInfo* info);
     void GenNegLong(RegLocation rl_dest, RegLocation rl_src);
@@ -122,6 +127,7 @@ class ArmMir2Lir : public Mir2Lir {
     void GenFusedFPCmpBranch(BasicBlock* bb, MIR* mir, bool gt_bias, bool is_double);
     void GenFusedLongCmpBranch(BasicBlock* bb, MIR* mir);
     void GenSelect(BasicBlock* bb, MIR* mir);
+    void GenVectorLoopBody(const VectorLoopInfo* info, int r_index, int r_count, int* r_arrays);
     void GenMemBarrier(MemBarrierKind barrier_kind);
     void GenMonitorEnter(int opt_flags, RegLocation rl_src);
     void GenMonitorExit(int opt_flags, RegLocation rl_src);
@@ -130,9 +136,10 @@ class ArmMir2Lir : public Mir2Lir {
                                                int first_bit, int second_bit);
     void GenNegDouble(RegLocation rl_dest, RegLocation rl_src);
     void GenNegFloat(RegLocation rl_dest, RegLocation rl_src);
-    void GenPackedSwitch(MIR* mir, uint32_t table_offset, RegLocation rl_src);
-    void GenSparseSwitch(MIR* mir, uint32_t table_offset, RegLocation rl_src);
+    void GenPackedSwitch(MIR* mir, const uint16_t* table, RegLocation rl_src);
+    void GenSparseSwitch(MIR* mir, const uint16_t* table, RegLocation rl_src);
     void GenSpecialCase(BasicBlock* bb, MIR* mir, SpecialCaseHandler special_case);
+    bool RemoveFrame();
 
     // Required for target - single operation generators.
     LIR* OpUnconditionalBranch(LIR* target);
@@ -153,6 +160,7 @@ class ArmMir2Lir : public Mir2Lir {
     LIR* OpRegRegImm(OpKind op, int r_dest, int r_src1, int value);
     LIR* OpRegRegReg(OpKind op, int r_dest, int r_src1, int r_src2);
     LIR* OpTestSuspend(LIR* target);
+    LIR* OpSuspendPoll();
     LIR* OpThreadMem(OpKind op, ThreadOffset thread_offset);
     LIR* OpVldm(int rBase, int count);
     LIR* OpVstm(int rBase, int count);
@@ -188,6 +196,11 @@ class ArmMir2Lir : public Mir2Lir {
     MIR* SpecialIdentity(MIR* mir);
     LIR* LoadFPConstantValue(int r_dest, int value);
     bool BadOverlap(RegLocation rl_src, RegLocation rl_dest);
+    bool RelaxInstruction(LIR* lir, bool offsets_exact, GrowableArray<LIR*>* fixups);
+    LIR* ExpandPcRelLoad(LIR* lir);
+    LIR* ExpandCompareAndBranch(LIR* lir);
+    void ExpandAdr(LIR* lir);
+    void ConvertToSingleRegPushPop(LIR* lir);
 };
 
 }  // namespace art
@@ -21,6 +21,7 @@
 #include "dex/quick/mir_to_lir-inl.h"
 #include "entrypoints/quick/quick_entrypoints.h"
 #include "mirror/array.h"
+#include "utils/magic_divide.h"
 
 namespace art {
 
@@ -244,6 +245,64 @@ void ArmMir2Lir::GenSelect(BasicBlock* bb, MIR* mir) {
   StoreValue(rl_dest, rl_result);
 }
 
+// Vector register n is q<n>, which the assembler takes as its first double d<2n>.
+static int QuadReg(int vector_reg) {
+  return dr0 + 4 * vector_reg;
+}
+
+void ArmMir2Lir::GenVectorLoopBody(const VectorLoopInfo* info, int r_index, int r_count,
+                                   int* r_arrays) {
+  // Walk the arrays with pointers, each bumped by the last access to its array.
+  int data_offset = mirror::Array::DataOffset(sizeof(int32_t)).Int32Value();
+  int last_accesses[VectorLoopInfo::kMaxArrays];
+  for (int i = 0; i < info->num_arrays; i++) {
+    OpRegRegRegShift(kOpAdd, r_arrays[i], r_arrays[i], r_index, EncodeShift(kArmLsl, 2));
+    OpRegImm(kOpAdd, r_arrays[i], data_offset);
+  }
+  for (int i = 0; i < info->num_ops; i++) {
+    if (info->ops[i].opcode == Instruction::AGET) {
+      last_accesses[info->ops[i].src1] = i;
+    } else if (info->ops[i].opcode == Instruction::APUT) {
+      last_accesses[info->ops[i].src2] = i;
+    }
+  }
+  OpRegRegRegShift(kOpAdd, r_index, r_index, r_count, EncodeShift(kArmLsl, 2));
+  // The vector registers are fp temps, all free after the flush of GenVectorLoop.
+  LIR* loop_head = NewLIR0(kPseudoTargetLabel);
+  for (int i = 0; i < info->num_ops; i++) {
+    const VectorLoopOp& op = info->ops[i];
+    LIR* insn;
+    switch (op.opcode) {
+      case Instruction::AGET:
+        insn = NewLIR2((last_accesses[op.src1] == i) ? kThumb2Vld1Q32Wb : kThumb2Vld1Q32,
+                       QuadReg(op.dest), r_arrays[op.src1]);
+        break;
+      case Instruction::APUT:
+        // The store is the last access of an iteration.
+        insn = NewLIR2(kThumb2Vst1Q32Wb, QuadReg(op.src1), r_arrays[op.src2]);
+        break;
+      default: {
+        ArmOpcode opcode = kThumbBkpt;
+        switch (op.opcode) {
+          case Instruction::ADD_INT: opcode = kThumb2VaddQI32; break;
+          case Instruction::SUB_INT: opcode = kThumb2VsubQI32; break;
+          case Instruction::MUL_INT: opcode = kThumb2VmulQI32; break;
+          case Instruction::AND_INT: opcode = kThumb2VandQ; break;
+          case Instruction::OR_INT: opcode = kThumb2VorrQ; break;
+          case Instruction::XOR_INT: opcode = kThumb2VeorQ; break;
+          default:
+            LOG(FATAL) << "Unexpected vector opcode: " << op.opcode;
+        }
+        insn = NewLIR3(opcode, QuadReg(op.dest), QuadReg(op.src1), QuadReg(op.src2));
+        break;
+      }
+    }
+    // TUNING: loosen barrier
+    insn->def_mask = ENCODE_ALL;
+  }
+  OpDecAndBranch(kCondNe, r_count, loop_head);
+}
+
 void ArmMir2Lir::GenFusedLongCmpBranch(BasicBlock* bb, MIR* mir) {
   RegLocation rl_src1 = mir_graph_->GetSrcWide(mir, 0);
   RegLocation rl_src2 = mir_graph_->GetSrcWide(mir, 2);
@@ -388,73 +447,39 @@ void ArmMir2Lir::OpRegCopyWide(int dest_lo, int dest_hi, int src_lo,
   }
 }
 
-// Table of magic divisors
-struct MagicTable {
-  uint32_t magic;
-  uint32_t shift;
-  DividePattern pattern;
-};
-
-static const MagicTable magic_table[] = {
-  {0, 0, DivideNone},        // 0
-  {0, 0, DivideNone},        // 1
-  {0, 0, DivideNone},        // 2
-  {0x55555556, 0, Divide3},  // 3
-  {0, 0, DivideNone},        // 4
-  {0x66666667, 1, Divide5},  // 5
-  {0x2AAAAAAB, 0, Divide3},  // 6
-  {0x92492493, 2, Divide7},  // 7
-  {0, 0, DivideNone},        // 8
-  {0x38E38E39, 1, Divide5},  // 9
-  {0x66666667, 2, Divide5},  // 10
-  {0x2E8BA2E9, 1, Divide5},  // 11
-  {0x2AAAAAAB, 1, Divide5},  // 12
-  {0x4EC4EC4F, 2, Divide5},  // 13
-  {0x92492493, 3, Divide7},  // 14
-  {0x88888889, 3, Divide7},  // 15
-};
-
 // Integer division by constant via reciprocal multiply (Hacker's Delight, 10-4)
-bool ArmMir2Lir::SmallLiteralDivRem(Instruction::Code dalvik_opcode, bool is_div,
+bool ArmMir2Lir::MagicLiteralDivRem(Instruction::Code dalvik_opcode, bool is_div,
                                     RegLocation rl_src, RegLocation rl_dest, int lit) {
-  if ((lit < 0) || (lit >= static_cast<int>(sizeof(magic_table)/sizeof(magic_table[0])))) {
-    return false;
-  }
-  DividePattern pattern = magic_table[lit].pattern;
-  if (pattern == DivideNone) {
-    return false;
-  }
-  // Tuning: add rem patterns
-  if (!is_div) {
-    return false;
-  }
+  int32_t magic;
+  int shift;
+  CalculateMagicAndShift(lit, &magic, &shift);
 
   int r_magic = AllocTemp();
-  LoadConstant(r_magic, magic_table[lit].magic);
+  LoadConstant(r_magic, magic);
   rl_src = LoadValue(rl_src, kCoreReg);
   RegLocation rl_result = EvalLoc(rl_dest, kCoreReg, true);
   int r_hi = AllocTemp();
   int r_lo = AllocTemp();
   NewLIR4(kThumb2Smull, r_lo, r_hi, r_magic, rl_src.low_reg);
-  switch (pattern) {
-    case Divide3:
-      OpRegRegRegShift(kOpSub, rl_result.low_reg, r_hi,
-               rl_src.low_reg, EncodeShift(kArmAsr, 31));
-      break;
-    case Divide5:
-      OpRegRegImm(kOpAsr, r_lo, rl_src.low_reg, 31);
-      OpRegRegRegShift(kOpRsub, rl_result.low_reg, r_lo, r_hi,
-               EncodeShift(kArmAsr, magic_table[lit].shift));
-      break;
-    case Divide7:
-      OpRegReg(kOpAdd, r_hi, rl_src.low_reg);
-      OpRegRegImm(kOpAsr, r_lo, rl_src.low_reg, 31);
-      OpRegRegRegShift(kOpRsub, rl_result.low_reg, r_lo, r_hi,
-               EncodeShift(kArmAsr, magic_table[lit].shift));
-      break;
-    default:
-      LOG(FATAL) << "Unexpected pattern: " << pattern;
+  if (lit > 0 && magic < 0) {
+    OpRegReg(kOpAdd, r_hi, rl_src.low_reg);
+  } else if (lit < 0 && magic > 0) {
+    OpRegReg(kOpSub, r_hi, rl_src.low_reg);
+  }
+  if (shift != 0) {
+    OpRegRegImm(kOpAsr, r_hi, r_hi, shift);
   }
+  // Round towards zero by adding the sign bit of the quotient.
+  int r_quotient = is_div ? rl_result.low_reg : r_lo;
+  OpRegRegRegShift(kOpAdd, r_quotient, r_hi, r_hi, EncodeShift(kArmLsr, 31));
+  if (!is_div) {
+    // rem = src - quotient * lit.
+    LoadConstant(r_magic, lit);
+    NewLIR4(kThumb2Mls, rl_result.low_reg, r_quotient, r_magic, rl_src.low_reg);
+  }
+  FreeTemp(r_magic);
+  FreeTemp(r_hi);
+  FreeTemp(r_lo);
   StoreValue(rl_dest, rl_result);
   return true;
 }
@@ -467,14 +492,31 @@ LIR* ArmMir2Lir::GenRegMemCheck(ConditionCode c_code,
 
 RegLocation ArmMir2Lir::GenDivRemLit(RegLocation rl_dest, int reg1, int lit,
                                      bool is_div) {
-  LOG(FATAL) << "Unexpected use of GenDivRemLit for Arm";
-  return rl_dest;
+  int t_reg = AllocTemp();
+  LoadConstant(t_reg, lit);
+  RegLocation rl_result = GenDivRem(rl_dest, reg1, t_reg, is_div);
+  FreeTemp(t_reg);
+  return rl_result;
 }
 
+/*
+ * Only used when the target has the kHwDiv feature.  The divisor has already been checked for
+ * zero; sdiv gives the Java result for 0x80000000 / -1, so no other check is needed.
+ */
 RegLocation ArmMir2Lir::GenDivRem(RegLocation rl_dest, int reg1, int reg2,
                                   bool is_div) {
-  LOG(FATAL) << "Unexpected use of GenDivRem for Arm";
-  return rl_dest;
+  DCHECK(cu_->instruction_set_features.HasDivideInstruction());
+  RegLocation rl_result = EvalLoc(rl_dest, kCoreReg, true);
+  if (is_div) {
+    NewLIR3(kThumb2SdivRRR, rl_result.low_reg, reg1, reg2);
+  } else {
+    // rem = dividend - quotient * divisor.
+    int t_reg = AllocTemp();
+    NewLIR3(kThumb2SdivRRR, t_reg, reg1, reg2);
+    NewLIR4(kThumb2Mls, rl_result.low_reg, t_reg, reg2, reg1);
+    FreeTemp(t_reg);
+  }
+  return rl_result;
 }
 
 bool ArmMir2Lir::GenInlinedMinMaxInt(CallInfo* info, bool is_min) {
@@ -561,6 +603,64 @@ bool ArmMir2Lir::GenInlinedCas32(CallInfo* info, bool need_write_barrier) {
   return true;
 }
 
+bool ArmMir2Lir::GenInlinedCas64(CallInfo* info) {
+  DCHECK_EQ(cu_->instruction_set, kThumb2);
+  // Unused - RegLocation rl_src_unsafe = info->args[0];
+  RegLocation rl_src_obj = info->args[1];  // Object - known non-null
+  RegLocation rl_src_offset = info->args[2];  // long low
+  rl_src_offset.wide = 0;  // ignore high half in info->args[3]
+  RegLocation rl_src_expected = info->args[4];  // long, high half in info->args[5]
+  RegLocation rl_src_new_value = info->args[6];  // long, high half in info->args[7]
+  RegLocation rl_dest = InlineTarget(info);  // boolean place for result
+
+  // Release store semantics, get the barrier out of the way.
+  GenMemBarrier(kStoreLoad);
+
+  // The address and the old, expected and new values would need seven registers, more than there
+  // are temps, so use all five explicitly: the new value is loaded over the old one once they have
+  // been compared, and the store's status goes in the low word of the expected value.
+  FlushAllRegs();
+  LockCallTemps();
+  LockTemp(r12);
+  int r_ptr = r12;
+  int r_old_low = r0;
+  int r_old_high = r1;
+  int r_expected_low = r2;
+  int r_expected_high = r3;
+  LoadValueDirectFixed(rl_src_obj, r_ptr);
+  LoadValueDirectFixed(rl_src_offset, r_old_low);
+  OpRegReg(kOpAdd, r_ptr, r_old_low);
+
+  // do {
+  //   r_old <- [r_ptr]
+  //   if (r_old != r_expected) goto mismatch
+  //   [r_ptr] <- r_new && r_status := success ? 0 : 1
+  // } while (r_status != 0)
+  LIR* retry = NewLIR0(kPseudoTargetLabel);
+  NewLIR3(kThumb2Ldrexd, r_old_low, r_old_high, r_ptr);
+  LoadValueDirectWideFixed(rl_src_expected, r_expected_low, r_expected_high);
+  OpRegReg(kOpCmp, r_old_low, r_expected_low);
+  OpIT(kCondEq, "");
+  OpRegReg(kOpCmp /* eq */, r_old_high, r_expected_high);
+  LIR* mismatch = OpCondBranch(kCondNe, NULL);
+  LoadValueDirectWideFixed(rl_src_new_value, r_old_low, r_old_high);
+  int r_status = r_expected_low;
+  NewLIR4(kThumb2Strexd, r_status, r_old_low, r_old_high, r_ptr);
+  OpCmpImmBranch(kCondNe, r_status, 0, retry);
+  LoadConstant(r0, 1);
+  LIR* done = OpUnconditionalBranch(NULL);
+
+  // Drop the exclusive monitor ldrexd took.
+  mismatch->target = NewLIR0(kPseudoTargetLabel);
+  NewLIR0(kThumb2Clrex);
+  LoadConstant(r0, 0);
+  done->target = NewLIR0(kPseudoTargetLabel);
+
+  RegLocation rl_result = LocCReturn();
+  StoreValue(rl_dest, rl_result);
+  return true;
+}
+
 LIR* ArmMir2Lir::OpPcRelLoad(int reg, LIR* target) {
   return RawLIR(current_dalvik_offset_, kThumb2LdrPcRel12, reg, 0, 0, 0, 0, target);
 }
@@ -596,6 +696,11 @@ LIR* ArmMir2Lir::OpTestSuspend(LIR* target) {
   return OpCondBranch((target == NULL) ? kCondEq : kCondNe, target);
 }
 
+LIR* ArmMir2Lir::OpSuspendPoll() {
+  LOG(FATAL) << "Unexpected use of OpSuspendPoll for Arm";
+  return NULL;
+}
+
 // Decrement register and branch on condition
 LIR* ArmMir2Lir::OpDecAndBranch(ConditionCode c_code, int reg, LIR* target) {
   // Combine sub & test using sub setflags encoding here
@@ -936,7 +1041,7 @@ void ArmMir2Lir::GenArrayPut(int opt_flags, OpSize size, RegLocation rl_array,
 void ArmMir2Lir::GenArrayObjPut(int opt_flags, RegLocation rl_array,
                              RegLocation rl_index, RegLocation rl_src, int scale) {
   int len_offset = mirror::Array::LengthOffset().Int32Value();
-  int data_offset = mirror::Array::DataOffset(sizeof(mirror::Object*)).Int32Value();
+  int data_offset = mirror::Array::DataOffset(mirror::kHeapReferenceSize).Int32Value();
 
   FlushAllRegs();  // Use explicit registers
   LockCallTemps();
@@ -191,6 +191,77 @@ void ArmMir2Lir::SetupTargetResourceMasks(LIR* lir) {
   if (flags & REG_DEF_LR) {
     lir->def_mask |= ENCODE_ARM_REG_LR;
   }
+
+  /* vcmp only reaches the condition codes through fmstat */
+  if (opcode == kThumb2Vcmps || opcode == kThumb2Vcmpd) {
+    lir->def_mask |= ENCODE_FP_STATUS;
+  } else if (opcode == kThumb2Fmstat) {
+    lir->use_mask |= ENCODE_FP_STATUS;
+  }
+}
+
+/*
+ * Result latencies, in cycles, used by the instruction scheduler.  These
+ * model the in-order Cortex-A cores, where a dependent instruction stalls
+ * until its operands are ready.
+ */
+enum ArmLatencyClass {
+  kArmLatencyAlu,
+  kArmLatencyLoad,
+  kArmLatencyMul,
+  kArmLatencyFp,
+  kArmLatencyFpDivSingle,
+  kArmLatencyFpDivDouble,
+  kArmLatencyClassCount
+};
+
+static const int kArmLatencies[kArmLatencyClassCount] = {
+  1,   // kArmLatencyAlu
+  3,   // kArmLatencyLoad
+  4,   // kArmLatencyMul
+  4,   // kArmLatencyFp
+  15,  // kArmLatencyFpDivSingle
+  29,  // kArmLatencyFpDivDouble
+};
+
+int ArmMir2Lir::GetInstructionLatency(LIR* lir) {
+  ArmLatencyClass latency_class;
+  switch (lir->opcode) {
+    case kThumbMul:
+    case kThumb2MulRRR:
+    case kThumb2Mla:
+    case kThumb2Mls:
+    case kThumb2Umull:
+    case kThumb2Smull:
+      latency_class = kArmLatencyMul;
+      break;
+    case kThumb2Vadds:
+    case kThumb2Vaddd:
+    case kThumb2Vsubs:
+    case kThumb2Vsubd:
+    case kThumb2Vmuls:
+    case kThumb2Vmuld:
+    case kThumb2VcvtIF:
+    case kThumb2VcvtID:
+    case kThumb2VcvtFI:
+    case kThumb2VcvtDI:
+    case kThumb2VcvtFd:
+    case kThumb2VcvtDF:
+      latency_class = kArmLatencyFp;
+      break;
+    case kThumb2Vdivs:
+    case kThumb2Vsqrts:
+      latency_class = kArmLatencyFpDivSingle;
+      break;
+    case kThumb2Vdivd:
+    case kThumb2Vsqrtd:
+      latency_class = kArmLatencyFpDivDouble;
+      break;
+    default:
+      latency_class = (EncodingMap[lir->opcode].flags & IS_LOAD) ? kArmLatencyLoad : kArmLatencyAlu;
+      break;
+  }
+  return kArmLatencies[latency_class];
 }
 
 ArmConditionCode ArmMir2Lir::ArmConditionEncoding(ConditionCode ccode) {
@@ -376,6 +447,9 @@ std::string ArmMir2Lir::BuildInsnString(const char* fmt, LIR* lir, unsigned char
            case 'S':
              sprintf(tbuf, "d%d", (operand & ARM_FP_REG_MASK) >> 1);
              break;
+           case 'q':
+             sprintf(tbuf, "q%d", (operand & ARM_FP_REG_MASK) >> 2);
+             break;
            case 'h':
              sprintf(tbuf, "%04x", operand);
              break;
@@ -489,6 +563,17 @@ bool ArmMir2Lir::IsUnconditionalBranch(LIR* lir) {
   return ((lir->opcode == kThumbBUncond) || (lir->opcode == kThumb2BUncond));
 }
 
+bool ArmMir2Lir::IsMemBarrier(LIR* lir) {
+  return lir->opcode == kThumb2Dmb;
+}
+
+void ArmMir2Lir::MergeMemBarriers(LIR* barrier, LIR* earlier) {
+  // A store-only dmb is only enough if both are.
+  if (earlier->operands[0] != kST) {
+    barrier->operands[0] = kSY;
+  }
+}
+
 ArmMir2Lir::ArmMir2Lir(CompilationUnit* cu, MIRGraph* mir_graph, ArenaAllocator* arena)
     : Mir2Lir(cu, mir_graph, arena) {
   // Sanity check - make sure encoding map lines up.
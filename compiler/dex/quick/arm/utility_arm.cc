@@ -778,6 +778,7 @@ LIR* ArmMir2Lir::LoadBaseDispBody(int rBase, int displacement, int r_dest,
   int encoded_disp = displacement;
   bool is64bit = false;
   bool already_generated = false;
+  bool address_in_reg = false;
   switch (size) {
     case kDouble:
     case kLong:
@@ -794,13 +795,13 @@ LIR* ArmMir2Lir::LoadBaseDispBody(int rBase, int displacement, int r_dest,
         }
         break;
       } else {
-        if (displacement <= 1020) {
+        if ((displacement >= 0) && (displacement <= 1020)) {
           load = NewLIR4(kThumb2LdrdI8, r_dest, r_dest_hi, rBase, displacement >> 2);
         } else {
-          load = LoadBaseDispBody(rBase, displacement, r_dest,
-                                 -1, kWord, s_reg);
-          LoadBaseDispBody(rBase, displacement + 4, r_dest_hi,
-                           -1, kWord, INVALID_SREG);
+          // Form the address in the low half of the destination, ldrd may load over its base.
+          OpRegRegImm(kOpAdd, r_dest, rBase, displacement);
+          load = NewLIR4(kThumb2LdrdI8, r_dest, r_dest_hi, r_dest, 0);
+          address_in_reg = true;
         }
         already_generated = true;
       }
@@ -883,7 +884,14 @@ LIR* ArmMir2Lir::LoadBaseDispBody(int rBase, int displacement, int r_dest,
 
   // TODO: in future may need to differentiate Dalvik accesses w/ spills
   if (rBase == rARM_SP) {
-    AnnotateDalvikRegAccess(load, displacement >> 2, true /* is_load */, is64bit);
+    if (address_in_reg) {
+      // The access goes through a computed address rather than sp + displacement, so don't
+      // let load/store elimination treat it as a known Dalvik register.
+      SetMemRefType(load, true /* is_load */, kDalvikReg);
+      load->def_mask = ENCODE_ALL;
+    } else {
+      AnnotateDalvikRegAccess(load, displacement >> 2, true /* is_load */, is64bit);
+    }
   }
   return load;
 }
@@ -909,16 +917,20 @@ LIR* ArmMir2Lir::StoreBaseDispBody(int rBase, int displacement,
   int encoded_disp = displacement;
   bool is64bit = false;
   bool already_generated = false;
+  bool address_in_reg = false;
   switch (size) {
     case kLong:
     case kDouble:
       is64bit = true;
       if (!ARM_FPREG(r_src)) {
-        if (displacement <= 1020) {
+        if ((displacement >= 0) && (displacement <= 1020)) {
           store = NewLIR4(kThumb2StrdI8, r_src, r_src_hi, rBase, displacement >> 2);
         } else {
-          store = StoreBaseDispBody(rBase, displacement, r_src, -1, kWord);
-          StoreBaseDispBody(rBase, displacement + 4, r_src_hi, -1, kWord);
+          int reg_ptr = AllocTemp();
+          OpRegRegImm(kOpAdd, reg_ptr, rBase, displacement);
+          store = NewLIR4(kThumb2StrdI8, r_src, r_src_hi, reg_ptr, 0);
+          FreeTemp(reg_ptr);
+          address_in_reg = true;
         }
         already_generated = true;
       } else {
@@ -997,7 +1009,14 @@ LIR* ArmMir2Lir::StoreBaseDispBody(int rBase, int displacement,
 
   // TODO: In future, may need to differentiate Dalvik & spill accesses
   if (rBase == rARM_SP) {
-    AnnotateDalvikRegAccess(store, displacement >> 2, false /* is_load */, is64bit);
+    if (address_in_reg) {
+      // The access goes through a computed address rather than sp + displacement, so don't
+      // let load/store elimination treat it as a known Dalvik register.
+      SetMemRefType(store, false /* is_load */, kDalvikReg);
+      store->def_mask = ENCODE_ALL;
+    } else {
+      AnnotateDalvikRegAccess(store, displacement >> 2, false /* is_load */, is64bit);
+    }
   }
   return store;
 }
@@ -147,6 +147,11 @@ void Mir2Lir::DumpLIRInsn(LIR* lir, unsigned char* base_addr) {
       LOG(INFO) << reinterpret_cast<uintptr_t>(base_addr) + offset << " (0x" << std::hex
                 << offset << "): .align4";
       break;
+    case kPseudoLoopHeadAlign:
+      LOG(INFO) << reinterpret_cast<uintptr_t>(base_addr) + offset << " (0x" << std::hex
+                << offset << "): .align" << std::dec << kLoopHeadAlignment << " (+"
+                << lir->operands[0] << ")";
+      break;
     case kPseudoEHBlockLabel:
       LOG(INFO) << "Exception_Handling:";
       break;
@@ -506,6 +511,19 @@ bool Mir2Lir::VerifyCatchEntries() {
 }
 
 
+// Appends (native pc offset, dex pc) pairs as differences from the pair before, see MappingTable.
+static void PushBackDeltas(const std::vector<uint32_t>& pairs,
+                           UnsignedLeb128EncodingVector* encoded_table) {
+  uint32_t native_offset = 0;
+  uint32_t dex_pc = 0;
+  for (size_t i = 0; i < pairs.size(); i += 2) {
+    encoded_table->PushBackSigned(static_cast<int32_t>(pairs[i] - native_offset));
+    encoded_table->PushBackSigned(static_cast<int32_t>(pairs[i + 1] - dex_pc));
+    native_offset = pairs[i];
+    dex_pc = pairs[i + 1];
+  }
+}
+
 void Mir2Lir::CreateMappingTables() {
   for (LIR* tgt_lir = first_lir_insn_; tgt_lir != NULL; tgt_lir = NEXT_LIR(tgt_lir)) {
     if (!tgt_lir->flags.is_nop && (tgt_lir->opcode == kPseudoSafepointPC)) {
@@ -526,8 +544,9 @@ void Mir2Lir::CreateMappingTables() {
   uint32_t pc2dex_entries = pc2dex_mapping_table_.size() / 2;
   encoded_mapping_table_.PushBack(total_entries);
   encoded_mapping_table_.PushBack(pc2dex_entries);
-  encoded_mapping_table_.InsertBack(pc2dex_mapping_table_.begin(), pc2dex_mapping_table_.end());
-  encoded_mapping_table_.InsertBack(dex2pc_mapping_table_.begin(), dex2pc_mapping_table_.end());
+  PushBackDeltas(pc2dex_mapping_table_, &encoded_mapping_table_);
+  PushBackDeltas(dex2pc_mapping_table_, &encoded_mapping_table_);
+  CreateCatchTable();
   if (kIsDebugBuild) {
     // Verify the encoded table holds the expected data.
     MappingTable table(&encoded_mapping_table_.GetData()[0]);
@@ -549,100 +568,161 @@ void Mir2Lir::CreateMappingTables() {
   }
 }
 
-class NativePcToReferenceMapBuilder {
- public:
-  NativePcToReferenceMapBuilder(std::vector<uint8_t>* table,
-                                size_t entries, uint32_t max_native_offset,
-                                size_t references_width) : entries_(entries),
-                                references_width_(references_width), in_use_(entries),
-                                table_(table) {
-    // Compute width in bytes needed to hold max_native_offset.
-    native_offset_width_ = 0;
-    while (max_native_offset != 0) {
-      native_offset_width_++;
-      max_native_offset >>= 8;
+// Appends the catch table, see MappingTable::FindCatchHandlers, so that exception delivery can
+// find the handlers of a call from its native pc alone.
+void Mir2Lir::CreateCatchTable() {
+  const DexFile::CodeItem* code_item = cu_->code_item;
+  UnsignedLeb128EncodingVector catch_sites;
+  UnsignedLeb128EncodingVector handler_lists;
+  // Calls in the same try block share the handler list, keyed by its offset in the dex file.
+  SafeMap<int32_t, uint32_t> handler_list_offsets;
+  uint32_t catch_site_count = 0;
+  for (size_t i = 0; code_item->tries_size_ != 0 && i < pc2dex_mapping_table_.size(); i += 2) {
+    uint32_t native_offset = pc2dex_mapping_table_[i];
+    uint32_t dex_pc = pc2dex_mapping_table_[i + 1];
+    int32_t handler_offset = DexFile::FindCatchHandlerOffset(*code_item, dex_pc);
+    if (handler_offset < 0) {
+      continue;
     }
-    // Resize table and set up header.
-    table->resize((EntryWidth() * entries) + sizeof(uint32_t));
-    CHECK_LT(native_offset_width_, 1U << 3);
-    (*table)[0] = native_offset_width_ & 7;
-    CHECK_LT(references_width_, 1U << 13);
-    (*table)[0] |= (references_width_ << 3) & 0xFF;
-    (*table)[1] = (references_width_ >> 5) & 0xFF;
-    CHECK_LT(entries, 1U << 16);
-    (*table)[2] = entries & 0xFF;
-    (*table)[3] = (entries >> 8) & 0xFF;
-  }
-
-  void AddEntry(uint32_t native_offset, const uint8_t* references) {
-    size_t table_index = TableIndex(native_offset);
-    while (in_use_[table_index]) {
-      table_index = (table_index + 1) % entries_;
+    uint32_t handler_list_offset;
+    SafeMap<int32_t, uint32_t>::const_iterator it = handler_list_offsets.find(handler_offset);
+    if (it != handler_list_offsets.end()) {
+      handler_list_offset = it->second;
+    } else {
+      handler_list_offset = handler_lists.GetData().size();
+      handler_list_offsets.Put(handler_offset, handler_list_offset);
+      std::vector<uint32_t> handlers;
+      for (CatchHandlerIterator handler(*code_item, dex_pc); handler.HasNext(); handler.Next()) {
+        uint16_t type_idx = handler.GetHandlerTypeIndex();
+        uint32_t handler_dex_pc = handler.GetHandlerAddress();
+        size_t j = 0;
+        while (j < dex2pc_mapping_table_.size() && dex2pc_mapping_table_[j + 1] != handler_dex_pc) {
+          j += 2;
+        }
+        CHECK_LT(j, dex2pc_mapping_table_.size())
+            << "Missing native PC for catch entry @ 0x" << std::hex << handler_dex_pc;
+        uint32_t handler_native_offset = dex2pc_mapping_table_[j];
+        const Instruction* first_catch_insn =
+            Instruction::At(code_item->insns_ + handler_dex_pc);
+        bool has_no_move_exception = first_catch_insn->Opcode() != Instruction::MOVE_EXCEPTION;
+        handlers.push_back(type_idx == DexFile::kDexNoIndex16 ? 0 : type_idx + 1);
+        handlers.push_back(handler_dex_pc);
+        handlers.push_back((handler_native_offset << 1) | (has_no_move_exception ? 1 : 0));
+      }
+      handler_lists.PushBack(handlers.size() / 3);
+      handler_lists.InsertBack(handlers.begin(), handlers.end());
     }
-    in_use_[table_index] = true;
-    SetNativeOffset(table_index, native_offset);
-    DCHECK_EQ(native_offset, GetNativeOffset(table_index));
-    SetReferences(table_index, references);
+    catch_sites.PushBack(native_offset);
+    catch_sites.PushBack(handler_list_offset);
+    catch_site_count++;
   }
+  encoded_mapping_table_.PushBack(catch_site_count);
+  encoded_mapping_table_.PushBack(catch_sites.GetData().size());
+  encoded_mapping_table_.InsertBack(catch_sites);
+  encoded_mapping_table_.InsertBack(handler_lists);
+}
 
- private:
-  size_t TableIndex(uint32_t native_offset) {
-    return NativePcOffsetToReferenceMap::Hash(native_offset) % entries_;
+// Builds a NativePcOffsetToReferenceMap from the references at each native pc offset.
+class NativePcToReferenceMapBuilder {
+ public:
+  NativePcToReferenceMapBuilder(std::vector<uint8_t>* table, size_t references_width)
+      : references_width_(references_width), table_(table) {
+    CHECK_LT(references_width_, 1U << 16);
   }
 
-  uint32_t GetNativeOffset(size_t table_index) {
-    uint32_t native_offset = 0;
-    size_t table_offset = (table_index * EntryWidth()) + sizeof(uint32_t);
-    for (size_t i = 0; i < native_offset_width_; i++) {
-      native_offset |= (*table_)[table_offset + i] << (i * 8);
+  void AddEntry(uint32_t native_offset, const uint8_t* references) {
+    std::vector<uint8_t> bitmap(references, references + references_width_);
+    SafeMap<std::vector<uint8_t>, size_t>::const_iterator it = bitmap_indexes_.find(bitmap);
+    size_t bitmap_index;
+    if (it != bitmap_indexes_.end()) {
+      bitmap_index = it->second;
+    } else {
+      bitmap_index = bitmaps_.size();
+      bitmap_indexes_.Put(bitmap, bitmap_index);
+      bitmaps_.push_back(bitmap);
     }
-    return native_offset;
+    entries_.push_back(std::make_pair(native_offset, bitmap_index));
   }
 
-  void SetNativeOffset(size_t table_index, uint32_t native_offset) {
-    size_t table_offset = (table_index * EntryWidth()) + sizeof(uint32_t);
-    for (size_t i = 0; i < native_offset_width_; i++) {
-      (*table_)[table_offset + i] = (native_offset >> (i * 8)) & 0xFF;
+  void Build() {
+    typedef NativePcOffsetToReferenceMap Map;
+    // Sort by native offset, keeping the order of entries for the same offset.
+    std::stable_sort(entries_.begin(), entries_.end(), CompareNativeOffsets);
+    uint32_t max_native_offset = entries_.empty() ? 0 : entries_.back().first;
+    uint32_t max_delta = 0;
+    for (size_t i = 1; i < entries_.size(); ++i) {
+      max_delta = std::max(max_delta, entries_[i].first - entries_[i - 1].first);
+    }
+    const size_t offset_bits = Map::BitsNeeded(max_native_offset);
+    const size_t delta_bits = Map::BitsNeeded(max_delta);
+    const size_t index_bits = Map::BitsNeeded(bitmaps_.empty() ? 0 : bitmaps_.size() - 1);
+    const size_t num_samples = (entries_.size() + Map::kSampleInterval - 1) / Map::kSampleInterval;
+    const size_t stream_bits =
+        num_samples * offset_bits + entries_.size() * (delta_bits + index_bits);
+    CHECK_LT(entries_.size(), 1U << 16);
+    CHECK_LT(bitmaps_.size(), 1U << 16);
+    table_->assign(Map::kHeaderSize + (stream_bits + 7) / 8 +
+                   bitmaps_.size() * references_width_, 0);
+    (*table_)[0] = references_width_ & 0xFF;
+    (*table_)[1] = (references_width_ >> 8) & 0xFF;
+    (*table_)[2] = entries_.size() & 0xFF;
+    (*table_)[3] = (entries_.size() >> 8) & 0xFF;
+    (*table_)[4] = bitmaps_.size() & 0xFF;
+    (*table_)[5] = (bitmaps_.size() >> 8) & 0xFF;
+    (*table_)[6] = offset_bits;
+    (*table_)[7] = delta_bits;
+    (*table_)[8] = index_bits;
+    size_t bit_offset = 0;
+    for (size_t i = 0; i < entries_.size(); i += Map::kSampleInterval) {
+      WriteBits(&bit_offset, entries_[i].first, offset_bits);
+    }
+    for (size_t i = 0; i < entries_.size(); ++i) {
+      // Sampled entries don't need their difference, but keep every entry the same width.
+      uint32_t delta =
+          (i % Map::kSampleInterval == 0) ? 0 : entries_[i].first - entries_[i - 1].first;
+      WriteBits(&bit_offset, delta, delta_bits);
+      WriteBits(&bit_offset, entries_[i].second, index_bits);
+    }
+    DCHECK_EQ(bit_offset, stream_bits);
+    uint8_t* bitmaps = &(*table_)[Map::kHeaderSize + (stream_bits + 7) / 8];
+    for (size_t i = 0; i < bitmaps_.size(); ++i) {
+      memcpy(bitmaps + i * references_width_, &bitmaps_[i][0], references_width_);
     }
   }
 
-  void SetReferences(size_t table_index, const uint8_t* references) {
-    size_t table_offset = (table_index * EntryWidth()) + sizeof(uint32_t);
-    memcpy(&(*table_)[table_offset + native_offset_width_], references, references_width_);
+ private:
+  static bool CompareNativeOffsets(const std::pair<uint32_t, size_t>& lhs,
+                                   const std::pair<uint32_t, size_t>& rhs) {
+    return lhs.first < rhs.first;
   }
 
-  size_t EntryWidth() const {
-    return native_offset_width_ + references_width_;
+  void WriteBits(size_t* bit_offset, uint32_t value, size_t bits) {
+    uint8_t* stream = &(*table_)[NativePcOffsetToReferenceMap::kHeaderSize];
+    for (size_t i = 0; i < bits; ++i, ++*bit_offset) {
+      if ((value & (1u << i)) != 0) {
+        stream[*bit_offset / 8] |= 1 << (*bit_offset % 8);
+      }
+    }
   }
 
-  // Number of entries in the table.
-  const size_t entries_;
   // Number of bytes used to encode the reference bitmap.
   const size_t references_width_;
-  // Number of bytes used to encode a native offset.
-  size_t native_offset_width_;
-  // Entries that are in use.
-  std::vector<bool> in_use_;
+  // The native offset and bitmap index of each entry.
+  std::vector<std::pair<uint32_t, size_t> > entries_;
+  // The distinct bitmaps, in the order they were first seen, and their indexes.
+  std::vector<std::vector<uint8_t> > bitmaps_;
+  SafeMap<std::vector<uint8_t>, size_t> bitmap_indexes_;
   // The table we're building.
   std::vector<uint8_t>* const table_;
 };
 
 void Mir2Lir::CreateNativeGcMap() {
   const std::vector<uint32_t>& mapping_table = pc2dex_mapping_table_;
-  uint32_t max_native_offset = 0;
-  for (size_t i = 0; i < mapping_table.size(); i += 2) {
-    uint32_t native_offset = mapping_table[i + 0];
-    if (native_offset > max_native_offset) {
-      max_native_offset = native_offset;
-    }
-  }
   MethodReference method_ref(cu_->dex_file, cu_->method_idx);
   const std::vector<uint8_t>* gc_map_raw = verifier::MethodVerifier::GetDexGcMap(method_ref);
   verifier::DexPcToReferenceMap dex_gc_map(&(*gc_map_raw)[4], gc_map_raw->size() - 4);
   // Compute native offset to references size.
-  NativePcToReferenceMapBuilder native_gc_map_builder(&native_gc_map_,
-                                                      mapping_table.size() / 2, max_native_offset,
-                                                      dex_gc_map.RegWidth());
+  NativePcToReferenceMapBuilder native_gc_map_builder(&native_gc_map_, dex_gc_map.RegWidth());
 
   for (size_t i = 0; i < mapping_table.size(); i += 2) {
     uint32_t native_offset = mapping_table[i + 0];
@@ -651,6 +731,16 @@ void Mir2Lir::CreateNativeGcMap() {
     CHECK(references != NULL) << "Missing ref for dex pc 0x" << std::hex << dex_pc;
     native_gc_map_builder.AddEntry(native_offset, references);
   }
+  native_gc_map_builder.Build();
+  if (kIsDebugBuild) {
+    // Verify the encoded map finds the references of every native offset.
+    NativePcOffsetToReferenceMap map(&native_gc_map_[0]);
+    CHECK_EQ(map.NumEntries(), mapping_table.size() / 2);
+    for (size_t i = 0; i < mapping_table.size(); i += 2) {
+      CHECK(map.HasEntry(mapping_table[i])) << "Missing native offset 0x" << std::hex
+                                            << mapping_table[i];
+    }
+  }
 }
 
 /* Determine the offset of each literal field */
@@ -709,6 +799,14 @@ int Mir2Lir::AssignInsnOffsets() {
       } else {
         lir->operands[0] = 0;
       }
+    } else if (lir->opcode == kPseudoLoopHeadAlign) {
+      // Pad only when the loop head would otherwise start late in its fetch block.
+      int padding = RoundUp(offset, kLoopHeadAlignment) - offset;
+      if (padding > kMaxLoopHeadPadding) {
+        padding = 0;
+      }
+      offset += padding;
+      lir->operands[0] = padding;
     }
     /* Pseudo opcodes don't consume space */
   }
@@ -745,10 +843,12 @@ void Mir2Lir::AssignOffsets() {
  */
 void Mir2Lir::AssembleLIR() {
   AssignOffsets();
+  int relaxation_passes = RelaxInstructions();
   int assembler_retries = 0;
   /*
    * Assemble here.  Note that we generate code with optimistic assumptions
    * and if found now to work, we'll have to redo the sequence and retry.
+   * Targets that relax their instructions first should rarely need to.
    */
 
   while (true) {
@@ -766,6 +866,7 @@ void Mir2Lir::AssembleLIR() {
       code_buffer_.clear();
     }
   }
+  cu_->compiler_driver->RecordAssembly(assembler_retries != 0, relaxation_passes);
 
   // Install literals
   InstallLiteralPools();
@@ -952,6 +1053,7 @@ Mir2Lir::Mir2Lir(CompilationUnit* cu, MIRGraph* mir_graph, ArenaAllocator* arena
       data_offset_(0),
       total_size_(0),
       block_label_list_(NULL),
+      frameless_block_(NULL),
       current_dalvik_offset_(0),
       reg_pool_(NULL),
       live_sreg_(0),
@@ -1031,6 +1133,7 @@ CompiledMethod* Mir2Lir::GetCompiledMethod() {
       new CompiledMethod(*cu_->compiler_driver, cu_->instruction_set, code_buffer_, frame_size_,
                          core_spill_mask_, fp_spill_mask_, encoded_mapping_table_.GetData(),
                          vmap_encoder.GetData(), native_gc_map_);
+  result->SetOsrDexPcs(osr_dex_pcs_);
   return result;
 }
 
@@ -73,6 +73,65 @@ LIR* Mir2Lir::GenNullCheck(int s_reg, int m_reg, int opt_flags) {
   return GenImmedCheck(kCondEq, m_reg, 0, kThrowNullPointer);
 }
 
+/*
+ * Whether a load or store at offset from an object register that may be null can serve as the
+ * null check of the object.  The runtime leaves the first page unmapped and turns the faults of
+ * such accesses into NullPointerExceptions, see FaultManager.  Its handler only decodes Thumb2.
+ */
+bool Mir2Lir::UseImplicitNullCheck(int opt_flags, int offset) {
+  if (cu_->instruction_set != kThumb2 || (cu_->disable_opt & (1 << kImplicitNullChecks))) {
+    return false;
+  }
+  if (!(cu_->disable_opt & (1 << kNullCheckElimination)) &&
+    opt_flags & MIR_IGNORE_NULL_CHECK) {
+    return false;
+  }
+  return offset >= 0 && static_cast<size_t>(offset) < kPageSize;
+}
+
+/*
+ * Record a safepoint after a memory access that stands in for a null check.  The fault handler
+ * throws from there as if the method had called the NullPointerException entrypoint, so the
+ * exception gets the dex pc and live references of the access.  The safepoint also keeps the
+ * local optimizations from moving anything between the access and its pc.
+ */
+void Mir2Lir::MarkImplicitNullCheck(LIR* access) {
+  MarkSafepointPC(access);
+}
+
+/*
+ * Whether the entry sequence can check for stack overflow with a load below the stack pointer
+ * instead of a compare with the stack end.  A frame smaller than the protected region at the
+ * bottom of the stack can't step over it, so the probe faults there first, and the runtime turns
+ * the fault into a StackOverflowError, see FaultManager.
+ */
+bool Mir2Lir::UseImplicitStackOverflowCheck() {
+  if (cu_->disable_opt & (1 << kImplicitStackOverflowChecks)) {
+    return false;
+  }
+  return static_cast<size_t>(frame_size_) < Thread::kStackOverflowProtectedBytes;
+}
+
+/*
+ * Keep the local optimizations from dropping the probe, whose result is unused, or moving it
+ * past the stores that build the frame.  Unlike an implicit null check it isn't a safepoint: the
+ * handler throws from the caller, as the explicit check's launchpad does.
+ */
+void Mir2Lir::MarkImplicitStackOverflowCheck(LIR* probe) {
+  probe->def_mask = ENCODE_ALL;
+}
+
+/*
+ * Whether a suspend check can be a load from the thread's suspend poll page rather than a test
+ * of the thread flags.  The load faults while a request is pending, and the runtime turns the
+ * fault into a call of the suspend check entrypoint from the safepoint after the load, see
+ * FaultManager.  Only x86 tests the flags in memory, Arm and Mips count down a register, which is
+ * cheaper than a load.
+ */
+bool Mir2Lir::UseImplicitSuspendCheck() {
+  return cu_->instruction_set == kX86 && !(cu_->disable_opt & (1 << kImplicitSuspendChecks));
+}
+
 /* Perform check on two registers */
 LIR* Mir2Lir::GenRegRegCheck(ConditionCode c_code, int reg1, int reg2,
                              ThrowKind kind) {
@@ -331,15 +390,32 @@ void Mir2Lir::GenFilledNewArray(CallInfo* info) {
   }
 }
 
+int Mir2Lir::LoadInitializedStaticStorage(int ssb_index) {
+  // The class was initialized when the method was compiled and its slot already filled in, so
+  // the slot can be loaded without a check or a call to the runtime.
+  DCHECK_GE(ssb_index, 0);
+  RegLocation rl_method = LoadCurrMethod();
+  int r_base = AllocTemp();
+  LoadWordDisp(rl_method.low_reg,
+               mirror::ArtMethod::DexCacheInitializedStaticStorageOffset().Int32Value(), r_base);
+  LoadWordDisp(r_base, mirror::Array::DataOffset(mirror::kHeapReferenceSize).Int32Value() +
+               sizeof(int32_t*) * ssb_index, r_base);
+  if (IsTemp(rl_method.low_reg)) {
+    FreeTemp(rl_method.low_reg);
+  }
+  return r_base;
+}
+
 void Mir2Lir::GenSput(uint32_t field_idx, RegLocation rl_src, bool is_long_or_double,
                       bool is_object) {
   int field_offset;
   int ssb_index;
   bool is_volatile;
   bool is_referrers_class;
+  bool is_initialized;
   bool fast_path = cu_->compiler_driver->ComputeStaticFieldInfo(
       field_idx, mir_graph_->GetCurrentDexCompilationUnit(), field_offset, ssb_index,
-      is_referrers_class, is_volatile, true);
+      is_referrers_class, is_initialized, is_volatile, true);
   if (fast_path && !SLOW_FIELD_PATH) {
     DCHECK_GE(field_offset, 0);
     int rBase;
@@ -352,10 +428,11 @@ void Mir2Lir::GenSput(uint32_t field_idx, RegLocation rl_src, bool is_long_or_do
       if (IsTemp(rl_method.low_reg)) {
         FreeTemp(rl_method.low_reg);
       }
+    } else if (is_initialized) {
+      rBase = LoadInitializedStaticStorage(ssb_index);
     } else {
       // Medium path, static storage base in a different class which requires checks that the other
       // class is initialized.
-      // TODO: remove initialized check now that we are initializing classes in the compiler driver.
       DCHECK_GE(ssb_index, 0);
       // May do runtime call so everything to home locations.
       FlushAllRegs();
@@ -369,7 +446,7 @@ void Mir2Lir::GenSput(uint32_t field_idx, RegLocation rl_src, bool is_long_or_do
                    mirror::ArtMethod::DexCacheInitializedStaticStorageOffset().Int32Value(),
                    rBase);
       LoadWordDisp(rBase,
-                   mirror::Array::DataOffset(sizeof(mirror::Object*)).Int32Value() +
+                   mirror::Array::DataOffset(mirror::kHeapReferenceSize).Int32Value() +
                    sizeof(int32_t*) * ssb_index, rBase);
       // rBase now points at appropriate static storage base (Class*)
       // or NULL if not initialized. Check for NULL and call helper if NULL.
@@ -423,9 +500,10 @@ void Mir2Lir::GenSget(uint32_t field_idx, RegLocation rl_dest,
   int ssb_index;
   bool is_volatile;
   bool is_referrers_class;
+  bool is_initialized;
   bool fast_path = cu_->compiler_driver->ComputeStaticFieldInfo(
       field_idx, mir_graph_->GetCurrentDexCompilationUnit(), field_offset, ssb_index,
-      is_referrers_class, is_volatile, false);
+      is_referrers_class, is_initialized, is_volatile, false);
   if (fast_path && !SLOW_FIELD_PATH) {
     DCHECK_GE(field_offset, 0);
     int rBase;
@@ -435,10 +513,11 @@ void Mir2Lir::GenSget(uint32_t field_idx, RegLocation rl_dest,
       rBase = AllocTemp();
       LoadWordDisp(rl_method.low_reg,
                    mirror::ArtMethod::DeclaringClassOffset().Int32Value(), rBase);
+    } else if (is_initialized) {
+      rBase = LoadInitializedStaticStorage(ssb_index);
     } else {
       // Medium path, static storage base in a different class which requires checks that the other
       // class is initialized
-      // TODO: remove initialized check now that we are initializing classes in the compiler driver.
       DCHECK_GE(ssb_index, 0);
       // May do runtime call so everything to home locations.
       FlushAllRegs();
@@ -451,7 +530,7 @@ void Mir2Lir::GenSget(uint32_t field_idx, RegLocation rl_dest,
       LoadWordDisp(r_method,
                    mirror::ArtMethod::DexCacheInitializedStaticStorageOffset().Int32Value(),
                    rBase);
-      LoadWordDisp(rBase, mirror::Array::DataOffset(sizeof(mirror::Object*)).Int32Value() +
+      LoadWordDisp(rBase, mirror::Array::DataOffset(mirror::kHeapReferenceSize).Int32Value() +
                    sizeof(int32_t*) * ssb_index, rBase);
       // rBase now points at appropriate static storage base (Class*)
       // or NULL if not initialized. Check for NULL and call helper if NULL.
@@ -622,9 +701,8 @@ void Mir2Lir::HandleThrowLaunchPads() {
           LoadWordDisp(rARM_SELF, func_offset.Int32Value(), r_tgt);
         } else {
           DCHECK(target_mips);
-          DCHECK_EQ(num_fp_spills_, 0);  // FP spills currently don't happen on mips.
-          // LR is offset 0 since we push in reverse order.
-          LoadWordDisp(TargetReg(kSp), 0, TargetReg(kLr));
+          // LR is the core spill nearest the fp spills since we push in reverse order.
+          LoadWordDisp(TargetReg(kSp), num_fp_spills_ * 4, TargetReg(kLr));
           OpRegImm(kOpAdd, TargetReg(kSp), spill_size);
           ClobberCalleeSave();
           r_tgt = CallHelperSetup(func_offset);  // Doesn't clobber LR.
@@ -679,9 +757,15 @@ void Mir2Lir::GenIGet(uint32_t field_idx, int opt_flags, OpSize size,
       StoreValueWide(rl_dest, rl_result);
     } else {
       rl_result = EvalLoc(rl_dest, reg_class, true);
-      GenNullCheck(rl_obj.s_reg_low, rl_obj.low_reg, opt_flags);
-      LoadBaseDisp(rl_obj.low_reg, field_offset, rl_result.low_reg,
-                   kWord, rl_obj.s_reg_low);
+      bool implicit_null_check = UseImplicitNullCheck(opt_flags, field_offset);
+      if (!implicit_null_check) {
+        GenNullCheck(rl_obj.s_reg_low, rl_obj.low_reg, opt_flags);
+      }
+      LIR* load = LoadBaseDisp(rl_obj.low_reg, field_offset, rl_result.low_reg,
+                               kWord, rl_obj.s_reg_low);
+      if (implicit_null_check) {
+        MarkImplicitNullCheck(load);
+      }
       if (is_volatile) {
         GenMemBarrier(kLoadLoad);
       }
@@ -731,11 +815,17 @@ void Mir2Lir::GenIPut(uint32_t field_idx, int opt_flags, OpSize size,
       FreeTemp(reg_ptr);
     } else {
       rl_src = LoadValue(rl_src, reg_class);
-      GenNullCheck(rl_obj.s_reg_low, rl_obj.low_reg, opt_flags);
+      bool implicit_null_check = UseImplicitNullCheck(opt_flags, field_offset);
+      if (!implicit_null_check) {
+        GenNullCheck(rl_obj.s_reg_low, rl_obj.low_reg, opt_flags);
+      }
       if (is_volatile) {
         GenMemBarrier(kStoreStore);
       }
-      StoreBaseDisp(rl_obj.low_reg, field_offset, rl_src.low_reg, kWord);
+      LIR* store = StoreBaseDisp(rl_obj.low_reg, field_offset, rl_src.low_reg, kWord);
+      if (implicit_null_check) {
+        MarkImplicitNullCheck(store);
+      }
       if (is_volatile) {
         GenMemBarrier(kLoadLoad);
       }
@@ -942,6 +1032,24 @@ void Mir2Lir::GenInstanceofFinal(bool use_declaring_class, uint32_t type_idx, Re
   StoreValue(rl_dest, rl_result);
 }
 
+LIR* Mir2Lir::GenSuperClassDisplayCheck(int obj_class_reg, int class_reg, int temp_reg) {
+  // The entry of depth d is d references past the depth word, and the classes that have no
+  // entry of their own have a depth of 0 or one too deep to index.
+  DCHECK_EQ(mirror::kHeapReferenceSize, 4U);
+  int depth_offset = mirror::Class::SuperClassDepthOffset().Int32Value();
+  LoadWordDisp(class_reg, depth_offset, temp_reg);
+  LIR* no_entry = OpCmpImmBranch(kCondEq, temp_reg, 0, NULL);
+  LIR* too_deep = OpCmpImmBranch(kCondGt, temp_reg, mirror::Class::kSuperClassDisplayDepth, NULL);
+  OpRegRegImm(kOpLsl, temp_reg, temp_reg, 2);
+  OpRegReg(kOpAdd, temp_reg, obj_class_reg);
+  LoadWordDisp(temp_reg, depth_offset, temp_reg);
+  LIR* hit = OpCmpBranch(kCondEq, temp_reg, class_reg, NULL);
+  LIR* miss = NewLIR0(kPseudoTargetLabel);
+  no_entry->target = miss;
+  too_deep->target = miss;
+  return hit;
+}
+
 void Mir2Lir::GenInstanceofCallingHelper(bool needs_access_check, bool type_known_final,
                                          bool type_known_abstract, bool use_declaring_class,
                                          bool can_assume_type_is_in_dex_cache,
@@ -998,6 +1106,7 @@ void Mir2Lir::GenInstanceofCallingHelper(bool needs_access_check, bool type_know
   LoadWordDisp(TargetReg(kArg0),  mirror::Object::ClassOffset().Int32Value(), TargetReg(kArg1));
   /* kArg0 is ref, kArg1 is ref->klass_, kArg2 is class */
   LIR* branchover = NULL;
+  LIR* display_hit = NULL;
   if (type_known_final) {
     // rl_result == ref == null == 0.
     if (cu_->instruction_set == kThumb2) {
@@ -1011,6 +1120,9 @@ void Mir2Lir::GenInstanceofCallingHelper(bool needs_access_check, bool type_know
       LoadConstant(rl_result.low_reg, 1);     // eq case - load true
     }
   } else {
+    // The ref is no longer needed, kArg0 may be the result.
+    LoadConstant(rl_result.low_reg, 1);
+    display_hit = GenSuperClassDisplayCheck(TargetReg(kArg1), TargetReg(kArg2), TargetReg(kArg3));
     if (cu_->instruction_set == kThumb2) {
       int r_tgt = LoadHelper(QUICK_ENTRYPOINT_OFFSET(pInstanceofNonTrivial));
       if (!type_known_abstract) {
@@ -1048,6 +1160,9 @@ void Mir2Lir::GenInstanceofCallingHelper(bool needs_access_check, bool type_know
   if (branchover != NULL) {
     branchover->target = target;
   }
+  if (display_hit != NULL) {
+    display_hit->target = target;
+  }
 }
 
 void Mir2Lir::GenInstanceof(uint32_t type_idx, RegLocation rl_dest, RegLocation rl_src) {
@@ -1135,6 +1250,7 @@ void Mir2Lir::GenCheckCast(uint32_t insn_idx, uint32_t type_idx, RegLocation rl_
   if (!type_known_abstract) {
     branch2 = OpCmpBranch(kCondEq, TargetReg(kArg1), class_reg, NULL);
   }
+  LIR* display_hit = GenSuperClassDisplayCheck(TargetReg(kArg1), class_reg, TargetReg(kArg3));
   CallRuntimeHelperRegReg(QUICK_ENTRYPOINT_OFFSET(pCheckCast), TargetReg(kArg1),
                           TargetReg(kArg2), true);
   /* branch target here */
@@ -1143,6 +1259,83 @@ void Mir2Lir::GenCheckCast(uint32_t insn_idx, uint32_t type_idx, RegLocation rl_
   if (branch2 != NULL) {
     branch2->target = target;
   }
+  display_hit->target = target;
+}
+
+/*
+ * Sparse switches whose keys are packed closely enough are dispatched through a jump table, with
+ * the gaps going to the fall-through block.  Up to kMaxSearchedSparseSwitchKeys keys are
+ * otherwise found by a binary search in compare-and-branch code.  Larger tables are left to the
+ * target's table scan.
+ */
+static const int kMinPackedSparseSwitchKeys = 4;
+static const int kMaxPackedSparseSwitchSpread = 2;  // Table entries per key.
+static const int kMaxSearchedSparseSwitchKeys = 64;
+static const int kMaxLinearSparseSwitchKeys = 3;  // Keys tested one by one at the search leaves.
+
+void Mir2Lir::LowerSparseSwitch(MIR* mir, BasicBlock* bb, const uint16_t* table,
+                                RegLocation rl_src) {
+  int size = table[1];
+  const int32_t* keys = reinterpret_cast<const int32_t*>(&table[2]);
+  const int32_t* targets = &keys[size];
+  int64_t spread = static_cast<int64_t>(keys[size - 1]) - keys[0] + 1;
+  if (size >= kMinPackedSparseSwitchKeys && spread <= size * kMaxPackedSparseSwitchSpread &&
+      spread <= 0xffff) {
+    int default_target = bb->fall_through->start_offset - current_dalvik_offset_;
+    GenPackedSwitch(mir, MakePackedSwitchTable(table, default_target), rl_src);
+  } else if (size <= kMaxSearchedSparseSwitchKeys) {
+    if (cu_->verbose) {
+      DumpSparseSwitchTable(table);
+    }
+    rl_src = LoadValue(rl_src, kCoreReg);
+    GenSparseSwitchSearch(rl_src.low_reg, keys, targets, 0, size,
+                          &block_label_list_[bb->fall_through->id]);
+  } else {
+    GenSparseSwitch(mir, table, rl_src);
+  }
+}
+
+const uint16_t* Mir2Lir::MakePackedSwitchTable(const uint16_t* sparse_table, int default_target) {
+  int size = sparse_table[1];
+  const int32_t* keys = reinterpret_cast<const int32_t*>(&sparse_table[2]);
+  const int32_t* targets = &keys[size];
+  int low_key = keys[0];
+  int entries = keys[size - 1] - low_key + 1;
+  DCHECK_LE(entries, 0xffff);
+  // The arena hands out 32-bit aligned memory, as the targets need.
+  uint16_t* table = static_cast<uint16_t*>(arena_->Alloc((4 + entries * 2) * sizeof(uint16_t),
+                                                         ArenaAllocator::kAllocData));
+  table[0] = Instruction::kPackedSwitchSignature;
+  table[1] = entries;
+  table[2] = low_key & 0xffff;
+  table[3] = (low_key >> 16) & 0xffff;
+  int32_t* packed_targets = reinterpret_cast<int32_t*>(&table[4]);
+  for (int i = 0; i < entries; i++) {
+    packed_targets[i] = default_target;
+  }
+  for (int i = 0; i < size; i++) {
+    packed_targets[keys[i] - low_key] = targets[i];
+  }
+  return table;
+}
+
+void Mir2Lir::GenSparseSwitchSearch(int reg, const int32_t* keys, const int32_t* targets,
+                                    int low, int high, LIR* default_label) {
+  if (high - low <= kMaxLinearSparseSwitchKeys) {
+    for (int i = low; i < high; i++) {
+      BasicBlock* case_block = mir_graph_->FindBlock(current_dalvik_offset_ + targets[i]);
+      OpCmpImmBranch(kCondEq, reg, keys[i], &block_label_list_[case_block->id]);
+    }
+    OpUnconditionalBranch(default_label);
+    return;
+  }
+  // The keys are sorted, search the upper half inline and branch to the lower one.
+  int middle = low + (high - low) / 2;
+  LIR* branch_lower = OpCmpImmBranch(kCondLt, reg, keys[middle], NULL);
+  GenSparseSwitchSearch(reg, keys, targets, middle, high, default_label);
+  LIR* lower = NewLIR0(kPseudoTargetLabel);
+  branch_lower->target = lower;
+  GenSparseSwitchSearch(reg, keys, targets, low, middle, default_label);
 }
 
 void Mir2Lir::GenLong3Addr(OpKind first_op, OpKind second_op, RegLocation rl_dest,
@@ -1321,7 +1514,7 @@ void Mir2Lir::GenArithOpInt(Instruction::Code opcode, RegLocation rl_dest,
     }
     StoreValue(rl_dest, rl_result);
   } else {
-    if (cu_->instruction_set == kMips) {
+    if (HasInlineIntDivide()) {
       rl_src1 = LoadValue(rl_src1, kCoreReg);
       rl_src2 = LoadValue(rl_src2, kCoreReg);
       if (check_zero) {
@@ -1378,22 +1571,24 @@ static int LowestSetBit(unsigned int x) {
   return bit_posn;
 }
 
+// Can int div and rem be done with GenDivRem rather than by calling pIdivmod?
+bool Mir2Lir::HasInlineIntDivide() const {
+  return (cu_->instruction_set == kMips) ||
+      (cu_->instruction_set == kThumb2 && cu_->instruction_set_features.HasDivideInstruction());
+}
+
 // Returns true if it added instructions to 'cu' to divide 'rl_src' by 'lit'
 // and store the result in 'rl_dest'.
 bool Mir2Lir::HandleEasyDivRem(Instruction::Code dalvik_opcode, bool is_div,
                                RegLocation rl_src, RegLocation rl_dest, int lit) {
-  if ((lit < 2) || ((cu_->instruction_set != kThumb2) && !IsPowerOfTwo(lit))) {
+  if ((lit >= -1) && (lit <= 1)) {
     return false;
   }
-  // No divide instruction for Arm, so check for more special cases
-  if ((cu_->instruction_set == kThumb2) && !IsPowerOfTwo(lit)) {
-    return SmallLiteralDivRem(dalvik_opcode, is_div, rl_src, rl_dest, lit);
+  // Shift by powers of two, avoiding the special cases of the largest ones.
+  if ((lit < 0) || !IsPowerOfTwo(lit) || (LowestSetBit(lit) >= 30)) {
+    return MagicLiteralDivRem(dalvik_opcode, is_div, rl_src, rl_dest, lit);
   }
   int k = LowestSetBit(lit);
-  if (k >= 30) {
-    // Avoid special cases.
-    return false;
-  }
   rl_src = LoadValue(rl_src, kCoreReg);
   RegLocation rl_result = EvalLoc(rl_dest, kCoreReg, true);
   if (is_div) {
@@ -1575,7 +1770,7 @@ void Mir2Lir::GenArithOpIntLit(Instruction::Code opcode, RegLocation rl_dest, Re
       if (HandleEasyDivRem(opcode, is_div, rl_src, rl_dest, lit)) {
         return;
       }
-      if (cu_->instruction_set == kMips) {
+      if (HasInlineIntDivide()) {
         rl_src = LoadValue(rl_src, kCoreReg);
         rl_result = GenDivRemLit(rl_dest, rl_src.low_reg, lit, is_div);
       } else {
@@ -1653,7 +1848,7 @@ void Mir2Lir::GenArithOpLong(Instruction::Code opcode, RegLocation rl_dest,
       break;
     case Instruction::MUL_LONG:
     case Instruction::MUL_LONG_2ADDR:
-      if (cu_->instruction_set == kThumb2) {
+      if (cu_->instruction_set != kMips) {
         GenMulLong(rl_dest, rl_src1, rl_src2);
         return;
       } else {
@@ -1764,6 +1959,10 @@ void Mir2Lir::GenSuspendTest(int opt_flags) {
     return;
   }
   FlushAllRegs();
+  if (UseImplicitSuspendCheck()) {
+    MarkSafepointPC(OpSuspendPoll());
+    return;
+  }
   LIR* branch = OpTestSuspend(NULL);
   LIR* ret_lab = NewLIR0(kPseudoTargetLabel);
   LIR* target = RawLIR(current_dalvik_offset_, kPseudoSuspendTarget,
@@ -1778,6 +1977,12 @@ void Mir2Lir::GenSuspendTestAndBranch(int opt_flags, LIR* target) {
     OpUnconditionalBranch(target);
     return;
   }
+  if (UseImplicitSuspendCheck()) {
+    FlushAllRegs();
+    MarkSafepointPC(OpSuspendPoll());
+    OpUnconditionalBranch(target);
+    return;
+  }
   OpTestSuspend(target);
   LIR* launch_pad =
       RawLIR(current_dalvik_offset_, kPseudoSuspendTarget,
@@ -1787,4 +1992,59 @@ void Mir2Lir::GenSuspendTestAndBranch(int opt_flags, LIR* target) {
   suspend_launchpads_.Insert(launch_pad);
 }
 
+/*
+ * Do the iterations of a loop matched by MIRGraph::VectorizeLoops that index every array in
+ * range, four elements at a time, leaving the rest to the scalar loop.  With a null array or a
+ * negative index the vector loop is skipped and the scalar loop throws as usual.  No suspend
+ * check is done, the iterations are bounded by the array lengths.
+ */
+void Mir2Lir::GenVectorLoop(MIR* mir) {
+  const VectorLoopInfo* info = mir->meta.vector_loop;
+  int length_offset = mirror::Array::LengthOffset().Int32Value();
+  // The skip path relies on the index being in its home.
+  FlushAllRegs();
+  LIR* skip_branches[VectorLoopInfo::kMaxArrays + 3];
+  int num_skip_branches = 0;
+  int r_count = AllocTemp();
+  int r_scratch = AllocTemp();
+  LoadValueDirect(mir_graph_->GetSrc(mir, info->num_arrays + 1), r_count);
+  if (info->bound_is_length) {
+    skip_branches[num_skip_branches++] = OpCmpImmBranch(kCondEq, r_count, 0, NULL);
+    LoadWordDisp(r_count, length_offset, r_count);
+  }
+  // Only go up to the shortest array.
+  int r_arrays[VectorLoopInfo::kMaxArrays];
+  for (int i = 0; i < info->num_arrays; i++) {
+    r_arrays[i] = AllocTemp();
+    LoadValueDirect(mir_graph_->GetSrc(mir, i + 1), r_arrays[i]);
+    skip_branches[num_skip_branches++] = OpCmpImmBranch(kCondEq, r_arrays[i], 0, NULL);
+    LoadWordDisp(r_arrays[i], length_offset, r_scratch);
+    LIR* not_shorter = OpCmpBranch(kCondGe, r_scratch, r_count, NULL);
+    OpRegCopy(r_count, r_scratch);
+    not_shorter->target = NewLIR0(kPseudoTargetLabel);
+  }
+  int r_index = r_scratch;
+  LoadValueDirect(mir_graph_->GetSrc(mir, 0), r_index);
+  skip_branches[num_skip_branches++] = OpCmpImmBranch(kCondLt, r_index, 0, NULL);
+  // Both are non-negative, the difference can't overflow.
+  OpRegReg(kOpSub, r_count, r_index);
+  OpRegImm(kOpAsr, r_count, 2);
+  skip_branches[num_skip_branches++] = OpCmpImmBranch(kCondLe, r_count, 0, NULL);
+  GenVectorLoopBody(info, r_index, r_count, r_arrays);
+  for (int i = 0; i < info->num_arrays; i++) {
+    FreeTemp(r_arrays[i]);
+  }
+  FreeTemp(r_count);
+  RegLocation rl_dest = mir_graph_->GetDest(mir);
+  RegLocation rl_result = EvalLoc(rl_dest, kCoreReg, true);
+  OpRegCopy(rl_result.low_reg, r_index);
+  FreeTemp(r_index);
+  StoreValue(rl_dest, rl_result);
+  FlushAllRegs();
+  LIR* skip_target = NewLIR0(kPseudoTargetLabel);
+  for (int i = 0; i < num_skip_branches; i++) {
+    skip_branches[i]->target = skip_target;
+  }
+}
+
 }  // namespace art
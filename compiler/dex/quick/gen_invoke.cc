@@ -19,6 +19,7 @@
 #include "entrypoints/quick/quick_entrypoints.h"
 #include "invoke_type.h"
 #include "mirror/array.h"
+#include "mirror/class.h"
 #include "mirror/string.h"
 #include "mir_to_lir-inl.h"
 #include "x86/codegen_x86.h"
@@ -310,6 +311,10 @@ void Mir2Lir::FlushIns(RegLocation* ArgLocs, RegLocation rl_method) {
       if (need_flush) {
         StoreBaseDisp(TargetReg(kSp), SRegOffset(start_vreg + i),
                       TargetReg(arg_regs[i]), kWord);
+        // Keep it for the frameless block, which doesn't reload its values from the frame.
+        if (frameless_block_ != NULL && !t_loc->wide && !t_loc->fp) {
+          MarkLive(TargetReg(arg_regs[i]), t_loc->s_reg_low);
+        }
       }
     } else {
       // If arriving in frame & promoted
@@ -375,6 +380,31 @@ static int NextSDCallInsn(CompilationUnit* cu, CallInfo* info,
     default:
       return -1;
     }
+  } else if (direct_method == static_cast<unsigned int>(-1)) {
+    // A call site of code cache code, whose literal the runtime points at the resolved target.
+    DCHECK_EQ(direct_code, 0U);
+    switch (state) {
+    case 0:  // Get the target Method* from the call site's literal [sets kArg0]
+      {
+        CHECK_EQ(cu->dex_file, target_method.dex_file);
+        LIR* data_target = cg->ScanLiteralPool(cg->method_literal_list_,
+                                               target_method.dex_method_index, 0);
+        if (data_target == NULL) {
+          data_target = cg->AddWordData(&cg->method_literal_list_, target_method.dex_method_index);
+          data_target->operands[1] = type;
+        }
+        LIR* load_pc_rel = cg->OpPcRelLoad(cg->TargetReg(kArg0), data_target);
+        cg->AppendLIR(load_pc_rel);
+      }
+      break;
+    case 1:  // Grab the code from the method*
+      cg->LoadWordDisp(cg->TargetReg(kArg0),
+                       mirror::ArtMethod::GetEntryPointFromCompiledCodeOffset().Int32Value(),
+                       cg->TargetReg(kInvokeTgt));
+      break;
+    default:
+      return -1;
+    }
   } else {
     switch (state) {
     case 0:  // Get the current Method* [sets kArg0]
@@ -405,7 +435,7 @@ static int NextSDCallInsn(CompilationUnit* cu, CallInfo* info,
     case 2:  // Grab target method*
       CHECK_EQ(cu->dex_file, target_method.dex_file);
       cg->LoadWordDisp(cg->TargetReg(kArg0),
-                       mirror::Array::DataOffset(sizeof(mirror::Object*)).Int32Value() +
+                       mirror::Array::DataOffset(mirror::kHeapReferenceSize).Int32Value() +
                            (target_method.dex_method_index * 4),
                        cg-> TargetReg(kArg0));
       break;
@@ -460,7 +490,7 @@ static int NextVCallInsn(CompilationUnit* cu, CallInfo* info,
       break;
     case 3:  // Get target method [use kInvokeTgt, set kArg0]
       cg->LoadWordDisp(cg->TargetReg(kInvokeTgt), (method_idx * 4) +
-                       mirror::Array::DataOffset(sizeof(mirror::Object*)).Int32Value(),
+                       mirror::Array::DataOffset(mirror::kHeapReferenceSize).Int32Value(),
                        cg->TargetReg(kArg0));
       break;
     case 4:  // Get the compiled code address [uses kArg0, sets kInvokeTgt]
@@ -538,7 +568,7 @@ static int NextInterfaceCallInsn(CompilationUnit* cu, CallInfo* info, int state,
     case 2:  // Grab target method* [set/use kArg0]
       CHECK_EQ(cu->dex_file, target_method.dex_file);
       cg->LoadWordDisp(cg->TargetReg(kArg0),
-                       mirror::Array::DataOffset(sizeof(mirror::Object*)).Int32Value() +
+                       mirror::Array::DataOffset(mirror::kHeapReferenceSize).Int32Value() +
                            (target_method.dex_method_index * 4),
                        cg->TargetReg(kArg0));
       break;
@@ -859,10 +889,6 @@ RegLocation Mir2Lir::InlineTargetWide(CallInfo* info) {
 }
 
 bool Mir2Lir::GenInlinedCharAt(CallInfo* info) {
-  if (cu_->instruction_set == kMips) {
-    // TODO - add Mips implementation
-    return false;
-  }
   // Location of reference to data array
   int value_offset = mirror::String::ValueOffset().Int32Value();
   // Location of count
@@ -895,9 +921,8 @@ bool Mir2Lir::GenInlinedCharAt(CallInfo* info) {
       // Set up a launch pad to allow retry in case of bounds violation */
       launch_pad = RawLIR(0, kPseudoIntrinsicRetry, reinterpret_cast<uintptr_t>(info));
       intrinsic_launchpads_.Insert(launch_pad);
-      OpRegReg(kOpCmp, rl_idx.low_reg, reg_max);
+      OpCmpBranch(kCondCs, rl_idx.low_reg, reg_max, launch_pad);
       FreeTemp(reg_max);
-      OpCondBranch(kCondCs, launch_pad);
     }
   } else {
     if (range_check) {
@@ -935,10 +960,6 @@ bool Mir2Lir::GenInlinedCharAt(CallInfo* info) {
 
 // Generates an inlined String.is_empty or String.length.
 bool Mir2Lir::GenInlinedStringIsEmptyOrLength(CallInfo* info, bool is_empty) {
-  if (cu_->instruction_set == kMips) {
-    // TODO - add Mips implementation
-    return false;
-  }
   // dst = src.length();
   RegLocation rl_obj = info->args[0];
   rl_obj = LoadValue(rl_obj, kCoreReg);
@@ -953,7 +974,7 @@ bool Mir2Lir::GenInlinedStringIsEmptyOrLength(CallInfo* info, bool is_empty) {
       OpRegReg(kOpNeg, t_reg, rl_result.low_reg);
       OpRegRegReg(kOpAdc, rl_result.low_reg, rl_result.low_reg, t_reg);
     } else {
-      DCHECK_EQ(cu_->instruction_set, kX86);
+      // dst = (dst - 1) >>> 31, counts being non-negative.
       OpRegImm(kOpSub, rl_result.low_reg, 1);
       OpRegImm(kOpLsr, rl_result.low_reg, 31);
     }
@@ -963,10 +984,6 @@ bool Mir2Lir::GenInlinedStringIsEmptyOrLength(CallInfo* info, bool is_empty) {
 }
 
 bool Mir2Lir::GenInlinedAbsInt(CallInfo* info) {
-  if (cu_->instruction_set == kMips) {
-    // TODO - add Mips implementation
-    return false;
-  }
   RegLocation rl_src = info->args[0];
   rl_src = LoadValue(rl_src, kCoreReg);
   RegLocation rl_dest = InlineTarget(info);
@@ -981,10 +998,6 @@ bool Mir2Lir::GenInlinedAbsInt(CallInfo* info) {
 }
 
 bool Mir2Lir::GenInlinedAbsLong(CallInfo* info) {
-  if (cu_->instruction_set == kMips) {
-    // TODO - add Mips implementation
-    return false;
-  }
   if (cu_->instruction_set == kThumb2) {
     RegLocation rl_src = info->args[0];
     rl_src = LoadValueWide(rl_src, kCoreReg);
@@ -999,6 +1012,24 @@ bool Mir2Lir::GenInlinedAbsLong(CallInfo* info) {
     OpRegReg(kOpXor, rl_result.high_reg, sign_reg);
     StoreValueWide(rl_dest, rl_result);
     return true;
+  } else if (cu_->instruction_set == kMips) {
+    // There is no carry bit, so negate a negative value as ~x + 1 with a branch around the
+    // increment of the high word unless the low word was zero.
+    RegLocation rl_src = info->args[0];
+    rl_src = LoadValueWide(rl_src, kCoreReg);
+    RegLocation rl_dest = InlineTargetWide(info);
+    RegLocation rl_result = EvalLoc(rl_dest, kCoreReg, true);
+    OpRegCopyWide(rl_result.low_reg, rl_result.high_reg, rl_src.low_reg, rl_src.high_reg);
+    LIR* branch_positive = OpCmpImmBranch(kCondGe, rl_result.high_reg, 0, NULL);
+    OpRegReg(kOpMvn, rl_result.high_reg, rl_result.high_reg);
+    OpRegReg(kOpNeg, rl_result.low_reg, rl_result.low_reg);
+    LIR* branch_no_carry = OpCmpImmBranch(kCondNe, rl_result.low_reg, 0, NULL);
+    OpRegImm(kOpAdd, rl_result.high_reg, 1);
+    LIR* done = NewLIR0(kPseudoTargetLabel);
+    branch_positive->target = done;
+    branch_no_carry->target = done;
+    StoreValueWide(rl_dest, rl_result);
+    return true;
   } else {
     DCHECK_EQ(cu_->instruction_set, kX86);
     // Reuse source registers to avoid running out of temps
@@ -1022,10 +1053,6 @@ bool Mir2Lir::GenInlinedAbsLong(CallInfo* info) {
 }
 
 bool Mir2Lir::GenInlinedFloatCvt(CallInfo* info) {
-  if (cu_->instruction_set == kMips) {
-    // TODO - add Mips implementation
-    return false;
-  }
   RegLocation rl_src = info->args[0];
   RegLocation rl_dest = InlineTarget(info);
   StoreValue(rl_dest, rl_src);
@@ -1033,10 +1060,6 @@ bool Mir2Lir::GenInlinedFloatCvt(CallInfo* info) {
 }
 
 bool Mir2Lir::GenInlinedDoubleCvt(CallInfo* info) {
-  if (cu_->instruction_set == kMips) {
-    // TODO - add Mips implementation
-    return false;
-  }
   RegLocation rl_src = info->args[0];
   RegLocation rl_dest = InlineTargetWide(info);
   StoreValueWide(rl_dest, rl_src);
@@ -1048,10 +1071,6 @@ bool Mir2Lir::GenInlinedDoubleCvt(CallInfo* info) {
  * otherwise bails to standard library code.
  */
 bool Mir2Lir::GenInlinedIndexOf(CallInfo* info, bool zero_based) {
-  if (cu_->instruction_set == kMips) {
-    // TODO - add Mips implementation
-    return false;
-  }
   ClobberCalleeSave();
   LockCallTemps();  // Using fixed registers
   int reg_ptr = TargetReg(kArg0);
@@ -1091,10 +1110,6 @@ bool Mir2Lir::GenInlinedIndexOf(CallInfo* info, bool zero_based) {
 
 /* Fast string.compareTo(Ljava/lang/string;)I. */
 bool Mir2Lir::GenInlinedStringCompareTo(CallInfo* info) {
-  if (cu_->instruction_set == kMips) {
-    // TODO - add Mips implementation
-    return false;
-  }
   ClobberCalleeSave();
   LockCallTemps();  // Using fixed registers
   int reg_this = TargetReg(kArg0);
@@ -1126,6 +1141,263 @@ bool Mir2Lir::GenInlinedStringCompareTo(CallInfo* info) {
   return true;
 }
 
+/*
+ * Fast string.equals(Ljava/lang/Object;)Z.  Compares the chars a word at a time,
+ * substrings starting at an odd offset are left to the library code.
+ */
+bool Mir2Lir::GenInlinedStringEquals(CallInfo* info) {
+  if (cu_->instruction_set == kX86) {
+    // TODO: x86 runs out of temps.
+    return false;
+  }
+  int value_offset = mirror::String::ValueOffset().Int32Value();
+  int count_offset = mirror::String::CountOffset().Int32Value();
+  int offset_offset = mirror::String::OffsetOffset().Int32Value();
+  int data_offset = mirror::Array::DataOffset(sizeof(uint16_t)).Int32Value();
+  int class_offset = mirror::Object::ClassOffset().Int32Value();
+  ClobberCalleeSave();
+  LockCallTemps();  // Using fixed registers
+  int reg_this = TargetReg(kArg0);
+  int reg_cmp = TargetReg(kArg1);
+  int reg_tmp1 = TargetReg(kArg2);
+  int reg_tmp2 = TargetReg(kArg3);
+  int reg_count = AllocTemp();
+
+  RegLocation rl_this = info->args[0];
+  RegLocation rl_cmp = info->args[1];
+  LoadValueDirectFixed(rl_this, reg_this);
+  LoadValueDirectFixed(rl_cmp, reg_cmp);
+  GenNullCheck(rl_this.s_reg_low, reg_this, info->opt_flags);
+  LIR* launch_pad = RawLIR(0, kPseudoIntrinsicRetry, reinterpret_cast<uintptr_t>(info));
+  intrinsic_launchpads_.Insert(launch_pad);
+  // A string equals itself and, String being final, nothing but another String.
+  LIR* branch_same = OpCmpBranch(kCondEq, reg_this, reg_cmp, NULL);
+  LIR* branch_null = OpCmpImmBranch(kCondEq, reg_cmp, 0, NULL);
+  LoadWordDisp(reg_this, class_offset, reg_tmp1);
+  LoadWordDisp(reg_cmp, class_offset, reg_tmp2);
+  LIR* branch_class = OpCmpBranch(kCondNe, reg_tmp1, reg_tmp2, NULL);
+  LoadWordDisp(reg_this, count_offset, reg_count);
+  LoadWordDisp(reg_cmp, count_offset, reg_tmp2);
+  LIR* branch_count = OpCmpBranch(kCondNe, reg_count, reg_tmp2, NULL);
+  // Turn the strings into pointers to their first char.
+  LoadWordDisp(reg_this, offset_offset, reg_tmp1);
+  LoadWordDisp(reg_cmp, offset_offset, reg_tmp2);
+  LoadWordDisp(reg_this, value_offset, reg_this);
+  LoadWordDisp(reg_cmp, value_offset, reg_cmp);
+  OpRegRegImm(kOpLsl, reg_tmp1, reg_tmp1, 1);
+  OpRegRegImm(kOpLsl, reg_tmp2, reg_tmp2, 1);
+  OpRegReg(kOpAdd, reg_this, reg_tmp1);
+  OpRegReg(kOpAdd, reg_cmp, reg_tmp2);
+  OpRegImm(kOpAdd, reg_this, data_offset);
+  OpRegImm(kOpAdd, reg_cmp, data_offset);
+  OpRegReg(kOpOr, reg_tmp1, reg_tmp2);
+  OpRegImm(kOpAnd, reg_tmp1, 2);
+  OpCmpImmBranch(kCondNe, reg_tmp1, 0, launch_pad);
+  // Compare pairs of chars until fewer than two are left.
+  LIR* word_loop = NewLIR0(kPseudoTargetLabel);
+  OpRegImm(kOpSub, reg_count, 2);
+  LIR* branch_tail = OpCmpImmBranch(kCondLt, reg_count, 0, NULL);
+  LoadWordDisp(reg_this, 0, reg_tmp1);
+  LoadWordDisp(reg_cmp, 0, reg_tmp2);
+  OpRegImm(kOpAdd, reg_this, 4);
+  OpRegImm(kOpAdd, reg_cmp, 4);
+  OpCmpBranch(kCondEq, reg_tmp1, reg_tmp2, word_loop);
+  LIR* branch_word_diff = OpUnconditionalBranch(NULL);
+  // Back to the number of chars left, one or none.
+  branch_tail->target = NewLIR0(kPseudoTargetLabel);
+  OpRegImm(kOpAdd, reg_count, 2);
+  LIR* branch_no_tail = OpCmpImmBranch(kCondEq, reg_count, 0, NULL);
+  LoadBaseDisp(reg_this, 0, reg_tmp1, kUnsignedHalf, INVALID_SREG);
+  LoadBaseDisp(reg_cmp, 0, reg_tmp2, kUnsignedHalf, INVALID_SREG);
+  LIR* branch_char_diff = OpCmpBranch(kCondNe, reg_tmp1, reg_tmp2, NULL);
+  LIR* equal_tgt = NewLIR0(kPseudoTargetLabel);
+  LoadConstant(TargetReg(kRet0), 1);
+  LIR* branch_done = OpUnconditionalBranch(NULL);
+  LIR* not_equal_tgt = NewLIR0(kPseudoTargetLabel);
+  LoadConstant(TargetReg(kRet0), 0);
+  LIR* resume_tgt = NewLIR0(kPseudoTargetLabel);
+  branch_same->target = equal_tgt;
+  branch_no_tail->target = equal_tgt;
+  branch_null->target = not_equal_tgt;
+  branch_class->target = not_equal_tgt;
+  branch_count->target = not_equal_tgt;
+  branch_word_diff->target = not_equal_tgt;
+  branch_char_diff->target = not_equal_tgt;
+  branch_done->target = resume_tgt;
+  launch_pad->operands[2] = reinterpret_cast<uintptr_t>(resume_tgt);
+  // Record that we've already inlined & null checked
+  info->opt_flags |= (MIR_INLINED | MIR_IGNORE_NULL_CHECK);
+  RegLocation rl_return = GetReturn(false);
+  RegLocation rl_dest = InlineTarget(info);
+  StoreValue(rl_dest, rl_return);
+  return true;
+}
+
+/*
+ * Fast System.arraycopy for copies between two distinct char arrays, the case
+ * StringBuilder and String hit.  Anything else, including everything that
+ * throws, is left to the native method.
+ */
+bool Mir2Lir::GenInlinedArrayCopyCharArray(CallInfo* info) {
+  if (cu_->instruction_set != kThumb2) {
+    // TODO: x86 runs out of temps, add Mips implementation
+    return false;
+  }
+  int length_offset = mirror::Array::LengthOffset().Int32Value();
+  int data_offset = mirror::Array::DataOffset(sizeof(uint16_t)).Int32Value();
+  int class_offset = mirror::Object::ClassOffset().Int32Value();
+  int component_type_offset = mirror::Class::ComponentTypeOffset().Int32Value();
+  int primitive_type_offset = mirror::Class::PrimitiveTypeOffset().Int32Value();
+  ClobberCalleeSave();
+  LockCallTemps();  // Using fixed registers
+  int reg_src = TargetReg(kArg0);
+  int reg_src_pos = TargetReg(kArg1);
+  int reg_dst = TargetReg(kArg2);
+  int reg_dst_pos = TargetReg(kArg3);
+  int reg_length = AllocTemp();
+
+  RegLocation rl_src = info->args[0];
+  RegLocation rl_src_pos = info->args[1];
+  RegLocation rl_dst = info->args[2];
+  RegLocation rl_dst_pos = info->args[3];
+  RegLocation rl_length = info->args[4];
+  LoadValueDirectFixed(rl_src, reg_src);
+  LoadValueDirectFixed(rl_dst, reg_dst);
+  LIR* launch_pad = RawLIR(0, kPseudoIntrinsicRetry, reinterpret_cast<uintptr_t>(info));
+  intrinsic_launchpads_.Insert(launch_pad);
+  // Copies within one array may overlap, the native method deals with them.
+  OpCmpImmBranch(kCondEq, reg_src, 0, launch_pad);
+  OpCmpImmBranch(kCondEq, reg_dst, 0, launch_pad);
+  OpCmpBranch(kCondEq, reg_src, reg_dst, launch_pad);
+  // Both must be char[], which also keeps object arrays needing card marks off the fast path.
+  LoadWordDisp(reg_src, class_offset, reg_src_pos);
+  LoadWordDisp(reg_dst, class_offset, reg_dst_pos);
+  OpCmpBranch(kCondNe, reg_src_pos, reg_dst_pos, launch_pad);
+  LoadWordDisp(reg_src_pos, component_type_offset, reg_src_pos);
+  OpCmpImmBranch(kCondEq, reg_src_pos, 0, launch_pad);
+  LoadWordDisp(reg_src_pos, primitive_type_offset, reg_src_pos);
+  OpCmpImmBranch(kCondNe, reg_src_pos, Primitive::kPrimChar, launch_pad);
+  // Range check both sides, turning the arrays into pointers to the first char copied.
+  LoadValueDirectFixed(rl_length, reg_length);
+  LoadValueDirectFixed(rl_src_pos, reg_src_pos);
+  OpCmpImmBranch(kCondLt, reg_length, 0, launch_pad);
+  OpCmpImmBranch(kCondLt, reg_src_pos, 0, launch_pad);
+  LoadWordDisp(reg_src, length_offset, reg_dst_pos);
+  OpRegReg(kOpSub, reg_dst_pos, reg_length);
+  OpCmpBranch(kCondLt, reg_dst_pos, reg_src_pos, launch_pad);
+  OpRegRegImm(kOpLsl, reg_src_pos, reg_src_pos, 1);
+  OpRegReg(kOpAdd, reg_src, reg_src_pos);
+  LoadValueDirectFixed(rl_dst_pos, reg_dst_pos);
+  OpCmpImmBranch(kCondLt, reg_dst_pos, 0, launch_pad);
+  LoadWordDisp(reg_dst, length_offset, reg_src_pos);
+  OpRegReg(kOpSub, reg_src_pos, reg_length);
+  OpCmpBranch(kCondLt, reg_src_pos, reg_dst_pos, launch_pad);
+  OpRegRegImm(kOpLsl, reg_dst_pos, reg_dst_pos, 1);
+  OpRegReg(kOpAdd, reg_dst, reg_dst_pos);
+  OpRegImm(kOpAdd, reg_src, data_offset);
+  OpRegImm(kOpAdd, reg_dst, data_offset);
+  // The positions are dead, reuse their registers.
+  int reg_tmp = reg_src_pos;
+  int reg_words = reg_dst_pos;
+  // Pointers that can't both be word aligned are copied a char at a time.
+  OpRegRegReg(kOpXor, reg_tmp, reg_src, reg_dst);
+  OpRegImm(kOpAnd, reg_tmp, 2);
+  LIR* branch_unaligned = OpCmpImmBranch(kCondNe, reg_tmp, 0, NULL);
+  LIR* branch_empty = OpCmpImmBranch(kCondEq, reg_length, 0, NULL);
+  OpRegRegImm(kOpAnd, reg_tmp, reg_src, 2);
+  LIR* branch_aligned = OpCmpImmBranch(kCondEq, reg_tmp, 0, NULL);
+  LoadBaseDisp(reg_src, 0, reg_tmp, kUnsignedHalf, INVALID_SREG);
+  StoreBaseDisp(reg_dst, 0, reg_tmp, kUnsignedHalf);
+  OpRegImm(kOpAdd, reg_src, 2);
+  OpRegImm(kOpAdd, reg_dst, 2);
+  OpRegImm(kOpSub, reg_length, 1);
+  branch_aligned->target = NewLIR0(kPseudoTargetLabel);
+  // Copy pairs of chars a word at a time, leaving at most one to copy.
+  OpRegRegImm(kOpLsr, reg_words, reg_length, 1);
+  LIR* branch_no_words = OpCmpImmBranch(kCondEq, reg_words, 0, NULL);
+  LIR* word_loop = NewLIR0(kPseudoTargetLabel);
+  LoadWordDisp(reg_src, 0, reg_tmp);
+  StoreWordDisp(reg_dst, 0, reg_tmp);
+  OpRegImm(kOpAdd, reg_src, 4);
+  OpRegImm(kOpAdd, reg_dst, 4);
+  OpDecAndBranch(kCondNe, reg_words, word_loop);
+  branch_no_words->target = NewLIR0(kPseudoTargetLabel);
+  OpRegImm(kOpAnd, reg_length, 1);
+  branch_unaligned->target = NewLIR0(kPseudoTargetLabel);
+  LIR* branch_done = OpCmpImmBranch(kCondEq, reg_length, 0, NULL);
+  LIR* char_loop = NewLIR0(kPseudoTargetLabel);
+  LoadBaseDisp(reg_src, 0, reg_tmp, kUnsignedHalf, INVALID_SREG);
+  StoreBaseDisp(reg_dst, 0, reg_tmp, kUnsignedHalf);
+  OpRegImm(kOpAdd, reg_src, 2);
+  OpRegImm(kOpAdd, reg_dst, 2);
+  OpDecAndBranch(kCondNe, reg_length, char_loop);
+  LIR* resume_tgt = NewLIR0(kPseudoTargetLabel);
+  branch_empty->target = resume_tgt;
+  branch_done->target = resume_tgt;
+  launch_pad->operands[2] = reinterpret_cast<uintptr_t>(resume_tgt);
+  info->opt_flags |= MIR_INLINED;
+  return true;
+}
+
+/* Fast Arrays.fill([II)V and Arrays.fill([CC)V, storing a word at a time. */
+bool Mir2Lir::GenInlinedArrayFill(CallInfo* info, bool is_char) {
+  int length_offset = mirror::Array::LengthOffset().Int32Value();
+  size_t component_size = is_char ? sizeof(uint16_t) : sizeof(int32_t);
+  int data_offset = mirror::Array::DataOffset(component_size).Int32Value();
+  ClobberCalleeSave();
+  LockCallTemps();  // Using fixed registers
+  int reg_ptr = TargetReg(kArg0);
+  int reg_value = TargetReg(kArg1);
+  int reg_count = TargetReg(kArg2);
+  int reg_tmp = TargetReg(kArg3);
+
+  RegLocation rl_array = info->args[0];
+  RegLocation rl_value = info->args[1];
+  LoadValueDirectFixed(rl_array, reg_ptr);
+  LoadValueDirectFixed(rl_value, reg_value);
+  // Let the library code throw the NullPointerException.
+  LIR* launch_pad = RawLIR(0, kPseudoIntrinsicRetry, reinterpret_cast<uintptr_t>(info));
+  intrinsic_launchpads_.Insert(launch_pad);
+  OpCmpImmBranch(kCondEq, reg_ptr, 0, launch_pad);
+  LoadWordDisp(reg_ptr, length_offset, reg_count);
+  OpRegImm(kOpAdd, reg_ptr, data_offset);
+  if (is_char) {
+    // Store an odd last char by itself, then fill words holding the char twice.
+    OpRegRegImm(kOpAnd, reg_tmp, reg_count, 1);
+    LIR* branch_even = OpCmpImmBranch(kCondEq, reg_tmp, 0, NULL);
+    OpRegImm(kOpSub, reg_count, 1);
+    StoreBaseIndexed(reg_ptr, reg_count, reg_value, 1, kUnsignedHalf);
+    branch_even->target = NewLIR0(kPseudoTargetLabel);
+    OpRegImm(kOpLsr, reg_count, 1);
+    OpRegRegImm(kOpLsl, reg_tmp, reg_value, 16);
+    OpRegReg(kOpOr, reg_value, reg_tmp);
+  }
+  LIR* branch_empty = OpCmpImmBranch(kCondEq, reg_count, 0, NULL);
+  LIR* loop = NewLIR0(kPseudoTargetLabel);
+  StoreWordDisp(reg_ptr, 0, reg_value);
+  OpRegImm(kOpAdd, reg_ptr, 4);
+  OpDecAndBranch(kCondNe, reg_count, loop);
+  LIR* resume_tgt = NewLIR0(kPseudoTargetLabel);
+  branch_empty->target = resume_tgt;
+  launch_pad->operands[2] = reinterpret_cast<uintptr_t>(resume_tgt);
+  info->opt_flags |= MIR_INLINED;
+  return true;
+}
+
+bool Mir2Lir::GenInlinedIdentityHashCode(CallInfo* info) {
+#ifdef MOVING_GARBAGE_COLLECTOR
+  // The hash is no longer the address, see mirror::Object::IdentityHashCode.
+  return false;
+#else
+  // An object's identity hash is its address, and null's is 0, so the hash is the reference
+  // itself. Nothing is stored in or inflated from the lock word.
+  RegLocation rl_src = info->args[0];
+  RegLocation rl_dest = InlineTarget(info);
+  StoreValue(rl_dest, rl_src);
+  return true;
+#endif
+}
+
 bool Mir2Lir::GenInlinedCurrentThread(CallInfo* info) {
   RegLocation rl_dest = InlineTarget(info);
   RegLocation rl_result = EvalLoc(rl_dest, kCoreReg, true);
@@ -1142,10 +1414,6 @@ bool Mir2Lir::GenInlinedCurrentThread(CallInfo* info) {
 
 bool Mir2Lir::GenInlinedUnsafeGet(CallInfo* info,
                                   bool is_long, bool is_volatile) {
-  if (cu_->instruction_set == kMips) {
-    // TODO - add Mips implementation
-    return false;
-  }
   // Unused - RegLocation rl_src_unsafe = info->args[0];
   RegLocation rl_src_obj = info->args[1];  // Object
   RegLocation rl_src_offset = info->args[2];  // long low
@@ -1170,10 +1438,6 @@ bool Mir2Lir::GenInlinedUnsafeGet(CallInfo* info,
 
 bool Mir2Lir::GenInlinedUnsafePut(CallInfo* info, bool is_long,
                                   bool is_object, bool is_volatile, bool is_ordered) {
-  if (cu_->instruction_set == kMips) {
-    // TODO - add Mips implementation
-    return false;
-  }
   if (cu_->instruction_set == kX86 && is_object) {
     // TODO: fix X86, it exhausts registers for card marking.
     return false;
@@ -1269,6 +1533,9 @@ bool Mir2Lir::GenIntrinsic(CallInfo* info) {
     if (tgt_method == "int java.lang.String.compareTo(java.lang.String)") {
       return GenInlinedStringCompareTo(info);
     }
+    if (tgt_method == "boolean java.lang.String.equals(java.lang.Object)") {
+      return GenInlinedStringEquals(info);
+    }
     if (tgt_method == "boolean java.lang.String.is_empty()") {
       return GenInlinedStringIsEmptyOrLength(info, true /* is_empty */);
     }
@@ -1281,6 +1548,22 @@ bool Mir2Lir::GenIntrinsic(CallInfo* info) {
     if (tgt_method == "int java.lang.String.length()") {
       return GenInlinedStringIsEmptyOrLength(info, false /* is_empty */);
     }
+  } else if (tgt_methods_declaring_class.starts_with("Ljava/lang/System;")) {
+    std::string tgt_method(PrettyMethod(info->index, *cu_->dex_file));
+    if (tgt_method == "void java.lang.System.arraycopy(java.lang.Object, int, java.lang.Object, int, int)") {
+      return GenInlinedArrayCopyCharArray(info);
+    }
+    if (tgt_method == "int java.lang.System.identityHashCode(java.lang.Object)") {
+      return GenInlinedIdentityHashCode(info);
+    }
+  } else if (tgt_methods_declaring_class.starts_with("Ljava/util/Arrays;")) {
+    std::string tgt_method(PrettyMethod(info->index, *cu_->dex_file));
+    if (tgt_method == "void java.util.Arrays.fill(int[], int)") {
+      return GenInlinedArrayFill(info, false /* is_char */);
+    }
+    if (tgt_method == "void java.util.Arrays.fill(char[], char)") {
+      return GenInlinedArrayFill(info, true /* is_char */);
+    }
   } else if (tgt_methods_declaring_class.starts_with("Ljava/lang/Thread;")) {
     std::string tgt_method(PrettyMethod(info->index, *cu_->dex_file));
     if (tgt_method == "java.lang.Thread java.lang.Thread.currentThread()") {
@@ -1291,6 +1574,9 @@ bool Mir2Lir::GenIntrinsic(CallInfo* info) {
     if (tgt_method == "boolean sun.misc.Unsafe.compareAndSwapInt(java.lang.Object, long, int, int)") {
       return GenInlinedCas32(info, false);
     }
+    if (tgt_method == "boolean sun.misc.Unsafe.compareAndSwapLong(java.lang.Object, long, long, long)") {
+      return GenInlinedCas64(info);
+    }
     if (tgt_method == "boolean sun.misc.Unsafe.compareAndSwapObject(java.lang.Object, long, java.lang.Object, java.lang.Object)") {
       return GenInlinedCas32(info, true);
     }
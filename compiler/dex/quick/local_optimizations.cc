@@ -28,6 +28,8 @@ namespace art {
 #define MAX_HOIST_DISTANCE 20
 #define LDLD_DISTANCE 4
 #define LD_LATENCY 2
+#define MAX_SCHEDULING_REGION 64
+#define IT_SHADOW_SIZE 4
 
 static bool IsDalvikRegisterClobbered(LIR* lir1, LIR* lir2) {
   int reg1Lo = DECODE_ALIAS_INFO_REG(lir1->alias_info);
@@ -88,6 +90,7 @@ void Mir2Lir::ApplyLoadStoreElimination(LIR* head_lir, LIR* tail_lir) {
 
     /* Skip non-interesting instructions */
     if ((this_lir->flags.is_nop == true) ||
+        (this_lir->def_mask == ENCODE_ALL) ||  // Skip safepoints, such as implicit null checks.
         (target_flags & IS_BRANCH) ||
         ((target_flags & (REG_DEF0 | REG_DEF1)) == (REG_DEF0 | REG_DEF1)) ||  // Skip wide loads.
         ((target_flags & (REG_USE0 | REG_USE1 | REG_USE2)) ==
@@ -293,6 +296,7 @@ void Mir2Lir::ApplyLoadHoisting(LIR* head_lir, LIR* tail_lir) {
     uint64_t target_flags = GetTargetInstFlags(this_lir->opcode);
     /* Skip non-interesting instructions */
     if ((this_lir->flags.is_nop == true) ||
+        (this_lir->def_mask == ENCODE_ALL) ||  // Skip safepoints, such as implicit null checks.
         ((target_flags & (REG_DEF0 | REG_DEF1)) == (REG_DEF0 | REG_DEF1)) ||
         !(target_flags & IS_LOAD)) {
       continue;
@@ -459,11 +463,197 @@ void Mir2Lir::ApplyLoadHoisting(LIR* head_lir, LIR* tail_lir) {
   }
 }
 
+/* Check whether 'later' has to stay after 'earlier' because of the memory they access */
+static bool HasMemoryDependency(LIR* earlier, LIR* later) {
+  uint64_t conflict = ((earlier->def_mask & (later->use_mask | later->def_mask)) |
+                       (earlier->use_mask & later->def_mask)) & ENCODE_MEM;
+  if (conflict == 0) {
+    return false;
+  }
+  /* We can fully disambiguate Dalvik references */
+  if (conflict == ENCODE_DALVIK_REG) {
+    return (earlier->alias_info == later->alias_info) ||
+        IsDalvikRegisterClobbered(earlier, later) || IsDalvikRegisterClobbered(later, earlier);
+  }
+  /* Conservatively treat everything else as may-alias */
+  return true;
+}
+
+/*
+ * List schedule a region of instructions with no barriers in between, and
+ * relink them in their new order just before 'anchor'.  Instructions are
+ * picked in order of the cycle their operands become ready, then by the
+ * length of the dependence chain they start, so that long latency results
+ * get consumed as late as possible.
+ */
+void Mir2Lir::ScheduleRegion(LIR** region, int region_size, LIR* anchor) {
+  if (region_size < 2) {
+    return;
+  }
+  DCHECK_LE(region_size, MAX_SCHEDULING_REGION);
+  uint64_t succs[MAX_SCHEDULING_REGION];
+  int latency[MAX_SCHEDULING_REGION];
+  int height[MAX_SCHEDULING_REGION];
+  int num_preds[MAX_SCHEDULING_REGION];
+  int ready_cycle[MAX_SCHEDULING_REGION];
+
+  /* Build the dependence graph, and the critical path height of each instruction */
+  for (int i = region_size - 1; i >= 0; i--) {
+    LIR* lir = region[i];
+    succs[i] = 0;
+    num_preds[i] = 0;
+    ready_cycle[i] = 0;
+    latency[i] = GetInstructionLatency(lir);
+    height[i] = latency[i];
+    for (int j = i + 1; j < region_size; j++) {
+      LIR* check_lir = region[j];
+      if (CHECK_REG_DEP(lir->use_mask & ~ENCODE_MEM, lir->def_mask & ~ENCODE_MEM, check_lir) ||
+          HasMemoryDependency(lir, check_lir)) {
+        succs[i] |= UINT64_C(1) << j;
+        num_preds[j]++;
+        int edge = (lir->def_mask & check_lir->use_mask & ~ENCODE_MEM) ? latency[i] : 1;
+        height[i] = std::max(height[i], edge + height[j]);
+      }
+    }
+  }
+
+  LIR* order[MAX_SCHEDULING_REGION];
+  uint64_t scheduled = 0;
+  bool reordered = false;
+  int cycle = 0;
+  for (int n = 0; n < region_size; n++) {
+    int best = -1;
+    int best_cycle = 0;
+    for (int i = 0; i < region_size; i++) {
+      if ((scheduled & (UINT64_C(1) << i)) || num_preds[i] != 0) {
+        continue;
+      }
+      int issue_cycle = std::max(cycle, ready_cycle[i]);
+      if (best == -1 || issue_cycle < best_cycle ||
+          (issue_cycle == best_cycle && height[i] > height[best])) {
+        best = i;
+        best_cycle = issue_cycle;
+      }
+    }
+    DCHECK_NE(best, -1);
+    scheduled |= UINT64_C(1) << best;
+    order[n] = region[best];
+    reordered |= (best != n);
+    cycle = best_cycle + 1;
+    for (int j = best + 1; j < region_size; j++) {
+      if (succs[best] & (UINT64_C(1) << j)) {
+        num_preds[j]--;
+        int edge = (region[best]->def_mask & region[j]->use_mask & ~ENCODE_MEM) ?
+            latency[best] : 1;
+        ready_cycle[j] = std::max(ready_cycle[j], best_cycle + edge);
+      }
+    }
+  }
+
+  if (!reordered) {
+    return;
+  }
+  for (int n = 0; n < region_size; n++) {
+    LIR* lir = order[n];
+    lir->prev->next = lir->next;
+    lir->next->prev = lir->prev;
+    InsertLIRBefore(anchor, lir);
+  }
+}
+
+/*
+ * Reorder the instructions of a superblock to hide load-use and other result
+ * latencies.  Labels and other pseudo ops, branches, instructions defining
+ * all resources or the pc, and the instructions in an IT block, split the
+ * superblock into regions which are scheduled separately.
+ */
+void Mir2Lir::ApplyInstructionScheduling(LIR* head_lir, LIR* tail_lir) {
+  LIR* region[MAX_SCHEDULING_REGION];
+  int region_size = 0;
+  int it_shadow = 0;
+  uint64_t pc_mask = GetPCUseDefEncoding();
+
+  if (head_lir == tail_lir) {
+    return;
+  }
+
+  LIR* next_lir;
+  for (LIR* this_lir = NEXT_LIR(head_lir); this_lir != tail_lir; this_lir = next_lir) {
+    next_lir = NEXT_LIR(this_lir);
+    /* Dalvik instruction boundaries only matter for dumps, so schedule across them */
+    if (this_lir->flags.is_nop || this_lir->opcode == kPseudoDalvikByteCodeBoundary) {
+      continue;
+    }
+    bool barrier = is_pseudo_opcode(this_lir->opcode);
+    if (!barrier) {
+      uint64_t target_flags = GetTargetInstFlags(this_lir->opcode);
+      barrier = (it_shadow > 0) || (target_flags & (IS_BRANCH | IS_IT)) ||
+          (this_lir->def_mask == ENCODE_ALL) || (this_lir->use_mask == ENCODE_ALL) ||
+          (this_lir->def_mask & pc_mask);
+      if (it_shadow > 0) {
+        it_shadow--;
+      }
+      if (target_flags & IS_IT) {
+        it_shadow = IT_SHADOW_SIZE;
+      }
+    }
+    if (barrier) {
+      ScheduleRegion(region, region_size, this_lir);
+      region_size = 0;
+      continue;
+    }
+    region[region_size++] = this_lir;
+    if (region_size == MAX_SCHEDULING_REGION) {
+      ScheduleRegion(region, region_size, next_lir);
+      region_size = 0;
+    }
+  }
+  ScheduleRegion(region, region_size, tail_lir);
+}
+
+/*
+ * Remove memory barriers made redundant by the next one in the superblock.
+ * When nothing between two barriers accesses memory or transfers control,
+ * the later one orders the same accesses as the earlier, so the earlier is
+ * nopped and the later strengthened to cover both.  Back-to-back volatile
+ * accesses, and a volatile store at the end of a constructor that needs a
+ * barrier, would otherwise pay for two fences.
+ */
+void Mir2Lir::ApplyBarrierElimination(LIR* head_lir, LIR* tail_lir) {
+  LIR* last_barrier = NULL;
+  for (LIR* this_lir = head_lir; ; this_lir = NEXT_LIR(this_lir)) {
+    if (!this_lir->flags.is_nop && this_lir->opcode != kPseudoDalvikByteCodeBoundary) {
+      if (is_pseudo_opcode(this_lir->opcode)) {
+        // Labels may be reached without passing the earlier barrier.
+        last_barrier = NULL;
+      } else if (IsMemBarrier(this_lir)) {
+        if (last_barrier != NULL) {
+          MergeMemBarriers(this_lir, last_barrier);
+          last_barrier->flags.is_nop = true;
+        }
+        last_barrier = this_lir;
+      } else if ((GetTargetInstFlags(this_lir->opcode) & (IS_LOAD | IS_STORE | IS_BRANCH)) ||
+                 ((this_lir->use_mask | this_lir->def_mask) & ENCODE_MEM)) {
+        last_barrier = NULL;
+      }
+    }
+    if (this_lir == tail_lir) {
+      break;
+    }
+  }
+}
+
 void Mir2Lir::ApplyLocalOptimizations(LIR* head_lir, LIR* tail_lir) {
+  if (!(cu_->disable_opt & (1 << kBarrierElimination))) {
+    ApplyBarrierElimination(head_lir, tail_lir);
+  }
   if (!(cu_->disable_opt & (1 << kLoadStoreElimination))) {
     ApplyLoadStoreElimination(head_lir, tail_lir);
   }
-  if (!(cu_->disable_opt & (1 << kLoadHoisting))) {
+  /* The scheduler subsumes load hoisting */
+  if (!(cu_->disable_opt & (1 << kInstructionScheduling))) {
+    ApplyInstructionScheduling(head_lir, tail_lir);
+  } else if (!(cu_->disable_opt & (1 << kLoadHoisting))) {
     ApplyLoadHoisting(head_lir, tail_lir);
   }
 }
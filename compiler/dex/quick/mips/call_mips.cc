@@ -28,6 +28,11 @@ void MipsMir2Lir::GenSpecialCase(BasicBlock* bb, MIR* mir,
     // TODO
 }
 
+bool MipsMir2Lir::RemoveFrame() {
+  // TODO
+  return false;
+}
+
 /*
  * The lack of pc-relative loads on Mips presents somewhat of a challenge
  * for our PIC switch table strategy.  To materialize the current location
@@ -59,9 +64,8 @@ void MipsMir2Lir::GenSpecialCase(BasicBlock* bb, MIR* mir,
  * done:
  *
  */
-void MipsMir2Lir::GenSparseSwitch(MIR* mir, uint32_t table_offset,
+void MipsMir2Lir::GenSparseSwitch(MIR* mir, const uint16_t* table,
                                   RegLocation rl_src) {
-  const uint16_t* table = cu_->insns + current_dalvik_offset_ + table_offset;
   if (cu_->verbose) {
     DumpSparseSwitchTable(table);
   }
@@ -138,9 +142,8 @@ void MipsMir2Lir::GenSparseSwitch(MIR* mir, uint32_t table_offset,
  *   jr    r_RA
  * done:
  */
-void MipsMir2Lir::GenPackedSwitch(MIR* mir, uint32_t table_offset,
+void MipsMir2Lir::GenPackedSwitch(MIR* mir, const uint16_t* table,
                                   RegLocation rl_src) {
-  const uint16_t* table = cu_->insns + current_dalvik_offset_ + table_offset;
   if (cu_->verbose) {
     DumpPackedSwitchTable(table);
   }
@@ -337,18 +340,21 @@ void MipsMir2Lir::GenEntrySequence(RegLocation* ArgLocs, RegLocation rl_method)
    */
   bool skip_overflow_check = (mir_graph_->MethodIsLeaf() &&
       (static_cast<size_t>(frame_size_) < Thread::kStackOverflowReservedBytes));
+  bool implicit_overflow_check = !skip_overflow_check && UseImplicitStackOverflowCheck();
   NewLIR0(kPseudoMethodEntry);
   int check_reg = AllocTemp();
   int new_sp = AllocTemp();
-  if (!skip_overflow_check) {
+  if (implicit_overflow_check) {
+    /* Probe below sp before anything is stored, so a fault throws from the caller */
+    int probe_offset = -static_cast<int>(Thread::kStackOverflowProbeBytes);
+    MarkImplicitStackOverflowCheck(LoadWordDisp(rMIPS_SP, probe_offset, check_reg));
+  } else if (!skip_overflow_check) {
     /* Load stack limit */
     LoadWordDisp(rMIPS_SELF, Thread::StackEndOffset().Int32Value(), check_reg);
   }
-  /* Spill core callee saves */
+  /* Spill core and fp callee saves */
   SpillCoreRegs();
-  /* NOTE: promotion of FP regs currently unsupported, thus no FP spill */
-  DCHECK_EQ(num_fp_spills_, 0);
-  if (!skip_overflow_check) {
+  if (!skip_overflow_check && !implicit_overflow_check) {
     OpRegRegImm(kOpSub, new_sp, rMIPS_SP, frame_size_ - (spill_count * 4));
     GenRegRegCheck(kCondCc, new_sp, check_reg, kThrowStackOverflow);
     OpRegCopy(rMIPS_SP, new_sp);     // Establish stack
@@ -235,8 +235,26 @@ void MipsMir2Lir::GenNegDouble(RegLocation rl_dest, RegLocation rl_src) {
 }
 
 bool MipsMir2Lir::GenInlinedMinMaxInt(CallInfo* info, bool is_min) {
-  // TODO: need Mips implementation
-  return false;
+  RegLocation rl_src1 = info->args[0];
+  RegLocation rl_src2 = info->args[1];
+  rl_src1 = LoadValue(rl_src1, kCoreReg);
+  rl_src2 = LoadValue(rl_src2, kCoreReg);
+  RegLocation rl_dest = InlineTarget(info);
+  RegLocation rl_result = EvalLoc(rl_dest, kCoreReg, true);
+  // The result is the operand picked when src1 < src2, else the other one.
+  int if_set = is_min ? rl_src1.low_reg : rl_src2.low_reg;
+  int if_clear = is_min ? rl_src2.low_reg : rl_src1.low_reg;
+  int t_reg = AllocTemp();
+  NewLIR3(kMipsSlt, t_reg, rl_src1.low_reg, rl_src2.low_reg);
+  if (rl_result.low_reg == if_set) {
+    NewLIR3(kMipsMovz, rl_result.low_reg, if_clear, t_reg);
+  } else {
+    OpRegCopy(rl_result.low_reg, if_clear);
+    NewLIR3(kMipsMovn, rl_result.low_reg, if_set, t_reg);
+  }
+  FreeTemp(t_reg);
+  StoreValue(rl_dest, rl_result);
+  return true;
 }
 
 }  // namespace art
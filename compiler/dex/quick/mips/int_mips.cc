@@ -21,6 +21,7 @@
 #include "entrypoints/quick/quick_entrypoints.h"
 #include "mips_lir.h"
 #include "mirror/array.h"
+#include "utils/magic_divide.h"
 
 namespace art {
 
@@ -213,6 +214,11 @@ void MipsMir2Lir::GenSelect(BasicBlock* bb, MIR* mir) {
   UNIMPLEMENTED(FATAL) << "Need codegen for select";
 }
 
+void MipsMir2Lir::GenVectorLoopBody(const VectorLoopInfo* info, int r_index, int r_count,
+                                    int* r_arrays) {
+  UNIMPLEMENTED(FATAL) << "Need codegen for vector loops";
+}
+
 void MipsMir2Lir::GenFusedLongCmpBranch(BasicBlock* bb, MIR* mir) {
   UNIMPLEMENTED(FATAL) << "Need codegen for fused long cmp branch";
 }
@@ -263,6 +269,11 @@ bool MipsMir2Lir::GenInlinedCas32(CallInfo* info, bool need_write_barrier) {
   return false;
 }
 
+bool MipsMir2Lir::GenInlinedCas64(CallInfo* info) {
+  DCHECK_NE(cu_->instruction_set, kThumb2);
+  return false;
+}
+
 bool MipsMir2Lir::GenInlinedSqrt(CallInfo* info) {
   DCHECK_NE(cu_->instruction_set, kThumb2);
   return false;
@@ -308,16 +319,54 @@ LIR* MipsMir2Lir::OpTestSuspend(LIR* target) {
   return OpCmpImmBranch((target == NULL) ? kCondEq : kCondNe, rMIPS_SUSPEND, 0, target);
 }
 
+LIR* MipsMir2Lir::OpSuspendPoll() {
+  LOG(FATAL) << "Unexpected use of OpSuspendPoll for Mips";
+  return NULL;
+}
+
 // Decrement register and branch on condition
 LIR* MipsMir2Lir::OpDecAndBranch(ConditionCode c_code, int reg, LIR* target) {
   OpRegImm(kOpSub, reg, 1);
   return OpCmpImmBranch(c_code, reg, 0, target);
 }
 
-bool MipsMir2Lir::SmallLiteralDivRem(Instruction::Code dalvik_opcode, bool is_div,
+// Integer division by constant via reciprocal multiply (Hacker's Delight, 10-4)
+bool MipsMir2Lir::MagicLiteralDivRem(Instruction::Code dalvik_opcode, bool is_div,
                                      RegLocation rl_src, RegLocation rl_dest, int lit) {
-  LOG(FATAL) << "Unexpected use of smallLiteralDive in Mips";
-  return false;
+  int32_t magic;
+  int shift;
+  CalculateMagicAndShift(lit, &magic, &shift);
+
+  int t_reg = AllocTemp();
+  LoadConstant(t_reg, magic);
+  rl_src = LoadValue(rl_src, kCoreReg);
+  RegLocation rl_result = EvalLoc(rl_dest, kCoreReg, true);
+  NewLIR4(kMipsMult, r_HI, r_LO, t_reg, rl_src.low_reg);
+  int r_quotient = AllocTemp();
+  NewLIR2(kMipsMfhi, r_quotient, r_HI);
+  if (lit > 0 && magic < 0) {
+    OpRegReg(kOpAdd, r_quotient, rl_src.low_reg);
+  } else if (lit < 0 && magic > 0) {
+    OpRegReg(kOpSub, r_quotient, rl_src.low_reg);
+  }
+  if (shift != 0) {
+    OpRegRegImm(kOpAsr, r_quotient, r_quotient, shift);
+  }
+  // Round towards zero by adding the sign bit of the quotient.
+  OpRegRegImm(kOpLsr, t_reg, r_quotient, 31);
+  if (is_div) {
+    OpRegRegReg(kOpAdd, rl_result.low_reg, r_quotient, t_reg);
+  } else {
+    // rem = src - quotient * lit.
+    OpRegReg(kOpAdd, r_quotient, t_reg);
+    LoadConstant(t_reg, lit);
+    OpRegReg(kOpMul, r_quotient, t_reg);
+    OpRegRegReg(kOpSub, rl_result.low_reg, rl_src.low_reg, r_quotient);
+  }
+  FreeTemp(t_reg);
+  FreeTemp(r_quotient);
+  StoreValue(rl_dest, rl_result);
+  return true;
 }
 
 LIR* MipsMir2Lir::OpIT(ConditionCode cond, const char* guide) {
@@ -558,7 +607,7 @@ void MipsMir2Lir::GenArrayPut(int opt_flags, OpSize size, RegLocation rl_array,
 void MipsMir2Lir::GenArrayObjPut(int opt_flags, RegLocation rl_array,
                              RegLocation rl_index, RegLocation rl_src, int scale) {
   int len_offset = mirror::Array::LengthOffset().Int32Value();
-  int data_offset = mirror::Array::DataOffset(sizeof(mirror::Object*)).Int32Value();
+  int data_offset = mirror::Array::DataOffset(mirror::kHeapReferenceSize).Int32Value();
 
   FlushAllRegs();  // Use explicit registers
   LockCallTemps();
@@ -611,10 +660,122 @@ void MipsMir2Lir::GenArrayObjPut(int opt_flags, RegLocation rl_array,
   }
 }
 
+/*
+ * The results are built in fresh temps, so any overlap of the source and destination pairs is
+ * harmless, and then handed to the destination.
+ */
 void MipsMir2Lir::GenShiftImmOpLong(Instruction::Code opcode, RegLocation rl_dest,
                                     RegLocation rl_src1, RegLocation rl_shift) {
-  // Default implementation is just to ignore the constant case.
-  GenShiftOpLong(opcode, rl_dest, rl_src1, rl_shift);
+  rl_src1 = LoadValueWide(rl_src1, kCoreReg);
+  // Per spec, we only care about low 6 bits of shift amount.
+  int shift_amount = mir_graph_->ConstantValue(rl_shift) & 0x3f;
+  if (shift_amount == 0) {
+    StoreValueWide(rl_dest, rl_src1);
+    return;
+  }
+  int t_lo = AllocTemp();
+  int t_hi = AllocTemp();
+  switch (opcode) {
+    case Instruction::SHL_LONG:
+    case Instruction::SHL_LONG_2ADDR:
+      if (shift_amount > 31) {
+        OpRegRegImm(kOpLsl, t_hi, rl_src1.low_reg, shift_amount - 32);
+        LoadConstant(t_lo, 0);
+      } else {
+        OpRegRegImm(kOpLsl, t_hi, rl_src1.high_reg, shift_amount);
+        OpRegRegImm(kOpLsr, t_lo, rl_src1.low_reg, 32 - shift_amount);
+        OpRegReg(kOpOr, t_hi, t_lo);
+        OpRegRegImm(kOpLsl, t_lo, rl_src1.low_reg, shift_amount);
+      }
+      break;
+    case Instruction::SHR_LONG:
+    case Instruction::SHR_LONG_2ADDR:
+      if (shift_amount > 31) {
+        OpRegRegImm(kOpAsr, t_lo, rl_src1.high_reg, shift_amount - 32);
+        OpRegRegImm(kOpAsr, t_hi, rl_src1.high_reg, 31);
+      } else {
+        OpRegRegImm(kOpLsr, t_lo, rl_src1.low_reg, shift_amount);
+        OpRegRegImm(kOpLsl, t_hi, rl_src1.high_reg, 32 - shift_amount);
+        OpRegReg(kOpOr, t_lo, t_hi);
+        OpRegRegImm(kOpAsr, t_hi, rl_src1.high_reg, shift_amount);
+      }
+      break;
+    case Instruction::USHR_LONG:
+    case Instruction::USHR_LONG_2ADDR:
+      if (shift_amount > 31) {
+        OpRegRegImm(kOpLsr, t_lo, rl_src1.high_reg, shift_amount - 32);
+        LoadConstant(t_hi, 0);
+      } else {
+        OpRegRegImm(kOpLsr, t_lo, rl_src1.low_reg, shift_amount);
+        OpRegRegImm(kOpLsl, t_hi, rl_src1.high_reg, 32 - shift_amount);
+        OpRegReg(kOpOr, t_lo, t_hi);
+        OpRegRegImm(kOpLsr, t_hi, rl_src1.high_reg, shift_amount);
+      }
+      break;
+    default:
+      LOG(FATAL) << "Unexpected case";
+  }
+  RegLocation rl_result = LocCReturnWide();  // Just using as a template.
+  rl_result.low_reg = t_lo;
+  rl_result.high_reg = t_hi;
+  StoreValueWide(rl_dest, rl_result);
+}
+
+/*
+ * The same sequences as the pShlLong, pShrLong and pUshrLong helpers: shift both words by the
+ * low 5 bits of the distance, carrying the bits that cross between them, then pick the words
+ * shifted across the middle with movn when bit 5 of the distance is set.
+ */
+void MipsMir2Lir::GenShiftOpLong(Instruction::Code opcode, RegLocation rl_dest,
+                                 RegLocation rl_src1, RegLocation rl_shift) {
+  rl_src1 = LoadValueWide(rl_src1, kCoreReg);
+  rl_shift = LoadValue(rl_shift, kCoreReg);
+  int t_lo = AllocTemp();
+  int t_hi = AllocTemp();
+  int t_cross = AllocTemp();
+  int t_inv = AllocTemp();
+  // The low 5 bits of ~shift are 31 - (shift & 31).
+  OpRegReg(kOpMvn, t_inv, rl_shift.low_reg);
+  switch (opcode) {
+    case Instruction::SHL_LONG:
+    case Instruction::SHL_LONG_2ADDR:
+      OpRegRegReg(kOpLsl, t_lo, rl_src1.low_reg, rl_shift.low_reg);
+      OpRegRegImm(kOpLsr, t_cross, rl_src1.low_reg, 1);
+      OpRegRegReg(kOpLsr, t_cross, t_cross, t_inv);
+      OpRegRegReg(kOpLsl, t_hi, rl_src1.high_reg, rl_shift.low_reg);
+      OpRegReg(kOpOr, t_hi, t_cross);
+      OpRegRegImm(kOpAnd, t_inv, rl_shift.low_reg, 0x20);
+      NewLIR3(kMipsMovn, t_hi, t_lo, t_inv);
+      NewLIR3(kMipsMovn, t_lo, r_ZERO, t_inv);
+      break;
+    case Instruction::SHR_LONG:
+    case Instruction::SHR_LONG_2ADDR:
+    case Instruction::USHR_LONG:
+    case Instruction::USHR_LONG_2ADDR: {
+      bool is_signed = (opcode == Instruction::SHR_LONG) ||
+          (opcode == Instruction::SHR_LONG_2ADDR);
+      OpRegRegReg(is_signed ? kOpAsr : kOpLsr, t_hi, rl_src1.high_reg, rl_shift.low_reg);
+      OpRegRegReg(kOpLsr, t_lo, rl_src1.low_reg, rl_shift.low_reg);
+      OpRegRegImm(kOpLsl, t_cross, rl_src1.high_reg, 1);
+      OpRegRegReg(kOpLsl, t_cross, t_cross, t_inv);
+      OpRegReg(kOpOr, t_lo, t_cross);
+      if (is_signed) {
+        OpRegRegImm(kOpAsr, t_cross, rl_src1.high_reg, 31);
+      }
+      OpRegRegImm(kOpAnd, t_inv, rl_shift.low_reg, 0x20);
+      NewLIR3(kMipsMovn, t_lo, t_hi, t_inv);
+      NewLIR3(kMipsMovn, t_hi, is_signed ? t_cross : r_ZERO, t_inv);
+      break;
+    }
+    default:
+      LOG(FATAL) << "Unexpected case";
+  }
+  FreeTemp(t_cross);
+  FreeTemp(t_inv);
+  RegLocation rl_result = LocCReturnWide();  // Just using as a template.
+  rl_result.low_reg = t_lo;
+  rl_result.high_reg = t_hi;
+  StoreValueWide(rl_dest, rl_result);
 }
 
 void MipsMir2Lir::GenArithImmOpLong(Instruction::Code opcode,
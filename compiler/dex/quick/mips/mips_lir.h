@@ -108,6 +108,8 @@ namespace art {
 #define MIPS_S2D(x, y) ((x) | MIPS_FP_DOUBLE)
 // Mask to strip off fp flags.
 #define MIPS_FP_REG_MASK (MIPS_FP_REG_OFFSET-1)
+// First FP callee save.
+#define MIPS_FP_CALLEE_SAVE_BASE 20
 
 #ifdef HAVE_LITTLE_ENDIAN
 #define LOWORD_OFFSET 0
@@ -154,7 +156,7 @@ enum MipsResourceEncodingPos {
   kMipsGPReg0   = 0,
   kMipsRegSP    = 29,
   kMipsRegLR    = 31,
-  kMipsFPReg0   = 32,  // only 16 fp regs supported currently.
+  kMipsFPReg0   = 32,  // fp regs 16-31 share the positions of 0-15.
   kMipsFPRegEnd   = 48,
   kMipsRegHI    = kMipsFPRegEnd,
   kMipsRegLO,
@@ -217,11 +219,6 @@ enum MipsNativeRegisterPool {
   r_F13,
   r_F14,
   r_F15,
-#if 0
-  /*
-   * TODO: The shared resource mask doesn't have enough bit positions to describe all
-   * MIPS registers.  Expand it and enable use of fp registers 16 through 31.
-   */
   r_F16,
   r_F17,
   r_F18,
@@ -238,7 +235,6 @@ enum MipsNativeRegisterPool {
   r_F29,
   r_F30,
   r_F31,
-#endif
   r_DF0 = r_F0 + MIPS_FP_DOUBLE,
   r_DF1 = r_F2 + MIPS_FP_DOUBLE,
   r_DF2 = r_F4 + MIPS_FP_DOUBLE,
@@ -247,7 +243,6 @@ enum MipsNativeRegisterPool {
   r_DF5 = r_F10 + MIPS_FP_DOUBLE,
   r_DF6 = r_F12 + MIPS_FP_DOUBLE,
   r_DF7 = r_F14 + MIPS_FP_DOUBLE,
-#if 0  // TODO: expand resource mask to enable use of all MIPS fp registers.
   r_DF8 = r_F16 + MIPS_FP_DOUBLE,
   r_DF9 = r_F18 + MIPS_FP_DOUBLE,
   r_DF10 = r_F20 + MIPS_FP_DOUBLE,
@@ -256,7 +251,6 @@ enum MipsNativeRegisterPool {
   r_DF13 = r_F26 + MIPS_FP_DOUBLE,
   r_DF14 = r_F28 + MIPS_FP_DOUBLE,
   r_DF15 = r_F30 + MIPS_FP_DOUBLE,
-#endif
   r_HI = MIPS_EXTRA_REG_OFFSET,
   r_LO,
   r_PC,
@@ -341,7 +335,9 @@ enum MipsOpCode {
   kMipsMflo,  // mflo d [0000000000000000] d[15..11] [00000010010].
   kMipsMove,  // move d,s [000000] s[25..21] [00000] d[15..11] [00000100101].
   kMipsMovz,  // movz d,s,t [000000] s[25..21] t[20..16] d[15..11] [00000001010].
+  kMipsMovn,  // movn d,s,t [000000] s[25..21] t[20..16] d[15..11] [00000001011].
   kMipsMul,   // mul d,s,t [011100] s[25..21] t[20..16] d[15..11] [00000000010].
+  kMipsMult,  // mult s,t [000000] s[25..21] t[20..16] [0000000000011000].
   kMipsNop,   // nop [00000000000000000000000000000000].
   kMipsNor,   // nor d,s,t [000000] s[25..21] t[20..16] d[15..11] [00000100111].
   kMipsOr,    // or d,s,t [000000] s[25..21] t[20..16] d[15..11] [00000100101].
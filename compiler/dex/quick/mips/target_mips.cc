@@ -32,9 +32,12 @@ static int ReservedRegs[] = {r_ZERO, r_AT, r_S0, r_S1, r_K0, r_K1, r_GP, r_SP,
 static int core_temps[] = {r_V0, r_V1, r_A0, r_A1, r_A2, r_A3, r_T0, r_T1, r_T2,
                            r_T3, r_T4, r_T5, r_T6, r_T7, r_T8};
 static int FpRegs[] = {r_F0, r_F1, r_F2, r_F3, r_F4, r_F5, r_F6, r_F7,
-                       r_F8, r_F9, r_F10, r_F11, r_F12, r_F13, r_F14, r_F15};
+                       r_F8, r_F9, r_F10, r_F11, r_F12, r_F13, r_F14, r_F15,
+                       r_F16, r_F17, r_F18, r_F19, r_F20, r_F21, r_F22, r_F23,
+                       r_F24, r_F25, r_F26, r_F27, r_F28, r_F29, r_F30, r_F31};
 static int fp_temps[] = {r_F0, r_F1, r_F2, r_F3, r_F4, r_F5, r_F6, r_F7,
-                         r_F8, r_F9, r_F10, r_F11, r_F12, r_F13, r_F14, r_F15};
+                         r_F8, r_F9, r_F10, r_F11, r_F12, r_F13, r_F14, r_F15,
+                         r_F16, r_F17, r_F18, r_F19};
 
 RegLocation MipsMir2Lir::LocCReturn() {
   RegLocation res = MIPS_LOC_C_RETURN;
@@ -108,7 +111,14 @@ uint64_t MipsMir2Lir::GetRegMaskCommon(int reg) {
   reg_id = reg & 0x1f;
   /* Each double register is equal to a pair of single-precision FP registers */
   seed = MIPS_DOUBLEREG(reg) ? 3 : 1;
-  /* FP register starts at bit position 16 */
+  /*
+   * FP register starts at bit position 32.  There are only 16 positions for
+   * the 32 fp registers, so $fN and $f(N+16) share one: a conservative mask
+   * that can only add dependencies.
+   */
+  if (MIPS_FPREG(reg)) {
+    reg_id &= 0xf;
+  }
   shift = MIPS_FPREG(reg) ? kMipsFPReg0 : 0;
   /* Expand the double register id into single offset */
   shift += reg_id;
@@ -300,13 +310,24 @@ void MipsMir2Lir::AdjustSpillMask() {
 }
 
 /*
- * Mark a callee-save fp register as promoted.  Note that
- * vpush/vpop uses contiguous register lists so we must
+ * Mark a callee-save fp register as promoted.  As on Arm, the
+ * spilled registers are a contiguous run from $f20, so we must
  * include any holes in the mask.  Associate holes with
  * Dalvik register INVALID_VREG (0xFFFFU).
  */
-void MipsMir2Lir::MarkPreservedSingle(int s_reg, int reg) {
-  LOG(FATAL) << "No support yet for promoted FP regs";
+void MipsMir2Lir::MarkPreservedSingle(int v_reg, int reg) {
+  DCHECK_GE(reg, MIPS_FP_REG_OFFSET + MIPS_FP_CALLEE_SAVE_BASE);
+  reg = (reg & MIPS_FP_REG_MASK) - MIPS_FP_CALLEE_SAVE_BASE;
+  // Ensure fp_vmap_table is large enough
+  int table_size = fp_vmap_table_.size();
+  for (int i = table_size; i < (reg + 1); i++) {
+    fp_vmap_table_.push_back(INVALID_VREG);
+  }
+  // Add the current mapping
+  fp_vmap_table_[reg] = v_reg;
+  // Size of fp_vmap_table is high-water mark, use to set mask
+  num_fp_spills_ = fp_vmap_table_.size();
+  fp_spill_mask_ = ((1 << num_fp_spills_) - 1) << MIPS_FP_CALLEE_SAVE_BASE;
 }
 
 void MipsMir2Lir::FlushRegWide(int reg1, int reg2) {
@@ -385,6 +406,10 @@ void MipsMir2Lir::ClobberCalleeSave() {
   Clobber(r_F13);
   Clobber(r_F14);
   Clobber(r_F15);
+  Clobber(r_F16);
+  Clobber(r_F17);
+  Clobber(r_F18);
+  Clobber(r_F19);
 }
 
 RegLocation MipsMir2Lir::GetReturnWideAlt() {
@@ -508,12 +533,17 @@ int MipsMir2Lir::LoadHelper(ThreadOffset offset) {
   return r_T9;
 }
 
+/*
+ * Promoted fp registers are spilled below the core registers, the
+ * lowest-numbered one farthest from the top of the frame, where
+ * MipsContext::FillCalleeSaves looks for them.
+ */
 void MipsMir2Lir::SpillCoreRegs() {
   if (num_core_spills_ == 0) {
     return;
   }
   uint32_t mask = core_spill_mask_;
-  int offset = num_core_spills_ * 4;
+  int offset = (num_core_spills_ + num_fp_spills_) * 4;
   OpRegImm(kOpSub, rMIPS_SP, offset);
   for (int reg = 0; mask; mask >>= 1, reg++) {
     if (mask & 0x1) {
@@ -521,6 +551,9 @@ void MipsMir2Lir::SpillCoreRegs() {
       StoreWordDisp(rMIPS_SP, offset, reg);
     }
   }
+  for (int i = 0; i < num_fp_spills_; i++) {
+    StoreWordDisp(rMIPS_SP, i * 4, r_F0 + MIPS_FP_CALLEE_SAVE_BASE + i);
+  }
 }
 
 void MipsMir2Lir::UnSpillCoreRegs() {
@@ -535,6 +568,10 @@ void MipsMir2Lir::UnSpillCoreRegs() {
       LoadWordDisp(rMIPS_SP, offset, reg);
     }
   }
+  offset -= num_fp_spills_ * 4;
+  for (int i = 0; i < num_fp_spills_; i++) {
+    LoadWordDisp(rMIPS_SP, offset + i * 4, r_F0 + MIPS_FP_CALLEE_SAVE_BASE + i);
+  }
   OpRegImm(kOpAdd, rMIPS_SP, frame_size_);
 }
 
@@ -542,6 +579,14 @@ bool MipsMir2Lir::IsUnconditionalBranch(LIR* lir) {
   return (lir->opcode == kMipsB);
 }
 
+bool MipsMir2Lir::IsMemBarrier(LIR* lir) {
+  return lir->opcode == kMipsSync;
+}
+
+void MipsMir2Lir::MergeMemBarriers(LIR* barrier, LIR* earlier) {
+  // All barriers are full syncs.
+}
+
 MipsMir2Lir::MipsMir2Lir(CompilationUnit* cu, MIRGraph* mir_graph, ArenaAllocator* arena)
     : Mir2Lir(cu, mir_graph, arena) {
   for (int i = 0; i < kMipsLast; i++) {
@@ -81,7 +81,10 @@ void Mir2Lir::CompileDalvikInstruction(MIR* mir, BasicBlock* bb, LIR* label_list
       break;
 
     case Instruction::RETURN_VOID:
-      if (((cu_->access_flags & kAccConstructor) != 0) &&
+      // Final fields can only be assigned by their class's constructors, so one that stores no
+      // fields itself, such as one that only delegates to this(...) or super(...), leaves the
+      // barrier to the constructors it calls.
+      if (((cu_->access_flags & kAccConstructor) != 0) && mir_graph_->MethodStoresFields() &&
           cu_->compiler_driver->RequiresConstructorBarrier(Thread::Current(), cu_->dex_file,
                                                           cu_->class_def_idx)) {
         GenMemBarrier(kStoreStore);
@@ -184,7 +187,9 @@ void Mir2Lir::CompileDalvikInstruction(MIR* mir, BasicBlock* bb, LIR* label_list
       break;
 
     case Instruction::CHECK_CAST: {
-      GenCheckCast(mir->offset, vB, rl_src[0]);
+      if (!(opt_flags & MIR_IGNORE_CHECK_CAST)) {
+        GenCheckCast(mir->offset, vB, rl_src[0]);
+      }
       break;
     }
     case Instruction::INSTANCE_OF:
@@ -247,11 +252,11 @@ void Mir2Lir::CompileDalvikInstruction(MIR* mir, BasicBlock* bb, LIR* label_list
       break;
 
     case Instruction::PACKED_SWITCH:
-      GenPackedSwitch(mir, vB, rl_src[0]);
+      GenPackedSwitch(mir, cu_->insns + current_dalvik_offset_ + vB, rl_src[0]);
       break;
 
     case Instruction::SPARSE_SWITCH:
-      GenSparseSwitch(mir, vB, rl_src[0]);
+      LowerSparseSwitch(mir, bb, cu_->insns + current_dalvik_offset_ + vB, rl_src[0]);
       break;
 
     case Instruction::CMPL_FLOAT:
@@ -542,12 +547,20 @@ void Mir2Lir::CompileDalvikInstruction(MIR* mir, BasicBlock* bb, LIR* label_list
       }
       break;
 
-    case Instruction::SUB_INT:
-    case Instruction::SUB_INT_2ADDR:
     case Instruction::DIV_INT:
     case Instruction::DIV_INT_2ADDR:
     case Instruction::REM_INT:
     case Instruction::REM_INT_2ADDR:
+      // Even an expensive constant divisor is cheaper to divide by than a call.
+      if (rl_src[1].is_const) {
+        GenArithOpIntLit(opcode, rl_dest, rl_src[0], mir_graph_->ConstantValue(rl_src[1]));
+      } else {
+        GenArithOpInt(opcode, rl_dest, rl_src[0], rl_src[1]);
+      }
+      break;
+
+    case Instruction::SUB_INT:
+    case Instruction::SUB_INT_2ADDR:
     case Instruction::SHL_INT:
     case Instruction::SHL_INT_2ADDR:
     case Instruction::SHR_INT:
@@ -680,11 +693,79 @@ void Mir2Lir::HandleExtendedMethodMIR(BasicBlock* bb, MIR* mir) {
     case kMirOpSelect:
       GenSelect(bb, mir);
       break;
+    case kMirOpVectorLoop:
+      GenVectorLoop(mir);
+      break;
     default:
       break;
   }
 }
 
+/*
+ * Let the interpreter continue a method in its code at a loop header (on-stack replacement).
+ * The interpreter points Thread::osr_vregs_ at its shadow frame's vregs and calls the code with
+ * osr_dex_pc_ set to the header. After the frame is set up, the code takes the request, copies
+ * every Dalvik register to its home location and to the register it is promoted to, and
+ * branches to the header's block. At a block's start the registers are in exactly those
+ * places, so nothing else needs fixing up.
+ */
+void Mir2Lir::GenOsrEntry() {
+  // Compiler temps have no place in the shadow frame, and only Thumb2 is wired up for now.
+  if (cu_->instruction_set != kThumb2 || !cu_->compiler_driver->GeneratesOsrEntries() ||
+      cu_->num_compiler_temps > 0) {
+    return;
+  }
+  // A loop header is a block that a block at or after it branches back to.
+  SafeMap<uint32_t, BasicBlock*> headers;
+  PreOrderDfsIterator iter(mir_graph_, false /* not iterative */);
+  for (BasicBlock* bb = iter.Next(); bb != NULL; bb = iter.Next()) {
+    if (bb->block_type != kDalvikByteCode || bb->catch_entry) {
+      continue;
+    }
+    GrowableArray<BasicBlock*>::Iterator pred_iter(bb->predecessors);
+    for (BasicBlock* pred = pred_iter.Next(); pred != NULL; pred = pred_iter.Next()) {
+      if (pred->block_type == kDalvikByteCode && pred->start_offset >= bb->start_offset) {
+        headers.Overwrite(bb->start_offset, bb);
+        break;
+      }
+    }
+  }
+  if (headers.empty()) {
+    return;
+  }
+  const int osr_vregs_offset = Thread::OsrVRegsOffset().Int32Value();
+  int r_vregs = AllocTemp();
+  LoadWordDisp(TargetReg(kSelf), osr_vregs_offset, r_vregs);
+  LIR* no_osr = OpCmpImmBranch(kCondEq, r_vregs, 0, NULL);
+  // Clear the request so that the methods this one calls are entered from the top.
+  int r_val = AllocTemp();
+  LoadConstant(r_val, 0);
+  StoreWordDisp(TargetReg(kSelf), osr_vregs_offset, r_val);
+  for (int v = 0; v < cu_->num_dalvik_registers; ++v) {
+    LoadWordDisp(r_vregs, v * sizeof(uint32_t), r_val);
+    StoreWordDisp(TargetReg(kSp), VRegOffset(v), r_val);
+    if (promotion_map_[v].core_location == kLocPhysReg) {
+      OpRegCopy(promotion_map_[v].core_reg, r_val);
+    }
+    if (promotion_map_[v].fp_location == kLocPhysReg) {
+      OpRegCopy(promotion_map_[v].FpReg, r_val);
+    }
+  }
+  LoadWordDisp(TargetReg(kSelf), Thread::OsrDexPcOffset().Int32Value(), r_val);
+  // The interpreter only asks for headers we have, so the last one needs no compare.
+  BasicBlock* last_header = (--headers.end())->second;
+  for (const std::pair<const uint32_t, BasicBlock*>& header : headers) {
+    osr_dex_pcs_.push_back(header.first);
+    if (header.second != last_header) {
+      OpCmpImmBranch(kCondEq, r_val, header.first, &block_label_list_[header.second->id]);
+    }
+  }
+  OpUnconditionalBranch(&block_label_list_[last_header->id]);
+  no_osr->target = NewLIR0(kPseudoTargetLabel);
+  FreeTemp(r_vregs);
+  FreeTemp(r_val);
+}
+
 // Handle the content in each basic block.
 bool Mir2Lir::MethodBlockCodeGen(BasicBlock* bb) {
   if (bb->block_type == kDead) return false;
@@ -694,6 +775,11 @@ bool Mir2Lir::MethodBlockCodeGen(BasicBlock* bb) {
 
   block_label_list_[block_id].operands[0] = bb->start_offset;
 
+  // Align the heads of x86 loops so that the loop body doesn't start late in a fetch block.
+  if ((cu_->instruction_set == kX86) && IsLoopHead(bb)) {
+    NewLIR1(kPseudoLoopHeadAlign, 0);
+  }
+
   // Insert the block label.
   block_label_list_[block_id].opcode = kPseudoNormalBlockLabel;
   AppendLIR(&block_label_list_[block_id]);
@@ -709,12 +795,16 @@ bool Mir2Lir::MethodBlockCodeGen(BasicBlock* bb) {
   ResetRegPool();
   ResetDefTracking();
 
-  ClobberAllRegs();
+  // The frameless block only follows the entry, so it can use the arguments left live there.
+  if (bb != frameless_block_) {
+    ClobberAllRegs();
+  }
 
   if (bb->block_type == kEntryBlock) {
     int start_vreg = cu_->num_dalvik_registers - cu_->num_ins;
     GenEntrySequence(&mir_graph_->reg_location_[start_vreg],
                          mir_graph_->reg_location_[mir_graph_->GetMethodSReg()]);
+    GenOsrEntry();
   } else if (bb->block_type == kExitBlock) {
     GenExitSequence();
   }
@@ -809,12 +899,55 @@ void Mir2Lir::SpecialMIR2LIR(SpecialCaseHandler special_case) {
   GenSpecialCase(bb, mir, special_case);
 }
 
+/*
+ * A leaf method whose code is a single block, entered from nowhere but the method entry, can do
+ * without a frame if that block keeps all its values in registers, calls nothing and can't
+ * throw.  Returns the block for RemoveFrame to check once it has been compiled, or NULL.
+ */
+BasicBlock* Mir2Lir::FindFramelessBlock() {
+  if (cu_->instruction_set != kThumb2 || (cu_->disable_opt & (1 << kFramelessLeafMethods)) ||
+      !mir_graph_->MethodIsLeaf()) {
+    return NULL;
+  }
+  BasicBlock* code_block = NULL;
+  PreOrderDfsIterator iter(mir_graph_, false /* not iterative */);
+  for (BasicBlock* bb = iter.Next(); bb != NULL; bb = iter.Next()) {
+    if (bb->block_type == kDalvikByteCode) {
+      if (code_block != NULL) {
+        return NULL;
+      }
+      code_block = bb;
+    }
+  }
+  if (code_block == NULL || code_block->catch_entry || code_block->predecessors->Size() != 1 ||
+      code_block->predecessors->Get(0)->block_type != kEntryBlock) {
+    return NULL;
+  }
+  return code_block;
+}
+
+bool Mir2Lir::IsLoopHead(BasicBlock* bb) {
+  if (bb->block_type != kDalvikByteCode) {
+    return false;
+  }
+  GrowableArray<BasicBlock*>::Iterator iter(bb->predecessors);
+  for (BasicBlock* pred_bb = iter.Next(); pred_bb != NULL; pred_bb = iter.Next()) {
+    if (mir_graph_->IsBackedge(pred_bb, bb) &&
+        ((pred_bb->taken == bb) || (pred_bb->fall_through == bb))) {
+      return true;
+    }
+  }
+  return false;
+}
+
 void Mir2Lir::MethodMIR2LIR() {
   // Hold the labels of each block.
   block_label_list_ =
       static_cast<LIR*>(arena_->Alloc(sizeof(LIR) * mir_graph_->GetNumBlocks(),
                                       ArenaAllocator::kAllocLIR));
 
+  frameless_block_ = FindFramelessBlock();
+
   PreOrderDfsIterator iter(mir_graph_, false /* not iterative */);
   for (BasicBlock* bb = iter.Next(); bb != NULL; bb = iter.Next()) {
     MethodBlockCodeGen(bb);
@@ -829,6 +962,10 @@ void Mir2Lir::MethodMIR2LIR() {
   if (!(cu_->disable_opt & (1 << kSafeOptimizations))) {
     RemoveRedundantBranches();
   }
+
+  if (frameless_block_ != NULL) {
+    RemoveFrame();
+  }
 }
 
 }  // namespace art
@@ -97,6 +97,7 @@ struct CompilationUnit;
 struct MIR;
 struct RegLocation;
 struct RegisterInfo;
+struct VectorLoopInfo;
 class MIRGraph;
 class Mir2Lir;
 
@@ -107,6 +108,10 @@ typedef int (*NextCallInsn)(CompilationUnit*, CallInfo*, int,
 
 typedef std::vector<uint8_t> CodeBuffer;
 
+// Loop heads are aligned to a 16 byte fetch block, unless that takes more than 10 bytes of padding.
+static constexpr int kLoopHeadAlignment = 16;
+static constexpr int kMaxLoopHeadPadding = 10;
+
 
 struct LIR {
   int offset;               // Offset of this instruction.
@@ -170,7 +175,7 @@ class Mir2Lir : public Backend {
   public:
     struct SwitchTable {
       int offset;
-      const uint16_t* table;      // Original dex table.
+      const uint16_t* table;      // Original dex table, or one packed from a sparse table.
       int vaddr;                  // Dalvik offset of switch opcode.
       LIR* anchor;                // Reference instruction for relative offsets.
       LIR** targets;              // Array of case targets.
@@ -190,6 +195,18 @@ class Mir2Lir : public Backend {
       bool double_start;   // Starting v_reg for a double
     };
 
+    /*
+     * Live interval of a promotion map entry for linear scan promotion, spanning its first to
+     * its last def or use in block pre-order.  Positions are -1 if the entry is never live.
+     */
+    struct LiveInterval {
+      int s_reg;
+      int start;
+      int end;
+      int count;           // Use count, the spill weight.
+      bool ref;            // Holds a reference somewhere in the method.
+    };
+
     /*
      * Data structure tracking the mapping between a Dalvik register (pair) and a
      * native register (pair). The idea is to reuse the previously loaded value
@@ -287,6 +304,7 @@ class Mir2Lir : public Backend {
     void InstallFillArrayData();
     bool VerifyCatchEntries();
     void CreateMappingTables();
+    void CreateCatchTable();
     void CreateNativeGcMap();
     int AssignLiteralOffset(int offset);
     int AssignSwitchTablesOffset(int offset);
@@ -301,6 +319,9 @@ class Mir2Lir : public Backend {
     void ConvertMemOpIntoMove(LIR* orig_lir, int dest, int src);
     void ApplyLoadStoreElimination(LIR* head_lir, LIR* tail_lir);
     void ApplyLoadHoisting(LIR* head_lir, LIR* tail_lir);
+    void ScheduleRegion(LIR** region, int region_size, LIR* anchor);
+    void ApplyInstructionScheduling(LIR* head_lir, LIR* tail_lir);
+    void ApplyBarrierElimination(LIR* head_lir, LIR* tail_lir);
     void ApplyLocalOptimizations(LIR* head_lir, LIR* tail_lir);
     void RemoveRedundantBranches();
 
@@ -370,12 +391,15 @@ class Mir2Lir : public Backend {
     void CountRefs(RefCounts* core_counts, RefCounts* fp_counts);
     void DumpCounts(const RefCounts* arr, int size, const char* msg);
     void DoPromotion();
+    void ComputeLiveIntervals(LiveInterval* intervals, int num_regs);
+    void LinearScanCorePromotion(const RefCounts* core_counts, int num_regs, int threshold);
     int VRegOffset(int v_reg);
     int SRegOffset(int s_reg);
     RegLocation GetReturnWide(bool is_double);
     RegLocation GetReturn(bool is_float);
 
     // Shared by all targets - implemented in gen_common.cc.
+    bool HasInlineIntDivide() const;
     bool HandleEasyDivRem(Instruction::Code dalvik_opcode, bool is_div,
                           RegLocation rl_src, RegLocation rl_dest, int lit);
     bool HandleEasyMultiply(RegLocation rl_src, RegLocation rl_dest, int lit);
@@ -387,6 +411,11 @@ class Mir2Lir : public Backend {
     LIR* GenImmedCheck(ConditionCode c_code, int reg, int imm_val,
                        ThrowKind kind);
     LIR* GenNullCheck(int s_reg, int m_reg, int opt_flags);
+    bool UseImplicitNullCheck(int opt_flags, int offset);
+    void MarkImplicitNullCheck(LIR* access);
+    bool UseImplicitStackOverflowCheck();
+    void MarkImplicitStackOverflowCheck(LIR* probe);
+    bool UseImplicitSuspendCheck();
     LIR* GenRegRegCheck(ConditionCode c_code, int reg1, int reg2,
                         ThrowKind kind);
     void GenCompareAndBranch(Instruction::Code opcode, RegLocation rl_src1,
@@ -415,10 +444,13 @@ class Mir2Lir : public Backend {
                        RegLocation rl_src);
     void GenCheckCast(uint32_t insn_idx, uint32_t type_idx,
                       RegLocation rl_src);
+    // Picks a jump table, a binary search or the target's table scan for a sparse switch.
+    void LowerSparseSwitch(MIR* mir, BasicBlock* bb, const uint16_t* table, RegLocation rl_src);
     void GenLong3Addr(OpKind first_op, OpKind second_op, RegLocation rl_dest,
                       RegLocation rl_src1, RegLocation rl_src2);
-    void GenShiftOpLong(Instruction::Code opcode, RegLocation rl_dest,
-                        RegLocation rl_src1, RegLocation rl_shift);
+    // Calls out to the runtime by default.
+    virtual void GenShiftOpLong(Instruction::Code opcode, RegLocation rl_dest,
+                                RegLocation rl_src1, RegLocation rl_shift);
     void GenArithOpInt(Instruction::Code opcode, RegLocation rl_dest,
                        RegLocation rl_src1, RegLocation rl_src2);
     void GenArithOpIntLit(Instruction::Code opcode, RegLocation rl_dest,
@@ -429,6 +461,7 @@ class Mir2Lir : public Backend {
                            RegLocation rl_src);
     void GenSuspendTest(int opt_flags);
     void GenSuspendTestAndBranch(int opt_flags, LIR* target);
+    void GenVectorLoop(MIR* mir);
 
     // Shared by all targets - implemented in gen_invoke.cc.
     int CallHelperSetup(ThreadOffset helper_offset);
@@ -488,6 +521,10 @@ class Mir2Lir : public Backend {
     bool GenInlinedDoubleCvt(CallInfo* info);
     bool GenInlinedIndexOf(CallInfo* info, bool zero_based);
     bool GenInlinedStringCompareTo(CallInfo* info);
+    bool GenInlinedStringEquals(CallInfo* info);
+    bool GenInlinedArrayCopyCharArray(CallInfo* info);
+    bool GenInlinedIdentityHashCode(CallInfo* info);
+    bool GenInlinedArrayFill(CallInfo* info, bool is_char);
     bool GenInlinedCurrentThread(CallInfo* info);
     bool GenInlinedUnsafeGet(CallInfo* info, bool is_long, bool is_volatile);
     bool GenInlinedUnsafePut(CallInfo* info, bool is_long, bool is_object,
@@ -519,13 +556,18 @@ class Mir2Lir : public Backend {
     void CompileDalvikInstruction(MIR* mir, BasicBlock* bb, LIR* label_list);
     void HandleExtendedMethodMIR(BasicBlock* bb, MIR* mir);
     bool MethodBlockCodeGen(BasicBlock* bb);
+    // Whether a branch back to the block closes a loop.
+    bool IsLoopHead(BasicBlock* bb);
+    void GenOsrEntry();
     void SpecialMIR2LIR(SpecialCaseHandler special_case);
+    BasicBlock* FindFramelessBlock();
     void MethodMIR2LIR();
 
 
 
     // Required for target - codegen helpers.
-    virtual bool SmallLiteralDivRem(Instruction::Code dalvik_opcode, bool is_div,
+    // Divides by a constant that is not a power of two by multiplying by its reciprocal.
+    virtual bool MagicLiteralDivRem(Instruction::Code dalvik_opcode, bool is_div,
                                     RegLocation rl_src, RegLocation rl_dest, int lit) = 0;
     virtual int LoadHelper(ThreadOffset offset) = 0;
     virtual LIR* LoadBaseDisp(int rBase, int displacement, int r_dest, OpSize size, int s_reg) = 0;
@@ -571,6 +613,11 @@ class Mir2Lir : public Backend {
 
     // Required for target - miscellaneous.
     virtual AssemblerStatus AssembleInstructions(uintptr_t start_addr) = 0;
+    // Fixes up out-of-range pc-relative instructions ahead of assembly, returning the number of
+    // passes taken. Targets without a relaxation pass rely on AssembleInstructions retrying.
+    virtual int RelaxInstructions() { return 0; }
+    // Cycles before an instruction's result can be used without stalling, for scheduling.
+    virtual int GetInstructionLatency(LIR* lir) { return 1; }
     virtual void DumpResourceMask(LIR* lir, uint64_t mask, const char* prefix) = 0;
     virtual void SetupTargetResourceMasks(LIR* lir) = 0;
     virtual const char* GetTargetInstFmt(int opcode) = 0;
@@ -580,6 +627,9 @@ class Mir2Lir : public Backend {
     virtual uint64_t GetTargetInstFlags(int opcode) = 0;
     virtual int GetInsnSize(LIR* lir) = 0;
     virtual bool IsUnconditionalBranch(LIR* lir) = 0;
+    virtual bool IsMemBarrier(LIR* lir) = 0;
+    // Strengthens barrier to order everything earlier did too.
+    virtual void MergeMemBarriers(LIR* barrier, LIR* earlier) = 0;
 
     // Required for target - Dalvik-level generators.
     virtual void GenArithImmOpLong(Instruction::Code opcode, RegLocation rl_dest,
@@ -600,6 +650,7 @@ class Mir2Lir : public Backend {
     virtual void GenConversion(Instruction::Code opcode, RegLocation rl_dest,
                                RegLocation rl_src) = 0;
     virtual bool GenInlinedCas32(CallInfo* info, bool need_write_barrier) = 0;
+    virtual bool GenInlinedCas64(CallInfo* info) = 0;
     virtual bool GenInlinedMinMaxInt(CallInfo* info, bool is_min) = 0;
     virtual bool GenInlinedSqrt(CallInfo* info) = 0;
     virtual void GenNegLong(RegLocation rl_dest, RegLocation rl_src) = 0;
@@ -627,6 +678,10 @@ class Mir2Lir : public Backend {
                                      bool is_double) = 0;
     virtual void GenFusedLongCmpBranch(BasicBlock* bb, MIR* mir) = 0;
     virtual void GenSelect(BasicBlock* bb, MIR* mir) = 0;
+    // Run the iterations of a vector loop, r_count of them from r_index, and leave in r_index
+    // the index the scalar loop continues from.  r_arrays may be changed.
+    virtual void GenVectorLoopBody(const VectorLoopInfo* info, int r_index, int r_count,
+                                   int* r_arrays) = 0;
     virtual void GenMemBarrier(MemBarrierKind barrier_kind) = 0;
     virtual void GenMonitorEnter(int opt_flags, RegLocation rl_src) = 0;
     virtual void GenMonitorExit(int opt_flags, RegLocation rl_src) = 0;
@@ -636,12 +691,14 @@ class Mir2Lir : public Backend {
                                                int second_bit) = 0;
     virtual void GenNegDouble(RegLocation rl_dest, RegLocation rl_src) = 0;
     virtual void GenNegFloat(RegLocation rl_dest, RegLocation rl_src) = 0;
-    virtual void GenPackedSwitch(MIR* mir, uint32_t table_offset,
+    virtual void GenPackedSwitch(MIR* mir, const uint16_t* table,
                                  RegLocation rl_src) = 0;
-    virtual void GenSparseSwitch(MIR* mir, uint32_t table_offset,
+    virtual void GenSparseSwitch(MIR* mir, const uint16_t* table,
                                  RegLocation rl_src) = 0;
     virtual void GenSpecialCase(BasicBlock* bb, MIR* mir,
                                 SpecialCaseHandler special_case) = 0;
+    // Drops the frame of a method found by FindFramelessBlock if its code never used it.
+    virtual bool RemoveFrame() = 0;
     virtual void GenArrayObjPut(int opt_flags, RegLocation rl_array,
                                 RegLocation rl_index, RegLocation rl_src, int scale) = 0;
     virtual void GenArrayGet(int opt_flags, OpSize size, RegLocation rl_array,
@@ -675,6 +732,7 @@ class Mir2Lir : public Backend {
     virtual LIR* OpRegRegReg(OpKind op, int r_dest, int r_src1,
                              int r_src2) = 0;
     virtual LIR* OpTestSuspend(LIR* target) = 0;
+    virtual LIR* OpSuspendPoll() = 0;
     virtual LIR* OpThreadMem(OpKind op, ThreadOffset thread_offset) = 0;
     virtual LIR* OpVldm(int rBase, int count) = 0;
     virtual LIR* OpVstm(int rBase, int count) = 0;
@@ -706,6 +764,19 @@ class Mir2Lir : public Backend {
                                     bool can_assume_type_is_in_dex_cache,
                                     uint32_t type_idx, RegLocation rl_dest,
                                     RegLocation rl_src);
+    // Returns a branch, to be targeted, taken when the class in obj_class_reg is a subclass of
+    // the one in class_reg according to its superclass display. Falls through when it isn't or
+    // the display can't tell. Clobbers temp_reg.
+    LIR* GenSuperClassDisplayCheck(int obj_class_reg, int class_reg, int temp_reg);
+    // Returns a packed switch table covering the keys of a sparse one, the keys it lacks going to
+    // default_target.
+    const uint16_t* MakePackedSwitchTable(const uint16_t* sparse_table, int default_target);
+    // Branches to the case of the key in reg among keys[low, high), or to default_label.
+    void GenSparseSwitchSearch(int reg, const int32_t* keys, const int32_t* targets, int low,
+                               int high, LIR* default_label);
+    // Returns a temp holding the static storage base in the dex cache slot ssb_index, which is
+    // known to be filled in.
+    int LoadInitializedStaticStorage(int ssb_index);
 
     void ClobberBody(RegisterInfo* p);
     void ResetDefBody(RegisterInfo* p) {
@@ -739,9 +810,13 @@ class Mir2Lir : public Backend {
      * immediately preceed the instruction.
      */
     std::vector<uint32_t> dex2pc_mapping_table_;
+    // Dex PCs of the loop headers GenOsrEntry lets the interpreter enter the code at, sorted.
+    std::vector<uint32_t> osr_dex_pcs_;
     int data_offset_;                     // starting offset of literal pool.
     int total_size_;                      // header + code size.
     LIR* block_label_list_;
+    // The code block of a leaf method that may do without a frame, see FindFramelessBlock.
+    BasicBlock* frameless_block_;
     PromotionMap* promotion_map_;
     /*
      * TODO: The code generation utilities don't have a built-in
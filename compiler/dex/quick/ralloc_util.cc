@@ -18,6 +18,7 @@
 
 #include "dex/compiler_ir.h"
 #include "dex/compiler_internals.h"
+#include "dex/dataflow_iterator-inl.h"
 #include "mir_to_lir-inl.h"
 
 namespace art {
@@ -946,6 +947,193 @@ void Mir2Lir::DumpCounts(const RefCounts* arr, int size, const char* msg) {
   }
 }
 
+static void ExtendLiveInterval(Mir2Lir::LiveInterval* interval, int pos) {
+  if (interval->start < 0) {
+    interval->start = pos;
+    interval->end = pos;
+  } else {
+    interval->start = std::min(interval->start, pos);
+    interval->end = std::max(interval->end, pos);
+  }
+}
+
+/*
+ * Build a live interval for every promotion map entry.  Each block is given a
+ * start and an end position around those of its instructions, and the Dalvik
+ * register live-in sets computed for phi pruning say which registers are live
+ * across the block boundaries.  The result is the convex hull of everywhere a
+ * register is live, so two intervals which don't overlap can share a register.
+ */
+void Mir2Lir::ComputeLiveIntervals(LiveInterval* intervals, int num_regs) {
+  int dalvik_regs = cu_->num_dalvik_registers;
+  for (int i = 0; i < num_regs; i++) {
+    intervals[i].start = -1;
+    intervals[i].end = -1;
+  }
+  // Incoming arguments are copied to their homes on entry, before any block.
+  for (int i = dalvik_regs - cu_->num_ins; i < dalvik_regs; i++) {
+    ExtendLiveInterval(&intervals[i], 0);
+  }
+  int pos = 1;
+  ArenaBitVector* live_out =
+      new (arena_) ArenaBitVector(arena_, dalvik_regs, false, kBitMapRegisterV);
+  PreOrderDfsIterator iter(mir_graph_, false /* not iterative */);
+  for (BasicBlock* bb = iter.Next(); bb != NULL; bb = iter.Next()) {
+    if ((bb->data_flow_info == NULL) || (bb->data_flow_info->live_in_v == NULL)) {
+      continue;
+    }
+    int block_start = pos++;
+    ArenaBitVector::Iterator live_in_iter(bb->data_flow_info->live_in_v);
+    for (int v_reg = live_in_iter.Next(); v_reg != -1; v_reg = live_in_iter.Next()) {
+      ExtendLiveInterval(&intervals[v_reg], block_start);
+    }
+    for (MIR* mir = bb->first_mir_insn; mir != NULL; mir = mir->next) {
+      int opcode = mir->dalvikInsn.opcode;
+      if (opcode == kMirOpPhi) {
+        continue;
+      }
+      int mir_pos = pos++;
+      // The check half of a throwing instruction emits the whole instruction.
+      MIR* ops = (opcode == kMirOpCheck) ? mir->meta.throw_insn : mir;
+      SSARepresentation* ssa_rep = ops->ssa_rep;
+      if (ssa_rep == NULL) {
+        continue;
+      }
+      for (int i = 0; i < ssa_rep->num_uses; i++) {
+        ExtendLiveInterval(&intervals[SRegToPMap(ssa_rep->uses[i])], mir_pos);
+      }
+      for (int i = 0; i < ssa_rep->num_defs; i++) {
+        ExtendLiveInterval(&intervals[SRegToPMap(ssa_rep->defs[i])], mir_pos);
+      }
+    }
+    int block_end = pos++;
+    live_out->ClearAllBits();
+    if ((bb->taken != NULL) && (bb->taken->data_flow_info != NULL)) {
+      live_out->Union(bb->taken->data_flow_info->live_in_v);
+    }
+    if ((bb->fall_through != NULL) && (bb->fall_through->data_flow_info != NULL)) {
+      live_out->Union(bb->fall_through->data_flow_info->live_in_v);
+    }
+    if (bb->successor_block_list.block_list_type != kNotUsed) {
+      GrowableArray<SuccessorBlockInfo*>::Iterator succ_iter(bb->successor_block_list.blocks);
+      for (SuccessorBlockInfo* info = succ_iter.Next(); info != NULL; info = succ_iter.Next()) {
+        if (info->block->data_flow_info != NULL) {
+          live_out->Union(info->block->data_flow_info->live_in_v);
+        }
+      }
+    }
+    ArenaBitVector::Iterator live_out_iter(live_out);
+    for (int v_reg = live_out_iter.Next(); v_reg != -1; v_reg = live_out_iter.Next()) {
+      ExtendLiveInterval(&intervals[v_reg], block_end);
+    }
+  }
+  for (int i = 0; i < mir_graph_->GetNumSSARegs(); i++) {
+    if (mir_graph_->reg_location_[i].ref) {
+      intervals[SRegToPMap(i)].ref = true;
+    }
+  }
+  /*
+   * The vmap table maps each callee-save register to a single Dalvik
+   * register for the GC, so references must keep their register to
+   * themselves.  Method* and compiler temps have no live-in information.
+   */
+  for (int i = 0; i < num_regs; i++) {
+    if (intervals[i].ref || (i >= dalvik_regs)) {
+      intervals[i].start = 0;
+      intervals[i].end = pos;
+    }
+  }
+}
+
+/* qsort callback function, sort by ascending start position */
+static int SortIntervals(const void *val1, const void *val2) {
+  const Mir2Lir::LiveInterval* op1 = reinterpret_cast<const Mir2Lir::LiveInterval*>(val1);
+  const Mir2Lir::LiveInterval* op2 = reinterpret_cast<const Mir2Lir::LiveInterval*>(val2);
+  return (op1->start == op2->start) ? (op1->s_reg - op2->s_reg) : (op1->start - op2->start);
+}
+
+/*
+ * Linear scan promotion of core registers: callee-save registers are handed
+ * out to live intervals in order of their start, and a register whose
+ * interval has ended is reused.  When none is free the interval with the
+ * lowest use count among the current one and the active ones goes to memory.
+ * Only the first Dalvik register given a callee-save is recorded in the vmap
+ * table, the debugger sees the frame slots of the others sharing it.
+ */
+void Mir2Lir::LinearScanCorePromotion(const RefCounts* core_counts, int num_regs,
+                                      int threshold) {
+  LiveInterval* intervals =
+      static_cast<LiveInterval*>(arena_->Alloc(sizeof(LiveInterval) * num_regs,
+                                               ArenaAllocator::kAllocRegAlloc));
+  ComputeLiveIntervals(intervals, num_regs);
+  for (int i = 0; i < num_regs; i++) {
+    LiveInterval* interval = &intervals[SRegToPMap(core_counts[i].s_reg)];
+    interval->s_reg = core_counts[i].s_reg;
+    interval->count = core_counts[i].count;
+  }
+  qsort(intervals, num_regs, sizeof(LiveInterval), SortIntervals);
+
+  std::vector<int> free_regs;
+  RegisterInfo* core_regs = reg_pool_->core_regs;
+  for (int i = reg_pool_->num_core_regs - 1; i >= 0; i--) {
+    if (!core_regs[i].is_temp && !core_regs[i].in_use) {
+      free_regs.push_back(core_regs[i].reg);
+    }
+  }
+  // Interval index to promoted register, -1 if left in memory.
+  std::vector<int> assigned(num_regs, -1);
+  std::vector<int> active;
+  for (int i = 0; i < num_regs; i++) {
+    LiveInterval* cur = &intervals[i];
+    if ((cur->start < 0) || (cur->count < threshold)) {
+      continue;
+    }
+    for (size_t j = 0; j < active.size();) {
+      if (intervals[active[j]].end < cur->start) {
+        free_regs.push_back(assigned[active[j]]);
+        active.erase(active.begin() + j);
+      } else {
+        j++;
+      }
+    }
+    if (free_regs.empty()) {
+      int victim = i;
+      size_t victim_idx = active.size();
+      for (size_t j = 0; j < active.size(); j++) {
+        LiveInterval* other = &intervals[active[j]];
+        if ((other->count < intervals[victim].count) ||
+            ((other->count == intervals[victim].count) && (other->end > intervals[victim].end))) {
+          victim = active[j];
+          victim_idx = j;
+        }
+      }
+      if (victim == i) {
+        continue;
+      }
+      free_regs.push_back(assigned[victim]);
+      assigned[victim] = -1;
+      active.erase(active.begin() + victim_idx);
+    }
+    assigned[i] = free_regs.back();
+    free_regs.pop_back();
+    active.push_back(i);
+  }
+
+  for (int i = 0; i < num_regs; i++) {
+    int reg = assigned[i];
+    if (reg < 0) {
+      continue;
+    }
+    if (!GetRegInfo(reg)->in_use) {
+      RecordCorePromotion(reg, intervals[i].s_reg);
+    } else {
+      int p_map_idx = SRegToPMap(intervals[i].s_reg);
+      promotion_map_[p_map_idx].core_location = kLocPhysReg;
+      promotion_map_[p_map_idx].core_reg = reg;
+    }
+  }
+}
+
 /*
  * Note: some portions of this code required even if the kPromoteRegs
  * optimization is disabled.
@@ -967,8 +1155,8 @@ void Mir2Lir::DoPromotion() {
    * preference to fp doubles - which must be allocated sequential
    * physical single fp registers started with an even-numbered
    * reg.
-   * TUNING: replace with linear scan once we have the ability
-   * to describe register live ranges for GC.
+   * When linear_scan_promotion is set, core registers are instead
+   * given out by live interval, see LinearScanCorePromotion.
    */
   RefCounts *core_regs =
       static_cast<RefCounts*>(arena_->Alloc(sizeof(RefCounts) * num_regs,
@@ -1027,14 +1215,18 @@ void Mir2Lir::DoPromotion() {
     }
 
     // Promote core regs
-    for (int i = 0; (i < num_regs) &&
-            (core_regs[i].count >= promotion_threshold); i++) {
-      int p_map_idx = SRegToPMap(core_regs[i].s_reg);
-      if (promotion_map_[p_map_idx].core_location !=
-          kLocPhysReg) {
-        int reg = AllocPreservedCoreReg(core_regs[i].s_reg);
-        if (reg < 0) {
-           break;  // No more left
+    if (cu_->linear_scan_promotion) {
+      LinearScanCorePromotion(core_regs, num_regs, promotion_threshold);
+    } else {
+      for (int i = 0; (i < num_regs) &&
+              (core_regs[i].count >= promotion_threshold); i++) {
+        int p_map_idx = SRegToPMap(core_regs[i].s_reg);
+        if (promotion_map_[p_map_idx].core_location !=
+            kLocPhysReg) {
+          int reg = AllocPreservedCoreReg(core_regs[i].s_reg);
+          if (reg < 0) {
+             break;  // No more left
+          }
         }
       }
     }
@@ -27,13 +27,17 @@ void X86Mir2Lir::GenSpecialCase(BasicBlock* bb, MIR* mir,
   // TODO
 }
 
+bool X86Mir2Lir::RemoveFrame() {
+  // TODO
+  return false;
+}
+
 /*
  * The sparse table in the literal pool is an array of <key,displacement>
  * pairs.
  */
-void X86Mir2Lir::GenSparseSwitch(MIR* mir, uint32_t table_offset,
+void X86Mir2Lir::GenSparseSwitch(MIR* mir, const uint16_t* table,
                                  RegLocation rl_src) {
-  const uint16_t* table = cu_->insns + current_dalvik_offset_ + table_offset;
   if (cu_->verbose) {
     DumpSparseSwitchTable(table);
   }
@@ -66,9 +70,8 @@ void X86Mir2Lir::GenSparseSwitch(MIR* mir, uint32_t table_offset,
  * jmp  r_start_of_method
  * done:
  */
-void X86Mir2Lir::GenPackedSwitch(MIR* mir, uint32_t table_offset,
+void X86Mir2Lir::GenPackedSwitch(MIR* mir, const uint16_t* table,
                                  RegLocation rl_src) {
-  const uint16_t* table = cu_->insns + current_dalvik_offset_ + table_offset;
   if (cu_->verbose) {
     DumpPackedSwitchTable(table);
   }
@@ -223,22 +226,30 @@ void X86Mir2Lir::GenEntrySequence(RegLocation* ArgLocs, RegLocation rl_method) {
   LockTemp(rX86_ARG1);
   LockTemp(rX86_ARG2);
 
-  /* Build frame, return address already on stack */
-  // TODO: 64 bit.
-  OpRegImm(kOpSub, rX86_SP, frame_size_ - 4);
-
   /*
    * We can safely skip the stack overflow check if we're
    * a leaf *and* our frame size < fudge factor.
    */
   const bool skip_overflow_check = (mir_graph_->MethodIsLeaf() &&
       (static_cast<size_t>(frame_size_) < Thread::kStackOverflowReservedBytes));
+  const bool implicit_overflow_check = !skip_overflow_check && UseImplicitStackOverflowCheck();
+  if (implicit_overflow_check) {
+    // cmp rX86_ARG0, [esp - probe] while esp still points at the return address, so a fault
+    // throws from the caller.
+    int probe_offset = -static_cast<int>(Thread::kStackOverflowProbeBytes);
+    MarkImplicitStackOverflowCheck(OpRegMem(kOpCmp, rX86_ARG0, rX86_SP, probe_offset));
+  }
+
+  /* Build frame, return address already on stack */
+  // TODO: 64 bit.
+  OpRegImm(kOpSub, rX86_SP, frame_size_ - 4);
+
   NewLIR0(kPseudoMethodEntry);
   /* Spill core callee saves */
   SpillCoreRegs();
   /* NOTE: promotion of FP regs currently unsupported, thus no FP spill */
   DCHECK_EQ(num_fp_spills_, 0);
-  if (!skip_overflow_check) {
+  if (!skip_overflow_check && !implicit_overflow_check) {
     // cmp rX86_SP, fs:[stack_end_]; jcc throw_launchpad
     LIR* tgt = RawLIR(0, kPseudoThrowTarget, kThrowStackOverflow, 0, 0, 0, 0);
     OpRegThreadMem(kOpCmp, rX86_SP, Thread::StackEndOffset());
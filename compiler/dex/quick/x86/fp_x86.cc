@@ -197,18 +197,39 @@ void X86Mir2Lir::GenConversion(Instruction::Code opcode, RegLocation rl_dest,
       StoreValue(rl_dest, rl_result);
       return;
     }
-    case Instruction::LONG_TO_DOUBLE:
-      GenConversionCall(QUICK_ENTRYPOINT_OFFSET(pL2d), rl_dest, rl_src);
+    case Instruction::LONG_TO_DOUBLE: {
+      rl_src = LoadValueWide(rl_src, kCoreReg);
+      rl_result = EvalLoc(rl_dest, kFPReg, true);
+      int r_result = S2d(rl_result.low_reg, rl_result.high_reg);
+      int temp_reg = AllocTempDouble();
+      int r_temp = S2d(temp_reg, temp_reg + 1);
+      // cvtsi2sd only converts 32 bits, so compute (hi + (lo >>> 31)) * 2^32 + (signed) lo. The
+      // first part is exact, leaving a single rounding in the final add.
+      int t_reg = AllocTemp();
+      OpRegCopy(t_reg, rl_src.low_reg);
+      OpRegImm(kOpLsr, t_reg, 31);
+      NewLIR2(kX86Cvtsi2sdRR, r_result, rl_src.high_reg);
+      NewLIR2(kX86Cvtsi2sdRR, r_temp, t_reg);
+      FreeTemp(t_reg);
+      NewLIR2(kX86AddsdRR, r_result, r_temp);
+      LoadConstantWide(temp_reg, temp_reg + 1, INT64_C(0x41f0000000000000));  // 2^32
+      NewLIR2(kX86MulsdRR, r_result, r_temp);
+      NewLIR2(kX86Cvtsi2sdRR, r_temp, rl_src.low_reg);
+      NewLIR2(kX86AddsdRR, r_result, r_temp);
+      FreeTemp(temp_reg);
+      FreeTemp(temp_reg + 1);
+      StoreValueWide(rl_dest, rl_result);
       return;
+    }
     case Instruction::LONG_TO_FLOAT:
-      // TODO: inline by using memory as a 64-bit source. Be careful about promoted registers.
+      // Going through a double would round twice, which is wrong for some values over 2^53.
       GenConversionCall(QUICK_ENTRYPOINT_OFFSET(pL2f), rl_dest, rl_src);
       return;
     case Instruction::FLOAT_TO_LONG:
-      GenConversionCall(QUICK_ENTRYPOINT_OFFSET(pF2l), rl_dest, rl_src);
+      GenFpToLong(false, rl_dest, rl_src);
       return;
     case Instruction::DOUBLE_TO_LONG:
-      GenConversionCall(QUICK_ENTRYPOINT_OFFSET(pD2l), rl_dest, rl_src);
+      GenFpToLong(true, rl_dest, rl_src);
       return;
     default:
       LOG(INFO) << "Unexpected opcode: " << opcode;
@@ -231,6 +252,35 @@ void X86Mir2Lir::GenConversion(Instruction::Code opcode, RegLocation rl_dest,
   }
 }
 
+void X86Mir2Lir::GenFpToLong(bool is_double, RegLocation rl_dest, RegLocation rl_src) {
+  // The slow path calls out, so don't optimize the register usage.
+  FlushAllRegs();   // Send everything to home location
+  LockCallTemps();  // Prepare for explicit register usage
+  int src_reg;
+  if (is_double) {
+    int temp_reg = AllocTempDouble();
+    LoadValueDirectWideFixed(rl_src, temp_reg, temp_reg + 1);
+    src_reg = S2d(temp_reg, temp_reg + 1);
+    NewLIR2(kX86Cvttsd2siRR, rX86_RET0, src_reg);
+  } else {
+    src_reg = AllocTempFloat();
+    LoadValueDirectFixed(rl_src, src_reg);
+    NewLIR2(kX86Cvttss2siRR, rX86_RET0, src_reg);
+  }
+  // Values that truncate to an int are sign extended. The conversion gives 0x80000000 for the
+  // others and for NaN, which are left to the runtime along with -2^31 itself.
+  LIR* branch_slow = OpCmpImmBranch(kCondEq, rX86_RET0, 0x80000000, NULL);
+  OpRegCopy(rX86_RET1, rX86_RET0);
+  OpRegImm(kOpAsr, rX86_RET1, 31);
+  LIR* branch_done = NewLIR1(kX86Jmp8, 0);
+  branch_slow->target = NewLIR0(kPseudoTargetLabel);
+  CallRuntimeHelperRegLocation(is_double ? QUICK_ENTRYPOINT_OFFSET(pD2l) :
+                               QUICK_ENTRYPOINT_OFFSET(pF2l), rl_src, false);
+  branch_done->target = NewLIR0(kPseudoTargetLabel);
+  RegLocation rl_result = GetReturnWide(false);
+  StoreValueWide(rl_dest, rl_result);
+}
+
 void X86Mir2Lir::GenCmpFP(Instruction::Code code, RegLocation rl_dest,
                           RegLocation rl_src1, RegLocation rl_src2) {
   bool single = (code == Instruction::CMPL_FLOAT) || (code == Instruction::CMPG_FLOAT);
@@ -369,8 +419,16 @@ void X86Mir2Lir::GenNegDouble(RegLocation rl_dest, RegLocation rl_src) {
 }
 
 bool X86Mir2Lir::GenInlinedSqrt(CallInfo* info) {
-  DCHECK_NE(cu_->instruction_set, kThumb2);
-  return false;
+  DCHECK_EQ(cu_->instruction_set, kX86);
+  // sqrtsd is correctly rounded and handles negative and NaN inputs, so needs no slow path.
+  RegLocation rl_src = info->args[0];
+  RegLocation rl_dest = InlineTargetWide(info);  // double place for result
+  rl_src = LoadValueWide(rl_src, kFPReg);
+  RegLocation rl_result = EvalLoc(rl_dest, kFPReg, true);
+  NewLIR2(kX86SqrtsdRR, S2d(rl_result.low_reg, rl_result.high_reg),
+          S2d(rl_src.low_reg, rl_src.high_reg));
+  StoreValueWide(rl_dest, rl_result);
+  return true;
 }
 
 
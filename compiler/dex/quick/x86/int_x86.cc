@@ -19,6 +19,7 @@
 #include "codegen_x86.h"
 #include "dex/quick/mir_to_lir-inl.h"
 #include "mirror/array.h"
+#include "utils/magic_divide.h"
 #include "x86_lir.h"
 
 namespace art {
@@ -165,6 +166,55 @@ void X86Mir2Lir::GenSelect(BasicBlock* bb, MIR* mir) {
   UNIMPLEMENTED(FATAL) << "Need codegen for GenSelect";
 }
 
+void X86Mir2Lir::GenVectorLoopBody(const VectorLoopInfo* info, int r_index, int r_count,
+                                   int* r_arrays) {
+  // Step the index itself, up to the one the scalar loop continues from.
+  int data_offset = mirror::Array::DataOffset(sizeof(int32_t)).Int32Value();
+  OpRegImm(kOpLsl, r_count, 2);
+  OpRegReg(kOpAdd, r_count, r_index);
+  // The vector registers are xmm temps, all free after the flush of GenVectorLoop.
+  LIR* loop_head = NewLIR0(kPseudoTargetLabel);
+  for (int i = 0; i < info->num_ops; i++) {
+    const VectorLoopOp& op = info->ops[i];
+    LIR* insn;
+    switch (op.opcode) {
+      case Instruction::AGET:
+        insn = NewLIR5(kX86MovdquRA, fr0 + op.dest, r_arrays[op.src1], r_index, 2, data_offset);
+        break;
+      case Instruction::APUT:
+        insn = NewLIR5(kX86MovdquAR, r_arrays[op.src2], r_index, 2, data_offset, fr0 + op.src1);
+        break;
+      default: {
+        X86OpCode opcode = kX86Nop;
+        switch (op.opcode) {
+          case Instruction::ADD_INT: opcode = kX86PadddRR; break;
+          case Instruction::SUB_INT: opcode = kX86PsubdRR; break;
+          case Instruction::AND_INT: opcode = kX86PandRR; break;
+          case Instruction::OR_INT: opcode = kX86PorRR; break;
+          case Instruction::XOR_INT: opcode = kX86PxorRR; break;
+          case Instruction::ADD_FLOAT: opcode = kX86AddpsRR; break;
+          case Instruction::SUB_FLOAT: opcode = kX86SubpsRR; break;
+          case Instruction::MUL_FLOAT: opcode = kX86MulpsRR; break;
+          default:
+            LOG(FATAL) << "Unexpected vector opcode: " << op.opcode;
+        }
+        // Two address form, dest is never the second operand's register unless both are.
+        if (op.dest != op.src1) {
+          insn = NewLIR2(kX86MovapsRR, fr0 + op.dest, fr0 + op.src1);
+          // TUNING: loosen barrier
+          insn->def_mask = ENCODE_ALL;
+        }
+        insn = NewLIR2(opcode, fr0 + op.dest, fr0 + op.src2);
+        break;
+      }
+    }
+    // TUNING: loosen barrier
+    insn->def_mask = ENCODE_ALL;
+  }
+  OpRegImm(kOpAdd, r_index, 4);
+  OpCmpBranch(kCondLt, r_index, r_count, loop_head);
+}
+
 void X86Mir2Lir::GenFusedLongCmpBranch(BasicBlock* bb, MIR* mir) {
   LIR* taken = &block_label_list_[bb->taken->id];
   RegLocation rl_src1 = mir_graph_->GetSrcWide(mir, 0);
@@ -245,7 +295,47 @@ void X86Mir2Lir::OpTlsCmp(ThreadOffset offset, int val) {
 }
 
 bool X86Mir2Lir::GenInlinedCas32(CallInfo* info, bool need_write_barrier) {
+  DCHECK_EQ(cu_->instruction_set, kX86);
+  // Unused - RegLocation rl_src_unsafe = info->args[0];
+  RegLocation rl_src_obj = info->args[1];  // Object - known non-null
+  RegLocation rl_src_offset = info->args[2];  // long low
+  rl_src_offset.wide = 0;  // ignore high half in info->args[3]
+  RegLocation rl_src_expected = info->args[4];  // int or Object
+  RegLocation rl_src_new_value = info->args[5];  // int or Object
+  RegLocation rl_dest = InlineTarget(info);  // boolean place for result
+
+  // cmpxchg compares with and loads into EAX, and the card mark needs two temps of its own, so
+  // use all four temps explicitly: EAX and EDX mark the card before they take the expected value
+  // and the offset.
+  FlushAllRegs();
+  LockCallTemps();
+  LoadValueDirectFixed(rl_src_obj, rCX);
+  LoadValueDirectFixed(rl_src_new_value, rBX);
+  if (need_write_barrier && !mir_graph_->IsConstantNullRef(rl_src_new_value)) {
+    // Mark card for object assuming new value is stored.
+    FreeTemp(rAX);
+    FreeTemp(rDX);
+    MarkGCCard(rBX, rCX);
+    LockTemp(rAX);
+    LockTemp(rDX);
+  }
+  LoadValueDirectFixed(rl_src_expected, rAX);
+  LoadValueDirectFixed(rl_src_offset, rDX);
+
+  // The lock prefix makes this a full barrier, so no others are needed.
+  NewLIR5(kX86LockCmpxchgAR, rCX, rDX, 0, 0, rBX);
+
+  // EAX now holds the old value, which isn't needed, so it takes the result.
+  NewLIR2(kX86Set8R, rAX, kX86CondZ);  // rAX = ZF ? 1 : 0
+  NewLIR2(kX86Movzx8RR, rAX, rAX);
+  RegLocation rl_result = LocCReturn();
+  StoreValue(rl_dest, rl_result);
+  return true;
+}
+
+bool X86Mir2Lir::GenInlinedCas64(CallInfo* info) {
   DCHECK_NE(cu_->instruction_set, kThumb2);
+  // TODO: cmpxchg8b needs EAX, EBX, ECX and EDX for its operands, leaving no temp for the address.
   return false;
 }
 
@@ -289,16 +379,57 @@ LIR* X86Mir2Lir::OpTestSuspend(LIR* target) {
   return OpCondBranch((target == NULL) ? kCondNe : kCondEq, target);
 }
 
+// mov r, fs:[suspend_poll_page_]; mov r, [r], which faults while a request is pending.
+LIR* X86Mir2Lir::OpSuspendPoll() {
+  int r_page = AllocTemp();
+  OpRegThreadMem(kOpMov, r_page, Thread::SuspendPollPageOffset());
+  LIR* poll = LoadWordDisp(r_page, 0, r_page);
+  FreeTemp(r_page);
+  return poll;
+}
+
 // Decrement register and branch on condition
 LIR* X86Mir2Lir::OpDecAndBranch(ConditionCode c_code, int reg, LIR* target) {
   OpRegImm(kOpSub, reg, 1);
   return OpCmpImmBranch(c_code, reg, 0, target);
 }
 
-bool X86Mir2Lir::SmallLiteralDivRem(Instruction::Code dalvik_opcode, bool is_div,
+// Integer division by constant via reciprocal multiply (Hacker's Delight, 10-4)
+bool X86Mir2Lir::MagicLiteralDivRem(Instruction::Code dalvik_opcode, bool is_div,
                                     RegLocation rl_src, RegLocation rl_dest, int lit) {
-  LOG(FATAL) << "Unexpected use of smallLiteralDive in x86";
-  return false;
+  int32_t magic;
+  int shift;
+  CalculateMagicAndShift(lit, &magic, &shift);
+
+  // The one operand imul leaves its product in edx:eax.
+  FlushAllRegs();
+  LockCallTemps();  // Prepare for explicit register usage
+  LoadValueDirectFixed(rl_src, r1);
+  LoadConstant(r0, magic);
+  NewLIR1(kX86Imul32DaR, r1);  // r2:r0 = r0 * r1
+  if (lit > 0 && magic < 0) {
+    OpRegReg(kOpAdd, r2, r1);
+  } else if (lit < 0 && magic > 0) {
+    OpRegReg(kOpSub, r2, r1);
+  }
+  if (shift != 0) {
+    OpRegImm(kOpAsr, r2, shift);
+  }
+  // Round towards zero by adding the sign bit of the quotient.
+  OpRegCopy(r0, r2);
+  OpRegImm(kOpLsr, r0, 31);
+  OpRegReg(kOpAdd, r2, r0);
+  int result_reg = r2;
+  if (!is_div) {
+    // rem = src - quotient * lit.
+    OpRegRegImm(kOpMul, r0, r2, lit);
+    OpRegReg(kOpSub, r1, r0);
+    result_reg = r1;
+  }
+  RegLocation rl_result = {kLocPhysReg, 0, 0, 0, 0, 0, 0, 0, 1, result_reg, INVALID_REG,
+                          INVALID_SREG, INVALID_SREG};
+  StoreValue(rl_dest, rl_result);
+  return true;
 }
 
 LIR* X86Mir2Lir::OpIT(ConditionCode cond, const char* guide) {
@@ -308,8 +439,23 @@ LIR* X86Mir2Lir::OpIT(ConditionCode cond, const char* guide) {
 
 void X86Mir2Lir::GenMulLong(RegLocation rl_dest, RegLocation rl_src1,
                             RegLocation rl_src2) {
-  LOG(FATAL) << "Unexpected use of GenX86Long for x86";
+  // TODO: fixed register usage here as we only have 4 temps and temporary allocation isn't smart
+  // enough.
+  FlushAllRegs();
+  LockCallTemps();  // Prepare for explicit register usage
+  LoadValueDirectWideFixed(rl_src1, r0, r1);
+  LoadValueDirectWideFixed(rl_src2, r2, r3);
+  // Compute (r2:r0) = (r1:r0) * (r3:r2), the cross products only contributing to the high word.
+  OpRegReg(kOpMul, r1, r2);  // r1 = r1 * r2
+  OpRegReg(kOpMul, r3, r0);  // r3 = r3 * r0
+  OpRegReg(kOpAdd, r1, r3);  // r1 = r1 + r3
+  NewLIR1(kX86Mul32DaR, r2);  // r2:r0 = r0 * r2, unsigned
+  OpRegReg(kOpAdd, r2, r1);  // r2 = r2 + r1
+  RegLocation rl_result = {kLocPhysReg, 1, 0, 0, 0, 0, 0, 0, 1, r0, r2,
+                          INVALID_SREG, INVALID_SREG};
+  StoreValueWide(rl_dest, rl_result);
 }
+
 void X86Mir2Lir::GenAddLong(RegLocation rl_dest, RegLocation rl_src1,
                          RegLocation rl_src2) {
   // TODO: fixed register usage here as we only have 4 temps and temporary allocation isn't smart
@@ -511,7 +657,7 @@ void X86Mir2Lir::GenArrayPut(int opt_flags, OpSize size, RegLocation rl_array,
 void X86Mir2Lir::GenArrayObjPut(int opt_flags, RegLocation rl_array,
                              RegLocation rl_index, RegLocation rl_src, int scale) {
   int len_offset = mirror::Array::LengthOffset().Int32Value();
-  int data_offset = mirror::Array::DataOffset(sizeof(mirror::Object*)).Int32Value();
+  int data_offset = mirror::Array::DataOffset(mirror::kHeapReferenceSize).Int32Value();
 
   FlushAllRegs();  // Use explicit registers
   LockCallTemps();
@@ -560,8 +706,111 @@ void X86Mir2Lir::GenArrayObjPut(int opt_flags, RegLocation rl_array,
 
 void X86Mir2Lir::GenShiftImmOpLong(Instruction::Code opcode, RegLocation rl_dest,
                                    RegLocation rl_src1, RegLocation rl_shift) {
-  // Default implementation is just to ignore the constant case.
-  GenShiftOpLong(opcode, rl_dest, rl_src1, rl_shift);
+  // Per spec, we only care about low 6 bits of shift amount.
+  int shift_amount = mir_graph_->ConstantValue(rl_shift) & 0x3f;
+  FlushAllRegs();
+  LockCallTemps();  // Prepare for explicit register usage
+  LoadValueDirectWideFixed(rl_src1, r0, r1);
+  if (shift_amount != 0) {
+    switch (opcode) {
+      case Instruction::SHL_LONG:
+      case Instruction::SHL_LONG_2ADDR:
+        if (shift_amount < 32) {
+          NewLIR3(kX86Shld32RRI, r1, r0, shift_amount);
+          OpRegImm(kOpLsl, r0, shift_amount);
+        } else {
+          OpRegCopy(r1, r0);
+          if (shift_amount > 32) {
+            OpRegImm(kOpLsl, r1, shift_amount - 32);
+          }
+          LoadConstant(r0, 0);
+        }
+        break;
+      case Instruction::SHR_LONG:
+      case Instruction::SHR_LONG_2ADDR:
+        if (shift_amount < 32) {
+          NewLIR3(kX86Shrd32RRI, r0, r1, shift_amount);
+          OpRegImm(kOpAsr, r1, shift_amount);
+        } else {
+          OpRegCopy(r0, r1);
+          if (shift_amount > 32) {
+            OpRegImm(kOpAsr, r0, shift_amount - 32);
+          }
+          OpRegImm(kOpAsr, r1, 31);
+        }
+        break;
+      case Instruction::USHR_LONG:
+      case Instruction::USHR_LONG_2ADDR:
+        if (shift_amount < 32) {
+          NewLIR3(kX86Shrd32RRI, r0, r1, shift_amount);
+          OpRegImm(kOpLsr, r1, shift_amount);
+        } else {
+          OpRegCopy(r0, r1);
+          if (shift_amount > 32) {
+            OpRegImm(kOpLsr, r0, shift_amount - 32);
+          }
+          LoadConstant(r1, 0);
+        }
+        break;
+      default:
+        LOG(FATAL) << "Unexpected case";
+    }
+  }
+  RegLocation rl_result = {kLocPhysReg, 1, 0, 0, 0, 0, 0, 0, 1, r0, r1,
+                          INVALID_SREG, INVALID_SREG};
+  StoreValueWide(rl_dest, rl_result);
+}
+
+void X86Mir2Lir::GenShiftOpLong(Instruction::Code opcode, RegLocation rl_dest,
+                                RegLocation rl_src1, RegLocation rl_shift) {
+  FlushAllRegs();
+  LockCallTemps();  // Prepare for explicit register usage
+  // The shift count has to be in CX, which is r1.
+  LoadValueDirectWideFixed(rl_src1, r0, r2);
+  LoadValueDirectFixed(rl_shift, r1);
+  // The double precision shifts only use the low 5 bits of the count, so shifts of 32 or more
+  // are finished by moving one word into the other.
+  switch (opcode) {
+    case Instruction::SHL_LONG:
+    case Instruction::SHL_LONG_2ADDR:
+      NewLIR2(kX86Shld32RRC, r2, r0);
+      NewLIR2(kX86Sal32RC, r0, r1);
+      break;
+    case Instruction::SHR_LONG:
+    case Instruction::SHR_LONG_2ADDR:
+      NewLIR2(kX86Shrd32RRC, r0, r2);
+      NewLIR2(kX86Sar32RC, r2, r1);
+      break;
+    case Instruction::USHR_LONG:
+    case Instruction::USHR_LONG_2ADDR:
+      NewLIR2(kX86Shrd32RRC, r0, r2);
+      NewLIR2(kX86Shr32RC, r2, r1);
+      break;
+    default:
+      LOG(FATAL) << "Unexpected case";
+  }
+  NewLIR2(kX86Test32RI, r1, 32);
+  LIR* branch = NewLIR2(kX86Jcc8, 0, kX86CondZ);
+  switch (opcode) {
+    case Instruction::SHL_LONG:
+    case Instruction::SHL_LONG_2ADDR:
+      OpRegCopy(r2, r0);
+      LoadConstant(r0, 0);
+      break;
+    case Instruction::SHR_LONG:
+    case Instruction::SHR_LONG_2ADDR:
+      OpRegCopy(r0, r2);
+      OpRegImm(kOpAsr, r2, 31);
+      break;
+    default:
+      OpRegCopy(r0, r2);
+      LoadConstant(r2, 0);
+      break;
+  }
+  branch->target = NewLIR0(kPseudoTargetLabel);
+  RegLocation rl_result = {kLocPhysReg, 1, 0, 0, 0, 0, 0, 0, 1, r0, r2,
+                          INVALID_SREG, INVALID_SREG};
+  StoreValueWide(rl_dest, rl_result);
 }
 
 void X86Mir2Lir::GenArithImmOpLong(Instruction::Code opcode,
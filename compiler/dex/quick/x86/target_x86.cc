@@ -507,6 +507,14 @@ bool X86Mir2Lir::IsUnconditionalBranch(LIR* lir) {
   return (lir->opcode == kX86Jmp8 || lir->opcode == kX86Jmp32);
 }
 
+bool X86Mir2Lir::IsMemBarrier(LIR* lir) {
+  return lir->opcode == kX86Mfence;
+}
+
+void X86Mir2Lir::MergeMemBarriers(LIR* barrier, LIR* earlier) {
+  // All barriers are full fences.
+}
+
 X86Mir2Lir::X86Mir2Lir(CompilationUnit* cu, MIRGraph* mir_graph, ArenaAllocator* arena)
     : Mir2Lir(cu, mir_graph, arena) {
   for (int i = 0; i < kX86Last; i++) {
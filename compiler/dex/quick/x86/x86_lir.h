@@ -300,6 +300,11 @@ enum X86OpCode {
   BinaryShiftOpCode(kX86Shr),
   BinaryShiftOpCode(kX86Sar),
 #undef BinaryShiftOpcode
+  // Double precision shifts, of the first register with bits shifted in from the second.
+  // RRI - lir operands - 0: reg1, 1: reg2, 2: immediate
+  // RRC - lir operands - 0: reg1, 1: reg2, the shift count being in CL
+  kX86Shld32RRI, kX86Shrd32RRI,
+  kX86Shld32RRC, kX86Shrd32RRC,
   kX86Cmc,
 #define UnaryOpcode(opcode, reg, mem, array) \
   opcode ## 8 ## reg, opcode ## 8 ## mem, opcode ## 8 ## array, \
@@ -344,6 +349,18 @@ enum X86OpCode {
   Binary0fOpCode(kX86Subss),    // float subtract
   Binary0fOpCode(kX86Divsd),    // double divide
   Binary0fOpCode(kX86Divss),    // float divide
+  Binary0fOpCode(kX86Sqrtsd),   // double square root
+  Binary0fOpCode(kX86Movaps),   // move of 4 floats, used to copy whole xmm registers
+  Binary0fOpCode(kX86Addps),    // 4 float add
+  Binary0fOpCode(kX86Mulps),    // 4 float multiply
+  Binary0fOpCode(kX86Subps),    // 4 float subtract
+  Binary0fOpCode(kX86Pand),     // and of xmm registers
+  Binary0fOpCode(kX86Por),      // or of xmm registers
+  Binary0fOpCode(kX86Pxor),     // xor of xmm registers
+  Binary0fOpCode(kX86Psubd),    // 4 int subtract
+  Binary0fOpCode(kX86Paddd),    // 4 int add
+  Binary0fOpCode(kX86Movdqu),   // unaligned load of 16 bytes
+  kX86MovdquAR,                 // unaligned store of 16 bytes
   kX86PsrlqRI,                  // right shift of floating point registers
   kX86PsllqRI,                  // left shift of floating point registers
   Binary0fOpCode(kX86Movdxr),   // move into xmm from gpr
@@ -388,6 +405,7 @@ enum X86EncodingKind {
   kRegRegStore,                            // RR following the store modrm reg-reg encoding rather than the load.
   kRegImm, kMemImm, kArrayImm, kThreadImm,  // RI, MI, AI and TI instruction kinds.
   kRegRegImm, kRegMemImm, kRegArrayImm,    // RRI, RMI and RAI instruction kinds.
+  kRegRegImmStore,                         // RRI following the store modrm reg-reg encoding rather than the load.
   kMovRegImm,                              // Shorter form move RI.
   kShiftRegImm, kShiftMemImm, kShiftArrayImm,  // Shift opcode with immediate.
   kShiftRegCl, kShiftMemCl, kShiftArrayCl,     // Shift opcode with register CL.
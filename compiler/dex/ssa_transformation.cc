@@ -433,10 +433,10 @@ void MIRGraph::ComputeDominators() {
 }
 
 /*
- * Perform dest U= src1 ^ ~src2
+ * Perform dest U= src1 ^ ~src2, returning whether dest changed.
  * This is probably not general enough to be placed in BitVector.[ch].
  */
-void MIRGraph::ComputeSuccLineIn(ArenaBitVector* dest, const ArenaBitVector* src1,
+bool MIRGraph::ComputeSuccLineIn(ArenaBitVector* dest, const ArenaBitVector* src1,
                                  const ArenaBitVector* src2) {
   if (dest->GetStorageSize() != src1->GetStorageSize() ||
       dest->GetStorageSize() != src2->GetStorageSize() ||
@@ -445,30 +445,37 @@ void MIRGraph::ComputeSuccLineIn(ArenaBitVector* dest, const ArenaBitVector* src
     LOG(FATAL) << "Incompatible set properties";
   }
 
-  unsigned int idx;
-  for (idx = 0; idx < dest->GetStorageSize(); idx++) {
-    dest->GetRawStorage()[idx] |= src1->GetRawStorageWord(idx) & ~(src2->GetRawStorageWord(idx));
+  uint32_t changed = 0;
+  uint32_t* dest_storage = dest->GetRawStorage();
+  for (unsigned int idx = 0; idx < dest->GetStorageSize(); idx++) {
+    uint32_t word = dest_storage[idx];
+    uint32_t new_word = word | (src1->GetRawStorageWord(idx) & ~(src2->GetRawStorageWord(idx)));
+    changed |= word ^ new_word;
+    dest_storage[idx] = new_word;
   }
+  return changed != 0;
 }
 
 /*
  * Iterate through all successor blocks and propagate up the live-in sets.
  * The calculated result is used for phi-node pruning - where we only need to
- * insert a phi node if the variable is live-in to the block.
+ * insert a phi node if the variable is live-in to the block.  Live-ins only
+ * grow, so they are merged in place rather than through a copy compared at
+ * the end.
  */
 bool MIRGraph::ComputeBlockLiveIns(BasicBlock* bb) {
-  ArenaBitVector* temp_dalvik_register_v = temp_dalvik_register_v_;
-
   if (bb->data_flow_info == NULL) {
     return false;
   }
-  temp_dalvik_register_v->Copy(bb->data_flow_info->live_in_v);
-  if (bb->taken && bb->taken->data_flow_info)
-    ComputeSuccLineIn(temp_dalvik_register_v, bb->taken->data_flow_info->live_in_v,
-                      bb->data_flow_info->def_v);
-  if (bb->fall_through && bb->fall_through->data_flow_info)
-    ComputeSuccLineIn(temp_dalvik_register_v, bb->fall_through->data_flow_info->live_in_v,
-                      bb->data_flow_info->def_v);
+  ArenaBitVector* live_in_v = bb->data_flow_info->live_in_v;
+  const ArenaBitVector* def_v = bb->data_flow_info->def_v;
+  bool change = false;
+  if (bb->taken && bb->taken->data_flow_info) {
+    change |= ComputeSuccLineIn(live_in_v, bb->taken->data_flow_info->live_in_v, def_v);
+  }
+  if (bb->fall_through && bb->fall_through->data_flow_info) {
+    change |= ComputeSuccLineIn(live_in_v, bb->fall_through->data_flow_info->live_in_v, def_v);
+  }
   if (bb->successor_block_list.block_list_type != kNotUsed) {
     GrowableArray<SuccessorBlockInfo*>::Iterator iterator(bb->successor_block_list.blocks);
     while (true) {
@@ -478,16 +485,11 @@ bool MIRGraph::ComputeBlockLiveIns(BasicBlock* bb) {
       }
       BasicBlock* succ_bb = successor_block_info->block;
       if (succ_bb->data_flow_info) {
-        ComputeSuccLineIn(temp_dalvik_register_v, succ_bb->data_flow_info->live_in_v,
-                          bb->data_flow_info->def_v);
+        change |= ComputeSuccLineIn(live_in_v, succ_bb->data_flow_info->live_in_v, def_v);
       }
     }
   }
-  if (!temp_dalvik_register_v->Equal(bb->data_flow_info->live_in_v)) {
-    bb->data_flow_info->live_in_v->Copy(temp_dalvik_register_v);
-    return true;
-  }
-  return false;
+  return change;
 }
 
 /* Insert phi nodes to for each variable to the dominance frontiers */
@@ -495,58 +497,49 @@ void MIRGraph::InsertPhiNodes() {
   int dalvik_reg;
   ArenaBitVector* phi_blocks =
       new (arena_) ArenaBitVector(arena_, GetNumBlocks(), false, kBitMapPhi);
-  ArenaBitVector* tmp_blocks =
-      new (arena_) ArenaBitVector(arena_, GetNumBlocks(), false, kBitMapTmpBlocks);
   ArenaBitVector* input_blocks =
       new (arena_) ArenaBitVector(arena_, GetNumBlocks(), false, kBitMapInputBlocks);
 
-  temp_dalvik_register_v_ =
-      new (arena_) ArenaBitVector(arena_, cu_->num_dalvik_registers, false, kBitMapRegisterV);
-
   PostOrderDfsIterator iter(this, true /* iterative */);
   bool change = false;
   for (BasicBlock* bb = iter.Next(false); bb != NULL; bb = iter.Next(change)) {
     change = ComputeBlockLiveIns(bb);
   }
 
+  /*
+   * The phi blocks of a register are the iterated dominance frontier of its
+   * definitions.  Rather than merging the frontiers of every input block until
+   * nothing changes, visit each block once from a worklist, queueing the
+   * frontier blocks that are seen for the first time.
+   */
+  std::vector<int> work_list;
+  work_list.reserve(GetNumBlocks());
+
   /* Iterate through each Dalvik register */
   for (dalvik_reg = cu_->num_dalvik_registers - 1; dalvik_reg >= 0; dalvik_reg--) {
-    bool change;
-
     input_blocks->Copy(def_block_matrix_[dalvik_reg]);
     phi_blocks->ClearAllBits();
 
     /* Calculate the phi blocks for each Dalvik register */
-    do {
-      change = false;
-      tmp_blocks->ClearAllBits();
-      ArenaBitVector::Iterator iterator(input_blocks);
-
-      while (true) {
-        int idx = iterator.Next();
-        if (idx == -1) {
-          break;
-        }
-        BasicBlock* def_bb = GetBasicBlock(idx);
-
-        /* Merge the dominance frontier to tmp_blocks */
-        // TUNING: hot call to Union().
-        if (def_bb->dom_frontier != NULL) {
-          tmp_blocks->Union(def_bb->dom_frontier);
-        }
+    ArenaBitVector::Iterator def_iterator(def_block_matrix_[dalvik_reg]);
+    for (int idx = def_iterator.Next(); idx != -1; idx = def_iterator.Next()) {
+      work_list.push_back(idx);
+    }
+    while (!work_list.empty()) {
+      BasicBlock* def_bb = GetBasicBlock(work_list.back());
+      work_list.pop_back();
+      if (def_bb->dom_frontier == NULL) {
+        continue;
       }
-      if (!phi_blocks->Equal(tmp_blocks)) {
-        change = true;
-        phi_blocks->Copy(tmp_blocks);
-
-        /*
-         * Iterate through the original blocks plus the new ones in
-         * the dominance frontier.
-         */
-        input_blocks->Copy(phi_blocks);
-        input_blocks->Union(def_block_matrix_[dalvik_reg]);
+      ArenaBitVector::Iterator df_iterator(def_bb->dom_frontier);
+      for (int idx = df_iterator.Next(); idx != -1; idx = df_iterator.Next()) {
+        phi_blocks->SetBit(idx);
+        if (!input_blocks->IsBitSet(idx)) {
+          input_blocks->SetBit(idx);
+          work_list.push_back(idx);
+        }
       }
-    } while (change);
+    }
 
     /*
      * Insert a phi node for dalvik_reg in the phi_blocks if the Dalvik
@@ -19,6 +19,7 @@
 #define ATRACE_TAG ATRACE_TAG_DALVIK
 #include <utils/Trace.h>
 
+#include <algorithm>
 #include <vector>
 #include <unistd.h>
 
@@ -27,7 +28,12 @@
 #include "class_linker.h"
 #include "dex_compilation_unit.h"
 #include "dex_file-inl.h"
+#include "dex_instruction-inl.h"
+#include "hot_method_compiler.h"
+#include "incremental_compilation.h"
 #include "jni_internal.h"
+#include "leb128.h"
+#include "method_profile.h"
 #include "object_utils.h"
 #include "runtime.h"
 #include "gc/accounting/card_table-inl.h"
@@ -77,7 +83,8 @@ class AOTCompilationStats {
         resolved_instance_fields_(0), unresolved_instance_fields_(0),
         resolved_local_static_fields_(0), resolved_static_fields_(0), unresolved_static_fields_(0),
         type_based_devirtualization_(0),
-        safe_casts_(0), not_safe_casts_(0) {
+        safe_casts_(0), not_safe_casts_(0),
+        assembled_without_retry_(0), assembled_with_retry_(0), relaxation_passes_(0) {
     for (size_t i = 0; i <= kMaxInvokeType; i++) {
       resolved_methods_[i] = 0;
       unresolved_methods_[i] = 0;
@@ -97,6 +104,12 @@ class AOTCompilationStats {
     DumpStat(resolved_local_static_fields_, resolved_static_fields_ + unresolved_static_fields_,
              "static fields local to a class");
     DumpStat(safe_casts_, not_safe_casts_, "check-casts removed based on type information");
+    DumpStat(assembled_without_retry_, assembled_with_retry_,
+             "methods assembled without restarting the assembler");
+    if (assembled_without_retry_ + assembled_with_retry_ != 0) {
+      VLOG(compiler) << relaxation_passes_ << " relaxation passes for "
+                     << (assembled_without_retry_ + assembled_with_retry_) << " methods";
+    }
     // Note, the code below subtracts the stat value so that when added to the stat value we have
     // 100% of samples. TODO: clean this up.
     DumpStat(type_based_devirtualization_,
@@ -250,6 +263,18 @@ class AOTCompilationStats {
     not_safe_casts_++;
   }
 
+  // A method was assembled after the given number of relaxation passes, with or without the
+  // assembler having to start over.
+  void AssembledMethod(bool retried, size_t relaxation_passes) {
+    STATS_LOCK();
+    if (retried) {
+      assembled_with_retry_++;
+    } else {
+      assembled_without_retry_++;
+    }
+    relaxation_passes_ += relaxation_passes;
+  }
+
  private:
   Mutex stats_lock_;
 
@@ -280,10 +305,19 @@ class AOTCompilationStats {
   size_t safe_casts_;
   size_t not_safe_casts_;
 
+  size_t assembled_without_retry_;
+  size_t assembled_with_retry_;
+  size_t relaxation_passes_;
+
   DISALLOW_COPY_AND_ASSIGN(AOTCompilationStats);
 };
 
 extern "C" void ArtInitCompilerContext(art::CompilerDriver& driver);
+extern "C" void ArtCompileMethods(
+    art::CompilerDriver& driver,
+    const std::vector<const art::CompilerDriver::MethodCompilationItem*>& items,
+    jobject class_loader, const art::DexFile& dex_file,
+    std::vector<art::CompiledMethod*>* compiled_methods);
 extern "C" void ArtInitQuickCompilerContext(art::CompilerDriver& compiler);
 
 extern "C" void ArtUnInitCompilerContext(art::CompilerDriver& driver);
@@ -335,6 +369,9 @@ extern "C" art::CompiledMethod* ArtQuickJniCompileMethod(art::CompilerDriver& co
 extern "C" void compilerLLVMSetBitcodeFileName(art::CompilerDriver& driver,
                                                std::string const& filename);
 
+extern "C" void compilerLLVMSetCompilationCacheDirectory(art::CompilerDriver& driver,
+                                                         std::string const& directory);
+
 CompilerDriver::CompilerDriver(CompilerBackend compiler_backend, InstructionSet instruction_set,
                                bool image, DescriptorSet* image_classes, size_t thread_count,
                                bool dump_stats)
@@ -343,19 +380,29 @@ CompilerDriver::CompilerDriver(CompilerBackend compiler_backend, InstructionSet
       freezing_constructor_lock_("freezing constructor lock"),
       compiled_classes_lock_("compiled classes lock"),
       compiled_methods_lock_("compiled method lock"),
+      method_items_lock_("method compilation items lock"),
+      method_batch_size_(0),
       image_(image),
       image_classes_(image_classes),
       thread_count_(thread_count),
       start_ns_(0),
       stats_(new AOTCompilationStats),
       dump_stats_(dump_stats),
+      method_profile_(NULL),
+      profile_hot_threshold_(0),
+      compress_cold_code_(false),
+      generate_osr_entries_(false),
+      patch_call_sites_(false),
+      align_text_to_huge_pages_(false),
       compiler_library_(NULL),
       compiler_(NULL),
       compiler_context_(NULL),
       jni_compiler_(NULL),
       compiler_enable_auto_elf_loading_(NULL),
       compiler_get_method_code_addr_(NULL),
-      support_boot_image_fixup_(true) {
+      support_boot_image_fixup_(true),
+      memory_budget_(0),
+      spill_lock_("compiled data spill lock") {
 
   CHECK_PTHREAD_CALL(pthread_key_create, (&tls_key_, NULL), "compiler tls key");
 
@@ -373,6 +420,11 @@ CompilerDriver::CompilerDriver(CompilerBackend compiler_backend, InstructionSet
 
   dex_to_dex_compiler_ = reinterpret_cast<DexToDexCompilerFn>(ArtCompileDEX);
 
+  batch_compiler_ = NULL;
+  if (compiler_backend_ == kPortable) {
+    batch_compiler_ = reinterpret_cast<BatchCompilerFn>(ArtCompileMethods);
+  }
+
 #ifdef ART_SEA_IR_MODE
   sea_ir_compiler_ = NULL;
   if (Runtime::Current()->IsSeaIRMode()) {
@@ -388,26 +440,120 @@ CompilerDriver::CompilerDriver(CompilerBackend compiler_backend, InstructionSet
     jni_compiler_ = reinterpret_cast<JniCompilerFn>(ArtQuickJniCompileMethod);
   }
 
-  CHECK(!Runtime::Current()->IsStarted());
+  // Only the hot method compiler creates a driver in a running runtime.
+  CHECK(!Runtime::Current()->IsStarted() || !image_);
   if (!image_) {
     CHECK(image_classes_.get() == NULL);
   }
 }
 
 std::vector<uint8_t>* CompilerDriver::DeduplicateCode(const std::vector<uint8_t>& code) {
-  return dedupe_code_.Add(Thread::Current(), code);
+  bool added;
+  std::vector<uint8_t>* result = dedupe_code_.Add(Thread::Current(), code, &added);
+  if (added) {
+    resident_compiled_bytes_.fetch_add(code.size());
+  }
+  return result;
 }
 
 std::vector<uint8_t>* CompilerDriver::DeduplicateMappingTable(const std::vector<uint8_t>& code) {
-  return dedupe_mapping_table_.Add(Thread::Current(), code);
+  bool added;
+  std::vector<uint8_t>* result = dedupe_mapping_table_.Add(Thread::Current(), code, &added);
+  if (added) {
+    resident_compiled_bytes_.fetch_add(code.size());
+  }
+  return result;
 }
 
 std::vector<uint8_t>* CompilerDriver::DeduplicateVMapTable(const std::vector<uint8_t>& code) {
-  return dedupe_vmap_table_.Add(Thread::Current(), code);
+  bool added;
+  std::vector<uint8_t>* result = dedupe_vmap_table_.Add(Thread::Current(), code, &added);
+  if (added) {
+    resident_compiled_bytes_.fetch_add(code.size());
+  }
+  return result;
 }
 
 std::vector<uint8_t>* CompilerDriver::DeduplicateGCMap(const std::vector<uint8_t>& code) {
-  return dedupe_gc_map_.Add(Thread::Current(), code);
+  bool added;
+  std::vector<uint8_t>* result = dedupe_gc_map_.Add(Thread::Current(), code, &added);
+  if (added) {
+    resident_compiled_bytes_.fetch_add(code.size());
+  }
+  return result;
+}
+
+void CompilerDriver::SetMemoryBudget(size_t budget_bytes, SpillSpace* spill_space) {
+  CHECK_EQ(compiler_backend_, kQuick);
+  CHECK(spill_space != NULL);
+  memory_budget_ = budget_bytes;
+  spill_space_.reset(spill_space);
+}
+
+const std::vector<uint8_t>& CompilerDriver::GetCompiledData(const std::vector<uint8_t>& data,
+                                                            std::vector<uint8_t>* buffer) const {
+  if (spill_space_.get() == NULL) {
+    return data;
+  }
+  return spill_space_->Load(data, buffer);
+}
+
+class SpillVisitor {
+ public:
+  explicit SpillVisitor(SpillSpace* spill_space) : spill_space_(spill_space), failed_(false) {}
+
+  void operator()(std::vector<uint8_t>* data) {
+    // Give up on the first failure, the data just stays in memory.
+    if (!failed_ && !spill_space_->Spill(data)) {
+      failed_ = true;
+    }
+  }
+
+  bool Failed() const {
+    return failed_;
+  }
+
+ private:
+  SpillSpace* const spill_space_;
+  bool failed_;
+};
+
+void CompilerDriver::SpillIfOverBudget(Thread* self) {
+  if (memory_budget_ == 0 ||
+      static_cast<size_t>(resident_compiled_bytes_.load()) <= memory_budget_) {
+    return;
+  }
+  MutexLock mu(self, spill_lock_);
+  // Another thread may have spilled while we waited.
+  if (static_cast<size_t>(resident_compiled_bytes_.load()) <= memory_budget_) {
+    return;
+  }
+  // Data added concurrently may get spilled along, and then counted again, which only makes the
+  // next spill come a little early.
+  resident_compiled_bytes_.store(0);
+  SpillVisitor visitor(spill_space_.get());
+  dedupe_code_.Evict(self, visitor);
+  dedupe_mapping_table_.Evict(self, visitor);
+  dedupe_vmap_table_.Evict(self, visitor);
+  dedupe_gc_map_.Evict(self, visitor);
+  if (visitor.Failed()) {
+    LOG(WARNING) << "Failed to spill compiled code, no longer enforcing the memory budget";
+    memory_budget_ = 0;
+  }
+  VLOG(compiler) << "Spilled compiled code, " << PrettySize(spill_space_->GetSpilledBytes())
+                 << " spilled in total";
+}
+
+void CompilerDriver::ReleaseCompiledMethods() {
+  Thread* self = Thread::Current();
+  {
+    MutexLock mu(self, compiled_methods_lock_);
+    STLDeleteValues(&compiled_methods_);
+  }
+  dedupe_code_.Clear(self);
+  dedupe_mapping_table_.Clear(self);
+  dedupe_vmap_table_.Clear(self);
+  dedupe_gc_map_.Clear(self);
 }
 
 CompilerDriver::~CompilerDriver() {
@@ -492,6 +638,12 @@ void CompilerDriver::CompileAll(jobject class_loader,
   UniquePtr<ThreadPool> thread_pool(new ThreadPool(thread_count_ - 1));
   PreCompile(class_loader, dex_files, *thread_pool.get(), timings);
   Compile(class_loader, dex_files, *thread_pool.get(), timings);
+  if (incremental_compilation_.get() != NULL) {
+    incremental_compilation_->DumpStats();
+  }
+  // Keep the arenas for any later compiles, but give their memory back while the oat file and
+  // image are written.
+  arena_pool_.ReleaseIdleArenas();
   if (dump_stats_) {
     stats_->Dump();
   }
@@ -574,6 +726,64 @@ void CompilerDriver::CompileOne(const mirror::ArtMethod* method, base::TimingLog
   self->TransitionFromSuspendedToRunnable();
 }
 
+const CompiledMethod* CompilerDriver::CompileHotMethod(mirror::ArtMethod* method) {
+  Thread* self = Thread::Current();
+  jobject jclass_loader;
+  const DexFile* dex_file;
+  uint16_t class_def_idx;
+  const DexFile::CodeItem* code_item;
+  {
+    ScopedObjectAccess soa(self);
+    // The class was verified when it was loaded, or ahead of time, without recording the maps the
+    // compiler needs.
+    if (!verifier::MethodVerifier::VerifyMethodForCompilation(method)) {
+      return NULL;
+    }
+    ScopedLocalRef<jobject>
+      local_class_loader(soa.Env(),
+                    soa.AddLocalReference<jobject>(method->GetDeclaringClass()->GetClassLoader()));
+    jclass_loader = soa.Env()->NewGlobalRef(local_class_loader.get());
+    MethodHelper mh(method);
+    dex_file = &mh.GetDexFile();
+    class_def_idx = mh.GetClassDefIndex();
+    code_item = mh.GetCodeItem();
+  }
+  const uint32_t method_idx = method->GetDexMethodIndex();
+  MethodReference ref(dex_file, method_idx);
+  // A method flushed from the code cache keeps its compiled code here.
+  CompiledMethod* compiled_method = GetCompiledMethod(ref);
+  if (compiled_method == NULL) {
+    const size_t num_code_patches = code_to_patch_.size();
+    const size_t num_method_patches = methods_to_patch_.size();
+    compiled_method = (*compiler_)(*this, code_item, method->GetAccessFlags(),
+                                   method->GetInvokeType(), class_def_idx, method_idx,
+                                   jclass_loader, *dex_file);
+    // The method literals are call sites the runtime patches once their targets are resolved,
+    // see SetPatchCallSites.
+    std::vector<uint32_t> call_sites;
+    for (size_t i = num_method_patches; i < methods_to_patch_.size(); ++i) {
+      call_sites.push_back(methods_to_patch_[i]->GetLiteralOffset());
+      call_sites.push_back(methods_to_patch_[i]->GetTargetMethodIdx());
+      delete methods_to_patch_[i];
+    }
+    methods_to_patch_.resize(num_method_patches);
+    // Nobody would apply code patches, code needing them can't run.
+    if (compiled_method != NULL && code_to_patch_.size() != num_code_patches) {
+      VLOG(compiler) << "Not using code needing patches for "
+                     << PrettyMethod(method_idx, *dex_file);
+      delete compiled_method;
+      compiled_method = NULL;
+    }
+    if (compiled_method != NULL) {
+      compiled_method->SetCallSites(call_sites);
+      MutexLock mu(self, compiled_methods_lock_);
+      compiled_methods_.Put(ref, compiled_method);
+    }
+  }
+  self->GetJniEnv()->DeleteGlobalRef(jclass_loader);
+  return compiled_method;
+}
+
 void CompilerDriver::Resolve(jobject class_loader, const std::vector<const DexFile*>& dex_files,
                              ThreadPool& thread_pool, base::TimingLogger& timings) {
   for (size_t i = 0; i != dex_files.size(); ++i) {
@@ -791,6 +1001,18 @@ bool CompilerDriver::CanAssumeTypeIsPresentInDexCache(const DexFile& dex_file,
   }
 }
 
+bool CompilerDriver::IsAssignableType(const DexFile& dex_file, uint32_t super_type_idx,
+                                      uint32_t sub_type_idx) {
+  if (super_type_idx == sub_type_idx) {
+    return true;
+  }
+  ScopedObjectAccess soa(Thread::Current());
+  mirror::DexCache* dex_cache = Runtime::Current()->GetClassLinker()->FindDexCache(dex_file);
+  mirror::Class* super_class = dex_cache->GetResolvedType(super_type_idx);
+  mirror::Class* sub_class = dex_cache->GetResolvedType(sub_type_idx);
+  return super_class != NULL && sub_class != NULL && super_class->IsAssignableFrom(sub_class);
+}
+
 bool CompilerDriver::CanAssumeStringIsPresentInDexCache(const DexFile& dex_file,
                                                         uint32_t string_idx) {
   // See also Compiler::ResolveDexFile
@@ -886,6 +1108,22 @@ bool CompilerDriver::CanAccessInstantiableTypeWithoutChecks(uint32_t referrer_id
   return result;
 }
 
+bool CompilerDriver::CanRemoveAllocation(uint32_t referrer_idx, const DexFile& dex_file,
+                                         uint32_t type_idx) {
+  ScopedObjectAccess soa(Thread::Current());
+  mirror::DexCache* dex_cache = Runtime::Current()->GetClassLinker()->FindDexCache(dex_file);
+  mirror::Class* resolved_class = dex_cache->GetResolvedType(type_idx);
+  const DexFile::MethodId& method_id = dex_file.GetMethodId(referrer_idx);
+  mirror::Class* referrer_class = dex_cache->GetResolvedType(method_id.class_idx_);
+  if (resolved_class == NULL || referrer_class == NULL) {
+    return false;
+  }
+  // A class is only initialized at compile time if its initialization has no side effects or
+  // the image keeps it initialized, see InitializeClass.
+  return referrer_class->CanAccess(resolved_class) && resolved_class->IsInstantiable() &&
+      resolved_class->IsInitialized() && !resolved_class->IsFinalizable();
+}
+
 static mirror::Class* ComputeCompilingMethodsClass(ScopedObjectAccess& soa,
                                                    mirror::DexCache* dex_cache,
                                                    const DexCompilationUnit* mUnit)
@@ -971,13 +1209,14 @@ bool CompilerDriver::ComputeInstanceFieldInfo(uint32_t field_idx, const DexCompi
 
 bool CompilerDriver::ComputeStaticFieldInfo(uint32_t field_idx, const DexCompilationUnit* mUnit,
                                             int& field_offset, int& ssb_index,
-                                            bool& is_referrers_class, bool& is_volatile,
-                                            bool is_put) {
+                                            bool& is_referrers_class, bool& is_initialized,
+                                            bool& is_volatile, bool is_put) {
   ScopedObjectAccess soa(Thread::Current());
   // Conservative defaults.
   field_offset = -1;
   ssb_index = -1;
   is_referrers_class = false;
+  is_initialized = false;
   is_volatile = true;
   // Try to resolve field and ignore if an Incompatible Class Change Error (ie isn't static).
   mirror::ArtField* resolved_field = ComputeFieldReferencedFromCompilingMethod(soa, mUnit, field_idx);
@@ -1022,6 +1261,7 @@ bool CompilerDriver::ComputeStaticFieldInfo(uint32_t field_idx, const DexCompila
             // common case where the dex cache of both the referrer and the field are the same,
             // no need to search the dex file
             ssb_index = fields_class->GetDexTypeIndex();
+            is_initialized = IsStaticStorageInitialized(dex_cache, ssb_index, fields_class);
             field_offset = resolved_field->GetOffset().Int32Value();
             is_volatile = resolved_field->IsVolatile();
             stats_->ResolvedStaticField();
@@ -1037,6 +1277,7 @@ bool CompilerDriver::ComputeStaticFieldInfo(uint32_t field_idx, const DexCompila
             if (type_id != NULL) {
               // medium path, needs check of static storage base being initialized
               ssb_index = mUnit->GetDexFile()->GetIndexForTypeId(*type_id);
+              is_initialized = IsStaticStorageInitialized(dex_cache, ssb_index, fields_class);
               field_offset = resolved_field->GetOffset().Int32Value();
               is_volatile = resolved_field->IsVolatile();
               stats_->ResolvedStaticField();
@@ -1055,6 +1296,19 @@ bool CompilerDriver::ComputeStaticFieldInfo(uint32_t field_idx, const DexCompila
   return false;  // Incomplete knowledge needs slow path.
 }
 
+bool CompilerDriver::IsStaticStorageInitialized(mirror::DexCache* dex_cache, int ssb_index,
+                                                mirror::Class* fields_class) {
+  // Classes initialized by dex2oat are only initialized again when the code runs, but code
+  // compiled in the process that runs it sees classes that can never become uninitialized.
+  if (Runtime::Current()->IsCompiler() || !fields_class->IsInitialized()) {
+    return false;
+  }
+  // The runtime only fills the slot once the class is initialized, do it now so the code may load
+  // the static storage base without testing it.
+  dex_cache->GetInitializedStaticStorage()->Set(ssb_index, fields_class);
+  return true;
+}
+
 void CompilerDriver::GetCodeAndMethodForDirectCall(InvokeType type, InvokeType sharp_type,
                                                    mirror::Class* referrer_class,
                                                    mirror::ArtMethod* method,
@@ -1078,6 +1332,10 @@ void CompilerDriver::GetCodeAndMethodForDirectCall(InvokeType type, InvokeType s
   }
   bool method_code_in_boot = method->GetDeclaringClass()->GetClassLoader() == NULL;
   if (!method_code_in_boot) {
+    if (patch_call_sites_ && (type == kStatic || type == kDirect)) {
+      // The literal starts out as the resolution method, the runtime patches it.
+      direct_method = -1;
+    }
     return;
   }
   bool has_clinit_trampoline = method->IsStatic() && !method->GetDeclaringClass()->IsInitialized();
@@ -1289,6 +1547,29 @@ bool CompilerDriver::ComputeInvokeInfo(const DexCompilationUnit* mUnit, const ui
   return false;  // Incomplete knowledge needs slow path.
 }
 
+const DexFile::CodeItem* CompilerDriver::GetInlineCodeItem(const MethodReference& target_method,
+                                                           uint32_t& access_flags) {
+  ScopedObjectAccess soa(Thread::Current());
+  mirror::DexCache* dex_cache =
+      Runtime::Current()->GetClassLinker()->FindDexCache(*target_method.dex_file);
+  mirror::ArtMethod* method = dex_cache->GetResolvedMethod(target_method.dex_method_index);
+  if (method == NULL || method->IsNative() || method->IsAbstract()) {
+    return NULL;
+  }
+  // The resolved method may be inherited from a class of another dex file, whose code refers to
+  // fields and methods by that dex file's indices.
+  mirror::Class* methods_class = method->GetDeclaringClass();
+  if (methods_class->GetDexCache() != dex_cache || !methods_class->IsVerified()) {
+    return NULL;
+  }
+  // Methods that aren't compiled may be quickened by the dex to dex compiler while we read them.
+  if (IsLeftToInterpreter(*target_method.dex_file, target_method.dex_method_index)) {
+    return NULL;
+  }
+  access_flags = method->GetAccessFlags();
+  return target_method.dex_file->GetCodeItem(method->GetCodeItemOffset());
+}
+
 bool CompilerDriver::IsSafeCast(const MethodReference& mr, uint32_t dex_pc) {
   bool result = verifier::MethodVerifier::IsSafeCast(mr, dex_pc);
   if (result) {
@@ -1299,6 +1580,10 @@ bool CompilerDriver::IsSafeCast(const MethodReference& mr, uint32_t dex_pc) {
   return result;
 }
 
+void CompilerDriver::RecordAssembly(bool retried, size_t relaxation_passes) {
+  stats_->AssembledMethod(retried, relaxation_passes);
+}
+
 
 void CompilerDriver::AddCodePatch(const DexFile* dex_file,
                                   uint16_t referrer_class_def_idx,
@@ -2102,7 +2387,9 @@ static const char* class_initializer_black_list[] = {
   "Lorg/apache/http/conn/util/InetAddressUtils;",  // Calls regex.Pattern.compile -..-> regex.Pattern.compileImpl.
 };
 
-static void InitializeClass(const ParallelCompilationManager* manager, size_t class_def_index)
+// Initializes the class, one at a time with other serialized classes if serialize is set.
+static void InitializeClass(const ParallelCompilationManager* manager, size_t class_def_index,
+                            bool serialize)
     LOCKS_EXCLUDED(Locks::mutator_lock_) {
   ATRACE_CALL();
   jobject jclass_loader = manager->GetClassLoader();
@@ -2127,9 +2414,13 @@ static void InitializeClass(const ParallelCompilationManager* manager, size_t cl
         // sub-class' lock. While on a second thread the sub-class is initialized (holding its lock)
         // after first initializing its parents, whose locks are acquired. This leads to a
         // parent-to-child and a child-to-parent lock ordering and consequent potential deadlock.
+        // That can't happen for classes of groups which aren't serialized, see
+        // GroupClassesForInitialization: each such group is initialized by one thread, before
+        // any serialized class.
         // We need to use an ObjectLock due to potential suspension in the interpreting code. Rather
         // than use a special Object for the purpose we use the Class of java.lang.Class.
-        ObjectLock lock(soa.Self(), klass->GetClass());
+        UniquePtr<ObjectLock> lock(serialize ? new ObjectLock(soa.Self(), klass->GetClass())
+                                             : NULL);
         // Attempt to initialize allowing initialization of parent classes but still not static
         // fields.
         manager->GetClassLinker()->EnsureInitialized(klass, false, true);
@@ -2192,9 +2483,283 @@ void CompilerDriver::InitializeClasses(jobject jni_class_loader, const DexFile&
     }
   }
 #endif
+  GroupClassesForInitialization(jni_class_loader, dex_file);
   ClassLinker* class_linker = Runtime::Current()->GetClassLinker();
   ParallelCompilationManager context(class_linker, jni_class_loader, this, &dex_file, thread_pool);
-  context.ForAll(0, dex_file.NumClassDefs(), InitializeClass, thread_count_);
+  // Serialized groups may initialize classes of any other group, so they go last.
+  size_t parallel_group_count = 0;
+  while (parallel_group_count < class_init_groups_.size() &&
+         !class_init_groups_[parallel_group_count].serialize) {
+    ++parallel_group_count;
+  }
+  context.ForAll(0, parallel_group_count, InitializeClassGroup, thread_count_);
+  context.ForAll(parallel_group_count, class_init_groups_.size(), InitializeClassGroup,
+                 thread_count_);
+  class_init_order_.clear();
+  class_init_groups_.clear();
+}
+
+void CompilerDriver::InitializeClassGroup(const ParallelCompilationManager* manager,
+                                          size_t index) {
+  CompilerDriver* driver = manager->GetCompiler();
+  const ClassInitGroup& group = driver->class_init_groups_[index];
+  for (size_t i = group.begin; i != group.end; ++i) {
+    InitializeClass(manager, driver->class_init_order_[i], group.serialize);
+  }
+}
+
+// The most methods whose code is followed from a class initializer when looking for the classes
+// it may initialize.
+static const size_t kMaxClassInitMethods = 32;
+
+// Returns the class def of dex_file for the type, unless there's none or the runtime has loaded
+// another dex file's definition of the class.
+static const DexFile::ClassDef* FindUsedClassDef(const DexFile& dex_file, uint16_t type_idx,
+                                                 mirror::Class* klass)
+    SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
+  if (klass != NULL && (klass->GetDexCache() == NULL ||
+                        klass->GetDexCache()->GetDexFile() != &dex_file)) {
+    return NULL;
+  }
+  return dex_file.FindClassDef(type_idx);
+}
+
+static mirror::Class* LookupType(const DexFile& dex_file, uint16_t type_idx,
+                                 ClassLinker* class_linker,
+                                 const mirror::ClassLoader* class_loader)
+    SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
+  const char* descriptor = dex_file.StringByTypeIdx(type_idx);
+  mirror::Class* klass = class_linker->LookupClass(descriptor, class_loader);
+  if (klass == NULL && class_loader != NULL) {
+    klass = class_linker->LookupClass(descriptor, NULL);
+  }
+  return klass;
+}
+
+// Records that initializing a class may initialize the type's class. Returns false if that's an
+// uninitialized class of another dex file.
+static bool AddClassInitDependency(const DexFile& dex_file, uint16_t type_idx,
+                                   ClassLinker* class_linker,
+                                   const mirror::ClassLoader* class_loader,
+                                   std::vector<uint16_t>* dependencies)
+    SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
+  mirror::Class* klass = LookupType(dex_file, type_idx, class_linker, class_loader);
+  if (klass != NULL && klass->IsInitialized()) {
+    return true;
+  }
+  const DexFile::ClassDef* class_def = FindUsedClassDef(dex_file, type_idx, klass);
+  if (class_def == NULL) {
+    return false;
+  }
+  dependencies->push_back(dex_file.GetIndexForClassDef(*class_def));
+  return true;
+}
+
+// Returns the code of a direct method of the class def, or NULL if it has none.
+static const DexFile::CodeItem* FindDirectMethodCode(const DexFile& dex_file,
+                                                     const DexFile::ClassDef& class_def,
+                                                     uint32_t method_idx) {
+  const byte* class_data = dex_file.GetClassData(class_def);
+  if (class_data == NULL) {
+    return NULL;
+  }
+  ClassDataItemIterator it(dex_file, class_data);
+  while (it.HasNextStaticField() || it.HasNextInstanceField()) {
+    it.Next();
+  }
+  while (it.HasNextDirectMethod()) {
+    if (it.GetMemberIndex() == method_idx) {
+      return it.GetMethodCodeItem();
+    }
+    it.Next();
+  }
+  return NULL;
+}
+
+// Finds the classes of dex_file that initializing the class may initialize: its superclass, and
+// those whose static fields, static methods and constructors are used by its initializer and by
+// the static and direct methods that calls, transitively. Returns false if they can't be bounded:
+// the code makes virtual or interface calls, calls native methods or methods of other dex files,
+// is too big to follow, or uses uninitialized classes of other dex files.
+static bool FindClassInitDependencies(const DexFile& dex_file, const DexFile::ClassDef& class_def,
+                                      ClassLinker* class_linker,
+                                      const mirror::ClassLoader* class_loader,
+                                      std::vector<uint16_t>* dependencies)
+    SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
+  if (class_def.superclass_idx_ != DexFile::kDexNoIndex16 &&
+      !AddClassInitDependency(dex_file, class_def.superclass_idx_, class_linker, class_loader,
+                              dependencies)) {
+    return false;
+  }
+  const byte* class_data = dex_file.GetClassData(class_def);
+  if (class_data == NULL) {
+    return true;
+  }
+  std::vector<uint32_t> methods;
+  ClassDataItemIterator it(dex_file, class_data);
+  while (it.HasNextStaticField() || it.HasNextInstanceField()) {
+    it.Next();
+  }
+  while (it.HasNextDirectMethod()) {
+    uint32_t access_flags = it.GetMemberAccessFlags();
+    if ((access_flags & kAccConstructor) != 0 && (access_flags & kAccStatic) != 0) {
+      methods.push_back(it.GetMemberIndex());
+    }
+    it.Next();
+  }
+  for (size_t i = 0; i < methods.size(); ++i) {
+    if (i == kMaxClassInitMethods) {
+      return false;
+    }
+    const DexFile::MethodId& method_id = dex_file.GetMethodId(methods[i]);
+    mirror::Class* klass = LookupType(dex_file, method_id.class_idx_, class_linker, class_loader);
+    const DexFile::ClassDef* method_class_def =
+        FindUsedClassDef(dex_file, method_id.class_idx_, klass);
+    const DexFile::CodeItem* code_item = method_class_def == NULL ? NULL :
+        FindDirectMethodCode(dex_file, *method_class_def, methods[i]);
+    if (code_item == NULL) {
+      return false;  // Native, or not defined in this dex file.
+    }
+    const uint16_t* insns = code_item->insns_;
+    for (const Instruction* inst = Instruction::At(insns);
+         inst->GetDexPc(insns) < code_item->insns_size_in_code_units_; inst = inst->Next()) {
+      uint32_t invoked_method_idx;
+      switch (inst->Opcode()) {
+        case Instruction::SGET:
+        case Instruction::SGET_WIDE:
+        case Instruction::SGET_OBJECT:
+        case Instruction::SGET_BOOLEAN:
+        case Instruction::SGET_BYTE:
+        case Instruction::SGET_CHAR:
+        case Instruction::SGET_SHORT:
+        case Instruction::SPUT:
+        case Instruction::SPUT_WIDE:
+        case Instruction::SPUT_OBJECT:
+        case Instruction::SPUT_BOOLEAN:
+        case Instruction::SPUT_BYTE:
+        case Instruction::SPUT_CHAR:
+        case Instruction::SPUT_SHORT:
+          if (!AddClassInitDependency(dex_file, dex_file.GetFieldId(inst->VRegB_21c()).class_idx_,
+                                      class_linker, class_loader, dependencies)) {
+            return false;
+          }
+          continue;
+        case Instruction::NEW_INSTANCE:
+          // The constructor is followed when its invoke-direct is reached.
+          if (!AddClassInitDependency(dex_file, inst->VRegB_21c(), class_linker, class_loader,
+                                      dependencies)) {
+            return false;
+          }
+          continue;
+        case Instruction::INVOKE_DIRECT:
+        case Instruction::INVOKE_STATIC:
+          invoked_method_idx = inst->VRegB_35c();
+          break;
+        case Instruction::INVOKE_DIRECT_RANGE:
+        case Instruction::INVOKE_STATIC_RANGE:
+          invoked_method_idx = inst->VRegB_3rc();
+          break;
+        case Instruction::INVOKE_VIRTUAL:
+        case Instruction::INVOKE_SUPER:
+        case Instruction::INVOKE_INTERFACE:
+        case Instruction::INVOKE_VIRTUAL_RANGE:
+        case Instruction::INVOKE_SUPER_RANGE:
+        case Instruction::INVOKE_INTERFACE_RANGE:
+        case Instruction::INVOKE_VIRTUAL_QUICK:
+        case Instruction::INVOKE_VIRTUAL_RANGE_QUICK:
+        case Instruction::INVOKE_SUPER_QUICK:
+        case Instruction::INVOKE_SUPER_RANGE_QUICK:
+          return false;
+        default:
+          continue;
+      }
+      uint16_t invoked_class_idx = dex_file.GetMethodId(invoked_method_idx).class_idx_;
+      if (!AddClassInitDependency(dex_file, invoked_class_idx, class_linker, class_loader,
+                                  dependencies)) {
+        return false;
+      }
+      if (std::find(methods.begin(), methods.end(), invoked_method_idx) == methods.end()) {
+        methods.push_back(invoked_method_idx);
+      }
+    }
+  }
+  return true;
+}
+
+static size_t FindClassInitRoot(std::vector<uint32_t>* parents, size_t index) {
+  while ((*parents)[index] != index) {
+    (*parents)[index] = (*parents)[(*parents)[index]];
+    index = (*parents)[index];
+  }
+  return index;
+}
+
+void CompilerDriver::GroupClassesForInitialization(jobject jni_class_loader,
+                                                   const DexFile& dex_file) {
+  DCHECK(class_init_groups_.empty());
+  size_t class_def_count = dex_file.NumClassDefs();
+  // Classes which may initialize each other are joined in a union-find forest. A tree is
+  // serialized if any of its classes may initialize classes we can't tell.
+  std::vector<uint32_t> parents(class_def_count);
+  std::vector<bool> serialize(class_def_count, false);
+  for (size_t i = 0; i < class_def_count; ++i) {
+    parents[i] = i;
+  }
+  {
+    ScopedObjectAccess soa(Thread::Current());
+    const mirror::ClassLoader* class_loader =
+        soa.Decode<mirror::ClassLoader*>(jni_class_loader);
+    ClassLinker* class_linker = Runtime::Current()->GetClassLinker();
+    std::vector<uint16_t> dependencies;
+    for (size_t i = 0; i < class_def_count; ++i) {
+      dependencies.clear();
+      bool bounded = FindClassInitDependencies(dex_file, dex_file.GetClassDef(i), class_linker,
+                                               class_loader, &dependencies);
+      size_t root = FindClassInitRoot(&parents, i);
+      for (uint16_t dependency : dependencies) {
+        size_t other_root = FindClassInitRoot(&parents, dependency);
+        if (other_root != root) {
+          parents[other_root] = root;
+          serialize[root] = serialize[root] || serialize[other_root];
+        }
+      }
+      serialize[root] = serialize[root] || !bounded;
+    }
+  }
+
+  // Each group keeps its classes in class def order, which puts superclasses first.
+  std::vector<uint32_t> roots(class_def_count);
+  for (size_t i = 0; i < class_def_count; ++i) {
+    roots[i] = FindClassInitRoot(&parents, i);
+    class_init_order_.push_back(i);
+  }
+  std::stable_sort(class_init_order_.begin(), class_init_order_.end(),
+                   [&roots](uint16_t lhs, uint16_t rhs) {
+    return roots[lhs] < roots[rhs];
+  });
+  for (size_t i = 0; i < class_def_count; ++i) {
+    uint32_t root = roots[class_init_order_[i]];
+    if (i == 0 || roots[class_init_order_[i - 1]] != root) {
+      ClassInitGroup group = { i, i + 1, serialize[root] };
+      class_init_groups_.push_back(group);
+    } else {
+      class_init_groups_.back().end = i + 1;
+    }
+  }
+  // Groups which aren't serialized come first. Start with the biggest groups, as for methods to
+  // compile.
+  std::sort(class_init_groups_.begin(), class_init_groups_.end(),
+            [](const ClassInitGroup& lhs, const ClassInitGroup& rhs) {
+    if (lhs.serialize != rhs.serialize) {
+      return rhs.serialize;
+    }
+    if (lhs.end - lhs.begin != rhs.end - rhs.begin) {
+      return lhs.end - lhs.begin > rhs.end - rhs.begin;
+    }
+    return lhs.begin < rhs.begin;
+  });
+  VLOG(compiler) << dex_file.GetLocation() << ": " << class_def_count << " classes in "
+                 << class_init_groups_.size() << " initialization groups";
 }
 
 void CompilerDriver::InitializeClasses(jobject class_loader,
@@ -2216,7 +2781,8 @@ void CompilerDriver::Compile(jobject class_loader, const std::vector<const DexFi
   }
 }
 
-void CompilerDriver::CompileClass(const ParallelCompilationManager* manager, size_t class_def_index) {
+void CompilerDriver::GatherClassMethods(const ParallelCompilationManager* manager,
+                                        size_t class_def_index) {
   ATRACE_CALL();
   jobject jclass_loader = manager->GetClassLoader();
   const DexFile& dex_file = *manager->GetDexFile();
@@ -2243,6 +2809,15 @@ void CompilerDriver::CompileClass(const ParallelCompilationManager* manager, siz
     mirror::ClassLoader* class_loader = soa.Decode<mirror::ClassLoader*>(jclass_loader);
     dex_to_dex_compilation_level = GetDexToDexCompilationlevel(class_loader, dex_file, class_def);
   }
+  CompilerDriver* driver = manager->GetCompiler();
+  // Methods of a class that can be reused from the previous compilation are copied from it,
+  // by their index in the class like the oat writer's.
+  UniquePtr<const OatFile::OatClass> previous_oat_class;
+  if (driver->incremental_compilation_.get() != NULL) {
+    previous_oat_class.reset(
+        driver->incremental_compilation_->GetReusableClass(dex_file, class_def_index));
+  }
+  size_t class_method_index = 0;
   ClassDataItemIterator it(dex_file, class_data);
   // Skip fields
   while (it.HasNextStaticField()) {
@@ -2251,8 +2826,8 @@ void CompilerDriver::CompileClass(const ParallelCompilationManager* manager, siz
   while (it.HasNextInstanceField()) {
     it.Next();
   }
-  CompilerDriver* driver = manager->GetCompiler();
-  // Compile direct methods
+  std::vector<MethodCompilationItem> items;
+  // Gather direct methods
   int64_t previous_direct_method_idx = -1;
   while (it.HasNextDirectMethod()) {
     uint32_t method_idx = it.GetMemberIndex();
@@ -2260,15 +2835,21 @@ void CompilerDriver::CompileClass(const ParallelCompilationManager* manager, siz
       // smali can create dex files with two encoded_methods sharing the same method_idx
       // http://code.google.com/p/smali/issues/detail?id=119
       it.Next();
+      class_method_index++;
       continue;
     }
     previous_direct_method_idx = method_idx;
-    driver->CompileMethod(it.GetMethodCodeItem(), it.GetMemberAccessFlags(),
-                          it.GetMethodInvokeType(class_def), class_def_index,
-                          method_idx, jclass_loader, dex_file, dex_to_dex_compilation_level);
+    if (!driver->ReusePreviousCode(previous_oat_class.get(), class_method_index++,
+                                   it.GetMemberAccessFlags(), dex_file, method_idx)) {
+      MethodCompilationItem item = { it.GetMethodCodeItem(), it.GetMemberAccessFlags(),
+                                     it.GetMethodInvokeType(class_def),
+                                     static_cast<uint16_t>(class_def_index), method_idx,
+                                     dex_to_dex_compilation_level };
+      items.push_back(item);
+    }
     it.Next();
   }
-  // Compile virtual methods
+  // Gather virtual methods
   int64_t previous_virtual_method_idx = -1;
   while (it.HasNextVirtualMethod()) {
     uint32_t method_idx = it.GetMemberIndex();
@@ -2276,15 +2857,65 @@ void CompilerDriver::CompileClass(const ParallelCompilationManager* manager, siz
       // smali can create dex files with two encoded_methods sharing the same method_idx
       // http://code.google.com/p/smali/issues/detail?id=119
       it.Next();
+      class_method_index++;
       continue;
     }
     previous_virtual_method_idx = method_idx;
-    driver->CompileMethod(it.GetMethodCodeItem(), it.GetMemberAccessFlags(),
-                          it.GetMethodInvokeType(class_def), class_def_index,
-                          method_idx, jclass_loader, dex_file, dex_to_dex_compilation_level);
+    if (!driver->ReusePreviousCode(previous_oat_class.get(), class_method_index++,
+                                   it.GetMemberAccessFlags(), dex_file, method_idx)) {
+      MethodCompilationItem item = { it.GetMethodCodeItem(), it.GetMemberAccessFlags(),
+                                     it.GetMethodInvokeType(class_def),
+                                     static_cast<uint16_t>(class_def_index), method_idx,
+                                     dex_to_dex_compilation_level };
+      items.push_back(item);
+    }
     it.Next();
   }
   DCHECK(!it.HasNext());
+
+  MutexLock mu(Thread::Current(), driver->method_items_lock_);
+  driver->method_items_.insert(driver->method_items_.end(), items.begin(), items.end());
+}
+
+bool CompilerDriver::ReusePreviousCode(const OatFile::OatClass* previous_oat_class,
+                                       size_t class_method_index, uint32_t access_flags,
+                                       const DexFile& dex_file, uint32_t method_idx) {
+  // JNI stubs depend on the method's annotations, which aren't compared, and are cheap to compile.
+  if (previous_oat_class == NULL || (access_flags & kAccNative) != 0) {
+    return false;
+  }
+  CompiledMethod* compiled_method = incremental_compilation_->CopyMethod(
+      *this, previous_oat_class->GetOatMethod(class_method_index));
+  if (compiled_method == NULL) {
+    return false;
+  }
+  AddCompiledMethod(Thread::Current(), dex_file, method_idx, compiled_method);
+  return true;
+}
+
+void CompilerDriver::CompileMethodItem(const ParallelCompilationManager* manager, size_t index) {
+  CompilerDriver* driver = manager->GetCompiler();
+  const MethodCompilationItem& item = driver->method_items_[index];
+  driver->CompileMethod(item.code_item, item.access_flags, item.invoke_type, item.class_def_idx,
+                        item.method_idx, manager->GetClassLoader(), *manager->GetDexFile(),
+                        item.dex_to_dex_compilation_level);
+}
+
+// Compilation time is roughly proportional to the number of instructions, with native and
+// abstract methods the cheapest.
+static size_t EstimatedCompilationCost(const CompilerDriver::MethodCompilationItem& item) {
+  return (item.code_item != NULL) ? item.code_item->insns_size_in_code_units_ : 0;
+}
+
+// Orders methods largest first, then in dex file order so that the order is deterministic.
+static bool CompileBefore(const CompilerDriver::MethodCompilationItem& lhs,
+                          const CompilerDriver::MethodCompilationItem& rhs) {
+  size_t lhs_cost = EstimatedCompilationCost(lhs);
+  size_t rhs_cost = EstimatedCompilationCost(rhs);
+  if (lhs_cost != rhs_cost) {
+    return lhs_cost > rhs_cost;
+  }
+  return lhs.method_idx < rhs.method_idx;
 }
 
 void CompilerDriver::CompileDexFile(jobject class_loader, const DexFile& dex_file,
@@ -2292,7 +2923,154 @@ void CompilerDriver::CompileDexFile(jobject class_loader, const DexFile& dex_fil
   timings.NewSplit("Compile Dex File");
   ParallelCompilationManager context(Runtime::Current()->GetClassLinker(), class_loader, this,
                                      &dex_file, thread_pool);
-  context.ForAll(0, dex_file.NumClassDefs(), CompilerDriver::CompileClass, thread_count_);
+  DCHECK(method_items_.empty());
+  context.ForAll(0, dex_file.NumClassDefs(), CompilerDriver::GatherClassMethods, thread_count_);
+  // Start with the biggest methods so that the small ones fill in the gaps at the end, rather
+  // than a big one starting last and running on its own.
+  if (method_batch_size_ != 0) {
+    BatchMethodItems();
+    if (!method_batches_.empty()) {
+      context.ForAll(0, method_batches_.size(), CompilerDriver::CompileMethodBatch,
+                     thread_count_);
+    }
+    method_batches_.clear();
+  } else {
+    std::sort(method_items_.begin(), method_items_.end(), CompileBefore);
+    if (!method_items_.empty()) {
+      context.ForAll(0, method_items_.size(), CompilerDriver::CompileMethodItem, thread_count_);
+    }
+  }
+  method_items_.clear();
+}
+
+// Orders methods by class, then in dex file order.
+static bool InClassOrder(const CompilerDriver::MethodCompilationItem& lhs,
+                         const CompilerDriver::MethodCompilationItem& rhs) {
+  if (lhs.class_def_idx != rhs.class_def_idx) {
+    return lhs.class_def_idx < rhs.class_def_idx;
+  }
+  return lhs.method_idx < rhs.method_idx;
+}
+
+void CompilerDriver::BatchMethodItems() {
+  DCHECK(method_batches_.empty());
+  std::sort(method_items_.begin(), method_items_.end(), InClassOrder);
+  for (size_t i = 0; i < method_items_.size(); ++i) {
+    size_t code_units = EstimatedCompilationCost(method_items_[i]);
+    if (!method_batches_.empty()) {
+      MethodBatch& batch = method_batches_.back();
+      if (method_items_[batch.begin].class_def_idx == method_items_[i].class_def_idx &&
+          batch.code_units + code_units <= method_batch_size_) {
+        batch.end = i + 1;
+        batch.code_units += code_units;
+        continue;
+      }
+    }
+    MethodBatch batch = { i, i + 1, code_units };
+    method_batches_.push_back(batch);
+  }
+  // As for single methods, start with the biggest batches.
+  std::sort(method_batches_.begin(), method_batches_.end(),
+            [](const MethodBatch& lhs, const MethodBatch& rhs) {
+    if (lhs.code_units != rhs.code_units) {
+      return lhs.code_units > rhs.code_units;
+    }
+    return lhs.begin < rhs.begin;
+  });
+}
+
+void CompilerDriver::CompileMethodBatch(const ParallelCompilationManager* manager, size_t index) {
+  CompilerDriver* driver = manager->GetCompiler();
+  const MethodBatch& batch = driver->method_batches_[index];
+  driver->CompileMethods(&driver->method_items_[batch.begin], batch.end - batch.begin,
+                         manager->GetClassLoader(), *manager->GetDexFile());
+}
+
+bool CompilerDriver::UsesCompilerFn(const MethodCompilationItem& item,
+                                    const DexFile& dex_file) const {
+  if ((item.access_flags & (kAccNative | kAccAbstract)) != 0) {
+    return false;
+  }
+  MethodReference method_ref(&dex_file, item.method_idx);
+  return verifier::MethodVerifier::IsCandidateForCompilation(method_ref, item.access_flags) &&
+      !IsLeftToInterpreter(dex_file, item.method_idx);
+}
+
+void CompilerDriver::CompileMethods(const MethodCompilationItem* items, size_t count,
+                                    jobject class_loader, const DexFile& dex_file) {
+  std::vector<const MethodCompilationItem*> batch;
+  for (size_t i = 0; i < count; ++i) {
+    if (UsesCompilerFn(items[i], dex_file)) {
+      batch.push_back(&items[i]);
+    } else {
+      CompileMethod(items[i].code_item, items[i].access_flags, items[i].invoke_type,
+                    items[i].class_def_idx, items[i].method_idx, class_loader, dex_file,
+                    items[i].dex_to_dex_compilation_level);
+    }
+  }
+  if (batch.size() <= 1 || batch_compiler_ == NULL) {
+    for (const MethodCompilationItem* item : batch) {
+      CompileMethod(item->code_item, item->access_flags, item->invoke_type, item->class_def_idx,
+                    item->method_idx, class_loader, dex_file, item->dex_to_dex_compilation_level);
+    }
+    return;
+  }
+
+  uint64_t start_ns = NanoTime();
+  std::vector<CompiledMethod*> compiled_methods;
+  (*batch_compiler_)(*this, batch, class_loader, dex_file, &compiled_methods);
+  CHECK_EQ(compiled_methods.size(), batch.size());
+  uint64_t duration_ns = NanoTime() - start_ns;
+  VLOG(compiler) << "Compiled " << batch.size() << " methods of "
+                 << PrettyMethod(batch[0]->method_idx, dex_file) << "'s class together in "
+                 << PrettyDuration(duration_ns);
+
+  Thread* self = Thread::Current();
+  for (size_t i = 0; i < batch.size(); ++i) {
+    AddCompiledMethod(self, dex_file, batch[i]->method_idx, compiled_methods[i]);
+  }
+}
+
+// Descriptor of the annotation marking native methods whose JNI stub may skip the thread state
+// change and the local reference frame, see ArtJniCompileMethodInternal for the contract.
+static const char* kFastNativeAnnotationDescriptor = "Ldalvik/annotation/optimization/FastNative;";
+// Descriptor of the annotation marking static native methods taking and returning only primitives
+// whose JNI stub calls them directly, without a JNIEnv* or jclass.
+static const char* kCriticalNativeAnnotationDescriptor =
+    "Ldalvik/annotation/optimization/CriticalNative;";
+
+static bool HasMethodAnnotation(const DexFile& dex_file, uint16_t class_def_idx,
+                                uint32_t method_idx, const char* descriptor) {
+  const DexFile::ClassDef& class_def = dex_file.GetClassDef(class_def_idx);
+  if (class_def.annotations_off_ == 0) {
+    return false;
+  }
+  const byte* begin = dex_file.Begin();
+  const DexFile::AnnotationsDirectoryItem* directory =
+      reinterpret_cast<const DexFile::AnnotationsDirectoryItem*>(begin + class_def.annotations_off_);
+  // The method annotations follow the directory and its field annotations.
+  const DexFile::FieldAnnotationsItem* fields =
+      reinterpret_cast<const DexFile::FieldAnnotationsItem*>(directory + 1);
+  const DexFile::MethodAnnotationsItem* methods =
+      reinterpret_cast<const DexFile::MethodAnnotationsItem*>(fields + directory->fields_size_);
+  for (uint32_t i = 0; i < directory->methods_size_; ++i) {
+    if (methods[i].method_idx_ != method_idx) {
+      continue;
+    }
+    const DexFile::AnnotationSetItem* set =
+        reinterpret_cast<const DexFile::AnnotationSetItem*>(begin + methods[i].annotations_off_);
+    for (uint32_t j = 0; j < set->size_; ++j) {
+      const DexFile::AnnotationItem* annotation =
+          reinterpret_cast<const DexFile::AnnotationItem*>(begin + set->entries_[j]);
+      const byte* encoded_annotation = annotation->annotation_;
+      uint32_t type_idx = DecodeUnsignedLeb128(&encoded_annotation);
+      if (strcmp(dex_file.StringByTypeIdx(type_idx), descriptor) == 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+  return false;
 }
 
 void CompilerDriver::CompileMethod(const DexFile::CodeItem* code_item, uint32_t access_flags,
@@ -2304,12 +3082,32 @@ void CompilerDriver::CompileMethod(const DexFile::CodeItem* code_item, uint32_t
   uint64_t start_ns = NanoTime();
 
   if ((access_flags & kAccNative) != 0) {
+    if (HasMethodAnnotation(dex_file, class_def_idx, method_idx,
+                            kCriticalNativeAnnotationDescriptor)) {
+      const char* shorty = dex_file.GetMethodShorty(dex_file.GetMethodId(method_idx));
+      if ((access_flags & kAccStatic) == 0 || (access_flags & kAccSynchronized) != 0 ||
+          strchr(shorty, 'L') != NULL) {
+        LOG(WARNING) << "Ignoring @CriticalNative on " << PrettyMethod(method_idx, dex_file)
+                     << ", it must be static, unsynchronized and take and return only primitives";
+      } else if (compiler_backend_ != kQuick) {
+        LOG(WARNING) << "Ignoring @CriticalNative on " << PrettyMethod(method_idx, dex_file)
+                     << ", only the quick backend supports it";
+      } else {
+        access_flags |= kAccCriticalNative;
+      }
+    }
+    if ((access_flags & kAccCriticalNative) == 0 &&
+        HasMethodAnnotation(dex_file, class_def_idx, method_idx,
+                            kFastNativeAnnotationDescriptor)) {
+      access_flags |= kAccFastNative;
+    }
     compiled_method = (*jni_compiler_)(*this, access_flags, method_idx, dex_file);
     CHECK(compiled_method != NULL);
   } else if ((access_flags & kAccAbstract) != 0) {
   } else {
     MethodReference method_ref(&dex_file, method_idx);
-    bool compile = verifier::MethodVerifier::IsCandidateForCompilation(method_ref, access_flags);
+    bool compile = verifier::MethodVerifier::IsCandidateForCompilation(method_ref, access_flags) &&
+        !IsLeftToInterpreter(dex_file, method_idx);
 
     if (compile) {
       CompilerFn compiler = compiler_;
@@ -2344,7 +3142,11 @@ void CompilerDriver::CompileMethod(const DexFile::CodeItem* code_item, uint32_t
                  << " took " << PrettyDuration(duration_ns);
   }
 
-  Thread* self = Thread::Current();
+  AddCompiledMethod(Thread::Current(), dex_file, method_idx, compiled_method);
+}
+
+void CompilerDriver::AddCompiledMethod(Thread* self, const DexFile& dex_file, uint32_t method_idx,
+                                       CompiledMethod* compiled_method) {
   if (compiled_method != NULL) {
     MethodReference ref(&dex_file, method_idx);
     DCHECK(GetCompiledMethod(ref) == NULL) << PrettyMethod(method_idx, dex_file);
@@ -2353,6 +3155,7 @@ void CompilerDriver::CompileMethod(const DexFile::CodeItem* code_item, uint32_t
       compiled_methods_.Put(ref, compiled_method);
     }
     DCHECK(GetCompiledMethod(ref) != NULL) << PrettyMethod(method_idx, dex_file);
+    SpillIfOverBudget(self);
   }
 
   if (self->IsExceptionPending()) {
@@ -2408,6 +3211,37 @@ CompiledMethod* CompilerDriver::GetCompiledMethod(MethodReference ref) const {
   return it->second;
 }
 
+static uint64_t TotalCount(const MethodProfile::Counts& counts) {
+  return static_cast<uint64_t>(counts.invocations) + counts.backedges;
+}
+
+bool CompilerDriver::IsProfiledHot(const DexFile& dex_file, uint32_t method_idx) const {
+  if (method_profile_ == NULL) {
+    return false;
+  }
+  const MethodProfile::Counts* counts = method_profile_->FindCounts(dex_file, method_idx);
+  return counts != NULL && TotalCount(*counts) >= profile_hot_threshold_;
+}
+
+bool CompilerDriver::IsProfiledCold(const DexFile& dex_file, uint32_t method_idx) const {
+  if (method_profile_ == NULL) {
+    return false;
+  }
+  const MethodProfile::Counts* counts = method_profile_->FindCounts(dex_file, method_idx);
+  return counts != NULL && TotalCount(*counts) < profile_hot_threshold_;
+}
+
+bool CompilerDriver::IsLeftToInterpreter(const DexFile& dex_file, uint32_t method_idx) const {
+  return !compress_cold_code_ && IsProfiledCold(dex_file, method_idx);
+}
+
+bool CompilerDriver::UseLinearScanPromotion(const DexFile& dex_file, uint32_t method_idx) const {
+  if (linear_scan_method_filter_.empty()) {
+    return false;
+  }
+  return PrettyMethod(method_idx, dex_file).find(linear_scan_method_filter_) != std::string::npos;
+}
+
 void CompilerDriver::SetBitcodeFileName(std::string const& filename) {
   typedef void (*SetBitcodeFileNameFn)(CompilerDriver&, std::string const&);
 
@@ -2417,6 +3251,16 @@ void CompilerDriver::SetBitcodeFileName(std::string const& filename) {
   set_bitcode_file_name(*this, filename);
 }
 
+void CompilerDriver::SetCompilationCacheDirectory(std::string const& directory) {
+  CHECK_EQ(compiler_backend_, kPortable);
+  typedef void (*SetCompilationCacheDirectoryFn)(CompilerDriver&, std::string const&);
+
+  SetCompilationCacheDirectoryFn set_compilation_cache_directory =
+    reinterpret_cast<SetCompilationCacheDirectoryFn>(compilerLLVMSetCompilationCacheDirectory);
+
+  set_compilation_cache_directory(*this, directory);
+}
+
 
 void CompilerDriver::AddRequiresConstructorBarrier(Thread* self, const DexFile* dex_file,
                                                    uint16_t class_def_index) {
@@ -2476,3 +3320,42 @@ void CompilerDriver::InstructionSetToLLVMTarget(InstructionSet instruction_set,
     }
   }
 }  // namespace art
+
+// Entry point of the runtime's hot method compiler, see HotMethodCompiler::CompileFn.
+extern "C" bool ArtCompileHotMethod(art::HotMethodCompiler& hot_method_compiler,
+                                    art::mirror::ArtMethod* method) {
+#if defined(__arm__)
+  const art::InstructionSet instruction_set = art::kThumb2;
+#elif defined(__i386__)
+  const art::InstructionSet instruction_set = art::kX86;
+#elif defined(__mips__)
+  const art::InstructionSet instruction_set = art::kMips;
+#else
+#error "Unsupported architecture"
+#endif
+  // Only ever called from the hot method compiler's thread.
+  static art::CompilerDriver* driver = NULL;
+  if (driver == NULL) {
+    driver = new art::CompilerDriver(art::kQuick, instruction_set, false, NULL, 1, false);
+    // Hot methods get compiled whatever the compiler filter says.
+    driver->SetMethodProfile(art::Runtime::Current()->GetMethodProfile(),
+                             hot_method_compiler.GetThreshold());
+    driver->SetGenerateOsrEntries(true);
+    // Only Thumb2 code loads call targets from literals.
+    driver->SetPatchCallSites(instruction_set == art::kThumb2);
+  }
+  const art::CompiledMethod* compiled_method = driver->CompileHotMethod(method);
+  if (compiled_method == NULL) {
+    return false;
+  }
+  return hot_method_compiler.InstallCode(method, compiled_method->GetInstructionSet(),
+                                         compiled_method->GetFrameSizeInBytes(),
+                                         compiled_method->GetCoreSpillMask(),
+                                         compiled_method->GetFpSpillMask(),
+                                         compiled_method->GetCode(),
+                                         compiled_method->GetMappingTable(),
+                                         compiled_method->GetVmapTable(),
+                                         compiled_method->GetGcMap(),
+                                         compiled_method->GetOsrDexPcs(),
+                                         compiled_method->GetCallSites());
+}
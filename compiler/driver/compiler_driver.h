@@ -21,6 +21,7 @@
 #include <string>
 #include <vector>
 
+#include "atomic_integer.h"
 #include "base/mutex.h"
 #include "class_reference.h"
 #include "compiled_class.h"
@@ -30,17 +31,21 @@
 #include "instruction_set.h"
 #include "invoke_type.h"
 #include "method_reference.h"
+#include "oat_file.h"
 #include "os.h"
 #include "runtime.h"
 #include "safe_map.h"
 #include "thread_pool.h"
 #include "utils/dedupe_set.h"
+#include "utils/spill_space.h"
 
 namespace art {
 
 class AOTCompilationStats;
 class ParallelCompilationManager;
 class DexCompilationUnit;
+class IncrementalCompilation;
+class MethodProfile;
 class OatWriter;
 class TimingLogger;
 
@@ -104,10 +109,24 @@ class CompilerDriver {
   void CompileOne(const mirror::ArtMethod* method, base::TimingLogger& timings)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
 
+  // Compile a method of an application that is already running, for the runtime's hot method
+  // compiler. Returns NULL if the method can't be compiled. Called in the kNative state.
+  const CompiledMethod* CompileHotMethod(mirror::ArtMethod* method)
+      LOCKS_EXCLUDED(Locks::mutator_lock_);
+
   InstructionSet GetInstructionSet() const {
     return instruction_set_;
   }
 
+  // Optional features of the target, such as hardware divide, that generated code may use.
+  const InstructionSetFeatures& GetInstructionSetFeatures() const {
+    return instruction_set_features_;
+  }
+
+  void SetInstructionSetFeatures(const InstructionSetFeatures& features) {
+    instruction_set_features_ = features;
+  }
+
   CompilerBackend GetCompilerBackend() const {
     return compiler_backend_;
   }
@@ -145,6 +164,11 @@ class CompilerDriver {
   CompiledMethod* GetCompiledMethod(MethodReference ref) const
       LOCKS_EXCLUDED(compiled_methods_lock_);
 
+  // Frees the compiled methods along with their deduplicated code and tables, for use once they
+  // have been written out. GetCompiledMethod returns NULL for every method afterwards.
+  void ReleaseCompiledMethods()
+      LOCKS_EXCLUDED(compiled_methods_lock_);
+
   void AddRequiresConstructorBarrier(Thread* self, const DexFile* dex_file,
                                      uint16_t class_def_index);
   bool RequiresConstructorBarrier(Thread* self, const DexFile* dex_file, uint16_t class_def_index);
@@ -157,6 +181,11 @@ class CompilerDriver {
   bool CanAssumeStringIsPresentInDexCache(const DexFile& dex_file, uint32_t string_idx)
       LOCKS_EXCLUDED(Locks::mutator_lock_);
 
+  // Is every instance of sub_type_idx an instance of super_type_idx? False if either type isn't
+  // resolved.
+  bool IsAssignableType(const DexFile& dex_file, uint32_t super_type_idx, uint32_t sub_type_idx)
+      LOCKS_EXCLUDED(Locks::mutator_lock_);
+
   // Are runtime access checks necessary in the compiled code?
   bool CanAccessTypeWithoutChecks(uint32_t referrer_idx, const DexFile& dex_file,
                                   uint32_t type_idx, bool* type_known_final = NULL,
@@ -169,16 +198,24 @@ class CompilerDriver {
                                               uint32_t type_idx)
      LOCKS_EXCLUDED(Locks::mutator_lock_);
 
+  // Can an allocation of type_idx that nothing ever sees be removed? True if the referrer can
+  // instantiate the class without checks, the class is already initialized and it isn't
+  // finalizable, so allocating it has no effect other than taking memory.
+  bool CanRemoveAllocation(uint32_t referrer_idx, const DexFile& dex_file, uint32_t type_idx)
+      LOCKS_EXCLUDED(Locks::mutator_lock_);
+
   // Can we fast path instance field access? Computes field's offset and volatility.
   bool ComputeInstanceFieldInfo(uint32_t field_idx, const DexCompilationUnit* mUnit,
                                 int& field_offset, bool& is_volatile, bool is_put)
       LOCKS_EXCLUDED(Locks::mutator_lock_);
 
   // Can we fastpath static field access? Computes field's offset, volatility and whether the
-  // field is within the referrer (which can avoid checking class initialization).
+  // field is within the referrer or a class known to be initialized (either of which avoids
+  // checking class initialization).
   bool ComputeStaticFieldInfo(uint32_t field_idx, const DexCompilationUnit* mUnit,
                               int& field_offset, int& ssb_index,
-                              bool& is_referrers_class, bool& is_volatile, bool is_put)
+                              bool& is_referrers_class, bool& is_initialized,
+                              bool& is_volatile, bool is_put)
       LOCKS_EXCLUDED(Locks::mutator_lock_);
 
   // Can we fastpath a interface, super class or virtual method call? Computes method's vtable
@@ -188,8 +225,19 @@ class CompilerDriver {
                          uintptr_t& direct_code, uintptr_t& direct_method, bool update_stats)
       LOCKS_EXCLUDED(Locks::mutator_lock_);
 
+  // Returns the code item of a resolved method for inlining into methods of the same dex file, or
+  // NULL if the method isn't resolved, has no code, won't be compiled or its class isn't verified
+  // or comes from another dex file.
+  const DexFile::CodeItem* GetInlineCodeItem(const MethodReference& target_method,
+                                             uint32_t& access_flags)
+      LOCKS_EXCLUDED(Locks::mutator_lock_);
+
   bool IsSafeCast(const MethodReference& mr, uint32_t dex_pc);
 
+  // Record how many relaxation passes a method's assembly took and whether the assembler still
+  // had to start over.
+  void RecordAssembly(bool retried, size_t relaxation_passes);
+
   // Record patch information for later fix up.
   void AddCodePatch(const DexFile* dex_file,
                     uint16_t referrer_class_def_idx,
@@ -210,6 +258,96 @@ class CompilerDriver {
 
   void SetBitcodeFileName(std::string const& filename);
 
+  // Only for the portable backend, see CompilerLLVM::SetCompilationCacheDirectory.
+  void SetCompilationCacheDirectory(std::string const& directory);
+
+  // Compile the methods of a class together in batches of up to max_code_units code units, so
+  // that small methods share the fixed cost of an LLVM module. Only for the portable backend, 0
+  // compiles each method on its own.
+  void SetMethodBatchSize(size_t max_code_units) {
+    CHECK(max_code_units == 0 || compiler_backend_ == kPortable);
+    method_batch_size_ = max_code_units;
+  }
+
+  // Compile only the methods the profile counts at least hot_threshold invocations and backedges
+  // for, leaving the others to the interpreter. Methods of dex files the profile has nothing on
+  // are compiled as without a profile.
+  void SetMethodProfile(MethodProfile* method_profile, uint32_t hot_threshold) {
+    method_profile_ = method_profile;
+    profile_hot_threshold_ = hot_threshold;
+  }
+
+  bool HasMethodProfile() const {
+    return method_profile_ != NULL;
+  }
+
+  // Is the method hot in the profile? Hot methods are compiled regardless of the compiler
+  // filter's size heuristics.
+  bool IsProfiledHot(const DexFile& dex_file, uint32_t method_idx) const;
+
+  // Is the method in a profiled dex file without being hot?
+  bool IsProfiledCold(const DexFile& dex_file, uint32_t method_idx) const;
+
+  // Compile the methods the profile finds cold as well, for the oat writer to store their code
+  // compressed, rather than leaving them to the interpreter. Quick backend only.
+  void SetCompressColdCode(bool compress_cold_code) {
+    CHECK(!compress_cold_code || compiler_backend_ == kQuick);
+    compress_cold_code_ = compress_cold_code;
+  }
+
+  bool CompressesColdCode() const {
+    return compress_cold_code_;
+  }
+
+  // Reuse the code of the classes that haven't changed since the previous oat file of
+  // incremental_compilation rather than compiling them. Takes ownership. Quick backend only, and
+  // not for images, whose code is patched.
+  void SetIncrementalCompilation(IncrementalCompilation* incremental_compilation) {
+    CHECK(compiler_backend_ == kQuick);
+    CHECK(!image_);
+    incremental_compilation_.reset(incremental_compilation);
+  }
+
+  // Give quick code for the hot method compiler entries at its loop headers, so that the
+  // interpreter can switch to it in the middle of a long running loop.
+  void SetGenerateOsrEntries(bool generate_osr_entries) {
+    generate_osr_entries_ = generate_osr_entries;
+  }
+
+  bool GeneratesOsrEntries() const {
+    return generate_osr_entries_;
+  }
+
+  // Have static and direct calls to methods outside the boot image load their target from a
+  // literal of their own, which the runtime points at the target once it is resolved rather than
+  // going through the dex cache. Only for code the hot method compiler installs in its writable
+  // code cache.
+  void SetPatchCallSites(bool patch_call_sites) {
+    patch_call_sites_ = patch_call_sites;
+  }
+
+  bool PatchesCallSites() const {
+    return patch_call_sites_;
+  }
+
+  // Lay the oat file out so that its code starts on a huge page boundary, both in the file and
+  // once loaded, for the kernel to be able to map it with file-backed huge pages.
+  void SetAlignTextToHugePages(bool align_text_to_huge_pages) {
+    align_text_to_huge_pages_ = align_text_to_huge_pages;
+  }
+
+  bool AlignsTextToHugePages() const {
+    return align_text_to_huge_pages_;
+  }
+
+  // Promote the core registers of methods whose pretty name contains filter by live interval
+  // rather than by use count.
+  void SetLinearScanMethodFilter(const std::string& filter) {
+    linear_scan_method_filter_ = filter;
+  }
+
+  bool UseLinearScanPromotion(const DexFile& dex_file, uint32_t method_idx) const;
+
   bool GetSupportBootImageFixup() const {
     return support_boot_image_fixup_;
   }
@@ -222,6 +360,19 @@ class CompilerDriver {
     return arena_pool_;
   }
 
+  const ArenaPool& GetArenaPool() const {
+    return arena_pool_;
+  }
+
+  // Once the compiled code and tables kept in memory exceed budget_bytes, they are moved out to
+  // spill_space, which the driver takes ownership of. Only for the quick backend.
+  void SetMemoryBudget(size_t budget_bytes, SpillSpace* spill_space);
+
+  // Returns the contents of compiled code or a table, which are read into buffer if they were
+  // spilled.
+  const std::vector<uint8_t>& GetCompiledData(const std::vector<uint8_t>& data,
+                                              std::vector<uint8_t>* buffer) const;
+
   bool WriteElf(const std::string& android_root,
                 bool is_host,
                 const std::vector<const DexFile*>& dex_files,
@@ -318,7 +469,28 @@ class CompilerDriver {
   std::vector<uint8_t>* DeduplicateVMapTable(const std::vector<uint8_t>& code);
   std::vector<uint8_t>* DeduplicateGCMap(const std::vector<uint8_t>& code);
 
+  // Spills the compiled code and tables if over the memory budget.
+  void SpillIfOverBudget(Thread* self) LOCKS_EXCLUDED(spill_lock_);
+
+  // A method waiting to be compiled. Methods of all classes of a dex file are gathered first and
+  // then compiled largest first, so that a class with many big methods doesn't leave a long
+  // serial tail at the end of compilation.
+  struct MethodCompilationItem {
+    const DexFile::CodeItem* code_item;
+    uint32_t access_flags;
+    InvokeType invoke_type;
+    uint16_t class_def_idx;
+    uint32_t method_idx;
+    DexToDexCompilationLevel dex_to_dex_compilation_level;
+  };
+
  private:
+  // Whether code compiled now may use fields_class's static storage without checking that the
+  // class is initialized. If so, the referrer's static storage slot is filled in for the code.
+  bool IsStaticStorageInitialized(mirror::DexCache* dex_cache, int ssb_index,
+                                  mirror::Class* fields_class)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
   // Compute constant code and method pointers when possible
   void GetCodeAndMethodForDirectCall(InvokeType type, InvokeType sharp_type,
                                      mirror::Class* referrer_class,
@@ -356,6 +528,12 @@ class CompilerDriver {
                          ThreadPool& thread_pool, base::TimingLogger& timings)
       LOCKS_EXCLUDED(Locks::mutator_lock_, compiled_classes_lock_);
 
+  // Fills in class_init_groups_ for the classes of dex_file.
+  void GroupClassesForInitialization(jobject class_loader, const DexFile& dex_file)
+      LOCKS_EXCLUDED(Locks::mutator_lock_);
+  static void InitializeClassGroup(const ParallelCompilationManager* context, size_t index)
+      LOCKS_EXCLUDED(Locks::mutator_lock_);
+
   void UpdateImageClasses(base::TimingLogger& timings);
   static void FindClinitImageClassesCallback(mirror::Object* object, void* arg)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
@@ -371,8 +549,30 @@ class CompilerDriver {
                      DexToDexCompilationLevel dex_to_dex_compilation_level)
       LOCKS_EXCLUDED(compiled_methods_lock_);
 
-  static void CompileClass(const ParallelCompilationManager* context, size_t class_def_index)
+  static void GatherClassMethods(const ParallelCompilationManager* context,
+                                 size_t class_def_index)
+      LOCKS_EXCLUDED(Locks::mutator_lock_, method_items_lock_);
+  static void CompileMethodItem(const ParallelCompilationManager* context, size_t index)
       LOCKS_EXCLUDED(Locks::mutator_lock_);
+  static void CompileMethodBatch(const ParallelCompilationManager* context, size_t index)
+      LOCKS_EXCLUDED(Locks::mutator_lock_);
+  // Splits method_items_ into batches of methods of the same class.
+  void BatchMethodItems();
+  void CompileMethods(const MethodCompilationItem* items, size_t count, jobject class_loader,
+                      const DexFile& dex_file)
+      LOCKS_EXCLUDED(compiled_methods_lock_);
+  // Would the method go to compiler_ rather than the JNI or DEX-to-DEX compilers?
+  bool UsesCompilerFn(const MethodCompilationItem& item, const DexFile& dex_file) const;
+  // Is the method cold in the profile, and so left to the interpreter rather than compiled?
+  bool IsLeftToInterpreter(const DexFile& dex_file, uint32_t method_idx) const;
+  void AddCompiledMethod(Thread* self, const DexFile& dex_file, uint32_t method_idx,
+                         CompiledMethod* compiled_method)
+      LOCKS_EXCLUDED(compiled_methods_lock_);
+  // Adds the previous compilation of a method of a reusable class, returns false if there is
+  // none and the method must be compiled.
+  bool ReusePreviousCode(const OatFile::OatClass* previous_oat_class, size_t class_method_index,
+                         uint32_t access_flags, const DexFile& dex_file, uint32_t method_idx)
+      LOCKS_EXCLUDED(compiled_methods_lock_);
 
   std::vector<const PatchInformation*> code_to_patch_;
   std::vector<const PatchInformation*> methods_to_patch_;
@@ -380,6 +580,7 @@ class CompilerDriver {
   CompilerBackend compiler_backend_;
 
   InstructionSet instruction_set_;
+  InstructionSetFeatures instruction_set_features_;
 
   // All class references that require
   mutable ReaderWriterMutex freezing_constructor_lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
@@ -395,6 +596,34 @@ class CompilerDriver {
   mutable Mutex compiled_methods_lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
   MethodTable compiled_methods_ GUARDED_BY(compiled_methods_lock_);
 
+  // Methods of the dex file being compiled. Only appended to while gathering, so it is read
+  // without the lock while compiling.
+  Mutex method_items_lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
+  std::vector<MethodCompilationItem> method_items_;
+
+  // Ranges of method_items_ compiled together, when batching.
+  struct MethodBatch {
+    size_t begin;
+    size_t end;
+    size_t code_units;
+  };
+  std::vector<MethodBatch> method_batches_;
+  size_t method_batch_size_;
+
+  // The classes of the dex file being initialized, in groups such that initializing the classes
+  // of one group can't initialize those of another. Each group is initialized by one thread, and
+  // groups run in parallel.
+  struct ClassInitGroup {
+    // The range of class_init_order_ holding the group's class def indexes.
+    size_t begin;
+    size_t end;
+    // Whether initializing the group's classes might initialize classes we can't tell, in which
+    // case they are initialized one at a time like those of other such groups.
+    bool serialize;
+  };
+  std::vector<uint16_t> class_init_order_;
+  std::vector<ClassInitGroup> class_init_groups_;
+
   const bool image_;
 
   // If image_ is true, specifies the classes that will be included in
@@ -409,6 +638,20 @@ class CompilerDriver {
 
   bool dump_stats_;
 
+  MethodProfile* method_profile_;
+  uint32_t profile_hot_threshold_;
+  bool compress_cold_code_;
+
+  UniquePtr<IncrementalCompilation> incremental_compilation_;
+
+  bool generate_osr_entries_;
+
+  bool patch_call_sites_;
+
+  bool align_text_to_huge_pages_;
+
+  std::string linear_scan_method_filter_;
+
   typedef void (*CompilerCallbackFn)(CompilerDriver& driver);
   typedef MutexLock* (*CompilerMutexLockFn)(CompilerDriver& driver);
 
@@ -433,6 +676,12 @@ class CompilerDriver {
 
   DexToDexCompilerFn dex_to_dex_compiler_;
 
+  typedef void (*BatchCompilerFn)(CompilerDriver& driver,
+                                  const std::vector<const MethodCompilationItem*>& items,
+                                  jobject class_loader, const DexFile& dex_file,
+                                  std::vector<CompiledMethod*>* compiled_methods);
+  BatchCompilerFn batch_compiler_;
+
   void* compiler_context_;
 
   typedef CompiledMethod* (*JniCompilerFn)(CompilerDriver& driver,
@@ -475,10 +724,16 @@ class CompilerDriver {
       return hash;
     }
   };
-  DedupeSet<std::vector<uint8_t>, size_t, DedupeHashFunc> dedupe_code_;
-  DedupeSet<std::vector<uint8_t>, size_t, DedupeHashFunc> dedupe_mapping_table_;
-  DedupeSet<std::vector<uint8_t>, size_t, DedupeHashFunc> dedupe_vmap_table_;
-  DedupeSet<std::vector<uint8_t>, size_t, DedupeHashFunc> dedupe_gc_map_;
+  DedupeSet<std::vector<uint8_t>, size_t, DedupeHashFunc, 4> dedupe_code_;
+  DedupeSet<std::vector<uint8_t>, size_t, DedupeHashFunc, 4> dedupe_mapping_table_;
+  DedupeSet<std::vector<uint8_t>, size_t, DedupeHashFunc, 4> dedupe_vmap_table_;
+  DedupeSet<std::vector<uint8_t>, size_t, DedupeHashFunc, 4> dedupe_gc_map_;
+
+  // Bytes of compiled code and tables added to the dedupe sets since they were last spilled.
+  AtomicInteger resident_compiled_bytes_;
+  size_t memory_budget_;
+  UniquePtr<SpillSpace> spill_space_;
+  Mutex spill_lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
 
   DISALLOW_COPY_AND_ASSIGN(CompilerDriver);
 };
@@ -0,0 +1,500 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "incremental_compilation.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "base/logging.h"
+#include "compiled_method.h"
+#include "dex_instruction.h"
+#include "gc_map.h"
+#include "leb128.h"
+#include "mapping_table.h"
+#include "UniquePtr.h"
+#include "vmap_table.h"
+
+namespace art {
+
+static bool SameTypeLists(const DexFile::TypeList* lhs, const DexFile::TypeList* rhs) {
+  if (lhs == NULL || rhs == NULL) {
+    return (lhs == NULL || lhs->Size() == 0) && (rhs == NULL || rhs->Size() == 0);
+  }
+  if (lhs->Size() != rhs->Size()) {
+    return false;
+  }
+  for (uint32_t i = 0; i < lhs->Size(); ++i) {
+    if (lhs->GetTypeItem(i).type_idx_ != rhs->GetTypeItem(i).type_idx_) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Are the dex files' string, type, proto, field and method ids the same, so that an index means
+// the same in both?
+static bool SameIds(const DexFile& lhs, const DexFile& rhs) {
+  if (lhs.NumStringIds() != rhs.NumStringIds() || lhs.NumTypeIds() != rhs.NumTypeIds() ||
+      lhs.NumProtoIds() != rhs.NumProtoIds() || lhs.NumFieldIds() != rhs.NumFieldIds() ||
+      lhs.NumMethodIds() != rhs.NumMethodIds()) {
+    return false;
+  }
+  for (size_t i = 0; i < lhs.NumStringIds(); ++i) {
+    if (strcmp(lhs.StringDataByIdx(i), rhs.StringDataByIdx(i)) != 0) {
+      return false;
+    }
+  }
+  for (size_t i = 0; i < lhs.NumTypeIds(); ++i) {
+    if (lhs.GetTypeId(i).descriptor_idx_ != rhs.GetTypeId(i).descriptor_idx_) {
+      return false;
+    }
+  }
+  for (size_t i = 0; i < lhs.NumProtoIds(); ++i) {
+    const DexFile::ProtoId& lhs_proto = lhs.GetProtoId(i);
+    const DexFile::ProtoId& rhs_proto = rhs.GetProtoId(i);
+    if (lhs_proto.shorty_idx_ != rhs_proto.shorty_idx_ ||
+        lhs_proto.return_type_idx_ != rhs_proto.return_type_idx_ ||
+        !SameTypeLists(lhs.GetProtoParameters(lhs_proto), rhs.GetProtoParameters(rhs_proto))) {
+      return false;
+    }
+  }
+  for (size_t i = 0; i < lhs.NumFieldIds(); ++i) {
+    const DexFile::FieldId& lhs_field = lhs.GetFieldId(i);
+    const DexFile::FieldId& rhs_field = rhs.GetFieldId(i);
+    if (lhs_field.class_idx_ != rhs_field.class_idx_ ||
+        lhs_field.type_idx_ != rhs_field.type_idx_ ||
+        lhs_field.name_idx_ != rhs_field.name_idx_) {
+      return false;
+    }
+  }
+  for (size_t i = 0; i < lhs.NumMethodIds(); ++i) {
+    const DexFile::MethodId& lhs_method = lhs.GetMethodId(i);
+    const DexFile::MethodId& rhs_method = rhs.GetMethodId(i);
+    if (lhs_method.class_idx_ != rhs_method.class_idx_ ||
+        lhs_method.proto_idx_ != rhs_method.proto_idx_ ||
+        lhs_method.name_idx_ != rhs_method.name_idx_) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static const byte* SkipEncodedArray(const byte* data);
+
+// Returns the end of the encoded_value at data.
+static const byte* SkipEncodedValue(const byte* data) {
+  byte header = *data++;
+  switch (header & 0x1f) {
+    case EncodedStaticFieldValueIterator::kNull:
+    case EncodedStaticFieldValueIterator::kBoolean:
+      return data;
+    case EncodedStaticFieldValueIterator::kArray:
+      return SkipEncodedArray(data);
+    case EncodedStaticFieldValueIterator::kAnnotation: {
+      DecodeUnsignedLeb128(&data);  // Type index.
+      uint32_t size = DecodeUnsignedLeb128(&data);
+      for (uint32_t i = 0; i < size; ++i) {
+        DecodeUnsignedLeb128(&data);  // Name index.
+        data = SkipEncodedValue(data);
+      }
+      return data;
+    }
+    default:
+      // The value's size in bytes, less one, is in the header's top three bits.
+      return data + (header >> 5) + 1;
+  }
+}
+
+static const byte* SkipEncodedArray(const byte* data) {
+  uint32_t size = DecodeUnsignedLeb128(&data);
+  for (uint32_t i = 0; i < size; ++i) {
+    data = SkipEncodedValue(data);
+  }
+  return data;
+}
+
+static bool SameEncodedArrays(const byte* lhs, const byte* rhs) {
+  if (lhs == NULL || rhs == NULL) {
+    return lhs == rhs;
+  }
+  size_t size = SkipEncodedArray(lhs) - lhs;
+  return size == static_cast<size_t>(SkipEncodedArray(rhs) - rhs) && memcmp(lhs, rhs, size) == 0;
+}
+
+// The size in bytes of the encoded_catch_handler_list of a code item with tries.
+static size_t CatchHandlersSize(const DexFile::CodeItem& code_item) {
+  const byte* const begin = DexFile::GetCatchHandlerData(code_item, 0);
+  const byte* data = begin;
+  uint32_t handler_lists = DecodeUnsignedLeb128(&data);
+  for (uint32_t i = 0; i < handler_lists; ++i) {
+    int32_t size = DecodeSignedLeb128(&data);
+    for (int32_t j = 0; j < abs(size); ++j) {
+      DecodeUnsignedLeb128(&data);  // Type index.
+      DecodeUnsignedLeb128(&data);  // Handler address.
+    }
+    if (size <= 0) {
+      DecodeUnsignedLeb128(&data);  // Catch all address.
+    }
+  }
+  return data - begin;
+}
+
+static bool SameCodeItems(const DexFile::CodeItem* lhs, const DexFile::CodeItem* rhs) {
+  if (lhs == NULL || rhs == NULL) {
+    return lhs == rhs;
+  }
+  if (lhs->registers_size_ != rhs->registers_size_ || lhs->ins_size_ != rhs->ins_size_ ||
+      lhs->outs_size_ != rhs->outs_size_ || lhs->tries_size_ != rhs->tries_size_ ||
+      lhs->insns_size_in_code_units_ != rhs->insns_size_in_code_units_) {
+    return false;
+  }
+  if (memcmp(lhs->insns_, rhs->insns_, lhs->insns_size_in_code_units_ * sizeof(uint16_t)) != 0) {
+    return false;
+  }
+  if (lhs->tries_size_ == 0) {
+    return true;
+  }
+  if (memcmp(DexFile::GetTryItems(*lhs, 0), DexFile::GetTryItems(*rhs, 0),
+             lhs->tries_size_ * sizeof(DexFile::TryItem)) != 0) {
+    return false;
+  }
+  size_t handlers_size = CatchHandlersSize(*lhs);
+  return handlers_size == CatchHandlersSize(*rhs) &&
+      memcmp(DexFile::GetCatchHandlerData(*lhs, 0), DexFile::GetCatchHandlerData(*rhs, 0),
+             handlers_size) == 0;
+}
+
+IncrementalCompilation* IncrementalCompilation::Create(
+    const OatFile* previous_oat_file, const std::vector<const DexFile*>& dex_files,
+    InstructionSet instruction_set, uint32_t image_file_location_oat_checksum) {
+  const OatHeader& header = previous_oat_file->GetOatHeader();
+  if (header.GetInstructionSet() != instruction_set) {
+    LOG(WARNING) << "Compiling from scratch, " << previous_oat_file->GetLocation()
+                 << " was compiled for " << header.GetInstructionSet() << " not for "
+                 << instruction_set;
+    return NULL;
+  }
+  if (header.GetImageFileLocationOatChecksum() != image_file_location_oat_checksum) {
+    LOG(WARNING) << "Compiling from scratch, the boot image changed since "
+                 << previous_oat_file->GetLocation() << " was compiled";
+    return NULL;
+  }
+  IncrementalCompilation* incremental_compilation =
+      new IncrementalCompilation(previous_oat_file, dex_files, instruction_set);
+  incremental_compilation->FindChangedClasses();
+  return incremental_compilation;
+}
+
+IncrementalCompilation::IncrementalCompilation(const OatFile* previous_oat_file,
+                                               const std::vector<const DexFile*>& dex_files,
+                                               InstructionSet instruction_set)
+    : previous_oat_file_(previous_oat_file), dex_files_(dex_files),
+      instruction_set_(instruction_set) {
+  std::vector<const OatFile::OatDexFile*> oat_dex_files = previous_oat_file_->GetOatDexFiles();
+  for (const DexFile* dex_file : dex_files_) {
+    PreviousDexFile previous = { NULL, NULL, false, false };
+    for (const OatFile::OatDexFile* oat_dex_file : oat_dex_files) {
+      if (oat_dex_file->GetDexFileLocation() == dex_file->GetLocation()) {
+        previous.oat_dex_file = oat_dex_file;
+        break;
+      }
+    }
+    if (previous.oat_dex_file != NULL) {
+      previous.unchanged =
+          previous.oat_dex_file->GetDexFileLocationChecksum() == dex_file->GetLocationChecksum();
+      if (!previous.unchanged) {
+        previous.dex_file = previous.oat_dex_file->OpenDexFile();
+        previous.same_ids = previous.dex_file != NULL && SameIds(*dex_file, *previous.dex_file);
+      }
+    }
+    VLOG(compiler) << dex_file->GetLocation() << " is "
+                   << (previous.oat_dex_file == NULL ? "new" :
+                       previous.unchanged ? "unchanged" :
+                       previous.same_ids ? "changed, with the same ids" : "changed");
+    previous_dex_files_.Put(dex_file, previous);
+  }
+}
+
+IncrementalCompilation::~IncrementalCompilation() {
+  for (const auto& entry : previous_dex_files_) {
+    delete entry.second.dex_file;
+  }
+}
+
+bool IncrementalCompilation::ClassChanged(const DexFile& dex_file,
+                                          const DexFile::ClassDef& class_def,
+                                          const PreviousDexFile& previous) const {
+  if (previous.unchanged) {
+    return false;
+  }
+  if (!previous.same_ids) {
+    return true;
+  }
+  const DexFile& previous_dex_file = *previous.dex_file;
+  const DexFile::ClassDef* previous_class_def =
+      previous_dex_file.FindClassDef(class_def.class_idx_);
+  if (previous_class_def == NULL ||
+      class_def.access_flags_ != previous_class_def->access_flags_ ||
+      class_def.superclass_idx_ != previous_class_def->superclass_idx_ ||
+      !SameTypeLists(dex_file.GetInterfacesList(class_def),
+                     previous_dex_file.GetInterfacesList(*previous_class_def)) ||
+      !SameEncodedArrays(dex_file.GetEncodedStaticFieldValuesArray(class_def),
+                         previous_dex_file.GetEncodedStaticFieldValuesArray(*previous_class_def))) {
+    return true;
+  }
+  const byte* class_data = dex_file.GetClassData(class_def);
+  const byte* previous_class_data = previous_dex_file.GetClassData(*previous_class_def);
+  if (class_data == NULL || previous_class_data == NULL) {
+    return (class_data == NULL) != (previous_class_data == NULL);
+  }
+  ClassDataItemIterator it(dex_file, class_data);
+  ClassDataItemIterator previous_it(previous_dex_file, previous_class_data);
+  if (it.NumStaticFields() != previous_it.NumStaticFields() ||
+      it.NumInstanceFields() != previous_it.NumInstanceFields() ||
+      it.NumDirectMethods() != previous_it.NumDirectMethods() ||
+      it.NumVirtualMethods() != previous_it.NumVirtualMethods()) {
+    return true;
+  }
+  for (; it.HasNext(); it.Next(), previous_it.Next()) {
+    if (it.GetMemberIndex() != previous_it.GetMemberIndex() ||
+        it.GetMemberAccessFlags() != previous_it.GetMemberAccessFlags()) {
+      return true;
+    }
+    bool is_method = it.HasNextDirectMethod() || it.HasNextVirtualMethod();
+    if (is_method && !SameCodeItems(it.GetMethodCodeItem(), previous_it.GetMethodCodeItem())) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void IncrementalCompilation::FindChangedClasses() {
+  for (const DexFile* dex_file : dex_files_) {
+    const PreviousDexFile& previous = previous_dex_files_.Get(dex_file);
+    for (size_t i = 0; i < dex_file->NumClassDefs(); ++i) {
+      const DexFile::ClassDef& class_def = dex_file->GetClassDef(i);
+      if (previous.oat_dex_file == NULL || ClassChanged(*dex_file, class_def, previous)) {
+        changed_descriptors_.insert(dex_file->GetClassDescriptor(class_def));
+      }
+    }
+  }
+  // Classes that are gone may have been superclasses or referred to by code, look them up in
+  // every dex file of the previous compilation that changed or isn't compiled any more.
+  for (const OatFile::OatDexFile* oat_dex_file : previous_oat_file_->GetOatDexFiles()) {
+    bool unchanged = false;
+    for (const auto& entry : previous_dex_files_) {
+      if (entry.second.oat_dex_file == oat_dex_file) {
+        unchanged = entry.second.unchanged;
+      }
+    }
+    if (unchanged) {
+      continue;
+    }
+    UniquePtr<const DexFile> previous_dex_file(oat_dex_file->OpenDexFile());
+    if (previous_dex_file.get() == NULL) {
+      continue;
+    }
+    for (size_t i = 0; i < previous_dex_file->NumClassDefs(); ++i) {
+      const char* descriptor =
+          previous_dex_file->GetClassDescriptor(previous_dex_file->GetClassDef(i));
+      bool found = false;
+      for (const DexFile* dex_file : dex_files_) {
+        if (dex_file->FindClassDef(descriptor) != NULL) {
+          found = true;
+          break;
+        }
+      }
+      if (!found) {
+        changed_descriptors_.insert(descriptor);
+      }
+    }
+  }
+  SafeMap<std::string, bool> affected;
+  for (const DexFile* dex_file : dex_files_) {
+    for (size_t i = 0; i < dex_file->NumClassDefs(); ++i) {
+      std::string descriptor(dex_file->GetClassDescriptor(dex_file->GetClassDef(i)));
+      if (IsAffected(descriptor, &affected)) {
+        affected_descriptors_.insert(descriptor);
+      }
+    }
+  }
+  // Removed classes are not defined by any dex file, but code may still refer to them.
+  affected_descriptors_.insert(changed_descriptors_.begin(), changed_descriptors_.end());
+  VLOG(compiler) << changed_descriptors_.size() << " classes changed, "
+                 << affected_descriptors_.size() << " with their subclasses";
+}
+
+bool IncrementalCompilation::IsAffected(const std::string& descriptor,
+                                        SafeMap<std::string, bool>* affected) {
+  SafeMap<std::string, bool>::const_iterator it = affected->find(descriptor);
+  if (it != affected->end()) {
+    return it->second;
+  }
+  // A class that is its own superclass is rejected by the verifier, treat it as changed.
+  affected->Put(descriptor, true);
+  bool result = changed_descriptors_.find(descriptor) != changed_descriptors_.end();
+  for (size_t i = 0; !result && i < dex_files_.size(); ++i) {
+    const DexFile& dex_file = *dex_files_[i];
+    const DexFile::ClassDef* class_def = dex_file.FindClassDef(descriptor.c_str());
+    if (class_def == NULL) {
+      continue;
+    }
+    if (class_def->superclass_idx_ != DexFile::kDexNoIndex16) {
+      result = IsAffected(dex_file.StringByTypeIdx(class_def->superclass_idx_), affected);
+    }
+    const DexFile::TypeList* interfaces = dex_file.GetInterfacesList(*class_def);
+    for (uint32_t j = 0; !result && interfaces != NULL && j < interfaces->Size(); ++j) {
+      result = IsAffected(dex_file.StringByTypeIdx(interfaces->GetTypeItem(j).type_idx_),
+                          affected);
+    }
+    // Classes are defined by the first dex file that has them.
+    break;
+  }
+  affected->Overwrite(descriptor, result);
+  return result;
+}
+
+static void AddTypeDescriptor(const char* descriptor, std::set<std::string>* descriptors) {
+  while (*descriptor == '[') {
+    ++descriptor;
+  }
+  if (*descriptor == 'L') {
+    descriptors->insert(descriptor);
+  }
+}
+
+void IncrementalCompilation::AddReferencedDescriptors(const DexFile& dex_file,
+                                                      const DexFile::ClassDef& class_def,
+                                                      std::set<std::string>* descriptors) const {
+  AddTypeDescriptor(dex_file.GetClassDescriptor(class_def), descriptors);
+  if (class_def.superclass_idx_ != DexFile::kDexNoIndex16) {
+    AddTypeDescriptor(dex_file.StringByTypeIdx(class_def.superclass_idx_), descriptors);
+  }
+  const DexFile::TypeList* interfaces = dex_file.GetInterfacesList(class_def);
+  for (uint32_t i = 0; interfaces != NULL && i < interfaces->Size(); ++i) {
+    AddTypeDescriptor(dex_file.StringByTypeIdx(interfaces->GetTypeItem(i).type_idx_),
+                      descriptors);
+  }
+  const byte* class_data = dex_file.GetClassData(class_def);
+  if (class_data == NULL) {
+    return;
+  }
+  for (ClassDataItemIterator it(dex_file, class_data); it.HasNext(); it.Next()) {
+    if (it.HasNextStaticField() || it.HasNextInstanceField()) {
+      continue;
+    }
+    const DexFile::CodeItem* code_item = it.GetMethodCodeItem();
+    if (code_item == NULL) {
+      continue;
+    }
+    // Code depends on the layout and the methods of the classes of the types, fields and methods
+    // it refers to.
+    const uint16_t* insns = code_item->insns_;
+    const uint16_t* const end = insns + code_item->insns_size_in_code_units_;
+    while (insns < end) {
+      const Instruction* inst = Instruction::At(insns);
+      int flags_b = inst->GetVerifyTypeArgumentB();
+      if ((flags_b & (Instruction::kVerifyRegBType | Instruction::kVerifyRegBNewInstance)) != 0) {
+        AddTypeDescriptor(dex_file.StringByTypeIdx(inst->VRegB()), descriptors);
+      } else if ((flags_b & Instruction::kVerifyRegBField) != 0) {
+        const DexFile::FieldId& field_id = dex_file.GetFieldId(inst->VRegB());
+        AddTypeDescriptor(dex_file.StringByTypeIdx(field_id.class_idx_), descriptors);
+      } else if ((flags_b & Instruction::kVerifyRegBMethod) != 0) {
+        const DexFile::MethodId& method_id = dex_file.GetMethodId(inst->VRegB());
+        AddTypeDescriptor(dex_file.StringByTypeIdx(method_id.class_idx_), descriptors);
+      }
+      int flags_c = inst->GetVerifyTypeArgumentC();
+      if ((flags_c & (Instruction::kVerifyRegCType | Instruction::kVerifyRegCNewArray)) != 0) {
+        AddTypeDescriptor(dex_file.StringByTypeIdx(inst->VRegC()), descriptors);
+      } else if ((flags_c & Instruction::kVerifyRegCField) != 0) {
+        const DexFile::FieldId& field_id = dex_file.GetFieldId(inst->VRegC());
+        AddTypeDescriptor(dex_file.StringByTypeIdx(field_id.class_idx_), descriptors);
+      }
+      insns += inst->SizeInCodeUnits();
+    }
+  }
+}
+
+const OatFile::OatClass* IncrementalCompilation::GetReusableClass(
+    const DexFile& dex_file, uint16_t class_def_index) const {
+  const PreviousDexFile& previous = previous_dex_files_.Get(&dex_file);
+  const DexFile::ClassDef& class_def = dex_file.GetClassDef(class_def_index);
+  if (previous.oat_dex_file == NULL) {
+    compiled_classes_++;
+    return NULL;
+  }
+  std::set<std::string> descriptors;
+  AddReferencedDescriptors(dex_file, class_def, &descriptors);
+  for (const std::string& descriptor : descriptors) {
+    if (affected_descriptors_.find(descriptor) != affected_descriptors_.end()) {
+      VLOG(compiler) << "Compiling " << dex_file.GetClassDescriptor(class_def)
+                     << ", it depends on " << descriptor << " which changed";
+      compiled_classes_++;
+      return NULL;
+    }
+  }
+  uint16_t previous_class_def_index = class_def_index;
+  if (!previous.unchanged) {
+    const DexFile::ClassDef* previous_class_def =
+        previous.dex_file->FindClassDef(class_def.class_idx_);
+    CHECK(previous_class_def != NULL) << dex_file.GetClassDescriptor(class_def);
+    previous_class_def_index = previous.dex_file->GetIndexForClassDef(*previous_class_def);
+  }
+  reused_classes_++;
+  return previous.oat_dex_file->GetOatClass(previous_class_def_index);
+}
+
+CompiledMethod* IncrementalCompilation::CopyMethod(CompilerDriver& driver,
+                                                   const OatFile::OatMethod& oat_method) {
+  const void* code_pointer = oat_method.GetCode();
+  if (code_pointer == NULL) {
+    return NULL;
+  }
+  uintptr_t code_address = reinterpret_cast<uintptr_t>(code_pointer);
+  if (instruction_set_ == kThumb2) {
+    code_address &= ~0x1;  // Clear the Thumb mode bit.
+  }
+  const uint8_t* code = reinterpret_cast<const uint8_t*>(code_address);
+  std::vector<uint8_t> code_copy(code, code + oat_method.GetCodeSize());
+  std::vector<uint8_t> mapping_table;
+  if (oat_method.GetMappingTable() != NULL) {
+    const uint8_t* table = oat_method.GetMappingTable();
+    mapping_table.assign(table, table + MappingTable(table).SizeInBytes());
+  }
+  std::vector<uint8_t> vmap_table;
+  if (oat_method.GetVmapTable() != NULL) {
+    const uint8_t* table = oat_method.GetVmapTable();
+    vmap_table.assign(table, table + VmapTable(table).SizeInBytes());
+  }
+  std::vector<uint8_t> gc_map;
+  if (oat_method.GetNativeGcMap() != NULL) {
+    const uint8_t* map = oat_method.GetNativeGcMap();
+    gc_map.assign(map, map + NativePcOffsetToReferenceMap(map).SizeInBytes());
+  }
+  reused_methods_++;
+  return new CompiledMethod(driver, instruction_set_, code_copy,
+                            oat_method.GetFrameSizeInBytes(), oat_method.GetCoreSpillMask(),
+                            oat_method.GetFpSpillMask(), mapping_table, vmap_table, gc_map);
+}
+
+void IncrementalCompilation::DumpStats() const {
+  LOG(INFO) << "Reused " << reused_classes_.load() << " classes and " << reused_methods_.load()
+            << " methods of " << previous_oat_file_->GetLocation() << ", compiled "
+            << compiled_classes_.load() << " classes";
+}
+
+}  // namespace art
@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ART_COMPILER_DRIVER_INCREMENTAL_COMPILATION_H_
+#define ART_COMPILER_DRIVER_INCREMENTAL_COMPILATION_H_
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include "atomic_integer.h"
+#include "base/macros.h"
+#include "dex_file.h"
+#include "instruction_set.h"
+#include "oat_file.h"
+#include "safe_map.h"
+
+namespace art {
+
+class CompiledMethod;
+class CompilerDriver;
+
+// Reuses the code an earlier dex2oat run compiled for the classes that haven't changed since, for
+// dex2oat --previous-oat-file. A class is reused when neither it nor any class its code refers
+// to, nor any superclass or interface of those, changed. Classes of the boot class path are only
+// compared through the checksum of the boot oat file.
+//
+// A dex file is unchanged when its checksum is the one recorded in the previous oat file. Code
+// names types, fields, methods and strings by dex file index, so classes of a dex file that
+// changed are only compared when its index tables are the same, otherwise all of them changed.
+// The class def, its fields and its methods' code items are then compared with those of the dex
+// file stored in the previous oat file.
+//
+// The previous oat file must have been compiled for the same instruction set and features and
+// with the same compiler options. There is no patch information in an oat file, so images, whose
+// code is patched, are always compiled from scratch.
+class IncrementalCompilation {
+ public:
+  // Returns NULL, after logging why, if nothing of the previous oat file can be reused.
+  static IncrementalCompilation* Create(const OatFile* previous_oat_file,
+                                        const std::vector<const DexFile*>& dex_files,
+                                        InstructionSet instruction_set,
+                                        uint32_t image_file_location_oat_checksum);
+
+  ~IncrementalCompilation();
+
+  // Returns the previous compilation of the class if it can be reused, NULL to compile it.
+  const OatFile::OatClass* GetReusableClass(const DexFile& dex_file,
+                                            uint16_t class_def_index) const;
+
+  // Copies the code and tables of a method of a reusable class, returns NULL if it had no code.
+  CompiledMethod* CopyMethod(CompilerDriver& driver, const OatFile::OatMethod& oat_method);
+
+  size_t GetReusedMethods() const {
+    return reused_methods_.load();
+  }
+
+  // Logs how many classes and methods were reused.
+  void DumpStats() const;
+
+ private:
+  struct PreviousDexFile {
+    // The dex file as stored in the previous oat file, NULL if there is no such dex file.
+    const DexFile* dex_file;
+    const OatFile::OatDexFile* oat_dex_file;
+    // The dex file's checksum is the one of the previous compilation.
+    bool unchanged;
+    // The dex files' index tables are the same, so class data can be compared.
+    bool same_ids;
+  };
+
+  IncrementalCompilation(const OatFile* previous_oat_file,
+                         const std::vector<const DexFile*>& dex_files,
+                         InstructionSet instruction_set);
+
+  void FindChangedClasses();
+  bool ClassChanged(const DexFile& dex_file, const DexFile::ClassDef& class_def,
+                    const PreviousDexFile& previous) const;
+  bool IsAffected(const std::string& descriptor, SafeMap<std::string, bool>* affected);
+  void AddReferencedDescriptors(const DexFile& dex_file, const DexFile::ClassDef& class_def,
+                                std::set<std::string>* descriptors) const;
+
+  const OatFile* const previous_oat_file_;
+  const std::vector<const DexFile*> dex_files_;
+  const InstructionSet instruction_set_;
+  SafeMap<const DexFile*, PreviousDexFile> previous_dex_files_;
+  // Descriptors of the classes that changed.
+  std::set<std::string> changed_descriptors_;
+  // Descriptors of the classes that changed or have a superclass or interface that changed.
+  // Filled in before compilation starts, only read while compiling.
+  std::set<std::string> affected_descriptors_;
+
+  mutable AtomicInteger reused_classes_;
+  mutable AtomicInteger compiled_classes_;
+  AtomicInteger reused_methods_;
+
+  DISALLOW_COPY_AND_ASSIGN(IncrementalCompilation);
+};
+
+}  // namespace art
+
+#endif  // ART_COMPILER_DRIVER_INCREMENTAL_COMPILATION_H_
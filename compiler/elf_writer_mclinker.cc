@@ -249,6 +249,7 @@ void ElfWriterMclinker::AddMethodInputs(const std::vector<const DexFile*>& dex_f
     it.Next();
   }
   added_symbols_.clear();
+  added_code_.clear();
 }
 
 void ElfWriterMclinker::AddCompiledCodeInput(const CompiledCode& compiled_code) {
@@ -263,6 +264,10 @@ void ElfWriterMclinker::AddCompiledCodeInput(const CompiledCode& compiled_code)
 
   // Add input to supply code for symbol
   const std::vector<uint8_t>& code = compiled_code.GetCode();
+  if (added_code_.find(&code) != added_code_.end()) {
+    return;
+  }
+  added_code_.Put(&code, &code);
   // TODO: ownership of code_input?
   // TODO: why does IRBuilder::ReadInput take a non-const pointer?
   mcld::Input* code_input = ir_builder_->ReadInput(symbol,
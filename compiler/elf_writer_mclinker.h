@@ -85,6 +85,8 @@ class ElfWriterMclinker : public ElfWriter {
   // Setup by AddCompiledCodeInput
   // set of symbols for already added mcld::Inputs
   SafeMap<const std::string*, const std::string*> added_symbols_;
+  // set of code for already added mcld::Inputs, methods compiled together share their code
+  SafeMap<const std::vector<uint8_t>*, const std::vector<uint8_t>*> added_code_;
 
   // Setup by FixupCompiledCodeOffset
   // map of symbol names to oatdata offset
@@ -16,12 +16,15 @@
 
 #include "elf_writer_quick.h"
 
+#include <fcntl.h>
+
 #include "base/logging.h"
 #include "base/unix_file/fd_file.h"
 #include "buffered_output_stream.h"
 #include "driver/compiler_driver.h"
 #include "file_output_stream.h"
 #include "globals.h"
+#include "mem_map.h"
 #include "oat.h"
 #include "oat_writer.h"
 #include "utils.h"
@@ -199,6 +202,12 @@ bool ElfWriterQuick::Write(OatWriter& oat_writer,
   const OatHeader& oat_header = oat_writer.GetOatHeader();
   CHECK(oat_header.IsValid());
   uint32_t oat_data_size = oat_header.GetExecutableOffset();
+  bool align_text_to_huge_pages = compiler_driver_->AlignsTextToHugePages();
+  if (align_text_to_huge_pages) {
+    // Oat offsets make .text directly follow .rodata, so the padding goes before .rodata.
+    oat_data_offset = expected_offset =
+        RoundUp(oat_data_offset + oat_data_size, MemMap::kHugePageSize) - oat_data_size;
+  }
   expected_offset += oat_data_size;
   if (debug) {
     LOG(INFO) << "oat_data_offset=" << oat_data_offset << std::hex << " " << oat_data_offset;
@@ -206,7 +215,9 @@ bool ElfWriterQuick::Write(OatWriter& oat_writer,
   }
 
   // .text
-  uint32_t oat_exec_alignment = kPageSize;
+  // ElfFile::Load reserves the file at its largest segment alignment, so a huge page aligned
+  // .text also has a huge page aligned address.
+  uint32_t oat_exec_alignment = align_text_to_huge_pages ? MemMap::kHugePageSize : kPageSize;
   CHECK_ALIGNED(expected_offset, kPageSize);
   uint32_t oat_exec_offset = expected_offset = RoundUp(expected_offset, oat_exec_alignment);
   uint32_t oat_exec_size = oat_writer.GetSize() - oat_data_size;
@@ -560,6 +571,15 @@ bool ElfWriterQuick::Write(OatWriter& oat_writer,
 
   // phase 3: writing file
 
+#if defined(__linux__) && !defined(HAVE_ANDROID_OS)
+  // Allocate the whole file up front so that it is laid out in a few extents rather than grown
+  // a buffer at a time. This is only a hint, file systems that can't do it are written as before.
+  if (fallocate(elf_file_->Fd(), FALLOC_FL_KEEP_SIZE, 0, expected_offset) != 0) {
+    PLOG(WARNING) << "Failed to preallocate " << expected_offset << " bytes for "
+                  << elf_file_->GetPath();
+  }
+#endif
+
   // Elf32_Ehdr
   if (!elf_file_->WriteFully(&elf_header, sizeof(elf_header))) {
     PLOG(ERROR) << "Failed to write ELF header for " << elf_file_->GetPath();
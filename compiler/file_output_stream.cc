@@ -16,9 +16,13 @@
 
 #include "file_output_stream.h"
 
+#include <limits.h>
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <vector>
+
 #include "base/unix_file/fd_file.h"
 
 namespace art {
@@ -29,6 +33,32 @@ bool FileOutputStream::WriteFully(const void* buffer, int64_t byte_count) {
   return file_->WriteFully(buffer, byte_count);
 }
 
+bool FileOutputStream::WriteFullyGathered(const struct iovec* iov, int iov_count) {
+  if (iov_count == 0) {
+    return true;
+  }
+  // writev may write less than asked, so work on a copy that can be advanced past what it wrote.
+  std::vector<struct iovec> remaining(iov, iov + iov_count);
+  struct iovec* next = &remaining[0];
+  int left = iov_count;
+  while (left > 0) {
+    ssize_t bytes_written = TEMP_FAILURE_RETRY(writev(file_->Fd(), next, std::min(left, IOV_MAX)));
+    if (bytes_written < 0) {
+      return false;
+    }
+    while (left > 0 && static_cast<size_t>(bytes_written) >= next->iov_len) {
+      bytes_written -= next->iov_len;
+      ++next;
+      --left;
+    }
+    if (left > 0) {
+      next->iov_base = reinterpret_cast<uint8_t*>(next->iov_base) + bytes_written;
+      next->iov_len -= bytes_written;
+    }
+  }
+  return true;
+}
+
 off_t FileOutputStream::Seek(off_t offset, Whence whence) {
   return lseek(file_->Fd(), offset, static_cast<int>(whence));
 }
@@ -31,6 +31,8 @@ class FileOutputStream : public OutputStream {
 
   virtual bool WriteFully(const void* buffer, int64_t byte_count);
 
+  virtual bool WriteFullyGathered(const struct iovec* iov, int iov_count);
+
   virtual off_t Seek(off_t offset, Whence whence);
 
  private:
@@ -75,8 +75,9 @@ TEST_F(ImageTest, WriteRead) {
   const uintptr_t requested_image_base = ART_BASE_ADDRESS;
   {
     ImageWriter writer(*compiler_driver_.get());
+    base::TimingLogger timings("ImageTest::WriteRead", false, false);
     bool success_image = writer.Write(tmp_image.GetFilename(), requested_image_base,
-                                      tmp_oat->GetPath(), tmp_oat->GetPath());
+                                      tmp_oat->GetPath(), tmp_oat->GetPath(), timings);
     ASSERT_TRUE(success_image);
     bool success_fixup = ElfFixup::Fixup(tmp_oat.get(), writer.GetOatDataBegin());
     ASSERT_TRUE(success_fixup);
@@ -90,6 +91,10 @@ TEST_F(ImageTest, WriteRead) {
     ASSERT_TRUE(image_header.IsValid());
     ASSERT_GE(image_header.GetImageBitmapOffset(), sizeof(image_header));
     ASSERT_NE(0U, image_header.GetImageBitmapSize());
+    ASSERT_TRUE(image_header.HasRelocations());
+    ASSERT_GE(image_header.GetRelocationsOffset(),
+              image_header.GetImageBitmapOffset() + image_header.GetImageBitmapSize());
+    ASSERT_NE(0U, image_header.GetImageRelocationsSize());
 
     gc::Heap* heap = Runtime::Current()->GetHeap();
     ASSERT_EQ(1U, heap->GetContinuousSpaces().size());
@@ -192,4 +197,48 @@ TEST_F(ImageTest, ImageHeaderIsValid) {
     ASSERT_FALSE(image_header.IsValid());
 }
 
+TEST_F(ImageTest, ImageHeaderRelocate) {
+    uint32_t image_begin = ART_BASE_ADDRESS;
+    ImageHeader image_header(image_begin,
+                             16 * KB,
+                             0,
+                             0,
+                             ART_BASE_ADDRESS + (1 * KB),
+                             0,
+                             ART_BASE_ADDRESS + (4 * KB),
+                             ART_BASE_ADDRESS + (8 * KB),
+                             ART_BASE_ADDRESS + (9 * KB),
+                             ART_BASE_ADDRESS + (10 * KB));
+    ASSERT_FALSE(image_header.HasRelocations());
+
+    const ptrdiff_t delta = -16 * kPageSize;
+    image_header.Relocate(delta);
+    EXPECT_EQ(reinterpret_cast<byte*>(ART_BASE_ADDRESS + delta), image_header.GetImageBegin());
+    EXPECT_EQ(reinterpret_cast<byte*>(ART_BASE_ADDRESS + (4 * KB) + delta),
+              image_header.GetOatFileBegin());
+    EXPECT_EQ(reinterpret_cast<byte*>(ART_BASE_ADDRESS + (8 * KB) + delta),
+              image_header.GetOatDataBegin());
+    EXPECT_EQ(reinterpret_cast<byte*>(ART_BASE_ADDRESS + (10 * KB) + delta),
+              image_header.GetOatFileEnd());
+    // Sizes and file offsets don't move.
+    EXPECT_EQ(16 * KB, image_header.GetImageSize());
+}
+
+TEST_F(ImageTest, AppImageHeader) {
+    // App images are written for address 0, with no oat file after them.
+    ImageHeader image_header(0, 16 * KB, 16 * KB, 0, 1 * KB, 0, 0, 0, 0, 0);
+    ASSERT_FALSE(image_header.IsAppImage());
+    image_header.SetBootImage(ART_BASE_ADDRESS, 1234);
+    ASSERT_TRUE(image_header.IsAppImage());
+    EXPECT_EQ(reinterpret_cast<byte*>(ART_BASE_ADDRESS), image_header.GetBootImageBegin());
+    EXPECT_EQ(1234U, image_header.GetBootOatChecksum());
+
+    const ptrdiff_t delta = 64 * kPageSize;
+    image_header.Relocate(delta);
+    EXPECT_EQ(reinterpret_cast<byte*>(delta), image_header.GetImageBegin());
+    EXPECT_TRUE(image_header.GetOatDataBegin() == NULL);
+    // The boot image doesn't move with the app image.
+    EXPECT_EQ(reinterpret_cast<byte*>(ART_BASE_ADDRESS), image_header.GetBootImageBegin());
+}
+
 }  // namespace art
@@ -18,19 +18,23 @@
 
 #include <sys/stat.h>
 
+#include <algorithm>
 #include <vector>
 
 #include "base/logging.h"
 #include "base/unix_file/fd_file.h"
 #include "class_linker.h"
 #include "compiled_method.h"
+#include "cutils/atomic-inline.h"
 #include "dex_file-inl.h"
 #include "driver/compiler_driver.h"
 #include "elf_writer.h"
 #include "gc/accounting/card_table-inl.h"
 #include "gc/accounting/heap_bitmap.h"
 #include "gc/accounting/space_bitmap-inl.h"
+#include "gc/collector/mark_sweep-inl.h"
 #include "gc/heap.h"
+#include "gc/space/image_space.h"
 #include "gc/space/large_object_space.h"
 #include "gc/space/space-inl.h"
 #include "globals.h"
@@ -42,6 +46,7 @@
 #include "mirror/class-inl.h"
 #include "mirror/class_loader.h"
 #include "mirror/dex_cache-inl.h"
+#include "mirror/iftable-inl.h"
 #include "mirror/object-inl.h"
 #include "mirror/object_array-inl.h"
 #include "oat.h"
@@ -50,6 +55,7 @@
 #include "runtime.h"
 #include "scoped_thread_state_change.h"
 #include "sirt_ref.h"
+#include "thread_pool.h"
 #include "UniquePtr.h"
 #include "utils.h"
 
@@ -64,10 +70,15 @@ using ::art::mirror::String;
 
 namespace art {
 
+// How many ranges of image objects each thread gets, more than one so that threads which get the
+// larger objects don't hold everybody else up.
+static constexpr size_t kImageObjectRangesPerThread = 4;
+
 bool ImageWriter::Write(const std::string& image_filename,
                         uintptr_t image_begin,
                         const std::string& oat_filename,
-                        const std::string& oat_location) {
+                        const std::string& oat_location,
+                        base::TimingLogger& timings) {
   CHECK(!image_filename.empty());
 
   CHECK_NE(image_begin, 0U);
@@ -108,6 +119,9 @@ bool ImageWriter::Write(const std::string& image_filename,
   {
     Thread::Current()->TransitionFromSuspendedToRunnable();
     PruneNonImageClasses();  // Remove junk
+    if (read_only_dex_caches_) {
+      ResolveDexCaches();
+    }
     ComputeLazyFieldsForImageClasses();  // Add useful information
     ComputeEagerResolvedStrings();
     Thread::Current()->TransitionFromRunnableToSuspended(kNative);
@@ -130,17 +144,79 @@ bool ImageWriter::Write(const std::string& image_filename,
     CheckNonImageClassesRemoved();
   }
 #endif
+  // The calling thread works too, so it doesn't need a worker of its own.
+  UniquePtr<ThreadPool> thread_pool(new ThreadPool(compiler_driver_.GetThreadCount() - 1));
   Thread::Current()->TransitionFromSuspendedToRunnable();
   size_t oat_loaded_size = 0;
   size_t oat_data_offset = 0;
   ElfWriter::GetOatElfInformation(oat_file.get(), oat_loaded_size, oat_data_offset);
-  CalculateNewObjectOffsets(oat_loaded_size, oat_data_offset);
-  CopyAndFixupObjects();
-  PatchOatCodeAndMethods();
-  // Record allocations into the image bitmap.
-  RecordImageAllocations();
+  CalculateNewObjectOffsets(oat_loaded_size, oat_data_offset, *thread_pool.get(), timings);
+  CopyAndFixupObjects(*thread_pool.get(), timings);
+  {
+    base::TimingLogger::ScopedSplit split("PatchOatCodeAndMethods", &timings);
+    PatchOatCodeAndMethods();
+  }
+  {
+    base::TimingLogger::ScopedSplit split("RecordImageAllocations", &timings);
+    // Record allocations into the image bitmap.
+    RecordImageAllocations();
+  }
   Thread::Current()->TransitionFromRunnableToSuspended(kNative);
 
+  return WriteImageFile(image_filename);
+}
+
+bool ImageWriter::WriteAppImage(const std::string& image_filename,
+                                File* oat_file,
+                                const std::string& oat_location,
+                                const std::vector<const DexFile*>& dex_files,
+                                base::TimingLogger& timings) {
+  CHECK(!image_filename.empty());
+  boot_image_space_ = Runtime::Current()->GetHeap()->GetImageSpace();
+  CHECK(boot_image_space_ != NULL) << "App images are written on top of a boot image";
+  app_image_ = true;
+  // App images are written for address 0, and relocated to wherever they are mapped.
+  image_begin_ = NULL;
+
+  {
+    UniquePtr<OatFile> app_oat_file(OatFile::OpenWritable(oat_file, oat_location));
+    if (app_oat_file.get() == NULL) {
+      LOG(ERROR) << "Failed to open writable oat file " << oat_location;
+      return false;
+    }
+    app_oat_checksum_ = app_oat_file->GetOatHeader().GetChecksum();
+  }
+
+  if (!AllocMemory()) {
+    return false;
+  }
+  UniquePtr<ThreadPool> thread_pool(new ThreadPool(compiler_driver_.GetThreadCount() - 1));
+  Thread* self = Thread::Current();
+  self->TransitionFromSuspendedToRunnable();
+  {
+    ClassLinker* class_linker = Runtime::Current()->GetClassLinker();
+    for (const DexFile* dex_file : dex_files) {
+      DexCache* dex_cache = class_linker->FindDexCache(*dex_file);
+      app_dex_caches_.insert(dex_cache);
+      dex_cache_arrays_.Put(dex_cache->GetResolvedTypes(), dex_cache);
+      dex_cache_arrays_.Put(dex_cache->GetResolvedMethods(), dex_cache);
+      dex_cache_arrays_.Put(dex_cache->GetResolvedFields(), dex_cache);
+      dex_cache_arrays_.Put(dex_cache->GetInitializedStaticStorage(), dex_cache);
+    }
+    SirtRef<ObjectArray<Object> > image_roots(self, CreateAppImageRoots(dex_files));
+    CalculateAppImageObjectOffsets(image_roots.get(), timings);
+  }
+  CopyAndFixupObjects(*thread_pool.get(), timings);
+  {
+    base::TimingLogger::ScopedSplit split("RecordImageAllocations", &timings);
+    RecordImageAllocations();
+  }
+  self->TransitionFromRunnableToSuspended(kNative);
+
+  return WriteImageFile(image_filename);
+}
+
+bool ImageWriter::WriteImageFile(const std::string& image_filename) {
   UniquePtr<File> image_file(OS::CreateEmptyFile(image_filename.c_str()));
   ImageHeader* image_header = reinterpret_cast<ImageHeader*>(image_->Begin());
   if (image_file.get() == NULL) {
@@ -152,6 +228,13 @@ bool ImageWriter::Write(const std::string& image_filename,
     return EXIT_FAILURE;
   }
 
+  // The relocations follow the image bitmap.
+  std::sort(oat_relocations_.begin(), oat_relocations_.end());
+  image_header->SetRelocations(RoundUp(image_header->GetImageBitmapOffset() +
+                                       image_header->GetImageBitmapSize(), kPageSize),
+                               image_relocations_.size() * sizeof(uint32_t),
+                               oat_relocations_.size());
+
   // Write out the image.
   CHECK_EQ(image_end_, image_header->GetImageSize());
   if (!image_file->WriteFully(image_->Begin(), image_end_)) {
@@ -168,6 +251,28 @@ bool ImageWriter::Write(const std::string& image_filename,
     return false;
   }
 
+  if (!WriteRelocations(image_file.get(), *image_header)) {
+    PLOG(ERROR) << "Failed to write image file " << image_filename;
+    return false;
+  }
+
+  return true;
+}
+
+bool ImageWriter::WriteRelocations(File* image_file, const ImageHeader& image_header) {
+  CHECK_ALIGNED(image_header.GetRelocationsOffset(), kPageSize);
+  if (!image_file->Write(reinterpret_cast<char*>(&image_relocations_[0]),
+                         image_header.GetImageRelocationsSize(),
+                         image_header.GetRelocationsOffset())) {
+    return false;
+  }
+  if (!oat_relocations_.empty() &&
+      !image_file->Write(reinterpret_cast<char*>(&oat_relocations_[0]),
+                         oat_relocations_.size() * sizeof(uint32_t),
+                         image_header.GetRelocationsOffset() +
+                             image_header.GetImageRelocationsSize())) {
+    return false;
+  }
   return true;
 }
 
@@ -240,6 +345,69 @@ void ImageWriter::ComputeEagerResolvedStrings()
   heap->GetLiveBitmap()->Walk(ComputeEagerResolvedStringsCallback, this);
 }
 
+void ImageWriter::ResolveDexCaches() {
+  Thread* self = Thread::Current();
+  ClassLinker* class_linker = Runtime::Current()->GetClassLinker();
+  size_t unresolved = 0;
+  size_t total = 0;
+  for (DexCache* dex_cache : dex_caches_) {
+    const DexFile& dex_file = *dex_cache->GetDexFile();
+    for (size_t i = 0; i < dex_file.NumStringIds(); ++i) {
+      class_linker->ResolveString(dex_file, i, dex_cache);
+    }
+    // Only the image classes are left in the class table, looking types up rather than resolving
+    // them keeps the others out of the image.
+    for (size_t i = 0; i < dex_file.NumTypeIds(); ++i) {
+      if (dex_cache->GetResolvedType(i) == NULL) {
+        const char* descriptor = dex_file.StringByTypeIdx(i);
+        Class* klass = class_linker->LookupClass(descriptor, NULL);
+        if (klass != NULL && klass->IsResolved()) {
+          dex_cache->SetResolvedType(i, klass);
+        } else {
+          ++unresolved;
+        }
+      }
+    }
+    total += dex_file.NumTypeIds();
+    // The dex cache has a single entry per method and field, whichever way it is invoked or
+    // accessed, so try each kind in turn.
+    static const InvokeType kInvokeTypes[] = { kStatic, kDirect, kVirtual, kInterface };
+    for (size_t i = 0; i < dex_file.NumMethodIds(); ++i) {
+      const DexFile::MethodId& method_id = dex_file.GetMethodId(i);
+      if (dex_cache->GetResolvedMethod(i) != NULL ||
+          dex_cache->GetResolvedType(method_id.class_idx_) == NULL) {
+        unresolved += dex_cache->GetResolvedMethod(i) == NULL ? 1 : 0;
+        continue;
+      }
+      for (size_t j = 0; j < arraysize(kInvokeTypes); ++j) {
+        ArtMethod* method = class_linker->ResolveMethod(dex_file, i, dex_cache, NULL, NULL,
+                                                        kInvokeTypes[j]);
+        self->ClearException();
+        if (method != NULL) {
+          break;
+        }
+      }
+      unresolved += dex_cache->GetResolvedMethod(i) == NULL ? 1 : 0;
+    }
+    total += dex_file.NumMethodIds();
+    for (size_t i = 0; i < dex_file.NumFieldIds(); ++i) {
+      const DexFile::FieldId& field_id = dex_file.GetFieldId(i);
+      if (dex_cache->GetResolvedField(i) == NULL &&
+          dex_cache->GetResolvedType(field_id.class_idx_) != NULL) {
+        if (class_linker->ResolveField(dex_file, i, dex_cache, NULL, true) == NULL) {
+          self->ClearException();
+          class_linker->ResolveField(dex_file, i, dex_cache, NULL, false);
+          self->ClearException();
+        }
+      }
+      unresolved += dex_cache->GetResolvedField(i) == NULL ? 1 : 0;
+    }
+    total += dex_file.NumFieldIds();
+  }
+  VLOG(compiler) << "Dex cache types, methods and fields left unresolved: " << unresolved
+                 << " of " << total;
+}
+
 bool ImageWriter::IsImageClass(const Class* klass) {
   return compiler_driver_.IsImageClass(ClassHelper(klass).GetDescriptor());
 }
@@ -346,25 +514,109 @@ void ImageWriter::CalculateNewObjectOffsetsCallback(Object* obj, void* arg) {
 
   // if it is a string, we want to intern it if its not interned.
   if (obj->GetClass()->IsStringClass()) {
-    // we must be an interned string that was forward referenced and already assigned
-    if (image_writer->IsImageOffsetAssigned(obj)) {
-      DCHECK_EQ(obj, obj->AsString()->Intern());
-      return;
-    }
     SirtRef<String> interned(Thread::Current(), obj->AsString()->Intern());
     if (obj != interned.get()) {
-      if (!image_writer->IsImageOffsetAssigned(interned.get())) {
+      if (image_writer->interned_strings_.insert(interned.get()).second) {
         // interned obj is after us, allocate its location early
-        image_writer->AssignImageOffset(interned.get());
+        image_writer->image_objects_.push_back(interned.get());
       }
       // point those looking for this object to the interned version.
-      image_writer->SetImageOffset(obj, image_writer->GetImageOffset(interned.get()));
+      image_writer->string_aliases_.push_back(std::make_pair(obj, interned.get()));
+      return;
+    }
+    // we must be an interned string that was forward referenced and already placed
+    if (!image_writer->interned_strings_.insert(obj).second) {
       return;
     }
-    // else (obj == interned), nothing to do but fall through to the normal case
+    // else nothing to do but fall through to the normal case
+  }
+
+  image_writer->image_objects_.push_back(obj);
+}
+
+bool ImageWriter::IsHotImageMethod(const ArtMethod* method) const {
+  if (method->IsRuntimeMethod() || method->IsProxyMethod()) {
+    return false;
   }
+  MethodHelper mh(method);
+  return compiler_driver_.IsProfiledHot(mh.GetDexFile(), method->GetDexMethodIndex());
+}
 
-  image_writer->AssignImageOffset(obj);
+bool ImageWriter::IsHotImageObject(const Object* obj) const {
+  if (obj->IsArtMethod()) {
+    return IsHotImageMethod(obj->AsArtMethod());
+  }
+  if (obj->IsClass()) {
+    const Class* klass = obj->AsClass();
+    for (size_t i = 0; i < klass->NumDirectMethods(); ++i) {
+      if (IsHotImageMethod(klass->GetDirectMethod(i))) {
+        return true;
+      }
+    }
+    for (size_t i = 0; i < klass->NumVirtualMethods(); ++i) {
+      if (IsHotImageMethod(klass->GetVirtualMethod(i))) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+bool ImageWriter::IsDirtyImageObject(const Object* obj) {
+  if (dirty_dex_cache_objects_.count(obj) != 0) {
+    return true;
+  }
+  if (obj->IsClass() && !obj->AsClass()->IsInitialized()) {
+    // Initializing the class writes its status and statics.
+    return true;
+  }
+  if (dirty_image_classes_ == NULL || dirty_image_classes_->empty()) {
+    return false;
+  }
+  const Class* klass = obj->IsClass() ? obj->AsClass() : obj->GetClass();
+  auto it = dirty_image_class_cache_.find(klass);
+  if (it != dirty_image_class_cache_.end()) {
+    return it->second;
+  }
+  bool is_dirty = dirty_image_classes_->count(ClassHelper(klass).GetDescriptor()) != 0;
+  dirty_image_class_cache_.Put(klass, is_dirty);
+  return is_dirty;
+}
+
+template <typename Visitor>
+class ImageObjectRangeTask : public Task {
+ public:
+  ImageObjectRangeTask(const Visitor* visitor, size_t begin, size_t end)
+      : visitor_(visitor), begin_(begin), end_(end) {}
+
+  // The thread which started the tasks holds the locks on behalf of the workers.
+  virtual void Run(Thread* self) NO_THREAD_SAFETY_ANALYSIS {
+    (*visitor_)(begin_, end_);
+  }
+
+  virtual void Finalize() {
+    delete this;
+  }
+
+ private:
+  const Visitor* const visitor_;
+  const size_t begin_;
+  const size_t end_;
+};
+
+template <typename Visitor>
+void ImageWriter::ForAllImageObjectRanges(ThreadPool& thread_pool, const Visitor& visitor) {
+  Thread* self = Thread::Current();
+  const size_t num_objects = image_objects_.size();
+  const size_t num_ranges = (thread_pool.GetThreadCount() + 1) * kImageObjectRangesPerThread;
+  const size_t range_size = RoundUp(num_objects, num_ranges) / num_ranges;
+  for (size_t begin = 0; begin < num_objects; begin += range_size) {
+    thread_pool.AddTask(self, new ImageObjectRangeTask<Visitor>(
+        &visitor, begin, std::min(begin + range_size, num_objects)));
+  }
+  thread_pool.StartWorkers(self);
+  thread_pool.Wait(self, true, true);
+  thread_pool.StopWorkers(self);
 }
 
 ObjectArray<Object>* ImageWriter::CreateImageRoots() const {
@@ -399,13 +651,52 @@ ObjectArray<Object>* ImageWriter::CreateImageRoots() const {
                    dex_caches);
   image_roots->Set(ImageHeader::kClassRoots,
                    class_linker->GetClassRoots());
+  image_roots->Set(ImageHeader::kInternedStrings,
+                   CreateInternedStrings());
   for (int i = 0; i < ImageHeader::kImageRootsMax; i++) {
     CHECK(image_roots->Get(i) != NULL);
   }
   return image_roots.get();
 }
 
-void ImageWriter::CalculateNewObjectOffsets(size_t oat_loaded_size, size_t oat_data_offset) {
+ObjectArray<String>* ImageWriter::CreateInternedStrings() const {
+  Thread* self = Thread::Current();
+  std::vector<String*> strings;
+  for (DexCache* dex_cache : dex_caches_) {
+    for (size_t i = 0; i < dex_cache->NumStrings(); ++i) {
+      String* string = dex_cache->GetResolvedString(i);
+      if (string != NULL) {
+        strings.push_back(string);
+      }
+    }
+  }
+  // At most half full, so that probes stay short and always reach a null slot.
+  size_t capacity = RoundUpToPowerOfTwo(std::max<size_t>(strings.size() * 2, 2));
+  size_t mask = capacity - 1;
+  Class* string_array_class = Runtime::Current()->GetClassLinker()->FindSystemClass(
+      "[Ljava/lang/String;");
+  ObjectArray<String>* table = ObjectArray<String>::Alloc(self, string_array_class, capacity);
+  CHECK(table != NULL);
+  for (String* string : strings) {
+    // Computing the hash code here also saves the runtime from writing it to the image page.
+    int32_t hash_code = string->GetHashCode();
+    for (size_t index = hash_code & mask; ; index = (index + 1) & mask) {
+      String* slot = table->GetWithoutChecks(index);
+      if (slot == NULL) {
+        table->SetWithoutChecks(index, string);
+        break;
+      }
+      if (slot == string || slot->Equals(string)) {
+        break;  // Equal strings of different dex caches, the first one is the interned one.
+      }
+    }
+  }
+  return table;
+}
+
+void ImageWriter::CalculateNewObjectOffsets(size_t oat_loaded_size, size_t oat_data_offset,
+                                            ThreadPool& thread_pool,
+                                            base::TimingLogger& timings) {
   CHECK_NE(0U, oat_loaded_size);
   Thread* self = Thread::Current();
   SirtRef<ObjectArray<Object> > image_roots(self, CreateImageRoots());
@@ -426,9 +717,118 @@ void ImageWriter::CalculateNewObjectOffsets(size_t oat_loaded_size, size_t oat_d
     // TODO: Add InOrderWalk to heap bitmap.
     const char* old = self->StartAssertNoThreadSuspension("ImageWriter");
     DCHECK(heap->GetLargeObjectsSpace()->GetLiveObjects()->IsEmpty());
-    for (const auto& space : spaces) {
-      space->GetLiveBitmap()->InOrderWalk(CalculateNewObjectOffsetsCallback, this);
-      DCHECK_LT(image_end_, image_->Size());
+    size_t num_clean_image_objects = 0;
+    size_t num_read_only_image_objects = 0;
+    {
+      // Interning decides which objects get a slot, and where forward referenced interned strings
+      // go, so the order is worked out serially.
+      base::TimingLogger::ScopedSplit split("OrderImageObjects", &timings);
+      for (const auto& space : spaces) {
+        space->GetLiveBitmap()->InOrderWalk(CalculateNewObjectOffsetsCallback, this);
+      }
+      interned_strings_.clear();
+      if (compiler_driver_.HasMethodProfile()) {
+        // Group the classes and methods touched by the profiled hot methods at the start of the
+        // image, keeping the walk order within each group.
+        std::stable_partition(image_objects_.begin(), image_objects_.end(),
+                              [this](const Object* obj) NO_THREAD_SAFETY_ANALYSIS {
+                                return IsHotImageObject(obj);
+                              });
+      }
+      // Move the objects likely to be written at runtime to the end, where they start on a page
+      // of their own, so that the pages before them stay clean and shared between processes.
+      // With read_only_dex_caches_, the dex cache arrays other than the static storage, which
+      // class initialization writes, go between the two on pages of their own.
+      std::set<const Object*>& dex_cache_arrays =
+          read_only_dex_caches_ ? read_only_dex_cache_arrays_ : dirty_dex_cache_objects_;
+      for (DexCache* dex_cache : dex_caches_) {
+        dirty_dex_cache_objects_.insert(dex_cache);
+        dex_cache_arrays.insert(dex_cache->GetStrings());
+        dex_cache_arrays.insert(dex_cache->GetResolvedTypes());
+        dex_cache_arrays.insert(dex_cache->GetResolvedMethods());
+        dex_cache_arrays.insert(dex_cache->GetResolvedFields());
+        dirty_dex_cache_objects_.insert(dex_cache->GetInitializedStaticStorage());
+      }
+      auto first_dirty = std::stable_partition(image_objects_.begin(), image_objects_.end(),
+                                               [this](const Object* obj) NO_THREAD_SAFETY_ANALYSIS {
+                                                 return !IsDirtyImageObject(obj) &&
+                                                     read_only_dex_cache_arrays_.count(obj) == 0;
+                                               });
+      num_clean_image_objects = first_dirty - image_objects_.begin();
+      auto first_writable =
+          std::stable_partition(first_dirty, image_objects_.end(), [this](const Object* obj) {
+            return read_only_dex_cache_arrays_.count(obj) != 0;
+          });
+      num_read_only_image_objects = first_writable - first_dirty;
+      dirty_dex_cache_objects_.clear();
+      read_only_dex_cache_arrays_.clear();
+      dirty_image_class_cache_.clear();
+    }
+    {
+      base::TimingLogger::ScopedSplit split("AssignImageOffsets", &timings);
+      // Each range first sums the aligned sizes of its objects, a prefix sum over the ranges then
+      // gives where each range starts, from which each range assigns offsets to its objects.
+      image_object_offsets_.resize(image_objects_.size());
+      std::vector<size_t> range_offsets(image_objects_.size(), 0);
+      auto size_visitor = [&](size_t begin, size_t end) NO_THREAD_SAFETY_ANALYSIS {
+        size_t range_size = 0;
+        for (size_t i = begin; i < end; ++i) {
+          image_object_offsets_[i] = RoundUp(image_objects_[i]->SizeOf(), 8);  // 64-bit alignment
+          range_size += image_object_offsets_[i];
+        }
+        range_offsets[begin] = range_size;
+      };
+      ForAllImageObjectRanges(thread_pool, size_visitor);
+      // Only the first index of each range holds a size, the others are still zero.
+      for (size_t i = 0; i < range_offsets.size(); ++i) {
+        const size_t range_size = range_offsets[i];
+        range_offsets[i] = image_end_;
+        image_end_ += range_size;
+      }
+      CHECK_LT(image_end_, image_->Size());
+      auto offset_visitor = [&](size_t begin, size_t end) NO_THREAD_SAFETY_ANALYSIS {
+        size_t offset = range_offsets[begin];
+        for (size_t i = begin; i < end; ++i) {
+          const size_t object_size = image_object_offsets_[i];
+          image_object_offsets_[i] = offset;
+          offset += object_size;
+        }
+      };
+      ForAllImageObjectRanges(thread_pool, offset_visitor);
+      // The read-only objects and the objects likely to be written each start on a new page.
+      const size_t first_dirty = num_clean_image_objects + num_read_only_image_objects;
+      const size_t group_starts[] = { num_clean_image_objects, first_dirty };
+      for (size_t group_start : group_starts) {
+        if (group_start == 0 || group_start == image_objects_.size()) {
+          continue;
+        }
+        const size_t group_begin = image_object_offsets_[group_start];
+        const size_t padding = RoundUp(group_begin, kPageSize) - group_begin;
+        for (size_t i = group_start; i < image_objects_.size(); ++i) {
+          image_object_offsets_[i] += padding;
+        }
+        image_end_ += padding;
+      }
+      CHECK_LT(image_end_, image_->Size());
+      if (num_read_only_image_objects != 0) {
+        read_only_begin_ = image_object_offsets_[num_clean_image_objects];
+        read_only_end_ = first_dirty != image_objects_.size() ? image_object_offsets_[first_dirty]
+                                                              : RoundUp(image_end_, kPageSize);
+        VLOG(compiler) << "Read-only dex cache arrays: " << num_read_only_image_objects << " in "
+                       << PrettySize(read_only_end_ - read_only_begin_);
+      }
+      if (first_dirty != image_objects_.size()) {
+        VLOG(compiler) << "Image objects likely to be written: "
+                       << image_objects_.size() - first_dirty << " in "
+                       << PrettySize(image_end_ - image_object_offsets_[first_dirty]);
+      }
+      for (size_t i = 0; i < image_objects_.size(); ++i) {
+        SetImageOffset(image_objects_[i], image_object_offsets_[i]);
+      }
+      for (const auto& alias : string_aliases_) {
+        SetImageOffset(alias.first, GetImageOffset(alias.second));
+      }
+      string_aliases_.clear();
     }
     self->EndAssertNoThreadSuspension(old);
   }
@@ -436,6 +836,9 @@ void ImageWriter::CalculateNewObjectOffsets(size_t oat_loaded_size, size_t oat_d
   // Create the image bitmap.
   image_bitmap_.reset(gc::accounting::SpaceBitmap::Create("image bitmap", image_->Begin(),
                                                           image_end_));
+  // And the relocation bitmap, one bit per word of the image.
+  size_t image_words = RoundUp(image_end_, sizeof(uint32_t)) / sizeof(uint32_t);
+  image_relocations_.assign(RoundUp(image_words, 32) / 32, 0);
   const byte* oat_file_begin = image_begin_ + RoundUp(image_end_, kPageSize);
   const byte* oat_file_end = oat_file_begin + oat_loaded_size;
   oat_data_begin_ = oat_file_begin + oat_data_offset;
@@ -453,13 +856,189 @@ void ImageWriter::CalculateNewObjectOffsets(size_t oat_loaded_size, size_t oat_d
                            reinterpret_cast<uint32_t>(oat_data_begin_),
                            reinterpret_cast<uint32_t>(oat_data_end),
                            reinterpret_cast<uint32_t>(oat_file_end));
+  image_header.SetReadOnlyDexCacheArrays(read_only_begin_, read_only_end_);
   memcpy(image_->Begin(), &image_header, sizeof(image_header));
 
   // Note that image_end_ is left at end of used space
 }
 
-void ImageWriter::CopyAndFixupObjects()
-    SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
+bool ImageWriter::IsInBootImage(const Object* object) const {
+  return boot_image_space_->Contains(object);
+}
+
+bool ImageWriter::IsAppImageClass(const Class* klass) {
+  if (IsInBootImage(klass)) {
+    return false;
+  }
+  SafeMap<const Class*, bool>::const_iterator it = app_image_classes_.find(klass);
+  if (it != app_image_classes_.end()) {
+    return it->second;
+  }
+  bool result = !klass->IsArrayClass() && !klass->IsProxyClass() && klass->IsResolved() &&
+      !klass->IsErroneous() && app_dex_caches_.count(klass->GetDexCache()) != 0;
+  const Class* super_class = klass->GetSuperClass();
+  if (result && super_class != NULL) {
+    result = IsInBootImage(super_class) || IsAppImageClass(super_class);
+  }
+  const mirror::IfTable* iftable = klass->GetIfTable();
+  for (int32_t i = 0; result && i < klass->GetIfTableCount(); ++i) {
+    const Class* interface = iftable->GetInterface(i);
+    result = IsInBootImage(interface) || IsAppImageClass(interface);
+  }
+  app_image_classes_.Put(klass, result);
+  return result;
+}
+
+bool ImageWriter::IsAppImageObject(const Object* object) {
+  if (IsInBootImage(object)) {
+    return false;
+  }
+  if (object->IsClass()) {
+    return IsAppImageClass(object->AsClass());
+  }
+  if (object->IsArtMethod()) {
+    return IsAppImageClass(object->AsArtMethod()->GetDeclaringClass());
+  }
+  if (object->IsArtField()) {
+    return IsAppImageClass(object->AsArtField()->GetDeclaringClass());
+  }
+  if (app_dex_caches_.count(object) != 0) {
+    return true;
+  }
+  // Otherwise only the strings and arrays these point to, never instances of app classes or
+  // per-process objects such as class loaders.
+  const Class* klass = object->GetClass();
+  return IsInBootImage(klass) && (klass->IsStringClass() || klass->IsArrayClass());
+}
+
+ObjectArray<Object>* ImageWriter::CreateAppImageRoots(
+    const std::vector<const DexFile*>& dex_files) {
+  ClassLinker* class_linker = Runtime::Current()->GetClassLinker();
+  Class* object_array_class = class_linker->FindSystemClass("[Ljava/lang/Object;");
+  Class* class_array_class = class_linker->FindSystemClass("[Ljava/lang/Class;");
+  Thread* self = Thread::Current();
+
+  SirtRef<ObjectArray<Object> > dex_caches(self,
+      ObjectArray<Object>::Alloc(self, object_array_class, dex_files.size()));
+  SirtRef<ObjectArray<Object> > classes(self,
+      ObjectArray<Object>::Alloc(self, object_array_class, dex_files.size()));
+  for (size_t i = 0; i < dex_files.size(); ++i) {
+    const DexFile& dex_file = *dex_files[i];
+    DexCache* dex_cache = class_linker->FindDexCache(dex_file);
+    dex_caches->Set(i, dex_cache);
+    ObjectArray<Class>* dex_file_classes =
+        ObjectArray<Class>::Alloc(self, class_array_class, dex_file.NumClassDefs());
+    classes->Set(i, dex_file_classes);
+    for (size_t class_def_index = 0; class_def_index < dex_file.NumClassDefs();
+         ++class_def_index) {
+      const DexFile::ClassDef& class_def = dex_file.GetClassDef(class_def_index);
+      // The compiler resolved the classes it could through the DexCache.
+      Class* klass = dex_cache->GetResolvedType(class_def.class_idx_);
+      if (klass != NULL && klass->GetDexCache() == dex_cache &&
+          klass->GetDexClassDefIndex() == class_def_index && IsAppImageClass(klass)) {
+        dex_file_classes->Set(class_def_index, klass);
+      }
+    }
+  }
+
+  ObjectArray<Object>* image_roots =
+      ObjectArray<Object>::Alloc(self, object_array_class, ImageHeader::kImageRootsMax);
+  image_roots->Set(ImageHeader::kDexCaches, dex_caches.get());
+  image_roots->Set(ImageHeader::kClassRoots, classes.get());
+  return image_roots;
+}
+
+void ImageWriter::CalculateAppImageObjectOffsets(ObjectArray<Object>* image_roots,
+                                                 base::TimingLogger& timings) {
+  base::TimingLogger::ScopedSplit split("CalculateAppImageObjectOffsets", &timings);
+  Thread* self = Thread::Current();
+  DCHECK_EQ(0U, image_end_);
+  image_end_ += RoundUp(sizeof(ImageHeader), 8);  // 64-bit-alignment
+
+  {
+    ReaderMutexLock mu(self, *Locks::heap_bitmap_lock_);
+    const char* old = self->StartAssertNoThreadSuspension("ImageWriter");
+    // Breadth first from the roots, image_objects_ being the queue. Only the entries of the
+    // DexCache arrays which are kept are followed, and these are all in the boot image.
+    std::set<const Object*> seen;
+    seen.insert(image_roots);
+    image_objects_.push_back(image_roots);
+    auto visit = [&](const Object* ref) NO_THREAD_SAFETY_ANALYSIS {
+      if (ref != NULL && seen.insert(ref).second && IsAppImageObject(ref)) {
+        image_objects_.push_back(const_cast<Object*>(ref));
+      }
+    };
+    for (size_t i = 0; i < image_objects_.size(); ++i) {
+      const Object* obj = image_objects_[i];
+      visit(obj->GetClass());
+      if (dex_cache_arrays_.find(obj) == dex_cache_arrays_.end()) {
+        gc::collector::MarkSweep::VisitObjectReferences(obj,
+            [&](const Object*, const Object* ref, const MemberOffset&, bool)
+                NO_THREAD_SAFETY_ANALYSIS {
+              visit(ref);
+            });
+      }
+    }
+
+    image_object_offsets_.resize(image_objects_.size());
+    for (size_t i = 0; i < image_objects_.size(); ++i) {
+      image_object_offsets_[i] = image_end_;
+      SetImageOffset(image_objects_[i], image_end_);
+      image_end_ += RoundUp(image_objects_[i]->SizeOf(), 8);  // 64-bit alignment
+    }
+    CHECK_LT(image_end_, image_->Size());
+    self->EndAssertNoThreadSuspension(old);
+  }
+
+  image_bitmap_.reset(gc::accounting::SpaceBitmap::Create("image bitmap", image_->Begin(),
+                                                          image_end_));
+  size_t image_words = RoundUp(image_end_, sizeof(uint32_t)) / sizeof(uint32_t);
+  image_relocations_.assign(RoundUp(image_words, 32) / 32, 0);
+
+  // There is no oat file mapped after an app image, its code is linked by the class linker.
+  ImageHeader image_header(reinterpret_cast<uint32_t>(image_begin_),
+                           static_cast<uint32_t>(image_end_),
+                           RoundUp(image_end_, kPageSize),
+                           image_bitmap_->Size(),
+                           reinterpret_cast<uint32_t>(GetImageAddress(image_roots)),
+                           app_oat_checksum_,
+                           0, 0, 0, 0);
+  const ImageHeader& boot_image_header = boot_image_space_->GetImageHeader();
+  image_header.SetBootImage(reinterpret_cast<uint32_t>(boot_image_header.GetImageBegin()),
+                            boot_image_header.GetOatChecksum());
+  memcpy(image_->Begin(), &image_header, sizeof(image_header));
+}
+
+const Object* ImageWriter::GetAppDexCacheEntry(const DexCache* dex_cache,
+                                               const ObjectArray<Object>* array,
+                                               int32_t index) const {
+  // Entries are only kept if they point into the boot image and were resolved without going
+  // through an app class, so that app classes are only reached once their class loader has
+  // defined them. Classes are initialized again in each process, so no static storage is kept.
+  const Object* resolution_method = Runtime::Current()->GetResolutionMethod();
+  const DexFile& dex_file = *dex_cache->GetDexFile();
+  const Object* element = array->Get(index);
+  const Object* array_object = array;
+  bool keep = element != NULL && IsInBootImage(element);
+  if (array_object == dex_cache->GetResolvedMethods()) {
+    if (keep && element != resolution_method) {
+      const Class* klass = dex_cache->GetResolvedType(dex_file.GetMethodId(index).class_idx_);
+      keep = klass != NULL && IsInBootImage(klass);
+    }
+    return keep ? element : resolution_method;
+  } else if (array_object == dex_cache->GetResolvedFields()) {
+    if (keep) {
+      const Class* klass = dex_cache->GetResolvedType(dex_file.GetFieldId(index).class_idx_);
+      keep = klass != NULL && IsInBootImage(klass);
+    }
+  } else if (array_object == dex_cache->GetInitializedStaticStorage()) {
+    keep = false;
+  }
+  return keep ? element : NULL;
+}
+
+void ImageWriter::CopyAndFixupObjects(ThreadPool& thread_pool, base::TimingLogger& timings) {
+  base::TimingLogger::ScopedSplit split("CopyAndFixupObjects", &timings);
   Thread* self = Thread::Current();
   const char* old_cause = self->StartAssertNoThreadSuspension("ImageWriter");
   gc::Heap* heap = Runtime::Current()->GetHeap();
@@ -467,33 +1046,36 @@ void ImageWriter::CopyAndFixupObjects()
   heap->DisableObjectValidation();
   // TODO: Image spaces only?
   WriterMutexLock mu(self, *Locks::heap_bitmap_lock_);
-  heap->FlushAllocStack();
-  heap->GetLiveBitmap()->Walk(CopyAndFixupObjectsCallback, this);
+  // Strings which share the slot of their interned version aren't copied, so every slot is only
+  // written by the one range which owns it.
+  auto copy_visitor = [&](size_t begin, size_t end) NO_THREAD_SAFETY_ANALYSIS {
+    for (size_t i = begin; i < end; ++i) {
+      CopyAndFixupObject(image_objects_[i], image_object_offsets_[i]);
+    }
+  };
+  ForAllImageObjectRanges(thread_pool, copy_visitor);
   self->EndAssertNoThreadSuspension(old_cause);
 }
 
-void ImageWriter::CopyAndFixupObjectsCallback(Object* object, void* arg) {
-  DCHECK(object != NULL);
-  DCHECK(arg != NULL);
-  const Object* obj = object;
-  ImageWriter* image_writer = reinterpret_cast<ImageWriter*>(arg);
-
+void ImageWriter::CopyAndFixupObject(const Object* obj, size_t offset) {
+  DCHECK(obj != NULL);
+  DCHECK_EQ(offset, GetImageOffset(obj));
   // see GetLocalAddress for similar computation
-  size_t offset = image_writer->GetImageOffset(obj);
-  byte* dst = image_writer->image_->Begin() + offset;
+  byte* dst = image_->Begin() + offset;
   const byte* src = reinterpret_cast<const byte*>(obj);
   size_t n = obj->SizeOf();
-  DCHECK_LT(offset + n, image_writer->image_->Size());
+  DCHECK_LT(offset + n, image_->Size());
   memcpy(dst, src, n);
   Object* copy = reinterpret_cast<Object*>(dst);
   copy->SetField32(Object::MonitorOffset(), 0, false);  // We may have inflated the lock during compilation.
-  image_writer->FixupObject(obj, copy);
+  FixupObject(obj, copy);
 }
 
 void ImageWriter::FixupObject(const Object* orig, Object* copy) {
   DCHECK(orig != NULL);
   DCHECK(copy != NULL);
   copy->SetClass(down_cast<Class*>(GetImageAddress(orig->GetClass())));
+  RecordRelocation(copy, Object::ClassOffset());
   // TODO: special case init of pointers to malloc data (or removal of these pointers)
   if (orig->IsClass()) {
     FixupClass(orig->AsClass(), down_cast<Class*>(copy));
@@ -504,16 +1086,46 @@ void ImageWriter::FixupObject(const Object* orig, Object* copy) {
   } else {
     FixupInstanceFields(orig, copy);
   }
+  if (app_image_ && app_dex_caches_.count(orig) != 0) {
+    // The DexFile is set when the DexCache is registered in the runtime.
+    down_cast<DexCache*>(copy)->SetDexFile(NULL);
+  }
 }
 
 void ImageWriter::FixupClass(const Class* orig, Class* copy) {
   FixupInstanceFields(orig, copy);
   FixupStaticFields(orig, copy);
+  for (uint32_t depth = 1; depth <= Class::kSuperClassDisplayDepth; ++depth) {
+    const Class* super_class = orig->GetSuperClassDisplayEntry(depth);
+    if (super_class != NULL) {
+      MemberOffset offset = Class::SuperClassDisplayEntryOffset(depth);
+      copy->SetFieldPtr(offset, GetImageAddress(super_class), false);
+      RecordRelocation(copy, offset);
+    }
+  }
+  if (app_image_) {
+    // App classes are initialized in each process that loads them.
+    if (orig->GetStatus() > Class::kStatusVerified) {
+      copy->SetField32(OFFSET_OF_OBJECT_MEMBER(Class, status_), Class::kStatusVerified, false);
+    }
+    copy->SetField32(OFFSET_OF_OBJECT_MEMBER(Class, clinit_thread_id_), 0, false);
+  }
 }
 
 void ImageWriter::FixupMethod(const ArtMethod* orig, ArtMethod* copy) {
   FixupInstanceFields(orig, copy);
 
+  if (app_image_) {
+    // App oat files are position independent, the code is linked when the class is loaded.
+    copy->SetEntryPointFromCompiledCode(NULL);
+    copy->SetEntryPointFromInterpreter(NULL);
+    copy->SetNativeMethod(NULL);
+    copy->SetMappingTable(NULL);
+    copy->SetVmapTable(NULL);
+    copy->SetNativeGcMap(NULL);
+    return;
+  }
+
   // OatWriter replaces the code_ with an offset value. Here we re-adjust to a pointer relative to
   // oat_begin_
 
@@ -571,15 +1183,48 @@ void ImageWriter::FixupMethod(const ArtMethod* orig, ArtMethod* copy) {
       }
     }
   }
+
+  RecordRelocation(copy, MemberOffset(OFFSETOF_MEMBER(ArtMethod, entry_point_from_compiled_code_)));
+  RecordRelocation(copy, MemberOffset(OFFSETOF_MEMBER(ArtMethod, entry_point_from_interpreter_)));
+  RecordRelocation(copy, MemberOffset(OFFSETOF_MEMBER(ArtMethod, native_method_)));
+  RecordRelocation(copy, MemberOffset(OFFSETOF_MEMBER(ArtMethod, mapping_table_)));
+  RecordRelocation(copy, MemberOffset(OFFSETOF_MEMBER(ArtMethod, vmap_table_)));
+  RecordRelocation(copy, MemberOffset(OFFSETOF_MEMBER(ArtMethod, gc_map_)));
 }
 
 void ImageWriter::FixupObjectArray(const ObjectArray<Object>* orig, ObjectArray<Object>* copy) {
+  const size_t data_offset =
+      ObjectArray<Object>::DataOffset(mirror::kHeapReferenceSize).Uint32Value();
+  const DexCache* dex_cache = NULL;
+  if (app_image_) {
+    SafeMap<const Object*, const DexCache*>::const_iterator it = dex_cache_arrays_.find(orig);
+    if (it != dex_cache_arrays_.end()) {
+      dex_cache = it->second;
+    }
+  }
   for (int32_t i = 0; i < orig->GetLength(); ++i) {
-    const Object* element = orig->Get(i);
+    const Object* element = (dex_cache != NULL) ? GetAppDexCacheEntry(dex_cache, orig, i)
+                                                : orig->Get(i);
     copy->SetPtrWithoutChecks(i, GetImageAddress(element));
+    RecordRelocation(copy, MemberOffset(data_offset + i * mirror::kHeapReferenceSize));
   }
 }
 
+void ImageWriter::RecordRelocation(const Object* copy, MemberOffset offset) {
+  uint32_t value = copy->GetField32(offset, false);
+  if (value == 0) {
+    return;
+  }
+  if (app_image_ && value - reinterpret_cast<uint32_t>(image_begin_) >= image_end_) {
+    return;  // Points into the boot image, which app images are only valid with.
+  }
+  size_t word = (reinterpret_cast<const byte*>(copy) + offset.Uint32Value() - image_->Begin()) /
+      sizeof(uint32_t);
+  DCHECK_LT(word / 32, image_relocations_.size());
+  // Objects in different ranges may share a bitmap word.
+  android_atomic_or(1 << (word % 32), reinterpret_cast<int32_t*>(&image_relocations_[word / 32]));
+}
+
 void ImageWriter::FixupInstanceFields(const Object* orig, Object* copy) {
   DCHECK(orig != NULL);
   DCHECK(copy != NULL);
@@ -612,6 +1257,7 @@ void ImageWriter::FixupFields(const Object* orig,
       const Object* ref = orig->GetFieldObject<const Object*>(byte_offset, false);
       // Use SetFieldPtr to avoid card marking since we are writing to the image.
       copy->SetFieldPtr(byte_offset, GetImageAddress(ref), false);
+      RecordRelocation(copy, byte_offset);
       ref_offsets &= ~(CLASS_HIGH_BIT >> right_shift);
     }
   } else {
@@ -633,6 +1279,7 @@ void ImageWriter::FixupFields(const Object* orig,
         const Object* ref = orig->GetFieldObject<const Object*>(field_offset, false);
         // Use SetFieldPtr to avoid card marking since we are writing to the image.
         copy->SetFieldPtr(field_offset, GetImageAddress(ref), false);
+        RecordRelocation(copy, field_offset);
       }
     }
   }
@@ -643,6 +1290,7 @@ void ImageWriter::FixupFields(const Object* orig,
     const Object* ref = orig->GetFieldObject<const Object*>(field_offset, false);
     // Use SetFieldPtr to avoid card marking since we are writing to the image.
     copy->SetFieldPtr(field_offset, GetImageAddress(ref), false);
+    RecordRelocation(copy, field_offset);
   }
 }
 
@@ -677,9 +1325,15 @@ void ImageWriter::PatchOatCodeAndMethods() {
   for (size_t i = 0; i < code_to_patch.size(); i++) {
     const CompilerDriver::PatchInformation* patch = code_to_patch[i];
     ArtMethod* target = GetTargetMethod(patch);
-    uint32_t code = reinterpret_cast<uint32_t>(class_linker->GetOatCodeFor(target));
-    uint32_t code_base = reinterpret_cast<uint32_t>(&oat_file_->GetOatHeader());
-    uint32_t code_offset = code - code_base;
+    uint32_t code_offset;
+    if (class_linker->HasCompressedOatCode(target)) {
+      // Calls to compressed code go through the trampoline that inflates it.
+      code_offset = quick_resolution_trampoline_offset_;
+    } else {
+      uint32_t code = reinterpret_cast<uint32_t>(class_linker->GetOatCodeFor(target));
+      uint32_t code_base = reinterpret_cast<uint32_t>(&oat_file_->GetOatHeader());
+      code_offset = code - code_base;
+    }
     SetPatchLocation(patch, reinterpret_cast<uint32_t>(GetOatAddress(code_offset)));
   }
 
@@ -716,6 +1370,8 @@ void ImageWriter::SetPatchLocation(const CompilerDriver::PatchInformation* patch
 #endif
   *patch_location = value;
   oat_header.UpdateChecksum(patch_location, sizeof(value));
+  oat_relocations_.push_back(reinterpret_cast<uint8_t*>(patch_location) -
+                             reinterpret_cast<uint8_t*>(&oat_header));
 }
 
 }  // namespace art
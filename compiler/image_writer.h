@@ -22,7 +22,10 @@
 #include <cstddef>
 #include <set>
 #include <string>
+#include <utility>
+#include <vector>
 
+#include "base/timing_logger.h"
 #include "driver/compiler_driver.h"
 #include "mem_map.h"
 #include "oat_file.h"
@@ -34,21 +37,48 @@
 
 namespace art {
 
+class ImageHeader;
+
+namespace gc {
+namespace space {
+class ImageSpace;
+}  // namespace space
+}  // namespace gc
+
 // Write a Space built during compilation for use during execution.
 class ImageWriter {
  public:
-  explicit ImageWriter(const CompilerDriver& compiler_driver)
+  // Instances of dirty_image_classes, and the classes themselves, are expected to be written at
+  // runtime and are placed on pages of their own. It may be NULL. With read_only_dex_caches, the
+  // boot image's dex caches are resolved as far as the image classes allow, and their arrays but
+  // for the static storage are placed on pages of their own that the runtime maps read-only.
+  explicit ImageWriter(const CompilerDriver& compiler_driver,
+                       const CompilerDriver::DescriptorSet* dirty_image_classes = NULL,
+                       bool read_only_dex_caches = false)
       : compiler_driver_(compiler_driver), oat_file_(NULL), image_end_(0), image_begin_(NULL),
         oat_data_begin_(NULL), interpreter_to_interpreter_bridge_offset_(0),
         interpreter_to_compiled_code_bridge_offset_(0), portable_resolution_trampoline_offset_(0),
-        quick_resolution_trampoline_offset_(0) {}
+        quick_resolution_trampoline_offset_(0), app_image_(false), boot_image_space_(NULL),
+        app_oat_checksum_(0), dirty_image_classes_(dirty_image_classes),
+        read_only_dex_caches_(read_only_dex_caches), read_only_begin_(0), read_only_end_(0) {}
 
   ~ImageWriter() {}
 
   bool Write(const std::string& image_filename,
              uintptr_t image_begin,
              const std::string& oat_filename,
-             const std::string& oat_location)
+             const std::string& oat_location,
+             base::TimingLogger& timings)
+      LOCKS_EXCLUDED(Locks::mutator_lock_);
+
+  // Writes an app image of the classes of dex_files, compiled into oat_file on top of the boot
+  // image. It holds the DexCaches of the dex files and their resolved classes, with the methods,
+  // fields and strings these point to, but no code addresses or class initialization.
+  bool WriteAppImage(const std::string& image_filename,
+                     File* oat_file,
+                     const std::string& oat_location,
+                     const std::vector<const DexFile*>& dex_files,
+                     base::TimingLogger& timings)
       LOCKS_EXCLUDED(Locks::mutator_lock_);
 
   uintptr_t GetOatDataBegin() {
@@ -58,18 +88,12 @@ class ImageWriter {
  private:
   bool AllocMemory();
 
+  // Writes the image in image_, with its bitmap and relocations.
+  bool WriteImageFile(const std::string& image_filename);
+
   // Mark the objects defined in this space in the given live bitmap.
   void RecordImageAllocations() SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
 
-  // We use the lock word to store the offset of the object in the image.
-  void AssignImageOffset(mirror::Object* object)
-      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
-    DCHECK(object != NULL);
-    SetImageOffset(object, image_end_);
-    image_end_ += RoundUp(object->SizeOf(), 8);  // 64-bit alignment
-    DCHECK_LT(image_end_, image_->Size());
-  }
-
   void SetImageOffset(mirror::Object* object, size_t offset) {
     DCHECK(object != NULL);
     DCHECK_NE(offset, 0U);
@@ -92,6 +116,15 @@ class ImageWriter {
     if (object == NULL) {
       return NULL;
     }
+    if (app_image_) {
+      // App images point into the boot image as is, and drop references to what they leave out.
+      if (IsInBootImage(object)) {
+        return const_cast<mirror::Object*>(object);
+      }
+      if (!IsImageOffsetAssigned(object)) {
+        return NULL;
+      }
+    }
     return reinterpret_cast<mirror::Object*>(image_begin_ + GetImageOffset(object));
   }
 
@@ -131,6 +164,10 @@ class ImageWriter {
   static void ComputeEagerResolvedStringsCallback(mirror::Object* obj, void* arg)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
 
+  // Resolves every string of the dex caches, and every type, method and field whose class is an
+  // image class, so that the runtime has little left to resolve. Loads no class.
+  void ResolveDexCaches() SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
   // Remove unwanted classes from various roots.
   void PruneNonImageClasses() SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
   static bool NonImageClassesVisitor(mirror::Class* c, void* arg)
@@ -141,18 +178,65 @@ class ImageWriter {
   static void CheckNonImageClassesRemovedCallback(mirror::Object* obj, void* arg)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
 
-  // Lays out where the image objects will be at runtime.
-  void CalculateNewObjectOffsets(size_t oat_loaded_size, size_t oat_data_offset)
+  // Lays out where the image objects will be at runtime. The layout order is decided by a serial
+  // walk of the heap, the offsets are then assigned in parallel on the thread pool.
+  void CalculateNewObjectOffsets(size_t oat_loaded_size, size_t oat_data_offset,
+                                 ThreadPool& thread_pool, base::TimingLogger& timings)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
   mirror::ObjectArray<mirror::Object>* CreateImageRoots() const
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+  // Builds the ImageHeader::kInternedStrings hash table of the dex caches' strings.
+  mirror::ObjectArray<mirror::String>* CreateInternedStrings() const
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+  // Is the object a profiled hot method, or a class with one?
+  bool IsHotImageObject(const mirror::Object* obj) const
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+  bool IsHotImageMethod(const mirror::ArtMethod* method) const
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+  // Is the object likely to be written at runtime, dirtying its page in every process that maps
+  // the image? Such objects are kept together on pages of their own.
+  bool IsDirtyImageObject(const mirror::Object* obj)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
   static void CalculateNewObjectOffsetsCallback(mirror::Object* obj, void* arg)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
 
+  bool IsInBootImage(const mirror::Object* object) const;
+
+  // Returns true if the class is one of the app classes stored in the app image: a resolved class
+  // of the app dex files, whose super class and interfaces are in the boot or app image.
+  bool IsAppImageClass(const mirror::Class* klass) SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
+  // Returns true if the object is stored in the app image when reachable from its roots.
+  bool IsAppImageObject(const mirror::Object* object)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
+  // Creates the app image roots: the DexCaches of dex_files, and for each a Class[] of its
+  // classes stored in the image, indexed by class def.
+  mirror::ObjectArray<mirror::Object>* CreateAppImageRoots(
+      const std::vector<const DexFile*>& dex_files)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
+  // Lays out the app image, as the objects reachable from the roots through app image objects.
+  void CalculateAppImageObjectOffsets(mirror::ObjectArray<mirror::Object>* image_roots,
+                                      base::TimingLogger& timings)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
+  // Returns what an entry of a resolved types, methods, fields or static storage array of an app
+  // DexCache holds in the app image.
+  const mirror::Object* GetAppDexCacheEntry(const mirror::DexCache* dex_cache,
+                                            const mirror::ObjectArray<mirror::Object>* array,
+                                            int32_t index) const
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
   // Creates the contiguous image in memory and adjusts pointers.
-  void CopyAndFixupObjects();
-  static void CopyAndFixupObjectsCallback(mirror::Object* obj, void* arg)
+  void CopyAndFixupObjects(ThreadPool& thread_pool, base::TimingLogger& timings)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+  void CopyAndFixupObject(const mirror::Object* obj, size_t offset)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
+  // Runs visitor(begin, end) over contiguous ranges of image_objects_ on the thread pool.
+  template <typename Visitor>
+  void ForAllImageObjectRanges(ThreadPool& thread_pool, const Visitor& visitor);
   void FixupClass(const mirror::Class* orig, mirror::Class* copy)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
   void FixupMethod(const mirror::ArtMethod* orig, mirror::ArtMethod* copy)
@@ -170,6 +254,14 @@ class ImageWriter {
                    bool is_static)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
 
+  // Records that the word at 'offset' in 'copy' holds an address into the image or oat file, so
+  // that it is adjusted when the image is loaded at another address. NULL words are skipped.
+  void RecordRelocation(const mirror::Object* copy, MemberOffset offset)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
+  // Writes the image and oat relocations after the image bitmap.
+  bool WriteRelocations(File* image_file, const ImageHeader& image_header);
+
   // Patches references in OatFile to expect runtime addresses.
   void PatchOatCodeAndMethods()
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
@@ -188,6 +280,16 @@ class ImageWriter {
   // Memory mapped for generating the image.
   UniquePtr<MemMap> image_;
 
+  // Objects which get their own slot in the image, in image order, and their image offsets.
+  std::vector<mirror::Object*> image_objects_;
+  std::vector<size_t> image_object_offsets_;
+
+  // Strings which share the slot of their interned version.
+  std::vector<std::pair<const mirror::Object*, const mirror::Object*> > string_aliases_;
+
+  // Interned strings which already have a slot in image_objects_.
+  std::set<const mirror::Object*> interned_strings_;
+
   // Offset to the free space in image_.
   size_t image_end_;
 
@@ -209,8 +311,48 @@ class ImageWriter {
   uint32_t quick_resolution_trampoline_offset_;
   uint32_t quick_to_interpreter_bridge_offset_;
 
+  // Bitmap with a bit set for each word of the image holding an address, set concurrently by the
+  // fixup of the image objects.
+  std::vector<uint32_t> image_relocations_;
+
+  // Offsets from the oat header of the words of oat code holding addresses.
+  std::vector<uint32_t> oat_relocations_;
+
   // DexCaches seen while scanning for fixing up CodeAndDirectMethods
   std::set<mirror::DexCache*> dex_caches_;
+
+  // Whether an app image is being written, on top of boot_image_space_.
+  bool app_image_;
+  const gc::space::ImageSpace* boot_image_space_;
+
+  // Checksum of the oat file of the app image.
+  uint32_t app_oat_checksum_;
+
+  // DexCaches of the dex files of the app image.
+  std::set<const mirror::Object*> app_dex_caches_;
+
+  // Resolved types, methods, fields and static storage arrays of app_dex_caches_, to their
+  // DexCache. Only some of their entries are kept in the app image.
+  SafeMap<const mirror::Object*, const mirror::DexCache*> dex_cache_arrays_;
+
+  // Classes named by dex2oat's --dirty-image-objects, or NULL.
+  const CompilerDriver::DescriptorSet* const dirty_image_classes_;
+
+  // DexCaches and their arrays, which are filled in as the runtime resolves what they cache.
+  std::set<const mirror::Object*> dirty_dex_cache_objects_;
+
+  const bool read_only_dex_caches_;
+  // With read_only_dex_caches_, the dex cache arrays the runtime maps read-only, and their range
+  // of image offsets.
+  std::set<const mirror::Object*> read_only_dex_cache_arrays_;
+  size_t read_only_begin_;
+  size_t read_only_end_;
+
+  // Whether a class is in dirty_image_classes_, worked out as needed.
+  SafeMap<const mirror::Class*, bool> dirty_image_class_cache_;
+
+  // Whether classes of the app dex files are stored in the app image, worked out as needed.
+  SafeMap<const mirror::Class*, bool> app_image_classes_;
 };
 
 }  // namespace art
@@ -46,7 +46,8 @@ class ArmManagedRuntimeCallingConvention : public ManagedRuntimeCallingConventio
 
 class ArmJniCallingConvention : public JniCallingConvention {
  public:
-  explicit ArmJniCallingConvention(bool is_static, bool is_synchronized, const char* shorty);
+  ArmJniCallingConvention(bool is_static, bool is_synchronized, bool is_critical_native,
+                          const char* shorty);
   virtual ~ArmJniCallingConvention() {}
   // Calling convention
   virtual ManagedRegister ReturnRegister();
@@ -86,15 +86,19 @@ bool ManagedRuntimeCallingConvention::IsCurrentParamAReference() {
 
 JniCallingConvention* JniCallingConvention::Create(bool is_static, bool is_synchronized,
                                                    const char* shorty,
-                                                   InstructionSet instruction_set) {
+                                                   InstructionSet instruction_set,
+                                                   bool is_critical_native) {
   switch (instruction_set) {
     case kArm:
     case kThumb2:
-      return new arm::ArmJniCallingConvention(is_static, is_synchronized, shorty);
+      return new arm::ArmJniCallingConvention(is_static, is_synchronized, is_critical_native,
+                                              shorty);
     case kMips:
-      return new mips::MipsJniCallingConvention(is_static, is_synchronized, shorty);
+      return new mips::MipsJniCallingConvention(is_static, is_synchronized, is_critical_native,
+                                                shorty);
     case kX86:
-      return new x86::X86JniCallingConvention(is_static, is_synchronized, shorty);
+      return new x86::X86JniCallingConvention(is_static, is_synchronized, is_critical_native,
+                                              shorty);
     default:
       LOG(FATAL) << "Unknown InstructionSet: " << instruction_set;
       return NULL;
@@ -102,7 +106,7 @@ JniCallingConvention* JniCallingConvention::Create(bool is_static, bool is_synch
 }
 
 size_t JniCallingConvention::ReferenceCount() const {
-  return NumReferenceArgs() + (IsStatic() ? 1 : 0);
+  return NumReferenceArgs() + (IsStatic() && !IsCriticalNative() ? 1 : 0);
 }
 
 FrameOffset JniCallingConvention::SavedLocalReferenceCookieOffset() const {
@@ -117,7 +121,7 @@ FrameOffset JniCallingConvention::ReturnValueSaveLocation() const {
 }
 
 bool JniCallingConvention::HasNext() {
-  if (itr_args_ <= kObjectOrClass) {
+  if (!IsCriticalNative() && itr_args_ <= kObjectOrClass) {
     return true;
   } else {
     unsigned int arg_pos = itr_args_ - NumberOfExtraArgumentsForJni();
@@ -127,7 +131,7 @@ bool JniCallingConvention::HasNext() {
 
 void JniCallingConvention::Next() {
   CHECK(HasNext());
-  if (itr_args_ > kObjectOrClass) {
+  if (IsCriticalNative() || itr_args_ > kObjectOrClass) {
     int arg_pos = itr_args_ - NumberOfExtraArgumentsForJni();
     if (IsParamALongOrDouble(arg_pos)) {
       itr_longs_and_doubles_++;
@@ -142,6 +146,9 @@ void JniCallingConvention::Next() {
 }
 
 bool JniCallingConvention::IsCurrentParamAReference() {
+  if (IsCriticalNative()) {
+    return IsParamAReference(itr_args_);
+  }
   switch (itr_args_) {
     case kJniEnv:
       return false;  // JNIEnv*
@@ -167,7 +174,7 @@ FrameOffset JniCallingConvention::CurrentParamSirtEntryOffset() {
 }
 
 size_t JniCallingConvention::CurrentParamSize() {
-  if (itr_args_ <= kObjectOrClass) {
+  if (!IsCriticalNative() && itr_args_ <= kObjectOrClass) {
     return kPointerSize;  // JNIEnv or jobject/jclass
   } else {
     int arg_pos = itr_args_ - NumberOfExtraArgumentsForJni();
@@ -178,6 +185,10 @@ size_t JniCallingConvention::CurrentParamSize() {
 size_t JniCallingConvention::NumberOfExtraArgumentsForJni() {
   // The first argument is the JNIEnv*.
   // Static methods have an extra argument which is the jclass.
+  // Critical native methods have neither.
+  if (IsCriticalNative()) {
+    return 0;
+  }
   return IsStatic() ? 2 : 1;
 }
 
@@ -206,10 +206,14 @@ class ManagedRuntimeCallingConvention : public CallingConvention {
 //
 // [1] We must save all callee saves here to enable any exception throws to restore
 // callee saves for frames above this one.
+//
+// The convention of a critical native method passes neither the JNIEnv* nor the jclass, only the
+// method's own arguments.
 class JniCallingConvention : public CallingConvention {
  public:
   static JniCallingConvention* Create(bool is_static, bool is_synchronized, const char* shorty,
-                                      InstructionSet instruction_set);
+                                      InstructionSet instruction_set,
+                                      bool is_critical_native = false);
 
   // Size of frame excluding space for outgoing args (its assumed Method* is
   // always at the bottom of a frame, but this doesn't work for outgoing
@@ -273,8 +277,14 @@ class JniCallingConvention : public CallingConvention {
     kObjectOrClass = 1
   };
 
-  explicit JniCallingConvention(bool is_static, bool is_synchronized, const char* shorty)
-      : CallingConvention(is_static, is_synchronized, shorty) {}
+  JniCallingConvention(bool is_static, bool is_synchronized, bool is_critical_native,
+                       const char* shorty)
+      : CallingConvention(is_static, is_synchronized, shorty),
+        is_critical_native_(is_critical_native) {}
+
+  bool IsCriticalNative() const {
+    return is_critical_native_;
+  }
 
   // Number of stack slots for outgoing arguments, above which the SIRT is
   // located
@@ -282,6 +292,9 @@ class JniCallingConvention : public CallingConvention {
 
  protected:
   size_t NumberOfExtraArgumentsForJni();
+
+ private:
+  const bool is_critical_native_;
 };
 
 }  // namespace art
@@ -51,6 +51,16 @@ static void SetNativeParameter(Assembler* jni_asm,
 // - Arguments are in the managed runtime format, either on stack or in
 //   registers, a reference to the method object is supplied as part of this
 //   convention.
+// - Methods flagged kAccFastNative, unless synchronized, are called without
+//   leaving Runnable and without a local reference segment of their own. The
+//   GC can't run while they do, so they must be short, must not block, and
+//   any local references they create outlive them in their caller's segment.
+// - Methods flagged kAccCriticalNative are static, unsynchronized and take and
+//   return only primitives. They are fast native methods that are also passed
+//   neither a JNIEnv* nor a jclass, so their arguments go straight from the
+//   managed convention to the native one and no SIRT is set up. They can't
+//   throw or call back into the runtime, and can only be reached through
+//   compiled JNI stubs.
 //
 CompiledMethod* ArtJniCompileMethodInternal(CompilerDriver& compiler,
                                             uint32_t access_flags, uint32_t method_idx,
@@ -59,6 +69,11 @@ CompiledMethod* ArtJniCompileMethodInternal(CompilerDriver& compiler,
   CHECK(is_native);
   const bool is_static = (access_flags & kAccStatic) != 0;
   const bool is_synchronized = (access_flags & kAccSynchronized) != 0;
+  const bool is_critical_native = (access_flags & kAccCriticalNative) != 0;
+  CHECK(!is_critical_native || (is_static && !is_synchronized));
+  // Critical native methods skip everything fast native methods skip.
+  const bool is_fast_native =
+      ((access_flags & kAccFastNative) != 0 && !is_synchronized) || is_critical_native;
   const char* shorty = dex_file.GetMethodShorty(dex_file.GetMethodId(method_idx));
   InstructionSet instruction_set = compiler.GetInstructionSet();
   if (instruction_set == kThumb2) {
@@ -66,7 +81,8 @@ CompiledMethod* ArtJniCompileMethodInternal(CompilerDriver& compiler,
   }
   // Calling conventions used to iterate over parameters to method
   UniquePtr<JniCallingConvention> main_jni_conv(
-      JniCallingConvention::Create(is_static, is_synchronized, shorty, instruction_set));
+      JniCallingConvention::Create(is_static, is_synchronized, shorty, instruction_set,
+                                   is_critical_native));
   bool reference_return = main_jni_conv->IsReturnAReference();
 
   UniquePtr<ManagedRuntimeCallingConvention> mr_conv(
@@ -75,12 +91,15 @@ CompiledMethod* ArtJniCompileMethodInternal(CompilerDriver& compiler,
   // Calling conventions to call into JNI method "end" possibly passing a returned reference, the
   //     method and the current thread.
   size_t jni_end_arg_count = 0;
-  if (reference_return) { jni_end_arg_count++; }
+  // Fast native methods have no cookie to pass, their reference result takes its place.
+  if (reference_return && !is_fast_native) { jni_end_arg_count++; }
   if (is_synchronized) { jni_end_arg_count++; }
   const char* jni_end_shorty = jni_end_arg_count == 0 ? "I"
                                                         : (jni_end_arg_count == 1 ? "II" : "III");
   UniquePtr<JniCallingConvention> end_jni_conv(
       JniCallingConvention::Create(is_static, is_synchronized, jni_end_shorty, instruction_set));
+  // A fast native method returning a primitive needs no call on the way out.
+  const bool call_jni_end = !is_fast_native || reference_return;
 
 
   // Assembler that holds generated instructions
@@ -98,68 +117,72 @@ CompiledMethod* ArtJniCompileMethodInternal(CompilerDriver& compiler,
   const std::vector<ManagedRegister>& callee_save_regs = main_jni_conv->CalleeSaveRegisters();
   __ BuildFrame(frame_size, mr_conv->MethodRegister(), callee_save_regs, mr_conv->EntrySpills());
 
-  // 2. Set up the StackIndirectReferenceTable
-  mr_conv->ResetIterator(FrameOffset(frame_size));
-  main_jni_conv->ResetIterator(FrameOffset(0));
-  __ StoreImmediateToFrame(main_jni_conv->SirtNumRefsOffset(),
-                           main_jni_conv->ReferenceCount(),
-                           mr_conv->InterproceduralScratchRegister());
-  __ CopyRawPtrFromThread(main_jni_conv->SirtLinkOffset(),
-                          Thread::TopSirtOffset(),
-                          mr_conv->InterproceduralScratchRegister());
-  __ StoreStackOffsetToThread(Thread::TopSirtOffset(),
-                              main_jni_conv->SirtOffset(),
-                              mr_conv->InterproceduralScratchRegister());
+  // 2-4. Critical native methods have no references to place in a SIRT and stay in managed code
+  //      as far as the runtime is concerned, so they skip straight to the out args.
+  if (!is_critical_native) {
+    // 2. Set up the StackIndirectReferenceTable
+    mr_conv->ResetIterator(FrameOffset(frame_size));
+    main_jni_conv->ResetIterator(FrameOffset(0));
+    __ StoreImmediateToFrame(main_jni_conv->SirtNumRefsOffset(),
+                             main_jni_conv->ReferenceCount(),
+                             mr_conv->InterproceduralScratchRegister());
+    __ CopyRawPtrFromThread(main_jni_conv->SirtLinkOffset(),
+                            Thread::TopSirtOffset(),
+                            mr_conv->InterproceduralScratchRegister());
+    __ StoreStackOffsetToThread(Thread::TopSirtOffset(),
+                                main_jni_conv->SirtOffset(),
+                                mr_conv->InterproceduralScratchRegister());
 
-  // 3. Place incoming reference arguments into SIRT
-  main_jni_conv->Next();  // Skip JNIEnv*
-  // 3.5. Create Class argument for static methods out of passed method
-  if (is_static) {
-    FrameOffset sirt_offset = main_jni_conv->CurrentParamSirtEntryOffset();
-    // Check sirt offset is within frame
-    CHECK_LT(sirt_offset.Uint32Value(), frame_size);
-    __ LoadRef(main_jni_conv->InterproceduralScratchRegister(),
-               mr_conv->MethodRegister(), mirror::ArtMethod::DeclaringClassOffset());
-    __ VerifyObject(main_jni_conv->InterproceduralScratchRegister(), false);
-    __ StoreRef(sirt_offset, main_jni_conv->InterproceduralScratchRegister());
-    main_jni_conv->Next();  // in SIRT so move to next argument
-  }
-  while (mr_conv->HasNext()) {
-    CHECK(main_jni_conv->HasNext());
-    bool ref_param = main_jni_conv->IsCurrentParamAReference();
-    CHECK(!ref_param || mr_conv->IsCurrentParamAReference());
-    // References need placing in SIRT and the entry value passing
-    if (ref_param) {
-      // Compute SIRT entry, note null is placed in the SIRT but its boxed value
-      // must be NULL
+    // 3. Place incoming reference arguments into SIRT
+    main_jni_conv->Next();  // Skip JNIEnv*
+    // 3.5. Create Class argument for static methods out of passed method
+    if (is_static) {
       FrameOffset sirt_offset = main_jni_conv->CurrentParamSirtEntryOffset();
-      // Check SIRT offset is within frame and doesn't run into the saved segment state
+      // Check sirt offset is within frame
       CHECK_LT(sirt_offset.Uint32Value(), frame_size);
-      CHECK_NE(sirt_offset.Uint32Value(),
-               main_jni_conv->SavedLocalReferenceCookieOffset().Uint32Value());
-      bool input_in_reg = mr_conv->IsCurrentParamInRegister();
-      bool input_on_stack = mr_conv->IsCurrentParamOnStack();
-      CHECK(input_in_reg || input_on_stack);
-
-      if (input_in_reg) {
-        ManagedRegister in_reg  =  mr_conv->CurrentParamRegister();
-        __ VerifyObject(in_reg, mr_conv->IsCurrentArgPossiblyNull());
-        __ StoreRef(sirt_offset, in_reg);
-      } else if (input_on_stack) {
-        FrameOffset in_off  = mr_conv->CurrentParamStackOffset();
-        __ VerifyObject(in_off, mr_conv->IsCurrentArgPossiblyNull());
-        __ CopyRef(sirt_offset, in_off,
-                   mr_conv->InterproceduralScratchRegister());
+      __ LoadRef(main_jni_conv->InterproceduralScratchRegister(),
+                 mr_conv->MethodRegister(), mirror::ArtMethod::DeclaringClassOffset());
+      __ VerifyObject(main_jni_conv->InterproceduralScratchRegister(), false);
+      __ StoreRef(sirt_offset, main_jni_conv->InterproceduralScratchRegister());
+      main_jni_conv->Next();  // in SIRT so move to next argument
+    }
+    while (mr_conv->HasNext()) {
+      CHECK(main_jni_conv->HasNext());
+      bool ref_param = main_jni_conv->IsCurrentParamAReference();
+      CHECK(!ref_param || mr_conv->IsCurrentParamAReference());
+      // References need placing in SIRT and the entry value passing
+      if (ref_param) {
+        // Compute SIRT entry, note null is placed in the SIRT but its boxed value
+        // must be NULL
+        FrameOffset sirt_offset = main_jni_conv->CurrentParamSirtEntryOffset();
+        // Check SIRT offset is within frame and doesn't run into the saved segment state
+        CHECK_LT(sirt_offset.Uint32Value(), frame_size);
+        CHECK_NE(sirt_offset.Uint32Value(),
+                 main_jni_conv->SavedLocalReferenceCookieOffset().Uint32Value());
+        bool input_in_reg = mr_conv->IsCurrentParamInRegister();
+        bool input_on_stack = mr_conv->IsCurrentParamOnStack();
+        CHECK(input_in_reg || input_on_stack);
+
+        if (input_in_reg) {
+          ManagedRegister in_reg  =  mr_conv->CurrentParamRegister();
+          __ VerifyObject(in_reg, mr_conv->IsCurrentArgPossiblyNull());
+          __ StoreRef(sirt_offset, in_reg);
+        } else if (input_on_stack) {
+          FrameOffset in_off  = mr_conv->CurrentParamStackOffset();
+          __ VerifyObject(in_off, mr_conv->IsCurrentArgPossiblyNull());
+          __ CopyRef(sirt_offset, in_off,
+                     mr_conv->InterproceduralScratchRegister());
+        }
       }
+      mr_conv->Next();
+      main_jni_conv->Next();
     }
-    mr_conv->Next();
-    main_jni_conv->Next();
-  }
 
-  // 4. Write out the end of the quick frames.
-  __ StoreStackPointerToThread(Thread::TopOfManagedStackOffset());
-  __ StoreImmediateToThread(Thread::TopOfManagedStackPcOffset(), 0,
-                            mr_conv->InterproceduralScratchRegister());
+    // 4. Write out the end of the quick frames.
+    __ StoreStackPointerToThread(Thread::TopOfManagedStackOffset());
+    __ StoreImmediateToThread(Thread::TopOfManagedStackPcOffset(), 0,
+                              mr_conv->InterproceduralScratchRegister());
+  }
 
   // 5. Move frame down to allow space for out going args.
   const size_t main_out_arg_size = main_jni_conv->OutArgSize();
@@ -172,41 +195,44 @@ CompiledMethod* ArtJniCompileMethodInternal(CompilerDriver& compiler,
   //    can occur. The result is the saved JNI local state that is restored by the exit call. We
   //    abuse the JNI calling convention here, that is guaranteed to support passing 2 pointer
   //    arguments.
+  //    Fast native methods stay Runnable and skip this.
   ThreadOffset jni_start = is_synchronized ? QUICK_ENTRYPOINT_OFFSET(pJniMethodStartSynchronized)
                                            : QUICK_ENTRYPOINT_OFFSET(pJniMethodStart);
   main_jni_conv->ResetIterator(FrameOffset(main_out_arg_size));
   FrameOffset locked_object_sirt_offset(0);
-  if (is_synchronized) {
-    // Pass object for locking.
-    main_jni_conv->Next();  // Skip JNIEnv.
-    locked_object_sirt_offset = main_jni_conv->CurrentParamSirtEntryOffset();
-    main_jni_conv->ResetIterator(FrameOffset(main_out_arg_size));
-    if (main_jni_conv->IsCurrentParamOnStack()) {
-      FrameOffset out_off = main_jni_conv->CurrentParamStackOffset();
-      __ CreateSirtEntry(out_off, locked_object_sirt_offset,
-                         mr_conv->InterproceduralScratchRegister(),
-                         false);
+  FrameOffset saved_cookie_offset = main_jni_conv->SavedLocalReferenceCookieOffset();
+  if (!is_fast_native) {
+    if (is_synchronized) {
+      // Pass object for locking.
+      main_jni_conv->Next();  // Skip JNIEnv.
+      locked_object_sirt_offset = main_jni_conv->CurrentParamSirtEntryOffset();
+      main_jni_conv->ResetIterator(FrameOffset(main_out_arg_size));
+      if (main_jni_conv->IsCurrentParamOnStack()) {
+        FrameOffset out_off = main_jni_conv->CurrentParamStackOffset();
+        __ CreateSirtEntry(out_off, locked_object_sirt_offset,
+                           mr_conv->InterproceduralScratchRegister(),
+                           false);
+      } else {
+        ManagedRegister out_reg = main_jni_conv->CurrentParamRegister();
+        __ CreateSirtEntry(out_reg, locked_object_sirt_offset,
+                           ManagedRegister::NoRegister(), false);
+      }
+      main_jni_conv->Next();
+    }
+    if (main_jni_conv->IsCurrentParamInRegister()) {
+      __ GetCurrentThread(main_jni_conv->CurrentParamRegister());
+      __ Call(main_jni_conv->CurrentParamRegister(), Offset(jni_start),
+              main_jni_conv->InterproceduralScratchRegister());
     } else {
-      ManagedRegister out_reg = main_jni_conv->CurrentParamRegister();
-      __ CreateSirtEntry(out_reg, locked_object_sirt_offset,
-                         ManagedRegister::NoRegister(), false);
+      __ GetCurrentThread(main_jni_conv->CurrentParamStackOffset(),
+                          main_jni_conv->InterproceduralScratchRegister());
+      __ Call(ThreadOffset(jni_start), main_jni_conv->InterproceduralScratchRegister());
     }
-    main_jni_conv->Next();
-  }
-  if (main_jni_conv->IsCurrentParamInRegister()) {
-    __ GetCurrentThread(main_jni_conv->CurrentParamRegister());
-    __ Call(main_jni_conv->CurrentParamRegister(), Offset(jni_start),
-            main_jni_conv->InterproceduralScratchRegister());
-  } else {
-    __ GetCurrentThread(main_jni_conv->CurrentParamStackOffset(),
-                        main_jni_conv->InterproceduralScratchRegister());
-    __ Call(ThreadOffset(jni_start), main_jni_conv->InterproceduralScratchRegister());
-  }
-  if (is_synchronized) {  // Check for exceptions from monitor enter.
-    __ ExceptionPoll(main_jni_conv->InterproceduralScratchRegister(), main_out_arg_size);
+    if (is_synchronized) {  // Check for exceptions from monitor enter.
+      __ ExceptionPoll(main_jni_conv->InterproceduralScratchRegister(), main_out_arg_size);
+    }
+    __ Store(saved_cookie_offset, main_jni_conv->IntReturnRegister(), 4);
   }
-  FrameOffset saved_cookie_offset = main_jni_conv->SavedLocalReferenceCookieOffset();
-  __ Store(saved_cookie_offset, main_jni_conv->IntReturnRegister(), 4);
 
   // 7. Iterate over arguments placing values from managed calling convention in
   //    to the convention required for a native call (shuffling). For references
@@ -227,9 +253,11 @@ CompiledMethod* ArtJniCompileMethodInternal(CompilerDriver& compiler,
   for (uint32_t i = 0; i < args_count; ++i) {
     mr_conv->ResetIterator(FrameOffset(frame_size + main_out_arg_size));
     main_jni_conv->ResetIterator(FrameOffset(main_out_arg_size));
-    main_jni_conv->Next();  // Skip JNIEnv*.
-    if (is_static) {
-      main_jni_conv->Next();  // Skip Class for now.
+    if (!is_critical_native) {
+      main_jni_conv->Next();  // Skip JNIEnv*.
+      if (is_static) {
+        main_jni_conv->Next();  // Skip Class for now.
+      }
     }
     // Skip to the argument we're interested in.
     for (uint32_t j = 0; j < args_count - i - 1; ++j) {
@@ -238,7 +266,7 @@ CompiledMethod* ArtJniCompileMethodInternal(CompilerDriver& compiler,
     }
     CopyParameter(jni_asm.get(), mr_conv.get(), main_jni_conv.get(), frame_size, main_out_arg_size);
   }
-  if (is_static) {
+  if (is_static && !is_critical_native) {
     // Create argument for Class
     mr_conv->ResetIterator(FrameOffset(frame_size+main_out_arg_size));
     main_jni_conv->ResetIterator(FrameOffset(main_out_arg_size));
@@ -257,16 +285,19 @@ CompiledMethod* ArtJniCompileMethodInternal(CompilerDriver& compiler,
   }
 
   // 8. Create 1st argument, the JNI environment ptr.
-  main_jni_conv->ResetIterator(FrameOffset(main_out_arg_size));
-  // Register that will hold local indirect reference table
-  if (main_jni_conv->IsCurrentParamInRegister()) {
-    ManagedRegister jni_env = main_jni_conv->CurrentParamRegister();
-    DCHECK(!jni_env.Equals(main_jni_conv->InterproceduralScratchRegister()));
-    __ LoadRawPtrFromThread(jni_env, Thread::JniEnvOffset());
-  } else {
-    FrameOffset jni_env = main_jni_conv->CurrentParamStackOffset();
-    __ CopyRawPtrFromThread(jni_env, Thread::JniEnvOffset(),
-                            main_jni_conv->InterproceduralScratchRegister());
+  //    Critical native methods don't take one.
+  if (!is_critical_native) {
+    main_jni_conv->ResetIterator(FrameOffset(main_out_arg_size));
+    // Register that will hold local indirect reference table
+    if (main_jni_conv->IsCurrentParamInRegister()) {
+      ManagedRegister jni_env = main_jni_conv->CurrentParamRegister();
+      DCHECK(!jni_env.Equals(main_jni_conv->InterproceduralScratchRegister()));
+      __ LoadRawPtrFromThread(jni_env, Thread::JniEnvOffset());
+    } else {
+      FrameOffset jni_env = main_jni_conv->CurrentParamStackOffset();
+      __ CopyRawPtrFromThread(jni_env, Thread::JniEnvOffset(),
+                              main_jni_conv->InterproceduralScratchRegister());
+    }
   }
 
   // 9. Plant call to native code associated with method.
@@ -302,7 +333,14 @@ CompiledMethod* ArtJniCompileMethodInternal(CompilerDriver& compiler,
   //     thread.
   end_jni_conv->ResetIterator(FrameOffset(end_out_arg_size));
   ThreadOffset jni_end(-1);
-  if (reference_return) {
+  if (is_fast_native) {
+    if (reference_return) {
+      // Pass result.
+      jni_end = QUICK_ENTRYPOINT_OFFSET(pJniMethodFastEndWithReference);
+      SetNativeParameter(jni_asm.get(), end_jni_conv.get(), end_jni_conv->ReturnRegister());
+      end_jni_conv->Next();
+    }
+  } else if (reference_return) {
     // Pass result.
     jni_end = is_synchronized ? QUICK_ENTRYPOINT_OFFSET(pJniMethodEndWithReferenceSynchronized)
                               : QUICK_ENTRYPOINT_OFFSET(pJniMethodEndWithReference);
@@ -312,15 +350,17 @@ CompiledMethod* ArtJniCompileMethodInternal(CompilerDriver& compiler,
     jni_end = is_synchronized ? QUICK_ENTRYPOINT_OFFSET(pJniMethodEndSynchronized)
                               : QUICK_ENTRYPOINT_OFFSET(pJniMethodEnd);
   }
-  // Pass saved local reference state.
-  if (end_jni_conv->IsCurrentParamOnStack()) {
-    FrameOffset out_off = end_jni_conv->CurrentParamStackOffset();
-    __ Copy(out_off, saved_cookie_offset, end_jni_conv->InterproceduralScratchRegister(), 4);
-  } else {
-    ManagedRegister out_reg = end_jni_conv->CurrentParamRegister();
-    __ Load(out_reg, saved_cookie_offset, 4);
+  if (!is_fast_native) {
+    // Pass saved local reference state.
+    if (end_jni_conv->IsCurrentParamOnStack()) {
+      FrameOffset out_off = end_jni_conv->CurrentParamStackOffset();
+      __ Copy(out_off, saved_cookie_offset, end_jni_conv->InterproceduralScratchRegister(), 4);
+    } else {
+      ManagedRegister out_reg = end_jni_conv->CurrentParamRegister();
+      __ Load(out_reg, saved_cookie_offset, 4);
+    }
+    end_jni_conv->Next();
   }
-  end_jni_conv->Next();
   if (is_synchronized) {
     // Pass object for unlocking.
     if (end_jni_conv->IsCurrentParamOnStack()) {
@@ -335,7 +375,14 @@ CompiledMethod* ArtJniCompileMethodInternal(CompilerDriver& compiler,
     }
     end_jni_conv->Next();
   }
-  if (end_jni_conv->IsCurrentParamInRegister()) {
+  if (!call_jni_end) {
+    // Nothing to do but pop the SIRT, if there is one.
+    if (!is_critical_native) {
+      main_jni_conv->ResetIterator(FrameOffset(max_out_arg_size));
+      __ CopyRawPtrToThread(Thread::TopSirtOffset(), main_jni_conv->SirtLinkOffset(),
+                            main_jni_conv->InterproceduralScratchRegister());
+    }
+  } else if (end_jni_conv->IsCurrentParamInRegister()) {
     __ GetCurrentThread(end_jni_conv->CurrentParamRegister());
     __ Call(end_jni_conv->CurrentParamRegister(), Offset(jni_end),
             end_jni_conv->InterproceduralScratchRegister());
@@ -353,8 +400,11 @@ CompiledMethod* ArtJniCompileMethodInternal(CompilerDriver& compiler,
   // 14. Move frame up now we're done with the out arg space.
   __ DecreaseFrameSize(max_out_arg_size);
 
-  // 15. Process pending exceptions from JNI call or monitor exit.
-  __ ExceptionPoll(main_jni_conv->InterproceduralScratchRegister(), 0);
+  // 15. Process pending exceptions from JNI call or monitor exit. Without a JNIEnv*, critical
+  //     native methods can't have raised any.
+  if (!is_critical_native) {
+    __ ExceptionPoll(main_jni_conv->InterproceduralScratchRegister(), 0);
+  }
 
   // 16. Remove activation - no need to restore callee save registers because we didn't clobber
   //     them.
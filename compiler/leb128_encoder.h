@@ -41,6 +41,19 @@ class UnsignedLeb128EncodingVector {
     } while (!done);
   }
 
+  // Appends a value in SLEB128 format, for deltas that may be negative.
+  void PushBackSigned(int32_t value) {
+    uint32_t extra_bits = static_cast<uint32_t>(value ^ (value >> 31)) >> 6;
+    uint8_t out = value & 0x7f;
+    while (extra_bits != 0u) {
+      data_.push_back(out | 0x80);
+      value >>= 7;
+      out = value & 0x7f;
+      extra_bits >>= 7;
+    }
+    data_.push_back(out);
+  }
+
   template<typename It>
   void InsertBack(It cur, It end) {
     for (; cur != end; ++cur) {
@@ -48,6 +61,11 @@ class UnsignedLeb128EncodingVector {
     }
   }
 
+  // Appends the values encoded by another vector.
+  void InsertBack(const UnsignedLeb128EncodingVector& other) {
+    data_.insert(data_.end(), other.data_.begin(), other.data_.end());
+  }
+
   const std::vector<uint8_t>& GetData() const {
     return data_;
   }
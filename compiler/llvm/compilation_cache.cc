@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "compilation_cache.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "base/logging.h"
+#include "base/stringprintf.h"
+#include "base/unix_file/fd_file.h"
+#include "os.h"
+#include "UniquePtr.h"
+
+namespace art {
+namespace llvm {
+
+// Entries start with this, followed by the size of the key, the key and the ELF object.
+static const uint32_t kEntryMagic = 0x31434c41;  // "ALC1"
+
+static uint64_t HashKey(const std::string& key) {
+  // 64-bit FNV-1a.
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (size_t i = 0; i < key.size(); ++i) {
+    hash ^= static_cast<uint8_t>(key[i]);
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+CompilationCache::CompilationCache(const std::string& directory) : directory_(directory) {
+}
+
+std::string CompilationCache::GetEntryPath(const std::string& key) const {
+  return StringPrintf("%s/%016llx.o", directory_.c_str(),
+                      static_cast<unsigned long long>(HashKey(key)));  // NOLINT(runtime/int)
+}
+
+bool CompilationCache::Lookup(const std::string& key, std::string* elf_object) {
+  std::string path(GetEntryPath(key));
+  UniquePtr<File> file(OS::OpenFileForReading(path.c_str()));
+  if (file.get() == NULL) {
+    misses_.fetch_add(1);
+    return false;
+  }
+  int64_t length = file->GetLength();
+  uint32_t header[2];
+  if (length < static_cast<int64_t>(sizeof(header) + key.size()) ||
+      !file->ReadFully(header, sizeof(header)) ||
+      header[0] != kEntryMagic || header[1] != key.size()) {
+    misses_.fetch_add(1);
+    return false;
+  }
+  std::string entry_key(key.size(), '\0');
+  if (!file->ReadFully(&entry_key[0], entry_key.size()) || entry_key != key) {
+    VLOG(compiler) << "Compilation cache entry " << path << " is for a different key";
+    misses_.fetch_add(1);
+    return false;
+  }
+  elf_object->resize(length - sizeof(header) - key.size());
+  if (elf_object->empty() || !file->ReadFully(&(*elf_object)[0], elf_object->size())) {
+    elf_object->clear();
+    misses_.fetch_add(1);
+    return false;
+  }
+  hits_.fetch_add(1);
+  return true;
+}
+
+void CompilationCache::Store(const std::string& key, const std::string& elf_object) {
+  std::string path(GetEntryPath(key));
+  std::string tmp_path(path + ".XXXXXX");
+  int fd = mkstemp(&tmp_path[0]);
+  if (fd == -1) {
+    PLOG(WARNING) << "Failed to create compilation cache entry in " << directory_;
+    return;
+  }
+  uint32_t header[2] = { kEntryMagic, static_cast<uint32_t>(key.size()) };
+  File file(fd, tmp_path);
+  if (!file.WriteFully(header, sizeof(header)) ||
+      !file.WriteFully(key.data(), key.size()) ||
+      !file.WriteFully(elf_object.data(), elf_object.size()) ||
+      file.Close() != 0 ||
+      rename(tmp_path.c_str(), path.c_str()) != 0) {
+    PLOG(WARNING) << "Failed to write compilation cache entry " << path;
+    unlink(tmp_path.c_str());
+  }
+}
+
+}  // namespace llvm
+}  // namespace art
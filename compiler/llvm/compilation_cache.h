@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ART_COMPILER_LLVM_COMPILATION_CACHE_H_
+#define ART_COMPILER_LLVM_COMPILATION_CACHE_H_
+
+#include <stdint.h>
+
+#include <string>
+
+#include "atomic_integer.h"
+#include "base/macros.h"
+
+namespace art {
+namespace llvm {
+
+// An on-disk cache of the ELF objects the portable backend compiles methods to, shared by dex2oat
+// runs. Entries are addressed by a hash of a key describing everything the compiled code depends
+// on; the whole key is stored along with the object and compared on lookup, so a hash collision
+// only costs a miss.
+//
+// Entries are written to a temporary file and renamed into place, so that concurrent compilers
+// sharing the directory never see partial entries.
+class CompilationCache {
+ public:
+  explicit CompilationCache(const std::string& directory);
+
+  // Returns true and sets elf_object if there is an entry for key.
+  bool Lookup(const std::string& key, std::string* elf_object);
+
+  // Adds an entry for key. Failures are logged and otherwise ignored, the cache is only an
+  // optimization.
+  void Store(const std::string& key, const std::string& elf_object);
+
+  const std::string& GetDirectory() const {
+    return directory_;
+  }
+
+  int32_t GetHits() const {
+    return hits_.load();
+  }
+
+  int32_t GetMisses() const {
+    return misses_.load();
+  }
+
+ private:
+  std::string GetEntryPath(const std::string& key) const;
+
+  const std::string directory_;
+  AtomicInteger hits_;
+  AtomicInteger misses_;
+
+  DISALLOW_COPY_AND_ASSIGN(CompilationCache);
+};
+
+}  // namespace llvm
+}  // namespace art
+
+#endif  // ART_COMPILER_LLVM_COMPILATION_CACHE_H_
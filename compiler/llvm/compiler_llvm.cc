@@ -16,12 +16,18 @@
 
 #include "compiler_llvm.h"
 
+#include <dlfcn.h>
+#include <sys/stat.h>
+
 #include "backend_options.h"
 #include "base/stl_util.h"
 #include "class_linker.h"
+#include "compilation_cache.h"
 #include "compiled_method.h"
 #include "driver/compiler_driver.h"
 #include "driver/dex_compilation_unit.h"
+#include "gc/heap.h"
+#include "gc/space/image_space.h"
 #include "globals.h"
 #include "ir_builder.h"
 #include "jni/portable/jni_compiler.h"
@@ -116,6 +122,68 @@ CompilerLLVM::CompilerLLVM(CompilerDriver* driver, InstructionSet insn_set)
 
 
 CompilerLLVM::~CompilerLLVM() {
+  if (compilation_cache_.get() != NULL) {
+    VLOG(compiler) << "Compilation cache " << compilation_cache_->GetDirectory() << ": "
+                   << compilation_cache_->GetHits() << " hits, "
+                   << compilation_cache_->GetMisses() << " misses";
+  }
+}
+
+
+void CompilerLLVM::SetCompilationCacheDirectory(const std::string& directory) {
+  // Code compiled by a different build of the compiler can't be reused, tell builds apart by the
+  // size and modification time of the library this code lives in.
+  Dl_info info;
+  struct stat st;
+  if (dladdr(reinterpret_cast<void*>(&makeLLVMModuleContents), &info) == 0 ||
+      info.dli_fname == NULL || stat(info.dli_fname, &st) != 0) {
+    LOG(WARNING) << "Failed to identify the compiler library, not using the compilation cache";
+    return;
+  }
+  compilation_cache_prefix_ = StringPrintf("%s %lld %lld isa=%d filter=%d\n", info.dli_fname,
+                                           static_cast<long long>(st.st_size),  // NOLINT
+                                           static_cast<long long>(st.st_mtime),  // NOLINT
+                                           insn_set_, Runtime::Current()->GetCompilerFilter());
+  gc::space::ImageSpace* image_space = Runtime::Current()->GetHeap()->GetImageSpace();
+  if (image_space != NULL) {
+    StringAppendF(&compilation_cache_prefix_, "image=%08x\n",
+                  image_space->GetImageHeader().GetOatChecksum());
+  }
+  compilation_cache_.reset(new CompilationCache(directory));
+}
+
+
+std::string CompilerLLVM::GetCompilationCacheKey(DexCompilationUnit* dex_compilation_unit,
+                                                 InvokeType invoke_type) const {
+  Runtime* runtime = Runtime::Current();
+  jobject class_loader = dex_compilation_unit->GetClassLoader();
+  if (class_loader != NULL && !runtime->UseCompileTimeClassPath()) {
+    return "";
+  }
+  std::string key(compilation_cache_prefix_);
+  // The code depends on how the classes it uses resolve, which only changes with the class path.
+  const std::vector<const DexFile*>& boot_class_path =
+      runtime->GetClassLinker()->GetBootClassPath();
+  for (size_t i = 0; i < boot_class_path.size(); ++i) {
+    StringAppendF(&key, "boot %s %08x\n", boot_class_path[i]->GetLocation().c_str(),
+                  boot_class_path[i]->GetLocationChecksum());
+  }
+  if (class_loader != NULL) {
+    const std::vector<const DexFile*>& class_path = runtime->GetCompileTimeClassPath(class_loader);
+    for (size_t i = 0; i < class_path.size(); ++i) {
+      StringAppendF(&key, "path %s %08x\n", class_path[i]->GetLocation().c_str(),
+                    class_path[i]->GetLocationChecksum());
+    }
+  }
+  const DexFile* dex_file = dex_compilation_unit->GetDexFile();
+  StringAppendF(&key, "method %s %08x %u %u %x %d\n", dex_file->GetLocation().c_str(),
+                dex_file->GetLocationChecksum(), dex_compilation_unit->GetDexMethodIndex(),
+                dex_compilation_unit->GetClassDefIndex(), dex_compilation_unit->GetAccessFlags(),
+                invoke_type);
+  const DexFile::CodeItem* code_item = dex_compilation_unit->GetCodeItem();
+  key.append(reinterpret_cast<const char*>(code_item->insns_),
+             code_item->insns_size_in_code_units_ * sizeof(code_item->insns_[0]));
+  return key;
 }
 
 
@@ -131,12 +199,36 @@ LlvmCompilationUnit* CompilerLLVM::AllocateCompilationUnit() {
 }
 
 
-CompiledMethod* CompilerLLVM::
-CompileDexMethod(DexCompilationUnit* dex_compilation_unit, InvokeType invoke_type) {
-  UniquePtr<LlvmCompilationUnit> cunit(AllocateCompilationUnit());
+CompiledMethod* CompilerLLVM::NewCompiledMethod(DexCompilationUnit* dex_compilation_unit,
+                                                const std::string& elf_object) {
+  MethodReference mref(dex_compilation_unit->GetDexFile(),
+                       dex_compilation_unit->GetDexMethodIndex());
+  return new CompiledMethod(*compiler_driver_, compiler_driver_->GetInstructionSet(),
+                            elf_object, *verifier::MethodVerifier::GetDexGcMap(mref),
+                            dex_compilation_unit->GetSymbol());
+}
 
-  cunit->SetDexCompilationUnit(dex_compilation_unit);
-  cunit->SetCompilerDriver(compiler_driver_);
+
+std::string CompilerLLVM::LookupCompilationCache(DexCompilationUnit* dex_compilation_unit,
+                                                 InvokeType invoke_type,
+                                                 CompiledMethod** compiled_method) {
+  *compiled_method = NULL;
+  if (compilation_cache_.get() == NULL || !bitcode_filename_.empty()) {
+    return "";
+  }
+  std::string cache_key(GetCompilationCacheKey(dex_compilation_unit, invoke_type));
+  std::string elf_object;
+  if (!cache_key.empty() && compilation_cache_->Lookup(cache_key, &elf_object)) {
+    *compiled_method = NewCompiledMethod(dex_compilation_unit, elf_object);
+  }
+  return cache_key;
+}
+
+
+void CompilerLLVM::AddDexMethod(LlvmCompilationUnit* cunit,
+                                DexCompilationUnit* dex_compilation_unit,
+                                InvokeType invoke_type) {
+  cunit->AddDexCompilationUnit(dex_compilation_unit);
   // TODO: consolidate ArtCompileMethods
   CompileOneMethod(*compiler_driver_,
                    kPortable,
@@ -147,15 +239,76 @@ CompileDexMethod(DexCompilationUnit* dex_compilation_unit, InvokeType invoke_typ
                    dex_compilation_unit->GetDexMethodIndex(),
                    dex_compilation_unit->GetClassLoader(),
                    *dex_compilation_unit->GetDexFile(),
-                   cunit.get());
+                   cunit);
+}
+
+
+CompiledMethod* CompilerLLVM::CompileUncachedDexMethod(DexCompilationUnit* dex_compilation_unit,
+                                                       InvokeType invoke_type,
+                                                       const std::string& cache_key) {
+  UniquePtr<LlvmCompilationUnit> cunit(AllocateCompilationUnit());
+  cunit->SetCompilerDriver(compiler_driver_);
+  AddDexMethod(cunit.get(), dex_compilation_unit, invoke_type);
 
   cunit->Materialize();
 
-  MethodReference mref(dex_compilation_unit->GetDexFile(),
-                       dex_compilation_unit->GetDexMethodIndex());
-  return new CompiledMethod(*compiler_driver_, compiler_driver_->GetInstructionSet(),
-                            cunit->GetElfObject(), *verifier::MethodVerifier::GetDexGcMap(mref),
-                            cunit->GetDexCompilationUnit()->GetSymbol());
+  if (!cache_key.empty() && !cunit->GetElfObject().empty()) {
+    compilation_cache_->Store(cache_key, cunit->GetElfObject());
+  }
+
+  return NewCompiledMethod(dex_compilation_unit, cunit->GetElfObject());
+}
+
+
+CompiledMethod* CompilerLLVM::
+CompileDexMethod(DexCompilationUnit* dex_compilation_unit, InvokeType invoke_type) {
+  CompiledMethod* compiled_method;
+  std::string cache_key(LookupCompilationCache(dex_compilation_unit, invoke_type,
+                                               &compiled_method));
+  if (compiled_method != NULL) {
+    return compiled_method;
+  }
+  return CompileUncachedDexMethod(dex_compilation_unit, invoke_type, cache_key);
+}
+
+
+void CompilerLLVM::CompileDexMethods(const std::vector<DexCompilationUnit*>& dex_compilation_units,
+                                     const std::vector<InvokeType>& invoke_types,
+                                     std::vector<CompiledMethod*>* compiled_methods) {
+  DCHECK_EQ(dex_compilation_units.size(), invoke_types.size());
+  compiled_methods->assign(dex_compilation_units.size(), NULL);
+  std::vector<std::string> cache_keys(dex_compilation_units.size());
+  std::vector<size_t> uncached;
+  for (size_t i = 0; i < dex_compilation_units.size(); ++i) {
+    cache_keys[i] = LookupCompilationCache(dex_compilation_units[i], invoke_types[i],
+                                           &(*compiled_methods)[i]);
+    if ((*compiled_methods)[i] == NULL) {
+      uncached.push_back(i);
+    }
+  }
+  if (uncached.size() <= 1) {
+    for (size_t i : uncached) {
+      (*compiled_methods)[i] = CompileUncachedDexMethod(dex_compilation_units[i], invoke_types[i],
+                                                        cache_keys[i]);
+    }
+    return;
+  }
+
+  // Share the module and the code generation passes between the methods. They all get the same
+  // ELF object, which the ELF writer links once and finds each method in by its symbol. The
+  // object isn't cached, a method taken from it alongside other copies of the same methods would
+  // define their symbols twice.
+  UniquePtr<LlvmCompilationUnit> cunit(AllocateCompilationUnit());
+  cunit->SetCompilerDriver(compiler_driver_);
+  for (size_t i : uncached) {
+    AddDexMethod(cunit.get(), dex_compilation_units[i], invoke_types[i]);
+  }
+
+  cunit->Materialize();
+
+  for (size_t i : uncached) {
+    (*compiled_methods)[i] = NewCompiledMethod(dex_compilation_units[i], cunit->GetElfObject());
+  }
 }
 
 
@@ -217,6 +370,26 @@ extern "C" art::CompiledMethod* ArtCompileMethod(art::CompilerDriver& driver,
   return result;
 }
 
+extern "C" void ArtCompileMethods(
+    art::CompilerDriver& driver,
+    const std::vector<const art::CompilerDriver::MethodCompilationItem*>& items,
+    jobject class_loader, const art::DexFile& dex_file,
+    std::vector<art::CompiledMethod*>* compiled_methods) {
+  art::ClassLinker *class_linker = art::Runtime::Current()->GetClassLinker();
+
+  std::vector<art::DexCompilationUnit*> dex_compilation_units;
+  std::vector<art::InvokeType> invoke_types;
+  for (const art::CompilerDriver::MethodCompilationItem* item : items) {
+    dex_compilation_units.push_back(new art::DexCompilationUnit(
+        NULL, class_loader, class_linker, dex_file, item->code_item,
+        item->class_def_idx, item->method_idx, item->access_flags));
+    invoke_types.push_back(item->invoke_type);
+  }
+  art::llvm::CompilerLLVM* compiler_llvm = ContextOf(driver);
+  compiler_llvm->CompileDexMethods(dex_compilation_units, invoke_types, compiled_methods);
+  art::STLDeleteElements(&dex_compilation_units);
+}
+
 extern "C" art::CompiledMethod* ArtLLVMJniCompileMethod(art::CompilerDriver& driver,
                                                         uint32_t access_flags, uint32_t method_idx,
                                                         const art::DexFile& dex_file) {
@@ -235,3 +408,8 @@ extern "C" void compilerLLVMSetBitcodeFileName(art::CompilerDriver& driver,
                                                std::string const& filename) {
   ContextOf(driver)->SetBitcodeFileName(filename);
 }
+
+extern "C" void compilerLLVMSetCompilationCacheDirectory(art::CompilerDriver& driver,
+                                                         std::string const& directory) {
+  ContextOf(driver)->SetCompilationCacheDirectory(directory);
+}
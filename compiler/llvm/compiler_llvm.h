@@ -53,6 +53,7 @@ namespace llvm {
 namespace art {
 namespace llvm {
 
+class CompilationCache;
 class LlvmCompilationUnit;
 class IRBuilder;
 
@@ -74,9 +75,19 @@ class CompilerLLVM {
     bitcode_filename_ = filename;
   }
 
+  // Reuse the code compiled for methods by earlier runs that compiled them with the same
+  // compiler, boot image and class path, keeping it in directory.
+  void SetCompilationCacheDirectory(const std::string& directory);
+
   CompiledMethod* CompileDexMethod(DexCompilationUnit* dex_compilation_unit,
                                    InvokeType invoke_type);
 
+  // Compiles the methods to a single ELF object, to save the per module setup and code
+  // generation pass overhead on small methods.
+  void CompileDexMethods(const std::vector<DexCompilationUnit*>& dex_compilation_units,
+                         const std::vector<InvokeType>& invoke_types,
+                         std::vector<CompiledMethod*>* compiled_methods);
+
   CompiledMethod* CompileGBCMethod(DexCompilationUnit* dex_compilation_unit, std::string* func);
 
   CompiledMethod* CompileNativeMethod(DexCompilationUnit* dex_compilation_unit);
@@ -84,6 +95,25 @@ class CompilerLLVM {
  private:
   LlvmCompilationUnit* AllocateCompilationUnit();
 
+  // Returns the compilation cache key for a method, or an empty string if it can't be cached.
+  std::string GetCompilationCacheKey(DexCompilationUnit* dex_compilation_unit,
+                                     InvokeType invoke_type) const;
+
+  // Sets compiled_method to the cached code for a method, or NULL. Returns the cache key, empty
+  // if the method can't be cached.
+  std::string LookupCompilationCache(DexCompilationUnit* dex_compilation_unit,
+                                     InvokeType invoke_type, CompiledMethod** compiled_method);
+
+  // Converts a method to GBC in cunit.
+  void AddDexMethod(LlvmCompilationUnit* cunit, DexCompilationUnit* dex_compilation_unit,
+                    InvokeType invoke_type);
+
+  CompiledMethod* CompileUncachedDexMethod(DexCompilationUnit* dex_compilation_unit,
+                                           InvokeType invoke_type, const std::string& cache_key);
+
+  CompiledMethod* NewCompiledMethod(DexCompilationUnit* dex_compilation_unit,
+                                    const std::string& elf_object);
+
   CompilerDriver* const compiler_driver_;
 
   const InstructionSet insn_set_;
@@ -93,6 +123,11 @@ class CompilerLLVM {
 
   std::string bitcode_filename_;
 
+  UniquePtr<CompilationCache> compilation_cache_;
+
+  // Identifies the compiler build and options in compilation cache keys.
+  std::string compilation_cache_prefix_;
+
   DISALLOW_COPY_AND_ASSIGN(CompilerLLVM);
 };
 
@@ -322,7 +322,7 @@ class GBCExpanderPass : public llvm::FunctionPass {
                                           llvm::Value* cmp_lt);
 
   llvm::Value* EmitLoadConstantClass(uint32_t dex_pc, uint32_t type_idx);
-  llvm::Value* EmitLoadStaticStorage(uint32_t dex_pc, uint32_t type_idx);
+  llvm::Value* EmitLoadStaticStorage(uint32_t dex_pc, uint32_t type_idx, bool is_initialized);
 
   llvm::Value* Expand_HLIGet(llvm::CallInst& call_inst, JType field_jty);
   void Expand_HLIPut(llvm::CallInst& call_inst, JType field_jty);
@@ -1833,18 +1833,24 @@ llvm::Value* GBCExpanderPass::EmitLoadConstantClass(uint32_t dex_pc,
 }
 
 llvm::Value* GBCExpanderPass::EmitLoadStaticStorage(uint32_t dex_pc,
-                                                    uint32_t type_idx) {
-  llvm::BasicBlock* block_load_static =
-    CreateBasicBlockWithDexPC(dex_pc, "load_static");
-
-  llvm::BasicBlock* block_cont = CreateBasicBlockWithDexPC(dex_pc, "cont");
-
+                                                    uint32_t type_idx,
+                                                    bool is_initialized) {
   // Load static storage from dex cache
   llvm::Value* storage_field_addr =
     EmitLoadDexCacheStaticStorageFieldAddr(type_idx);
 
   llvm::Value* storage_object_addr = irb_.CreateLoad(storage_field_addr, kTBAARuntimeInfo);
 
+  if (is_initialized) {
+    // The slot was filled in when the class was found initialized at compile time
+    return storage_object_addr;
+  }
+
+  llvm::BasicBlock* block_load_static =
+    CreateBasicBlockWithDexPC(dex_pc, "load_static");
+
+  llvm::BasicBlock* block_cont = CreateBasicBlockWithDexPC(dex_pc, "cont");
+
   llvm::BasicBlock* block_original = irb_.GetInsertBlock();
 
   // Test: Is the static storage of this class initialized?
@@ -1894,11 +1900,12 @@ llvm::Value* GBCExpanderPass::Expand_HLSget(llvm::CallInst& call_inst,
   int field_offset;
   int ssb_index;
   bool is_referrers_class;
+  bool is_initialized;
   bool is_volatile;
 
   bool is_fast_path = driver_->ComputeStaticFieldInfo(
     field_idx, dex_compilation_unit_, field_offset, ssb_index,
-    is_referrers_class, is_volatile, false);
+    is_referrers_class, is_initialized, is_volatile, false);
 
   llvm::Value* static_field_value;
 
@@ -1945,7 +1952,7 @@ llvm::Value* GBCExpanderPass::Expand_HLSget(llvm::CallInst& call_inst,
       // Medium path, static storage base in a different class which
       // requires checks that the other class is initialized
       DCHECK_GE(ssb_index, 0);
-      static_storage_addr = EmitLoadStaticStorage(dex_pc, ssb_index);
+      static_storage_addr = EmitLoadStaticStorage(dex_pc, ssb_index, is_initialized);
     }
 
     llvm::Value* static_field_offset_value = irb_.getPtrEquivInt(field_offset);
@@ -1978,11 +1985,12 @@ void GBCExpanderPass::Expand_HLSput(llvm::CallInst& call_inst,
   int field_offset;
   int ssb_index;
   bool is_referrers_class;
+  bool is_initialized;
   bool is_volatile;
 
   bool is_fast_path = driver_->ComputeStaticFieldInfo(
     field_idx, dex_compilation_unit_, field_offset, ssb_index,
-    is_referrers_class, is_volatile, true);
+    is_referrers_class, is_initialized, is_volatile, true);
 
   if (!is_fast_path) {
     llvm::Function* runtime_func;
@@ -2030,7 +2038,7 @@ void GBCExpanderPass::Expand_HLSput(llvm::CallInst& call_inst,
       // Medium path, static storage base in a different class which
       // requires checks that the other class is initialized
       DCHECK_GE(ssb_index, 0);
-      static_storage_addr = EmitLoadStaticStorage(dex_pc, ssb_index);
+      static_storage_addr = EmitLoadStaticStorage(dex_pc, ssb_index, is_initialized);
     }
 
     if (is_volatile) {
@@ -236,22 +236,21 @@ bool LlvmCompilationUnit::MaterializeToRawOStream(::llvm::raw_ostream& out_strea
   ::llvm::FunctionPassManager fpm(module_);
   fpm.add(new ::llvm::DataLayout(*data_layout));
 
-  if (bitcode_filename_.empty()) {
-    // If we don't need write the bitcode to file, add the AddSuspendCheckToLoopLatchPass to the
-    // regular FunctionPass.
-    fpm.add(CreateGBCExpanderPass(*llvm_info_->GetIntrinsicHelper(), *irb_.get(),
-                                  driver_, dex_compilation_unit_));
-  } else {
-    ::llvm::FunctionPassManager fpm2(module_);
-    fpm2.add(CreateGBCExpanderPass(*llvm_info_->GetIntrinsicHelper(), *irb_.get(),
-                                   driver_, dex_compilation_unit_));
-    fpm2.doInitialization();
-    for (::llvm::Module::iterator F = module_->begin(), E = module_->end();
-         F != E; ++F) {
-      fpm2.run(*F);
-    }
-    fpm2.doFinalization();
+  // Expand the GBC intrinsics of each method in the context of its own dex method. Functions of
+  // the unit that aren't dex methods, like JNI stubs, have nothing to expand.
+  for (size_t i = 0; i < dex_compilation_units_.size(); ++i) {
+    DexCompilationUnit* dex_compilation_unit = dex_compilation_units_[i];
+    ::llvm::Function* func = module_->getFunction(dex_compilation_unit->GetSymbol());
+    CHECK(func != NULL) << dex_compilation_unit->GetSymbol();
+    ::llvm::FunctionPassManager expander_fpm(module_);
+    expander_fpm.add(CreateGBCExpanderPass(*llvm_info_->GetIntrinsicHelper(), *irb_.get(),
+                                           driver_, dex_compilation_unit));
+    expander_fpm.doInitialization();
+    expander_fpm.run(*func);
+    expander_fpm.doFinalization();
+  }
 
+  if (!bitcode_filename_.empty()) {
     // Write bitcode to file
     std::string errmsg;
 
@@ -81,11 +81,14 @@ class LlvmCompilationUnit {
   void SetCompilerDriver(CompilerDriver* driver) {
     driver_ = driver;
   }
+  // Returns the method last added, which is the one being converted to GBC.
   DexCompilationUnit* GetDexCompilationUnit() {
     return dex_compilation_unit_;
   }
-  void SetDexCompilationUnit(DexCompilationUnit* dex_compilation_unit) {
+  // Adds a method to the unit, all of them are compiled to a single ELF object.
+  void AddDexCompilationUnit(DexCompilationUnit* dex_compilation_unit) {
     dex_compilation_unit_ = dex_compilation_unit;
+    dex_compilation_units_.push_back(dex_compilation_unit);
   }
 
   bool Materialize();
@@ -114,6 +117,7 @@ class LlvmCompilationUnit {
   UniquePtr<LLVMInfo> llvm_info_;
   CompilerDriver* driver_;
   DexCompilationUnit* dex_compilation_unit_;
+  std::vector<DexCompilationUnit*> dex_compilation_units_;
 
   std::string bitcode_filename_;
 
@@ -15,6 +15,7 @@
  */
 
 #include "compiler/oat_writer.h"
+#include "driver/incremental_compilation.h"
 #include "mirror/art_method-inl.h"
 #include "mirror/class-inl.h"
 #include "mirror/object_array-inl.h"
@@ -138,12 +139,63 @@ TEST_F(OatTest, WriteRead) {
                   oat_class->GetOatMethod(method_index), dex_file);
     }
   }
+
+  // Dex files opened from the oat file find their classes through the persisted class def index.
+  ASSERT_TRUE(oat_dex_file->GetClassDefIndex() != NULL);
+  UniquePtr<const DexFile> oat_dex(oat_dex_file->OpenDexFile());
+  ASSERT_TRUE(oat_dex.get() != NULL);
+  for (size_t i = 0; i < oat_dex->NumClassDefs(); i++) {
+    const DexFile::ClassDef& class_def = oat_dex->GetClassDef(i);
+    EXPECT_EQ(&class_def, oat_dex->FindClassDef(oat_dex->GetClassDescriptor(class_def)));
+  }
+}
+
+TEST_F(OatTest, IncrementalCompilation) {
+  ClassLinker* class_linker = Runtime::Current()->GetClassLinker();
+  InstructionSet insn_set = kIsTargetBuild ? kThumb2 : kX86;
+  compiler_driver_.reset(new CompilerDriver(kQuick, insn_set, false, NULL, 2, true));
+
+  ScopedObjectAccess soa(Thread::Current());
+  ScratchFile tmp;
+  OatWriter oat_writer(class_linker->GetBootClassPath(),
+                       42U,
+                       4096U,
+                       "lue.art",
+                       compiler_driver_.get());
+  ASSERT_TRUE(compiler_driver_->WriteElf(GetTestAndroidRoot(),
+                                         !kIsTargetBuild,
+                                         class_linker->GetBootClassPath(),
+                                         oat_writer,
+                                         tmp.GetFile()));
+  UniquePtr<OatFile> oat_file(OatFile::Open(tmp.GetFilename(), tmp.GetFilename(), NULL, false));
+  ASSERT_TRUE(oat_file.get() != NULL);
+
+  std::vector<const DexFile*> dex_files;
+  dex_files.push_back(java_lang_dex_file_);
+
+  // Nothing is reused once the boot image or the instruction set changed.
+  UniquePtr<IncrementalCompilation> incremental(
+      IncrementalCompilation::Create(oat_file.get(), dex_files, insn_set, 43U));
+  EXPECT_TRUE(incremental.get() == NULL);
+  incremental.reset(IncrementalCompilation::Create(oat_file.get(), dex_files,
+                                                   insn_set == kX86 ? kThumb2 : kX86, 42U));
+  EXPECT_TRUE(incremental.get() == NULL);
+
+  // Every class of an unchanged dex file is reused.
+  incremental.reset(IncrementalCompilation::Create(oat_file.get(), dex_files, insn_set, 42U));
+  ASSERT_TRUE(incremental.get() != NULL);
+  for (size_t i = 0; i < java_lang_dex_file_->NumClassDefs(); i++) {
+    UniquePtr<const OatFile::OatClass> oat_class(
+        incremental->GetReusableClass(*java_lang_dex_file_, i));
+    EXPECT_TRUE(oat_class.get() != NULL)
+        << java_lang_dex_file_->GetClassDescriptor(java_lang_dex_file_->GetClassDef(i));
+  }
 }
 
 TEST_F(OatTest, OatHeaderSizeCheck) {
   // If this test is failing and you have to update these constants,
   // it is time to update OatHeader::kOatVersion
-  EXPECT_EQ(64U, sizeof(OatHeader));
+  EXPECT_EQ(76U, sizeof(OatHeader));
   EXPECT_EQ(28U, sizeof(OatMethodOffsets));
 }
 
@@ -167,4 +219,32 @@ TEST_F(OatTest, OatHeaderIsValid) {
     ASSERT_FALSE(oat_header.IsValid());
 }
 
+TEST_F(OatTest, OatHeaderDexLocationStat) {
+    std::vector<const DexFile*> dex_files;
+    const std::string image_file_location;
+    OatHeader oat_header(kX86, &dex_files, 0, 0, image_file_location);
+    struct stat dex_location_stat;
+    memset(&dex_location_stat, 0, sizeof(dex_location_stat));
+    dex_location_stat.st_mtime = 1234;
+    dex_location_stat.st_size = 5678;
+    dex_location_stat.st_ino = 42;
+    // Nothing recorded yet.
+    EXPECT_FALSE(oat_header.MatchesDexLocationStat(dex_location_stat));
+
+    uint32_t checksum = oat_header.GetChecksum();
+    oat_header.SetDexLocationStat(dex_location_stat);
+    EXPECT_NE(checksum, oat_header.GetChecksum());
+    EXPECT_TRUE(oat_header.MatchesDexLocationStat(dex_location_stat));
+
+    struct stat changed_stat = dex_location_stat;
+    changed_stat.st_mtime++;
+    EXPECT_FALSE(oat_header.MatchesDexLocationStat(changed_stat));
+    changed_stat = dex_location_stat;
+    changed_stat.st_size++;
+    EXPECT_FALSE(oat_header.MatchesDexLocationStat(changed_stat));
+    changed_stat = dex_location_stat;
+    changed_stat.st_ino++;
+    EXPECT_FALSE(oat_header.MatchesDexLocationStat(changed_stat));
+}
+
 }  // namespace art
@@ -62,6 +62,7 @@ OatWriter::OatWriter(const std::vector<const DexFile*>& dex_files,
     size_code_size_(0),
     size_code_(0),
     size_code_alignment_(0),
+    size_compressed_code_(0),
     size_mapping_table_(0),
     size_vmap_table_(0),
     size_gc_map_(0),
@@ -70,8 +71,24 @@ OatWriter::OatWriter(const std::vector<const DexFile*>& dex_files,
     size_oat_dex_file_location_checksum_(0),
     size_oat_dex_file_offset_(0),
     size_oat_dex_file_methods_offsets_(0),
+    size_oat_dex_file_class_def_index_(0),
     size_oat_class_status_(0),
+    size_oat_class_verification_dependencies_(0),
     size_oat_class_method_offsets_(0) {
+  if (compiler->CompressesColdCode()) {
+    // Compressed code is only inflated at runtime, after the image writer has patched the code.
+    typedef std::vector<const CompilerDriver::PatchInformation*> Patches;
+    const Patches& code_to_patch = compiler->GetCodeToPatch();
+    for (size_t i = 0; i < code_to_patch.size(); i++) {
+      patched_methods_.insert(MethodReference(&code_to_patch[i]->GetDexFile(),
+                                              code_to_patch[i]->GetReferrerMethodIdx()));
+    }
+    const Patches& methods_to_patch = compiler->GetMethodsToPatch();
+    for (size_t i = 0; i < methods_to_patch.size(); i++) {
+      patched_methods_.insert(MethodReference(&methods_to_patch[i]->GetDexFile(),
+                                              methods_to_patch[i]->GetReferrerMethodIdx()));
+    }
+  }
   size_t offset = InitOatHeader();
   offset = InitOatDexFiles(offset);
   offset = InitDexFiles(offset);
@@ -161,7 +178,12 @@ size_t OatWriter::InitOatClasses(size_t offset) {
         status = mirror::Class::kStatusNotReady;
       }
 
-      OatClass* oat_class = new OatClass(offset, status, num_methods);
+      const std::vector<uint16_t>* verification_dependencies = NULL;
+      if (status == mirror::Class::kStatusRetryVerificationAtRuntime) {
+        verification_dependencies =
+            verifier::MethodVerifier::GetVerificationDependencies(class_ref);
+      }
+      OatClass* oat_class = new OatClass(offset, status, num_methods, verification_dependencies);
       oat_classes_.push_back(oat_class);
       offset += oat_class->SizeOf();
     }
@@ -207,25 +229,79 @@ size_t OatWriter::InitOatCode(size_t offset) {
   return offset;
 }
 
+OatWriter::CodeSection OatWriter::GetCodeSection(const DexFile& dex_file,
+                                                 uint32_t method_idx) const {
+  if (compiler_driver_->IsProfiledHot(dex_file, method_idx)) {
+    return kHotCode;
+  }
+  if (compiler_driver_->CompressesColdCode() &&
+      compiler_driver_->IsProfiledCold(dex_file, method_idx) &&
+      patched_methods_.find(MethodReference(&dex_file, method_idx)) == patched_methods_.end()) {
+    return kCompressedCode;
+  }
+  return kColdCode;
+}
+
+const std::vector<uint8_t>* OatWriter::CompressCode(const std::vector<uint8_t>& code_key,
+                                                    const std::vector<uint8_t>& code) {
+  // A raw deflate stream, without the zlib header and checksum that would only add to the size
+  // of every method.
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  CHECK_EQ(deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 9,
+                        Z_DEFAULT_STRATEGY), Z_OK);
+  const size_t header_size = 2 * sizeof(uint32_t);
+  std::vector<uint8_t> compressed_code(header_size + deflateBound(&stream, code.size()));
+  stream.next_in = const_cast<Bytef*>(&code[0]);
+  stream.avail_in = code.size();
+  stream.next_out = &compressed_code[header_size];
+  stream.avail_out = compressed_code.size() - header_size;
+  CHECK_EQ(deflate(&stream, Z_FINISH), Z_STREAM_END);
+  const uint32_t compressed_size = stream.total_out;
+  deflateEnd(&stream);
+  // The raw code would need its size too.
+  if (header_size + compressed_size >= sizeof(uint32_t) + code.size()) {
+    return NULL;
+  }
+  compressed_code.resize(header_size + compressed_size);
+  const uint32_t code_size = code.size();
+  memcpy(&compressed_code[0], &code_size, sizeof(code_size));
+  memcpy(&compressed_code[sizeof(code_size)], &compressed_size, sizeof(compressed_size));
+  compressed_code_.Put(&code_key, compressed_code);
+  return &compressed_code_.find(&code_key)->second;
+}
+
 size_t OatWriter::InitOatCodeDexFiles(size_t offset) {
-  size_t oat_class_index = 0;
-  for (size_t i = 0; i != dex_files_->size(); ++i) {
-    const DexFile* dex_file = (*dex_files_)[i];
-    CHECK(dex_file != NULL);
-    offset = InitOatCodeDexFile(offset, oat_class_index, *dex_file);
+  // With a profile the code of the hot methods is laid out first, so that what runs at startup
+  // is packed into as few pages as possible. Without one, everything goes in the cold pass. The
+  // compressed code, which nothing runs in place, comes last.
+  for (int pass = compiler_driver_->HasMethodProfile() ? kHotCode : kColdCode;
+       pass <= kCompressedCode; ++pass) {
+    size_t oat_class_index = 0;
+    for (size_t i = 0; i != dex_files_->size(); ++i) {
+      const DexFile* dex_file = (*dex_files_)[i];
+      CHECK(dex_file != NULL);
+      offset = InitOatCodeDexFile(offset, oat_class_index, *dex_file,
+                                  static_cast<CodeSection>(pass));
+    }
+  }
+  // The method offsets of a class are only complete once both passes are done.
+  for (OatClass* oat_class : oat_classes_) {
+    oat_class->UpdateChecksum(*oat_header_);
   }
   return offset;
 }
 
 size_t OatWriter::InitOatCodeDexFile(size_t offset,
                                      size_t& oat_class_index,
-                                     const DexFile& dex_file) {
+                                     const DexFile& dex_file,
+                                     CodeSection section) {
   for (size_t class_def_index = 0;
        class_def_index < dex_file.NumClassDefs();
        class_def_index++, oat_class_index++) {
     const DexFile::ClassDef& class_def = dex_file.GetClassDef(class_def_index);
-    offset = InitOatCodeClassDef(offset, oat_class_index, class_def_index, dex_file, class_def);
-    oat_classes_[oat_class_index]->UpdateChecksum(*oat_header_);
+    offset = InitOatCodeClassDef(offset, oat_class_index, class_def_index, dex_file, class_def,
+                                 section);
   }
   return offset;
 }
@@ -233,7 +309,8 @@ size_t OatWriter::InitOatCodeDexFile(size_t offset,
 size_t OatWriter::InitOatCodeClassDef(size_t offset,
                                       size_t oat_class_index, size_t class_def_index,
                                       const DexFile& dex_file,
-                                      const DexFile::ClassDef& class_def) {
+                                      const DexFile::ClassDef& class_def,
+                                      CodeSection section) {
   const byte* class_data = dex_file.GetClassData(class_def);
   if (class_data == NULL) {
     // empty class, such as a marker interface
@@ -253,17 +330,21 @@ size_t OatWriter::InitOatCodeClassDef(size_t offset,
   size_t class_def_method_index = 0;
   while (it.HasNextDirectMethod()) {
     bool is_native = (it.GetMemberAccessFlags() & kAccNative) != 0;
-    offset = InitOatCodeMethod(offset, oat_class_index, class_def_index, class_def_method_index,
-                               is_native, it.GetMethodInvokeType(class_def), it.GetMemberIndex(),
-                               &dex_file);
+    if (GetCodeSection(dex_file, it.GetMemberIndex()) == section) {
+      offset = InitOatCodeMethod(offset, oat_class_index, class_def_index, class_def_method_index,
+                                 is_native, it.GetMethodInvokeType(class_def),
+                                 it.GetMemberIndex(), &dex_file);
+    }
     class_def_method_index++;
     it.Next();
   }
   while (it.HasNextVirtualMethod()) {
     bool is_native = (it.GetMemberAccessFlags() & kAccNative) != 0;
-    offset = InitOatCodeMethod(offset, oat_class_index, class_def_index, class_def_method_index,
-                               is_native, it.GetMethodInvokeType(class_def), it.GetMemberIndex(),
-                               &dex_file);
+    if (GetCodeSection(dex_file, it.GetMemberIndex()) == section) {
+      offset = InitOatCodeMethod(offset, oat_class_index, class_def_index, class_def_method_index,
+                                 is_native, it.GetMethodInvokeType(class_def),
+                                 it.GetMemberIndex(), &dex_file);
+    }
     class_def_method_index++;
     it.Next();
   }
@@ -299,60 +380,88 @@ size_t OatWriter::InitOatCodeMethod(size_t offset, size_t oat_class_index,
     compiled_method->AddOatdataOffsetToCompliledCodeOffset(
         oat_method_offsets_offset + OFFSETOF_MEMBER(OatMethodOffsets, code_offset_));
 #else
-    const std::vector<uint8_t>& code = compiled_method->GetCode();
-    offset = compiled_method->AlignCode(offset);
-    DCHECK_ALIGNED(offset, kArmAlignment);
+    // Offsets are keyed by the compiler driver's arrays, whose contents may have been spilled.
+    const std::vector<uint8_t>& code_key = compiled_method->GetCode();
+    std::vector<uint8_t> code_buffer;
+    const std::vector<uint8_t>& code = compiler_driver_->GetCompiledData(code_key, &code_buffer);
     uint32_t code_size = code.size() * sizeof(code[0]);
     CHECK_NE(code_size, 0U);
-    uint32_t thumb_offset = compiled_method->CodeDelta();
-    code_offset = offset + sizeof(code_size) + thumb_offset;
 
     // Deduplicate code arrays
-    SafeMap<const std::vector<uint8_t>*, uint32_t>::iterator code_iter = code_offsets_.find(&code);
-    if (code_iter != code_offsets_.end()) {
-      code_offset = code_iter->second;
+    SafeMap<const std::vector<uint8_t>*, uint32_t>::iterator code_iter =
+        code_offsets_.find(&code_key);
+    const std::vector<uint8_t>* compressed_code = NULL;
+    if (code_iter == code_offsets_.end() &&
+        GetCodeSection(*dex_file, method_idx) == kCompressedCode) {
+      compressed_code = CompressCode(code_key, code);
+    }
+    if (compressed_code != NULL) {
+      // Deflated code is copied before it runs, only its header needs aligning.
+      offset = RoundUp(offset, sizeof(uint32_t));
+      CHECK_EQ(offset & OatMethodOffsets::kCompressedCodeFlag, 0U);
+      code_offset = offset | OatMethodOffsets::kCompressedCodeFlag;
+      code_offsets_.Put(&code_key, code_offset);
+      offset += compressed_code->size();
+      oat_header_->UpdateChecksum(&(*compressed_code)[0], compressed_code->size());
     } else {
-      code_offsets_.Put(&code, code_offset);
-      offset += sizeof(code_size);  // code size is prepended before code
-      offset += code_size;
-      oat_header_->UpdateChecksum(&code[0], code_size);
+      offset = compiled_method->AlignCode(offset);
+      DCHECK_ALIGNED(offset, kArmAlignment);
+      uint32_t thumb_offset = compiled_method->CodeDelta();
+      code_offset = offset + sizeof(code_size) + thumb_offset;
+      if (code_iter != code_offsets_.end()) {
+        code_offset = code_iter->second;
+      } else {
+        code_offsets_.Put(&code_key, code_offset);
+        offset += sizeof(code_size);  // code size is prepended before code
+        offset += code_size;
+        oat_header_->UpdateChecksum(&code[0], code_size);
+      }
     }
 #endif
     frame_size_in_bytes = compiled_method->GetFrameSizeInBytes();
     core_spill_mask = compiled_method->GetCoreSpillMask();
     fp_spill_mask = compiled_method->GetFpSpillMask();
 
-    const std::vector<uint8_t>& mapping_table = compiled_method->GetMappingTable();
+    const std::vector<uint8_t>& mapping_table_key = compiled_method->GetMappingTable();
+    std::vector<uint8_t> mapping_table_buffer;
+    const std::vector<uint8_t>& mapping_table =
+        compiler_driver_->GetCompiledData(mapping_table_key, &mapping_table_buffer);
     size_t mapping_table_size = mapping_table.size() * sizeof(mapping_table[0]);
     mapping_table_offset = (mapping_table_size == 0) ? 0 : offset;
 
     // Deduplicate mapping tables
     SafeMap<const std::vector<uint8_t>*, uint32_t>::iterator mapping_iter =
-        mapping_table_offsets_.find(&mapping_table);
+        mapping_table_offsets_.find(&mapping_table_key);
     if (mapping_iter != mapping_table_offsets_.end()) {
       mapping_table_offset = mapping_iter->second;
     } else {
-      mapping_table_offsets_.Put(&mapping_table, mapping_table_offset);
+      mapping_table_offsets_.Put(&mapping_table_key, mapping_table_offset);
       offset += mapping_table_size;
       oat_header_->UpdateChecksum(&mapping_table[0], mapping_table_size);
     }
 
-    const std::vector<uint8_t>& vmap_table = compiled_method->GetVmapTable();
+    const std::vector<uint8_t>& vmap_table_key = compiled_method->GetVmapTable();
+    std::vector<uint8_t> vmap_table_buffer;
+    const std::vector<uint8_t>& vmap_table =
+        compiler_driver_->GetCompiledData(vmap_table_key, &vmap_table_buffer);
     size_t vmap_table_size = vmap_table.size() * sizeof(vmap_table[0]);
     vmap_table_offset = (vmap_table_size == 0) ? 0 : offset;
 
     // Deduplicate vmap tables
     SafeMap<const std::vector<uint8_t>*, uint32_t>::iterator vmap_iter =
-        vmap_table_offsets_.find(&vmap_table);
+        vmap_table_offsets_.find(&vmap_table_key);
     if (vmap_iter != vmap_table_offsets_.end()) {
       vmap_table_offset = vmap_iter->second;
     } else {
-      vmap_table_offsets_.Put(&vmap_table, vmap_table_offset);
+      vmap_table_offsets_.Put(&vmap_table_key, vmap_table_offset);
       offset += vmap_table_size;
       oat_header_->UpdateChecksum(&vmap_table[0], vmap_table_size);
     }
 
-    const std::vector<uint8_t>& gc_map = compiled_method->GetGcMap();
+    const std::vector<uint8_t>& gc_map_key = compiled_method->GetGcMap();
+    std::vector<uint8_t> gc_map_buffer;
+    const std::vector<uint8_t>& gc_map =
+        compiler_driver_->GetCompiledData(gc_map_key, &gc_map_buffer);
     size_t gc_map_size = gc_map.size() * sizeof(gc_map[0]);
     gc_map_offset = (gc_map_size == 0) ? 0 : offset;
 
@@ -376,11 +485,11 @@ size_t OatWriter::InitOatCodeMethod(size_t offset, size_t oat_class_index,
 
     // Deduplicate GC maps
     SafeMap<const std::vector<uint8_t>*, uint32_t>::iterator gc_map_iter =
-        gc_map_offsets_.find(&gc_map);
+        gc_map_offsets_.find(&gc_map_key);
     if (gc_map_iter != gc_map_offsets_.end()) {
       gc_map_offset = gc_map_iter->second;
     } else {
-      gc_map_offsets_.Put(&gc_map, gc_map_offset);
+      gc_map_offsets_.Put(&gc_map_key, gc_map_offset);
       offset += gc_map_size;
       oat_header_->UpdateChecksum(&gc_map[0], gc_map_size);
     }
@@ -407,8 +516,10 @@ size_t OatWriter::InitOatCodeMethod(size_t offset, size_t oat_class_index,
     method->SetCoreSpillMask(core_spill_mask);
     method->SetFpSpillMask(fp_spill_mask);
     method->SetOatMappingTableOffset(mapping_table_offset);
-    // Don't overwrite static method trampoline
-    if (!method->IsStatic() || method->IsConstructor() ||
+    // Don't overwrite static method trampoline, nor the one compressed code needs.
+    if ((code_offset & OatMethodOffsets::kCompressedCodeFlag) != 0) {
+      method->SetEntryPointFromCompiledCode(NULL);
+    } else if (!method->IsStatic() || method->IsConstructor() ||
         method->GetDeclaringClass()->IsInitialized()) {
       method->SetOatCodeOffset(code_offset);
     } else {
@@ -483,6 +594,7 @@ bool OatWriter::Write(OutputStream& out) {
     DO_STAT(size_code_size_);
     DO_STAT(size_code_);
     DO_STAT(size_code_alignment_);
+    DO_STAT(size_compressed_code_);
     DO_STAT(size_mapping_table_);
     DO_STAT(size_vmap_table_);
     DO_STAT(size_gc_map_);
@@ -491,7 +603,9 @@ bool OatWriter::Write(OutputStream& out) {
     DO_STAT(size_oat_dex_file_location_checksum_);
     DO_STAT(size_oat_dex_file_offset_);
     DO_STAT(size_oat_dex_file_methods_offsets_);
+    DO_STAT(size_oat_dex_file_class_def_index_);
     DO_STAT(size_oat_class_status_);
+    DO_STAT(size_oat_class_verification_dependencies_);
     DO_STAT(size_oat_class_method_offsets_);
     #undef DO_STAT
 
@@ -582,14 +696,19 @@ size_t OatWriter::WriteCode(OutputStream& out, const size_t file_offset) {
 size_t OatWriter::WriteCodeDexFiles(OutputStream& out,
                                     const size_t file_offset,
                                     size_t relative_offset) {
-  size_t oat_class_index = 0;
-  for (size_t i = 0; i != oat_dex_files_.size(); ++i) {
-    const DexFile* dex_file = (*dex_files_)[i];
-    CHECK(dex_file != NULL);
-    relative_offset = WriteCodeDexFile(out, file_offset, relative_offset, oat_class_index,
-                                       *dex_file);
-    if (relative_offset == 0) {
-      return 0;
+  // Same passes as InitOatCodeDexFiles.
+  for (int pass = compiler_driver_->HasMethodProfile() ? kHotCode : kColdCode;
+       pass <= kCompressedCode; ++pass) {
+    const CodeSection section = static_cast<CodeSection>(pass);
+    size_t oat_class_index = 0;
+    for (size_t i = 0; i != oat_dex_files_.size(); ++i) {
+      const DexFile* dex_file = (*dex_files_)[i];
+      CHECK(dex_file != NULL);
+      relative_offset = WriteCodeDexFile(out, file_offset, relative_offset, oat_class_index,
+                                         *dex_file, section);
+      if (relative_offset == 0) {
+        return 0;
+      }
     }
   }
   return relative_offset;
@@ -597,12 +716,12 @@ size_t OatWriter::WriteCodeDexFiles(OutputStream& out,
 
 size_t OatWriter::WriteCodeDexFile(OutputStream& out, const size_t file_offset,
                                    size_t relative_offset, size_t& oat_class_index,
-                                   const DexFile& dex_file) {
+                                   const DexFile& dex_file, CodeSection section) {
   for (size_t class_def_index = 0; class_def_index < dex_file.NumClassDefs();
       class_def_index++, oat_class_index++) {
     const DexFile::ClassDef& class_def = dex_file.GetClassDef(class_def_index);
     relative_offset = WriteCodeClassDef(out, file_offset, relative_offset, oat_class_index,
-                                        dex_file, class_def);
+                                        dex_file, class_def, section);
     if (relative_offset == 0) {
       return 0;
     }
@@ -621,7 +740,8 @@ size_t OatWriter::WriteCodeClassDef(OutputStream& out,
                                     size_t relative_offset,
                                     size_t oat_class_index,
                                     const DexFile& dex_file,
-                                    const DexFile::ClassDef& class_def) {
+                                    const DexFile::ClassDef& class_def,
+                                    CodeSection section) {
   const byte* class_data = dex_file.GetClassData(class_def);
   if (class_data == NULL) {
     // ie. an empty class such as a marker interface
@@ -639,20 +759,25 @@ size_t OatWriter::WriteCodeClassDef(OutputStream& out,
   size_t class_def_method_index = 0;
   while (it.HasNextDirectMethod()) {
     bool is_static = (it.GetMemberAccessFlags() & kAccStatic) != 0;
-    relative_offset = WriteCodeMethod(out, file_offset, relative_offset, oat_class_index,
-                                      class_def_method_index, is_static, it.GetMemberIndex(),
-                                      dex_file);
-    if (relative_offset == 0) {
-      return 0;
+    if (GetCodeSection(dex_file, it.GetMemberIndex()) == section) {
+      relative_offset = WriteCodeMethod(out, file_offset, relative_offset, oat_class_index,
+                                        class_def_method_index, is_static, it.GetMemberIndex(),
+                                        dex_file);
+      if (relative_offset == 0) {
+        return 0;
+      }
     }
     class_def_method_index++;
     it.Next();
   }
   while (it.HasNextVirtualMethod()) {
-    relative_offset = WriteCodeMethod(out, file_offset, relative_offset, oat_class_index,
-                                      class_def_method_index, false, it.GetMemberIndex(), dex_file);
-    if (relative_offset == 0) {
-      return 0;
+    if (GetCodeSection(dex_file, it.GetMemberIndex()) == section) {
+      relative_offset = WriteCodeMethod(out, file_offset, relative_offset, oat_class_index,
+                                        class_def_method_index, false, it.GetMemberIndex(),
+                                        dex_file);
+      if (relative_offset == 0) {
+        return 0;
+      }
     }
     class_def_method_index++;
     it.Next();
@@ -673,7 +798,14 @@ size_t OatWriter::WriteCodeMethod(OutputStream& out, const size_t file_offset,
 
   if (compiled_method != NULL) {  // ie. not an abstract method
 #if !defined(ART_USE_PORTABLE_COMPILER)
-    uint32_t aligned_offset = compiled_method->AlignCode(relative_offset);
+    const std::vector<uint8_t>& code_key = compiled_method->GetCode();
+    // Only the first method with the code writes its deflated copy, the others start later.
+    const uint32_t compressed_code_offset = RoundUp(relative_offset, sizeof(uint32_t));
+    const bool write_compressed_code =
+        (compressed_code_offset | OatMethodOffsets::kCompressedCodeFlag) ==
+        method_offsets.code_offset_;
+    uint32_t aligned_offset = write_compressed_code ? compressed_code_offset
+                                                    : compiled_method->AlignCode(relative_offset);
     uint32_t aligned_code_delta = aligned_offset - relative_offset;
     if (aligned_code_delta != 0) {
       off_t new_offset = out.Seek(aligned_code_delta, kSeekCurrent);
@@ -687,42 +819,57 @@ size_t OatWriter::WriteCodeMethod(OutputStream& out, const size_t file_offset,
       relative_offset += aligned_code_delta;
       DCHECK_OFFSET();
     }
-    DCHECK_ALIGNED(relative_offset, kArmAlignment);
-    const std::vector<uint8_t>& code = compiled_method->GetCode();
-    uint32_t code_size = code.size() * sizeof(code[0]);
-    CHECK_NE(code_size, 0U);
-
-    // Deduplicate code arrays
-    size_t code_offset = relative_offset + sizeof(code_size) + compiled_method->CodeDelta();
-    SafeMap<const std::vector<uint8_t>*, uint32_t>::iterator code_iter = code_offsets_.find(&code);
-    if (code_iter != code_offsets_.end() && code_offset != method_offsets.code_offset_) {
-      DCHECK(code_iter->second == method_offsets.code_offset_)
-          << PrettyMethod(method_idx, dex_file);
-    } else {
-      DCHECK(code_offset == method_offsets.code_offset_) << PrettyMethod(method_idx, dex_file);
-      if (!out.WriteFully(&code_size, sizeof(code_size))) {
-        ReportWriteFailure("method code size", method_idx, dex_file, out);
+    if (write_compressed_code) {
+      const std::vector<uint8_t>& compressed_code = compressed_code_.find(&code_key)->second;
+      if (!out.WriteFully(&compressed_code[0], compressed_code.size())) {
+        ReportWriteFailure("compressed method code", method_idx, dex_file, out);
         return 0;
       }
-      size_code_size_ += sizeof(code_size);
-      relative_offset += sizeof(code_size);
-      DCHECK_OFFSET();
-      if (!out.WriteFully(&code[0], code_size)) {
-        ReportWriteFailure("method code", method_idx, dex_file, out);
-        return 0;
+      size_compressed_code_ += compressed_code.size();
+      relative_offset += compressed_code.size();
+    } else {
+      DCHECK_ALIGNED(relative_offset, kArmAlignment);
+      std::vector<uint8_t> code_buffer;
+      const std::vector<uint8_t>& code = compiler_driver_->GetCompiledData(code_key, &code_buffer);
+      uint32_t code_size = code.size() * sizeof(code[0]);
+      CHECK_NE(code_size, 0U);
+
+      // Deduplicate code arrays
+      size_t code_offset = relative_offset + sizeof(code_size) + compiled_method->CodeDelta();
+      SafeMap<const std::vector<uint8_t>*, uint32_t>::iterator code_iter =
+          code_offsets_.find(&code_key);
+      if (code_iter != code_offsets_.end() && code_offset != method_offsets.code_offset_) {
+        DCHECK(code_iter->second == method_offsets.code_offset_)
+            << PrettyMethod(method_idx, dex_file);
+      } else {
+        DCHECK(code_offset == method_offsets.code_offset_) << PrettyMethod(method_idx, dex_file);
+        if (!out.WriteFully(&code_size, sizeof(code_size))) {
+          ReportWriteFailure("method code size", method_idx, dex_file, out);
+          return 0;
+        }
+        size_code_size_ += sizeof(code_size);
+        relative_offset += sizeof(code_size);
+        DCHECK_OFFSET();
+        if (!out.WriteFully(&code[0], code_size)) {
+          ReportWriteFailure("method code", method_idx, dex_file, out);
+          return 0;
+        }
+        size_code_ += code_size;
+        relative_offset += code_size;
       }
-      size_code_ += code_size;
-      relative_offset += code_size;
     }
     DCHECK_OFFSET();
 #endif
 
-    const std::vector<uint8_t>& mapping_table = compiled_method->GetMappingTable();
+    const std::vector<uint8_t>& mapping_table_key = compiled_method->GetMappingTable();
+    std::vector<uint8_t> mapping_table_buffer;
+    const std::vector<uint8_t>& mapping_table =
+        compiler_driver_->GetCompiledData(mapping_table_key, &mapping_table_buffer);
     size_t mapping_table_size = mapping_table.size() * sizeof(mapping_table[0]);
 
     // Deduplicate mapping tables
     SafeMap<const std::vector<uint8_t>*, uint32_t>::iterator mapping_iter =
-        mapping_table_offsets_.find(&mapping_table);
+        mapping_table_offsets_.find(&mapping_table_key);
     if (mapping_iter != mapping_table_offsets_.end() &&
         relative_offset != method_offsets.mapping_table_offset_) {
       DCHECK((mapping_table_size == 0 && method_offsets.mapping_table_offset_ == 0)
@@ -741,12 +888,15 @@ size_t OatWriter::WriteCodeMethod(OutputStream& out, const size_t file_offset,
     }
     DCHECK_OFFSET();
 
-    const std::vector<uint8_t>& vmap_table = compiled_method->GetVmapTable();
+    const std::vector<uint8_t>& vmap_table_key = compiled_method->GetVmapTable();
+    std::vector<uint8_t> vmap_table_buffer;
+    const std::vector<uint8_t>& vmap_table =
+        compiler_driver_->GetCompiledData(vmap_table_key, &vmap_table_buffer);
     size_t vmap_table_size = vmap_table.size() * sizeof(vmap_table[0]);
 
     // Deduplicate vmap tables
     SafeMap<const std::vector<uint8_t>*, uint32_t>::iterator vmap_iter =
-        vmap_table_offsets_.find(&vmap_table);
+        vmap_table_offsets_.find(&vmap_table_key);
     if (vmap_iter != vmap_table_offsets_.end() &&
         relative_offset != method_offsets.vmap_table_offset_) {
       DCHECK((vmap_table_size == 0 && method_offsets.vmap_table_offset_ == 0)
@@ -765,12 +915,15 @@ size_t OatWriter::WriteCodeMethod(OutputStream& out, const size_t file_offset,
     }
     DCHECK_OFFSET();
 
-    const std::vector<uint8_t>& gc_map = compiled_method->GetGcMap();
+    const std::vector<uint8_t>& gc_map_key = compiled_method->GetGcMap();
+    std::vector<uint8_t> gc_map_buffer;
+    const std::vector<uint8_t>& gc_map =
+        compiler_driver_->GetCompiledData(gc_map_key, &gc_map_buffer);
     size_t gc_map_size = gc_map.size() * sizeof(gc_map[0]);
 
     // Deduplicate GC maps
     SafeMap<const std::vector<uint8_t>*, uint32_t>::iterator gc_map_iter =
-        gc_map_offsets_.find(&gc_map);
+        gc_map_offsets_.find(&gc_map_key);
     if (gc_map_iter != gc_map_offsets_.end() &&
         relative_offset != method_offsets.gc_map_offset_) {
       DCHECK((gc_map_size == 0 && method_offsets.gc_map_offset_ == 0)
@@ -801,6 +954,7 @@ OatWriter::OatDexFile::OatDexFile(size_t offset, const DexFile& dex_file) {
   dex_file_location_checksum_ = dex_file.GetLocationChecksum();
   dex_file_offset_ = 0;
   methods_offsets_.resize(dex_file.NumClassDefs());
+  dex_file.BuildClassDefIndex(&class_def_index_);
 }
 
 size_t OatWriter::OatDexFile::SizeOf() const {
@@ -808,7 +962,8 @@ size_t OatWriter::OatDexFile::SizeOf() const {
           + dex_file_location_size_
           + sizeof(dex_file_location_checksum_)
           + sizeof(dex_file_offset_)
-          + (sizeof(methods_offsets_[0]) * methods_offsets_.size());
+          + (sizeof(methods_offsets_[0]) * methods_offsets_.size())
+          + (sizeof(class_def_index_[0]) * class_def_index_.size());
 }
 
 void OatWriter::OatDexFile::UpdateChecksum(OatHeader& oat_header) const {
@@ -818,6 +973,8 @@ void OatWriter::OatDexFile::UpdateChecksum(OatHeader& oat_header) const {
   oat_header.UpdateChecksum(&dex_file_offset_, sizeof(dex_file_offset_));
   oat_header.UpdateChecksum(&methods_offsets_[0],
                             sizeof(methods_offsets_[0]) * methods_offsets_.size());
+  oat_header.UpdateChecksum(&class_def_index_[0],
+                            sizeof(class_def_index_[0]) * class_def_index_.size());
 }
 
 bool OatWriter::OatDexFile::Write(OatWriter* oat_writer,
@@ -851,12 +1008,27 @@ bool OatWriter::OatDexFile::Write(OatWriter* oat_writer,
   }
   oat_writer->size_oat_dex_file_methods_offsets_ +=
       sizeof(methods_offsets_[0]) * methods_offsets_.size();
+  if (!out.WriteFully(&class_def_index_[0],
+                      sizeof(class_def_index_[0]) * class_def_index_.size())) {
+    PLOG(ERROR) << "Failed to write class def index to " << out.GetLocation();
+    return false;
+  }
+  oat_writer->size_oat_dex_file_class_def_index_ +=
+      sizeof(class_def_index_[0]) * class_def_index_.size();
   return true;
 }
 
-OatWriter::OatClass::OatClass(size_t offset, mirror::Class::Status status, uint32_t methods_count) {
+OatWriter::OatClass::OatClass(size_t offset, mirror::Class::Status status, uint32_t methods_count,
+                              const std::vector<uint16_t>* verification_dependencies) {
   offset_ = offset;
   status_ = status;
+  num_verification_dependencies_ = 0;
+  if (verification_dependencies != NULL) {
+    DCHECK_EQ(status, mirror::Class::kStatusRetryVerificationAtRuntime);
+    num_verification_dependencies_ = verification_dependencies->size();
+    verification_dependencies_ = *verification_dependencies;
+    verification_dependencies_.resize(RoundUp(num_verification_dependencies_, 2), 0);
+  }
   method_offsets_.resize(methods_count);
 }
 
@@ -867,7 +1039,13 @@ size_t OatWriter::OatClass::GetOatMethodOffsetsOffsetFromOatHeader(
 
 size_t OatWriter::OatClass::GetOatMethodOffsetsOffsetFromOatClass(
     size_t class_def_method_index_) const {
+  size_t verification_dependencies_size = 0;
+  if (status_ == mirror::Class::kStatusRetryVerificationAtRuntime) {
+    verification_dependencies_size = sizeof(num_verification_dependencies_)
+        + (sizeof(verification_dependencies_[0]) * verification_dependencies_.size());
+  }
   return sizeof(status_)
+          + verification_dependencies_size
           + (sizeof(method_offsets_[0]) * class_def_method_index_);
 }
 
@@ -877,6 +1055,15 @@ size_t OatWriter::OatClass::SizeOf() const {
 
 void OatWriter::OatClass::UpdateChecksum(OatHeader& oat_header) const {
   oat_header.UpdateChecksum(&status_, sizeof(status_));
+  if (status_ == mirror::Class::kStatusRetryVerificationAtRuntime) {
+    oat_header.UpdateChecksum(&num_verification_dependencies_,
+                              sizeof(num_verification_dependencies_));
+    if (!verification_dependencies_.empty()) {
+      oat_header.UpdateChecksum(&verification_dependencies_[0],
+                                sizeof(verification_dependencies_[0]) *
+                                    verification_dependencies_.size());
+    }
+  }
   oat_header.UpdateChecksum(&method_offsets_[0],
                             sizeof(method_offsets_[0]) * method_offsets_.size());
 }
@@ -890,6 +1077,22 @@ bool OatWriter::OatClass::Write(OatWriter* oat_writer,
     return false;
   }
   oat_writer->size_oat_class_status_ += sizeof(status_);
+  if (status_ == mirror::Class::kStatusRetryVerificationAtRuntime) {
+    if (!out.WriteFully(&num_verification_dependencies_,
+                        sizeof(num_verification_dependencies_))) {
+      PLOG(ERROR) << "Failed to write verification dependency count to " << out.GetLocation();
+      return false;
+    }
+    const size_t dependencies_size =
+        sizeof(verification_dependencies_[0]) * verification_dependencies_.size();
+    if (dependencies_size != 0 &&
+        !out.WriteFully(&verification_dependencies_[0], dependencies_size)) {
+      PLOG(ERROR) << "Failed to write verification dependencies to " << out.GetLocation();
+      return false;
+    }
+    oat_writer->size_oat_class_verification_dependencies_ +=
+        sizeof(num_verification_dependencies_) + dependencies_size;
+  }
   DCHECK_EQ(static_cast<off_t>(file_offset + GetOatMethodOffsetsOffsetFromOatHeader(0)),
             out.Seek(0, kSeekCurrent));
   if (!out.WriteFully(&method_offsets_[0],
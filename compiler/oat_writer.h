@@ -20,6 +20,7 @@
 #include <stdint.h>
 
 #include <cstddef>
+#include <set>
 
 #include "driver/compiler_driver.h"
 #include "mem_map.h"
@@ -34,7 +35,8 @@ class OutputStream;
 
 // OatHeader         variable length with count of D OatDexFiles
 //
-// OatDexFile[0]     one variable sized OatDexFile with offsets to Dex and OatClasses
+// OatDexFile[0]     one variable sized OatDexFile with offsets to Dex and OatClasses and a
+//                   descriptor hash table for finding ClassDefs
 // OatDexFile[1]
 // ...
 // OatDexFile[D]
@@ -45,18 +47,21 @@ class OutputStream;
 // Dex[D]
 //
 // OatClass[0]       one variable sized OatClass for each of C DexFile::ClassDefs
-// OatClass[1]       contains OatClass entries with class status, offsets to code, etc.
+// OatClass[1]       contains OatClass entries with class status, verification dependencies for
+//                   classes to verify again at runtime, offsets to code, etc.
 // ...
 // OatClass[C]
 //
 // padding           if necessary so that the following code will be page aligned
 //
-// CompiledMethod    one variable sized blob with the contents of each CompiledMethod
-// CompiledMethod
-// CompiledMethod
-// CompiledMethod
+// CompiledMethod    one variable sized blob with the contents of each CompiledMethod, hot
+// CompiledMethod    methods first when compiling with a profile
 // CompiledMethod
+// ...
 // CompiledMethod
+//
+// CompiledMethod    with --compress-cold-code, the methods the profile finds cold, their code
+// CompiledMethod    deflated, see OatMethodOffsets::kCompressedCodeFlag
 // ...
 // CompiledMethod
 //
@@ -72,6 +77,10 @@ class OatWriter {
     return *oat_header_;
   }
 
+  void SetDexLocationStat(const struct stat& dex_location_stat) {
+    oat_header_->SetDexLocationStat(dex_location_stat);
+  }
+
   size_t GetSize() const {
     return size_;
   }
@@ -89,14 +98,27 @@ class OatWriter {
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
   size_t InitOatCodeDexFiles(size_t offset)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+  // Methods are laid out in a pass per section, the passes only lay out the methods of their
+  // section.
+  enum CodeSection {
+    kHotCode,         // Methods the profile finds hot.
+    kColdCode,        // All the others, unless they go in the compressed section.
+    kCompressedCode,  // Methods the profile finds cold, with --compress-cold-code.
+  };
+  CodeSection GetCodeSection(const DexFile& dex_file, uint32_t method_idx) const;
+  // Returns the deflated code with its header, or NULL if deflating doesn't make it smaller.
+  const std::vector<uint8_t>* CompressCode(const std::vector<uint8_t>& code_key,
+                                           const std::vector<uint8_t>& code);
   size_t InitOatCodeDexFile(size_t offset,
                             size_t& oat_class_index,
-                            const DexFile& dex_file)
+                            const DexFile& dex_file,
+                            CodeSection section)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
   size_t InitOatCodeClassDef(size_t offset,
                              size_t oat_class_index, size_t class_def_index,
                              const DexFile& dex_file,
-                             const DexFile::ClassDef& class_def)
+                             const DexFile::ClassDef& class_def,
+                             CodeSection section)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
   size_t InitOatCodeMethod(size_t offset, size_t oat_class_index, size_t class_def_index,
                            size_t class_def_method_index, bool is_native, InvokeType type,
@@ -107,10 +129,11 @@ class OatWriter {
   size_t WriteCode(OutputStream& out, const size_t file_offset);
   size_t WriteCodeDexFiles(OutputStream& out, const size_t file_offset, size_t relative_offset);
   size_t WriteCodeDexFile(OutputStream& out, const size_t file_offset, size_t relative_offset,
-                          size_t& oat_class_index, const DexFile& dex_file);
+                          size_t& oat_class_index, const DexFile& dex_file,
+                          CodeSection section);
   size_t WriteCodeClassDef(OutputStream& out, const size_t file_offset, size_t relative_offset,
                            size_t oat_class_index, const DexFile& dex_file,
-                           const DexFile::ClassDef& class_def);
+                           const DexFile::ClassDef& class_def, CodeSection section);
   size_t WriteCodeMethod(OutputStream& out, const size_t file_offset, size_t relative_offset,
                          size_t oat_class_index, size_t class_def_method_index, bool is_static,
                          uint32_t method_idx, const DexFile& dex_file);
@@ -135,6 +158,8 @@ class OatWriter {
     uint32_t dex_file_location_checksum_;
     uint32_t dex_file_offset_;
     std::vector<uint32_t> methods_offsets_;
+    // See DexFile::BuildClassDefIndex.
+    std::vector<uint32_t> class_def_index_;
 
    private:
     DISALLOW_COPY_AND_ASSIGN(OatDexFile);
@@ -142,7 +167,8 @@ class OatWriter {
 
   class OatClass {
    public:
-    explicit OatClass(size_t offset, mirror::Class::Status status, uint32_t methods_count);
+    explicit OatClass(size_t offset, mirror::Class::Status status, uint32_t methods_count,
+                      const std::vector<uint16_t>* verification_dependencies);
     size_t GetOatMethodOffsetsOffsetFromOatHeader(size_t class_def_method_index_) const;
     size_t GetOatMethodOffsetsOffsetFromOatClass(size_t class_def_method_index_) const;
     size_t SizeOf() const;
@@ -158,6 +184,10 @@ class OatWriter {
 
     // data to write
     mirror::Class::Status status_;
+    // Only written for classes to verify again at runtime, zero for those without a record. The
+    // type indices are padded to a multiple of four bytes.
+    uint32_t num_verification_dependencies_;
+    std::vector<uint16_t> verification_dependencies_;
     std::vector<OatMethodOffsets> method_offsets_;
 
    private:
@@ -206,6 +236,7 @@ class OatWriter {
   uint32_t size_code_size_;
   uint32_t size_code_;
   uint32_t size_code_alignment_;
+  uint32_t size_compressed_code_;
   uint32_t size_mapping_table_;
   uint32_t size_vmap_table_;
   uint32_t size_gc_map_;
@@ -214,7 +245,9 @@ class OatWriter {
   uint32_t size_oat_dex_file_location_checksum_;
   uint32_t size_oat_dex_file_offset_;
   uint32_t size_oat_dex_file_methods_offsets_;
+  uint32_t size_oat_dex_file_class_def_index_;
   uint32_t size_oat_class_status_;
+  uint32_t size_oat_class_verification_dependencies_;
   uint32_t size_oat_class_method_offsets_;
 
   // Code mappings for deduplication. Deduplication is already done on a pointer basis by the
@@ -224,6 +257,12 @@ class OatWriter {
   SafeMap<const std::vector<uint8_t>*, uint32_t> mapping_table_offsets_;
   SafeMap<const std::vector<uint8_t>*, uint32_t> gc_map_offsets_;
 
+  // Deflated code with its header, by the code it was deflated from.
+  SafeMap<const std::vector<uint8_t>*, std::vector<uint8_t> > compressed_code_;
+
+  // Methods whose code the image writer patches, which can't be compressed.
+  std::set<MethodReference, MethodReferenceComparator> patched_methods_;
+
   DISALLOW_COPY_AND_ASSIGN(OatWriter);
 };
 
@@ -18,6 +18,7 @@
 #define ART_COMPILER_OUTPUT_STREAM_H_
 
 #include <stdint.h>
+#include <sys/uio.h>
 
 #include <string>
 
@@ -43,6 +44,17 @@ class OutputStream {
 
   virtual bool WriteFully(const void* buffer, int64_t byte_count) = 0;
 
+  // Writes the buffers one after the other. Streams backed by a file do it with as few system
+  // calls as they can, without first copying the buffers together.
+  virtual bool WriteFullyGathered(const struct iovec* iov, int iov_count) {
+    for (int i = 0; i < iov_count; ++i) {
+      if (!WriteFully(iov[i].iov_base, iov[i].iov_len)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
   virtual off_t Seek(off_t offset, Whence whence) = 0;
 
  private:
@@ -86,6 +86,37 @@ TEST_F(OutputStreamTest, Buffered) {
   CheckTestOutput(actual);
 }
 
+TEST_F(OutputStreamTest, BufferedPaddingAndLargeWrites) {
+  // Padding that is buffered, writes larger than the buffer that are gathered with what is
+  // buffered and a seek far enough to leave a hole should all write what a vector gets.
+  std::vector<uint8_t> large(3 * MB / 2);
+  for (size_t i = 0; i < large.size(); ++i) {
+    large[i] = i * 7;
+  }
+  uint8_t small[] = { 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+  std::vector<uint8_t> expected;
+  VectorOutputStream vector_output_stream("test vector output", expected);
+  ScratchFile tmp;
+  BufferedOutputStream buffered_output_stream(new FileOutputStream(tmp.GetFile()));
+  OutputStream* streams[] = { &vector_output_stream, &buffered_output_stream };
+  for (size_t i = 0; i < arraysize(streams); ++i) {
+    EXPECT_TRUE(streams[i]->WriteFully(small, sizeof(small)));
+    EXPECT_EQ(12, streams[i]->Seek(3, kSeekCurrent));
+    EXPECT_TRUE(streams[i]->WriteFully(&large[0], large.size()));
+    EXPECT_TRUE(streams[i]->WriteFully(small, sizeof(small)));
+    off_t end = 12 + large.size() + sizeof(small) + 3 * kPageSize;
+    EXPECT_EQ(end, streams[i]->Seek(3 * kPageSize, kSeekCurrent));
+    EXPECT_TRUE(streams[i]->WriteFully(small, 1));
+    EXPECT_EQ(end + 1, streams[i]->Seek(0, kSeekCurrent));
+  }
+  UniquePtr<File> in(OS::OpenFileForReading(tmp.GetFilename().c_str()));
+  EXPECT_TRUE(in.get() != NULL);
+  std::vector<uint8_t> actual(in->GetLength());
+  EXPECT_TRUE(in->ReadFully(&actual[0], actual.size()));
+  ASSERT_EQ(expected.size(), actual.size());
+  EXPECT_EQ(0, memcmp(&expected[0], &actual[0], actual.size()));
+}
+
 TEST_F(OutputStreamTest, Vector) {
   std::vector<uint8_t> output;
   VectorOutputStream output_stream("test vector output", output);
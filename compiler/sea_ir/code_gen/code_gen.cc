@@ -27,6 +27,9 @@
 namespace sea_ir {
 
 void CodeGenPrepassVisitor::Visit(PhiInstructionNode* phi) {
+  if (MaterializeOptimizedValue(phi)) {
+    return;
+  }
   Region* r = phi->GetRegion();
   const std::vector<Region*>* predecessors = r->GetPredecessors();
   DCHECK(NULL != predecessors);
@@ -36,7 +39,26 @@ void CodeGenPrepassVisitor::Visit(PhiInstructionNode* phi) {
   llvm_data_->AddValue(phi, llvm_phi);
 }
 
+bool CodeGenPassVisitor::MaterializeOptimizedValue(InstructionNode* instruction) {
+  int32_t value;
+  if (value_optimizer_->GetConstant(instruction, &value)) {
+    llvm_data_->AddValue(instruction,
+        llvm::ConstantInt::get(*llvm_data_->context_, llvm::APInt(32, value, true)));
+    return true;
+  }
+  if (value_optimizer_->IsDead(instruction)) {
+    return true;
+  }
+  InstructionNode* leader = value_optimizer_->GetLeader(instruction);
+  if (leader != instruction) {
+    llvm_data_->AddValue(instruction, llvm_data_->GetValue(leader));
+    return true;
+  }
+  return false;
+}
+
 void CodeGenPassVisitor::Initialize(SeaGraph* graph) {
+  value_optimizer_ = graph->GetValueOptimizer();
   Region* root_region;
   ordered_regions_.clear();
   for (std::vector<Region*>::const_iterator cit = graph->GetRegions()->begin();
@@ -121,28 +143,26 @@ void CodeGenVisitor::Visit(InstructionNode* instruction) {
 }
 
 void CodeGenVisitor::Visit(UnnamedConstInstructionNode* instruction) {
-  std::string instr = instruction->GetInstruction()->DumpString(NULL);
-  std::cout << "1.Instruction: " << instr << std::endl;
-  llvm_data_->AddValue(instruction,
-      llvm::ConstantInt::get(*llvm_data_->context_, llvm::APInt(32, instruction->GetConstValue())));
+  VLOG(compiler) << "Generating code for " << instruction->GetInstruction()->DumpString(NULL);
+  // Constant propagation knows the value of all constants.
+  bool materialized = MaterializeOptimizedValue(instruction);
+  DCHECK(materialized);
 }
 
 void CodeGenVisitor::Visit(ConstInstructionNode* instruction) {
-  std::string instr = instruction->GetInstruction()->DumpString(NULL);
-  std::cout << "1.Instruction: " << instr << std::endl;
-  llvm_data_->AddValue(instruction,
-      llvm::ConstantInt::get(*llvm_data_->context_, llvm::APInt(32, instruction->GetConstValue())));
+  VLOG(compiler) << "Generating code for " << instruction->GetInstruction()->DumpString(NULL);
+  // Constant propagation knows the value of all constants.
+  bool materialized = MaterializeOptimizedValue(instruction);
+  DCHECK(materialized);
 }
 void CodeGenVisitor::Visit(ReturnInstructionNode* instruction) {
-  std::string instr = instruction->GetInstruction()->DumpString(NULL);
-  std::cout << "2.Instruction: " << instr << std::endl;
+  VLOG(compiler) << "Generating code for " << instruction->GetInstruction()->DumpString(NULL);
   DCHECK_GT(instruction->GetSSAProducers().size(), 0u);
   llvm::Value* return_value = llvm_data_->GetValue(instruction->GetSSAProducers().at(0));
   llvm_data_->builder_.CreateRet(return_value);
 }
 void CodeGenVisitor::Visit(IfNeInstructionNode* instruction) {
-  std::string instr = instruction->GetInstruction()->DumpString(NULL);
-  std::cout << "3.Instruction: " << instr << std::endl;
+  VLOG(compiler) << "Generating code for " << instruction->GetInstruction()->DumpString(NULL);
   std::vector<InstructionNode*> ssa_uses = instruction->GetSSAProducers();
   DCHECK_GT(ssa_uses.size(), 1u);
   InstructionNode* use_l = ssa_uses.at(0);
@@ -174,26 +194,14 @@ void CodeGenVisitor::Visit(AddIntLitInstructionNode* instruction) {
 }
 */
 void CodeGenVisitor::Visit(MoveResultInstructionNode* instruction) {
-  std::string instr = instruction->GetInstruction()->DumpString(NULL);
-  std::cout << "5.Instruction: " << instr << std::endl;
-  // TODO: Currently, this "mov" instruction is simulated by "res = return_register + 0".
-  // This is inefficient, but should be optimized out by the coalescing phase of the reg alloc.
-  // The TODO is to either ensure that this happens, or to
-  // remove the move-result instructions completely from the IR
-  // by merging them with the invoke-* instructions,
-  // since their purpose of minimizing the number of opcodes in dex is
-  // not relevant for the IR. (Will need to have different
-  // instruction subclasses for functions and procedures.)
-  std::vector<InstructionNode*> ssa_uses = instruction->GetSSAProducers();
-  InstructionNode* use_l = ssa_uses.at(0);
-  llvm::Value* left = llvm_data_->GetValue(use_l);
-  llvm::Value* right = llvm::ConstantInt::get(*llvm_data_->context_, llvm::APInt(32, 0));
-  llvm::Value* result = llvm_data_->builder_.CreateAdd(left, right);
-  llvm_data_->AddValue(instruction, result);
+  VLOG(compiler) << "Generating code for " << instruction->GetInstruction()->DumpString(NULL);
+  // Value numbering makes move-result instructions reuse the value of their invoke-*
+  // instruction, so no code is ever needed for them.
+  bool materialized = MaterializeOptimizedValue(instruction);
+  DCHECK(materialized);
 }
 void CodeGenVisitor::Visit(InvokeStaticInstructionNode* invoke) {
-  std::string instr = invoke->GetInstruction()->DumpString(NULL);
-  std::cout << "6.Instruction: " << instr << std::endl;
+  VLOG(compiler) << "Generating code for " << invoke->GetInstruction()->DumpString(NULL);
   // TODO: Build callee LLVM function name.
   std::string symbol = "dex_";
   symbol += art::MangleForJni(PrettyMethod(invoke->GetCalledMethodIndex(), dex_file_));
@@ -216,8 +224,10 @@ void CodeGenVisitor::Visit(InvokeStaticInstructionNode* invoke) {
   llvm_data_->AddValue(invoke, return_value);
 }
 void CodeGenVisitor::Visit(AddIntInstructionNode* instruction) {
-  std::string instr = instruction->GetInstruction()->DumpString(NULL);
-  std::cout << "7.Instruction: " << instr << std::endl;
+  VLOG(compiler) << "Generating code for " << instruction->GetInstruction()->DumpString(NULL);
+  if (MaterializeOptimizedValue(instruction)) {
+    return;
+  }
   std::vector<InstructionNode*> ssa_uses = instruction->GetSSAProducers();
   DCHECK_GT(ssa_uses.size(), 1u);
   InstructionNode* use_l = ssa_uses.at(0);
@@ -228,16 +238,14 @@ void CodeGenVisitor::Visit(AddIntInstructionNode* instruction) {
   llvm_data_->AddValue(instruction, result);
 }
 void CodeGenVisitor::Visit(GotoInstructionNode* instruction) {
-  std::string instr = instruction->GetInstruction()->DumpString(NULL);
-  std::cout << "8.Instruction: " << instr << std::endl;
+  VLOG(compiler) << "Generating code for " << instruction->GetInstruction()->DumpString(NULL);
   std::vector<sea_ir::Region*>* targets = instruction->GetRegion()->GetSuccessors();
   DCHECK_EQ(targets->size(), 1u);
   llvm::BasicBlock* target_block = llvm_data_->GetBlock(targets->at(0));
   llvm_data_->builder_.CreateBr(target_block);
 }
 void CodeGenVisitor::Visit(IfEqzInstructionNode* instruction) {
-  std::string instr = instruction->GetInstruction()->DumpString(NULL);
-  std::cout << "9. Instruction: " << instr << "; Id: " <<instruction << std::endl;
+  VLOG(compiler) << "Generating code for " << instruction->GetInstruction()->DumpString(NULL);
   std::vector<InstructionNode*> ssa_uses = instruction->GetSSAProducers();
   DCHECK_GT(ssa_uses.size(), 0u);
   InstructionNode* use_l = ssa_uses.at(0);
@@ -254,7 +262,12 @@ void CodeGenVisitor::Visit(IfEqzInstructionNode* instruction) {
 }
 
 void CodeGenPostpassVisitor::Visit(PhiInstructionNode* phi) {
-  std::cout << "10. Instruction: Phi(" << phi->GetRegisterNumber() << ")" << std::endl;
+  VLOG(compiler) << "Generating code for phi of v" << phi->GetRegisterNumber();
+  int32_t value;
+  if (value_optimizer_->GetConstant(phi, &value) || value_optimizer_->IsDead(phi)) {
+    // The prepass did not create an LLVM phi.
+    return;
+  }
   Region* r = phi->GetRegion();
   const std::vector<Region*>* predecessors = r->GetPredecessors();
   DCHECK(NULL != predecessors);
@@ -83,8 +83,8 @@ class CodeGenData {
 
 class CodeGenPassVisitor: public IRVisitor {
  public:
-  explicit CodeGenPassVisitor(CodeGenData* cgd): llvm_data_(cgd) { }
-  CodeGenPassVisitor(): llvm_data_(new CodeGenData()) { }
+  explicit CodeGenPassVisitor(CodeGenData* cgd): llvm_data_(cgd), value_optimizer_(NULL) { }
+  CodeGenPassVisitor(): llvm_data_(new CodeGenData()), value_optimizer_(NULL) { }
   // Initialize any data structure needed before the start of visiting.
   virtual void Initialize(SeaGraph* graph);
   CodeGenData* GetData() {
@@ -96,7 +96,12 @@ class CodeGenPassVisitor: public IRVisitor {
     }
 
  protected:
+  // Records the value of @instruction if the optimizations determined it (as a constant or
+  // as the value of an earlier instruction), and returns true if no code is needed for it.
+  bool MaterializeOptimizedValue(InstructionNode* instruction);
+
   CodeGenData* const llvm_data_;
+  const ValueOptimizer* value_optimizer_;
 };
 
 class CodeGenPrepassVisitor: public CodeGenPassVisitor {
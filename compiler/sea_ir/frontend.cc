@@ -47,20 +47,23 @@ static CompiledMethod* CompileMethodWithSeaIr(CompilerDriver& compiler,
                                      , llvm::LlvmCompilationUnit* llvm_compilation_unit
 #endif
 ) {
-  LOG(INFO) << "Compiling " << PrettyMethod(method_idx, dex_file) << ".";
+  VLOG(compiler) << "Compiling " << PrettyMethod(method_idx, dex_file) << ".";
   sea_ir::SeaGraph* ir_graph = sea_ir::SeaGraph::GetGraph(dex_file);
   std::string symbol = "dex_" + MangleForJni(PrettyMethod(method_idx, dex_file));
   sea_ir::CodeGenData* llvm_data = ir_graph->CompileMethod(symbol,
           code_item, class_def_idx, method_idx, method_access_flags, dex_file);
-  sea_ir::DotConversion dc;
-  SafeMap<int, const sea_ir::Type*>*  types = ir_graph->ti_->GetTypeMap();
-  dc.DumpSea(ir_graph, "/tmp/temp.dot", types);
+  if (VLOG_IS_ON(compiler)) {
+    // Keep one graph per method, so that they are not overwritten by the next method.
+    sea_ir::DotConversion dc;
+    SafeMap<int, const sea_ir::Type*>*  types = ir_graph->ti_->GetTypeMap();
+    dc.DumpSea(ir_graph, StringPrintf("/tmp/%s.dot", symbol.c_str()), types);
+  }
   MethodReference mref(&dex_file, method_idx);
   std::string llvm_code = llvm_data->GetElf(compiler.GetInstructionSet());
   CompiledMethod* compiled_method =
       new CompiledMethod(compiler, compiler.GetInstructionSet(), llvm_code,
                          *verifier::MethodVerifier::GetDexGcMap(mref), symbol);
-  LOG(INFO) << "Compiled SEA IR method " << PrettyMethod(method_idx, dex_file) << ".";
+  VLOG(compiler) << "Compiled SEA IR method " << PrettyMethod(method_idx, dex_file) << ".";
   return compiled_method;
 }
 
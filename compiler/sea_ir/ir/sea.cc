@@ -398,7 +398,6 @@ CodeGenData* SeaGraph::GenerateLLVM(const std::string& function_name,
     const art::DexFile& dex_file) {
   // Pass: Generate LLVM IR.
   CodeGenPrepassVisitor code_gen_prepass_visitor(function_name);
-  std::cout << "Generating code..." << std::endl;
   Accept(&code_gen_prepass_visitor);
   CodeGenVisitor code_gen_visitor(code_gen_prepass_visitor.GetData(),  dex_file);
   Accept(&code_gen_visitor);
@@ -427,6 +426,9 @@ CodeGenData* SeaGraph::CompileMethod(
   ConvertToSSA();
   // Pass: type inference
   ti_->ComputeTypes(this);
+  // Sparse and dominator tree passes: constant propagation, value numbering and
+  // dead code elimination.
+  value_optimizer_.Optimize(this);
   // Pass: Generate LLVM IR.
   CodeGenData* cgd = GenerateLLVM(function_name, dex_file);
   return cgd;
@@ -462,7 +464,7 @@ void SeaGraph::AddRegion(Region* r) {
 
 SeaGraph::SeaGraph(const art::DexFile& df)
     :ti_(new TypeInference()), class_def_idx_(0), method_idx_(0),  method_access_flags_(),
-     regions_(), parameters_(), dex_file_(df), code_item_(NULL) { }
+     regions_(), parameters_(), dex_file_(df), code_item_(NULL), value_optimizer_() { }
 
 void Region::AddChild(sea_ir::InstructionNode* instruction) {
   DCHECK(instruction) << "Tried to add NULL instruction to region node.";
@@ -27,6 +27,7 @@
 #include "dex_instruction.h"
 #include "sea_ir/ir/instruction_tools.h"
 #include "sea_ir/ir/instruction_nodes.h"
+#include "sea_ir/opt/value_optimizer.h"
 
 namespace sea_ir {
 
@@ -281,6 +282,12 @@ class SeaGraph: IVisitable {
     return &dex_file_;
   }
 
+  // Returns the results of the scalar optimizations.
+  // Precondition: CompileMethod() ran the optimizations.
+  const ValueOptimizer* GetValueOptimizer() const {
+    return &value_optimizer_;
+  }
+
   virtual void Accept(IRVisitor* visitor) {
     visitor->Initialize(this);
     visitor->Visit(this);
@@ -298,6 +305,8 @@ class SeaGraph: IVisitable {
 
  private:
   FRIEND_TEST(RegionsTest, Basics);
+  FRIEND_TEST(ValueOptimizerTest, FoldsConstants);
+  FRIEND_TEST(ValueOptimizerTest, NumbersValues);
   // Registers @childReg as a region belonging to the SeaGraph instance.
   void AddRegion(Region* childReg);
   // Returns new region and registers it with the  SeaGraph instance.
@@ -348,6 +357,7 @@ class SeaGraph: IVisitable {
   std::vector<SignatureNode*> parameters_;
   const art::DexFile& dex_file_;
   const art::DexFile::CodeItem* code_item_;
+  ValueOptimizer value_optimizer_;
 };
 }  // namespace sea_ir
 #endif  // ART_COMPILER_SEA_IR_IR_SEA_H_
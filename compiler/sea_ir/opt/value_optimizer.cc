@@ -0,0 +1,307 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <list>
+
+#include "base/stringprintf.h"
+#include "sea_ir/ir/sea.h"
+#include "sea_ir/opt/value_optimizer.h"
+
+namespace sea_ir {
+
+const char* const ValueVisitor::kCopyExpression = "copy";
+
+void ValueVisitor::SetOpaque(bool has_side_effects) {
+  lattice_ = kNotConstant;
+  value_ = 0;
+  has_side_effects_ = has_side_effects;
+  expression_.clear();
+  commutative_ = false;
+}
+
+ValueVisitor::Lattice ValueVisitor::GetOperandLattice(const InstructionNode* instruction,
+    int32_t* value) const {
+  art::SafeMap<int, int32_t>::const_iterator it = constants_->find(instruction->Id());
+  if (it != constants_->end()) {
+    *value = it->second;
+    return kConstant;
+  }
+  if (not_constant_->find(instruction->Id()) != not_constant_->end()) {
+    return kNotConstant;
+  }
+  return kUndefined;
+}
+
+void ValueVisitor::Visit(PhiInstructionNode* instruction) {
+  SetOpaque(false);
+  // Undefined operands are ignored, optimistically assuming they will agree with the others.
+  lattice_ = kUndefined;
+  std::vector<InstructionNode*> producers = instruction->GetSSAProducers();
+  for (std::vector<InstructionNode*>::const_iterator cit = producers.begin();
+      cit != producers.end(); cit++) {
+    int32_t value;
+    Lattice operand = GetOperandLattice(*cit, &value);
+    if (operand == kNotConstant || (operand == kConstant && lattice_ == kConstant &&
+        value != value_)) {
+      lattice_ = kNotConstant;
+      value_ = 0;
+      return;
+    }
+    if (operand == kConstant) {
+      lattice_ = kConstant;
+      value_ = value;
+    }
+  }
+}
+
+void ValueVisitor::Visit(SignatureNode* parameter) {
+  SetOpaque(true);
+}
+
+void ValueVisitor::Visit(InstructionNode* instruction) {
+  // Instructions without a dedicated node class are not understood, assume the worst.
+  SetOpaque(true);
+}
+
+void ValueVisitor::Visit(UnnamedConstInstructionNode* instruction) {
+  SetOpaque(false);
+  lattice_ = kConstant;
+  value_ = instruction->GetConstValue();
+}
+
+void ValueVisitor::Visit(ConstInstructionNode* instruction) {
+  SetOpaque(false);
+  lattice_ = kConstant;
+  value_ = instruction->GetConstValue();
+}
+
+void ValueVisitor::Visit(ReturnInstructionNode* instruction) {
+  SetOpaque(true);
+}
+
+void ValueVisitor::Visit(IfNeInstructionNode* instruction) {
+  SetOpaque(true);
+}
+
+void ValueVisitor::Visit(MoveResultInstructionNode* instruction) {
+  SetOpaque(false);
+  std::vector<InstructionNode*> producers = instruction->GetSSAProducers();
+  DCHECK_EQ(producers.size(), 1u);
+  lattice_ = GetOperandLattice(producers.at(0), &value_);
+  expression_ = kCopyExpression;
+}
+
+void ValueVisitor::Visit(InvokeStaticInstructionNode* instruction) {
+  SetOpaque(true);
+}
+
+void ValueVisitor::Visit(AddIntInstructionNode* instruction) {
+  SetOpaque(false);
+  expression_ = "add-int";
+  commutative_ = true;
+  std::vector<InstructionNode*> producers = instruction->GetSSAProducers();
+  DCHECK_EQ(producers.size(), 2u);
+  int32_t left;
+  int32_t right;
+  Lattice left_lattice = GetOperandLattice(producers.at(0), &left);
+  Lattice right_lattice = GetOperandLattice(producers.at(1), &right);
+  if (left_lattice == kNotConstant || right_lattice == kNotConstant) {
+    lattice_ = kNotConstant;
+  } else if (left_lattice == kUndefined || right_lattice == kUndefined) {
+    lattice_ = kUndefined;
+  } else {
+    // Dalvik integer arithmetic wraps around.
+    lattice_ = kConstant;
+    value_ = static_cast<int32_t>(static_cast<uint32_t>(left) + static_cast<uint32_t>(right));
+  }
+}
+
+void ValueVisitor::Visit(GotoInstructionNode* instruction) {
+  SetOpaque(true);
+}
+
+void ValueVisitor::Visit(IfEqzInstructionNode* instruction) {
+  SetOpaque(true);
+}
+
+void ValueOptimizer::Optimize(SeaGraph* graph) {
+  constants_.clear();
+  not_constant_.clear();
+  leaders_.clear();
+  live_.clear();
+  PropagateConstants(graph);
+  std::vector<Region*>* regions = graph->GetRegions();
+  for (std::vector<Region*>::const_iterator cit = regions->begin(); cit != regions->end(); cit++) {
+    if ((*cit)->GetIDominator() == (*cit)) {
+      utils::ScopedHashtable<std::string, InstructionNode*> table;
+      NumberValues(*cit, &table);
+    }
+  }
+  MarkLiveInstructions(graph);
+}
+
+bool ValueOptimizer::GetConstant(const InstructionNode* instruction, int32_t* value) const {
+  art::SafeMap<int, int32_t>::const_iterator it = constants_.find(instruction->Id());
+  if (it == constants_.end()) {
+    return false;
+  }
+  *value = it->second;
+  return true;
+}
+
+InstructionNode* ValueOptimizer::GetLeader(InstructionNode* instruction) const {
+  art::SafeMap<int, InstructionNode*>::const_iterator it = leaders_.find(instruction->Id());
+  return (it == leaders_.end()) ? instruction : it->second;
+}
+
+bool ValueOptimizer::IsDead(const InstructionNode* instruction) const {
+  return live_.find(instruction->Id()) == live_.end();
+}
+
+void ValueOptimizer::PropagateConstants(SeaGraph* graph) {
+  std::vector<Region*>* regions = graph->GetRegions();
+  std::list<InstructionNode*> worklist;
+  for (std::vector<Region*>::const_iterator region_it = regions->begin();
+      region_it != regions->end(); region_it++) {
+    std::vector<PhiInstructionNode*>* phi_instructions = (*region_it)->GetPhiNodes();
+    std::copy(phi_instructions->begin(), phi_instructions->end(), std::back_inserter(worklist));
+    std::vector<InstructionNode*>* instructions = (*region_it)->GetInstructions();
+    std::copy(instructions->begin(), instructions->end(), std::back_inserter(worklist));
+  }
+  // Sparse fixed-point algorithm in the style of TypeInference::ComputeTypes(): the values
+  // only ever move down the lattice (undefined, constant, not constant), so the consumers of
+  // an instruction are revisited at most twice.
+  ValueVisitor visitor(&constants_, &not_constant_);
+  for (std::list<InstructionNode*>::const_iterator instruction_it = worklist.begin();
+      instruction_it != worklist.end(); instruction_it++) {
+    (*instruction_it)->Accept(&visitor);
+    int id = (*instruction_it)->Id();
+    if (not_constant_.find(id) != not_constant_.end()) {
+      continue;
+    }
+    art::SafeMap<int, int32_t>::iterator old_constant = constants_.find(id);
+    bool changed = false;
+    if (visitor.GetLattice() == ValueVisitor::kNotConstant ||
+        (visitor.GetLattice() == ValueVisitor::kConstant && old_constant != constants_.end() &&
+         old_constant->second != visitor.GetValue())) {
+      if (old_constant != constants_.end()) {
+        constants_.erase(old_constant);
+      }
+      not_constant_.insert(id);
+      changed = true;
+    } else if (visitor.GetLattice() == ValueVisitor::kConstant &&
+        old_constant == constants_.end()) {
+      constants_.Put(id, visitor.GetValue());
+      changed = true;
+    }
+    if (changed) {
+      std::vector<InstructionNode*>* consumers = (*instruction_it)->GetSSAConsumers();
+      std::copy(consumers->begin(), consumers->end(), std::back_inserter(worklist));
+    }
+  }
+}
+
+void ValueOptimizer::NumberValues(Region* region,
+    utils::ScopedHashtable<std::string, InstructionNode*>* table) {
+  table->OpenScope();
+  ValueVisitor visitor(&constants_, &not_constant_);
+  std::vector<InstructionNode*>* instructions = region->GetInstructions();
+  for (std::vector<InstructionNode*>::const_iterator cit = instructions->begin();
+      cit != instructions->end(); cit++) {
+    InstructionNode* instruction = *cit;
+    instruction->Accept(&visitor);
+    if (visitor.GetExpression().empty()) {
+      continue;
+    }
+    std::vector<InstructionNode*> producers = instruction->GetSSAProducers();
+    if (visitor.IsCopy()) {
+      leaders_.Put(instruction->Id(), GetLeader(producers.at(0)));
+      continue;
+    }
+    // Operands are named by their constant value if they have one, so that for example the
+    // unnamed constants of two identical *-lit instructions match.
+    std::vector<std::string> operands;
+    for (std::vector<InstructionNode*>::const_iterator producer = producers.begin();
+        producer != producers.end(); producer++) {
+      int32_t value;
+      if (GetConstant(*producer, &value)) {
+        operands.push_back(art::StringPrintf("#%d", value));
+      } else {
+        operands.push_back(GetLeader(*producer)->StringId());
+      }
+    }
+    if (visitor.IsCommutative()) {
+      std::sort(operands.begin(), operands.end());
+    }
+    std::string key = visitor.GetExpression();
+    for (std::vector<std::string>::const_iterator operand = operands.begin();
+        operand != operands.end(); operand++) {
+      key += " " + *operand;
+    }
+    InstructionNode* leader = table->Lookup(key);
+    if (leader != NULL) {
+      leaders_.Put(instruction->Id(), leader);
+    } else {
+      table->Add(key, instruction);
+    }
+  }
+  const std::set<Region*>* dominated_regions = region->GetIDominatedSet();
+  for (std::set<Region*>::const_iterator cit = dominated_regions->begin();
+      cit != dominated_regions->end(); cit++) {
+    NumberValues(*cit, table);
+  }
+  table->CloseScope();
+}
+
+void ValueOptimizer::MarkLiveInstructions(SeaGraph* graph) {
+  std::vector<InstructionNode*> worklist;
+  ValueVisitor visitor(&constants_, &not_constant_);
+  std::vector<Region*>* regions = graph->GetRegions();
+  for (std::vector<Region*>::const_iterator region_it = regions->begin();
+      region_it != regions->end(); region_it++) {
+    std::vector<InstructionNode*>* instructions = (*region_it)->GetInstructions();
+    for (std::vector<InstructionNode*>::const_iterator cit = instructions->begin();
+        cit != instructions->end(); cit++) {
+      (*cit)->Accept(&visitor);
+      if (visitor.HasSideEffects()) {
+        worklist.push_back(*cit);
+      }
+    }
+  }
+  while (!worklist.empty()) {
+    InstructionNode* instruction = worklist.back();
+    worklist.pop_back();
+    if (!live_.insert(instruction->Id()).second) {
+      continue;
+    }
+    // Constants are materialized in place and reused values come from their leader, so
+    // neither needs its operands to be computed.
+    int32_t value;
+    if (GetConstant(instruction, &value)) {
+      continue;
+    }
+    InstructionNode* leader = GetLeader(instruction);
+    if (leader != instruction) {
+      worklist.push_back(leader);
+      continue;
+    }
+    std::vector<InstructionNode*> producers = instruction->GetSSAProducers();
+    worklist.insert(worklist.end(), producers.begin(), producers.end());
+  }
+}
+
+}  // namespace sea_ir
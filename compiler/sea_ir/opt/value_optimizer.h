@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ART_COMPILER_SEA_IR_OPT_VALUE_OPTIMIZER_H_
+#define ART_COMPILER_SEA_IR_OPT_VALUE_OPTIMIZER_H_
+
+#include <stdint.h>
+
+#include <set>
+#include <string>
+
+#include "safe_map.h"
+#include "sea_ir/ir/visitor.h"
+#include "utils/scoped_hashtable.h"
+
+namespace sea_ir {
+
+class SeaGraph;
+class Region;
+class InstructionNode;
+
+// The ValueOptimizer runs the scalar optimizations of SEA IR over a method in SSA form:
+// sparse constant propagation, dominator-based value numbering (which also forwards
+// move-result copies) and dead code elimination. The IR itself is left untouched; code
+// generation asks the optimizer how each instruction should be materialized.
+class ValueOptimizer {
+ public:
+  ValueOptimizer() { }
+
+  // Optimizes the method with SEA IR representation provided by @graph.
+  // Precondition: SeaGraph.ConvertToSSA()
+  void Optimize(SeaGraph* graph);
+
+  // Returns true and sets @value if @instruction always evaluates to the same integer.
+  bool GetConstant(const InstructionNode* instruction, int32_t* value) const;
+  // Returns the instruction whose value @instruction can reuse, or @instruction itself.
+  // The returned instruction dominates @instruction.
+  InstructionNode* GetLeader(InstructionNode* instruction) const;
+  // Returns true if @instruction needs no code of its own.
+  bool IsDead(const InstructionNode* instruction) const;
+
+ private:
+  // Computes the constant value of every instruction.
+  void PropagateConstants(SeaGraph* graph);
+  // Computes the leaders of all instructions in the dominator (sub)tree rooted at @region.
+  void NumberValues(Region* region, utils::ScopedHashtable<std::string, InstructionNode*>* table);
+  // Marks as live the instructions whose values are needed by side effects or control flow.
+  void MarkLiveInstructions(SeaGraph* graph);
+
+  art::SafeMap<int, int32_t> constants_;
+  std::set<int> not_constant_;
+  art::SafeMap<int, InstructionNode*> leaders_;
+  std::set<int> live_;
+};
+
+// The ValueVisitor describes the instruction it visits in terms the ValueOptimizer understands:
+// its constant value given the constants already known for its operands, whether it has effects
+// beyond computing its value, and the expression it computes. The result is stored in the
+// visitor, in the same way as for the TypeInferenceVisitor.
+class ValueVisitor: public IRVisitor {
+ public:
+  enum Lattice {
+    kUndefined,     // Not computed yet, or computed from undefined operands only.
+    kConstant,
+    kNotConstant
+  };
+
+  explicit ValueVisitor(const art::SafeMap<int, int32_t>* constants,
+      const std::set<int>* not_constant):
+    constants_(constants), not_constant_(not_constant), lattice_(kNotConstant), value_(0),
+    has_side_effects_(true), expression_(), commutative_(false) { }
+
+  void Initialize(SeaGraph* graph) { }
+  void Visit(SeaGraph* graph) { }
+  void Visit(Region* region) { }
+  void Visit(PhiInstructionNode* instruction);
+  void Visit(SignatureNode* parameter);
+  void Visit(InstructionNode* instruction);
+  void Visit(UnnamedConstInstructionNode* instruction);
+  void Visit(ConstInstructionNode* instruction);
+  void Visit(ReturnInstructionNode* instruction);
+  void Visit(IfNeInstructionNode* instruction);
+  void Visit(MoveResultInstructionNode* instruction);
+  void Visit(InvokeStaticInstructionNode* instruction);
+  void Visit(AddIntInstructionNode* instruction);
+  void Visit(GotoInstructionNode* instruction);
+  void Visit(IfEqzInstructionNode* instruction);
+
+  Lattice GetLattice() const {
+    return lattice_;
+  }
+  int32_t GetValue() const {
+    return value_;
+  }
+  bool HasSideEffects() const {
+    return has_side_effects_;
+  }
+  // Returns the name of the pure operation computed by the visited instruction or an empty
+  // string if instructions computing the same operation on the same operands may differ.
+  const std::string& GetExpression() const {
+    return expression_;
+  }
+  // Returns true if the operands of the expression can be swapped.
+  bool IsCommutative() const {
+    return commutative_;
+  }
+  // Returns true if the visited instruction only copies its (single) operand.
+  bool IsCopy() const {
+    return expression_ == kCopyExpression;
+  }
+
+  static const char* const kCopyExpression;
+
+ private:
+  // Sets the state for an instruction that computes nothing the optimizer can reason about.
+  void SetOpaque(bool has_side_effects);
+  // Returns the lattice value of @instruction, and its constant in @value.
+  Lattice GetOperandLattice(const InstructionNode* instruction, int32_t* value) const;
+
+  const art::SafeMap<int, int32_t>* const constants_;
+  const std::set<int>* const not_constant_;
+  Lattice lattice_;
+  int32_t value_;
+  bool has_side_effects_;
+  std::string expression_;
+  bool commutative_;
+};
+
+}  // namespace sea_ir
+
+#endif  // ART_COMPILER_SEA_IR_OPT_VALUE_OPTIMIZER_H_
@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "common_test.h"
+#include "sea_ir/ir/sea.h"
+#include "sea_ir/opt/value_optimizer.h"
+
+namespace sea_ir {
+
+class ValueOptimizerTest : public art::CommonTest {
+};
+
+// const/4 v0, #2
+static const uint16_t kConst2[] = { 0x2012 };
+// const/4 v1, #3
+static const uint16_t kConst3[] = { 0x3112 };
+// add-int v2, v0, v1
+static const uint16_t kAddV2V0V1[] = { 0x0290, 0x0100 };
+// add-int v3, v1, v0
+static const uint16_t kAddV3V1V0[] = { 0x0390, 0x0001 };
+// add-int v4, v2, v3
+static const uint16_t kAddV4V2V3[] = { 0x0490, 0x0302 };
+// add-int v5, v0, v0
+static const uint16_t kAddV5V0V0[] = { 0x0590, 0x0000 };
+// return v2
+static const uint16_t kReturnV2[] = { 0x020f };
+// return v4
+static const uint16_t kReturnV4[] = { 0x040f };
+
+TEST_F(ValueOptimizerTest, FoldsConstants) {
+  sea_ir::SeaGraph sg(*java_lang_dex_file_);
+  sea_ir::Region* root = sg.GetNewRegion();
+  root->SetIDominator(root);
+  InstructionNode* const_2 = new ConstInstructionNode(art::Instruction::At(kConst2));
+  InstructionNode* const_3 = new ConstInstructionNode(art::Instruction::At(kConst3));
+  InstructionNode* add = new AddIntInstructionNode(art::Instruction::At(kAddV2V0V1));
+  InstructionNode* ret = new ReturnInstructionNode(art::Instruction::At(kReturnV2));
+  root->AddChild(const_2);
+  root->AddChild(const_3);
+  root->AddChild(add);
+  root->AddChild(ret);
+  add->RenameToSSA(0, const_2);
+  add->RenameToSSA(1, const_3);
+  ret->RenameToSSA(2, add);
+
+  ValueOptimizer optimizer;
+  optimizer.Optimize(&sg);
+  int32_t value = 0;
+  EXPECT_TRUE(optimizer.GetConstant(add, &value));
+  EXPECT_EQ(5, value);
+  EXPECT_FALSE(optimizer.GetConstant(ret, &value));
+  // Only the folded sum is used, so the constants it was computed from need no code.
+  EXPECT_FALSE(optimizer.IsDead(ret));
+  EXPECT_FALSE(optimizer.IsDead(add));
+  EXPECT_TRUE(optimizer.IsDead(const_2));
+  EXPECT_TRUE(optimizer.IsDead(const_3));
+}
+
+TEST_F(ValueOptimizerTest, NumbersValues) {
+  sea_ir::SeaGraph sg(*java_lang_dex_file_);
+  sea_ir::Region* root = sg.GetNewRegion();
+  root->SetIDominator(root);
+  SignatureNode* param_0 = new SignatureNode(0, 0);
+  SignatureNode* param_1 = new SignatureNode(1, 1);
+  InstructionNode* add_2 = new AddIntInstructionNode(art::Instruction::At(kAddV2V0V1));
+  InstructionNode* add_3 = new AddIntInstructionNode(art::Instruction::At(kAddV3V1V0));
+  InstructionNode* add_4 = new AddIntInstructionNode(art::Instruction::At(kAddV4V2V3));
+  InstructionNode* add_5 = new AddIntInstructionNode(art::Instruction::At(kAddV5V0V0));
+  InstructionNode* ret = new ReturnInstructionNode(art::Instruction::At(kReturnV4));
+  root->AddChild(param_0);
+  root->AddChild(param_1);
+  root->AddChild(add_2);
+  root->AddChild(add_3);
+  root->AddChild(add_4);
+  root->AddChild(add_5);
+  root->AddChild(ret);
+  add_2->RenameToSSA(0, param_0);
+  add_2->RenameToSSA(1, param_1);
+  add_3->RenameToSSA(1, param_1);
+  add_3->RenameToSSA(0, param_0);
+  add_4->RenameToSSA(2, add_2);
+  add_4->RenameToSSA(3, add_3);
+  add_5->RenameToSSA(0, param_0);
+  ret->RenameToSSA(4, add_4);
+
+  ValueOptimizer optimizer;
+  optimizer.Optimize(&sg);
+  int32_t value = 0;
+  EXPECT_FALSE(optimizer.GetConstant(add_2, &value));
+  EXPECT_FALSE(optimizer.GetConstant(add_4, &value));
+  // Addition is commutative, so v1 + v0 reuses v0 + v1.
+  EXPECT_EQ(add_2, optimizer.GetLeader(add_2));
+  EXPECT_EQ(add_2, optimizer.GetLeader(add_3));
+  EXPECT_EQ(add_4, optimizer.GetLeader(add_4));
+  EXPECT_FALSE(optimizer.IsDead(add_2));
+  EXPECT_FALSE(optimizer.IsDead(add_4));
+  // The result of v0 + v0 is never used.
+  EXPECT_TRUE(optimizer.IsDead(add_5));
+}
+
+}  // namespace sea_ir
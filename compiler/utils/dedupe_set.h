@@ -18,22 +18,26 @@
 #define ART_COMPILER_UTILS_DEDUPE_SET_H_
 
 #include <set>
+#include <vector>
 
 #include "base/mutex.h"
 #include "base/stl_util.h"
 
 namespace art {
 
-// A simple data structure to handle hashed deduplication. Add is thread safe.
-template <typename Key, typename HashType, typename HashFunc>
+// A simple data structure to handle hashed deduplication. Add is thread safe. Keys are spread
+// over kShard sets by hash, each with its own lock, so that threads adding keys which hash
+// differently don't contend.
+template <typename Key, typename HashType, typename HashFunc, HashType kShard = 1>
 class DedupeSet {
   typedef std::pair<HashType, Key*> HashedKey;
 
   class Comparator {
    public:
     bool operator()(const HashedKey& a, const HashedKey& b) const {
-      if (a.first < b.first) return true;
-      if (a.first > b.first) return true;
+      if (a.first != b.first) {
+        return a.first < b.first;
+      }
       return *a.second < *b.second;
     }
   };
@@ -41,39 +45,85 @@ class DedupeSet {
   typedef std::set<HashedKey, Comparator> Keys;
 
  public:
-  typedef typename Keys::iterator iterator;
-  typedef typename Keys::const_iterator const_iterator;
   typedef typename Keys::size_type size_type;
-  typedef typename Keys::value_type value_type;
 
-  iterator begin() { return keys_.begin(); }
-  const_iterator begin() const { return keys_.begin(); }
-  iterator end() { return keys_.end(); }
-  const_iterator end() const { return keys_.end(); }
-
-  Key* Add(Thread* self, const Key& key) {
+  // Returns the set's copy of key, setting *added if the copy was made by this call.
+  Key* Add(Thread* self, const Key& key, bool* added = NULL) {
     HashType hash = HashFunc()(key);
     HashedKey hashed_key(hash, const_cast<Key*>(&key));
-    MutexLock lock(self, lock_);
-    auto it = keys_.find(hashed_key);
-    if (it != keys_.end()) {
+    const HashType shard = ShardIndex(hash);
+    MutexLock lock(self, *lock_[shard]);
+    auto it = keys_[shard].find(hashed_key);
+    if (it != keys_[shard].end()) {
+      if (added != NULL) {
+        *added = false;
+      }
       return it->second;
     }
     hashed_key.second = new Key(key);
-    keys_.insert(hashed_key);
+    keys_[shard].insert(hashed_key);
+    if (added != NULL) {
+      *added = true;
+    }
     return hashed_key.second;
   }
 
-  DedupeSet() : lock_("dedupe lock") {
+  // Takes every key out of the set, calling visitor(Key*) on each. The pointers returned by Add
+  // stay valid and the keys are still freed with the set, but later Adds of an equal key make a
+  // new copy, so the visitor may change the keys.
+  template <typename Visitor>
+  void Evict(Thread* self, Visitor& visitor) {
+    for (HashType i = 0; i < kShard; ++i) {
+      MutexLock lock(self, *lock_[i]);
+      for (const HashedKey& hashed_key : keys_[i]) {
+        visitor(hashed_key.second);
+        evicted_keys_[i].push_back(hashed_key.second);
+      }
+      keys_[i].clear();
+    }
+  }
+
+  // Frees every key, the pointers returned by Add are no longer valid afterwards.
+  void Clear(Thread* self) {
+    for (HashType i = 0; i < kShard; ++i) {
+      MutexLock lock(self, *lock_[i]);
+      STLDeleteValues(&keys_[i]);
+      STLDeleteElements(&evicted_keys_[i]);
+    }
+  }
+
+  size_type Size(Thread* self) {
+    size_type size = 0;
+    for (HashType i = 0; i < kShard; ++i) {
+      MutexLock lock(self, *lock_[i]);
+      size += keys_[i].size();
+    }
+    return size;
+  }
+
+  DedupeSet() {
+    for (HashType i = 0; i < kShard; ++i) {
+      lock_[i] = new Mutex("dedupe lock");
+    }
   }
 
   ~DedupeSet() {
-    STLDeleteValues(&keys_);
+    for (HashType i = 0; i < kShard; ++i) {
+      STLDeleteValues(&keys_[i]);
+      STLDeleteElements(&evicted_keys_[i]);
+      delete lock_[i];
+    }
   }
 
  private:
-  Mutex lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
-  Keys keys_;
+  // Hash functions may leave the low bits poorly distributed, mix in the high bits.
+  static HashType ShardIndex(HashType hash) {
+    return (hash ^ (hash >> 16)) % kShard;
+  }
+
+  Mutex* lock_[kShard];
+  Keys keys_[kShard];
+  std::vector<Key*> evicted_keys_[kShard];
   DISALLOW_COPY_AND_ASSIGN(DedupeSet);
 };
 
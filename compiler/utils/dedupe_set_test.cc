@@ -75,4 +75,53 @@ TEST_F(DedupeSetTest, Test) {
   }
 }
 
+TEST_F(DedupeSetTest, Sharded) {
+  Thread* self = Thread::Current();
+  typedef std::vector<uint8_t> ByteArray;
+  DedupeSet<ByteArray, size_t, DedupeHashFunc, 4> deduplicator;
+  std::vector<ByteArray*> arrays;
+  for (size_t i = 0; i < 256; ++i) {
+    ByteArray test;
+    test.push_back(i);
+    test.push_back(i * 3);
+    arrays.push_back(deduplicator.Add(self, test));
+    ASSERT_EQ(test, *arrays.back());
+  }
+  EXPECT_EQ(256U, deduplicator.Size(self));
+  for (size_t i = 0; i < 256; ++i) {
+    ByteArray test;
+    test.push_back(i);
+    test.push_back(i * 3);
+    ASSERT_EQ(arrays[i], deduplicator.Add(self, test));
+  }
+  EXPECT_EQ(256U, deduplicator.Size(self));
+  deduplicator.Clear(self);
+  EXPECT_EQ(0U, deduplicator.Size(self));
+}
+
+TEST_F(DedupeSetTest, Evict) {
+  Thread* self = Thread::Current();
+  typedef std::vector<uint8_t> ByteArray;
+  DedupeSet<ByteArray, size_t, DedupeHashFunc, 4> deduplicator;
+  ByteArray test;
+  test.push_back(1);
+  test.push_back(2);
+  bool added = false;
+  ByteArray* array1 = deduplicator.Add(self, test, &added);
+  EXPECT_TRUE(added);
+  EXPECT_EQ(array1, deduplicator.Add(self, test, &added));
+  EXPECT_FALSE(added);
+
+  // Evicted keys stay alive but are no longer handed out.
+  size_t visited = 0;
+  auto visitor = [&visited](ByteArray*) { ++visited; };
+  deduplicator.Evict(self, visitor);
+  EXPECT_EQ(1U, visited);
+  EXPECT_EQ(0U, deduplicator.Size(self));
+  EXPECT_EQ(test, *array1);
+  ByteArray* array2 = deduplicator.Add(self, test, &added);
+  EXPECT_TRUE(added);
+  EXPECT_NE(array1, array2);
+}
+
 }  // namespace art
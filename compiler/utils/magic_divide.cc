@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "magic_divide.h"
+
+#include "base/logging.h"
+
+namespace art {
+
+void CalculateMagicAndShift(int32_t divisor, int32_t* magic, int* shift) {
+  DCHECK(divisor < -1 || divisor > 1) << divisor;
+  const uint32_t two31 = 0x80000000U;
+  // Work with the absolute values of the divisor and of nc, the largest dividend for which
+  // nc % divisor == divisor - 1.
+  uint32_t ad = (divisor < 0) ? -static_cast<uint32_t>(divisor) : divisor;
+  uint32_t t = two31 + (static_cast<uint32_t>(divisor) >> 31);
+  uint32_t anc = t - 1 - t % ad;
+  int p = 31;
+  uint32_t q1 = two31 / anc;
+  uint32_t r1 = two31 - q1 * anc;
+  uint32_t q2 = two31 / ad;
+  uint32_t r2 = two31 - q2 * ad;
+  uint32_t delta;
+  // Find the smallest p for which 2^p > nc * (divisor - 2^p % divisor).
+  do {
+    p++;
+    q1 = 2 * q1;
+    r1 = 2 * r1;
+    if (r1 >= anc) {
+      q1++;
+      r1 -= anc;
+    }
+    q2 = 2 * q2;
+    r2 = 2 * r2;
+    if (r2 >= ad) {
+      q2++;
+      r2 -= ad;
+    }
+    delta = ad - r2;
+  } while (q1 < delta || (q1 == delta && r1 == 0));
+  uint32_t m = q2 + 1;
+  *magic = static_cast<int32_t>((divisor < 0) ? -m : m);
+  *shift = p - 32;
+}
+
+int32_t MagicDivide(int32_t dividend, int32_t divisor, int32_t magic, int shift) {
+  int64_t product = static_cast<int64_t>(magic) * dividend;
+  // Unsigned arithmetic, as the adjustments may wrap in 32 bits like the machine instructions.
+  uint32_t q = static_cast<uint32_t>(product >> 32);
+  if (divisor > 0 && magic < 0) {
+    q += dividend;
+  } else if (divisor < 0 && magic > 0) {
+    q -= dividend;
+  }
+  q = static_cast<uint32_t>(static_cast<int32_t>(q) >> shift);
+  q += q >> 31;
+  return static_cast<int32_t>(q);
+}
+
+}  // namespace art
@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ART_COMPILER_UTILS_MAGIC_DIVIDE_H_
+#define ART_COMPILER_UTILS_MAGIC_DIVIDE_H_
+
+#include <stdint.h>
+
+namespace art {
+
+// Signed division of n by a constant d, where d is neither 0, 1 nor -1, without a divide
+// instruction (Hacker's Delight, 10-4 and 10-5):
+//
+//   q = high word of the 64-bit product magic * n
+//   q += n if d > 0 and magic < 0, or q -= n if d < 0 and magic > 0
+//   q >>= shift                    (arithmetic)
+//   q += (uint32_t) q >> 31        (rounds towards zero)
+//
+// leaves the quotient in q, which makes the remainder n - q * d.
+void CalculateMagicAndShift(int32_t divisor, int32_t* magic, int* shift);
+
+// Computes the quotient with the sequence above, as the code generators emit it.
+int32_t MagicDivide(int32_t dividend, int32_t divisor, int32_t magic, int shift);
+
+}  // namespace art
+
+#endif  // ART_COMPILER_UTILS_MAGIC_DIVIDE_H_
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "magic_divide.h"
+
+#include <limits>
+
+#include "gtest/gtest.h"
+
+namespace art {
+
+static const int32_t kMin = std::numeric_limits<int32_t>::min();
+static const int32_t kMax = std::numeric_limits<int32_t>::max();
+
+// Dividends around the points where quotients change sign or overflow.
+static const int32_t kDividends[] = {
+  0, 1, -1, 2, -2, 3, -3, 5, -5, 6, -6, 7, -7, 100, -100, 1000, -1000,
+  0x12345678, -0x12345678, 0x3fffffff, 0x40000000, -0x40000000, -0x40000001,
+  kMax - 1, kMax, kMin + 1, kMin,
+};
+
+static void CheckDivisor(int32_t divisor) {
+  int32_t magic;
+  int shift;
+  CalculateMagicAndShift(divisor, &magic, &shift);
+  ASSERT_GE(shift, 0) << divisor;
+  ASSERT_LT(shift, 32) << divisor;
+  for (size_t i = 0; i < sizeof(kDividends) / sizeof(kDividends[0]); ++i) {
+    // Also try the dividends next to a multiple of the divisor, where rounding matters most.
+    int64_t multiple = (static_cast<int64_t>(kDividends[i]) / divisor) * divisor;
+    int64_t dividends[] = { kDividends[i], multiple - 1, multiple, multiple + 1 };
+    for (size_t j = 0; j < sizeof(dividends) / sizeof(dividends[0]); ++j) {
+      if (dividends[j] < kMin || dividends[j] > kMax) {
+        continue;
+      }
+      int32_t dividend = static_cast<int32_t>(dividends[j]);
+      int32_t quotient = MagicDivide(dividend, divisor, magic, shift);
+      EXPECT_EQ(dividend / divisor, quotient) << dividend << " / " << divisor;
+      // The remainder as the code generators derive it, with the multiply wrapping.
+      int32_t remainder = dividend - static_cast<int32_t>(static_cast<uint32_t>(quotient) *
+                                                          static_cast<uint32_t>(divisor));
+      EXPECT_EQ(dividend % divisor, remainder) << dividend << " % " << divisor;
+    }
+  }
+}
+
+TEST(MagicDivide, SmallDivisors) {
+  for (int32_t divisor = 2; divisor <= 1000; ++divisor) {
+    CheckDivisor(divisor);
+    CheckDivisor(-divisor);
+  }
+}
+
+TEST(MagicDivide, LargeDivisors) {
+  static const int32_t kDivisors[] = {
+    641, 6700417, 0x7ffffffe, kMax, 0x40000000, 0x40000001, 0x55555555, 0x12345678,
+    kMin, kMin + 1, -0x40000000, -0x55555555,
+  };
+  for (size_t i = 0; i < sizeof(kDivisors) / sizeof(kDivisors[0]); ++i) {
+    CheckDivisor(kDivisors[i]);
+  }
+}
+
+TEST(MagicDivide, KnownMagicNumbers) {
+  // From Hacker's Delight, table 10-1.
+  int32_t magic;
+  int shift;
+  CalculateMagicAndShift(3, &magic, &shift);
+  EXPECT_EQ(0x55555556, magic);
+  EXPECT_EQ(0, shift);
+  CalculateMagicAndShift(7, &magic, &shift);
+  EXPECT_EQ(static_cast<int32_t>(0x92492493), magic);
+  EXPECT_EQ(2, shift);
+  CalculateMagicAndShift(-5, &magic, &shift);
+  EXPECT_EQ(static_cast<int32_t>(0x99999999), magic);
+  EXPECT_EQ(1, shift);
+}
+
+}  // namespace art
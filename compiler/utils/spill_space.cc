@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "spill_space.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "base/logging.h"
+#include "base/stringprintf.h"
+#include "thread.h"
+
+namespace art {
+
+SpillSpace* SpillSpace::Create(const std::string& directory, std::string* error_msg) {
+  std::string path(directory + "/dex2oat-spill-XXXXXX");
+  int fd = mkstemp(&path[0]);
+  if (fd == -1) {
+    *error_msg = StringPrintf("Failed to create spill file in '%s': %s", directory.c_str(),
+                              strerror(errno));
+    return NULL;
+  }
+  if (unlink(path.c_str()) != 0) {
+    PLOG(WARNING) << "Failed to unlink spill file " << path;
+  }
+  return new SpillSpace(new File(fd, path));
+}
+
+SpillSpace::SpillSpace(File* file)
+    : file_(file), lock_("spill space lock"), end_(0) {
+}
+
+bool SpillSpace::Spill(std::vector<uint8_t>* data) {
+  if (data->empty()) {
+    return true;
+  }
+  Entry entry;
+  entry.size = data->size();
+  {
+    // Reserve the space, the write itself doesn't need the lock.
+    MutexLock mu(Thread::Current(), lock_);
+    entry.offset = end_;
+    end_ += entry.size;
+  }
+  const char* ptr = reinterpret_cast<const char*>(&(*data)[0]);
+  size_t written = 0;
+  while (written < entry.size) {
+    int64_t rc = file_->Write(ptr + written, entry.size - written, entry.offset + written);
+    if (rc <= 0) {
+      PLOG(ERROR) << "Failed to write " << entry.size << " bytes to spill file "
+                  << file_->GetPath();
+      return false;
+    }
+    written += rc;
+  }
+  {
+    MutexLock mu(Thread::Current(), lock_);
+    entries_.Put(data, entry);
+  }
+  // Swap with an empty vector to actually give back the storage.
+  std::vector<uint8_t>().swap(*data);
+  return true;
+}
+
+bool SpillSpace::IsSpilled(const std::vector<uint8_t>& data) const {
+  MutexLock mu(Thread::Current(), lock_);
+  return entries_.find(&data) != entries_.end();
+}
+
+const std::vector<uint8_t>& SpillSpace::Load(const std::vector<uint8_t>& data,
+                                             std::vector<uint8_t>* buffer) const {
+  Entry entry;
+  {
+    MutexLock mu(Thread::Current(), lock_);
+    auto it = entries_.find(&data);
+    if (it == entries_.end()) {
+      return data;
+    }
+    entry = it->second;
+  }
+  buffer->resize(entry.size);
+  char* ptr = reinterpret_cast<char*>(&(*buffer)[0]);
+  size_t read = 0;
+  while (read < entry.size) {
+    int64_t rc = file_->Read(ptr + read, entry.size - read, entry.offset + read);
+    if (rc <= 0) {
+      // The data can't be recreated, there is no sensible way to carry on.
+      PLOG(FATAL) << "Failed to read " << entry.size << " bytes from spill file "
+                  << file_->GetPath();
+    }
+    read += rc;
+  }
+  return *buffer;
+}
+
+uint64_t SpillSpace::GetSpilledBytes() const {
+  MutexLock mu(Thread::Current(), lock_);
+  return end_;
+}
+
+}  // namespace art
@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ART_COMPILER_UTILS_SPILL_SPACE_H_
+#define ART_COMPILER_UTILS_SPILL_SPACE_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "base/macros.h"
+#include "base/mutex.h"
+#include "base/unix_file/fd_file.h"
+#include "os.h"
+#include "safe_map.h"
+#include "UniquePtr.h"
+
+namespace art {
+
+// Moves the contents of byte arrays out of memory into a temporary file. A spilled array keeps
+// its identity but is left empty, its contents have to be loaded back to be used.
+class SpillSpace {
+ public:
+  // Creates the spill file in directory. The file is unlinked right away, so that it goes away
+  // with the process.
+  static SpillSpace* Create(const std::string& directory, std::string* error_msg);
+
+  // Writes out the contents of data and frees them. Returns false, leaving data as it was, if
+  // they couldn't be written.
+  bool Spill(std::vector<uint8_t>* data) LOCKS_EXCLUDED(lock_);
+
+  bool IsSpilled(const std::vector<uint8_t>& data) const LOCKS_EXCLUDED(lock_);
+
+  // Returns the contents of data, read back into buffer if they were spilled.
+  const std::vector<uint8_t>& Load(const std::vector<uint8_t>& data,
+                                   std::vector<uint8_t>* buffer) const LOCKS_EXCLUDED(lock_);
+
+  // Returns the number of bytes written to the spill file.
+  uint64_t GetSpilledBytes() const LOCKS_EXCLUDED(lock_);
+
+ private:
+  explicit SpillSpace(File* file);
+
+  struct Entry {
+    uint64_t offset;
+    size_t size;
+  };
+
+  UniquePtr<File> file_;
+
+  mutable Mutex lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
+  uint64_t end_ GUARDED_BY(lock_);
+  SafeMap<const std::vector<uint8_t>*, Entry> entries_ GUARDED_BY(lock_);
+
+  DISALLOW_COPY_AND_ASSIGN(SpillSpace);
+};
+
+}  // namespace art
+
+#endif  // ART_COMPILER_UTILS_SPILL_SPACE_H_
@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "spill_space.h"
+
+#include "common_test.h"
+
+namespace art {
+
+class SpillSpaceTest : public CommonTest {};
+
+TEST_F(SpillSpaceTest, SpillAndLoad) {
+  std::string error_msg;
+  UniquePtr<SpillSpace> spill_space(SpillSpace::Create(android_data_, &error_msg));
+  ASSERT_TRUE(spill_space.get() != NULL) << error_msg;
+
+  std::vector<uint8_t> data1;
+  std::vector<uint8_t> data2;
+  for (size_t i = 0; i < 10000; ++i) {
+    data1.push_back(i & 0xff);
+    data2.push_back((i * 7) & 0xff);
+  }
+  const std::vector<uint8_t> expected1(data1);
+  const std::vector<uint8_t> expected2(data2);
+  std::vector<uint8_t> untouched(3, 42);
+
+  ASSERT_TRUE(spill_space->Spill(&data1));
+  ASSERT_TRUE(spill_space->Spill(&data2));
+  EXPECT_TRUE(data1.empty());
+  EXPECT_TRUE(spill_space->IsSpilled(data1));
+  EXPECT_FALSE(spill_space->IsSpilled(untouched));
+  EXPECT_EQ(expected1.size() + expected2.size(), spill_space->GetSpilledBytes());
+
+  std::vector<uint8_t> buffer;
+  EXPECT_EQ(expected2, spill_space->Load(data2, &buffer));
+  EXPECT_EQ(expected1, spill_space->Load(data1, &buffer));
+  // Data that wasn't spilled is returned as is.
+  EXPECT_EQ(&untouched, &spill_space->Load(untouched, &buffer));
+}
+
+}  // namespace art
@@ -0,0 +1,667 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "assembler_x86_64.h"
+
+namespace art {
+namespace x86_64 {
+
+void X86_64Assembler::call(Register reg) {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  EmitRex(false, 2, Operand(reg));
+  EmitUint8(0xFF);
+  EmitOperand(2, Operand(reg));
+}
+
+
+void X86_64Assembler::call(const Address& address) {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  EmitRex(false, 2, address);
+  EmitUint8(0xFF);
+  EmitOperand(2, address);
+}
+
+
+void X86_64Assembler::pushq(Register reg) {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  EmitRex(false, 0, Operand(reg));
+  EmitUint8(0x50 + (reg & 7));
+}
+
+
+void X86_64Assembler::pushq(const Immediate& imm) {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  if (imm.is_int8()) {
+    EmitUint8(0x6A);
+    EmitUint8(imm.value() & 0xFF);
+  } else {
+    EmitUint8(0x68);
+    EmitImmediate(imm);
+  }
+}
+
+
+void X86_64Assembler::popq(Register reg) {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  EmitRex(false, 0, Operand(reg));
+  EmitUint8(0x58 + (reg & 7));
+}
+
+
+void X86_64Assembler::movq(Register dst, const Immediate& imm) {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  if (imm.is_int32()) {
+    // Sign-extended 32-bit immediate.
+    EmitRex(true, 0, Operand(dst));
+    EmitUint8(0xC7);
+    EmitOperand(0, Operand(dst));
+    EmitImmediate(imm);
+  } else {
+    EmitRex(true, 0, Operand(dst));
+    EmitUint8(0xB8 + (dst & 7));
+    EmitInt64(imm.value());
+  }
+}
+
+
+void X86_64Assembler::movq(Register dst, Register src) {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  EmitRegisterMemory(true, 0x8B, dst, Operand(src));
+}
+
+
+void X86_64Assembler::movq(Register dst, const Address& src) {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  EmitRegisterMemory(true, 0x8B, dst, src);
+}
+
+
+void X86_64Assembler::movq(const Address& dst, Register src) {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  EmitRex(true, src, dst);
+  EmitUint8(0x89);
+  EmitOperand(src, dst);
+}
+
+
+void X86_64Assembler::movq(const Address& dst, const Immediate& imm) {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  EmitRex(true, 0, dst);
+  EmitUint8(0xC7);
+  EmitOperand(0, dst);
+  EmitImmediate(imm);
+}
+
+
+void X86_64Assembler::movl(Register dst, const Immediate& imm) {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  EmitRex(false, 0, Operand(dst));
+  EmitUint8(0xB8 + (dst & 7));
+  EmitImmediate(imm);
+}
+
+
+void X86_64Assembler::movl(Register dst, Register src) {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  EmitRegisterMemory(false, 0x8B, dst, Operand(src));
+}
+
+
+void X86_64Assembler::movl(Register dst, const Address& src) {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  EmitRegisterMemory(false, 0x8B, dst, src);
+}
+
+
+void X86_64Assembler::movl(const Address& dst, Register src) {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  EmitRex(false, src, dst);
+  EmitUint8(0x89);
+  EmitOperand(src, dst);
+}
+
+
+void X86_64Assembler::movl(const Address& dst, const Immediate& imm) {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  EmitRex(false, 0, dst);
+  EmitUint8(0xC7);
+  EmitOperand(0, dst);
+  EmitImmediate(imm);
+}
+
+
+void X86_64Assembler::movsxd(Register dst, Register src) {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  EmitRegisterMemory(true, 0x63, dst, Operand(src));
+}
+
+
+void X86_64Assembler::movsxd(Register dst, const Address& src) {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  EmitRegisterMemory(true, 0x63, dst, src);
+}
+
+
+void X86_64Assembler::leaq(Register dst, const Address& src) {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  EmitRegisterMemory(true, 0x8D, dst, src);
+}
+
+
+void X86_64Assembler::cmpq(Register reg0, Register reg1) {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  EmitRegisterMemory(true, 0x3B, reg0, Operand(reg1));
+}
+
+
+void X86_64Assembler::cmpq(Register reg, const Immediate& imm) {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  EmitComplex(true, 7, Operand(reg), imm);
+}
+
+
+void X86_64Assembler::cmpq(Register reg, const Address& address) {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  EmitRegisterMemory(true, 0x3B, reg, address);
+}
+
+
+void X86_64Assembler::cmpl(Register reg0, Register reg1) {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  EmitRegisterMemory(false, 0x3B, reg0, Operand(reg1));
+}
+
+
+void X86_64Assembler::cmpl(Register reg, const Immediate& imm) {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  EmitComplex(false, 7, Operand(reg), imm);
+}
+
+
+void X86_64Assembler::testq(Register reg1, Register reg2) {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  EmitRegisterMemory(true, 0x85, reg1, Operand(reg2));
+}
+
+
+void X86_64Assembler::testl(Register reg1, Register reg2) {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  EmitRegisterMemory(false, 0x85, reg1, Operand(reg2));
+}
+
+
+void X86_64Assembler::andq(Register dst, Register src) {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  EmitRegisterMemory(true, 0x23, dst, Operand(src));
+}
+
+
+void X86_64Assembler::andq(Register dst, const Immediate& imm) {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  EmitComplex(true, 4, Operand(dst), imm);
+}
+
+
+void X86_64Assembler::andl(Register dst, Register src) {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  EmitRegisterMemory(false, 0x23, dst, Operand(src));
+}
+
+
+void X86_64Assembler::andl(Register dst, const Immediate& imm) {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  EmitComplex(false, 4, Operand(dst), imm);
+}
+
+
+void X86_64Assembler::orq(Register dst, Register src) {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  EmitRegisterMemory(true, 0x0B, dst, Operand(src));
+}
+
+
+void X86_64Assembler::orq(Register dst, const Immediate& imm) {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  EmitComplex(true, 1, Operand(dst), imm);
+}
+
+
+void X86_64Assembler::orl(Register dst, Register src) {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  EmitRegisterMemory(false, 0x0B, dst, Operand(src));
+}
+
+
+void X86_64Assembler::orl(Register dst, const Immediate& imm) {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  EmitComplex(false, 1, Operand(dst), imm);
+}
+
+
+void X86_64Assembler::xorq(Register dst, Register src) {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  EmitRegisterMemory(true, 0x33, dst, Operand(src));
+}
+
+
+void X86_64Assembler::xorq(Register dst, const Immediate& imm) {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  EmitComplex(true, 6, Operand(dst), imm);
+}
+
+
+void X86_64Assembler::xorl(Register dst, Register src) {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  EmitRegisterMemory(false, 0x33, dst, Operand(src));
+}
+
+
+void X86_64Assembler::xorl(Register dst, const Immediate& imm) {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  EmitComplex(false, 6, Operand(dst), imm);
+}
+
+
+void X86_64Assembler::addq(Register dst, Register src) {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  EmitRegisterMemory(true, 0x03, dst, Operand(src));
+}
+
+
+void X86_64Assembler::addq(Register reg, const Immediate& imm) {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  EmitComplex(true, 0, Operand(reg), imm);
+}
+
+
+void X86_64Assembler::addq(Register reg, const Address& address) {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  EmitRegisterMemory(true, 0x03, reg, address);
+}
+
+
+void X86_64Assembler::addl(Register dst, Register src) {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  EmitRegisterMemory(false, 0x03, dst, Operand(src));
+}
+
+
+void X86_64Assembler::addl(Register reg, const Immediate& imm) {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  EmitComplex(false, 0, Operand(reg), imm);
+}
+
+
+void X86_64Assembler::addl(Register reg, const Address& address) {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  EmitRegisterMemory(false, 0x03, reg, address);
+}
+
+
+void X86_64Assembler::subq(Register dst, Register src) {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  EmitRegisterMemory(true, 0x2B, dst, Operand(src));
+}
+
+
+void X86_64Assembler::subq(Register reg, const Immediate& imm) {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  EmitComplex(true, 5, Operand(reg), imm);
+}
+
+
+void X86_64Assembler::subq(Register reg, const Address& address) {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  EmitRegisterMemory(true, 0x2B, reg, address);
+}
+
+
+void X86_64Assembler::subl(Register dst, Register src) {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  EmitRegisterMemory(false, 0x2B, dst, Operand(src));
+}
+
+
+void X86_64Assembler::subl(Register reg, const Immediate& imm) {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  EmitComplex(false, 5, Operand(reg), imm);
+}
+
+
+void X86_64Assembler::subl(Register reg, const Address& address) {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  EmitRegisterMemory(false, 0x2B, reg, address);
+}
+
+
+void X86_64Assembler::imulq(Register dst, Register src) {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  EmitRex(true, dst, Operand(src));
+  EmitUint8(0x0F);
+  EmitUint8(0xAF);
+  EmitOperand(dst, Operand(src));
+}
+
+
+void X86_64Assembler::imull(Register dst, Register src) {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  EmitRex(false, dst, Operand(src));
+  EmitUint8(0x0F);
+  EmitUint8(0xAF);
+  EmitOperand(dst, Operand(src));
+}
+
+
+void X86_64Assembler::cqo() {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  EmitUint8(kRexPrefix | kRexW);
+  EmitUint8(0x99);
+}
+
+
+void X86_64Assembler::cdq() {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  EmitUint8(0x99);
+}
+
+
+void X86_64Assembler::idivq(Register reg) {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  EmitRex(true, 7, Operand(reg));
+  EmitUint8(0xF7);
+  EmitOperand(7, Operand(reg));
+}
+
+
+void X86_64Assembler::idivl(Register reg) {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  EmitRex(false, 7, Operand(reg));
+  EmitUint8(0xF7);
+  EmitOperand(7, Operand(reg));
+}
+
+
+void X86_64Assembler::negq(Register reg) {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  EmitRex(true, 3, Operand(reg));
+  EmitUint8(0xF7);
+  EmitOperand(3, Operand(reg));
+}
+
+
+void X86_64Assembler::negl(Register reg) {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  EmitRex(false, 3, Operand(reg));
+  EmitUint8(0xF7);
+  EmitOperand(3, Operand(reg));
+}
+
+
+void X86_64Assembler::notq(Register reg) {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  EmitRex(true, 2, Operand(reg));
+  EmitUint8(0xF7);
+  EmitOperand(2, Operand(reg));
+}
+
+
+void X86_64Assembler::notl(Register reg) {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  EmitRex(false, 2, Operand(reg));
+  EmitUint8(0xF7);
+  EmitOperand(2, Operand(reg));
+}
+
+
+void X86_64Assembler::shlq(Register reg, const Immediate& imm) {
+  EmitGenericShift(true, 4, reg, imm);
+}
+
+
+void X86_64Assembler::shlq(Register operand, Register shifter) {
+  EmitGenericShift(true, 4, operand, shifter);
+}
+
+
+void X86_64Assembler::shrq(Register reg, const Immediate& imm) {
+  EmitGenericShift(true, 5, reg, imm);
+}
+
+
+void X86_64Assembler::shrq(Register operand, Register shifter) {
+  EmitGenericShift(true, 5, operand, shifter);
+}
+
+
+void X86_64Assembler::sarq(Register reg, const Immediate& imm) {
+  EmitGenericShift(true, 7, reg, imm);
+}
+
+
+void X86_64Assembler::sarq(Register operand, Register shifter) {
+  EmitGenericShift(true, 7, operand, shifter);
+}
+
+
+void X86_64Assembler::ret() {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  EmitUint8(0xC3);
+}
+
+
+void X86_64Assembler::nop() {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  EmitUint8(0x90);
+}
+
+
+void X86_64Assembler::int3() {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  EmitUint8(0xCC);
+}
+
+
+void X86_64Assembler::hlt() {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  EmitUint8(0xF4);
+}
+
+
+void X86_64Assembler::j(Condition condition, Label* label) {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  if (label->IsBound()) {
+    static const int kShortSize = 2;
+    static const int kLongSize = 6;
+    int offset = label->Position() - buffer_.Size();
+    CHECK_LE(offset, 0);
+    if (IsInt(8, offset - kShortSize)) {
+      EmitUint8(0x70 + condition);
+      EmitUint8((offset - kShortSize) & 0xFF);
+    } else {
+      EmitUint8(0x0F);
+      EmitUint8(0x80 + condition);
+      EmitInt32(offset - kLongSize);
+    }
+  } else {
+    EmitUint8(0x0F);
+    EmitUint8(0x80 + condition);
+    EmitLabelLink(label);
+  }
+}
+
+
+void X86_64Assembler::jmp(Register reg) {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  EmitRex(false, 4, Operand(reg));
+  EmitUint8(0xFF);
+  EmitOperand(4, Operand(reg));
+}
+
+
+void X86_64Assembler::jmp(const Address& address) {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  EmitRex(false, 4, address);
+  EmitUint8(0xFF);
+  EmitOperand(4, address);
+}
+
+
+void X86_64Assembler::jmp(Label* label) {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  if (label->IsBound()) {
+    static const int kShortSize = 2;
+    static const int kLongSize = 5;
+    int offset = label->Position() - buffer_.Size();
+    CHECK_LE(offset, 0);
+    if (IsInt(8, offset - kShortSize)) {
+      EmitUint8(0xEB);
+      EmitUint8((offset - kShortSize) & 0xFF);
+    } else {
+      EmitUint8(0xE9);
+      EmitInt32(offset - kLongSize);
+    }
+  } else {
+    EmitUint8(0xE9);
+    EmitLabelLink(label);
+  }
+}
+
+
+void X86_64Assembler::Align(int alignment, int offset) {
+  CHECK(IsPowerOfTwo(alignment));
+  // Emit nop instruction until the real position is aligned.
+  while (((offset + buffer_.GetPosition()) & (alignment-1)) != 0) {
+    nop();
+  }
+}
+
+
+void X86_64Assembler::Bind(Label* label) {
+  int bound = buffer_.Size();
+  CHECK(!label->IsBound());  // Labels can only be bound once.
+  while (label->IsLinked()) {
+    int position = label->LinkPosition();
+    int next = buffer_.Load<int32_t>(position);
+    buffer_.Store<int32_t>(position, bound - (position + 4));
+    label->position_ = next;
+  }
+  label->BindTo(bound);
+}
+
+
+void X86_64Assembler::EmitRex(bool wide, int reg_or_opcode, const Operand& operand) {
+  CHECK_GE(reg_or_opcode, 0);
+  CHECK_LT(reg_or_opcode, 16);
+  uint8_t rex = operand.rex();
+  if (wide) {
+    rex |= kRexW;
+  }
+  if (reg_or_opcode > 7) {
+    rex |= kRexR;
+  }
+  if (rex != kRexNone) {
+    EmitUint8(kRexPrefix | rex);
+  }
+}
+
+
+void X86_64Assembler::EmitOperand(int reg_or_opcode, const Operand& operand) {
+  CHECK_GE(reg_or_opcode, 0);
+  CHECK_LT(reg_or_opcode, 16);
+  const int length = operand.length_;
+  CHECK_GT(length, 0);
+  // Emit the ModRM byte updated with the given reg value, its fourth bit is in the REX prefix.
+  CHECK_EQ(operand.encoding_[0] & 0x38, 0);
+  EmitUint8(operand.encoding_[0] + ((reg_or_opcode & 7) << 3));
+  // Emit the rest of the encoded operand.
+  for (int i = 1; i < length; i++) {
+    EmitUint8(operand.encoding_[i]);
+  }
+}
+
+
+void X86_64Assembler::EmitImmediate(const Immediate& imm) {
+  // Even 64-bit operations take (sign-extended) 32-bit immediates.
+  CHECK(imm.is_int32()) << imm.value();
+  EmitInt32(static_cast<int32_t>(imm.value()));
+}
+
+
+void X86_64Assembler::EmitComplex(bool wide, int reg_or_opcode, const Operand& operand,
+                                  const Immediate& immediate) {
+  CHECK_GE(reg_or_opcode, 0);
+  CHECK_LT(reg_or_opcode, 8);
+  EmitRex(wide, reg_or_opcode, operand);
+  if (immediate.is_int8()) {
+    // Use sign-extended 8-bit immediate.
+    EmitUint8(0x83);
+    EmitOperand(reg_or_opcode, operand);
+    EmitUint8(immediate.value() & 0xFF);
+  } else if (operand.IsRegister(RAX)) {
+    // Use short form if the destination is rax.
+    EmitUint8(0x05 + (reg_or_opcode << 3));
+    EmitImmediate(immediate);
+  } else {
+    EmitUint8(0x81);
+    EmitOperand(reg_or_opcode, operand);
+    EmitImmediate(immediate);
+  }
+}
+
+
+void X86_64Assembler::EmitRegisterMemory(bool wide, uint8_t opcode, Register dst,
+                                         const Operand& src) {
+  EmitRex(wide, dst, src);
+  EmitUint8(opcode);
+  EmitOperand(dst, src);
+}
+
+
+void X86_64Assembler::EmitLabelLink(Label* label) {
+  CHECK(!label->IsBound());
+  int position = buffer_.Size();
+  EmitInt32(label->position_);
+  label->LinkTo(position);
+}
+
+
+void X86_64Assembler::EmitGenericShift(bool wide, int reg_or_opcode, Register reg,
+                                       const Immediate& imm) {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  CHECK(imm.is_int8());
+  EmitRex(wide, reg_or_opcode, Operand(reg));
+  if (imm.value() == 1) {
+    EmitUint8(0xD1);
+    EmitOperand(reg_or_opcode, Operand(reg));
+  } else {
+    EmitUint8(0xC1);
+    EmitOperand(reg_or_opcode, Operand(reg));
+    EmitUint8(imm.value() & 0xFF);
+  }
+}
+
+
+void X86_64Assembler::EmitGenericShift(bool wide, int reg_or_opcode, Register operand,
+                                       Register shifter) {
+  AssemblerBuffer::EnsureCapacity ensured(&buffer_);
+  CHECK_EQ(shifter, RCX);
+  EmitRex(wide, reg_or_opcode, Operand(operand));
+  EmitUint8(0xD3);
+  EmitOperand(reg_or_opcode, Operand(operand));
+}
+
+}  // namespace x86_64
+}  // namespace art
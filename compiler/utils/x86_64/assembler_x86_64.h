@@ -0,0 +1,360 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ART_COMPILER_UTILS_X86_64_ASSEMBLER_X86_64_H_
+#define ART_COMPILER_UTILS_X86_64_ASSEMBLER_X86_64_H_
+
+#include <string.h>
+
+#include "base/macros.h"
+#include "constants_x86_64.h"
+#include "globals.h"
+#include "memory_region.h"
+#include "utils/assembler.h"
+#include "utils.h"
+
+namespace art {
+namespace x86_64 {
+
+class Immediate {
+ public:
+  explicit Immediate(int64_t value) : value_(value) {}
+
+  int64_t value() const { return value_; }
+
+  // The runtime's IsInt() takes a word, which may be too narrow for the value.
+  bool is_int8() const { return value_ == static_cast<int8_t>(value_); }
+  bool is_int32() const { return value_ == static_cast<int32_t>(value_); }
+
+ private:
+  const int64_t value_;
+
+  DISALLOW_COPY_AND_ASSIGN(Immediate);
+};
+
+
+// A ModRM encoded operand, with the REX bits needed to reach registers 8 to 15.
+class Operand {
+ public:
+  uint8_t mod() const {
+    return (encoding_at(0) >> 6) & 3;
+  }
+
+  Register rm() const {
+    return static_cast<Register>((encoding_at(0) & 7) | ((rex_ & kRexB) != 0 ? 8 : 0));
+  }
+
+  // Returns the REX.X and REX.B bits the operand needs.
+  uint8_t rex() const {
+    return rex_;
+  }
+
+  bool IsRegister(Register reg) const {
+    return ((encoding_[0] & 0xF8) == 0xC0)  // Addressing mode is register only.
+        && (rm() == reg);                   // Register codes match.
+  }
+
+ protected:
+  // Operand can be sub classed (e.g: Address).
+  Operand() : rex_(kRexNone), length_(0) { }
+
+  void SetModRM(int mod, Register rm) {
+    CHECK_EQ(mod & ~3, 0);
+    encoding_[0] = (mod << 6) | (rm & 7);
+    if (rm > 7) {
+      rex_ |= kRexB;
+    }
+    length_ = 1;
+  }
+
+  void SetSIB(ScaleFactor scale, Register index, Register base) {
+    CHECK_EQ(length_, 1);
+    CHECK_EQ(scale & ~3, 0);
+    encoding_[1] = (scale << 6) | ((index & 7) << 3) | (base & 7);
+    if (index > 7) {
+      rex_ |= kRexX;
+    }
+    if (base > 7) {
+      rex_ |= kRexB;
+    }
+    length_ = 2;
+  }
+
+  void SetDisp8(int8_t disp) {
+    CHECK(length_ == 1 || length_ == 2);
+    encoding_[length_++] = static_cast<uint8_t>(disp);
+  }
+
+  void SetDisp32(int32_t disp) {
+    CHECK(length_ == 1 || length_ == 2);
+    int disp_size = sizeof(disp);
+    memmove(&encoding_[length_], &disp, disp_size);
+    length_ += disp_size;
+  }
+
+ private:
+  uint8_t rex_;
+  byte length_;
+  byte encoding_[6];
+
+  explicit Operand(Register reg) : rex_(kRexNone), length_(0) { SetModRM(3, reg); }
+
+  // Get the operand encoding byte at the given index.
+  uint8_t encoding_at(int index) const {
+    CHECK_GE(index, 0);
+    CHECK_LT(index, length_);
+    return encoding_[index];
+  }
+
+  friend class X86_64Assembler;
+
+  DISALLOW_COPY_AND_ASSIGN(Operand);
+};
+
+
+class Address : public Operand {
+ public:
+  Address(Register base, int32_t disp) {
+    Init(base, disp);
+  }
+
+  Address(Register base, Offset disp) {
+    Init(base, disp.Int32Value());
+  }
+
+  Address(Register base, FrameOffset disp) {
+    CHECK_EQ(base, RSP);
+    Init(RSP, disp.Int32Value());
+  }
+
+  Address(Register base, MemberOffset disp) {
+    Init(base, disp.Int32Value());
+  }
+
+  // As on x86, except that R12 needs a SIB byte like RSP, and R13 needs a displacement like
+  // RBP: without one, their encoding means RIP-relative addressing.
+  void Init(Register base, int32_t disp) {
+    if (disp == 0 && (base & 7) != RBP) {
+      SetModRM(0, base);
+      if ((base & 7) == RSP) SetSIB(TIMES_1, RSP, base);
+    } else if (disp >= -128 && disp <= 127) {
+      SetModRM(1, base);
+      if ((base & 7) == RSP) SetSIB(TIMES_1, RSP, base);
+      SetDisp8(disp);
+    } else {
+      SetModRM(2, base);
+      if ((base & 7) == RSP) SetSIB(TIMES_1, RSP, base);
+      SetDisp32(disp);
+    }
+  }
+
+  Address(Register index, ScaleFactor scale, int32_t disp) {
+    CHECK_NE(index, RSP);  // Illegal addressing mode.
+    SetModRM(0, RSP);
+    SetSIB(scale, index, RBP);
+    SetDisp32(disp);
+  }
+
+  Address(Register base, Register index, ScaleFactor scale, int32_t disp) {
+    CHECK_NE(index, RSP);  // Illegal addressing mode.
+    if (disp == 0 && (base & 7) != RBP) {
+      SetModRM(0, RSP);
+      SetSIB(scale, index, base);
+    } else if (disp >= -128 && disp <= 127) {
+      SetModRM(1, RSP);
+      SetSIB(scale, index, base);
+      SetDisp8(disp);
+    } else {
+      SetModRM(2, RSP);
+      SetSIB(scale, index, base);
+      SetDisp32(disp);
+    }
+  }
+
+ private:
+  Address() {}
+
+  DISALLOW_COPY_AND_ASSIGN(Address);
+};
+
+
+// Assembler for the general purpose instructions of x86-64, in the style of the x86 assembler.
+// Instructions suffixed with q operate on 64 bits, those suffixed with l on 32 bits (and clear
+// the upper half of their destination register). All sixteen registers can be used anywhere a
+// register is expected; REX prefixes are emitted as needed.
+//
+// This is not an art::Assembler: the managed-register operations that the JNI compiler uses
+// need a 64-bit calling convention and frame layout, which the runtime does not have.
+class X86_64Assembler {
+ public:
+  X86_64Assembler() {}
+
+  // Size of generated code
+  size_t CodeSize() const { return buffer_.Size(); }
+
+  // Copy instructions out of assembly buffer into the given region of memory
+  void FinalizeInstructions(const MemoryRegion& region) {
+    buffer_.FinalizeInstructions(region);
+  }
+
+  /*
+   * Emit Machine Instructions.
+   */
+  void call(Register reg);
+  void call(const Address& address);
+
+  void pushq(Register reg);
+  void pushq(const Immediate& imm);
+
+  void popq(Register reg);
+
+  void movq(Register dst, const Immediate& src);
+  void movq(Register dst, Register src);
+  void movq(Register dst, const Address& src);
+  void movq(const Address& dst, Register src);
+  void movq(const Address& dst, const Immediate& imm);
+
+  void movl(Register dst, const Immediate& src);
+  void movl(Register dst, Register src);
+  void movl(Register dst, const Address& src);
+  void movl(const Address& dst, Register src);
+  void movl(const Address& dst, const Immediate& imm);
+
+  // Sign extends a 32-bit value.
+  void movsxd(Register dst, Register src);
+  void movsxd(Register dst, const Address& src);
+
+  void leaq(Register dst, const Address& src);
+
+  void cmpq(Register reg0, Register reg1);
+  void cmpq(Register reg, const Immediate& imm);
+  void cmpq(Register reg, const Address& address);
+  void cmpl(Register reg0, Register reg1);
+  void cmpl(Register reg, const Immediate& imm);
+
+  void testq(Register reg1, Register reg2);
+  void testl(Register reg1, Register reg2);
+
+  void andq(Register dst, Register src);
+  void andq(Register dst, const Immediate& imm);
+  void andl(Register dst, Register src);
+  void andl(Register dst, const Immediate& imm);
+
+  void orq(Register dst, Register src);
+  void orq(Register dst, const Immediate& imm);
+  void orl(Register dst, Register src);
+  void orl(Register dst, const Immediate& imm);
+
+  void xorq(Register dst, Register src);
+  void xorq(Register dst, const Immediate& imm);
+  void xorl(Register dst, Register src);
+  void xorl(Register dst, const Immediate& imm);
+
+  void addq(Register dst, Register src);
+  void addq(Register reg, const Immediate& imm);
+  void addq(Register reg, const Address& address);
+  void addl(Register dst, Register src);
+  void addl(Register reg, const Immediate& imm);
+  void addl(Register reg, const Address& address);
+
+  void subq(Register dst, Register src);
+  void subq(Register reg, const Immediate& imm);
+  void subq(Register reg, const Address& address);
+  void subl(Register dst, Register src);
+  void subl(Register reg, const Immediate& imm);
+  void subl(Register reg, const Address& address);
+
+  void imulq(Register dst, Register src);
+  void imull(Register dst, Register src);
+
+  void cqo();
+  void cdq();
+
+  void idivq(Register reg);
+  void idivl(Register reg);
+
+  void negq(Register reg);
+  void negl(Register reg);
+  void notq(Register reg);
+  void notl(Register reg);
+
+  void shlq(Register reg, const Immediate& imm);
+  void shlq(Register operand, Register shifter);
+  void shrq(Register reg, const Immediate& imm);
+  void shrq(Register operand, Register shifter);
+  void sarq(Register reg, const Immediate& imm);
+  void sarq(Register operand, Register shifter);
+
+  void ret();
+
+  void nop();
+  void int3();
+  void hlt();
+
+  void j(Condition condition, Label* label);
+
+  void jmp(Register reg);
+  void jmp(const Address& address);
+  void jmp(Label* label);
+
+  //
+  // Misc. functionality
+  //
+  int PreferredLoopAlignment() { return 16; }
+  void Align(int alignment, int offset);
+  void Bind(Label* label);
+
+ private:
+  inline void EmitUint8(uint8_t value);
+  inline void EmitInt32(int32_t value);
+  inline void EmitInt64(int64_t value);
+
+  // Emits the REX prefix for an instruction with the given operand size, ModRM reg field (a
+  // register or an opcode extension) and ModRM rm operand, if one is needed.
+  void EmitRex(bool wide, int reg_or_opcode, const Operand& operand);
+  void EmitOperand(int reg_or_opcode, const Operand& operand);
+  void EmitImmediate(const Immediate& imm);
+  // Emits an instruction of the add/or/and/sub/xor/cmp group with an immediate operand.
+  void EmitComplex(bool wide, int reg_or_opcode, const Operand& operand,
+                   const Immediate& immediate);
+  // Emits an instruction taking a register destination and register or memory source.
+  void EmitRegisterMemory(bool wide, uint8_t opcode, Register dst, const Operand& src);
+  void EmitLabelLink(Label* label);
+
+  void EmitGenericShift(bool wide, int reg_or_opcode, Register reg, const Immediate& imm);
+  void EmitGenericShift(bool wide, int reg_or_opcode, Register operand, Register shifter);
+
+  AssemblerBuffer buffer_;
+
+  DISALLOW_COPY_AND_ASSIGN(X86_64Assembler);
+};
+
+inline void X86_64Assembler::EmitUint8(uint8_t value) {
+  buffer_.Emit<uint8_t>(value);
+}
+
+inline void X86_64Assembler::EmitInt32(int32_t value) {
+  buffer_.Emit<int32_t>(value);
+}
+
+inline void X86_64Assembler::EmitInt64(int64_t value) {
+  buffer_.Emit<int64_t>(value);
+}
+
+}  // namespace x86_64
+}  // namespace art
+
+#endif  // ART_COMPILER_UTILS_X86_64_ASSEMBLER_X86_64_H_
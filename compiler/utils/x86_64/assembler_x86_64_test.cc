@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "assembler_x86_64.h"
+
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace art {
+namespace x86_64 {
+
+static void ExpectCode(X86_64Assembler* assembler, const uint8_t* expected, size_t size) {
+  std::vector<uint8_t> code(assembler->CodeSize());
+  MemoryRegion region(&code[0], code.size());
+  assembler->FinalizeInstructions(region);
+  ASSERT_EQ(size, code.size());
+  for (size_t i = 0; i < size; ++i) {
+    EXPECT_EQ(expected[i], code[i]) << "at offset " << i;
+  }
+}
+
+TEST(AssemblerX86_64, Registers) {
+  X86_64Assembler assembler;
+  assembler.movq(RAX, R9);
+  assembler.movq(R9, RAX);
+  assembler.movl(R8, Immediate(7));
+  assembler.pushq(R12);
+  assembler.popq(RBX);
+  assembler.addq(RSI, R15);
+  assembler.movsxd(RAX, R8);
+  assembler.call(R11);
+  static const uint8_t expected[] = {
+    0x49, 0x8B, 0xC1,                    // mov %r9, %rax
+    0x4C, 0x8B, 0xC8,                    // mov %rax, %r9
+    0x41, 0xB8, 0x07, 0x00, 0x00, 0x00,  // mov $7, %r8d
+    0x41, 0x54,                          // push %r12
+    0x5B,                                // pop %rbx
+    0x49, 0x03, 0xF7,                    // add %r15, %rsi
+    0x49, 0x63, 0xC0,                    // movslq %r8d, %rax
+    0x41, 0xFF, 0xD3,                    // call *%r11
+  };
+  ExpectCode(&assembler, expected, sizeof(expected));
+}
+
+TEST(AssemblerX86_64, Immediates) {
+  X86_64Assembler assembler;
+  assembler.movq(R10, Immediate(-1));
+  assembler.movq(RCX, Immediate(0x123456789LL));
+  assembler.addq(RSP, Immediate(8));
+  assembler.addq(RAX, Immediate(0x1000));
+  assembler.subq(R11, Immediate(0x1000));
+  static const uint8_t expected[] = {
+    0x49, 0xC7, 0xC2, 0xFF, 0xFF, 0xFF, 0xFF,                    // mov $-1, %r10
+    0x48, 0xB9, 0x89, 0x67, 0x45, 0x23, 0x01, 0x00, 0x00, 0x00,  // movabs $0x123456789, %rcx
+    0x48, 0x83, 0xC4, 0x08,                                      // add $8, %rsp
+    0x48, 0x05, 0x00, 0x10, 0x00, 0x00,                          // add $0x1000, %rax
+    0x49, 0x81, 0xEB, 0x00, 0x10, 0x00, 0x00,                    // sub $0x1000, %r11
+  };
+  ExpectCode(&assembler, expected, sizeof(expected));
+}
+
+TEST(AssemblerX86_64, Addresses) {
+  X86_64Assembler assembler;
+  assembler.movq(R12, Address(RSP, 8));
+  // R13 and R12 as bases need the same special encodings as RBP and RSP.
+  assembler.movq(Address(R13, 0), RDX);
+  assembler.movq(Address(R12, 0), RAX);
+  assembler.leaq(R14, Address(R8, R11, TIMES_8, 16));
+  static const uint8_t expected[] = {
+    0x4C, 0x8B, 0x64, 0x24, 0x08,  // mov 8(%rsp), %r12
+    0x49, 0x89, 0x55, 0x00,        // mov %rdx, 0(%r13)
+    0x49, 0x89, 0x04, 0x24,        // mov %rax, (%r12)
+    0x4F, 0x8D, 0x74, 0xD8, 0x10,  // lea 16(%r8,%r11,8), %r14
+  };
+  ExpectCode(&assembler, expected, sizeof(expected));
+}
+
+TEST(AssemblerX86_64, Arithmetic) {
+  X86_64Assembler assembler;
+  assembler.imulq(R13, R10);
+  assembler.cqo();
+  assembler.idivq(R8);
+  assembler.shlq(R9, Immediate(3));
+  assembler.sarq(RDX, RCX);
+  static const uint8_t expected[] = {
+    0x4D, 0x0F, 0xAF, 0xEA,  // imul %r10, %r13
+    0x48, 0x99,              // cqto
+    0x49, 0xF7, 0xF8,        // idiv %r8
+    0x49, 0xC1, 0xE1, 0x03,  // shl $3, %r9
+    0x48, 0xD3, 0xFA,        // sar %cl, %rdx
+  };
+  ExpectCode(&assembler, expected, sizeof(expected));
+}
+
+TEST(AssemblerX86_64, Labels) {
+  X86_64Assembler assembler;
+  Label backward;
+  Label forward;
+  assembler.Bind(&backward);
+  assembler.nop();
+  assembler.j(kNotEqual, &backward);
+  assembler.jmp(&forward);
+  assembler.nop();
+  assembler.Bind(&forward);
+  static const uint8_t expected[] = {
+    0x90,                          // nop
+    0x75, 0xFD,                    // jne -3
+    0xE9, 0x01, 0x00, 0x00, 0x00,  // jmp +1
+    0x90,                          // nop
+  };
+  ExpectCode(&assembler, expected, sizeof(expected));
+}
+
+}  // namespace x86_64
+}  // namespace art
@@ -16,15 +16,20 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/resource.h>
 #include <sys/stat.h>
+#include <unistd.h>
 #include <valgrind.h>
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
+#include <map>
 #include <sstream>
 #include <string>
 #include <vector>
 
+#include "atomic_integer.h"
 #include "base/stl_util.h"
 #include "base/stringpiece.h"
 #include "base/timing_logger.h"
@@ -32,12 +37,14 @@
 #include "class_linker.h"
 #include "dex_file-inl.h"
 #include "driver/compiler_driver.h"
+#include "driver/incremental_compilation.h"
 #include "elf_fixup.h"
 #include "elf_stripper.h"
 #include "gc/space/image_space.h"
 #include "gc/space/space-inl.h"
 #include "image_writer.h"
 #include "leb128.h"
+#include "method_profile.h"
 #include "mirror/art_method-inl.h"
 #include "mirror/class-inl.h"
 #include "mirror/class_loader.h"
@@ -50,12 +57,16 @@
 #include "ScopedLocalRef.h"
 #include "scoped_thread_state_change.h"
 #include "sirt_ref.h"
+#include "utils.h"
 #include "vector_output_stream.h"
 #include "well_known_classes.h"
 #include "zip_archive.h"
 
 namespace art {
 
+// How many invocations and backedges make a method hot for --profile-file by default.
+static const int kDefaultProfileHotThreshold = 100;
+
 static void UsageErrorV(const char* fmt, va_list ap) {
   std::string error;
   StringAppendV(&error, fmt, ap);
@@ -104,12 +115,52 @@ static void Usage(const char* fmt, ...) {
   UsageError("  --bitcode=<file.bc>: specifies the optional bitcode filename.");
   UsageError("      Example: --bitcode=/system/framework/boot.bc");
   UsageError("");
+  UsageError("  --profile-file=<file>: specifies a method profile written by a runtime started with");
+  UsageError("      -Xmethod-profile-file. Only the methods it counts as hot are compiled, the");
+  UsageError("      others are left to the interpreter.");
+  UsageError("      Example: --profile-file=/data/dalvik-cache/profiles/Calculator.apk");
+  UsageError("");
+  UsageError("  --profile-threshold=<count>: how many invocations and backedges make a method hot");
+  UsageError("      for --profile-file.");
+  UsageError("      Example: --profile-threshold=%d", kDefaultProfileHotThreshold);
+  UsageError("");
+  UsageError("  --compress-cold-code: compile the methods --profile-file doesn't count as hot");
+  UsageError("      too, but store their code deflated. It is inflated when first called. Quick");
+  UsageError("      backend only.");
+  UsageError("");
+  UsageError("  --previous-oat-file=<file.oat>: reuse the code of the classes that haven't");
+  UsageError("      changed since file.oat was compiled, with the same options, from earlier");
+  UsageError("      versions of the dex files. Quick backend only, not for images.");
+  UsageError("      Example: --previous-oat-file=/data/local/tmp/Calculator.odex");
+  UsageError("");
+  UsageError("  --align-text-to-huge-pages: pad the oat file so its code starts on a 2MB");
+  UsageError("      boundary, letting the kernel back it with file huge pages where it can.");
+  UsageError("");
+  UsageError("  --linear-scan-methods=<substring>: promote the registers of the methods whose");
+  UsageError("      name contains substring by live range instead of by use count, to compare");
+  UsageError("      the code quality of the two register promotion schemes.");
+  UsageError("      Example: --linear-scan-methods=java.lang.String.");
+  UsageError("");
   UsageError("  --image=<file.art>: specifies the output image filename.");
   UsageError("      Example: --image=/system/framework/boot.art");
   UsageError("");
+  UsageError("  --app-image=<file.art>: specifies an output image for the classes of the dex");
+  UsageError("      files, loaded on top of the boot image along with the oat file.");
+  UsageError("      Example: --app-image=/data/dalvik-cache/data@app@Calculator.apk@classes.art");
+  UsageError("");
   UsageError("  --image-classes=<classname-file>: specifies classes to include in an image.");
   UsageError("      Example: --image=frameworks/base/preloaded-classes");
   UsageError("");
+  UsageError("  --dirty-image-objects=<classname-file>: specifies classes whose instances, and");
+  UsageError("      the classes themselves, are likely to be written at runtime. They are placed");
+  UsageError("      on image pages of their own, keeping the other pages clean and shared. The");
+  UsageError("      classes can be found with the runtime's -XX:TrackZygoteDirtyPages.");
+  UsageError("      Example: --dirty-image-objects=frameworks/base/dirty-image-objects");
+  UsageError("");
+  UsageError("  --read-only-dex-caches: resolves the boot image's dex caches ahead of time and");
+  UsageError("      places their arrays on image pages the runtime maps read-only, so that every");
+  UsageError("      process shares them. What the runtime resolves later goes to a side table.");
+  UsageError("");
   UsageError("  --base=<hex-address>: specifies the base address when creating a boot image.");
   UsageError("      Example: --base=0x50000000");
   UsageError("");
@@ -131,6 +182,11 @@ static void Usage(const char* fmt, ...) {
   UsageError("      Example: --instruction-set=x86");
   UsageError("      Default: arm");
   UsageError("");
+  UsageError("  --instruction-set-features=...: comma separated list of optional features of");
+  UsageError("      the target, such as div for the hardware divide of ARMv7ve cores.");
+  UsageError("      Example: --instruction-set-features=div");
+  UsageError("      Default: default");
+  UsageError("");
   UsageError("  --compiler-backend=(Quick|QuickGBC|Portable): select compiler backend");
   UsageError("      set.");
   UsageError("      Example: --instruction-set=Portable");
@@ -138,8 +194,27 @@ static void Usage(const char* fmt, ...) {
   UsageError("");
   UsageError("  --host: used with Portable backend to link against host runtime libraries");
   UsageError("");
+  UsageError("  --compilation-cache=<directory>: used with Portable backend to reuse the code of");
+  UsageError("      methods compiled by earlier runs with the same compiler and class path.");
+  UsageError("      Example: --compilation-cache=out/host/dex2oat-cache");
+  UsageError("");
+  UsageError("  --method-batch-size=<code-units>: used with Portable backend to compile the");
+  UsageError("      methods of a class together, in batches of up to that many code units.");
+  UsageError("      Example: --method-batch-size=2000");
+  UsageError("      Default: 0, each method compiled on its own");
+  UsageError("");
   UsageError("  --dump-timing: display a breakdown of where time was spent");
   UsageError("");
+  UsageError("  --timing-report=<file>: write the time spent in each phase, the thread count");
+  UsageError("      and the peak resident set size to a tab separated file, for scripts such");
+  UsageError("      as tools/dex2oat-benchmark.py.");
+  UsageError("      Example: --timing-report=/tmp/timing.txt");
+  UsageError("");
+  UsageError("  --memory-budget=<megabytes>: once the compiled code kept in memory grows past");
+  UsageError("      the budget, move it out to a temporary file in $TMPDIR. For build hosts");
+  UsageError("      short on memory, only with the Quick backend.");
+  UsageError("      Example: --memory-budget=512");
+  UsageError("");
   UsageError("  --runtime-arg <argument>: used to specify various arguments for the runtime,");
   UsageError("      such as initial heap size, maximum heap size, and verbose output.");
   UsageError("      Use a separate --runtime-arg switch for each argument.");
@@ -155,13 +230,15 @@ class Dex2Oat {
                      Runtime::Options& options,
                      CompilerBackend compiler_backend,
                      InstructionSet instruction_set,
+                     const InstructionSetFeatures& instruction_set_features,
                      size_t thread_count)
       SHARED_TRYLOCK_FUNCTION(true, Locks::mutator_lock_) {
     if (!CreateRuntime(options, instruction_set)) {
       *p_dex2oat = NULL;
       return false;
     }
-    *p_dex2oat = new Dex2Oat(Runtime::Current(), compiler_backend, instruction_set, thread_count);
+    *p_dex2oat = new Dex2Oat(Runtime::Current(), compiler_backend, instruction_set,
+                             instruction_set_features, thread_count);
     return true;
   }
 
@@ -229,10 +306,21 @@ class Dex2Oat {
                                       bool is_host,
                                       const std::vector<const DexFile*>& dex_files,
                                       File* oat_file,
+                                      const struct stat* dex_location_stat,
                                       const std::string& bitcode_filename,
+                                      const std::string& compilation_cache_dir,
+                                      size_t method_batch_size,
                                       bool image,
                                       UniquePtr<CompilerDriver::DescriptorSet>& image_classes,
                                       bool dump_stats,
+                                      size_t memory_budget,
+                                      SpillSpace* spill_space,
+                                      MethodProfile* method_profile,
+                                      uint32_t profile_hot_threshold,
+                                      bool compress_cold_code,
+                                      const OatFile* previous_oat_file,
+                                      const std::string& linear_scan_methods,
+                                      bool align_text_to_huge_pages,
                                       base::TimingLogger& timings) {
     // SirtRef and ClassLoader creation needs to come after Runtime::Create
     jobject class_loader = NULL;
@@ -261,6 +349,33 @@ class Dex2Oat {
 
     if (compiler_backend_ == kPortable) {
       driver->SetBitcodeFileName(bitcode_filename);
+      if (!compilation_cache_dir.empty()) {
+        driver->SetCompilationCacheDirectory(compilation_cache_dir);
+      }
+      driver->SetMethodBatchSize(method_batch_size);
+    }
+
+    if (method_profile != NULL) {
+      driver->SetMethodProfile(method_profile, profile_hot_threshold);
+      driver->SetCompressColdCode(compress_cold_code);
+    }
+
+    if (previous_oat_file != NULL) {
+      gc::space::ImageSpace* image_space = Runtime::Current()->GetHeap()->GetImageSpace();
+      IncrementalCompilation* incremental_compilation =
+          IncrementalCompilation::Create(previous_oat_file, dex_files, instruction_set_,
+                                         image_space->GetImageHeader().GetOatChecksum());
+      if (incremental_compilation != NULL) {
+        driver->SetIncrementalCompilation(incremental_compilation);
+      }
+    }
+
+    driver->SetLinearScanMethodFilter(linear_scan_methods);
+    driver->SetAlignTextToHugePages(align_text_to_huge_pages);
+    driver->SetInstructionSetFeatures(instruction_set_features_);
+
+    if (spill_space != NULL) {
+      driver->SetMemoryBudget(memory_budget, spill_space);
     }
 
     driver->CompileAll(class_loader, dex_files, timings);
@@ -285,26 +400,53 @@ class Dex2Oat {
                          image_file_location_oat_data_begin,
                          image_file_location,
                          driver.get());
+    if (dex_location_stat != NULL) {
+      oat_writer.SetDexLocationStat(*dex_location_stat);
+    }
 
     if (!driver->WriteElf(android_root, is_host, dex_files, oat_writer, oat_file)) {
       LOG(ERROR) << "Failed to write ELF file " << oat_file->GetPath();
       return NULL;
     }
 
+    // Nothing reads the compiled code back once it is in the oat file, only the patch information
+    // is needed to write the image. Free it so it doesn't add to the footprint of image writing.
+    driver->ReleaseCompiledMethods();
+
     return driver.release();
   }
 
+  bool CreateAppImageFile(const std::string& image_filename,
+                          File* oat_file,
+                          const std::string& oat_location,
+                          const std::vector<const DexFile*>& dex_files,
+                          const CompilerDriver& compiler,
+                          base::TimingLogger& timings)
+      LOCKS_EXCLUDED(Locks::mutator_lock_) {
+    // App oat files are position independent, so unlike the boot image there's no ELF fixup.
+    ImageWriter image_writer(compiler);
+    if (!image_writer.WriteAppImage(image_filename, oat_file, oat_location, dex_files, timings)) {
+      LOG(ERROR) << "Failed to create app image file " << image_filename;
+      return false;
+    }
+    return true;
+  }
+
   bool CreateImageFile(const std::string& image_filename,
                        uintptr_t image_base,
                        const std::string& oat_filename,
                        const std::string& oat_location,
-                       const CompilerDriver& compiler)
+                       const CompilerDriver& compiler,
+                       const CompilerDriver::DescriptorSet* dirty_image_classes,
+                       bool read_only_dex_caches,
+                       base::TimingLogger& timings)
       LOCKS_EXCLUDED(Locks::mutator_lock_) {
     uintptr_t oat_data_begin;
     {
       // ImageWriter is scoped so it can free memory before doing FixupElf
-      ImageWriter image_writer(compiler);
-      if (!image_writer.Write(image_filename, image_base, oat_filename, oat_location)) {
+      ImageWriter image_writer(compiler, dirty_image_classes, read_only_dex_caches);
+      if (!image_writer.Write(image_filename, image_base, oat_filename, oat_location,
+                              timings)) {
         LOG(ERROR) << "Failed to create image file " << image_filename;
         return false;
       }
@@ -327,9 +469,11 @@ class Dex2Oat {
   explicit Dex2Oat(Runtime* runtime,
                    CompilerBackend compiler_backend,
                    InstructionSet instruction_set,
+                   const InstructionSetFeatures& instruction_set_features,
                    size_t thread_count)
       : compiler_backend_(compiler_backend),
         instruction_set_(instruction_set),
+        instruction_set_features_(instruction_set_features),
         runtime_(runtime),
         thread_count_(thread_count),
         start_ns_(NanoTime()) {
@@ -391,6 +535,7 @@ class Dex2Oat {
   const CompilerBackend compiler_backend_;
 
   const InstructionSet instruction_set_;
+  const InstructionSetFeatures instruction_set_features_;
 
   Runtime* runtime_;
   size_t thread_count_;
@@ -409,23 +554,111 @@ static bool ParseInt(const char* in, int* out) {
   return true;
 }
 
+// Parses a comma separated list of instruction set features. "default" stands for the baseline
+// of the instruction set, and a feature prefixed with "no" is turned off again.
+static InstructionSetFeatures ParseInstructionSetFeatures(const std::string& feature_list) {
+  InstructionSetFeatures result;
+  std::vector<std::string> features;
+  Split(feature_list, ',', features);
+  for (size_t i = 0; i < features.size(); ++i) {
+    const std::string& feature = features[i];
+    if (feature == "default") {
+      result = InstructionSetFeatures();
+    } else if (feature == "div") {
+      result.SetHasDivideInstruction(true);
+    } else if (feature == "nodiv") {
+      result.SetHasDivideInstruction(false);
+    } else {
+      Usage("Unknown instruction set feature: '%s'", feature.c_str());
+    }
+  }
+  return result;
+}
+
+// Writes one "<phase>\t<nanoseconds>" line per split label, adding up the splits repeated for each
+// dex file, followed by the total time, the thread count and the peak RSS in kilobytes.
+static void WriteTimingReport(const std::string& filename, const base::TimingLogger& timings,
+                              int thread_count) {
+  std::vector<const char*> labels;
+  std::map<std::string, uint64_t> phase_ns;
+  const base::TimingLogger::SplitTimings& splits = timings.GetSplits();
+  for (base::TimingLogger::SplitTimingsIterator it = splits.begin(); it != splits.end(); ++it) {
+    if (phase_ns.find(it->second) == phase_ns.end()) {
+      labels.push_back(it->second);
+      phase_ns[it->second] = 0;
+    }
+    phase_ns[it->second] += it->first;
+  }
+  std::ostringstream report;
+  for (size_t i = 0; i < labels.size(); ++i) {
+    report << labels[i] << "\t" << phase_ns[labels[i]] << "\n";
+  }
+  report << "total\t" << timings.GetTotalNs() << "\n";
+  report << "threads\t" << thread_count << "\n";
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) == 0) {
+    report << "peak_rss_kb\t" << usage.ru_maxrss << "\n";
+  }
+  UniquePtr<File> file(OS::CreateEmptyFile(filename.c_str()));
+  if (file.get() == NULL || !file->WriteFully(report.str().data(), report.str().size())) {
+    LOG(ERROR) << "Failed to write timing report " << filename;
+  }
+}
+
+struct OpenDexFilesState {
+  const std::vector<const char*>* dex_filenames;
+  const std::vector<const char*>* dex_locations;
+  std::vector<const DexFile*>* opened;
+  AtomicInteger next_index;
+};
+
+static void* OpenDexFilesWorker(void* arg) {
+  OpenDexFilesState* state = reinterpret_cast<OpenDexFilesState*>(arg);
+  while (true) {
+    size_t i = state->next_index++;
+    if (i >= state->dex_filenames->size()) {
+      return NULL;
+    }
+    const char* dex_filename = (*state->dex_filenames)[i];
+    if (OS::FileExists(dex_filename)) {
+      (*state->opened)[i] = DexFile::Open(dex_filename, (*state->dex_locations)[i]);
+    }
+  }
+}
+
+// Opens the dex files on several threads, as inflating classes.dex out of each jar dominates.
+// The result keeps the order of 'dex_filenames'.
 static size_t OpenDexFiles(const std::vector<const char*>& dex_filenames,
                            const std::vector<const char*>& dex_locations,
                            std::vector<const DexFile*>& dex_files) {
+  std::vector<const DexFile*> opened(dex_filenames.size(), NULL);
+  OpenDexFilesState state;
+  state.dex_filenames = &dex_filenames;
+  state.dex_locations = &dex_locations;
+  state.opened = &opened;
+  size_t thread_count = std::min(dex_filenames.size(),
+                                 static_cast<size_t>(sysconf(_SC_NPROCESSORS_CONF)));
+  // The calling thread is one of the workers.
+  std::vector<pthread_t> threads(thread_count > 1 ? thread_count - 1 : 0);
+  for (size_t i = 0; i < threads.size(); ++i) {
+    CHECK_PTHREAD_CALL(pthread_create, (&threads[i], NULL, OpenDexFilesWorker, &state),
+                       "open dex files");
+  }
+  OpenDexFilesWorker(&state);
+  for (size_t i = 0; i < threads.size(); ++i) {
+    CHECK_PTHREAD_CALL(pthread_join, (threads[i], NULL), "open dex files");
+  }
+
   size_t failure_count = 0;
   for (size_t i = 0; i < dex_filenames.size(); i++) {
     const char* dex_filename = dex_filenames[i];
-    const char* dex_location = dex_locations[i];
-    if (!OS::FileExists(dex_filename)) {
+    if (opened[i] != NULL) {
+      dex_files.push_back(opened[i]);
+    } else if (!OS::FileExists(dex_filename)) {
       LOG(WARNING) << "Skipping non-existent dex file '" << dex_filename << "'";
-      continue;
-    }
-    const DexFile* dex_file = DexFile::Open(dex_filename, dex_location);
-    if (dex_file == NULL) {
+    } else {
       LOG(WARNING) << "Failed to open .dex from file '" << dex_filename << "'\n";
       ++failure_count;
-    } else {
-      dex_files.push_back(dex_file);
     }
   }
   return failure_count;
@@ -584,9 +817,20 @@ static int dex2oat(int argc, char** argv) {
   std::string oat_location;
   int oat_fd = -1;
   std::string bitcode_filename;
+  std::string compilation_cache_dir;
+  int method_batch_size = 0;
+  std::string profile_filename;
+  int profile_hot_threshold = kDefaultProfileHotThreshold;
+  bool compress_cold_code = false;
+  std::string previous_oat_filename;
+  std::string linear_scan_methods;
+  bool align_text_to_huge_pages = false;
   const char* image_classes_zip_filename = NULL;
   const char* image_classes_filename = NULL;
+  const char* dirty_image_objects_filename = NULL;
+  bool read_only_dex_caches = false;
   std::string image_filename;
+  std::string app_image_filename;
   std::string boot_image_filename;
   uintptr_t image_base = 0;
   UniquePtr<std::string> host_prefix;
@@ -607,9 +851,12 @@ static int dex2oat(int argc, char** argv) {
 #else
 #error "Unsupported architecture"
 #endif
+  InstructionSetFeatures instruction_set_features;
   bool is_host = false;
   bool dump_stats = kIsDebugBuild;
   bool dump_timing = false;
+  std::string timing_report_filename;
+  int memory_budget_mb = 0;
   bool dump_slow_timing = kIsDebugBuild;
   bool watch_dog_enabled = !kIsTargetBuild;
 
@@ -653,10 +900,39 @@ static int dex2oat(int argc, char** argv) {
       oat_location = option.substr(strlen("--oat-location=")).data();
     } else if (option.starts_with("--bitcode=")) {
       bitcode_filename = option.substr(strlen("--bitcode=")).data();
+    } else if (option.starts_with("--compilation-cache=")) {
+      compilation_cache_dir = option.substr(strlen("--compilation-cache=")).data();
+    } else if (option.starts_with("--method-batch-size=")) {
+      const char* batch_size_str = option.substr(strlen("--method-batch-size=")).data();
+      if (!ParseInt(batch_size_str, &method_batch_size) || method_batch_size < 0) {
+        Usage("Failed to parse --method-batch-size argument '%s' as a number of code units",
+              batch_size_str);
+      }
+    } else if (option.starts_with("--profile-file=")) {
+      profile_filename = option.substr(strlen("--profile-file=")).data();
+    } else if (option.starts_with("--profile-threshold=")) {
+      const char* threshold_str = option.substr(strlen("--profile-threshold=")).data();
+      if (!ParseInt(threshold_str, &profile_hot_threshold) || profile_hot_threshold < 0) {
+        Usage("Failed to parse --profile-threshold argument '%s' as a count", threshold_str);
+      }
+    } else if (option == "--compress-cold-code") {
+      compress_cold_code = true;
+    } else if (option.starts_with("--previous-oat-file=")) {
+      previous_oat_filename = option.substr(strlen("--previous-oat-file=")).data();
+    } else if (option.starts_with("--linear-scan-methods=")) {
+      linear_scan_methods = option.substr(strlen("--linear-scan-methods=")).data();
+    } else if (option == "--align-text-to-huge-pages") {
+      align_text_to_huge_pages = true;
     } else if (option.starts_with("--image=")) {
       image_filename = option.substr(strlen("--image=")).data();
+    } else if (option.starts_with("--app-image=")) {
+      app_image_filename = option.substr(strlen("--app-image=")).data();
     } else if (option.starts_with("--image-classes=")) {
       image_classes_filename = option.substr(strlen("--image-classes=")).data();
+    } else if (option.starts_with("--dirty-image-objects=")) {
+      dirty_image_objects_filename = option.substr(strlen("--dirty-image-objects=")).data();
+    } else if (option == "--read-only-dex-caches") {
+      read_only_dex_caches = true;
     } else if (option.starts_with("--image-classes-zip=")) {
       image_classes_zip_filename = option.substr(strlen("--image-classes-zip=")).data();
     } else if (option.starts_with("--base=")) {
@@ -681,6 +957,9 @@ static int dex2oat(int argc, char** argv) {
       } else if (instruction_set_str == "x86") {
         instruction_set = kX86;
       }
+    } else if (option.starts_with("--instruction-set-features=")) {
+      std::string features_str = option.substr(strlen("--instruction-set-features=")).data();
+      instruction_set_features = ParseInstructionSetFeatures(features_str);
     } else if (option.starts_with("--compiler-backend=")) {
       StringPiece backend_str = option.substr(strlen("--compiler-backend=")).data();
       if (backend_str == "Quick") {
@@ -688,6 +967,13 @@ static int dex2oat(int argc, char** argv) {
       } else if (backend_str == "Portable") {
         compiler_backend = kPortable;
       }
+    } else if (option.starts_with("--memory-budget=")) {
+      const char* memory_budget_str = option.substr(strlen("--memory-budget=")).data();
+      if (!ParseInt(memory_budget_str, &memory_budget_mb) || memory_budget_mb <= 0 ||
+          memory_budget_mb >= 2048) {
+        Usage("Failed to parse --memory-budget argument '%s' as a number of megabytes below 2048",
+              memory_budget_str);
+      }
     } else if (option == "--host") {
       is_host = true;
     } else if (option == "--runtime-arg") {
@@ -700,6 +986,8 @@ static int dex2oat(int argc, char** argv) {
       runtime_args.push_back(argv[i]);
     } else if (option == "--dump-timing") {
       dump_timing = true;
+    } else if (option.starts_with("--timing-report=")) {
+      timing_report_filename = option.substr(strlen("--timing-report=")).data();
     } else {
       Usage("Unknown argument %s", option.data());
     }
@@ -756,6 +1044,10 @@ static int dex2oat(int argc, char** argv) {
     boot_image_option += boot_image_filename;
   }
 
+  if (!app_image_filename.empty() && image) {
+    Usage("--app-image should not be used with --image");
+  }
+
   if (image_classes_filename != NULL && !image) {
     Usage("--image-classes should only be used with --image");
   }
@@ -764,6 +1056,47 @@ static int dex2oat(int argc, char** argv) {
     Usage("--image-classes should not be used with --boot-image");
   }
 
+  if (dirty_image_objects_filename != NULL && !image) {
+    Usage("--dirty-image-objects should only be used with --image");
+  }
+
+  if (read_only_dex_caches && !image) {
+    Usage("--read-only-dex-caches should only be used with --image");
+  }
+
+  if (!compilation_cache_dir.empty()) {
+    if (compiler_backend != kPortable) {
+      Usage("--compilation-cache should only be used with the Portable backend");
+    }
+    if (!OS::DirectoryExists(compilation_cache_dir.c_str())) {
+      Usage("--compilation-cache directory '%s' does not exist", compilation_cache_dir.c_str());
+    }
+  }
+
+  if (method_batch_size != 0 && compiler_backend != kPortable) {
+    Usage("--method-batch-size should only be used with the Portable backend");
+  }
+
+  if (memory_budget_mb != 0 && compiler_backend != kQuick) {
+    Usage("--memory-budget should only be used with the Quick backend");
+  }
+
+  if (compress_cold_code && profile_filename.empty()) {
+    Usage("--compress-cold-code should be used with --profile-file");
+  }
+
+  if (compress_cold_code && compiler_backend != kQuick) {
+    Usage("--compress-cold-code should only be used with the Quick backend");
+  }
+
+  if (!previous_oat_filename.empty() && compiler_backend != kQuick) {
+    Usage("--previous-oat-file should only be used with the Quick backend");
+  }
+
+  if (!previous_oat_filename.empty() && image) {
+    Usage("--previous-oat-file should not be used with --image");
+  }
+
   if (image_classes_zip_filename != NULL && image_classes_filename == NULL) {
     Usage("--image-classes-zip should be used with --image-classes");
   }
@@ -809,6 +1142,20 @@ static int dex2oat(int argc, char** argv) {
   // Done with usage checks, enable watchdog if requested
   WatchDog watch_dog(watch_dog_enabled);
 
+  // Open the previous oat file before the output, which may replace it.
+  UniquePtr<const OatFile> previous_oat_file;
+  if (!previous_oat_filename.empty()) {
+    if (previous_oat_filename == oat_unstripped) {
+      Usage("--previous-oat-file should not be the output oat file");
+    }
+    previous_oat_file.reset(OatFile::Open(previous_oat_filename, previous_oat_filename, NULL,
+                                          false));
+    if (previous_oat_file.get() == NULL) {
+      LOG(WARNING) << "Compiling from scratch, failed to open previous oat file "
+                   << previous_oat_filename;
+    }
+  }
+
   // Check early that the result of compilation can be written
   UniquePtr<File> oat_file;
   bool create_file = !oat_unstripped.empty();  // as opposed to using open file descriptor
@@ -871,7 +1218,8 @@ static int dex2oat(int argc, char** argv) {
 #endif
 
   Dex2Oat* p_dex2oat;
-  if (!Dex2Oat::Create(&p_dex2oat, options, compiler_backend, instruction_set, thread_count)) {
+  if (!Dex2Oat::Create(&p_dex2oat, options, compiler_backend, instruction_set,
+                       instruction_set_features, thread_count)) {
     LOG(ERROR) << "Failed to create dex2oat";
     return EXIT_FAILURE;
   }
@@ -901,11 +1249,27 @@ static int dex2oat(int argc, char** argv) {
     }
   }
 
+  UniquePtr<CompilerDriver::DescriptorSet> dirty_image_classes(NULL);
+  if (dirty_image_objects_filename != NULL) {
+    dirty_image_classes.reset(dex2oat->ReadImageClassesFromFile(dirty_image_objects_filename));
+    if (dirty_image_classes.get() == NULL) {
+      LOG(ERROR) << "Failed to read dirty image classes from " << dirty_image_objects_filename;
+      return EXIT_FAILURE;
+    }
+  }
+
   std::vector<const DexFile*> dex_files;
+  // The stat of the file the single dex location names, recorded in the oat header so the
+  // runtime can skip reading the dex checksum out of an unchanged file.
+  struct stat dex_location_stat;
+  struct stat* dex_location_stat_ptr = NULL;
   if (boot_image_option.empty()) {
     dex_files = Runtime::Current()->GetClassLinker()->GetBootClassPath();
   } else {
     if (dex_filenames.empty()) {
+      if (TEMP_FAILURE_RETRY(fstat(zip_fd, &dex_location_stat)) == 0) {
+        dex_location_stat_ptr = &dex_location_stat;
+      }
       UniquePtr<ZipArchive> zip_archive(ZipArchive::OpenFromFd(zip_fd, image_classes_zip_filename));
       if (zip_archive.get() == NULL) {
         LOG(ERROR) << "Failed to open zip from file descriptor for " << zip_location;
@@ -923,6 +1287,11 @@ static int dex2oat(int argc, char** argv) {
         LOG(ERROR) << "Failed to open some dex files: " << failure_count;
         return EXIT_FAILURE;
       }
+      // Only a file compiled in place can be recognized by its stat later.
+      if (dex_filenames.size() == 1 && strcmp(dex_filenames[0], dex_locations[0]) == 0 &&
+          TEMP_FAILURE_RETRY(stat(dex_filenames[0], &dex_location_stat)) == 0) {
+        dex_location_stat_ptr = &dex_location_stat;
+      }
     }
 
     // Ensure opened dex files are writable for dex-to-dex transformations.
@@ -950,16 +1319,48 @@ static int dex2oat(int argc, char** argv) {
     }
   }
 
+  UniquePtr<MethodProfile> method_profile;
+  if (!profile_filename.empty()) {
+    method_profile.reset(new MethodProfile);
+    if (!method_profile->ReadFromFile(profile_filename)) {
+      LOG(ERROR) << "Failed to read profile file " << profile_filename;
+      return EXIT_FAILURE;
+    }
+  }
+
+  // The driver takes ownership of the spill space.
+  SpillSpace* spill_space = NULL;
+  if (memory_budget_mb != 0) {
+    const char* tmp_dir = getenv("TMPDIR");
+    std::string error_msg;
+    spill_space = SpillSpace::Create(tmp_dir != NULL ? tmp_dir : "/tmp", &error_msg);
+    if (spill_space == NULL) {
+      LOG(ERROR) << error_msg;
+      return EXIT_FAILURE;
+    }
+  }
+
   UniquePtr<const CompilerDriver> compiler(dex2oat->CreateOatFile(boot_image_option,
                                                                   host_prefix.get(),
                                                                   android_root,
                                                                   is_host,
                                                                   dex_files,
                                                                   oat_file.get(),
+                                                                  dex_location_stat_ptr,
                                                                   bitcode_filename,
+                                                                  compilation_cache_dir,
+                                                                  method_batch_size,
                                                                   image,
                                                                   image_classes,
                                                                   dump_stats,
+                                                                  memory_budget_mb * MB,
+                                                                  spill_space,
+                                                                  method_profile.get(),
+                                                                  profile_hot_threshold,
+                                                                  compress_cold_code,
+                                                                  previous_oat_file.get(),
+                                                                  linear_scan_methods,
+                                                                  align_text_to_huge_pages,
                                                                   timings));
 
   if (compiler.get() == NULL) {
@@ -1025,16 +1426,33 @@ static int dex2oat(int argc, char** argv) {
                                                            image_base,
                                                            oat_unstripped,
                                                            oat_location,
-                                                           *compiler.get());
+                                                           *compiler.get(),
+                                                           dirty_image_classes.get(),
+                                                           read_only_dex_caches,
+                                                           timings);
     if (!image_creation_success) {
       return EXIT_FAILURE;
     }
     VLOG(compiler) << "Image written successfully: " << image_filename;
   }
 
+  if (!app_image_filename.empty()) {
+    timings.NewSplit("dex2oat ImageWriter");
+    if (!dex2oat->CreateAppImageFile(app_image_filename, oat_file.get(), oat_location, dex_files,
+                                     *compiler.get(), timings)) {
+      return EXIT_FAILURE;
+    }
+    VLOG(compiler) << "App image written successfully: " << app_image_filename;
+  }
+
   if (is_host) {
+    timings.EndSplit();
+    if (!timing_report_filename.empty()) {
+      WriteTimingReport(timing_report_filename, timings, thread_count);
+    }
     if (dump_timing || (dump_slow_timing && timings.GetTotalNs() > MsToNs(1000))) {
       LOG(INFO) << Dumpable<base::TimingLogger>(timings);
+      LOG(INFO) << Dumpable<const ArenaPool>(compiler->GetArenaPool());
     }
     return EXIT_SUCCESS;
   }
@@ -1074,8 +1492,12 @@ static int dex2oat(int argc, char** argv) {
 
   timings.EndSplit();
 
+  if (!timing_report_filename.empty()) {
+    WriteTimingReport(timing_report_filename, timings, thread_count);
+  }
   if (dump_timing || (dump_slow_timing && timings.GetTotalNs() > MsToNs(1000))) {
     LOG(INFO) << Dumpable<base::TimingLogger>(timings);
+    LOG(INFO) << Dumpable<const ArenaPool>(compiler->GetArenaPool());
   }
 
   // Everything was successfully written, do an explicit exit here to avoid running Runtime
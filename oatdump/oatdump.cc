@@ -17,8 +17,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
+#include <map>
 #include <string>
 #include <vector>
 
@@ -36,6 +38,7 @@
 #include "image.h"
 #include "indenter.h"
 #include "mapping_table.h"
+#include "method_profile.h"
 #include "mirror/art_field-inl.h"
 #include "mirror/art_method-inl.h"
 #include "mirror/array-inl.h"
@@ -77,6 +80,16 @@ static void usage() {
           "      Example: --host-prefix=out/target/product/crespo\n"
           "      Default: $ANDROID_PRODUCT_OUT\n"
           "\n");
+  fprintf(stderr,
+          "  --profile-file=<file>: with --oat-file, count the pages holding the code of the\n"
+          "      methods run in the profile, for instance one recorded at startup.\n"
+          "      Example: --profile-file=/data/local/tmp/startup.profile\n"
+          "\n");
+  fprintf(stderr,
+          "  --report: with --oat-file, instead of dumping it print the size of the code and\n"
+          "      tables of every method, class and package, how well they were deduplicated and,\n"
+          "      with --profile-file, how many pages the profiled methods touch, a line each.\n"
+          "\n");
   fprintf(stderr,
           "  --output=<file> may be used to send the output to a file.\n"
           "      Example: --output=/tmp/oatdump.txt\n"
@@ -92,14 +105,17 @@ const char* image_roots_descriptions_[] = {
   "kOatLocation",
   "kDexCaches",
   "kClassRoots",
+  "kInternedStrings",
 };
 
 class OatDumper {
  public:
-  explicit OatDumper(const std::string& host_prefix, const OatFile& oat_file)
+  explicit OatDumper(const std::string& host_prefix, const OatFile& oat_file,
+                     MethodProfile* method_profile = NULL)
     : host_prefix_(host_prefix),
       oat_file_(oat_file),
       oat_dex_files_(oat_file.GetOatDexFiles()),
+      method_profile_(method_profile),
       disassembler_(Disassembler::Create(oat_file_.GetOatHeader().GetInstructionSet())) {
     AddAllOffsets();
   }
@@ -142,6 +158,10 @@ class OatDumper {
     os << "END:\n";
     os << reinterpret_cast<const void*>(oat_file_.End()) << "\n\n";
 
+    if (method_profile_ != NULL) {
+      DumpProfiledPages(os);
+    }
+
     os << std::flush;
 
     for (size_t i = 0; i < oat_dex_files_.size(); i++) {
@@ -151,6 +171,104 @@ class OatDumper {
     }
   }
 
+  // Dumps one line per method, class, package, table kind and profile summary, each starting with
+  // its kind and with the name, which may hold spaces, last, for scripts to sort and sum. Sizes are
+  // the bytes stored in the oat file, code stored deflated counts its deflated size.
+  void DumpReport(std::ostream& os) {
+    os << "# method <code> <mapping_table> <vmap_table> <gc_map> <invocations> <backedges>"
+       << " <name>\n";
+    os << "# class <methods> <code> <tables> <descriptor>\n";
+    os << "# package <classes> <methods> <code> <tables> <name>\n";
+    os << "# dedupe <kind> <references> <unique> <referenced_bytes> <unique_bytes>\n";
+    os << "# overhead <kind> <bytes> <percent_of_code>\n";
+    os << "# hot_pages <hot_methods> <hot_method_pages> <all_method_pages>\n";
+    std::map<std::string, ReportSizes> packages;
+    TableStats code_stats;
+    TableStats mapping_table_stats;
+    TableStats vmap_table_stats;
+    TableStats gc_map_stats;
+    std::set<uintptr_t> hot_pages;
+    std::set<uintptr_t> all_pages;
+    size_t num_hot_methods = 0;
+    for (size_t i = 0; i < oat_dex_files_.size(); i++) {
+      const OatFile::OatDexFile* oat_dex_file = oat_dex_files_[i];
+      CHECK(oat_dex_file != NULL);
+      UniquePtr<const DexFile> dex_file(oat_dex_file->OpenDexFile());
+      if (dex_file.get() == NULL) {
+        continue;
+      }
+      for (size_t class_def_index = 0; class_def_index < dex_file->NumClassDefs(); class_def_index++) {
+        const DexFile::ClassDef& class_def = dex_file->GetClassDef(class_def_index);
+        const char* descriptor = dex_file->GetClassDescriptor(class_def);
+        UniquePtr<const OatFile::OatClass> oat_class(oat_dex_file->GetOatClass(class_def_index));
+        ReportSizes class_sizes;
+        const byte* class_data = dex_file->GetClassData(class_def);
+        if (class_data != NULL) {
+          ClassDataItemIterator it(*dex_file, class_data);
+          SkipAllFields(it);
+          for (uint32_t class_method_index = 0; it.HasNext(); class_method_index++, it.Next()) {
+            const OatFile::OatMethod oat_method = oat_class->GetOatMethod(class_method_index);
+            const size_t code_size = code_stats.Add(GetStoredCodeOffset(oat_method),
+                                                    GetStoredCodeSize(oat_method));
+            const size_t mapping_table_size = AddTable(oat_method.GetMappingTableOffset(),
+                                                       &mapping_table_stats);
+            const size_t vmap_table_size = AddTable(oat_method.GetVmapTableOffset(),
+                                                    &vmap_table_stats);
+            const size_t gc_map_size = AddTable(oat_method.GetNativeGcMapOffset(), &gc_map_stats);
+            AddPages(oat_method, &all_pages);
+            MethodProfile::Counts counts = {0, 0};
+            if (method_profile_ != NULL) {
+              const MethodProfile::Counts* found =
+                  method_profile_->FindCounts(*dex_file, it.GetMemberIndex());
+              if (found != NULL) {
+                counts = *found;
+              }
+              if (counts.invocations != 0 || counts.backedges != 0) {
+                AddPages(oat_method, &hot_pages);
+                num_hot_methods++;
+              }
+            }
+            os << StringPrintf("method %zd %zd %zd %zd %u %u %s\n", code_size,
+                               mapping_table_size, vmap_table_size, gc_map_size,
+                               counts.invocations, counts.backedges,
+                               PrettyMethod(it.GetMemberIndex(), *dex_file, true).c_str());
+            class_sizes.methods++;
+            class_sizes.code += code_size;
+            class_sizes.tables += mapping_table_size + vmap_table_size + gc_map_size;
+          }
+        }
+        os << StringPrintf("class %zd %zd %zd %s\n", class_sizes.methods, class_sizes.code,
+                           class_sizes.tables, descriptor);
+        std::string package(DescriptorToDot(descriptor));
+        size_t last_dot = package.rfind('.');
+        package.erase(last_dot == std::string::npos ? 0 : last_dot);
+        ReportSizes& package_sizes = packages[package];
+        package_sizes.classes++;
+        package_sizes.methods += class_sizes.methods;
+        package_sizes.code += class_sizes.code;
+        package_sizes.tables += class_sizes.tables;
+      }
+    }
+    typedef std::map<std::string, ReportSizes>::const_iterator It;
+    for (It it = packages.begin(); it != packages.end(); ++it) {
+      os << StringPrintf("package %zd %zd %zd %zd %s\n", it->second.classes, it->second.methods,
+                         it->second.code, it->second.tables,
+                         it->first.empty() ? "<default>" : it->first.c_str());
+    }
+    code_stats.Dump(os, "code");
+    mapping_table_stats.Dump(os, "mapping_table");
+    vmap_table_stats.Dump(os, "vmap_table");
+    gc_map_stats.Dump(os, "gc_map");
+    DumpOverhead(os, "mapping_table", mapping_table_stats.unique_bytes, code_stats.unique_bytes);
+    DumpOverhead(os, "vmap_table", vmap_table_stats.unique_bytes, code_stats.unique_bytes);
+    DumpOverhead(os, "gc_map", gc_map_stats.unique_bytes, code_stats.unique_bytes);
+    if (method_profile_ != NULL) {
+      os << StringPrintf("hot_pages %zd %zd %zd\n", num_hot_methods, hot_pages.size(),
+                         all_pages.size());
+    }
+    os << std::flush;
+  }
+
   size_t ComputeSize(const void* oat_data) {
     if (reinterpret_cast<const byte*>(oat_data) < oat_file_.Begin() ||
         reinterpret_cast<const byte*>(oat_data) > oat_file_.End()) {
@@ -230,12 +348,136 @@ class OatDumper {
     offsets_.insert(static_cast<uint32_t>(oat_file_.Size()));
   }
 
-  void AddOffsets(const OatFile::OatMethod& oat_method) {
-    uint32_t code_offset = oat_method.GetCodeOffset();
+  // Counts the pages holding the code and tables of the methods the profile saw run, which is
+  // what running the profiled workload again faults in, against the pages of all methods.
+  void DumpProfiledPages(std::ostream& os) {
+    std::set<uintptr_t> profiled_pages;
+    std::set<uintptr_t> all_pages;
+    size_t num_profiled_methods = 0;
+    for (size_t i = 0; i < oat_dex_files_.size(); i++) {
+      const OatFile::OatDexFile* oat_dex_file = oat_dex_files_[i];
+      CHECK(oat_dex_file != NULL);
+      UniquePtr<const DexFile> dex_file(oat_dex_file->OpenDexFile());
+      if (dex_file.get() == NULL) {
+        continue;
+      }
+      for (size_t class_def_index = 0; class_def_index < dex_file->NumClassDefs(); class_def_index++) {
+        const DexFile::ClassDef& class_def = dex_file->GetClassDef(class_def_index);
+        UniquePtr<const OatFile::OatClass> oat_class(oat_dex_file->GetOatClass(class_def_index));
+        const byte* class_data = dex_file->GetClassData(class_def);
+        if (class_data == NULL) {
+          continue;
+        }
+        ClassDataItemIterator it(*dex_file, class_data);
+        SkipAllFields(it);
+        for (uint32_t class_method_index = 0; it.HasNext(); class_method_index++, it.Next()) {
+          const OatFile::OatMethod oat_method = oat_class->GetOatMethod(class_method_index);
+          AddPages(oat_method, &all_pages);
+          const MethodProfile::Counts* counts =
+              method_profile_->FindCounts(*dex_file, it.GetMemberIndex());
+          if (counts != NULL && (counts->invocations != 0 || counts->backedges != 0)) {
+            AddPages(oat_method, &profiled_pages);
+            num_profiled_methods++;
+          }
+        }
+      }
+    }
+    os << "PROFILED PAGES:\n";
+    os << StringPrintf("%zd methods on %zd of %zd pages\n\n", num_profiled_methods,
+                       profiled_pages.size(), all_pages.size());
+  }
+
+  // Sizes summed over the methods of a class or package for DumpReport.
+  struct ReportSizes {
+    ReportSizes() : classes(0), methods(0), code(0), tables(0) {}
+    size_t classes;
+    size_t methods;
+    size_t code;
+    size_t tables;
+  };
+
+  // How well the compiler driver's deduplication shared one kind of code or table between methods.
+  struct TableStats {
+    TableStats() : references(0), referenced_bytes(0), unique_bytes(0) {}
+
+    // Counts a method's reference to the data at offset, returns its size.
+    size_t Add(uint32_t offset, size_t size) {
+      if (offset == 0) {
+        return 0;
+      }
+      references++;
+      referenced_bytes += size;
+      if (offsets.insert(offset).second) {
+        unique_bytes += size;
+      }
+      return size;
+    }
+
+    void Dump(std::ostream& os, const char* kind) const {
+      os << StringPrintf("dedupe %s %zd %zd %zd %zd\n", kind, references, offsets.size(),
+                         referenced_bytes, unique_bytes);
+    }
+
+    size_t references;
+    size_t referenced_bytes;
+    size_t unique_bytes;
+    std::set<uint32_t> offsets;
+  };
+
+  size_t AddTable(uint32_t offset, TableStats* stats) {
+    return stats->Add(offset, offset == 0 ? 0 : ComputeSize(oat_file_.Begin() + offset));
+  }
+
+  static void DumpOverhead(std::ostream& os, const char* kind, size_t bytes, size_t code_bytes) {
+    os << StringPrintf("overhead %s %zd %.2f\n", kind, bytes,
+                       code_bytes == 0 ? 0.0 : (100.0 * bytes) / code_bytes);
+  }
+
+  uint32_t GetStoredCodeOffset(const OatFile::OatMethod& oat_method) {
+    uint32_t code_offset = oat_method.GetCodeOffset() & ~OatMethodOffsets::kCompressedCodeFlag;
     if (oat_file_.GetOatHeader().GetInstructionSet() == kThumb2) {
       code_offset &= ~0x1;
     }
-    offsets_.insert(code_offset);
+    return code_offset;
+  }
+
+  // The size of the code as stored, deflated if it is compressed.
+  size_t GetStoredCodeSize(const OatFile::OatMethod& oat_method) {
+    uint32_t code_offset = GetStoredCodeOffset(oat_method);
+    if (code_offset == 0) {
+      return 0;
+    }
+    if (oat_method.IsCodeCompressed()) {
+      return ComputeSize(oat_file_.Begin() + code_offset);
+    }
+    return oat_method.GetCodeSize();
+  }
+
+  void AddPages(const OatFile::OatMethod& oat_method, std::set<uintptr_t>* pages) {
+    AddPages(GetStoredCodeOffset(oat_method), pages);
+    AddPages(oat_method.GetMappingTableOffset(), pages);
+    AddPages(oat_method.GetVmapTableOffset(), pages);
+    AddPages(oat_method.GetNativeGcMapOffset(), pages);
+  }
+
+  void AddPages(uint32_t offset, std::set<uintptr_t>* pages) {
+    if (offset == 0) {
+      return;
+    }
+    const byte* begin = oat_file_.Begin() + offset;
+    const size_t size = ComputeSize(begin);
+    if (size == 0) {
+      return;
+    }
+    const uintptr_t first_page = reinterpret_cast<uintptr_t>(begin) / kPageSize;
+    const uintptr_t last_page = (reinterpret_cast<uintptr_t>(begin) + size - 1) / kPageSize;
+    for (uintptr_t page = first_page; page <= last_page; ++page) {
+      pages->insert(page);
+    }
+  }
+
+  void AddOffsets(const OatFile::OatMethod& oat_method) {
+    offsets_.insert(GetStoredCodeOffset(oat_method));
     offsets_.insert(oat_method.GetMappingTableOffset());
     offsets_.insert(oat_method.GetVmapTableOffset());
     offsets_.insert(oat_method.GetNativeGcMapOffset());
@@ -355,10 +597,11 @@ class OatDumper {
       }
     }
     {
-      indent1_os << StringPrintf("CODE: %p (offset=0x%08x size=%d)%s\n",
+      indent1_os << StringPrintf("CODE: %p (offset=0x%08x size=%d%s)%s\n",
                                  oat_method.GetCode(),
                                  oat_method.GetCodeOffset(),
                                  oat_method.GetCodeSize(),
+                                 oat_method.IsCodeCompressed() ? " compressed" : "",
                                  oat_method.GetCode() != NULL ? "..." : "");
       Indenter indent2_filter(indent1_os.rdbuf(), kIndentChar, kIndentBy1Count);
       std::ostream indent2_os(&indent2_filter);
@@ -495,6 +738,22 @@ class OatDumper {
         }
         os << "}\n";
       }
+      if (table.PcToDexSize() != 0) {
+        typedef MappingTable::PcToDexIterator It;
+        os << "catch handlers {\n";
+        for (It cur = table.PcToDexBegin(), end = table.PcToDexEnd(); cur != end; ++cur) {
+          MappingTable::CatchHandlerIterator it = table.FindCatchHandlers(cur.NativePcOffset());
+          for (; it.HasNext(); it.Next()) {
+            indent_os << StringPrintf("0x%04x -> 0x%04x (dex PC 0x%04x", cur.NativePcOffset(),
+                                      it.GetHandlerNativePcOffset(), it.GetHandlerDexPc());
+            if (!it.IsCatchAll()) {
+              indent_os << StringPrintf(", type_idx=%d", it.GetHandlerTypeIndex());
+            }
+            indent_os << ")\n";
+          }
+        }
+        os << "}\n";
+      }
     }
   }
 
@@ -657,6 +916,7 @@ class OatDumper {
   const OatFile& oat_file_;
   std::vector<const OatFile::OatDexFile*> oat_dex_files_;
   std::set<uint32_t> offsets_;
+  MethodProfile* const method_profile_;
   UniquePtr<Disassembler> disassembler_;
 };
 
@@ -687,6 +947,12 @@ class ImageDumper {
 
     os << "OAT FILE END:" << reinterpret_cast<void*>(image_header_.GetOatFileEnd()) << "\n\n";
 
+    if (image_header_.GetReadOnlyDexCacheArraysEnd() != 0) {
+      os << "READ-ONLY DEX CACHE ARRAYS: "
+         << reinterpret_cast<void*>(image_header_.GetReadOnlyDexCacheArraysBegin()) << "-"
+         << reinterpret_cast<void*>(image_header_.GetReadOnlyDexCacheArraysEnd()) << "\n\n";
+    }
+
     {
       os << "ROOTS: " << reinterpret_cast<void*>(image_header_.GetImageRoots()) << "\n";
       Indenter indent1_filter(os.rdbuf(), kIndentChar, kIndentBy1Count);
@@ -1055,6 +1321,29 @@ class ImageDumper {
       }
     }
     state->stats_.Update(ClassHelper(obj_class).GetDescriptor(), object_bytes);
+    if (!obj_class->IsArrayClass() && !obj->IsClass()) {
+      state->stats_.UpdateInstanceWaste(ClassHelper(obj_class).GetDescriptor(), obj_class);
+    }
+  }
+
+  // Returns the bytes of an instance of klass that no field uses: words left in front of 64-bit
+  // fields to align them, the unused part of the word each boolean, byte, char and short field
+  // takes, and the rounding of the size to kObjectAlignment. The object header is made of fields
+  // of java.lang.Object.
+  static size_t InstanceWasteBytes(mirror::Class* klass)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
+    size_t used_bytes = 0;
+    FieldHelper fh;
+    for (mirror::Class* c = klass; c != NULL; c = c->GetSuperClass()) {
+      mirror::ObjectArray<mirror::ArtField>* fields = c->GetIFields();
+      for (size_t i = 0; i < c->NumInstanceFields(); ++i) {
+        fh.ChangeField(fields->Get(i));
+        used_bytes += Primitive::ComponentSize(fh.GetTypeAsPrimitiveType());
+      }
+    }
+    size_t size = RoundUp(klass->GetObjectSize(), kObjectAlignment);
+    DCHECK_GE(size, used_bytes) << PrettyDescriptor(klass);
+    return size - used_bytes;
   }
 
   std::set<const void*> already_seen_;
@@ -1126,6 +1415,25 @@ class ImageDumper {
     typedef SafeMap<std::string, SizeAndCount> SizeAndCountTable;
     SizeAndCountTable sizes_and_counts;
 
+    // Bytes of each instance of a class that no field uses, and the number of instances.
+    struct InstanceWaste {
+      InstanceWaste(size_t bytes, size_t count) : bytes(bytes), count(count) {}
+      size_t bytes;
+      size_t count;
+    };
+    typedef SafeMap<std::string, InstanceWaste> InstanceWasteTable;
+    InstanceWasteTable instance_waste;
+
+    void UpdateInstanceWaste(const std::string& descriptor, mirror::Class* klass)
+        SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
+      InstanceWasteTable::iterator it = instance_waste.find(descriptor);
+      if (it != instance_waste.end()) {
+        it->second.count += 1;
+      } else {
+        instance_waste.Put(descriptor, InstanceWaste(InstanceWasteBytes(klass), 1));
+      }
+    }
+
     void Update(const std::string& descriptor, size_t object_bytes) {
       SizeAndCountTable::iterator it = sizes_and_counts.find(descriptor);
       if (it != sizes_and_counts.end()) {
@@ -1255,6 +1563,30 @@ class ImageDumper {
       os << "\n" << std::flush;
     }
 
+    // Lists the classes whose instances have bytes no field uses, most total bytes first.
+    void DumpInstanceWaste(std::ostream& os) {
+      std::vector<std::pair<size_t, std::string> > totals;
+      size_t total_bytes = 0;
+      for (const auto& waste : instance_waste) {
+        if (waste.second.bytes != 0) {
+          size_t bytes = waste.second.bytes * waste.second.count;
+          totals.push_back(std::make_pair(bytes, waste.first));
+          total_bytes += bytes;
+        }
+      }
+      std::sort(totals.rbegin(), totals.rend());
+      os << StringPrintf("instance_waste_bytes = %zd (%2.0f%% of object_bytes)\n",
+                         total_bytes, PercentOfObjectBytes(total_bytes));
+      Indenter indent_filter(os.rdbuf(), kIndentChar, kIndentBy1Count);
+      std::ostream indent_os(&indent_filter);
+      for (const std::pair<size_t, std::string>& total : totals) {
+        const InstanceWaste& waste = instance_waste.find(total.second)->second;
+        indent_os << StringPrintf("%32s %8zd bytes %6zd instances (%zd bytes/instance)\n",
+                                  total.second.c_str(), total.first, waste.count, waste.bytes);
+      }
+      os << "\n" << std::flush;
+    }
+
     void Dump(std::ostream& os) SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
       {
         os << "art_file_bytes = " << PrettySize(file_bytes) << "\n\n"
@@ -1289,6 +1621,8 @@ class ImageDumper {
       os << "\n" << std::flush;
       CHECK_EQ(object_bytes, object_bytes_total);
 
+      DumpInstanceWaste(os);
+
       os << StringPrintf("oat_file_bytes               = %8zd\n"
                          "managed_code_bytes           = %8zd (%2.0f%% of oat file bytes)\n"
                          "managed_to_native_code_bytes = %8zd (%2.0f%% of oat file bytes)\n"
@@ -1365,6 +1699,8 @@ static int oatdump(int argc, char** argv) {
   const char* boot_image_filename = NULL;
   std::string elf_filename_prefix;
   UniquePtr<std::string> host_prefix;
+  const char* profile_filename = NULL;
+  bool report = false;
   std::ostream* os = &std::cout;
   UniquePtr<std::ofstream> out;
 
@@ -1378,6 +1714,10 @@ static int oatdump(int argc, char** argv) {
       boot_image_filename = option.substr(strlen("--boot-image=")).data();
     } else if (option.starts_with("--host-prefix=")) {
       host_prefix.reset(new std::string(option.substr(strlen("--host-prefix=")).data()));
+    } else if (option.starts_with("--profile-file=")) {
+      profile_filename = option.substr(strlen("--profile-file=")).data();
+    } else if (option == "--report") {
+      report = true;
     } else if (option.starts_with("--output=")) {
       const char* filename = option.substr(strlen("--output=")).data();
       out.reset(new std::ofstream(filename));
@@ -1402,6 +1742,11 @@ static int oatdump(int argc, char** argv) {
     return EXIT_FAILURE;
   }
 
+  if (report && oat_filename == NULL) {
+    fprintf(stderr, "--report requires --oat-file\n");
+    return EXIT_FAILURE;
+  }
+
   if (host_prefix.get() == NULL) {
     const char* android_product_out = getenv("ANDROID_PRODUCT_OUT");
     if (android_product_out != NULL) {
@@ -1418,8 +1763,20 @@ static int oatdump(int argc, char** argv) {
       fprintf(stderr, "Failed to open oat file from %s\n", oat_filename);
       return EXIT_FAILURE;
     }
-    OatDumper oat_dumper(*host_prefix.get(), *oat_file);
-    oat_dumper.Dump(*os);
+    UniquePtr<MethodProfile> method_profile;
+    if (profile_filename != NULL) {
+      method_profile.reset(new MethodProfile);
+      if (!method_profile->ReadFromFile(profile_filename)) {
+        fprintf(stderr, "Failed to read profile file %s\n", profile_filename);
+        return EXIT_FAILURE;
+      }
+    }
+    OatDumper oat_dumper(*host_prefix.get(), *oat_file, method_profile.get());
+    if (report) {
+      oat_dumper.DumpReport(*os);
+    } else {
+      oat_dumper.Dump(*os);
+    }
     return EXIT_SUCCESS;
   }
 
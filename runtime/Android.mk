@@ -34,6 +34,7 @@ LIBART_COMMON_SRC_FILES := \
 	check_jni.cc \
 	class_linker.cc \
 	common_throws.cc \
+	cycle_clock.cc \
 	debugger.cc \
 	dex_file.cc \
 	dex_file_verifier.cc \
@@ -43,7 +44,9 @@ LIBART_COMMON_SRC_FILES := \
 	disassembler_mips.cc \
 	disassembler_x86.cc \
 	elf_file.cc \
+	fault_handler.cc \
 	gc/allocator/dlmalloc.cc \
+	gc/allocation_sampler.cc \
 	gc/accounting/card_table.cc \
 	gc/accounting/gc_allocator.cc \
 	gc/accounting/heap_bitmap.cc \
@@ -53,16 +56,20 @@ LIBART_COMMON_SRC_FILES := \
 	gc/collector/mark_sweep.cc \
 	gc/collector/partial_mark_sweep.cc \
 	gc/collector/sticky_mark_sweep.cc \
+	gc/gc_event_log.cc \
 	gc/heap.cc \
 	gc/space/dlmalloc_space.cc \
 	gc/space/image_space.cc \
 	gc/space/large_object_space.cc \
+	gc/space/run_alloc_space.cc \
 	gc/space/space.cc \
+	hot_method_compiler.cc \
 	hprof/hprof.cc \
 	image.cc \
 	indirect_reference_table.cc \
 	instrumentation.cc \
 	intern_table.cc \
+	interpreter/decoded_code.cc \
 	interpreter/interpreter.cc \
 	jdwp/jdwp_event.cc \
 	jdwp/jdwp_expand_buf.cc \
@@ -75,7 +82,9 @@ LIBART_COMMON_SRC_FILES := \
 	jobject_comparator.cc \
 	locks.cc \
 	mem_map.cc \
+	member_index.cc \
 	memory_region.cc \
+	method_profile.cc \
 	mirror/art_field.cc \
 	mirror/art_method.cc \
 	mirror/array.cc \
@@ -109,6 +118,7 @@ LIBART_COMMON_SRC_FILES := \
 	native/org_apache_harmony_dalvik_ddmc_DdmServer.cc \
 	native/org_apache_harmony_dalvik_ddmc_DdmVmInternal.cc \
 	native/sun_misc_Unsafe.cc \
+	numa.cc \
 	oat.cc \
 	oat_file.cc \
 	offsets.cc \
@@ -119,9 +129,12 @@ LIBART_COMMON_SRC_FILES := \
 	runtime.cc \
 	signal_catcher.cc \
 	stack.cc \
+	startup_page_profile.cc \
+	startup_timeline.cc \
 	thread.cc \
 	thread_list.cc \
 	thread_pool.cc \
+	thread_stack_cache.cc \
 	throw_location.cc \
 	trace.cc \
 	utf.cc \
@@ -139,6 +152,7 @@ LIBART_COMMON_SRC_FILES += \
 	arch/context.cc \
 	arch/arm/registers_arm.cc \
 	arch/x86/registers_x86.cc \
+	arch/x86_64/registers_x86_64.cc \
 	arch/mips/registers_mips.cc \
 	entrypoints/entrypoint_utils.cc \
 	entrypoints/interpreter/interpreter_entrypoints.cc \
@@ -16,11 +16,101 @@
 
 #include "barrier.h"
 
-#include "base/mutex.h"
+#include <errno.h>
+#include <limits.h>
+
+#include "base/mutex-inl.h"
 #include "thread.h"
 
 namespace art {
 
+#if ART_USE_FUTEXES
+
+// How many times a waiter checks for a new generation before sleeping.
+static constexpr int kBarrierSpinCount = 100;
+
+static constexpr int kBarrierCountBits = 16;
+static constexpr uint32_t kBarrierCountMask = (1U << kBarrierCountBits) - 1;
+
+static int BarrierCount(int32_t state) {
+  return static_cast<int16_t>(static_cast<uint32_t>(state) & kBarrierCountMask);
+}
+
+static uint32_t BarrierGeneration(int32_t state) {
+  return static_cast<uint32_t>(state) >> kBarrierCountBits;
+}
+
+Barrier::Barrier(int count)
+    : state_(0),
+      num_waiters_(0) {
+  AddToCount(count, true);
+}
+
+int32_t Barrier::AddToCount(int delta, bool set) {
+  int32_t old_state;
+  int32_t new_state;
+  int count;
+  do {
+    old_state = state_;
+    count = set ? delta : BarrierCount(old_state) + delta;
+    DCHECK_EQ(count, static_cast<int16_t>(count)) << "Barrier count out of range";
+    uint32_t generation = BarrierGeneration(old_state);
+    if (count == 0 && (set || delta != 0)) {
+      ++generation;
+    }
+    new_state = static_cast<int32_t>((generation << kBarrierCountBits) |
+                                     (static_cast<uint32_t>(count) & kBarrierCountMask));
+  } while (android_atomic_cas(old_state, new_state, &state_) != 0);
+  // The compare-and-swap is a full barrier, so a waiter has either registered itself in
+  // num_waiters_ or will see the new generation before sleeping.
+  if (BarrierGeneration(new_state) != BarrierGeneration(old_state) && num_waiters_ != 0) {
+    futex(&state_, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+  }
+  return new_state;
+}
+
+void Barrier::Pass(Thread* /* self */) {
+  AddToCount(-1, false);
+}
+
+void Barrier::Wait(Thread* self) {
+  Increment(self, -1);
+}
+
+void Barrier::Init(Thread* /* self */, int count) {
+  AddToCount(count, true);
+}
+
+void Barrier::Increment(Thread* /* self */, int delta) {
+  const int32_t state = AddToCount(delta, false);
+  if (BarrierCount(state) == 0) {
+    return;
+  }
+  const uint32_t generation = BarrierGeneration(state);
+  for (int i = 0; i < kBarrierSpinCount; ++i) {
+    if (BarrierGeneration(state_) != generation) {
+      ANDROID_MEMBAR_FULL();
+      return;
+    }
+  }
+  android_atomic_inc(&num_waiters_);
+  int32_t current_state;
+  while (BarrierGeneration(current_state = state_) == generation) {
+    // Returns straight away if the state is no longer the one read.
+    if (futex(&state_, FUTEX_WAIT, current_state, NULL, NULL, 0) != 0 && errno != EAGAIN &&
+        errno != EINTR) {
+      PLOG(FATAL) << "futex wait failed for barrier";
+    }
+  }
+  android_atomic_dec(&num_waiters_);
+}
+
+Barrier::~Barrier() {
+  CHECK(!BarrierCount(state_)) << "Attempted to destroy barrier with non zero count";
+}
+
+#else  // ART_USE_FUTEXES
+
 Barrier::Barrier(int count)
     : count_(count),
       lock_("GC barrier lock"),
@@ -60,4 +150,6 @@ Barrier::~Barrier() {
   CHECK(!count_) << "Attempted to destroy barrier with non zero count";
 }
 
+#endif  // ART_USE_FUTEXES
+
 }  // namespace art
@@ -23,6 +23,10 @@
 
 namespace art {
 
+// Counts down to zero, releasing the threads waiting on it when it gets there. Where futexes are
+// available, passing the barrier is a compare-and-swap, and only the thread bringing the count to
+// zero makes a system call, and then only if somebody is asleep. Waiters spin briefly before
+// sleeping, as the GC's checkpoints usually complete quickly.
 class Barrier {
  public:
   explicit Barrier(int count);
@@ -42,6 +46,18 @@ class Barrier {
   void Increment(Thread* self, int delta);
 
  private:
+#if ART_USE_FUTEXES
+  // Adds delta to the count, starting a new generation and waking the waiters if it reaches
+  // zero, and returns the new state.
+  int32_t AddToCount(int delta, bool set);
+
+  // The count in the low kBarrierCountBits bits and, above them, how many times it has reached
+  // zero. Waiters wait for the generation to change rather than for the count to be zero, which
+  // it needn't still be by the time they look.
+  volatile int32_t state_;
+  // Number of threads sleeping, or about to sleep, on state_.
+  volatile int32_t num_waiters_;
+#else
   void SetCountLocked(Thread* self, int count) EXCLUSIVE_LOCKS_REQUIRED(lock_);
 
   // Counter, when this reaches 0 all people blocked on the barrier are signalled.
@@ -49,6 +65,7 @@ class Barrier {
 
   Mutex lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
   ConditionVariable condition_ GUARDED_BY(lock_);
+#endif
 };
 
 }  // namespace art
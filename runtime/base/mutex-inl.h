@@ -89,12 +89,15 @@ struct __attribute__((__may_alias__)) glibc_pthread_rwlock_t {
 
 #endif  // __GLIBC__
 
+static inline uint64_t SafeGetTid(const Thread* self);
+
 class ScopedContentionRecorder {
  public:
-  ScopedContentionRecorder(BaseMutex* mutex, uint64_t blocked_tid, uint64_t owner_tid)
+  ScopedContentionRecorder(BaseMutex* mutex, Thread* self, uint64_t owner_tid)
       : mutex_(kLogLockContentions ? mutex : NULL),
-        blocked_tid_(kLogLockContentions ? blocked_tid : 0),
+        blocked_tid_(kLogLockContentions ? SafeGetTid(self) : 0),
         owner_tid_(kLogLockContentions ? owner_tid : 0),
+        blocked_method_(kLogLockContentions ? BaseMutex::GetContentionMethod(self) : NULL),
         start_nano_time_(kLogLockContentions ? NanoTime() : 0) {
     std::string msg = StringPrintf("Lock contention on %s (owner tid: %llu)",
                                    mutex->GetName(), owner_tid);
@@ -105,7 +108,8 @@ class ScopedContentionRecorder {
     ATRACE_END();
     if (kLogLockContentions) {
       uint64_t end_nano_time = NanoTime();
-      mutex_->RecordContention(blocked_tid_, owner_tid_, end_nano_time - start_nano_time_);
+      mutex_->RecordContention(blocked_tid_, owner_tid_, blocked_method_,
+                               end_nano_time - start_nano_time_);
     }
   }
 
@@ -113,6 +117,7 @@ class ScopedContentionRecorder {
   BaseMutex* const mutex_;
   const uint64_t blocked_tid_;
   const uint64_t owner_tid_;
+  const mirror::ArtMethod* const blocked_method_;
   const uint64_t start_nano_time_;
 };
 
@@ -179,18 +184,56 @@ inline void BaseMutex::RegisterAsUnlocked(Thread* self) {
   }
 }
 
+#if ART_USE_FUTEXES
+inline volatile int32_t* ReaderWriterMutex::GetReaderSlot(const Thread* self) const {
+  return &reader_slots_[SafeGetTid(self) % kReaderSlots].count;
+}
+
+inline void ReaderWriterMutex::LeaveReaderSlot(const Thread* self) {
+  android_atomic_dec(GetReaderSlot(self));
+  // Order the decrement before the read of state_, pairing with the barrier in WaitForReaders.
+  ANDROID_MEMBAR_FULL();
+  if (UNLIKELY(state_ < 0)) {
+    // A writer is waiting for the readers to leave.
+    android_atomic_inc(&reader_exit_sequence_);
+    futex(&reader_exit_sequence_, FUTEX_WAKE, -1, NULL, NULL, 0);
+  }
+}
+#endif
+
 inline void ReaderWriterMutex::SharedLock(Thread* self) {
   DCHECK(self == NULL || self == Thread::Current());
 #if ART_USE_FUTEXES
   bool done = false;
   do {
+    if (reader_slots_ != NULL) {
+      android_atomic_inc(GetReaderSlot(self));
+      // Order the increment before the read of state_, a writer either sees our count or we see
+      // its -1.
+      ANDROID_MEMBAR_FULL();
+      if (LIKELY(state_ == 0)) {
+        done = true;
+      } else {
+        // A writer holds the lock or is waiting for the readers to leave, make way for it.
+        LeaveReaderSlot(self);
+        ScopedContentionRecorder scr(this, self, GetExclusiveOwnerTid());
+        android_atomic_inc(&num_pending_readers_);
+        if (futex(&state_, FUTEX_WAIT, -1, NULL, NULL, 0) != 0) {
+          if (errno != EAGAIN) {
+            PLOG(FATAL) << "futex wait failed for " << name_;
+          }
+        }
+        android_atomic_dec(&num_pending_readers_);
+      }
+      continue;
+    }
     int32_t cur_state = state_;
     if (LIKELY(cur_state >= 0)) {
       // Add as an extra reader.
       done = android_atomic_acquire_cas(cur_state, cur_state + 1, &state_) == 0;
     } else {
       // Owner holds it exclusively, hang up.
-      ScopedContentionRecorder scr(this, GetExclusiveOwnerTid(), SafeGetTid(self));
+      ScopedContentionRecorder scr(this, self, GetExclusiveOwnerTid());
       android_atomic_inc(&num_pending_readers_);
       if (futex(&state_, FUTEX_WAIT, cur_state, NULL, NULL, 0) != 0) {
         if (errno != EAGAIN) {
@@ -212,6 +255,10 @@ inline void ReaderWriterMutex::SharedUnlock(Thread* self) {
   AssertSharedHeld(self);
   RegisterAsUnlocked(self);
 #if ART_USE_FUTEXES
+  if (reader_slots_ != NULL) {
+    LeaveReaderSlot(self);
+    return;
+  }
   bool done = false;
   do {
     int32_t cur_state = state_;
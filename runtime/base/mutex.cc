@@ -32,6 +32,9 @@
 namespace art {
 
 #if ART_USE_FUTEXES
+// Number of times a contended Mutex::ExclusiveLock polls the lock before sleeping on the futex.
+static const size_t kMutexSpins = 100;
+
 static bool ComputeRelativeTimeSpec(timespec* result_ts, const timespec& lhs, const timespec& rhs) {
   const int32_t one_sec = 1000 * 1000 * 1000;  // one second in nanoseconds.
   result_ts->tv_sec = lhs.tv_sec - rhs.tv_sec;
@@ -159,16 +162,21 @@ inline void BaseMutex::ContentionLogData::AddToWaitTime(uint64_t value) {
 
 void BaseMutex::RecordContention(uint64_t blocked_tid,
                                  uint64_t owner_tid,
+                                 const mirror::ArtMethod* blocked_method,
                                  uint64_t nano_time_blocked) {
   if (kLogLockContentions) {
     ContentionLogData* data = contetion_log_data_;
     ++(data->contention_count);
     data->AddToWaitTime(nano_time_blocked);
-    ContentionLogEntry* log = data->contention_log;
     // This code is intentionally racy as it is only used for diagnostics.
+    if (nano_time_blocked > data->max_wait_time) {
+      data->max_wait_time = nano_time_blocked;
+    }
+    ContentionLogEntry* log = data->contention_log;
     uint32_t slot = data->cur_content_log_entry;
     if (log[slot].blocked_tid == blocked_tid &&
-        log[slot].owner_tid == blocked_tid) {
+        log[slot].owner_tid == owner_tid &&
+        log[slot].blocked_method == blocked_method) {
       ++log[slot].count;
     } else {
       uint32_t new_slot;
@@ -178,11 +186,63 @@ void BaseMutex::RecordContention(uint64_t blocked_tid,
       } while (!data->cur_content_log_entry.compare_and_swap(slot, new_slot));
       log[new_slot].blocked_tid = blocked_tid;
       log[new_slot].owner_tid = owner_tid;
+      log[new_slot].blocked_method = blocked_method;
       log[new_slot].count = 1;
     }
   }
 }
 
+void BaseMutex::RecordContendedRelease(Thread* self) {
+  if (kLogLockContentions) {
+    // The logging lock is also released while aborting, when the stack may not be walkable.
+    if (this == Locks::logging_lock_) {
+      return;
+    }
+    ContentionLogData* data = contetion_log_data_;
+    uint32_t slot;
+    uint32_t new_slot;
+    do {
+      slot = data->cur_owner_method_entry;
+      new_slot = (slot + 1) % kContentionLogSize;
+    } while (!data->cur_owner_method_entry.compare_and_swap(slot, new_slot));
+    data->owner_methods[new_slot] = GetContentionMethod(self);
+  }
+}
+
+const mirror::ArtMethod* BaseMutex::GetContentionMethod(Thread* self) {
+  // Only the thread itself walks its stack, so the mutator lock isn't needed to read it.
+  Runtime* runtime = Runtime::Current();
+  if (self == NULL || runtime == NULL || !runtime->IsStarted()) {
+    return NULL;
+  }
+  return self->GetCurrentMethod(NULL);
+}
+
+static void AddMethodCount(SafeMap<const mirror::ArtMethod*, size_t>* counts,
+                           const mirror::ArtMethod* method, size_t count) {
+  SafeMap<const mirror::ArtMethod*, size_t>::iterator it = counts->find(method);
+  if (it != counts->end()) {
+    it->second += count;
+  } else {
+    counts->Put(method, count);
+  }
+}
+
+// Returns the most frequent of the non-NULL methods in 'counts', or NULL if there are none.
+static const mirror::ArtMethod* MostCommonMethod(
+    const SafeMap<const mirror::ArtMethod*, size_t>& counts) {
+  const mirror::ArtMethod* max_method = NULL;
+  size_t max_method_count = 0;
+  typedef SafeMap<const mirror::ArtMethod*, size_t>::const_iterator It;
+  for (It it = counts.begin(); it != counts.end(); ++it) {
+    if (it->first != NULL && it->second > max_method_count) {
+      max_method = it->first;
+      max_method_count = it->second;
+    }
+  }
+  return max_method;
+}
+
 void BaseMutex::DumpContention(std::ostream& os) const {
   if (kLogLockContentions) {
     const ContentionLogData* data = contetion_log_data_;
@@ -193,15 +253,19 @@ void BaseMutex::DumpContention(std::ostream& os) const {
       os << "never contended";
     } else {
       os << "contended " << contention_count
-         << " times, average wait of contender " << PrettyDuration(wait_time / contention_count);
+         << " times, average wait of contender " << PrettyDuration(wait_time / contention_count)
+         << ", max wait " << PrettyDuration(data->max_wait_time);
       SafeMap<uint64_t, size_t> most_common_blocker;
       SafeMap<uint64_t, size_t> most_common_blocked;
+      SafeMap<const mirror::ArtMethod*, size_t> most_common_blocked_method;
+      SafeMap<const mirror::ArtMethod*, size_t> most_common_owner_method;
       typedef SafeMap<uint64_t, size_t>::const_iterator It;
       for (size_t i = 0; i < kContentionLogSize; ++i) {
         uint64_t blocked_tid = log[i].blocked_tid;
         uint64_t owner_tid = log[i].owner_tid;
         uint32_t count = log[i].count;
         if (count > 0) {
+          AddMethodCount(&most_common_blocked_method, log[i].blocked_method, count);
           It it = most_common_blocked.find(blocked_tid);
           if (it != most_common_blocked.end()) {
             most_common_blocked.Overwrite(blocked_tid, it->second + count);
@@ -238,6 +302,20 @@ void BaseMutex::DumpContention(std::ostream& os) const {
       if (max_tid != 0) {
         os << " sample shows tid=" << max_tid << " owning during this time";
       }
+      const mirror::ArtMethod* blocked_method = MostCommonMethod(most_common_blocked_method);
+      if (blocked_method != NULL) {
+        os << " most blocked in " << PrettyMethod(blocked_method);
+      }
+      for (size_t i = 0; i < kContentionLogSize; ++i) {
+        const mirror::ArtMethod* owner_method = data->owner_methods[i];
+        if (owner_method != NULL) {
+          AddMethodCount(&most_common_owner_method, owner_method, 1);
+        }
+      }
+      const mirror::ArtMethod* owner_method = MostCommonMethod(most_common_owner_method);
+      if (owner_method != NULL) {
+        os << " most often released to waiters in " << PrettyMethod(owner_method);
+      }
     }
   }
 }
@@ -296,14 +374,19 @@ void Mutex::ExclusiveLock(Thread* self) {
   if (!recursive_ || !IsExclusiveHeld(self)) {
 #if ART_USE_FUTEXES
     bool done = false;
+    size_t spins = 0;
     do {
       int32_t cur_state = state_;
       if (LIKELY(cur_state == 0)) {
         // Change state from 0 to 1.
         done = android_atomic_acquire_cas(0, 1, &state_) == 0;
+      } else if (spins < kMutexSpins && num_contenders_ == 0) {
+        // Locks are mostly held briefly, poll a little before paying for a futex wait and wake.
+        // Don't spin past threads already asleep, they would be woken only to lose to us.
+        ++spins;
       } else {
         // Failed to acquire, hang up.
-        ScopedContentionRecorder scr(this, SafeGetTid(self), GetExclusiveOwnerTid());
+        ScopedContentionRecorder scr(this, self, GetExclusiveOwnerTid());
         android_atomic_inc(&num_contenders_);
         if (futex(&state_, FUTEX_WAIT, 1, NULL, NULL, 0) != 0) {
           // EAGAIN and EINTR both indicate a spurious failure, try again from the beginning.
@@ -393,6 +476,9 @@ void Mutex::ExclusiveUnlock(Thread* self) {
         // Wake a contender
         if (UNLIKELY(num_contenders_ > 0)) {
           futex(&state_, FUTEX_WAKE, 1, NULL, NULL, 0);
+          if (kLogLockContentions) {
+            RecordContendedRelease(self);
+          }
         }
       }
     } else {
@@ -427,13 +513,16 @@ std::ostream& operator<<(std::ostream& os, const Mutex& mu) {
   return os;
 }
 
-ReaderWriterMutex::ReaderWriterMutex(const char* name, LockLevel level)
+ReaderWriterMutex::ReaderWriterMutex(const char* name, LockLevel level, bool distributed_readers)
     : BaseMutex(name, level)
 #if ART_USE_FUTEXES
-    , state_(0), exclusive_owner_(0), num_pending_readers_(0), num_pending_writers_(0)
+    , state_(0), exclusive_owner_(0), num_pending_readers_(0), num_pending_writers_(0),
+    reader_slots_(distributed_readers ? new ReaderSlot[kReaderSlots]() : NULL),
+    reader_exit_sequence_(0)
 #endif
 {  // NOLINT(whitespace/braces)
 #if !ART_USE_FUTEXES
+  UNUSED(distributed_readers);
   CHECK_MUTEX_CALL(pthread_rwlock_init, (&rwlock_, NULL));
 #endif
 }
@@ -444,6 +533,12 @@ ReaderWriterMutex::~ReaderWriterMutex() {
   CHECK_EQ(exclusive_owner_, 0U);
   CHECK_EQ(num_pending_readers_, 0);
   CHECK_EQ(num_pending_writers_, 0);
+  if (reader_slots_ != NULL) {
+    for (size_t i = 0; i < kReaderSlots; ++i) {
+      CHECK_EQ(reader_slots_[i].count, 0);
+    }
+    delete[] reader_slots_;
+  }
 #else
   // We can't use CHECK_MUTEX_CALL here because on shutdown a suspended daemon thread
   // may still be using locks.
@@ -471,7 +566,7 @@ void ReaderWriterMutex::ExclusiveLock(Thread* self) {
       done = android_atomic_acquire_cas(0, -1, &state_) == 0;
     } else {
       // Failed to acquire, hang up.
-      ScopedContentionRecorder scr(this, SafeGetTid(self), GetExclusiveOwnerTid());
+      ScopedContentionRecorder scr(this, self, GetExclusiveOwnerTid());
       android_atomic_inc(&num_pending_writers_);
       if (futex(&state_, FUTEX_WAIT, cur_state, NULL, NULL, 0) != 0) {
         // EAGAIN and EINTR both indicate a spurious failure, try again from the beginning.
@@ -484,6 +579,9 @@ void ReaderWriterMutex::ExclusiveLock(Thread* self) {
     }
   } while (!done);
   DCHECK_EQ(state_, -1);
+  if (reader_slots_ != NULL) {
+    WaitForReaders(self, NULL);
+  }
   exclusive_owner_ = SafeGetTid(self);
 #else
   CHECK_MUTEX_CALL(pthread_rwlock_wrlock, (&rwlock_));
@@ -509,6 +607,9 @@ void ReaderWriterMutex::ExclusiveUnlock(Thread* self) {
         // Wake any waiters.
         if (UNLIKELY(num_pending_readers_ > 0 || num_pending_writers_ > 0)) {
           futex(&state_, FUTEX_WAKE, -1, NULL, NULL, 0);
+          if (kLogLockContentions) {
+            RecordContendedRelease(self);
+          }
         }
       }
     } else {
@@ -540,7 +641,7 @@ bool ReaderWriterMutex::ExclusiveLockWithTimeout(Thread* self, int64_t ms, int32
       if (ComputeRelativeTimeSpec(&rel_ts, end_abs_ts, now_abs_ts)) {
         return false;  // Timed out.
       }
-      ScopedContentionRecorder scr(this, SafeGetTid(self), GetExclusiveOwnerTid());
+      ScopedContentionRecorder scr(this, self, GetExclusiveOwnerTid());
       android_atomic_inc(&num_pending_writers_);
       if (futex(&state_, FUTEX_WAIT, cur_state, &rel_ts, NULL, 0) != 0) {
         if (errno == ETIMEDOUT) {
@@ -556,6 +657,14 @@ bool ReaderWriterMutex::ExclusiveLockWithTimeout(Thread* self, int64_t ms, int32
       android_atomic_dec(&num_pending_writers_);
     }
   } while (!done);
+  if (reader_slots_ != NULL && !WaitForReaders(self, &end_abs_ts)) {
+    // Timed out with readers still in, give up the lock again.
+    android_atomic_release_store(0, &state_);
+    if (num_pending_readers_ > 0 || num_pending_writers_ > 0) {
+      futex(&state_, FUTEX_WAKE, -1, NULL, NULL, 0);
+    }
+    return false;
+  }
   exclusive_owner_ = SafeGetTid(self);
 #else
   timespec ts;
@@ -575,9 +684,54 @@ bool ReaderWriterMutex::ExclusiveLockWithTimeout(Thread* self, int64_t ms, int32
 }
 #endif
 
+#if ART_USE_FUTEXES
+bool ReaderWriterMutex::WaitForReaders(Thread* self, const timespec* end_abs_ts) {
+  for (;;) {
+    // Read the sequence before the slots, so that a reader leaving after we looked at its slot
+    // makes the wait below return at once.
+    int32_t cur_sequence = reader_exit_sequence_;
+    ANDROID_MEMBAR_FULL();
+    int32_t num_readers = 0;
+    for (size_t i = 0; i < kReaderSlots; ++i) {
+      num_readers += reader_slots_[i].count;
+    }
+    if (num_readers == 0) {
+      return true;
+    }
+    timespec rel_ts;
+    if (end_abs_ts != NULL) {
+      timespec now_abs_ts;
+      InitTimeSpec(true, CLOCK_REALTIME, 0, 0, &now_abs_ts);
+      if (ComputeRelativeTimeSpec(&rel_ts, *end_abs_ts, now_abs_ts)) {
+        return false;  // Timed out.
+      }
+    }
+    ScopedContentionRecorder scr(this, self, 0);
+    if (futex(&reader_exit_sequence_, FUTEX_WAIT, cur_sequence,
+              end_abs_ts != NULL ? &rel_ts : NULL, NULL, 0) != 0) {
+      // ETIMEDOUT is caught by the deadline check above, EAGAIN and EINTR are spurious failures.
+      if ((errno != ETIMEDOUT) && (errno != EAGAIN) && (errno != EINTR)) {
+        PLOG(FATAL) << "futex wait failed for " << name_;
+      }
+    }
+  }
+}
+#endif
+
 bool ReaderWriterMutex::SharedTryLock(Thread* self) {
   DCHECK(self == NULL || self == Thread::Current());
 #if ART_USE_FUTEXES
+  if (reader_slots_ != NULL) {
+    android_atomic_inc(GetReaderSlot(self));
+    ANDROID_MEMBAR_FULL();
+    if (state_ != 0) {
+      LeaveReaderSlot(self);
+      return false;
+    }
+    RegisterAsLocked(self);
+    AssertSharedHeld(self);
+    return true;
+  }
   bool done = false;
   do {
     int32_t cur_state = state_;
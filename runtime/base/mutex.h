@@ -47,18 +47,24 @@ namespace art {
 class ScopedContentionRecorder;
 class Thread;
 
+namespace mirror {
+  class ArtMethod;
+}  // namespace mirror
+
 const bool kDebugLocking = kIsDebugBuild;
 
 // Record Log contention information, dumpable via SIGQUIT.
-#ifdef ART_USE_FUTEXES
-// To enable lock contention logging, set this to true.
-const bool kLogLockContentions = false;
+#if ART_USE_FUTEXES && defined(ART_LOCK_CONTENTION_LOGGING)
+// Enabled by building with ART_LOCK_CONTENTION_LOGGING=true.
+const bool kLogLockContentions = true;
 #else
 // Keep this false as lock contention logging is supported only with
 // futex.
 const bool kLogLockContentions = false;
 #endif
 const size_t kContentionLogSize = 64;
+// Size of a reader slot of a ReaderWriterMutex with distributed readers, at least a cache line.
+const size_t kReaderSlotSize = 64;
 const size_t kContentionLogDataSize = kLogLockContentions ? 1 : 0;
 const size_t kAllMutexDataSize = kLogLockContentions ? 1 : 0;
 
@@ -87,17 +93,25 @@ class BaseMutex {
 
   friend class ScopedContentionRecorder;
 
-  void RecordContention(uint64_t blocked_tid, uint64_t owner_tid, uint64_t nano_time_blocked);
+  void RecordContention(uint64_t blocked_tid, uint64_t owner_tid,
+                        const mirror::ArtMethod* blocked_method, uint64_t nano_time_blocked);
+  // Called by the owner when it releases the mutex to waiting threads.
+  void RecordContendedRelease(Thread* self);
   void DumpContention(std::ostream& os) const;
 
+  // The method 'self' is executing, or NULL if it has no managed frames.
+  static const mirror::ArtMethod* GetContentionMethod(Thread* self) NO_THREAD_SAFETY_ANALYSIS;
+
   const LockLevel level_;  // Support for lock hierarchy.
   const char* const name_;
 
   // A log entry that records contention but makes no guarantee that either tid will be held live.
   struct ContentionLogEntry {
-    ContentionLogEntry() : blocked_tid(0), owner_tid(0) {}
+    ContentionLogEntry() : blocked_tid(0), owner_tid(0), blocked_method(NULL) {}
     uint64_t blocked_tid;
     uint64_t owner_tid;
+    // The method the blocked thread was executing.
+    const mirror::ArtMethod* blocked_method;
     AtomicInteger count;
   };
   struct ContentionLogData {
@@ -109,8 +123,17 @@ class BaseMutex {
     AtomicInteger contention_count;
     // Sum of time waited by all contenders in ns.
     volatile uint64_t wait_time;
+    // Longest time waited by a contender in ns.
+    volatile uint64_t max_wait_time;
+    // Methods the owner was executing when it released the mutex to waiters.
+    const mirror::ArtMethod* owner_methods[kContentionLogSize];
+    AtomicInteger cur_owner_method_entry;
     void AddToWaitTime(uint64_t value);
-    ContentionLogData() : wait_time(0) {}
+    ContentionLogData() : wait_time(0), max_wait_time(0) {
+      for (size_t i = 0; i < kContentionLogSize; ++i) {
+        owner_methods[i] = NULL;
+      }
+    }
   };
   ContentionLogData contetion_log_data_[kContentionLogDataSize];
 
@@ -220,7 +243,11 @@ class LOCKABLE Mutex : public BaseMutex {
 std::ostream& operator<<(std::ostream& os, const ReaderWriterMutex& mu);
 class LOCKABLE ReaderWriterMutex : public BaseMutex {
  public:
-  explicit ReaderWriterMutex(const char* name, LockLevel level = kDefaultMutexLevel);
+  // With distributed_readers, shared holders count themselves in one of several cache lines picked
+  // by their tid, so that readers on different cores don't contend, at the expense of writers who
+  // have to scan all of them.
+  explicit ReaderWriterMutex(const char* name, LockLevel level = kDefaultMutexLevel,
+                             bool distributed_readers = false);
   ~ReaderWriterMutex();
 
   virtual bool IsReaderWriterMutex() const { return true; }
@@ -305,6 +332,26 @@ class LOCKABLE ReaderWriterMutex : public BaseMutex {
   volatile int32_t num_pending_readers_;
   // Pending writers.
   volatile int32_t num_pending_writers_;
+
+  // A count of shared holders, padded so that no two counts share a cache line.
+  struct ReaderSlot {
+    volatile int32_t count;
+    uint8_t padding[kReaderSlotSize - sizeof(int32_t)];
+  };
+  static const size_t kReaderSlots = 16;
+  // With distributed readers, shared holders count themselves here rather than in state_, which
+  // then only takes the values 0 and -1. NULL otherwise.
+  ReaderSlot* const reader_slots_;
+  // Bumped by readers that leave while a writer waits for the reader slots to drain.
+  volatile int32_t reader_exit_sequence_;
+
+  // The slot self counts itself in.
+  volatile int32_t* GetReaderSlot(const Thread* self) const;
+  // Takes self out of its reader slot and lets a writer waiting on the readers know.
+  void LeaveReaderSlot(const Thread* self);
+  // Waits, after an exclusive acquire of state_, for the reader slots to drain. Returns false if
+  // end_abs_ts, when non-NULL, passes first.
+  bool WaitForReaders(Thread* self, const timespec* end_abs_ts);
 #else
   pthread_rwlock_t rwlock_;
 #endif
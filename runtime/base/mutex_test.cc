@@ -146,6 +146,20 @@ TEST_F(MutexTest, SharedLockUnlock) {
   mu.AssertNotHeld(Thread::Current());
 }
 
+TEST_F(MutexTest, DistributedReadersLockUnlock) {
+  ReaderWriterMutex mu("test rwmutex", kDefaultMutexLevel, true);
+  mu.SharedLock(Thread::Current());
+  mu.AssertSharedHeld(Thread::Current());
+  mu.AssertNotExclusiveHeld(Thread::Current());
+  mu.SharedUnlock(Thread::Current());
+  mu.AssertNotHeld(Thread::Current());
+  // The writer must not wait for the reader that just left.
+  mu.ExclusiveLock(Thread::Current());
+  mu.AssertExclusiveHeld(Thread::Current());
+  mu.ExclusiveUnlock(Thread::Current());
+  mu.AssertNotHeld(Thread::Current());
+}
+
 TEST_F(MutexTest, ExclusiveLockUnlock) {
   ReaderWriterMutex mu("test rwmutex");
   mu.AssertNotHeld(Thread::Current());
@@ -158,6 +158,7 @@ class ScopedCheck {
       SHARED_LOCK_FUNCTION(Locks::mutator_lock_)
       : soa_(env) {
     Init(flags, functionName, true);
+    check_arguments_ = SampleCall(soa_.Env());
     CheckThread(flags);
   }
 
@@ -184,6 +185,9 @@ class ScopedCheck {
   // times, so using "java.lang.Thread" instead of "java/lang/Thread" might work in some
   // circumstances, but this is incorrect.
   void CheckClassName(const char* class_name) {
+    if (!check_arguments_) {
+      return;
+    }
     if (!IsValidJniClassName(class_name)) {
       JniAbortF(function_name_,
                 "illegal class name '%s'\n"
@@ -200,6 +204,9 @@ class ScopedCheck {
    */
   void CheckFieldType(jobject java_object, jfieldID fid, char prim, bool isStatic)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
+    if (!check_arguments_) {
+      return;
+    }
     mirror::ArtField* f = CheckFieldID(fid);
     if (f == NULL) {
       return;
@@ -247,6 +254,9 @@ class ScopedCheck {
    */
   void CheckInstanceFieldID(jobject java_object, jfieldID fid)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
+    if (!check_arguments_) {
+      return;
+    }
     mirror::Object* o = soa_.Decode<mirror::Object*>(java_object);
     if (o == NULL || !Runtime::Current()->GetHeap()->IsHeapAddress(o)) {
       Runtime::Current()->GetHeap()->DumpSpaces();
@@ -271,6 +281,9 @@ class ScopedCheck {
    * Verify that the pointer value is non-NULL.
    */
   void CheckNonNull(const void* ptr) {
+    if (!check_arguments_) {
+      return;
+    }
     if (ptr == NULL) {
       JniAbortF(function_name_, "non-nullable argument was NULL");
     }
@@ -282,6 +295,9 @@ class ScopedCheck {
    */
   void CheckSig(jmethodID mid, const char* expectedType, bool isStatic)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
+    if (!check_arguments_) {
+      return;
+    }
     mirror::ArtMethod* m = CheckMethodID(mid);
     if (m == NULL) {
       return;
@@ -308,6 +324,9 @@ class ScopedCheck {
    */
   void CheckStaticFieldID(jclass java_class, jfieldID fid)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
+    if (!check_arguments_) {
+      return;
+    }
     mirror::Class* c = soa_.Decode<mirror::Class*>(java_class);
     const mirror::ArtField* f = CheckFieldID(fid);
     if (f == NULL) {
@@ -330,6 +349,9 @@ class ScopedCheck {
    */
   void CheckStaticMethod(jclass java_class, jmethodID mid)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
+    if (!check_arguments_) {
+      return;
+    }
     const mirror::ArtMethod* m = CheckMethodID(mid);
     if (m == NULL) {
       return;
@@ -350,6 +372,9 @@ class ScopedCheck {
    */
   void CheckVirtualMethod(jobject java_object, jmethodID mid)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
+    if (!check_arguments_) {
+      return;
+    }
     const mirror::ArtMethod* m = CheckMethodID(mid);
     if (m == NULL) {
       return;
@@ -545,7 +570,7 @@ class ScopedCheck {
     }
 
     // We always do the thorough checks on entry, and never on exit...
-    if (entry) {
+    if (entry && check_arguments_) {
       va_start(ap, fmt0);
       for (const char* fmt = fmt0; *fmt; ++fmt) {
         char ch = *fmt;
@@ -600,6 +625,9 @@ class ScopedCheck {
    */
   bool CheckInstance(InstanceKind kind, jobject java_object)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
+    if (!check_arguments_) {
+      return true;
+    }
     const char* what = NULL;
     switch (kind) {
     case kClass:
@@ -667,6 +695,30 @@ class ScopedCheck {
     flags_ = flags;
     function_name_ = functionName;
     has_method_ = has_method;
+    check_arguments_ = true;
+  }
+
+  // With -Xjnicheckrate:<n> the arguments of only one in n calls of a thread are checked, on
+  // average, the thread, critical region and pending exception checks are always made. The number
+  // of calls skipped after a checked one is random so that calls made in a fixed pattern, say
+  // alternately from a loop, don't escape checking.
+  static bool SampleCall(JNIEnvExt* env) {
+    const uint32_t rate = env->vm->check_jni_rate;
+    if (rate <= 1) {
+      return true;
+    }
+    if (env->check_jni_skip != 0) {
+      env->check_jni_skip--;
+      return false;
+    }
+    // A xorshift generator: cheap, and its state is never zero.
+    uint32_t random = env->check_jni_random;
+    random ^= random << 13;
+    random ^= random >> 17;
+    random ^= random << 5;
+    env->check_jni_random = random;
+    env->check_jni_skip = random % (2 * rate - 1);
+    return true;
   }
 
   /*
@@ -889,6 +941,8 @@ class ScopedCheck {
   const char* function_name_;
   int flags_;
   bool has_method_;
+  // False when this call wasn't sampled by -Xjnicheckrate.
+  bool check_arguments_;
   int indent_;
 
   DISALLOW_COPY_AND_ASSIGN(ScopedCheck);
@@ -115,9 +115,11 @@ inline mirror::ObjectArray<mirror::ArtMethod>* ClassLinker::AllocArtMethodArray(
       GetClassRoot(kJavaLangReflectArtMethodArrayClass), length);
 }
 
-inline mirror::IfTable* ClassLinker::AllocIfTable(Thread* self, size_t ifcount) {
+inline mirror::IfTable* ClassLinker::AllocIfTable(Thread* self, size_t ifcount,
+                                                  bool with_imtable) {
+  const size_t length = ifcount * mirror::IfTable::kMax + (with_imtable ? 1 : 0);
   return down_cast<mirror::IfTable*>(
-      mirror::IfTable::Alloc(self, GetClassRoot(kObjectArrayClass), ifcount * mirror::IfTable::kMax));
+      mirror::IfTable::Alloc(self, GetClassRoot(kObjectArrayClass), length));
 }
 
 inline mirror::ObjectArray<mirror::ArtField>* ClassLinker::AllocArtFieldArray(Thread* self,
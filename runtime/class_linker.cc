@@ -18,6 +18,7 @@
 
 #include <fcntl.h>
 #include <sys/file.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/wait.h>
@@ -27,6 +28,7 @@
 #include <utility>
 #include <vector>
 
+#include "atomic_integer.h"
 #include "base/casts.h"
 #include "base/logging.h"
 #include "base/stl_util.h"
@@ -63,6 +65,7 @@
 #include "sirt_ref.h"
 #include "stack_indirect_reference_table.h"
 #include "thread.h"
+#include "thread_pool.h"
 #include "UniquePtr.h"
 #include "utils.h"
 #include "verifier/method_verifier.h"
@@ -132,6 +135,55 @@ static size_t Hash(const char* s) {
   return hash;
 }
 
+void ClassLinker::ClassTable::Insert(size_t hash, mirror::Class* klass) {
+  DCHECK(IsLive(klass));
+  // Keep at least a quarter of the slots empty so that probe sequences stay short.
+  if ((num_entries_ + num_tombstones_ + 1) * 4 > slots_.size() * 3) {
+    Rehash(num_entries_ * 2 >= slots_.size() ? slots_.size() * 2 : slots_.size());
+  }
+  const size_t mask = slots_.size() - 1;
+  size_t i = SlotIndex(hash, mask);
+  while (IsLive(slots_[i].klass)) {
+    i = (i + 1) & mask;
+  }
+  if (slots_[i].klass == Tombstone()) {
+    --num_tombstones_;
+  }
+  slots_[i].hash = hash;
+  slots_[i].klass = klass;
+  ++num_entries_;
+}
+
+void ClassLinker::ClassTable::Remove(size_t hash, mirror::Class* klass) {
+  const size_t mask = slots_.size() - 1;
+  for (size_t i = SlotIndex(hash, mask); slots_[i].klass != NULL; i = (i + 1) & mask) {
+    if (slots_[i].klass == klass) {
+      slots_[i].klass = Tombstone();
+      --num_entries_;
+      ++num_tombstones_;
+      return;
+    }
+  }
+  LOG(FATAL) << "Removing class which isn't in the class table " << klass;
+}
+
+void ClassLinker::ClassTable::Rehash(size_t capacity) {
+  DCHECK(IsPowerOfTwo(capacity));
+  std::vector<Slot> old_slots(capacity);
+  old_slots.swap(slots_);
+  const size_t mask = capacity - 1;
+  for (const Slot& slot : old_slots) {
+    if (IsLive(slot.klass)) {
+      size_t i = SlotIndex(slot.hash, mask);
+      while (slots_[i].klass != NULL) {
+        i = (i + 1) & mask;
+      }
+      slots_[i] = slot;
+    }
+  }
+  num_tombstones_ = 0;
+}
+
 const char* ClassLinker::class_roots_descriptors_[] = {
   "Ljava/lang/Class;",
   "Ljava/lang/Object;",
@@ -220,25 +272,30 @@ void ClassLinker::InitFromCompiler(const std::vector<const DexFile*>& boot_class
   // AllocClass(mirror::Class*) can now be used
 
   // Class[] is used for reflection support.
-  SirtRef<mirror::Class> class_array_class(self, AllocClass(self, java_lang_Class.get(), sizeof(mirror::Class)));
+  SirtRef<mirror::Class> class_array_class(self, AllocClass(self, java_lang_Class.get(),
+                                                            mirror::Class::MinimumClassSize()));
   class_array_class->SetComponentType(java_lang_Class.get());
 
   // java_lang_Object comes next so that object_array_class can be created.
-  SirtRef<mirror::Class> java_lang_Object(self, AllocClass(self, java_lang_Class.get(), sizeof(mirror::Class)));
+  SirtRef<mirror::Class> java_lang_Object(self, AllocClass(self, java_lang_Class.get(),
+                                                           mirror::Class::MinimumClassSize()));
   CHECK(java_lang_Object.get() != NULL);
   // backfill Object as the super class of Class.
   java_lang_Class->SetSuperClass(java_lang_Object.get());
   java_lang_Object->SetStatus(mirror::Class::kStatusLoaded, self);
 
   // Object[] next to hold class roots.
-  SirtRef<mirror::Class> object_array_class(self, AllocClass(self, java_lang_Class.get(), sizeof(mirror::Class)));
+  SirtRef<mirror::Class> object_array_class(self, AllocClass(self, java_lang_Class.get(),
+                                                             mirror::Class::MinimumClassSize()));
   object_array_class->SetComponentType(java_lang_Object.get());
 
   // Setup the char class to be used for char[].
-  SirtRef<mirror::Class> char_class(self, AllocClass(self, java_lang_Class.get(), sizeof(mirror::Class)));
+  SirtRef<mirror::Class> char_class(self, AllocClass(self, java_lang_Class.get(),
+                                                     mirror::Class::MinimumClassSize()));
 
   // Setup the char[] class to be used for String.
-  SirtRef<mirror::Class> char_array_class(self, AllocClass(self, java_lang_Class.get(), sizeof(mirror::Class)));
+  SirtRef<mirror::Class> char_array_class(self, AllocClass(self, java_lang_Class.get(),
+                                                           mirror::Class::MinimumClassSize()));
   char_array_class->SetComponentType(char_class.get());
   mirror::CharArray::SetArrayClass(char_array_class.get());
 
@@ -269,10 +326,11 @@ void ClassLinker::InitFromCompiler(const std::vector<const DexFile*>& boot_class
   SetClassRoot(kPrimitiveVoid, CreatePrimitiveClass(self, Primitive::kPrimVoid));
 
   // Create array interface entries to populate once we can load system classes.
-  array_iftable_ = AllocIfTable(self, 2);
+  array_iftable_ = AllocIfTable(self, 2, false);
 
   // Create int array type for AllocDexCache (done in AppendToBootClassPath).
-  SirtRef<mirror::Class> int_array_class(self, AllocClass(self, java_lang_Class.get(), sizeof(mirror::Class)));
+  SirtRef<mirror::Class> int_array_class(self, AllocClass(self, java_lang_Class.get(),
+                                                          mirror::Class::MinimumClassSize()));
   int_array_class->SetComponentType(GetClassRoot(kPrimitiveInt));
   mirror::IntArray::SetArrayClass(int_array_class.get());
   SetClassRoot(kIntArrayClass, int_array_class.get());
@@ -306,17 +364,17 @@ void ClassLinker::InitFromCompiler(const std::vector<const DexFile*>& boot_class
 
   // Set up array classes for string, field, method
   SirtRef<mirror::Class> object_array_string(self, AllocClass(self, java_lang_Class.get(),
-                                                              sizeof(mirror::Class)));
+                                                              mirror::Class::MinimumClassSize()));
   object_array_string->SetComponentType(java_lang_String.get());
   SetClassRoot(kJavaLangStringArrayClass, object_array_string.get());
 
-  SirtRef<mirror::Class> object_array_art_method(self, AllocClass(self, java_lang_Class.get(),
-                                                                  sizeof(mirror::Class)));
+  SirtRef<mirror::Class> object_array_art_method(
+      self, AllocClass(self, java_lang_Class.get(), mirror::Class::MinimumClassSize()));
   object_array_art_method->SetComponentType(java_lang_reflect_ArtMethod.get());
   SetClassRoot(kJavaLangReflectArtMethodArrayClass, object_array_art_method.get());
 
-  SirtRef<mirror::Class> object_array_art_field(self, AllocClass(self, java_lang_Class.get(),
-                                                                 sizeof(mirror::Class)));
+  SirtRef<mirror::Class> object_array_art_field(
+      self, AllocClass(self, java_lang_Class.get(), mirror::Class::MinimumClassSize()));
   object_array_art_field->SetComponentType(java_lang_reflect_ArtField.get());
   SetClassRoot(kJavaLangReflectArtFieldArrayClass, object_array_art_field.get());
 
@@ -671,16 +729,17 @@ OatFile& ClassLinker::GetImageOatFile(gc::space::ImageSpace* space) {
 
 const OatFile* ClassLinker::FindOpenedOatFileForDexFile(const DexFile& dex_file) {
   ReaderMutexLock mu(Thread::Current(), dex_lock_);
-  return FindOpenedOatFileFromDexLocation(dex_file.GetLocation(), dex_file.GetLocationChecksum());
+  uint32_t dex_location_checksum = dex_file.GetLocationChecksum();
+  return FindOpenedOatFileFromDexLocation(dex_file.GetLocation(), &dex_location_checksum);
 }
 
-const OatFile* ClassLinker::FindOpenedOatFileFromDexLocation(const std::string& dex_location,
-                                                             uint32_t dex_location_checksum) {
+const OatFile* ClassLinker::FindOpenedOatFileFromDexLocation(
+    const std::string& dex_location, const uint32_t* dex_location_checksum) {
   for (size_t i = 0; i < oat_files_.size(); i++) {
     const OatFile* oat_file = oat_files_[i];
     DCHECK(oat_file != NULL);
     const OatFile::OatDexFile* oat_dex_file = oat_file->GetOatDexFile(dex_location,
-                                                                      &dex_location_checksum,
+                                                                      dex_location_checksum,
                                                                       false);
     if (oat_dex_file != NULL) {
       return oat_file;
@@ -689,6 +748,21 @@ const OatFile* ClassLinker::FindOpenedOatFileFromDexLocation(const std::string&
   return NULL;
 }
 
+bool ClassLinker::GetDexLocationChecksum(const OatFile* oat_file,
+                                         const std::string& dex_location,
+                                         uint32_t* dex_location_checksum) {
+  struct stat dex_location_stat;
+  if (TEMP_FAILURE_RETRY(stat(dex_location.c_str(), &dex_location_stat)) == 0 &&
+      oat_file->GetOatHeader().MatchesDexLocationStat(dex_location_stat)) {
+    const OatFile::OatDexFile* oat_dex_file = oat_file->GetOatDexFile(dex_location, NULL, false);
+    if (oat_dex_file != NULL) {
+      *dex_location_checksum = oat_dex_file->GetDexFileLocationChecksum();
+      return true;
+    }
+  }
+  return DexFile::GetChecksum(dex_location, dex_location_checksum);
+}
+
 const DexFile* ClassLinker::FindDexFileInOatLocation(const std::string& dex_location,
                                                      uint32_t dex_location_checksum,
                                                      const std::string& oat_location) {
@@ -904,14 +978,18 @@ const DexFile* ClassLinker::VerifyAndOpenDexFileFromOatFile(const OatFile* oat_f
   return oat_file->GetOatDexFile(dex_location, &dex_location_checksum)->OpenDexFile();
 }
 
-const DexFile* ClassLinker::FindDexFileInOatFileFromDexLocation(const std::string& dex_location,
-                                                                uint32_t dex_location_checksum) {
+const DexFile* ClassLinker::FindDexFileInOatFileFromDexLocation(const std::string& dex_location) {
   WriterMutexLock mu(Thread::Current(), dex_lock_);
 
-  const OatFile* open_oat_file = FindOpenedOatFileFromDexLocation(dex_location,
-                                                                  dex_location_checksum);
+  const OatFile* open_oat_file = FindOpenedOatFileFromDexLocation(dex_location, NULL);
   if (open_oat_file != NULL) {
-    return open_oat_file->GetOatDexFile(dex_location, &dex_location_checksum)->OpenDexFile();
+    uint32_t dex_location_checksum;
+    if (GetDexLocationChecksum(open_oat_file, dex_location, &dex_location_checksum)) {
+      open_oat_file = FindOpenedOatFileFromDexLocation(dex_location, &dex_location_checksum);
+      if (open_oat_file != NULL) {
+        return open_oat_file->GetOatDexFile(dex_location, &dex_location_checksum)->OpenDexFile();
+      }
+    }
   }
 
   // Look for an existing file next to dex. for example, for
@@ -920,7 +998,7 @@ const DexFile* ClassLinker::FindDexFileInOatFileFromDexLocation(const std::strin
   UniquePtr<const OatFile> oat_file(FindOatFileFromOatLocationLocked(odex_filename));
   if (oat_file.get() != NULL) {
     uint32_t dex_location_checksum;
-    if (!DexFile::GetChecksum(dex_location, &dex_location_checksum)) {
+    if (!GetDexLocationChecksum(oat_file.get(), dex_location, &dex_location_checksum)) {
       // If no classes.dex found in dex_location, it has been stripped, assume oat is up-to-date.
       // This is the common case in user builds for jar's and apk's in the /system directory.
       const OatFile::OatDexFile* oat_dex_file = oat_file->GetOatDexFile(dex_location, NULL);
@@ -941,7 +1019,7 @@ const DexFile* ClassLinker::FindDexFileInOatFileFromDexLocation(const std::strin
   oat_file.reset(FindOatFileFromOatLocationLocked(cache_location));
   if (oat_file.get() != NULL) {
     uint32_t dex_location_checksum;
-    if (!DexFile::GetChecksum(dex_location, &dex_location_checksum)) {
+    if (!GetDexLocationChecksum(oat_file.get(), dex_location, &dex_location_checksum)) {
       LOG(WARNING) << "Failed to compute checksum: " << dex_location;
       return NULL;
     }
@@ -958,6 +1036,11 @@ const DexFile* ClassLinker::FindDexFileInOatFileFromDexLocation(const std::strin
   LOG(INFO) << "Failed to open oat file from " << odex_filename << " or " << cache_location << ".";
 
   // Try to generate oat file if it wasn't found or was obsolete.
+  uint32_t dex_location_checksum;
+  if (!DexFile::GetChecksum(dex_location, &dex_location_checksum)) {
+    LOG(WARNING) << "Failed to compute checksum: " << dex_location;
+    return NULL;
+  }
   std::string oat_cache_filename(GetDalvikCacheFilenameOrDie(dex_location));
   return FindOrCreateOatFileForDexLocationLocked(dex_location, dex_location_checksum, oat_cache_filename);
 }
@@ -1102,6 +1185,7 @@ void ClassLinker::VisitRoots(RootVisitor* visitor, void* arg, bool only_dirty, b
       for (mirror::DexCache* dex_cache : dex_caches_) {
         visitor(dex_cache, arg);
       }
+      mirror::DexCache::VisitOverflowRoots(visitor, arg);
       if (clean_dirty) {
         dex_caches_dirty_ = false;
       }
@@ -1111,9 +1195,10 @@ void ClassLinker::VisitRoots(RootVisitor* visitor, void* arg, bool only_dirty, b
   {
     ReaderMutexLock mu(self, *Locks::classlinker_classes_lock_);
     if (!only_dirty || class_table_dirty_) {
-      for (const std::pair<size_t, mirror::Class*>& it : class_table_) {
-        visitor(it.second, arg);
-      }
+      class_table_.Visit([visitor, arg](mirror::Class* klass) {
+        visitor(klass, arg);
+        return true;
+      });
       if (clean_dirty) {
         class_table_dirty_ = false;
       }
@@ -1131,11 +1216,9 @@ void ClassLinker::VisitClasses(ClassVisitor* visitor, void* arg) {
     MoveImageClassesToClassTable();
   }
   ReaderMutexLock mu(Thread::Current(), *Locks::classlinker_classes_lock_);
-  for (const std::pair<size_t, mirror::Class*>& it : class_table_) {
-    if (!visitor(it.second, arg)) {
-      return;
-    }
-  }
+  class_table_.Visit([visitor, arg](mirror::Class* klass) {
+    return visitor(klass, arg);
+  });
 }
 
 static bool GetClassesVisitor(mirror::Class* c, void* arg) {
@@ -1174,6 +1257,23 @@ ClassLinker::~ClassLinker() {
   STLDeleteElements(&oat_files_);
 }
 
+// Returns the whole pages of a freshly allocated, and so zeroed, array to the kernel. The heap is
+// private anonymous memory, so the pages read back as zeroes and only become dirty again once an
+// element on them is written.
+static void ReleaseArrayPages(mirror::Array* array) {
+  byte* data = reinterpret_cast<byte*>(array->GetRawData(mirror::kHeapReferenceSize));
+  byte* begin = reinterpret_cast<byte*>(RoundUp(reinterpret_cast<uintptr_t>(data), kPageSize));
+  byte* end = reinterpret_cast<byte*>(
+      RoundDown(reinterpret_cast<uintptr_t>(data + array->GetLength() * mirror::kHeapReferenceSize),
+                kPageSize));
+  if (begin < end) {
+    int result = madvise(begin, end - begin, MADV_DONTNEED);
+    if (result == -1) {
+      PLOG(WARNING) << "madvise failed for dex cache array";
+    }
+  }
+}
+
 mirror::DexCache* ClassLinker::AllocDexCache(Thread* self, const DexFile& dex_file) {
   gc::Heap* heap = Runtime::Current()->GetHeap();
   mirror::Class* dex_cache_class = GetClassRoot(kJavaLangDexCache);
@@ -1214,6 +1314,13 @@ mirror::DexCache* ClassLinker::AllocDexCache(Thread* self, const DexFile& dex_fi
   if (initialized_static_storage.get() == NULL) {
     return NULL;
   }
+  // Most entries of these arrays are never resolved in a given process, and a miss only needs the
+  // entry to read as NULL, so let their pages be faulted in on first use instead of keeping them
+  // all dirty. The methods array is left alone as Init fills it with the resolution method.
+  ReleaseArrayPages(strings.get());
+  ReleaseArrayPages(types.get());
+  ReleaseArrayPages(fields.get());
+  ReleaseArrayPages(initialized_static_storage.get());
 
   dex_cache->Init(&dex_file,
                   location.get(),
@@ -1227,7 +1334,7 @@ mirror::DexCache* ClassLinker::AllocDexCache(Thread* self, const DexFile& dex_fi
 
 mirror::Class* ClassLinker::AllocClass(Thread* self, mirror::Class* java_lang_Class,
                                        size_t class_size) {
-  DCHECK_GE(class_size, sizeof(mirror::Class));
+  DCHECK_GE(class_size, mirror::Class::MinimumClassSize());
   gc::Heap* heap = Runtime::Current()->GetHeap();
   mirror::Object* k = heap->AllocObject(self, java_lang_Class, class_size);
   if (UNLIKELY(k == NULL)) {
@@ -1297,6 +1404,74 @@ mirror::Class* ClassLinker::FindSystemClass(const char* descriptor) {
   return FindClass(descriptor, NULL);
 }
 
+// Loads the descriptors a PreloadClasses call has not handed out yet, one at a time. Every
+// worker runs one of these until the descriptors run out.
+class PreloadClassesTask : public Task {
+ public:
+  PreloadClassesTask(ClassLinker* class_linker, const std::vector<std::string>* descriptors,
+                     AtomicInteger* next_index, AtomicInteger* loaded_count)
+      : class_linker_(class_linker), descriptors_(descriptors), next_index_(next_index),
+        loaded_count_(loaded_count) {
+  }
+
+  virtual void Run(Thread* self) {
+    while (true) {
+      size_t i = (*next_index_)++;
+      if (i >= descriptors_->size()) {
+        return;
+      }
+      const char* descriptor = (*descriptors_)[i].c_str();
+      // Only the boot class path is searched, as other loaders run managed code to load classes.
+      // Array classes are defined by the loader of their element type.
+      const char* element_descriptor = descriptor;
+      while (*element_descriptor == '[') {
+        ++element_descriptor;
+      }
+      if (element_descriptor[0] == '\0') {
+        continue;
+      }
+      bool is_primitive = element_descriptor[1] == '\0';
+      if (!is_primitive && !class_linker_->IsInBootClassPath(element_descriptor)) {
+        continue;
+      }
+      // Take the mutator lock per class so that a long list doesn't hold off suspension.
+      ScopedObjectAccess soa(self);
+      if (class_linker_->FindSystemClass(descriptor) != NULL) {
+        ++(*loaded_count_);
+      } else {
+        self->ClearException();
+      }
+    }
+  }
+
+  virtual void Finalize() {
+    delete this;
+  }
+
+ private:
+  ClassLinker* const class_linker_;
+  const std::vector<std::string>* const descriptors_;
+  AtomicInteger* const next_index_;
+  AtomicInteger* const loaded_count_;
+};
+
+size_t ClassLinker::PreloadClasses(Thread* self, const std::vector<std::string>& descriptors,
+                                   size_t thread_count) {
+  AtomicInteger next_index(0);
+  AtomicInteger loaded_count(0);
+  thread_count = std::max<size_t>(1, std::min(thread_count, descriptors.size()));
+  // The calling thread is one of the workers. The pool's threads are gone by the time this
+  // returns, so the zygote can still fork afterwards.
+  ThreadPool thread_pool(thread_count - 1);
+  for (size_t i = 0; i < thread_count; ++i) {
+    thread_pool.AddTask(self, new PreloadClassesTask(this, &descriptors, &next_index,
+                                                     &loaded_count));
+  }
+  thread_pool.StartWorkers(self);
+  thread_pool.Wait(self, true, false);
+  return loaded_count;
+}
+
 mirror::Class* ClassLinker::FindClass(const char* descriptor, mirror::ClassLoader* class_loader) {
   DCHECK_NE(*descriptor, '\0') << "descriptor is empty string";
   Thread* self = Thread::Current();
@@ -1404,6 +1579,11 @@ mirror::Class* ClassLinker::DefineClass(const char* descriptor,
       klass.reset(AllocClass(self, SizeOfClass(dex_file, dex_class_def)));
     }
   } else {
+    mirror::Class* image_class = DefineClassFromAppImage(self, descriptor, class_loader, dex_file,
+                                                         dex_class_def);
+    if (image_class != NULL || self->IsExceptionPending()) {
+      return image_class;
+    }
     klass.reset(AllocClass(self, SizeOfClass(dex_file, dex_class_def)));
   }
   if (UNLIKELY(klass.get() == NULL)) {
@@ -1483,9 +1663,9 @@ size_t ClassLinker::SizeOfClass(const DexFile& dex_file,
     }
   }
   // start with generic class data
-  size_t size = sizeof(mirror::Class);
+  size_t size = mirror::Class::MinimumClassSize();
   // follow with reference fields which must be contiguous at start
-  size += (num_ref * sizeof(uint32_t));
+  size += (num_ref * mirror::kHeapReferenceSize);
   // if there are 64-bit fields to add, make sure they are aligned
   if (num_64 != 0 && size != RoundUp(size, 8)) {  // for 64-bit alignment
     if (num_32 != 0) {
@@ -1610,6 +1790,13 @@ const void* ClassLinker::GetOatCodeFor(const DexFile& dex_file, uint16_t class_d
   return oat_class->GetOatMethod(oat_method_idx).GetCode();
 }
 
+bool ClassLinker::HasCompressedOatCode(const mirror::ArtMethod* method) {
+  if (method->IsAbstract() || method->IsProxyMethod()) {
+    return false;
+  }
+  return GetOatMethodFor(method).IsCodeCompressed();
+}
+
 // Returns true if the method must run with interpreter, false otherwise.
 static bool NeedsInterpreter(const mirror::ArtMethod* method, const void* code) {
   if (code == NULL) {
@@ -1661,7 +1848,10 @@ void ClassLinker::FixupStaticTrampolines(mirror::Class* klass) {
       // Only update static methods.
       continue;
     }
-    const void* code = oat_class->GetOatMethod(method_index).GetCode();
+    const OatFile::OatMethod oat_method = oat_class->GetOatMethod(method_index);
+    // Compressed code keeps the trampoline, which inflates it on the method's first call.
+    const void* code = oat_method.IsCodeCompressed() ? GetResolutionTrampoline(this)
+                                                     : oat_method.GetCode();
     const bool enter_interpreter = NeedsInterpreter(method, code);
     if (enter_interpreter) {
       // Use interpreter entry point.
@@ -1684,6 +1874,10 @@ static void LinkCode(SirtRef<mirror::ArtMethod>& method, const OatFile::OatClass
 
   // Install entry point from interpreter.
   Runtime* runtime = Runtime::Current();
+  if (oat_method.IsCodeCompressed()) {
+    // Don't inflate the code until the method is called, the trampoline does it then.
+    method->SetEntryPointFromCompiledCode(GetResolutionTrampoline(runtime->GetClassLinker()));
+  }
   bool enter_interpreter = NeedsInterpreter(method.get(), method->GetEntryPointFromCompiledCode());
   if (enter_interpreter) {
     method->SetEntryPointFromInterpreter(interpreter::artInterpreterToInterpreterBridge);
@@ -1712,10 +1906,77 @@ static void LinkCode(SirtRef<mirror::ArtMethod>& method, const OatFile::OatClass
   }
 
   // Allow instrumentation its chance to hijack code.
+  runtime->GetInstrumentation()->ApplyMethodFilter(method.get());
   runtime->GetInstrumentation()->UpdateMethodsCode(method.get(),
                                                    method->GetEntryPointFromCompiledCode());
 }
 
+mirror::Class* ClassLinker::DefineClassFromAppImage(Thread* self, const char* descriptor,
+                                                    mirror::ClassLoader* class_loader,
+                                                    const DexFile& dex_file,
+                                                    const DexFile::ClassDef& dex_class_def) {
+  mirror::Class* image_class;
+  {
+    ReaderMutexLock mu(self, dex_lock_);
+    SafeMap<const DexFile*, mirror::ObjectArray<mirror::Class>*>::const_iterator it =
+        app_image_classes_.find(&dex_file);
+    if (it == app_image_classes_.end()) {
+      return NULL;
+    }
+    image_class = it->second->Get(dex_file.GetIndexForClassDef(dex_class_def));
+  }
+  if (image_class == NULL || class_loader == NULL) {
+    return NULL;
+  }
+  SirtRef<mirror::Class> klass(self, image_class);
+
+  // The image class was linked against the classes the compiler resolved, make sure the class
+  // loader resolves the same ones. App classes among these are defined from the image first.
+  mirror::DexCache* dex_cache = klass->GetDexCache();
+  if (dex_class_def.superclass_idx_ != DexFile::kDexNoIndex16) {
+    mirror::Class* super_class = ResolveType(dex_file, dex_class_def.superclass_idx_, dex_cache,
+                                             class_loader);
+    if (super_class != klass->GetSuperClass()) {
+      return NULL;
+    }
+  }
+  const DexFile::TypeList* interfaces = dex_file.GetInterfacesList(dex_class_def);
+  if (interfaces != NULL) {
+    for (size_t i = 0; i < interfaces->Size(); ++i) {
+      mirror::Class* interface = ResolveType(dex_file, interfaces->GetTypeItem(i).type_idx_,
+                                             dex_cache, class_loader);
+      if (interface == NULL || !interface->IsAssignableFrom(klass.get())) {
+        return NULL;
+      }
+    }
+  }
+
+  ObjectLock lock(self, klass.get());
+  if (klass->GetClinitThreadId() != 0) {
+    // Already defined from the image, possibly by another class loader sharing the dex file.
+    return NULL;
+  }
+  klass->SetClinitThreadId(self->GetTid());
+  klass->SetClassLoader(class_loader);
+  UniquePtr<const OatFile::OatClass> oat_class(GetOatClass(dex_file,
+                                                         klass->GetDexClassDefIndex()));
+  for (size_t i = 0; i < klass->NumDirectMethods(); ++i) {
+    SirtRef<mirror::ArtMethod> method(self, klass->GetDirectMethod(i));
+    LinkCode(method, oat_class.get(), i);
+  }
+  for (size_t i = 0; i < klass->NumVirtualMethods(); ++i) {
+    SirtRef<mirror::ArtMethod> method(self, klass->GetVirtualMethod(i));
+    LinkCode(method, oat_class.get(), klass->NumDirectMethods() + i);
+  }
+  mirror::Class* existing = InsertClass(descriptor, klass.get(), Hash(descriptor));
+  if (existing != NULL) {
+    // We raced with another thread defining the class the usual way.
+    return EnsureResolved(self, existing);
+  }
+  Dbg::PostClassPrepare(klass.get());
+  return klass.get();
+}
+
 void ClassLinker::LoadClass(const DexFile& dex_file,
                             const DexFile::ClassDef& dex_class_def,
                             SirtRef<mirror::Class>& klass,
@@ -1957,7 +2218,11 @@ void ClassLinker::RegisterDexFile(const DexFile& dex_file) {
   // Don't alloc while holding the lock, since allocation may need to
   // suspend all threads and another thread may need the dex_lock_ to
   // get to a suspend point.
-  SirtRef<mirror::DexCache> dex_cache(self, AllocDexCache(self, dex_file));
+  mirror::ObjectArray<mirror::Class>* image_classes = NULL;
+  SirtRef<mirror::DexCache> dex_cache(self, FindAppImageDexCache(dex_file, &image_classes));
+  if (dex_cache.get() == NULL) {
+    dex_cache.reset(AllocDexCache(self, dex_file));
+  }
   CHECK(dex_cache.get() != NULL) << "Failed to allocate dex cache for " << dex_file.GetLocation();
   {
     WriterMutexLock mu(self, dex_lock_);
@@ -1965,7 +2230,90 @@ void ClassLinker::RegisterDexFile(const DexFile& dex_file) {
       return;
     }
     RegisterDexFileLocked(dex_file, dex_cache);
+    if (image_classes != NULL) {
+      app_image_classes_.Put(&dex_file, image_classes);
+    }
+  }
+}
+
+// App images are written next to their oat file, with an .art extension.
+static std::string GetAppImageLocation(const std::string& oat_location) {
+  std::string image_location(oat_location);
+  size_t extension = image_location.rfind('.');
+  if (extension != std::string::npos && image_location.find('/', extension) == std::string::npos) {
+    image_location.erase(extension);
+  }
+  return image_location + ".art";
+}
+
+gc::space::ImageSpace* ClassLinker::OpenAppImage(const OatFile& oat_file) {
+  Thread* self = Thread::Current();
+  {
+    WriterMutexLock mu(self, dex_lock_);
+    SafeMap<const OatFile*, gc::space::ImageSpace*>::const_iterator it =
+        app_images_.find(&oat_file);
+    if (it != app_images_.end()) {
+      return it->second;
+    }
+    // Threads asking while the image is mapped do without it.
+    app_images_.Put(&oat_file, NULL);
+  }
+  gc::space::ImageSpace* space =
+      gc::space::ImageSpace::CreateAppImage(GetAppImageLocation(oat_file.GetLocation()), oat_file);
+  if (space == NULL) {
+    return NULL;
+  }
+  Runtime::Current()->GetHeap()->AddAppImageSpace(space);
+  WriterMutexLock mu(self, dex_lock_);
+  app_images_.Overwrite(&oat_file, space);
+  return space;
+}
+
+mirror::DexCache* ClassLinker::FindAppImageDexCache(
+    const DexFile& dex_file, mirror::ObjectArray<mirror::Class>** image_classes) {
+  Runtime* runtime = Runtime::Current();
+  if (runtime->IsCompiler() || !init_done_) {
+    return NULL;
   }
+  const OatFile* oat_file = FindOpenedOatFileForDexFile(dex_file);
+  if (oat_file == NULL) {
+    return NULL;
+  }
+  gc::space::ImageSpace* space = OpenAppImage(*oat_file);
+  if (space == NULL) {
+    return NULL;
+  }
+  const ImageHeader& image_header = space->GetImageHeader();
+  mirror::ObjectArray<mirror::DexCache>* dex_caches =
+      image_header.GetImageRoot(ImageHeader::kDexCaches)->AsObjectArray<mirror::DexCache>();
+  mirror::ObjectArray<mirror::Object>* classes =
+      image_header.GetImageRoot(ImageHeader::kClassRoots)->AsObjectArray<mirror::Object>();
+  for (int32_t i = 0; i < dex_caches->GetLength(); ++i) {
+    mirror::DexCache* dex_cache = dex_caches->Get(i);
+    // The DexFile is set once the DexCache is registered.
+    if (dex_cache->GetDexFile() != NULL ||
+        !dex_cache->GetLocation()->Equals(dex_file.GetLocation()) ||
+        dex_cache->NumResolvedTypes() != dex_file.NumTypeIds() ||
+        dex_cache->NumStrings() != dex_file.NumStringIds()) {
+      continue;
+    }
+    // Strings were interned by the compiler, intern them in this runtime too so that they are the
+    // same as equal strings from elsewhere.
+    InternTable* intern_table = runtime->GetInternTable();
+    mirror::ObjectArray<mirror::String>* strings = dex_cache->GetStrings();
+    for (int32_t string_idx = 0; string_idx < strings->GetLength(); ++string_idx) {
+      mirror::String* string = strings->Get(string_idx);
+      if (string != NULL) {
+        mirror::String* interned = intern_table->InternStrong(string);
+        if (interned != string) {
+          strings->Set(string_idx, interned);
+        }
+      }
+    }
+    *image_classes = classes->Get(i)->AsObjectArray<mirror::Class>();
+    return dex_cache;
+  }
+  return NULL;
 }
 
 void ClassLinker::RegisterDexFile(const DexFile& dex_file, SirtRef<mirror::DexCache>& dex_cache) {
@@ -2007,7 +2355,7 @@ void ClassLinker::FixupDexCaches(mirror::ArtMethod* resolution_method) const {
 }
 
 mirror::Class* ClassLinker::CreatePrimitiveClass(Thread* self, Primitive::Type type) {
-  mirror::Class* klass = AllocClass(self, sizeof(mirror::Class));
+  mirror::Class* klass = AllocClass(self, mirror::Class::MinimumClassSize());
   if (UNLIKELY(klass == NULL)) {
     return NULL;
   }
@@ -2106,7 +2454,7 @@ mirror::Class* ClassLinker::CreateArrayClass(const char* descriptor,
     }
   }
   if (new_class.get() == NULL) {
-    new_class.reset(AllocClass(self, sizeof(mirror::Class)));
+    new_class.reset(AllocClass(self, mirror::Class::MinimumClassSize()));
     if (new_class.get() == NULL) {
       return NULL;
     }
@@ -2116,6 +2464,7 @@ mirror::Class* ClassLinker::CreateArrayClass(const char* descriptor,
   DCHECK(new_class->GetComponentType() != NULL);
   mirror::Class* java_lang_Object = GetClassRoot(kJavaLangObject);
   new_class->SetSuperClass(java_lang_Object);
+  new_class->SetUpSuperClassDisplay();
   new_class->SetVTable(java_lang_Object->GetVTable());
   new_class->SetPrimitiveType(Primitive::kPrimNot);
   new_class->SetClassLoader(component_type->GetClassLoader());
@@ -2217,7 +2566,7 @@ mirror::Class* ClassLinker::InsertClass(const char* descriptor, mirror::Class* k
     }
   }
   Runtime::Current()->GetHeap()->VerifyObject(klass);
-  class_table_.insert(std::make_pair(hash, klass));
+  class_table_.Insert(hash, klass);
   class_table_dirty_ = true;
   return NULL;
 }
@@ -2225,17 +2574,12 @@ mirror::Class* ClassLinker::InsertClass(const char* descriptor, mirror::Class* k
 bool ClassLinker::RemoveClass(const char* descriptor, const mirror::ClassLoader* class_loader) {
   size_t hash = Hash(descriptor);
   WriterMutexLock mu(Thread::Current(), *Locks::classlinker_classes_lock_);
-  ClassHelper kh;
-  for (auto it = class_table_.lower_bound(hash), end = class_table_.end(); it != end && it->first == hash;
-       ++it) {
-    mirror::Class* klass = it->second;
-    kh.ChangeClass(klass);
-    if (strcmp(kh.GetDescriptor(), descriptor) == 0 && klass->GetClassLoader() == class_loader) {
-      class_table_.erase(it);
-      return true;
-    }
+  mirror::Class* klass = LookupClassFromTableLocked(descriptor, class_loader, hash);
+  if (klass == NULL) {
+    return false;
   }
-  return false;
+  class_table_.Remove(hash, klass);
+  return true;
 }
 
 mirror::Class* ClassLinker::LookupClass(const char* descriptor,
@@ -2272,25 +2616,24 @@ mirror::Class* ClassLinker::LookupClassFromTableLocked(const char* descriptor,
                                                        const mirror::ClassLoader* class_loader,
                                                        size_t hash) {
   ClassHelper kh(NULL, this);
-  auto end = class_table_.end();
-  for (auto it = class_table_.lower_bound(hash); it != end && it->first == hash; ++it) {
-    mirror::Class* klass = it->second;
+  mirror::Class* result = NULL;
+  class_table_.Find(hash, [&](mirror::Class* klass) NO_THREAD_SAFETY_ANALYSIS {
     kh.ChangeClass(klass);
-    if (klass->GetClassLoader() == class_loader && strcmp(descriptor, kh.GetDescriptor()) == 0) {
-      if (kIsDebugBuild) {
-        // Check for duplicates in the table.
-        for (++it; it != end && it->first == hash; ++it) {
-          mirror::Class* klass2 = it->second;
-          kh.ChangeClass(klass2);
-          CHECK(!(strcmp(descriptor, kh.GetDescriptor()) == 0 && klass2->GetClassLoader() == class_loader))
-          << PrettyClass(klass) << " " << klass << " " << klass->GetClassLoader() << " "
-          << PrettyClass(klass2) << " " << klass2 << " " << klass2->GetClassLoader();
-        }
-      }
-      return klass;
+    if (klass->GetClassLoader() != class_loader || strcmp(descriptor, kh.GetDescriptor()) != 0) {
+      return false;
     }
-  }
-  return NULL;
+    if (!kIsDebugBuild) {
+      result = klass;
+      return true;
+    }
+    // Check for duplicates in the table by carrying on with the probe sequence.
+    CHECK(result == NULL)
+        << PrettyClass(result) << " " << result << " " << result->GetClassLoader() << " "
+        << PrettyClass(klass) << " " << klass << " " << klass->GetClassLoader();
+    result = klass;
+    return false;
+  });
+  return result;
 }
 
 static mirror::ObjectArray<mirror::DexCache>* GetImageDexCaches()
@@ -2326,7 +2669,7 @@ void ClassLinker::MoveImageClassesToClassTable() {
           CHECK(existing == klass) << PrettyClassAndClassLoader(existing) << " != "
               << PrettyClassAndClassLoader(klass);
         } else {
-          class_table_.insert(std::make_pair(hash, klass));
+          class_table_.Insert(hash, klass);
         }
       }
     }
@@ -2386,14 +2729,13 @@ void ClassLinker::LookupClasses(const char* descriptor, std::vector<mirror::Clas
   size_t hash = Hash(descriptor);
   ReaderMutexLock mu(Thread::Current(), *Locks::classlinker_classes_lock_);
   ClassHelper kh(NULL, this);
-  for (auto it = class_table_.lower_bound(hash), end = class_table_.end();
-      it != end && it->first == hash; ++it) {
-    mirror::Class* klass = it->second;
+  class_table_.Find(hash, [&](mirror::Class* klass) NO_THREAD_SAFETY_ANALYSIS {
     kh.ChangeClass(klass);
     if (strcmp(descriptor, kh.GetDescriptor()) == 0) {
       result.push_back(klass);
     }
-  }
+    return false;
+  });
 }
 
 void ClassLinker::VerifyClass(mirror::Class* klass) {
@@ -2466,9 +2808,16 @@ void ClassLinker::VerifyClass(mirror::Class* klass) {
   verifier::MethodVerifier::FailureKind verifier_failure = verifier::MethodVerifier::kNoFailure;
   std::string error_msg;
   if (!preverified) {
-    verifier_failure = verifier::MethodVerifier::VerifyClass(klass,
-                                                             Runtime::Current()->IsCompiler(),
-                                                             &error_msg);
+    if (oat_file_class_status == mirror::Class::kStatusRetryVerificationAtRuntime &&
+        VerificationDependenciesStillUnresolved(dex_file, klass)) {
+      VLOG(class_linker) << "Skipping runtime verification of " << PrettyDescriptor(klass)
+          << " whose verification dependencies are still unresolved";
+      verifier_failure = verifier::MethodVerifier::kSoftFailure;
+    } else {
+      verifier_failure = verifier::MethodVerifier::VerifyClass(klass,
+                                                               Runtime::Current()->IsCompiler(),
+                                                               &error_msg);
+    }
   }
   if (preverified || verifier_failure != verifier::MethodVerifier::kHardFailure) {
     if (!preverified && verifier_failure != verifier::MethodVerifier::kNoFailure) {
@@ -2599,6 +2948,39 @@ bool ClassLinker::VerifyClassUsingOatFile(const DexFile& dex_file, mirror::Class
   return false;
 }
 
+bool ClassLinker::VerificationDependenciesStillUnresolved(const DexFile& dex_file,
+                                                          mirror::Class* klass) {
+  // Only the runtime verifier turns soft failures into checks in the interpreter.
+  if (Runtime::Current()->IsCompiler()) {
+    return false;
+  }
+  const OatFile* oat_file = FindOpenedOatFileForDexFile(dex_file);
+  if (oat_file == NULL) {
+    return false;
+  }
+  uint dex_location_checksum = dex_file.GetLocationChecksum();
+  const OatFile::OatDexFile* oat_dex_file = oat_file->GetOatDexFile(dex_file.GetLocation(),
+                                                                    &dex_location_checksum);
+  if (oat_dex_file == NULL) {
+    return false;
+  }
+  UniquePtr<const OatFile::OatClass> oat_class(
+      oat_dex_file->GetOatClass(klass->GetDexClassDefIndex()));
+  if (oat_class.get() == NULL || oat_class->NumVerificationDependencies() == 0) {
+    return false;
+  }
+  Thread* self = Thread::Current();
+  for (size_t i = 0; i < oat_class->NumVerificationDependencies(); ++i) {
+    // Resolve as the verifier would, a type which resolves now may change the outcome.
+    if (ResolveType(dex_file, oat_class->GetVerificationDependency(i), klass) != NULL) {
+      return false;
+    }
+    DCHECK(self->IsExceptionPending());
+    self->ClearException();
+  }
+  return true;
+}
+
 void ClassLinker::ResolveClassExceptionHandlerTypes(const DexFile& dex_file, mirror::Class* klass) {
   for (size_t i = 0; i < klass->NumDirectMethods(); i++) {
     ResolveMethodExceptionHandlerTypes(dex_file, klass->GetDirectMethod(i));
@@ -2747,6 +3129,11 @@ mirror::Class* ClassLinker::CreateProxyClass(mirror::String* name,
 
     interfaces_sfield->SetObject(klass.get(), interfaces);
     throws_sfield->SetObject(klass.get(), throws);
+    // Proxy classes skip InitializeClass, which builds the interface method table.
+    if (!LinkInterfaceMethodTable(self, klass->GetIfTable())) {
+      klass->SetStatus(mirror::Class::kStatusError, self);
+      return NULL;
+    }
     klass->SetStatus(mirror::Class::kStatusInitialized, self);
   }
 
@@ -3052,6 +3439,13 @@ bool ClassLinker::InitializeClass(mirror::Class* klass, bool can_init_statics,
     }
   }
 
+  // Interface calls can only be made on instances, which can't exist before initialization, so
+  // classes that are loaded but never initialized don't pay for an interface method table.
+  // Without one calls fall back to searching the iftable, so failing to allocate it is harmless.
+  if (!LinkInterfaceMethodTable(self, klass->GetIfTable())) {
+    self->ClearException();
+  }
+
   mirror::ArtMethod* clinit = klass->FindDeclaredDirectMethod("<clinit>", "()V");
   if (clinit != NULL) {
     CHECK(can_init_statics);
@@ -3322,6 +3716,7 @@ bool ClassLinker::LinkSuperClass(SirtRef<mirror::Class>& klass) {
       ThrowClassFormatError(klass.get(), "java.lang.Object must not have a superclass");
       return false;
     }
+    klass->SetUpSuperClassDisplay();
     return true;
   }
   if (super == NULL) {
@@ -3369,6 +3764,9 @@ bool ClassLinker::LinkSuperClass(SirtRef<mirror::Class>& klass) {
       super = super->GetSuperClass();
     }
   }
+  if (!klass->IsInterface()) {
+    klass->SetUpSuperClassDisplay();
+  }
   return true;
 }
 
@@ -3518,7 +3916,9 @@ bool ClassLinker::LinkInterfaceMethods(SirtRef<mirror::Class>& klass,
     }
   }
   Thread* self = Thread::Current();
-  SirtRef<mirror::IfTable> iftable(self, AllocIfTable(self, ifcount));
+  // Interfaces are never the receiver of an interface dispatch, so they don't need a method table.
+  const bool with_imtable = !klass->IsInterface();
+  SirtRef<mirror::IfTable> iftable(self, AllocIfTable(self, ifcount, with_imtable));
   if (UNLIKELY(iftable.get() == NULL)) {
     CHECK(self->IsExceptionPending());  // OOME.
     return false;
@@ -3573,7 +3973,8 @@ bool ClassLinker::LinkInterfaceMethods(SirtRef<mirror::Class>& klass,
   }
   // Shrink iftable in case duplicates were found
   if (idx < ifcount) {
-    iftable.reset(down_cast<mirror::IfTable*>(iftable->CopyOf(self, idx * mirror::IfTable::kMax)));
+    const size_t length = idx * mirror::IfTable::kMax + (with_imtable ? 1 : 0);
+    iftable.reset(down_cast<mirror::IfTable*>(iftable->CopyOf(self, length)));
     if (UNLIKELY(iftable.get() == NULL)) {
       CHECK(self->IsExceptionPending());  // OOME.
       return false;
@@ -3591,6 +3992,13 @@ bool ClassLinker::LinkInterfaceMethods(SirtRef<mirror::Class>& klass,
   std::vector<mirror::ArtMethod*> miranda_list;
   MethodHelper vtable_mh(NULL, this);
   MethodHelper interface_mh(NULL, this);
+  // Index the vtable by name, rather than comparing every interface method with every entry.
+  MemberNameIndex vtable_index;
+  for (int32_t k = 0; k < klass->GetVTableDuringLinking()->GetLength(); ++k) {
+    vtable_mh.ChangeMethod(klass->GetVTableDuringLinking()->Get(k));
+    vtable_index.Add(vtable_mh.GetName(), k);
+  }
+  vtable_index.Sort();
   for (size_t i = 0; i < ifcount; ++i) {
     mirror::Class* interface = iftable->GetInterface(i);
     size_t num_methods = interface->NumVirtualMethods();
@@ -3606,31 +4014,34 @@ bool ClassLinker::LinkInterfaceMethods(SirtRef<mirror::Class>& klass,
       for (size_t j = 0; j < num_methods; ++j) {
         mirror::ArtMethod* interface_method = interface->GetVirtualMethod(j);
         interface_mh.ChangeMethod(interface_method);
-        int32_t k;
+        int32_t k = -1;
         // For each method listed in the interface's method list, find the
         // matching method in our class's method list.  We want to favor the
-        // subclass over the superclass, which just requires walking
-        // back from the end of the vtable.  (This only matters if the
+        // subclass over the superclass, which just requires taking the last
+        // match in the vtable.  (This only matters if the
         // superclass defines a private method and this class redefines
         // it -- otherwise it would use the same vtable slot.  In .dex files
         // those don't end up in the virtual method table, so it shouldn't
-        // matter which direction we go.  We walk it backward anyway.)
-        for (k = vtable->GetLength() - 1; k >= 0; --k) {
-          mirror::ArtMethod* vtable_method = vtable->Get(k);
-          vtable_mh.ChangeMethod(vtable_method);
+        // matter which one we take.  We take the last anyway.)
+        MemberCandidates candidates(vtable_index.Find(interface_mh.GetName()));
+        while (!candidates.Done()) {
+          size_t candidate = candidates.Next();
+          vtable_mh.ChangeMethod(vtable->Get(candidate));
           if (interface_mh.HasSameNameAndSignature(&vtable_mh)) {
-            if (!vtable_method->IsAbstract() && !vtable_method->IsPublic()) {
-              ThrowIllegalAccessError(klass.get(),
-                                      "Method '%s' implementing interface method '%s' is not public",
-                                      PrettyMethod(vtable_method).c_str(),
-                                      PrettyMethod(interface_method).c_str());
-              return false;
-            }
-            method_array->Set(j, vtable_method);
-            break;
+            k = candidate;
           }
         }
-        if (k < 0) {
+        if (k >= 0) {
+          mirror::ArtMethod* vtable_method = vtable->Get(k);
+          if (!vtable_method->IsAbstract() && !vtable_method->IsPublic()) {
+            ThrowIllegalAccessError(klass.get(),
+                                    "Method '%s' implementing interface method '%s' is not public",
+                                    PrettyMethod(vtable_method).c_str(),
+                                    PrettyMethod(interface_method).c_str());
+            return false;
+          }
+          method_array->Set(j, vtable_method);
+        } else {
           SirtRef<mirror::ArtMethod> miranda_method(self, NULL);
           for (size_t mir = 0; mir < miranda_list.size(); mir++) {
             mirror::ArtMethod* mir_method = miranda_list[mir];
@@ -3702,6 +4113,59 @@ bool ClassLinker::LinkInterfaceMethods(SirtRef<mirror::Class>& klass,
 
 //  klass->DumpClass(std::cerr, Class::kDumpClassFullDetail);
 
+  // The interface method table is left to InitializeClass, see LinkInterfaceMethodTable.
+  return true;
+}
+
+bool ClassLinker::LinkInterfaceMethodTable(Thread* self, mirror::IfTable* iftable) {
+  if (iftable == NULL || !iftable->HasImTableSlot() || iftable->GetImTable() != NULL) {
+    // No interfaces, an interface's iftable, or the table was already built.
+    return true;
+  }
+  size_t num_interface_methods = 0;
+  const size_t ifcount = iftable->Count();
+  for (size_t i = 0; i < ifcount; ++i) {
+    num_interface_methods += iftable->GetMethodArrayCount(i);
+  }
+  if (num_interface_methods == 0) {
+    // Only marker interfaces, nothing to dispatch.
+    return true;
+  }
+  SirtRef<mirror::IfTable> iftable_ref(self, iftable);
+  const size_t imtable_length = mirror::IfTable::kImtSize * mirror::IfTable::kImtMax;
+  mirror::ObjectArray<mirror::ArtMethod>* imtable = AllocArtMethodArray(self, imtable_length);
+  if (UNLIKELY(imtable == NULL)) {
+    CHECK(self->IsExceptionPending());  // OOME.
+    return false;
+  }
+  std::vector<bool> conflicts(mirror::IfTable::kImtSize, false);
+  for (size_t i = 0; i < ifcount; ++i) {
+    const size_t num_methods = iftable_ref->GetMethodArrayCount(i);
+    if (num_methods == 0) {
+      continue;
+    }
+    mirror::Class* interface = iftable_ref->GetInterface(i);
+    mirror::ObjectArray<mirror::ArtMethod>* method_array = iftable_ref->GetMethodArray(i);
+    for (size_t j = 0; j < num_methods; ++j) {
+      mirror::ArtMethod* interface_method = interface->GetVirtualMethod(j);
+      const uint32_t dex_method_idx = interface_method->GetDexMethodIndex();
+      const size_t index = mirror::IfTable::ImtIndex(dex_method_idx);
+      const size_t slot = dex_method_idx % mirror::IfTable::kImtSize;
+      if (conflicts[slot]) {
+        continue;
+      }
+      if (imtable->Get(index + mirror::IfTable::kImtInterfaceMethod) != NULL) {
+        // Another interface method hashed here first, leave both to the iftable search.
+        imtable->Set(index + mirror::IfTable::kImtInterfaceMethod, NULL);
+        imtable->Set(index + mirror::IfTable::kImtMethod, NULL);
+        conflicts[slot] = true;
+        continue;
+      }
+      imtable->Set(index + mirror::IfTable::kImtInterfaceMethod, interface_method);
+      imtable->Set(index + mirror::IfTable::kImtMethod, method_array->Get(j));
+    }
+  }
+  iftable_ref->SetImTable(imtable);
   return true;
 }
 
@@ -3751,6 +4215,34 @@ struct LinkFieldsComparator {
   FieldHelper* fh_;
 };
 
+// Collects, in increasing order, the offsets of the 32-bit words of an instance of klass that
+// none of its fields or those of its superclasses occupy. A class leaves such a gap when it has
+// no 32-bit field to put in front of its 64-bit fields to align them, and its subclasses can put
+// their own 32-bit fields there instead of growing the object.
+static void FindInstanceFieldGaps(mirror::Class* klass, FieldHelper* fh,
+                                  std::deque<uint32_t>* gaps)
+    SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
+  std::vector<bool> used(klass->GetObjectSize() / sizeof(uint32_t), false);
+  for (mirror::Class* c = klass; c != NULL; c = c->GetSuperClass()) {
+    mirror::ObjectArray<mirror::ArtField>* fields = c->GetIFields();
+    for (size_t i = 0; i < c->NumInstanceFields(); ++i) {
+      mirror::ArtField* field = fields->Get(i);
+      fh->ChangeField(field);
+      Primitive::Type type = fh->GetTypeAsPrimitiveType();
+      size_t words = (type == Primitive::kPrimLong || type == Primitive::kPrimDouble) ? 2 : 1;
+      size_t word = field->GetOffset().Uint32Value() / sizeof(uint32_t);
+      for (size_t j = word; j < word + words && j < used.size(); ++j) {
+        used[j] = true;
+      }
+    }
+  }
+  for (size_t word = sizeof(mirror::Object) / sizeof(uint32_t); word < used.size(); ++word) {
+    if (!used[word]) {
+      gaps->push_back(word * sizeof(uint32_t));
+    }
+  }
+}
+
 bool ClassLinker::LinkFields(SirtRef<mirror::Class>& klass, bool is_static) {
   size_t num_fields =
       is_static ? klass->NumStaticFields() : klass->NumInstanceFields();
@@ -3786,6 +4278,19 @@ bool ClassLinker::LinkFields(SirtRef<mirror::Class>& klass, bool is_static) {
             grouped_and_sorted_fields.end(),
             LinkFieldsComparator(&fh));
 
+  // Look for unused words in the superclasses' part of an instance, if there is a 32-bit field to
+  // put in them. Those sort last.
+  std::deque<uint32_t> gaps;
+  mirror::Class* super_class = klass->GetSuperClass();
+  if (!is_static && num_fields != 0 && super_class != NULL && !super_class->IsVariableSize()) {
+    fh.ChangeField(grouped_and_sorted_fields.back());
+    Primitive::Type type = fh.GetTypeAsPrimitiveType();
+    if (type != Primitive::kPrimNot && type != Primitive::kPrimLong &&
+        type != Primitive::kPrimDouble) {
+      FindInstanceFieldGaps(super_class, &fh, &gaps);
+    }
+  }
+
   // References should be at the front.
   size_t current_field = 0;
   size_t num_reference_fields = 0;
@@ -3801,7 +4306,23 @@ bool ClassLinker::LinkFields(SirtRef<mirror::Class>& klass, bool is_static) {
     num_reference_fields++;
     fields->Set(current_field, field);
     field->SetOffset(field_offset);
-    field_offset = MemberOffset(field_offset.Uint32Value() + sizeof(uint32_t));
+    field_offset = MemberOffset(field_offset.Uint32Value() + mirror::kHeapReferenceSize);
+  }
+
+  // Fill the gaps the superclasses left with 32-bit fields, in name order.
+  for (size_t i = 0; i < grouped_and_sorted_fields.size() && !gaps.empty(); ) {
+    mirror::ArtField* field = grouped_and_sorted_fields[i];
+    fh.ChangeField(field);
+    Primitive::Type type = fh.GetTypeAsPrimitiveType();
+    CHECK(type != Primitive::kPrimNot);  // should only be working on primitive types
+    if (type == Primitive::kPrimLong || type == Primitive::kPrimDouble) {
+      ++i;
+      continue;
+    }
+    fields->Set(current_field++, field);
+    field->SetOffset(MemberOffset(gaps.front()));
+    gaps.pop_front();
+    grouped_and_sorted_fields.erase(grouped_and_sorted_fields.begin() + i);
   }
 
   // Now we want to pack all of the double-wide fields together.  If
@@ -3943,6 +4464,14 @@ void ClassLinker::CreateReferenceOffsets(SirtRef<mirror::Class>& klass, bool is_
     const mirror::ArtField* field = fields->Get(i);
     MemberOffset byte_offset = field->GetOffsetDuringLinking();
     CHECK_EQ(byte_offset.Uint32Value() & (CLASS_OFFSET_ALIGNMENT - 1), 0U);
+    // Without a bitmap the GC finds the references as a run per class, see VisitFieldsReferences.
+    if (kIsDebugBuild) {
+      mirror::Class* super_class = klass->GetSuperClass();
+      uint32_t first_offset = is_static ? mirror::Class::FieldsOffset().Uint32Value()
+          : ((super_class != NULL) ? super_class->GetObjectSize() : 0);
+      CHECK_EQ(byte_offset.Uint32Value(), first_offset + i * mirror::kHeapReferenceSize)
+          << PrettyField(field);
+    }
     if (CLASS_CAN_ENCODE_OFFSET(byte_offset.Uint32Value())) {
       uint32_t new_bit = CLASS_BIT_FROM_OFFSET(byte_offset.Uint32Value());
       CHECK_NE(new_bit, 0U);
@@ -4239,9 +4768,10 @@ void ClassLinker::DumpAllClasses(int flags) {
   std::vector<mirror::Class*> all_classes;
   {
     ReaderMutexLock mu(Thread::Current(), *Locks::classlinker_classes_lock_);
-    for (const std::pair<size_t, mirror::Class*>& it : class_table_) {
-      all_classes.push_back(it.second);
-    }
+    class_table_.Visit([&all_classes](mirror::Class* klass) {
+      all_classes.push_back(klass);
+      return true;
+    });
   }
 
   for (size_t i = 0; i < all_classes.size(); ++i) {
@@ -4254,7 +4784,7 @@ void ClassLinker::DumpForSigQuit(std::ostream& os) {
     MoveImageClassesToClassTable();
   }
   ReaderMutexLock mu(Thread::Current(), *Locks::classlinker_classes_lock_);
-  os << "Loaded classes: " << class_table_.size() << " allocated classes\n";
+  os << "Loaded classes: " << class_table_.Size() << " allocated classes\n";
 }
 
 size_t ClassLinker::NumLoadedClasses() {
@@ -4262,7 +4792,7 @@ size_t ClassLinker::NumLoadedClasses() {
     MoveImageClassesToClassTable();
   }
   ReaderMutexLock mu(Thread::Current(), *Locks::classlinker_classes_lock_);
-  return class_table_.size();
+  return class_table_.Size();
 }
 
 pid_t ClassLinker::GetClassesLockOwner() {
@@ -25,6 +25,7 @@
 #include "base/mutex.h"
 #include "dex_file.h"
 #include "gtest/gtest.h"
+#include "member_index.h"
 #include "root_visitor.h"
 #include "oat_file.h"
 
@@ -72,6 +73,14 @@ class ClassLinker {
   mirror::Class* FindSystemClass(const char* descriptor)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
 
+  // Loads and links the boot class path classes with the given descriptors on thread_count
+  // threads, the caller included, so that their dex and oat file I/O and linking overlap. The
+  // classes aren't initialized. Descriptors that the boot class path doesn't define, or whose
+  // class fails to load, are skipped. Returns the number of classes found.
+  size_t PreloadClasses(Thread* self, const std::vector<std::string>& descriptors,
+                        size_t thread_count)
+      LOCKS_EXCLUDED(Locks::mutator_lock_);
+
   // Define a new a class based on a ClassDef from a DexFile
   mirror::Class* DefineClass(const char* descriptor, mirror::ClassLoader* class_loader,
                              const DexFile& dex_file, const DexFile::ClassDef& dex_class_def)
@@ -270,8 +279,7 @@ class ClassLinker {
   // Find a DexFile within an OatFile given a DexFile location. Note
   // that this returns null if the location checksum of the DexFile
   // does not match the OatFile.
-  const DexFile* FindDexFileInOatFileFromDexLocation(const std::string& location,
-                                                     uint32_t location_checksum)
+  const DexFile* FindDexFileInOatFileFromDexLocation(const std::string& location)
       LOCKS_EXCLUDED(dex_lock_)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
 
@@ -296,7 +304,9 @@ class ClassLinker {
   mirror::ObjectArray<mirror::ArtMethod>* AllocArtMethodArray(Thread* self, size_t length)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
 
-  mirror::IfTable* AllocIfTable(Thread* self, size_t ifcount)
+  // Allocates an iftable for ifcount interfaces, with a slot for an interface method table if
+  // with_imtable is true.
+  mirror::IfTable* AllocIfTable(Thread* self, size_t ifcount, bool with_imtable)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
 
   mirror::ObjectArray<mirror::ArtField>* AllocArtFieldArray(Thread* self, size_t length)
@@ -310,6 +320,10 @@ class ClassLinker {
   bool VerifyClassUsingOatFile(const DexFile& dex_file, mirror::Class* klass,
                                mirror::Class::Status& oat_file_class_status)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+  // Returns true if the class has verification dependencies in the oat file and none of them
+  // resolves yet, in which case verifying it again would only find the same soft failures.
+  bool VerificationDependenciesStillUnresolved(const DexFile& dex_file, mirror::Class* klass)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
   void ResolveClassExceptionHandlerTypes(const DexFile& dex_file, mirror::Class* klass)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
   void ResolveMethodExceptionHandlerTypes(const DexFile& dex_file, mirror::ArtMethod* klass)
@@ -335,6 +349,10 @@ class ClassLinker {
   const void* GetOatCodeFor(const DexFile& dex_file, uint16_t class_def_idx, uint32_t method_idx)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
 
+  // Is the method's code compressed in its oat file? GetOatCodeFor inflates it.
+  bool HasCompressedOatCode(const mirror::ArtMethod* method)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
   pid_t GetClassesLockOwner();  // For SignalCatcher.
   pid_t GetDexLockOwner();  // For SignalCatcher.
 
@@ -350,6 +368,11 @@ class ClassLinker {
     return intern_table_;
   }
 
+  // The indexes of the members of resolved classes, for the lookups by name.
+  MemberIndexTable* GetMemberIndexes() {
+    return &member_indexes_;
+  }
+
   // Attempts to insert a class into a class table.  Returns NULL if
   // the class was inserted, otherwise returns an existing class with
   // the same descriptor and ClassLoader.
@@ -473,6 +496,11 @@ class ClassLinker {
                             mirror::ObjectArray<mirror::Class>* interfaces)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
 
+  // Fills in the interface method table of a class from its completed iftable, unless it has one
+  // already. Done as the class is initialized, rather than when it's linked.
+  bool LinkInterfaceMethodTable(Thread* self, mirror::IfTable* iftable)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
   bool LinkStaticFields(SirtRef<mirror::Class>& klass)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
   bool LinkInstanceFields(SirtRef<mirror::Class>& klass)
@@ -497,9 +525,39 @@ class ClassLinker {
   const OatFile* FindOpenedOatFileForDexFile(const DexFile& dex_file)
       LOCKS_EXCLUDED(dex_lock_)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
+  // Maps the app image of the oat file, if it has one, the first time it's asked for.
+  gc::space::ImageSpace* OpenAppImage(const OatFile& oat_file)
+      LOCKS_EXCLUDED(dex_lock_)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
+  // Returns the DexCache for the dex file in the app image of its oat file, with its strings
+  // interned, or NULL if there is none. Also returns the classes stored for the dex file in the
+  // image, indexed by class def.
+  mirror::DexCache* FindAppImageDexCache(const DexFile& dex_file,
+                                         mirror::ObjectArray<mirror::Class>** image_classes)
+      LOCKS_EXCLUDED(dex_lock_)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
+  // Defines the class from the app image, if it holds the class and the class loader resolves
+  // its super class and interfaces to the ones it was linked against. Returns NULL otherwise, or
+  // with an exception pending if these couldn't be resolved.
+  mirror::Class* DefineClassFromAppImage(Thread* self, const char* descriptor,
+                                         mirror::ClassLoader* class_loader,
+                                         const DexFile& dex_file,
+                                         const DexFile::ClassDef& dex_class_def)
+      LOCKS_EXCLUDED(dex_lock_)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
+  // Finds an opened oat file containing dex_location, with the given checksum unless it is null.
   const OatFile* FindOpenedOatFileFromDexLocation(const std::string& dex_location,
-                                                  uint32_t dex_location_checksum)
+                                                  const uint32_t* dex_location_checksum)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_, dex_lock_);
+  // Gets the checksum of the dex file at dex_location. When the file is unchanged since oat_file
+  // was compiled from it, this is the checksum oat_file recorded, saving a read of the zip.
+  static bool GetDexLocationChecksum(const OatFile* oat_file,
+                                     const std::string& dex_location,
+                                     uint32_t* dex_location_checksum);
   const OatFile* FindOpenedOatFileFromOatLocation(const std::string& oat_location)
       SHARED_LOCKS_REQUIRED(dex_lock_);
   const DexFile* FindDexFileInOatLocation(const std::string& dex_location,
@@ -526,13 +584,84 @@ class ClassLinker {
   mutable ReaderWriterMutex dex_lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
   std::vector<mirror::DexCache*> dex_caches_ GUARDED_BY(dex_lock_);
   std::vector<const OatFile*> oat_files_ GUARDED_BY(dex_lock_);
-
-
-  // multimap from a string hash code of a class descriptor to
-  // mirror::Class* instances. Results should be compared for a matching
-  // Class::descriptor_ and Class::class_loader_.
-  typedef std::multimap<size_t, mirror::Class*> Table;
-  Table class_table_ GUARDED_BY(Locks::classlinker_classes_lock_);
+  // App images by oat file, NULL for oat files without one or while it is being mapped.
+  SafeMap<const OatFile*, gc::space::ImageSpace*> app_images_ GUARDED_BY(dex_lock_);
+  // Classes stored in app images for the dex files registered with their DexCache, indexed by
+  // class def.
+  SafeMap<const DexFile*, mirror::ObjectArray<mirror::Class>*> app_image_classes_
+      GUARDED_BY(dex_lock_);
+
+
+  // Open addressing hash table from the string hash code of a class descriptor to
+  // mirror::Class* instances, probed linearly. Results should be compared for a matching
+  // Class::descriptor_ and Class::class_loader_. Keeping the hash codes next to the classes lets
+  // a lookup skip classes with other descriptors without touching them.
+  class ClassTable {
+   public:
+    ClassTable() : slots_(kInitialCapacity), num_entries_(0), num_tombstones_(0) {}
+
+    // Returns the first class with the given hash for which predicate returns true, or NULL.
+    template <typename Predicate>
+    mirror::Class* Find(size_t hash, const Predicate& predicate) const {
+      const size_t mask = slots_.size() - 1;
+      for (size_t i = SlotIndex(hash, mask); ; i = (i + 1) & mask) {
+        const Slot& slot = slots_[i];
+        if (slot.klass == NULL) {
+          return NULL;
+        }
+        if (slot.hash == hash && slot.klass != Tombstone() && predicate(slot.klass)) {
+          return slot.klass;
+        }
+      }
+    }
+
+    // Calls visitor on every class until it returns false.
+    template <typename Visitor>
+    void Visit(const Visitor& visitor) const {
+      for (const Slot& slot : slots_) {
+        if (IsLive(slot.klass) && !visitor(slot.klass)) {
+          return;
+        }
+      }
+    }
+
+    void Insert(size_t hash, mirror::Class* klass);
+    void Remove(size_t hash, mirror::Class* klass);
+
+    size_t Size() const {
+      return num_entries_;
+    }
+
+   private:
+    struct Slot {
+      size_t hash;
+      mirror::Class* klass;
+    };
+
+    static const size_t kInitialCapacity = 4096;
+    static const uintptr_t kTombstone = 1;
+
+    static size_t SlotIndex(size_t hash, size_t mask) {
+      // Mix the high bits in, descriptors often only differ in their last characters.
+      return (hash ^ (hash >> 16)) & mask;
+    }
+
+    // Marks slots whose class was removed so that probing continues past them.
+    static mirror::Class* Tombstone() {
+      return reinterpret_cast<mirror::Class*>(kTombstone);
+    }
+
+    static bool IsLive(const mirror::Class* klass) {
+      return klass != NULL && klass != Tombstone();
+    }
+
+    void Rehash(size_t capacity);
+
+    std::vector<Slot> slots_;
+    size_t num_entries_;
+    size_t num_tombstones_;
+  };
+  ClassTable class_table_ GUARDED_BY(Locks::classlinker_classes_lock_);
 
   // Do we need to search dex caches to find image classes?
   bool dex_cache_image_class_lookup_required_;
@@ -618,6 +747,8 @@ class ClassLinker {
 
   InternTable* intern_table_;
 
+  MemberIndexTable member_indexes_;
+
   const void* portable_resolution_trampoline_;
   const void* quick_resolution_trampoline_;
 
@@ -641,6 +641,35 @@ TEST_F(ClassLinkerTest, FindClassNonexistent) {
   AssertNonExistentClass("LNoSuchClass;");
 }
 
+TEST_F(ClassLinkerTest, FillsSuperclassFieldGaps) {
+  ScopedObjectAccess soa(Thread::Current());
+  SirtRef<mirror::ClassLoader> class_loader(soa.Self(), soa.Decode<mirror::ClassLoader*>(LoadDex("FieldGaps")));
+
+  mirror::Class* padded = class_linker_->FindClass("LFieldGaps$Padded;", class_loader.get());
+  ASSERT_TRUE(padded != NULL);
+  const uint32_t header = sizeof(mirror::Object);
+  EXPECT_EQ(header, padded->FindDeclaredInstanceField("o", "Ljava/lang/Object;")->GetOffset()
+      .Uint32Value());
+  EXPECT_EQ(header + 8, padded->FindDeclaredInstanceField("j", "J")->GetOffset().Uint32Value());
+  EXPECT_EQ(header + 16, padded->GetObjectSize());
+
+  mirror::Class* padded_boolean = class_linker_->FindClass("LFieldGaps$PaddedBoolean;",
+                                                           class_loader.get());
+  ASSERT_TRUE(padded_boolean != NULL);
+  EXPECT_EQ(header + 4, padded_boolean->FindDeclaredInstanceField("z", "Z")->GetOffset()
+      .Uint32Value());
+  EXPECT_EQ(padded->GetObjectSize(), padded_boolean->GetObjectSize());
+
+  mirror::Class* padded_ints = class_linker_->FindClass("LFieldGaps$PaddedInts;",
+                                                        class_loader.get());
+  ASSERT_TRUE(padded_ints != NULL);
+  EXPECT_EQ(header + 4, padded_ints->FindDeclaredInstanceField("a", "I")->GetOffset()
+      .Uint32Value());
+  EXPECT_EQ(header + 16, padded_ints->FindDeclaredInstanceField("b", "I")->GetOffset()
+      .Uint32Value());
+  EXPECT_EQ(header + 20, padded_ints->GetObjectSize());
+}
+
 TEST_F(ClassLinkerTest, FindClassNested) {
   ScopedObjectAccess soa(Thread::Current());
   SirtRef<mirror::ClassLoader> class_loader(soa.Self(), soa.Decode<mirror::ClassLoader*>(LoadDex("Nested")));
@@ -971,6 +1000,25 @@ TEST_F(ClassLinkerTest, Interfaces) {
   EXPECT_EQ(Aj1, A->FindVirtualMethodForVirtualOrInterface(Jj1));
   EXPECT_EQ(Aj2, A->FindVirtualMethodForVirtualOrInterface(Jj2));
 
+  // Classes get an interface method table once they are initialized, interfaces don't.
+  EXPECT_TRUE(J->GetIfTable() == NULL || J->GetIfTable()->GetImTable() == NULL);
+  EXPECT_TRUE(A->GetIfTable()->GetImTable() == NULL);
+  ASSERT_TRUE(class_linker_->EnsureInitialized(A, true, true));
+  mirror::ObjectArray<mirror::ArtMethod>* imtable = A->GetIfTable()->GetImTable();
+  ASSERT_TRUE(imtable != NULL);
+  EXPECT_EQ(static_cast<int32_t>(mirror::IfTable::kImtSize * mirror::IfTable::kImtMax),
+            imtable->GetLength());
+  // The dex file has too few methods for its interface methods to conflict.
+  size_t index = mirror::IfTable::ImtIndex(Ii->GetDexMethodIndex());
+  EXPECT_EQ(Ii, imtable->Get(index + mirror::IfTable::kImtInterfaceMethod));
+  EXPECT_EQ(Ai, imtable->Get(index + mirror::IfTable::kImtMethod));
+  index = mirror::IfTable::ImtIndex(Jj2->GetDexMethodIndex());
+  EXPECT_EQ(Jj2, imtable->Get(index + mirror::IfTable::kImtInterfaceMethod));
+  EXPECT_EQ(Aj2, imtable->Get(index + mirror::IfTable::kImtMethod));
+  EXPECT_EQ(Ai, A->FindVirtualMethodForInterface(Ii));
+  EXPECT_EQ(Aj2, A->FindVirtualMethodForInterface(Jj2));
+  EXPECT_EQ(2, A->GetIfTableCount());
+
   mirror::ArtField* Afoo = A->FindStaticField("foo", "Ljava/lang/String;");
   mirror::ArtField* Bfoo = B->FindStaticField("foo", "Ljava/lang/String;");
   mirror::ArtField* Jfoo = J->FindStaticField("foo", "Ljava/lang/String;");
@@ -1044,6 +1092,58 @@ TEST_F(ClassLinkerTest, FinalizableBit) {
   EXPECT_TRUE(c->IsFinalizable());
 }
 
+TEST_F(ClassLinkerTest, SuperClassDisplay) {
+  ScopedObjectAccess soa(Thread::Current());
+  mirror::Class* object = class_linker_->FindSystemClass("Ljava/lang/Object;");
+  EXPECT_EQ(1U, object->GetSuperClassDepth());
+  EXPECT_EQ(object, object->GetSuperClassDisplayEntry(1));
+
+  // ClosedByInterruptException is as deep as the display goes.
+  mirror::Class* c =
+      class_linker_->FindSystemClass("Ljava/nio/channels/ClosedByInterruptException;");
+  ASSERT_TRUE(c != NULL);
+  ASSERT_EQ(static_cast<uint32_t>(mirror::Class::kSuperClassDisplayDepth), c->GetSuperClassDepth());
+  uint32_t depth = c->GetSuperClassDepth();
+  for (mirror::Class* super = c; super != NULL; super = super->GetSuperClass(), --depth) {
+    EXPECT_EQ(depth, super->GetSuperClassDepth()) << PrettyClass(super);
+    EXPECT_EQ(super, c->GetSuperClassDisplayEntry(depth)) << PrettyClass(super);
+    EXPECT_TRUE(c->IsSubClass(super)) << PrettyClass(super);
+  }
+  EXPECT_EQ(0U, depth);
+  mirror::Class* io_exception = class_linker_->FindSystemClass("Ljava/io/IOException;");
+  EXPECT_TRUE(io_exception->GetSuperClassDisplayEntry(c->GetSuperClassDepth()) == NULL);
+  EXPECT_FALSE(io_exception->IsSubClass(c));
+  EXPECT_FALSE(c->IsSubClass(class_linker_->FindSystemClass("Ljava/lang/RuntimeException;")));
+
+  // Interfaces and arrays aren't looked up in displays, though arrays have one.
+  EXPECT_EQ(0U, class_linker_->FindSystemClass("Ljava/lang/Runnable;")->GetSuperClassDepth());
+  mirror::Class* object_array = class_linker_->FindSystemClass("[Ljava/lang/Object;");
+  EXPECT_EQ(0U, object_array->GetSuperClassDepth());
+  EXPECT_EQ(object, object_array->GetSuperClassDisplayEntry(1));
+}
+
+TEST_F(ClassLinkerTest, PreloadClasses) {
+  std::vector<std::string> descriptors;
+  descriptors.push_back("Ljava/util/concurrent/ConcurrentSkipListMap;");
+  descriptors.push_back("[Ljava/util/concurrent/ConcurrentSkipListSet;");
+  descriptors.push_back("Ljava/util/concurrent/Exchanger;");
+  // Neither is defined by the boot class path.
+  descriptors.push_back("LMyClass;");
+  descriptors.push_back("[LNoSuchClass;");
+  EXPECT_EQ(3U, class_linker_->PreloadClasses(Thread::Current(), descriptors, 4));
+
+  ScopedObjectAccess soa(Thread::Current());
+  EXPECT_FALSE(soa.Self()->IsExceptionPending());
+  for (size_t i = 0; i < 3; ++i) {
+    mirror::Class* klass = class_linker_->LookupClass(descriptors[i].c_str(), NULL);
+    ASSERT_TRUE(klass != NULL) << descriptors[i];
+    EXPECT_TRUE(klass->IsResolved());
+    // Array classes are created initialized, the others are only linked.
+    EXPECT_EQ(klass->IsArrayClass(), klass->IsInitialized());
+  }
+  EXPECT_TRUE(class_linker_->LookupClass("LMyClass;", NULL) == NULL);
+}
+
 TEST_F(ClassLinkerTest, ClassRootDescriptors) {
   ScopedObjectAccess soa(Thread::Current());
   ClassHelper kh;
@@ -348,7 +348,9 @@ void ThrowNullPointerExceptionFromDexPC(const ThrowLocation& throw_location) {
       ThrowNullPointerExceptionForMethodAccess(throw_location, instr->VRegB_3rc(), kInterface);
       break;
     case Instruction::INVOKE_VIRTUAL_QUICK:
-    case Instruction::INVOKE_VIRTUAL_RANGE_QUICK: {
+    case Instruction::INVOKE_VIRTUAL_RANGE_QUICK:
+    case Instruction::INVOKE_SUPER_QUICK:
+    case Instruction::INVOKE_SUPER_RANGE_QUICK: {
       // Since we replaced the method index, we ask the verifier to tell us which
       // method is invoked at this location.
       mirror::ArtMethod* method =
@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cycle_clock.h"
+
+#include <string>
+
+#include "base/logging.h"
+#include "utils.h"
+
+namespace art {
+
+uint64_t CycleClock::cycles_per_us_ = 0;
+bool CycleClock::initialized_ = false;
+
+// Counts cycles over this long to calibrate.
+static constexpr uint64_t kCalibrationNs = 1000000;
+
+bool CycleClock::Init() {
+  if (initialized_) {
+    return IsAvailable();
+  }
+  initialized_ = true;
+#if defined(__i386__) || defined(__x86_64__)
+  std::string cpu_info;
+  if (!ReadFileToString("/proc/cpuinfo", &cpu_info) ||
+      cpu_info.find(" constant_tsc") == std::string::npos ||
+      cpu_info.find(" nonstop_tsc") == std::string::npos) {
+    VLOG(startup) << "The time stamp counter doesn't run at a constant rate";
+    return false;
+  }
+  uint64_t start_ns = NanoTime();
+  uint64_t start_cycles = Now();
+  uint64_t end_ns;
+  do {
+    end_ns = NanoTime();
+  } while (end_ns - start_ns < kCalibrationNs);
+  uint64_t cycles = Now() - start_cycles;
+  cycles_per_us_ = cycles * 1000 / (end_ns - start_ns);
+  VLOG(startup) << "The time stamp counter runs at " << cycles_per_us_ << " cycles per us";
+  return IsAvailable();
+#else
+  return false;
+#endif
+}
+
+}  // namespace art
@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ART_RUNTIME_CYCLE_CLOCK_H_
+#define ART_RUNTIME_CYCLE_CLOCK_H_
+
+#include <stdint.h>
+
+#include "base/macros.h"
+
+namespace art {
+
+// A cycle counter read without a system call, calibrated against the monotonic clock. Only the
+// x86 time stamp counter qualifies, when the kernel reports it runs at a constant rate and keeps
+// running in idle states. The ARM cycle counter traps unless the kernel opened it to user space,
+// which can't be checked for.
+class CycleClock {
+ public:
+  // Calibrates the counter, taking about a millisecond the first time. Returns whether it's
+  // usable, and can be called again.
+  static bool Init();
+
+  static bool IsAvailable() {
+    return cycles_per_us_ != 0;
+  }
+
+  static uint64_t Now() {
+#if defined(__i386__) || defined(__x86_64__)
+    uint32_t low;
+    uint32_t high;
+    __asm__ __volatile__("rdtsc" : "=a" (low), "=d" (high));
+    return (static_cast<uint64_t>(high) << 32) | low;
+#else
+    return 0;
+#endif
+  }
+
+  static uint64_t CyclesToMicros(uint64_t cycles) {
+    return cycles / cycles_per_us_;
+  }
+
+ private:
+  // Zero until Init finds a usable counter.
+  static uint64_t cycles_per_us_;
+  static bool initialized_;
+
+  DISALLOW_IMPLICIT_CONSTRUCTORS(CycleClock);
+};
+
+}  // namespace art
+
+#endif  // ART_RUNTIME_CYCLE_CLOCK_H_
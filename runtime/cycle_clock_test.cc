@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cycle_clock.h"
+
+#include "gtest/gtest.h"
+#include "utils.h"
+
+namespace art {
+
+TEST(CycleClockTest, Calibration) {
+  if (!CycleClock::Init()) {
+    // No usable counter on this CPU, the trace reads the kernel's clock instead.
+    return;
+  }
+  EXPECT_TRUE(CycleClock::IsAvailable());
+  uint64_t start_ns = NanoTime();
+  uint64_t start_cycles = CycleClock::Now();
+  while (NanoTime() - start_ns < MsToNs(10)) {
+    uint64_t cycles = CycleClock::Now();
+    ASSERT_GE(cycles, start_cycles);
+  }
+  uint64_t elapsed_us = CycleClock::CyclesToMicros(CycleClock::Now() - start_cycles);
+  uint64_t expected_us = (NanoTime() - start_ns) / 1000;
+  // Loose bounds, the thread may be descheduled between reading the two clocks.
+  EXPECT_GT(elapsed_us, expected_us / 2);
+  EXPECT_LT(elapsed_us, expected_us * 2);
+}
+
+}  // namespace art
@@ -16,6 +16,7 @@
 
 #include "debugger.h"
 
+#include <sys/time.h>
 #include <sys/uio.h>
 
 #include <set>
@@ -26,6 +27,7 @@
 #include "dex_file-inl.h"
 #include "dex_instruction.h"
 #include "gc/accounting/card_table-inl.h"
+#include "gc/gc_event_log.h"
 #include "gc/space/large_object_space.h"
 #include "gc/space/space-inl.h"
 #include "invoke_arg_array_builder.h"
@@ -45,6 +47,7 @@
 #include "ScopedPrimitiveArray.h"
 #include "sirt_ref.h"
 #include "stack_indirect_reference_table.h"
+#include "startup_timeline.h"
 #include "thread_list.h"
 #include "throw_location.h"
 #include "utf.h"
@@ -107,6 +110,27 @@ struct SingleStepControl {
   int32_t line_number;  // Or -1 for native methods.
   std::set<uint32_t> dex_pcs;
   int stack_depth;
+
+  // What the step had deoptimized: everything when stepping into calls, otherwise the methods on
+  // the thread's stack, which are all it can step through.
+  bool deoptimized_everything;
+  std::vector<mirror::ArtMethod*> deoptimized_methods;
+};
+
+// A change to which methods run in the interpreter, or to whether the debugger listens for method
+// entry and exit, made by Dbg::ManageDeoptimization with all threads suspended.
+struct DeoptimizationRequest {
+  enum Kind {
+    kSelectiveDeoptimization,
+    kSelectiveUndeoptimization,
+    kFullDeoptimization,
+    kFullUndeoptimization,
+    kEnableMethodEvents,
+    kDisableMethodEvents,
+  };
+  Kind kind;
+  mirror::ArtMethod* method;  // For the selective kinds.
+  DeoptimizationRequest(Kind kind, mirror::ArtMethod* method) : kind(kind), method(method) {}
 };
 
 class DebugInstrumentationListener : public instrumentation::InstrumentationListener {
@@ -194,6 +218,43 @@ static size_t gAllocRecordCount GUARDED_BY(gAllocTrackerLock) = 0;
 static std::vector<Breakpoint> gBreakpoints GUARDED_BY(Locks::breakpoint_lock_);
 static SingleStepControl gSingleStepControl GUARDED_BY(Locks::breakpoint_lock_);
 
+// Deoptimization, so that only the methods with breakpoints or being stepped through run in the
+// interpreter where the debugger sees every dex pc. Requests are queued while handling a JDWP
+// command and carried out once it is done, the counts say how many breakpoints, steps or event
+// requests want each change.
+static std::vector<DeoptimizationRequest> gDeoptimizationRequests
+    GUARDED_BY(Locks::breakpoint_lock_);
+static SafeMap<mirror::ArtMethod*, size_t> gDeoptimizedMethodCounts
+    GUARDED_BY(Locks::mutator_lock_);
+static size_t gFullDeoptimizationCount GUARDED_BY(Locks::mutator_lock_) = 0;
+static size_t gMethodEventsCount GUARDED_BY(Locks::mutator_lock_) = 0;
+
+static void RequestDeoptimization(DeoptimizationRequest::Kind kind, mirror::ArtMethod* method)
+    EXCLUSIVE_LOCKS_REQUIRED(Locks::breakpoint_lock_)
+    SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
+  if (method != NULL && (method->IsNative() || method->IsAbstract() || method->IsProxyMethod())) {
+    return;  // No dex pcs to see.
+  }
+  gDeoptimizationRequests.push_back(DeoptimizationRequest(kind, method));
+}
+
+// Releases what the current single-step had deoptimized.
+static void UndeoptimizeSingleStep()
+    EXCLUSIVE_LOCKS_REQUIRED(Locks::breakpoint_lock_)
+    SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
+  if (gSingleStepControl.deoptimized_everything) {
+    RequestDeoptimization(DeoptimizationRequest::kFullUndeoptimization, NULL);
+    gSingleStepControl.deoptimized_everything = false;
+  }
+  for (mirror::ArtMethod* method : gSingleStepControl.deoptimized_methods) {
+    RequestDeoptimization(DeoptimizationRequest::kSelectiveUndeoptimization, method);
+  }
+  gSingleStepControl.deoptimized_methods.clear();
+}
+
+static void ProcessDeoptimizationRequests(const std::vector<DeoptimizationRequest>& requests)
+    EXCLUSIVE_LOCKS_REQUIRED(Locks::mutator_lock_);
+
 static bool IsBreakpoint(const mirror::ArtMethod* m, uint32_t dex_pc)
     LOCKS_EXCLUDED(Locks::breakpoint_lock_)
     SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
@@ -471,6 +532,30 @@ void Dbg::StopJdwp() {
   gRegistry = NULL;
 }
 
+void Dbg::VisitRoots(RootVisitor* visitor, void* arg) {
+  if (gRegistry != NULL) {
+    gRegistry->VisitRoots(visitor, arg);
+  }
+}
+
+void Dbg::SweepObjectRegistry(IsMarkedTester is_marked, void* arg) {
+  if (gRegistry != NULL) {
+    gRegistry->SweepWeaks(is_marked, arg);
+  }
+}
+
+void Dbg::DisallowNewObjectRegistryObjects() {
+  if (gRegistry != NULL) {
+    gRegistry->DisallowNewObjects();
+  }
+}
+
+void Dbg::AllowNewObjectRegistryObjects() {
+  if (gRegistry != NULL) {
+    gRegistry->AllowNewObjects();
+  }
+}
+
 void Dbg::GcDidFinish() {
   if (gDdmHpifWhen != HPIF_WHEN_NEVER) {
     ScopedObjectAccess soa(Thread::Current());
@@ -539,9 +624,9 @@ void Dbg::GoActive() {
   Thread* self = Thread::Current();
   ThreadState old_state = self->SetStateUnsafe(kRunnable);
   CHECK_NE(old_state, kRunnable);
+  // Neither listener needs any stubs: dex pcs are only reported by methods deoptimized for
+  // breakpoints and steps, and method entry and exit are listened for once requested.
   runtime->GetInstrumentation()->AddListener(&gDebugInstrumentationListener,
-                                             instrumentation::Instrumentation::kMethodEntered |
-                                             instrumentation::Instrumentation::kMethodExited |
                                              instrumentation::Instrumentation::kDexPcMoved |
                                              instrumentation::Instrumentation::kExceptionCaught);
   gDebuggerActive = true;
@@ -558,14 +643,22 @@ void Dbg::Disconnected() {
 
   // Suspend all threads and exclusively acquire the mutator lock. Set the state of the thread
   // to kRunnable to avoid scoped object access transitions. Remove the debugger as a listener
-  // and clear the object registry.
+  // and clear the object registry. The pending deoptimization requests are those of the event
+  // requests cleared when the connection closed, which leave nothing deoptimized.
   Runtime* runtime = Runtime::Current();
-  runtime->GetThreadList()->SuspendAll();
   Thread* self = Thread::Current();
+  std::vector<DeoptimizationRequest> requests;
+  {
+    MutexLock mu(self, *Locks::breakpoint_lock_);
+    requests.swap(gDeoptimizationRequests);
+  }
+  runtime->GetThreadList()->SuspendAll();
   ThreadState old_state = self->SetStateUnsafe(kRunnable);
+  ProcessDeoptimizationRequests(requests);
+  CHECK_EQ(gDeoptimizedMethodCounts.size(), 0U);
+  CHECK_EQ(gFullDeoptimizationCount, 0U);
+  CHECK_EQ(gMethodEventsCount, 0U);
   runtime->GetInstrumentation()->RemoveListener(&gDebugInstrumentationListener,
-                                                instrumentation::Instrumentation::kMethodEntered |
-                                                instrumentation::Instrumentation::kMethodExited |
                                                 instrumentation::Instrumentation::kDexPcMoved |
                                                 instrumentation::Instrumentation::kExceptionCaught);
   gDebuggerActive = false;
@@ -2012,14 +2105,17 @@ JDWP::JdwpError Dbg::GetThisObject(JDWP::ObjectId thread_id, JDWP::FrameId frame
   return JDWP::ERR_NONE;
 }
 
-void Dbg::GetLocalValue(JDWP::ObjectId thread_id, JDWP::FrameId frame_id, int slot, JDWP::JdwpTag tag,
-                        uint8_t* buf, size_t width) {
+JDWP::JdwpError Dbg::GetLocalValues(JDWP::ObjectId thread_id, JDWP::FrameId frame_id,
+                                    int slot_count, JDWP::Request& request,
+                                    JDWP::ExpandBuf* pReply) {
+  // Finds the frame once and reads all the requested slots from it, rather than walking the
+  // stack for each slot.
   struct GetLocalVisitor : public StackVisitor {
-    GetLocalVisitor(Thread* thread, Context* context, JDWP::FrameId frame_id, int slot,
-                    JDWP::JdwpTag tag, uint8_t* buf, size_t width)
+    GetLocalVisitor(Thread* thread, Context* context, JDWP::FrameId frame_id, int slot_count,
+                    JDWP::Request& request, JDWP::ExpandBuf* pReply)
         SHARED_LOCKS_REQUIRED(Locks::mutator_lock_)
-        : StackVisitor(thread, context), frame_id_(frame_id), slot_(slot), tag_(tag),
-          buf_(buf), width_(width) {}
+        : StackVisitor(thread, context), frame_id_(frame_id), slot_count_(slot_count),
+          request_(request), pReply_(pReply), found_(false) {}
 
     // TODO: Enable annotalysis. We know lock is held in constructor, but abstraction confuses
     // annotalysis.
@@ -2027,61 +2123,75 @@ void Dbg::GetLocalValue(JDWP::ObjectId thread_id, JDWP::FrameId frame_id, int sl
       if (GetFrameId() != frame_id_) {
         return true;  // Not our frame, carry on.
       }
-      // TODO: check that the tag is compatible with the actual type of the slot!
+      found_ = true;
       mirror::ArtMethod* m = GetMethod();
-      uint16_t reg = DemangleSlot(slot_, m);
+      for (int i = 0; i < slot_count_; ++i) {
+        uint32_t slot = request_.ReadUnsigned32("slot");
+        JDWP::JdwpTag tag = request_.ReadTag();
+        VLOG(jdwp) << "    --> slot " << slot << " " << tag;
+        size_t width = Dbg::GetTagWidth(tag);
+        uint8_t* buf = expandBufAddSpace(pReply_, width + 1);
+        GetLocalValue(m, slot, tag, buf, width);
+      }
+      return false;
+    }
 
-      switch (tag_) {
+    void GetLocalValue(mirror::ArtMethod* m, int slot, JDWP::JdwpTag tag, uint8_t* buf,
+                       size_t width) NO_THREAD_SAFETY_ANALYSIS {
+      // TODO: check that the tag is compatible with the actual type of the slot!
+      uint16_t reg = DemangleSlot(slot, m);
+
+      switch (tag) {
       case JDWP::JT_BOOLEAN:
         {
-          CHECK_EQ(width_, 1U);
+          CHECK_EQ(width, 1U);
           uint32_t intVal = GetVReg(m, reg, kIntVReg);
           VLOG(jdwp) << "get boolean local " << reg << " = " << intVal;
-          JDWP::Set1(buf_+1, intVal != 0);
+          JDWP::Set1(buf+1, intVal != 0);
         }
         break;
       case JDWP::JT_BYTE:
         {
-          CHECK_EQ(width_, 1U);
+          CHECK_EQ(width, 1U);
           uint32_t intVal = GetVReg(m, reg, kIntVReg);
           VLOG(jdwp) << "get byte local " << reg << " = " << intVal;
-          JDWP::Set1(buf_+1, intVal);
+          JDWP::Set1(buf+1, intVal);
         }
         break;
       case JDWP::JT_SHORT:
       case JDWP::JT_CHAR:
         {
-          CHECK_EQ(width_, 2U);
+          CHECK_EQ(width, 2U);
           uint32_t intVal = GetVReg(m, reg, kIntVReg);
           VLOG(jdwp) << "get short/char local " << reg << " = " << intVal;
-          JDWP::Set2BE(buf_+1, intVal);
+          JDWP::Set2BE(buf+1, intVal);
         }
         break;
       case JDWP::JT_INT:
         {
-          CHECK_EQ(width_, 4U);
+          CHECK_EQ(width, 4U);
           uint32_t intVal = GetVReg(m, reg, kIntVReg);
           VLOG(jdwp) << "get int local " << reg << " = " << intVal;
-          JDWP::Set4BE(buf_+1, intVal);
+          JDWP::Set4BE(buf+1, intVal);
         }
         break;
       case JDWP::JT_FLOAT:
         {
-          CHECK_EQ(width_, 4U);
+          CHECK_EQ(width, 4U);
           uint32_t intVal = GetVReg(m, reg, kFloatVReg);
           VLOG(jdwp) << "get int/float local " << reg << " = " << intVal;
-          JDWP::Set4BE(buf_+1, intVal);
+          JDWP::Set4BE(buf+1, intVal);
         }
         break;
       case JDWP::JT_ARRAY:
         {
-          CHECK_EQ(width_, sizeof(JDWP::ObjectId));
+          CHECK_EQ(width, sizeof(JDWP::ObjectId));
           mirror::Object* o = reinterpret_cast<mirror::Object*>(GetVReg(m, reg, kReferenceVReg));
           VLOG(jdwp) << "get array local " << reg << " = " << o;
           if (!Runtime::Current()->GetHeap()->IsHeapAddress(o)) {
             LOG(FATAL) << "Register " << reg << " expected to hold array: " << o;
           }
-          JDWP::SetObjectId(buf_+1, gRegistry->Add(o));
+          JDWP::SetObjectId(buf+1, gRegistry->Add(o));
         }
         break;
       case JDWP::JT_CLASS_LOADER:
@@ -2091,51 +2201,50 @@ void Dbg::GetLocalValue(JDWP::ObjectId thread_id, JDWP::FrameId frame_id, int sl
       case JDWP::JT_THREAD:
       case JDWP::JT_THREAD_GROUP:
         {
-          CHECK_EQ(width_, sizeof(JDWP::ObjectId));
+          CHECK_EQ(width, sizeof(JDWP::ObjectId));
           mirror::Object* o = reinterpret_cast<mirror::Object*>(GetVReg(m, reg, kReferenceVReg));
           VLOG(jdwp) << "get object local " << reg << " = " << o;
           if (!Runtime::Current()->GetHeap()->IsHeapAddress(o)) {
             LOG(FATAL) << "Register " << reg << " expected to hold object: " << o;
           }
-          tag_ = TagFromObject(o);
-          JDWP::SetObjectId(buf_+1, gRegistry->Add(o));
+          tag = TagFromObject(o);
+          JDWP::SetObjectId(buf+1, gRegistry->Add(o));
         }
         break;
       case JDWP::JT_DOUBLE:
         {
-          CHECK_EQ(width_, 8U);
+          CHECK_EQ(width, 8U);
           uint32_t lo = GetVReg(m, reg, kDoubleLoVReg);
           uint64_t hi = GetVReg(m, reg + 1, kDoubleHiVReg);
           uint64_t longVal = (hi << 32) | lo;
           VLOG(jdwp) << "get double/long local " << hi << ":" << lo << " = " << longVal;
-          JDWP::Set8BE(buf_+1, longVal);
+          JDWP::Set8BE(buf+1, longVal);
         }
         break;
       case JDWP::JT_LONG:
         {
-          CHECK_EQ(width_, 8U);
+          CHECK_EQ(width, 8U);
           uint32_t lo = GetVReg(m, reg, kLongLoVReg);
           uint64_t hi = GetVReg(m, reg + 1, kLongHiVReg);
           uint64_t longVal = (hi << 32) | lo;
           VLOG(jdwp) << "get double/long local " << hi << ":" << lo << " = " << longVal;
-          JDWP::Set8BE(buf_+1, longVal);
+          JDWP::Set8BE(buf+1, longVal);
         }
         break;
       default:
-        LOG(FATAL) << "Unknown tag " << tag_;
+        LOG(FATAL) << "Unknown tag " << tag;
         break;
       }
 
       // Prepend tag, which may have been updated.
-      JDWP::Set1(buf_, tag_);
-      return false;
+      JDWP::Set1(buf, tag);
     }
 
     const JDWP::FrameId frame_id_;
-    const int slot_;
-    JDWP::JdwpTag tag_;
-    uint8_t* const buf_;
-    const size_t width_;
+    const int slot_count_;
+    JDWP::Request& request_;
+    JDWP::ExpandBuf* const pReply_;
+    bool found_;
   };
 
   ScopedObjectAccessUnchecked soa(Thread::Current());
@@ -2143,11 +2252,12 @@ void Dbg::GetLocalValue(JDWP::ObjectId thread_id, JDWP::FrameId frame_id, int sl
   Thread* thread;
   JDWP::JdwpError error = DecodeThread(soa, thread_id, thread);
   if (error != JDWP::ERR_NONE) {
-    return;
+    return error;
   }
   UniquePtr<Context> context(Context::Create());
-  GetLocalVisitor visitor(thread, context.get(), frame_id, slot, tag, buf, width);
+  GetLocalVisitor visitor(thread, context.get(), frame_id, slot_count, request, pReply);
   visitor.WalkStack();
+  return visitor.found_ ? JDWP::ERR_NONE : JDWP::ERR_INVALID_FRAMEID;
 }
 
 void Dbg::SetLocalValue(JDWP::ObjectId thread_id, JDWP::FrameId frame_id, int slot, JDWP::JdwpTag tag,
@@ -2235,6 +2345,8 @@ void Dbg::SetLocalValue(JDWP::ObjectId thread_id, JDWP::FrameId frame_id, int sl
   UniquePtr<Context> context(Context::Create());
   SetLocalVisitor visitor(thread, context.get(), frame_id, slot, tag, value, width);
   visitor.WalkStack();
+  // The collector must rescan the stack rather than trust an earlier scan.
+  thread->NoteRootsChanged();
 }
 
 void Dbg::PostLocationEvent(const mirror::ArtMethod* m, int dex_pc,
@@ -2375,6 +2487,7 @@ void Dbg::WatchLocation(const JDWP::JdwpLocation* location) {
   mirror::ArtMethod* m = FromMethodId(location->method_id);
   gBreakpoints.push_back(Breakpoint(m, location->dex_pc));
   VLOG(jdwp) << "Set breakpoint #" << (gBreakpoints.size() - 1) << ": " << gBreakpoints[gBreakpoints.size() - 1];
+  RequestDeoptimization(DeoptimizationRequest::kSelectiveDeoptimization, m);
 }
 
 void Dbg::UnwatchLocation(const JDWP::JdwpLocation* location) {
@@ -2384,6 +2497,7 @@ void Dbg::UnwatchLocation(const JDWP::JdwpLocation* location) {
     if (gBreakpoints[i].method == m && gBreakpoints[i].dex_pc == location->dex_pc) {
       VLOG(jdwp) << "Removed breakpoint #" << i << ": " << gBreakpoints[i];
       gBreakpoints.erase(gBreakpoints.begin() + i);
+      RequestDeoptimization(DeoptimizationRequest::kSelectiveUndeoptimization, m);
       return;
     }
   }
@@ -2408,10 +2522,12 @@ class ScopedThreadSuspension {
       if (thread_ == soa.Self()) {
         self_suspend_ = true;
       } else {
+        ScopedLocalRef<jobject> thread_peer(soa.Env(),
+            soa.AddLocalReference<jobject>(gRegistry->Get<mirror::Object*>(thread_id)));
         soa.Self()->TransitionFromRunnableToSuspended(kWaitingForDebuggerSuspension);
-        jobject thread_peer = gRegistry->GetJObject(thread_id);
         bool timed_out;
-        Thread* suspended_thread = Thread::SuspendForDebugger(thread_peer, true, &timed_out);
+        Thread* suspended_thread = Thread::SuspendForDebugger(thread_peer.get(), true,
+                                                              &timed_out);
         CHECK_EQ(soa.Self()->TransitionFromSuspendedToRunnable(), kWaitingForDebuggerSuspension);
         if (suspended_thread == NULL) {
           // Thread terminated from under us while suspending.
@@ -2460,6 +2576,7 @@ JDWP::JdwpError Dbg::ConfigureStep(JDWP::ObjectId thread_id, JDWP::JdwpStepSize
     LOG(WARNING) << "single-step already active for " << *gSingleStepControl.thread
                  << "; switching to " << *sts.GetThread();
   }
+  UndeoptimizeSingleStep();
 
   //
   // Work out what Method* we're in, the current line number, and how deep the stack currently
@@ -2479,9 +2596,10 @@ JDWP::JdwpError Dbg::ConfigureStep(JDWP::ObjectId thread_id, JDWP::JdwpStepSize
     // annotalysis.
     bool VisitFrame() NO_THREAD_SAFETY_ANALYSIS {
       Locks::breakpoint_lock_->AssertHeld(Thread::Current());
-      const mirror::ArtMethod* m = GetMethod();
+      mirror::ArtMethod* m = GetMethod();
       if (!m->IsRuntimeMethod()) {
         ++gSingleStepControl.stack_depth;
+        methods.push_back(m);
         if (gSingleStepControl.method == NULL) {
           const mirror::DexCache* dex_cache = m->GetDeclaringClass()->GetDexCache();
           gSingleStepControl.method = m;
@@ -2494,6 +2612,9 @@ JDWP::JdwpError Dbg::ConfigureStep(JDWP::ObjectId thread_id, JDWP::JdwpStepSize
       }
       return true;
     }
+
+    // The methods on the stack, innermost first.
+    std::vector<mirror::ArtMethod*> methods;
   };
 
   SingleStepStackVisitor visitor(sts.GetThread());
@@ -2568,6 +2689,18 @@ JDWP::JdwpError Dbg::ConfigureStep(JDWP::ObjectId thread_id, JDWP::JdwpStepSize
   gSingleStepControl.step_depth = step_depth;
   gSingleStepControl.is_active = true;
 
+  // Stepping over or out only stops in methods already on the stack, any method may be stepped
+  // into.
+  if (step_depth == JDWP::SD_INTO) {
+    gSingleStepControl.deoptimized_everything = true;
+    RequestDeoptimization(DeoptimizationRequest::kFullDeoptimization, NULL);
+  } else {
+    gSingleStepControl.deoptimized_methods = visitor.methods;
+    for (mirror::ArtMethod* method : visitor.methods) {
+      RequestDeoptimization(DeoptimizationRequest::kSelectiveDeoptimization, method);
+    }
+  }
+
   if (VLOG_IS_ON(jdwp)) {
     VLOG(jdwp) << "Single-step thread: " << *gSingleStepControl.thread;
     VLOG(jdwp) << "Single-step step size: " << gSingleStepControl.step_size;
@@ -2590,6 +2723,94 @@ void Dbg::UnconfigureStep(JDWP::ObjectId /*thread_id*/) {
   gSingleStepControl.is_active = false;
   gSingleStepControl.thread = NULL;
   gSingleStepControl.dex_pcs.clear();
+  UndeoptimizeSingleStep();
+}
+
+void Dbg::EnableMethodEvents() {
+  MutexLock mu(Thread::Current(), *Locks::breakpoint_lock_);
+  RequestDeoptimization(DeoptimizationRequest::kEnableMethodEvents, NULL);
+}
+
+void Dbg::DisableMethodEvents() {
+  MutexLock mu(Thread::Current(), *Locks::breakpoint_lock_);
+  RequestDeoptimization(DeoptimizationRequest::kDisableMethodEvents, NULL);
+}
+
+static void ProcessDeoptimizationRequests(const std::vector<DeoptimizationRequest>& requests) {
+  instrumentation::Instrumentation* instrumentation = Runtime::Current()->GetInstrumentation();
+  for (const DeoptimizationRequest& request : requests) {
+    switch (request.kind) {
+      case DeoptimizationRequest::kSelectiveDeoptimization: {
+        auto it = gDeoptimizedMethodCounts.find(request.method);
+        if (it != gDeoptimizedMethodCounts.end()) {
+          ++it->second;
+        } else {
+          VLOG(jdwp) << "Deoptimizing " << PrettyMethod(request.method);
+          gDeoptimizedMethodCounts.Put(request.method, 1);
+          instrumentation->Deoptimize(request.method);
+        }
+        break;
+      }
+      case DeoptimizationRequest::kSelectiveUndeoptimization: {
+        auto it = gDeoptimizedMethodCounts.find(request.method);
+        CHECK(it != gDeoptimizedMethodCounts.end()) << PrettyMethod(request.method);
+        if (--it->second == 0) {
+          VLOG(jdwp) << "Undeoptimizing " << PrettyMethod(request.method);
+          gDeoptimizedMethodCounts.erase(it);
+          instrumentation->Undeoptimize(request.method);
+        }
+        break;
+      }
+      case DeoptimizationRequest::kFullDeoptimization:
+        if (gFullDeoptimizationCount++ == 0) {
+          VLOG(jdwp) << "Deoptimizing everything";
+          instrumentation->DeoptimizeEverything();
+        }
+        break;
+      case DeoptimizationRequest::kFullUndeoptimization:
+        CHECK_GT(gFullDeoptimizationCount, 0U);
+        if (--gFullDeoptimizationCount == 0) {
+          VLOG(jdwp) << "Undeoptimizing everything";
+          instrumentation->UndeoptimizeEverything();
+        }
+        break;
+      case DeoptimizationRequest::kEnableMethodEvents:
+        if (gMethodEventsCount++ == 0) {
+          instrumentation->AddListener(&gDebugInstrumentationListener,
+                                       instrumentation::Instrumentation::kMethodEntered |
+                                       instrumentation::Instrumentation::kMethodExited);
+        }
+        break;
+      case DeoptimizationRequest::kDisableMethodEvents:
+        CHECK_GT(gMethodEventsCount, 0U);
+        if (--gMethodEventsCount == 0) {
+          instrumentation->RemoveListener(&gDebugInstrumentationListener,
+                                          instrumentation::Instrumentation::kMethodEntered |
+                                          instrumentation::Instrumentation::kMethodExited);
+        }
+        break;
+    }
+  }
+}
+
+void Dbg::ManageDeoptimization() {
+  Thread* self = Thread::Current();
+  std::vector<DeoptimizationRequest> requests;
+  {
+    MutexLock mu(self, *Locks::breakpoint_lock_);
+    requests.swap(gDeoptimizationRequests);
+  }
+  if (requests.empty()) {
+    return;
+  }
+  // Code and stacks can only be changed with every thread suspended.
+  Runtime* runtime = Runtime::Current();
+  runtime->GetThreadList()->SuspendAll();
+  ThreadState old_state = self->SetStateUnsafe(kRunnable);
+  CHECK_NE(old_state, kRunnable);
+  ProcessDeoptimizationRequests(requests);
+  CHECK_EQ(self->SetStateUnsafe(old_state), kRunnable);
+  runtime->GetThreadList()->ResumeAll();
 }
 
 static char JdwpTagToShortyChar(JDWP::JdwpTag tag) {
@@ -2722,10 +2943,7 @@ JDWP::JdwpError Dbg::InvokeMethod(JDWP::ObjectId thread_id, JDWP::ObjectId objec
         if (!argument->InstanceOf(parameter_type)) {
           return JDWP::ERR_ILLEGAL_ARGUMENT;
         }
-
-        // Turn the on-the-wire ObjectId into a jobject.
-        jvalue& v = reinterpret_cast<jvalue&>(arg_values[i]);
-        v.l = gRegistry->GetJObject(arg_values[i]);
+        // The ObjectId is turned into a jobject by ExecuteMethod, on the thread that uses it.
       }
     }
 
@@ -2839,9 +3057,26 @@ void Dbg::ExecuteMethod(DebugInvokeReq* pReq) {
   CHECK_EQ(sizeof(jvalue), sizeof(uint64_t));
 
   MethodHelper mh(m);
-  ArgArray arg_array(mh.GetShorty(), mh.GetShortyLength());
-  arg_array.BuildArgArray(soa, pReq->receiver_, reinterpret_cast<jvalue*>(pReq->arg_values_));
-  InvokeWithArgArray(soa, m, &arg_array, &pReq->result_value, mh.GetShorty()[0]);
+  const char* shorty = mh.GetShorty();
+  jvalue* args = reinterpret_cast<jvalue*>(pReq->arg_values_);
+  // Turn the on-the-wire ObjectIds into local references of this thread.
+  for (size_t i = 0; i < pReq->arg_count_; ++i) {
+    if (shorty[i + 1] == 'L') {
+      mirror::Object* argument = gRegistry->Get<mirror::Object*>(pReq->arg_values_[i]);
+      if (argument == ObjectRegistry::kInvalidObject) {
+        argument = NULL;  // Disposed of since InvokeMethod checked it.
+      }
+      args[i].l = soa.AddLocalReference<jobject>(argument);
+    }
+  }
+  ArgArray arg_array(shorty, mh.GetShortyLength());
+  arg_array.BuildArgArray(soa, pReq->receiver_, args);
+  InvokeWithArgArray(soa, m, &arg_array, &pReq->result_value, shorty[0]);
+  for (size_t i = 0; i < pReq->arg_count_; ++i) {
+    if (shorty[i + 1] == 'L') {
+      soa.Env()->DeleteLocalRef(args[i].l);
+    }
+  }
 
   mirror::Throwable* exception = soa.Self()->GetException(NULL);
   soa.Self()->ClearException();
@@ -3799,4 +4034,139 @@ jbyteArray Dbg::GetRecentAllocations() {
   return result;
 }
 
+/*
+ * Generate the contents of a GCEV chunk, describing recent garbage collections
+ * and the distribution of GC pause times.
+ *
+ * All times are in nanoseconds. Start times are on the monotonic clock; the
+ * header carries the current monotonic and wall clock times to relate them.
+ *
+ * Response has:
+ *  (2b) format version (1)
+ *  (8b) current monotonic time
+ *  (8b) current wall clock time, in milliseconds since the epoch
+ *  (1b) number of GC types with pause statistics
+ *  For each GC type:
+ *    (1b) GC type (1 = sticky, 2 = partial, 3 = full)
+ *    (8b) number of pauses
+ *    (8b) 50th, 90th and 99th percentile pause
+ *    (8b) longest pause
+ *  (4b) number of events
+ *  For each event, oldest first:
+ *    (4b) sequence number, counting all GCs since startup
+ *    (8b) start time
+ *    (1b) cause (0 = for alloc, 1 = background, 2 = explicit)
+ *    (1b) GC type
+ *    (1b) concurrent?
+ *    (8b) duration
+ *    (8b) freed objects, freed bytes
+ *    (8b) freed large objects, freed large object bytes
+ *    (8b) bytes allocated before and after, total heap size
+ *    (1b) number of pauses
+ *      (8b) pause
+ *    (1b) number of phases
+ *      (2b) phase name length, followed by that many bytes of UTF-8
+ *      (8b) phase duration
+ */
+jbyteArray Dbg::GetGcEvents() {
+  gc::GcEventLog* log = Runtime::Current()->GetHeap()->GetGcEventLog();
+  std::vector<gc::GcEventLog::Event> events;
+  log->GetEvents(&events);
+
+  std::vector<uint8_t> bytes;
+  JDWP::Append2BE(bytes, 1);
+  JDWP::Append8BE(bytes, NanoTime());
+  timeval now;
+  gettimeofday(&now, NULL);
+  JDWP::Append8BE(bytes, static_cast<uint64_t>(now.tv_sec) * 1000 + now.tv_usec / 1000);
+
+  JDWP::Append1BE(bytes, gc::collector::kGcTypeMax - gc::collector::kGcTypeSticky);
+  for (int type = gc::collector::kGcTypeSticky; type < gc::collector::kGcTypeMax; ++type) {
+    gc::GcEventLog::PauseStats stats;
+    log->GetPauseStats(static_cast<gc::collector::GcType>(type), &stats);
+    JDWP::Append1BE(bytes, type);
+    JDWP::Append8BE(bytes, stats.count);
+    JDWP::Append8BE(bytes, stats.p50_ns);
+    JDWP::Append8BE(bytes, stats.p90_ns);
+    JDWP::Append8BE(bytes, stats.p99_ns);
+    JDWP::Append8BE(bytes, stats.max_ns);
+  }
+
+  JDWP::Append4BE(bytes, events.size());
+  for (const gc::GcEventLog::Event& event : events) {
+    JDWP::Append4BE(bytes, event.sequence_number);
+    JDWP::Append8BE(bytes, event.start_time_ns);
+    JDWP::Append1BE(bytes, event.cause);
+    JDWP::Append1BE(bytes, event.type);
+    JDWP::Append1BE(bytes, event.concurrent);
+    JDWP::Append8BE(bytes, event.duration_ns);
+    JDWP::Append8BE(bytes, event.freed_objects);
+    JDWP::Append8BE(bytes, event.freed_bytes);
+    JDWP::Append8BE(bytes, event.freed_large_objects);
+    JDWP::Append8BE(bytes, event.freed_large_object_bytes);
+    JDWP::Append8BE(bytes, event.bytes_allocated_before);
+    JDWP::Append8BE(bytes, event.bytes_allocated_after);
+    JDWP::Append8BE(bytes, event.total_memory);
+    JDWP::Append1BE(bytes, event.pause_count);
+    for (size_t i = 0; i < event.pause_count; ++i) {
+      JDWP::Append8BE(bytes, event.pause_ns[i]);
+    }
+    JDWP::Append1BE(bytes, event.phase_count);
+    for (size_t i = 0; i < event.phase_count; ++i) {
+      size_t length = strlen(event.phases[i].label);
+      JDWP::Append2BE(bytes, length);
+      bytes.insert(bytes.end(), event.phases[i].label, event.phases[i].label + length);
+      JDWP::Append8BE(bytes, event.phases[i].duration_ns);
+    }
+  }
+
+  JNIEnv* env = Thread::Current()->GetJniEnv();
+  jbyteArray result = env->NewByteArray(bytes.size());
+  if (result != NULL) {
+    env->SetByteArrayRegion(result, 0, bytes.size(), reinterpret_cast<const jbyte*>(&bytes[0]));
+  }
+  return result;
+}
+
+/*
+ * The "STTL" chunk body, the phases of runtime startup in order.
+ *
+ * Times are in nanoseconds on the monotonic clock. Page faults are those of
+ * the whole process during the phase.
+ *
+ * Response has:
+ *  (2b) format version (1)
+ *  (2b) number of phases
+ *  For each phase:
+ *    (2b) phase name length, followed by that many bytes of UTF-8
+ *    (8b) start time
+ *    (8b) duration
+ *    (8b) minor faults
+ *    (8b) major faults
+ */
+jbyteArray Dbg::GetStartupTimeline() {
+  std::vector<StartupTimeline::Phase> phases;
+  Runtime::Current()->GetStartupTimeline()->GetPhases(&phases);
+
+  std::vector<uint8_t> bytes;
+  JDWP::Append2BE(bytes, 1);
+  JDWP::Append2BE(bytes, phases.size());
+  for (const StartupTimeline::Phase& phase : phases) {
+    size_t length = strlen(phase.label);
+    JDWP::Append2BE(bytes, length);
+    bytes.insert(bytes.end(), phase.label, phase.label + length);
+    JDWP::Append8BE(bytes, phase.start_ns);
+    JDWP::Append8BE(bytes, phase.duration_ns);
+    JDWP::Append8BE(bytes, phase.minor_faults);
+    JDWP::Append8BE(bytes, phase.major_faults);
+  }
+
+  JNIEnv* env = Thread::Current()->GetJniEnv();
+  jbyteArray result = env->NewByteArray(bytes.size());
+  if (result != NULL) {
+    env->SetByteArrayRegion(result, 0, bytes.size(), reinterpret_cast<const jbyte*>(&bytes[0]));
+  }
+  return result;
+}
+
 }  // namespace art
@@ -92,6 +92,13 @@ class Dbg {
   // Invoked by the GC in case we need to keep DDMS informed.
   static void GcDidFinish() LOCKS_EXCLUDED(Locks::mutator_lock_);
 
+  // The object registry's part in garbage collection: objects whose collection the debugger has
+  // disabled are roots, the rest are system weaks.
+  static void VisitRoots(RootVisitor* visitor, void* arg);
+  static void SweepObjectRegistry(IsMarkedTester is_marked, void* arg);
+  static void DisallowNewObjectRegistryObjects() EXCLUSIVE_LOCKS_REQUIRED(Locks::mutator_lock_);
+  static void AllowNewObjectRegistryObjects() SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
   // Return the DebugInvokeReq for the current thread.
   static DebugInvokeReq* GetInvokeReq();
 
@@ -308,8 +315,11 @@ class Dbg {
       LOCKS_EXCLUDED(Locks::thread_list_lock_,
                      Locks::thread_suspend_count_lock_)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
-  static void GetLocalValue(JDWP::ObjectId thread_id, JDWP::FrameId frame_id, int slot,
-                            JDWP::JdwpTag tag, uint8_t* buf, size_t expectedLen)
+  // Reads slot_count (slot, tag) pairs from the request and appends the tagged values of those
+  // slots in the frame to the reply.
+  static JDWP::JdwpError GetLocalValues(JDWP::ObjectId thread_id, JDWP::FrameId frame_id,
+                                        int slot_count, JDWP::Request& request,
+                                        JDWP::ExpandBuf* pReply)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
   static void SetLocalValue(JDWP::ObjectId thread_id, JDWP::FrameId frame_id, int slot,
                             JDWP::JdwpTag tag, uint64_t value, size_t width)
@@ -355,7 +365,24 @@ class Dbg {
                                        JDWP::JdwpStepDepth depth)
       LOCKS_EXCLUDED(Locks::breakpoint_lock_)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
-  static void UnconfigureStep(JDWP::ObjectId thread_id) LOCKS_EXCLUDED(Locks::breakpoint_lock_);
+  static void UnconfigureStep(JDWP::ObjectId thread_id)
+      LOCKS_EXCLUDED(Locks::breakpoint_lock_)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
+  // Counted requests for method entry and exit events, which need the entry and exit stubs on
+  // every method, so the debugger only listens for them while it has event requests for them.
+  static void EnableMethodEvents()
+      LOCKS_EXCLUDED(Locks::breakpoint_lock_)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+  static void DisableMethodEvents()
+      LOCKS_EXCLUDED(Locks::breakpoint_lock_)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
+  // Deoptimizes or undeoptimizes the methods that breakpoints, steps and event requests have
+  // asked for since the last call, suspending all threads to do so. Called by the JDWP thread
+  // once it has handled a command.
+  static void ManageDeoptimization()
+      LOCKS_EXCLUDED(Locks::breakpoint_lock_, Locks::mutator_lock_);
 
   static JDWP::JdwpError InvokeMethod(JDWP::ObjectId thread_id, JDWP::ObjectId object_id,
                                       JDWP::RefTypeId class_id, JDWP::MethodId method_id,
@@ -394,6 +421,16 @@ class Dbg {
   static jbyteArray GetRecentAllocations() SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
   static void DumpRecentAllocations();
 
+  /*
+   * GC event log support.
+   */
+  static jbyteArray GetGcEvents() SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
+  /*
+   * Startup timeline support.
+   */
+  static jbyteArray GetStartupTimeline() SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
   enum HpifWhen {
     HPIF_WHEN_NEVER = 0,
     HPIF_WHEN_NOW = 1,
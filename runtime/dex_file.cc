@@ -27,6 +27,7 @@
 #include "base/logging.h"
 #include "base/stringprintf.h"
 #include "class_linker.h"
+#include "cutils/atomic-inline.h"
 #include "dex_file-inl.h"
 #include "dex_file_verifier.h"
 #include "globals.h"
@@ -274,6 +275,7 @@ DexFile::~DexFile() {
   // that's only called after DetachCurrentThread, which means there's no JNIEnv. We could
   // re-attach, but cleaning up these global references is not obviously useful. It's not as if
   // the global reference table is otherwise empty!
+  delete owned_class_def_index_;
 }
 
 bool DexFile::Init() {
@@ -331,38 +333,74 @@ uint32_t DexFile::GetVersion() const {
   return atoi(version);
 }
 
+uint32_t DexFile::ComputeDescriptorHash(const char* descriptor) {
+  uint32_t hash = 0;
+  for (; *descriptor != '\0'; ++descriptor) {
+    hash = hash * 31 + *descriptor;
+  }
+  // Mix the high bits in, descriptors often only differ in their last characters.
+  return hash ^ (hash >> 16);
+}
+
+void DexFile::BuildClassDefIndex(std::vector<uint32_t>* index) const {
+  // Keep the table at most half full, there is always at least one empty entry.
+  const size_t num_class_defs = NumClassDefs();
+  const size_t num_entries = RoundUpToPowerOfTwo(num_class_defs * 2 + 1);
+  const size_t mask = num_entries - 1;
+  index->assign(1 + num_entries * 2, kDexNoIndex);
+  (*index)[0] = num_entries;
+  uint32_t* entries = &(*index)[1];
+  for (size_t i = 0; i < num_class_defs; ++i) {
+    const uint32_t hash = ComputeDescriptorHash(GetClassDescriptor(GetClassDef(i)));
+    size_t pos = hash & mask;
+    while (entries[pos * 2 + 1] != kDexNoIndex) {
+      pos = (pos + 1) & mask;
+    }
+    entries[pos * 2] = hash;
+    entries[pos * 2 + 1] = i;
+  }
+}
+
+const uint32_t* DexFile::GetClassDefIndex() const {
+  const uint32_t* index = class_def_index_;
+  if (LIKELY(index != NULL)) {
+    return index;
+  }
+  UniquePtr<std::vector<uint32_t> > new_index(new std::vector<uint32_t>);
+  BuildClassDefIndex(new_index.get());
+  if (android_atomic_release_cas(0, reinterpret_cast<int32_t>(&(*new_index)[0]),
+                                 reinterpret_cast<volatile int32_t*>(&class_def_index_)) == 0) {
+    owned_class_def_index_ = new_index.release();
+  }
+  // Either ours, or another thread published its index first.
+  return class_def_index_;
+}
+
 const DexFile::ClassDef* DexFile::FindClassDef(const char* descriptor) const {
   size_t num_class_defs = NumClassDefs();
   if (num_class_defs == 0) {
     return NULL;
   }
-  const StringId* string_id = FindStringId(descriptor);
-  if (string_id == NULL) {
-    return NULL;
-  }
-  const TypeId* type_id = FindTypeId(GetIndexForStringId(*string_id));
-  if (type_id == NULL) {
-    return NULL;
-  }
-  uint16_t type_idx = GetIndexForTypeId(*type_id);
-  for (size_t i = 0; i < num_class_defs; ++i) {
-    const ClassDef& class_def = GetClassDef(i);
-    if (class_def.class_idx_ == type_idx) {
-      return &class_def;
+  const uint32_t* index = GetClassDefIndex();
+  const size_t mask = index[0] - 1;
+  const uint32_t* entries = &index[1];
+  const uint32_t hash = ComputeDescriptorHash(descriptor);
+  for (size_t pos = hash & mask; entries[pos * 2 + 1] != kDexNoIndex; pos = (pos + 1) & mask) {
+    if (entries[pos * 2] == hash) {
+      const ClassDef& class_def = GetClassDef(entries[pos * 2 + 1]);
+      if (strcmp(GetClassDescriptor(class_def), descriptor) == 0) {
+        return &class_def;
+      }
     }
   }
   return NULL;
 }
 
 const DexFile::ClassDef* DexFile::FindClassDef(uint16_t type_idx) const {
-  size_t num_class_defs = NumClassDefs();
-  for (size_t i = 0; i < num_class_defs; ++i) {
-    const ClassDef& class_def = GetClassDef(i);
-    if (class_def.class_idx_ == type_idx) {
-      return &class_def;
-    }
+  if (NumClassDefs() == 0) {
+    return NULL;
   }
-  return NULL;
+  return FindClassDef(StringByTypeIdx(type_idx));
 }
 
 const DexFile::FieldId* DexFile::FindFieldId(const DexFile::TypeId& declaring_klass,
@@ -599,6 +599,22 @@ class DexFile {
   // Looks up a class definition by its class descriptor.
   const ClassDef* FindClassDef(const char* descriptor) const;
 
+  // Hash of a class descriptor as used by the class def index.
+  static uint32_t ComputeDescriptorHash(const char* descriptor);
+
+  // Builds an open addressing hash table from descriptor hashes to class def indices, probed
+  // linearly from the hash modulo the number of entries. The first word is the number of
+  // entries, a power of two, followed by that many pairs of descriptor hash and class def index.
+  // Empty entries have a class def index of kDexNoIndex. The oat writer persists this.
+  void BuildClassDefIndex(std::vector<uint32_t>* index) const;
+
+  // Use a class def index persisted elsewhere, which must outlive the dex file. Must be called
+  // before the dex file is used for lookups.
+  void SetClassDefIndex(const uint32_t* index) const {
+    DCHECK(class_def_index_ == NULL);
+    class_def_index_ = index;
+  }
+
   // Looks up a class definition by its type index.
   const ClassDef* FindClassDef(uint16_t type_idx) const;
 
@@ -850,7 +866,9 @@ class DexFile {
         field_ids_(0),
         method_ids_(0),
         proto_ids_(0),
-        class_defs_(0) {
+        class_defs_(0),
+        class_def_index_(NULL),
+        owned_class_def_index_(NULL) {
     CHECK(begin_ != NULL) << GetLocation();
     CHECK_GT(size_, 0U) << GetLocation();
   }
@@ -864,6 +882,9 @@ class DexFile {
   // Returns true if the header magic and version numbers are of the expected values.
   bool CheckMagicAndVersion() const;
 
+  // Returns the class def index, building it on first use.
+  const uint32_t* GetClassDefIndex() const;
+
   void DecodeDebugInfo0(const CodeItem* code_item, bool is_static, uint32_t method_idx,
       DexDebugNewPositionCb position_cb, DexDebugNewLocalCb local_cb,
       void* context, const byte* stream, LocalInfo* local_in_reg) const;
@@ -910,6 +931,13 @@ class DexFile {
 
   // Points to the base of the class definition list.
   const ClassDef* class_defs_;
+
+  // Class def index in the layout described at BuildClassDefIndex. Either persisted in the oat
+  // file, or created lazily and published with a CAS, so racing threads may both build one but
+  // only one is kept.
+  mutable const uint32_t* volatile class_def_index_;
+  // The lazily created index, if it won the race.
+  mutable std::vector<uint32_t>* owned_class_def_index_;
 };
 
 // Iterate over a dex file's ProtoId's paramters
@@ -221,6 +221,16 @@ TEST_F(DexFileTest, FindTypeId) {
   }
 }
 
+TEST_F(DexFileTest, FindClassDef) {
+  for (size_t i = 0; i < java_lang_dex_file_->NumClassDefs(); i++) {
+    const DexFile::ClassDef& class_def = java_lang_dex_file_->GetClassDef(i);
+    const char* descriptor = java_lang_dex_file_->GetClassDescriptor(class_def);
+    EXPECT_EQ(&class_def, java_lang_dex_file_->FindClassDef(descriptor)) << descriptor;
+    EXPECT_EQ(&class_def, java_lang_dex_file_->FindClassDef(class_def.class_idx_)) << descriptor;
+  }
+  EXPECT_TRUE(java_lang_dex_file_->FindClassDef("LNoSuchClass;") == NULL);
+}
+
 TEST_F(DexFileTest, FindProtoId) {
   for (size_t i = 0; i < java_lang_dex_file_->NumProtoIds(); i++) {
     const DexFile::ProtoId& to_find = java_lang_dex_file_->GetProtoId(i);
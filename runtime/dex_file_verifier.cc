@@ -16,8 +16,14 @@
 
 #include "dex_file_verifier.h"
 
+#include <pthread.h>
+#include <unistd.h>
 #include <zlib.h>
 
+#include <algorithm>
+
+#include "atomic_integer.h"
+#include "base/stl_util.h"
 #include "base/stringprintf.h"
 #include "dex_file-inl.h"
 #include "leb128.h"
@@ -1213,95 +1219,177 @@ bool DexFileVerifier::CheckIntraDataSection(uint32_t offset, uint32_t count, uin
   return true;
 }
 
+// Each section is checked by its own verifier, as the checks walk the items of a section with a
+// cursor.
+struct DexFileVerifier::SectionTask {
+  SectionTask(const DexFileVerifier* parent, const DexFile::MapItem* item, bool inter)
+      : verifier(parent->dex_file_, parent->begin_, parent->size_, parent->type_map_),
+        item(item), inter(inter), end_offset(0), result(false) {
+  }
+
+  void Run() {
+    if (inter) {
+      result = verifier.CheckInterSectionIterate(item->offset_, item->size_, item->type_);
+    } else {
+      result = verifier.CheckIntraSectionItem(item, &end_offset);
+    }
+  }
+
+  DexFileVerifier verifier;
+  const DexFile::MapItem* const item;
+  const bool inter;
+  uint32_t end_offset;
+  bool result;
+};
+
+struct DexFileVerifier::SectionTaskQueue {
+  const std::vector<SectionTask*>* tasks;
+  AtomicInteger next_index;
+};
+
+void* DexFileVerifier::SectionTaskWorker(void* arg) {
+  SectionTaskQueue* queue = reinterpret_cast<SectionTaskQueue*>(arg);
+  while (true) {
+    size_t i = queue->next_index++;
+    if (i >= queue->tasks->size()) {
+      return NULL;
+    }
+    (*queue->tasks)[i]->Run();
+  }
+}
+
+bool DexFileVerifier::RunSectionTasks(const std::vector<SectionTask*>& tasks) const {
+  SectionTaskQueue queue;
+  queue.tasks = &tasks;
+  size_t thread_count = 1;
+  if (size_ >= kParallelVerifySize) {
+    thread_count = std::min(tasks.size(), static_cast<size_t>(sysconf(_SC_NPROCESSORS_CONF)));
+  }
+  // The calling thread is one of the workers.
+  std::vector<pthread_t> threads(thread_count > 1 ? thread_count - 1 : 0);
+  for (size_t i = 0; i < threads.size(); ++i) {
+    CHECK_PTHREAD_CALL(pthread_create, (&threads[i], NULL, SectionTaskWorker, &queue),
+                       "dex file verifier");
+  }
+  SectionTaskWorker(&queue);
+  for (size_t i = 0; i < threads.size(); ++i) {
+    CHECK_PTHREAD_CALL(pthread_join, (threads[i], NULL), "dex file verifier");
+  }
+  for (size_t i = 0; i < tasks.size(); ++i) {
+    if (!tasks[i]->result) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool DexFileVerifier::CheckIntraSectionItem(const DexFile::MapItem* item, uint32_t* end_offset) {
+  uint32_t section_offset = item->offset_;
+  uint32_t section_count = item->size_;
+  uint16_t type = item->type_;
+  ptr_ = begin_ + section_offset;
+
+  // Check each item based on its type.
+  switch (type) {
+    case DexFile::kDexTypeHeaderItem:
+      if (section_count != 1) {
+        LOG(ERROR) << "Multiple header items";
+        return false;
+      }
+      if (section_offset != 0) {
+        LOG(ERROR) << StringPrintf("Header at %x, not at start of file", section_offset);
+        return false;
+      }
+      *end_offset = header_->header_size_;
+      return true;
+    case DexFile::kDexTypeStringIdItem:
+    case DexFile::kDexTypeTypeIdItem:
+    case DexFile::kDexTypeProtoIdItem:
+    case DexFile::kDexTypeFieldIdItem:
+    case DexFile::kDexTypeMethodIdItem:
+    case DexFile::kDexTypeClassDefItem:
+      if (!CheckIntraIdSection(section_offset, section_count, type)) {
+        return false;
+      }
+      break;
+    case DexFile::kDexTypeMapList: {
+      if (section_count != 1) {
+        LOG(ERROR) << "Multiple map list items";
+        return false;
+      }
+      if (section_offset != header_->map_off_) {
+        LOG(ERROR) << StringPrintf("Map not at header-defined offset: %x, expected %x",
+            section_offset, header_->map_off_);
+        return false;
+      }
+      const DexFile::MapList* map =
+          reinterpret_cast<const DexFile::MapList*>(begin_ + header_->map_off_);
+      *end_offset = section_offset + sizeof(uint32_t) + (map->size_ * sizeof(DexFile::MapItem));
+      return true;
+    }
+    case DexFile::kDexTypeTypeList:
+    case DexFile::kDexTypeAnnotationSetRefList:
+    case DexFile::kDexTypeAnnotationSetItem:
+    case DexFile::kDexTypeClassDataItem:
+    case DexFile::kDexTypeCodeItem:
+    case DexFile::kDexTypeStringDataItem:
+    case DexFile::kDexTypeDebugInfoItem:
+    case DexFile::kDexTypeAnnotationItem:
+    case DexFile::kDexTypeEncodedArrayItem:
+    case DexFile::kDexTypeAnnotationsDirectoryItem:
+      if (!CheckIntraDataSection(section_offset, section_count, type)) {
+        return false;
+      }
+      break;
+    default:
+      LOG(ERROR) << StringPrintf("Unknown map item type %x", type);
+      return false;
+  }
+
+  *end_offset = reinterpret_cast<uint32_t>(ptr_) - reinterpret_cast<uint32_t>(begin_);
+  return true;
+}
+
 bool DexFileVerifier::CheckIntraSection() {
   const DexFile::MapList* map = reinterpret_cast<const DexFile::MapList*>(begin_ + header_->map_off_);
   const DexFile::MapItem* item = map->list_;
-
   uint32_t count = map->size_;
-  uint32_t offset = 0;
-  ptr_ = begin_;
 
-  // Check the items listed in the map.
-  while (count--) {
-    uint32_t section_offset = item->offset_;
-    uint32_t section_count = item->size_;
-    uint16_t type = item->type_;
+  // Check the items of each section, which CheckMap found to start within the file.
+  std::vector<SectionTask*> tasks;
+  for (uint32_t i = 0; i < count; i++) {
+    tasks.push_back(new SectionTask(this, &item[i], false));
+  }
+  bool result = RunSectionTasks(tasks);
 
-    // Check for padding and overlap between items.
+  // Check for padding and overlap between sections.
+  uint32_t offset = 0;
+  for (uint32_t i = 0; result && i < count; i++) {
+    uint32_t section_offset = item[i].offset_;
+    ptr_ = begin_ + offset;
     if (!CheckPadding(offset, section_offset)) {
-      return false;
+      result = false;
     } else if (offset > section_offset) {
       LOG(ERROR) << StringPrintf("Section overlap or out-of-order map: %x, %x", offset, section_offset);
-      return false;
+      result = false;
     }
+    offset = tasks[i]->end_offset;
+  }
 
-    // Check each item based on its type.
-    switch (type) {
-      case DexFile::kDexTypeHeaderItem:
-        if (section_count != 1) {
-          LOG(ERROR) << "Multiple header items";
-          return false;
-        }
-        if (section_offset != 0) {
-          LOG(ERROR) << StringPrintf("Header at %x, not at start of file", section_offset);
-          return false;
-        }
-        ptr_ = begin_ + header_->header_size_;
-        offset = header_->header_size_;
-        break;
-      case DexFile::kDexTypeStringIdItem:
-      case DexFile::kDexTypeTypeIdItem:
-      case DexFile::kDexTypeProtoIdItem:
-      case DexFile::kDexTypeFieldIdItem:
-      case DexFile::kDexTypeMethodIdItem:
-      case DexFile::kDexTypeClassDefItem:
-        if (!CheckIntraIdSection(section_offset, section_count, type)) {
-          return false;
-        }
-        offset = reinterpret_cast<uint32_t>(ptr_) - reinterpret_cast<uint32_t>(begin_);
-        break;
-      case DexFile::kDexTypeMapList:
-        if (section_count != 1) {
-          LOG(ERROR) << "Multiple map list items";
-          return false;
-        }
-        if (section_offset != header_->map_off_) {
-          LOG(ERROR) << StringPrintf("Map not at header-defined offset: %x, expected %x",
-              section_offset, header_->map_off_);
-          return false;
-        }
-        ptr_ += sizeof(uint32_t) + (map->size_ * sizeof(DexFile::MapItem));
-        offset = section_offset + sizeof(uint32_t) + (map->size_ * sizeof(DexFile::MapItem));
-        break;
-      case DexFile::kDexTypeTypeList:
-      case DexFile::kDexTypeAnnotationSetRefList:
-      case DexFile::kDexTypeAnnotationSetItem:
-      case DexFile::kDexTypeClassDataItem:
-      case DexFile::kDexTypeCodeItem:
-      case DexFile::kDexTypeStringDataItem:
-      case DexFile::kDexTypeDebugInfoItem:
-      case DexFile::kDexTypeAnnotationItem:
-      case DexFile::kDexTypeEncodedArrayItem:
-      case DexFile::kDexTypeAnnotationsDirectoryItem:
-        if (!CheckIntraDataSection(section_offset, section_count, type)) {
-          return false;
-        }
-        offset = reinterpret_cast<uint32_t>(ptr_) - reinterpret_cast<uint32_t>(begin_);
-        break;
-      default:
-        LOG(ERROR) << StringPrintf("Unknown map item type %x", type);
-        return false;
+  // Sections don't overlap, so neither do the data items they found.
+  for (uint32_t i = 0; result && i < count; i++) {
+    const SafeMap<uint32_t, uint16_t>& section_map = tasks[i]->verifier.offset_to_type_map_;
+    for (const auto& entry : section_map) {
+      offset_to_type_map_.Put(entry.first, entry.second);
     }
-
-    item++;
   }
-
-  return true;
+  STLDeleteElements(&tasks);
+  return result;
 }
 
 bool DexFileVerifier::CheckOffsetToTypeMap(uint32_t offset, uint16_t type) {
-  auto it = offset_to_type_map_.find(offset);
-  if (it == offset_to_type_map_.end()) {
+  auto it = type_map_->find(offset);
+  if (it == type_map_->end()) {
     LOG(ERROR) << StringPrintf("No data map entry found @ %x; expected %x", offset, type);
     return false;
   }
@@ -1878,9 +1966,8 @@ bool DexFileVerifier::CheckInterSection() {
   uint32_t count = map->size_;
 
   // Cross check the items listed in the map.
+  std::vector<SectionTask*> tasks;
   while (count--) {
-    uint32_t section_offset = item->offset_;
-    uint32_t section_count = item->size_;
     uint16_t type = item->type_;
 
     switch (type) {
@@ -1903,20 +1990,21 @@ bool DexFileVerifier::CheckInterSection() {
       case DexFile::kDexTypeAnnotationSetItem:
       case DexFile::kDexTypeClassDataItem:
       case DexFile::kDexTypeAnnotationsDirectoryItem: {
-        if (!CheckInterSectionIterate(section_offset, section_count, type)) {
-          return false;
-        }
+        tasks.push_back(new SectionTask(this, item, true));
         break;
       }
       default:
         LOG(ERROR) << StringPrintf("Unknown map item type %x", type);
+        STLDeleteElements(&tasks);
         return false;
     }
 
     item++;
   }
 
-  return true;
+  bool result = RunSectionTasks(tasks);
+  STLDeleteElements(&tasks);
+  return result;
 }
 
 bool DexFileVerifier::Verify() {
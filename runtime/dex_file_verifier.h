@@ -17,7 +17,10 @@
 #ifndef ART_RUNTIME_DEX_FILE_VERIFIER_H_
 #define ART_RUNTIME_DEX_FILE_VERIFIER_H_
 
+#include <vector>
+
 #include "dex_file.h"
+#include "globals.h"
 #include "safe_map.h"
 
 namespace art {
@@ -27,13 +30,31 @@ class DexFileVerifier {
   static bool Verify(const DexFile* dex_file, const byte* begin, size_t size);
 
  private:
+  struct SectionTask;
+  struct SectionTaskQueue;
+
+  // Dex files at least this big have their sections checked on several threads.
+  static const size_t kParallelVerifySize = 1 * MB;
+
   DexFileVerifier(const DexFile* dex_file, const byte* begin, size_t size)
       : dex_file_(dex_file), begin_(begin), size_(size),
-        header_(&dex_file->GetHeader()), ptr_(NULL), previous_item_(NULL)  {
+        header_(&dex_file->GetHeader()), type_map_(&offset_to_type_map_), ptr_(NULL),
+        previous_item_(NULL)  {
+  }
+
+  // Creates a verifier for a single section, which looks data items up in 'type_map'.
+  DexFileVerifier(const DexFile* dex_file, const byte* begin, size_t size,
+                  const SafeMap<uint32_t, uint16_t>* type_map)
+      : dex_file_(dex_file), begin_(begin), size_(size),
+        header_(&dex_file->GetHeader()), type_map_(type_map), ptr_(NULL), previous_item_(NULL)  {
   }
 
   bool Verify();
 
+  // Runs the tasks, on several threads for large dex files, and returns whether all succeeded.
+  bool RunSectionTasks(const std::vector<SectionTask*>& tasks) const;
+  static void* SectionTaskWorker(void* arg);
+
   bool CheckPointerRange(const void* start, const void* end, const char* label) const;
   bool CheckListSize(const void* start, uint32_t count, uint32_t element_size, const char* label) const;
   bool CheckIndex(uint32_t field, uint32_t limit, const char* label) const;
@@ -62,6 +83,7 @@ class DexFileVerifier {
   bool CheckIntraSectionIterate(uint32_t offset, uint32_t count, uint16_t type);
   bool CheckIntraIdSection(uint32_t offset, uint32_t count, uint16_t type);
   bool CheckIntraDataSection(uint32_t offset, uint32_t count, uint16_t type);
+  bool CheckIntraSectionItem(const DexFile::MapItem* item, uint32_t* end_offset);
   bool CheckIntraSection();
 
   bool CheckOffsetToTypeMap(uint32_t offset, uint16_t type);
@@ -87,7 +109,10 @@ class DexFileVerifier {
   size_t size_;
   const DexFile::Header* header_;
 
+  // Data items found by the intra-section checks of this verifier, by offset.
   SafeMap<uint32_t, uint16_t> offset_to_type_map_;
+  // Data items of the whole dex file, used by the inter-section checks.
+  const SafeMap<uint32_t, uint16_t>* const type_map_;
   const byte* ptr_;
   const void* previous_item_;
 };
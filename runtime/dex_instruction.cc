@@ -565,6 +565,7 @@ std::string Instruction::DumpString(const DexFile* file) const {
             break;
           }  // else fall-through
         case INVOKE_VIRTUAL_QUICK:
+        case INVOKE_SUPER_QUICK:
           if (file != NULL) {
             os << opcode << " {";
             uint32_t method_idx = VRegB_35c();
@@ -598,6 +599,7 @@ std::string Instruction::DumpString(const DexFile* file) const {
             break;
           }  // else fall-through
         case INVOKE_VIRTUAL_RANGE_QUICK:
+        case INVOKE_SUPER_RANGE_QUICK:
           if (file != NULL) {
             uint32_t method_idx = VRegB_3rc();
             os << StringPrintf("%s, {v%d .. v%d}, ", opcode, VRegC_3rc(), (VRegC_3rc() + VRegA_3rc() - 1))
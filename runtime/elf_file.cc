@@ -596,9 +596,21 @@ size_t ElfFile::GetLoadedSize() {
   return loaded_size;
 }
 
-bool ElfFile::Load(bool executable) {
+size_t ElfFile::GetLoadAlignment() {
+  size_t alignment = kPageSize;
+  for (llvm::ELF::Elf32_Word i = 0; i < GetProgramHeaderNum(); i++) {
+    llvm::ELF::Elf32_Phdr& program_header = GetProgramHeader(i);
+    if (program_header.p_type == llvm::ELF::PT_LOAD && program_header.p_align > alignment) {
+      alignment = program_header.p_align;
+    }
+  }
+  return alignment;
+}
+
+bool ElfFile::Load(bool executable, ptrdiff_t load_bias) {
   // TODO: actually return false error
   CHECK(program_header_only_) << file_->GetPath();
+  base_address_ = reinterpret_cast<byte*>(load_bias);
   for (llvm::ELF::Elf32_Word i = 0; i < GetProgramHeaderNum(); i++) {
     llvm::ELF::Elf32_Phdr& program_header = GetProgramHeader(i);
 
@@ -628,8 +640,13 @@ bool ElfFile::Load(bool executable) {
     if (program_header.p_vaddr == 0) {
       std::string reservation_name("ElfFile reservation for ");
       reservation_name += file_->GetPath();
-      UniquePtr<MemMap> reserve(MemMap::MapAnonymous(reservation_name.c_str(),
-                                                     NULL, GetLoadedSize(), PROT_NONE));
+      // Segments aligned beyond a page, such as an oat file's text written for huge pages, only
+      // keep their alignment in memory if the reservation has it too.
+      size_t alignment = GetLoadAlignment();
+      UniquePtr<MemMap> reserve((alignment == kPageSize)
+          ? MemMap::MapAnonymous(reservation_name.c_str(), NULL, GetLoadedSize(), PROT_NONE)
+          : MemMap::MapAnonymousAligned(reservation_name.c_str(), GetLoadedSize(), PROT_NONE,
+                                        alignment));
       CHECK(reserve.get() != NULL) << file_->GetPath();
       base_address_ = reserve->Begin();
       segments_.push_back(reserve.release());
@@ -670,6 +687,10 @@ bool ElfFile::Load(bool executable) {
                                                        true));
     CHECK(segment.get() != NULL) << file_->GetPath();
     CHECK_EQ(segment->Begin(), p_vaddr) << file_->GetPath();
+    if (MemMap::UseHugePages() && (prot & PROT_EXEC) != 0) {
+      // Where the kernel supports huge pages for file mappings, they can back the code.
+      segment->AdviseHugePages();
+    }
     segments_.push_back(segment.release());
   }
 
@@ -113,9 +113,13 @@ class ElfFile {
   // Returns the expected size when the file is loaded at runtime
   size_t GetLoadedSize();
 
+  // Returns the largest alignment a PT_LOAD segment asks for, at least the page size.
+  size_t GetLoadAlignment();
+
   // Load segments into memory based on PT_LOAD program headers.
   // executable is true at run time, false at compile time.
-  bool Load(bool executable);
+  // Segments at fixed addresses are loaded load_bias bytes away from them.
+  bool Load(bool executable, ptrdiff_t load_bias = 0);
 
  private:
   ElfFile();
@@ -327,6 +327,9 @@ static inline void CheckSuspend(Thread* thread) SHARED_LOCKS_REQUIRED(Locks::mut
       thread->AtomicClearFlag(kCheckpointRequest);
     } else if (thread->ReadFlag(kSuspendRequest)) {
       thread->FullSuspendCheck();
+    } else if (thread->ReadFlag(kInstrumentationRequest)) {
+      // Nothing to do here, the interpreter re-reads the instrumentation after a suspend check.
+      thread->AtomicClearFlag(kInstrumentationRequest);
     } else {
       break;
     }
@@ -30,18 +30,26 @@ extern "C" void artInterpreterToCompiledCodeBridge(Thread* self, MethodHelper& m
                                                    ShadowFrame* shadow_frame, JValue* result) {
   mirror::ArtMethod* method = shadow_frame->GetMethod();
   // Ensure static methods are initialized.
-  if (method->IsStatic()) {
-    Runtime::Current()->GetClassLinker()->EnsureInitialized(method->GetDeclaringClass(), true, true);
+  if (method->IsStatic() && UNLIKELY(!method->GetDeclaringClass()->IsInitialized())) {
+    if (!Runtime::Current()->GetClassLinker()->EnsureInitialized(method->GetDeclaringClass(),
+                                                                 true, true)) {
+      DCHECK(self->IsExceptionPending());
+      return;
+    }
   }
   uint16_t arg_offset = (code_item == NULL) ? 0 : code_item->registers_size_ - code_item->ins_size_;
+  // The interpreter only gets here for a started runtime and a method with code, skip Invoke's
+  // checks of those.
 #if defined(ART_USE_PORTABLE_COMPILER)
   ArgArray arg_array(mh.GetShorty(), mh.GetShortyLength());
   arg_array.BuildArgArrayFromFrame(shadow_frame, arg_offset);
-  method->Invoke(self, arg_array.GetArray(), arg_array.GetNumBytes(), result, mh.GetShorty()[0]);
+  method->InvokeCompiledCode(self, arg_array.GetArray(), arg_array.GetNumBytes(), result,
+                             mh.GetShorty()[0]);
 #else
-  method->Invoke(self, shadow_frame->GetVRegArgs(arg_offset),
-                 (shadow_frame->NumberOfVRegs() - arg_offset) * 4,
-                 result, mh.GetShorty()[0]);
+  // The arguments are the ins at the end of the shadow frame, laid out as the stub expects.
+  method->InvokeCompiledCode(self, shadow_frame->GetVRegArgs(arg_offset),
+                             (shadow_frame->NumberOfVRegs() - arg_offset) * 4,
+                             result, mh.GetShorty()[0]);
 #endif
 }
 
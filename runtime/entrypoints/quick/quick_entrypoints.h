@@ -82,6 +82,7 @@ struct PACKED(4) QuickEntryPoints {
   mirror::Object* (*pJniMethodEndWithReference)(jobject result, uint32_t cookie, Thread* self);
   mirror::Object* (*pJniMethodEndWithReferenceSynchronized)(jobject result, uint32_t cookie,
                                                     jobject locked, Thread* self);
+  mirror::Object* (*pJniMethodFastEndWithReference)(jobject result, Thread* self);
 
   // Locks
   void (*pLockObject)(void*);
@@ -157,6 +158,10 @@ extern mirror::Object* JniMethodEndWithReferenceSynchronized(jobject result,
                                                              jobject locked, Thread* self)
     SHARED_LOCK_FUNCTION(Locks::mutator_lock_) HOT_ATTR;
 
+// Exit of a fast native method, which ran without leaving Runnable.
+extern mirror::Object* JniMethodFastEndWithReference(jobject result, Thread* self)
+    SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) HOT_ATTR;
+
 }  // namespace art
 
 #endif  // ART_RUNTIME_ENTRYPOINTS_QUICK_QUICK_ENTRYPOINTS_H_
@@ -33,12 +33,18 @@ extern "C" uint64_t artInvokeInterfaceTrampoline(mirror::ArtMethod* interface_me
     SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
   mirror::ArtMethod* method;
   if (LIKELY(interface_method->GetDexMethodIndex() != DexFile::kDexNoIndex)) {
-    method = this_object->GetClass()->FindVirtualMethodForInterface(interface_method);
+    mirror::Class* klass = this_object->GetClass();
+    method = self->LookupInterfaceDispatch(klass, interface_method);
     if (UNLIKELY(method == NULL)) {
-      FinishCalleeSaveFrameSetup(self, sp, Runtime::kRefsAndArgs);
-      ThrowIncompatibleClassChangeErrorClassForInterfaceDispatch(interface_method, this_object,
-                                                                 caller_method);
-      return 0;  // Failure.
+      // Miss, search the iftable and remember the target for the next dispatch.
+      method = klass->FindVirtualMethodForInterface(interface_method);
+      if (UNLIKELY(method == NULL)) {
+        FinishCalleeSaveFrameSetup(self, sp, Runtime::kRefsAndArgs);
+        ThrowIncompatibleClassChangeErrorClassForInterfaceDispatch(interface_method, this_object,
+                                                                   caller_method);
+        return 0;  // Failure.
+      }
+      self->AddInterfaceDispatch(klass, interface_method, method);
     }
   } else {
     FinishCalleeSaveFrameSetup(self, sp, Runtime::kRefsAndArgs);
@@ -94,4 +94,19 @@ extern mirror::Object* JniMethodEndWithReferenceSynchronized(jobject result,
   return o;
 }
 
+// Called on exit of a fast native method returning a reference. Fast native methods stay Runnable
+// and don't push a local reference segment, so only the SIRT needs popping.
+extern mirror::Object* JniMethodFastEndWithReference(jobject result, Thread* self) {
+  mirror::Object* o = self->DecodeJObject(result);  // Must decode before pop.
+  self->PopSirt();
+  // Process result.
+  if (UNLIKELY(self->GetJniEnv()->check_jni)) {
+    if (self->IsExceptionPending()) {
+      return NULL;
+    }
+    CheckReferenceResult(o, self);
+  }
+  return o;
+}
+
 }  // namespace art
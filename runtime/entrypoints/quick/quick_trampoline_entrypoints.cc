@@ -19,6 +19,8 @@
 #include "dex_file-inl.h"
 #include "dex_instruction-inl.h"
 #include "entrypoints/entrypoint_utils.h"
+#include "hot_method_compiler.h"
+#include "instrumentation.h"
 #include "interpreter/interpreter.h"
 #include "invoke_arg_array_builder.h"
 #include "mirror/art_method-inl.h"
@@ -524,7 +526,8 @@ extern "C" const void* artQuickResolutionTrampoline(mirror::ArtMethod* called,
   visitor.VisitArguments();
   thread->EndAssertNoThreadSuspension(old_cause);
   // Resolve method filling in dex cache.
-  if (called->IsRuntimeMethod()) {
+  const bool from_call_site = called->IsRuntimeMethod();
+  if (from_call_site) {
     called = linker->ResolveMethod(dex_method_idx, caller, invoke_type);
   }
   const void* code = NULL;
@@ -542,6 +545,18 @@ extern "C" const void* artQuickResolutionTrampoline(mirror::ArtMethod* called,
     linker->EnsureInitialized(called_class, true, true);
     if (LIKELY(called_class->IsInitialized())) {
       code = called->GetEntryPointFromCompiledCode();
+      if (UNLIKELY(code == GetQuickResolutionTrampoline(linker))) {
+        // The method's code is compressed in its oat file. Inflate it, and have later calls go
+        // straight to it.
+        code = linker->GetOatCodeFor(called);
+        Runtime::Current()->GetInstrumentation()->UpdateMethodsCode(called, code);
+      }
+      // Code cache callers can have later calls skip the trampoline.
+      HotMethodCompiler* hot_method_compiler = Runtime::Current()->GetHotMethodCompiler();
+      if (from_call_site && (invoke_type == kStatic || invoke_type == kDirect) &&
+          hot_method_compiler != NULL) {
+        hot_method_compiler->PatchCallSites(caller, dex_method_idx, called);
+      }
     } else if (called_class->IsInitializing()) {
       if (invoke_type == kStatic) {
         // Class is still initializing, go to oat and grab code (trampoline must be left in place
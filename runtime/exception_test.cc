@@ -17,8 +17,10 @@
 #include "class_linker.h"
 #include "common_test.h"
 #include "dex_file.h"
+#include "gc_map.h"
 #include "gtest/gtest.h"
 #include "leb128_encoder.h"
+#include "mapping_table.h"
 #include "mirror/class-inl.h"
 #include "mirror/object_array-inl.h"
 #include "mirror/object-inl.h"
@@ -66,10 +68,8 @@ class ExceptionTest : public CommonTest {
 
     fake_vmap_table_data_.PushBack(0);
 
-    fake_gc_map_.push_back(0);  // 0 bytes to encode references and native pc offsets.
-    fake_gc_map_.push_back(0);
-    fake_gc_map_.push_back(0);  // 0 entries.
-    fake_gc_map_.push_back(0);
+    // A header for a map with 0 entries and 0 bitmaps, of 0 bytes each, encoded with 0 bits.
+    fake_gc_map_.assign(NativePcOffsetToReferenceMap::kHeaderSize, 0);
 
     method_f_ = my_klass_->FindVirtualMethod("f", "()I");
     ASSERT_TRUE(method_f_ != NULL);
@@ -137,6 +137,63 @@ TEST_F(ExceptionTest, FindCatchHandler) {
   }
 }
 
+TEST_F(ExceptionTest, FindCatchHandlerByNativePc) {
+  // Calls at native pc 0x10 (dex pc 3) and 0x20 (dex pc 6), of which only the first is in a try
+  // block, with handlers for type 5 at dex pc 8 and for everything else at dex pc 12.
+  UnsignedLeb128EncodingVector table;
+  table.PushBack(4);  // Total entries.
+  table.PushBack(2);  // Pc to dex entries.
+  table.PushBackSigned(0x10);  // Differences from the entry before.
+  table.PushBackSigned(3);
+  table.PushBackSigned(0x10);
+  table.PushBackSigned(3);
+  table.PushBackSigned(0x30);  // Dex to pc entries.
+  table.PushBackSigned(8);
+  table.PushBackSigned(0x10);
+  table.PushBackSigned(4);
+  UnsignedLeb128EncodingVector catch_sites;
+  catch_sites.PushBack(0x10);
+  catch_sites.PushBack(0);  // Offset of its handler list.
+  table.PushBack(1);
+  table.PushBack(catch_sites.GetData().size());
+  table.InsertBack(catch_sites);
+  table.PushBack(2);  // Handlers in the list.
+  table.PushBack(5 + 1);
+  table.PushBack(8);
+  table.PushBack(0x30 << 1);
+  table.PushBack(0);  // Catch all.
+  table.PushBack(12);
+  table.PushBack((0x40 << 1) | 1);  // Doesn't start with a move-exception.
+
+  MappingTable mapping_table(&table.GetData()[0]);
+  MappingTable::PcToDexIterator pc_to_dex = mapping_table.PcToDexBegin();
+  EXPECT_EQ(0x10U, pc_to_dex.NativePcOffset());
+  EXPECT_EQ(3U, pc_to_dex.DexPc());
+  ++pc_to_dex;
+  EXPECT_EQ(0x20U, pc_to_dex.NativePcOffset());
+  EXPECT_EQ(6U, pc_to_dex.DexPc());
+  MappingTable::DexToPcIterator dex_to_pc = mapping_table.DexToPcBegin();
+  ++dex_to_pc;
+  EXPECT_EQ(0x40U, dex_to_pc.NativePcOffset());
+  EXPECT_EQ(12U, dex_to_pc.DexPc());
+  EXPECT_FALSE(mapping_table.FindCatchHandlers(0x20).HasNext());
+  MappingTable::CatchHandlerIterator it = mapping_table.FindCatchHandlers(0x10);
+  ASSERT_TRUE(it.HasNext());
+  EXPECT_FALSE(it.IsCatchAll());
+  EXPECT_EQ(5, it.GetHandlerTypeIndex());
+  EXPECT_EQ(8U, it.GetHandlerDexPc());
+  EXPECT_EQ(0x30U, it.GetHandlerNativePcOffset());
+  EXPECT_FALSE(it.HasNoMoveException());
+  it.Next();
+  ASSERT_TRUE(it.HasNext());
+  EXPECT_TRUE(it.IsCatchAll());
+  EXPECT_EQ(12U, it.GetHandlerDexPc());
+  EXPECT_EQ(0x40U, it.GetHandlerNativePcOffset());
+  EXPECT_TRUE(it.HasNoMoveException());
+  it.Next();
+  EXPECT_FALSE(it.HasNext());
+}
+
 TEST_F(ExceptionTest, StackTraceElement) {
   Thread* thread = Thread::Current();
   thread->TransitionFromSuspendedToRunnable();
@@ -217,6 +274,11 @@ TEST_F(ExceptionTest, StackTraceElement) {
   EXPECT_STREQ("f", trace_array->Get(1)->GetMethodName()->ToModifiedUtf8().c_str());
   EXPECT_EQ(22, trace_array->Get(1)->GetLineNumber());
 
+  // A trace of the same frames shares the internal stack trace.
+  jobject internal_again = thread->CreateInternalStackTrace(soa);
+  ASSERT_TRUE(internal_again != NULL);
+  EXPECT_EQ(soa.Decode<mirror::Object*>(internal), soa.Decode<mirror::Object*>(internal_again));
+
 #if !defined(ART_USE_PORTABLE_COMPILER)
   thread->SetTopOfStack(NULL, 0);  // Disarm the assertion that no code is running when we detach.
 #else
@@ -0,0 +1,342 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "fault_handler.h"
+
+#include <string.h>
+
+#include "base/logging.h"
+#include "globals.h"
+#include "instrumentation.h"
+#include "mapping_table.h"
+#include "mirror/art_method-inl.h"
+#include "runtime.h"
+#include "signal_context.h"
+#include "thread.h"
+#include "utils.h"
+
+#if defined(__arm__) && !defined(ART_USE_PORTABLE_COMPILER)
+#define ART_IMPLICIT_NULL_CHECKS 1
+extern "C" void art_quick_throw_null_pointer_exception();
+#endif
+
+#if (defined(__arm__) || defined(__i386__) || (defined(__mips__) && defined(HAVE_ANDROID_OS))) && \
+    !defined(ART_USE_PORTABLE_COMPILER)
+#define ART_IMPLICIT_STACK_OVERFLOW_CHECKS 1
+extern "C" void art_quick_throw_stack_overflow(void*);
+#endif
+
+#if defined(__i386__) && !defined(ART_USE_PORTABLE_COMPILER)
+#define ART_IMPLICIT_SUSPEND_CHECKS 1
+extern "C" void art_quick_test_suspend();
+#endif
+
+namespace art {
+
+struct sigaction FaultManager::old_action_;
+bool FaultManager::initialized_ = false;
+
+#if defined(ART_IMPLICIT_STACK_OVERFLOW_CHECKS)
+
+// The stack probe is among the first instructions of a method, see Mir2Lir::GenEntrySequence.
+static constexpr uintptr_t kMaxStackProbeOffset = 16;
+
+#if defined(__arm__)
+// The Thumb state bit of the cpsr.
+static constexpr uint32_t kCpsrThumbBit = 1 << 5;
+
+static uintptr_t GetPc(const MachineContext& context) { return context.arm_pc; }
+static uintptr_t GetSp(const MachineContext& context) { return context.arm_sp; }
+static uintptr_t GetArg0(const MachineContext& context) { return context.arm_r0; }
+static void SetPc(MachineContext& context, uintptr_t pc) { context.arm_pc = pc; }
+
+// Resumes at the entrypoint, switching to its instruction set.
+static void SetPcToEntrypoint(MachineContext& context, uintptr_t entrypoint) {
+  context.arm_pc = entrypoint & ~static_cast<uintptr_t>(1);
+  if ((entrypoint & 1) == 0) {
+    context.arm_cpsr &= ~kCpsrThumbBit;
+  }
+}
+
+static size_t StackProbeSize(uintptr_t pc) {
+  return FaultManager::ThumbInstructionSize(*reinterpret_cast<const uint16_t*>(pc));
+}
+#elif defined(__i386__) && defined(HAVE_ANDROID_OS)
+static uintptr_t GetPc(const MachineContext& context) { return context.eip; }
+static uintptr_t GetSp(const MachineContext& context) { return context.esp; }
+static uintptr_t GetArg0(const MachineContext& context) { return context.eax; }
+static void SetPc(MachineContext& context, uintptr_t pc) { context.eip = pc; }
+static void SetSp(MachineContext& context, uintptr_t sp) { context.esp = sp; }
+static void SetPcToEntrypoint(MachineContext& context, uintptr_t entrypoint) {
+  context.eip = entrypoint;
+}
+
+static size_t StackProbeSize(uintptr_t pc) {
+  return FaultManager::X86StackProbeSize(reinterpret_cast<const uint8_t*>(pc));
+}
+#elif defined(__i386__)
+static uintptr_t GetPc(const MachineContext& context) { return context.gregs[REG_EIP]; }
+static uintptr_t GetSp(const MachineContext& context) { return context.gregs[REG_ESP]; }
+static uintptr_t GetArg0(const MachineContext& context) { return context.gregs[REG_EAX]; }
+static void SetPc(MachineContext& context, uintptr_t pc) { context.gregs[REG_EIP] = pc; }
+static void SetSp(MachineContext& context, uintptr_t sp) { context.gregs[REG_ESP] = sp; }
+static void SetPcToEntrypoint(MachineContext& context, uintptr_t entrypoint) {
+  context.gregs[REG_EIP] = entrypoint;
+}
+
+static size_t StackProbeSize(uintptr_t pc) {
+  return FaultManager::X86StackProbeSize(reinterpret_cast<const uint8_t*>(pc));
+}
+#elif defined(__mips__)
+static uintptr_t GetPc(const MachineContext& context) { return context.sc_pc; }
+static uintptr_t GetSp(const MachineContext& context) { return context.sc_regs[29]; }
+static uintptr_t GetArg0(const MachineContext& context) { return context.sc_regs[4]; }
+static void SetPc(MachineContext& context, uintptr_t pc) { context.sc_pc = pc; }
+
+// The entrypoint computes its global pointer from $t9, as if it had been called through it.
+static void SetPcToEntrypoint(MachineContext& context, uintptr_t entrypoint) {
+  context.sc_pc = entrypoint;
+  context.sc_regs[25] = entrypoint;
+}
+
+static size_t StackProbeSize(uintptr_t) {
+  return 4;
+}
+#endif
+
+// Checks that a word read off the stack points to an ArtMethod, using only reads of memory that
+// is known to be mapped. The class is read directly as the accessors may verify the object.
+static bool IsMethod(const mirror::ArtMethod* method) {
+  if (method == NULL || !IsAligned<kObjectAlignment>(method) ||
+      Runtime::Current()->GetHeap()->FindContinuousSpaceFromObject(method, true) == NULL) {
+    return false;
+  }
+  const byte* raw_addr = reinterpret_cast<const byte*>(method) +
+      mirror::Object::ClassOffset().Int32Value();
+  const mirror::Class* klass =
+      reinterpret_cast<const mirror::HeapReference<mirror::Class>*>(raw_addr)->AsMirrorPtr();
+  return klass != NULL && klass == mirror::ArtMethod::GetJavaLangReflectArtMethod();
+}
+
+static bool IsOnThreadStack(Thread* self, uintptr_t addr) {
+  uintptr_t stack_low = reinterpret_cast<uintptr_t>(self->GetStackEnd());
+  uintptr_t stack_high = stack_low + self->GetStackSize();
+  return stack_low <= addr && addr < stack_high;
+}
+
+#if defined(ART_IMPLICIT_NULL_CHECKS) || defined(ART_IMPLICIT_SUSPEND_CHECKS)
+// Returns whether the mapping table has a safepoint at native_pc_offset.
+static bool HasSafepoint(const mirror::ArtMethod* method, uint32_t native_pc_offset)
+    SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
+  MappingTable table(method->GetMappingTable());
+  if (table.TotalSize() == 0) {
+    return false;
+  }
+  typedef MappingTable::PcToDexIterator It;
+  for (It cur = table.PcToDexBegin(), end = table.PcToDexEnd(); cur != end; ++cur) {
+    if (cur.NativePcOffset() == native_pc_offset) {
+      return true;
+    }
+  }
+  return false;
+}
+#endif
+
+#endif  // ART_IMPLICIT_STACK_OVERFLOW_CHECKS
+
+void FaultManager::Init() {
+#if defined(ART_IMPLICIT_STACK_OVERFLOW_CHECKS)
+  if (initialized_) {
+    return;
+  }
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  sigemptyset(&action.sa_mask);
+  action.sa_sigaction = HandleFault;
+  action.sa_flags = SA_SIGINFO | SA_ONSTACK;
+  CHECK_EQ(sigaction(SIGSEGV, &action, &old_action_), 0);
+  initialized_ = true;
+#endif
+}
+
+void FaultManager::HandleFault(int signal_number, siginfo_t* info, void* raw_context) {
+  if (HandleNullPointerFault(info, raw_context) || HandleStackOverflowFault(info, raw_context) ||
+      HandleSuspendFault(info, raw_context)) {
+    return;
+  }
+  // Not an implicit check, hand the fault on as if this handler had never been installed.
+  if ((old_action_.sa_flags & SA_SIGINFO) != 0) {
+    old_action_.sa_sigaction(signal_number, info, raw_context);
+  } else if (old_action_.sa_handler == SIG_DFL || old_action_.sa_handler == SIG_IGN) {
+    // Returning retries the access, which faults again and now takes the default action.
+    signal(SIGSEGV, SIG_DFL);
+  } else {
+    old_action_.sa_handler(signal_number);
+  }
+}
+
+bool FaultManager::HandleNullPointerFault(siginfo_t* info, void* raw_context) {
+#if defined(ART_IMPLICIT_NULL_CHECKS)
+  if (reinterpret_cast<uintptr_t>(info->si_addr) >= kPageSize) {
+    return false;
+  }
+  // Compiled code only runs in runnable threads, which share the mutator lock.
+  Thread* self = Thread::Current();
+  if (self == NULL || self->GetState() != kRunnable) {
+    return false;
+  }
+  MachineContext& context = reinterpret_cast<KernelUContext*>(raw_context)->uc_mcontext;
+  uintptr_t pc = context.arm_pc;
+  uintptr_t sp = context.arm_sp;
+  if ((context.arm_cpsr & kCpsrThumbBit) == 0 || !IsOnThreadStack(self, sp)) {
+    return false;
+  }
+  // Field accesses only happen after the prologue, which stores the method at the stack pointer.
+  const mirror::ArtMethod* method = *reinterpret_cast<mirror::ArtMethod**>(sp);
+  if (!IsMethod(method) || method->IsNative() || method->IsRuntimeMethod() ||
+      method->IsProxyMethod()) {
+    return false;
+  }
+  // The code the frame runs, which isn't the entry point while instrumentation stubs are in use.
+  const void* code = Runtime::Current()->GetInstrumentation()->GetQuickCodeFor(method);
+  uintptr_t code_begin = reinterpret_cast<uintptr_t>(code) & ~static_cast<uintptr_t>(1);
+  if (code_begin == 0 || pc < code_begin ||
+      pc >= code_begin + reinterpret_cast<const uint32_t*>(code_begin)[-1]) {
+    return false;
+  }
+  uintptr_t return_pc = pc + ThumbInstructionSize(*reinterpret_cast<const uint16_t*>(pc));
+  if (!HasSafepoint(method, return_pc - code_begin)) {
+    return false;
+  }
+  // Call the entrypoint as the explicit check's launchpad would have, from the safepoint after the
+  // access. It saves the callee saves like any runtime call, so the stack walks as usual.
+  context.arm_lr = return_pc | 1;
+  SetPcToEntrypoint(context,
+                    reinterpret_cast<uintptr_t>(art_quick_throw_null_pointer_exception));
+  return true;
+#else
+  UNUSED(info);
+  UNUSED(raw_context);
+  return false;
+#endif
+}
+
+bool FaultManager::HandleStackOverflowFault(siginfo_t* info, void* raw_context) {
+#if defined(ART_IMPLICIT_STACK_OVERFLOW_CHECKS)
+  Thread* self = Thread::Current();
+  if (self == NULL || self->GetState() != kRunnable) {
+    return false;
+  }
+  MachineContext& context = reinterpret_cast<KernelUContext*>(raw_context)->uc_mcontext;
+  uintptr_t pc = GetPc(context);
+  uintptr_t sp = GetSp(context);
+  if (reinterpret_cast<uintptr_t>(info->si_addr) != sp - Thread::kStackOverflowProbeBytes ||
+      !IsOnThreadStack(self, sp)) {
+    return false;
+  }
+  // The probe comes before the prologue stores anything, while the method is still in the first
+  // argument register.
+  const mirror::ArtMethod* method = reinterpret_cast<const mirror::ArtMethod*>(GetArg0(context));
+  if (!IsMethod(method) || method->IsNative() || method->IsRuntimeMethod() ||
+      method->IsProxyMethod()) {
+    return false;
+  }
+  const void* code = Runtime::Current()->GetInstrumentation()->GetQuickCodeFor(method);
+  uintptr_t code_begin = reinterpret_cast<uintptr_t>(code) & ~static_cast<uintptr_t>(1);
+  if (code_begin == 0 || pc < code_begin || pc - code_begin > kMaxStackProbeOffset) {
+    return false;
+  }
+  size_t probe_size = StackProbeSize(pc);
+  if (probe_size == 0) {
+    return false;
+  }
+  if (self->IsHandlingStackOverflow()) {
+    // Building the StackOverflowError runs compiled code below the probes' limit. Let it use the
+    // reserved space as the explicit checks do, as long as any frame still fits above the
+    // protected region, which is now the stack end.
+    if (sp < reinterpret_cast<uintptr_t>(self->GetStackEnd()) +
+        Thread::kStackOverflowProtectedBytes) {
+      return false;
+    }
+    SetPc(context, pc + probe_size);
+    return true;
+  }
+  // Nothing has been pushed, so this throws from the caller, as the explicit check's launchpad
+  // does after popping the frame.
+  SetPcToEntrypoint(context, reinterpret_cast<uintptr_t>(art_quick_throw_stack_overflow));
+  return true;
+#else
+  UNUSED(info);
+  UNUSED(raw_context);
+  return false;
+#endif
+}
+
+bool FaultManager::HandleSuspendFault(siginfo_t* info, void* raw_context) {
+#if defined(ART_IMPLICIT_SUSPEND_CHECKS)
+  const byte* fault_addr = reinterpret_cast<const byte*>(info->si_addr);
+  const byte* trigger_page = Thread::GetSuspendTriggerPage();
+  if (fault_addr < trigger_page || fault_addr >= trigger_page + kPageSize) {
+    return false;
+  }
+  Thread* self = Thread::Current();
+  if (self == NULL || self->GetState() != kRunnable) {
+    return false;
+  }
+  MachineContext& context = reinterpret_cast<KernelUContext*>(raw_context)->uc_mcontext;
+  uintptr_t pc = GetPc(context);
+  uintptr_t sp = GetSp(context);
+  if (!IsOnThreadStack(self, sp)) {
+    return false;
+  }
+  // Polls only happen after the prologue, which stores the method at the stack pointer.
+  const mirror::ArtMethod* method = *reinterpret_cast<mirror::ArtMethod**>(sp);
+  if (!IsMethod(method) || method->IsNative() || method->IsRuntimeMethod() ||
+      method->IsProxyMethod()) {
+    return false;
+  }
+  const void* code = Runtime::Current()->GetInstrumentation()->GetQuickCodeFor(method);
+  uintptr_t code_begin = reinterpret_cast<uintptr_t>(code);
+  if (code_begin == 0 || pc < code_begin ||
+      pc >= code_begin + reinterpret_cast<const uint32_t*>(code_begin)[-1]) {
+    return false;
+  }
+  size_t poll_size = X86SuspendPollSize(reinterpret_cast<const uint8_t*>(pc));
+  uintptr_t return_pc = pc + poll_size;
+  if (poll_size == 0 || !HasSafepoint(method, return_pc - code_begin)) {
+    return false;
+  }
+  // A request cleared since the poll page was last switched leaves nothing to do.
+  self->UpdateSuspendPollPage();
+  if (!self->TestAllFlags()) {
+    SetPc(context, return_pc);
+    return true;
+  }
+  // Push the safepoint as the return address, as the explicit check's launchpad would call from
+  // there. The entrypoint saves the callee saves, the poll has already flushed everything else.
+  sp -= sizeof(uintptr_t);
+  *reinterpret_cast<uintptr_t*>(sp) = return_pc;
+  SetSp(context, sp);
+  SetPcToEntrypoint(context, reinterpret_cast<uintptr_t>(art_quick_test_suspend));
+  return true;
+#else
+  UNUSED(info);
+  UNUSED(raw_context);
+  return false;
+#endif
+}
+
+}  // namespace art
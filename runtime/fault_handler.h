@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ART_RUNTIME_FAULT_HANDLER_H_
+#define ART_RUNTIME_FAULT_HANDLER_H_
+
+#include <signal.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "base/macros.h"
+
+namespace art {
+
+// Turns the faults of field accesses through null references in compiled code into
+// NullPointerExceptions. On Thumb2 the compiler leaves out the explicit null check of a field
+// access whose offset is within the unmapped first page. Instead it records the pc after the
+// access as a safepoint for the access's dex pc, see Mir2Lir::UseImplicitNullCheck. When such an
+// access faults, the handler makes the method appear to call the NullPointerException entrypoint
+// from that safepoint.
+//
+// It also turns the faults of stack probes into StackOverflowErrors. Rather than comparing the
+// stack pointer with the stack end, a method's first instruction loads from
+// Thread::kStackOverflowProbeBytes below it, which faults in the protected region at the bottom
+// of the stack before the stack overflows. Nothing has been pushed yet, so the handler makes the
+// caller appear to call the StackOverflowError entrypoint.
+//
+// On x86 suspend checks are loads from Thread::suspend_poll_page_, which points at an
+// inaccessible page while a suspend or checkpoint request is pending. The handler makes the
+// method appear to call the suspend check entrypoint from the safepoint after the load. Every
+// other fault goes on to the handler installed before, which dumps it.
+class FaultManager {
+ public:
+  // Installs the SIGSEGV handler, on the targets the compiler emits implicit checks for.
+  static void Init();
+
+  // Returns the size in bytes of the Thumb2 instruction with the given first halfword.
+  static size_t ThumbInstructionSize(uint16_t first_halfword) {
+    // 32-bit encodings start with 0b11101, 0b11110 or 0b11111.
+    return ((first_halfword & 0xe000) == 0xe000 && (first_halfword & 0x1800) != 0) ? 4 : 2;
+  }
+
+  // Returns the size in bytes of the x86 stack probe, cmp r32, [esp + disp32], at code, or 0 if
+  // the code is something else.
+  static size_t X86StackProbeSize(const uint8_t* code) {
+    return (code[0] == 0x3b && (code[1] & 0xc7) == 0x84 && code[2] == 0x24) ? 7 : 0;
+  }
+
+  // Returns the size in bytes of the x86 suspend poll, mov r32, [r32], at code, or 0 if the code
+  // is something else. The register is one of the temps, eax to ebx.
+  static size_t X86SuspendPollSize(const uint8_t* code) {
+    return (code[0] == 0x8b && (code[1] & 0xc4) == 0) ? 2 : 0;
+  }
+
+ private:
+  static void HandleFault(int signal_number, siginfo_t* info, void* raw_context);
+
+  // Returns whether the fault was an implicit null check, and if so redirects the context to
+  // throw the NullPointerException.
+  static bool HandleNullPointerFault(siginfo_t* info, void* raw_context)
+      NO_THREAD_SAFETY_ANALYSIS;
+
+  // Returns whether the fault was a stack probe, and if so redirects the context to throw the
+  // StackOverflowError, or to skip the probe while the error is being thrown.
+  static bool HandleStackOverflowFault(siginfo_t* info, void* raw_context)
+      NO_THREAD_SAFETY_ANALYSIS;
+
+  // Returns whether the fault was a suspend poll, and if so redirects the context to call the
+  // suspend check entrypoint, or to skip the poll if the request has gone.
+  static bool HandleSuspendFault(siginfo_t* info, void* raw_context) NO_THREAD_SAFETY_ANALYSIS;
+
+  static struct sigaction old_action_;
+  static bool initialized_;
+
+  DISALLOW_IMPLICIT_CONSTRUCTORS(FaultManager);
+};
+
+}  // namespace art
+
+#endif  // ART_RUNTIME_FAULT_HANDLER_H_
@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "fault_handler.h"
+
+#include "gtest/gtest.h"
+
+namespace art {
+
+TEST(FaultHandlerTest, ThumbInstructionSize) {
+  EXPECT_EQ(2U, FaultManager::ThumbInstructionSize(0x6808));  // ldr r0, [r1, #0]
+  EXPECT_EQ(2U, FaultManager::ThumbInstructionSize(0x6048));  // str r0, [r1, #4]
+  EXPECT_EQ(2U, FaultManager::ThumbInstructionSize(0xe7fe));  // b .
+  EXPECT_EQ(4U, FaultManager::ThumbInstructionSize(0xf8d1));  // ldr.w r0, [r1, #imm12]
+  EXPECT_EQ(4U, FaultManager::ThumbInstructionSize(0xf8c1));  // str.w r0, [r1, #imm12]
+  EXPECT_EQ(4U, FaultManager::ThumbInstructionSize(0xed91));  // vldr s0, [r1, #imm8]
+  EXPECT_EQ(4U, FaultManager::ThumbInstructionSize(0xe9d1));  // ldrd r0, r1, [r1]
+}
+
+TEST(FaultHandlerTest, X86StackProbeSize) {
+  const uint8_t kProbe[] = { 0x3b, 0x84, 0x24, 0x00, 0xb0, 0xff, 0xff };  // cmp eax, [esp - 20K]
+  EXPECT_EQ(sizeof(kProbe), FaultManager::X86StackProbeSize(kProbe));
+  const uint8_t kLoad[] = { 0x8b, 0x84, 0x24, 0x00, 0xb0, 0xff, 0xff };  // mov eax, [esp - 20K]
+  EXPECT_EQ(0U, FaultManager::X86StackProbeSize(kLoad));
+  const uint8_t kCmpEbp[] = { 0x3b, 0x85, 0x00, 0xb0, 0xff, 0xff };  // cmp eax, [ebp - 20K]
+  EXPECT_EQ(0U, FaultManager::X86StackProbeSize(kCmpEbp));
+}
+
+TEST(FaultHandlerTest, X86SuspendPollSize) {
+  const uint8_t kPollEax[] = { 0x8b, 0x00 };  // mov eax, [eax]
+  EXPECT_EQ(sizeof(kPollEax), FaultManager::X86SuspendPollSize(kPollEax));
+  const uint8_t kPollEbx[] = { 0x8b, 0x1b };  // mov ebx, [ebx]
+  EXPECT_EQ(sizeof(kPollEbx), FaultManager::X86SuspendPollSize(kPollEbx));
+  const uint8_t kLoadDisp[] = { 0x8b, 0x40, 0x08 };  // mov eax, [eax + 8]
+  EXPECT_EQ(0U, FaultManager::X86SuspendPollSize(kLoadDisp));
+  const uint8_t kLoadEsp[] = { 0x8b, 0x04, 0x24 };  // mov eax, [esp]
+  EXPECT_EQ(0U, FaultManager::X86SuspendPollSize(kLoadEsp));
+}
+
+}  // namespace art
@@ -48,6 +48,7 @@ class AtomicStack {
     front_index_ = 0;
     back_index_ = 0;
     debug_is_sorted_ = true;
+    ++layout_version_;
     int result = madvise(begin_, sizeof(T) * capacity_, MADV_DONTNEED);
     if (result == -1) {
       PLOG(WARNING) << "madvise failed";
@@ -73,6 +74,35 @@ class AtomicStack {
     return true;
   }
 
+  // Atomically claims num_slots consecutive slots, returned as [*start_address, *end_address), for
+  // the caller to fill without further synchronization. Slots are NULL until filled, and any left
+  // unfilled stay NULL, so users of a stack claimed from this way must skip NULL entries. Returns
+  // false if there aren't enough free slots.
+  bool AtomicBumpBack(size_t num_slots, T** start_address, T** end_address) {
+    if (kIsDebugBuild) {
+      debug_is_sorted_ = false;
+    }
+    int32_t index;
+    int32_t new_index;
+    do {
+      index = back_index_;
+      new_index = index + num_slots;
+      if (UNLIKELY(static_cast<size_t>(new_index) > capacity_)) {
+        // Stack overflow.
+        return false;
+      }
+    } while (!back_index_.compare_and_swap(index, new_index));
+    *start_address = &begin_[index];
+    *end_address = &begin_[new_index];
+    if (kIsDebugBuild) {
+      // Reset zeroes the stack, so claimed slots must not have been written yet.
+      for (int32_t i = index; i < new_index; ++i) {
+        DCHECK(begin_[i] == NULL) << "i=" << i << " index=" << index << " new_index=" << new_index;
+      }
+    }
+    return true;
+  }
+
   void PushBack(const T& value) {
     if (kIsDebugBuild) {
       debug_is_sorted_ = false;
@@ -135,6 +165,7 @@ class AtomicStack {
     int32_t start_back_index = back_index_.load();
     int32_t start_front_index = front_index_.load();
     std::sort(Begin(), End());
+    ++layout_version_;
     CHECK_EQ(start_back_index, back_index_.load());
     CHECK_EQ(start_front_index, front_index_.load());
     if (kIsDebugBuild) {
@@ -151,6 +182,12 @@ class AtomicStack {
     return std::find(Begin(), End(), value) != End();
   }
 
+  // Changes whenever Reset or Sort drop or move entries, so that a summary of the entries up to
+  // some index can tell that it is stale.
+  size_t GetLayoutVersion() const {
+    return layout_version_;
+  }
+
  private:
   AtomicStack(const std::string& name, const size_t capacity)
       : name_(name),
@@ -158,7 +195,8 @@ class AtomicStack {
         front_index_(0),
         begin_(NULL),
         capacity_(capacity),
-        debug_is_sorted_(true) {
+        debug_is_sorted_(true),
+        layout_version_(0) {
   }
 
   // Size in number of elements.
@@ -193,6 +231,9 @@ class AtomicStack {
   // Whether or not the stack is sorted, only updated in debug mode to avoid performance overhead.
   bool debug_is_sorted_;
 
+  // See GetLayoutVersion.
+  size_t layout_version_;
+
   DISALLOW_COPY_AND_ASSIGN(AtomicStack);
 };
 
@@ -41,6 +41,18 @@ static inline bool byte_cas(byte old_value, byte new_value, byte* address) {
   return success;
 }
 
+template <typename Visitor>
+inline void CardTable::AddCardToRun(SpaceBitmap* bitmap, uintptr_t start, const Visitor& visitor,
+                                    uintptr_t* run_begin, uintptr_t* run_end) {
+  if (start != *run_end) {
+    if (*run_begin != *run_end) {
+      bitmap->VisitMarkedRange(*run_begin, *run_end, visitor);
+    }
+    *run_begin = start;
+  }
+  *run_end = start + kCardSize;
+}
+
 template <typename Visitor>
 inline size_t CardTable::Scan(SpaceBitmap* bitmap, byte* scan_begin, byte* scan_end,
                               const Visitor& visitor, const byte minimum_age) const {
@@ -51,12 +63,16 @@ inline size_t CardTable::Scan(SpaceBitmap* bitmap, byte* scan_begin, byte* scan_
   CheckCardValid(card_cur);
   CheckCardValid(card_end);
   size_t cards_scanned = 0;
+  // The cards to scan that have been found but not visited yet. Dirty cards tend to come in
+  // runs, and one bitmap walk over a run costs less than a walk per card.
+  uintptr_t run_begin = 0;
+  uintptr_t run_end = 0;
 
   // Handle any unaligned cards at the start.
   while (!IsAligned<sizeof(word)>(card_cur) && card_cur < card_end) {
     if (*card_cur >= minimum_age) {
       uintptr_t start = reinterpret_cast<uintptr_t>(AddrFromCard(card_cur));
-      bitmap->VisitMarkedRange(start, start + kCardSize, visitor);
+      AddCardToRun(bitmap, start, visitor, &run_begin, &run_end);
       ++cards_scanned;
     }
     ++card_cur;
@@ -78,14 +94,12 @@ inline size_t CardTable::Scan(SpaceBitmap* bitmap, byte* scan_begin, byte* scan_
     // Find the first dirty card.
     uintptr_t start_word = *word_cur;
     uintptr_t start = reinterpret_cast<uintptr_t>(AddrFromCard(reinterpret_cast<byte*>(word_cur)));
-    // TODO: Investigate if processing continuous runs of dirty cards with a single bitmap visit is
-    // more efficient.
     for (size_t i = 0; i < sizeof(uintptr_t); ++i) {
       if (static_cast<byte>(start_word) >= minimum_age) {
         auto* card = reinterpret_cast<byte*>(word_cur) + i;
         DCHECK(*card == static_cast<byte>(start_word) || *card == kCardDirty)
             << "card " << static_cast<size_t>(*card) << " word " << (start_word & 0xFF);
-        bitmap->VisitMarkedRange(start, start + kCardSize, visitor);
+        AddCardToRun(bitmap, start, visitor, &run_begin, &run_end);
         ++cards_scanned;
       }
       start_word >>= 8;
@@ -99,12 +113,15 @@ inline size_t CardTable::Scan(SpaceBitmap* bitmap, byte* scan_begin, byte* scan_
   while (card_cur < card_end) {
     if (*card_cur >= minimum_age) {
       uintptr_t start = reinterpret_cast<uintptr_t>(AddrFromCard(card_cur));
-      bitmap->VisitMarkedRange(start, start + kCardSize, visitor);
+      AddCardToRun(bitmap, start, visitor, &run_begin, &run_end);
       ++cards_scanned;
     }
     ++card_cur;
   }
 
+  if (run_begin != run_end) {
+    bitmap->VisitMarkedRange(run_begin, run_end, visitor);
+  }
   return cards_scanned;
 }
 
@@ -146,7 +163,7 @@ inline void CardTable::ModifyCardsAtomic(byte* scan_begin, byte* scan_end, const
       new_value = visitor(expected);
     } while (expected != new_value && UNLIKELY(!byte_cas(expected, new_value, card_end)));
     if (expected != new_value) {
-      modified(card_cur, expected, new_value);
+      modified(card_end, expected, new_value);
     }
   }
 
@@ -158,12 +175,15 @@ inline void CardTable::ModifyCardsAtomic(byte* scan_begin, byte* scan_end, const
 
   // TODO: Parallelize.
   while (word_cur < word_end) {
+    word_cur = SkipCleanCardWords(word_cur, word_end);
+    if (word_cur >= word_end) {
+      break;
+    }
     while ((expected_word = *word_cur) != 0) {
-      new_word =
-          (visitor((expected_word >> 0) & 0xFF) << 0) |
-          (visitor((expected_word >> 8) & 0xFF) << 8) |
-          (visitor((expected_word >> 16) & 0xFF) << 16) |
-          (visitor((expected_word >> 24) & 0xFF) << 24);
+      new_word = 0;
+      for (size_t i = 0; i < sizeof(uintptr_t); ++i) {
+        new_word |= static_cast<uintptr_t>(visitor((expected_word >> (8 * i)) & 0xFF)) << (8 * i);
+      }
       if (new_word == expected_word) {
         // No need to do a cas.
         break;
@@ -184,6 +204,47 @@ inline void CardTable::ModifyCardsAtomic(byte* scan_begin, byte* scan_end, const
   }
 }
 
+template <typename Visitor>
+inline void CardTable::VisitClear(const void* start, const void* end, const Visitor& visitor) {
+  byte* card_cur = CardFromAddr(start);
+  byte* card_end = CardFromAddr(end);
+  uintptr_t* word_end = reinterpret_cast<uintptr_t*>(
+      card_end - (reinterpret_cast<uintptr_t>(card_end) & (sizeof(uintptr_t) - 1)));
+  while (card_cur < card_end) {
+    if (IsAligned<sizeof(uintptr_t)>(card_cur)) {
+      // Skip whole words of clean cards.
+      card_cur = reinterpret_cast<byte*>(
+          SkipCleanCardWords(reinterpret_cast<uintptr_t*>(card_cur), word_end));
+      if (card_cur >= card_end) {
+        break;
+      }
+    }
+    if (*card_cur == kCardDirty) {
+      *card_cur = kCardClean;
+      visitor(card_cur);
+    }
+    ++card_cur;
+  }
+}
+
+inline uintptr_t* CardTable::SkipCleanCardWords(uintptr_t* word_cur, uintptr_t* word_end) {
+  // Check a block of words at a time, the compiler can turn this into vector compares.
+  while (word_cur + kCardBlockWords <= word_end) {
+    uintptr_t block = 0;
+    for (size_t i = 0; i < kCardBlockWords; ++i) {
+      block |= word_cur[i];
+    }
+    if (block != 0) {
+      break;
+    }
+    word_cur += kCardBlockWords;
+  }
+  while (word_cur < word_end && *word_cur == 0) {
+    ++word_cur;
+  }
+  return word_cur;
+}
+
 inline void* CardTable::AddrFromCard(const byte *card_addr) const {
   DCHECK(IsValidCard(card_addr))
     << " card_addr: " << reinterpret_cast<const void*>(card_addr)
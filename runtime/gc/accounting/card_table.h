@@ -49,6 +49,11 @@ class CardTable {
   static const size_t kCardSize = (1 << kCardShift);
   static const uint8_t kCardClean = 0x0;
   static const uint8_t kCardDirty = 0x70;
+  // A card dirtied during concurrent marking which the GC scanned again before its pause. Until
+  // the next GC ages it, it stands for the same writes as a dirty card.
+  static const uint8_t kCardPreCleaned = kCardDirty - 2;
+  // Number of words of cards which are checked together when skipping runs of clean cards.
+  static const size_t kCardBlockWords = 4;
 
   static CardTable* Create(const byte* heap_begin, size_t heap_capacity);
 
@@ -58,9 +63,10 @@ class CardTable {
     *card_addr = kCardDirty;
   }
 
-  // Is the object on a dirty card?
+  // Is the object on a card dirtied since the cards were last aged?
   bool IsDirty(const mirror::Object* obj) const {
-    return GetCard(obj) == kCardDirty;
+    byte card = GetCard(obj);
+    return card == kCardDirty || card == kCardPreCleaned;
   }
 
   // Return the state of the card at an address.
@@ -70,16 +76,7 @@ class CardTable {
 
   // Visit and clear cards within memory range, only visits dirty cards.
   template <typename Visitor>
-  void VisitClear(const void* start, const void* end, const Visitor& visitor) {
-    byte* card_start = CardFromAddr(start);
-    byte* card_end = CardFromAddr(end);
-    for (byte* it = card_start; it != card_end; ++it) {
-      if (*it == kCardDirty) {
-        *it = kCardClean;
-        visitor(it);
-      }
-    }
-  }
+  void VisitClear(const void* start, const void* end, const Visitor& visitor);
 
   // Returns a value that when added to a heap address >> GC_CARD_SHIFT will address the appropriate
   // card table byte. For convenience this value is cached in every Thread
@@ -94,13 +91,16 @@ class CardTable {
    * value.
    * modified: Whenever the visitor modifies a card, this visitor is called on the card. Enables
    * us to know which cards got cleared.
+   * The visitor must map clean cards to clean cards, runs of clean cards are skipped a block of
+   * words at a time without calling it.
    */
   template <typename Visitor, typename ModifiedVisitor>
   void ModifyCardsAtomic(byte* scan_begin, byte* scan_end, const Visitor& visitor,
                          const ModifiedVisitor& modified);
 
   // For every dirty at least minumum age between begin and end invoke the visitor with the
-  // specified argument. Returns how many cards the visitor was run on.
+  // specified argument. Returns how many cards the visitor was run on. Runs of consecutive cards
+  // are visited with a single bitmap walk.
   template <typename Visitor>
   size_t Scan(SpaceBitmap* bitmap, byte* scan_begin, byte* scan_end, const Visitor& visitor,
               const byte minimum_age = kCardDirty) const
@@ -136,6 +136,17 @@ class CardTable {
 
   void CheckCardValid(byte* card) const ALWAYS_INLINE;
 
+  // Adds the card starting at 'start' to the run of cards [*run_begin, *run_end) that Scan visits,
+  // first visiting the run if the card doesn't extend it.
+  template <typename Visitor>
+  static void AddCardToRun(SpaceBitmap* bitmap, uintptr_t start, const Visitor& visitor,
+                           uintptr_t* run_begin, uintptr_t* run_end)
+      EXCLUSIVE_LOCKS_REQUIRED(Locks::heap_bitmap_lock_)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) ALWAYS_INLINE;
+
+  // Returns the first word in [word_cur, word_end) which has a non clean card, or word_end.
+  static uintptr_t* SkipCleanCardWords(uintptr_t* word_cur, uintptr_t* word_end) ALWAYS_INLINE;
+
   // Verifies that all gray objects are on a dirty card.
   void VerifyCardTable();
 
@@ -0,0 +1,223 @@
+/*
+ * Copyright (C) 2012 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "card_table.h"
+
+#include "card_table-inl.h"
+#include "common_test.h"
+#include "gc/accounting/space_bitmap-inl.h"
+#include "gc/heap.h"
+#include "globals.h"
+#include "UniquePtr.h"
+#include "utils.h"
+
+#include <stdint.h>
+#include <vector>
+
+namespace art {
+namespace gc {
+namespace accounting {
+
+class CardTableTest : public CommonTest {
+ public:
+};
+
+static byte* const kHeapBegin = reinterpret_cast<byte*>(0x10000000);
+static const size_t kHeapCapacity = 16 * MB;
+static const byte kClean = CardTable::kCardClean;
+
+class RecordModifiedVisitor {
+ public:
+  explicit RecordModifiedVisitor(std::vector<byte*>* cards) : cards_(cards) {}
+
+  void operator()(byte* card, byte expected_value, byte new_value) const {
+    EXPECT_NE(expected_value, new_value);
+    cards_->push_back(card);
+  }
+
+ private:
+  std::vector<byte*>* const cards_;
+};
+
+class RecordClearedVisitor {
+ public:
+  explicit RecordClearedVisitor(std::vector<byte*>* cards) : cards_(cards) {}
+
+  void operator()(byte* card) const {
+    cards_->push_back(card);
+  }
+
+ private:
+  std::vector<byte*>* const cards_;
+};
+
+TEST_F(CardTableTest, ModifyCardsAtomic) {
+  UniquePtr<CardTable> card_table(CardTable::Create(kHeapBegin, kHeapCapacity));
+  ASSERT_TRUE(card_table.get() != NULL);
+  // Use an unaligned range so that both the byte and the word paths are taken.
+  byte* begin = kHeapBegin + 3 * CardTable::kCardSize;
+  byte* end = kHeapBegin + kHeapCapacity - 5 * CardTable::kCardSize;
+  // Dirty a few isolated cards, a run of cards, and some cards which are one GC old.
+  std::vector<byte*> dirty;
+  std::vector<byte*> aged;
+  dirty.push_back(begin);
+  dirty.push_back(end - CardTable::kCardSize);
+  for (size_t i = 0; i < 100; ++i) {
+    dirty.push_back(begin + (1000 + i) * CardTable::kCardSize);
+  }
+  aged.push_back(begin + 77777 * CardTable::kCardSize);
+  aged.push_back(begin + 5 * CardTable::kCardSize);
+  for (byte* addr : dirty) {
+    card_table->MarkCard(addr);
+  }
+  for (byte* addr : aged) {
+    *card_table->CardFromAddr(addr) = CardTable::kCardDirty - 1;
+  }
+
+  std::vector<byte*> modified;
+  card_table->ModifyCardsAtomic(begin, end, AgeCardVisitor(), RecordModifiedVisitor(&modified));
+  EXPECT_EQ(dirty.size() + aged.size(), modified.size());
+  for (byte* addr : dirty) {
+    EXPECT_EQ(CardTable::kCardDirty - 1, *card_table->CardFromAddr(addr));
+  }
+  for (byte* addr : aged) {
+    EXPECT_EQ(kClean, *card_table->CardFromAddr(addr));
+  }
+  for (byte* card : modified) {
+    byte* addr = reinterpret_cast<byte*>(card_table->AddrFromCard(card));
+    EXPECT_TRUE(addr >= begin && addr < end);
+  }
+}
+
+TEST_F(CardTableTest, PreCleanedCards) {
+  UniquePtr<CardTable> card_table(CardTable::Create(kHeapBegin, kHeapCapacity));
+  ASSERT_TRUE(card_table.get() != NULL);
+  byte* begin = kHeapBegin;
+  byte* end = kHeapBegin + kHeapCapacity;
+  byte* dirty = begin + 10 * CardTable::kCardSize;
+  byte* aged = begin + 20 * CardTable::kCardSize;
+  card_table->MarkCard(dirty);
+  *card_table->CardFromAddr(aged) = CardTable::kCardDirty - 1;
+
+  // Pre-cleaning only changes dirty cards, which still count as dirty afterwards.
+  std::vector<byte*> modified;
+  card_table->ModifyCardsAtomic(begin, end, PreCleanCardVisitor(),
+                                RecordModifiedVisitor(&modified));
+  ASSERT_EQ(1U, modified.size());
+  EXPECT_EQ(card_table->CardFromAddr(dirty), modified[0]);
+  EXPECT_EQ(static_cast<byte>(CardTable::kCardPreCleaned), *card_table->CardFromAddr(dirty));
+  EXPECT_TRUE(card_table->IsDirty(reinterpret_cast<mirror::Object*>(dirty)));
+  EXPECT_EQ(CardTable::kCardDirty - 1, *card_table->CardFromAddr(aged));
+
+  // The next GC ages pre-cleaned cards like dirty ones.
+  card_table->ModifyCardsAtomic(begin, end, AgeCardVisitor(), VoidFunctor());
+  EXPECT_EQ(CardTable::kCardDirty - 1, *card_table->CardFromAddr(dirty));
+  EXPECT_EQ(kClean, *card_table->CardFromAddr(aged));
+}
+
+TEST_F(CardTableTest, VisitClear) {
+  UniquePtr<CardTable> card_table(CardTable::Create(kHeapBegin, kHeapCapacity));
+  ASSERT_TRUE(card_table.get() != NULL);
+  byte* begin = kHeapBegin + CardTable::kCardSize;
+  byte* end = kHeapBegin + kHeapCapacity - 3 * CardTable::kCardSize;
+  std::vector<byte*> dirty;
+  for (size_t i = 0; i < 64; ++i) {
+    dirty.push_back(begin + i * 97 * CardTable::kCardSize);
+  }
+  for (byte* addr : dirty) {
+    card_table->MarkCard(addr);
+  }
+  // Aged cards are not visited or cleared.
+  byte* aged = begin + 2 * CardTable::kCardSize;
+  *card_table->CardFromAddr(aged) = CardTable::kCardDirty - 1;
+
+  std::vector<byte*> cleared;
+  card_table->VisitClear(begin, end, RecordClearedVisitor(&cleared));
+  ASSERT_EQ(dirty.size(), cleared.size());
+  for (size_t i = 0; i < dirty.size(); ++i) {
+    EXPECT_EQ(card_table->CardFromAddr(dirty[i]), cleared[i]);
+    EXPECT_EQ(kClean, *cleared[i]);
+  }
+  EXPECT_EQ(CardTable::kCardDirty - 1, *card_table->CardFromAddr(aged));
+}
+
+class CollectVisitor {
+ public:
+  explicit CollectVisitor(std::vector<const mirror::Object*>* objects) : objects_(objects) {}
+
+  void operator()(const mirror::Object* obj) const {
+    objects_->push_back(obj);
+  }
+
+ private:
+  std::vector<const mirror::Object*>* const objects_;
+};
+
+TEST_F(CardTableTest, Scan) {
+  UniquePtr<CardTable> card_table(CardTable::Create(kHeapBegin, kHeapCapacity));
+  ASSERT_TRUE(card_table.get() != NULL);
+  UniquePtr<SpaceBitmap> bitmap(SpaceBitmap::Create("test bitmap", kHeapBegin, kHeapCapacity));
+  ASSERT_TRUE(bitmap.get() != NULL);
+  // A run of dirty cards, visited with one bitmap walk, an aged card and a clean card.
+  std::vector<const mirror::Object*> dirty_objects;
+  for (size_t i = 10; i < 30; ++i) {
+    byte* card_begin = kHeapBegin + i * CardTable::kCardSize;
+    card_table->MarkCard(card_begin);
+    dirty_objects.push_back(reinterpret_cast<mirror::Object*>(card_begin));
+    dirty_objects.push_back(reinterpret_cast<mirror::Object*>(card_begin + 64));
+  }
+  byte* aged = kHeapBegin + 40 * CardTable::kCardSize;
+  *card_table->CardFromAddr(aged) = CardTable::kCardDirty - 1;
+  byte* clean = kHeapBegin + 50 * CardTable::kCardSize;
+  for (const mirror::Object* obj : dirty_objects) {
+    bitmap->Set(obj);
+  }
+  bitmap->Set(reinterpret_cast<mirror::Object*>(aged + 8));
+  bitmap->Set(reinterpret_cast<mirror::Object*>(clean));
+
+  byte* end = kHeapBegin + kHeapCapacity;
+  std::vector<const mirror::Object*> visited;
+  EXPECT_EQ(20U, card_table->Scan(bitmap.get(), kHeapBegin, end, CollectVisitor(&visited)));
+  EXPECT_TRUE(visited == dirty_objects);
+
+  // Starting on an unaligned card takes the byte path for the first cards of the run.
+  visited.clear();
+  EXPECT_EQ(21U, card_table->Scan(bitmap.get(), kHeapBegin + 11 * CardTable::kCardSize, end,
+                                  CollectVisitor(&visited), CardTable::kCardDirty - 1));
+  std::vector<const mirror::Object*> expected(dirty_objects.begin() + 2, dirty_objects.end());
+  expected.push_back(reinterpret_cast<mirror::Object*>(aged + 8));
+  EXPECT_TRUE(visited == expected);
+}
+
+// Aging a sparse set of dirty cards, as every GC does for each space, over repeated GCs.
+TEST_F(CardTableTest, AgeSparseCards) {
+  UniquePtr<CardTable> card_table(CardTable::Create(kHeapBegin, kHeapCapacity));
+  ASSERT_TRUE(card_table.get() != NULL);
+  byte* end = kHeapBegin + kHeapCapacity;
+  for (size_t i = 0; i < 2; ++i) {
+    // Dirty one card in every 64 to model a sparse remembered set.
+    for (byte* addr = kHeapBegin; addr < end; addr += 64 * CardTable::kCardSize) {
+      card_table->MarkCard(addr);
+    }
+    card_table->ModifyCardsAtomic(kHeapBegin, end, AgeCardVisitor(), VoidFunctor());
+  }
+  EXPECT_EQ(CardTable::kCardDirty - 1, *card_table->CardFromAddr(kHeapBegin));
+  EXPECT_EQ(kClean, *card_table->CardFromAddr(kHeapBegin + CardTable::kCardSize));
+}
+
+}  // namespace accounting
+}  // namespace gc
+}  // namespace art
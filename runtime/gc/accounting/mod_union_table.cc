@@ -16,6 +16,8 @@
 
 #include "mod_union_table.h"
 
+#include <algorithm>
+
 #include "base/stl_util.h"
 #include "card_table-inl.h"
 #include "heap_bitmap.h"
@@ -43,7 +45,7 @@ class ModUnionClearCardSetVisitor {
   }
 
   inline void operator()(byte* card, byte expected_value, byte new_value) const {
-    if (expected_value == CardTable::kCardDirty) {
+    if (expected_value == CardTable::kCardDirty || expected_value == CardTable::kCardPreCleaned) {
       cleared_cards_->insert(card);
     }
   }
@@ -59,7 +61,7 @@ class ModUnionClearCardVisitor {
   }
 
   void operator()(byte* card, byte expected_card, byte new_card) const {
-    if (expected_card == CardTable::kCardDirty) {
+    if (expected_card == CardTable::kCardDirty || expected_card == CardTable::kCardPreCleaned) {
       cleared_cards_->push_back(card);
     }
   }
@@ -186,21 +188,90 @@ class ModUnionCheckReferences {
   const std::set<const Object*>& references_;
 };
 
+// A reference is encoded as the difference, in object alignment units, from the previous one of
+// its card, seven bits a byte with the top bit set on all but the last byte.
+static void EncodeDelta(uintptr_t delta, std::vector<uint8_t, GCAllocator<uint8_t> >* data) {
+  while (delta >= 0x80) {
+    data->push_back(static_cast<uint8_t>(delta) | 0x80);
+    delta >>= 7;
+  }
+  data->push_back(static_cast<uint8_t>(delta));
+}
+
+static uintptr_t DecodeDelta(const uint8_t** data) {
+  const uint8_t* ptr = *data;
+  uintptr_t delta = 0;
+  size_t shift = 0;
+  uint8_t byte;
+  do {
+    byte = *ptr++;
+    delta |= static_cast<uintptr_t>(byte & 0x7f) << shift;
+    shift += 7;
+  } while ((byte & 0x80) != 0);
+  *data = ptr;
+  return delta;
+}
+
+ModUnionTableReferenceCache::CardReferences ModUnionTableReferenceCache::EncodeReferences(
+    const byte* card, std::vector<const Object*>* references) {
+  std::sort(references->begin(), references->end());
+  references->erase(std::unique(references->begin(), references->end()), references->end());
+  CardReferences card_references;
+  card_references.card = card;
+  card_references.offset = references_data_.size();
+  uintptr_t previous = 0;
+  for (const Object* ref : *references) {
+    uintptr_t address = reinterpret_cast<uintptr_t>(ref);
+    DCHECK_EQ(address % kObjectAlignment, 0U);
+    EncodeDelta((address - previous) / kObjectAlignment, &references_data_);
+    previous = address;
+  }
+  card_references.size = references_data_.size() - card_references.offset;
+  return card_references;
+}
+
+template <typename Visitor>
+inline void ModUnionTableReferenceCache::VisitReferences(const CardReferences& card_references,
+                                                         const Visitor& visitor) const {
+  const uint8_t* data = &references_data_[card_references.offset];
+  const uint8_t* end = data + card_references.size;
+  uintptr_t address = 0;
+  while (data < end) {
+    address += DecodeDelta(&data) * kObjectAlignment;
+    visitor(reinterpret_cast<const Object*>(address));
+  }
+}
+
+void ModUnionTableReferenceCache::Compact() {
+  std::vector<uint8_t, GCAllocator<uint8_t> > data;
+  data.reserve(references_data_.size() - garbage_bytes_);
+  for (CardReferences& card_references : card_references_) {
+    const uint8_t* begin = &references_data_[card_references.offset];
+    card_references.offset = data.size();
+    data.insert(data.end(), begin, begin + card_references.size);
+  }
+  references_data_.swap(data);
+  garbage_bytes_ = 0;
+}
+
 void ModUnionTableReferenceCache::Verify() {
   // Start by checking that everything in the mod union table is marked.
   Heap* heap = GetHeap();
-  for (const std::pair<const byte*, std::vector<const Object*> >& it : references_) {
-    for (const Object* ref : it.second) {
+  for (const CardReferences& card_references : card_references_) {
+    VisitReferences(card_references, [heap](const Object* ref) NO_THREAD_SAFETY_ANALYSIS {
       CHECK(heap->IsLiveObjectLocked(ref));
-    }
+    });
   }
 
   // Check the references of each clean card which is also in the mod union table.
   CardTable* card_table = heap->GetCardTable();
-  for (const std::pair<const byte*, std::vector<const Object*> > & it : references_) {
-    const byte* card = it.first;
+  for (const CardReferences& card_references : card_references_) {
+    const byte* card = card_references.card;
     if (*card == CardTable::kCardClean) {
-      std::set<const Object*> reference_set(it.second.begin(), it.second.end());
+      std::set<const Object*> reference_set;
+      VisitReferences(card_references, [&reference_set](const Object* ref) {
+        reference_set.insert(ref);
+      });
       ModUnionCheckReferences visitor(this, reference_set);
       uintptr_t start = reinterpret_cast<uintptr_t>(card_table->AddrFromCard(card));
       uintptr_t end = start + CardTable::kCardSize;
@@ -220,15 +291,15 @@ void ModUnionTableReferenceCache::Dump(std::ostream& os) {
     uintptr_t end = start + CardTable::kCardSize;
     os << reinterpret_cast<void*>(start) << "-" << reinterpret_cast<void*>(end) << ",";
   }
-  os << "]\nModUnionTable references: [";
-  for (const std::pair<const byte*, std::vector<const Object*> >& it : references_) {
-    const byte* card_addr = it.first;
-    uintptr_t start = reinterpret_cast<uintptr_t>(card_table->AddrFromCard(card_addr));
+  os << "]\nModUnionTable references (" << card_references_.size() << " cards in "
+     << references_data_.size() << " bytes): [";
+  for (const CardReferences& card_references : card_references_) {
+    uintptr_t start = reinterpret_cast<uintptr_t>(card_table->AddrFromCard(card_references.card));
     uintptr_t end = start + CardTable::kCardSize;
     os << reinterpret_cast<void*>(start) << "-" << reinterpret_cast<void*>(end) << "->{";
-    for (const mirror::Object* ref : it.second) {
+    VisitReferences(card_references, [&os](const Object* ref) {
       os << reinterpret_cast<const void*>(ref) << ",";
-    }
+    });
     os << "},";
   }
 }
@@ -240,8 +311,20 @@ void ModUnionTableReferenceCache::Update() {
   std::vector<const Object*> cards_references;
   ModUnionReferenceVisitor visitor(this, &cards_references);
 
+  // Both are sorted by card, merge the cleared cards into the cards with references.
+  std::vector<CardReferences, GCAllocator<CardReferences> > card_references;
+  card_references.reserve(card_references_.size());
+  auto old_it = card_references_.begin();
   for (const auto& card : cleared_cards_) {
-    // Clear and re-compute alloc space references associated with this card.
+    while (old_it != card_references_.end() && old_it->card < card) {
+      card_references.push_back(*old_it);
+      ++old_it;
+    }
+    if (old_it != card_references_.end() && old_it->card == card) {
+      garbage_bytes_ += old_it->size;
+      ++old_it;
+    }
+    // Re-compute alloc space references associated with this card.
     cards_references.clear();
     uintptr_t start = reinterpret_cast<uintptr_t>(card_table->AddrFromCard(card));
     uintptr_t end = start + CardTable::kCardSize;
@@ -249,30 +332,28 @@ void ModUnionTableReferenceCache::Update() {
     DCHECK(space != nullptr);
     SpaceBitmap* live_bitmap = space->GetLiveBitmap();
     live_bitmap->VisitMarkedRange(start, end, visitor);
-
-    // Update the corresponding references for the card.
-    auto found = references_.find(card);
-    if (found == references_.end()) {
-      if (cards_references.empty()) {
-        // No reason to add empty array.
-        continue;
-      }
-      references_.Put(card, cards_references);
-    } else {
-      found->second = cards_references;
+    // No reason to keep a card without references.
+    if (!cards_references.empty()) {
+      card_references.push_back(EncodeReferences(card, &cards_references));
     }
   }
+  card_references.insert(card_references.end(), old_it, card_references_.end());
+  card_references_.swap(card_references);
   cleared_cards_.clear();
+  if (garbage_bytes_ > references_data_.size() / 2) {
+    Compact();
+  }
 }
 
 void ModUnionTableReferenceCache::MarkReferences(collector::MarkSweep* mark_sweep) {
   size_t count = 0;
 
-  for (const auto& ref : references_) {
-    for (const auto& obj : ref.second) {
+  for (const CardReferences& card_references : card_references_) {
+    VisitReferences(card_references, [mark_sweep, &count](const Object* obj)
+        NO_THREAD_SAFETY_ANALYSIS {
       mark_sweep->MarkRoot(obj);
       ++count;
-    }
+    });
   }
   if (VLOG_IS_ON(heap)) {
     VLOG(gc) << "Marked " << count << " references in mod union table";
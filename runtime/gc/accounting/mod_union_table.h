@@ -19,7 +19,6 @@
 
 #include "gc_allocator.h"
 #include "globals.h"
-#include "safe_map.h"
 
 #include <set>
 #include <vector>
@@ -85,9 +84,11 @@ class ModUnionTable {
 };
 
 // Reference caching implementation. Caches references pointing to alloc space(s) for each card.
+// The references of a card are kept sorted and delta encoded in one buffer shared by all cards,
+// a few bytes each rather than a pointer plus a vector per card.
 class ModUnionTableReferenceCache : public ModUnionTable {
  public:
-  explicit ModUnionTableReferenceCache(Heap* heap) : ModUnionTable(heap) {}
+  explicit ModUnionTableReferenceCache(Heap* heap) : ModUnionTable(heap), garbage_bytes_(0) {}
   virtual ~ModUnionTableReferenceCache() {}
 
   // Clear and store cards for a space.
@@ -113,12 +114,32 @@ class ModUnionTableReferenceCache : public ModUnionTable {
   void Dump(std::ostream& os);
 
  protected:
+  // The references of a card, size bytes from offset in references_data_.
+  struct CardReferences {
+    const byte* card;
+    uint32_t offset;
+    uint32_t size;
+  };
+
+  // Appends the encoding of references, which it sorts, to references_data_.
+  CardReferences EncodeReferences(const byte* card, std::vector<const mirror::Object*>* references);
+
+  template <typename Visitor>
+  void VisitReferences(const CardReferences& card_references, const Visitor& visitor) const;
+
+  // Drops the encodings of the cards updated since, once they make up half of references_data_.
+  void Compact();
+
   // Cleared card array, used to update the mod-union table.
   ModUnionTable::CardSet cleared_cards_;
 
-  // Maps from dirty cards to their corresponding alloc space references.
-  SafeMap<const byte*, std::vector<const mirror::Object*>, std::less<const byte*>,
-    GCAllocator<std::pair<const byte*, std::vector<const mirror::Object*> > > > references_;
+  // The cards which have references, sorted by card.
+  std::vector<CardReferences, GCAllocator<CardReferences> > card_references_;
+
+  std::vector<uint8_t, GCAllocator<uint8_t> > references_data_;
+
+  // Bytes of references_data_ no card refers to any more.
+  size_t garbage_bytes_;
 };
 
 // Card caching implementation. Keeps track of which cards we cleared and only this information.
@@ -33,6 +33,8 @@ inline bool SpaceBitmap::AtomicTestAndSet(const mirror::Object* obj) {
   const word mask = OffsetToMask(offset);
   word* const address = &bitmap_begin_[index];
   DCHECK_LT(index, bitmap_size_ / kWordSize) << " bitmap_size_ = " << bitmap_size_;
+  // Set the summary first so that anybody who sees the bit also sees the summary bit.
+  SetSummary(index);
   word old_word;
   do {
     old_word = *address;
@@ -87,7 +89,11 @@ void SpaceBitmap::VisitMarkedRange(uintptr_t visit_begin, uintptr_t visit_end,
 
   for (size_t i = word_start; i < word_end; i++) {
     size_t w = bitmap_begin_[i];
-    if (w != 0) {
+    if (w == 0) {
+      if (!BlockMayHaveSetBits(i)) {
+        i = NextBlockIndex(i) - 1;
+      }
+    } else {
       uintptr_t ptr_base = IndexToOffset(i) + heap_begin_;
       do {
         const size_t shift = CLZ(w);
@@ -117,6 +123,16 @@ void SpaceBitmap::VisitMarkedRange(uintptr_t visit_begin, uintptr_t visit_end,
   }
 }
 
+inline void SpaceBitmap::SetSummary(size_t index) {
+  const size_t block = index / kSummaryBlockWords;
+  const word mask = SummaryMask(block);
+  word* const address = &summary_begin_[block / kBitsPerWord];
+  // Summary bits are only reset by Clear(), so this is rarely taken.
+  if (UNLIKELY((*address & mask) == 0)) {
+    android_atomic_or(mask, reinterpret_cast<int32_t*>(address));
+  }
+}
+
 inline bool SpaceBitmap::Modify(const mirror::Object* obj, bool do_set) {
   uintptr_t addr = reinterpret_cast<uintptr_t>(obj);
   DCHECK_GE(addr, heap_begin_);
@@ -127,6 +143,7 @@ inline bool SpaceBitmap::Modify(const mirror::Object* obj, bool do_set) {
   word* address = &bitmap_begin_[index];
   word old_word = *address;
   if (do_set) {
+    SetSummary(index);
     *address = old_word | mask;
   } else {
     *address = old_word & ~mask;
@@ -50,24 +50,56 @@ void SpaceSetMap::Walk(SpaceBitmap::Callback* callback, void* arg) {
   }
 }
 
-SpaceBitmap* SpaceBitmap::CreateFromMemMap(const std::string& name, MemMap* mem_map,
-                                           byte* heap_begin, size_t heap_capacity) {
+size_t SpaceBitmap::SummarySize(size_t bitmap_size) {
+  const size_t num_words = bitmap_size / kWordSize;
+  const size_t num_blocks = RoundUp(num_words, kSummaryBlockWords) / kSummaryBlockWords;
+  return RoundUp(num_blocks, kBitsPerWord) / kBitsPerWord * kWordSize;
+}
+
+SpaceBitmap* SpaceBitmap::CreateWithSummary(const std::string& name, MemMap* mem_map,
+                                            byte* heap_begin, size_t heap_capacity) {
   CHECK(mem_map != nullptr);
+  UniquePtr<MemMap> bitmap_mem_map(mem_map);
   word* bitmap_begin = reinterpret_cast<word*>(mem_map->Begin());
   size_t bitmap_size = OffsetToIndex(RoundUp(heap_capacity, kAlignment * kBitsPerWord)) * kWordSize;
-  return new SpaceBitmap(name, mem_map, bitmap_begin, bitmap_size, heap_begin);
+  std::string summary_name(name + " summary");
+  MemMap* summary_mem_map = MemMap::MapAnonymous(summary_name.c_str(), NULL,
+                                                 SummarySize(bitmap_size), PROT_READ | PROT_WRITE);
+  if (summary_mem_map == NULL) {
+    LOG(ERROR) << "Failed to allocate bitmap " << summary_name;
+    return NULL;
+  }
+  return new SpaceBitmap(name, bitmap_mem_map.release(), bitmap_begin, bitmap_size,
+                         summary_mem_map, heap_begin);
+}
+
+SpaceBitmap* SpaceBitmap::CreateFromMemMap(const std::string& name, MemMap* mem_map,
+                                           byte* heap_begin, size_t heap_capacity) {
+  SpaceBitmap* bitmap = CreateWithSummary(name, mem_map, heap_begin, heap_capacity);
+  if (bitmap != NULL) {
+    const size_t num_words = bitmap->bitmap_size_ / kWordSize;
+    for (size_t i = 0; i < num_words; ++i) {
+      if (bitmap->bitmap_begin_[i] != 0) {
+        bitmap->SetSummary(i);
+        i = NextBlockIndex(i) - 1;
+      }
+    }
+  }
+  return bitmap;
 }
 
 SpaceBitmap* SpaceBitmap::Create(const std::string& name, byte* heap_begin, size_t heap_capacity) {
   CHECK(heap_begin != NULL);
   // Round up since heap_capacity is not necessarily a multiple of kAlignment * kBitsPerWord.
   size_t bitmap_size = OffsetToIndex(RoundUp(heap_capacity, kAlignment * kBitsPerWord)) * kWordSize;
-  UniquePtr<MemMap> mem_map(MemMap::MapAnonymous(name.c_str(), NULL, bitmap_size, PROT_READ | PROT_WRITE));
+  UniquePtr<MemMap> mem_map(MemMap::MapAnonymousHugePages(name.c_str(), NULL, bitmap_size,
+                                                          PROT_READ | PROT_WRITE));
   if (mem_map.get() == NULL) {
     LOG(ERROR) << "Failed to allocate bitmap " << name;
     return NULL;
   }
-  return CreateFromMemMap(name, mem_map.release(), heap_begin, heap_capacity);
+  // The bitmap starts out empty, so there is no need to compute the summary.
+  return CreateWithSummary(name, mem_map.release(), heap_begin, heap_capacity);
 }
 
 // Clean up any resources associated with the bitmap.
@@ -90,12 +122,19 @@ void SpaceBitmap::Clear() {
     if (result == -1) {
       PLOG(FATAL) << "madvise failed";
     }
+    result = madvise(summary_begin_, summary_mem_map_->Size(), MADV_DONTNEED);
+    if (result == -1) {
+      PLOG(FATAL) << "madvise failed";
+    }
   }
 }
 
 void SpaceBitmap::CopyFrom(SpaceBitmap* source_bitmap) {
   DCHECK_EQ(Size(), source_bitmap->Size());
   std::copy(source_bitmap->Begin(), source_bitmap->Begin() + source_bitmap->Size() / kWordSize, Begin());
+  const size_t summary_words = SummarySize(Size()) / kWordSize;
+  std::copy(source_bitmap->summary_begin_, source_bitmap->summary_begin_ + summary_words,
+            summary_begin_);
 }
 
 // Visits set bits in address order.  The callback is not permitted to
@@ -107,6 +146,10 @@ void SpaceBitmap::Walk(SpaceBitmap::Callback* callback, void* arg) {
   uintptr_t end = OffsetToIndex(HeapLimit() - heap_begin_ - 1);
   word* bitmap_begin = bitmap_begin_;
   for (uintptr_t i = 0; i <= end; ++i) {
+    if (i % kSummaryBlockWords == 0 && !BlockMayHaveSetBits(i)) {
+      i = NextBlockIndex(i) - 1;
+      continue;
+    }
     word w = bitmap_begin[i];
     if (w != 0) {
       uintptr_t ptr_base = IndexToOffset(i) + heap_begin_;
@@ -151,6 +194,11 @@ void SpaceBitmap::SweepWalk(const SpaceBitmap& live_bitmap,
   word* live = live_bitmap.bitmap_begin_;
   word* mark = mark_bitmap.bitmap_begin_;
   for (size_t i = start; i <= end; i++) {
+    // Garbage is live but not marked, so there is nothing to sweep where the live bitmap is empty.
+    if (live[i] == 0 && !live_bitmap.BlockMayHaveSetBits(i)) {
+      i = NextBlockIndex(i) - 1;
+      continue;
+    }
     word garbage = live[i] & ~mark[i];
     if (UNLIKELY(garbage != 0)) {
       uintptr_t ptr_base = IndexToOffset(i) + live_bitmap.heap_begin_;
@@ -252,6 +300,10 @@ void SpaceBitmap::InOrderWalk(SpaceBitmap::Callback* callback, void* arg) {
   CHECK(callback != NULL);
   uintptr_t end = Size() / kWordSize;
   for (uintptr_t i = 0; i < end; ++i) {
+    if (i % kSummaryBlockWords == 0 && !BlockMayHaveSetBits(i)) {
+      i = NextBlockIndex(i) - 1;
+      continue;
+    }
     word w = bitmap_begin_[i];
     if (UNLIKELY(w != 0)) {
       uintptr_t ptr_base = IndexToOffset(i) + heap_begin_;
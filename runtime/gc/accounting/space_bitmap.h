@@ -42,6 +42,9 @@ class SpaceBitmap {
   // Alignment of objects within spaces.
   static const size_t kAlignment = 8;
 
+  // Number of bitmap words summarized by each bit of the summary bitmap.
+  static const size_t kSummaryBlockWords = 64;
+
   typedef void Callback(mirror::Object* obj, void* arg);
 
   typedef void ScanCallback(mirror::Object* obj, void* finger, void* arg);
@@ -54,7 +57,7 @@ class SpaceBitmap {
 
   // Initialize a space bitmap using the provided mem_map as the live bits. Takes ownership of the
   // mem map. The address range covered starts at heap_begin and is of size equal to heap_capacity.
-  // Objects are kAlignement-aligned.
+  // Objects are kAlignement-aligned. The summary is computed from the bits already in mem_map.
   static SpaceBitmap* CreateFromMemMap(const std::string& name, MemMap* mem_map,
                                        byte* heap_begin, size_t heap_capacity);
 
@@ -90,6 +93,18 @@ class SpaceBitmap {
   // Fill the bitmap with zeroes.  Returns the bitmap's memory to the system as a side-effect.
   void Clear();
 
+  // Returns false if no bit is set in the block of kSummaryBlockWords words containing the word at
+  // index. The summary is conservative, clearing bits never clears summary bits.
+  bool BlockMayHaveSetBits(size_t index) const {
+    const size_t block = index / kSummaryBlockWords;
+    return (summary_begin_[block / kBitsPerWord] & SummaryMask(block)) != 0;
+  }
+
+  // Index of the first word of the block following the one containing the word at index.
+  static size_t NextBlockIndex(size_t index) {
+    return (index / kSummaryBlockWords + 1) * kSummaryBlockWords;
+  }
+
   bool Test(const mirror::Object* obj) const;
 
   // Return true iff <obj> is within the range of pointers that this bitmap could potentially cover,
@@ -183,11 +198,26 @@ class SpaceBitmap {
   // TODO: heap_end_ is initialized so that the heap bitmap is empty, this doesn't require the -1,
   // however, we document that this is expected on heap_end_
   SpaceBitmap(const std::string& name, MemMap* mem_map, word* bitmap_begin, size_t bitmap_size,
-              const void* heap_begin)
+              MemMap* summary_mem_map, const void* heap_begin)
       : mem_map_(mem_map), bitmap_begin_(bitmap_begin), bitmap_size_(bitmap_size),
+        summary_mem_map_(summary_mem_map),
+        summary_begin_(reinterpret_cast<word*>(summary_mem_map->Begin())),
         heap_begin_(reinterpret_cast<uintptr_t>(heap_begin)),
         name_(name) {}
 
+  static SpaceBitmap* CreateWithSummary(const std::string& name, MemMap* mem_map,
+                                        byte* heap_begin, size_t heap_capacity);
+
+  static word SummaryMask(size_t block) {
+    return static_cast<word>(1) << (block % kBitsPerWord);
+  }
+
+  // Size in bytes of the summary of a bitmap of bitmap_size bytes.
+  static size_t SummarySize(size_t bitmap_size);
+
+  // Set the summary bit of the block containing the word at index. Safe to call concurrently.
+  void SetSummary(size_t index);
+
   bool Modify(const mirror::Object* obj, bool do_set);
 
   // Backing storage for bitmap.
@@ -199,6 +229,11 @@ class SpaceBitmap {
   // Size of this bitmap.
   size_t bitmap_size_;
 
+  // One bit per kSummaryBlockWords words of the bitmap, set if any of those words may be non zero.
+  // Lets walks of sparse bitmaps skip large empty regions.
+  UniquePtr<MemMap> summary_mem_map_;
+  word* const summary_begin_;
+
   // The base address of the heap, which corresponds to the word containing the first bit in the
   // bitmap.
   const uintptr_t heap_begin_;
@@ -22,6 +22,7 @@
 #include "UniquePtr.h"
 
 #include <stdint.h>
+#include <vector>
 
 namespace art {
 namespace gc {
@@ -88,6 +89,66 @@ TEST_F(SpaceBitmapTest, ScanRange) {
   }
 }
 
+class CollectVisitor {
+ public:
+  explicit CollectVisitor(std::vector<const mirror::Object*>* objects) : objects_(objects) {}
+
+  void operator()(const mirror::Object* obj) const {
+    objects_->push_back(obj);
+  }
+
+ private:
+  std::vector<const mirror::Object*>* const objects_;
+};
+
+static void CollectCallback(mirror::Object* obj, void* arg) {
+  reinterpret_cast<std::vector<const mirror::Object*>*>(arg)->push_back(obj);
+}
+
+// Objects spread out over a mostly empty bitmap must all be found by the walks which skip over
+// blocks of clear summary bits.
+TEST_F(SpaceBitmapTest, SparseWalk) {
+  byte* heap_begin = reinterpret_cast<byte*>(0x10000000);
+  size_t heap_capacity = 16 * MB;
+
+  UniquePtr<SpaceBitmap> space_bitmap(SpaceBitmap::Create("test bitmap",
+                                                          heap_begin, heap_capacity));
+  ASSERT_TRUE(space_bitmap.get() != NULL);
+
+  const size_t block_bytes = SpaceBitmap::kSummaryBlockWords * kBitsPerWord *
+      SpaceBitmap::kAlignment;
+  std::vector<const mirror::Object*> expected;
+  expected.push_back(reinterpret_cast<mirror::Object*>(heap_begin));
+  expected.push_back(reinterpret_cast<mirror::Object*>(heap_begin + block_bytes - 8));
+  expected.push_back(reinterpret_cast<mirror::Object*>(heap_begin + 7 * block_bytes + 64));
+  expected.push_back(reinterpret_cast<mirror::Object*>(heap_begin + heap_capacity - 8));
+  for (const mirror::Object* obj : expected) {
+    space_bitmap->Set(obj);
+  }
+  EXPECT_TRUE(space_bitmap->BlockMayHaveSetBits(0));
+  EXPECT_FALSE(space_bitmap->BlockMayHaveSetBits(SpaceBitmap::kSummaryBlockWords));
+
+  std::vector<const mirror::Object*> visited;
+  space_bitmap->VisitMarkedRange(reinterpret_cast<uintptr_t>(heap_begin),
+                                 reinterpret_cast<uintptr_t>(heap_begin + heap_capacity),
+                                 CollectVisitor(&visited));
+  EXPECT_TRUE(visited == expected);
+
+  visited.clear();
+  space_bitmap->Walk(CollectCallback, &visited);
+  EXPECT_TRUE(visited == expected);
+
+  // Clearing a bit leaves the summary conservatively set, the walk must still be exact.
+  space_bitmap->Clear(expected[2]);
+  expected.erase(expected.begin() + 2);
+  visited.clear();
+  space_bitmap->Walk(CollectCallback, &visited);
+  EXPECT_TRUE(visited == expected);
+
+  space_bitmap->Clear();
+  EXPECT_FALSE(space_bitmap->BlockMayHaveSetBits(0));
+}
+
 }  // namespace accounting
 }  // namespace gc
 }  // namespace art
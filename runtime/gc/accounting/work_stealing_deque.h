@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ART_RUNTIME_GC_ACCOUNTING_WORK_STEALING_DEQUE_H_
+#define ART_RUNTIME_GC_ACCOUNTING_WORK_STEALING_DEQUE_H_
+
+#include <string>
+
+#include "atomic_integer.h"
+#include "base/logging.h"
+#include "base/macros.h"
+#include "UniquePtr.h"
+#include "mem_map.h"
+#include "utils.h"
+
+namespace art {
+namespace gc {
+namespace accounting {
+
+// A fixed capacity Chase-Lev work stealing deque. The owning thread pushes and pops at the bottom
+// without atomic read-modify-writes except when racing for the last element, any other thread
+// may steal from the top.
+template <typename T>
+class WorkStealingDeque {
+ public:
+  // Capacity is how many elements we can store in the deque, it must be a power of two.
+  static WorkStealingDeque* Create(const std::string& name, size_t capacity) {
+    CHECK(IsPowerOfTwo(capacity)) << capacity;
+    UniquePtr<WorkStealingDeque> deque(new WorkStealingDeque(capacity));
+    deque->mem_map_.reset(MemMap::MapAnonymous(name.c_str(), NULL, capacity * sizeof(T),
+                                               PROT_READ | PROT_WRITE));
+    CHECK(deque->mem_map_.get() != NULL) << "couldn't allocate work stealing deque";
+    deque->begin_ = reinterpret_cast<T*>(deque->mem_map_->Begin());
+    return deque.release();
+  }
+
+  ~WorkStealingDeque() {}
+
+  // Must not race with any other operation.
+  void Reset() {
+    top_ = 0;
+    bottom_ = 0;
+  }
+
+  // Owner only. Returns false if the deque is full.
+  bool PushBottom(const T& value) {
+    const int32_t bottom = bottom_.load();
+    // A stale top only makes the deque look fuller than it is.
+    if (UNLIKELY(static_cast<size_t>(bottom - top_.load()) >= capacity_)) {
+      return false;
+    }
+    begin_[bottom & mask_] = value;
+    // The element must be visible before thieves can see the new bottom.
+    ANDROID_MEMBAR_STORE();
+    bottom_ = bottom + 1;
+    return true;
+  }
+
+  // Owner only. Returns false if the deque is empty.
+  bool PopBottom(T* value) {
+    const int32_t bottom = bottom_.load() - 1;
+    bottom_ = bottom;
+    // Claim the element before looking at what thieves have taken.
+    ANDROID_MEMBAR_FULL();
+    const int32_t top = top_.load();
+    if (bottom < top) {
+      bottom_ = top;
+      return false;
+    }
+    *value = begin_[bottom & mask_];
+    if (bottom > top) {
+      return true;
+    }
+    // Last element, race the thieves for it.
+    const bool won = top_.compare_and_swap(top, top + 1);
+    bottom_ = top + 1;
+    return won;
+  }
+
+  // Any thread. Returns false if the deque is empty or another thread took the element first.
+  bool Steal(T* value) {
+    const int32_t top = top_.load();
+    ANDROID_MEMBAR_FULL();
+    const int32_t bottom = bottom_.load();
+    if (top >= bottom) {
+      return false;
+    }
+    const T result = begin_[top & mask_];
+    if (!top_.compare_and_swap(top, top + 1)) {
+      return false;
+    }
+    *value = result;
+    return true;
+  }
+
+  // Only exact when no other thread is using the deque.
+  bool IsEmpty() const {
+    return bottom_.load() <= top_.load();
+  }
+
+  size_t Capacity() const {
+    return capacity_;
+  }
+
+ private:
+  explicit WorkStealingDeque(size_t capacity)
+      : begin_(NULL),
+        capacity_(capacity),
+        mask_(capacity - 1) {
+  }
+
+  // Memory mapping of the deque's elements.
+  UniquePtr<MemMap> mem_map_;
+
+  // Index of the oldest element, advanced by thieves and by the owner taking the last element.
+  AtomicInteger top_;
+
+  // Index after the newest element, only written by the owner.
+  AtomicInteger bottom_;
+
+  // Base of the circular buffer.
+  T* begin_;
+
+  // Maximum number of elements.
+  const size_t capacity_;
+  const size_t mask_;
+
+  DISALLOW_COPY_AND_ASSIGN(WorkStealingDeque);
+};
+
+typedef WorkStealingDeque<const mirror::Object*> ObjectDeque;
+
+}  // namespace accounting
+}  // namespace gc
+}  // namespace art
+
+#endif  // ART_RUNTIME_GC_ACCOUNTING_WORK_STEALING_DEQUE_H_
@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "allocation_sampler.h"
+
+#include <algorithm>
+#include <ostream>
+
+#include "base/stringprintf.h"
+#include "mirror/art_method-inl.h"
+#include "mirror/class.h"
+#include "object_utils.h"
+#include "runtime.h"
+#include "stack.h"
+#include "thread.h"
+#include "thread_list.h"
+#include "utils.h"
+
+namespace art {
+namespace gc {
+
+class AllocationSiteStackVisitor : public StackVisitor {
+ public:
+  AllocationSiteStackVisitor(Thread* thread, AllocationSampler::SiteStats* stats)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_)
+      : StackVisitor(thread, NULL), stats_(stats) {
+    stats_->depth = 0;
+  }
+
+  bool VisitFrame() SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
+    mirror::ArtMethod* m = GetMethod();
+    // Ignore runtime frames (in particular callee save).
+    if (m->IsRuntimeMethod()) {
+      return true;
+    }
+    stats_->methods[stats_->depth] = m;
+    stats_->dex_pcs[stats_->depth] = GetDexPc();
+    return ++stats_->depth < AllocationSampler::kMaxStackDepth;
+  }
+
+ private:
+  AllocationSampler::SiteStats* const stats_;
+};
+
+AllocationSampler::AllocationSampler()
+    : interval_bytes_(0), lock_("allocation sampler lock") {
+}
+
+void AllocationSampler::ResetThreadInterval(Thread* thread, void* arg) {
+  thread->SetAllocSampleBytesLeft(*reinterpret_cast<size_t*>(arg));
+}
+
+void AllocationSampler::Start(size_t interval_bytes) {
+  CHECK_NE(interval_bytes, 0U);
+  Thread* self = Thread::Current();
+  // Threads count down from a full interval. Threads started later sample their first
+  // allocation and count down from there.
+  MutexLock mu(self, *Locks::thread_list_lock_);
+  Runtime::Current()->GetThreadList()->ForEach(ResetThreadInterval, &interval_bytes);
+  interval_bytes_ = interval_bytes;
+}
+
+void AllocationSampler::Stop() {
+  interval_bytes_ = 0;
+}
+
+void AllocationSampler::Reset() {
+  MutexLock mu(Thread::Current(), lock_);
+  sites_.clear();
+}
+
+void AllocationSampler::RecordAllocation(Thread* self, mirror::Class* klass, size_t byte_count) {
+  ssize_t bytes_left = self->GetAllocSampleBytesLeft() - static_cast<ssize_t>(byte_count);
+  if (LIKELY(bytes_left > 0)) {
+    self->SetAllocSampleBytesLeft(bytes_left);
+  } else {
+    Sample(self, klass, byte_count, bytes_left);
+  }
+}
+
+void AllocationSampler::Sample(Thread* self, mirror::Class* klass, size_t byte_count,
+                               ssize_t bytes_left) {
+  size_t interval_bytes = interval_bytes_;
+  if (interval_bytes == 0) {
+    return;  // Raced with Stop.
+  }
+  // Carry the overshoot into the next interval so that large allocations aren't undercounted,
+  // but always leave some bytes before the next sample.
+  bytes_left += interval_bytes;
+  self->SetAllocSampleBytesLeft(bytes_left > 0 ? bytes_left : interval_bytes);
+
+  SiteStats stats;
+  AllocationSiteStackVisitor visitor(self, &stats);
+  visitor.WalkStack();
+  Site site;
+  site.method = (stats.depth != 0) ? stats.methods[0] : NULL;
+  site.dex_pc = (stats.depth != 0) ? stats.dex_pcs[0] : 0;
+  site.klass = klass;
+
+  MutexLock mu(self, lock_);
+  SiteMap::iterator it = sites_.find(site);
+  if (it == sites_.end()) {
+    stats.samples = 1;
+    stats.sampled_bytes = byte_count;
+    sites_.Put(site, stats);
+  } else {
+    ++it->second.samples;
+    it->second.sampled_bytes += byte_count;
+  }
+}
+
+void AllocationSampler::GetSites(SiteMap* sites) {
+  MutexLock mu(Thread::Current(), lock_);
+  *sites = sites_;
+}
+
+static bool MoreSamples(const std::pair<AllocationSampler::Site, AllocationSampler::SiteStats>& a,
+                        const std::pair<AllocationSampler::Site, AllocationSampler::SiteStats>& b) {
+  return a.second.samples > b.second.samples;
+}
+
+void AllocationSampler::Dump(std::ostream& os) {
+  SiteMap sites;
+  GetSites(&sites);
+  std::vector<std::pair<Site, SiteStats> > sorted(sites.begin(), sites.end());
+  std::sort(sorted.begin(), sorted.end(), MoreSamples);
+
+  os << "Allocation samples (one per " << PrettySize(interval_bytes_) << " per thread), "
+     << sorted.size() << " sites\n";
+  for (const auto& entry : sorted) {
+    const Site& site = entry.first;
+    const SiteStats& stats = entry.second;
+    os << StringPrintf("  %6zd samples, ~", stats.samples) << PrettySize(EstimateBytes(stats))
+       << " " << PrettyClass(site.klass) << "\n";
+    for (size_t i = 0; i < stats.depth; ++i) {
+      MethodHelper mh(stats.methods[i]);
+      os << "    at " << PrettyMethod(stats.methods[i]) << " line "
+         << mh.GetLineNumFromDexPC(stats.dex_pcs[i]) << "\n";
+    }
+  }
+}
+
+}  // namespace gc
+}  // namespace art
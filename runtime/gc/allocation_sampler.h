@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ART_RUNTIME_GC_ALLOCATION_SAMPLER_H_
+#define ART_RUNTIME_GC_ALLOCATION_SAMPLER_H_
+
+#include <iosfwd>
+#include <vector>
+
+#include "base/macros.h"
+#include "base/mutex.h"
+#include "globals.h"
+#include "safe_map.h"
+
+namespace art {
+
+class Thread;
+
+namespace mirror {
+  class ArtMethod;
+  class Class;
+}  // namespace mirror
+
+namespace gc {
+
+// Samples allocations every so many bytes per thread, recording where they come from. Samples are
+// aggregated by allocation site: the innermost method, its dex pc and the allocated class.
+class AllocationSampler {
+ public:
+  static const size_t kDefaultIntervalBytes = 512 * KB;
+  static const size_t kMaxStackDepth = 8;
+
+  struct Site {
+    const mirror::ArtMethod* method;
+    uint32_t dex_pc;
+    const mirror::Class* klass;
+
+    bool operator<(const Site& other) const {
+      if (method != other.method) {
+        return method < other.method;
+      }
+      if (dex_pc != other.dex_pc) {
+        return dex_pc < other.dex_pc;
+      }
+      return klass < other.klass;
+    }
+  };
+
+  struct SiteStats {
+    size_t samples;
+    // Bytes of the sampled allocations themselves.
+    uint64_t sampled_bytes;
+    // Stack of the first sample at this site, innermost frame first.
+    size_t depth;
+    const mirror::ArtMethod* methods[kMaxStackDepth];
+    uint32_t dex_pcs[kMaxStackDepth];
+  };
+
+  typedef SafeMap<Site, SiteStats> SiteMap;
+
+  AllocationSampler();
+
+  bool IsEnabled() const {
+    return interval_bytes_ != 0;
+  }
+
+  size_t GetIntervalBytes() const {
+    return interval_bytes_;
+  }
+
+  // Starts sampling one allocation every 'interval_bytes' bytes allocated by each thread.
+  void Start(size_t interval_bytes) LOCKS_EXCLUDED(lock_, Locks::thread_list_lock_);
+  void Stop();
+  void Reset() LOCKS_EXCLUDED(lock_);
+
+  // Counts an allocation against the thread's interval, sampling it when the interval is used up.
+  void RecordAllocation(Thread* self, mirror::Class* klass, size_t byte_count)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) LOCKS_EXCLUDED(lock_);
+
+  // Copies out the sites sampled so far.
+  void GetSites(SiteMap* sites) LOCKS_EXCLUDED(lock_);
+
+  // Estimates the bytes allocated at a site from its number of samples.
+  uint64_t EstimateBytes(const SiteStats& stats) const {
+    return static_cast<uint64_t>(stats.samples) * interval_bytes_;
+  }
+
+  // Logs the sites sampled so far, most allocating first.
+  void Dump(std::ostream& os) SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) LOCKS_EXCLUDED(lock_);
+
+ private:
+  void Sample(Thread* self, mirror::Class* klass, size_t byte_count, ssize_t bytes_left)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) LOCKS_EXCLUDED(lock_);
+
+  static void ResetThreadInterval(Thread* thread, void* arg);
+
+  volatile size_t interval_bytes_;
+
+  Mutex lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
+  SiteMap sites_ GUARDED_BY(lock_);
+
+  DISALLOW_COPY_AND_ASSIGN(AllocationSampler);
+};
+
+}  // namespace gc
+}  // namespace art
+
+#endif  // ART_RUNTIME_GC_ALLOCATION_SAMPLER_H_
@@ -38,6 +38,69 @@ static void art_heap_usage_error(const char* function, void* p);
 #pragma GCC diagnostic warning "-Wempty-body"
 
 
+extern "C" void* MspaceInspectFrom(void* msp, void* resume,
+                                   bool (*handler)(void* start, void* end, size_t used_bytes,
+                                                   void* arg),
+                                   void* arg) {
+  // Follows internal_inspect_all, which has no way to stop or resume.
+  mstate m = reinterpret_cast<mstate>(msp);
+  if (!ok_magic(m)) {
+    USAGE_ERROR_ACTION(m, m);
+    return NULL;
+  }
+  void* result = NULL;
+  if (!PREACTION(m)) {
+    if (is_initialized(m)) {
+      mchunkptr top = m->top;
+      for (msegmentptr s = &m->seg; s != 0 && result == NULL; s = s->next) {
+        mchunkptr q = align_as_chunk(s->base);
+        if (resume != NULL) {
+          if (!segment_holds(s, resume)) {
+            continue;
+          }
+          q = reinterpret_cast<mchunkptr>(resume);
+          resume = NULL;
+        }
+        while (segment_holds(s, q) && q->head != FENCEPOST_HEAD) {
+          mchunkptr next = next_chunk(q);
+          size_t sz = chunksize(q);
+          size_t used;
+          void* start;
+          if (is_inuse(q)) {
+            used = sz - CHUNK_OVERHEAD;
+            start = chunk2mem(q);
+          } else {
+            used = 0;
+            if (is_small(sz)) {
+              start = reinterpret_cast<void*>(reinterpret_cast<char*>(q) + sizeof(malloc_chunk));
+            } else {
+              start = reinterpret_cast<void*>(reinterpret_cast<char*>(q) +
+                                              sizeof(malloc_tree_chunk));
+            }
+          }
+          bool keep_going = true;
+          if (start < reinterpret_cast<void*>(next)) {
+            keep_going = handler(start, next, used, arg);
+          }
+          if (q == top) {
+            if (!keep_going && s->next != 0) {
+              result = align_as_chunk(s->next->base);
+            }
+            break;
+          }
+          if (!keep_going) {
+            result = next;
+            break;
+          }
+          q = next;
+        }
+      }
+    }
+    POSTACTION(m);
+  }
+  return result;
+}
+
 static void art_heap_corruption(const char* function) {
   LOG(FATAL) << "Corrupt heap detected in: " << function;
 }
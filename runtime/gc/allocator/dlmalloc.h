@@ -43,4 +43,13 @@ extern "C" void DlmallocMadviseCallback(void* start, void* end, size_t used_byte
 extern "C" void DlmallocBytesAllocatedCallback(void* start, void* end, size_t used_bytes, void* arg);
 extern "C" void DlmallocObjectsAllocatedCallback(void* start, void* end, size_t used_bytes, void* arg);
 
+// Like mspace_inspect_all, but starts at the chunk resume, or at the first chunk if resume is NULL,
+// and stops after the first chunk the handler returns false for. Returns the chunk to resume from,
+// or NULL once the end of the mspace is reached. The returned chunk is only valid until the next
+// allocation or free in the mspace.
+extern "C" void* MspaceInspectFrom(void* msp, void* resume,
+                                   bool (*handler)(void* start, void* end, size_t used_bytes,
+                                                   void* arg),
+                                   void* arg);
+
 #endif  // ART_RUNTIME_GC_ALLOCATOR_DLMALLOC_H_
@@ -21,6 +21,7 @@
 
 #include "garbage_collector.h"
 
+#include "base/histogram-inl.h"
 #include "base/logging.h"
 #include "base/mutex-inl.h"
 #include "gc/accounting/heap_bitmap.h"
@@ -33,13 +34,18 @@ namespace art {
 namespace gc {
 namespace collector {
 
+// Pause histogram buckets start 100us wide and double in width when they run out.
+static constexpr uint64_t kPauseBucketSize = 100;
+static constexpr size_t kPauseBucketCount = 64;
+
 GarbageCollector::GarbageCollector(Heap* heap, const std::string& name)
     : heap_(heap),
       name_(name),
       verbose_(VLOG_IS_ON(heap)),
       duration_ns_(0),
       timings_(name_.c_str(), true, verbose_),
-      cumulative_timings_(name) {
+      cumulative_timings_(name),
+      pause_histogram_((name_ + " paused").c_str(), kPauseBucketSize, kPauseBucketCount) {
   ResetCumulativeStatistics();
 }
 
@@ -50,6 +56,7 @@ bool GarbageCollector::HandleDirtyObjectsPhase() {
 
 void GarbageCollector::RegisterPause(uint64_t nano_length) {
   pause_times_.push_back(nano_length);
+  pause_histogram_.AddValue(nano_length / 1000);
 }
 
 void GarbageCollector::ResetCumulativeStatistics() {
@@ -58,6 +65,7 @@ void GarbageCollector::ResetCumulativeStatistics() {
   total_paused_time_ns_ = 0;
   total_freed_objects_ = 0;
   total_freed_bytes_ = 0;
+  pause_histogram_.Reset();
 }
 
 void GarbageCollector::Run() {
@@ -78,7 +86,7 @@ void GarbageCollector::Run() {
     thread_list->ResumeAll();
     ATRACE_END();
     uint64_t pause_end = NanoTime();
-    pause_times_.push_back(pause_end - pause_start);
+    RegisterPause(pause_end - pause_start);
   } else {
     Thread* self = Thread::Current();
     {
@@ -98,7 +106,7 @@ void GarbageCollector::Run() {
       ATRACE_BEGIN("Resuming mutator threads");
       thread_list->ResumeAll();
       ATRACE_END();
-      pause_times_.push_back(pause_end - pause_start);
+      RegisterPause(pause_end - pause_start);
     }
     {
       ReaderMutexLock mu(self, *Locks::mutator_lock_);
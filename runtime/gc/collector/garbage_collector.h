@@ -17,6 +17,7 @@
 #ifndef ART_RUNTIME_GC_COLLECTOR_GARBAGE_COLLECTOR_H_
 #define ART_RUNTIME_GC_COLLECTOR_GARBAGE_COLLECTOR_H_
 
+#include "base/histogram.h"
 #include "gc_type.h"
 #include "locks.h"
 #include "base/timing_logger.h"
@@ -72,6 +73,11 @@ class GarbageCollector {
     return cumulative_timings_;
   }
 
+  // Distribution of every pause since the cumulative statistics were last reset, in microseconds.
+  Histogram<uint64_t>& GetPauseHistogram() {
+    return pause_histogram_;
+  }
+
   void ResetCumulativeStatistics();
 
   // Swap the live and mark bitmaps of spaces that are active for the collector. For partial GC,
@@ -110,6 +116,7 @@ class GarbageCollector {
   uint64_t total_freed_bytes_;
 
   CumulativeLogger cumulative_timings_;
+  Histogram<uint64_t> pause_histogram_;
 
   std::vector<uint64_t> pause_times_;
 };
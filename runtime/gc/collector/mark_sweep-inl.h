@@ -129,23 +129,29 @@ inline void MarkSweep::VisitFieldsReferences(const mirror::Object* obj, uint32_t
       ref_offsets &= ~(CLASS_HIGH_BIT >> right_shift);
     }
   } else {
-    // There is no reference offset bitmap.  In the non-static case,
-    // walk up the class inheritance hierarchy and find reference
-    // offsets the hard way. In the static case, just consider this
-    // class.
-    for (const mirror::Class* klass = is_static ? obj->AsClass() : obj->GetClass();
-         klass != NULL;
-         klass = is_static ? NULL : klass->GetSuperClass()) {
-      size_t num_reference_fields = (is_static
-                                     ? klass->NumReferenceStaticFields()
-                                     : klass->NumReferenceInstanceFields());
+    // There is no reference offset bitmap. The reference fields a class declares are contiguous,
+    // the instance ones start where its superclass's instances end and the static ones at
+    // Class::FieldsOffset (see ClassLinker::LinkFields). In the non-static case walk up the class
+    // inheritance hierarchy visiting the references of each class, in the static case just
+    // consider this class.
+    const mirror::Class* klass = is_static ? obj->AsClass() : obj->GetClass();
+    while (klass != NULL) {
+      const mirror::Class* super_class = is_static ? NULL : klass->GetSuperClass();
+      size_t num_reference_fields;
+      uint32_t first_offset;
+      if (is_static) {
+        num_reference_fields = klass->NumReferenceStaticFields();
+        first_offset = mirror::Class::FieldsOffset().Uint32Value();
+      } else {
+        num_reference_fields = klass->NumReferenceInstanceFields();
+        first_offset = (super_class != NULL) ? super_class->GetObjectSize() : 0;
+      }
       for (size_t i = 0; i < num_reference_fields; ++i) {
-        mirror::ArtField* field = (is_static ? klass->GetStaticField(i)
-                                   : klass->GetInstanceField(i));
-        MemberOffset field_offset = field->GetOffset();
+        MemberOffset field_offset(first_offset + i * mirror::kHeapReferenceSize);
         const mirror::Object* ref = obj->GetFieldObject<const mirror::Object*>(field_offset, false);
         visitor(obj, ref, field_offset, is_static);
       }
+      klass = super_class;
     }
   }
 }
@@ -156,7 +162,7 @@ inline void MarkSweep::VisitObjectArrayReferences(const mirror::ObjectArray<mirr
   const size_t length = static_cast<size_t>(array->GetLength());
   for (size_t i = 0; i < length; ++i) {
     const mirror::Object* element = array->GetWithoutChecks(static_cast<int32_t>(i));
-    const size_t width = sizeof(mirror::Object*);
+    const size_t width = mirror::kHeapReferenceSize;
     MemberOffset offset(i * width + mirror::Array::DataOffset(width).Int32Value());
     visitor(array, element, offset, false);
   }
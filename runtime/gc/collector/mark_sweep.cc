@@ -19,16 +19,20 @@
 #include <functional>
 #include <numeric>
 #include <climits>
+#include <sched.h>
 #include <vector>
 
 #include "base/bounded_fifo.h"
 #include "base/logging.h"
 #include "base/macros.h"
 #include "base/mutex-inl.h"
+#include "base/stl_util.h"
 #include "base/timing_logger.h"
+#include "debugger.h"
 #include "gc/accounting/card_table-inl.h"
 #include "gc/accounting/heap_bitmap.h"
 #include "gc/accounting/space_bitmap-inl.h"
+#include "gc/accounting/work_stealing_deque.h"
 #include "gc/heap.h"
 #include "gc/space/image_space.h"
 #include "gc/space/large_object_space.h"
@@ -46,6 +50,7 @@
 #include "mirror/object-inl.h"
 #include "mirror/object_array.h"
 #include "mirror/object_array-inl.h"
+#include "numa.h"
 #include "runtime.h"
 #include "thread-inl.h"
 #include "thread_list.h"
@@ -64,6 +69,23 @@ namespace collector {
 constexpr bool kUseRecursiveMark = false;
 constexpr bool kUseMarkStackPrefetch = true;
 constexpr size_t kSweepArrayChunkFreeSize = 1024;
+// Number of gray objects each work stealing mark task can hold before it overflows into memory
+// other tasks can't steal from.
+constexpr size_t kMarkDequeCapacity = 64 * KB;
+// Concurrent passes over the cards dirtied during marking before the pause. Passes stop once one
+// finds at most kPreCleanConvergedCards cards, or no fewer than half of the previous pass's.
+constexpr size_t kMaxPreCleanPasses = 4;
+constexpr size_t kPreCleanConvergedCards = 64;
+
+// Prefetches the class of the next object to scan out of a prefetch FIFO, for the class fields
+// ScanObject reads first. The object itself was prefetched when it entered the FIFO, so loading
+// its class pointer shouldn't miss by then.
+static inline void PrefetchClassForScan(const Object* obj)
+    SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
+  const byte* klass = reinterpret_cast<const byte*>(obj->GetClass());
+  __builtin_prefetch(klass);
+  __builtin_prefetch(klass + Class::ReferenceInstanceOffsetsOffset().Int32Value());
+}
 
 // Parallelism options.
 constexpr bool kParallelCardScan = true;
@@ -74,6 +96,7 @@ constexpr bool kParallelRecursiveMark = true;
 // ProcessMarkStack with very small mark stacks.
 constexpr size_t kMinimumParallelMarkStackSize = 128;
 constexpr bool kParallelProcessMarkStack = true;
+constexpr bool kParallelSweep = true;
 
 // Profiling and information flags.
 constexpr bool kCountClassesMarked = false;
@@ -149,6 +172,13 @@ MarkSweep::MarkSweep(Heap* heap, bool is_concurrent, const std::string& name_pre
       clear_soft_references_(false) {
 }
 
+MarkSweep::~MarkSweep() {
+  STLDeleteElements(&mark_deques_);
+}
+
+// The last root scan id handed out. Collections are serialized by the heap.
+static uint32_t last_root_scan_id = 0;
+
 void MarkSweep::InitializePhase() {
   timings_.Reset();
   base::TimingLogger::ScopedSplit split("InitializePhase", &timings_);
@@ -164,6 +194,8 @@ void MarkSweep::InitializePhase() {
   freed_large_object_bytes_ = 0;
   freed_objects_ = 0;
   freed_large_objects_ = 0;
+  soft_references_preserved_ = 0;
+  soft_references_cleared_ = 0;
   class_count_ = 0;
   array_count_ = 0;
   other_count_ = 0;
@@ -174,6 +206,13 @@ void MarkSweep::InitializePhase() {
   work_chunks_created_ = 0;
   work_chunks_deleted_ = 0;
   reference_count_ = 0;
+  // Zero is the scan id of threads that were never scanned.
+  if (++last_root_scan_id == 0) {
+    ++last_root_scan_id;
+  }
+  root_scan_id_ = last_root_scan_id;
+  threads_remarked_ = 0;
+  threads_unchanged_ = 0;
   java_lang_Class_ = Class::GetJavaLangClass();
   CHECK(java_lang_Class_ != nullptr);
 
@@ -214,6 +253,8 @@ bool MarkSweep::HandleDirtyObjectsPhase() {
     WriterMutexLock mu(self, *Locks::heap_bitmap_lock_);
     // This second sweep makes sure that we don't have any objects in the live stack which point to
     // freed objects. These cause problems since their references may be previously freed objects.
+    // It empties the allocation stack, so no thread may keep a segment of it.
+    GetHeap()->RevokeAllThreadLocalAllocationStacks(self);
     SweepArray(GetHeap()->allocation_stack_.get(), false);
   }
 
@@ -230,6 +271,11 @@ bool MarkSweep::HandleDirtyObjectsPhase() {
   // incorrectly sweep it. This also fixes a race where interning may attempt to return a strong
   // reference to a string that is about to be swept.
   Runtime::Current()->DisallowNewSystemWeaks();
+
+  // The sweep runs with the mutators going again, deflate idle monitors while they're stopped.
+  timings_.StartSplit("DeflateMonitors");
+  Runtime::Current()->GetMonitorList()->DeflateMonitors();
+  timings_.EndSplit();
   return true;
 }
 
@@ -266,6 +312,17 @@ void MarkSweep::MarkingPhase() {
 
   heap_->UpdateAndMarkModUnion(this, timings_, GetGcType());
   MarkReachableObjects();
+
+  if (IsConcurrent()) {
+    // Rescan the thread roots with another round of checkpoints. Threads that stay suspended from
+    // here until the pause don't need to be rescanned in it.
+    MarkRootsCheckpoint(self);
+    timings_.StartSplit("ProcessMarkStack");
+    ProcessMarkStack(false);
+    timings_.EndSplit();
+    PreCleanCards();
+    PreProcessReferences(self);
+  }
 }
 
 void MarkSweep::MarkThreadRoots(Thread* self) {
@@ -344,6 +401,12 @@ void MarkSweep::ReclaimPhase() {
     // Unbind the live and mark bitmaps.
     UnBindBitmaps();
   }
+
+  // Unmap the freed large objects now that the heap bitmap lock is released, so that a collection
+  // freeing many of them doesn't hold it through the system calls.
+  timings_.StartSplit("UnmapFreedRuns");
+  GetHeap()->GetLargeObjectsSpace()->UnmapFreedRuns();
+  timings_.EndSplit();
 }
 
 void MarkSweep::SetImmuneRange(Object* begin, Object* end) {
@@ -727,6 +790,9 @@ class MarkStackTask : public Task {
         }
         obj = prefetch_fifo.front();
         prefetch_fifo.pop_front();
+        if (!prefetch_fifo.empty()) {
+          PrefetchClassForScan(prefetch_fifo.front());
+        }
       } else {
         if (UNLIKELY(mark_stack_pos_ == 0)) {
           break;
@@ -874,6 +940,53 @@ void MarkSweep::ScanGrayObjects(bool paused, byte minimum_age) {
   }
 }
 
+class RecordPreCleanedCardVisitor {
+ public:
+  explicit RecordPreCleanedCardVisitor(std::vector<byte*>* cards) : cards_(cards) {}
+
+  void operator()(byte* card, byte expected_value, byte new_value) const {
+    DCHECK_EQ(new_value, accounting::CardTable::kCardPreCleaned);
+    cards_->push_back(card);
+  }
+
+ private:
+  std::vector<byte*>* const cards_;
+};
+
+void MarkSweep::PreCleanCards() {
+  accounting::CardTable* card_table = GetHeap()->GetCardTable();
+  ScanObjectVisitor visitor(this);
+  std::vector<byte*> cards;
+  size_t previous_num_cards = 0;
+  for (size_t pass = 0; pass < kMaxPreCleanPasses; ++pass) {
+    // Mark the dirty cards as pre-cleaned before scanning them, so that the pause still sees any
+    // card written to during the scan as dirty.
+    timings_.StartSplit("PreCleanCards");
+    size_t num_cards = 0;
+    for (const auto& space : GetHeap()->GetContinuousSpaces()) {
+      cards.clear();
+      card_table->ModifyCardsAtomic(space->Begin(), space->End(), PreCleanCardVisitor(),
+                                    RecordPreCleanedCardVisitor(&cards));
+      accounting::SpaceBitmap* bitmap = space->GetMarkBitmap();
+      for (byte* card : cards) {
+        uintptr_t start = reinterpret_cast<uintptr_t>(card_table->AddrFromCard(card));
+        bitmap->VisitMarkedRange(start, start + accounting::CardTable::kCardSize, visitor);
+      }
+      num_cards += cards.size();
+    }
+    timings_.EndSplit();
+    timings_.StartSplit("ProcessMarkStack");
+    ProcessMarkStack(false);
+    timings_.EndSplit();
+    VLOG(heap) << "Pre-cleaning pass " << pass << " scanned " << num_cards << " cards";
+    if (num_cards <= kPreCleanConvergedCards ||
+        (pass != 0 && num_cards > previous_num_cards / 2)) {
+      break;
+    }
+    previous_num_cards = num_cards;
+  }
+}
+
 void MarkSweep::VerifyImageRoots() {
   // Verify roots ensures that all the references inside the image space point
   // objects which are either in the image space or marked objects in the alloc
@@ -1001,8 +1114,27 @@ void MarkSweep::RecursiveMarkDirtyObjects(bool paused, byte minimum_age) {
 
 void MarkSweep::ReMarkRoots() {
   timings_.StartSplit("ReMarkRoots");
-  Runtime::Current()->VisitRoots(ReMarkObjectVisitor, this, true, true);
+  Runtime* runtime = Runtime::Current();
+  runtime->VisitConcurrentRoots(ReMarkObjectVisitor, this, true, true);
+  runtime->VisitNonThreadRoots(ReMarkObjectVisitor, this);
+  timings_.NewSplit("ReMarkThreadRoots");
+  {
+    MutexLock mu(Thread::Current(), *Locks::thread_list_lock_);
+    runtime->GetThreadList()->ForEach(ReMarkThreadRootsCallback, this);
+  }
   timings_.EndSplit();
+  VLOG(gc) << "Re-marked the roots of " << threads_remarked_ << " threads, "
+           << threads_unchanged_ << " unchanged since their checkpoint";
+}
+
+void MarkSweep::ReMarkThreadRootsCallback(Thread* thread, void* arg) {
+  MarkSweep* mark_sweep = reinterpret_cast<MarkSweep*>(arg);
+  if (thread->AreRootsUnchangedSinceScan(mark_sweep->root_scan_id_)) {
+    ++mark_sweep->threads_unchanged_;
+  } else {
+    ++mark_sweep->threads_remarked_;
+    thread->VisitRoots(ReMarkObjectVisitor, arg);
+  }
 }
 
 void MarkSweep::SweepJniWeakGlobals(IsMarkedTester is_marked, void* arg) {
@@ -1033,6 +1165,7 @@ void MarkSweep::SweepSystemWeaks() {
   runtime->GetInternTable()->SweepInternTableWeaks(IsMarkedCallback, this);
   runtime->GetMonitorList()->SweepMonitorList(IsMarkedCallback, this);
   SweepJniWeakGlobals(IsMarkedCallback, this);
+  Dbg::SweepObjectRegistry(IsMarkedCallback, this);
   timings_.EndSplit();
 }
 
@@ -1047,8 +1180,7 @@ void MarkSweep::VerifyIsLive(const Object* obj) {
   if (!heap->GetLiveBitmap()->Test(obj)) {
     space::LargeObjectSpace* large_object_space = GetHeap()->GetLargeObjectsSpace();
     if (!large_object_space->GetLiveObjects()->Test(obj)) {
-      if (std::find(heap->allocation_stack_->Begin(), heap->allocation_stack_->End(), obj) ==
-          heap->allocation_stack_->End()) {
+      if (!heap->AllocationStackContains(obj)) {
         // Object not found!
         heap->DumpSpaces();
         LOG(FATAL) << "Found dead object " << obj;
@@ -1063,12 +1195,19 @@ void MarkSweep::VerifySystemWeaks() {
   runtime->GetInternTable()->SweepInternTableWeaks(VerifyIsLiveCallback, this);
   runtime->GetMonitorList()->SweepMonitorList(VerifyIsLiveCallback, this);
   runtime->GetJavaVM()->SweepWeakGlobals(VerifyIsLiveCallback, this);
+  Dbg::SweepObjectRegistry(VerifyIsLiveCallback, this);
 }
 
 struct SweepCallbackContext {
   MarkSweep* mark_sweep;
   space::AllocSpace* space;
+  // The thread doing the sweeping, a thread pool worker when sweeping in parallel.
   Thread* self;
+  // The thread holding the heap bitmap lock on behalf of the sweeping threads.
+  Thread* gc_thread;
+  // Merged into the collector and heap once all the sweeping threads are done.
+  size_t freed_objects;
+  size_t freed_bytes;
 };
 
 class CheckpointMarkThreadRoots : public Closure {
@@ -1082,6 +1221,14 @@ class CheckpointMarkThreadRoots : public Closure {
     CHECK(thread == self || thread->IsSuspended() || thread->GetState() == kWaitingPerformingGc)
         << thread->GetState() << " thread " << thread << " self " << self;
     thread->VisitRoots(MarkSweep::MarkRootParallelCallback, mark_sweep_);
+    // The stacks may have been swapped since the thread claimed its allocation stack segment,
+    // after this it allocates into the current allocation stack.
+    thread->RevokeThreadLocalAllocationStack();
+    if (thread != self) {
+      // The thread is suspended, so its roots stay as they are until it next becomes runnable or
+      // another thread notes a change, see Thread::AreRootsUnchangedSinceScan.
+      thread->SetRootsScanned(mark_sweep_->GetRootScanId());
+    }
     ATRACE_END();
     mark_sweep_->GetBarrier().Pass(self);
   }
@@ -1112,25 +1259,19 @@ void MarkSweep::MarkRootsCheckpoint(Thread* self) {
 
 void MarkSweep::SweepCallback(size_t num_ptrs, Object** ptrs, void* arg) {
   SweepCallbackContext* context = static_cast<SweepCallbackContext*>(arg);
-  MarkSweep* mark_sweep = context->mark_sweep;
-  Heap* heap = mark_sweep->GetHeap();
   space::AllocSpace* space = context->space;
-  Thread* self = context->self;
-  Locks::heap_bitmap_lock_->AssertExclusiveHeld(self);
+  Locks::heap_bitmap_lock_->AssertExclusiveHeld(context->gc_thread);
   // Use a bulk free, that merges consecutive objects before freeing or free per object?
   // Documentation suggests better free performance with merging, but this may be at the expensive
   // of allocation.
-  size_t freed_objects = num_ptrs;
+  context->freed_objects += num_ptrs;
   // AllocSpace::FreeList clears the value in ptrs, so perform after clearing the live bit
-  size_t freed_bytes = space->FreeList(self, num_ptrs, ptrs);
-  heap->RecordFree(freed_objects, freed_bytes);
-  mark_sweep->freed_objects_.fetch_add(freed_objects);
-  mark_sweep->freed_bytes_.fetch_add(freed_bytes);
+  context->freed_bytes += space->FreeList(context->self, num_ptrs, ptrs);
 }
 
 void MarkSweep::ZygoteSweepCallback(size_t num_ptrs, Object** ptrs, void* arg) {
   SweepCallbackContext* context = static_cast<SweepCallbackContext*>(arg);
-  Locks::heap_bitmap_lock_->AssertExclusiveHeld(context->self);
+  Locks::heap_bitmap_lock_->AssertExclusiveHeld(context->gc_thread);
   Heap* heap = context->mark_sweep->GetHeap();
   // We don't free any actual memory to avoid dirtying the shared zygote pages.
   for (size_t i = 0; i < num_ptrs; ++i) {
@@ -1140,34 +1281,28 @@ void MarkSweep::ZygoteSweepCallback(size_t num_ptrs, Object** ptrs, void* arg) {
   }
 }
 
-void MarkSweep::SweepArray(accounting::ObjectStack* allocations, bool swap_bitmaps) {
-  space::DlMallocSpace* space = heap_->GetAllocSpace();
-  timings_.StartSplit("SweepArray");
-  // Newly allocated objects MUST be in the alloc space and those are the only objects which we are
-  // going to free.
-  accounting::SpaceBitmap* live_bitmap = space->GetLiveBitmap();
-  accounting::SpaceBitmap* mark_bitmap = space->GetMarkBitmap();
-  space::LargeObjectSpace* large_object_space = GetHeap()->GetLargeObjectsSpace();
-  accounting::SpaceSetMap* large_live_objects = large_object_space->GetLiveObjects();
-  accounting::SpaceSetMap* large_mark_objects = large_object_space->GetMarkObjects();
-  if (swap_bitmaps) {
-    std::swap(live_bitmap, mark_bitmap);
-    std::swap(large_live_objects, large_mark_objects);
-  }
+struct SweepArrayCounts {
+  size_t freed_objects;
+  size_t freed_bytes;
+  size_t freed_large_objects;
+  size_t freed_large_object_bytes;
+};
 
-  size_t freed_bytes = 0;
-  size_t freed_large_object_bytes = 0;
-  size_t freed_objects = 0;
-  size_t freed_large_objects = 0;
-  size_t count = allocations->Size();
-  Object** objects = const_cast<Object**>(allocations->Begin());
-  Object** out = objects;
+// Frees the unmarked objects of an allocation stack range.
+static void SweepArrayRange(Thread* self, space::DlMallocSpace* space,
+                            accounting::SpaceBitmap* mark_bitmap,
+                            space::LargeObjectSpace* large_object_space,
+                            accounting::SpaceSetMap* large_mark_objects, Object** begin,
+                            Object** end, SweepArrayCounts* counts) NO_THREAD_SAFETY_ANALYSIS {
+  // Unmarked objects are compacted to the start of the range as it is only read once.
+  Object** out = begin;
   Object** objects_to_chunk_free = out;
-
-  // Empty the allocation stack.
-  Thread* self = Thread::Current();
-  for (size_t i = 0; i < count; ++i) {
-    Object* obj = objects[i];
+  for (Object** it = begin; it != end; ++it) {
+    Object* obj = *it;
+    if (UNLIKELY(obj == NULL)) {
+      // An unused slot of a thread's segment of the allocation stack.
+      continue;
+    }
     // There should only be objects in the AllocSpace/LargeObjectSpace in the allocation stack.
     if (LIKELY(mark_bitmap->HasAddress(obj))) {
       if (!mark_bitmap->Test(obj)) {
@@ -1177,40 +1312,122 @@ void MarkSweep::SweepArray(accounting::ObjectStack* allocations, bool swap_bitma
         DCHECK_GE(out, objects_to_chunk_free);
         DCHECK_LE(static_cast<size_t>(out - objects_to_chunk_free), kSweepArrayChunkFreeSize);
         if (static_cast<size_t>(out - objects_to_chunk_free) == kSweepArrayChunkFreeSize) {
-          timings_.StartSplit("FreeList");
           size_t chunk_freed_objects = out - objects_to_chunk_free;
-          freed_objects += chunk_freed_objects;
-          freed_bytes += space->FreeList(self, chunk_freed_objects, objects_to_chunk_free);
+          counts->freed_objects += chunk_freed_objects;
+          counts->freed_bytes += space->FreeList(self, chunk_freed_objects, objects_to_chunk_free);
           objects_to_chunk_free = out;
-          timings_.EndSplit();
         }
       }
     } else if (!large_mark_objects->Test(obj)) {
-      ++freed_large_objects;
-      freed_large_object_bytes += large_object_space->Free(self, obj);
+      ++counts->freed_large_objects;
+      counts->freed_large_object_bytes += large_object_space->Free(self, obj);
     }
   }
   // Free the remaining objects in chunks.
   DCHECK_GE(out, objects_to_chunk_free);
   DCHECK_LE(static_cast<size_t>(out - objects_to_chunk_free), kSweepArrayChunkFreeSize);
   if (out - objects_to_chunk_free > 0) {
-    timings_.StartSplit("FreeList");
     size_t chunk_freed_objects = out - objects_to_chunk_free;
-    freed_objects += chunk_freed_objects;
-    freed_bytes += space->FreeList(self, chunk_freed_objects, objects_to_chunk_free);
-    timings_.EndSplit();
+    counts->freed_objects += chunk_freed_objects;
+    counts->freed_bytes += space->FreeList(self, chunk_freed_objects, objects_to_chunk_free);
+  }
+}
+
+class SweepArrayTask : public Task {
+ public:
+  SweepArrayTask(space::DlMallocSpace* space, accounting::SpaceBitmap* mark_bitmap,
+                 space::LargeObjectSpace* large_object_space,
+                 accounting::SpaceSetMap* large_mark_objects, Object** begin, Object** end)
+      : space_(space),
+        mark_bitmap_(mark_bitmap),
+        large_object_space_(large_object_space),
+        large_mark_objects_(large_mark_objects),
+        begin_(begin),
+        end_(end) {
+    memset(&counts_, 0, sizeof(counts_));
+  }
+
+  const SweepArrayCounts& GetCounts() const {
+    return counts_;
+  }
+
+ protected:
+  space::DlMallocSpace* const space_;
+  accounting::SpaceBitmap* const mark_bitmap_;
+  space::LargeObjectSpace* const large_object_space_;
+  accounting::SpaceSetMap* const large_mark_objects_;
+  Object** const begin_;
+  Object** const end_;
+  SweepArrayCounts counts_;
+
+  virtual void Run(Thread* self) NO_THREAD_SAFETY_ANALYSIS {
+    SweepArrayRange(self, space_, mark_bitmap_, large_object_space_, large_mark_objects_, begin_,
+                    end_, &counts_);
+  }
+};
+
+void MarkSweep::SweepArray(accounting::ObjectStack* allocations, bool swap_bitmaps) {
+  space::DlMallocSpace* space = heap_->GetAllocSpace();
+  timings_.StartSplit("SweepArray");
+  // Newly allocated objects MUST be in the alloc space and those are the only objects which we are
+  // going to free.
+  accounting::SpaceBitmap* live_bitmap = space->GetLiveBitmap();
+  accounting::SpaceBitmap* mark_bitmap = space->GetMarkBitmap();
+  space::LargeObjectSpace* large_object_space = GetHeap()->GetLargeObjectsSpace();
+  accounting::SpaceSetMap* large_live_objects = large_object_space->GetLiveObjects();
+  accounting::SpaceSetMap* large_mark_objects = large_object_space->GetMarkObjects();
+  if (swap_bitmaps) {
+    std::swap(live_bitmap, mark_bitmap);
+    std::swap(large_live_objects, large_mark_objects);
+  }
+
+  SweepArrayCounts counts;
+  memset(&counts, 0, sizeof(counts));
+  size_t count = allocations->Size();
+  Object** objects = const_cast<Object**>(allocations->Begin());
+
+  // Empty the allocation stack.
+  Thread* self = Thread::Current();
+  ThreadPool* thread_pool = GetHeap()->GetThreadPool();
+  const size_t thread_count = GetThreadCount(!IsConcurrent());
+  if (kParallelSweep && thread_count > 1 && count >= thread_count * kSweepArrayChunkFreeSize) {
+    // Each task sweeps a contiguous range of the allocation stack.
+    std::vector<SweepArrayTask*> tasks;
+    const size_t delta = count / thread_count + 1;
+    for (size_t i = 0; i < count; i += delta) {
+      auto* task = new SweepArrayTask(space, mark_bitmap, large_object_space, large_mark_objects,
+                                      objects + i, objects + std::min(count, i + delta));
+      tasks.push_back(task);
+      thread_pool->AddTask(self, task);
+    }
+    thread_pool->SetMaxActiveWorkers(thread_count - 1);
+    thread_pool->StartWorkers(self);
+    thread_pool->Wait(self, true, true);
+    thread_pool->StopWorkers(self);
+    for (const SweepArrayTask* task : tasks) {
+      const SweepArrayCounts& task_counts = task->GetCounts();
+      counts.freed_objects += task_counts.freed_objects;
+      counts.freed_bytes += task_counts.freed_bytes;
+      counts.freed_large_objects += task_counts.freed_large_objects;
+      counts.freed_large_object_bytes += task_counts.freed_large_object_bytes;
+    }
+    STLDeleteElements(&tasks);
+  } else {
+    SweepArrayRange(self, space, mark_bitmap, large_object_space, large_mark_objects, objects,
+                    objects + count, &counts);
   }
   CHECK_EQ(count, allocations->Size());
   timings_.EndSplit();
 
   timings_.StartSplit("RecordFree");
-  VLOG(heap) << "Freed " << freed_objects << "/" << count
-             << " objects with size " << PrettySize(freed_bytes);
-  heap_->RecordFree(freed_objects + freed_large_objects, freed_bytes + freed_large_object_bytes);
-  freed_objects_.fetch_add(freed_objects);
-  freed_large_objects_.fetch_add(freed_large_objects);
-  freed_bytes_.fetch_add(freed_bytes);
-  freed_large_object_bytes_.fetch_add(freed_large_object_bytes);
+  VLOG(heap) << "Freed " << counts.freed_objects << "/" << count
+             << " objects with size " << PrettySize(counts.freed_bytes);
+  heap_->RecordFree(counts.freed_objects + counts.freed_large_objects,
+                    counts.freed_bytes + counts.freed_large_object_bytes);
+  freed_objects_.fetch_add(counts.freed_objects);
+  freed_large_objects_.fetch_add(counts.freed_large_objects);
+  freed_bytes_.fetch_add(counts.freed_bytes);
+  freed_large_object_bytes_.fetch_add(counts.freed_large_object_bytes);
   timings_.EndSplit();
 
   timings_.StartSplit("ResetStack");
@@ -1218,14 +1435,57 @@ void MarkSweep::SweepArray(accounting::ObjectStack* allocations, bool swap_bitma
   timings_.EndSplit();
 }
 
+class SweepTask : public Task {
+ public:
+  SweepTask(MarkSweep* mark_sweep, space::AllocSpace* space,
+            const accounting::SpaceBitmap* live_bitmap,
+            const accounting::SpaceBitmap* mark_bitmap, uintptr_t begin, uintptr_t end,
+            bool zygote, Thread* gc_thread)
+      : live_bitmap_(live_bitmap),
+        mark_bitmap_(mark_bitmap),
+        begin_(begin),
+        end_(end),
+        zygote_(zygote) {
+    context_.mark_sweep = mark_sweep;
+    context_.space = space;
+    context_.self = NULL;
+    context_.gc_thread = gc_thread;
+    context_.freed_objects = 0;
+    context_.freed_bytes = 0;
+  }
+
+  const SweepCallbackContext& GetContext() const {
+    return context_;
+  }
+
+  virtual void Run(Thread* self) NO_THREAD_SAFETY_ANALYSIS {
+    context_.self = self;
+    // Zygote sweep takes care of dirtying cards and clearing live bits, does not free actual
+    // memory.
+    accounting::SpaceBitmap::SweepWalk(*live_bitmap_, *mark_bitmap_, begin_, end_,
+                                       zygote_ ? &MarkSweep::ZygoteSweepCallback :
+                                           &MarkSweep::SweepCallback,
+                                       reinterpret_cast<void*>(&context_));
+  }
+
+ protected:
+  const accounting::SpaceBitmap* const live_bitmap_;
+  const accounting::SpaceBitmap* const mark_bitmap_;
+  const uintptr_t begin_;
+  const uintptr_t end_;
+  const bool zygote_;
+  SweepCallbackContext context_;
+};
+
 void MarkSweep::Sweep(bool swap_bitmaps) {
   DCHECK(mark_stack_->IsEmpty());
   base::TimingLogger::ScopedSplit("Sweep", &timings_);
 
   const bool partial = (GetGcType() == kGcTypePartial);
-  SweepCallbackContext scc;
-  scc.mark_sweep = this;
-  scc.self = Thread::Current();
+  Thread* self = Thread::Current();
+  ThreadPool* thread_pool = GetHeap()->GetThreadPool();
+  const size_t thread_count = kParallelSweep ? GetThreadCount(!IsConcurrent()) : 0;
+  std::vector<SweepTask*> tasks;
   for (const auto& space : GetHeap()->GetContinuousSpaces()) {
     // We always sweep always collect spaces.
     bool sweep_space = (space->GetGcRetentionPolicy() == space::kGcRetentionPolicyAlwaysCollect);
@@ -1236,27 +1496,48 @@ void MarkSweep::Sweep(bool swap_bitmaps) {
     if (sweep_space) {
       uintptr_t begin = reinterpret_cast<uintptr_t>(space->Begin());
       uintptr_t end = reinterpret_cast<uintptr_t>(space->End());
-      scc.space = space->AsDlMallocSpace();
       accounting::SpaceBitmap* live_bitmap = space->GetLiveBitmap();
       accounting::SpaceBitmap* mark_bitmap = space->GetMarkBitmap();
       if (swap_bitmaps) {
         std::swap(live_bitmap, mark_bitmap);
       }
-      if (!space->IsZygoteSpace()) {
-        base::TimingLogger::ScopedSplit split("SweepAllocSpace", &timings_);
-        // Bitmaps are pre-swapped for optimization which enables sweeping with the heap unlocked.
-        accounting::SpaceBitmap::SweepWalk(*live_bitmap, *mark_bitmap, begin, end,
-                                           &SweepCallback, reinterpret_cast<void*>(&scc));
-      } else {
-        base::TimingLogger::ScopedSplit split("SweepZygote", &timings_);
-        // Zygote sweep takes care of dirtying cards and clearing live bits, does not free actual
-        // memory.
-        accounting::SpaceBitmap::SweepWalk(*live_bitmap, *mark_bitmap, begin, end,
-                                           &ZygoteSweepCallback, reinterpret_cast<void*>(&scc));
+      // Bitmaps are pre-swapped for optimization which enables sweeping with the heap unlocked.
+      // Split the space into one range per thread. Ranges are page aligned so that no two
+      // tasks share a bitmap word.
+      const size_t range_count = std::max(thread_count, static_cast<size_t>(1));
+      const size_t delta = RoundUp((end - begin) / range_count + 1, kPageSize);
+      for (uintptr_t range_begin = begin; range_begin < end; range_begin += delta) {
+        tasks.push_back(new SweepTask(this, space->AsDlMallocSpace(), live_bitmap, mark_bitmap,
+                                      range_begin, std::min(end, range_begin + delta),
+                                      space->IsZygoteSpace(), self));
       }
     }
   }
 
+  if (thread_count > 1) {
+    for (SweepTask* task : tasks) {
+      thread_pool->AddTask(self, task);
+    }
+    thread_pool->SetMaxActiveWorkers(thread_count - 1);
+    thread_pool->StartWorkers(self);
+    thread_pool->Wait(self, true, true);
+    thread_pool->StopWorkers(self);
+  } else {
+    for (SweepTask* task : tasks) {
+      task->Run(self);
+    }
+  }
+  size_t freed_objects = 0;
+  size_t freed_bytes = 0;
+  for (const SweepTask* task : tasks) {
+    freed_objects += task->GetContext().freed_objects;
+    freed_bytes += task->GetContext().freed_bytes;
+  }
+  STLDeleteElements(&tasks);
+  heap_->RecordFree(freed_objects, freed_bytes);
+  freed_objects_.fetch_add(freed_objects);
+  freed_bytes_.fetch_add(freed_bytes);
+
   SweepLargeObjects(swap_bitmaps);
 }
 
@@ -1270,15 +1551,17 @@ void MarkSweep::SweepLargeObjects(bool swap_bitmaps) {
     std::swap(large_live_objects, large_mark_objects);
   }
   // O(n*log(n)) but hopefully there are not too many large objects.
-  size_t freed_objects = 0;
-  size_t freed_bytes = 0;
-  Thread* self = Thread::Current();
+  std::vector<Object*> dead_objects;
   for (const Object* obj : large_live_objects->GetObjects()) {
     if (!large_mark_objects->Test(obj)) {
-      freed_bytes += large_object_space->Free(self, const_cast<Object*>(obj));
-      ++freed_objects;
+      dead_objects.push_back(const_cast<Object*>(obj));
     }
   }
+  size_t freed_objects = dead_objects.size();
+  size_t freed_bytes = 0;
+  if (freed_objects != 0) {
+    freed_bytes = large_object_space->FreeList(Thread::Current(), freed_objects, &dead_objects[0]);
+  }
   freed_large_objects_.fetch_add(freed_objects);
   freed_large_object_bytes_.fetch_add(freed_bytes);
   GetHeap()->RecordFree(freed_objects, freed_bytes);
@@ -1399,17 +1682,151 @@ void MarkSweep::ScanObject(const Object* obj) {
   ScanObjectVisit(obj, visitor);
 }
 
+// Marks from a seed range of the mark stack, keeping gray objects in its own deque. Once the deque
+// is drained the task steals from the deques of the other tasks until none of them has work left.
+// In NUMA mode the task has no seed range of its own and claims chunks of seeds instead, those on
+// its node first, before it steals.
+class WorkStealingMarkTask : public Task {
+ public:
+  WorkStealingMarkTask(MarkSweep* mark_sweep, size_t index, size_t num_tasks, Object** begin,
+                       Object** end, size_t numa_chunk_size)
+      : mark_sweep_(mark_sweep),
+        deque_(mark_sweep->mark_deques_[index]),
+        index_(index),
+        num_tasks_(num_tasks),
+        begin_(begin),
+        end_(end),
+        numa_chunk_size_(numa_chunk_size),
+        node_(0) {
+  }
+
+  virtual void Finalize() {
+    delete this;
+  }
+
+  virtual void Run(Thread* self) NO_THREAD_SAFETY_ANALYSIS {
+    ++mark_sweep_->active_mark_tasks_;
+    if (numa_chunk_size_ != 0) {
+      node_ = Numa::CurrentNode();
+      mark_sweep_->mark_task_nodes_[index_] = node_;
+    }
+    for (Object** it = begin_; it != end_; ++it) {
+      MarkStackPush(*it);
+    }
+    for (;;) {
+      const Object* obj = NULL;
+      if (!deque_->PopBottom(&obj) && !OverflowPop(&obj) && !ClaimNumaSeeds(&obj) &&
+          !Steal(&obj)) {
+        break;
+      }
+      DCHECK(obj != NULL);
+      ScanObject(obj);
+    }
+    DCHECK(overflow_.empty());
+  }
+
+ private:
+  MarkSweep* const mark_sweep_;
+  accounting::ObjectDeque* const deque_;
+  const size_t index_;
+  const size_t num_tasks_;
+  Object** const begin_;
+  Object** const end_;
+  // Zero unless in NUMA mode.
+  const size_t numa_chunk_size_;
+  size_t node_;
+  // Gray objects which didn't fit in the deque, only visible to this task.
+  std::vector<const Object*> overflow_;
+
+  void MarkStackPush(const Object* obj) ALWAYS_INLINE {
+    if (UNLIKELY(!deque_->PushBottom(obj))) {
+      overflow_.push_back(obj);
+    }
+  }
+
+  bool OverflowPop(const Object** obj) {
+    if (overflow_.empty()) {
+      return false;
+    }
+    *obj = overflow_.back();
+    overflow_.pop_back();
+    return true;
+  }
+
+  bool ClaimNumaSeeds(const Object** obj) {
+    Object** begin;
+    Object** end;
+    if (numa_chunk_size_ == 0 ||
+        !mark_sweep_->ClaimNumaSeeds(node_, numa_chunk_size_, &begin, &end)) {
+      return false;
+    }
+    for (Object** it = begin; it != end; ++it) {
+      MarkStackPush(*it);
+    }
+    return deque_->PopBottom(obj) || OverflowPop(obj);
+  }
+
+  // Returns false once no task has any gray objects left. Tasks only stop being active when their
+  // own deque is empty and nothing pushes to an inactive task's deque, so no work can be missed.
+  // NUMA seeds are all claimed by active tasks before any task gets here.
+  bool Steal(const Object** obj) {
+    --mark_sweep_->active_mark_tasks_;
+    for (;;) {
+      // In NUMA mode the first pass only steals from tasks on the same node.
+      for (size_t pass = numa_chunk_size_ != 0 ? 0 : 1; pass < 2; ++pass) {
+        for (size_t i = 1; i < num_tasks_; ++i) {
+          const size_t victim = (index_ + i) % num_tasks_;
+          if (pass == 0 && mark_sweep_->mark_task_nodes_[victim] != node_) {
+            continue;
+          }
+          if (mark_sweep_->mark_deques_[victim]->Steal(obj)) {
+            ++mark_sweep_->active_mark_tasks_;
+            return true;
+          }
+        }
+      }
+      if (mark_sweep_->active_mark_tasks_ == 0) {
+        return false;
+      }
+      sched_yield();
+    }
+  }
+
+  void ScanObject(const Object* obj) NO_THREAD_SAFETY_ANALYSIS {
+    MarkSweep* mark_sweep = mark_sweep_;
+    mark_sweep->ScanObjectVisit(obj,
+        [mark_sweep, this](const Object* /* obj */, const Object* ref,
+            const MemberOffset& /* offset */, bool /* is_static */) ALWAYS_INLINE {
+      if (ref != nullptr && mark_sweep->MarkObjectParallel(ref)) {
+        MarkStackPush(ref);
+      }
+    });
+  }
+};
+
 void MarkSweep::ProcessMarkStackParallel(size_t thread_count) {
   Thread* self = Thread::Current();
   ThreadPool* thread_pool = GetHeap()->GetThreadPool();
-  const size_t chunk_size = std::min(mark_stack_->Size() / thread_count + 1,
-                                     static_cast<size_t>(MarkStackTask<false>::kMaxSize));
-  CHECK_GT(chunk_size, 0U);
-  // Split the current mark stack up into work tasks.
-  for (mirror::Object **it = mark_stack_->Begin(), **end = mark_stack_->End(); it < end; ) {
+  while (mark_deques_.size() < thread_count) {
+    mark_deques_.push_back(accounting::ObjectDeque::Create("mark deque", kMarkDequeCapacity));
+  }
+  const size_t chunk_size = mark_stack_->Size() / thread_count + 1;
+  // Seed one task per thread with a part of the current mark stack, the tasks balance the rest of
+  // the work between themselves by stealing. In NUMA mode which part depends on the node the task
+  // ends up running on, so the tasks claim their seeds themselves.
+  const bool numa = GetHeap()->IsNumaEnabled();
+  if (numa) {
+    SortMarkStackByNumaNode();
+    mark_task_nodes_.assign(thread_count, 0);
+  }
+  active_mark_tasks_ = 0;
+  mirror::Object** it = mark_stack_->Begin();
+  mirror::Object** const end = numa ? it : mark_stack_->End();
+  for (size_t i = 0; i < thread_count; ++i) {
+    mark_deques_[i]->Reset();
     const size_t delta = std::min(static_cast<size_t>(end - it), chunk_size);
-    thread_pool->AddTask(self, new MarkStackTask<false>(thread_pool, this, delta,
-                                                        const_cast<const mirror::Object**>(it)));
+    thread_pool->AddTask(self, new WorkStealingMarkTask(this, i, thread_count, it, it + delta,
+                                                        numa ? chunk_size : 0));
     it += delta;
   }
   thread_pool->SetMaxActiveWorkers(thread_count - 1);
@@ -1420,6 +1837,53 @@ void MarkSweep::ProcessMarkStackParallel(size_t thread_count) {
   CHECK_EQ(work_chunks_created_, work_chunks_deleted_) << " some of the work chunks were leaked";
 }
 
+void MarkSweep::SortMarkStackByNumaNode() {
+  const Heap* heap = GetHeap();
+  const size_t num_nodes = Numa::NumNodes();
+  mirror::Object** const begin = mark_stack_->Begin();
+  mirror::Object** const end = mark_stack_->End();
+  std::vector<size_t> node_starts(num_nodes + 1, 0);
+  for (mirror::Object** it = begin; it != end; ++it) {
+    ++node_starts[heap->NumaNodeOf(*it) + 1];
+  }
+  for (size_t node = 1; node <= num_nodes; ++node) {
+    node_starts[node] += node_starts[node - 1];
+  }
+  std::vector<mirror::Object*> sorted(end - begin);
+  std::vector<size_t> next(node_starts.begin(), node_starts.end() - 1);
+  for (mirror::Object** it = begin; it != end; ++it) {
+    sorted[next[heap->NumaNodeOf(*it)]++] = *it;
+  }
+  std::copy(sorted.begin(), sorted.end(), begin);
+  numa_seeds_.resize(num_nodes + 1);
+  for (size_t node = 0; node <= num_nodes; ++node) {
+    numa_seeds_[node] = begin + node_starts[node];
+  }
+  numa_seeds_claimed_.resize(num_nodes);
+  for (size_t node = 0; node < num_nodes; ++node) {
+    numa_seeds_claimed_[node] = 0;
+  }
+}
+
+bool MarkSweep::ClaimNumaSeeds(size_t node, size_t chunk_size, mirror::Object*** begin,
+                               mirror::Object*** end) {
+  const size_t num_nodes = numa_seeds_claimed_.size();
+  for (size_t i = 0; i < num_nodes; ++i) {
+    const size_t n = (node + i) % num_nodes;
+    const size_t num_seeds = numa_seeds_[n + 1] - numa_seeds_[n];
+    if (static_cast<size_t>(numa_seeds_claimed_[n].load()) >= num_seeds) {
+      continue;
+    }
+    const size_t claimed = numa_seeds_claimed_[n].fetch_add(chunk_size);
+    if (claimed < num_seeds) {
+      *begin = numa_seeds_[n] + claimed;
+      *end = numa_seeds_[n] + std::min(claimed + chunk_size, num_seeds);
+      return true;
+    }
+  }
+  return false;
+}
+
 // Scan anything that's on the mark stack.
 void MarkSweep::ProcessMarkStack(bool paused) {
   timings_.StartSplit("ProcessMarkStack");
@@ -1445,6 +1909,9 @@ void MarkSweep::ProcessMarkStack(bool paused) {
         }
         obj = prefetch_fifo.front();
         prefetch_fifo.pop_front();
+        if (!prefetch_fifo.empty()) {
+          PrefetchClassForScan(prefetch_fifo.front());
+        }
       } else {
         if (mark_stack_->IsEmpty()) {
           break;
@@ -1460,32 +1927,48 @@ void MarkSweep::ProcessMarkStack(bool paused) {
 
 // Walks the reference list marking any references subject to the
 // reference clearing policy.  References with a black referent are
-// removed from the list.  References with white referents biased
-// toward saving are blackened and also removed from the list.
+// removed from the list.  White referents that have not been only
+// softly reachable for longer than the heap's soft reference age are
+// blackened and also removed from the list.
 void MarkSweep::PreserveSomeSoftReferences(Object** list) {
   DCHECK(list != NULL);
   Object* clear = NULL;
-  size_t counter = 0;
 
   DCHECK(mark_stack_->IsEmpty());
 
   timings_.StartSplit("PreserveSomeSoftReferences");
+  SafeMap<const Object*, Heap::SoftReferenceAge>& ages = heap_->soft_reference_ages_;
+  const uint64_t now = NanoTime();
+  const uint64_t max_age = heap_->GetSoftReferenceMaxAgeNs();
   while (*list != NULL) {
     Object* ref = heap_->DequeuePendingReference(list);
     Object* referent = heap_->GetReferenceReferent(ref);
     if (referent == NULL) {
       // Referent was cleared by the user during marking.
+      ages.erase(ref);
       continue;
     }
-    bool is_marked = IsMarked(referent);
-    if (!is_marked && ((++counter) & 1)) {
-      // Referent is white and biased toward saving, mark it.
-      MarkObject(referent);
-      is_marked = true;
+    if (IsMarked(referent)) {
+      // Strongly reachable again, the referent was used since it was last found white.
+      ages.erase(ref);
+      continue;
+    }
+    auto it = ages.find(ref);
+    if (it == ages.end()) {
+      Heap::SoftReferenceAge age = { now, heap_->soft_reference_gc_ };
+      ages.Put(ref, age);
+      it = ages.find(ref);
     }
-    if (!is_marked) {
-      // Referent is white, queue it for clearing.
+    it->second.last_white_gc = heap_->soft_reference_gc_;
+    if (now - it->second.white_since_ns <= max_age) {
+      // Referent was recently reachable, mark it.
+      MarkObject(referent);
+      ++soft_references_preserved_;
+    } else {
+      // Referent is white and old, queue it for clearing.
+      ages.erase(it);
       heap_->EnqueuePendingReference(ref, &clear);
+      ++soft_references_cleared_;
     }
   }
   *list = clear;
@@ -1495,6 +1978,29 @@ void MarkSweep::PreserveSomeSoftReferences(Object** list) {
   ProcessMarkStack(true);
 }
 
+void MarkSweep::SweepSoftReferenceAges() {
+  timings_.StartSplit("SweepSoftReferenceAges");
+  SafeMap<const Object*, Heap::SoftReferenceAge>& ages = heap_->soft_reference_ages_;
+  // A sticky collection doesn't scan the references allocated before the last collection, not
+  // finding their referents white again doesn't mean they were used.
+  const bool scanned_all = GetGcType() != kGcTypeSticky;
+  for (auto it = ages.begin(); it != ages.end();) {
+    const Object* ref = it->first;
+    if (!IsMarked(ref)) {
+      ages.erase(it++);
+    } else if (scanned_all && !IsImmune(ref) &&
+               it->second.last_white_gc != heap_->soft_reference_gc_) {
+      // The reference was scanned but its referent wasn't white, so it was used since the last
+      // collection and ages afresh once it is only softly reachable again.
+      ages.erase(it++);
+    } else {
+      ++it;
+    }
+  }
+  ++heap_->soft_reference_gc_;
+  timings_.EndSplit();
+}
+
 inline bool MarkSweep::IsMarked(const Object* object) const
     SHARED_LOCKS_REQUIRED(Locks::heap_bitmap_lock_) {
   if (IsImmune(object)) {
@@ -1526,6 +2032,31 @@ void MarkSweep::ClearWhiteReferences(Object** list) {
   DCHECK(*list == NULL);
 }
 
+void MarkSweep::FilterMarkedReferences(Object** list, Mutex* lock) {
+  DCHECK(list != NULL);
+  Thread* self = Thread::Current();
+  MutexLock mu(self, *lock);
+  Object* keep = NULL;
+  while (*list != NULL) {
+    Object* ref = heap_->DequeuePendingReference(list);
+    // The referent may be cleared by the user at any point, but never becomes non-null again.
+    Object* referent = heap_->GetReferenceReferent(ref);
+    if (referent != NULL && !IsMarked(referent)) {
+      heap_->EnqueuePendingReference(ref, &keep);
+    }
+  }
+  *list = keep;
+}
+
+void MarkSweep::PreProcessReferences(Thread* self) {
+  base::TimingLogger::ScopedSplit split("PreProcessReferences", &timings_);
+  DCHECK(mark_stack_->IsEmpty());
+  FilterMarkedReferences(&soft_reference_list_, heap_->GetSoftRefQueueLock());
+  FilterMarkedReferences(&weak_reference_list_, heap_->GetWeakRefQueueLock());
+  FilterMarkedReferences(&finalizer_reference_list_, heap_->GetFinalizerRefQueueLock());
+  FilterMarkedReferences(&phantom_reference_list_, heap_->GetPhantomRefQueueLock());
+}
+
 // Enqueues finalizer references with white referents.  White
 // referents are blackened, moved to the zombie field, and the
 // referent field is cleared.
@@ -1571,10 +2102,11 @@ void MarkSweep::ProcessReferences(Object** soft_references, bool clear_soft,
     PreserveSomeSoftReferences(soft_references);
   }
 
-  timings_.StartSplit("ProcessReferences");
   // Clear all remaining soft and weak references with white
   // referents.
+  timings_.StartSplit("ProcessSoftReferences");
   ClearWhiteReferences(soft_references);
+  timings_.NewSplit("ProcessWeakReferences");
   ClearWhiteReferences(weak_references);
   timings_.EndSplit();
 
@@ -1582,13 +2114,15 @@ void MarkSweep::ProcessReferences(Object** soft_references, bool clear_soft,
   // them for finalization.
   EnqueueFinalizerReferences(finalizer_references);
 
-  timings_.StartSplit("ProcessReferences");
   // Clear all f-reachable soft and weak references with white
   // referents.
+  timings_.StartSplit("ProcessSoftReferences");
   ClearWhiteReferences(soft_references);
+  timings_.NewSplit("ProcessWeakReferences");
   ClearWhiteReferences(weak_references);
 
   // Clear all phantom references with white referents.
+  timings_.NewSplit("ProcessPhantomReferences");
   ClearWhiteReferences(phantom_references);
 
   // At this point all reference lists should be empty.
@@ -1597,6 +2131,9 @@ void MarkSweep::ProcessReferences(Object** soft_references, bool clear_soft,
   DCHECK(*finalizer_references == NULL);
   DCHECK(*phantom_references == NULL);
   timings_.EndSplit();
+
+  // Marking is complete, the references that aren't marked are about to be swept.
+  SweepSoftReferenceAges();
 }
 
 void MarkSweep::UnBindBitmaps() {
@@ -1628,15 +2165,15 @@ void MarkSweep::FinishPhase() {
   heap->PostGcVerification(this);
 
   timings_.NewSplit("GrowForUtilization");
-  heap->GrowForUtilization(GetGcType(), GetDurationNs());
+  heap->GrowForUtilization(this);
 
   timings_.NewSplit("RequestHeapTrim");
   heap->RequestHeapTrim();
 
   // Update the cumulative statistics
   total_time_ns_ += GetDurationNs();
-  total_paused_time_ns_ += std::accumulate(GetPauseTimes().begin(), GetPauseTimes().end(), 0,
-                                           std::plus<uint64_t>());
+  total_paused_time_ns_ += std::accumulate(GetPauseTimes().begin(), GetPauseTimes().end(),
+                                           UINT64_C(0), std::plus<uint64_t>());
   total_freed_objects_ += GetFreedObjects() + GetFreedLargeObjects();
   total_freed_bytes_ += GetFreedBytes() + GetFreedLargeObjectBytes();
 
@@ -1668,6 +2205,11 @@ void MarkSweep::FinishPhase() {
     VLOG(gc) << "References scanned " << reference_count_;
   }
 
+  if (soft_references_preserved_ != 0 || soft_references_cleared_ != 0) {
+    VLOG(gc) << "Soft references preserved " << soft_references_preserved_ << " cleared "
+             << soft_references_cleared_;
+  }
+
   // Update the cumulative loggers.
   cumulative_timings_.Start();
   cumulative_timings_.AddLogger(timings_);
@@ -48,6 +48,8 @@ namespace accounting {
   class MarkStackChunk;
   typedef AtomicStack<mirror::Object*> ObjectStack;
   class SpaceBitmap;
+  template <typename T> class WorkStealingDeque;
+  typedef WorkStealingDeque<const mirror::Object*> ObjectDeque;
 }  // namespace accounting
 
 namespace space {
@@ -62,7 +64,7 @@ class MarkSweep : public GarbageCollector {
  public:
   explicit MarkSweep(Heap* heap, bool is_concurrent, const std::string& name_prefix = "");
 
-  ~MarkSweep() {}
+  ~MarkSweep();
 
   virtual void InitializePhase();
   virtual bool IsConcurrent() const;
@@ -134,6 +136,11 @@ class MarkSweep : public GarbageCollector {
       EXCLUSIVE_LOCKS_REQUIRED(Locks::heap_bitmap_lock_)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
 
+  // Identifies this collection to the threads whose roots it scanned while they were suspended.
+  uint32_t GetRootScanId() const {
+    return root_scan_id_;
+  }
+
   void ProcessReferences(Thread* self)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
 
@@ -182,6 +189,15 @@ class MarkSweep : public GarbageCollector {
     return freed_large_objects_;
   }
 
+  // Soft references with white referents the age policy kept or cleared in this collection.
+  size_t GetSoftReferencesPreserved() const {
+    return soft_references_preserved_;
+  }
+
+  size_t GetSoftReferencesCleared() const {
+    return soft_references_cleared_;
+  }
+
   uint64_t GetTotalTimeNs() const {
     return total_time_ns_;
   }
@@ -252,6 +268,11 @@ class MarkSweep : public GarbageCollector {
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_)
       EXCLUSIVE_LOCKS_REQUIRED(Locks::heap_bitmap_lock_);
 
+  // Re-marks the roots of a thread unless they are unchanged since this collection scanned them.
+  static void ReMarkThreadRootsCallback(Thread* thread, void* arg)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_)
+      EXCLUSIVE_LOCKS_REQUIRED(Locks::heap_bitmap_lock_);
+
   static void VerifyImageRootVisitor(mirror::Object* root, void* arg)
       SHARED_LOCKS_REQUIRED(Locks::heap_bitmap_lock_,
                             Locks::mutator_lock_);
@@ -359,6 +380,12 @@ class MarkSweep : public GarbageCollector {
       EXCLUSIVE_LOCKS_REQUIRED(Locks::heap_bitmap_lock_)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
 
+  // Scans the cards dirtied during concurrent marking while the mutators still run, marking them
+  // pre-cleaned, so that the pause only has to scan the cards dirtied again since.
+  void PreCleanCards()
+      EXCLUSIVE_LOCKS_REQUIRED(Locks::heap_bitmap_lock_)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
   // Schedules an unmarked object for reference processing.
   void DelayReferenceReferent(mirror::Class* klass, mirror::Object* reference)
       SHARED_LOCKS_REQUIRED(Locks::heap_bitmap_lock_, Locks::mutator_lock_);
@@ -372,6 +399,14 @@ class MarkSweep : public GarbageCollector {
       EXCLUSIVE_LOCKS_REQUIRED(Locks::heap_bitmap_lock_)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
 
+  // Orders the mark stack by the NUMA node of the objects and sets up numa_seeds_ for it.
+  void SortMarkStackByNumaNode();
+
+  // Hands out the next chunk of at most chunk_size seeds of node, or of another node once node has
+  // none left. Returns false once all seeds are handed out.
+  bool ClaimNumaSeeds(size_t node, size_t chunk_size, mirror::Object*** begin,
+                      mirror::Object*** end);
+
   void EnqueueFinalizerReferences(mirror::Object** ref)
       EXCLUSIVE_LOCKS_REQUIRED(Locks::heap_bitmap_lock_)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
@@ -380,9 +415,25 @@ class MarkSweep : public GarbageCollector {
       EXCLUSIVE_LOCKS_REQUIRED(Locks::heap_bitmap_lock_)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
 
+  // Forgets the ages of soft references that died in this collection, and of those it scanned
+  // without finding their referent white.
+  void SweepSoftReferenceAges()
+      SHARED_LOCKS_REQUIRED(Locks::heap_bitmap_lock_, Locks::mutator_lock_);
+
   void ClearWhiteReferences(mirror::Object** list)
       SHARED_LOCKS_REQUIRED(Locks::heap_bitmap_lock_, Locks::mutator_lock_);
 
+  // Drops the references whose referents are already marked from the pending lists so that the
+  // paused reference processing only has to look at references which may need clearing. Safe to
+  // call while mutators are running since marks are never cleared during a GC.
+  void PreProcessReferences(Thread* self)
+      EXCLUSIVE_LOCKS_REQUIRED(Locks::heap_bitmap_lock_)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
+  void FilterMarkedReferences(mirror::Object** list, Mutex* lock)
+      EXCLUSIVE_LOCKS_REQUIRED(Locks::heap_bitmap_lock_)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
   void ProcessReferences(mirror::Object** soft_references, bool clear_soft_references,
                          mirror::Object** weak_references,
                          mirror::Object** finalizer_references,
@@ -405,6 +456,22 @@ class MarkSweep : public GarbageCollector {
 
   accounting::ObjectStack* mark_stack_;
 
+  // Deques of gray objects for the work stealing parallel mark stack processing, one per GC thread,
+  // created on first use.
+  std::vector<accounting::ObjectDeque*> mark_deques_;
+
+  // Number of work stealing mark tasks which are still working through their own gray objects.
+  AtomicInteger active_mark_tasks_;
+
+  // In NUMA mode the work stealing mark tasks take their seeds from the part of the mark stack on
+  // their own node, and steal from tasks on their own node first. numa_seeds_[n] is where the
+  // objects of node n start on the mark stack, followed by the end of the mark stack.
+  std::vector<mirror::Object**> numa_seeds_;
+  // How many of each node's seeds have been handed out.
+  std::vector<AtomicInteger> numa_seeds_claimed_;
+  // The node each work stealing mark task runs on.
+  std::vector<size_t> mark_task_nodes_;
+
   // Immune range, every object inside the immune range is assumed to be marked.
   mirror::Object* immune_begin_;
   mirror::Object* immune_end_;
@@ -425,6 +492,9 @@ class MarkSweep : public GarbageCollector {
   AtomicInteger freed_objects_;
   // Number of freed large objects.
   AtomicInteger freed_large_objects_;
+  // See GetSoftReferencesPreserved.
+  size_t soft_references_preserved_;
+  size_t soft_references_cleared_;
   // Number of classes scanned, if kCountScannedTypes.
   AtomicInteger class_count_;
   // Number of arrays scanned, if kCountScannedTypes.
@@ -443,6 +513,12 @@ class MarkSweep : public GarbageCollector {
   // Verification.
   size_t live_stack_freeze_size_;
 
+  // Unique to each collection, see Thread::SetRootsScanned.
+  uint32_t root_scan_id_;
+  // Threads whose roots the pause re-marked or could skip as unchanged.
+  size_t threads_remarked_;
+  size_t threads_unchanged_;
+
   UniquePtr<Barrier> gc_barrier_;
   Mutex large_object_lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
   Mutex mark_stack_lock_ ACQUIRED_AFTER(Locks::classlinker_classes_lock_);
@@ -454,6 +530,8 @@ class MarkSweep : public GarbageCollector {
  private:
   friend class AddIfReachesAllocSpaceVisitor;  // Used by mod-union table.
   friend class CardScanTask;
+  friend class SweepTask;
+  friend class WorkStealingMarkTask;
   friend class CheckBitmapVisitor;
   friend class CheckReferenceVisitor;
   friend class art::gc::Heap;
@@ -25,6 +25,10 @@ namespace art {
 namespace gc {
 namespace collector {
 
+// Collects only the objects allocated since the last GC. The allocation stack stands in for a
+// nursery and aged cards for the remembered set. Objects are not evacuated: the runtime keeps raw
+// object pointers across suspend points and root visitors cannot update roots, so a minor GC has
+// to mark and sweep the allocated objects in place.
 class StickyMarkSweep : public PartialMarkSweep {
  public:
   GcType GetGcType() const {
@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "gc_event_log.h"
+
+#include "base/histogram-inl.h"
+#include "cutils/atomic-inline.h"
+#include "thread.h"
+
+namespace art {
+namespace gc {
+
+static const char* const kPauseHistogramNames[collector::kGcTypeMax] = {
+  "none pauses",
+  "sticky pauses",
+  "partial pauses",
+  "full pauses",
+};
+
+GcEventLog::GcEventLog()
+    : next_sequence_number_(0), histogram_lock_("gc event log histogram lock") {
+  for (size_t i = 0; i < kCapacity; ++i) {
+    slots_[i].version = 0;
+  }
+  for (size_t i = 0; i < collector::kGcTypeMax; ++i) {
+    // Buckets of 50us to start with, as for the cumulative GC timings.
+    pause_histograms_[i] = new Histogram<uint64_t>(kPauseHistogramNames[i], 50);
+  }
+}
+
+GcEventLog::~GcEventLog() {
+  for (size_t i = 0; i < collector::kGcTypeMax; ++i) {
+    delete pause_histograms_[i];
+  }
+}
+
+void GcEventLog::Record(const Event& event) {
+  uint32_t sequence_number = next_sequence_number_;
+  Slot* slot = &slots_[sequence_number % kCapacity];
+  // An odd version tells readers the slot is being rewritten.
+  slot->version = slot->version + 1;
+  ANDROID_MEMBAR_STORE();
+  slot->event = event;
+  slot->event.sequence_number = sequence_number;
+  ANDROID_MEMBAR_STORE();
+  slot->version = slot->version + 1;
+  next_sequence_number_ = sequence_number + 1;
+
+  MutexLock mu(Thread::Current(), histogram_lock_);
+  Histogram<uint64_t>* histogram = pause_histograms_[event.type];
+  for (size_t i = 0; i < event.pause_count; ++i) {
+    histogram->AddValue(event.pause_ns[i] / 1000);
+  }
+}
+
+void GcEventLog::GetEvents(std::vector<Event>* events) const {
+  events->clear();
+  uint32_t end = next_sequence_number_;
+  ANDROID_MEMBAR_FULL();
+  uint32_t begin = (end > kCapacity) ? end - kCapacity : 0;
+  for (uint32_t i = begin; i != end; ++i) {
+    const Slot* slot = &slots_[i % kCapacity];
+    uint32_t version = slot->version;
+    if ((version & 1) != 0) {
+      continue;
+    }
+    ANDROID_MEMBAR_FULL();
+    Event event = slot->event;
+    ANDROID_MEMBAR_FULL();
+    // Skip events that were overwritten by a newer one, entirely or while we copied them.
+    if (slot->version == version && event.sequence_number == i) {
+      events->push_back(event);
+    }
+  }
+}
+
+void GcEventLog::GetPauseStats(collector::GcType type, PauseStats* stats) {
+  MutexLock mu(Thread::Current(), histogram_lock_);
+  Histogram<uint64_t>* histogram = pause_histograms_[type];
+  stats->count = histogram->SampleSize();
+  if (stats->count == 0) {
+    stats->p50_ns = stats->p90_ns = stats->p99_ns = stats->max_ns = 0;
+    return;
+  }
+  Histogram<uint64_t>::CumulativeData data;
+  histogram->CreateHistogram(data);
+  stats->p50_ns = static_cast<uint64_t>(histogram->Percentile(0.50, data) * 1000);
+  stats->p90_ns = static_cast<uint64_t>(histogram->Percentile(0.90, data) * 1000);
+  stats->p99_ns = static_cast<uint64_t>(histogram->Percentile(0.99, data) * 1000);
+  stats->max_ns = histogram->Max() * 1000;
+}
+
+}  // namespace gc
+}  // namespace art
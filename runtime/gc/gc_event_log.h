@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ART_RUNTIME_GC_GC_EVENT_LOG_H_
+#define ART_RUNTIME_GC_GC_EVENT_LOG_H_
+
+#include <vector>
+
+#include "base/histogram.h"
+#include "base/macros.h"
+#include "base/mutex.h"
+#include "gc/collector/gc_type.h"
+#include "gc/heap.h"
+
+namespace art {
+namespace gc {
+
+// A fixed size log of the most recent garbage collections, kept in machine readable form for
+// monitoring tools, along with a histogram of pause times per GC type.
+//
+// Collections are serialized by the heap, so the log has a single writer. Readers copy events out
+// without blocking it: each slot carries a version which is odd while the slot is being written,
+// and a copy is only kept if the version was even and unchanged across it.
+class GcEventLog {
+ public:
+  static const size_t kCapacity = 64;
+  static const size_t kMaxPauses = 4;
+  static const size_t kMaxPhases = 24;
+
+  struct Phase {
+    // A TimingLogger split label, which are string literals.
+    const char* label;
+    uint64_t duration_ns;
+  };
+
+  struct Event {
+    // Position of the event in the sequence of all recorded events, starting at 0.
+    uint32_t sequence_number;
+    // Monotonic time at which the collection started.
+    uint64_t start_time_ns;
+    GcCause cause;
+    collector::GcType type;
+    bool concurrent;
+    uint64_t duration_ns;
+    size_t pause_count;
+    uint64_t pause_ns[kMaxPauses];
+    uint64_t freed_objects;
+    uint64_t freed_bytes;
+    uint64_t freed_large_objects;
+    uint64_t freed_large_object_bytes;
+    uint64_t bytes_allocated_before;
+    uint64_t bytes_allocated_after;
+    uint64_t total_memory;
+    size_t phase_count;
+    Phase phases[kMaxPhases];
+  };
+
+  struct PauseStats {
+    uint64_t count;
+    uint64_t p50_ns;
+    uint64_t p90_ns;
+    uint64_t p99_ns;
+    uint64_t max_ns;
+  };
+
+  GcEventLog();
+  ~GcEventLog();
+
+  // Records a finished collection, assigning its sequence number. Only called by the thread that
+  // ran the collection.
+  void Record(const Event& event) LOCKS_EXCLUDED(histogram_lock_);
+
+  // Copies out the events in the log, oldest first. Events overwritten while being copied are
+  // left out.
+  void GetEvents(std::vector<Event>* events) const;
+
+  // Returns the number of events ever recorded.
+  uint32_t GetEventCount() const {
+    return next_sequence_number_;
+  }
+
+  void GetPauseStats(collector::GcType type, PauseStats* stats) LOCKS_EXCLUDED(histogram_lock_);
+
+ private:
+  struct Slot {
+    volatile uint32_t version;
+    Event event;
+  };
+
+  Slot slots_[kCapacity];
+  volatile uint32_t next_sequence_number_;
+
+  Mutex histogram_lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
+  // Pause times in microseconds, indexed by GC type.
+  Histogram<uint64_t>* pause_histograms_[collector::kGcTypeMax] GUARDED_BY(histogram_lock_);
+
+  DISALLOW_COPY_AND_ASSIGN(GcEventLog);
+};
+
+}  // namespace gc
+}  // namespace art
+
+#endif  // ART_RUNTIME_GC_GC_EVENT_LOG_H_
@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "gc_event_log.h"
+
+#include "common_test.h"
+
+namespace art {
+namespace gc {
+
+class GcEventLogTest : public CommonTest {};
+
+static GcEventLog::Event MakeEvent(collector::GcType type, uint64_t pause_ns) {
+  GcEventLog::Event event;
+  memset(&event, 0, sizeof(event));
+  event.cause = kGcCauseExplicit;
+  event.type = type;
+  event.pause_count = 1;
+  event.pause_ns[0] = pause_ns;
+  event.phase_count = 1;
+  event.phases[0].label = "MarkingPhase";
+  event.phases[0].duration_ns = pause_ns;
+  return event;
+}
+
+TEST_F(GcEventLogTest, RecordAndWrap) {
+  GcEventLog log;
+  std::vector<GcEventLog::Event> events;
+  log.GetEvents(&events);
+  EXPECT_TRUE(events.empty());
+
+  log.Record(MakeEvent(collector::kGcTypeFull, 1000000));
+  log.GetEvents(&events);
+  ASSERT_EQ(1U, events.size());
+  EXPECT_EQ(0U, events[0].sequence_number);
+  EXPECT_EQ(collector::kGcTypeFull, events[0].type);
+
+  // Once full, only the newest events are kept, oldest first.
+  const size_t total = GcEventLog::kCapacity + 10;
+  for (size_t i = 1; i < total; ++i) {
+    log.Record(MakeEvent(collector::kGcTypeSticky, i * 1000));
+  }
+  EXPECT_EQ(total, log.GetEventCount());
+  log.GetEvents(&events);
+  ASSERT_EQ(GcEventLog::kCapacity, events.size());
+  for (size_t i = 0; i < events.size(); ++i) {
+    EXPECT_EQ(total - GcEventLog::kCapacity + i, events[i].sequence_number);
+  }
+}
+
+TEST_F(GcEventLogTest, PauseStats) {
+  GcEventLog log;
+  GcEventLog::PauseStats stats;
+  log.GetPauseStats(collector::kGcTypePartial, &stats);
+  EXPECT_EQ(0U, stats.count);
+
+  for (size_t i = 1; i <= 100; ++i) {
+    log.Record(MakeEvent(collector::kGcTypePartial, i * 100000));
+  }
+  log.GetPauseStats(collector::kGcTypePartial, &stats);
+  EXPECT_EQ(100U, stats.count);
+  EXPECT_EQ(10000000U, stats.max_ns);
+  EXPECT_LE(stats.p50_ns, stats.p90_ns);
+  EXPECT_LE(stats.p90_ns, stats.p99_ns);
+  EXPECT_LE(stats.p99_ns, stats.max_ns);
+
+  // Other GC types are tracked separately.
+  log.GetPauseStats(collector::kGcTypeFull, &stats);
+  EXPECT_EQ(0U, stats.count);
+}
+
+}  // namespace gc
+}  // namespace art
@@ -20,9 +20,12 @@
 #include <cutils/trace.h>
 
 #include <limits>
+#include <sched.h>
 #include <vector>
 #include <valgrind.h>
+#include <zlib.h>
 
+#include "base/histogram-inl.h"
 #include "base/stl_util.h"
 #include "common_throws.h"
 #include "cutils/sched_policy.h"
@@ -32,20 +35,24 @@
 #include "gc/accounting/heap_bitmap-inl.h"
 #include "gc/accounting/mod_union_table-inl.h"
 #include "gc/accounting/space_bitmap-inl.h"
+#include "gc/allocation_sampler.h"
 #include "gc/collector/mark_sweep-inl.h"
 #include "gc/collector/partial_mark_sweep.h"
 #include "gc/collector/sticky_mark_sweep.h"
+#include "gc/gc_event_log.h"
 #include "gc/space/dlmalloc_space-inl.h"
 #include "gc/space/image_space.h"
 #include "gc/space/large_object_space.h"
 #include "gc/space/space-inl.h"
 #include "image.h"
 #include "invoke_arg_array_builder.h"
+#include "mem_map.h"
 #include "mirror/art_field-inl.h"
 #include "mirror/class-inl.h"
 #include "mirror/object.h"
 #include "mirror/object-inl.h"
 #include "mirror/object_array-inl.h"
+#include "numa.h"
 #include "object_utils.h"
 #include "os.h"
 #include "ScopedLocalRef.h"
@@ -60,32 +67,67 @@ namespace gc {
 
 static constexpr bool kGCALotMode = false;
 static constexpr size_t kGcAlotInterval = KB;
-static constexpr bool kDumpGcPerformanceOnShutdown = false;
 // Minimum amount of remaining bytes before a concurrent GC is triggered.
 static constexpr size_t kMinConcurrentRemainingBytes = 128 * KB;
 // If true, measure the total allocation time.
 static constexpr bool kMeasureAllocationTime = false;
+// Serve small alloc space allocations from per-thread caches of pre-allocated chunks.
+static constexpr bool kUseThreadLocalAllocCache = true;
+// How many allocation stack slots a thread claims at a time, so that only claiming them is atomic.
+static constexpr size_t kThreadLocalAllocationStackSize = 128;
+// How much the latest GC counts towards the moving average of the fraction of time GCs take.
+static constexpr double kGcCpuFractionWeight = 0.25;
+// How far, and how quickly, the adaptive growth policy scales the free space.
+static constexpr double kMinFreeSpaceScale = 0.25;
+static constexpr double kMaxFreeSpaceScale = 8.0;
+static constexpr double kFreeSpaceScaleStep = 1.25;
+// Bounds of how many times the allocation expected during a concurrent GC is left free when it
+// starts, how much an allocation waiting for a GC raises it and how much a GC lowers it by.
+static constexpr double kMinConcurrentStartMargin = 1.25;
+static constexpr double kMaxConcurrentStartMargin = 4.0;
+static constexpr double kConcurrentStartMarginRaise = 1.5;
+static constexpr double kConcurrentStartMarginDecay = 0.95;
 
 Heap::Heap(size_t initial_size, size_t growth_limit, size_t min_free, size_t max_free,
            double target_utilization, size_t capacity, const std::string& original_image_file_name,
-           bool concurrent_gc, size_t parallel_gc_threads, size_t conc_gc_threads,
+           ptrdiff_t image_relocation_delta, bool concurrent_gc, size_t parallel_gc_threads, size_t conc_gc_threads,
            bool low_memory_mode, size_t long_pause_log_threshold, size_t long_gc_log_threshold,
-           bool ignore_max_footprint)
+           bool ignore_max_footprint, bool use_run_alloc_space,
+           bool dump_gc_performance_on_shutdown, bool track_zygote_dirty_pages)
     : alloc_space_(NULL),
       card_table_(NULL),
       concurrent_gc_(concurrent_gc),
       parallel_gc_threads_(parallel_gc_threads),
       conc_gc_threads_(conc_gc_threads),
       low_memory_mode_(low_memory_mode),
+      use_run_alloc_space_(use_run_alloc_space),
       long_pause_log_threshold_(long_pause_log_threshold),
       long_gc_log_threshold_(long_gc_log_threshold),
       ignore_max_footprint_(ignore_max_footprint),
+      dump_gc_performance_on_shutdown_(dump_gc_performance_on_shutdown),
+      track_zygote_dirty_pages_(track_zygote_dirty_pages),
       have_zygote_space_(false),
       soft_ref_queue_lock_(NULL),
       weak_ref_queue_lock_(NULL),
       finalizer_ref_queue_lock_(NULL),
       phantom_ref_queue_lock_(NULL),
+      allocation_stack_summary_lock_(NULL),
+      summarized_stack_(NULL),
+      summarized_layout_version_(0),
+      summarized_end_(0),
+      pending_references_lock_(NULL),
+      pending_finalizer_references_(NULL),
+      pending_references_(NULL),
+      pending_reference_count_(0),
+      reference_enqueue_task_queued_(false),
+      references_enqueued_(0),
+      finalizer_references_enqueued_(0),
+      reference_batches_(0),
+      max_reference_batch_(0),
+      max_pending_references_(0),
+      reference_enqueue_ns_(0),
       is_gc_running_(false),
+      gc_epoch_(0),
       last_gc_type_(collector::kGcTypeNone),
       next_gc_type_(collector::kGcTypePartial),
       capacity_(capacity),
@@ -93,6 +135,7 @@ Heap::Heap(size_t initial_size, size_t growth_limit, size_t min_free, size_t max
       max_allowed_footprint_(initial_size),
       native_footprint_gc_watermark_(initial_size),
       native_footprint_limit_(2 * initial_size),
+      native_blocking_gc_bytes_(0),
       activity_thread_class_(NULL),
       application_thread_class_(NULL),
       activity_thread_(NULL),
@@ -101,6 +144,7 @@ Heap::Heap(size_t initial_size, size_t growth_limit, size_t min_free, size_t max
       // Initially care about pauses in case we never get notified of process states, or if the JNI
       // code becomes broken.
       care_about_pause_times_(true),
+      background_collection_pending_(0),
       concurrent_start_bytes_(concurrent_gc_ ? initial_size - kMinConcurrentRemainingBytes
           :  std::numeric_limits<size_t>::max()),
       total_bytes_freed_ever_(0),
@@ -108,16 +152,32 @@ Heap::Heap(size_t initial_size, size_t growth_limit, size_t min_free, size_t max
       large_object_threshold_(3 * kPageSize),
       num_bytes_allocated_(0),
       native_bytes_allocated_(0),
+      native_gc_requests_(0),
+      native_blocking_gcs_(0),
+      explicit_gc_requests_(0),
+      explicit_gcs_(0),
+      explicit_gc_pending_(0),
       gc_memory_overhead_(0),
       verify_missing_card_marks_(false),
       verify_system_weaks_(false),
       verify_pre_gc_heap_(false),
       verify_post_gc_heap_(false),
       verify_mod_union_table_(false),
+      verification_sampling_(1),
+      verification_sample_(0),
+      reference_enqueue_threads_(0),
+      num_numa_nodes_(0),
       min_alloc_space_size_for_sticky_gc_(2 * MB),
       min_remaining_space_for_sticky_gc_(1 * MB),
       last_trim_time_ms_(0),
+      total_trims_(0),
+      total_trim_slices_(0),
+      total_trimmed_bytes_(0),
+      longest_trim_slice_ns_(0),
       allocation_rate_(0),
+      thread_allocation_rate_(0),
+      concurrent_gc_duration_ns_(0),
+      concurrent_start_margin_(kMinConcurrentStartMargin),
       /* For GC a lot mode, we limit the allocations stacks to be kGcAlotInterval allocations. This
        * causes a lot of GC since we do a GC for alloc whenever the stack is full. When heap
        * verification is enabled, we limit the size of allocation stacks to speed up their
@@ -133,7 +193,15 @@ Heap::Heap(size_t initial_size, size_t growth_limit, size_t min_free, size_t max
       min_free_(min_free),
       max_free_(max_free),
       target_utilization_(target_utilization),
+      target_gc_cpu_fraction_(0.0),
+      pause_budget_ns_(std::numeric_limits<uint64_t>::max()),
+      soft_reference_ms_per_mb_(kDefaultSoftReferenceMsPerMb),
+      soft_reference_gc_(0),
+      gc_cpu_fraction_(0.0),
+      free_space_scale_(1.0),
       total_wait_time_(0),
+      native_blocking_time_(0),
+      last_explicit_gc_ns_(0),
       total_allocation_time_(0),
       verify_object_mode_(kHeapVerificationNotPermitted),
       running_on_valgrind_(RUNNING_ON_VALGRIND) {
@@ -148,7 +216,8 @@ Heap::Heap(size_t initial_size, size_t growth_limit, size_t min_free, size_t max
   byte* requested_alloc_space_begin = NULL;
   std::string image_file_name(original_image_file_name);
   if (!image_file_name.empty()) {
-    space::ImageSpace* image_space = space::ImageSpace::Create(image_file_name);
+    space::ImageSpace* image_space = space::ImageSpace::Create(image_file_name,
+                                                               image_relocation_delta);
     CHECK(image_space != NULL) << "Failed to create space for " << image_file_name;
     AddContinuousSpace(image_space);
     // Oat files referenced by image files immediately follow them in memory, ensure alloc space
@@ -160,12 +229,35 @@ Heap::Heap(size_t initial_size, size_t growth_limit, size_t min_free, size_t max
           reinterpret_cast<byte*>(RoundUp(reinterpret_cast<uintptr_t>(oat_file_end_addr),
                                           kPageSize));
     }
+    if (!Runtime::Current()->IsCompiler()) {
+      // App images are mapped later on, keep room for them between the oat file and the alloc
+      // space.
+      app_image_reservation_.reset(MemMap::MapAnonymous("app image reservation",
+                                                        requested_alloc_space_begin,
+                                                        kAppImageReservationSize, PROT_NONE));
+      if (app_image_reservation_.get() != NULL &&
+          app_image_reservation_->Begin() != requested_alloc_space_begin) {
+        app_image_reservation_.reset();
+      }
+      if (app_image_reservation_.get() == NULL) {
+        LOG(WARNING) << "Failed to reserve address space for app images";
+      } else {
+        requested_alloc_space_begin = app_image_reservation_->End();
+      }
+    }
+    if (MemMap::UseHugePages()) {
+      // Start on a huge page boundary for the alloc space to be backed by huge pages.
+      requested_alloc_space_begin =
+          reinterpret_cast<byte*>(RoundUp(reinterpret_cast<uintptr_t>(requested_alloc_space_begin),
+                                          MemMap::kHugePageSize));
+    }
   }
 
   alloc_space_ = space::DlMallocSpace::Create(Runtime::Current()->IsZygote() ? "zygote space" : "alloc space",
                                               initial_size,
                                               growth_limit, capacity,
-                                              requested_alloc_space_begin);
+                                              requested_alloc_space_begin,
+                                              use_run_alloc_space);
   CHECK(alloc_space_ != NULL) << "Failed to create alloc space";
   alloc_space_->SetFootprintLimit(alloc_space_->Capacity());
   AddContinuousSpace(alloc_space_);
@@ -207,6 +299,9 @@ Heap::Heap(size_t initial_size, size_t growth_limit, size_t min_free, size_t max
                                                           max_allocation_stack_size_));
   live_stack_.reset(accounting::ObjectStack::Create("live stack",
                                                     max_allocation_stack_size_));
+  allocation_stack_bitmap_.reset(accounting::SpaceBitmap::Create("allocation stack bitmap",
+                                                                 heap_begin, heap_capacity));
+  CHECK(allocation_stack_bitmap_.get() != NULL) << "Failed to create allocation stack bitmap";
 
   // It's still too early to take a lock because there are no threads yet, but we can create locks
   // now. We don't create it earlier to make it clear that you can't use locks during heap
@@ -220,6 +315,11 @@ Heap::Heap(size_t initial_size, size_t growth_limit, size_t min_free, size_t max
   weak_ref_queue_lock_ = new Mutex("Weak reference queue lock");
   finalizer_ref_queue_lock_ = new Mutex("Finalizer reference queue lock");
   phantom_ref_queue_lock_ = new Mutex("Phantom reference queue lock");
+  pinned_objects_lock_ = new Mutex("Pinned objects lock", kPinTableLock);
+  pending_references_lock_ = new Mutex("Pending references lock");
+  allocation_stack_summary_lock_ = new Mutex("Allocation stack summary lock");
+  allocation_sampler_.reset(new AllocationSampler);
+  gc_event_log_.reset(new GcEventLog);
 
   last_gc_time_ns_ = NanoTime();
   last_gc_size_ = GetBytesAllocated();
@@ -248,10 +348,16 @@ void Heap::CreateThreadPool() {
   if (num_threads != 0) {
     thread_pool_.reset(new ThreadPool(num_threads));
   }
+  if (reference_enqueue_threads_ != 0) {
+    reference_enqueue_pool_.reset(new ThreadPool(reference_enqueue_threads_));
+    reference_enqueue_pool_->StartWorkers(Thread::Current());
+  }
 }
 
 void Heap::DeleteThreadPool() {
   thread_pool_.reset(nullptr);
+  // References still pending are dropped, as they are when the runtime isn't started.
+  reference_enqueue_pool_.reset(nullptr);
 }
 
 static bool ReadStaticInt(JNIEnvExt* env, jclass clz, const char* name, int* out_value) {
@@ -364,8 +470,12 @@ void Heap::ListenForProcessStateChange() {
     int process_state = env->GetIntField(application_thread_, last_process_state_id_);
     env->ExceptionClear();
 
+    const bool cared_about_pause_times = care_about_pause_times_;
     care_about_pause_times_ = process_state_cares_about_pause_time_.find(process_state) !=
         process_state_cares_about_pause_time_.end();
+    if (cared_about_pause_times && !care_about_pause_times_) {
+      background_collection_pending_ = 1;
+    }
 
     VLOG(heap) << "New process state " << process_state
                << " care about pauses " << care_about_pause_times_;
@@ -450,6 +560,17 @@ void Heap::DumpGcPerformanceInfo(std::ostream& os) {
          << " objects with total size " << PrettySize(freed_bytes) << "\n"
          << collector->GetName() << " throughput: " << freed_objects / seconds << "/s / "
          << PrettySize(freed_bytes / seconds) << "/s\n";
+      Histogram<uint64_t>& pauses = collector->GetPauseHistogram();
+      if (pauses.SampleSize() != 0) {
+        // The histogram holds microseconds.
+        Histogram<uint64_t>::CumulativeData data;
+        pauses.CreateHistogram(data);
+        os << collector->GetName() << " pauses: " << pauses.SampleSize()
+           << " p50: " << PrettyDuration(pauses.Percentile(0.50, data) * 1000)
+           << " p90: " << PrettyDuration(pauses.Percentile(0.90, data) * 1000)
+           << " p99: " << PrettyDuration(pauses.Percentile(0.99, data) * 1000)
+           << " max: " << PrettyDuration(pauses.Max() * 1000) << "\n";
+      }
       total_duration += total_ns;
       total_paused_time += total_pause_ns;
     }
@@ -474,11 +595,43 @@ void Heap::DumpGcPerformanceInfo(std::ostream& os) {
   }
   os << "Total mutator paused time: " << PrettyDuration(total_paused_time) << "\n";
   os << "Total time waiting for GC to complete: " << PrettyDuration(total_wait_time_) << "\n";
+  {
+    MutexLock mu(Thread::Current(), *pending_references_lock_);
+    if (reference_batches_ != 0) {
+      os << "References enqueued: " << references_enqueued_ << " ("
+         << finalizer_references_enqueued_ << " finalizer) in " << reference_batches_
+         << " batches, max batch " << max_reference_batch_ << ", time "
+         << PrettyDuration(reference_enqueue_ns_) << "\n";
+    }
+    if (max_pending_references_ != 0) {
+      os << "Pending references: " << pending_reference_count_ << ", max "
+         << max_pending_references_ << "\n";
+    }
+  }
+  if (target_gc_cpu_fraction_ != 0.0) {
+    os << "GC CPU fraction: " << gc_cpu_fraction_ << " (target " << target_gc_cpu_fraction_
+       << "), free space scale " << free_space_scale_ << "\n";
+  }
+  if (concurrent_gc_duration_ns_ != 0) {
+    os << "Mean concurrent GC duration: " << PrettyDuration(concurrent_gc_duration_ns_)
+       << ", started with " << concurrent_start_margin_ << "x the allocation expected during it"
+       << " left free\n";
+  }
+  os << "Explicit GCs: " << GetExplicitGcRequestCount() << " requested, " << GetExplicitGcCount()
+     << " run or requested concurrently\n";
+  os << "Native bytes allocated: " << PrettySize(GetNativeBytesAllocated()) << ", "
+     << GetNativeGcRequestCount() << " concurrent GCs requested, " << GetNativeBlockingGcCount()
+     << " GCs waited for in " << PrettyDuration(native_blocking_time_) << "\n";
+  if (total_trims_ != 0) {
+    os << "Heap trims: " << total_trims_ << " in " << total_trim_slices_ << " slices, released "
+       << PrettySize(total_trimmed_bytes_) << ", longest slice "
+       << PrettyDuration(longest_trim_slice_ns_) << "\n";
+  }
   os << "Approximate GC data structures memory overhead: " << gc_memory_overhead_;
 }
 
 Heap::~Heap() {
-  if (kDumpGcPerformanceOnShutdown) {
+  if (dump_gc_performance_on_shutdown_) {
     DumpGcPerformanceInfo(LOG(INFO));
   }
 
@@ -500,6 +653,9 @@ Heap::~Heap() {
   delete weak_ref_queue_lock_;
   delete finalizer_ref_queue_lock_;
   delete phantom_ref_queue_lock_;
+  delete pinned_objects_lock_;
+  delete pending_references_lock_;
+  delete allocation_stack_summary_lock_;
 }
 
 space::ContinuousSpace* Heap::FindContinuousSpaceFromObject(const mirror::Object* obj,
@@ -545,6 +701,52 @@ space::ImageSpace* Heap::GetImageSpace() const {
   return NULL;
 }
 
+byte* Heap::AllocAppImageRange(size_t size) {
+  if (app_image_reservation_.get() == NULL) {
+    return NULL;
+  }
+  size = RoundUp(size, kPageSize);
+  while (true) {
+    int32_t used = app_image_reservation_used_;
+    if (size > app_image_reservation_->Size() - used) {
+      return NULL;
+    }
+    if (app_image_reservation_used_.compare_and_swap(used, used + size)) {
+      return app_image_reservation_->Begin() + used;
+    }
+  }
+}
+
+void Heap::AddAppImageSpace(space::ImageSpace* space) {
+  DCHECK(app_image_reservation_.get() != NULL);
+  DCHECK_GE(space->Begin(), app_image_reservation_->Begin());
+  DCHECK_LE(space->End(), app_image_reservation_->End());
+  Thread* self = Thread::Current();
+  ScopedThreadStateChange tsc(self, kWaitingPerformingGc);
+  // Take the place of a GC so that none runs while the spaces change, and suspend the mutators
+  // which look up spaces without locks.
+  bool claimed = false;
+  while (!claimed) {
+    {
+      MutexLock mu(self, *gc_complete_lock_);
+      if (!is_gc_running_) {
+        is_gc_running_ = true;
+        claimed = true;
+      }
+    }
+    if (!claimed) {
+      WaitForConcurrentGcToComplete(self);
+    }
+  }
+  ThreadList* thread_list = Runtime::Current()->GetThreadList();
+  thread_list->SuspendAll();
+  AddContinuousSpace(space);
+  thread_list->ResumeAll();
+  MutexLock mu(self, *gc_complete_lock_);
+  is_gc_running_ = false;
+  gc_complete_cond_->Broadcast(self);
+}
+
 static void MSpaceChunkCallback(void* start, void* end, size_t used_bytes, void* arg) {
   size_t chunk_size = reinterpret_cast<uint8_t*>(end) - reinterpret_cast<uint8_t*>(start);
   if (used_bytes < chunk_size) {
@@ -591,11 +793,15 @@ mirror::Object* Heap::AllocObject(Thread* self, mirror::Class* c, size_t byte_co
 
     // Record allocation after since we want to use the atomic add for the atomic fence to guard
     // the SetClass since we do not want the class to appear NULL in another thread.
-    RecordAllocation(bytes_allocated, obj);
+    RecordAllocation(self, bytes_allocated, obj);
+    self->RecordHeapAllocation(bytes_allocated);
 
     if (Dbg::IsAllocTrackingEnabled()) {
       Dbg::RecordAllocation(c, byte_count);
     }
+    if (UNLIKELY(allocation_sampler_->IsEnabled())) {
+      allocation_sampler_->RecordAllocation(self, c, bytes_allocated);
+    }
     if (UNLIKELY(static_cast<size_t>(num_bytes_allocated_) >= concurrent_start_bytes_)) {
       // The SirtRef is necessary since the calls in RequestConcurrentGC are a safepoint.
       SirtRef<mirror::Object> ref(self, obj);
@@ -674,7 +880,7 @@ bool Heap::IsLiveObjectLocked(const mirror::Object* obj, bool search_allocation_
         if (allocation_stack_->ContainsSorted(const_cast<mirror::Object*>(obj))) {
           return true;
         }
-      } else if (allocation_stack_->Contains(const_cast<mirror::Object*>(obj))) {
+      } else if (AllocationStackContains(obj)) {
         return true;
       }
     }
@@ -704,6 +910,50 @@ bool Heap::IsLiveObjectLocked(const mirror::Object* obj, bool search_allocation_
   return false;
 }
 
+bool Heap::AllocationStackContains(const mirror::Object* obj) {
+  MutexLock mu(Thread::Current(), *allocation_stack_summary_lock_);
+  const accounting::ObjectStack* stack = allocation_stack_.get();
+  if (stack != summarized_stack_ || stack->GetLayoutVersion() != summarized_layout_version_) {
+    allocation_stack_bitmap_->Clear();
+    summarized_large_objects_.clear();
+    unfilled_slots_.clear();
+    summarized_stack_ = stack;
+    summarized_layout_version_ = stack->GetLayoutVersion();
+    summarized_end_ = 0;
+  }
+  mirror::Object** const begin = stack->Begin();
+  const size_t end = stack->Size();
+  // Threads fill the slots of their segments as they allocate.
+  for (size_t i = 0; i < unfilled_slots_.size();) {
+    const mirror::Object* slot_obj = begin[unfilled_slots_[i]];
+    if (slot_obj == NULL) {
+      ++i;
+      continue;
+    }
+    if (allocation_stack_bitmap_->HasAddress(slot_obj)) {
+      allocation_stack_bitmap_->Set(slot_obj);
+    } else {
+      summarized_large_objects_.insert(slot_obj);
+    }
+    unfilled_slots_[i] = unfilled_slots_.back();
+    unfilled_slots_.pop_back();
+  }
+  for (; summarized_end_ < end; ++summarized_end_) {
+    const mirror::Object* slot_obj = begin[summarized_end_];
+    if (slot_obj == NULL) {
+      unfilled_slots_.push_back(summarized_end_);
+    } else if (allocation_stack_bitmap_->HasAddress(slot_obj)) {
+      allocation_stack_bitmap_->Set(slot_obj);
+    } else {
+      summarized_large_objects_.insert(slot_obj);
+    }
+  }
+  if (allocation_stack_bitmap_->HasAddress(obj)) {
+    return allocation_stack_bitmap_->Test(obj);
+  }
+  return summarized_large_objects_.find(obj) != summarized_large_objects_.end();
+}
+
 void Heap::VerifyObjectImpl(const mirror::Object* obj) {
   if (Thread::Current() == NULL ||
       Runtime::Current()->GetThreadList()->GetLockOwner() == Thread::Current()->GetTid()) {
@@ -719,12 +969,39 @@ void Heap::DumpSpaces() {
     LOG(INFO) << space << " " << *space << "\n"
               << live_bitmap << " " << *live_bitmap << "\n"
               << mark_bitmap << " " << *mark_bitmap;
+    std::vector<size_t> pages_per_node;
+    if (Numa::CountResidentPages(space->Begin(), space->End(), &pages_per_node)) {
+      std::ostringstream oss;
+      for (size_t node = 0; node < pages_per_node.size(); ++node) {
+        oss << " node " << node << ": " << PrettySize(pages_per_node[node] * kPageSize);
+      }
+      LOG(INFO) << space->GetName() << " resident on" << oss.str();
+    }
   }
   for (const auto& space : discontinuous_spaces_) {
     LOG(INFO) << space << " " << *space << "\n";
   }
 }
 
+void Heap::EnableNuma() {
+  if (Numa::NumNodes() == 1) {
+    LOG(WARNING) << "Ignoring NUMA mode on a host with a single NUMA node";
+    return;
+  }
+  num_numa_nodes_ = Numa::NumNodes();
+  PlaceOnNumaNodes(alloc_space_);
+}
+
+void Heap::PlaceOnNumaNodes(space::DlMallocSpace* space) {
+  byte* const limit = space->Begin() + space->NonGrowthLimitCapacity();
+  for (byte* region = space->Begin(); region < limit; ) {
+    byte* region_end = std::min(limit, reinterpret_cast<byte*>(
+        RoundDown(reinterpret_cast<uintptr_t>(region), kNumaRegionSize) + kNumaRegionSize));
+    Numa::PreferNode(region, region_end - region, NumaNodeOf(region));
+    region = region_end;
+  }
+}
+
 void Heap::VerifyObjectBody(const mirror::Object* obj) {
   CHECK(IsAligned<kObjectAlignment>(obj)) << "Object isn't aligned: " << obj;
   // Ignore early dawn of the universe verifications.
@@ -733,7 +1010,8 @@ void Heap::VerifyObjectBody(const mirror::Object* obj) {
   }
   const byte* raw_addr = reinterpret_cast<const byte*>(obj) +
       mirror::Object::ClassOffset().Int32Value();
-  const mirror::Class* c = *reinterpret_cast<mirror::Class* const *>(raw_addr);
+  const mirror::Class* c =
+      reinterpret_cast<const mirror::HeapReference<mirror::Class>*>(raw_addr)->AsMirrorPtr();
   if (UNLIKELY(c == NULL)) {
     LOG(FATAL) << "Null class in object: " << obj;
   } else if (UNLIKELY(!IsAligned<kObjectAlignment>(c))) {
@@ -743,9 +1021,11 @@ void Heap::VerifyObjectBody(const mirror::Object* obj) {
   // Note: we don't use the accessors here as they have internal sanity checks
   // that we don't want to run
   raw_addr = reinterpret_cast<const byte*>(c) + mirror::Object::ClassOffset().Int32Value();
-  const mirror::Class* c_c = *reinterpret_cast<mirror::Class* const *>(raw_addr);
+  const mirror::Class* c_c =
+      reinterpret_cast<const mirror::HeapReference<mirror::Class>*>(raw_addr)->AsMirrorPtr();
   raw_addr = reinterpret_cast<const byte*>(c_c) + mirror::Object::ClassOffset().Int32Value();
-  const mirror::Class* c_c_c = *reinterpret_cast<mirror::Class* const *>(raw_addr);
+  const mirror::Class* c_c_c =
+      reinterpret_cast<const mirror::HeapReference<mirror::Class>*>(raw_addr)->AsMirrorPtr();
   CHECK_EQ(c_c, c_c_c);
 
   if (verify_object_mode_ != kVerifyAllFast) {
@@ -771,7 +1051,7 @@ void Heap::VerifyHeap() {
   GetLiveBitmap()->Walk(Heap::VerificationCallback, this);
 }
 
-inline void Heap::RecordAllocation(size_t size, mirror::Object* obj) {
+inline void Heap::RecordAllocation(Thread* self, size_t size, mirror::Object* obj) {
   DCHECK(obj != NULL);
   DCHECK_GT(size, 0u);
   num_bytes_allocated_.fetch_add(size);
@@ -789,9 +1069,19 @@ inline void Heap::RecordAllocation(size_t size, mirror::Object* obj) {
 
   // This is safe to do since the GC will never free objects which are neither in the allocation
   // stack or the live bitmap.
-  while (!allocation_stack_->AtomicPushBack(obj)) {
+  if (UNLIKELY(!self->PushOnThreadLocalAllocationStack(obj))) {
+    PushOnThreadLocalAllocationStackWithRefill(self, obj);
+  }
+}
+
+void Heap::PushOnThreadLocalAllocationStackWithRefill(Thread* self, mirror::Object* obj) {
+  mirror::Object** start;
+  mirror::Object** end;
+  while (!allocation_stack_->AtomicBumpBack(kThreadLocalAllocationStackSize, &start, &end)) {
     CollectGarbageInternal(collector::kGcTypeSticky, kGcCauseForAlloc, false);
   }
+  self->SetThreadLocalAllocationStack(start, end);
+  CHECK(self->PushOnThreadLocalAllocationStack(obj));
 }
 
 void Heap::RecordFree(size_t freed_objects, size_t freed_bytes) {
@@ -841,7 +1131,11 @@ inline mirror::Object* Heap::TryToAllocate(Thread* self, space::DlMallocSpace* s
   if (UNLIKELY(IsOutOfMemoryOnAllocation(alloc_size, grow))) {
     return NULL;
   }
-  if (LIKELY(!running_on_valgrind_)) {
+  if (LIKELY(!running_on_valgrind_ && !use_run_alloc_space_)) {
+    if (kUseThreadLocalAllocCache && alloc_size <= space::DlMallocSpace::kMaxThreadLocalAllocSize &&
+        space == alloc_space_) {
+      return space->AllocThreadLocal(self, alloc_size, bytes_allocated);
+    }
     return space->AllocNonvirtual(self, alloc_size, bytes_allocated);
   } else {
     return space->Alloc(self, alloc_size, bytes_allocated);
@@ -867,6 +1161,12 @@ mirror::Object* Heap::AllocateInternalWithGc(Thread* self, space::AllocSpace* sp
                                              size_t alloc_size, size_t* bytes_allocated) {
   mirror::Object* ptr;
 
+  if (concurrent_gc_) {
+    // The concurrent GC started too late to keep up with allocation, start the next ones earlier.
+    concurrent_start_margin_ = std::min(concurrent_start_margin_ * kConcurrentStartMarginRaise,
+                                        kMaxConcurrentStartMargin);
+  }
+
   // The allocation failed. If the GC is running, block until it completes, and then retry the
   // allocation.
   collector::GcType last_gc = WaitForConcurrentGcToComplete(self);
@@ -940,6 +1240,20 @@ void Heap::SetTargetHeapUtilization(float target) {
   target_utilization_ = target;
 }
 
+void Heap::SetTargetGcCpuFraction(double fraction) {
+  DCHECK_GE(fraction, 0.0);
+  DCHECK_LT(fraction, 1.0);
+  target_gc_cpu_fraction_ = fraction;
+  free_space_scale_ = 1.0;
+}
+
+uint64_t Heap::GetSoftReferenceMaxAgeNs() const {
+  // Allocated bytes still include this GC's garbage, so the free heap is underestimated.
+  const int64_t free_bytes = GetMaxMemory() - static_cast<int64_t>(GetBytesAllocated());
+  const uint64_t free_mb = free_bytes > 0 ? static_cast<uint64_t>(free_bytes) / MB : 0;
+  return MsToNs(free_mb * soft_reference_ms_per_mb_);
+}
+
 void Heap::SetTargetHeapMinFree(size_t bytes) {
   min_free_ = bytes;
 }
@@ -999,34 +1313,120 @@ size_t Heap::GetBytesAllocatedEver() const {
   return total;
 }
 
+// Visits the live objects of one address range of a continuous space, or of a whole
+// discontinuous space, with the task's own copy of the visitor.
+template <typename Visitor>
+class LiveObjectVisitTask : public Task {
+ public:
+  LiveObjectVisitTask(const accounting::SpaceBitmap* bitmap, uintptr_t begin, uintptr_t end,
+                      const Visitor& visitor)
+      : bitmap_(bitmap), space_set_(NULL), begin_(begin), end_(end), visitor_(visitor) {
+  }
+
+  LiveObjectVisitTask(accounting::SpaceSetMap* space_set, const Visitor& visitor)
+      : bitmap_(NULL), space_set_(space_set), begin_(0), end_(0), visitor_(visitor) {
+  }
+
+  virtual void Run(Thread* self) NO_THREAD_SAFETY_ANALYSIS {
+    if (bitmap_ != NULL) {
+      bitmap_->VisitMarkedRange(begin_, end_, visitor_);
+    } else {
+      space_set_->Visit(visitor_);
+    }
+  }
+
+  const Visitor& GetVisitor() const {
+    return visitor_;
+  }
+
+ private:
+  const accounting::SpaceBitmap* const bitmap_;
+  accounting::SpaceSetMap* const space_set_;
+  const uintptr_t begin_;
+  const uintptr_t end_;
+  Visitor visitor_;
+
+  DISALLOW_COPY_AND_ASSIGN(LiveObjectVisitTask);
+};
+
+template <typename Visitor>
+void Heap::VisitLiveObjectsParallel(Thread* self, const Visitor& visitor,
+                                    std::vector<Visitor>* visitors) {
+  ThreadPool* thread_pool = GetThreadPool();
+  const size_t thread_count = (thread_pool != NULL) ? thread_pool->GetThreadCount() + 1 : 1;
+  // A few ranges per thread so that threads which finish early pick up more work. Ranges are
+  // page aligned so that no two tasks share a bitmap word.
+  const size_t range_count = thread_count * 4;
+  std::vector<LiveObjectVisitTask<Visitor>*> tasks;
+  for (const auto& space : continuous_spaces_) {
+    uintptr_t begin = reinterpret_cast<uintptr_t>(space->Begin());
+    uintptr_t end = reinterpret_cast<uintptr_t>(space->End());
+    const size_t delta = RoundUp((end - begin) / range_count + 1, kPageSize);
+    for (uintptr_t range_begin = begin; range_begin < end; range_begin += delta) {
+      tasks.push_back(new LiveObjectVisitTask<Visitor>(space->GetLiveBitmap(), range_begin,
+                                                       std::min(end, range_begin + delta),
+                                                       visitor));
+    }
+  }
+  for (const auto& space_set : live_bitmap_->discontinuous_space_sets_) {
+    tasks.push_back(new LiveObjectVisitTask<Visitor>(space_set, visitor));
+  }
+
+  if (thread_count > 1) {
+    for (LiveObjectVisitTask<Visitor>* task : tasks) {
+      thread_pool->AddTask(self, task);
+    }
+    thread_pool->SetMaxActiveWorkers(thread_count - 1);
+    thread_pool->StartWorkers(self);
+    thread_pool->Wait(self, true, true);
+    thread_pool->StopWorkers(self);
+  } else {
+    for (LiveObjectVisitTask<Visitor>* task : tasks) {
+      task->Run(self);
+    }
+  }
+
+  visitors->clear();
+  visitors->reserve(tasks.size());
+  for (LiveObjectVisitTask<Visitor>* task : tasks) {
+    visitors->push_back(task->GetVisitor());
+    delete task;
+  }
+}
+
 class InstanceCounter {
  public:
-  InstanceCounter(const std::vector<mirror::Class*>& classes, bool use_is_assignable_from, uint64_t* counts)
+  InstanceCounter(const std::vector<mirror::Class*>& classes, bool use_is_assignable_from)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_)
-      : classes_(classes), use_is_assignable_from_(use_is_assignable_from), counts_(counts) {
+      : classes_(&classes), use_is_assignable_from_(use_is_assignable_from),
+        counts_(classes.size(), 0) {
   }
 
   void operator()(const mirror::Object* o) const SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
-    for (size_t i = 0; i < classes_.size(); ++i) {
+    const std::vector<mirror::Class*>& classes = *classes_;
+    for (size_t i = 0; i < classes.size(); ++i) {
       const mirror::Class* instance_class = o->GetClass();
       if (use_is_assignable_from_) {
-        if (instance_class != NULL && classes_[i]->IsAssignableFrom(instance_class)) {
+        if (instance_class != NULL && classes[i]->IsAssignableFrom(instance_class)) {
           ++counts_[i];
         }
       } else {
-        if (instance_class == classes_[i]) {
+        if (instance_class == classes[i]) {
           ++counts_[i];
         }
       }
     }
   }
 
+  uint64_t GetCount(size_t i) const {
+    return counts_[i];
+  }
+
  private:
-  const std::vector<mirror::Class*>& classes_;
+  const std::vector<mirror::Class*>* classes_;
   bool use_is_assignable_from_;
-  uint64_t* const counts_;
-
-  DISALLOW_COPY_AND_ASSIGN(InstanceCounter);
+  // Mutable as bitmap visitors are const; each walker thread has its own copy.
+  mutable std::vector<uint64_t> counts_;
 };
 
 void Heap::CountInstances(const std::vector<mirror::Class*>& classes, bool use_is_assignable_from,
@@ -1038,16 +1438,38 @@ void Heap::CountInstances(const std::vector<mirror::Class*>& classes, bool use_i
   CollectGarbage(false);
   self->TransitionFromSuspendedToRunnable();
 
-  InstanceCounter counter(classes, use_is_assignable_from, counts);
-  ReaderMutexLock mu(self, *Locks::heap_bitmap_lock_);
-  GetLiveBitmap()->Visit(counter);
+  std::vector<InstanceCounter> counters;
+  {
+    ReaderMutexLock mu(self, *Locks::heap_bitmap_lock_);
+    VisitLiveObjectsParallel(self, InstanceCounter(classes, use_is_assignable_from), &counters);
+  }
+  for (const InstanceCounter& counter : counters) {
+    for (size_t i = 0; i < classes.size(); ++i) {
+      counts[i] += counter.GetCount(i);
+    }
+  }
+}
+
+// Appends the objects collected by each of 'visitors', in order, up to 'max_count' objects in
+// total if it's non-zero.
+template <typename Visitor>
+static void MergeCollectedObjects(const std::vector<Visitor>& visitors, int32_t max_count,
+                                  std::vector<mirror::Object*>& objects) {
+  for (const Visitor& visitor : visitors) {
+    const std::vector<mirror::Object*>& collected = visitor.GetObjects();
+    size_t count = collected.size();
+    if (max_count != 0) {
+      count = std::min(count, static_cast<uint32_t>(max_count) - objects.size());
+    }
+    objects.insert(objects.end(), collected.begin(), collected.begin() + count);
+  }
 }
 
 class InstanceCollector {
  public:
-  InstanceCollector(mirror::Class* c, int32_t max_count, std::vector<mirror::Object*>& instances)
+  InstanceCollector(mirror::Class* c, int32_t max_count)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_)
-      : class_(c), max_count_(max_count), instances_(instances) {
+      : class_(c), max_count_(max_count) {
   }
 
   void operator()(const mirror::Object* o) const SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
@@ -1059,12 +1481,14 @@ class InstanceCollector {
     }
   }
 
+  const std::vector<mirror::Object*>& GetObjects() const {
+    return instances_;
+  }
+
  private:
   mirror::Class* class_;
   uint32_t max_count_;
-  std::vector<mirror::Object*>& instances_;
-
-  DISALLOW_COPY_AND_ASSIGN(InstanceCollector);
+  mutable std::vector<mirror::Object*> instances_;
 };
 
 void Heap::GetInstances(mirror::Class* c, int32_t max_count,
@@ -1076,17 +1500,19 @@ void Heap::GetInstances(mirror::Class* c, int32_t max_count,
   CollectGarbage(false);
   self->TransitionFromSuspendedToRunnable();
 
-  InstanceCollector collector(c, max_count, instances);
-  ReaderMutexLock mu(self, *Locks::heap_bitmap_lock_);
-  GetLiveBitmap()->Visit(collector);
+  std::vector<InstanceCollector> collectors;
+  {
+    ReaderMutexLock mu(self, *Locks::heap_bitmap_lock_);
+    VisitLiveObjectsParallel(self, InstanceCollector(c, max_count), &collectors);
+  }
+  MergeCollectedObjects(collectors, max_count, instances);
 }
 
 class ReferringObjectsFinder {
  public:
-  ReferringObjectsFinder(mirror::Object* object, int32_t max_count,
-                         std::vector<mirror::Object*>& referring_objects)
+  ReferringObjectsFinder(mirror::Object* object, int32_t max_count)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_)
-      : object_(object), max_count_(max_count), referring_objects_(referring_objects) {
+      : object_(object), max_count_(max_count) {
   }
 
   // For bitmap Visit.
@@ -1104,12 +1530,14 @@ class ReferringObjectsFinder {
     }
   }
 
+  const std::vector<mirror::Object*>& GetObjects() const {
+    return referring_objects_;
+  }
+
  private:
   mirror::Object* object_;
   uint32_t max_count_;
-  std::vector<mirror::Object*>& referring_objects_;
-
-  DISALLOW_COPY_AND_ASSIGN(ReferringObjectsFinder);
+  mutable std::vector<mirror::Object*> referring_objects_;
 };
 
 void Heap::GetReferringObjects(mirror::Object* o, int32_t max_count,
@@ -1121,9 +1549,12 @@ void Heap::GetReferringObjects(mirror::Object* o, int32_t max_count,
   CollectGarbage(false);
   self->TransitionFromSuspendedToRunnable();
 
-  ReferringObjectsFinder finder(o, max_count, referring_objects);
-  ReaderMutexLock mu(self, *Locks::heap_bitmap_lock_);
-  GetLiveBitmap()->Visit(finder);
+  std::vector<ReferringObjectsFinder> finders;
+  {
+    ReaderMutexLock mu(self, *Locks::heap_bitmap_lock_);
+    VisitLiveObjectsParallel(self, ReferringObjectsFinder(o, max_count), &finders);
+  }
+  MergeCollectedObjects(finders, max_count, referring_objects);
 }
 
 void Heap::CollectGarbage(bool clear_soft_references) {
@@ -1134,6 +1565,42 @@ void Heap::CollectGarbage(bool clear_soft_references) {
   CollectGarbageInternal(collector::kGcTypeFull, kGcCauseExplicit, clear_soft_references);
 }
 
+void Heap::RequestExplicitGc(Thread* self) {
+  ++explicit_gc_requests_;
+  // A full GC already running frees everything this request could, a sticky or partial one
+  // doesn't.
+  if (WaitForConcurrentGcToComplete(self) == collector::kGcTypeFull) {
+    return;
+  }
+  const uint64_t now = NanoTime();
+  bool blocking;
+  {
+    MutexLock mu(self, *gc_complete_lock_);
+    blocking = last_explicit_gc_ns_ == 0 || now - last_explicit_gc_ns_ >= kExplicitGcWindow;
+    if (blocking) {
+      last_explicit_gc_ns_ = now;
+    }
+  }
+  if (!blocking && concurrent_gc_) {
+    // Too soon after the last blocking one, fold this and the requests following it until the GC
+    // daemon runs into a full concurrent GC.
+    if (!explicit_gc_pending_.compare_and_swap(0, 1)) {
+      return;
+    }
+    RequestConcurrentGC(self);
+    if (IsGCRequestPending()) {
+      ++explicit_gcs_;
+      return;
+    }
+    // The GC daemon can't run it, collect here instead unless a racing request already has.
+    if (!explicit_gc_pending_.compare_and_swap(1, 0)) {
+      return;
+    }
+  }
+  ++explicit_gcs_;
+  CollectGarbageInternal(collector::kGcTypeFull, kGcCauseExplicit, false);
+}
+
 void Heap::PreZygoteFork() {
   static Mutex zygote_creation_lock_("zygote creation lock", kZygoteCreationLock);
   // Do this before acquiring the zygote creation lock so that we don't get lock order violations.
@@ -1143,11 +1610,18 @@ void Heap::PreZygoteFork() {
 
   // Try to see if we have any Zygote spaces.
   if (have_zygote_space_) {
+    if (track_zygote_dirty_pages_) {
+      // The zygote writes to its own pages between forks, so compare against what this fork shares.
+      RecordZygotePageChecksums();
+    }
     return;
   }
 
   VLOG(heap) << "Starting PreZygoteFork with alloc space size " << PrettySize(alloc_space_->Size());
 
+  // Cached chunks would otherwise end up in the zygote space and later be handed out from there.
+  RevokeAllThreadLocalAllocCaches();
+
   {
     // Flush the alloc stack.
     WriterMutexLock mu(self, *Locks::heap_bitmap_lock_);
@@ -1163,15 +1637,105 @@ void Heap::PreZygoteFork() {
   // Change the GC retention policy of the zygote space to only collect when full.
   zygote_space->SetGcRetentionPolicy(space::kGcRetentionPolicyFullCollect);
   AddContinuousSpace(alloc_space_);
+  if (IsNumaEnabled()) {
+    PlaceOnNumaNodes(alloc_space_);
+  }
   have_zygote_space_ = true;
 
   // Reset the cumulative loggers since we now have a few additional timing phases.
   for (const auto& collector : mark_sweep_collectors_) {
     collector->ResetCumulativeStatistics();
   }
+
+  if (track_zygote_dirty_pages_) {
+    RecordZygotePageChecksums();
+  }
+}
+
+static uint32_t PageChecksum(const byte* page) {
+  return adler32(adler32(0L, Z_NULL, 0), page, kPageSize);
+}
+
+void Heap::RecordZygotePageChecksums() {
+  zygote_page_checksums_.clear();
+  for (const auto& space : continuous_spaces_) {
+    if (!space->IsImageSpace() && !space->IsZygoteSpace()) {
+      continue;
+    }
+    ZygotePageChecksums pages;
+    pages.space = space;
+    for (const byte* page = space->Begin(); page < space->End(); page += kPageSize) {
+      pages.checksums.push_back(PageChecksum(page));
+    }
+    zygote_page_checksums_.push_back(pages);
+  }
+}
+
+void Heap::DumpZygoteDirtyPages(std::ostream& os) {
+  if (zygote_page_checksums_.empty()) {
+    os << "Zygote dirty pages: not tracked\n";
+    return;
+  }
+  Thread* self = Thread::Current();
+  // Which classes start on dirty pages tells what to keep off the pages shared with the zygote,
+  // such as by listing them for dex2oat's --dirty-image-objects.
+  SafeMap<std::string, size_t> dirty_classes;
+  WriterMutexLock mu(self, *Locks::heap_bitmap_lock_);
+  for (const ZygotePageChecksums& pages : zygote_page_checksums_) {
+    accounting::SpaceBitmap* bitmap = pages.space->GetLiveBitmap();
+    size_t dirty_pages = 0;
+    for (size_t i = 0; i < pages.checksums.size(); ++i) {
+      const byte* page = pages.space->Begin() + i * kPageSize;
+      if (PageChecksum(page) == pages.checksums[i]) {
+        continue;
+      }
+      ++dirty_pages;
+      const uintptr_t page_begin = reinterpret_cast<uintptr_t>(page);
+      const uintptr_t page_end = std::min(page_begin + kPageSize,
+                                          reinterpret_cast<uintptr_t>(pages.space->End()));
+      bitmap->VisitMarkedRange(page_begin, page_end, [&](const mirror::Object* obj) {
+        std::string descriptor(ClassHelper(obj->GetClass()).GetDescriptor());
+        auto it = dirty_classes.find(descriptor);
+        if (it == dirty_classes.end()) {
+          dirty_classes.Put(descriptor, 1);
+        } else {
+          ++it->second;
+        }
+      });
+    }
+    os << "Zygote dirty pages: " << pages.space->GetName() << " " << dirty_pages << "/"
+       << pages.checksums.size() << " (" << PrettySize(dirty_pages * kPageSize) << ")\n";
+  }
+  std::vector<std::pair<size_t, std::string> > by_count;
+  for (const auto& dirty_class : dirty_classes) {
+    by_count.push_back(std::make_pair(dirty_class.second, dirty_class.first));
+  }
+  std::sort(by_count.rbegin(), by_count.rend());
+  for (const auto& dirty_class : by_count) {
+    os << "  " << dirty_class.first << " " << dirty_class.second << "\n";
+  }
+}
+
+void Heap::RevokeThreadLocalAllocCache(Thread* thread) {
+  alloc_space_->RevokeThreadLocalAllocCache(thread);
+}
+
+void Heap::RevokeAllThreadLocalAllocCaches() {
+  MutexLock mu(Thread::Current(), *Locks::thread_list_lock_);
+  for (const auto& thread : Runtime::Current()->GetThreadList()->GetList()) {
+    RevokeThreadLocalAllocCache(thread);
+  }
+}
+
+void Heap::RevokeAllThreadLocalAllocationStacks(Thread* self) {
+  MutexLock mu(self, *Locks::thread_list_lock_);
+  for (const auto& thread : Runtime::Current()->GetThreadList()->GetList()) {
+    thread->RevokeThreadLocalAllocationStack();
+  }
 }
 
 void Heap::FlushAllocStack() {
+  RevokeAllThreadLocalAllocationStacks(Thread::Current());
   MarkAllocStack(alloc_space_->GetLiveBitmap(), large_object_space_->GetLiveObjects(),
                  allocation_stack_.get());
   allocation_stack_->Reset();
@@ -1182,7 +1746,10 @@ void Heap::MarkAllocStack(accounting::SpaceBitmap* bitmap, accounting::SpaceSetM
   mirror::Object** limit = stack->End();
   for (mirror::Object** it = stack->Begin(); it != limit; ++it) {
     const mirror::Object* obj = *it;
-    DCHECK(obj != NULL);
+    if (obj == NULL) {
+      // An unused slot of a thread's segment.
+      continue;
+    }
     if (LIKELY(bitmap->HasAddress(obj))) {
       bitmap->Set(obj);
     } else {
@@ -1215,6 +1782,7 @@ collector::GcType Heap::CollectGarbageInternal(collector::GcType gc_type, GcCaus
       MutexLock mu(self, *gc_complete_lock_);
       if (!is_gc_running_) {
         is_gc_running_ = true;
+        ++gc_epoch_;
         start_collect = true;
       }
     }
@@ -1243,6 +1811,7 @@ collector::GcType Heap::CollectGarbageInternal(collector::GcType gc_type, GcCaus
   if (ms_delta != 0) {
     allocation_rate_ = ((gc_start_size - last_gc_size_) * 1000) / ms_delta;
     VLOG(heap) << "Allocation rate: " << PrettySize(allocation_rate_) << "/s";
+    UpdateThreadAllocationRates(ms_delta);
   }
 
   if (gc_type == collector::kGcTypeSticky &&
@@ -1271,6 +1840,7 @@ collector::GcType Heap::CollectGarbageInternal(collector::GcType gc_type, GcCaus
   collector->Run();
   total_objects_freed_ever_ += collector->GetFreedObjects();
   total_bytes_freed_ever_ += collector->GetFreedBytes();
+  RecordGcEvent(collector, gc_cause, gc_start_time_ns, gc_start_size);
   if (care_about_pause_times_) {
     const size_t duration = collector->GetDurationNs();
     std::vector<uint64_t> pauses = collector->GetPauseTimes();
@@ -1309,6 +1879,7 @@ collector::GcType Heap::CollectGarbageInternal(collector::GcType gc_type, GcCaus
   {
       MutexLock mu(self, *gc_complete_lock_);
       is_gc_running_ = false;
+      ++gc_epoch_;
       last_gc_type_ = gc_type;
       // Wake anyone who may have been waiting for the GC to complete.
       gc_complete_cond_->Broadcast(self);
@@ -1321,6 +1892,35 @@ collector::GcType Heap::CollectGarbageInternal(collector::GcType gc_type, GcCaus
   return gc_type;
 }
 
+void Heap::RecordGcEvent(collector::MarkSweep* collector, GcCause gc_cause,
+                         uint64_t start_time_ns, uint64_t bytes_allocated_before) {
+  GcEventLog::Event event;
+  event.start_time_ns = start_time_ns;
+  event.cause = gc_cause;
+  event.type = collector->GetGcType();
+  event.concurrent = collector->IsConcurrent();
+  event.duration_ns = collector->GetDurationNs();
+  const std::vector<uint64_t>& pauses = collector->GetPauseTimes();
+  event.pause_count = std::min(pauses.size(), GcEventLog::kMaxPauses);
+  for (size_t i = 0; i < event.pause_count; ++i) {
+    event.pause_ns[i] = pauses[i];
+  }
+  event.freed_objects = collector->GetFreedObjects();
+  event.freed_bytes = collector->GetFreedBytes();
+  event.freed_large_objects = collector->GetFreedLargeObjects();
+  event.freed_large_object_bytes = collector->GetFreedLargeObjectBytes();
+  event.bytes_allocated_before = bytes_allocated_before;
+  event.bytes_allocated_after = GetBytesAllocated();
+  event.total_memory = GetTotalMemory();
+  const base::TimingLogger::SplitTimings& splits = collector->GetTimings().GetSplits();
+  event.phase_count = std::min(splits.size(), GcEventLog::kMaxPhases);
+  for (size_t i = 0; i < event.phase_count; ++i) {
+    event.phases[i].label = splits[i].second;
+    event.phases[i].duration_ns = splits[i].first;
+  }
+  gc_event_log_->Record(event);
+}
+
 void Heap::UpdateAndMarkModUnion(collector::MarkSweep* mark_sweep, base::TimingLogger& timings,
                                  collector::GcType gc_type) {
   if (gc_type == collector::kGcTypeSticky) {
@@ -1502,6 +2102,112 @@ class VerifyObjectVisitor {
   mutable bool failed_;
 };
 
+static bool IsSampledCard(const void* addr, size_t sampling, size_t sample) {
+  const uintptr_t card = reinterpret_cast<uintptr_t>(addr) / accounting::CardTable::kCardSize;
+  return card % sampling == sample;
+}
+
+// Visits the live objects of the sampled cards in [begin, end) with a Visitor of its own.
+template <typename Visitor>
+class VerifyCardRangeTask : public Task {
+ public:
+  VerifyCardRangeTask(Heap* heap, accounting::SpaceBitmap* bitmap, byte* begin, byte* end,
+                      size_t sampling, size_t sample, AtomicInteger* failures)
+      : heap_(heap),
+        bitmap_(bitmap),
+        begin_(reinterpret_cast<uintptr_t>(begin)),
+        end_(reinterpret_cast<uintptr_t>(end)),
+        sampling_(sampling),
+        sample_(sample),
+        failures_(failures) {
+  }
+
+  virtual void Run(Thread* self) NO_THREAD_SAFETY_ANALYSIS {
+    Visitor visitor(heap_);
+    if (sampling_ == 1) {
+      bitmap_->VisitMarkedRange(begin_, end_, visitor);
+    } else {
+      const uintptr_t card_size = accounting::CardTable::kCardSize;
+      // The first sampled card from begin_, then every sampling_ cards.
+      uintptr_t card = RoundDown(begin_, card_size);
+      while (!IsSampledCard(reinterpret_cast<const void*>(card), sampling_, sample_)) {
+        card += card_size;
+      }
+      for (; card < end_; card += sampling_ * card_size) {
+        bitmap_->VisitMarkedRange(std::max(card, begin_), std::min(card + card_size, end_),
+                                  visitor);
+      }
+    }
+    if (visitor.Failed()) {
+      failures_->fetch_add(1);
+    }
+  }
+
+  virtual void Finalize() {
+    delete this;
+  }
+
+ private:
+  Heap* const heap_;
+  accounting::SpaceBitmap* const bitmap_;
+  const uintptr_t begin_;
+  const uintptr_t end_;
+  const size_t sampling_;
+  const size_t sample_;
+  AtomicInteger* const failures_;
+};
+
+template <typename Visitor>
+bool Heap::VerifyLiveObjects(accounting::ObjectStack* stack, const Visitor& visitor) {
+  Thread* self = Thread::Current();
+  ThreadPool* thread_pool = parallel_gc_threads_ != 0 ? thread_pool_.get() : nullptr;
+  const size_t thread_count = thread_pool != nullptr ? parallel_gc_threads_ + 1 : 1;
+  AtomicInteger failures(0);
+  std::vector<Task*> tasks;
+  for (const auto& space : continuous_spaces_) {
+    accounting::SpaceBitmap* bitmap = space->GetLiveBitmap();
+    byte* begin = space->Begin();
+    byte* end = space->End();
+    const size_t delta = RoundUp((end - begin) / thread_count + 1,
+                                 accounting::CardTable::kCardSize);
+    while (begin < end) {
+      byte* range_end = begin + std::min(delta, static_cast<size_t>(end - begin));
+      tasks.push_back(new VerifyCardRangeTask<Visitor>(this, bitmap, begin, range_end,
+                                                       verification_sampling_,
+                                                       verification_sample_, &failures));
+      begin = range_end;
+    }
+  }
+  if (thread_pool != nullptr) {
+    for (Task* task : tasks) {
+      thread_pool->AddTask(self, task);
+    }
+    thread_pool->SetMaxActiveWorkers(thread_count - 1);
+    thread_pool->StartWorkers(self);
+  } else {
+    for (Task* task : tasks) {
+      task->Run(self);
+      task->Finalize();
+    }
+  }
+  // The workers only read the heap, so this thread can verify the rest meanwhile.
+  for (const auto& space : discontinuous_spaces_) {
+    space->GetLiveObjects()->Visit(visitor);
+  }
+  if (stack != nullptr) {
+    for (mirror::Object** it = stack->Begin(); it != stack->End(); ++it) {
+      if (*it != NULL && IsSampledCard(*it, verification_sampling_, verification_sample_)) {
+        visitor(*it);
+      }
+    }
+  }
+  if (thread_pool != nullptr) {
+    thread_pool->Wait(self, true, true);
+    thread_pool->StopWorkers(self);
+  }
+  return failures.load() == 0 && !visitor.Failed();
+}
+
 // Must do this with mutators suspended since we are directly accessing the allocation stacks.
 bool Heap::VerifyHeapReferences() {
   Locks::mutator_lock_->AssertExclusiveHeld(Thread::Current());
@@ -1509,18 +2215,17 @@ bool Heap::VerifyHeapReferences() {
   allocation_stack_->Sort();
   live_stack_->Sort();
   // Perform the verification.
-  VerifyObjectVisitor visitor(this);
-  Runtime::Current()->VisitRoots(VerifyReferenceVisitor::VerifyRoots, &visitor, false, false);
-  GetLiveBitmap()->Visit(visitor);
+  VerifyReferenceVisitor root_visitor(this);
+  Runtime::Current()->VisitRoots(VerifyReferenceVisitor::VerifyRoots, &root_visitor, false,
+                                 false);
   // Verify objects in the allocation stack since these will be objects which were:
   // 1. Allocated prior to the GC (pre GC verification).
   // 2. Allocated during the GC (pre sweep GC verification).
-  for (mirror::Object** it = allocation_stack_->Begin(); it != allocation_stack_->End(); ++it) {
-    visitor(*it);
-  }
   // We don't want to verify the objects in the live stack since they themselves may be
   // pointing to dead objects if they are not reachable.
-  if (visitor.Failed()) {
+  VerifyObjectVisitor visitor(this);
+  bool succeeded = VerifyLiveObjects(allocation_stack_.get(), visitor);
+  if (!succeeded || root_visitor.Failed()) {
     // Dump mod-union tables.
     image_mod_union_table_->Dump(LOG(ERROR) << "Image mod-union table: ");
     zygote_mod_union_table_->Dump(LOG(ERROR) << "Zygote mod-union table: ");
@@ -1627,15 +2332,9 @@ bool Heap::VerifyMissingCardMarks() {
 
   // We need to sort the live stack since we binary search it.
   live_stack_->Sort();
-  VerifyLiveStackReferences visitor(this);
-  GetLiveBitmap()->Visit(visitor);
-
   // We can verify objects in the live stack since none of these should reference dead objects.
-  for (mirror::Object** it = live_stack_->Begin(); it != live_stack_->End(); ++it) {
-    visitor(*it);
-  }
-
-  if (visitor.Failed()) {
+  VerifyLiveStackReferences visitor(this);
+  if (!VerifyLiveObjects(live_stack_.get(), visitor)) {
     DumpSpaces();
     return false;
   }
@@ -1643,6 +2342,12 @@ bool Heap::VerifyMissingCardMarks() {
 }
 
 void Heap::SwapStacks() {
+  Thread* self = Thread::Current();
+  if (Locks::mutator_lock_->IsExclusiveHeld(self)) {
+    RevokeAllThreadLocalAllocationStacks(self);
+  }
+  // Otherwise the mutators are running, and drop their segments of what becomes the live stack
+  // when they next pass a checkpoint, see MarkSweep::MarkThreadRoots.
   allocation_stack_.swap(live_stack_);
 }
 
@@ -1667,6 +2372,8 @@ void Heap::ProcessCards(base::TimingLogger& timings) {
 void Heap::PreGcVerification(collector::GarbageCollector* gc) {
   ThreadList* thread_list = Runtime::Current()->GetThreadList();
   Thread* self = Thread::Current();
+  // Sample the next cards this GC.
+  verification_sample_ = (verification_sample_ + 1) % verification_sampling_;
 
   if (verify_pre_gc_heap_) {
     thread_list->SuspendAll();
@@ -1769,6 +2476,13 @@ void Heap::DumpForSigQuit(std::ostream& os) {
   os << "Heap: " << GetPercentFree() << "% free, " << PrettySize(GetBytesAllocated()) << "/"
      << PrettySize(GetTotalMemory()) << "; " << GetObjectsAllocated() << " objects\n";
   DumpGcPerformanceInfo(os);
+  if (thread_pool_.get() != NULL) {
+    os << "GC thread pool: ";
+    thread_pool_->DumpStats(os);
+  }
+  if (track_zygote_dirty_pages_) {
+    DumpZygoteDirtyPages(os);
+  }
 }
 
 size_t Heap::GetPercentFree() {
@@ -1797,10 +2511,52 @@ void Heap::UpdateMaxNativeFootprint() {
   native_footprint_limit_ = 2 * target_size - native_size;
 }
 
-void Heap::GrowForUtilization(collector::GcType gc_type, uint64_t gc_duration) {
+void Heap::UpdateGcCpuFraction(uint64_t gc_duration, const std::vector<uint64_t>& pauses) {
+  const uint64_t now = NanoTime();
+  const uint64_t interval = std::max(now - last_gc_time_ns_, gc_duration);
+  if (interval == 0) {
+    return;
+  }
+  const double fraction = static_cast<double>(gc_duration) / interval;
+  gc_cpu_fraction_ += kGcCpuFractionWeight * (fraction - gc_cpu_fraction_);
+  if (target_gc_cpu_fraction_ == 0.0) {
+    return;
+  }
+  uint64_t longest_pause = 0;
+  for (uint64_t pause : pauses) {
+    longest_pause = std::max(longest_pause, pause);
+  }
+  if (gc_cpu_fraction_ > target_gc_cpu_fraction_ || longest_pause > pause_budget_ns_) {
+    // Collecting too often, leave more room between GCs.
+    free_space_scale_ = std::min(free_space_scale_ * kFreeSpaceScaleStep, kMaxFreeSpaceScale);
+  } else if (gc_cpu_fraction_ < target_gc_cpu_fraction_ / 2) {
+    // GCs are cheap enough to afford a smaller heap.
+    free_space_scale_ = std::max(free_space_scale_ / kFreeSpaceScaleStep, kMinFreeSpaceScale);
+  }
+}
+
+void Heap::UpdateThreadAllocationRates(uint64_t ms_delta) {
+  uint64_t rate = 0;
+  MutexLock mu(Thread::Current(), *Locks::thread_list_lock_);
+  for (const auto& thread : Runtime::Current()->GetThreadList()->GetList()) {
+    rate += thread->UpdateHeapAllocationRate(ms_delta);
+  }
+  thread_allocation_rate_ = rate;
+}
+
+void Heap::GrowForUtilization(collector::MarkSweep* collector) {
+  const collector::GcType gc_type = collector->GetGcType();
+  const uint64_t gc_duration = collector->GetDurationNs();
   // We know what our utilization is at this moment.
   // This doesn't actually resize any memory. It just lets the heap grow more when necessary.
   const size_t bytes_allocated = GetBytesAllocated();
+  UpdateGcCpuFraction(gc_duration, collector->GetPauseTimes());
+  if (collector->IsConcurrent()) {
+    concurrent_gc_duration_ns_ = concurrent_gc_duration_ns_ == 0 ? gc_duration :
+        (concurrent_gc_duration_ns_ + gc_duration) / 2;
+    concurrent_start_margin_ = std::max(concurrent_start_margin_ * kConcurrentStartMarginDecay,
+                                        kMinConcurrentStartMargin);
+  }
   last_gc_size_ = bytes_allocated;
   last_gc_time_ns_ = NanoTime();
 
@@ -1813,6 +2569,15 @@ void Heap::GrowForUtilization(collector::GcType gc_type, uint64_t gc_duration) {
     } else if (target_size < bytes_allocated + min_free_) {
       target_size = bytes_allocated + min_free_;
     }
+    if (target_gc_cpu_fraction_ != 0.0) {
+      if (!care_about_pause_times_) {
+        // In the background GC time matters less than memory, keep the heap tight.
+        target_size = bytes_allocated + min_free_;
+      } else {
+        const size_t free_space = (target_size - bytes_allocated) * free_space_scale_;
+        target_size = bytes_allocated + std::max(free_space, min_free_);
+      }
+    }
     next_gc_type_ = collector::kGcTypeSticky;
   } else {
     // Based on how close the current heap size is to the target size, decide
@@ -1837,10 +2602,14 @@ void Heap::GrowForUtilization(collector::GcType gc_type, uint64_t gc_duration) {
     if (concurrent_gc_) {
       // Calculate when to perform the next ConcurrentGC.
 
-      // Calculate the estimated GC duration.
-      double gc_duration_seconds = NsToMs(gc_duration) / 1000.0;
-      // Estimate how many remaining bytes we will have when we need to start the next GC.
-      size_t remaining_bytes = allocation_rate_ * gc_duration_seconds;
+      // Calculate the estimated GC duration, from the concurrent GCs seen so far if there are any.
+      const uint64_t expected_duration =
+          concurrent_gc_duration_ns_ != 0 ? concurrent_gc_duration_ns_ : gc_duration;
+      double gc_duration_seconds = NsToMs(expected_duration) / 1000.0;
+      // Estimate how many remaining bytes we will have when we need to start the next GC. The
+      // threads' rates keep recent bursts in, which the average over the whole cycle smooths out.
+      const uint64_t rate = std::max(allocation_rate_, thread_allocation_rate_);
+      size_t remaining_bytes = rate * gc_duration_seconds * concurrent_start_margin_;
       remaining_bytes = std::max(remaining_bytes, kMinConcurrentRemainingBytes);
       if (UNLIKELY(remaining_bytes > max_allowed_footprint_)) {
         // A never going to happen situation that from the estimated allocation rate we will exceed
@@ -1964,19 +2733,111 @@ void Heap::AddFinalizerReference(Thread* self, mirror::Object* object) {
       arg_array.GetArray(), arg_array.GetNumBytes(), &result, 'V');
 }
 
+// Enqueues the pending references on one of the reference enqueue threads.
+class ReferenceEnqueueTask : public Task {
+ public:
+  explicit ReferenceEnqueueTask(Heap* heap) : heap_(heap) {}
+
+  virtual void Run(Thread* self) {
+    heap_->EnqueuePendingReferences(self);
+  }
+
+  virtual void Finalize() {
+    delete this;
+  }
+
+ private:
+  Heap* const heap_;
+
+  DISALLOW_COPY_AND_ASSIGN(ReferenceEnqueueTask);
+};
+
 void Heap::EnqueueClearedReferences(mirror::Object** cleared) {
   DCHECK(cleared != NULL);
   if (*cleared != NULL) {
     // When a runtime isn't started there are no reference queues to care about so ignore.
     if (LIKELY(Runtime::Current()->IsStarted())) {
       ScopedObjectAccess soa(Thread::Current());
+      ThreadPool* enqueue_pool = reference_enqueue_pool_.get();
+      bool queue_task = false;
+      {
+        MutexLock mu(soa.Self(), *pending_references_lock_);
+        while (*cleared != NULL) {
+          mirror::Object* ref = DequeuePendingReference(cleared);
+          EnqueuePendingReference(ref, ref->GetClass()->IsFinalizerReferenceClass()
+                                           ? &pending_finalizer_references_
+                                           : &pending_references_);
+          ++pending_reference_count_;
+        }
+        max_pending_references_ = std::max(max_pending_references_, pending_reference_count_);
+        if (enqueue_pool != NULL && !reference_enqueue_task_queued_) {
+          reference_enqueue_task_queued_ = true;
+          queue_task = true;
+        }
+      }
+      if (enqueue_pool == NULL) {
+        EnqueuePendingReferences(soa.Self());
+      } else if (queue_task) {
+        enqueue_pool->AddTask(soa.Self(), new ReferenceEnqueueTask(this));
+      }
+    }
+    *cleared = NULL;
+  }
+}
+
+void Heap::EnqueuePendingReferences(Thread* self) {
+  ScopedObjectAccess soa(self);
+  size_t count;
+  size_t finalizer_count = 0;
+  SirtRef<mirror::Object> finalizer_references(self, NULL);
+  SirtRef<mirror::Object> references(self, NULL);
+  {
+    MutexLock mu(self, *pending_references_lock_);
+    reference_enqueue_task_queued_ = false;
+    count = pending_reference_count_;
+    if (count == 0) {
+      // Taken by an earlier task.
+      return;
+    }
+    if (pending_finalizer_references_ != NULL) {
+      mirror::Object* ref = pending_finalizer_references_;
+      do {
+        ++finalizer_count;
+        ref = ref->GetFieldObject<mirror::Object*>(reference_pendingNext_offset_, false);
+      } while (ref != pending_finalizer_references_);
+    }
+    finalizer_references.reset(pending_finalizer_references_);
+    references.reset(pending_references_);
+    pending_finalizer_references_ = NULL;
+    pending_references_ = NULL;
+    pending_reference_count_ = 0;
+  }
+  const uint64_t start = NanoTime();
+  mirror::ArtMethod* add = soa.DecodeMethod(WellKnownClasses::java_lang_ref_ReferenceQueue_add);
+  for (mirror::Object* list : {finalizer_references.get(), references.get()}) {
+    if (list != NULL) {
       JValue result;
       ArgArray arg_array(NULL, 0);
-      arg_array.Append(reinterpret_cast<uint32_t>(*cleared));
-      soa.DecodeMethod(WellKnownClasses::java_lang_ref_ReferenceQueue_add)->Invoke(soa.Self(),
-          arg_array.GetArray(), arg_array.GetNumBytes(), &result, 'V');
+      arg_array.Append(reinterpret_cast<uint32_t>(list));
+      add->Invoke(self, arg_array.GetArray(), arg_array.GetNumBytes(), &result, 'V');
     }
-    *cleared = NULL;
+  }
+  const uint64_t duration = NanoTime() - start;
+  MutexLock mu(self, *pending_references_lock_);
+  references_enqueued_ += count;
+  finalizer_references_enqueued_ += finalizer_count;
+  ++reference_batches_;
+  max_reference_batch_ = std::max(max_reference_batch_, count);
+  reference_enqueue_ns_ += duration;
+}
+
+void Heap::VisitPendingReferences(RootVisitor* visitor, void* arg) {
+  MutexLock mu(Thread::Current(), *pending_references_lock_);
+  if (pending_finalizer_references_ != NULL) {
+    visitor(pending_finalizer_references_, arg);
+  }
+  if (pending_references_ != NULL) {
+    visitor(pending_references_, arg);
   }
 }
 
@@ -2019,15 +2880,22 @@ void Heap::ConcurrentGC(Thread* self) {
   }
 
   // Wait for any GCs currently running to finish.
-  if (WaitForConcurrentGcToComplete(self) == collector::kGcTypeNone) {
+  const collector::GcType last_gc_type = WaitForConcurrentGcToComplete(self);
+  if (explicit_gc_pending_.compare_and_swap(1, 0)) {
+    // Explicit GC requests folded into this one need everything unreachable freed, which only a
+    // full GC does.
+    if (last_gc_type != collector::kGcTypeFull) {
+      CollectGarbageInternal(collector::kGcTypeFull, kGcCauseExplicit, false);
+    }
+  } else if (last_gc_type == collector::kGcTypeNone) {
     CollectGarbageInternal(next_gc_type_, kGcCauseBackground, false);
   }
 }
 
 void Heap::RequestHeapTrim() {
   // GC completed and now we must decide whether to request a heap trim (advising pages back to the
-  // kernel) or not. Issuing a request will also cause trimming of the libc heap. As a trim scans
-  // a space it will hold its lock and can become a cause of jank.
+  // kernel) or not. Issuing a request will also cause trimming of the libc heap. A trim scans the
+  // alloc space in slices, but still takes its lock for each of them.
   // Note, the large object space self trims and the Zygote space was trimmed and unchanging since
   // forking.
 
@@ -2076,7 +2944,31 @@ void Heap::RequestHeapTrim() {
 
 size_t Heap::Trim() {
   // Handle a requested heap trim on a thread outside of the main GC thread.
-  return alloc_space_->Trim();
+  // Only one of any racing trims gets to clear the pending flag and run the collection.
+  if (background_collection_pending_.compare_and_swap(1, 0)) {
+    // Objects can't be moved so this is the closest we get to compacting the heap: collect
+    // everything we can while pauses don't matter so that freed neighbouring chunks coalesce.
+    Thread* self = Thread::Current();
+    WaitForConcurrentGcToComplete(self);
+    CollectGarbageInternal(collector::kGcTypeFull, kGcCauseBackground, true);
+  }
+  // Trim the alloc space a slice at a time, letting allocations in between, so that a trim never
+  // keeps the foreground waiting for the space's lock for long.
+  size_t reclaimed = 0;
+  bool done = false;
+  while (!done) {
+    uint64_t slice_start = NanoTime();
+    done = alloc_space_->TrimSlice(&reclaimed);
+    longest_trim_slice_ns_ = std::max(longest_trim_slice_ns_, NanoTime() - slice_start);
+    ++total_trim_slices_;
+    if (!done) {
+      sched_yield();
+    }
+  }
+  reclaimed += large_object_space_->Trim();
+  ++total_trims_;
+  total_trimmed_bytes_ += reclaimed;
+  return reclaimed;
 }
 
 bool Heap::IsGCRequestPending() const {
@@ -2085,43 +2977,28 @@ bool Heap::IsGCRequestPending() const {
 
 void Heap::RegisterNativeAllocation(int bytes) {
   // Total number of native bytes allocated.
-  native_bytes_allocated_.fetch_add(bytes);
+  const size_t native_bytes = native_bytes_allocated_.fetch_add(bytes) + bytes;
+  if (native_bytes <= native_footprint_gc_watermark_) {
+    return;
+  }
   Thread* self = Thread::Current();
-  if (static_cast<size_t>(native_bytes_allocated_) > native_footprint_gc_watermark_) {
-    // The second watermark is higher than the gc watermark. If you hit this it means you are
-    // allocating native objects faster than the GC can keep up with.
-    if (static_cast<size_t>(native_bytes_allocated_) > native_footprint_limit_) {
-        JNIEnv* env = self->GetJniEnv();
-        // Can't do this in WellKnownClasses::Init since System is not properly set up at that
-        // point.
-        if (WellKnownClasses::java_lang_System_runFinalization == NULL) {
-          DCHECK(WellKnownClasses::java_lang_System != NULL);
-          WellKnownClasses::java_lang_System_runFinalization =
-              CacheMethod(env, WellKnownClasses::java_lang_System, true, "runFinalization", "()V");
-          assert(WellKnownClasses::java_lang_System_runFinalization != NULL);
-        }
-        if (WaitForConcurrentGcToComplete(self) != collector::kGcTypeNone) {
-          // Just finished a GC, attempt to run finalizers.
-          env->CallStaticVoidMethod(WellKnownClasses::java_lang_System,
-                                    WellKnownClasses::java_lang_System_runFinalization);
-          CHECK(!env->ExceptionCheck());
-        }
-
-        // If we still are over the watermark, attempt a GC for alloc and run finalizers.
-        if (static_cast<size_t>(native_bytes_allocated_) > native_footprint_limit_) {
-          CollectGarbageInternal(collector::kGcTypePartial, kGcCauseForAlloc, false);
-          env->CallStaticVoidMethod(WellKnownClasses::java_lang_System,
-                                    WellKnownClasses::java_lang_System_runFinalization);
-          CHECK(!env->ExceptionCheck());
-        }
-        // We have just run finalizers, update the native watermark since it is very likely that
-        // finalizers released native managed allocations.
-        UpdateMaxNativeFootprint();
-    } else {
-      if (!IsGCRequestPending()) {
-        RequestConcurrentGC(self);
-      }
-    }
+  const size_t headroom = native_footprint_limit_ - native_footprint_gc_watermark_;
+  if (native_bytes > native_footprint_limit_ &&
+      native_bytes > native_blocking_gc_bytes_ + headroom) {
+    // Native objects are being allocated faster than concurrent GCs can keep up with. Wait for the
+    // GC in progress, or do one, but leave the finalizers it finds to the FinalizerDaemon: running
+    // them here would stall this thread behind every pending finalizer.
+    const uint64_t wait_start = NanoTime();
+    if (WaitForConcurrentGcToComplete(self) == collector::kGcTypeNone) {
+      CollectGarbageInternal(collector::kGcTypePartial, kGcCauseForAlloc, false);
+    }
+    native_blocking_gc_bytes_ = native_bytes_allocated_;
+    ++native_blocking_gcs_;
+    MutexLock mu(self, *gc_complete_lock_);
+    native_blocking_time_ += NanoTime() - wait_start;
+  } else if (!IsGCRequestPending()) {
+    ++native_gc_requests_;
+    RequestConcurrentGC(self);
   }
 }
 
@@ -2136,6 +3013,58 @@ void Heap::RegisterNativeFree(int bytes) {
         break;
       }
   } while (!native_bytes_allocated_.compare_and_swap(expected_size, new_size));
+  if (static_cast<size_t>(new_size) < native_footprint_gc_watermark_) {
+    native_blocking_gc_bytes_ = 0;
+  }
+}
+
+void Heap::PinObject(Thread* self, const mirror::Object* obj) {
+  DCHECK(obj != NULL);
+  MutexLock mu(self, *pinned_objects_lock_);
+  auto it = pinned_objects_.find(obj);
+  if (it == pinned_objects_.end()) {
+    pinned_objects_.Put(obj, 1);
+  } else {
+    ++it->second;
+  }
+}
+
+void Heap::UnpinObject(Thread* self, const mirror::Object* obj) {
+  MutexLock mu(self, *pinned_objects_lock_);
+  auto it = pinned_objects_.find(obj);
+  if (it == pinned_objects_.end()) {
+    LOG(WARNING) << "Attempt to unpin " << obj << " which isn't pinned";
+    return;
+  }
+  if (--it->second == 0) {
+    pinned_objects_.erase(it);
+  }
+}
+
+bool Heap::IsPinned(Thread* self, const mirror::Object* obj) {
+  MutexLock mu(self, *pinned_objects_lock_);
+  return pinned_objects_.find(obj) != pinned_objects_.end();
+}
+
+size_t Heap::GetPinnedObjectCount(Thread* self) {
+  MutexLock mu(self, *pinned_objects_lock_);
+  return pinned_objects_.size();
+}
+
+void Heap::VisitPinnedObjects(RootVisitor* visitor, void* arg) {
+  MutexLock mu(Thread::Current(), *pinned_objects_lock_);
+  for (const auto& pinned : pinned_objects_) {
+    visitor(pinned.first, arg);
+  }
+}
+
+void Heap::DumpPinnedObjects(std::ostream& os) {
+  MutexLock mu(Thread::Current(), *pinned_objects_lock_);
+  os << "pinned objects: " << pinned_objects_.size() << "\n";
+  for (const auto& pinned : pinned_objects_) {
+    os << "  " << PrettyTypeOf(pinned.first) << " " << pinned.first
+       << " (pinned " << pinned.second << "x)\n";
+  }
 }
 
 int64_t Heap::GetTotalMemory() const {
@@ -17,7 +17,9 @@
 #ifndef ART_RUNTIME_GC_HEAP_H_
 #define ART_RUNTIME_GC_HEAP_H_
 
+#include <algorithm>
 #include <iosfwd>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -31,12 +33,14 @@
 #include "jni.h"
 #include "locks.h"
 #include "offsets.h"
+#include "root_visitor.h"
 #include "safe_map.h"
 #include "thread_pool.h"
 
 namespace art {
 
 class ConditionVariable;
+class MemMap;
 class Mutex;
 class StackVisitor;
 class Thread;
@@ -48,9 +52,13 @@ namespace mirror {
 }  // namespace mirror
 
 namespace gc {
+class AllocationSampler;
+class GcEventLog;
+
 namespace accounting {
   class HeapBitmap;
   class ModUnionTable;
+  class SpaceBitmap;
   class SpaceSetMap;
 }  // namespace accounting
 
@@ -72,14 +80,27 @@ namespace space {
 class AgeCardVisitor {
  public:
   byte operator()(byte card) const {
-    if (card == accounting::CardTable::kCardDirty) {
-      return card - 1;
+    if (card == accounting::CardTable::kCardDirty ||
+        card == accounting::CardTable::kCardPreCleaned) {
+      return accounting::CardTable::kCardDirty - 1;
     } else {
       return 0;
     }
   }
 };
 
+// Marks dirty cards as scanned by the concurrent GC, see MarkSweep::PreCleanCards.
+class PreCleanCardVisitor {
+ public:
+  byte operator()(byte card) const {
+    if (card == accounting::CardTable::kCardDirty) {
+      return accounting::CardTable::kCardPreCleaned;
+    } else {
+      return card;
+    }
+  }
+};
+
 // What caused the GC?
 enum GcCause {
   // GC triggered by a failed allocation. Thread doing allocation is blocked waiting for GC before
@@ -109,21 +130,40 @@ class Heap {
   static constexpr size_t kDefaultMinFree = kDefaultMaxFree / 4;
   static constexpr size_t kDefaultLongPauseLogThreshold = MsToNs(5);
   static constexpr size_t kDefaultLongGCLogThreshold = MsToNs(100);
+  // Explicit GC requests this soon after the last explicit GC don't block, see RequestExplicitGc.
+  static constexpr uint64_t kExplicitGcWindow = MsToNs(1000);
+  // Address space kept after the boot image and oat file for app images.
+  static constexpr size_t kAppImageReservationSize = 16 * MB;
 
   // Default target utilization.
   static constexpr double kDefaultTargetUtilization = 0.5;
 
+  // Default for how long a referent may stay only softly reachable per MB of free heap.
+  static constexpr uint64_t kDefaultSoftReferenceMsPerMb = 1000;
+
+  // The most threads -XX:ReferenceEnqueueThreads may ask for. They only help while cleared
+  // references arrive faster than one thread can hand them to the managed reference queues.
+  static constexpr size_t kMaxReferenceEnqueueThreads = 4;
+
+  // Granularity at which EnableNuma spreads the alloc spaces over the nodes, a huge page so that
+  // it combines with -XX:UseHugePages.
+  static constexpr size_t kNumaRegionSize = 2 * MB;
+
   // Used so that we don't overflow the allocation time atomic integer.
   static constexpr size_t kTimeAdjust = 1024;
 
   // Create a heap with the requested sizes. The possible empty
   // image_file_names names specify Spaces to load based on
-  // ImageWriter output.
+  // ImageWriter output, image_relocation_delta bytes away from
+  // the address they were written for.
   explicit Heap(size_t initial_size, size_t growth_limit, size_t min_free,
                 size_t max_free, double target_utilization, size_t capacity,
-                const std::string& original_image_file_name, bool concurrent_gc,
+                const std::string& original_image_file_name,
+                ptrdiff_t image_relocation_delta, bool concurrent_gc,
                 size_t parallel_gc_threads, size_t conc_gc_threads, bool low_memory_mode,
-                size_t long_pause_threshold, size_t long_gc_threshold, bool ignore_max_footprint);
+                size_t long_pause_threshold, size_t long_gc_threshold, bool ignore_max_footprint,
+                bool use_run_alloc_space, bool dump_gc_performance_on_shutdown,
+                bool track_zygote_dirty_pages);
 
   ~Heap();
 
@@ -135,6 +175,33 @@ class Heap {
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
   void RegisterNativeFree(int bytes) SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
 
+  // Pins an object so that its data can be handed out directly to native code, as for JNI
+  // critical access. Pins nest, and a pinned object is a root until its last pin is released.
+  // A collector that moves objects must leave pinned ones, and only those, where they are rather
+  // than copy them or wait for them to be unpinned.
+  void PinObject(Thread* self, const mirror::Object* obj)
+      LOCKS_EXCLUDED(pinned_objects_lock_)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+  void UnpinObject(Thread* self, const mirror::Object* obj)
+      LOCKS_EXCLUDED(pinned_objects_lock_)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+  bool IsPinned(Thread* self, const mirror::Object* obj) LOCKS_EXCLUDED(pinned_objects_lock_);
+  size_t GetPinnedObjectCount(Thread* self) LOCKS_EXCLUDED(pinned_objects_lock_);
+  void VisitPinnedObjects(RootVisitor* visitor, void* arg) LOCKS_EXCLUDED(pinned_objects_lock_);
+  void DumpPinnedObjects(std::ostream& os)
+      LOCKS_EXCLUDED(pinned_objects_lock_)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
+  // Records where sampled allocations come from.
+  AllocationSampler* GetAllocationSampler() const {
+    return allocation_sampler_.get();
+  }
+
+  // Machine readable records of recent collections.
+  GcEventLog* GetGcEventLog() const {
+    return gc_event_log_.get();
+  }
+
   // The given reference is believed to be to an object in the Java heap, check the soundness of it.
   void VerifyObjectImpl(const mirror::Object* o);
   void VerifyObject(const mirror::Object* o) {
@@ -163,9 +230,21 @@ class Heap {
                           bool search_live_stack = true, bool sorted = false)
       SHARED_LOCKS_REQUIRED(Locks::heap_bitmap_lock_);
 
+  // Whether obj was pushed on the allocation stack since it was last flushed. Takes time in what
+  // was pushed since the previous query rather than in the size of the stack.
+  bool AllocationStackContains(const mirror::Object* obj)
+      LOCKS_EXCLUDED(allocation_stack_summary_lock_);
+
   // Initiates an explicit garbage collection.
   void CollectGarbage(bool clear_soft_references) LOCKS_EXCLUDED(Locks::mutator_lock_);
 
+  // Handles a request for a GC from System.gc(). A full GC already running satisfies the request.
+  // A request within kExplicitGcWindow of the last blocking explicit GC has the GC daemon do a full
+  // concurrent GC, unless one is already pending, so a burst of requests costs one GC. Other
+  // requests, and all of them without concurrent GC, do a blocking full GC like CollectGarbage.
+  void RequestExplicitGc(Thread* self)
+      LOCKS_EXCLUDED(Locks::mutator_lock_, gc_complete_lock_);
+
   // Does a concurrent GC, should only be called by the GC daemon thread
   // through runtime.
   void ConcurrentGC(Thread* self) LOCKS_EXCLUDED(Locks::runtime_shutdown_lock_);
@@ -203,6 +282,80 @@ class Heap {
   // dalvik.system.VMRuntime.setTargetHeapUtilization.
   void SetTargetHeapUtilization(float target);
 
+  // Sizes the heap after each GC so that GCs take about the given fraction of the time, rather
+  // than from the target utilization alone. Zero goes back to the fixed target utilization. The
+  // adaptive alternative to dalvik.system.VMRuntime.setTargetHeapUtilization.
+  void SetTargetGcCpuFraction(double fraction);
+
+  double GetTargetGcCpuFraction() const {
+    return target_gc_cpu_fraction_;
+  }
+
+  // Under the adaptive policy, the heap is not shrunk while GC pauses are longer than this.
+  void SetPauseBudget(uint64_t pause_budget_ns) {
+    pause_budget_ns_ = pause_budget_ns;
+  }
+
+  // Soft references are cleared once their referent has been only softly reachable for longer
+  // than this many milliseconds per MB of free heap, as HotSpot's SoftRefLRUPolicyMSPerMB.
+  void SetSoftReferenceMsPerMb(uint64_t ms_per_mb) {
+    soft_reference_ms_per_mb_ = ms_per_mb;
+  }
+
+  // How long a referent may currently stay only softly reachable before it is cleared.
+  uint64_t GetSoftReferenceMaxAgeNs() const;
+
+  // Hands cleared references to the managed reference queues on this many threads of their own
+  // rather than on the thread that ran the GC, which may be a mutator that failed to allocate.
+  // Zero, the default, enqueues them on the GC thread. Takes effect with CreateThreadPool.
+  void SetReferenceEnqueueThreads(size_t threads) {
+    reference_enqueue_threads_ = std::min(threads, kMaxReferenceEnqueueThreads);
+  }
+
+  // Makes the heap verifiers check the objects of one card in sampling per GC, a different one
+  // each GC, rather than the whole heap. One, the default, checks every card.
+  void SetVerificationSampling(size_t sampling) {
+    verification_sampling_ = std::max<size_t>(sampling, 1);
+    verification_sample_ = 0;
+  }
+
+  // Places the alloc spaces on the NUMA nodes in turn, a kNumaRegionSize region at a time, so that
+  // the node of an object follows from its address. Thread local runs and parallel marking then
+  // prefer the regions of the node they run on. Does nothing on a host with a single node.
+  void EnableNuma();
+
+  bool IsNumaEnabled() const {
+    return num_numa_nodes_ != 0;
+  }
+
+  size_t NumaNodeOf(const void* addr) const {
+    DCHECK(IsNumaEnabled());
+    return (reinterpret_cast<uintptr_t>(addr) / kNumaRegionSize) % num_numa_nodes_;
+  }
+
+  // See SetSoftReferenceMsPerMb.
+  uint64_t soft_reference_ms_per_mb_;
+
+  // When a soft reference's referent was first found white, and the last collection that found it
+  // so. Reference.get() doesn't record accesses.
+  struct SoftReferenceAge {
+    uint64_t white_since_ns;
+    uint64_t last_white_gc;
+  };
+
+  // The soft references with a white referent, by reference. Entries go once a collection no longer
+  // finds the referent white, the reference is cleared or the reference dies. Only used by the
+  // collectors, which are serialized.
+  SafeMap<const mirror::Object*, SoftReferenceAge> soft_reference_ages_;
+
+  // Counts the collections that processed references, stamps SoftReferenceAge::last_white_gc.
+  uint64_t soft_reference_gc_;
+
+  // Moving average of the fraction of time recent GCs took.
+  double GetGcCpuFraction() const {
+    return gc_cpu_fraction_;
+  }
+
   // Sets HEAP_MIN_FREE, implements
   // dalvik.system.VMRuntime.SetTargetHeapMinFree.
   void SetTargetHeapMinFree(size_t bytes);
@@ -251,6 +404,15 @@ class Heap {
   void EnqueueReference(mirror::Object* ref, mirror::Object** list)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
   bool IsEnqueued(mirror::Object* ref) SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
+  // Calls managed ReferenceQueue.add with the references cleared by the GCs since the last call,
+  // finalizer references first so that the FinalizerDaemon can start on them sooner. Called on
+  // the GC thread, or by the reference enqueue threads.
+  void EnqueuePendingReferences(Thread* self) LOCKS_EXCLUDED(pending_references_lock_);
+
+  // References cleared by a GC but not yet handed to managed code are roots.
+  void VisitPendingReferences(RootVisitor* visitor, void* arg)
+      LOCKS_EXCLUDED(pending_references_lock_);
   void EnqueuePendingReference(mirror::Object* ref, mirror::Object** list)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
   mirror::Object* DequeuePendingReference(mirror::Object** list)
@@ -319,6 +481,36 @@ class Heap {
     return num_bytes_allocated_;
   }
 
+  // Returns the number of bytes allocated by native code and registered with
+  // RegisterNativeAllocation.
+  size_t GetNativeBytesAllocated() const {
+    return native_bytes_allocated_;
+  }
+
+  // Bumped when a garbage collection starts and again when it ends, so it is odd while one runs.
+  // An object address seen at an even epoch can't have been freed and reused while the epoch is
+  // unchanged.
+  uint32_t GetGcEpoch() const {
+    return gc_epoch_;
+  }
+
+  // Returns how many concurrent GCs native allocations requested, and how many times a thread
+  // registering a native allocation waited for a GC.
+  size_t GetNativeGcRequestCount() const {
+    return native_gc_requests_;
+  }
+  size_t GetNativeBlockingGcCount() const {
+    return native_blocking_gcs_;
+  }
+
+  // Returns how many explicit GCs were requested, and how many GCs those requests ran or requested.
+  size_t GetExplicitGcRequestCount() const {
+    return explicit_gc_requests_;
+  }
+  size_t GetExplicitGcCount() const {
+    return explicit_gcs_;
+  }
+
   // Returns the number of objects currently allocated.
   size_t GetObjectsAllocated() const;
 
@@ -365,7 +557,9 @@ class Heap {
 
   void DumpForSigQuit(std::ostream& os);
 
-  size_t Trim();
+  // Hands unused alloc space pages back to the system, preceded by a full collection if the
+  // process dropped to a state which doesn't care about pause times since the last trim.
+  size_t Trim() LOCKS_EXCLUDED(Locks::mutator_lock_);
 
   accounting::HeapBitmap* GetLiveBitmap() SHARED_LOCKS_REQUIRED(Locks::heap_bitmap_lock_) {
     return live_bitmap_.get();
@@ -381,6 +575,24 @@ class Heap {
 
   void PreZygoteFork() LOCKS_EXCLUDED(Locks::heap_bitmap_lock_);
 
+  // With -XX:TrackZygoteDirtyPages, reports how many of the image and zygote space pages shared
+  // with the zygote this process has written since it forked, and which classes of objects start
+  // on those pages. Pages are compared against checksums taken just before the fork.
+  void DumpZygoteDirtyPages(std::ostream& os)
+      LOCKS_EXCLUDED(Locks::heap_bitmap_lock_)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
+  // Return the alloc space chunks cached by thread, which must not be allocating concurrently.
+  void RevokeThreadLocalAllocCache(Thread* thread);
+  // Revoke the allocation caches of all threads. Only safe when no other thread can allocate, such
+  // as in the single threaded zygote before forking.
+  void RevokeAllThreadLocalAllocCaches() LOCKS_EXCLUDED(Locks::thread_list_lock_);
+
+  // Drops every thread's segment of the allocation stack, so that no thread writes to it after it
+  // is swapped or emptied. Only safe when no other thread can allocate.
+  void RevokeAllThreadLocalAllocationStacks(Thread* self)
+      LOCKS_EXCLUDED(Locks::thread_list_lock_);
+
   // Mark and empty stack.
   void FlushAllocStack()
       EXCLUSIVE_LOCKS_REQUIRED(Locks::heap_bitmap_lock_);
@@ -402,6 +614,14 @@ class Heap {
   // Assumes there is only one image space.
   space::ImageSpace* GetImageSpace() const;
 
+  // Returns where an app image of 'size' bytes should be mapped, in the address space reserved
+  // for app images after the boot image, or NULL if it is used up.
+  byte* AllocAppImageRange(size_t size);
+
+  // Adds an image space for an app image mapped at a range from AllocAppImageRange. Suspends
+  // all threads while the spaces change.
+  void AddAppImageSpace(space::ImageSpace* space) LOCKS_EXCLUDED(Locks::heap_bitmap_lock_);
+
   space::DlMallocSpace* GetAllocSpace() const {
     return alloc_space_;
   }
@@ -426,6 +646,8 @@ class Heap {
     return phantom_ref_queue_lock_;
   }
 
+  // Logs the spaces and their bitmaps, and how much of each space is resident on each NUMA node
+  // on a host with more than one.
   void DumpSpaces();
 
   // GC performance measuring
@@ -477,14 +699,32 @@ class Heap {
 
   bool IsOutOfMemoryOnAllocation(size_t alloc_size, bool grow);
 
-  // Pushes a list of cleared references out to the managed heap.
-  void EnqueueClearedReferences(mirror::Object** cleared_references);
+  // Adds a finished collection to the GC event log.
+  void RecordGcEvent(collector::MarkSweep* collector, GcCause gc_cause,
+                     uint64_t start_time_ns, uint64_t bytes_allocated_before);
+
+  // Visits the live objects in address ranges on the GC thread pool. Each range is visited with
+  // its own copy of 'visitor'; the copies are returned in address order for the caller to merge.
+  template <typename Visitor>
+  void VisitLiveObjectsParallel(Thread* self, const Visitor& visitor, std::vector<Visitor>* visitors)
+      SHARED_LOCKS_REQUIRED(Locks::heap_bitmap_lock_, Locks::mutator_lock_);
+
+  // Pushes a list of cleared references out to the managed heap, directly or through the
+  // reference enqueue threads.
+  void EnqueueClearedReferences(mirror::Object** cleared_references)
+      LOCKS_EXCLUDED(pending_references_lock_);
 
   void RequestHeapTrim() LOCKS_EXCLUDED(Locks::runtime_shutdown_lock_);
   void RequestConcurrentGC(Thread* self) LOCKS_EXCLUDED(Locks::runtime_shutdown_lock_);
   bool IsGCRequestPending() const;
 
-  void RecordAllocation(size_t size, mirror::Object* object)
+  void RecordAllocation(Thread* self, size_t size, mirror::Object* object)
+      LOCKS_EXCLUDED(GlobalSynchronization::heap_bitmap_lock_)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
+  // Gives self a new segment of the allocation stack, collecting garbage to empty the stack if it
+  // is full, and records obj in it.
+  void PushOnThreadLocalAllocationStackWithRefill(Thread* self, mirror::Object* obj)
       LOCKS_EXCLUDED(GlobalSynchronization::heap_bitmap_lock_)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
 
@@ -508,11 +748,21 @@ class Heap {
   // Given the current contents of the alloc space, increase the allowed heap footprint to match
   // the target utilization ratio.  This should only be called immediately after a full garbage
   // collection.
-  void GrowForUtilization(collector::GcType gc_type, uint64_t gc_duration);
+  void GrowForUtilization(collector::MarkSweep* collector);
+
+  // Updates the threads' allocation rates at the start of a GC, ms_delta after the last one.
+  void UpdateThreadAllocationRates(uint64_t ms_delta) LOCKS_EXCLUDED(Locks::thread_list_lock_);
+
+  // Updates gc_cpu_fraction_ with a GC which took gc_duration and, under the adaptive policy,
+  // free_space_scale_ to bring it towards target_gc_cpu_fraction_.
+  void UpdateGcCpuFraction(uint64_t gc_duration, const std::vector<uint64_t>& pauses);
 
   size_t GetPercentFree();
 
   void AddContinuousSpace(space::ContinuousSpace* space) LOCKS_EXCLUDED(Locks::heap_bitmap_lock_);
+
+  // Places the regions of the space on the NUMA nodes NumaNodeOf gives for them.
+  void PlaceOnNumaNodes(space::DlMallocSpace* space);
   void AddDiscontinuousSpace(space::DiscontinuousSpace* space)
       LOCKS_EXCLUDED(Locks::heap_bitmap_lock_);
 
@@ -520,6 +770,13 @@ class Heap {
   // lock ordering for it.
   void VerifyObjectBody(const mirror::Object *obj) NO_THREAD_SAFETY_ANALYSIS;
 
+  // Runs a Visitor over each range of cards of the continuous spaces on the parallel GC threads,
+  // and visitor over the large objects and stack, if not NULL, on this thread meanwhile. Only the
+  // sampled cards are visited. Returns true if no visitor failed.
+  template <typename Visitor>
+  bool VerifyLiveObjects(accounting::ObjectStack* stack, const Visitor& visitor)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_, Locks::heap_bitmap_lock_);
+
   static void VerificationCallback(mirror::Object* obj, void* arg)
       SHARED_LOCKS_REQUIRED(GlobalSychronization::heap_bitmap_lock_);
 
@@ -529,6 +786,9 @@ class Heap {
   // Clear cards and update the mod union table.
   void ProcessCards(base::TimingLogger& timings);
 
+  // Checksums the pages of the image and zygote spaces into zygote_page_checksums_.
+  void RecordZygotePageChecksums();
+
   // All-known continuous spaces, where objects lie within fixed bounds.
   std::vector<space::ContinuousSpace*> continuous_spaces_;
 
@@ -544,6 +804,12 @@ class Heap {
   // The card table, dirtied by the write barrier.
   UniquePtr<accounting::CardTable> card_table_;
 
+  // Address space between the boot oat file and the alloc space for app images, so that they are
+  // covered by the card table and sorted before the zygote and alloc spaces.
+  UniquePtr<MemMap> app_image_reservation_;
+  // Bytes of app_image_reservation_ handed out by AllocAppImageRange.
+  AtomicInteger app_image_reservation_used_;
+
   // The mod-union table remembers all of the references from the image space to the alloc /
   // zygote spaces to allow the card table to be cleared.
   UniquePtr<accounting::ModUnionTable> image_mod_union_table_;
@@ -564,6 +830,10 @@ class Heap {
   // Boolean for if we are in low memory mode.
   const bool low_memory_mode_;
 
+  // Whether the alloc space is a RunAllocSpace, which must be allocated from through its virtual
+  // Alloc.
+  const bool use_run_alloc_space_;
+
   // If we get a pause longer than long pause log threshold, then we print out the GC after it
   // finishes.
   const size_t long_pause_log_threshold_;
@@ -575,6 +845,21 @@ class Heap {
   // useful for benchmarking since it reduces time spent in GC to a low %.
   const bool ignore_max_footprint_;
 
+  // If true, the cumulative GC statistics and pause percentiles are logged when the heap is
+  // destroyed, which is how benchmarks read them.
+  const bool dump_gc_performance_on_shutdown_;
+
+  // If true, the image and zygote space pages are checksummed before each fork of the zygote, for
+  // DumpZygoteDirtyPages.
+  const bool track_zygote_dirty_pages_;
+
+  // A checksum of every page of a space shared with the zygote, taken just before the last fork.
+  struct ZygotePageChecksums {
+    space::ContinuousSpace* space;
+    std::vector<uint32_t> checksums;
+  };
+  std::vector<ZygotePageChecksums> zygote_page_checksums_;
+
   // If we have a zygote space.
   bool have_zygote_space_;
 
@@ -590,9 +875,52 @@ class Heap {
   Mutex* finalizer_ref_queue_lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
   Mutex* phantom_ref_queue_lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
 
+  // Objects pinned for direct access by native code, with how many times each is pinned.
+  Mutex* pinned_objects_lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
+  SafeMap<const mirror::Object*, size_t> pinned_objects_ GUARDED_BY(pinned_objects_lock_);
+
+  // The objects of summarized_stack_ up to summarized_end_, so that AllocationStackContains only
+  // searches what was pushed since the last query. Rebuilt once the stack is swapped, reset or
+  // sorted. Slots of threads' segments that were still unfilled are looked at again each time.
+  Mutex* allocation_stack_summary_lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
+  const accounting::ObjectStack* summarized_stack_ GUARDED_BY(allocation_stack_summary_lock_);
+  size_t summarized_layout_version_ GUARDED_BY(allocation_stack_summary_lock_);
+  size_t summarized_end_ GUARDED_BY(allocation_stack_summary_lock_);
+  std::vector<size_t> unfilled_slots_ GUARDED_BY(allocation_stack_summary_lock_);
+  // Covers the continuous spaces, large objects go in the set.
+  UniquePtr<accounting::SpaceBitmap> allocation_stack_bitmap_
+      GUARDED_BY(allocation_stack_summary_lock_);
+  std::set<const mirror::Object*> summarized_large_objects_
+      GUARDED_BY(allocation_stack_summary_lock_);
+
+  // References cleared by GCs and waiting to be enqueued, in cyclic pendingNext lists like the
+  // ones the collectors build. Successive GCs add to the same lists until they are taken, so a
+  // backed up enqueue thread takes one batch rather than one per GC.
+  Mutex* pending_references_lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
+  mirror::Object* pending_finalizer_references_ GUARDED_BY(pending_references_lock_);
+  mirror::Object* pending_references_ GUARDED_BY(pending_references_lock_);
+  size_t pending_reference_count_ GUARDED_BY(pending_references_lock_);
+  // True while a task to enqueue the pending references is queued but not yet running.
+  bool reference_enqueue_task_queued_ GUARDED_BY(pending_references_lock_);
+
+  // Reference enqueueing statistics, for DumpGcPerformanceInfo.
+  uint64_t references_enqueued_ GUARDED_BY(pending_references_lock_);
+  uint64_t finalizer_references_enqueued_ GUARDED_BY(pending_references_lock_);
+  uint64_t reference_batches_ GUARDED_BY(pending_references_lock_);
+  size_t max_reference_batch_ GUARDED_BY(pending_references_lock_);
+  size_t max_pending_references_ GUARDED_BY(pending_references_lock_);
+  uint64_t reference_enqueue_ns_ GUARDED_BY(pending_references_lock_);
+
+  UniquePtr<AllocationSampler> allocation_sampler_;
+
+  UniquePtr<GcEventLog> gc_event_log_;
+
   // True while the garbage collector is running.
   volatile bool is_gc_running_ GUARDED_BY(gc_complete_lock_);
 
+  // Written with gc_complete_lock_ held, read without, see GetGcEpoch.
+  volatile uint32_t gc_epoch_;
+
   // Last Gc type we ran. Used by WaitForConcurrentGc to know which Gc was waited on.
   volatile collector::GcType last_gc_type_ GUARDED_BY(gc_complete_lock_);
   collector::GcType next_gc_type_;
@@ -608,12 +936,18 @@ class Heap {
   // a GC should be triggered.
   size_t max_allowed_footprint_;
 
-  // The watermark at which a concurrent GC is requested by registerNativeAllocation.
+  // The soft watermark, at which a concurrent GC is requested by registerNativeAllocation.
   size_t native_footprint_gc_watermark_;
 
-  // The watermark at which a GC is performed inside of registerNativeAllocation.
+  // The hard watermark, at which registerNativeAllocation waits for a GC to complete.
   size_t native_footprint_limit_;
 
+  // Native bytes allocated when an allocating thread last waited for a GC. Finalizers release
+  // native memory some time after the GC that found their objects, so a thread only waits again
+  // once as much more is allocated as the watermarks leave between them. Cleared once native bytes
+  // fall back below the soft watermark.
+  size_t native_blocking_gc_bytes_;
+
   // Activity manager members.
   jclass activity_thread_class_;
   jclass application_thread_class_;
@@ -627,6 +961,12 @@ class Heap {
   // Whether or not we currently care about pause times.
   bool care_about_pause_times_;
 
+  // Set when the process stops caring about pause times, the next heap trim is then preceded by a
+  // full collection which clears soft references so that as much of the heap as possible coalesces
+  // into free pages the trim can give back. Set by the thread noticing the process state change,
+  // cleared by the heap trimmer daemon.
+  AtomicInteger background_collection_pending_;
+
   // When num_bytes_allocated_ exceeds this amount then a concurrent GC should be requested so that
   // it completes ahead of an allocation failing.
   size_t concurrent_start_bytes_;
@@ -646,6 +986,17 @@ class Heap {
   // Bytes which are allocated and managed by native code but still need to be accounted for.
   AtomicInteger native_bytes_allocated_;
 
+  // Concurrent GCs requested, and GCs waited for, because of native allocations.
+  AtomicInteger native_gc_requests_;
+  AtomicInteger native_blocking_gcs_;
+
+  // Explicit GCs requested, and the GCs done or requested for them.
+  AtomicInteger explicit_gc_requests_;
+  AtomicInteger explicit_gcs_;
+
+  // Set while explicit GC requests wait for the GC daemon, its next concurrent GC is then full.
+  AtomicInteger explicit_gc_pending_;
+
   // Data structure GC overhead.
   AtomicInteger gc_memory_overhead_;
 
@@ -656,9 +1007,22 @@ class Heap {
   const bool verify_post_gc_heap_;
   const bool verify_mod_union_table_;
 
+  // See SetVerificationSampling. verification_sample_ is the card, modulo verification_sampling_,
+  // the current GC verifies.
+  size_t verification_sampling_;
+  size_t verification_sample_;
+
   // Parallel GC data structures.
   UniquePtr<ThreadPool> thread_pool_;
 
+  // Threads that enqueue cleared references, see SetReferenceEnqueueThreads.
+  size_t reference_enqueue_threads_;
+
+  // Number of NUMA nodes the alloc spaces are spread over, zero unless EnableNuma was called on a
+  // host with more than one.
+  size_t num_numa_nodes_;
+  UniquePtr<ThreadPool> reference_enqueue_pool_;
+
   // Sticky mark bits GC has some overhead, so if we have less a few megabytes of AllocSpace then
   // it's probably better to just do a partial GC.
   const size_t min_alloc_space_size_for_sticky_gc_;
@@ -670,6 +1034,12 @@ class Heap {
   // The last time a heap trim occurred.
   uint64_t last_trim_time_ms_;
 
+  // Statistics of the heap trims done, which run in slices of the alloc space.
+  uint64_t total_trims_;
+  uint64_t total_trim_slices_;
+  uint64_t total_trimmed_bytes_;
+  uint64_t longest_trim_slice_ns_;
+
   // The nanosecond time at which the last GC ended.
   uint64_t last_gc_time_ns_;
 
@@ -680,6 +1050,17 @@ class Heap {
   // and the start of the current one.
   uint64_t allocation_rate_;
 
+  // Sum of the threads' allocation rates, which keep part of a burst for one more cycle, see
+  // Thread::UpdateHeapAllocationRate.
+  uint64_t thread_allocation_rate_;
+
+  // Moving average of how long concurrent GCs take, from start to finish.
+  uint64_t concurrent_gc_duration_ns_;
+
+  // How many times the estimated allocation during a concurrent GC is left free when it starts.
+  // Raised whenever an allocation has to wait for a GC, and lowered slowly while none does.
+  double concurrent_start_margin_;
+
   // For a GC cycle, a bitmap that is set corresponding to the
   UniquePtr<accounting::HeapBitmap> live_bitmap_ GUARDED_BY(Locks::heap_bitmap_lock_);
   UniquePtr<accounting::HeapBitmap> mark_bitmap_ GUARDED_BY(Locks::heap_bitmap_lock_);
@@ -721,9 +1102,28 @@ class Heap {
   // Target ideal heap utilization ratio
   double target_utilization_;
 
+  // The fraction of time GCs should take, or zero to size the heap from target_utilization_ alone.
+  double target_gc_cpu_fraction_;
+
+  // Longest GC pause the adaptive policy tolerates before it stops shrinking the heap.
+  uint64_t pause_budget_ns_;
+
+  // Moving average of the fraction of time recent GCs took, from the end of one to the next.
+  double gc_cpu_fraction_;
+
+  // What the adaptive policy scales the free space left by target_utilization_ by.
+  double free_space_scale_;
+
   // Total time which mutators are paused or waiting for GC to complete.
   uint64_t total_wait_time_;
 
+  // Total time threads registering native allocations waited for GCs, guarded by
+  // gc_complete_lock_.
+  uint64_t native_blocking_time_;
+
+  // When the last blocking explicit GC started, 0 before the first one.
+  uint64_t last_explicit_gc_ns_ GUARDED_BY(gc_complete_lock_);
+
   // Total number of objects allocated in microseconds.
   AtomicInteger total_allocation_time_;
 
@@ -15,12 +15,16 @@
  */
 
 #include "common_test.h"
+#include "gc/accounting/atomic_stack.h"
 #include "gc/accounting/card_table-inl.h"
 #include "gc/accounting/space_bitmap-inl.h"
+#include "gc/allocation_sampler.h"
+#include "mirror/art_field-inl.h"
 #include "mirror/class-inl.h"
 #include "mirror/object-inl.h"
 #include "mirror/object_array-inl.h"
 #include "sirt_ref.h"
+#include "thread_list.h"
 
 namespace art {
 namespace gc {
@@ -55,6 +59,259 @@ TEST_F(HeapTest, GarbageCollectClassLinkerInit) {
   Runtime::Current()->GetHeap()->CollectGarbage(false);
 }
 
+TEST_F(HeapTest, PinObject) {
+  ScopedObjectAccess soa(Thread::Current());
+  Heap* heap = Runtime::Current()->GetHeap();
+  SirtRef<mirror::String> string(soa.Self(),
+                                 mirror::String::AllocFromModifiedUtf8(soa.Self(), "pinned"));
+  size_t pinned_before = heap->GetPinnedObjectCount(soa.Self());
+  EXPECT_FALSE(heap->IsPinned(soa.Self(), string.get()));
+
+  // Pins nest, the object stays pinned until the last one is released.
+  heap->PinObject(soa.Self(), string.get());
+  heap->PinObject(soa.Self(), string.get());
+  EXPECT_TRUE(heap->IsPinned(soa.Self(), string.get()));
+  EXPECT_EQ(pinned_before + 1, heap->GetPinnedObjectCount(soa.Self()));
+  heap->UnpinObject(soa.Self(), string.get());
+  EXPECT_TRUE(heap->IsPinned(soa.Self(), string.get()));
+  heap->UnpinObject(soa.Self(), string.get());
+  EXPECT_FALSE(heap->IsPinned(soa.Self(), string.get()));
+  EXPECT_EQ(pinned_before, heap->GetPinnedObjectCount(soa.Self()));
+}
+
+TEST_F(HeapTest, RegisterNativeAllocation) {
+  ScopedObjectAccess soa(Thread::Current());
+  Heap* heap = Runtime::Current()->GetHeap();
+  size_t native_before = heap->GetNativeBytesAllocated();
+  size_t requests_before = heap->GetNativeGcRequestCount();
+  size_t blocking_before = heap->GetNativeBlockingGcCount();
+
+  // Well below the soft watermark, registering native bytes only counts them.
+  heap->RegisterNativeAllocation(4 * KB);
+  EXPECT_EQ(native_before + 4 * KB, heap->GetNativeBytesAllocated());
+  EXPECT_EQ(requests_before, heap->GetNativeGcRequestCount());
+  EXPECT_EQ(blocking_before, heap->GetNativeBlockingGcCount());
+  heap->RegisterNativeFree(4 * KB);
+  EXPECT_EQ(native_before, heap->GetNativeBytesAllocated());
+  EXPECT_FALSE(soa.Self()->IsExceptionPending());
+}
+
+TEST_F(HeapTest, RequestExplicitGc) {
+  Heap* heap = Runtime::Current()->GetHeap();
+  size_t requests_before = heap->GetExplicitGcRequestCount();
+  size_t gcs_before = heap->GetExplicitGcCount();
+
+  // The first request does a GC. The one right after it would be left to the GC daemon, which a
+  // runtime that hasn't finished starting doesn't have, so it still gets its full GC.
+  heap->RequestExplicitGc(Thread::Current());
+  heap->RequestExplicitGc(Thread::Current());
+  EXPECT_EQ(requests_before + 2, heap->GetExplicitGcRequestCount());
+  EXPECT_EQ(gcs_before + 2, heap->GetExplicitGcCount());
+}
+
+TEST_F(HeapTest, TargetGcCpuFraction) {
+  Heap* heap = Runtime::Current()->GetHeap();
+  EXPECT_EQ(0.0, heap->GetTargetGcCpuFraction());
+  heap->SetTargetGcCpuFraction(0.05);
+  EXPECT_EQ(0.05, heap->GetTargetGcCpuFraction());
+
+  // Every collection feeds the moving average the adaptive policy sizes the heap from.
+  heap->CollectGarbage(false);
+  EXPECT_GT(heap->GetGcCpuFraction(), 0.0);
+  EXPECT_LE(heap->GetGcCpuFraction(), 1.0);
+  heap->SetTargetGcCpuFraction(0.0);
+}
+
+TEST_F(HeapTest, SoftReferenceMaxAge) {
+  Heap* heap = Runtime::Current()->GetHeap();
+  const uint64_t max_age_ns = heap->GetSoftReferenceMaxAgeNs();
+  EXPECT_GT(max_age_ns, 0U);
+  // The age scales with the free heap, whole MBs of it.
+  EXPECT_EQ(0U, max_age_ns % MsToNs(Heap::kDefaultSoftReferenceMsPerMb));
+  heap->SetSoftReferenceMsPerMb(0);
+  EXPECT_EQ(0U, heap->GetSoftReferenceMaxAgeNs());
+  heap->SetSoftReferenceMsPerMb(Heap::kDefaultSoftReferenceMsPerMb);
+}
+
+// Collects garbage for a test that stays runnable around the collection.
+static void CollectGarbageFromRunnable(Thread* self) {
+  self->TransitionFromRunnableToSuspended(kNative);
+  Runtime::Current()->GetHeap()->CollectGarbage(false);
+  self->TransitionFromSuspendedToRunnable();
+}
+
+TEST_F(HeapTest, SoftReferenceAgeRestartsAfterUse) {
+  ScopedObjectAccess soa(Thread::Current());
+  Heap* heap = Runtime::Current()->GetHeap();
+  // Without any allowance a referent outlives the first collection finding it only softly
+  // reachable, and the next one clears it.
+  heap->SetSoftReferenceMsPerMb(0);
+  mirror::Class* soft_class = class_linker_->FindSystemClass("Ljava/lang/ref/SoftReference;");
+  mirror::ArtField* referent_field =
+      soft_class->FindInstanceField("referent", "Ljava/lang/Object;");
+  ASSERT_TRUE(referent_field != NULL);
+  SirtRef<mirror::Object> reference(soa.Self(), soft_class->AllocObject(soa.Self()));
+  {
+    SirtRef<mirror::String> referent(soa.Self(),
+                                     mirror::String::AllocFromModifiedUtf8(soa.Self(), "soft"));
+    referent_field->SetObj(reference.get(), referent.get());
+  }
+  CollectGarbageFromRunnable(soa.Self());
+  ASSERT_TRUE(referent_field->GetObj(reference.get()) != NULL);
+
+  // Used again, the referent is strongly reachable during this collection.
+  {
+    SirtRef<mirror::Object> referent(soa.Self(), referent_field->GetObj(reference.get()));
+    CollectGarbageFromRunnable(soa.Self());
+  }
+
+  // Only softly reachable again, the referent ages from now rather than from the first time.
+  CollectGarbageFromRunnable(soa.Self());
+  EXPECT_TRUE(referent_field->GetObj(reference.get()) != NULL);
+  CollectGarbageFromRunnable(soa.Self());
+  EXPECT_TRUE(referent_field->GetObj(reference.get()) == NULL);
+  heap->SetSoftReferenceMsPerMb(Heap::kDefaultSoftReferenceMsPerMb);
+}
+
+TEST_F(HeapTest, PerThreadAllocationCounter) {
+  ScopedObjectAccess soa(Thread::Current());
+  size_t allocated_before = soa.Self()->GetHeapBytesAllocated();
+  SirtRef<mirror::String> string(soa.Self(),
+                                 mirror::String::AllocFromModifiedUtf8(soa.Self(), "counted"));
+  EXPECT_GE(soa.Self()->GetHeapBytesAllocated() - allocated_before, string->SizeOf());
+}
+
+TEST_F(HeapTest, AllocationStackSegments) {
+  UniquePtr<accounting::ObjectStack> stack(accounting::ObjectStack::Create("test stack", 8));
+  mirror::Object** start1;
+  mirror::Object** end1;
+  mirror::Object** start2;
+  mirror::Object** end2;
+  ASSERT_TRUE(stack->AtomicBumpBack(3, &start1, &end1));
+  ASSERT_TRUE(stack->AtomicBumpBack(3, &start2, &end2));
+  EXPECT_EQ(3, end1 - start1);
+  EXPECT_EQ(end1, start2);
+  EXPECT_EQ(6U, stack->Size());
+  // Slots are claimed, not filled, so they read as NULL until a thread stores to them.
+  EXPECT_TRUE(*start2 == NULL);
+  mirror::Object** start3;
+  mirror::Object** end3;
+  EXPECT_FALSE(stack->AtomicBumpBack(3, &start3, &end3));
+  EXPECT_TRUE(stack->AtomicBumpBack(2, &start3, &end3));
+}
+
+TEST_F(HeapTest, AllocationStackContains) {
+  Heap* heap = Runtime::Current()->GetHeap();
+  {
+    ScopedObjectAccess soa(Thread::Current());
+    mirror::Class* c = class_linker_->FindSystemClass("[Ljava/lang/Object;");
+    SirtRef<mirror::ObjectArray<mirror::Object> > array(soa.Self(),
+        mirror::ObjectArray<mirror::Object>::Alloc(soa.Self(), c, 16));
+    EXPECT_TRUE(heap->AllocationStackContains(array.get()));
+    // Objects pushed after the first query are found too.
+    for (size_t i = 0; i < 16; ++i) {
+      array->Set(i, mirror::ObjectArray<mirror::Object>::Alloc(soa.Self(), c, 1));
+    }
+    for (size_t i = 0; i < 16; ++i) {
+      EXPECT_TRUE(heap->AllocationStackContains(array->Get(i)));
+    }
+    ReaderMutexLock mu(soa.Self(), *Locks::heap_bitmap_lock_);
+    EXPECT_TRUE(heap->IsLiveObjectLocked(array->Get(15)));
+  }
+
+  // The GC starts a new allocation stack, the summary of the old one must not be used for it.
+  heap->CollectGarbage(false);
+  ScopedObjectAccess soa(Thread::Current());
+  mirror::Class* c = class_linker_->FindSystemClass("[Ljava/lang/Object;");
+  SirtRef<mirror::ObjectArray<mirror::Object> > array(soa.Self(),
+      mirror::ObjectArray<mirror::Object>::Alloc(soa.Self(), c, 1));
+  EXPECT_TRUE(heap->AllocationStackContains(array.get()));
+  ReaderMutexLock mu(soa.Self(), *Locks::heap_bitmap_lock_);
+  EXPECT_TRUE(heap->IsLiveObjectLocked(array.get()));
+}
+
+TEST_F(HeapTest, CountAndGetInstances) {
+  ScopedObjectAccess soa(Thread::Current());
+  Heap* heap = Runtime::Current()->GetHeap();
+  mirror::Class* c = class_linker_->FindSystemClass("[Ljava/lang/Object;");
+  SirtRef<mirror::ObjectArray<mirror::Object> > array(soa.Self(),
+      mirror::ObjectArray<mirror::Object>::Alloc(soa.Self(), c, 64));
+  for (size_t i = 0; i < 64; ++i) {
+    array->Set(i, mirror::ObjectArray<mirror::Object>::Alloc(soa.Self(), c, 1));
+  }
+
+  std::vector<mirror::Class*> classes;
+  classes.push_back(c);
+  uint64_t count = 0;
+  heap->CountInstances(classes, false, &count);
+  EXPECT_GE(count, 65U);
+
+  std::vector<mirror::Object*> instances;
+  heap->GetInstances(c, 10, instances);
+  EXPECT_EQ(10U, instances.size());
+  instances.clear();
+  heap->GetInstances(c, 0, instances);
+  EXPECT_EQ(count, instances.size());
+
+  std::vector<mirror::Object*> referrers;
+  heap->GetReferringObjects(array->Get(0), 0, referrers);
+  ASSERT_EQ(1U, referrers.size());
+  EXPECT_EQ(array.get(), referrers[0]);
+}
+
+TEST_F(HeapTest, AllocationSampler) {
+  ScopedObjectAccess soa(Thread::Current());
+  AllocationSampler* sampler = Runtime::Current()->GetHeap()->GetAllocationSampler();
+  EXPECT_FALSE(sampler->IsEnabled());
+  sampler->Start(KB);
+  EXPECT_TRUE(sampler->IsEnabled());
+  for (size_t i = 0; i < 256; ++i) {
+    mirror::String::AllocFromModifiedUtf8(soa.Self(), "sampled allocation");
+  }
+  sampler->Stop();
+  EXPECT_FALSE(sampler->IsEnabled());
+
+  AllocationSampler::SiteMap sites;
+  sampler->GetSites(&sites);
+  ASSERT_FALSE(sites.empty());
+  size_t samples = 0;
+  for (const auto& entry : sites) {
+    EXPECT_TRUE(entry.first.klass != NULL);
+    samples += entry.second.samples;
+  }
+  EXPECT_GT(samples, 0U);
+
+  sampler->Reset();
+  sampler->GetSites(&sites);
+  EXPECT_TRUE(sites.empty());
+}
+
+TEST_F(HeapTest, VerifyHeapReferences) {
+  Heap* heap = Runtime::Current()->GetHeap();
+  ThreadList* thread_list = Runtime::Current()->GetThreadList();
+  Thread* self = Thread::Current();
+  {
+    ScopedObjectAccess soa(self);
+    mirror::Class* c = class_linker_->FindSystemClass("[Ljava/lang/Object;");
+    SirtRef<mirror::ObjectArray<mirror::Object> > array(soa.Self(),
+        mirror::ObjectArray<mirror::Object>::Alloc(soa.Self(), c, 256));
+    for (size_t i = 0; i < 256; ++i) {
+      array->Set(i, mirror::String::AllocFromModifiedUtf8(soa.Self(), "verified"));
+    }
+  }
+  // Every card, then one card in four.
+  for (size_t sampling = 1; sampling <= 4; sampling += 3) {
+    heap->SetVerificationSampling(sampling);
+    thread_list->SuspendAll();
+    {
+      ReaderMutexLock mu(self, *Locks::heap_bitmap_lock_);
+      EXPECT_TRUE(heap->VerifyHeapReferences());
+    }
+    thread_list->ResumeAll();
+  }
+  heap->SetVerificationSampling(1);
+}
+
 TEST_F(HeapTest, HeapBitmapCapacityTest) {
   byte* heap_begin = reinterpret_cast<byte*>(0x1000);
   const size_t heap_capacity = accounting::SpaceBitmap::kAlignment * (sizeof(intptr_t) * 8 + 1);
@@ -37,7 +37,32 @@ inline mirror::Object* DlMallocSpace::AllocNonvirtual(Thread* self, size_t num_b
   return obj;
 }
 
+inline mirror::Object* DlMallocSpace::AllocThreadLocal(Thread* self, size_t num_bytes,
+                                                      size_t* bytes_allocated) {
+  DCHECK_LE(num_bytes, kMaxThreadLocalAllocSize);
+  const size_t bracket = ThreadLocalAllocBracket(num_bytes);
+  void* chunk = self->GetThreadLocalAllocCache(bracket);
+  if (UNLIKELY(chunk == NULL)) {
+    if (!RefillThreadLocalAllocCache(self, bracket)) {
+      return NULL;
+    }
+    chunk = self->GetThreadLocalAllocCache(bracket);
+  }
+  self->SetThreadLocalAllocCache(bracket, *reinterpret_cast<void**>(chunk));
+  mirror::Object* result = reinterpret_cast<mirror::Object*>(chunk);
+  if (kDebugSpaces) {
+    CHECK(Contains(result)) << "Allocation (" << reinterpret_cast<void*>(result)
+          << ") not in bounds of allocation space " << *this;
+  }
+  DCHECK(bytes_allocated != NULL);
+  *bytes_allocated = AllocationSizeNonvirtual(result);
+  // Zero the object, this also clears the free list link.
+  memset(result, 0, num_bytes);
+  return result;
+}
+
 inline mirror::Object* DlMallocSpace::AllocWithoutGrowthLocked(size_t num_bytes, size_t* bytes_allocated) {
+  ++mspace_changes_;
   mirror::Object* result = reinterpret_cast<mirror::Object*>(mspace_malloc(mspace_, num_bytes));
   if (result != NULL) {
     if (kDebugSpaces) {
@@ -18,6 +18,7 @@
 #include "gc/accounting/card_table.h"
 #include "gc/heap.h"
 #include "mirror/object-inl.h"
+#include "run_alloc_space.h"
 #include "runtime.h"
 #include "thread.h"
 #include "utils.h"
@@ -120,7 +121,8 @@ DlMallocSpace::DlMallocSpace(const std::string& name, MemMap* mem_map, void* msp
                        byte* end, size_t growth_limit)
     : MemMapSpace(name, mem_map, end - begin, kGcRetentionPolicyAlwaysCollect),
       recent_free_pos_(0), total_bytes_freed_(0), total_objects_freed_(0),
-      lock_("allocation space lock", kAllocSpaceLock), mspace_(mspace),
+      lock_("allocation space lock", kAllocSpaceLock), mspace_(mspace), mspace_changes_(0),
+      trim_resume_chunk_(NULL), trim_resume_address_(0), trim_resume_changes_(0),
       growth_limit_(growth_limit) {
   CHECK(mspace != NULL);
 
@@ -146,7 +148,8 @@ DlMallocSpace::DlMallocSpace(const std::string& name, MemMap* mem_map, void* msp
 }
 
 DlMallocSpace* DlMallocSpace::Create(const std::string& name, size_t initial_size, size_t
-                                     growth_limit, size_t capacity, byte* requested_begin) {
+                                     growth_limit, size_t capacity, byte* requested_begin,
+                                     bool use_runs) {
   // Memory we promise to dlmalloc before it asks for morecore.
   // Note: making this value large means that large allocations are unlikely to succeed as dlmalloc
   // will ask for this memory from sys_alloc which will fail as the footprint (this value plus the
@@ -183,8 +186,8 @@ DlMallocSpace* DlMallocSpace::Create(const std::string& name, size_t initial_siz
   growth_limit = RoundUp(growth_limit, kPageSize);
   capacity = RoundUp(capacity, kPageSize);
 
-  UniquePtr<MemMap> mem_map(MemMap::MapAnonymous(name.c_str(), requested_begin, capacity,
-                                                 PROT_READ | PROT_WRITE));
+  UniquePtr<MemMap> mem_map(MemMap::MapAnonymousHugePages(name.c_str(), requested_begin, capacity,
+                                                          PROT_READ | PROT_WRITE));
   if (mem_map.get() == NULL) {
     LOG(ERROR) << "Failed to allocate pages for alloc space (" << name << ") of size "
         << PrettySize(capacity);
@@ -209,6 +212,8 @@ DlMallocSpace* DlMallocSpace::Create(const std::string& name, size_t initial_siz
   if (RUNNING_ON_VALGRIND > 0) {
     space = new ValgrindDlMallocSpace(name, mem_map_ptr, mspace, mem_map_ptr->Begin(), end,
                                       growth_limit, initial_size);
+  } else if (use_runs) {
+    space = new RunAllocSpace(name, mem_map_ptr, mspace, mem_map_ptr->Begin(), end, growth_limit);
   } else {
     space = new DlMallocSpace(name, mem_map_ptr, mspace, mem_map_ptr->Begin(), end, growth_limit);
   }
@@ -269,6 +274,65 @@ mirror::Object* DlMallocSpace::AllocWithGrowth(Thread* self, size_t num_bytes, s
   return result;
 }
 
+bool DlMallocSpace::RefillThreadLocalAllocCache(Thread* self, size_t bracket) {
+  DCHECK(self->GetThreadLocalAllocCache(bracket) == NULL);
+  const size_t bracket_size = ThreadLocalAllocBracketSize(bracket);
+  void* head = NULL;
+  {
+    MutexLock mu(self, lock_);
+    ++mspace_changes_;
+    for (size_t i = 0; i < kThreadLocalAllocRefillCount; ++i) {
+      void* chunk = mspace_malloc(mspace_, bracket_size);
+      if (chunk == NULL) {
+        break;
+      }
+      *reinterpret_cast<void**>(chunk) = head;
+      head = chunk;
+    }
+  }
+  self->SetThreadLocalAllocCache(bracket, head);
+  return head != NULL;
+}
+
+void DlMallocSpace::RevokeThreadLocalAllocCache(Thread* thread) {
+  MutexLock mu(Thread::Current(), lock_);
+  ++mspace_changes_;
+  for (size_t bracket = 0; bracket < Thread::kThreadLocalAllocBracketCount; ++bracket) {
+    void* chunk = thread->GetThreadLocalAllocCache(bracket);
+    while (chunk != NULL) {
+      void* next = *reinterpret_cast<void**>(chunk);
+      mspace_free(mspace_, chunk);
+      chunk = next;
+    }
+    thread->SetThreadLocalAllocCache(bracket, NULL);
+  }
+}
+
+void* DlMallocSpace::AllocChunk(Thread* self, size_t alignment, size_t num_bytes, bool grow) {
+  MutexLock mu(self, lock_);
+  ++mspace_changes_;
+  if (grow) {
+    mspace_set_footprint_limit(mspace_, Capacity());
+  }
+  void* result = mspace_memalign(mspace_, alignment, num_bytes);
+  if (grow) {
+    mspace_set_footprint_limit(mspace_, mspace_footprint(mspace_));
+  }
+  return result;
+}
+
+void DlMallocSpace::FreeChunk(Thread* self, void* chunk) {
+  MutexLock mu(self, lock_);
+  ++mspace_changes_;
+  mspace_free(mspace_, chunk);
+}
+
+void DlMallocSpace::RecordFreed(Thread* self, size_t num_objects, size_t num_bytes) {
+  MutexLock mu(self, lock_);
+  total_bytes_freed_ += num_bytes;
+  total_objects_freed_ += num_objects;
+}
+
 void DlMallocSpace::SetGrowthLimit(size_t growth_limit) {
   growth_limit = RoundUp(growth_limit, kPageSize);
   growth_limit_ = growth_limit;
@@ -307,7 +371,8 @@ DlMallocSpace* DlMallocSpace::CreateZygoteSpace(const char* alloc_space_name) {
   VLOG(heap) << "Size " << GetMemMap()->Size();
   VLOG(heap) << "GrowthLimit " << PrettySize(growth_limit);
   VLOG(heap) << "Capacity " << PrettySize(capacity);
-  UniquePtr<MemMap> mem_map(MemMap::MapAnonymous(alloc_space_name, End(), capacity, PROT_READ | PROT_WRITE));
+  UniquePtr<MemMap> mem_map(MemMap::MapAnonymousHugePages(alloc_space_name, End(), capacity,
+                                                          PROT_READ | PROT_WRITE));
   void* mspace = CreateMallocSpace(end_, starting_size, initial_size);
   // Protect memory beyond the initial size.
   byte* end = mem_map->Begin() + starting_size;
@@ -315,7 +380,7 @@ DlMallocSpace* DlMallocSpace::CreateZygoteSpace(const char* alloc_space_name) {
     CHECK_MEMORY_CALL(mprotect, (end, capacity - initial_size, PROT_NONE), alloc_space_name);
   }
   DlMallocSpace* alloc_space =
-      new DlMallocSpace(alloc_space_name, mem_map.release(), mspace, end_, end, growth_limit);
+      CreateInstance(alloc_space_name, mem_map.release(), mspace, end_, end, growth_limit);
   live_bitmap_->SetHeapLimit(reinterpret_cast<uintptr_t>(End()));
   CHECK_EQ(live_bitmap_->HeapLimit(), reinterpret_cast<uintptr_t>(End()));
   mark_bitmap_->SetHeapLimit(reinterpret_cast<uintptr_t>(End()));
@@ -324,6 +389,12 @@ DlMallocSpace* DlMallocSpace::CreateZygoteSpace(const char* alloc_space_name) {
   return alloc_space;
 }
 
+DlMallocSpace* DlMallocSpace::CreateInstance(const std::string& name, MemMap* mem_map,
+                                             void* mspace, byte* begin, byte* end,
+                                             size_t growth_limit) {
+  return new DlMallocSpace(name, mem_map, mspace, begin, end, growth_limit);
+}
+
 mirror::Class* DlMallocSpace::FindRecentFreedObject(const mirror::Object* obj) {
   size_t pos = recent_free_pos_;
   // Start at the most recently freed object and work our way back since there may be duplicates
@@ -357,6 +428,7 @@ size_t DlMallocSpace::Free(Thread* self, mirror::Object* ptr) {
   if (kRecentFreeCount > 0) {
     RegisterRecentFree(ptr);
   }
+  ++mspace_changes_;
   mspace_free(mspace_, ptr);
   return bytes_freed;
 }
@@ -401,6 +473,7 @@ size_t DlMallocSpace::FreeList(Thread* self, size_t num_ptrs, mirror::Object** p
     MutexLock mu(self, lock_);
     total_bytes_freed_ += bytes_freed;
     total_objects_freed_ += num_ptrs;
+    ++mspace_changes_;
     mspace_bulk_free(mspace_, reinterpret_cast<void**>(ptrs), num_ptrs);
     return bytes_freed;
   }
@@ -453,15 +526,75 @@ size_t DlMallocSpace::AllocationSize(const mirror::Object* obj) {
 }
 
 size_t DlMallocSpace::Trim() {
-  MutexLock mu(Thread::Current(), lock_);
-  // Trim to release memory at the end of the space.
-  mspace_trim(mspace_, 0);
-  // Visit space looking for page-sized holes to advise the kernel we don't need.
   size_t reclaimed = 0;
-  mspace_inspect_all(mspace_, DlmallocMadviseCallback, &reclaimed);
+  while (!TrimSlice(&reclaimed)) {
+  }
   return reclaimed;
 }
 
+struct TrimSliceState {
+  // Chunks before this address were visited by an earlier slice.
+  uintptr_t skip_below;
+  uint64_t deadline_ns;
+  size_t chunks_left;
+  uintptr_t reached;
+  size_t reclaimed;
+};
+
+static bool TrimSliceCallback(void* start, void* end, size_t used_bytes, void* arg) {
+  TrimSliceState* state = reinterpret_cast<TrimSliceState*>(arg);
+  if (reinterpret_cast<uintptr_t>(end) <= state->skip_below) {
+    // Stepping over visited chunks is cheap, and not counting them means a slice always gets
+    // further, however often the chunks change in between.
+    return true;
+  }
+  if (reinterpret_cast<uintptr_t>(start) < state->skip_below) {
+    // A free chunk that has grown back over visited pages.
+    start = reinterpret_cast<void*>(state->skip_below);
+  }
+  size_t reclaimed = state->reclaimed;
+  DlmallocMadviseCallback(start, end, used_bytes, &state->reclaimed);
+  state->reached = reinterpret_cast<uintptr_t>(end);
+  --state->chunks_left;
+  if (state->chunks_left == 0) {
+    return false;
+  }
+  // Only look at the clock after a madvise, or every so many chunks.
+  if (state->reclaimed != reclaimed || state->chunks_left % 64 == 0) {
+    return NanoTime() < state->deadline_ns;
+  }
+  return true;
+}
+
+bool DlMallocSpace::TrimSlice(size_t* reclaimed) {
+  // Bounds the chunks a slice visits when the clock isn't read.
+  static const size_t kTrimSliceChunks = 16 * KB;
+  MutexLock mu(Thread::Current(), lock_);
+  TrimSliceState state;
+  state.deadline_ns = NanoTime() + kTrimSliceNs;
+  state.chunks_left = kTrimSliceChunks;
+  state.reclaimed = 0;
+  if (trim_resume_chunk_ == NULL) {
+    // Trim to release memory at the end of the space, then look for page-sized holes to advise
+    // the kernel we don't need.
+    mspace_trim(mspace_, 0);
+    ++mspace_changes_;
+    trim_resume_address_ = 0;
+  }
+  void* resume = trim_resume_chunk_;
+  state.skip_below = trim_resume_address_;
+  state.reached = trim_resume_address_;
+  if (trim_resume_changes_ != mspace_changes_) {
+    // The chunk may have been split or merged since, so walk from the start of the space.
+    resume = NULL;
+  }
+  trim_resume_chunk_ = MspaceInspectFrom(mspace_, resume, TrimSliceCallback, &state);
+  trim_resume_address_ = state.reached;
+  trim_resume_changes_ = mspace_changes_;
+  *reclaimed += state.reclaimed;
+  return trim_resume_chunk_ == NULL;
+}
+
 void DlMallocSpace::Walk(void(*callback)(void *start, void *end, size_t num_bytes, void* callback_arg),
                       void* arg) {
   MutexLock mu(Thread::Current(), lock_);
@@ -19,6 +19,7 @@
 
 #include "gc/allocator/dlmalloc.h"
 #include "space.h"
+#include "thread.h"
 
 namespace art {
 namespace gc {
@@ -45,9 +46,9 @@ class DlMallocSpace : public MemMapSpace, public AllocSpace {
   // Create a AllocSpace with the requested sizes. The requested
   // base address is not guaranteed to be granted, if it is required,
   // the caller should call Begin on the returned space to confirm
-  // the request was granted.
+  // the request was granted. If use_runs is set small allocations are served by a RunAllocSpace.
   static DlMallocSpace* Create(const std::string& name, size_t initial_size, size_t growth_limit,
-                               size_t capacity, byte* requested_begin);
+                               size_t capacity, byte* requested_begin, bool use_runs = false);
 
   // Allocate num_bytes without allowing the underlying mspace to grow.
   virtual mirror::Object* AllocWithGrowth(Thread* self, size_t num_bytes,
@@ -63,6 +64,24 @@ class DlMallocSpace : public MemMapSpace, public AllocSpace {
 
   mirror::Object* AllocNonvirtual(Thread* self, size_t num_bytes, size_t* bytes_allocated);
 
+  // Largest request served from the thread-local allocation cache.
+  static constexpr size_t kMaxThreadLocalAllocSize =
+      Thread::kThreadLocalAllocBracketCount * kObjectAlignment;
+
+  // Number of chunks allocated under lock_ when an empty thread-local bracket is refilled.
+  static constexpr size_t kThreadLocalAllocRefillCount = 8;
+
+  // Allocate num_bytes, which must be at most kMaxThreadLocalAllocSize, from the calling thread's
+  // allocation cache. An empty bracket is refilled with several chunks under a single acquisition
+  // of lock_, so most small allocations don't touch the lock. The chunks are ordinary mspace
+  // chunks so they can be freed individually by the sweeper. The cache isn't tied to a space, so
+  // only the heap's current alloc space may use it.
+  mirror::Object* AllocThreadLocal(Thread* self, size_t num_bytes, size_t* bytes_allocated)
+      LOCKS_EXCLUDED(lock_);
+
+  // Return the chunks cached by thread to the mspace. Thread must not be allocating concurrently.
+  virtual void RevokeThreadLocalAllocCache(Thread* thread) LOCKS_EXCLUDED(lock_);
+
   size_t AllocationSizeNonvirtual(const mirror::Object* obj) {
     return mspace_usable_size(const_cast<void*>(reinterpret_cast<const void*>(obj))) +
         kChunkOverhead;
@@ -75,7 +94,14 @@ class DlMallocSpace : public MemMapSpace, public AllocSpace {
   }
 
   // Hands unused pages back to the system.
-  size_t Trim();
+  size_t Trim() LOCKS_EXCLUDED(lock_);
+
+  // Does part of a trim, holding the lock for about kTrimSliceNs at most so that allocations don't
+  // wait behind it, and adds the bytes it released to reclaimed. Returns true once a trim has
+  // visited the whole space, after which the next call starts another one.
+  bool TrimSlice(size_t* reclaimed) LOCKS_EXCLUDED(lock_);
+
+  static constexpr uint64_t kTrimSliceNs = 1000 * 1000;
 
   // Perform a mspace_inspect_all which calls back for each allocation chunk. The chunk may not be
   // in use, indicated by num_bytes equaling zero.
@@ -127,8 +153,8 @@ class DlMallocSpace : public MemMapSpace, public AllocSpace {
   // Turn ourself into a zygote space and return a new alloc space which has our unused memory.
   DlMallocSpace* CreateZygoteSpace(const char* alloc_space_name);
 
-  uint64_t GetBytesAllocated();
-  uint64_t GetObjectsAllocated();
+  virtual uint64_t GetBytesAllocated();
+  virtual uint64_t GetObjectsAllocated();
   uint64_t GetTotalBytesAllocated() {
     return GetBytesAllocated() + total_bytes_freed_;
   }
@@ -143,10 +169,32 @@ class DlMallocSpace : public MemMapSpace, public AllocSpace {
   DlMallocSpace(const std::string& name, MemMap* mem_map, void* mspace, byte* begin, byte* end,
                 size_t growth_limit);
 
+  // Create the space which takes over the unused memory in CreateZygoteSpace.
+  virtual DlMallocSpace* CreateInstance(const std::string& name, MemMap* mem_map, void* mspace,
+                                        byte* begin, byte* end, size_t growth_limit);
+
+  // Allocate a raw chunk of the mspace, growing it up to Capacity if grow is set. The chunk isn't
+  // zeroed and isn't accounted as an object allocation.
+  void* AllocChunk(Thread* self, size_t alignment, size_t num_bytes, bool grow)
+      LOCKS_EXCLUDED(lock_);
+  void FreeChunk(Thread* self, void* chunk) LOCKS_EXCLUDED(lock_);
+
+  // Account for objects freed without going through Free or FreeList.
+  void RecordFreed(Thread* self, size_t num_objects, size_t num_bytes) LOCKS_EXCLUDED(lock_);
+
  private:
   size_t InternalAllocationSize(const mirror::Object* obj);
   mirror::Object* AllocWithoutGrowthLocked(size_t num_bytes, size_t* bytes_allocated)
       EXCLUSIVE_LOCKS_REQUIRED(lock_);
+  // Allocate a batch of chunks for the given bracket into self's allocation cache, returns false if
+  // the mspace couldn't provide any.
+  bool RefillThreadLocalAllocCache(Thread* self, size_t bracket) LOCKS_EXCLUDED(lock_);
+  static size_t ThreadLocalAllocBracket(size_t num_bytes) {
+    return (RoundUp(num_bytes, kObjectAlignment) / kObjectAlignment) - 1;
+  }
+  static size_t ThreadLocalAllocBracketSize(size_t bracket) {
+    return (bracket + 1) * kObjectAlignment;
+  }
   bool Init(size_t initial_size, size_t maximum_size, size_t growth_size, byte* requested_base);
   void RegisterRecentFree(mirror::Object* ptr);
   static void* CreateMallocSpace(void* base, size_t morecore_start, size_t initial_size);
@@ -176,6 +224,16 @@ class DlMallocSpace : public MemMapSpace, public AllocSpace {
   // Underlying malloc space
   void* const mspace_;
 
+  // Counts allocations and frees in the mspace, which may split or merge the chunk an incremental
+  // trim is to resume from.
+  uint64_t mspace_changes_ GUARDED_BY(lock_);
+
+  // The chunk the trim in progress resumes from, or NULL to start a new one, the address it has
+  // reached and the value of mspace_changes_ when it stopped.
+  void* trim_resume_chunk_ GUARDED_BY(lock_);
+  uintptr_t trim_resume_address_ GUARDED_BY(lock_);
+  uint64_t trim_resume_changes_ GUARDED_BY(lock_);
+
   // The capacity of the alloc space until such time that ClearGrowthLimit is called.
   // The underlying mem_map_ controls the maximum size we allow the heap to grow to. The growth
   // limit is a value <= to the mem_map_ capacity used for ergonomic reasons because of the zygote.
@@ -16,14 +16,21 @@
 
 #include "image_space.h"
 
+#include <pthread.h>
+#include <sys/mman.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
 
 #include "base/stl_util.h"
 #include "base/unix_file/fd_file.h"
 #include "gc/accounting/space_bitmap-inl.h"
+#include "gc/heap.h"
 #include "mirror/art_method.h"
 #include "mirror/class-inl.h"
+#include "mirror/dex_cache.h"
 #include "mirror/object-inl.h"
 #include "oat_file.h"
 #include "os.h"
@@ -37,6 +44,13 @@ namespace space {
 
 AtomicInteger ImageSpace::bitmap_index_(0);
 
+// Image relocation is split over at most this many threads, each patching at least
+// kMinRelocationPagesPerThread pages.
+static constexpr size_t kMaxRelocationThreads = 4;
+static constexpr size_t kMinRelocationPagesPerThread = 64;
+// Words of the image relocation bitmap covering a page of the image.
+static constexpr size_t kRelocationWordsPerPage = kPageSize / (32 * sizeof(uint32_t));
+
 ImageSpace::ImageSpace(const std::string& name, MemMap* mem_map,
                        accounting::SpaceBitmap* live_bitmap)
     : MemMapSpace(name, mem_map, mem_map->Size(), kGcRetentionPolicyNeverCollect) {
@@ -130,23 +144,25 @@ static bool GenerateImage(const std::string& image_file_name) {
   return true;
 }
 
-ImageSpace* ImageSpace::Create(const std::string& original_image_file_name) {
+ImageSpace* ImageSpace::Create(const std::string& original_image_file_name,
+                               ptrdiff_t relocation_delta) {
   if (OS::FileExists(original_image_file_name.c_str())) {
     // If the /system file exists, it should be up-to-date, don't try to generate
-    return space::ImageSpace::Init(original_image_file_name, false);
+    return space::ImageSpace::Init(original_image_file_name, false, relocation_delta);
   }
   // If the /system file didn't exist, we need to use one from the dalvik-cache.
   // If the cache file exists, try to open, but if it fails, regenerate.
   // If it does not exist, generate.
   std::string image_file_name(GetDalvikCacheFilenameOrDie(original_image_file_name));
   if (OS::FileExists(image_file_name.c_str())) {
-    space::ImageSpace* image_space = space::ImageSpace::Init(image_file_name, true);
+    space::ImageSpace* image_space = space::ImageSpace::Init(image_file_name, true,
+                                                             relocation_delta);
     if (image_space != NULL) {
       return image_space;
     }
   }
   CHECK(GenerateImage(image_file_name)) << "Failed to generate image: " << image_file_name;
-  return space::ImageSpace::Init(image_file_name, true);
+  return space::ImageSpace::Init(image_file_name, true, relocation_delta);
 }
 
 void ImageSpace::VerifyImageAllocations() {
@@ -154,13 +170,104 @@ void ImageSpace::VerifyImageAllocations() {
   while (current < End()) {
     DCHECK_ALIGNED(current, kObjectAlignment);
     const mirror::Object* obj = reinterpret_cast<const mirror::Object*>(current);
+    if (!IsAligned<kPageSize>(current) && !live_bitmap_->Test(obj) &&
+        obj->GetClass() == nullptr) {
+      // Zero padding, before the objects the image writer starts on a page of their own.
+      current = reinterpret_cast<byte*>(RoundUp(reinterpret_cast<uintptr_t>(current), kPageSize));
+      continue;
+    }
     CHECK(live_bitmap_->Test(obj));
     CHECK(obj->GetClass() != nullptr) << "Image object at address " << obj << " has null class";
     current += RoundUp(obj->SizeOf(), kObjectAlignment);
   }
 }
 
-ImageSpace* ImageSpace::Init(const std::string& image_file_name, bool validate_oat_file) {
+// A range of an image being relocated, in words of its relocation bitmap. Ranges are whole pages
+// of the image, so that each page is only written by one thread.
+struct ImageRelocationRange {
+  uint32_t* image_words;
+  const uint32_t* relocations;
+  size_t begin;
+  size_t end;
+  ptrdiff_t delta;
+};
+
+static void RelocateImageRange(const ImageRelocationRange& range) {
+  for (size_t i = range.begin; i < range.end; ++i) {
+    // Pages without addresses have no bits set and are left untouched, so they stay clean.
+    uint32_t bits = range.relocations[i];
+    while (bits != 0) {
+      range.image_words[i * 32 + CTZ(bits)] += range.delta;
+      bits &= bits - 1;
+    }
+  }
+}
+
+static void* RelocateImageRangeThread(void* arg) {
+  RelocateImageRange(*reinterpret_cast<ImageRelocationRange*>(arg));
+  return NULL;
+}
+
+bool ImageSpace::RelocateImage(MemMap* image_map, const MemMap& relocations,
+                               ptrdiff_t relocation_delta) {
+  ImageHeader* image_header = reinterpret_cast<ImageHeader*>(image_map->Begin());
+  size_t image_words = RoundUp(image_header->GetImageSize(), sizeof(uint32_t)) / sizeof(uint32_t);
+  size_t relocation_words = image_header->GetImageRelocationsSize() / sizeof(uint32_t);
+  if (relocation_words != RoundUp(image_words, 32) / 32) {
+    LOG(ERROR) << "Image relocation bitmap of " << relocation_words << " words doesn't match "
+               << image_words << " image words";
+    return false;
+  }
+
+  size_t pages = RoundUp(relocation_words, kRelocationWordsPerPage) / kRelocationWordsPerPage;
+  int cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  size_t thread_count = std::min(kMaxRelocationThreads, static_cast<size_t>(std::max(cpus, 1)));
+  thread_count = std::max<size_t>(1, std::min(thread_count, pages / kMinRelocationPagesPerThread));
+  size_t pages_per_thread = RoundUp(pages, thread_count) / thread_count;
+
+  std::vector<ImageRelocationRange> ranges(thread_count);
+  for (size_t i = 0; i < thread_count; ++i) {
+    ImageRelocationRange& range = ranges[i];
+    range.image_words = reinterpret_cast<uint32_t*>(image_map->Begin());
+    range.relocations = reinterpret_cast<const uint32_t*>(relocations.Begin());
+    range.begin = std::min(i * pages_per_thread * kRelocationWordsPerPage, relocation_words);
+    range.end = std::min((i + 1) * pages_per_thread * kRelocationWordsPerPage, relocation_words);
+    range.delta = relocation_delta;
+  }
+  // The runtime isn't up yet, so use plain pthreads. The calling thread takes the first range.
+  std::vector<pthread_t> threads(thread_count);
+  for (size_t i = 1; i < thread_count; ++i) {
+    CHECK_PTHREAD_CALL(pthread_create, (&threads[i], NULL, RelocateImageRangeThread, &ranges[i]),
+                       "image relocation thread");
+  }
+  RelocateImageRange(ranges[0]);
+  for (size_t i = 1; i < thread_count; ++i) {
+    CHECK_PTHREAD_CALL(pthread_join, (threads[i], NULL), "image relocation thread");
+  }
+  image_header->Relocate(relocation_delta);
+  return true;
+}
+
+accounting::SpaceBitmap* ImageSpace::MapLiveBitmap(const std::string& image_file_name,
+                                                   File* file, const ImageHeader& image_header,
+                                                   const MemMap& image_map) {
+  UniquePtr<MemMap> bitmap_map(MemMap::MapFileAtAddress(nullptr,
+                                                        image_header.GetImageBitmapSize(),
+                                                        PROT_READ, MAP_PRIVATE, file->Fd(),
+                                                        image_header.GetBitmapOffset(), false));
+  CHECK(bitmap_map.get() != nullptr) << "failed to map image bitmap";
+  size_t bitmap_index = bitmap_index_.fetch_add(1);
+  std::string bitmap_name(StringPrintf("imagespace %s live-bitmap %u", image_file_name.c_str(),
+                                       bitmap_index));
+  accounting::SpaceBitmap* bitmap =
+      accounting::SpaceBitmap::CreateFromMemMap(bitmap_name, bitmap_map.release(),
+                                                image_map.Begin(), image_map.Size());
+  CHECK(bitmap != nullptr) << "could not create " << bitmap_name;
+  return bitmap;
+}
+
+ImageSpace* ImageSpace::Init(const std::string& image_file_name, bool validate_oat_file,
+                             ptrdiff_t relocation_delta) {
   CHECK(!image_file_name.empty());
 
   uint64_t start_time = 0;
@@ -181,8 +288,23 @@ ImageSpace* ImageSpace::Init(const std::string& image_file_name, bool validate_o
     return NULL;
   }
 
+  UniquePtr<MemMap> relocations;
+  if (relocation_delta != 0) {
+    if (!image_header.HasRelocations()) {
+      LOG(ERROR) << "Image " << image_file_name << " can't be relocated, it has no relocations";
+      return NULL;
+    }
+    relocations.reset(MemMap::MapFileAtAddress(nullptr, image_header.GetRelocationsSize(),
+                                               PROT_READ, MAP_PRIVATE, file->Fd(),
+                                               image_header.GetRelocationsOffset(), false));
+    if (relocations.get() == nullptr) {
+      LOG(ERROR) << "Failed to map relocations of " << image_file_name;
+      return NULL;
+    }
+  }
+
   // Note: The image header is part of the image due to mmap page alignment required of offset.
-  UniquePtr<MemMap> map(MemMap::MapFileAtAddress(image_header.GetImageBegin(),
+  UniquePtr<MemMap> map(MemMap::MapFileAtAddress(image_header.GetImageBegin() + relocation_delta,
                                                  image_header.GetImageSize(),
                                                  PROT_READ | PROT_WRITE,
                                                  MAP_PRIVATE | MAP_FIXED,
@@ -193,22 +315,33 @@ ImageSpace* ImageSpace::Init(const std::string& image_file_name, bool validate_o
     LOG(ERROR) << "Failed to map " << image_file_name;
     return NULL;
   }
-  CHECK_EQ(image_header.GetImageBegin(), map->Begin());
+  CHECK_EQ(image_header.GetImageBegin() + relocation_delta, map->Begin());
   DCHECK_EQ(0, memcmp(&image_header, map->Begin(), sizeof(ImageHeader)));
+  if (relocation_delta != 0) {
+    uint64_t relocation_start_time = NanoTime();
+    if (!RelocateImage(map.get(), *relocations.get(), relocation_delta)) {
+      LOG(ERROR) << "Failed to relocate " << image_file_name;
+      return NULL;
+    }
+    image_header.Relocate(relocation_delta);
+    VLOG(startup) << "Relocated " << image_file_name << " by " << relocation_delta << " bytes in "
+                  << PrettyDuration(NanoTime() - relocation_start_time);
+  }
 
-  UniquePtr<MemMap> image_map(MemMap::MapFileAtAddress(nullptr, image_header.GetImageBitmapSize(),
-                                                       PROT_READ, MAP_PRIVATE,
-                                                       file->Fd(), image_header.GetBitmapOffset(),
-                                                       false));
-  CHECK(image_map.get() != nullptr) << "failed to map image bitmap";
-  size_t bitmap_index = bitmap_index_.fetch_add(1);
-  std::string bitmap_name(StringPrintf("imagespace %s live-bitmap %u", image_file_name.c_str(),
-                                       bitmap_index));
-  UniquePtr<accounting::SpaceBitmap> bitmap(
-      accounting::SpaceBitmap::CreateFromMemMap(bitmap_name, image_map.release(),
-                                                reinterpret_cast<byte*>(map->Begin()),
-                                                map->Size()));
-  CHECK(bitmap.get() != nullptr) << "could not create " << bitmap_name;
+  UniquePtr<accounting::SpaceBitmap> bitmap(MapLiveBitmap(image_file_name, file.get(),
+                                                          image_header, *map.get()));
+
+  if (image_header.GetReadOnlyDexCacheArraysEnd() != 0) {
+    // Once relocated, nothing writes these pages: what is resolved at runtime goes to the dex
+    // caches' overflow table instead. So they stay shared with the other processes mapping the
+    // image, and the protection makes sure of it.
+    byte* begin = map->Begin() + image_header.GetReadOnlyDexCacheArraysBegin();
+    byte* end = map->Begin() + image_header.GetReadOnlyDexCacheArraysEnd();
+    mirror::DexCache::SetReadOnlyArrays(begin, end);
+    if (mprotect(begin, end - begin, PROT_READ) != 0) {
+      PLOG(WARNING) << "Failed to protect the dex cache arrays of " << image_file_name;
+    }
+  }
 
   Runtime* runtime = Runtime::Current();
   mirror::Object* resolution_method = image_header.GetImageRoot(ImageHeader::kResolutionMethod);
@@ -226,11 +359,15 @@ ImageSpace* ImageSpace::Init(const std::string& image_file_name, bool validate_o
     space->VerifyImageAllocations();
   }
 
-  space->oat_file_.reset(space->OpenOatFile());
+  space->oat_file_.reset(space->OpenOatFile(relocation_delta));
   if (space->oat_file_.get() == NULL) {
     LOG(ERROR) << "Failed to open oat file for image: " << image_file_name;
     return NULL;
   }
+  if (relocation_delta != 0 && !space->RelocateOatFile(*relocations.get(), relocation_delta)) {
+    LOG(ERROR) << "Failed to relocate oat file for image: " << image_file_name;
+    return NULL;
+  }
 
   if (validate_oat_file && !space->ValidateOatFile()) {
     LOG(WARNING) << "Failed to validate oat file for image: " << image_file_name;
@@ -244,7 +381,79 @@ ImageSpace* ImageSpace::Init(const std::string& image_file_name, bool validate_o
   return space.release();
 }
 
-OatFile* ImageSpace::OpenOatFile() const {
+ImageSpace* ImageSpace::CreateAppImage(const std::string& image_file_name,
+                                       const OatFile& oat_file) {
+  uint64_t start_time = NanoTime();
+  UniquePtr<File> file(OS::OpenFileForReading(image_file_name.c_str()));
+  if (file.get() == NULL) {
+    // Apps need not have an image.
+    return NULL;
+  }
+  ImageHeader image_header;
+  bool success = file->ReadFully(&image_header, sizeof(image_header));
+  if (!success || !image_header.IsValid() || !image_header.IsAppImage() ||
+      !image_header.HasRelocations()) {
+    LOG(WARNING) << "Invalid app image header " << image_file_name;
+    return NULL;
+  }
+  // The app image points into the boot image, and was written for the code of the oat file.
+  Heap* heap = Runtime::Current()->GetHeap();
+  const ImageHeader& boot_image_header = heap->GetImageSpace()->GetImageHeader();
+  if (image_header.GetBootImageBegin() != boot_image_header.GetImageBegin() ||
+      image_header.GetBootOatChecksum() != boot_image_header.GetOatChecksum()) {
+    LOG(WARNING) << "App image " << image_file_name << " doesn't match the boot image";
+    return NULL;
+  }
+  if (image_header.GetOatChecksum() != oat_file.GetOatHeader().GetChecksum()) {
+    LOG(WARNING) << "App image " << image_file_name << " doesn't match oat file "
+                 << oat_file.GetLocation();
+    return NULL;
+  }
+
+  byte* image_begin = heap->AllocAppImageRange(image_header.GetImageSize());
+  if (image_begin == NULL) {
+    LOG(WARNING) << "No room left to map app image " << image_file_name;
+    return NULL;
+  }
+  UniquePtr<MemMap> relocations(MemMap::MapFileAtAddress(nullptr, image_header.GetRelocationsSize(),
+                                                         PROT_READ, MAP_PRIVATE, file->Fd(),
+                                                         image_header.GetRelocationsOffset(),
+                                                         false));
+  if (relocations.get() == nullptr) {
+    LOG(ERROR) << "Failed to map relocations of " << image_file_name;
+    return NULL;
+  }
+  // The range is part of the heap's reservation, so it may be mapped over.
+  UniquePtr<MemMap> map(MemMap::MapFileAtAddress(image_begin, image_header.GetImageSize(),
+                                                 PROT_READ | PROT_WRITE,
+                                                 MAP_PRIVATE | MAP_FIXED,
+                                                 file->Fd(), 0, true));
+  if (map.get() == NULL) {
+    LOG(ERROR) << "Failed to map " << image_file_name;
+    return NULL;
+  }
+  CHECK_EQ(image_begin, map->Begin());
+  // App images are written for address 0, so are always relocated.
+  ptrdiff_t relocation_delta = reinterpret_cast<uintptr_t>(image_begin) -
+      reinterpret_cast<uintptr_t>(image_header.GetImageBegin());
+  if (!RelocateImage(map.get(), *relocations.get(), relocation_delta)) {
+    LOG(ERROR) << "Failed to relocate " << image_file_name;
+    return NULL;
+  }
+  image_header.Relocate(relocation_delta);
+
+  UniquePtr<accounting::SpaceBitmap> bitmap(MapLiveBitmap(image_file_name, file.get(),
+                                                          image_header, *map.get()));
+  UniquePtr<ImageSpace> space(new ImageSpace(image_file_name, map.release(), bitmap.release()));
+  if (kIsDebugBuild) {
+    space->VerifyImageAllocations();
+  }
+  VLOG(startup) << "Mapped app image " << image_file_name << " in "
+                << PrettyDuration(NanoTime() - start_time) << " " << *space.get();
+  return space.release();
+}
+
+OatFile* ImageSpace::OpenOatFile(ptrdiff_t relocation_delta) const {
   const Runtime* runtime = Runtime::Current();
   const ImageHeader& image_header = GetImageHeader();
   // Grab location but don't use Object::AsString as we haven't yet initialized the roots to
@@ -254,8 +463,14 @@ OatFile* ImageSpace::OpenOatFile() const {
   std::string oat_filename;
   oat_filename += runtime->GetHostPrefix();
   oat_filename += oat_location->ToModifiedUtf8();
-  OatFile* oat_file = OatFile::Open(oat_filename, oat_filename, image_header.GetOatDataBegin(),
-                                    !Runtime::Current()->IsCompiler());
+  OatFile* oat_file;
+  if (relocation_delta == 0) {
+    oat_file = OatFile::Open(oat_filename, oat_filename, image_header.GetOatDataBegin(),
+                             !Runtime::Current()->IsCompiler());
+  } else {
+    oat_file = OatFile::OpenRelocated(oat_filename, oat_filename, image_header.GetOatDataBegin(),
+                                      relocation_delta, !Runtime::Current()->IsCompiler());
+  }
   if (oat_file == NULL) {
     LOG(ERROR) << "Failed to open oat file " << oat_filename << " referenced from image.";
     return NULL;
@@ -271,6 +486,45 @@ OatFile* ImageSpace::OpenOatFile() const {
   return oat_file;
 }
 
+bool ImageSpace::RelocateOatFile(const MemMap& relocations, ptrdiff_t relocation_delta) const {
+  const ImageHeader& image_header = GetImageHeader();
+  const byte* oat_relocations_begin = relocations.Begin() + image_header.GetImageRelocationsSize();
+  const uint32_t* oat_relocations = reinterpret_cast<const uint32_t*>(oat_relocations_begin);
+  size_t count = image_header.GetOatRelocationCount();
+  byte* oat_data_begin = image_header.GetOatDataBegin();
+  size_t oat_data_size = image_header.GetOatDataEnd() - oat_data_begin;
+  int prot = PROT_READ | (Runtime::Current()->IsCompiler() ? 0 : PROT_EXEC);
+  // The relocations are sorted, so the code is made writable a page at a time.
+  size_t i = 0;
+  while (i < count) {
+    uint32_t page_offset = RoundDown(oat_relocations[i], kPageSize);
+    size_t page_end = i;
+    while (page_end < count && oat_relocations[page_end] < page_offset + kPageSize) {
+      if (oat_relocations[page_end] + sizeof(uint32_t) > oat_data_size) {
+        LOG(ERROR) << "Oat relocation " << oat_relocations[page_end] << " out of range";
+        return false;
+      }
+      ++page_end;
+    }
+    byte* begin = oat_data_begin + page_offset;
+    byte* end = oat_data_begin + RoundUp(oat_relocations[page_end - 1] + sizeof(uint32_t),
+                                         kPageSize);
+    if (mprotect(begin, end - begin, PROT_READ | PROT_WRITE) != 0) {
+      PLOG(ERROR) << "Failed to make oat code writable for relocation";
+      return false;
+    }
+    for (; i < page_end; ++i) {
+      *reinterpret_cast<uint32_t*>(oat_data_begin + oat_relocations[i]) += relocation_delta;
+    }
+    if (mprotect(begin, end - begin, prot) != 0) {
+      PLOG(ERROR) << "Failed to restore protection of relocated oat code";
+      return false;
+    }
+    __builtin___clear_cache(reinterpret_cast<char*>(begin), reinterpret_cast<char*>(end));
+  }
+  return true;
+}
+
 bool ImageSpace::ValidateOatFile() const {
   CHECK(oat_file_.get() != NULL);
   for (const OatFile::OatDexFile* oat_dex_file : oat_file_->GetOatDexFiles()) {
@@ -17,6 +17,7 @@
 #ifndef ART_RUNTIME_GC_SPACE_IMAGE_SPACE_H_
 #define ART_RUNTIME_GC_SPACE_IMAGE_SPACE_H_
 
+#include "os.h"
 #include "space.h"
 
 namespace art {
@@ -45,7 +46,18 @@ class ImageSpace : public MemMapSpace {
   // creation of the alloc space. The ReleaseOatFile will later be
   // used to transfer ownership of the OatFile to the ClassLinker when
   // it is initialized.
-  static ImageSpace* Create(const std::string& image)
+  //
+  // A non-zero relocation_delta maps the image and its oat file that
+  // many bytes away from the addresses they were compiled for,
+  // patching the addresses in them.
+  static ImageSpace* Create(const std::string& image, ptrdiff_t relocation_delta)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
+  // Maps an app image written for the given app oat file on top of the
+  // boot image, in the address space the heap keeps for app images,
+  // returning NULL if there is none or it doesn't match the boot image
+  // or oat file. The caller adds the space to the heap.
+  static ImageSpace* CreateAppImage(const std::string& image, const OatFile& oat_file)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
 
   // Releases the OatFile from the ImageSpace so it can be transfer to
@@ -84,12 +96,26 @@ class ImageSpace : public MemMapSpace {
   // image's OatFile is up-to-date relative to its DexFile
   // inputs. Otherwise (for /data), validate the inputs and generate
   // the OatFile in /data/dalvik-cache if necessary.
-  static ImageSpace* Init(const std::string& image, bool validate_oat_file)
+  static ImageSpace* Init(const std::string& image, bool validate_oat_file,
+                          ptrdiff_t relocation_delta)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
 
-  OatFile* OpenOatFile() const
+  // Adds relocation_delta to the addresses in the mapped image, including
+  // its header, using the relocation section of the image file.
+  static bool RelocateImage(MemMap* image_map, const MemMap& relocations,
+                            ptrdiff_t relocation_delta);
+
+  // Maps the live bitmap of the image mapped at image_map.
+  static accounting::SpaceBitmap* MapLiveBitmap(const std::string& image_file_name, File* file,
+                                                const ImageHeader& image_header,
+                                                const MemMap& image_map);
+
+  OatFile* OpenOatFile(ptrdiff_t relocation_delta) const
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
 
+  // Adds relocation_delta to the addresses in the code of the oat file.
+  bool RelocateOatFile(const MemMap& relocations, ptrdiff_t relocation_delta) const;
+
   bool ValidateOatFile() const
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
 
@@ -50,21 +50,73 @@ void LargeObjectSpace::CopyLiveToMarked() {
 
 LargeObjectMapSpace::LargeObjectMapSpace(const std::string& name)
     : LargeObjectSpace(name),
-      lock_("large object map space lock", kAllocSpaceLock) {}
+      lock_("large object map space lock", kAllocSpaceLock),
+      cached_bytes_(0),
+      last_release_time_ns_(0) {}
+
+LargeObjectMapSpace::~LargeObjectMapSpace() {
+  for (MemMaps::iterator it = mem_maps_.begin(); it != mem_maps_.end(); ++it) {
+    delete it->second;
+  }
+  for (size_t i = 0; i < kNumSizeClasses; ++i) {
+    for (const FreeRun& run : free_runs_[i]) {
+      delete run.mem_map;
+    }
+  }
+  STLDeleteElements(&runs_to_unmap_);
+}
 
 LargeObjectMapSpace* LargeObjectMapSpace::Create(const std::string& name) {
   return new LargeObjectMapSpace(name);
 }
 
+size_t LargeObjectMapSpace::RunSize(size_t num_bytes, size_t* size_class) {
+  COMPILE_ASSERT(kMaxCachedRunSize == 256 * kPageSize, size_classes_do_not_match_max_run_size);
+  size_t pages = RoundUp(num_bytes, kPageSize) / kPageSize;
+  if (pages == 0 || pages > kMaxCachedRunSize / kPageSize) {
+    *size_class = kNumSizeClasses;
+    return pages * kPageSize;
+  }
+  if (pages <= 8) {
+    *size_class = pages - 1;
+    return pages * kPageSize;
+  }
+  // The power of two below the run, which the run is at most twice of.
+  size_t log2_base = 31 - CLZ(pages - 1);
+  size_t base = 1 << log2_base;
+  size_t step = base / 4;
+  pages = RoundUp(pages, step);
+  *size_class = 8 + 4 * (log2_base - 3) + (pages - base) / step - 1;
+  DCHECK_LT(*size_class, kNumSizeClasses);
+  return pages * kPageSize;
+}
+
 mirror::Object* LargeObjectMapSpace::Alloc(Thread* self, size_t num_bytes, size_t* bytes_allocated) {
-  MemMap* mem_map = MemMap::MapAnonymous("large object space allocation", NULL, num_bytes,
-                                         PROT_READ | PROT_WRITE);
-  if (mem_map == NULL) {
-    return NULL;
+  size_t size_class;
+  size_t run_size = RunSize(num_bytes, &size_class);
+  MemMap* mem_map = NULL;
+  bool needs_zeroing = false;
+  if (size_class < kNumSizeClasses) {
+    MutexLock mu(self, lock_);
+    FreeRuns& free_runs = free_runs_[size_class];
+    if (!free_runs.empty()) {
+      mem_map = free_runs.back().mem_map;
+      needs_zeroing = !free_runs.back().released;
+      free_runs.pop_back();
+      cached_bytes_ -= run_size;
+    }
+  }
+  if (needs_zeroing) {
+    memset(mem_map->Begin(), 0, num_bytes);
+  } else if (mem_map == NULL) {
+    mem_map = MemMap::MapAnonymous("large object space allocation", NULL, run_size,
+                                   PROT_READ | PROT_WRITE);
+    if (mem_map == NULL) {
+      return NULL;
+    }
   }
   MutexLock mu(self, lock_);
   mirror::Object* obj = reinterpret_cast<mirror::Object*>(mem_map->Begin());
-  large_objects_.push_back(obj);
   mem_maps_.Put(obj, mem_map);
   size_t allocation_size = mem_map->Size();
   DCHECK(bytes_allocated != NULL);
@@ -78,17 +130,88 @@ mirror::Object* LargeObjectMapSpace::Alloc(Thread* self, size_t num_bytes, size_
 
 size_t LargeObjectMapSpace::Free(Thread* self, mirror::Object* ptr) {
   MutexLock mu(self, lock_);
+  return FreeLocked(ptr, NanoTime());
+}
+
+size_t LargeObjectMapSpace::FreeList(Thread* self, size_t num_ptrs, mirror::Object** ptrs) {
+  MutexLock mu(self, lock_);
+  uint64_t now_ns = NanoTime();
+  size_t total = 0;
+  for (size_t i = 0; i < num_ptrs; ++i) {
+    total += FreeLocked(ptrs[i], now_ns);
+  }
+  return total;
+}
+
+size_t LargeObjectMapSpace::FreeLocked(mirror::Object* ptr, uint64_t now_ns) {
   MemMaps::iterator found = mem_maps_.find(ptr);
   CHECK(found != mem_maps_.end()) << "Attempted to free large object which was not live";
   DCHECK_GE(num_bytes_allocated_, found->second->Size());
-  size_t allocation_size = found->second->Size();
+  MemMap* mem_map = found->second;
+  size_t allocation_size = mem_map->Size();
   num_bytes_allocated_ -= allocation_size;
   --num_objects_allocated_;
-  delete found->second;
   mem_maps_.erase(found);
+  size_t size_class;
+  RunSize(allocation_size, &size_class);
+  if (size_class < kNumSizeClasses && cached_bytes_ + allocation_size <= kMaxCachedBytes) {
+    FreeRun run = { mem_map, now_ns, false };
+    free_runs_[size_class].push_back(run);
+    cached_bytes_ += allocation_size;
+  } else {
+    runs_to_unmap_.push_back(mem_map);
+  }
+  if (now_ns - last_release_time_ns_ > kRunIdleTimeNs) {
+    ReleaseIdleRuns(now_ns);
+  }
   return allocation_size;
 }
 
+void LargeObjectMapSpace::ReleaseIdleRuns(uint64_t now_ns) {
+  last_release_time_ns_ = now_ns;
+  for (size_t i = 0; i < kNumSizeClasses; ++i) {
+    for (FreeRun& run : free_runs_[i]) {
+      if (now_ns - run.free_time_ns <= kRunIdleTimeNs) {
+        // The rest of the list was freed more recently still.
+        break;
+      }
+      if (!run.released) {
+        madvise(run.mem_map->Begin(), run.mem_map->Size(), MADV_DONTNEED);
+        run.released = true;
+      }
+    }
+  }
+}
+
+size_t LargeObjectMapSpace::UnmapFreedRuns() {
+  std::vector<MemMap*, accounting::GCAllocator<MemMap*> > runs;
+  {
+    MutexLock mu(Thread::Current(), lock_);
+    runs.swap(runs_to_unmap_);
+  }
+  size_t unmapped = 0;
+  for (MemMap* mem_map : runs) {
+    unmapped += mem_map->Size();
+    delete mem_map;
+  }
+  return unmapped;
+}
+
+size_t LargeObjectMapSpace::Trim() {
+  size_t reclaimed = UnmapFreedRuns();
+  MutexLock mu(Thread::Current(), lock_);
+  for (size_t i = 0; i < kNumSizeClasses; ++i) {
+    for (FreeRun& run : free_runs_[i]) {
+      if (!run.released) {
+        madvise(run.mem_map->Begin(), run.mem_map->Size(), MADV_DONTNEED);
+        run.released = true;
+        reclaimed += run.mem_map->Size();
+      }
+    }
+  }
+  return reclaimed;
+}
+
 size_t LargeObjectMapSpace::AllocationSize(const mirror::Object* obj) {
   MutexLock mu(Thread::Current(), lock_);
   MemMaps::iterator found = mem_maps_.find(const_cast<mirror::Object*>(obj));
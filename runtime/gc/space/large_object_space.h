@@ -59,6 +59,18 @@ class LargeObjectSpace : public DiscontinuousSpace, public AllocSpace {
 
   size_t FreeList(Thread* self, size_t num_ptrs, mirror::Object** ptrs);
 
+  // Gives memory the space holds on to but doesn't use back to the kernel, returning how many
+  // bytes were released.
+  virtual size_t Trim() {
+    return 0;
+  }
+
+  // Unmaps the memory of objects freed since the last call, which frees leave mapped so that they
+  // make no system calls holding locks. Returns how many bytes were unmapped.
+  virtual size_t UnmapFreedRuns() {
+    return 0;
+  }
+
  protected:
   explicit LargeObjectSpace(const std::string& name);
 
@@ -74,7 +86,10 @@ class LargeObjectSpace : public DiscontinuousSpace, public AllocSpace {
   DISALLOW_COPY_AND_ASSIGN(LargeObjectSpace);
 };
 
-// A discontinuous large object space implemented by individual mmap/munmap calls.
+// A discontinuous large object space where each object has a run of pages of its own. Freed runs
+// of up to kMaxCachedRunSize stay mapped, in free lists by size class, so that the next
+// allocations of about the same size take neither a mmap nor a new VMA. Runs that stay unused for
+// kRunIdleTimeNs have their pages released with madvise.
 class LargeObjectMapSpace : public LargeObjectSpace {
  public:
   // Creates a large object space. Allocations into the large object space use memory maps instead
@@ -84,22 +99,61 @@ class LargeObjectMapSpace : public LargeObjectSpace {
   // Return the storage space required by obj.
   size_t AllocationSize(const mirror::Object* obj);
   mirror::Object* Alloc(Thread* self, size_t num_bytes, size_t* bytes_allocated);
-  size_t Free(Thread* self, mirror::Object* ptr);
+  size_t Free(Thread* self, mirror::Object* ptr) LOCKS_EXCLUDED(lock_);
+  // Frees the objects taking lock_ once.
+  size_t FreeList(Thread* self, size_t num_ptrs, mirror::Object** ptrs) LOCKS_EXCLUDED(lock_);
   void Walk(DlMallocSpace::WalkCallback, void* arg) LOCKS_EXCLUDED(lock_);
   // TODO: disabling thread safety analysis as this may be called when we already hold lock_.
   bool Contains(const mirror::Object* obj) const NO_THREAD_SAFETY_ANALYSIS;
 
+  // Releases the pages of every cached run, idle or not, and unmaps the freed runs.
+  size_t Trim() LOCKS_EXCLUDED(lock_);
+
+  size_t UnmapFreedRuns() LOCKS_EXCLUDED(lock_);
+
+  // Returns the size of the run that holds num_bytes, and sets size_class to the free list such
+  // runs are cached in, or to kNumSizeClasses for runs too big to cache.
+  static size_t RunSize(size_t num_bytes, size_t* size_class);
+
+  static constexpr size_t kMaxCachedRunSize = 256 * kPageSize;
+  // Runs of up to eight pages have a size class each. Bigger runs are rounded up to a quarter of
+  // the power of two below them, giving four classes per doubling: 10, 12, 14, 16, 20, 24...
+  // pages, and 28 classes up to kMaxCachedRunSize.
+  static constexpr size_t kNumSizeClasses = 28;
+  // Cached runs beyond this many bytes are unmapped when freed instead.
+  static constexpr size_t kMaxCachedBytes = 16 * MB;
+  static constexpr uint64_t kRunIdleTimeNs = 2000 * 1000 * 1000ULL;
+
  private:
   explicit LargeObjectMapSpace(const std::string& name);
-  virtual ~LargeObjectMapSpace() {}
+  virtual ~LargeObjectMapSpace();
+
+  struct FreeRun {
+    MemMap* mem_map;
+    uint64_t free_time_ns;
+    // If the pages were released to the kernel, the run reads as zeroes again.
+    bool released;
+  };
+
+  // Releases the pages of cached runs freed before the idle time.
+  void ReleaseIdleRuns(uint64_t now_ns) EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  // Frees ptr, caching its run or queueing it for UnmapFreedRuns. Returns its allocation size.
+  size_t FreeLocked(mirror::Object* ptr, uint64_t now_ns) EXCLUSIVE_LOCKS_REQUIRED(lock_);
 
   // Used to ensure mutual exclusion when the allocation spaces data structures are being modified.
   mutable Mutex lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
-  std::vector<mirror::Object*,
-      accounting::GCAllocator<mirror::Object*> > large_objects_ GUARDED_BY(lock_);
   typedef SafeMap<mirror::Object*, MemMap*, std::less<mirror::Object*>,
       accounting::GCAllocator<std::pair<const mirror::Object*, MemMap*> > > MemMaps;
   MemMaps mem_maps_ GUARDED_BY(lock_);
+  // Ordered by the time the runs were freed, so the most recently used are reused first and the
+  // idle ones are at the front.
+  typedef std::vector<FreeRun, accounting::GCAllocator<FreeRun> > FreeRuns;
+  FreeRuns free_runs_[kNumSizeClasses] GUARDED_BY(lock_);
+  size_t cached_bytes_ GUARDED_BY(lock_);
+  uint64_t last_release_time_ns_ GUARDED_BY(lock_);
+  // Freed runs which aren't cached, still mapped until UnmapFreedRuns.
+  std::vector<MemMap*, accounting::GCAllocator<MemMap*> > runs_to_unmap_ GUARDED_BY(lock_);
 };
 
 // A continuous large object space with a free-list to handle holes.
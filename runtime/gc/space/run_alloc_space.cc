@@ -0,0 +1,370 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "run_alloc_space.h"
+
+#include "base/mutex-inl.h"
+#include "gc/heap.h"
+#include "numa.h"
+#include "runtime.h"
+#include "thread.h"
+#include "utils.h"
+
+#include <algorithm>
+
+namespace art {
+namespace gc {
+namespace space {
+
+static const uint32_t kAllSlotsAllocated = 0xFFFFFFFF;
+
+mirror::Object* RunAllocSpace::Run::AllocSlot() {
+  for (size_t i = 0; i < kBitMapWords; ++i) {
+    const uint32_t free_slots = ~alloc_bit_map_[i];
+    if (free_slots != 0) {
+      const size_t bit = CTZ(free_slots);
+      alloc_bit_map_[i] |= 1U << bit;
+      const size_t slot = i * kBitsPerByte * sizeof(uint32_t) + bit;
+      DCHECK_LT(slot, num_slots_);
+      return reinterpret_cast<mirror::Object*>(FirstSlot() + slot * BracketSize(bracket_));
+    }
+  }
+  return NULL;
+}
+
+void RunAllocSpace::Run::FreeSlot(size_t slot) {
+  DCHECK_LT(slot, num_slots_);
+  const size_t word = slot / (kBitsPerByte * sizeof(uint32_t));
+  const uint32_t mask = 1U << (slot % (kBitsPerByte * sizeof(uint32_t)));
+  DCHECK_NE(alloc_bit_map_[word] & mask, 0U) << "Freeing free slot " << slot;
+  if (is_thread_local_) {
+    thread_local_free_bit_map_[word] |= mask;
+  } else {
+    alloc_bit_map_[word] &= ~mask;
+  }
+}
+
+void RunAllocSpace::Run::MergeThreadLocalFreeBitMap() {
+  for (size_t i = 0; i < kBitMapWords; ++i) {
+    alloc_bit_map_[i] &= ~thread_local_free_bit_map_[i];
+    thread_local_free_bit_map_[i] = 0;
+  }
+}
+
+bool RunAllocSpace::Run::IsFull() const {
+  for (size_t i = 0; i < kBitMapWords; ++i) {
+    if (alloc_bit_map_[i] != kAllSlotsAllocated) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool RunAllocSpace::Run::IsEmpty() const {
+  return NumAllocatedSlots() == 0;
+}
+
+size_t RunAllocSpace::Run::NumAllocatedSlots() const {
+  size_t count = 0;
+  for (size_t i = 0; i < kBitMapWords; ++i) {
+    count += __builtin_popcount(alloc_bit_map_[i] & ~thread_local_free_bit_map_[i]);
+  }
+  // Bits past the last slot are permanently set.
+  return count - (kMaxSlotsPerRun - num_slots_);
+}
+
+RunAllocSpace::RunAllocSpace(const std::string& name, MemMap* mem_map, void* mspace, byte* begin,
+                             byte* end, size_t growth_limit)
+    : DlMallocSpace(name, mem_map, mspace, begin, end, growth_limit),
+      page_map_(mem_map->Size() / kRunSize, 0) {
+  COMPILE_ASSERT(kMaxSlotsPerRun % (kBitsPerByte * sizeof(uint32_t)) == 0,
+                 bit_maps_must_cover_whole_words);
+  COMPILE_ASSERT(kHeaderSize + kMaxBracketSize <= kRunSize, runs_must_hold_a_slot);
+  COMPILE_ASSERT(kMaxBracketSize / kBracketQuantum <= 256, bracket_index_must_fit_a_byte);
+  CHECK(IsAligned<kRunSize>(begin));
+  for (size_t i = 0; i < kNumBrackets; ++i) {
+    bracket_locks_[i] = new Mutex("run alloc space bracket lock", kRunAllocSpaceBracketLock);
+    current_runs_[i] = NULL;
+  }
+}
+
+RunAllocSpace::~RunAllocSpace() {
+  for (size_t i = 0; i < kNumBrackets; ++i) {
+    delete bracket_locks_[i];
+  }
+}
+
+DlMallocSpace* RunAllocSpace::CreateInstance(const std::string& name, MemMap* mem_map,
+                                             void* mspace, byte* begin, byte* end,
+                                             size_t growth_limit) {
+  return new RunAllocSpace(name, mem_map, mspace, begin, end, growth_limit);
+}
+
+mirror::Object* RunAllocSpace::Alloc(Thread* self, size_t num_bytes, size_t* bytes_allocated) {
+  if (num_bytes > kMaxBracketSize) {
+    return DlMallocSpace::Alloc(self, num_bytes, bytes_allocated);
+  }
+  return AllocFromRun(self, num_bytes, bytes_allocated, false);
+}
+
+mirror::Object* RunAllocSpace::AllocWithGrowth(Thread* self, size_t num_bytes,
+                                               size_t* bytes_allocated) {
+  if (num_bytes > kMaxBracketSize) {
+    return DlMallocSpace::AllocWithGrowth(self, num_bytes, bytes_allocated);
+  }
+  return AllocFromRun(self, num_bytes, bytes_allocated, true);
+}
+
+mirror::Object* RunAllocSpace::AllocFromRun(Thread* self, size_t num_bytes,
+                                            size_t* bytes_allocated, bool grow) {
+  const size_t bracket = BracketIndex(num_bytes);
+  mirror::Object* result;
+  if (bracket < kNumThreadLocalBrackets) {
+    result = AllocFromThreadLocalRun(self, bracket, grow);
+  } else {
+    MutexLock mu(self, *bracket_locks_[bracket]);
+    Run* run = current_runs_[bracket];
+    if (run == NULL || run->IsFull()) {
+      // A full run is only picked up again once the sweeper frees one of its slots.
+      run = RefillRun(self, bracket, grow);
+      current_runs_[bracket] = run;
+    }
+    result = (run != NULL) ? run->AllocSlot() : NULL;
+  }
+  if (result != NULL) {
+    *bytes_allocated = BracketSize(bracket);
+    // Slots are recycled without being cleared.
+    memset(result, 0, num_bytes);
+  }
+  CHECK(!kDebugSpaces || result == NULL || Contains(result));
+  return result;
+}
+
+mirror::Object* RunAllocSpace::AllocFromThreadLocalRun(Thread* self, size_t bracket, bool grow) {
+  Run* run = reinterpret_cast<Run*>(self->GetThreadLocalRun(bracket));
+  if (UNLIKELY(run == NULL || run->IsFull())) {
+    MutexLock mu(self, *bracket_locks_[bracket]);
+    if (run != NULL) {
+      // Pick up the slots freed while we owned the run before giving up on it.
+      run->MergeThreadLocalFreeBitMap();
+      if (run->IsFull()) {
+        run->is_thread_local_ = 0;
+        run = NULL;
+      }
+    }
+    if (run == NULL) {
+      run = RefillRun(self, bracket, grow);
+      self->SetThreadLocalRun(bracket, run);
+      if (run == NULL) {
+        return NULL;
+      }
+      run->is_thread_local_ = 1;
+    }
+  }
+  // Only the owner sets bits in the alloc bit map of a thread local run, so no lock is needed.
+  return run->AllocSlot();
+}
+
+std::set<RunAllocSpace::Run*>::iterator RunAllocSpace::FindLocalRun(std::set<Run*>& runs) {
+  Heap* heap = Runtime::Current()->GetHeap();
+  if (!heap->IsNumaEnabled()) {
+    return runs.begin();
+  }
+  const size_t num_nodes = Numa::NumNodes();
+  const size_t node = Numa::CurrentNode();
+  std::set<Run*>::iterator it = runs.begin();
+  while (it != runs.end()) {
+    const size_t run_node = heap->NumaNodeOf(*it);
+    if (run_node == node) {
+      return it;
+    }
+    // Skip to the next region of node, runs are ordered by address.
+    const uintptr_t region = RoundDown(reinterpret_cast<uintptr_t>(*it), Heap::kNumaRegionSize);
+    const size_t regions_to_skip = (node + num_nodes - run_node) % num_nodes;
+    it = runs.lower_bound(reinterpret_cast<Run*>(region + regions_to_skip * Heap::kNumaRegionSize));
+  }
+  return runs.begin();
+}
+
+RunAllocSpace::Run* RunAllocSpace::RefillRun(Thread* self, size_t bracket, bool grow) {
+  bracket_locks_[bracket]->AssertHeld(self);
+  std::set<Run*>& non_full_runs = non_full_runs_[bracket];
+  if (!non_full_runs.empty()) {
+    std::set<Run*>::iterator it = non_full_runs.begin();
+    if (bracket < kNumThreadLocalBrackets) {
+      it = FindLocalRun(non_full_runs);
+    }
+    Run* run = *it;
+    non_full_runs.erase(it);
+    DCHECK(!run->IsFull());
+    return run;
+  }
+  Run* run = reinterpret_cast<Run*>(AllocChunk(self, kRunSize, kRunSize, grow));
+  if (run == NULL) {
+    return NULL;
+  }
+  DCHECK(IsAligned<kRunSize>(run));
+  run->bracket_ = bracket;
+  run->is_thread_local_ = 0;
+  run->num_slots_ = (kRunSize - kHeaderSize) / BracketSize(bracket);
+  memset(run->alloc_bit_map_, 0, sizeof(run->alloc_bit_map_));
+  memset(run->thread_local_free_bit_map_, 0, sizeof(run->thread_local_free_bit_map_));
+  // Mark the bits past the last slot as allocated so that AllocSlot never hands them out.
+  for (size_t slot = run->num_slots_; slot < kMaxSlotsPerRun; ++slot) {
+    run->alloc_bit_map_[slot / (kBitsPerByte * sizeof(uint32_t))] |=
+        1U << (slot % (kBitsPerByte * sizeof(uint32_t)));
+  }
+  page_map_[(reinterpret_cast<byte*>(run) - Begin()) / kRunSize] = 1;
+  return run;
+}
+
+void RunAllocSpace::ReleaseRun(Thread* self, Run* run) {
+  bracket_locks_[run->bracket_]->AssertHeld(self);
+  DCHECK(!run->is_thread_local_);
+  if (run->IsEmpty()) {
+    non_full_runs_[run->bracket_].erase(run);
+    page_map_[(reinterpret_cast<byte*>(run) - Begin()) / kRunSize] = 0;
+    FreeChunk(self, run);
+  } else if (!run->IsFull()) {
+    non_full_runs_[run->bracket_].insert(run);
+  }
+}
+
+size_t RunAllocSpace::FreeSlots(Thread* self, Run* run, mirror::Object** ptrs, size_t num_ptrs) {
+  const size_t bracket = run->bracket_;
+  {
+    MutexLock mu(self, *bracket_locks_[bracket]);
+    for (size_t i = 0; i < num_ptrs; ++i) {
+      if (kDebugSpaces) {
+        CHECK(Contains(ptrs[i])) << "Free (" << ptrs[i] << ") not in bounds of heap " << *this;
+      }
+      run->FreeSlot(run->SlotIndex(ptrs[i]));
+    }
+    // Thread local runs are released by their owner, the shared current run stays put.
+    if (!run->is_thread_local_ && run != current_runs_[bracket]) {
+      ReleaseRun(self, run);
+    }
+  }
+  const size_t bytes_freed = num_ptrs * BracketSize(bracket);
+  RecordFreed(self, num_ptrs, bytes_freed);
+  return bytes_freed;
+}
+
+size_t RunAllocSpace::Free(Thread* self, mirror::Object* ptr) {
+  Run* run = RunOf(ptr);
+  if (run == NULL) {
+    return DlMallocSpace::Free(self, ptr);
+  }
+  return FreeSlots(self, run, &ptr, 1);
+}
+
+size_t RunAllocSpace::FreeList(Thread* self, size_t num_ptrs, mirror::Object** ptrs) {
+  DCHECK(ptrs != NULL);
+  // Move the run slots to the end of ptrs and sort them so that the slots of a run are adjacent,
+  // each run's bracket lock is then only taken once for the whole batch.
+  mirror::Object** const ptrs_end = ptrs + num_ptrs;
+  mirror::Object** const slots_begin = std::partition(ptrs, ptrs_end, [this](mirror::Object* obj) {
+    return RunOf(obj) == NULL;
+  });
+  std::sort(slots_begin, ptrs_end);
+  size_t bytes_freed = 0;
+  for (mirror::Object** it = slots_begin; it != ptrs_end;) {
+    Run* run = RunOf(*it);
+    mirror::Object** run_end = it + 1;
+    while (run_end != ptrs_end && RunOf(*run_end) == run) {
+      ++run_end;
+    }
+    bytes_freed += FreeSlots(self, run, it, run_end - it);
+    it = run_end;
+  }
+  const size_t num_chunks = slots_begin - ptrs;
+  if (num_chunks != 0) {
+    bytes_freed += DlMallocSpace::FreeList(self, num_chunks, ptrs);
+  }
+  return bytes_freed;
+}
+
+size_t RunAllocSpace::AllocationSize(const mirror::Object* obj) {
+  Run* run = RunOf(obj);
+  if (run == NULL) {
+    return DlMallocSpace::AllocationSize(obj);
+  }
+  return BracketSize(run->bracket_);
+}
+
+void RunAllocSpace::RevokeThreadLocalAllocCache(Thread* thread) {
+  DlMallocSpace::RevokeThreadLocalAllocCache(thread);
+  Thread* self = Thread::Current();
+  for (size_t bracket = 0; bracket < kNumThreadLocalBrackets; ++bracket) {
+    Run* run = reinterpret_cast<Run*>(thread->GetThreadLocalRun(bracket));
+    if (run != NULL) {
+      MutexLock mu(self, *bracket_locks_[bracket]);
+      run->MergeThreadLocalFreeBitMap();
+      run->is_thread_local_ = 0;
+      ReleaseRun(self, run);
+      thread->SetThreadLocalRun(bracket, NULL);
+    }
+  }
+}
+
+struct RunAllocSpaceCount {
+  RunAllocSpace* space;
+  size_t count;
+};
+
+void RunAllocSpace::BytesAllocatedCallback(void* start, void* /*end*/, size_t used_bytes,
+                                           void* arg) {
+  if (used_bytes == 0) {
+    return;
+  }
+  RunAllocSpaceCount* context = reinterpret_cast<RunAllocSpaceCount*>(arg);
+  Run* run = context->space->RunOf(reinterpret_cast<mirror::Object*>(start));
+  if (run != NULL) {
+    context->count += run->NumAllocatedSlots() * BracketSize(run->bracket_);
+  } else {
+    context->count += used_bytes + sizeof(size_t);
+  }
+}
+
+void RunAllocSpace::ObjectsAllocatedCallback(void* start, void* /*end*/, size_t used_bytes,
+                                             void* arg) {
+  if (used_bytes == 0) {
+    return;
+  }
+  RunAllocSpaceCount* context = reinterpret_cast<RunAllocSpaceCount*>(arg);
+  Run* run = context->space->RunOf(reinterpret_cast<mirror::Object*>(start));
+  if (run != NULL) {
+    context->count += run->NumAllocatedSlots();
+  } else {
+    ++context->count;
+  }
+}
+
+uint64_t RunAllocSpace::GetBytesAllocated() {
+  RunAllocSpaceCount context = { this, 0 };
+  Walk(BytesAllocatedCallback, &context);
+  return context.count;
+}
+
+uint64_t RunAllocSpace::GetObjectsAllocated() {
+  RunAllocSpaceCount context = { this, 0 };
+  Walk(ObjectsAllocatedCallback, &context);
+  return context.count;
+}
+
+}  // namespace space
+}  // namespace gc
+}  // namespace art
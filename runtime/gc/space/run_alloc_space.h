@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ART_RUNTIME_GC_SPACE_RUN_ALLOC_SPACE_H_
+#define ART_RUNTIME_GC_SPACE_RUN_ALLOC_SPACE_H_
+
+#include "base/mutex.h"
+#include "dlmalloc_space.h"
+
+#include <set>
+#include <vector>
+
+namespace art {
+namespace gc {
+namespace space {
+
+// An alloc space which serves small allocations from page sized runs of equally sized slots,
+// segregated by size bracket. Each bracket has its own lock and, for the smallest brackets, each
+// thread owns a current run it allocates from without locking. Runs are carved out of the
+// underlying mspace, which still serves allocations too large for any bracket, so objects keep
+// living in the space's SpaceBitmap and are swept like any other DlMallocSpace allocation.
+class RunAllocSpace : public DlMallocSpace {
+ public:
+  // Slot sizes are multiples of kBracketQuantum up to kMaxBracketSize.
+  static constexpr size_t kBracketQuantum = 16;
+  static constexpr size_t kNumBrackets = 32;
+  static constexpr size_t kMaxBracketSize = kNumBrackets * kBracketQuantum;
+
+  // Brackets below this index use per-thread current runs, the others share a run per bracket.
+  static constexpr size_t kNumThreadLocalBrackets = Thread::kThreadLocalRunBracketCount;
+
+  virtual mirror::Object* AllocWithGrowth(Thread* self, size_t num_bytes, size_t* bytes_allocated);
+  virtual mirror::Object* Alloc(Thread* self, size_t num_bytes, size_t* bytes_allocated);
+  virtual size_t AllocationSize(const mirror::Object* obj);
+  virtual size_t Free(Thread* self, mirror::Object* ptr);
+  virtual size_t FreeList(Thread* self, size_t num_ptrs, mirror::Object** ptrs);
+
+  // Hand the thread's current runs back to the space. Thread must not be allocating concurrently.
+  virtual void RevokeThreadLocalAllocCache(Thread* thread);
+
+  virtual uint64_t GetBytesAllocated();
+  virtual uint64_t GetObjectsAllocated();
+
+  RunAllocSpace(const std::string& name, MemMap* mem_map, void* mspace, byte* begin, byte* end,
+                size_t growth_limit);
+  virtual ~RunAllocSpace();
+
+ protected:
+  virtual DlMallocSpace* CreateInstance(const std::string& name, MemMap* mem_map, void* mspace,
+                                        byte* begin, byte* end, size_t growth_limit);
+
+ private:
+  static constexpr size_t kRunSize = kPageSize;
+  static constexpr size_t kMaxSlotsPerRun = kRunSize / kBracketQuantum;
+  static constexpr size_t kBitMapWords = kMaxSlotsPerRun / (sizeof(uint32_t) * kBitsPerByte);
+
+  // Header at the start of every run, followed by the slots.
+  struct Run {
+    uint8_t bracket_;
+    // Set while the run is some thread's current run. Slots freed during that time are recorded in
+    // thread_local_free_bit_map_ so that alloc_bit_map_ is only written by the owner.
+    uint8_t is_thread_local_;
+    uint16_t num_slots_;
+    uint32_t alloc_bit_map_[kBitMapWords];
+    uint32_t thread_local_free_bit_map_[kBitMapWords];
+
+    byte* FirstSlot() {
+      return reinterpret_cast<byte*>(this) + kHeaderSize;
+    }
+    size_t SlotIndex(const mirror::Object* obj) {
+      return (reinterpret_cast<const byte*>(obj) - FirstSlot()) / BracketSize(bracket_);
+    }
+    mirror::Object* AllocSlot();
+    void FreeSlot(size_t slot);
+    // Frees the slots recorded in thread_local_free_bit_map_.
+    void MergeThreadLocalFreeBitMap();
+    bool IsFull() const;
+    bool IsEmpty() const;
+    size_t NumAllocatedSlots() const;
+  };
+
+  static constexpr size_t kHeaderSize = (sizeof(Run) + kBracketQuantum - 1) & ~(kBracketQuantum - 1);
+
+  static size_t BracketIndex(size_t num_bytes) {
+    DCHECK_GT(num_bytes, 0U);
+    return (num_bytes - 1) / kBracketQuantum;
+  }
+  static size_t BracketSize(size_t bracket) {
+    return (bracket + 1) * kBracketQuantum;
+  }
+
+  // Returns the run containing obj, or NULL if obj is a plain mspace allocation.
+  Run* RunOf(const mirror::Object* obj) {
+    const byte* addr = reinterpret_cast<const byte*>(obj);
+    if (page_map_[(addr - Begin()) / kRunSize] == 0) {
+      return NULL;
+    }
+    return reinterpret_cast<Run*>(RoundDown(reinterpret_cast<uintptr_t>(addr), kRunSize));
+  }
+
+  mirror::Object* AllocFromRun(Thread* self, size_t num_bytes, size_t* bytes_allocated, bool grow);
+  mirror::Object* AllocFromThreadLocalRun(Thread* self, size_t bracket, bool grow);
+  // Returns a run with at least one free slot, taken from the non full runs of the bracket or
+  // freshly carved out of the mspace. Requires the bracket's lock.
+  Run* RefillRun(Thread* self, size_t bracket, bool grow);
+  // Returns the lowest of runs in a region of the calling thread's NUMA node, or the lowest of
+  // them if there is none or the heap isn't in NUMA mode.
+  std::set<Run*>::iterator FindLocalRun(std::set<Run*>& runs);
+  // Frees the given slots, which must all belong to run, and returns the run to the mspace if it
+  // becomes empty.
+  size_t FreeSlots(Thread* self, Run* run, mirror::Object** ptrs, size_t num_ptrs);
+  // Release a run which is no longer a current run, keeping it on the non full set if it has free
+  // slots and handing it back to the mspace if it is empty. Requires the bracket's lock.
+  void ReleaseRun(Thread* self, Run* run);
+
+  static void BytesAllocatedCallback(void* start, void* end, size_t used_bytes, void* arg);
+  static void ObjectsAllocatedCallback(void* start, void* end, size_t used_bytes, void* arg);
+
+  Mutex* bracket_locks_[kNumBrackets];
+
+  // Current run of each bracket which isn't allocated from thread locally.
+  Run* current_runs_[kNumBrackets];
+
+  // Runs with free slots which aren't anybody's current run.
+  std::set<Run*> non_full_runs_[kNumBrackets];
+
+  // One entry per page of the space, non-zero if the page is a run.
+  std::vector<uint8_t> page_map_;
+
+  DISALLOW_COPY_AND_ASSIGN(RunAllocSpace);
+};
+
+}  // namespace space
+}  // namespace gc
+}  // namespace art
+
+#endif  // ART_RUNTIME_GC_SPACE_RUN_ALLOC_SPACE_H_
@@ -16,6 +16,7 @@
 
 #include "dlmalloc_space.h"
 #include "large_object_space.h"
+#include "run_alloc_space.h"
 
 #include "common_test.h"
 #include "globals.h"
@@ -204,6 +205,89 @@ TEST_F(SpaceTest, AllocAndFree) {
   EXPECT_LE(1U * MB, free1);
 }
 
+TEST_F(SpaceTest, AllocThreadLocal) {
+  DlMallocSpace* space(DlMallocSpace::Create("test", 4 * MB, 16 * MB, 16 * MB, NULL));
+  ASSERT_TRUE(space != NULL);
+  Thread* self = Thread::Current();
+
+  // Make space findable to the heap, will also delete space when runtime is cleaned up
+  AddContinuousSpace(space);
+
+  // The allocation cache isn't tied to a space, drop anything cached from the heap's alloc space.
+  Runtime::Current()->GetHeap()->RevokeThreadLocalAllocCache(self);
+
+  // Succeeds, the empty bracket is refilled with a whole batch of chunks.
+  size_t ptr1_bytes_allocated;
+  mirror::Object* ptr1 = space->AllocThreadLocal(self, 16, &ptr1_bytes_allocated);
+  ASSERT_TRUE(ptr1 != NULL);
+  EXPECT_TRUE(space->Contains(ptr1));
+  EXPECT_LE(16U, ptr1_bytes_allocated);
+  EXPECT_EQ(ptr1_bytes_allocated, space->AllocationSize(ptr1));
+  EXPECT_EQ(DlMallocSpace::kThreadLocalAllocRefillCount, space->GetObjectsAllocated());
+
+  // Same bracket, served from the cache without allocating more chunks.
+  size_t ptr2_bytes_allocated;
+  mirror::Object* ptr2 = space->AllocThreadLocal(self, 12, &ptr2_bytes_allocated);
+  ASSERT_TRUE(ptr2 != NULL);
+  EXPECT_NE(ptr1, ptr2);
+  EXPECT_EQ(DlMallocSpace::kThreadLocalAllocRefillCount, space->GetObjectsAllocated());
+
+  // Handed out chunks are regular mspace chunks and can be freed individually.
+  EXPECT_EQ(ptr1_bytes_allocated, space->Free(self, ptr1));
+  EXPECT_EQ(ptr2_bytes_allocated, space->Free(self, ptr2));
+
+  // Revoking returns the remaining cached chunks.
+  space->RevokeThreadLocalAllocCache(self);
+  EXPECT_EQ(0U, space->GetObjectsAllocated());
+}
+
+TEST_F(SpaceTest, RunAllocSpace) {
+  DlMallocSpace* space(DlMallocSpace::Create("test", 4 * MB, 16 * MB, 16 * MB, NULL, true));
+  ASSERT_TRUE(space != NULL);
+  Thread* self = Thread::Current();
+
+  // Make space findable to the heap, will also delete space when runtime is cleaned up
+  AddContinuousSpace(space);
+
+  // Thread local bracket, rounded up to the bracket size.
+  size_t ptr1_bytes_allocated;
+  mirror::Object* ptr1 = space->Alloc(self, 12, &ptr1_bytes_allocated);
+  ASSERT_TRUE(ptr1 != NULL);
+  EXPECT_TRUE(space->Contains(ptr1));
+  EXPECT_EQ(RunAllocSpace::kBracketQuantum, ptr1_bytes_allocated);
+  EXPECT_EQ(ptr1_bytes_allocated, space->AllocationSize(ptr1));
+
+  // Shared bracket.
+  size_t ptr2_bytes_allocated;
+  mirror::Object* ptr2 = space->Alloc(self, RunAllocSpace::kMaxBracketSize, &ptr2_bytes_allocated);
+  ASSERT_TRUE(ptr2 != NULL);
+  EXPECT_EQ(RunAllocSpace::kMaxBracketSize, ptr2_bytes_allocated);
+
+  // Too large for any bracket, served by the mspace.
+  size_t ptr3_bytes_allocated;
+  mirror::Object* ptr3 = space->Alloc(self, 1 * KB, &ptr3_bytes_allocated);
+  ASSERT_TRUE(ptr3 != NULL);
+  EXPECT_LE(1U * KB, ptr3_bytes_allocated);
+  EXPECT_EQ(3U, space->GetObjectsAllocated());
+  EXPECT_EQ(ptr1_bytes_allocated + ptr2_bytes_allocated + ptr3_bytes_allocated,
+            space->GetBytesAllocated());
+
+  // Slots of the same run are freed in one batch along with the mspace chunk.
+  mirror::Object* ptrs[4];
+  size_t bytes_allocated = ptr1_bytes_allocated + ptr2_bytes_allocated + ptr3_bytes_allocated;
+  ptrs[0] = ptr1;
+  ptrs[1] = ptr2;
+  ptrs[2] = ptr3;
+  ptrs[3] = space->Alloc(self, 12, &ptr1_bytes_allocated);
+  ASSERT_TRUE(ptrs[3] != NULL);
+  bytes_allocated += ptr1_bytes_allocated;
+  EXPECT_EQ(bytes_allocated, space->FreeList(self, arraysize(ptrs), ptrs));
+
+  // Revoking hands the now empty thread local run back to the mspace.
+  space->RevokeThreadLocalAllocCache(self);
+  EXPECT_EQ(0U, space->GetObjectsAllocated());
+}
+
 TEST_F(SpaceTest, LargeObjectTest) {
   size_t rand_seed = 0;
   for (size_t i = 0; i < 2; ++i) {
@@ -265,6 +349,76 @@ TEST_F(SpaceTest, LargeObjectTest) {
   }
 }
 
+TEST_F(SpaceTest, LargeObjectMapSpaceReusesRuns) {
+  size_t size_class;
+  EXPECT_EQ(3 * kPageSize, LargeObjectMapSpace::RunSize(2 * kPageSize + 1, &size_class));
+  EXPECT_EQ(2U, size_class);
+  EXPECT_EQ(10 * kPageSize, LargeObjectMapSpace::RunSize(9 * kPageSize, &size_class));
+  EXPECT_EQ(8U, size_class);
+  EXPECT_EQ(20 * kPageSize, LargeObjectMapSpace::RunSize(17 * kPageSize, &size_class));
+  EXPECT_EQ(12U, size_class);
+  EXPECT_EQ(LargeObjectMapSpace::kMaxCachedRunSize,
+            LargeObjectMapSpace::RunSize(LargeObjectMapSpace::kMaxCachedRunSize, &size_class));
+  EXPECT_EQ(LargeObjectMapSpace::kNumSizeClasses - 1, size_class);
+  LargeObjectMapSpace::RunSize(LargeObjectMapSpace::kMaxCachedRunSize + 1, &size_class);
+  EXPECT_EQ(LargeObjectMapSpace::kNumSizeClasses, size_class);
+
+  Thread* self = Thread::Current();
+  LargeObjectSpace* los = LargeObjectMapSpace::Create("large object space");
+  size_t bytes_allocated = 0;
+  mirror::Object* obj = los->Alloc(self, 64 * KB, &bytes_allocated);
+  ASSERT_TRUE(obj != NULL);
+  EXPECT_EQ(64 * KB, bytes_allocated);
+  memset(obj, 0xFF, 64 * KB);
+  EXPECT_EQ(64 * KB, los->Free(self, obj));
+
+  // A run of the same size class comes back from the cache, cleared.
+  mirror::Object* reused = los->Alloc(self, 60 * KB, &bytes_allocated);
+  EXPECT_EQ(obj, reused);
+  EXPECT_EQ(64 * KB, bytes_allocated);
+  for (size_t i = 0; i < 60 * KB; ++i) {
+    ASSERT_EQ(0, reinterpret_cast<const byte*>(reused)[i]);
+  }
+  memset(reused, 0xFF, 60 * KB);
+  los->Free(self, reused);
+
+  // Trimming releases the cached run once, and leaves it for reuse.
+  EXPECT_EQ(64 * KB, los->Trim());
+  EXPECT_EQ(0U, los->Trim());
+  reused = los->Alloc(self, 64 * KB, &bytes_allocated);
+  EXPECT_EQ(obj, reused);
+  for (size_t i = 0; i < 64 * KB; ++i) {
+    ASSERT_EQ(0, reinterpret_cast<const byte*>(reused)[i]);
+  }
+  los->Free(self, reused);
+  EXPECT_EQ(0U, los->GetBytesAllocated());
+  delete los;
+}
+
+TEST_F(SpaceTest, LargeObjectMapSpaceDefersUnmapping) {
+  Thread* self = Thread::Current();
+  LargeObjectSpace* los = LargeObjectMapSpace::Create("large object space");
+  // Too big to cache, so freeing them queues their runs to be unmapped.
+  const size_t size = LargeObjectMapSpace::kMaxCachedRunSize + kPageSize;
+  mirror::Object* objects[3];
+  size_t bytes_allocated = 0;
+  for (size_t i = 0; i < arraysize(objects); ++i) {
+    objects[i] = los->Alloc(self, size, &bytes_allocated);
+    ASSERT_TRUE(objects[i] != NULL);
+  }
+  EXPECT_EQ(3 * size, los->FreeList(self, arraysize(objects), objects));
+  EXPECT_EQ(0U, los->GetBytesAllocated());
+  EXPECT_EQ(3 * size, los->UnmapFreedRuns());
+  EXPECT_EQ(0U, los->UnmapFreedRuns());
+
+  // Trimming unmaps them too.
+  mirror::Object* obj = los->Alloc(self, size, &bytes_allocated);
+  ASSERT_TRUE(obj != NULL);
+  los->Free(self, obj);
+  EXPECT_EQ(size, los->Trim());
+  delete los;
+}
+
 TEST_F(SpaceTest, AllocAndFreeList) {
   DlMallocSpace* space(DlMallocSpace::Create("test", 4 * MB, 16 * MB, 16 * MB, NULL));
   ASSERT_TRUE(space != NULL);
@@ -303,6 +457,46 @@ TEST_F(SpaceTest, AllocAndFreeList) {
   }
 }
 
+TEST_F(SpaceTest, TrimSlice) {
+  DlMallocSpace* space(DlMallocSpace::Create("test", 4 * MB, 16 * MB, 16 * MB, NULL));
+  ASSERT_TRUE(space != NULL);
+  AddContinuousSpace(space);
+  Thread* self = Thread::Current();
+
+  // Free every other object, leaving holes of at least two whole pages between live objects.
+  static const size_t kNumObjects = 256;
+  mirror::Object* objects[kNumObjects];
+  for (size_t i = 0; i < kNumObjects; ++i) {
+    size_t bytes_allocated = 0;
+    objects[i] = space->Alloc(self, 3 * kPageSize, &bytes_allocated);
+    ASSERT_TRUE(objects[i] != NULL);
+  }
+  for (size_t i = 0; i < kNumObjects; i += 2) {
+    space->Free(self, objects[i]);
+  }
+
+  size_t reclaimed = 0;
+  size_t slices = 0;
+  bool done = false;
+  while (!done) {
+    done = space->TrimSlice(&reclaimed);
+    ++slices;
+    if (slices == 1) {
+      // Allocating between slices makes the next one walk from the start of the space again.
+      size_t bytes_allocated = 0;
+      mirror::Object* object = space->Alloc(self, 16, &bytes_allocated);
+      ASSERT_TRUE(object != NULL);
+      space->Free(self, object);
+    }
+    ASSERT_LT(slices, 1000U);
+  }
+  EXPECT_GE(reclaimed, (kNumObjects / 2) * 2 * kPageSize);
+
+  for (size_t i = 1; i < kNumObjects; i += 2) {
+    space->Free(self, objects[i]);
+  }
+}
+
 void SpaceTest::SizeFootPrintGrowthLimitAndTrimBody(DlMallocSpace* space, intptr_t object_size,
                                                     int round, size_t growth_limit) {
   if (((object_size > 0 && object_size >= static_cast<intptr_t>(growth_limit))) ||
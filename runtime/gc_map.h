@@ -19,14 +19,28 @@
 
 #include <stdint.h>
 
+#include <algorithm>
+
 #include "base/logging.h"
 #include "base/macros.h"
 
 namespace art {
 
-// Lightweight wrapper for native PC offset to reference bit maps.
+// Lightweight wrapper for native PC offset to reference bit maps, read in place from the oat
+// file. The header holds the width in bytes of a reference bitmap, the number of entries and the
+// number of distinct bitmaps, as little endian 16-bit values, followed by the bit widths of a
+// native pc offset, of the difference between the offsets of consecutive entries and of a bitmap
+// index. A bit stream, least significant bit first, follows with the native pc offset of every
+// kSampleInterval-th entry and then an entry per native pc offset, in increasing order: its
+// difference from the previous entry's offset and the index of its bitmap. Calls that see the
+// same references share a bitmap. The bitmaps follow the bit stream, from the next byte.
 class NativePcOffsetToReferenceMap {
  public:
+  static constexpr size_t kHeaderSize = 9;
+  // Entries between sampled native pc offsets. A lookup decodes at most this many entries after
+  // a binary search of the samples.
+  static constexpr size_t kSampleInterval = 16;
+
   explicit NativePcOffsetToReferenceMap(const uint8_t* data) : data_(data) {
     CHECK(data_ != NULL);
   }
@@ -38,69 +52,118 @@ class NativePcOffsetToReferenceMap {
 
   // Return address of bitmap encoding what are live references.
   const uint8_t* GetBitMap(size_t index) const {
-    size_t entry_offset = index * EntryWidth();
-    return &Table()[entry_offset + NativeOffsetWidth()];
+    size_t bitmap_index = ReadBits(EntryBitOffset(index) + DeltaBits(), IndexBits());
+    return BitMaps() + bitmap_index * RegWidth();
   }
 
   // Get the native PC encoded in the table at the given index.
   uintptr_t GetNativePcOffset(size_t index) const {
-    size_t entry_offset = index * EntryWidth();
-    uintptr_t result = 0;
-    for (size_t i = 0; i < NativeOffsetWidth(); ++i) {
-      result |= Table()[entry_offset + i] << (i * 8);
+    size_t first = index - index % kSampleInterval;
+    uintptr_t result = GetSample(first / kSampleInterval);
+    for (size_t i = first + 1; i <= index; ++i) {
+      result += ReadBits(EntryBitOffset(i), DeltaBits());
     }
     return result;
   }
 
   // Does the given offset have an entry?
   bool HasEntry(uintptr_t native_pc_offset) {
-    for (size_t i = 0; i < NumEntries(); ++i) {
-      if (GetNativePcOffset(i) == native_pc_offset) {
-        return true;
-      }
-    }
-    return false;
+    return FindEntry(native_pc_offset) != NumEntries();
   }
 
   // Finds the bitmap associated with the native pc offset.
   const uint8_t* FindBitMap(uintptr_t native_pc_offset) {
-    size_t num_entries = NumEntries();
-    size_t index = Hash(native_pc_offset) % num_entries;
-    size_t misses = 0;
-    while (GetNativePcOffset(index) != native_pc_offset) {
-      index = (index + 1) % num_entries;
-      misses++;
-      DCHECK_LT(misses, num_entries) << "Failed to find offset: " << native_pc_offset;
-    }
-    return GetBitMap(index);
-  }
-
-  static uint32_t Hash(uint32_t native_offset) {
-    uint32_t hash = native_offset;
-    hash ^= (hash >> 20) ^ (hash >> 12);
-    hash ^= (hash >> 7) ^ (hash >> 4);
-    return hash;
+    size_t index = FindEntry(native_pc_offset);
+    DCHECK_NE(index, NumEntries()) << "Failed to find offset: " << native_pc_offset;
+    return index != NumEntries() ? GetBitMap(index) : NULL;
   }
 
   // The number of bytes used to encode registers.
   size_t RegWidth() const {
-    return (static_cast<size_t>(data_[0]) | (static_cast<size_t>(data_[1]) << 8)) >> 3;
+    return data_[0] | (data_[1] << 8);
+  }
+
+  // The number of distinct bitmaps.
+  size_t NumBitMaps() const {
+    return data_[4] | (data_[5] << 8);
+  }
+
+  // The size in bytes of the encoded map, bitmaps included.
+  size_t SizeInBytes() const {
+    return BitMaps() + NumBitMaps() * RegWidth() - data_;
+  }
+
+  // The number of bits needed to hold the value, 0 for 0.
+  static size_t BitsNeeded(uint32_t value) {
+    return value == 0 ? 0 : 32 - __builtin_clz(value);
   }
 
  private:
-  // Skip the size information at the beginning of data.
-  const uint8_t* Table() const {
-    return data_ + 4;
+  size_t NativeOffsetBits() const {
+    return data_[6];
+  }
+
+  size_t DeltaBits() const {
+    return data_[7];
   }
 
-  // Number of bytes used to encode a native offset.
-  size_t NativeOffsetWidth() const {
-    return data_[0] & 7;
+  size_t IndexBits() const {
+    return data_[8];
   }
 
-  // The width of an entry in the table.
-  size_t EntryWidth() const {
-    return NativeOffsetWidth() + RegWidth();
+  size_t NumSamples() const {
+    return (NumEntries() + kSampleInterval - 1) / kSampleInterval;
+  }
+
+  uintptr_t GetSample(size_t sample) const {
+    return ReadBits(sample * NativeOffsetBits(), NativeOffsetBits());
+  }
+
+  size_t EntryBitOffset(size_t index) const {
+    return NumSamples() * NativeOffsetBits() + index * (DeltaBits() + IndexBits());
+  }
+
+  const uint8_t* BitMaps() const {
+    return data_ + kHeaderSize + (EntryBitOffset(NumEntries()) + 7) / 8;
+  }
+
+  // Returns the index of the first entry for the native pc offset, or NumEntries() if none.
+  size_t FindEntry(uintptr_t native_pc_offset) const {
+    // Find the last sample at or before the offset.
+    size_t low = 0;
+    size_t high = NumSamples();
+    while (low < high) {
+      size_t mid = (low + high) / 2;
+      if (GetSample(mid) <= native_pc_offset) {
+        low = mid + 1;
+      } else {
+        high = mid;
+      }
+    }
+    if (low == 0) {
+      return NumEntries();
+    }
+    size_t index = (low - 1) * kSampleInterval;
+    size_t end = std::min(index + kSampleInterval, NumEntries());
+    uintptr_t offset = GetSample(low - 1);
+    while (offset < native_pc_offset && ++index < end) {
+      offset += ReadBits(EntryBitOffset(index), DeltaBits());
+    }
+    return (index < end && offset == native_pc_offset) ? index : NumEntries();
+  }
+
+  // Reads a value of the given number of bits from the bit stream.
+  uint32_t ReadBits(size_t bit_offset, size_t bits) const {
+    const uint8_t* stream = data_ + kHeaderSize;
+    uint32_t result = 0;
+    for (size_t done = 0; done < bits;) {
+      size_t shift = (bit_offset + done) % 8;
+      size_t count = std::min(8 - shift, bits - done);
+      uint32_t byte = stream[(bit_offset + done) / 8];
+      result |= ((byte >> shift) & ((1u << count) - 1)) << done;
+      done += count;
+    }
+    return result;
   }
 
   const uint8_t* const data_;  // The header and table data
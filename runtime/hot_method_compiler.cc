@@ -0,0 +1,371 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "hot_method_compiler.h"
+
+#include <dlfcn.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include <algorithm>
+
+#include "base/logging.h"
+#include "entrypoints/entrypoint_utils.h"
+#include "instrumentation.h"
+#include "interpreter/interpreter.h"
+#include "mem_map.h"
+#include "mirror/art_method-inl.h"
+#include "mirror/class-inl.h"
+#include "mirror/object_array-inl.h"
+#include "object_utils.h"
+#include "runtime.h"
+#include "scoped_thread_state_change.h"
+#include "stack.h"
+#include "thread.h"
+#include "thread_list.h"
+#include "utils.h"
+
+namespace art {
+
+// Finds out whether any of a set of methods has a quick frame on a thread's stack.
+class QuickFrameFinder : public StackVisitor {
+ public:
+  QuickFrameFinder(Thread* thread, const std::set<mirror::ArtMethod*>& methods)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_)
+      : StackVisitor(thread, NULL), methods_(methods), found_(false) {}
+
+  bool VisitFrame() SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
+    if (GetCurrentQuickFrame() != NULL && methods_.find(GetMethod()) != methods_.end()) {
+      found_ = true;
+      return false;
+    }
+    return true;
+  }
+
+  bool Found() const {
+    return found_;
+  }
+
+ private:
+  const std::set<mirror::ArtMethod*>& methods_;
+  bool found_;
+};
+
+struct QuickFrameSearch {
+  const std::set<mirror::ArtMethod*>* methods;
+  bool found;
+};
+
+static void FindQuickFrames(Thread* thread, void* arg)
+    SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
+  QuickFrameSearch* search = reinterpret_cast<QuickFrameSearch*>(arg);
+  if (search->found) {
+    return;
+  }
+  QuickFrameFinder finder(thread, *search->methods);
+  finder.WalkStack();
+  search->found = finder.Found();
+}
+
+// Returns true if any of the methods has a quick frame on some thread's stack. Requires all other
+// threads to be suspended.
+static bool HasQuickFrames(const std::set<mirror::ArtMethod*>& methods)
+    EXCLUSIVE_LOCKS_REQUIRED(Locks::mutator_lock_) {
+  QuickFrameSearch search;
+  search.methods = &methods;
+  search.found = false;
+  MutexLock mu(Thread::Current(), *Locks::thread_list_lock_);
+  Runtime::Current()->GetThreadList()->ForEach(FindQuickFrames, &search);
+  return search.found;
+}
+
+HotMethodCompiler* HotMethodCompiler::Create(size_t threshold, size_t code_cache_capacity) {
+  const char* library_name = kIsDebugBuild ? "libartd-compiler.so" : "libart-compiler.so";
+  void* compiler_library = dlopen(library_name, RTLD_NOW);
+  if (compiler_library == NULL) {
+    LOG(WARNING) << "Not compiling hot methods, failed to load " << library_name << ": "
+                 << dlerror();
+    return NULL;
+  }
+  CompileFn compile = reinterpret_cast<CompileFn>(dlsym(compiler_library, "ArtCompileHotMethod"));
+  if (compile == NULL) {
+    LOG(WARNING) << "Not compiling hot methods, no ArtCompileHotMethod in " << library_name;
+    dlclose(compiler_library);
+    return NULL;
+  }
+  MemMap* code_cache = MemMap::MapAnonymous("hot method code cache", NULL,
+                                            RoundUp(code_cache_capacity, kPageSize),
+                                            PROT_READ | PROT_WRITE | PROT_EXEC);
+  if (code_cache == NULL) {
+    LOG(WARNING) << "Not compiling hot methods, failed to map a code cache of "
+                 << PrettySize(code_cache_capacity);
+    dlclose(compiler_library);
+    return NULL;
+  }
+  // The library is never unloaded, its code may be on the stack until the process exits.
+  return new HotMethodCompiler(threshold, code_cache, compile);
+}
+
+HotMethodCompiler::HotMethodCompiler(size_t threshold, MemMap* code_cache, CompileFn compile)
+    : threshold_(threshold),
+      code_cache_(code_cache),
+      code_cache_top_(code_cache->Begin()),
+      compile_(compile),
+      lock_("hot method compiler lock"),
+      cond_("hot method compiler condition variable", lock_),
+      shutting_down_(false) {
+  // Create a raw pthread; its start routine will attach to the runtime.
+  CHECK_PTHREAD_CALL(pthread_create, (&pthread_, NULL, &Run, this), "hot method compiler thread");
+}
+
+HotMethodCompiler::~HotMethodCompiler() {
+  {
+    MutexLock mu(Thread::Current(), lock_);
+    shutting_down_ = true;
+    cond_.Broadcast(Thread::Current());
+  }
+  CHECK_PTHREAD_CALL(pthread_join, (pthread_, NULL), "hot method compiler shutdown");
+  // The compiled code stays mapped, the runtime may still be running it.
+  code_cache_.release();
+}
+
+void HotMethodCompiler::AddHotMethod(Thread* self, mirror::ArtMethod* method) {
+  if (method->IsNative() || method->IsAbstract() || method->IsProxyMethod() ||
+      (method->IsStatic() && method->IsConstructor())) {
+    return;
+  }
+  // Static methods of classes still being initialized get their entry point replaced when the
+  // initialization finishes, and forced interpretation, for example by the debugger, wins.
+  if (!method->GetDeclaringClass()->IsInitialized() ||
+      Runtime::Current()->GetInstrumentation()->InterpretOnly()) {
+    return;
+  }
+  MutexLock mu(self, lock_);
+  if (seen_methods_.insert(method).second) {
+    queue_.push_back(method);
+    cond_.Signal(self);
+  }
+}
+
+void* HotMethodCompiler::Run(void* arg) {
+  HotMethodCompiler* hot_method_compiler = reinterpret_cast<HotMethodCompiler*>(arg);
+  CHECK(hot_method_compiler != NULL);
+
+  Runtime* runtime = Runtime::Current();
+  if (!runtime->AttachCurrentThread("Hot method compiler", true, runtime->GetSystemThreadGroup(),
+                                    true)) {
+    // The runtime is already shutting down.
+    return NULL;
+  }
+  Thread* self = Thread::Current();
+  DCHECK_NE(self->GetState(), kRunnable);
+  hot_method_compiler->CompileLoop(self);
+  runtime->DetachCurrentThread();
+  return NULL;
+}
+
+void HotMethodCompiler::CompileLoop(Thread* self) {
+  while (true) {
+    mirror::ArtMethod* method;
+    {
+      MutexLock mu(self, lock_);
+      while (!shutting_down_ && queue_.empty()) {
+        cond_.Wait(self);
+      }
+      if (shutting_down_) {
+        return;
+      }
+      method = queue_.front();
+      queue_.pop_front();
+    }
+    if (!(*compile_)(*this, method) && VLOG_IS_ON(compiler)) {
+      ScopedObjectAccess soa(self);
+      LOG(INFO) << "Failed to compile hot method " << PrettyMethod(method);
+    }
+  }
+}
+
+bool HotMethodCompiler::InstallCode(mirror::ArtMethod* method, InstructionSet instruction_set,
+                                    size_t frame_size_in_bytes, uint32_t core_spill_mask,
+                                    uint32_t fp_spill_mask, const std::vector<uint8_t>& code,
+                                    const std::vector<uint8_t>& mapping_table,
+                                    const std::vector<uint8_t>& vmap_table,
+                                    const std::vector<uint8_t>& gc_map,
+                                    const std::vector<uint32_t>& osr_dex_pcs,
+                                    const std::vector<uint32_t>& call_sites) {
+  CHECK(!code.empty());
+  CHECK_EQ(call_sites.size() % 2, 0U);
+  // Code first, aligned as the oat writer would, then the tables the stack walker reads.
+  const size_t code_size = RoundUp(code.size(), sizeof(uint32_t));
+  const size_t size = RoundUp(code_size + mapping_table.size() + vmap_table.size() +
+                              gc_map.size(), kStackAlignment);
+
+  ThreadList* thread_list = Runtime::Current()->GetThreadList();
+  thread_list->SuspendAll();
+  // Threads in the middle of a call to the method through the interpreter bridge have a quick
+  // frame the stack walker would measure with the new frame size.
+  std::set<mirror::ArtMethod*> methods;
+  methods.insert(method);
+  byte* begin = NULL;
+  if (!HasQuickFrames(methods)) {
+    begin = AllocateCode(size);
+  }
+  if (begin == NULL) {
+    thread_list->ResumeAll();
+    return false;
+  }
+  byte* tables = begin + code_size;
+  memcpy(begin, &code[0], code.size());
+  const uint8_t* mapping_table_begin = mapping_table.empty() ? NULL : tables;
+  memcpy(tables, mapping_table.data(), mapping_table.size());
+  tables += mapping_table.size();
+  const uint8_t* vmap_table_begin = vmap_table.empty() ? NULL : tables;
+  memcpy(tables, vmap_table.data(), vmap_table.size());
+  tables += vmap_table.size();
+  const uint8_t* gc_map_begin = gc_map.empty() ? NULL : tables;
+  memcpy(tables, gc_map.data(), gc_map.size());
+  // Call sites to targets already resolved go straight to them, the others to the trampoline.
+  mirror::ObjectArray<mirror::ArtMethod>* resolved_methods = method->GetDexCacheResolvedMethods();
+  mirror::ArtMethod* resolution_method = Runtime::Current()->GetResolutionMethod();
+  for (size_t i = 0; i < call_sites.size(); i += 2) {
+    mirror::ArtMethod* target = resolved_methods->Get(call_sites[i + 1]);
+    if (target == NULL || target->IsRuntimeMethod() || !CanCallDirectly(target)) {
+      target = resolution_method;
+    }
+    *reinterpret_cast<mirror::ArtMethod**>(begin + call_sites[i]) = target;
+  }
+  __builtin___clear_cache(reinterpret_cast<char*>(begin),
+                          reinterpret_cast<char*>(begin + code.size()));
+
+  InstalledMethod installed;
+  installed.method = method;
+  installed.frame_size_in_bytes = method->GetFrameSizeInBytes();
+  installed.core_spill_mask = method->GetCoreSpillMask();
+  installed.fp_spill_mask = method->GetFpSpillMask();
+  // Thumb2 code is entered with the low bit of its address set.
+  installed.entry_point = begin + ((instruction_set == kThumb2) ? 1 : 0);
+  installed.osr_dex_pcs = osr_dex_pcs;
+  installed.call_sites = call_sites;
+  installed_methods_.push_back(installed);
+
+  method->SetFrameSizeInBytes(frame_size_in_bytes);
+  method->SetCoreSpillMask(core_spill_mask);
+  method->SetFpSpillMask(fp_spill_mask);
+  method->SetMappingTable(mapping_table_begin);
+  method->SetVmapTable(vmap_table_begin);
+  method->SetNativeGcMap(gc_map_begin);
+  Runtime::Current()->GetInstrumentation()->UpdateMethodsCode(method, installed.entry_point);
+  method->SetEntryPointFromInterpreter(artInterpreterToCompiledCodeBridge);
+  thread_list->ResumeAll();
+
+  if (VLOG_IS_ON(compiler)) {
+    ScopedObjectAccess soa(Thread::Current());
+    LOG(INFO) << "Compiled hot method " << PrettyMethod(method) << " into "
+              << PrettySize(size) << " of code cache";
+  }
+  return true;
+}
+
+bool HotMethodCompiler::HasOsrEntry(mirror::ArtMethod* method, uint32_t dex_pc) {
+  // Only asked when a loop's count reaches another multiple of the threshold, a scan will do.
+  for (const InstalledMethod& installed : installed_methods_) {
+    if (installed.method == method) {
+      // The code may have been swapped out for instrumentation since it was installed.
+      return method->GetEntryPointFromCompiledCode() == installed.entry_point &&
+          std::binary_search(installed.osr_dex_pcs.begin(), installed.osr_dex_pcs.end(), dex_pc);
+    }
+  }
+  return false;
+}
+
+bool HotMethodCompiler::CanCallDirectly(const mirror::ArtMethod* target) {
+  return !target->IsStatic() || target->GetDeclaringClass()->IsInitialized();
+}
+
+void HotMethodCompiler::PatchCallSites(mirror::ArtMethod* caller, uint32_t method_idx,
+                                       mirror::ArtMethod* target) {
+  const byte* caller_code = reinterpret_cast<const byte*>(caller->GetEntryPointFromCompiledCode());
+  if (caller_code < code_cache_->Begin() || caller_code >= code_cache_->End() ||
+      !CanCallDirectly(target)) {
+    return;
+  }
+  for (const InstalledMethod& installed : installed_methods_) {
+    if (installed.method == caller && installed.entry_point == caller_code) {
+      // The code starts at the entry point, less the Thumb2 bit.
+      byte* begin = reinterpret_cast<byte*>(reinterpret_cast<uintptr_t>(caller_code) & ~1);
+      for (size_t i = 0; i < installed.call_sites.size(); i += 2) {
+        if (installed.call_sites[i + 1] == method_idx) {
+          // A single aligned word, racing calls see either the trampoline's method or target.
+          *reinterpret_cast<mirror::ArtMethod* volatile*>(begin + installed.call_sites[i]) = target;
+        }
+      }
+      return;
+    }
+  }
+}
+
+byte* HotMethodCompiler::AllocateCode(size_t size) {
+  if (size > code_cache_->Size()) {
+    return NULL;
+  }
+  if (code_cache_top_ + size > code_cache_->End()) {
+    std::set<mirror::ArtMethod*> methods;
+    for (const InstalledMethod& installed : installed_methods_) {
+      methods.insert(installed.method);
+    }
+    if (HasQuickFrames(methods)) {
+      // Some code can't go away yet, try again when the next method gets hot.
+      return NULL;
+    }
+    FlushCodeCache();
+  }
+  byte* result = code_cache_top_;
+  code_cache_top_ += size;
+  return result;
+}
+
+static void ClearDexPcCache(Thread* thread, void*) {
+  thread->ClearDexPcCache();
+}
+
+void HotMethodCompiler::FlushCodeCache() {
+  VLOG(compiler) << "Flushing " << installed_methods_.size() << " methods from the code cache";
+  {
+    // The code's native pcs may be reused by the next methods compiled.
+    MutexLock mu(Thread::Current(), *Locks::thread_list_lock_);
+    Runtime::Current()->GetThreadList()->ForEach(ClearDexPcCache, NULL);
+  }
+  instrumentation::Instrumentation* instrumentation = Runtime::Current()->GetInstrumentation();
+  for (const InstalledMethod& installed : installed_methods_) {
+    mirror::ArtMethod* method = installed.method;
+    instrumentation->UpdateMethodsCode(method, GetCompiledCodeToInterpreterBridge());
+    method->SetEntryPointFromInterpreter(interpreter::artInterpreterToInterpreterBridge);
+    method->SetFrameSizeInBytes(installed.frame_size_in_bytes);
+    method->SetCoreSpillMask(installed.core_spill_mask);
+    method->SetFpSpillMask(installed.fp_spill_mask);
+    method->SetMappingTable(NULL);
+    method->SetVmapTable(NULL);
+    method->SetNativeGcMap(NULL);
+  }
+  installed_methods_.clear();
+  code_cache_top_ = code_cache_->Begin();
+  // Flushed methods may be compiled again once they get hot again.
+  MutexLock mu(Thread::Current(), lock_);
+  seen_methods_.clear();
+  seen_methods_.insert(queue_.begin(), queue_.end());
+}
+
+}  // namespace art
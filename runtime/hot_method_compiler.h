@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ART_RUNTIME_HOT_METHOD_COMPILER_H_
+#define ART_RUNTIME_HOT_METHOD_COMPILER_H_
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include <deque>
+#include <set>
+#include <vector>
+
+#include "base/macros.h"
+#include "base/mutex.h"
+#include "globals.h"
+#include "instruction_set.h"
+#include "UniquePtr.h"
+
+namespace art {
+
+namespace mirror {
+class ArtMethod;
+}  // namespace mirror
+class MemMap;
+class Thread;
+
+// Compiles the methods the interpreter finds hot on a background thread and installs their code,
+// so that dex files which weren't compiled ahead of time still get compiled code where it counts.
+// Enabled with -Xhot-method-threshold:<count>.
+//
+// The interpreter reports a method each time its invocation and backedge counts in the runtime's
+// MethodProfile reach another multiple of the threshold. Compilation is done by libart-compiler,
+// loaded on creation, which hands the code back through InstallCode. The code lives in a cache of
+// -Xhot-method-code-cache-size bytes; when it is full every compiled method is sent back to the
+// interpreter and the cache starts over, unless a thread is still running code from it.
+class HotMethodCompiler {
+ public:
+  // Signature of ArtCompileHotMethod, looked up in libart-compiler. Compiles the method and passes
+  // its code to InstallCode, returning false if either fails. Called in the kNative state.
+  typedef bool (*CompileFn)(HotMethodCompiler& hot_method_compiler, mirror::ArtMethod* method);
+
+  // Returns NULL if the compiler library can't be loaded or the code cache can't be mapped.
+  static HotMethodCompiler* Create(size_t threshold, size_t code_cache_capacity);
+
+  ~HotMethodCompiler();
+
+  size_t GetThreshold() const {
+    return threshold_;
+  }
+
+  // Queues a method for compilation unless it was queued before or can't be compiled.
+  void AddHotMethod(Thread* self, mirror::ArtMethod* method)
+      LOCKS_EXCLUDED(lock_)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
+  // Copies compiled code and its tables into the code cache and points the method at it. The code
+  // can be entered from the interpreter at the loop headers listed in osr_dex_pcs. call_sites
+  // pairs the code offsets of the literals holding the targets of static and direct calls with
+  // the targets' dex method indexes, see PatchCallSites. Returns false if there is no room in the
+  // cache or the method is in the middle of a call that can't switch to compiled code. Only called
+  // by the compiler thread.
+  bool InstallCode(mirror::ArtMethod* method, InstructionSet instruction_set,
+                   size_t frame_size_in_bytes, uint32_t core_spill_mask, uint32_t fp_spill_mask,
+                   const std::vector<uint8_t>& code, const std::vector<uint8_t>& mapping_table,
+                   const std::vector<uint8_t>& vmap_table, const std::vector<uint8_t>& gc_map,
+                   const std::vector<uint32_t>& osr_dex_pcs,
+                   const std::vector<uint32_t>& call_sites)
+      LOCKS_EXCLUDED(Locks::mutator_lock_, lock_);
+
+  // Called by the resolution trampoline once the static or direct method of caller's dex method
+  // index method_idx has been resolved to target. If caller runs code from the cache, its calls to
+  // the method then go straight to target rather than through the trampoline.
+  void PatchCallSites(mirror::ArtMethod* caller, uint32_t method_idx, mirror::ArtMethod* target)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
+  // Can the interpreter switch to the method's code from the cache at the loop header at dex_pc,
+  // through Thread::SetOsrEntry and the interpreter bridge?
+  bool HasOsrEntry(mirror::ArtMethod* method, uint32_t dex_pc)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
+ private:
+  // What a compiled method looked like before it got code from the cache, and where the code
+  // can be entered.
+  struct InstalledMethod {
+    mirror::ArtMethod* method;
+    size_t frame_size_in_bytes;
+    uint32_t core_spill_mask;
+    uint32_t fp_spill_mask;
+    const void* entry_point;
+    std::vector<uint32_t> osr_dex_pcs;
+    std::vector<uint32_t> call_sites;
+  };
+
+  HotMethodCompiler(size_t threshold, MemMap* code_cache, CompileFn compile);
+
+  static void* Run(void* arg);
+
+  // Compiles queued methods until shutdown.
+  void CompileLoop(Thread* self) LOCKS_EXCLUDED(lock_);
+
+  // Returns space for size bytes in the code cache, flushing the cache if it is full and nothing
+  // runs from it. Returns NULL if there is no room. Requires all other threads to be suspended.
+  byte* AllocateCode(size_t size) EXCLUSIVE_LOCKS_REQUIRED(Locks::mutator_lock_);
+
+  // Can calls go straight to target? Static methods must wait for their class's initialization.
+  static bool CanCallDirectly(const mirror::ArtMethod* target)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
+  // Sends every method with code in the cache back to the interpreter and empties the cache.
+  void FlushCodeCache() EXCLUSIVE_LOCKS_REQUIRED(Locks::mutator_lock_) LOCKS_EXCLUDED(lock_);
+
+  const size_t threshold_;
+
+  // Executable memory holding compiled code and its tables, allocated from the bottom up.
+  UniquePtr<MemMap> code_cache_;
+  byte* code_cache_top_;
+
+  const CompileFn compile_;
+
+  Mutex lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
+  ConditionVariable cond_ GUARDED_BY(lock_);
+
+  // Methods waiting to be compiled.
+  std::deque<mirror::ArtMethod*> queue_ GUARDED_BY(lock_);
+
+  // Every method queued since the code cache was last flushed, so that a hot method is compiled
+  // at most once per flush even if its compilation failed.
+  std::set<mirror::ArtMethod*> seen_methods_ GUARDED_BY(lock_);
+
+  bool shutting_down_ GUARDED_BY(lock_);
+  pthread_t pthread_;
+
+  // Methods running code from the cache. Only changed with all other threads suspended, so that
+  // holding the mutator lock is enough to read it. Methods are neither moved nor freed, so
+  // holding onto them without visiting them is fine.
+  std::vector<InstalledMethod> installed_methods_;
+
+  DISALLOW_COPY_AND_ASSIGN(HotMethodCompiler);
+};
+
+}  // namespace art
+
+#endif  // ART_RUNTIME_HOT_METHOD_COMPILER_H_
@@ -34,8 +34,11 @@
 #include <time.h>
 #include <time.h>
 #include <unistd.h>
+#include <zlib.h>
 
+#include <map>
 #include <set>
+#include <vector>
 
 #include "base/logging.h"
 #include "base/stringprintf.h"
@@ -45,10 +48,12 @@
 #include "debugger.h"
 #include "dex_file-inl.h"
 #include "gc/accounting/heap_bitmap.h"
+#include "gc/allocation_sampler.h"
 #include "gc/heap.h"
 #include "gc/space/space.h"
 #include "globals.h"
 #include "mirror/art_field-inl.h"
+#include "mirror/art_method-inl.h"
 #include "mirror/class.h"
 #include "mirror/class-inl.h"
 #include "mirror/object-inl.h"
@@ -57,6 +62,7 @@
 #include "safe_map.h"
 #include "scoped_thread_state_change.h"
 #include "thread_list.h"
+#include "UniquePtr.h"
 
 namespace art {
 
@@ -146,7 +152,12 @@ enum HprofHeapTag {
   HPROF_ROOT_VM_INTERNAL = 0x8d,
   HPROF_ROOT_JNI_MONITOR = 0x8e,
   HPROF_UNREACHABLE = 0x90,  // Obsolete.
-  HPROF_PRIMITIVE_ARRAY_NODATA_DUMP = 0xc3,  // Obsolete.
+  // Same as PRIMITIVE ARRAY DUMP without the elements, for arrays too big to dump the contents of.
+  HPROF_PRIMITIVE_ARRAY_NODATA_DUMP = 0xc3,
+  // ID: array object ID
+  // U4: stack trace serial number
+  // ID: ID of an earlier PRIMITIVE ARRAY DUMP or NODATA DUMP of the same type and contents
+  HPROF_PRIMITIVE_ARRAY_DUPLICATE_DUMP = 0xc4,
 };
 
 enum HprofHeapId {
@@ -364,12 +375,101 @@ class HprofRecord {
   DISALLOW_COPY_AND_ASSIGN(HprofRecord);
 };
 
+// Deflates what's written to a stdio stream into a file descriptor as a gzip stream, so that a
+// streamed dump is compressed as it goes rather than once it has all been written.
+class HprofDeflater {
+ public:
+  // Takes ownership of fd.
+  explicit HprofDeflater(int fd) : file_(fd), initialized_(false) {
+    memset(&stream_, 0, sizeof(stream_));
+  }
+
+  ~HprofDeflater() {
+    if (initialized_) {
+      deflateEnd(&stream_);
+    }
+  }
+
+  // Returns a stream that writes through the deflater, or NULL. Closing the stream finishes the
+  // gzip stream and closes the fd.
+  FILE* Open() {
+    // The 16 extra window bits ask for a gzip header and trailer instead of zlib's.
+    if (deflateInit2(&stream_, Z_DEFAULT_COMPRESSION, Z_DEFLATED, MAX_WBITS + 16, 8,
+                     Z_DEFAULT_STRATEGY) != Z_OK) {
+      return NULL;
+    }
+    initialized_ = true;
+#if defined(__GLIBC__)
+    cookie_io_functions_t functions = { NULL, WriteCallback, NULL, CloseCallback };
+    return fopencookie(this, "w", functions);
+#else
+    return funopen(this, NULL, WriteCallback, NULL, CloseCallback);
+#endif
+  }
+
+  // The number of bytes written to the stream so far, and the number written to the fd for them.
+  size_t BytesIn() const {
+    return stream_.total_in;
+  }
+
+  size_t BytesOut() const {
+    return stream_.total_out;
+  }
+
+ private:
+#if defined(__GLIBC__)
+  static ssize_t WriteCallback(void* cookie, const char* buf, size_t size) {
+#else
+  static int WriteCallback(void* cookie, const char* buf, int size) {
+#endif
+    HprofDeflater* deflater = reinterpret_cast<HprofDeflater*>(cookie);
+    if (!deflater->Deflate(buf, size, Z_NO_FLUSH)) {
+      return -1;
+    }
+    return size;
+  }
+
+  static int CloseCallback(void* cookie) {
+    HprofDeflater* deflater = reinterpret_cast<HprofDeflater*>(cookie);
+    bool okay = deflater->Deflate(NULL, 0, Z_FINISH);
+    return (deflater->file_.Close() == 0 && okay) ? 0 : EOF;
+  }
+
+  // Deflates size bytes of data, writing out whatever output that produces.
+  bool Deflate(const char* data, size_t size, int flush) {
+    stream_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+    stream_.avail_in = size;
+    // Output left in the buffer means deflate has consumed all the input, or finished.
+    do {
+      stream_.next_out = out_;
+      stream_.avail_out = sizeof(out_);
+      if (deflate(&stream_, flush) == Z_STREAM_ERROR) {
+        return false;
+      }
+      size_t out_size = sizeof(out_) - stream_.avail_out;
+      if (out_size != 0 && !file_.WriteFully(out_, out_size)) {
+        return false;
+      }
+    } while (stream_.avail_out == 0);
+    return true;
+  }
+
+  File file_;
+  z_stream stream_;
+  bool initialized_;
+  Bytef out_[64 * KB];
+
+  DISALLOW_COPY_AND_ASSIGN(HprofDeflater);
+};
+
 class Hprof {
  public:
-  Hprof(const char* output_filename, int fd, bool direct_to_ddms)
+  Hprof(const char* output_filename, int fd, bool direct_to_ddms, const DumpOptions& options)
       : filename_(output_filename),
         fd_(fd),
         direct_to_ddms_(direct_to_ddms),
+        streaming_(!direct_to_ddms),
+        options_(direct_to_ddms ? DumpOptions() : options),
         start_ns_(NanoTime()),
         current_record_(),
         gc_thread_serial_number_(0),
@@ -382,9 +482,16 @@ class Hprof {
         body_fp_(NULL),
         body_data_ptr_(NULL),
         body_data_size_(0),
-        next_string_id_(0x400000) {
+        next_class_serial_number_(1),
+        next_string_id_(0x400000),
+        alloc_interval_bytes_(0) {
     LOG(INFO) << "hprof: heap dump \"" << filename_ << "\" starting...";
 
+    if (streaming_) {
+      // The header and body both go straight to the output file, which is opened by Dump.
+      return;
+    }
+
     header_fp_ = open_memstream(&header_data_ptr_, &header_data_size_);
     if (header_fp_ == NULL) {
       PLOG(FATAL) << "header open_memstream failed";
@@ -397,7 +504,7 @@ class Hprof {
   }
 
   ~Hprof() {
-    if (header_fp_ != NULL) {
+    if (header_fp_ != NULL && header_fp_ != body_fp_) {
       fclose(header_fp_);
     }
     if (body_fp_ != NULL) {
@@ -410,6 +517,20 @@ class Hprof {
   void Dump()
       EXCLUSIVE_LOCKS_REQUIRED(Locks::mutator_lock_)
       LOCKS_EXCLUDED(Locks::heap_bitmap_lock_) {
+    if (streaming_ && !OpenOutputStream()) {
+      return;
+    }
+
+    // Pick up any sampled allocation sites, interning their strings and classes.
+    CollectAllocationSites();
+
+    if (streaming_) {
+      // Write the header up front. Strings and classes are written as they're first referenced,
+      // ahead of the heap dump segment that refers to them, so nothing but the current segment
+      // is buffered.
+      WriteHeader();
+    }
+
     // Walk the roots and the heap.
     current_record_.StartNewRecord(body_fp_, HPROF_TAG_HEAP_DUMP_SEGMENT, HPROF_TIME);
     Runtime::Current()->VisitRoots(RootVisitor, this, false, false);
@@ -422,68 +543,67 @@ class Hprof {
       ReaderMutexLock mu(self, *Locks::heap_bitmap_lock_);
       Runtime::Current()->GetHeap()->GetLiveBitmap()->Walk(HeapBitmapCallback, this);
     }
+    if (streaming_) {
+      WritePendingTables();
+    }
     current_record_.StartNewRecord(body_fp_, HPROF_TAG_HEAP_DUMP_END, HPROF_TIME);
     current_record_.Flush();
     fflush(body_fp_);
 
-    // Write the header.
-    WriteFixedHeader();
-    // Write the string and class tables, and any stack traces, to the header.
-    // (jhat requires that these appear before any of the data in the body that refers to them.)
-    WriteStringTable();
-    WriteClassTable();
-    WriteStackTraces();
-    current_record_.Flush();
-    fflush(header_fp_);
+    if (!streaming_) {
+      WriteHeader();
+    }
 
     bool okay = true;
-    if (direct_to_ddms_) {
-      // Send the data off to DDMS.
-      iovec iov[2];
-      iov[0].iov_base = header_data_ptr_;
-      iov[0].iov_len = header_data_size_;
-      iov[1].iov_base = body_data_ptr_;
-      iov[1].iov_len = body_data_size_;
-      Dbg::DdmSendChunkV(CHUNK_TYPE("HPDS"), iov, 2);
-    } else {
-      // Where exactly are we writing to?
-      int out_fd;
-      if (fd_ >= 0) {
-        out_fd = dup(fd_);
-        if (out_fd < 0) {
-          ThrowRuntimeException("Couldn't dump heap; dup(%d) failed: %s", fd_, strerror(errno));
-          return;
-        }
+    size_t dump_size = 0;
+    if (streaming_) {
+      okay = !ferror(body_fp_);
+      if (deflater_.get() == NULL) {
+        dump_size = static_cast<size_t>(ftell(body_fp_));
       } else {
-        out_fd = open(filename_.c_str(), O_WRONLY|O_CREAT|O_TRUNC, 0644);
-        if (out_fd < 0) {
-          ThrowRuntimeException("Couldn't dump heap; open(\"%s\") failed: %s", filename_.c_str(),
-                                strerror(errno));
-          return;
-        }
+        // Closing the stream writes out the end of the gzip stream.
+        okay = (fclose(body_fp_) == 0) && okay;
+        header_fp_ = body_fp_ = NULL;
+        dump_size = deflater_->BytesOut();
       }
-
-      UniquePtr<File> file(new File(out_fd, filename_));
-      okay = file->WriteFully(header_data_ptr_, header_data_size_) &&
-          file->WriteFully(body_data_ptr_, body_data_size_);
       if (!okay) {
         std::string msg(StringPrintf("Couldn't dump heap; writing \"%s\" failed: %s",
                                      filename_.c_str(), strerror(errno)));
         ThrowRuntimeException("%s", msg.c_str());
         LOG(ERROR) << msg;
       }
+    } else if (direct_to_ddms_) {
+      // Send the data off to DDMS.
+      iovec iov[2];
+      iov[0].iov_base = header_data_ptr_;
+      iov[0].iov_len = header_data_size_;
+      iov[1].iov_base = body_data_ptr_;
+      iov[1].iov_len = body_data_size_;
+      Dbg::DdmSendChunkV(CHUNK_TYPE("HPDS"), iov, 2);
+      dump_size = header_data_size_ + body_data_size_;
     }
 
     // Throw out a log message for the benefit of "runhat".
     if (okay) {
       uint64_t duration = NanoTime() - start_ns_;
-      LOG(INFO) << "hprof: heap dump completed ("
-          << PrettySize(header_data_size_ + body_data_size_ + 1023)
-          << ") in " << PrettyDuration(duration);
+      std::string compressed_from;
+      if (deflater_.get() != NULL) {
+        compressed_from = ", compressed from " + PrettySize(deflater_->BytesIn() + 1023);
+      }
+      LOG(INFO) << "hprof: heap dump completed (" << PrettySize(dump_size + 1023)
+          << compressed_from << ") in " << PrettyDuration(duration);
     }
   }
 
  private:
+  // Size of the stdio buffer used when streaming, which bounds how much of the dump is held
+  // in memory at once besides the current heap dump segment.
+  static const size_t kStreamBufferSize = 64 * KB;
+
+  // Primitive arrays smaller than this aren't worth looking up for duplicates: a DUPLICATE DUMP
+  // record would save little, and remembering them all would cost more.
+  static const size_t kMinDedupArrayBytes = 256;
+
   static void RootVisitor(const mirror::Object* obj, void* arg)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
     CHECK(arg != NULL);
@@ -503,18 +623,105 @@ class Hprof {
 
   int DumpHeapObject(mirror::Object* obj) SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
 
+  // Returns an array already dumped with the same class and contents as array, or NULL after
+  // remembering array for the ones that follow. The threads are suspended for the whole dump, so
+  // the arrays stay where they are.
+  const mirror::Array* FindDumpedArray(const mirror::Array* array, size_t component_size)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
+    size_t byte_length = array->GetLength() * component_size;
+    const void* data = array->GetRawData(component_size);
+    uint32_t hash = crc32(0L, reinterpret_cast<const Bytef*>(data), byte_length);
+    typedef std::multimap<uint32_t, const mirror::Array*>::const_iterator It;
+    std::pair<It, It> range = dumped_arrays_.equal_range(hash);
+    for (It it = range.first; it != range.second; ++it) {
+      const mirror::Array* other = it->second;
+      if (other->GetClass() == array->GetClass() && other->GetLength() == array->GetLength() &&
+          memcmp(other->GetRawData(component_size), data, byte_length) == 0) {
+        return other;
+      }
+    }
+    dumped_arrays_.insert(std::make_pair(hash, array));
+    return NULL;
+  }
+
   void Finish() {
   }
 
+  // Opens the file or fd being dumped to as both the header and body stream.
+  bool OpenOutputStream() {
+    // Where exactly are we writing to?
+    int out_fd;
+    if (fd_ >= 0) {
+      out_fd = dup(fd_);
+      if (out_fd < 0) {
+        ThrowRuntimeException("Couldn't dump heap; dup(%d) failed: %s", fd_, strerror(errno));
+        return false;
+      }
+    } else {
+      out_fd = open(filename_.c_str(), O_WRONLY|O_CREAT|O_TRUNC, 0644);
+      if (out_fd < 0) {
+        ThrowRuntimeException("Couldn't dump heap; open(\"%s\") failed: %s", filename_.c_str(),
+                              strerror(errno));
+        return false;
+      }
+    }
+
+    if (options_.compress) {
+      deflater_.reset(new HprofDeflater(out_fd));
+      body_fp_ = deflater_->Open();
+      if (body_fp_ == NULL) {
+        ThrowRuntimeException("Couldn't dump heap; opening a deflate stream on fd %d failed",
+                              out_fd);
+        return false;
+      }
+    } else {
+      body_fp_ = fdopen(out_fd, "w");
+      if (body_fp_ == NULL) {
+        ThrowRuntimeException("Couldn't dump heap; fdopen(%d) failed: %s", out_fd,
+                              strerror(errno));
+        close(out_fd);
+        return false;
+      }
+    }
+    setvbuf(body_fp_, NULL, _IOFBF, kStreamBufferSize);
+    header_fp_ = body_fp_;
+    return true;
+  }
+
+  // Writes the file header, the string and class tables, and any stack traces.
+  // (jhat requires that these appear before any of the data in the body that refers to them.)
+  void WriteHeader() SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
+    WriteFixedHeader();
+    WritePendingTables();
+    WriteStackTraces();
+    WriteAllocSites();
+    current_record_.Flush();
+    fflush(header_fp_);
+  }
+
+  // Writes the STRING and LOAD CLASS records for strings and classes that have been given IDs
+  // since the last call. Strings go first, as class records refer to their names.
+  int WritePendingTables() SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
+    int err = WriteStringTable();
+    if (err == 0) {
+      err = WriteClassTable();
+    }
+    if (err == 0) {
+      err = table_record_.Flush();
+    }
+    pending_strings_.clear();
+    pending_classes_.clear();
+    return err;
+  }
+
   int WriteClassTable() SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
-    HprofRecord* rec = &current_record_;
-    uint32_t nextSerialNumber = 1;
+    HprofRecord* rec = &table_record_;
 
-    for (ClassSetIterator it = classes_.begin(); it != classes_.end(); ++it) {
-      const mirror::Class* c = *it;
+    for (size_t i = 0; i < pending_classes_.size(); ++i) {
+      const mirror::Class* c = pending_classes_[i];
       CHECK(c != NULL);
 
-      int err = current_record_.StartNewRecord(header_fp_, HPROF_TAG_LOAD_CLASS, HPROF_TIME);
+      int err = rec->StartNewRecord(header_fp_, HPROF_TAG_LOAD_CLASS, HPROF_TIME);
       if (err != 0) {
         return err;
       }
@@ -524,7 +731,8 @@ class Hprof {
       // ID: class object ID. We use the address of the class object structure as its ID.
       // U4: stack trace serial number
       // ID: class name string ID
-      rec->AddU4(nextSerialNumber++);
+      class_serial_numbers_.Put(c, next_class_serial_number_);
+      rec->AddU4(next_class_serial_number_++);
       rec->AddId((HprofClassObjectId) c);
       rec->AddU4(HPROF_NULL_STACK_TRACE);
       rec->AddId(LookupClassNameId(c));
@@ -534,13 +742,13 @@ class Hprof {
   }
 
   int WriteStringTable() {
-    HprofRecord* rec = &current_record_;
+    HprofRecord* rec = &table_record_;
 
-    for (StringMapIterator it = strings_.begin(); it != strings_.end(); ++it) {
-      const std::string& string = (*it).first;
-      size_t id = (*it).second;
+    for (size_t i = 0; i < pending_strings_.size(); ++i) {
+      const std::string& string = pending_strings_[i]->first;
+      size_t id = pending_strings_[i]->second;
 
-      int err = current_record_.StartNewRecord(header_fp_, HPROF_TAG_STRING, HPROF_TIME);
+      int err = rec->StartNewRecord(header_fp_, HPROF_TAG_STRING, HPROF_TIME);
       if (err != 0) {
         return err;
       }
@@ -562,7 +770,11 @@ class Hprof {
     return 0;
   }
 
-  void StartNewHeapDumpSegment() {
+  void StartNewHeapDumpSegment() SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
+    if (streaming_) {
+      // Strings and classes first referenced by the old segment must precede it in the file.
+      WritePendingTables();
+    }
     // This flushes the old segment and starts a new one.
     current_record_.StartNewRecord(body_fp_, HPROF_TAG_HEAP_DUMP_SEGMENT, HPROF_TIME);
     objects_in_segment_ = 0;
@@ -582,6 +794,9 @@ class Hprof {
 
     std::pair<ClassSetIterator, bool> result = classes_.insert(c);
     const mirror::Class* present = *result.first;
+    if (result.second) {
+      pending_classes_.push_back(c);
+    }
 
     // Make sure that we've assigned a string ID for this class' name
     LookupClassNameId(c);
@@ -605,6 +820,7 @@ class Hprof {
     }
     HprofStringId id = next_string_id_++;
     strings_.Put(string, id);
+    pending_strings_.push_back(strings_.find(string));
     return id;
   }
 
@@ -643,12 +859,116 @@ class Hprof {
     fwrite(buf, 1, sizeof(uint32_t), header_fp_);  // xxx fix the time
   }
 
-  void WriteStackTraces() {
+  void WriteStackTraces() SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
     // Write a dummy stack trace record so the analysis tools don't freak out.
     current_record_.StartNewRecord(header_fp_, HPROF_TAG_STACK_TRACE, HPROF_TIME);
     current_record_.AddU4(HPROF_NULL_STACK_TRACE);
     current_record_.AddU4(HPROF_NULL_THREAD);
     current_record_.AddU4(0);    // no frames
+
+    // Write a trace for each sampled allocation site, with serial numbers starting at 1.
+    HprofId next_frame_id = 1;
+    for (size_t i = 0; i < alloc_sites_.size(); ++i) {
+      const gc::AllocationSampler::SiteStats& stats = alloc_sites_[i].second;
+      std::vector<HprofId> frame_ids;
+      for (size_t j = 0; j < stats.depth; ++j) {
+        const mirror::ArtMethod* m = stats.methods[j];
+        MethodHelper mh(m);
+        // STACK FRAME format:
+        // ID: stack frame ID
+        // ID: method name string ID
+        // ID: method signature string ID
+        // ID: source file name string ID
+        // U4: class serial number
+        // U4: line number (> 0), or -1 if unknown
+        current_record_.StartNewRecord(header_fp_, HPROF_TAG_STACK_FRAME, HPROF_TIME);
+        current_record_.AddId(next_frame_id);
+        current_record_.AddId(LookupStringId(mh.GetName()));
+        current_record_.AddId(LookupStringId(mh.GetSignature()));
+        const char* source_file = mh.GetDeclaringClassSourceFile();
+        current_record_.AddId(LookupStringId(source_file != NULL ? source_file : ""));
+        current_record_.AddU4(class_serial_numbers_.Get(m->GetDeclaringClass()));
+        int32_t line_number = mh.GetLineNumFromDexPC(stats.dex_pcs[j]);
+        current_record_.AddU4(line_number > 0 ? line_number : static_cast<uint32_t>(-1));
+        frame_ids.push_back(next_frame_id++);
+      }
+      current_record_.StartNewRecord(header_fp_, HPROF_TAG_STACK_TRACE, HPROF_TIME);
+      current_record_.AddU4(i + 1);
+      current_record_.AddU4(HPROF_NULL_THREAD);
+      current_record_.AddU4(frame_ids.size());
+      if (!frame_ids.empty()) {
+        current_record_.AddIdList(&frame_ids[0], frame_ids.size());
+      }
+    }
+  }
+
+  void CollectAllocationSites() SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
+    gc::AllocationSampler* sampler = Runtime::Current()->GetHeap()->GetAllocationSampler();
+    gc::AllocationSampler::SiteMap sites;
+    sampler->GetSites(&sites);
+    alloc_interval_bytes_ = sampler->GetIntervalBytes();
+    alloc_sites_.assign(sites.begin(), sites.end());
+    for (size_t i = 0; i < alloc_sites_.size(); ++i) {
+      LookupClassId(const_cast<mirror::Class*>(alloc_sites_[i].first.klass));
+      const gc::AllocationSampler::SiteStats& stats = alloc_sites_[i].second;
+      for (size_t j = 0; j < stats.depth; ++j) {
+        const mirror::ArtMethod* m = stats.methods[j];
+        MethodHelper mh(m);
+        LookupClassId(m->GetDeclaringClass());
+        LookupStringId(mh.GetName());
+        LookupStringId(mh.GetSignature());
+        const char* source_file = mh.GetDeclaringClassSourceFile();
+        LookupStringId(source_file != NULL ? source_file : "");
+      }
+    }
+  }
+
+  void WriteAllocSites() SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
+    if (alloc_sites_.empty()) {
+      return;
+    }
+    uint64_t total_bytes = 0;
+    uint64_t total_instances = 0;
+    for (size_t i = 0; i < alloc_sites_.size(); ++i) {
+      total_bytes += alloc_interval_bytes_ * alloc_sites_[i].second.samples;
+      total_instances += alloc_sites_[i].second.samples;
+    }
+    // ALLOC SITES format:
+    // U2: flags (0x0 = incremental, 0x2 = sorted by live bytes, 0x4 = force GC)
+    // U4: cutoff ratio
+    // U4: total live bytes
+    // U4: total live instances
+    // U8: total bytes allocated
+    // U8: total instances allocated
+    // U4: number of sites
+    // Per site:
+    //   U1: array indicator (0 = normal object)
+    //   U4: class serial number
+    //   U4: stack trace serial number
+    //   U4: number of live bytes
+    //   U4: number of live instances
+    //   U4: number of bytes allocated
+    //   U4: number of instances allocated
+    // Sampling only estimates what was allocated; live counts are left at zero.
+    current_record_.StartNewRecord(header_fp_, HPROF_TAG_ALLOC_SITES, HPROF_TIME);
+    current_record_.AddU2(0);
+    current_record_.AddU4(0);
+    current_record_.AddU4(0);
+    current_record_.AddU4(0);
+    current_record_.AddU8(total_bytes);
+    current_record_.AddU8(total_instances);
+    current_record_.AddU4(alloc_sites_.size());
+    for (size_t i = 0; i < alloc_sites_.size(); ++i) {
+      const gc::AllocationSampler::Site& site = alloc_sites_[i].first;
+      const gc::AllocationSampler::SiteStats& stats = alloc_sites_[i].second;
+      current_record_.AddU1(0);
+      current_record_.AddU4(class_serial_numbers_.Get(site.klass));
+      current_record_.AddU4(i + 1);
+      current_record_.AddU4(0);
+      current_record_.AddU4(0);
+      current_record_.AddU4(alloc_interval_bytes_ * stats.samples);
+      current_record_.AddU4(stats.samples);
+    }
   }
 
   // If direct_to_ddms_ is set, "filename_" and "fd" will be ignored.
@@ -657,6 +977,10 @@ class Hprof {
   std::string filename_;
   int fd_;
   bool direct_to_ddms_;
+  // Whether the dump is written to the file or fd as it's generated, rather than buffered in
+  // memory and written at the end. DDMS wants the whole dump in a single chunk.
+  bool streaming_;
+  const DumpOptions options_;
 
   uint64_t start_ns_;
 
@@ -675,10 +999,30 @@ class Hprof {
   char* body_data_ptr_;
   size_t body_data_size_;
 
+  // Compresses body_fp_ when options_.compress is set.
+  UniquePtr<HprofDeflater> deflater_;
+
   ClassSet classes_;
+  SafeMap<const mirror::Class*, uint32_t> class_serial_numbers_;
+  uint32_t next_class_serial_number_;
   size_t next_string_id_;
   StringMap strings_;
 
+  // Strings and classes that have IDs but haven't had their records written yet, and the record
+  // those are written with, so that they can be emitted while a heap dump segment is open.
+  std::vector<StringMapIterator> pending_strings_;
+  std::vector<const mirror::Class*> pending_classes_;
+  HprofRecord table_record_;
+
+  // Sampled allocation sites, written as stack traces and an ALLOC SITES record.
+  std::vector<std::pair<gc::AllocationSampler::Site, gc::AllocationSampler::SiteStats> >
+      alloc_sites_;
+  size_t alloc_interval_bytes_;
+
+  // The primitive arrays dumped with their contents, by the CRC32 of their contents, when
+  // options_.dedup_primitive_arrays is set.
+  std::multimap<uint32_t, const mirror::Array*> dumped_arrays_;
+
   DISALLOW_COPY_AND_ASSIGN(Hprof);
 };
 
@@ -813,6 +1157,7 @@ int Hprof::MarkRootObject(const mirror::Object* obj, jobject jniObj) {
   case HPROF_PRIMITIVE_ARRAY_DUMP:
   case HPROF_HEAP_DUMP_INFO:
   case HPROF_PRIMITIVE_ARRAY_NODATA_DUMP:
+  case HPROF_PRIMITIVE_ARRAY_DUPLICATE_DUMP:
     // Ignored.
     break;
 
@@ -966,28 +1311,52 @@ int Hprof::DumpHeapObject(mirror::Object* obj) {
         rec->AddId(LookupClassId(c));
 
         // Dump the elements, which are always objects or NULL.
-        rec->AddIdList((const HprofObjectId*)aobj->GetRawData(sizeof(mirror::Object*)), length);
+        rec->AddIdList((const HprofObjectId*)aobj->GetRawData(mirror::kHeapReferenceSize),
+                       length);
       } else {
         size_t size;
         HprofBasicType t = PrimitiveToBasicTypeAndSize(c->GetComponentType()->GetPrimitiveType(), &size);
 
-        // obj is a primitive array.
-        rec->AddU1(HPROF_PRIMITIVE_ARRAY_DUMP);
+        const mirror::Array* original = NULL;
+        if (options_.dedup_primitive_arrays && length * size >= kMinDedupArrayBytes) {
+          original = FindDumpedArray(aobj, size);
+        }
 
-        rec->AddId((HprofObjectId)obj);
-        rec->AddU4(StackTraceSerialNumber(obj));
-        rec->AddU4(length);
-        rec->AddU1(t);
+        if (original != NULL) {
+          // obj is a primitive array with the same contents as one already dumped.
+          rec->AddU1(HPROF_PRIMITIVE_ARRAY_DUPLICATE_DUMP);
+
+          rec->AddId((HprofObjectId)obj);
+          rec->AddU4(StackTraceSerialNumber(obj));
+          rec->AddId((HprofObjectId)original);
+        } else if (options_.max_primitive_array_bytes != 0 &&
+                   length * size > options_.max_primitive_array_bytes) {
+          // obj is a primitive array too big to dump the contents of.
+          rec->AddU1(HPROF_PRIMITIVE_ARRAY_NODATA_DUMP);
+
+          rec->AddId((HprofObjectId)obj);
+          rec->AddU4(StackTraceSerialNumber(obj));
+          rec->AddU4(length);
+          rec->AddU1(t);
+        } else {
+          // obj is a primitive array.
+          rec->AddU1(HPROF_PRIMITIVE_ARRAY_DUMP);
 
-        // Dump the raw, packed element values.
-        if (size == 1) {
-          rec->AddU1List((const uint8_t*)aobj->GetRawData(sizeof(uint8_t)), length);
-        } else if (size == 2) {
-          rec->AddU2List((const uint16_t*)aobj->GetRawData(sizeof(uint16_t)), length);
-        } else if (size == 4) {
-          rec->AddU4List((const uint32_t*)aobj->GetRawData(sizeof(uint32_t)), length);
-        } else if (size == 8) {
-          rec->AddU8List((const uint64_t*)aobj->GetRawData(sizeof(uint64_t)), length);
+          rec->AddId((HprofObjectId)obj);
+          rec->AddU4(StackTraceSerialNumber(obj));
+          rec->AddU4(length);
+          rec->AddU1(t);
+
+          // Dump the raw, packed element values.
+          if (size == 1) {
+            rec->AddU1List((const uint8_t*)aobj->GetRawData(sizeof(uint8_t)), length);
+          } else if (size == 2) {
+            rec->AddU2List((const uint16_t*)aobj->GetRawData(sizeof(uint16_t)), length);
+          } else if (size == 4) {
+            rec->AddU4List((const uint32_t*)aobj->GetRawData(sizeof(uint32_t)), length);
+          } else if (size == 8) {
+            rec->AddU8List((const uint64_t*)aobj->GetRawData(sizeof(uint64_t)), length);
+          }
         }
       }
     } else {
@@ -1075,11 +1444,11 @@ void Hprof::VisitRoot(const mirror::Object* obj) {
 // sent directly to DDMS.
 // If "fd" is >= 0, the output will be written to that file descriptor.
 // Otherwise, "filename" is used to create an output file.
-void DumpHeap(const char* filename, int fd, bool direct_to_ddms) {
+void DumpHeap(const char* filename, int fd, bool direct_to_ddms, const DumpOptions& options) {
   CHECK(filename != NULL);
 
   Runtime::Current()->GetThreadList()->SuspendAll();
-  Hprof hprof(filename, fd, direct_to_ddms);
+  Hprof hprof(filename, fd, direct_to_ddms, options);
   hprof.Dump();
   Runtime::Current()->GetThreadList()->ResumeAll();
 }
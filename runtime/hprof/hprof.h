@@ -17,11 +17,29 @@
 #ifndef ART_RUNTIME_HPROF_HPROF_H_
 #define ART_RUNTIME_HPROF_HPROF_H_
 
+#include <stddef.h>
+
 namespace art {
 
 namespace hprof {
 
-void DumpHeap(const char* filename, int fd, bool direct_to_ddms);
+// How a heap dump written to a file or fd is encoded. The defaults give a plain hprof file;
+// the other encodings are for tools that run the dump through a converter first.
+struct DumpOptions {
+  DumpOptions() : compress(false), dedup_primitive_arrays(false), max_primitive_array_bytes(0) {}
+
+  // Whether the dump is written as a gzip stream, which gunzip turns back into an hprof file.
+  bool compress;
+  // Whether a primitive array with the same type and contents as one already dumped is written
+  // as a PRIMITIVE ARRAY DUPLICATE DUMP (0xc4) referring to that one, instead of repeating them.
+  bool dedup_primitive_arrays;
+  // Primitive arrays bigger than this many bytes are written as a PRIMITIVE ARRAY NODATA DUMP
+  // (0xc3), without their contents. 0 means no limit.
+  size_t max_primitive_array_bytes;
+};
+
+// DDMS always gets a plain dump; the options only apply to a dump written to a file or fd.
+void DumpHeap(const char* filename, int fd, bool direct_to_ddms, const DumpOptions& options);
 
 }  // namespace hprof
 
@@ -24,7 +24,7 @@
 namespace art {
 
 const byte ImageHeader::kImageMagic[] = { 'a', 'r', 't', '\n' };
-const byte ImageHeader::kImageVersion[] = { '0', '0', '5', '\0' };
+const byte ImageHeader::kImageVersion[] = { '0', '0', '9', '\0' };
 
 ImageHeader::ImageHeader(uint32_t image_begin,
                          uint32_t image_size,
@@ -45,15 +45,25 @@ ImageHeader::ImageHeader(uint32_t image_begin,
     oat_data_begin_(oat_data_begin),
     oat_data_end_(oat_data_end),
     oat_file_end_(oat_file_end),
-    image_roots_(image_roots) {
+    image_roots_(image_roots),
+    relocations_offset_(0),
+    image_relocations_size_(0),
+    oat_relocation_count_(0),
+    boot_image_begin_(0),
+    boot_oat_checksum_(0),
+    read_only_dex_cache_arrays_begin_(0),
+    read_only_dex_cache_arrays_end_(0) {
   CHECK_EQ(image_begin, RoundUp(image_begin, kPageSize));
-  CHECK_EQ(oat_file_begin, RoundUp(oat_file_begin, kPageSize));
-  CHECK_EQ(oat_data_begin, RoundUp(oat_data_begin, kPageSize));
   CHECK_LT(image_begin, image_roots);
-  CHECK_LT(image_roots, oat_file_begin);
-  CHECK_LE(oat_file_begin, oat_data_begin);
-  CHECK_LT(oat_data_begin, oat_data_end);
-  CHECK_LE(oat_data_end, oat_file_end);
+  // App images have no oat addresses.
+  if (oat_data_begin != 0) {
+    CHECK_EQ(oat_file_begin, RoundUp(oat_file_begin, kPageSize));
+    CHECK_EQ(oat_data_begin, RoundUp(oat_data_begin, kPageSize));
+    CHECK_LT(image_roots, oat_file_begin);
+    CHECK_LE(oat_file_begin, oat_data_begin);
+    CHECK_LT(oat_data_begin, oat_data_end);
+    CHECK_LE(oat_data_end, oat_file_end);
+  }
   memcpy(magic_, kImageMagic, sizeof(kImageMagic));
   memcpy(version_, kImageVersion, sizeof(kImageVersion));
 }
@@ -68,6 +78,18 @@ bool ImageHeader::IsValid() const {
   return true;
 }
 
+void ImageHeader::Relocate(ptrdiff_t delta) {
+  CHECK_ALIGNED(delta, kPageSize);
+  image_begin_ += delta;
+  image_roots_ += delta;
+  if (!IsAppImage()) {
+    oat_file_begin_ += delta;
+    oat_data_begin_ += delta;
+    oat_data_end_ += delta;
+    oat_file_end_ += delta;
+  }
+}
+
 const char* ImageHeader::GetMagic() const {
   CHECK(IsValid());
   return reinterpret_cast<const char*>(magic_);
@@ -88,6 +88,76 @@ class PACKED(4) ImageHeader {
     return RoundUp(image_size_, kPageSize);
   }
 
+  bool HasRelocations() const {
+    return relocations_offset_ != 0;
+  }
+
+  // Offset in the file of the relocation section, which follows the image bitmap. It holds a
+  // bitmap with a bit set for each 32-bit word of the image which holds an address into the image
+  // or oat file, then a sorted array of the offsets from oat_data_begin_ of the words of oat code
+  // which do.
+  size_t GetRelocationsOffset() const {
+    return relocations_offset_;
+  }
+
+  size_t GetImageRelocationsSize() const {
+    return image_relocations_size_;
+  }
+
+  size_t GetOatRelocationCount() const {
+    return oat_relocation_count_;
+  }
+
+  size_t GetRelocationsSize() const {
+    return image_relocations_size_ + oat_relocation_count_ * sizeof(uint32_t);
+  }
+
+  void SetRelocations(uint32_t relocations_offset, uint32_t image_relocations_size,
+                      uint32_t oat_relocation_count) {
+    relocations_offset_ = relocations_offset;
+    image_relocations_size_ = image_relocations_size;
+    oat_relocation_count_ = oat_relocation_count;
+  }
+
+  // Adjusts the addresses in the header for an image mapped delta bytes away from image_begin_.
+  void Relocate(ptrdiff_t delta);
+
+  // Page aligned offsets in the image of the range holding the boot dex caches' strings and
+  // resolved types, methods and fields, which is mapped read-only. Both 0 if there is none.
+  size_t GetReadOnlyDexCacheArraysBegin() const {
+    return read_only_dex_cache_arrays_begin_;
+  }
+
+  size_t GetReadOnlyDexCacheArraysEnd() const {
+    return read_only_dex_cache_arrays_end_;
+  }
+
+  void SetReadOnlyDexCacheArrays(uint32_t begin, uint32_t end) {
+    read_only_dex_cache_arrays_begin_ = begin;
+    read_only_dex_cache_arrays_end_ = end;
+  }
+
+  // App images hold classes of application dex files, on top of the boot image. They have no oat
+  // addresses, the code of their methods is linked when the classes are loaded.
+  bool IsAppImage() const {
+    return boot_image_begin_ != 0;
+  }
+
+  byte* GetBootImageBegin() const {
+    return reinterpret_cast<byte*>(boot_image_begin_);
+  }
+
+  uint32_t GetBootOatChecksum() const {
+    return boot_oat_checksum_;
+  }
+
+  void SetBootImage(uint32_t boot_image_begin, uint32_t boot_oat_checksum) {
+    boot_image_begin_ = boot_image_begin;
+    boot_oat_checksum_ = boot_oat_checksum;
+  }
+
+  // App images only use kDexCaches, and kClassRoots for an Object[] holding a Class[] per dex
+  // cache, indexed by class def.
   enum ImageRoot {
     kResolutionMethod,
     kCalleeSaveMethod,
@@ -96,6 +166,10 @@ class PACKED(4) ImageHeader {
     kOatLocation,
     kDexCaches,
     kClassRoots,
+    // A String[] open addressing hash table of the dex caches' strings, see InternTable. Its
+    // length is a power of two, at least twice the number of strings. A string goes in the first
+    // null slot probing linearly from its hash code masked by the length minus one.
+    kInternedStrings,
     kImageRootsMax,
   };
 
@@ -142,6 +216,24 @@ class PACKED(4) ImageHeader {
   // Absolute address of an Object[] of objects needed to reinitialize from an image.
   uint32_t image_roots_;
 
+  // Page aligned offset of the relocation section in the file, 0 if there is none.
+  uint32_t relocations_offset_;
+
+  // Size of the image relocation bitmap at the start of the relocation section.
+  uint32_t image_relocations_size_;
+
+  // Number of oat code relocations following the image relocation bitmap.
+  uint32_t oat_relocation_count_;
+
+  // For app images, the address and oat checksum of the boot image they were compiled against,
+  // which they refer to with absolute addresses. 0 for boot images.
+  uint32_t boot_image_begin_;
+  uint32_t boot_oat_checksum_;
+
+  // Offsets of the range of dex cache arrays mapped read-only, 0 if there is none.
+  uint32_t read_only_dex_cache_arrays_begin_;
+  uint32_t read_only_dex_cache_arrays_end_;
+
   friend class ImageWriter;
   friend class ImageDumper;  // For GetImageRoots()
 };
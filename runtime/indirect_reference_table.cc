@@ -22,6 +22,7 @@
 #include "thread.h"
 #include "utils.h"
 
+#include <algorithm>
 #include <cstdlib>
 
 namespace art {
@@ -40,31 +41,46 @@ IndirectReferenceTable::IndirectReferenceTable(size_t initialCount,
   CHECK_LE(initialCount, maxCount);
   CHECK_NE(desiredKind, kSirtOrInvalid);
 
-  table_ = reinterpret_cast<const mirror::Object**>(malloc(initialCount * sizeof(const mirror::Object*)));
-  CHECK(table_ != NULL);
-  memset(table_, 0xd1, initialCount * sizeof(const mirror::Object*));
-
-  slot_data_ = reinterpret_cast<IndirectRefSlot*>(calloc(initialCount, sizeof(IndirectRefSlot)));
-  CHECK(slot_data_ != NULL);
+  // Only the chunk pointers are allocated up front, the chunks themselves as the table grows.
+  size_t maxChunks = RoundUp(maxCount, kIrtChunkEntries) / kIrtChunkEntries;
+  chunks_ = reinterpret_cast<IrtEntry**>(calloc(maxChunks, sizeof(IrtEntry*)));
+  CHECK(chunks_ != NULL);
 
   segment_state_.all = IRT_FIRST_SEGMENT;
-  alloc_entries_ = initialCount;
+  alloc_entries_ = 0;
   max_entries_ = maxCount;
   kind_ = desiredKind;
+  while (alloc_entries_ < initialCount) {
+    CHECK(Grow());
+  }
 }
 
 IndirectReferenceTable::~IndirectReferenceTable() {
-  free(table_);
-  free(slot_data_);
-  table_ = NULL;
-  slot_data_ = NULL;
+  size_t numChunks = RoundUp(alloc_entries_, kIrtChunkEntries) / kIrtChunkEntries;
+  for (size_t i = 0; i < numChunks; ++i) {
+    free(chunks_[i]);
+  }
+  free(chunks_);
+  chunks_ = NULL;
   alloc_entries_ = max_entries_ = -1;
 }
 
+// Add a chunk of empty entries. Existing entries stay where they are.
+bool IndirectReferenceTable::Grow() {
+  DCHECK_LT(alloc_entries_, max_entries_);
+  DCHECK_EQ(alloc_entries_ % kIrtChunkEntries, 0U);
+  IrtEntry* chunk = reinterpret_cast<IrtEntry*>(calloc(kIrtChunkEntries, sizeof(IrtEntry)));
+  if (chunk == NULL) {
+    return false;
+  }
+  chunks_[alloc_entries_ / kIrtChunkEntries] = chunk;
+  alloc_entries_ = std::min(alloc_entries_ + kIrtChunkEntries, max_entries_);
+  return true;
+}
+
 // Make sure that the entry at "idx" is correctly paired with "iref".
 bool IndirectReferenceTable::CheckEntry(const char* what, IndirectRef iref, int idx) const {
-  const mirror::Object* obj = table_[idx];
-  IndirectRef checkRef = ToIndirectRef(obj, idx);
+  IndirectRef checkRef = ToIndirectRef(idx);
   if (UNLIKELY(checkRef != iref)) {
     LOG(ERROR) << "JNI ERROR (app bug): attempt to " << what
                << " stale " << kind_ << " " << iref
@@ -83,7 +99,7 @@ IndirectRef IndirectReferenceTable::Add(uint32_t cookie, const mirror::Object* o
   DCHECK(obj != NULL);
   // TODO: stronger sanity check on the object (such as in heap)
   DCHECK_ALIGNED(reinterpret_cast<uintptr_t>(obj), 8);
-  DCHECK(table_ != NULL);
+  DCHECK(chunks_ != NULL);
   DCHECK_LE(alloc_entries_, max_entries_);
   DCHECK_GE(segment_state_.parts.numHoles, prevState.parts.numHoles);
 
@@ -95,27 +111,12 @@ IndirectRef IndirectReferenceTable::Add(uint32_t cookie, const mirror::Object* o
                  << MutatorLockedDumpable<IndirectReferenceTable>(*this);
     }
 
-    size_t newSize = alloc_entries_ * 2;
-    if (newSize > max_entries_) {
-      newSize = max_entries_;
-    }
-    DCHECK_GT(newSize, alloc_entries_);
-
-    table_ = reinterpret_cast<const mirror::Object**>(realloc(table_, newSize * sizeof(const mirror::Object*)));
-    slot_data_ = reinterpret_cast<IndirectRefSlot*>(realloc(slot_data_,
-                                                            newSize * sizeof(IndirectRefSlot)));
-    if (table_ == NULL || slot_data_ == NULL) {
+    if (!Grow()) {
       LOG(FATAL) << "JNI ERROR (app bug): unable to expand "
-                 << kind_ << " table (from "
-                 << alloc_entries_ << " to " << newSize
+                 << kind_ << " table (from " << alloc_entries_
                  << ", max=" << max_entries_ << ")\n"
                  << MutatorLockedDumpable<IndirectReferenceTable>(*this);
     }
-
-    // Clear the newly-allocated slot_data_ elements.
-    memset(slot_data_ + alloc_entries_, 0, (newSize - alloc_entries_) * sizeof(IndirectRefSlot));
-
-    alloc_entries_ = newSize;
   }
 
   // We know there's enough room in the table.  Now we just need to find
@@ -126,21 +127,19 @@ IndirectRef IndirectReferenceTable::Add(uint32_t cookie, const mirror::Object* o
   if (numHoles > 0) {
     DCHECK_GT(topIndex, 1U);
     // Find the first hole; likely to be near the end of the list.
-    const mirror::Object** pScan = &table_[topIndex - 1];
-    DCHECK(*pScan != NULL);
-    while (*--pScan != NULL) {
-      DCHECK_GE(pScan, table_ + prevState.parts.topIndex);
+    size_t scan = topIndex - 1;
+    DCHECK(GetEntry(scan).ref != NULL);
+    while (GetEntry(--scan).ref != NULL) {
+      DCHECK_GE(scan, prevState.parts.topIndex);
     }
-    UpdateSlotAdd(obj, pScan - table_);
-    result = ToIndirectRef(obj, pScan - table_);
-    *pScan = obj;
+    SetEntry(scan, obj);
+    result = ToIndirectRef(scan);
     segment_state_.parts.numHoles--;
   } else {
     // Add to the end.
-    UpdateSlotAdd(obj, topIndex);
-    result = ToIndirectRef(obj, topIndex);
-    table_[topIndex++] = obj;
-    segment_state_.parts.topIndex = topIndex;
+    SetEntry(topIndex, obj);
+    result = ToIndirectRef(topIndex);
+    segment_state_.parts.topIndex = ++topIndex;
   }
   if (false) {
     LOG(INFO) << "+++ added at " << ExtractIndex(result) << " top=" << segment_state_.parts.topIndex
@@ -181,7 +180,7 @@ bool IndirectReferenceTable::GetChecked(IndirectRef iref) const {
     return false;
   }
 
-  if (UNLIKELY(table_[idx] == NULL)) {
+  if (UNLIKELY(GetEntry(idx).ref == NULL)) {
     LOG(ERROR) << "JNI ERROR (app bug): accessed deleted " << kind_ << " " << iref;
     AbortMaybe();
     return false;
@@ -194,9 +193,10 @@ bool IndirectReferenceTable::GetChecked(IndirectRef iref) const {
   return true;
 }
 
-static int Find(mirror::Object* direct_pointer, int bottomIndex, int topIndex, const mirror::Object** table) {
+int IndirectReferenceTable::Find(mirror::Object* direct_pointer, int bottomIndex,
+                                 int topIndex) const {
   for (int i = bottomIndex; i < topIndex; ++i) {
-    if (table[i] == direct_pointer) {
+    if (GetEntry(i).ref == direct_pointer) {
       return i;
     }
   }
@@ -204,7 +204,7 @@ static int Find(mirror::Object* direct_pointer, int bottomIndex, int topIndex, c
 }
 
 bool IndirectReferenceTable::ContainsDirectPointer(mirror::Object* direct_pointer) const {
-  return Find(direct_pointer, 0, segment_state_.parts.topIndex, table_) != -1;
+  return Find(direct_pointer, 0, segment_state_.parts.topIndex) != -1;
 }
 
 // Removes an object. We extract the table offset bits from "iref"
@@ -221,7 +221,7 @@ bool IndirectReferenceTable::Remove(uint32_t cookie, IndirectRef iref) {
   int topIndex = segment_state_.parts.topIndex;
   int bottomIndex = prevState.parts.topIndex;
 
-  DCHECK(table_ != NULL);
+  DCHECK(chunks_ != NULL);
   DCHECK_LE(alloc_entries_, max_entries_);
   DCHECK_GE(segment_state_.parts.numHoles, prevState.parts.numHoles);
 
@@ -235,7 +235,7 @@ bool IndirectReferenceTable::Remove(uint32_t cookie, IndirectRef iref) {
   }
   if (GetIndirectRefKind(iref) == kSirtOrInvalid && vm->work_around_app_jni_bugs) {
     mirror::Object* direct_pointer = reinterpret_cast<mirror::Object*>(iref);
-    idx = Find(direct_pointer, bottomIndex, topIndex, table_);
+    idx = Find(direct_pointer, bottomIndex, topIndex);
     if (idx == -1) {
       LOG(WARNING) << "Trying to work around app JNI bugs, but didn't find " << iref << " in table!";
       return false;
@@ -262,15 +262,15 @@ bool IndirectReferenceTable::Remove(uint32_t cookie, IndirectRef iref) {
       return false;
     }
 
-    table_[idx] = NULL;
+    ClearEntry(idx);
     int numHoles = segment_state_.parts.numHoles - prevState.parts.numHoles;
     if (numHoles != 0) {
       while (--topIndex > bottomIndex && numHoles != 0) {
         if (false) {
           LOG(INFO) << "+++ checking for hole at " << topIndex-1
-                    << " (cookie=" << cookie << ") val=" << table_[topIndex - 1];
+                    << " (cookie=" << cookie << ") val=" << GetEntry(topIndex - 1).ref;
         }
-        if (table_[topIndex-1] != NULL) {
+        if (GetEntry(topIndex - 1).ref != NULL) {
           break;
         }
         if (false) {
@@ -290,7 +290,7 @@ bool IndirectReferenceTable::Remove(uint32_t cookie, IndirectRef iref) {
     // Not the top-most entry.  This creates a hole.  We NULL out the
     // entry to prevent somebody from deleting it twice and screwing up
     // the hole count.
-    if (table_[idx] == NULL) {
+    if (GetEntry(idx).ref == NULL) {
       LOG(INFO) << "--- WEIRD: removing null entry " << idx;
       return false;
     }
@@ -298,7 +298,7 @@ bool IndirectReferenceTable::Remove(uint32_t cookie, IndirectRef iref) {
       return false;
     }
 
-    table_[idx] = NULL;
+    ClearEntry(idx);
     segment_state_.parts.numHoles++;
     if (false) {
       LOG(INFO) << "+++ left hole at " << idx << ", holes=" << segment_state_.parts.numHoles;
@@ -316,11 +316,12 @@ void IndirectReferenceTable::VisitRoots(RootVisitor* visitor, void* arg) {
 
 void IndirectReferenceTable::Dump(std::ostream& os) const {
   os << kind_ << " table dump:\n";
-  std::vector<const mirror::Object*> entries(table_, table_ + Capacity());
-  // Remove NULLs.
-  for (int i = entries.size() - 1; i >= 0; --i) {
-    if (entries[i] == NULL) {
-      entries.erase(entries.begin() + i);
+  std::vector<const mirror::Object*> entries;
+  // Skip NULLs.
+  for (size_t i = 0; i < Capacity(); ++i) {
+    const mirror::Object* obj = GetEntry(i).ref;
+    if (obj != NULL) {
+      entries.push_back(obj);
     }
   }
   ReferenceTable::Dump(os, entries);
@@ -124,15 +124,21 @@ static inline IndirectRefKind GetIndirectRefKind(IndirectRef iref) {
 }
 
 /*
- * Extended debugging structure.  We keep a parallel array of these, one
- * per slot in the table.
+ * Table entry.  The serial number is advanced whenever the slot is filled
+ * or emptied, which invalidates any outstanding references to it.  Keeping
+ * it next to the reference means a lookup touches a single cache line.
  */
-static const size_t kIRTPrevCount = 4;
-struct IndirectRefSlot {
+struct IrtEntry {
   uint32_t serial;
-  const mirror::Object* previous[kIRTPrevCount];
+  const mirror::Object* ref;
 };
 
+/*
+ * Entries are allocated in chunks of this many, so that growing a table
+ * never moves the entries it already has.
+ */
+static const size_t kIrtChunkEntries = 64;
+
 /* use as initial value for "cookie", and when table has only one segment */
 static const uint32_t IRT_FIRST_SEGMENT = 0;
 
@@ -145,9 +151,8 @@ static const uint32_t IRT_FIRST_SEGMENT = 0;
  * operations are adding a new entry and removing an entire table segment.
  *
  * If "alloc_entries_" is not equal to "max_entries_", the table may expand
- * when entries are added, which means the memory may move.  If you want
- * to keep pointers into "table" rather than offsets, you must use a
- * fixed-size table.
+ * when entries are added.  It does so a chunk at a time, so the memory of
+ * existing entries never moves and only as much is allocated as is used.
  *
  * If we delete entries from the middle of the list, we will be left with
  * "holes".  We track the number of holes so that, when adding new elements,
@@ -190,11 +195,10 @@ static const uint32_t IRT_FIRST_SEGMENT = 0;
  * and local refs to improve performance.  A large circular buffer might
  * reduce the amortized cost of adding global references.
  *
- * TODO: if we can guarantee that the underlying storage doesn't move,
- * e.g. by using oversized mmap regions to handle expanding tables, we may
- * be able to avoid having to synchronize lookups.  Might make sense to
- * add a "synchronized lookup" call that takes the mutex as an argument,
- * and either locks or doesn't lock based on internal details.
+ * TODO: now that the underlying storage doesn't move, we may be able to
+ * avoid having to synchronize lookups.  Might make sense to add a
+ * "synchronized lookup" call that takes the mutex as an argument, and
+ * either locks or doesn't lock based on internal details.
  */
 union IRTSegmentState {
   uint32_t          all;
@@ -206,8 +210,8 @@ union IRTSegmentState {
 
 class IrtIterator {
  public:
-  explicit IrtIterator(const mirror::Object** table, size_t i, size_t capacity)
-      : table_(table), i_(i), capacity_(capacity) {
+  explicit IrtIterator(IrtEntry* const* chunks, size_t i, size_t capacity)
+      : chunks_(chunks), i_(i), capacity_(capacity) {
     SkipNullsAndTombstones();
   }
 
@@ -218,22 +222,27 @@ class IrtIterator {
   }
 
   const mirror::Object** operator*() {
-    return &table_[i_];
+    return &Entry(i_).ref;
   }
 
   bool equals(const IrtIterator& rhs) const {
-    return (i_ == rhs.i_ && table_ == rhs.table_);
+    return (i_ == rhs.i_ && chunks_ == rhs.chunks_);
   }
 
  private:
+  IrtEntry& Entry(size_t i) const {
+    return chunks_[i / kIrtChunkEntries][i % kIrtChunkEntries];
+  }
+
   void SkipNullsAndTombstones() {
     // We skip NULLs and tombstones. Clients don't want to see implementation details.
-    while (i_ < capacity_ && (table_[i_] == NULL || table_[i_] == kClearedJniWeakGlobal)) {
+    while (i_ < capacity_ &&
+           (Entry(i_).ref == NULL || Entry(i_).ref == kClearedJniWeakGlobal)) {
       ++i_;
     }
   }
 
-  const mirror::Object** table_;
+  IrtEntry* const* chunks_;
   size_t i_;
   size_t capacity_;
 };
@@ -267,10 +276,19 @@ class IndirectReferenceTable {
    * Returns kInvalidIndirectRefObject if iref is invalid.
    */
   const mirror::Object* Get(IndirectRef iref) const {
+    // A live iref is below the top and is exactly what its slot would hand out now, which folds
+    // the kind, index and serial checks into one compare. Anything else takes the slow path to
+    // find out what is wrong with it.
+    uint32_t idx = ExtractIndex(iref);
+    if (LIKELY(idx < segment_state_.parts.topIndex && ToIndirectRef(idx) == iref)) {
+      const mirror::Object* obj = GetEntry(idx).ref;
+      DCHECK(obj != NULL);
+      return obj;
+    }
     if (!GetChecked(iref)) {
       return kInvalidIndirectRefObject;
     }
-    return table_[ExtractIndex(iref)];
+    return GetEntry(idx).ref;
   }
 
   // TODO: remove when we remove work_around_app_jni_bugs support.
@@ -300,11 +318,11 @@ class IndirectReferenceTable {
   }
 
   IrtIterator begin() {
-    return IrtIterator(table_, 0, Capacity());
+    return IrtIterator(chunks_, 0, Capacity());
   }
 
   IrtIterator end() {
-    return IrtIterator(table_, Capacity(), Capacity());
+    return IrtIterator(chunks_, Capacity(), Capacity());
   }
 
   void VisitRoots(RootVisitor* visitor, void* arg);
@@ -330,31 +348,47 @@ class IndirectReferenceTable {
     return (uref >> 2) & 0xffff;
   }
 
+  IrtEntry& GetEntry(size_t tableIndex) const {
+    return chunks_[tableIndex / kIrtChunkEntries][tableIndex % kIrtChunkEntries];
+  }
+
   /*
    * The object pointer itself is subject to relocation in some GC
-   * implementations, so we shouldn't really be using it here.
+   * implementations, so we don't use it here; the slot's serial number
+   * tells references to successive occupants apart instead.
    */
-  IndirectRef ToIndirectRef(const mirror::Object* /*o*/, uint32_t tableIndex) const {
+  IndirectRef ToIndirectRef(uint32_t tableIndex) const {
     DCHECK_LT(tableIndex, 65536U);
-    uint32_t serialChunk = slot_data_[tableIndex].serial;
+    uint32_t serialChunk = GetEntry(tableIndex).serial;
     uint32_t uref = serialChunk << 20 | (tableIndex << 2) | kind_;
     return (IndirectRef) uref;
   }
 
   /*
-   * Update extended debug info when an entry is added.
-   *
-   * We advance the serial number, invalidating any outstanding references to
-   * this slot.
+   * Store obj in an empty slot, advancing the serial number to invalidate any outstanding
+   * references to the slot's previous occupant.
    */
-  void UpdateSlotAdd(const mirror::Object* obj, int slot) {
-    if (slot_data_ != NULL) {
-      IndirectRefSlot* pSlot = &slot_data_[slot];
-      pSlot->serial++;
-      pSlot->previous[pSlot->serial % kIRTPrevCount] = obj;
-    }
+  void SetEntry(size_t tableIndex, const mirror::Object* obj) {
+    IrtEntry& entry = GetEntry(tableIndex);
+    entry.serial++;
+    entry.ref = obj;
+  }
+
+  /*
+   * Empty a slot, advancing the serial number so that references to it fail the fast check in
+   * Get.
+   */
+  void ClearEntry(size_t tableIndex) {
+    IrtEntry& entry = GetEntry(tableIndex);
+    entry.serial++;
+    entry.ref = NULL;
   }
 
+  /* allocate another chunk of entries; false if out of memory */
+  bool Grow();
+
+  int Find(mirror::Object* direct_pointer, int bottomIndex, int topIndex) const;
+
   /* extra debugging checks */
   bool GetChecked(IndirectRef) const;
   bool CheckEntry(const char*, IndirectRef, int) const;
@@ -362,12 +396,10 @@ class IndirectReferenceTable {
   /* semi-public - read/write by jni down calls */
   IRTSegmentState segment_state_;
 
-  /* bottom of the stack */
-  const mirror::Object** table_;
+  /* chunks of entries, enough pointers for max_entries_ but only allocated ones are non-NULL */
+  IrtEntry** chunks_;
   /* bit mask, ORed into all irefs */
   IndirectRefKind kind_;
-  /* extended debugging info */
-  IndirectRefSlot* slot_data_;
   /* #of entries we have space for */
   size_t alloc_entries_;
   /* max #of entries allowed */
@@ -250,4 +250,56 @@ TEST_F(IndirectReferenceTableTest, BasicTest) {
   CheckDump(&irt, 0, 0);
 }
 
+TEST_F(IndirectReferenceTableTest, ChunkedGrowth) {
+  ScopedObjectAccess soa(Thread::Current());
+  static const size_t kTableInitial = 1;
+  static const size_t kTableMax = 3 * kIrtChunkEntries + 1;
+  IndirectReferenceTable irt(kTableInitial, kTableMax, kLocal);
+
+  mirror::Class* c = class_linker_->FindSystemClass("Ljava/lang/Object;");
+  ASSERT_TRUE(c != NULL);
+  mirror::Object* obj0 = c->AllocObject(soa.Self());
+  ASSERT_TRUE(obj0 != NULL);
+  mirror::Object* obj1 = c->AllocObject(soa.Self());
+  ASSERT_TRUE(obj1 != NULL);
+
+  const uint32_t cookie = IRT_FIRST_SEGMENT;
+
+  // Remember where the first entry lives, growing must not move it.
+  IndirectRef first = irt.Add(cookie, obj0);
+  ASSERT_TRUE(first != NULL);
+  const mirror::Object** first_entry = *irt.begin();
+
+  // Fill the table to its maximum, a chunk at a time.
+  IndirectRef refs[kTableMax];
+  refs[0] = first;
+  for (size_t i = 1; i < kTableMax; i++) {
+    refs[i] = irt.Add(cookie, (i % 2 == 0) ? obj0 : obj1);
+    ASSERT_TRUE(refs[i] != NULL) << "Failed adding " << i;
+  }
+  ASSERT_EQ(kTableMax, irt.Capacity());
+  EXPECT_EQ(first_entry, *irt.begin());
+  for (size_t i = 0; i < kTableMax; i++) {
+    EXPECT_EQ((i % 2 == 0) ? obj0 : obj1, irt.Get(refs[i])) << i;
+  }
+  CheckDump(&irt, kTableMax, 2);
+
+  // A removed entry in a later chunk is caught by the serial check, even once its slot is reused.
+  size_t middle = 2 * kIrtChunkEntries;
+  ASSERT_TRUE(irt.Remove(cookie, refs[middle]));
+  EXPECT_EQ(kInvalidIndirectRefObject, irt.Get(refs[middle]));
+  IndirectRef reused = irt.Add(cookie, obj0);
+  ASSERT_TRUE(reused != NULL);
+  EXPECT_NE(refs[middle], reused);
+  EXPECT_EQ(obj0, irt.Get(reused));
+  EXPECT_EQ(kInvalidIndirectRefObject, irt.Get(refs[middle]));
+  refs[middle] = reused;
+
+  for (size_t i = kTableMax; i > 0; i--) {
+    ASSERT_TRUE(irt.Remove(cookie, refs[i - 1])) << "failed removing " << (i - 1);
+  }
+  ASSERT_EQ(0U, irt.Capacity());
+  CheckDump(&irt, 0, 0);
+}
+
 }  // namespace art
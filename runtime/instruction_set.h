@@ -18,6 +18,7 @@
 #define ART_RUNTIME_INSTRUCTION_SET_H_
 
 #include <iosfwd>
+#include <stdint.h>
 
 namespace art {
 
@@ -31,6 +32,39 @@ enum InstructionSet {
 
 std::ostream& operator<<(std::ostream& os, const InstructionSet& rhs);
 
+// Optional instruction set features that a particular core may implement.
+enum InstructionSetFeature {
+  kHwDiv = 1  // Hardware integer divide, e.g. sdiv and udiv on ARMv7ve cores such as the A15.
+};
+
+std::ostream& operator<<(std::ostream& os, const InstructionSetFeature& rhs);
+
+// The set of optional features the code being compiled may assume the target to have.
+class InstructionSetFeatures {
+ public:
+  InstructionSetFeatures() : mask_(0) {}
+  explicit InstructionSetFeatures(uint32_t mask) : mask_(mask) {}
+
+  bool HasDivideInstruction() const {
+    return (mask_ & kHwDiv) != 0;
+  }
+
+  void SetHasDivideInstruction(bool v) {
+    mask_ = (mask_ & ~kHwDiv) | (v ? kHwDiv : 0);
+  }
+
+  uint32_t GetMask() const {
+    return mask_;
+  }
+
+  bool operator==(const InstructionSetFeatures& peer) const {
+    return mask_ == peer.mask_;
+  }
+
+ private:
+  uint32_t mask_;
+};
+
 }  // namespace art
 
 #endif  // ART_RUNTIME_INSTRUCTION_SET_H_
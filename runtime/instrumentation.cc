@@ -48,57 +48,55 @@ static bool InstallStubsClassVisitor(mirror::Class* klass, void* arg)
 }
 
 bool Instrumentation::InstallStubsForClass(mirror::Class* klass) {
-  bool uninstall = !entry_exit_stubs_installed_ && !interpreter_stubs_installed_;
-  ClassLinker* class_linker = NULL;
-  if (uninstall) {
-    class_linker = Runtime::Current()->GetClassLinker();
-  }
-  bool is_initialized = klass->IsInitialized();
   for (size_t i = 0; i < klass->NumDirectMethods(); i++) {
     mirror::ArtMethod* method = klass->GetDirectMethod(i);
     if (!method->IsAbstract() && !method->IsProxyMethod()) {
-      const void* new_code;
-      if (uninstall) {
-        if (forced_interpret_only_ && !method->IsNative()) {
-          new_code = GetCompiledCodeToInterpreterBridge();
-        } else if (is_initialized || !method->IsStatic() || method->IsConstructor()) {
-          new_code = class_linker->GetOatCodeFor(method);
-        } else {
-          new_code = GetResolutionTrampoline(class_linker);
-        }
-      } else {  // !uninstall
-        if (!interpreter_stubs_installed_ || method->IsNative()) {
-          new_code = GetQuickInstrumentationEntryPoint();
-        } else {
-          new_code = GetCompiledCodeToInterpreterBridge();
-        }
+      if (IsDeoptimized(method)) {
+        method->SetEntryPointFromCompiledCode(GetCompiledCodeToInterpreterBridge());
+      } else {
+        method->SetEntryPointFromCompiledCode(GetUndeoptimizedCodeFor(method));
       }
-      method->SetEntryPointFromCompiledCode(new_code);
     }
   }
   for (size_t i = 0; i < klass->NumVirtualMethods(); i++) {
     mirror::ArtMethod* method = klass->GetVirtualMethod(i);
     if (!method->IsAbstract() && !method->IsProxyMethod()) {
-      const void* new_code;
-      if (uninstall) {
-        if (forced_interpret_only_ && !method->IsNative()) {
-          new_code = GetCompiledCodeToInterpreterBridge();
-        } else {
-          new_code = class_linker->GetOatCodeFor(method);
-        }
-      } else {  // !uninstall
-        if (!interpreter_stubs_installed_ || method->IsNative()) {
-          new_code = GetQuickInstrumentationEntryPoint();
-        } else {
-          new_code = GetCompiledCodeToInterpreterBridge();
-        }
+      if (IsDeoptimized(method)) {
+        method->SetEntryPointFromCompiledCode(GetCompiledCodeToInterpreterBridge());
+      } else {
+        method->SetEntryPointFromCompiledCode(GetUndeoptimizedCodeFor(method));
       }
-      method->SetEntryPointFromCompiledCode(new_code);
     }
   }
   return true;
 }
 
+const void* Instrumentation::GetUndeoptimizedCodeFor(mirror::ArtMethod* method) const {
+  if (entry_exit_stubs_installed_ || interpreter_stubs_installed_) {
+    if (!interpreter_stubs_installed_ || method->IsNative()) {
+      return GetQuickInstrumentationEntryPoint();
+    } else {
+      return GetCompiledCodeToInterpreterBridge();
+    }
+  }
+  if (IsInstrumented(method)) {
+    return GetQuickInstrumentationEntryPoint();
+  }
+  ClassLinker* class_linker = Runtime::Current()->GetClassLinker();
+  if (forced_interpret_only_ && !method->IsNative()) {
+    return GetCompiledCodeToInterpreterBridge();
+  } else if (!method->IsStatic() || method->IsConstructor() ||
+             method->GetDeclaringClass()->IsInitialized()) {
+    if (class_linker->HasCompressedOatCode(method)) {
+      // Leave compressed code to be inflated, if it hasn't been already, when it's next called.
+      return GetResolutionTrampoline(class_linker);
+    }
+    return class_linker->GetOatCodeFor(method);
+  } else {
+    return GetResolutionTrampoline(class_linker);
+  }
+}
+
 // Places the instrumentation exit pc as the return PC for every quick frame. This also allows
 // deoptimization of quick frames to interpreter frames.
 static void InstrumentationInstallStack(Thread* thread, void* arg)
@@ -106,7 +104,8 @@ static void InstrumentationInstallStack(Thread* thread, void* arg)
   struct InstallStackVisitor : public StackVisitor {
     InstallStackVisitor(Thread* thread, Context* context, uintptr_t instrumentation_exit_pc)
         : StackVisitor(thread, context),  instrumentation_stack_(thread->GetInstrumentationStack()),
-          instrumentation_exit_pc_(instrumentation_exit_pc), last_return_pc_(0) {}
+          instrumentation_exit_pc_(instrumentation_exit_pc), last_return_pc_(0),
+          instrumentation_stack_depth_(0) {}
 
     virtual bool VisitFrame() SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
       mirror::ArtMethod* m = GetMethod();
@@ -124,34 +123,48 @@ static void InstrumentationInstallStack(Thread* thread, void* arg)
         last_return_pc_ = 0;
         return true;  // Ignore upcalls.
       }
-      if (m->IsRuntimeMethod()) {
+      uintptr_t return_pc = GetReturnPc();
+      if (m->IsRuntimeMethod() && return_pc != instrumentation_exit_pc_) {
         if (kVerboseInstrumentation) {
           LOG(INFO) << "  Skipping runtime method. Frame " << GetFrameId();
         }
-        last_return_pc_ = GetReturnPc();
+        last_return_pc_ = return_pc;
         return true;  // Ignore unresolved methods since they will be instrumented after resolution.
       }
+      if (return_pc == instrumentation_exit_pc_) {
+        // Instrumented by an earlier install, or entered through the method entry stub. The frame
+        // keeps its place on the instrumentation stack, which has its real return pc.
+        return_pc = instrumentation_stack_->at(instrumentation_stack_depth_).return_pc_;
+        instrumentation_stack_depth_++;
+        last_return_pc_ = return_pc;
+        return true;  // Continue.
+      }
       if (kVerboseInstrumentation) {
         LOG(INFO) << "  Installing exit stub in " << DescribeLocation();
       }
-      uintptr_t return_pc = GetReturnPc();
-      CHECK_NE(return_pc, instrumentation_exit_pc_);
       CHECK_NE(return_pc, 0U);
       InstrumentationStackFrame instrumentation_frame(GetThisObject(), m, return_pc, GetFrameId(),
                                                       false);
       if (kVerboseInstrumentation) {
         LOG(INFO) << "Pushing frame " << instrumentation_frame.Dump();
       }
-      instrumentation_stack_->push_back(instrumentation_frame);
+      // The stack walk reads the instrumentation stack in order as it meets the exit pc, so the
+      // frame goes after those of the frames above it.
+      instrumentation_stack_->insert(instrumentation_stack_->begin() + instrumentation_stack_depth_,
+                                     instrumentation_frame);
+      instrumentation_stack_depth_++;
+      new_frames_.push_back(instrumentation_frame);
       dex_pcs_.push_back(m->ToDexPc(last_return_pc_));
       SetReturnPc(instrumentation_exit_pc_);
       last_return_pc_ = return_pc;
       return true;  // Continue.
     }
     std::deque<InstrumentationStackFrame>* const instrumentation_stack_;
+    std::vector<InstrumentationStackFrame> new_frames_;
     std::vector<uint32_t> dex_pcs_;
     const uintptr_t instrumentation_exit_pc_;
     uintptr_t last_return_pc_;
+    size_t instrumentation_stack_depth_;
   };
   if (kVerboseInstrumentation) {
     std::string thread_name;
@@ -163,16 +176,15 @@ static void InstrumentationInstallStack(Thread* thread, void* arg)
   InstallStackVisitor visitor(thread, context.get(), instrumentation_exit_pc);
   visitor.WalkStack(true);
 
-  // Create method enter events for all methods current on the thread's stack.
+  // Create method enter events for the methods on the thread's stack that weren't instrumented
+  // already, outermost first.
   Instrumentation* instrumentation = reinterpret_cast<Instrumentation*>(arg);
-  typedef std::deque<InstrumentationStackFrame>::const_reverse_iterator It;
-  for (It it = thread->GetInstrumentationStack()->rbegin(),
-       end = thread->GetInstrumentationStack()->rend(); it != end; ++it) {
-    mirror::Object* this_object = (*it).this_object_;
-    mirror::ArtMethod* method = (*it).method_;
-    uint32_t dex_pc = visitor.dex_pcs_.back();
+  while (!visitor.new_frames_.empty()) {
+    const InstrumentationStackFrame& frame = visitor.new_frames_.back();
+    instrumentation->MethodEnterEvent(thread, frame.this_object_, frame.method_,
+                                      visitor.dex_pcs_.back());
+    visitor.new_frames_.pop_back();
     visitor.dex_pcs_.pop_back();
-    instrumentation->MethodEnterEvent(thread, this_object, method, dex_pc);
   }
   thread->VerifyStack();
 }
@@ -258,18 +270,21 @@ static void InstrumentationRestoreStack(Thread* thread, void* arg)
   }
 }
 
+// Makes the interpreter in the thread pick its handlers again. A thread that was suspended
+// outside of a suspend check, blocked on a monitor for instance, would otherwise keep the
+// handlers it had.
+static void RequestInterpreterHandlerUpdate(Thread* thread, void*) {
+  thread->AtomicSetFlag(kInstrumentationRequest);
+}
+
 void Instrumentation::AddListener(InstrumentationListener* listener, uint32_t events) {
   Locks::mutator_lock_->AssertExclusiveHeld(Thread::Current());
-  bool require_entry_exit_stubs = false;
-  bool require_interpreter = false;
   if ((events & kMethodEntered) != 0) {
     method_entry_listeners_.push_back(listener);
-    require_entry_exit_stubs = true;
     have_method_entry_listeners_ = true;
   }
   if ((events & kMethodExited) != 0) {
     method_exit_listeners_.push_back(listener);
-    require_entry_exit_stubs = true;
     have_method_exit_listeners_ = true;
   }
   if ((events & kMethodUnwind) != 0) {
@@ -277,22 +292,22 @@ void Instrumentation::AddListener(InstrumentationListener* listener, uint32_t ev
     have_method_unwind_listeners_ = true;
   }
   if ((events & kDexPcMoved) != 0) {
+    // Only methods running in the interpreter report their dex pcs, the listener chooses which
+    // ones with Deoptimize or DeoptimizeEverything.
     dex_pc_listeners_.push_back(listener);
-    require_interpreter = true;
     have_dex_pc_listeners_ = true;
+    MutexLock mu(Thread::Current(), *Locks::thread_list_lock_);
+    Runtime::Current()->GetThreadList()->ForEach(RequestInterpreterHandlerUpdate, NULL);
   }
   if ((events & kExceptionCaught) != 0) {
     exception_caught_listeners_.push_back(listener);
     have_exception_caught_listeners_ = true;
   }
-  ConfigureStubs(require_entry_exit_stubs, require_interpreter);
+  ConfigureStubs(RequiresEntryExitStubs(), deoptimize_everything_);
 }
 
 void Instrumentation::RemoveListener(InstrumentationListener* listener, uint32_t events) {
   Locks::mutator_lock_->AssertExclusiveHeld(Thread::Current());
-  bool require_entry_exit_stubs = false;
-  bool require_interpreter = false;
-
   if ((events & kMethodEntered) != 0) {
     bool contains = std::find(method_entry_listeners_.begin(), method_entry_listeners_.end(),
                               listener) != method_entry_listeners_.end();
@@ -300,7 +315,6 @@ void Instrumentation::RemoveListener(InstrumentationListener* listener, uint32_t
       method_entry_listeners_.remove(listener);
     }
     have_method_entry_listeners_ = method_entry_listeners_.size() > 0;
-    require_entry_exit_stubs |= have_method_entry_listeners_;
   }
   if ((events & kMethodExited) != 0) {
     bool contains = std::find(method_exit_listeners_.begin(), method_exit_listeners_.end(),
@@ -309,7 +323,6 @@ void Instrumentation::RemoveListener(InstrumentationListener* listener, uint32_t
       method_exit_listeners_.remove(listener);
     }
     have_method_exit_listeners_ = method_exit_listeners_.size() > 0;
-    require_entry_exit_stubs |= have_method_exit_listeners_;
   }
   if ((events & kMethodUnwind) != 0) {
     method_unwind_listeners_.remove(listener);
@@ -321,13 +334,14 @@ void Instrumentation::RemoveListener(InstrumentationListener* listener, uint32_t
       dex_pc_listeners_.remove(listener);
     }
     have_dex_pc_listeners_ = dex_pc_listeners_.size() > 0;
-    require_interpreter |= have_dex_pc_listeners_;
+    MutexLock mu(Thread::Current(), *Locks::thread_list_lock_);
+    Runtime::Current()->GetThreadList()->ForEach(RequestInterpreterHandlerUpdate, NULL);
   }
   if ((events & kExceptionCaught) != 0) {
     exception_caught_listeners_.remove(listener);
     have_exception_caught_listeners_ = exception_caught_listeners_.size() > 0;
   }
-  ConfigureStubs(require_entry_exit_stubs, require_interpreter);
+  ConfigureStubs(RequiresEntryExitStubs(), deoptimize_everything_);
 }
 
 void Instrumentation::ConfigureStubs(bool require_entry_exit_stubs, bool require_interpreter) {
@@ -353,31 +367,122 @@ void Instrumentation::ConfigureStubs(bool require_entry_exit_stubs, bool require
     return;
   }
   Thread* self = Thread::Current();
-  Runtime* runtime = Runtime::Current();
   Locks::thread_list_lock_->AssertNotHeld(self);
+  interpreter_stubs_installed_ = desired_level == 2;
+  entry_exit_stubs_installed_ = desired_level == 1;
+  Runtime::Current()->GetClassLinker()->VisitClasses(InstallStubsClassVisitor, this);
   if (desired_level > 0) {
-    if (require_interpreter) {
-      interpreter_stubs_installed_ = true;
-    } else {
-      CHECK(require_entry_exit_stubs);
-      entry_exit_stubs_installed_ = true;
-    }
-    runtime->GetClassLinker()->VisitClasses(InstallStubsClassVisitor, this);
-    instrumentation_stubs_installed_ = true;
-    MutexLock mu(Thread::Current(), *Locks::thread_list_lock_);
-    runtime->GetThreadList()->ForEach(InstrumentationInstallStack, this);
-  } else {
-    interpreter_stubs_installed_ = false;
-    entry_exit_stubs_installed_ = false;
-    runtime->GetClassLinker()->VisitClasses(InstallStubsClassVisitor, this);
-    instrumentation_stubs_installed_ = false;
-    MutexLock mu(self, *Locks::thread_list_lock_);
-    Runtime::Current()->GetThreadList()->ForEach(InstrumentationRestoreStack, this);
+    InstallStacks();
+  } else if (deoptimized_methods_.empty() && method_filter_ == NULL) {
+    // Deoptimized and instrumented methods still need the exit pc on their frames.
+    RestoreStacks();
+  }
+}
+
+void Instrumentation::InstallStacks() {
+  instrumentation_stubs_installed_ = true;
+  MutexLock mu(Thread::Current(), *Locks::thread_list_lock_);
+  Runtime::Current()->GetThreadList()->ForEach(InstrumentationInstallStack, this);
+}
+
+void Instrumentation::RestoreStacks() {
+  instrumentation_stubs_installed_ = false;
+  MutexLock mu(Thread::Current(), *Locks::thread_list_lock_);
+  Runtime::Current()->GetThreadList()->ForEach(InstrumentationRestoreStack, this);
+}
+
+void Instrumentation::Deoptimize(mirror::ArtMethod* method) {
+  CHECK(!method->IsNative());
+  CHECK(!method->IsProxyMethod());
+  CHECK(!method->IsAbstract());
+  bool inserted = deoptimized_methods_.insert(method).second;
+  CHECK(inserted) << PrettyMethod(method) << " is already deoptimized";
+  method->SetEntryPointFromCompiledCode(GetCompiledCodeToInterpreterBridge());
+  // Compiled frames of the method can only be deoptimized when a callee returns to them through
+  // the exit pc. Frames created later run the interpreter from the start.
+  InstallStacks();
+}
+
+void Instrumentation::Undeoptimize(mirror::ArtMethod* method) {
+  size_t erased = deoptimized_methods_.erase(method);
+  CHECK_EQ(erased, 1U) << PrettyMethod(method) << " is not deoptimized";
+  method->SetEntryPointFromCompiledCode(GetUndeoptimizedCodeFor(method));
+  if (deoptimized_methods_.empty() && method_filter_ == NULL &&
+      !entry_exit_stubs_installed_ && !interpreter_stubs_installed_) {
+    RestoreStacks();
   }
 }
 
+bool Instrumentation::IsDeoptimized(const mirror::ArtMethod* method) const {
+  return !deoptimized_methods_.empty() &&
+      deoptimized_methods_.find(method) != deoptimized_methods_.end();
+}
+
+static bool ApplyMethodFilterClassVisitor(mirror::Class* klass, void* arg)
+    SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
+  Instrumentation* instrumentation = reinterpret_cast<Instrumentation*>(arg);
+  for (size_t i = 0; i < klass->NumDirectMethods(); i++) {
+    instrumentation->ApplyMethodFilter(klass->GetDirectMethod(i));
+  }
+  for (size_t i = 0; i < klass->NumVirtualMethods(); i++) {
+    instrumentation->ApplyMethodFilter(klass->GetVirtualMethod(i));
+  }
+  return instrumentation->InstallStubsForClass(klass);
+}
+
+void Instrumentation::SetMethodFilter(const InstrumentationMethodFilter* filter) {
+  Locks::mutator_lock_->AssertExclusiveHeld(Thread::Current());
+  method_filter_ = filter;
+  // Takes the stubs away from all methods, or gives them back, if they're listened to.
+  ConfigureStubs(RequiresEntryExitStubs(), deoptimize_everything_);
+  Runtime::Current()->GetClassLinker()->VisitClasses(ApplyMethodFilterClassVisitor, this);
+  if (filter != NULL) {
+    // Frames of the instrumented methods already on the stack report their exit through the exit
+    // pc.
+    InstallStacks();
+  } else if (deoptimized_methods_.empty() && !entry_exit_stubs_installed_ &&
+             !interpreter_stubs_installed_) {
+    RestoreStacks();
+  }
+}
+
+void Instrumentation::ApplyMethodFilter(mirror::ArtMethod* method) const {
+  if (method->IsAbstract() || method->IsProxyMethod()) {
+    return;
+  }
+  bool instrumented = method_filter_ != NULL && method_filter_->Matches(method);
+  if (instrumented != method->IsInstrumented()) {
+    method->SetInstrumented(instrumented);
+  }
+}
+
+bool Instrumentation::IsInstrumented(const mirror::ArtMethod* method) const {
+  return method_filter_ != NULL && method->IsInstrumented();
+}
+
+bool Instrumentation::ReportsEventsFor(const mirror::ArtMethod* method) const {
+  return method_filter_ == NULL || method->IsInstrumented();
+}
+
+void Instrumentation::DeoptimizeEverything() {
+  CHECK(!deoptimize_everything_);
+  deoptimize_everything_ = true;
+  ConfigureStubs(RequiresEntryExitStubs(), true);
+}
+
+void Instrumentation::UndeoptimizeEverything() {
+  CHECK(deoptimize_everything_);
+  deoptimize_everything_ = false;
+  ConfigureStubs(RequiresEntryExitStubs(), false);
+}
+
 void Instrumentation::UpdateMethodsCode(mirror::ArtMethod* method, const void* code) const {
-  if (LIKELY(!instrumentation_stubs_installed_)) {
+  if (UNLIKELY(IsDeoptimized(method))) {
+    // Stay in the interpreter. Undeoptimize works out the code the method gets back.
+    return;
+  }
+  if (LIKELY(!entry_exit_stubs_installed_ && !interpreter_stubs_installed_ &&
+             !IsInstrumented(method))) {
     method->SetEntryPointFromCompiledCode(code);
   } else {
     if (!interpreter_stubs_installed_ || method->IsNative()) {
@@ -390,7 +495,8 @@ void Instrumentation::UpdateMethodsCode(mirror::ArtMethod* method, const void* c
 
 const void* Instrumentation::GetQuickCodeFor(const mirror::ArtMethod* method) const {
   Runtime* runtime = Runtime::Current();
-  if (LIKELY(!instrumentation_stubs_installed_)) {
+  if (LIKELY(!entry_exit_stubs_installed_ && !interpreter_stubs_installed_ &&
+             !IsInstrumented(method))) {
     const void* code = method->GetEntryPointFromCompiledCode();
     DCHECK(code != NULL);
     if (LIKELY(code != GetQuickResolutionTrampoline(runtime->GetClassLinker()) &&
@@ -404,6 +510,9 @@ const void* Instrumentation::GetQuickCodeFor(const mirror::ArtMethod* method) co
 void Instrumentation::MethodEnterEventImpl(Thread* thread, mirror::Object* this_object,
                                            const mirror::ArtMethod* method,
                                            uint32_t dex_pc) const {
+  if (!ReportsEventsFor(method)) {
+    return;
+  }
   auto it = method_entry_listeners_.begin();
   bool is_end = (it == method_entry_listeners_.end());
   // Implemented this way to prevent problems caused by modification of the list while iterating.
@@ -418,6 +527,9 @@ void Instrumentation::MethodEnterEventImpl(Thread* thread, mirror::Object* this_
 void Instrumentation::MethodExitEventImpl(Thread* thread, mirror::Object* this_object,
                                           const mirror::ArtMethod* method,
                                           uint32_t dex_pc, const JValue& return_value) const {
+  if (!ReportsEventsFor(method)) {
+    return;
+  }
   auto it = method_exit_listeners_.begin();
   bool is_end = (it == method_exit_listeners_.end());
   // Implemented this way to prevent problems caused by modification of the list while iterating.
@@ -432,7 +544,7 @@ void Instrumentation::MethodExitEventImpl(Thread* thread, mirror::Object* this_o
 void Instrumentation::MethodUnwindEvent(Thread* thread, mirror::Object* this_object,
                                         const mirror::ArtMethod* method,
                                         uint32_t dex_pc) const {
-  if (have_method_unwind_listeners_) {
+  if (have_method_unwind_listeners_ && ReportsEventsFor(method)) {
     for (InstrumentationListener* listener : method_unwind_listeners_) {
       listener->MethodUnwind(thread, method, dex_pc);
     }
@@ -523,11 +635,14 @@ uint64_t Instrumentation::PopInstrumentationStackFrame(Thread* self, uintptr_t*
   MethodExitEvent(self, this_object, instrumentation_frame.method_, dex_pc, return_value);
 
   bool deoptimize = false;
-  if (interpreter_stubs_installed_) {
-    // Deoptimize unless we're returning to an upcall.
+  if (interpreter_stubs_installed_ || !deoptimized_methods_.empty()) {
+    // Deoptimize unless we're returning to an upcall or to a method that keeps its compiled code.
+    // Deoptimization carries on to the next upcall, so the caller's compiled callers finish in the
+    // interpreter too.
     NthCallerVisitor visitor(self, 1, true);
     visitor.WalkStack(true);
-    deoptimize = visitor.caller != NULL;
+    deoptimize = visitor.caller != NULL &&
+        (interpreter_stubs_installed_ || IsDeoptimized(visitor.caller));
     if (deoptimize && kVerboseInstrumentation) {
       LOG(INFO) << "Deoptimizing into " << PrettyMethod(visitor.caller);
     }
@@ -22,6 +22,7 @@
 
 #include <stdint.h>
 #include <list>
+#include <set>
 
 namespace art {
 namespace mirror {
@@ -75,6 +76,15 @@ struct InstrumentationListener {
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) = 0;
 };
 
+// Chooses the methods Instrumentation::SetMethodFilter instruments.
+struct InstrumentationMethodFilter {
+  InstrumentationMethodFilter() {}
+  virtual ~InstrumentationMethodFilter() {}
+
+  virtual bool Matches(const mirror::ArtMethod* method) const
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) = 0;
+};
+
 // Instrumentation is a catch-all for when extra information is required from the runtime. The
 // typical use for instrumentation is for profiling and debugging. Instrumentation may add stubs
 // to method entry and exit, it may also force execution to be switched to the interpreter and
@@ -92,10 +102,10 @@ class Instrumentation {
   Instrumentation() :
       instrumentation_stubs_installed_(false), entry_exit_stubs_installed_(false),
       interpreter_stubs_installed_(false),
-      interpret_only_(false), forced_interpret_only_(false),
+      interpret_only_(false), forced_interpret_only_(false), deoptimize_everything_(false),
       have_method_entry_listeners_(false), have_method_exit_listeners_(false),
       have_method_unwind_listeners_(false), have_dex_pc_listeners_(false),
-      have_exception_caught_listeners_(false) {}
+      have_exception_caught_listeners_(false), method_filter_(NULL) {}
 
   // Add a listener to be notified of the masked together sent of instrumentation events. This
   // suspend the runtime to install stubs. You are expected to hold the mutator lock as a proxy
@@ -110,8 +120,51 @@ class Instrumentation {
       EXCLUSIVE_LOCKS_REQUIRED(Locks::mutator_lock_)
       LOCKS_EXCLUDED(Locks::thread_list_lock_, Locks::classlinker_classes_lock_);
 
+  // Deoptimizes a method: it runs in the interpreter, and its compiled frames already on thread
+  // stacks are deoptimized when a callee returns to them. All other methods keep their compiled
+  // code. Dex pc listeners only see methods running in the interpreter, so a debugger deoptimizes
+  // the methods holding breakpoints instead of the whole runtime.
+  void Deoptimize(mirror::ArtMethod* method)
+      EXCLUSIVE_LOCKS_REQUIRED(Locks::mutator_lock_)
+      LOCKS_EXCLUDED(Locks::thread_list_lock_, Locks::classlinker_classes_lock_);
+
+  // Undoes Deoptimize, giving the method back the code it would have without it.
+  void Undeoptimize(mirror::ArtMethod* method)
+      EXCLUSIVE_LOCKS_REQUIRED(Locks::mutator_lock_)
+      LOCKS_EXCLUDED(Locks::thread_list_lock_, Locks::classlinker_classes_lock_);
+
+  bool IsDeoptimized(const mirror::ArtMethod* method) const
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
+  // Gives the methods the filter matches the entry and exit stubs, and limits method entry, exit
+  // and unwind events to them. All other methods keep their code, so listening to a few methods
+  // doesn't slow down the rest, as adding an entry or exit listener alone does. The filter is
+  // evaluated once per method, now for the loaded classes and by ApplyMethodFilter for the
+  // classes linked later. NULL removes the filter, the caller keeps ownership of it.
+  void SetMethodFilter(const InstrumentationMethodFilter* filter)
+      EXCLUSIVE_LOCKS_REQUIRED(Locks::mutator_lock_)
+      LOCKS_EXCLUDED(Locks::thread_list_lock_, Locks::classlinker_classes_lock_);
+
+  // Evaluates the method filter for a method being linked, before other threads can see it.
+  void ApplyMethodFilter(mirror::ArtMethod* method) const
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
+  bool IsInstrumented(const mirror::ArtMethod* method) const
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
+  // Runs every method in the interpreter, for when the methods that need dex pc events can't be
+  // known in advance, such as stepping into calls.
+  void DeoptimizeEverything()
+      EXCLUSIVE_LOCKS_REQUIRED(Locks::mutator_lock_)
+      LOCKS_EXCLUDED(Locks::thread_list_lock_, Locks::classlinker_classes_lock_);
+
+  void UndeoptimizeEverything()
+      EXCLUSIVE_LOCKS_REQUIRED(Locks::mutator_lock_)
+      LOCKS_EXCLUDED(Locks::thread_list_lock_, Locks::classlinker_classes_lock_);
+
   // Update the code of a method respecting any installed stubs.
-  void UpdateMethodsCode(mirror::ArtMethod* method, const void* code) const;
+  void UpdateMethodsCode(mirror::ArtMethod* method, const void* code) const
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
 
   // Get the quick code for the given method. More efficient than asking the class linker as it
   // will short-cut to GetCode if instrumentation and static method resolution stubs aren't
@@ -215,6 +268,26 @@ class Instrumentation {
       EXCLUSIVE_LOCKS_REQUIRED(Locks::mutator_lock_)
       LOCKS_EXCLUDED(Locks::thread_list_lock_, Locks::classlinker_classes_lock_);
 
+  // Places or removes the instrumentation exit pc on every thread's stack, as needed by the
+  // installed stubs and deoptimized methods.
+  void InstallStacks() EXCLUSIVE_LOCKS_REQUIRED(Locks::mutator_lock_)
+      LOCKS_EXCLUDED(Locks::thread_list_lock_);
+  void RestoreStacks() EXCLUSIVE_LOCKS_REQUIRED(Locks::mutator_lock_)
+      LOCKS_EXCLUDED(Locks::thread_list_lock_);
+
+  // Whether every method needs the entry and exit stubs, rather than the instrumented ones only.
+  bool RequiresEntryExitStubs() const {
+    return (have_method_entry_listeners_ || have_method_exit_listeners_) && method_filter_ == NULL;
+  }
+
+  // Whether the events of the method go to the listeners, see SetMethodFilter.
+  bool ReportsEventsFor(const mirror::ArtMethod* method) const
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
+  // The code a method has when it isn't deoptimized, given the installed stubs.
+  const void* GetUndeoptimizedCodeFor(mirror::ArtMethod* method) const
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
   void MethodEnterEventImpl(Thread* thread, mirror::Object* this_object,
                             const mirror::ArtMethod* method, uint32_t dex_pc) const
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
@@ -241,6 +314,9 @@ class Instrumentation {
   // Did the runtime request we only run in the interpreter? ie -Xint mode.
   bool forced_interpret_only_;
 
+  // Has DeoptimizeEverything been called without a matching UndeoptimizeEverything?
+  bool deoptimize_everything_;
+
   // Do we have any listeners for method entry events? Short-cut to avoid taking the
   // instrumentation_lock_.
   bool have_method_entry_listeners_;
@@ -267,6 +343,12 @@ class Instrumentation {
   std::list<InstrumentationListener*> dex_pc_listeners_ GUARDED_BY(Locks::mutator_lock_);
   std::list<InstrumentationListener*> exception_caught_listeners_ GUARDED_BY(Locks::mutator_lock_);
 
+  // The methods passed to Deoptimize, written to with the mutator_lock_ exclusively held.
+  std::set<const mirror::ArtMethod*> deoptimized_methods_ GUARDED_BY(Locks::mutator_lock_);
+
+  // See SetMethodFilter, written to with the mutator_lock_ exclusively held.
+  const InstrumentationMethodFilter* method_filter_ GUARDED_BY(Locks::mutator_lock_);
+
   DISALLOW_COPY_AND_ASSIGN(Instrumentation);
 };
 
@@ -282,9 +364,9 @@ struct InstrumentationStackFrame {
 
   mirror::Object* this_object_;
   mirror::ArtMethod* method_;
-  const uintptr_t return_pc_;
-  const size_t frame_id_;
-  const bool interpreter_entry_;
+  uintptr_t return_pc_;
+  size_t frame_id_;
+  bool interpreter_entry_;
 };
 
 }  // namespace instrumentation
@@ -16,6 +16,8 @@
 
 #include "intern_table.h"
 
+#include "base/stl_util.h"
+#include "cutils/atomic-inline.h"
 #include "gc/space/image_space.h"
 #include "mirror/dex_cache.h"
 #include "mirror/object_array-inl.h"
@@ -27,29 +29,135 @@
 
 namespace art {
 
+InternTable::Table::Table()
+    : slots_(new SlotArray(kInitialCapacity)), num_entries_(0), num_tombstones_(0) {
+}
+
+InternTable::Table::~Table() {
+  FreeRetiredSlots();
+  delete slots_;
+}
+
+mirror::String* InternTable::Table::Lookup(mirror::String* s, int32_t hash_code) const {
+  const SlotArray* slots = slots_;
+  for (size_t i = hash_code & slots->mask; ; i = (i + 1) & slots->mask) {
+    const Slot& slot = slots->slots[i];
+    mirror::String* existing_string = slot.string;
+    if (existing_string == NULL) {
+      return NULL;
+    }
+    if (existing_string != Tombstone() && slot.hash_code == hash_code &&
+        existing_string->Equals(s)) {
+      return existing_string;
+    }
+  }
+}
+
+void InternTable::Table::Insert(mirror::String* s, int32_t hash_code) {
+  DCHECK(IsLive(s));
+  // Keep at least a quarter of the slots empty so that probe sequences stay short.
+  if ((num_entries_ + num_tombstones_ + 1) * 4 > (slots_->mask + 1) * 3) {
+    Rehash();
+  }
+  SlotArray* slots = slots_;
+  size_t i = hash_code & slots->mask;
+  while (IsLive(slots->slots[i].string)) {
+    i = (i + 1) & slots->mask;
+  }
+  Slot& slot = slots->slots[i];
+  if (slot.string == Tombstone()) {
+    --num_tombstones_;
+  }
+  slot.hash_code = hash_code;
+  // Readers must see the hash code and the string's contents before the string.
+  ANDROID_MEMBAR_STORE();
+  slot.string = s;
+  ++num_entries_;
+}
+
+void InternTable::Table::Remove(const mirror::String* s, int32_t hash_code) {
+  SlotArray* slots = slots_;
+  for (size_t i = hash_code & slots->mask; slots->slots[i].string != NULL;
+       i = (i + 1) & slots->mask) {
+    Slot& slot = slots->slots[i];
+    if (slot.string == s) {
+      slot.string = Tombstone();
+      --num_entries_;
+      ++num_tombstones_;
+      return;
+    }
+  }
+}
+
+void InternTable::Table::Rehash() {
+  SlotArray* old_slots = slots_;
+  size_t capacity = old_slots->mask + 1;
+  if (num_entries_ * 2 >= capacity) {
+    capacity *= 2;
+  }
+  SlotArray* new_slots = new SlotArray(capacity);
+  for (const Slot& slot : old_slots->slots) {
+    if (IsLive(slot.string)) {
+      size_t i = slot.hash_code & new_slots->mask;
+      while (new_slots->slots[i].string != NULL) {
+        i = (i + 1) & new_slots->mask;
+      }
+      new_slots->slots[i] = slot;
+    }
+  }
+  num_tombstones_ = 0;
+  // Publish the filled in slots, readers may still be probing the old ones.
+  ANDROID_MEMBAR_STORE();
+  slots_ = new_slots;
+  retired_slots_.push_back(old_slots);
+}
+
+void InternTable::Table::VisitRoots(RootVisitor* visitor, void* arg) const {
+  for (const Slot& slot : slots_->slots) {
+    if (IsLive(slot.string)) {
+      visitor(slot.string, arg);
+    }
+  }
+}
+
+void InternTable::Table::SweepWeaks(IsMarkedTester is_marked, void* arg) {
+  for (Slot& slot : slots_->slots) {
+    if (IsLive(slot.string) && !is_marked(slot.string, arg)) {
+      slot.string = Tombstone();
+      --num_entries_;
+      ++num_tombstones_;
+    }
+  }
+}
+
+void InternTable::Table::FreeRetiredSlots() {
+  STLDeleteElements(&retired_slots_);
+}
+
 InternTable::InternTable()
     : intern_table_lock_("InternTable lock"), is_dirty_(false), allow_new_interns_(true),
       new_intern_condition_("New intern condition", intern_table_lock_) {
 }
 
+InternTable::~InternTable() {
+}
+
 size_t InternTable::Size() const {
   MutexLock mu(Thread::Current(), intern_table_lock_);
-  return strong_interns_.size() + weak_interns_.size();
+  return strong_interns_.Size() + weak_interns_.Size();
 }
 
 void InternTable::DumpForSigQuit(std::ostream& os) const {
   MutexLock mu(Thread::Current(), intern_table_lock_);
-  os << "Intern table: " << strong_interns_.size() << " strong; "
-     << weak_interns_.size() << " weak\n";
+  os << "Intern table: " << strong_interns_.Size() << " strong; "
+     << weak_interns_.Size() << " weak\n";
 }
 
 void InternTable::VisitRoots(RootVisitor* visitor, void* arg,
                              bool only_dirty, bool clean_dirty) {
   MutexLock mu(Thread::Current(), intern_table_lock_);
   if (!only_dirty || is_dirty_) {
-    for (const auto& strong_intern : strong_interns_) {
-      visitor(strong_intern.second, arg);
-    }
+    strong_interns_.VisitRoots(visitor, arg);
     if (clean_dirty) {
       is_dirty_ = false;
     }
@@ -58,59 +166,26 @@ void InternTable::VisitRoots(RootVisitor* visitor, void* arg,
   // image roots.
 }
 
-mirror::String* InternTable::Lookup(Table& table, mirror::String* s,
-                                    uint32_t hash_code) {
-  intern_table_lock_.AssertHeld(Thread::Current());
-  for (auto it = table.find(hash_code), end = table.end(); it != end; ++it) {
-    mirror::String* existing_string = it->second;
-    if (existing_string->Equals(s)) {
-      return existing_string;
-    }
-  }
-  return NULL;
-}
-
-mirror::String* InternTable::Insert(Table& table, mirror::String* s,
-                                    uint32_t hash_code) {
-  intern_table_lock_.AssertHeld(Thread::Current());
-  table.insert(std::make_pair(hash_code, s));
-  return s;
-}
-
-void InternTable::Remove(Table& table, const mirror::String* s,
-                         uint32_t hash_code) {
-  intern_table_lock_.AssertHeld(Thread::Current());
-  for (auto it = table.find(hash_code), end = table.end(); it != end; ++it) {
-    if (it->second == s) {
-      table.erase(it);
-      return;
-    }
-  }
-}
-
-static mirror::String* LookupStringFromImage(mirror::String* s)
+// Looks the string up in the boot image's hash table of interned strings, which is read-only so
+// needs no lock.
+static mirror::String* LookupStringFromImage(mirror::String* s, int32_t hash_code)
     SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
   gc::space::ImageSpace* image = Runtime::Current()->GetHeap()->GetImageSpace();
   if (image == NULL) {
     return NULL;  // No image present.
   }
-  mirror::Object* root = image->GetImageHeader().GetImageRoot(ImageHeader::kDexCaches);
-  mirror::ObjectArray<mirror::DexCache>* dex_caches = root->AsObjectArray<mirror::DexCache>();
-  const std::string utf8 = s->ToModifiedUtf8();
-  for (int32_t i = 0; i < dex_caches->GetLength(); ++i) {
-    mirror::DexCache* dex_cache = dex_caches->Get(i);
-    const DexFile* dex_file = dex_cache->GetDexFile();
-    // Binary search the dex file for the string index.
-    const DexFile::StringId* string_id = dex_file->FindStringId(utf8.c_str());
-    if (string_id != NULL) {
-      uint32_t string_idx = dex_file->GetIndexForStringId(*string_id);
-      mirror::String* image = dex_cache->GetResolvedString(string_idx);
-      if (image != NULL) {
-        return image;
-      }
+  mirror::Object* root = image->GetImageHeader().GetImageRoot(ImageHeader::kInternedStrings);
+  mirror::ObjectArray<mirror::String>* table = root->AsObjectArray<mirror::String>();
+  size_t mask = table->GetLength() - 1;
+  for (size_t index = hash_code & mask; ; index = (index + 1) & mask) {
+    mirror::String* image_string = table->GetWithoutChecks(index);
+    if (image_string == NULL) {
+      return NULL;
+    }
+    if (image_string->GetHashCode() == hash_code && image_string->Equals(s)) {
+      return image_string;
     }
   }
-  return NULL;
 }
 
 void InternTable::AllowNewInterns() {
@@ -124,22 +199,45 @@ void InternTable::DisallowNewInterns() {
   Thread* self = Thread::Current();
   MutexLock mu(self, intern_table_lock_);
   allow_new_interns_ = false;
+  // All other threads are suspended, so none of them can be probing old slot arrays.
+  strong_interns_.FreeRetiredSlots();
+  weak_interns_.FreeRetiredSlots();
 }
 
 mirror::String* InternTable::Insert(mirror::String* s, bool is_strong) {
+  DCHECK(s != NULL);
+  int32_t hash_code = s->GetHashCode();
+
+  // Fast path for strings which are already interned. New interns are only disallowed while all
+  // threads are suspended, so no lookup can race with the weak strings being swept.
+  if (LIKELY(allow_new_interns_)) {
+    mirror::String* strong = strong_interns_.Lookup(s, hash_code);
+    if (strong != NULL) {
+      return strong;
+    }
+  }
+  // Image strings are interned by the image itself, they never go in the tables.
+  mirror::String* image = LookupStringFromImage(s, hash_code);
+  if (image != NULL) {
+    return image;
+  }
+  if (LIKELY(allow_new_interns_) && !is_strong) {
+    mirror::String* weak = weak_interns_.Lookup(s, hash_code);
+    if (weak != NULL) {
+      return weak;
+    }
+  }
+
   Thread* self = Thread::Current();
   MutexLock mu(self, intern_table_lock_);
 
-  DCHECK(s != NULL);
-  uint32_t hash_code = s->GetHashCode();
-
   while (UNLIKELY(!allow_new_interns_)) {
     new_intern_condition_.WaitHoldingLocks(self);
   }
 
   if (is_strong) {
     // Check the strong table for a match.
-    mirror::String* strong = Lookup(strong_interns_, s, hash_code);
+    mirror::String* strong = strong_interns_.Lookup(s, hash_code);
     if (strong != NULL) {
       return strong;
     }
@@ -147,42 +245,34 @@ mirror::String* InternTable::Insert(mirror::String* s, bool is_strong) {
     // Mark as dirty so that we rescan the roots.
     is_dirty_ = true;
 
-    // Check the image for a match.
-    mirror::String* image = LookupStringFromImage(s);
-    if (image != NULL) {
-      return Insert(strong_interns_, image, hash_code);
-    }
-
     // There is no match in the strong table, check the weak table.
-    mirror::String* weak = Lookup(weak_interns_, s, hash_code);
+    mirror::String* weak = weak_interns_.Lookup(s, hash_code);
     if (weak != NULL) {
       // A match was found in the weak table. Promote to the strong table.
-      Remove(weak_interns_, weak, hash_code);
-      return Insert(strong_interns_, weak, hash_code);
+      weak_interns_.Remove(weak, hash_code);
+      strong_interns_.Insert(weak, hash_code);
+      return weak;
     }
 
     // No match in the strong table or the weak table. Insert into the strong
     // table.
-    return Insert(strong_interns_, s, hash_code);
+    strong_interns_.Insert(s, hash_code);
+    return s;
   }
 
   // Check the strong table for a match.
-  mirror::String* strong = Lookup(strong_interns_, s, hash_code);
+  mirror::String* strong = strong_interns_.Lookup(s, hash_code);
   if (strong != NULL) {
     return strong;
   }
-  // Check the image for a match.
-  mirror::String* image = LookupStringFromImage(s);
-  if (image != NULL) {
-    return Insert(weak_interns_, image, hash_code);
-  }
   // Check the weak table for a match.
-  mirror::String* weak = Lookup(weak_interns_, s, hash_code);
+  mirror::String* weak = weak_interns_.Lookup(s, hash_code);
   if (weak != NULL) {
     return weak;
   }
   // Insert into the weak table.
-  return Insert(weak_interns_, s, hash_code);
+  weak_interns_.Insert(s, hash_code);
+  return s;
 }
 
 mirror::String* InternTable::InternStrong(int32_t utf16_length,
@@ -212,21 +302,13 @@ mirror::String* InternTable::InternWeak(mirror::String* s) {
 
 bool InternTable::ContainsWeak(mirror::String* s) {
   MutexLock mu(Thread::Current(), intern_table_lock_);
-  const mirror::String* found = Lookup(weak_interns_, s, s->GetHashCode());
+  const mirror::String* found = weak_interns_.Lookup(s, s->GetHashCode());
   return found == s;
 }
 
 void InternTable::SweepInternTableWeaks(IsMarkedTester is_marked, void* arg) {
   MutexLock mu(Thread::Current(), intern_table_lock_);
-  // TODO: std::remove_if + lambda.
-  for (auto it = weak_interns_.begin(), end = weak_interns_.end(); it != end;) {
-    mirror::Object* object = it->second;
-    if (!is_marked(object, arg)) {
-      weak_interns_.erase(it++);
-    } else {
-      ++it;
-    }
-  }
+  weak_interns_.SweepWeaks(is_marked, arg);
 }
 
 }  // namespace art
@@ -20,7 +20,7 @@
 #include "base/mutex.h"
 #include "root_visitor.h"
 
-#include <map>
+#include <vector>
 
 namespace art {
 namespace mirror {
@@ -36,10 +36,17 @@ class String;
  * String.intern. Some code (XML parsers being a prime example) relies on being able to intern
  * arbitrarily many strings for the duration of a parse without permanently increasing the memory
  * footprint.
+ *
+ * Lookups of strings which are already interned don't take the lock. Inserting, removing and
+ * sweeping strings requires intern_table_lock_.
+ *
+ * The boot image's strings are interned by a read-only hash table in the image, see
+ * ImageHeader::kInternedStrings, and are never added to either table.
  */
 class InternTable {
  public:
   InternTable();
+  ~InternTable();
 
   // Interns a potentially new string in the 'strong' table. (See above.)
   mirror::String* InternStrong(int32_t utf16_length, const char* utf8_data)
@@ -70,22 +77,74 @@ class InternTable {
   void AllowNewInterns() SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
 
  private:
-  typedef std::multimap<int32_t, mirror::String*> Table;
+  // An open addressing hash set of strings using linear probing. Lookups may run concurrently with
+  // a single writer, they can miss strings which are being inserted but never return a string
+  // which isn't equal to the one looked up. Slot arrays replaced when growing are kept until
+  // FreeRetiredSlots, which must only be called when no thread can be in the middle of a lookup.
+  class Table {
+   public:
+    Table();
+    ~Table();
+
+    mirror::String* Lookup(mirror::String* s, int32_t hash_code) const
+        SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+    void Insert(mirror::String* s, int32_t hash_code);
+    void Remove(const mirror::String* s, int32_t hash_code);
+
+    void VisitRoots(RootVisitor* visitor, void* arg) const;
+    void SweepWeaks(IsMarkedTester is_marked, void* arg);
+    void FreeRetiredSlots();
+
+    size_t Size() const {
+      return num_entries_;
+    }
+
+   private:
+    struct Slot {
+      int32_t hash_code;
+      mirror::String* volatile string;
+    };
+
+    struct SlotArray {
+      explicit SlotArray(size_t capacity) : mask(capacity - 1), slots(capacity) {}
+
+      const size_t mask;
+      std::vector<Slot> slots;
+    };
+
+    static const size_t kInitialCapacity = 1024;
+    static const uintptr_t kTombstone = 1;
+
+    static bool IsLive(const mirror::String* string) {
+      return string != NULL && string != Tombstone();
+    }
+
+    // Marks slots whose string was removed so that probing continues past them.
+    static mirror::String* Tombstone() {
+      return reinterpret_cast<mirror::String*>(kTombstone);
+    }
+
+    // Rehash into a new slot array, growing it if it is more than half full of live strings.
+    void Rehash();
+
+    SlotArray* volatile slots_;
+    std::vector<SlotArray*> retired_slots_;
+    size_t num_entries_;
+    size_t num_tombstones_;
+
+    DISALLOW_COPY_AND_ASSIGN(Table);
+  };
 
   mirror::String* Insert(mirror::String* s, bool is_strong)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
 
-  mirror::String* Lookup(Table& table, mirror::String* s, uint32_t hash_code)
-      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
-  mirror::String* Insert(Table& table, mirror::String* s, uint32_t hash_code);
-  void Remove(Table& table, const mirror::String* s, uint32_t hash_code);
-
   mutable Mutex intern_table_lock_;
   bool is_dirty_ GUARDED_BY(intern_table_lock_);
-  bool allow_new_interns_ GUARDED_BY(intern_table_lock_);
+  // Written holding intern_table_lock_, read without it by the lookup fast path.
+  volatile bool allow_new_interns_;
   ConditionVariable new_intern_condition_ GUARDED_BY(intern_table_lock_);
-  Table strong_interns_ GUARDED_BY(intern_table_lock_);
-  Table weak_interns_ GUARDED_BY(intern_table_lock_);
+  Table strong_interns_;
+  Table weak_interns_;
 };
 
 }  // namespace art
@@ -167,4 +167,21 @@ TEST_F(InternTableTest, ContainsWeak) {
   }
 }
 
+TEST_F(InternTableTest, Grow) {
+  ScopedObjectAccess soa(Thread::Current());
+  InternTable t;
+  // Enough strings to make the table rehash a few times.
+  const size_t kNumStrings = 2000;
+  for (size_t i = 0; i < kNumStrings; ++i) {
+    t.InternStrong(StringPrintf("string %zd", i).c_str());
+  }
+  EXPECT_EQ(kNumStrings, t.Size());
+  for (size_t i = 0; i < kNumStrings; ++i) {
+    std::string utf8(StringPrintf("string %zd", i));
+    mirror::String* interned = t.InternStrong(utf8.c_str());
+    EXPECT_TRUE(interned->Equals(utf8.c_str()));
+  }
+  EXPECT_EQ(kNumStrings, t.Size());
+}
+
 }  // namespace art
@@ -0,0 +1,680 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "decoded_code.h"
+
+#include "base/logging.h"
+#include "cutils/atomic-inline.h"
+#include "dex_instruction-inl.h"
+#include "stack.h"
+#include "thread.h"
+
+namespace art {
+namespace interpreter {
+
+DecodedCode::DecodedCode(const DexFile::CodeItem* code_item) {
+  const uint32_t insns_size = code_item->insns_size_in_code_units_;
+  DecodedInstruction not_decoded;
+  memset(&not_decoded, 0, sizeof(not_decoded));
+  not_decoded.operation = kNotDecoded;
+  instructions_.resize(insns_size, not_decoded);
+  for (uint32_t dex_pc = 0; dex_pc < insns_size; ) {
+    const Instruction* inst = Instruction::At(code_item->insns_ + dex_pc);
+    // Switch and array payloads read as NOPs, which aren't decoded.
+    if (IsDecodedOpcode(inst->Opcode())) {
+      instructions_[dex_pc] = Decode(inst, dex_pc);
+    }
+    dex_pc += inst->SizeInCodeUnits();
+  }
+}
+
+DecodedCode::DecodedInstruction DecodedCode::Decode(const Instruction* inst, uint32_t dex_pc) {
+  DecodedInstruction d;
+  memset(&d, 0, sizeof(d));
+  d.next_dex_pc = dex_pc + inst->SizeInCodeUnits();
+  switch (inst->Opcode()) {
+    case Instruction::MOVE:
+    case Instruction::MOVE_WIDE:
+    case Instruction::MOVE_OBJECT:
+      d.a = inst->VRegA_12x();
+      d.b = inst->VRegB_12x();
+      break;
+    case Instruction::MOVE_FROM16:
+    case Instruction::MOVE_WIDE_FROM16:
+    case Instruction::MOVE_OBJECT_FROM16:
+      d.a = inst->VRegA_22x();
+      d.b = inst->VRegB_22x();
+      break;
+    case Instruction::MOVE_16:
+    case Instruction::MOVE_WIDE_16:
+    case Instruction::MOVE_OBJECT_16:
+      d.a = inst->VRegA_32x();
+      d.b = inst->VRegB_32x();
+      break;
+    case Instruction::CONST_4:
+      d.a = inst->VRegA_11n();
+      d.literal = inst->VRegB_11n();
+      break;
+    case Instruction::CONST_16:
+    case Instruction::CONST_WIDE_16:
+      d.a = inst->VRegA_21s();
+      d.literal = inst->VRegB_21s();
+      break;
+    case Instruction::CONST:
+    case Instruction::CONST_WIDE_32:
+      d.a = inst->VRegA_31i();
+      d.literal = inst->VRegB_31i();
+      break;
+    case Instruction::CONST_HIGH16:
+      d.a = inst->VRegA_21h();
+      d.literal = static_cast<int32_t>(inst->VRegB_21h() << 16);
+      break;
+    case Instruction::CONST_WIDE:
+      d.a = inst->VRegA_51l();
+      d.literal = inst->VRegB_51l();
+      break;
+    case Instruction::CONST_WIDE_HIGH16:
+      d.a = inst->VRegA_21h();
+      d.literal = static_cast<uint64_t>(inst->VRegB_21h()) << 48;
+      break;
+    case Instruction::GOTO:
+      d.target_dex_pc = dex_pc + inst->VRegA_10t();
+      break;
+    case Instruction::GOTO_16:
+      d.target_dex_pc = dex_pc + inst->VRegA_20t();
+      break;
+    case Instruction::GOTO_32:
+      d.target_dex_pc = dex_pc + inst->VRegA_30t();
+      break;
+    case Instruction::IF_EQ:
+    case Instruction::IF_NE:
+    case Instruction::IF_LT:
+    case Instruction::IF_GE:
+    case Instruction::IF_GT:
+    case Instruction::IF_LE:
+      d.a = inst->VRegA_22t();
+      d.b = inst->VRegB_22t();
+      d.target_dex_pc = dex_pc + inst->VRegC_22t();
+      break;
+    case Instruction::IF_EQZ:
+    case Instruction::IF_NEZ:
+    case Instruction::IF_LTZ:
+    case Instruction::IF_GEZ:
+    case Instruction::IF_GTZ:
+    case Instruction::IF_LEZ:
+      d.a = inst->VRegA_21t();
+      d.target_dex_pc = dex_pc + inst->VRegB_21t();
+      break;
+    case Instruction::NEG_INT:
+    case Instruction::NOT_INT:
+    case Instruction::NEG_LONG:
+    case Instruction::NOT_LONG:
+    case Instruction::INT_TO_LONG:
+    case Instruction::LONG_TO_INT:
+    case Instruction::INT_TO_BYTE:
+    case Instruction::INT_TO_CHAR:
+    case Instruction::INT_TO_SHORT:
+      d.a = inst->VRegA_12x();
+      d.b = inst->VRegB_12x();
+      break;
+    case Instruction::ADD_INT_2ADDR:
+    case Instruction::SUB_INT_2ADDR:
+    case Instruction::MUL_INT_2ADDR:
+    case Instruction::AND_INT_2ADDR:
+    case Instruction::OR_INT_2ADDR:
+    case Instruction::XOR_INT_2ADDR:
+    case Instruction::SHL_INT_2ADDR:
+    case Instruction::SHR_INT_2ADDR:
+    case Instruction::USHR_INT_2ADDR:
+    case Instruction::ADD_LONG_2ADDR:
+    case Instruction::SUB_LONG_2ADDR:
+    case Instruction::MUL_LONG_2ADDR:
+    case Instruction::AND_LONG_2ADDR:
+    case Instruction::OR_LONG_2ADDR:
+    case Instruction::XOR_LONG_2ADDR:
+    case Instruction::SHL_LONG_2ADDR:
+    case Instruction::SHR_LONG_2ADDR:
+    case Instruction::USHR_LONG_2ADDR:
+    case Instruction::ADD_FLOAT_2ADDR:
+    case Instruction::SUB_FLOAT_2ADDR:
+    case Instruction::MUL_FLOAT_2ADDR:
+    case Instruction::ADD_DOUBLE_2ADDR:
+    case Instruction::SUB_DOUBLE_2ADDR:
+    case Instruction::MUL_DOUBLE_2ADDR:
+      d.a = inst->VRegA_12x();
+      d.b = inst->VRegA_12x();
+      d.c = inst->VRegB_12x();
+      break;
+    case Instruction::ADD_INT_LIT16:
+    case Instruction::RSUB_INT:
+    case Instruction::MUL_INT_LIT16:
+    case Instruction::AND_INT_LIT16:
+    case Instruction::OR_INT_LIT16:
+    case Instruction::XOR_INT_LIT16:
+      d.a = inst->VRegA_22s();
+      d.b = inst->VRegB_22s();
+      d.literal = inst->VRegC_22s();
+      break;
+    case Instruction::ADD_INT_LIT8:
+    case Instruction::RSUB_INT_LIT8:
+    case Instruction::MUL_INT_LIT8:
+    case Instruction::AND_INT_LIT8:
+    case Instruction::OR_INT_LIT8:
+    case Instruction::XOR_INT_LIT8:
+    case Instruction::SHL_INT_LIT8:
+    case Instruction::SHR_INT_LIT8:
+    case Instruction::USHR_INT_LIT8:
+      d.a = inst->VRegA_22b();
+      d.b = inst->VRegB_22b();
+      d.literal = inst->VRegC_22b();
+      break;
+    default:
+      // The remaining decoded instructions are all 23x.
+      d.a = inst->VRegA_23x();
+      d.b = inst->VRegB_23x();
+      d.c = inst->VRegC_23x();
+      break;
+  }
+  switch (inst->Opcode()) {
+    case Instruction::MOVE:
+    case Instruction::MOVE_FROM16:
+    case Instruction::MOVE_16:
+      d.operation = kMove;
+      break;
+    case Instruction::MOVE_WIDE:
+    case Instruction::MOVE_WIDE_FROM16:
+    case Instruction::MOVE_WIDE_16:
+      d.operation = kMoveWide;
+      break;
+    case Instruction::MOVE_OBJECT:
+    case Instruction::MOVE_OBJECT_FROM16:
+    case Instruction::MOVE_OBJECT_16:
+      d.operation = kMoveObject;
+      break;
+    case Instruction::CONST_4:
+    case Instruction::CONST_16:
+    case Instruction::CONST:
+    case Instruction::CONST_HIGH16:
+      d.operation = kConst;
+      break;
+    case Instruction::CONST_WIDE_16:
+    case Instruction::CONST_WIDE_32:
+    case Instruction::CONST_WIDE:
+    case Instruction::CONST_WIDE_HIGH16:
+      d.operation = kConstWide;
+      break;
+    case Instruction::GOTO:
+    case Instruction::GOTO_16:
+    case Instruction::GOTO_32:
+      d.operation = kGoto;
+      break;
+    case Instruction::IF_EQ: d.operation = kIfEq; break;
+    case Instruction::IF_NE: d.operation = kIfNe; break;
+    case Instruction::IF_LT: d.operation = kIfLt; break;
+    case Instruction::IF_GE: d.operation = kIfGe; break;
+    case Instruction::IF_GT: d.operation = kIfGt; break;
+    case Instruction::IF_LE: d.operation = kIfLe; break;
+    case Instruction::IF_EQZ: d.operation = kIfEqz; break;
+    case Instruction::IF_NEZ: d.operation = kIfNez; break;
+    case Instruction::IF_LTZ: d.operation = kIfLtz; break;
+    case Instruction::IF_GEZ: d.operation = kIfGez; break;
+    case Instruction::IF_GTZ: d.operation = kIfGtz; break;
+    case Instruction::IF_LEZ: d.operation = kIfLez; break;
+    case Instruction::NEG_INT: d.operation = kNegInt; break;
+    case Instruction::NOT_INT: d.operation = kNotInt; break;
+    case Instruction::NEG_LONG: d.operation = kNegLong; break;
+    case Instruction::NOT_LONG: d.operation = kNotLong; break;
+    case Instruction::INT_TO_LONG: d.operation = kIntToLong; break;
+    case Instruction::LONG_TO_INT: d.operation = kLongToInt; break;
+    case Instruction::INT_TO_BYTE: d.operation = kIntToByte; break;
+    case Instruction::INT_TO_CHAR: d.operation = kIntToChar; break;
+    case Instruction::INT_TO_SHORT: d.operation = kIntToShort; break;
+    case Instruction::ADD_INT:
+    case Instruction::ADD_INT_2ADDR:
+      d.operation = kAddInt;
+      break;
+    case Instruction::SUB_INT:
+    case Instruction::SUB_INT_2ADDR:
+      d.operation = kSubInt;
+      break;
+    case Instruction::MUL_INT:
+    case Instruction::MUL_INT_2ADDR:
+      d.operation = kMulInt;
+      break;
+    case Instruction::AND_INT:
+    case Instruction::AND_INT_2ADDR:
+      d.operation = kAndInt;
+      break;
+    case Instruction::OR_INT:
+    case Instruction::OR_INT_2ADDR:
+      d.operation = kOrInt;
+      break;
+    case Instruction::XOR_INT:
+    case Instruction::XOR_INT_2ADDR:
+      d.operation = kXorInt;
+      break;
+    case Instruction::SHL_INT:
+    case Instruction::SHL_INT_2ADDR:
+      d.operation = kShlInt;
+      break;
+    case Instruction::SHR_INT:
+    case Instruction::SHR_INT_2ADDR:
+      d.operation = kShrInt;
+      break;
+    case Instruction::USHR_INT:
+    case Instruction::USHR_INT_2ADDR:
+      d.operation = kUshrInt;
+      break;
+    case Instruction::ADD_LONG:
+    case Instruction::ADD_LONG_2ADDR:
+      d.operation = kAddLong;
+      break;
+    case Instruction::SUB_LONG:
+    case Instruction::SUB_LONG_2ADDR:
+      d.operation = kSubLong;
+      break;
+    case Instruction::MUL_LONG:
+    case Instruction::MUL_LONG_2ADDR:
+      d.operation = kMulLong;
+      break;
+    case Instruction::AND_LONG:
+    case Instruction::AND_LONG_2ADDR:
+      d.operation = kAndLong;
+      break;
+    case Instruction::OR_LONG:
+    case Instruction::OR_LONG_2ADDR:
+      d.operation = kOrLong;
+      break;
+    case Instruction::XOR_LONG:
+    case Instruction::XOR_LONG_2ADDR:
+      d.operation = kXorLong;
+      break;
+    case Instruction::SHL_LONG:
+    case Instruction::SHL_LONG_2ADDR:
+      d.operation = kShlLong;
+      break;
+    case Instruction::SHR_LONG:
+    case Instruction::SHR_LONG_2ADDR:
+      d.operation = kShrLong;
+      break;
+    case Instruction::USHR_LONG:
+    case Instruction::USHR_LONG_2ADDR:
+      d.operation = kUshrLong;
+      break;
+    case Instruction::ADD_FLOAT:
+    case Instruction::ADD_FLOAT_2ADDR:
+      d.operation = kAddFloat;
+      break;
+    case Instruction::SUB_FLOAT:
+    case Instruction::SUB_FLOAT_2ADDR:
+      d.operation = kSubFloat;
+      break;
+    case Instruction::MUL_FLOAT:
+    case Instruction::MUL_FLOAT_2ADDR:
+      d.operation = kMulFloat;
+      break;
+    case Instruction::ADD_DOUBLE:
+    case Instruction::ADD_DOUBLE_2ADDR:
+      d.operation = kAddDouble;
+      break;
+    case Instruction::SUB_DOUBLE:
+    case Instruction::SUB_DOUBLE_2ADDR:
+      d.operation = kSubDouble;
+      break;
+    case Instruction::MUL_DOUBLE:
+    case Instruction::MUL_DOUBLE_2ADDR:
+      d.operation = kMulDouble;
+      break;
+    case Instruction::ADD_INT_LIT16:
+    case Instruction::ADD_INT_LIT8:
+      d.operation = kAddIntLit;
+      break;
+    case Instruction::RSUB_INT:
+    case Instruction::RSUB_INT_LIT8:
+      d.operation = kRsubIntLit;
+      break;
+    case Instruction::MUL_INT_LIT16:
+    case Instruction::MUL_INT_LIT8:
+      d.operation = kMulIntLit;
+      break;
+    case Instruction::AND_INT_LIT16:
+    case Instruction::AND_INT_LIT8:
+      d.operation = kAndIntLit;
+      break;
+    case Instruction::OR_INT_LIT16:
+    case Instruction::OR_INT_LIT8:
+      d.operation = kOrIntLit;
+      break;
+    case Instruction::XOR_INT_LIT16:
+    case Instruction::XOR_INT_LIT8:
+      d.operation = kXorIntLit;
+      break;
+    case Instruction::SHL_INT_LIT8: d.operation = kShlIntLit; break;
+    case Instruction::SHR_INT_LIT8: d.operation = kShrIntLit; break;
+    case Instruction::USHR_INT_LIT8: d.operation = kUshrIntLit; break;
+    default:
+      LOG(FATAL) << "Unexpected opcode " << inst->Opcode();
+      break;
+  }
+  return d;
+}
+
+uint32_t DecodedCode::Run(Thread* self, ShadowFrame& shadow_frame, uint32_t dex_pc) const {
+  DCHECK_NE(instructions_[dex_pc].operation, kNotDecoded);
+  for (;;) {
+    const DecodedInstruction& d = instructions_[dex_pc];
+    uint32_t next_dex_pc = d.next_dex_pc;
+    bool taken = false;
+    switch (d.operation) {
+      case kNotDecoded:
+        return dex_pc;
+      case kMove:
+        shadow_frame.SetVReg(d.a, shadow_frame.GetVReg(d.b));
+        break;
+      case kMoveWide:
+        shadow_frame.SetVRegLong(d.a, shadow_frame.GetVRegLong(d.b));
+        break;
+      case kMoveObject:
+        shadow_frame.SetVRegReference(d.a, shadow_frame.GetVRegReference(d.b));
+        break;
+      case kConst:
+        shadow_frame.SetVReg(d.a, d.literal);
+        if (d.literal == 0) {
+          shadow_frame.SetVRegReference(d.a, NULL);
+        }
+        break;
+      case kConstWide:
+        shadow_frame.SetVRegLong(d.a, d.literal);
+        break;
+      case kGoto:
+        taken = true;
+        break;
+      case kIfEq:
+        taken = shadow_frame.GetVReg(d.a) == shadow_frame.GetVReg(d.b);
+        break;
+      case kIfNe:
+        taken = shadow_frame.GetVReg(d.a) != shadow_frame.GetVReg(d.b);
+        break;
+      case kIfLt:
+        taken = shadow_frame.GetVReg(d.a) < shadow_frame.GetVReg(d.b);
+        break;
+      case kIfGe:
+        taken = shadow_frame.GetVReg(d.a) >= shadow_frame.GetVReg(d.b);
+        break;
+      case kIfGt:
+        taken = shadow_frame.GetVReg(d.a) > shadow_frame.GetVReg(d.b);
+        break;
+      case kIfLe:
+        taken = shadow_frame.GetVReg(d.a) <= shadow_frame.GetVReg(d.b);
+        break;
+      case kIfEqz:
+        taken = shadow_frame.GetVReg(d.a) == 0;
+        break;
+      case kIfNez:
+        taken = shadow_frame.GetVReg(d.a) != 0;
+        break;
+      case kIfLtz:
+        taken = shadow_frame.GetVReg(d.a) < 0;
+        break;
+      case kIfGez:
+        taken = shadow_frame.GetVReg(d.a) >= 0;
+        break;
+      case kIfGtz:
+        taken = shadow_frame.GetVReg(d.a) > 0;
+        break;
+      case kIfLez:
+        taken = shadow_frame.GetVReg(d.a) <= 0;
+        break;
+      case kNegInt:
+        shadow_frame.SetVReg(d.a, -shadow_frame.GetVReg(d.b));
+        break;
+      case kNotInt:
+        shadow_frame.SetVReg(d.a, ~shadow_frame.GetVReg(d.b));
+        break;
+      case kNegLong:
+        shadow_frame.SetVRegLong(d.a, -shadow_frame.GetVRegLong(d.b));
+        break;
+      case kNotLong:
+        shadow_frame.SetVRegLong(d.a, ~shadow_frame.GetVRegLong(d.b));
+        break;
+      case kIntToLong:
+        shadow_frame.SetVRegLong(d.a, shadow_frame.GetVReg(d.b));
+        break;
+      case kLongToInt:
+        shadow_frame.SetVReg(d.a, shadow_frame.GetVRegLong(d.b));
+        break;
+      case kIntToByte:
+        shadow_frame.SetVReg(d.a, static_cast<int8_t>(shadow_frame.GetVReg(d.b)));
+        break;
+      case kIntToChar:
+        shadow_frame.SetVReg(d.a, static_cast<uint16_t>(shadow_frame.GetVReg(d.b)));
+        break;
+      case kIntToShort:
+        shadow_frame.SetVReg(d.a, static_cast<int16_t>(shadow_frame.GetVReg(d.b)));
+        break;
+      case kAddInt:
+        shadow_frame.SetVReg(d.a, shadow_frame.GetVReg(d.b) + shadow_frame.GetVReg(d.c));
+        break;
+      case kSubInt:
+        shadow_frame.SetVReg(d.a, shadow_frame.GetVReg(d.b) - shadow_frame.GetVReg(d.c));
+        break;
+      case kMulInt:
+        shadow_frame.SetVReg(d.a, shadow_frame.GetVReg(d.b) * shadow_frame.GetVReg(d.c));
+        break;
+      case kAndInt:
+        shadow_frame.SetVReg(d.a, shadow_frame.GetVReg(d.b) & shadow_frame.GetVReg(d.c));
+        break;
+      case kOrInt:
+        shadow_frame.SetVReg(d.a, shadow_frame.GetVReg(d.b) | shadow_frame.GetVReg(d.c));
+        break;
+      case kXorInt:
+        shadow_frame.SetVReg(d.a, shadow_frame.GetVReg(d.b) ^ shadow_frame.GetVReg(d.c));
+        break;
+      case kShlInt:
+        shadow_frame.SetVReg(d.a,
+                             shadow_frame.GetVReg(d.b) << (shadow_frame.GetVReg(d.c) & 0x1f));
+        break;
+      case kShrInt:
+        shadow_frame.SetVReg(d.a,
+                             shadow_frame.GetVReg(d.b) >> (shadow_frame.GetVReg(d.c) & 0x1f));
+        break;
+      case kUshrInt:
+        shadow_frame.SetVReg(d.a, static_cast<uint32_t>(shadow_frame.GetVReg(d.b)) >>
+                             (shadow_frame.GetVReg(d.c) & 0x1f));
+        break;
+      case kAddLong:
+        shadow_frame.SetVRegLong(d.a,
+                                 shadow_frame.GetVRegLong(d.b) + shadow_frame.GetVRegLong(d.c));
+        break;
+      case kSubLong:
+        shadow_frame.SetVRegLong(d.a,
+                                 shadow_frame.GetVRegLong(d.b) - shadow_frame.GetVRegLong(d.c));
+        break;
+      case kMulLong:
+        shadow_frame.SetVRegLong(d.a,
+                                 shadow_frame.GetVRegLong(d.b) * shadow_frame.GetVRegLong(d.c));
+        break;
+      case kAndLong:
+        shadow_frame.SetVRegLong(d.a,
+                                 shadow_frame.GetVRegLong(d.b) & shadow_frame.GetVRegLong(d.c));
+        break;
+      case kOrLong:
+        shadow_frame.SetVRegLong(d.a,
+                                 shadow_frame.GetVRegLong(d.b) | shadow_frame.GetVRegLong(d.c));
+        break;
+      case kXorLong:
+        shadow_frame.SetVRegLong(d.a,
+                                 shadow_frame.GetVRegLong(d.b) ^ shadow_frame.GetVRegLong(d.c));
+        break;
+      case kShlLong:
+        shadow_frame.SetVRegLong(d.a, shadow_frame.GetVRegLong(d.b) <<
+                                 (shadow_frame.GetVReg(d.c) & 0x3f));
+        break;
+      case kShrLong:
+        shadow_frame.SetVRegLong(d.a, shadow_frame.GetVRegLong(d.b) >>
+                                 (shadow_frame.GetVReg(d.c) & 0x3f));
+        break;
+      case kUshrLong:
+        shadow_frame.SetVRegLong(d.a, static_cast<uint64_t>(shadow_frame.GetVRegLong(d.b)) >>
+                                 (shadow_frame.GetVReg(d.c) & 0x3f));
+        break;
+      case kAddFloat:
+        shadow_frame.SetVRegFloat(d.a,
+                                  shadow_frame.GetVRegFloat(d.b) + shadow_frame.GetVRegFloat(d.c));
+        break;
+      case kSubFloat:
+        shadow_frame.SetVRegFloat(d.a,
+                                  shadow_frame.GetVRegFloat(d.b) - shadow_frame.GetVRegFloat(d.c));
+        break;
+      case kMulFloat:
+        shadow_frame.SetVRegFloat(d.a,
+                                  shadow_frame.GetVRegFloat(d.b) * shadow_frame.GetVRegFloat(d.c));
+        break;
+      case kAddDouble:
+        shadow_frame.SetVRegDouble(d.a, shadow_frame.GetVRegDouble(d.b) +
+                                   shadow_frame.GetVRegDouble(d.c));
+        break;
+      case kSubDouble:
+        shadow_frame.SetVRegDouble(d.a, shadow_frame.GetVRegDouble(d.b) -
+                                   shadow_frame.GetVRegDouble(d.c));
+        break;
+      case kMulDouble:
+        shadow_frame.SetVRegDouble(d.a, shadow_frame.GetVRegDouble(d.b) *
+                                   shadow_frame.GetVRegDouble(d.c));
+        break;
+      case kAddIntLit:
+        shadow_frame.SetVReg(d.a, shadow_frame.GetVReg(d.b) + d.literal);
+        break;
+      case kRsubIntLit:
+        shadow_frame.SetVReg(d.a, d.literal - shadow_frame.GetVReg(d.b));
+        break;
+      case kMulIntLit:
+        shadow_frame.SetVReg(d.a, shadow_frame.GetVReg(d.b) * d.literal);
+        break;
+      case kAndIntLit:
+        shadow_frame.SetVReg(d.a, shadow_frame.GetVReg(d.b) & d.literal);
+        break;
+      case kOrIntLit:
+        shadow_frame.SetVReg(d.a, shadow_frame.GetVReg(d.b) | d.literal);
+        break;
+      case kXorIntLit:
+        shadow_frame.SetVReg(d.a, shadow_frame.GetVReg(d.b) ^ d.literal);
+        break;
+      case kShlIntLit:
+        shadow_frame.SetVReg(d.a, shadow_frame.GetVReg(d.b) << (d.literal & 0x1f));
+        break;
+      case kShrIntLit:
+        shadow_frame.SetVReg(d.a, shadow_frame.GetVReg(d.b) >> (d.literal & 0x1f));
+        break;
+      case kUshrIntLit:
+        shadow_frame.SetVReg(d.a, static_cast<uint32_t>(shadow_frame.GetVReg(d.b)) >>
+                             (d.literal & 0x1f));
+        break;
+    }
+    if (taken) {
+      next_dex_pc = d.target_dex_pc;
+      if (next_dex_pc <= dex_pc && UNLIKELY(self->TestAllFlags())) {
+        return next_dex_pc;
+      }
+    }
+    dex_pc = next_dex_pc;
+  }
+}
+
+DecodedCodeCache::DecodedCodeCache(size_t threshold)
+    : threshold_(threshold),
+      lock_("decoded code cache lock"),
+      num_dex_files_(0) {
+  DCHECK_NE(threshold, 0U);
+}
+
+DecodedCodeCache::~DecodedCodeCache() {
+  for (int32_t i = 0; i < num_dex_files_; ++i) {
+    std::vector<Slot>& slots = dex_files_[i]->slots;
+    for (size_t j = 0; j < slots.size(); ++j) {
+      delete slots[j].code;
+    }
+    delete dex_files_[i];
+  }
+}
+
+const DecodedCode* DecodedCodeCache::Get(const DexFile& dex_file, uint32_t method_idx,
+                                         const DexFile::CodeItem* code_item, bool count) {
+  Slot* slot = FindSlot(dex_file, method_idx);
+  if (UNLIKELY(slot == NULL)) {
+    slot = AddDexFile(dex_file, method_idx);
+    if (slot == NULL) {
+      return NULL;
+    }
+  }
+  const DecodedCode* code = slot->code;
+  if (LIKELY(code != NULL) || !count) {
+    return code;
+  }
+  if (++slot->invocations < threshold_) {
+    return NULL;
+  }
+  return Publish(slot, new DecodedCode(code_item));
+}
+
+DecodedCodeCache::Slot* DecodedCodeCache::FindSlot(const DexFile& dex_file, uint32_t method_idx) {
+  // Dex files are only ever added, so a stale count misses at most the latest ones.
+  const int32_t num_dex_files = android_atomic_acquire_load(&num_dex_files_);
+  for (int32_t i = 0; i < num_dex_files; ++i) {
+    DexFileSlots* dex_file_slots = dex_files_[i];
+    // Also check the checksum, in case a closed dex file's DexFile got reused for another one.
+    if (dex_file_slots->dex_file == &dex_file &&
+        dex_file_slots->checksum == dex_file.GetLocationChecksum()) {
+      DCHECK_LT(method_idx, dex_file_slots->slots.size());
+      return &dex_file_slots->slots[method_idx];
+    }
+  }
+  return NULL;
+}
+
+DecodedCodeCache::Slot* DecodedCodeCache::AddDexFile(const DexFile& dex_file,
+                                                     uint32_t method_idx) {
+  MutexLock mu(Thread::Current(), lock_);
+  // Another thread may have added the dex file while we were waiting for the lock.
+  Slot* slot = FindSlot(dex_file, method_idx);
+  if (slot != NULL || num_dex_files_ == static_cast<int32_t>(kMaxDexFiles)) {
+    return slot;
+  }
+  DexFileSlots* dex_file_slots = new DexFileSlots;
+  dex_file_slots->dex_file = &dex_file;
+  dex_file_slots->checksum = dex_file.GetLocationChecksum();
+  Slot empty = { 0, NULL };
+  dex_file_slots->slots.resize(dex_file.NumMethodIds(), empty);
+  dex_files_[num_dex_files_] = dex_file_slots;
+  android_atomic_release_store(num_dex_files_ + 1, &num_dex_files_);
+  return &dex_file_slots->slots[method_idx];
+}
+
+const DecodedCode* DecodedCodeCache::Publish(Slot* slot, const DecodedCode* code) {
+  MutexLock mu(Thread::Current(), lock_);
+  // Threads reaching the threshold together both decode the method, the first one wins.
+  if (slot->code != NULL) {
+    delete code;
+    return slot->code;
+  }
+  // Readers go through the pointer, so the code must be visible before it.
+  ANDROID_MEMBAR_STORE();
+  slot->code = code;
+  return code;
+}
+
+}  // namespace interpreter
+}  // namespace art
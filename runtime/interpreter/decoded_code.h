@@ -0,0 +1,170 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ART_RUNTIME_INTERPRETER_DECODED_CODE_H_
+#define ART_RUNTIME_INTERPRETER_DECODED_CODE_H_
+
+#include <vector>
+
+#include "base/macros.h"
+#include "base/mutex.h"
+#include "dex_file.h"
+#include "dex_instruction.h"
+
+namespace art {
+
+class ShadowFrame;
+class Thread;
+
+namespace interpreter {
+
+// The instructions DecodedCode runs: moves, constants, branches and the arithmetic that can't
+// throw. None of them calls, allocates, throws or reads the heap.
+#define DECODED_INSTRUCTION_LIST(V) \
+  V(MOVE) V(MOVE_FROM16) V(MOVE_16) V(MOVE_WIDE) V(MOVE_WIDE_FROM16) V(MOVE_WIDE_16) \
+  V(MOVE_OBJECT) V(MOVE_OBJECT_FROM16) V(MOVE_OBJECT_16) \
+  V(CONST_4) V(CONST_16) V(CONST) V(CONST_HIGH16) \
+  V(CONST_WIDE_16) V(CONST_WIDE_32) V(CONST_WIDE) V(CONST_WIDE_HIGH16) \
+  V(GOTO) V(GOTO_16) V(GOTO_32) \
+  V(IF_EQ) V(IF_NE) V(IF_LT) V(IF_GE) V(IF_GT) V(IF_LE) \
+  V(IF_EQZ) V(IF_NEZ) V(IF_LTZ) V(IF_GEZ) V(IF_GTZ) V(IF_LEZ) \
+  V(NEG_INT) V(NOT_INT) V(NEG_LONG) V(NOT_LONG) V(INT_TO_LONG) V(LONG_TO_INT) \
+  V(INT_TO_BYTE) V(INT_TO_CHAR) V(INT_TO_SHORT) \
+  V(ADD_INT) V(SUB_INT) V(MUL_INT) V(AND_INT) V(OR_INT) V(XOR_INT) \
+  V(SHL_INT) V(SHR_INT) V(USHR_INT) \
+  V(ADD_LONG) V(SUB_LONG) V(MUL_LONG) V(AND_LONG) V(OR_LONG) V(XOR_LONG) \
+  V(SHL_LONG) V(SHR_LONG) V(USHR_LONG) \
+  V(ADD_FLOAT) V(SUB_FLOAT) V(MUL_FLOAT) V(ADD_DOUBLE) V(SUB_DOUBLE) V(MUL_DOUBLE) \
+  V(ADD_INT_2ADDR) V(SUB_INT_2ADDR) V(MUL_INT_2ADDR) V(AND_INT_2ADDR) V(OR_INT_2ADDR) \
+  V(XOR_INT_2ADDR) V(SHL_INT_2ADDR) V(SHR_INT_2ADDR) V(USHR_INT_2ADDR) \
+  V(ADD_LONG_2ADDR) V(SUB_LONG_2ADDR) V(MUL_LONG_2ADDR) V(AND_LONG_2ADDR) V(OR_LONG_2ADDR) \
+  V(XOR_LONG_2ADDR) V(SHL_LONG_2ADDR) V(SHR_LONG_2ADDR) V(USHR_LONG_2ADDR) \
+  V(ADD_FLOAT_2ADDR) V(SUB_FLOAT_2ADDR) V(MUL_FLOAT_2ADDR) \
+  V(ADD_DOUBLE_2ADDR) V(SUB_DOUBLE_2ADDR) V(MUL_DOUBLE_2ADDR) \
+  V(ADD_INT_LIT16) V(RSUB_INT) V(MUL_INT_LIT16) V(AND_INT_LIT16) V(OR_INT_LIT16) \
+  V(XOR_INT_LIT16) \
+  V(ADD_INT_LIT8) V(RSUB_INT_LIT8) V(MUL_INT_LIT8) V(AND_INT_LIT8) V(OR_INT_LIT8) \
+  V(XOR_INT_LIT8) V(SHL_INT_LIT8) V(SHR_INT_LIT8) V(USHR_INT_LIT8)
+
+#define DECODED_OPCODE_TEST(code) || opcode == Instruction::code
+static constexpr bool IsDecodedOpcode(Instruction::Code opcode) {
+  return false DECODED_INSTRUCTION_LIST(DECODED_OPCODE_TEST);
+}
+#undef DECODED_OPCODE_TEST
+
+// A method's DECODED_INSTRUCTION_LIST instructions, decoded once into fixed-width entries. The
+// operands are extracted, the 2addr and literal forms folded into a few operations, and the
+// branch targets resolved to dex pcs. The interpreter hands stretches of these instructions to
+// Run instead of decoding them from the dex code every time.
+class DecodedCode {
+ public:
+  explicit DecodedCode(const DexFile::CodeItem* code_item);
+
+  // Runs the decoded instructions from dex_pc, which must be one, up to the first instruction
+  // that isn't decoded, and returns its dex pc. Also returns after a backward branch when the
+  // thread has a pending suspend or checkpoint request, as the interpreter checks for them.
+  uint32_t Run(Thread* self, ShadowFrame& shadow_frame, uint32_t dex_pc) const
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
+ private:
+  enum Operation {
+    kNotDecoded,
+    kMove, kMoveWide, kMoveObject, kConst, kConstWide, kGoto,
+    // Compare vA with vB, or with 0 for the Z forms, and branch to target_dex_pc.
+    kIfEq, kIfNe, kIfLt, kIfGe, kIfGt, kIfLe,
+    kIfEqz, kIfNez, kIfLtz, kIfGez, kIfGtz, kIfLez,
+    // vA = op vB.
+    kNegInt, kNotInt, kNegLong, kNotLong, kIntToLong, kLongToInt,
+    kIntToByte, kIntToChar, kIntToShort,
+    // vA = vB op vC.
+    kAddInt, kSubInt, kMulInt, kAndInt, kOrInt, kXorInt, kShlInt, kShrInt, kUshrInt,
+    kAddLong, kSubLong, kMulLong, kAndLong, kOrLong, kXorLong, kShlLong, kShrLong, kUshrLong,
+    kAddFloat, kSubFloat, kMulFloat, kAddDouble, kSubDouble, kMulDouble,
+    // vA = vB op literal.
+    kAddIntLit, kRsubIntLit, kMulIntLit, kAndIntLit, kOrIntLit, kXorIntLit,
+    kShlIntLit, kShrIntLit, kUshrIntLit,
+  };
+
+  struct DecodedInstruction {
+    uint16_t operation;
+    uint16_t a;
+    uint16_t b;
+    uint16_t c;
+    uint32_t next_dex_pc;
+    uint32_t target_dex_pc;
+    int64_t literal;
+  };
+
+  static DecodedInstruction Decode(const Instruction* inst, uint32_t dex_pc);
+
+  // Indexed by dex pc, kNotDecoded for the code units that don't start a decoded instruction.
+  std::vector<DecodedInstruction> instructions_;
+
+  DISALLOW_COPY_AND_ASSIGN(DecodedCode);
+};
+
+// The decoded code of the methods invoked at least a threshold number of times. Enabled with
+// -Xinterpreter-decode-threshold:<count>. Invocations are counted racily, a lost count only
+// delays the decoding. The code of a method is never freed, like the dex file it comes from.
+class DecodedCodeCache {
+ public:
+  explicit DecodedCodeCache(size_t threshold);
+  ~DecodedCodeCache();
+
+  // Counts an invocation of the method if count is set, and returns its decoded code, NULL until
+  // the method was invoked threshold times.
+  const DecodedCode* Get(const DexFile& dex_file, uint32_t method_idx,
+                         const DexFile::CodeItem* code_item, bool count)
+      LOCKS_EXCLUDED(lock_);
+
+ private:
+  // Dex files beyond this many are not decoded.
+  static constexpr size_t kMaxDexFiles = 256;
+
+  struct Slot {
+    uint32_t invocations;
+    // Set once, after a store barrier, and then read without the lock.
+    const DecodedCode* volatile code;
+  };
+
+  struct DexFileSlots {
+    const DexFile* dex_file;
+    uint32_t checksum;
+    std::vector<Slot> slots;
+  };
+
+  // Lock free lookup of the dex files already added.
+  Slot* FindSlot(const DexFile& dex_file, uint32_t method_idx);
+
+  Slot* AddDexFile(const DexFile& dex_file, uint32_t method_idx) LOCKS_EXCLUDED(lock_);
+
+  const DecodedCode* Publish(Slot* slot, const DecodedCode* code) LOCKS_EXCLUDED(lock_);
+
+  const uint32_t threshold_;
+
+  Mutex lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
+
+  // Entries below num_dex_files_ never change and are read without the lock.
+  DexFileSlots* dex_files_[kMaxDexFiles];
+  volatile int32_t num_dex_files_;
+
+  DISALLOW_COPY_AND_ASSIGN(DecodedCodeCache);
+};
+
+}  // namespace interpreter
+}  // namespace art
+
+#endif  // ART_RUNTIME_INTERPRETER_DECODED_CODE_H_
@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "decoded_code.h"
+
+#include "common_test.h"
+#include "scoped_thread_state_change.h"
+#include "stack.h"
+#include "UniquePtr.h"
+
+namespace art {
+namespace interpreter {
+
+class DecodedCodeTest : public CommonTest {
+ protected:
+  // Returns a code item with the given instructions, in storage that code_item_storage_ owns.
+  const DexFile::CodeItem* MakeCodeItem(uint16_t registers_size, const uint16_t* insns,
+                                        size_t insns_size) {
+    size_t size = OFFSETOF_MEMBER(DexFile::CodeItem, insns_) + insns_size * sizeof(uint16_t);
+    code_item_storage_.reset(new uint8_t[size]);
+    memset(code_item_storage_.get(), 0, size);
+    DexFile::CodeItem* code_item = reinterpret_cast<DexFile::CodeItem*>(code_item_storage_.get());
+    code_item->registers_size_ = registers_size;
+    code_item->insns_size_in_code_units_ = insns_size;
+    memcpy(code_item->insns_, insns, insns_size * sizeof(uint16_t));
+    return code_item;
+  }
+
+  UniquePtr<uint8_t[]> code_item_storage_;
+};
+
+TEST_F(DecodedCodeTest, Opcodes) {
+  EXPECT_TRUE(IsDecodedOpcode(Instruction::ADD_INT_LIT8));
+  EXPECT_TRUE(IsDecodedOpcode(Instruction::IF_NEZ));
+  // These may throw, call or touch the heap.
+  EXPECT_FALSE(IsDecodedOpcode(Instruction::DIV_INT));
+  EXPECT_FALSE(IsDecodedOpcode(Instruction::AGET));
+  EXPECT_FALSE(IsDecodedOpcode(Instruction::INVOKE_STATIC));
+  EXPECT_FALSE(IsDecodedOpcode(Instruction::RETURN));
+}
+
+TEST_F(DecodedCodeTest, Loop) {
+  ScopedObjectAccess soa(Thread::Current());
+  // Sums 10 + 9 + ... + 1 into v0.
+  const uint16_t insns[] = {
+    0x0012,          // 0: const/4 v0, #0
+    0x0113, 0x000a,  // 1: const/16 v1, #10
+    0x10b0,          // 3: add-int/2addr v0, v1
+    0x01d8, 0xff01,  // 4: add-int/lit8 v1, v1, #-1
+    0x0139, 0xfffd,  // 6: if-nez v1, 3
+    0x000f,          // 8: return v0
+  };
+  const DexFile::CodeItem* code_item = MakeCodeItem(2, insns, arraysize(insns));
+  DecodedCode decoded_code(code_item);
+  UniquePtr<uint8_t[]> memory(new uint8_t[ShadowFrame::ComputeSize(2)]);
+  ShadowFrame* shadow_frame = ShadowFrame::Create(2, NULL, NULL, 0, memory.get());
+  // Runs up to the return, which isn't decoded.
+  EXPECT_EQ(8U, decoded_code.Run(soa.Self(), *shadow_frame, 0));
+  EXPECT_EQ(55, shadow_frame->GetVReg(0));
+  EXPECT_EQ(0, shadow_frame->GetVReg(1));
+}
+
+TEST_F(DecodedCodeTest, Wide) {
+  ScopedObjectAccess soa(Thread::Current());
+  const uint16_t insns[] = {
+    0x0019, 0x4000,  // 0: const-wide/high16 v0, #0x4000000000000000
+    0x0216, 0xffff,  // 2: const-wide/16 v2, #-1
+    0x20bb,          // 4: add-long/2addr v0, v2
+    0x0484, 0x0000,  // 5: long-to-int v4, v0 then nop, which isn't decoded
+  };
+  const DexFile::CodeItem* code_item = MakeCodeItem(5, insns, arraysize(insns));
+  DecodedCode decoded_code(code_item);
+  UniquePtr<uint8_t[]> memory(new uint8_t[ShadowFrame::ComputeSize(5)]);
+  ShadowFrame* shadow_frame = ShadowFrame::Create(5, NULL, NULL, 0, memory.get());
+  EXPECT_EQ(6U, decoded_code.Run(soa.Self(), *shadow_frame, 0));
+  EXPECT_EQ(INT64_C(0x3fffffffffffffff), shadow_frame->GetVRegLong(0));
+  EXPECT_EQ(-1, shadow_frame->GetVReg(4));
+}
+
+}  // namespace interpreter
+}  // namespace art
@@ -21,12 +21,15 @@
 #include "base/logging.h"
 #include "class_linker-inl.h"
 #include "common_throws.h"
+#include "decoded_code.h"
 #include "dex_file-inl.h"
 #include "dex_instruction-inl.h"
 #include "dex_instruction.h"
 #include "entrypoints/entrypoint_utils.h"
 #include "gc/accounting/card_table-inl.h"
 #include "invoke_arg_array_builder.h"
+#include "hot_method_compiler.h"
+#include "method_profile.h"
 #include "nth_caller_visitor.h"
 #include "mirror/art_field-inl.h"
 #include "mirror/art_method.h"
@@ -230,6 +233,15 @@ static void InterpreterJni(Thread* self, ArtMethod* method, StringPiece shorty,
   // TODO: The following enters JNI code using a typedef-ed function rather than the JNI compiler,
   //       it should be removed and JNI compiled stubs used instead.
   ScopedObjectAccessUnchecked soa(self);
+  if (!method->IsRegistered()) {
+    // Calls through the JNI stub bind native methods on their first call, do it here instead.
+    void* native_code = soa.Vm()->FindCodeForNativeMethod(method);
+    if (native_code == NULL) {
+      DCHECK(self->IsExceptionPending());
+      return;
+    }
+    method->RegisterNative(self, native_code);
+  }
   if (method->IsStatic()) {
     if (shorty == "L") {
       typedef jobject (fnptr)(JNIEnv*, jclass);
@@ -427,8 +439,31 @@ static bool DoInvoke(Thread* self, ShadowFrame& shadow_frame,
   uint32_t method_idx = (is_range) ? inst->VRegB_3rc() : inst->VRegB_35c();
   uint32_t vregC = (is_range) ? inst->VRegC_3rc() : inst->VRegC_35c();
   Object* receiver = (type == kStatic) ? NULL : shadow_frame.GetVRegReference(vregC);
-  ArtMethod* method = FindMethodFromCode(method_idx, receiver, shadow_frame.GetMethod(), self,
-                                         do_access_check, type);
+  // Direct and static invokes cache their target, virtual ones the method whose vtable index
+  // they dispatch on.
+  const bool use_cache = (type == kStatic) || (type == kDirect) || (type == kVirtual);
+  const ArtMethod* cached_method = use_cache ?
+      reinterpret_cast<const ArtMethod*>(self->LookupInterpreterCache(inst)) : NULL;
+  ArtMethod* method;
+  if (LIKELY(cached_method != NULL)) {
+    if (UNLIKELY(receiver == NULL && type != kStatic)) {
+      ThrowNullPointerExceptionForMethodAccess(shadow_frame.GetCurrentLocationForThrow(),
+                                               method_idx, type);
+      result->SetJ(0);
+      return false;
+    }
+    if (type == kVirtual) {
+      method = receiver->GetClass()->GetVTable()->Get(cached_method->GetMethodIndex());
+    } else {
+      method = const_cast<ArtMethod*>(cached_method);
+    }
+  } else {
+    method = FindMethodFromCode(method_idx, receiver, shadow_frame.GetMethod(), self,
+                                do_access_check, type);
+    if (use_cache && method != NULL) {
+      self->AddInterpreterCache(inst, method);
+    }
+  }
   if (UNLIKELY(method == NULL)) {
     CHECK(self->IsExceptionPending());
     result->SetJ(0);
@@ -523,14 +558,14 @@ static bool DoInvoke(Thread* self, ShadowFrame& shadow_frame,
 
 // TODO: should be SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) which is failing due to template
 // specialization.
-template<bool is_range>
-static bool DoInvokeVirtualQuick(Thread* self, ShadowFrame& shadow_frame,
-                                 const Instruction* inst, JValue* result)
+template<InvokeType type, bool is_range>
+static bool DoInvokeQuick(Thread* self, ShadowFrame& shadow_frame,
+                          const Instruction* inst, JValue* result)
     NO_THREAD_SAFETY_ANALYSIS;
 
-template<bool is_range>
-static bool DoInvokeVirtualQuick(Thread* self, ShadowFrame& shadow_frame,
-                                 const Instruction* inst, JValue* result) {
+template<InvokeType type, bool is_range>
+static bool DoInvokeQuick(Thread* self, ShadowFrame& shadow_frame,
+                          const Instruction* inst, JValue* result) {
   uint32_t vregC = (is_range) ? inst->VRegC_3rc() : inst->VRegC_35c();
   Object* receiver = shadow_frame.GetVRegReference(vregC);
   if (UNLIKELY(receiver == NULL)) {
@@ -541,7 +576,14 @@ static bool DoInvokeVirtualQuick(Thread* self, ShadowFrame& shadow_frame,
   }
   uint32_t vtable_idx = (is_range) ? inst->VRegB_3rc() : inst->VRegB_35c();
   // TODO: use ObjectArray<T>::GetWithoutChecks ?
-  ArtMethod* method = receiver->GetClass()->GetVTable()->Get(vtable_idx);
+  ArtMethod* method;
+  if (type == kSuper) {
+    // As invoke-super, dispatch in the vtable of the super class of the caller's class.
+    Class* super_class = shadow_frame.GetMethod()->GetDeclaringClass()->GetSuperClass();
+    method = super_class->GetVTable()->Get(vtable_idx);
+  } else {
+    method = receiver->GetClass()->GetVTable()->Get(vtable_idx);
+  }
   if (UNLIKELY(method == NULL)) {
     CHECK(self->IsExceptionPending());
     result->SetJ(0);
@@ -614,6 +656,35 @@ static bool DoInvokeVirtualQuick(Thread* self, ShadowFrame& shadow_frame,
   return !self->IsExceptionPending();
 }
 
+// Resolves the field of a field access instruction, using the thread's interpreter cache so that
+// only the first execution goes through FindFieldFromCode.
+// TODO: should be SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) which is failing due to template
+// specialization.
+template<FindFieldType find_type, Primitive::Type field_type, bool do_access_check>
+static ArtField* ResolveFieldAccess(Thread* self, const ShadowFrame& shadow_frame,
+                                    const Instruction* inst)
+    NO_THREAD_SAFETY_ANALYSIS ALWAYS_INLINE;
+
+template<FindFieldType find_type, Primitive::Type field_type, bool do_access_check>
+static inline ArtField* ResolveFieldAccess(Thread* self, const ShadowFrame& shadow_frame,
+                                           const Instruction* inst) {
+  ArtField* f = reinterpret_cast<ArtField*>(const_cast<void*>(self->LookupInterpreterCache(inst)));
+  if (LIKELY(f != NULL)) {
+    return f;
+  }
+  bool is_static = (find_type == StaticObjectRead) || (find_type == StaticPrimitiveRead) ||
+      (find_type == StaticObjectWrite) || (find_type == StaticPrimitiveWrite);
+  uint32_t field_idx = is_static ? inst->VRegB_21c() : inst->VRegC_22c();
+  f = FindFieldFromCode(field_idx, shadow_frame.GetMethod(), self, find_type,
+                        Primitive::FieldSize(field_type), do_access_check);
+  // Static fields are only cached once their class is initialized, until then every access has
+  // to go through the initialization check.
+  if (f != NULL && (!is_static || f->GetDeclaringClass()->IsInitialized())) {
+    self->AddInterpreterCache(inst, f);
+  }
+  return f;
+}
+
 // We use template functions to optimize compiler inlining process. Otherwise,
 // some parts of the code (like a switch statement) which depend on a constant
 // parameter would not be inlined while it should be. These constant parameters
@@ -631,10 +702,8 @@ template<FindFieldType find_type, Primitive::Type field_type, bool do_access_che
 static inline bool DoFieldGet(Thread* self, ShadowFrame& shadow_frame,
                               const Instruction* inst) {
   bool is_static = (find_type == StaticObjectRead) || (find_type == StaticPrimitiveRead);
-  uint32_t field_idx = is_static ? inst->VRegB_21c() : inst->VRegC_22c();
-  ArtField* f = FindFieldFromCode(field_idx, shadow_frame.GetMethod(), self,
-                                  find_type, Primitive::FieldSize(field_type),
-                                  do_access_check);
+  ArtField* f = ResolveFieldAccess<find_type, field_type, do_access_check>(self, shadow_frame,
+                                                                           inst);
   if (UNLIKELY(f == NULL)) {
     CHECK(self->IsExceptionPending());
     return false;
@@ -726,10 +795,8 @@ static inline bool DoFieldPut(Thread* self, const ShadowFrame& shadow_frame,
                               const Instruction* inst) {
   bool do_assignability_check = do_access_check;
   bool is_static = (find_type == StaticObjectWrite) || (find_type == StaticPrimitiveWrite);
-  uint32_t field_idx = is_static ? inst->VRegB_21c() : inst->VRegC_22c();
-  ArtField* f = FindFieldFromCode(field_idx, shadow_frame.GetMethod(), self,
-                                  find_type, Primitive::FieldSize(field_type),
-                                  do_access_check);
+  ArtField* f = ResolveFieldAccess<find_type, field_type, do_access_check>(self, shadow_frame,
+                                                                           inst);
   if (UNLIKELY(f == NULL)) {
     CHECK(self->IsExceptionPending());
     return false;
@@ -1023,8 +1090,8 @@ static inline const Instruction* FindNextInstructionFollowingException(Thread* s
   ThrowLocation throw_location;
   mirror::Throwable* exception = self->GetException(&throw_location);
   bool clear_exception;
-  uint32_t found_dex_pc = shadow_frame.GetMethod()->FindCatchBlock(exception->GetClass(), dex_pc,
-                                                                   &clear_exception);
+  uint32_t found_dex_pc = self->FindCatchBlock(shadow_frame.GetMethod(), exception->GetClass(),
+                                               dex_pc, &clear_exception);
   if (found_dex_pc == DexFile::kDexNoIndex) {
     instrumentation->MethodUnwindEvent(self, this_object_ref.get(),
                                        shadow_frame.GetMethod(), dex_pc);
@@ -1064,9 +1131,125 @@ static void UnexpectedOpcode(const Instruction* inst, MethodHelper& mh)
   exit(0);  // Unreachable, keep GCC happy.
 }
 
+// Set to true to log every instruction executed along with the vregs.
+static const bool kTracing = false;
+
+static void TraceExecution(const ShadowFrame& shadow_frame, const Instruction* inst,
+                           uint32_t dex_pc, MethodHelper& mh)
+    SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
+#define TRACE_LOG std::cerr
+  TRACE_LOG << PrettyMethod(shadow_frame.GetMethod())
+            << StringPrintf("\n0x%x: ", dex_pc)
+            << inst->DumpString(&mh.GetDexFile()) << "\n";
+  for (size_t i = 0; i < shadow_frame.NumberOfVRegs(); ++i) {
+    uint32_t raw_value = shadow_frame.GetVReg(i);
+    Object* ref_value = shadow_frame.GetVRegReference(i);
+    TRACE_LOG << StringPrintf(" vreg%d=0x%08X", i, raw_value);
+    if (ref_value != NULL) {
+      if (ref_value->GetClass()->IsStringClass() &&
+          ref_value->AsString()->GetCharArray() != NULL) {
+        TRACE_LOG << "/java.lang.String \"" << ref_value->AsString()->ToModifiedUtf8() << "\"";
+      } else {
+        TRACE_LOG << "/" << PrettyTypeOf(ref_value);
+      }
+    }
+  }
+  TRACE_LOG << "\n";
+#undef TRACE_LOG
+}
+
+// Handlers are labels reached through a computed goto on the next instruction's opcode.
+#define HANDLE_INSTRUCTION_START(opcode) op_##opcode:  // NOLINT(whitespace/labels)
+
+#define HANDLE_INSTRUCTION_END() \
+  do { \
+    dex_pc = inst->GetDexPc(insns); \
+    shadow_frame.SetDexPC(dex_pc); \
+    if (UNLIKELY(self->TestAllFlags())) { \
+      CheckSuspend(self); \
+      UPDATE_HANDLER_TABLE(); \
+    } \
+    goto *current_handlers[inst->Opcode()]; \
+  } while (false)
+
+// Listeners are only added with all threads suspended, and adding or removing dex pc listeners
+// raises kInstrumentationRequest on every thread, so the table needs to be picked again after a
+// suspend check or a call that may have consumed the request. Decoded code runs many
+// instructions per handler, so it is only used without the instrumentation.
+#define UPDATE_HANDLER_TABLE() \
+  current_handlers = (UNLIKELY(profile_counts != NULL || kTracing || \
+                               instrumentation->HasDexPcListeners())) ? \
+      instrumentation_handlers_table : \
+      (decoded_code != NULL ? decoded_handlers_table : handlers_table)
+
+// Hooks run before each dex instruction while the instrumentation table is in use.
+#define INSTRUMENTATION_PREAMBLE() \
+  do { \
+    if (profile_counts != NULL) { \
+      /* Moving backwards means we took a backward branch, or more rarely went to a handler. */ \
+      if (dex_pc < last_dex_pc) { \
+        ++profile_counts->backedges; \
+        if (UNLIKELY(hot_method_compiler != NULL) && \
+            CheckHotness(self, hot_method_compiler, *profile_counts, mh.GetMethod())) { \
+          JValue osr_result; \
+          if (TryOsr(self, hot_method_compiler, instrumentation, mh, code_item, shadow_frame, \
+                     dex_pc, &osr_result)) { \
+            return osr_result; \
+          } \
+        } \
+      } \
+      last_dex_pc = dex_pc; \
+    } \
+    if (UNLIKELY(instrumentation->HasDexPcListeners())) { \
+      instrumentation->DexPcMovedEvent(self, this_object_ref.get(), \
+                                       shadow_frame.GetMethod(), dex_pc); \
+    } \
+    if (kTracing) { \
+      TraceExecution(shadow_frame, inst, dex_pc, mh); \
+    } \
+  } while (false)
+
 // Code to run before each dex instruction.
 #define PREAMBLE()
 
+// Hands the method to the hot method compiler each time its counts reach another multiple of the
+// threshold, returning whether they did. Racing threads may skip a multiple, which only delays
+// the compilation. The current invocation keeps running in the interpreter unless it is in a
+// loop that TryOsr can move to compiled code.
+static inline bool CheckHotness(Thread* self, HotMethodCompiler* hot_method_compiler,
+                                const MethodProfile::Counts& counts, ArtMethod* method)
+    SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
+  const uint32_t total = counts.invocations + counts.backedges;
+  if (UNLIKELY(total % hot_method_compiler->GetThreshold() == 0)) {
+    hot_method_compiler->AddHotMethod(self, method);
+    return true;
+  }
+  return false;
+}
+
+// On-stack replacement: finishes the invocation in the method's compiled code, entered at the
+// loop header at dex_pc with the shadow frame's vregs, if the hot method compiler has code with
+// an entry there. Returns false to keep interpreting otherwise. Listeners expecting the
+// interpreter's method exit and dex pc events, and synchronized methods, whose monitor the
+// compiled code would not know about, stay in the interpreter.
+static bool TryOsr(Thread* self, HotMethodCompiler* hot_method_compiler,
+                   const instrumentation::Instrumentation* instrumentation, MethodHelper& mh,
+                   const DexFile::CodeItem* code_item, ShadowFrame& shadow_frame, uint32_t dex_pc,
+                   JValue* result)
+    SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
+  ArtMethod* method = shadow_frame.GetMethod();
+  if (instrumentation->HasMethodExitListeners() || instrumentation->HasDexPcListeners() ||
+      method->IsSynchronized() || !hot_method_compiler->HasOsrEntry(method, dex_pc)) {
+    return false;
+  }
+  VLOG(compiler) << "Entering " << PrettyMethod(method) << " at loop header 0x" << std::hex
+                 << dex_pc;
+  shadow_frame.SetDexPC(dex_pc);
+  self->SetOsrEntry(shadow_frame.GetVRegArgs(0), dex_pc);
+  artInterpreterToCompiledCodeBridge(self, mh, code_item, &shadow_frame, result);
+  return true;
+}
+
 // TODO: should be SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) which is failing due to template
 // specialization.
 template<bool do_access_check>
@@ -1090,2018 +1273,2101 @@ static JValue ExecuteImpl(Thread* self, MethodHelper& mh, const DexFile::CodeIte
   // garbage collector access it, we store it into sirt references.
   SirtRef<Object> this_object_ref(self, shadow_frame.GetThisObject(code_item->ins_size_));
 
+  // Invocation and backedge counts, when the runtime is recording a method profile.
+  MethodProfile* const method_profile = Runtime::Current()->GetMethodProfile();
+  HotMethodCompiler* const hot_method_compiler = Runtime::Current()->GetHotMethodCompiler();
+  MethodProfile::Counts* profile_counts = NULL;
+  if (UNLIKELY(method_profile != NULL)) {
+    profile_counts = method_profile->GetCounts(mh.GetDexFile(),
+                                               mh.GetMethod()->GetDexMethodIndex());
+  }
+
   uint32_t dex_pc = shadow_frame.GetDexPC();
   if (LIKELY(dex_pc == 0)) {  // We are entering the method as opposed to deoptimizing..
     if (UNLIKELY(instrumentation->HasMethodEntryListeners())) {
       instrumentation->MethodEnterEvent(self, this_object_ref.get(),
                                         shadow_frame.GetMethod(), 0);
     }
+    if (UNLIKELY(profile_counts != NULL)) {
+      ++profile_counts->invocations;
+      if (UNLIKELY(hot_method_compiler != NULL)) {
+        CheckHotness(self, hot_method_compiler, *profile_counts, mh.GetMethod());
+      }
+    }
+  }
+  // The pre-decoded form of the method once it has been invoked often enough.
+  DecodedCodeCache* const decoded_code_cache = Runtime::Current()->GetDecodedCodeCache();
+  const DecodedCode* decoded_code = NULL;
+  if (UNLIKELY(decoded_code_cache != NULL)) {
+    decoded_code = decoded_code_cache->Get(mh.GetDexFile(), mh.GetMethod()->GetDexMethodIndex(),
+                                           code_item, dex_pc == 0);
   }
   const uint16_t* const insns = code_item->insns_;
   const Instruction* inst = Instruction::At(insns + dex_pc);
-  while (true) {
-    dex_pc = inst->GetDexPc(insns);
-    shadow_frame.SetDexPC(dex_pc);
-    if (UNLIKELY(self->TestAllFlags())) {
-      CheckSuspend(self);
-    }
-    if (UNLIKELY(instrumentation->HasDexPcListeners())) {
-      instrumentation->DexPcMovedEvent(self, this_object_ref.get(),
-                                       shadow_frame.GetMethod(), dex_pc);
+  uint32_t last_dex_pc = dex_pc;
+
+  // Every handler ends by jumping straight to the handler of the next instruction. The
+  // instrumentation table routes each instruction through the profiling, DexPcMovedEvent and
+  // tracing hooks first, so they cost nothing when nobody listens.
+  static const void* const handlers_table[kNumPackedOpcodes] = {
+#define INSTRUCTION_HANDLER(o, code, n, f, r, i, a, v) &&op_##code,
+#include "dex_instruction_list.h"
+    DEX_INSTRUCTION_LIST(INSTRUCTION_HANDLER)
+#undef DEX_INSTRUCTION_LIST
+#undef INSTRUCTION_HANDLER
+  };
+  static const void* const instrumentation_handlers_table[kNumPackedOpcodes] = {
+#define INSTRUCTION_HANDLER(o, code, n, f, r, i, a, v) &&instrumentation_op_##code,
+#include "dex_instruction_list.h"
+    DEX_INSTRUCTION_LIST(INSTRUCTION_HANDLER)
+#undef DEX_INSTRUCTION_LIST
+#undef INSTRUCTION_HANDLER
+  };
+  // The handlers table, but with the decoded instructions going to decoded_run.
+  static const void* const decoded_handlers_table[kNumPackedOpcodes] = {
+#define INSTRUCTION_HANDLER(o, code, n, f, r, i, a, v) \
+    IsDecodedOpcode(Instruction::code) ? &&decoded_run : &&op_##code,
+#include "dex_instruction_list.h"
+    DEX_INSTRUCTION_LIST(INSTRUCTION_HANDLER)
+#undef DEX_INSTRUCTION_LIST
+#undef INSTRUCTION_HANDLER
+  };
+  const void* const* current_handlers;
+  UPDATE_HANDLER_TABLE();
+  HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(NOP)
+    PREAMBLE();
+    inst = inst->Next_1xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(MOVE)
+    PREAMBLE();
+    shadow_frame.SetVReg(inst->VRegA_12x(),
+                         shadow_frame.GetVReg(inst->VRegB_12x()));
+    inst = inst->Next_1xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(MOVE_FROM16)
+    PREAMBLE();
+    shadow_frame.SetVReg(inst->VRegA_22x(),
+                         shadow_frame.GetVReg(inst->VRegB_22x()));
+    inst = inst->Next_2xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(MOVE_16)
+    PREAMBLE();
+    shadow_frame.SetVReg(inst->VRegA_32x(),
+                         shadow_frame.GetVReg(inst->VRegB_32x()));
+    inst = inst->Next_3xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(MOVE_WIDE)
+    PREAMBLE();
+    shadow_frame.SetVRegLong(inst->VRegA_12x(),
+                             shadow_frame.GetVRegLong(inst->VRegB_12x()));
+    inst = inst->Next_1xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(MOVE_WIDE_FROM16)
+    PREAMBLE();
+    shadow_frame.SetVRegLong(inst->VRegA_22x(),
+                             shadow_frame.GetVRegLong(inst->VRegB_22x()));
+    inst = inst->Next_2xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(MOVE_WIDE_16)
+    PREAMBLE();
+    shadow_frame.SetVRegLong(inst->VRegA_32x(),
+                             shadow_frame.GetVRegLong(inst->VRegB_32x()));
+    inst = inst->Next_3xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(MOVE_OBJECT)
+    PREAMBLE();
+    shadow_frame.SetVRegReference(inst->VRegA_12x(),
+                                  shadow_frame.GetVRegReference(inst->VRegB_12x()));
+    inst = inst->Next_1xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(MOVE_OBJECT_FROM16)
+    PREAMBLE();
+    shadow_frame.SetVRegReference(inst->VRegA_22x(),
+                                  shadow_frame.GetVRegReference(inst->VRegB_22x()));
+    inst = inst->Next_2xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(MOVE_OBJECT_16)
+    PREAMBLE();
+    shadow_frame.SetVRegReference(inst->VRegA_32x(),
+                                  shadow_frame.GetVRegReference(inst->VRegB_32x()));
+    inst = inst->Next_3xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(MOVE_RESULT)
+    PREAMBLE();
+    shadow_frame.SetVReg(inst->VRegA_11x(), result_register.GetI());
+    inst = inst->Next_1xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(MOVE_RESULT_WIDE)
+    PREAMBLE();
+    shadow_frame.SetVRegLong(inst->VRegA_11x(), result_register.GetJ());
+    inst = inst->Next_1xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(MOVE_RESULT_OBJECT)
+    PREAMBLE();
+    shadow_frame.SetVRegReference(inst->VRegA_11x(), result_register.GetL());
+    inst = inst->Next_1xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(MOVE_EXCEPTION) {
+    PREAMBLE();
+    Throwable* exception = self->GetException(NULL);
+    self->ClearException();
+    shadow_frame.SetVRegReference(inst->VRegA_11x(), exception);
+    inst = inst->Next_1xx();
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(RETURN_VOID) {
+    PREAMBLE();
+    JValue result;
+    if (UNLIKELY(instrumentation->HasMethodExitListeners())) {
+      instrumentation->MethodExitEvent(self, this_object_ref.get(),
+                                       shadow_frame.GetMethod(), inst->GetDexPc(insns),
+                                       result);
     }
-    const bool kTracing = false;
-    if (kTracing) {
-#define TRACE_LOG std::cerr
-      TRACE_LOG << PrettyMethod(shadow_frame.GetMethod())
-                << StringPrintf("\n0x%x: ", dex_pc)
-                << inst->DumpString(&mh.GetDexFile()) << "\n";
-      for (size_t i = 0; i < shadow_frame.NumberOfVRegs(); ++i) {
-        uint32_t raw_value = shadow_frame.GetVReg(i);
-        Object* ref_value = shadow_frame.GetVRegReference(i);
-        TRACE_LOG << StringPrintf(" vreg%d=0x%08X", i, raw_value);
-        if (ref_value != NULL) {
-          if (ref_value->GetClass()->IsStringClass() &&
-              ref_value->AsString()->GetCharArray() != NULL) {
-            TRACE_LOG << "/java.lang.String \"" << ref_value->AsString()->ToModifiedUtf8() << "\"";
-          } else {
-            TRACE_LOG << "/" << PrettyTypeOf(ref_value);
-          }
-        }
-      }
-      TRACE_LOG << "\n";
-#undef TRACE_LOG
+    return result;
+  }
+  HANDLE_INSTRUCTION_START(RETURN_VOID_BARRIER) {
+    PREAMBLE();
+    ANDROID_MEMBAR_STORE();
+    JValue result;
+    if (UNLIKELY(instrumentation->HasMethodExitListeners())) {
+      instrumentation->MethodExitEvent(self, this_object_ref.get(),
+                                       shadow_frame.GetMethod(), inst->GetDexPc(insns),
+                                       result);
     }
-    switch (inst->Opcode()) {
-      case Instruction::NOP:
-        PREAMBLE();
-        inst = inst->Next_1xx();
-        break;
-      case Instruction::MOVE:
-        PREAMBLE();
-        shadow_frame.SetVReg(inst->VRegA_12x(),
-                             shadow_frame.GetVReg(inst->VRegB_12x()));
-        inst = inst->Next_1xx();
-        break;
-      case Instruction::MOVE_FROM16:
-        PREAMBLE();
-        shadow_frame.SetVReg(inst->VRegA_22x(),
-                             shadow_frame.GetVReg(inst->VRegB_22x()));
-        inst = inst->Next_2xx();
-        break;
-      case Instruction::MOVE_16:
-        PREAMBLE();
-        shadow_frame.SetVReg(inst->VRegA_32x(),
-                             shadow_frame.GetVReg(inst->VRegB_32x()));
-        inst = inst->Next_3xx();
-        break;
-      case Instruction::MOVE_WIDE:
-        PREAMBLE();
-        shadow_frame.SetVRegLong(inst->VRegA_12x(),
-                                 shadow_frame.GetVRegLong(inst->VRegB_12x()));
-        inst = inst->Next_1xx();
-        break;
-      case Instruction::MOVE_WIDE_FROM16:
-        PREAMBLE();
-        shadow_frame.SetVRegLong(inst->VRegA_22x(),
-                                 shadow_frame.GetVRegLong(inst->VRegB_22x()));
-        inst = inst->Next_2xx();
-        break;
-      case Instruction::MOVE_WIDE_16:
-        PREAMBLE();
-        shadow_frame.SetVRegLong(inst->VRegA_32x(),
-                                 shadow_frame.GetVRegLong(inst->VRegB_32x()));
-        inst = inst->Next_3xx();
-        break;
-      case Instruction::MOVE_OBJECT:
-        PREAMBLE();
-        shadow_frame.SetVRegReference(inst->VRegA_12x(),
-                                      shadow_frame.GetVRegReference(inst->VRegB_12x()));
-        inst = inst->Next_1xx();
-        break;
-      case Instruction::MOVE_OBJECT_FROM16:
-        PREAMBLE();
-        shadow_frame.SetVRegReference(inst->VRegA_22x(),
-                                      shadow_frame.GetVRegReference(inst->VRegB_22x()));
-        inst = inst->Next_2xx();
-        break;
-      case Instruction::MOVE_OBJECT_16:
-        PREAMBLE();
-        shadow_frame.SetVRegReference(inst->VRegA_32x(),
-                                      shadow_frame.GetVRegReference(inst->VRegB_32x()));
-        inst = inst->Next_3xx();
-        break;
-      case Instruction::MOVE_RESULT:
-        PREAMBLE();
-        shadow_frame.SetVReg(inst->VRegA_11x(), result_register.GetI());
-        inst = inst->Next_1xx();
-        break;
-      case Instruction::MOVE_RESULT_WIDE:
-        PREAMBLE();
-        shadow_frame.SetVRegLong(inst->VRegA_11x(), result_register.GetJ());
-        inst = inst->Next_1xx();
-        break;
-      case Instruction::MOVE_RESULT_OBJECT:
-        PREAMBLE();
-        shadow_frame.SetVRegReference(inst->VRegA_11x(), result_register.GetL());
-        inst = inst->Next_1xx();
-        break;
-      case Instruction::MOVE_EXCEPTION: {
-        PREAMBLE();
-        Throwable* exception = self->GetException(NULL);
-        self->ClearException();
-        shadow_frame.SetVRegReference(inst->VRegA_11x(), exception);
-        inst = inst->Next_1xx();
-        break;
-      }
-      case Instruction::RETURN_VOID: {
-        PREAMBLE();
-        JValue result;
-        if (UNLIKELY(instrumentation->HasMethodExitListeners())) {
-          instrumentation->MethodExitEvent(self, this_object_ref.get(),
-                                           shadow_frame.GetMethod(), inst->GetDexPc(insns),
-                                           result);
-        }
-        return result;
-      }
-      case Instruction::RETURN_VOID_BARRIER: {
-        PREAMBLE();
-        ANDROID_MEMBAR_STORE();
-        JValue result;
-        if (UNLIKELY(instrumentation->HasMethodExitListeners())) {
-          instrumentation->MethodExitEvent(self, this_object_ref.get(),
-                                           shadow_frame.GetMethod(), inst->GetDexPc(insns),
-                                           result);
-        }
-        return result;
-      }
-      case Instruction::RETURN: {
-        PREAMBLE();
-        JValue result;
-        result.SetJ(0);
-        result.SetI(shadow_frame.GetVReg(inst->VRegA_11x()));
-        if (UNLIKELY(instrumentation->HasMethodExitListeners())) {
-          instrumentation->MethodExitEvent(self, this_object_ref.get(),
-                                           shadow_frame.GetMethod(), inst->GetDexPc(insns),
-                                           result);
-        }
-        return result;
-      }
-      case Instruction::RETURN_WIDE: {
-        PREAMBLE();
-        JValue result;
-        result.SetJ(shadow_frame.GetVRegLong(inst->VRegA_11x()));
-        if (UNLIKELY(instrumentation->HasMethodExitListeners())) {
-          instrumentation->MethodExitEvent(self, this_object_ref.get(),
-                                           shadow_frame.GetMethod(), inst->GetDexPc(insns),
-                                           result);
-        }
-        return result;
-      }
-      case Instruction::RETURN_OBJECT: {
-        PREAMBLE();
-        JValue result;
-        Object* obj_result = shadow_frame.GetVRegReference(inst->VRegA_11x());
-        result.SetJ(0);
-        result.SetL(obj_result);
-        if (do_assignability_check && obj_result != NULL) {
-          Class* return_type = MethodHelper(shadow_frame.GetMethod()).GetReturnType();
-          if (return_type == NULL) {
-            // Return the pending exception.
-            HANDLE_PENDING_EXCEPTION();
-          }
-          if (!obj_result->VerifierInstanceOf(return_type)) {
-            // This should never happen.
-            self->ThrowNewExceptionF(self->GetCurrentLocationForThrow(),
-                                     "Ljava/lang/VirtualMachineError;",
-                                     "Returning '%s' that is not instance of return type '%s'",
-                                     ClassHelper(obj_result->GetClass()).GetDescriptor(),
-                                     ClassHelper(return_type).GetDescriptor());
-            HANDLE_PENDING_EXCEPTION();
-          }
-        }
-        if (UNLIKELY(instrumentation->HasMethodExitListeners())) {
-          instrumentation->MethodExitEvent(self, this_object_ref.get(),
-                                           shadow_frame.GetMethod(), inst->GetDexPc(insns),
-                                           result);
-        }
-        return result;
-      }
-      case Instruction::CONST_4: {
-        PREAMBLE();
-        uint4_t dst = inst->VRegA_11n();
-        int4_t val = inst->VRegB_11n();
-        shadow_frame.SetVReg(dst, val);
-        if (val == 0) {
-          shadow_frame.SetVRegReference(dst, NULL);
-        }
-        inst = inst->Next_1xx();
-        break;
-      }
-      case Instruction::CONST_16: {
-        PREAMBLE();
-        uint8_t dst = inst->VRegA_21s();
-        int16_t val = inst->VRegB_21s();
-        shadow_frame.SetVReg(dst, val);
-        if (val == 0) {
-          shadow_frame.SetVRegReference(dst, NULL);
-        }
-        inst = inst->Next_2xx();
-        break;
-      }
-      case Instruction::CONST: {
-        PREAMBLE();
-        uint8_t dst = inst->VRegA_31i();
-        int32_t val = inst->VRegB_31i();
-        shadow_frame.SetVReg(dst, val);
-        if (val == 0) {
-          shadow_frame.SetVRegReference(dst, NULL);
-        }
-        inst = inst->Next_3xx();
-        break;
-      }
-      case Instruction::CONST_HIGH16: {
-        PREAMBLE();
-        uint8_t dst = inst->VRegA_21h();
-        int32_t val = static_cast<int32_t>(inst->VRegB_21h() << 16);
-        shadow_frame.SetVReg(dst, val);
-        if (val == 0) {
-          shadow_frame.SetVRegReference(dst, NULL);
-        }
-        inst = inst->Next_2xx();
-        break;
-      }
-      case Instruction::CONST_WIDE_16:
-        PREAMBLE();
-        shadow_frame.SetVRegLong(inst->VRegA_21s(), inst->VRegB_21s());
-        inst = inst->Next_2xx();
-        break;
-      case Instruction::CONST_WIDE_32:
-        PREAMBLE();
-        shadow_frame.SetVRegLong(inst->VRegA_31i(), inst->VRegB_31i());
-        inst = inst->Next_3xx();
-        break;
-      case Instruction::CONST_WIDE:
-        PREAMBLE();
-        shadow_frame.SetVRegLong(inst->VRegA_51l(), inst->VRegB_51l());
-        inst = inst->Next_51l();
-        break;
-      case Instruction::CONST_WIDE_HIGH16:
-        shadow_frame.SetVRegLong(inst->VRegA_21h(),
-                                 static_cast<uint64_t>(inst->VRegB_21h()) << 48);
-        inst = inst->Next_2xx();
-        break;
-      case Instruction::CONST_STRING: {
-        PREAMBLE();
-        String* s = ResolveString(self, mh,  inst->VRegB_21c());
-        if (UNLIKELY(s == NULL)) {
-          HANDLE_PENDING_EXCEPTION();
-        } else {
-          shadow_frame.SetVRegReference(inst->VRegA_21c(), s);
-          inst = inst->Next_2xx();
-        }
-        break;
-      }
-      case Instruction::CONST_STRING_JUMBO: {
-        PREAMBLE();
-        String* s = ResolveString(self, mh,  inst->VRegB_31c());
-        if (UNLIKELY(s == NULL)) {
-          HANDLE_PENDING_EXCEPTION();
-        } else {
-          shadow_frame.SetVRegReference(inst->VRegA_31c(), s);
-          inst = inst->Next_3xx();
-        }
-        break;
-      }
-      case Instruction::CONST_CLASS: {
-        PREAMBLE();
-        Class* c = ResolveVerifyAndClinit(inst->VRegB_21c(), shadow_frame.GetMethod(),
-                                          self, false, do_access_check);
-        if (UNLIKELY(c == NULL)) {
-          HANDLE_PENDING_EXCEPTION();
-        } else {
-          shadow_frame.SetVRegReference(inst->VRegA_21c(), c);
-          inst = inst->Next_2xx();
-        }
-        break;
-      }
-      case Instruction::MONITOR_ENTER: {
-        PREAMBLE();
-        Object* obj = shadow_frame.GetVRegReference(inst->VRegA_11x());
-        if (UNLIKELY(obj == NULL)) {
-          ThrowNullPointerExceptionFromDexPC(shadow_frame.GetCurrentLocationForThrow());
-          HANDLE_PENDING_EXCEPTION();
-        } else {
-          DoMonitorEnter(self, obj);
-          POSSIBLY_HANDLE_PENDING_EXCEPTION(self->IsExceptionPending(), Next_1xx);
-        }
-        break;
-      }
-      case Instruction::MONITOR_EXIT: {
-        PREAMBLE();
-        Object* obj = shadow_frame.GetVRegReference(inst->VRegA_11x());
-        if (UNLIKELY(obj == NULL)) {
-          ThrowNullPointerExceptionFromDexPC(shadow_frame.GetCurrentLocationForThrow());
-          HANDLE_PENDING_EXCEPTION();
-        } else {
-          DoMonitorExit(self, obj);
-          POSSIBLY_HANDLE_PENDING_EXCEPTION(self->IsExceptionPending(), Next_1xx);
-        }
-        break;
-      }
-      case Instruction::CHECK_CAST: {
-        PREAMBLE();
-        Class* c = ResolveVerifyAndClinit(inst->VRegB_21c(), shadow_frame.GetMethod(),
-                                          self, false, do_access_check);
-        if (UNLIKELY(c == NULL)) {
-          HANDLE_PENDING_EXCEPTION();
-        } else {
-          Object* obj = shadow_frame.GetVRegReference(inst->VRegA_21c());
-          if (UNLIKELY(obj != NULL && !obj->InstanceOf(c))) {
-            ThrowClassCastException(c, obj->GetClass());
-            HANDLE_PENDING_EXCEPTION();
-          } else {
-            inst = inst->Next_2xx();
-          }
-        }
-        break;
-      }
-      case Instruction::INSTANCE_OF: {
-        PREAMBLE();
-        Class* c = ResolveVerifyAndClinit(inst->VRegC_22c(), shadow_frame.GetMethod(),
-                                          self, false, do_access_check);
-        if (UNLIKELY(c == NULL)) {
-          HANDLE_PENDING_EXCEPTION();
-        } else {
-          Object* obj = shadow_frame.GetVRegReference(inst->VRegB_22c());
-          shadow_frame.SetVReg(inst->VRegA_22c(), (obj != NULL && obj->InstanceOf(c)) ? 1 : 0);
-          inst = inst->Next_2xx();
-        }
-        break;
-      }
-      case Instruction::ARRAY_LENGTH:  {
-        PREAMBLE();
-        Object* array = shadow_frame.GetVRegReference(inst->VRegB_12x());
-        if (UNLIKELY(array == NULL)) {
-          ThrowNullPointerExceptionFromDexPC(shadow_frame.GetCurrentLocationForThrow());
-          HANDLE_PENDING_EXCEPTION();
-        } else {
-          shadow_frame.SetVReg(inst->VRegA_12x(), array->AsArray()->GetLength());
-          inst = inst->Next_1xx();
-        }
-        break;
-      }
-      case Instruction::NEW_INSTANCE: {
-        PREAMBLE();
-        Object* obj = AllocObjectFromCode(inst->VRegB_21c(), shadow_frame.GetMethod(),
-                                          self, do_access_check);
-        if (UNLIKELY(obj == NULL)) {
-          HANDLE_PENDING_EXCEPTION();
-        } else {
-          shadow_frame.SetVRegReference(inst->VRegA_21c(), obj);
-          inst = inst->Next_2xx();
-        }
-        break;
-      }
-      case Instruction::NEW_ARRAY: {
-        PREAMBLE();
-        int32_t length = shadow_frame.GetVReg(inst->VRegB_22c());
-        Object* obj = AllocArrayFromCode(inst->VRegC_22c(), shadow_frame.GetMethod(),
-                                         length, self, do_access_check);
-        if (UNLIKELY(obj == NULL)) {
-          HANDLE_PENDING_EXCEPTION();
-        } else {
-          shadow_frame.SetVRegReference(inst->VRegA_22c(), obj);
-          inst = inst->Next_2xx();
-        }
-        break;
-      }
-      case Instruction::FILLED_NEW_ARRAY: {
-        PREAMBLE();
-        bool success = DoFilledNewArray<false, do_access_check>(inst, shadow_frame,
-                                                                self, &result_register);
-        POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_3xx);
-        break;
-      }
-      case Instruction::FILLED_NEW_ARRAY_RANGE: {
-        PREAMBLE();
-        bool success = DoFilledNewArray<true, do_access_check>(inst, shadow_frame,
-                                                               self, &result_register);
-        POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_3xx);
-        break;
-      }
-      case Instruction::FILL_ARRAY_DATA: {
-        PREAMBLE();
-        Object* obj = shadow_frame.GetVRegReference(inst->VRegA_31t());
-        if (UNLIKELY(obj == NULL)) {
-          ThrowNullPointerException(NULL, "null array in FILL_ARRAY_DATA");
-          HANDLE_PENDING_EXCEPTION();
-          break;
-        }
-        Array* array = obj->AsArray();
-        DCHECK(array->IsArrayInstance() && !array->IsObjectArray());
-        const uint16_t* payload_addr = reinterpret_cast<const uint16_t*>(inst) + inst->VRegB_31t();
-        const Instruction::ArrayDataPayload* payload =
-            reinterpret_cast<const Instruction::ArrayDataPayload*>(payload_addr);
-        if (UNLIKELY(static_cast<int32_t>(payload->element_count) > array->GetLength())) {
-          self->ThrowNewExceptionF(shadow_frame.GetCurrentLocationForThrow(),
-                                   "Ljava/lang/ArrayIndexOutOfBoundsException;",
-                                   "failed FILL_ARRAY_DATA; length=%d, index=%d",
-                                   array->GetLength(), payload->element_count);
-          HANDLE_PENDING_EXCEPTION();
-          break;
-        }
-        uint32_t size_in_bytes = payload->element_count * payload->element_width;
-        memcpy(array->GetRawData(payload->element_width), payload->data, size_in_bytes);
-        inst = inst->Next_3xx();
-        break;
-      }
-      case Instruction::THROW: {
-        PREAMBLE();
-        Object* exception = shadow_frame.GetVRegReference(inst->VRegA_11x());
-        if (UNLIKELY(exception == NULL)) {
-          ThrowNullPointerException(NULL, "throw with null exception");
-        } else if (do_assignability_check && !exception->GetClass()->IsThrowableClass()) {
-          // This should never happen.
-          self->ThrowNewExceptionF(self->GetCurrentLocationForThrow(),
-                                   "Ljava/lang/VirtualMachineError;",
-                                   "Throwing '%s' that is not instance of Throwable",
-                                   ClassHelper(exception->GetClass()).GetDescriptor());
-        } else {
-          self->SetException(shadow_frame.GetCurrentLocationForThrow(), exception->AsThrowable());
-        }
+    return result;
+  }
+  HANDLE_INSTRUCTION_START(RETURN) {
+    PREAMBLE();
+    JValue result;
+    result.SetJ(0);
+    result.SetI(shadow_frame.GetVReg(inst->VRegA_11x()));
+    if (UNLIKELY(instrumentation->HasMethodExitListeners())) {
+      instrumentation->MethodExitEvent(self, this_object_ref.get(),
+                                       shadow_frame.GetMethod(), inst->GetDexPc(insns),
+                                       result);
+    }
+    return result;
+  }
+  HANDLE_INSTRUCTION_START(RETURN_WIDE) {
+    PREAMBLE();
+    JValue result;
+    result.SetJ(shadow_frame.GetVRegLong(inst->VRegA_11x()));
+    if (UNLIKELY(instrumentation->HasMethodExitListeners())) {
+      instrumentation->MethodExitEvent(self, this_object_ref.get(),
+                                       shadow_frame.GetMethod(), inst->GetDexPc(insns),
+                                       result);
+    }
+    return result;
+  }
+  HANDLE_INSTRUCTION_START(RETURN_OBJECT) {
+    PREAMBLE();
+    JValue result;
+    Object* obj_result = shadow_frame.GetVRegReference(inst->VRegA_11x());
+    result.SetJ(0);
+    result.SetL(obj_result);
+    if (do_assignability_check && obj_result != NULL) {
+      Class* return_type = MethodHelper(shadow_frame.GetMethod()).GetReturnType();
+      if (return_type == NULL) {
+        // Return the pending exception.
         HANDLE_PENDING_EXCEPTION();
-        break;
-      }
-      case Instruction::GOTO: {
-        PREAMBLE();
-        inst = inst->RelativeAt(inst->VRegA_10t());
-        break;
-      }
-      case Instruction::GOTO_16: {
-        PREAMBLE();
-        inst = inst->RelativeAt(inst->VRegA_20t());
-        break;
-      }
-      case Instruction::GOTO_32: {
-        PREAMBLE();
-        inst = inst->RelativeAt(inst->VRegA_30t());
-        break;
-      }
-      case Instruction::PACKED_SWITCH: {
-        PREAMBLE();
-        const uint16_t* switch_data = reinterpret_cast<const uint16_t*>(inst) + inst->VRegB_31t();
-        int32_t test_val = shadow_frame.GetVReg(inst->VRegA_31t());
-        DCHECK_EQ(switch_data[0], static_cast<uint16_t>(Instruction::kPackedSwitchSignature));
-        uint16_t size = switch_data[1];
-        DCHECK_GT(size, 0);
-        const int32_t* keys = reinterpret_cast<const int32_t*>(&switch_data[2]);
-        DCHECK(IsAligned<4>(keys));
-        int32_t first_key = keys[0];
-        const int32_t* targets = reinterpret_cast<const int32_t*>(&switch_data[4]);
-        DCHECK(IsAligned<4>(targets));
-        int32_t index = test_val - first_key;
-        if (index >= 0 && index < size) {
-          inst = inst->RelativeAt(targets[index]);
-        } else {
-          inst = inst->Next_3xx();
-        }
-        break;
-      }
-      case Instruction::SPARSE_SWITCH: {
-        PREAMBLE();
-        inst = DoSparseSwitch(inst, shadow_frame);
-        break;
-      }
-      case Instruction::CMPL_FLOAT: {
-        PREAMBLE();
-        float val1 = shadow_frame.GetVRegFloat(inst->VRegB_23x());
-        float val2 = shadow_frame.GetVRegFloat(inst->VRegC_23x());
-        int32_t result;
-        if (val1 > val2) {
-          result = 1;
-        } else if (val1 == val2) {
-          result = 0;
-        } else {
-          result = -1;
-        }
-        shadow_frame.SetVReg(inst->VRegA_23x(), result);
-        inst = inst->Next_2xx();
-        break;
-      }
-      case Instruction::CMPG_FLOAT: {
-        PREAMBLE();
-        float val1 = shadow_frame.GetVRegFloat(inst->VRegB_23x());
-        float val2 = shadow_frame.GetVRegFloat(inst->VRegC_23x());
-        int32_t result;
-        if (val1 < val2) {
-          result = -1;
-        } else if (val1 == val2) {
-          result = 0;
-        } else {
-          result = 1;
-        }
-        shadow_frame.SetVReg(inst->VRegA_23x(), result);
-        inst = inst->Next_2xx();
-        break;
-      }
-      case Instruction::CMPL_DOUBLE: {
-        PREAMBLE();
-        double val1 = shadow_frame.GetVRegDouble(inst->VRegB_23x());
-        double val2 = shadow_frame.GetVRegDouble(inst->VRegC_23x());
-        int32_t result;
-        if (val1 > val2) {
-          result = 1;
-        } else if (val1 == val2) {
-          result = 0;
-        } else {
-          result = -1;
-        }
-        shadow_frame.SetVReg(inst->VRegA_23x(), result);
-        inst = inst->Next_2xx();
-        break;
       }
-
-      case Instruction::CMPG_DOUBLE: {
-        PREAMBLE();
-        double val1 = shadow_frame.GetVRegDouble(inst->VRegB_23x());
-        double val2 = shadow_frame.GetVRegDouble(inst->VRegC_23x());
-        int32_t result;
-        if (val1 < val2) {
-          result = -1;
-        } else if (val1 == val2) {
-          result = 0;
-        } else {
-          result = 1;
-        }
-        shadow_frame.SetVReg(inst->VRegA_23x(), result);
-        inst = inst->Next_2xx();
-        break;
+      if (!obj_result->VerifierInstanceOf(return_type)) {
+        // This should never happen.
+        self->ThrowNewExceptionF(self->GetCurrentLocationForThrow(),
+                                 "Ljava/lang/VirtualMachineError;",
+                                 "Returning '%s' that is not instance of return type '%s'",
+                                 ClassHelper(obj_result->GetClass()).GetDescriptor(),
+                                 ClassHelper(return_type).GetDescriptor());
+        HANDLE_PENDING_EXCEPTION();
       }
-      case Instruction::CMP_LONG: {
-        PREAMBLE();
-        int64_t val1 = shadow_frame.GetVRegLong(inst->VRegB_23x());
-        int64_t val2 = shadow_frame.GetVRegLong(inst->VRegC_23x());
-        int32_t result;
-        if (val1 > val2) {
-          result = 1;
-        } else if (val1 == val2) {
-          result = 0;
-        } else {
-          result = -1;
-        }
-        shadow_frame.SetVReg(inst->VRegA_23x(), result);
+    }
+    if (UNLIKELY(instrumentation->HasMethodExitListeners())) {
+      instrumentation->MethodExitEvent(self, this_object_ref.get(),
+                                       shadow_frame.GetMethod(), inst->GetDexPc(insns),
+                                       result);
+    }
+    return result;
+  }
+  HANDLE_INSTRUCTION_START(CONST_4) {
+    PREAMBLE();
+    uint4_t dst = inst->VRegA_11n();
+    int4_t val = inst->VRegB_11n();
+    shadow_frame.SetVReg(dst, val);
+    if (val == 0) {
+      shadow_frame.SetVRegReference(dst, NULL);
+    }
+    inst = inst->Next_1xx();
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(CONST_16) {
+    PREAMBLE();
+    uint8_t dst = inst->VRegA_21s();
+    int16_t val = inst->VRegB_21s();
+    shadow_frame.SetVReg(dst, val);
+    if (val == 0) {
+      shadow_frame.SetVRegReference(dst, NULL);
+    }
+    inst = inst->Next_2xx();
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(CONST) {
+    PREAMBLE();
+    uint8_t dst = inst->VRegA_31i();
+    int32_t val = inst->VRegB_31i();
+    shadow_frame.SetVReg(dst, val);
+    if (val == 0) {
+      shadow_frame.SetVRegReference(dst, NULL);
+    }
+    inst = inst->Next_3xx();
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(CONST_HIGH16) {
+    PREAMBLE();
+    uint8_t dst = inst->VRegA_21h();
+    int32_t val = static_cast<int32_t>(inst->VRegB_21h() << 16);
+    shadow_frame.SetVReg(dst, val);
+    if (val == 0) {
+      shadow_frame.SetVRegReference(dst, NULL);
+    }
+    inst = inst->Next_2xx();
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(CONST_WIDE_16)
+    PREAMBLE();
+    shadow_frame.SetVRegLong(inst->VRegA_21s(), inst->VRegB_21s());
+    inst = inst->Next_2xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(CONST_WIDE_32)
+    PREAMBLE();
+    shadow_frame.SetVRegLong(inst->VRegA_31i(), inst->VRegB_31i());
+    inst = inst->Next_3xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(CONST_WIDE)
+    PREAMBLE();
+    shadow_frame.SetVRegLong(inst->VRegA_51l(), inst->VRegB_51l());
+    inst = inst->Next_51l();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(CONST_WIDE_HIGH16)
+    shadow_frame.SetVRegLong(inst->VRegA_21h(),
+                             static_cast<uint64_t>(inst->VRegB_21h()) << 48);
+    inst = inst->Next_2xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(CONST_STRING) {
+    PREAMBLE();
+    String* s = ResolveString(self, mh,  inst->VRegB_21c());
+    if (UNLIKELY(s == NULL)) {
+      HANDLE_PENDING_EXCEPTION();
+    } else {
+      shadow_frame.SetVRegReference(inst->VRegA_21c(), s);
+      inst = inst->Next_2xx();
+    }
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(CONST_STRING_JUMBO) {
+    PREAMBLE();
+    String* s = ResolveString(self, mh,  inst->VRegB_31c());
+    if (UNLIKELY(s == NULL)) {
+      HANDLE_PENDING_EXCEPTION();
+    } else {
+      shadow_frame.SetVRegReference(inst->VRegA_31c(), s);
+      inst = inst->Next_3xx();
+    }
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(CONST_CLASS) {
+    PREAMBLE();
+    Class* c = ResolveVerifyAndClinit(inst->VRegB_21c(), shadow_frame.GetMethod(),
+                                      self, false, do_access_check);
+    if (UNLIKELY(c == NULL)) {
+      HANDLE_PENDING_EXCEPTION();
+    } else {
+      shadow_frame.SetVRegReference(inst->VRegA_21c(), c);
+      inst = inst->Next_2xx();
+    }
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(MONITOR_ENTER) {
+    PREAMBLE();
+    Object* obj = shadow_frame.GetVRegReference(inst->VRegA_11x());
+    if (UNLIKELY(obj == NULL)) {
+      ThrowNullPointerExceptionFromDexPC(shadow_frame.GetCurrentLocationForThrow());
+      HANDLE_PENDING_EXCEPTION();
+    } else {
+      DoMonitorEnter(self, obj);
+      POSSIBLY_HANDLE_PENDING_EXCEPTION(self->IsExceptionPending(), Next_1xx);
+    }
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(MONITOR_EXIT) {
+    PREAMBLE();
+    Object* obj = shadow_frame.GetVRegReference(inst->VRegA_11x());
+    if (UNLIKELY(obj == NULL)) {
+      ThrowNullPointerExceptionFromDexPC(shadow_frame.GetCurrentLocationForThrow());
+      HANDLE_PENDING_EXCEPTION();
+    } else {
+      DoMonitorExit(self, obj);
+      POSSIBLY_HANDLE_PENDING_EXCEPTION(self->IsExceptionPending(), Next_1xx);
+    }
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(CHECK_CAST) {
+    PREAMBLE();
+    Class* c = ResolveVerifyAndClinit(inst->VRegB_21c(), shadow_frame.GetMethod(),
+                                      self, false, do_access_check);
+    if (UNLIKELY(c == NULL)) {
+      HANDLE_PENDING_EXCEPTION();
+    } else {
+      Object* obj = shadow_frame.GetVRegReference(inst->VRegA_21c());
+      if (UNLIKELY(obj != NULL && !obj->InstanceOf(c))) {
+        ThrowClassCastException(c, obj->GetClass());
+        HANDLE_PENDING_EXCEPTION();
+      } else {
         inst = inst->Next_2xx();
-        break;
       }
-      case Instruction::IF_EQ: {
-        PREAMBLE();
-        if (shadow_frame.GetVReg(inst->VRegA_22t()) == shadow_frame.GetVReg(inst->VRegB_22t())) {
-          inst = inst->RelativeAt(inst->VRegC_22t());
-        } else {
-          inst = inst->Next_2xx();
-        }
-        break;
-      }
-      case Instruction::IF_NE: {
-        PREAMBLE();
-        if (shadow_frame.GetVReg(inst->VRegA_22t()) != shadow_frame.GetVReg(inst->VRegB_22t())) {
-          inst = inst->RelativeAt(inst->VRegC_22t());
-        } else {
-          inst = inst->Next_2xx();
-        }
-        break;
-      }
-      case Instruction::IF_LT: {
-        PREAMBLE();
-        if (shadow_frame.GetVReg(inst->VRegA_22t()) < shadow_frame.GetVReg(inst->VRegB_22t())) {
-          inst = inst->RelativeAt(inst->VRegC_22t());
-        } else {
-          inst = inst->Next_2xx();
-        }
-        break;
-      }
-      case Instruction::IF_GE: {
-        PREAMBLE();
-        if (shadow_frame.GetVReg(inst->VRegA_22t()) >= shadow_frame.GetVReg(inst->VRegB_22t())) {
-          inst = inst->RelativeAt(inst->VRegC_22t());
-        } else {
-          inst = inst->Next_2xx();
-        }
-        break;
-      }
-      case Instruction::IF_GT: {
-        PREAMBLE();
-        if (shadow_frame.GetVReg(inst->VRegA_22t()) > shadow_frame.GetVReg(inst->VRegB_22t())) {
-          inst = inst->RelativeAt(inst->VRegC_22t());
-        } else {
-          inst = inst->Next_2xx();
-        }
-        break;
-      }
-      case Instruction::IF_LE: {
-        PREAMBLE();
-        if (shadow_frame.GetVReg(inst->VRegA_22t()) <= shadow_frame.GetVReg(inst->VRegB_22t())) {
-          inst = inst->RelativeAt(inst->VRegC_22t());
-        } else {
-          inst = inst->Next_2xx();
-        }
-        break;
-      }
-      case Instruction::IF_EQZ: {
-        PREAMBLE();
-        if (shadow_frame.GetVReg(inst->VRegA_21t()) == 0) {
-          inst = inst->RelativeAt(inst->VRegB_21t());
-        } else {
-          inst = inst->Next_2xx();
-        }
-        break;
-      }
-      case Instruction::IF_NEZ: {
-        PREAMBLE();
-        if (shadow_frame.GetVReg(inst->VRegA_21t()) != 0) {
-          inst = inst->RelativeAt(inst->VRegB_21t());
-        } else {
-          inst = inst->Next_2xx();
-        }
-        break;
-      }
-      case Instruction::IF_LTZ: {
-        PREAMBLE();
-        if (shadow_frame.GetVReg(inst->VRegA_21t()) < 0) {
-          inst = inst->RelativeAt(inst->VRegB_21t());
-        } else {
-          inst = inst->Next_2xx();
-        }
-        break;
-      }
-      case Instruction::IF_GEZ: {
-        PREAMBLE();
-        if (shadow_frame.GetVReg(inst->VRegA_21t()) >= 0) {
-          inst = inst->RelativeAt(inst->VRegB_21t());
-        } else {
-          inst = inst->Next_2xx();
-        }
-        break;
-      }
-      case Instruction::IF_GTZ: {
-        PREAMBLE();
-        if (shadow_frame.GetVReg(inst->VRegA_21t()) > 0) {
-          inst = inst->RelativeAt(inst->VRegB_21t());
-        } else {
-          inst = inst->Next_2xx();
-        }
-        break;
-      }
-      case Instruction::IF_LEZ:  {
-        PREAMBLE();
-        if (shadow_frame.GetVReg(inst->VRegA_21t()) <= 0) {
-          inst = inst->RelativeAt(inst->VRegB_21t());
-        } else {
-          inst = inst->Next_2xx();
-        }
-        break;
-      }
-      case Instruction::AGET_BOOLEAN: {
-        PREAMBLE();
-        Object* a = shadow_frame.GetVRegReference(inst->VRegB_23x());
-        if (UNLIKELY(a == NULL)) {
-          ThrowNullPointerExceptionFromDexPC(shadow_frame.GetCurrentLocationForThrow());
-          HANDLE_PENDING_EXCEPTION();
-          break;
-        }
-        int32_t index = shadow_frame.GetVReg(inst->VRegC_23x());
-        BooleanArray* array = a->AsBooleanArray();
-        if (LIKELY(array->IsValidIndex(index))) {
-          shadow_frame.SetVReg(inst->VRegA_23x(), array->GetData()[index]);
-          inst = inst->Next_2xx();
-        } else {
-          HANDLE_PENDING_EXCEPTION();
-        }
-        break;
-      }
-      case Instruction::AGET_BYTE: {
-        PREAMBLE();
-        Object* a = shadow_frame.GetVRegReference(inst->VRegB_23x());
-        if (UNLIKELY(a == NULL)) {
-          ThrowNullPointerExceptionFromDexPC(shadow_frame.GetCurrentLocationForThrow());
-          HANDLE_PENDING_EXCEPTION();
-          break;
-        }
-        int32_t index = shadow_frame.GetVReg(inst->VRegC_23x());
-        ByteArray* array = a->AsByteArray();
-        if (LIKELY(array->IsValidIndex(index))) {
-          shadow_frame.SetVReg(inst->VRegA_23x(), array->GetData()[index]);
-          inst = inst->Next_2xx();
-        } else {
-          HANDLE_PENDING_EXCEPTION();
-        }
-        break;
-      }
-      case Instruction::AGET_CHAR: {
-        PREAMBLE();
-        Object* a = shadow_frame.GetVRegReference(inst->VRegB_23x());
-        if (UNLIKELY(a == NULL)) {
-          ThrowNullPointerExceptionFromDexPC(shadow_frame.GetCurrentLocationForThrow());
-          HANDLE_PENDING_EXCEPTION();
-          break;
-        }
-        int32_t index = shadow_frame.GetVReg(inst->VRegC_23x());
-        CharArray* array = a->AsCharArray();
-        if (LIKELY(array->IsValidIndex(index))) {
-          shadow_frame.SetVReg(inst->VRegA_23x(), array->GetData()[index]);
-          inst = inst->Next_2xx();
-        } else {
-          HANDLE_PENDING_EXCEPTION();
-        }
-        break;
-      }
-      case Instruction::AGET_SHORT: {
-        PREAMBLE();
-        Object* a = shadow_frame.GetVRegReference(inst->VRegB_23x());
-        if (UNLIKELY(a == NULL)) {
-          ThrowNullPointerExceptionFromDexPC(shadow_frame.GetCurrentLocationForThrow());
-          HANDLE_PENDING_EXCEPTION();
-          break;
-        }
-        int32_t index = shadow_frame.GetVReg(inst->VRegC_23x());
-        ShortArray* array = a->AsShortArray();
-        if (LIKELY(array->IsValidIndex(index))) {
-          shadow_frame.SetVReg(inst->VRegA_23x(), array->GetData()[index]);
-          inst = inst->Next_2xx();
-        } else {
-          HANDLE_PENDING_EXCEPTION();
-        }
-        break;
-      }
-      case Instruction::AGET: {
-        PREAMBLE();
-        Object* a = shadow_frame.GetVRegReference(inst->VRegB_23x());
-        if (UNLIKELY(a == NULL)) {
-          ThrowNullPointerExceptionFromDexPC(shadow_frame.GetCurrentLocationForThrow());
-          HANDLE_PENDING_EXCEPTION();
-          break;
-        }
-        int32_t index = shadow_frame.GetVReg(inst->VRegC_23x());
-        IntArray* array = a->AsIntArray();
-        if (LIKELY(array->IsValidIndex(index))) {
-          shadow_frame.SetVReg(inst->VRegA_23x(), array->GetData()[index]);
-          inst = inst->Next_2xx();
-        } else {
-          HANDLE_PENDING_EXCEPTION();
-        }
-        break;
-      }
-      case Instruction::AGET_WIDE:  {
-        PREAMBLE();
-        Object* a = shadow_frame.GetVRegReference(inst->VRegB_23x());
-        if (UNLIKELY(a == NULL)) {
-          ThrowNullPointerExceptionFromDexPC(shadow_frame.GetCurrentLocationForThrow());
-          HANDLE_PENDING_EXCEPTION();
-          break;
-        }
-        int32_t index = shadow_frame.GetVReg(inst->VRegC_23x());
-        LongArray* array = a->AsLongArray();
-        if (LIKELY(array->IsValidIndex(index))) {
-          shadow_frame.SetVRegLong(inst->VRegA_23x(), array->GetData()[index]);
-          inst = inst->Next_2xx();
-        } else {
-          HANDLE_PENDING_EXCEPTION();
-        }
-        break;
-      }
-      case Instruction::AGET_OBJECT: {
-        PREAMBLE();
-        Object* a = shadow_frame.GetVRegReference(inst->VRegB_23x());
-        if (UNLIKELY(a == NULL)) {
-          ThrowNullPointerExceptionFromDexPC(shadow_frame.GetCurrentLocationForThrow());
-          HANDLE_PENDING_EXCEPTION();
-          break;
-        }
-        int32_t index = shadow_frame.GetVReg(inst->VRegC_23x());
-        ObjectArray<Object>* array = a->AsObjectArray<Object>();
-        if (LIKELY(array->IsValidIndex(index))) {
-          shadow_frame.SetVRegReference(inst->VRegA_23x(), array->GetWithoutChecks(index));
-          inst = inst->Next_2xx();
-        } else {
-          HANDLE_PENDING_EXCEPTION();
-        }
-        break;
-      }
-      case Instruction::APUT_BOOLEAN: {
-        PREAMBLE();
-        Object* a = shadow_frame.GetVRegReference(inst->VRegB_23x());
-        if (UNLIKELY(a == NULL)) {
-          ThrowNullPointerExceptionFromDexPC(shadow_frame.GetCurrentLocationForThrow());
-          HANDLE_PENDING_EXCEPTION();
-          break;
-        }
-        uint8_t val = shadow_frame.GetVReg(inst->VRegA_23x());
-        int32_t index = shadow_frame.GetVReg(inst->VRegC_23x());
-        BooleanArray* array = a->AsBooleanArray();
-        if (LIKELY(array->IsValidIndex(index))) {
-          array->GetData()[index] = val;
-          inst = inst->Next_2xx();
-        } else {
-          HANDLE_PENDING_EXCEPTION();
-        }
-        break;
-      }
-      case Instruction::APUT_BYTE: {
-        PREAMBLE();
-        Object* a = shadow_frame.GetVRegReference(inst->VRegB_23x());
-        if (UNLIKELY(a == NULL)) {
-          ThrowNullPointerExceptionFromDexPC(shadow_frame.GetCurrentLocationForThrow());
-          HANDLE_PENDING_EXCEPTION();
-          break;
-        }
-        int8_t val = shadow_frame.GetVReg(inst->VRegA_23x());
-        int32_t index = shadow_frame.GetVReg(inst->VRegC_23x());
-        ByteArray* array = a->AsByteArray();
-        if (LIKELY(array->IsValidIndex(index))) {
-          array->GetData()[index] = val;
-          inst = inst->Next_2xx();
-        } else {
-          HANDLE_PENDING_EXCEPTION();
-        }
-        break;
-      }
-      case Instruction::APUT_CHAR: {
-        PREAMBLE();
-        Object* a = shadow_frame.GetVRegReference(inst->VRegB_23x());
-        if (UNLIKELY(a == NULL)) {
-          ThrowNullPointerExceptionFromDexPC(shadow_frame.GetCurrentLocationForThrow());
-          HANDLE_PENDING_EXCEPTION();
-          break;
-        }
-        uint16_t val = shadow_frame.GetVReg(inst->VRegA_23x());
-        int32_t index = shadow_frame.GetVReg(inst->VRegC_23x());
-        CharArray* array = a->AsCharArray();
-        if (LIKELY(array->IsValidIndex(index))) {
-          array->GetData()[index] = val;
-          inst = inst->Next_2xx();
-        } else {
-          HANDLE_PENDING_EXCEPTION();
-        }
-        break;
-      }
-      case Instruction::APUT_SHORT: {
-        PREAMBLE();
-        Object* a = shadow_frame.GetVRegReference(inst->VRegB_23x());
-        if (UNLIKELY(a == NULL)) {
-          ThrowNullPointerExceptionFromDexPC(shadow_frame.GetCurrentLocationForThrow());
-          HANDLE_PENDING_EXCEPTION();
-          break;
-        }
-        int16_t val = shadow_frame.GetVReg(inst->VRegA_23x());
-        int32_t index = shadow_frame.GetVReg(inst->VRegC_23x());
-        ShortArray* array = a->AsShortArray();
-        if (LIKELY(array->IsValidIndex(index))) {
-          array->GetData()[index] = val;
-          inst = inst->Next_2xx();
-        } else {
-          HANDLE_PENDING_EXCEPTION();
-        }
-        break;
-      }
-      case Instruction::APUT: {
-        PREAMBLE();
-        Object* a = shadow_frame.GetVRegReference(inst->VRegB_23x());
-        if (UNLIKELY(a == NULL)) {
-          ThrowNullPointerExceptionFromDexPC(shadow_frame.GetCurrentLocationForThrow());
-          HANDLE_PENDING_EXCEPTION();
-          break;
-        }
-        int32_t val = shadow_frame.GetVReg(inst->VRegA_23x());
-        int32_t index = shadow_frame.GetVReg(inst->VRegC_23x());
-        IntArray* array = a->AsIntArray();
-        if (LIKELY(array->IsValidIndex(index))) {
-          array->GetData()[index] = val;
-          inst = inst->Next_2xx();
-        } else {
-          HANDLE_PENDING_EXCEPTION();
-        }
-        break;
-      }
-      case Instruction::APUT_WIDE: {
-        PREAMBLE();
-        Object* a = shadow_frame.GetVRegReference(inst->VRegB_23x());
-        if (UNLIKELY(a == NULL)) {
-          ThrowNullPointerExceptionFromDexPC(shadow_frame.GetCurrentLocationForThrow());
-          HANDLE_PENDING_EXCEPTION();
-          break;
-        }
-        int64_t val = shadow_frame.GetVRegLong(inst->VRegA_23x());
-        int32_t index = shadow_frame.GetVReg(inst->VRegC_23x());
-        LongArray* array = a->AsLongArray();
-        if (LIKELY(array->IsValidIndex(index))) {
-          array->GetData()[index] = val;
-          inst = inst->Next_2xx();
-        } else {
-          HANDLE_PENDING_EXCEPTION();
-        }
-        break;
-      }
-      case Instruction::APUT_OBJECT: {
-        PREAMBLE();
-        Object* a = shadow_frame.GetVRegReference(inst->VRegB_23x());
-        if (UNLIKELY(a == NULL)) {
-          ThrowNullPointerExceptionFromDexPC(shadow_frame.GetCurrentLocationForThrow());
-          HANDLE_PENDING_EXCEPTION();
-          break;
-        }
-        int32_t index = shadow_frame.GetVReg(inst->VRegC_23x());
-        Object* val = shadow_frame.GetVRegReference(inst->VRegA_23x());
-        ObjectArray<Object>* array = a->AsObjectArray<Object>();
-        if (LIKELY(array->IsValidIndex(index) && array->CheckAssignable(val))) {
-          array->SetWithoutChecks(index, val);
-          inst = inst->Next_2xx();
-        } else {
-          HANDLE_PENDING_EXCEPTION();
-        }
-        break;
-      }
-      case Instruction::IGET_BOOLEAN: {
-        PREAMBLE();
-        bool success = DoFieldGet<InstancePrimitiveRead, Primitive::kPrimBoolean, do_access_check>(self, shadow_frame, inst);
-        POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
-        break;
-      }
-      case Instruction::IGET_BYTE: {
-        PREAMBLE();
-        bool success = DoFieldGet<InstancePrimitiveRead, Primitive::kPrimByte, do_access_check>(self, shadow_frame, inst);
-        POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
-        break;
-      }
-      case Instruction::IGET_CHAR: {
-        PREAMBLE();
-        bool success = DoFieldGet<InstancePrimitiveRead, Primitive::kPrimChar, do_access_check>(self, shadow_frame, inst);
-        POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
-        break;
-      }
-      case Instruction::IGET_SHORT: {
-        PREAMBLE();
-        bool success = DoFieldGet<InstancePrimitiveRead, Primitive::kPrimShort, do_access_check>(self, shadow_frame, inst);
-        POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
-        break;
-      }
-      case Instruction::IGET: {
-        PREAMBLE();
-        bool success = DoFieldGet<InstancePrimitiveRead, Primitive::kPrimInt, do_access_check>(self, shadow_frame, inst);
-        POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
-        break;
-      }
-      case Instruction::IGET_WIDE: {
-        PREAMBLE();
-        bool success = DoFieldGet<InstancePrimitiveRead, Primitive::kPrimLong, do_access_check>(self, shadow_frame, inst);
-        POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
-        break;
-      }
-      case Instruction::IGET_OBJECT: {
-        PREAMBLE();
-        bool success = DoFieldGet<InstanceObjectRead, Primitive::kPrimNot, do_access_check>(self, shadow_frame, inst);
-        POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
-        break;
-      }
-      case Instruction::IGET_QUICK: {
-        PREAMBLE();
-        bool success = DoIGetQuick<Primitive::kPrimInt>(self, shadow_frame, inst);
-        POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
-        break;
-      }
-      case Instruction::IGET_WIDE_QUICK: {
-        PREAMBLE();
-        bool success = DoIGetQuick<Primitive::kPrimLong>(self, shadow_frame, inst);
-        POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
-        break;
-      }
-      case Instruction::IGET_OBJECT_QUICK: {
-        PREAMBLE();
-        bool success = DoIGetQuick<Primitive::kPrimNot>(self, shadow_frame, inst);
-        POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
-        break;
-      }
-      case Instruction::SGET_BOOLEAN: {
-        PREAMBLE();
-        bool success = DoFieldGet<StaticPrimitiveRead, Primitive::kPrimBoolean, do_access_check>(self, shadow_frame, inst);
-        POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
-        break;
-      }
-      case Instruction::SGET_BYTE: {
-        PREAMBLE();
-        bool success = DoFieldGet<StaticPrimitiveRead, Primitive::kPrimByte, do_access_check>(self, shadow_frame, inst);
-        POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
-        break;
-      }
-      case Instruction::SGET_CHAR: {
-        PREAMBLE();
-        bool success = DoFieldGet<StaticPrimitiveRead, Primitive::kPrimChar, do_access_check>(self, shadow_frame, inst);
-        POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
-        break;
-      }
-      case Instruction::SGET_SHORT: {
-        PREAMBLE();
-        bool success = DoFieldGet<StaticPrimitiveRead, Primitive::kPrimShort, do_access_check>(self, shadow_frame, inst);
-        POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
-        break;
-      }
-      case Instruction::SGET: {
-        PREAMBLE();
-        bool success = DoFieldGet<StaticPrimitiveRead, Primitive::kPrimInt, do_access_check>(self, shadow_frame, inst);
-        POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
-        break;
-      }
-      case Instruction::SGET_WIDE: {
-        PREAMBLE();
-        bool success = DoFieldGet<StaticPrimitiveRead, Primitive::kPrimLong, do_access_check>(self, shadow_frame, inst);
-        POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
-        break;
-      }
-      case Instruction::SGET_OBJECT: {
-        PREAMBLE();
-        bool success = DoFieldGet<StaticObjectRead, Primitive::kPrimNot, do_access_check>(self, shadow_frame, inst);
-        POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
-        break;
-      }
-      case Instruction::IPUT_BOOLEAN: {
-        PREAMBLE();
-        bool success = DoFieldPut<InstancePrimitiveWrite, Primitive::kPrimBoolean, do_access_check>(self, shadow_frame, inst);
-        POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
-        break;
-      }
-      case Instruction::IPUT_BYTE: {
-        PREAMBLE();
-        bool success = DoFieldPut<InstancePrimitiveWrite, Primitive::kPrimByte, do_access_check>(self, shadow_frame, inst);
-        POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
-        break;
-      }
-      case Instruction::IPUT_CHAR: {
-        PREAMBLE();
-        bool success = DoFieldPut<InstancePrimitiveWrite, Primitive::kPrimChar, do_access_check>(self, shadow_frame, inst);
-        POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
-        break;
-      }
-      case Instruction::IPUT_SHORT: {
-        PREAMBLE();
-        bool success = DoFieldPut<InstancePrimitiveWrite, Primitive::kPrimShort, do_access_check>(self, shadow_frame, inst);
-        POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
-        break;
-      }
-      case Instruction::IPUT: {
-        PREAMBLE();
-        bool success = DoFieldPut<InstancePrimitiveWrite, Primitive::kPrimInt, do_access_check>(self, shadow_frame, inst);
-        POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
-        break;
-      }
-      case Instruction::IPUT_WIDE: {
-        PREAMBLE();
-        bool success = DoFieldPut<InstancePrimitiveWrite, Primitive::kPrimLong, do_access_check>(self, shadow_frame, inst);
-        POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
-        break;
-      }
-      case Instruction::IPUT_OBJECT: {
-        PREAMBLE();
-        bool success = DoFieldPut<InstanceObjectWrite, Primitive::kPrimNot, do_access_check>(self, shadow_frame, inst);
-        POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
-        break;
-      }
-      case Instruction::IPUT_QUICK: {
-        PREAMBLE();
-        bool success = DoIPutQuick<Primitive::kPrimInt>(self, shadow_frame, inst);
-        POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
-        break;
-      }
-      case Instruction::IPUT_WIDE_QUICK: {
-        PREAMBLE();
-        bool success = DoIPutQuick<Primitive::kPrimLong>(self, shadow_frame, inst);
-        POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
-        break;
-      }
-      case Instruction::IPUT_OBJECT_QUICK: {
-        PREAMBLE();
-        bool success = DoIPutQuick<Primitive::kPrimNot>(self, shadow_frame, inst);
-        POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
-        break;
-      }
-      case Instruction::SPUT_BOOLEAN: {
-        PREAMBLE();
-        bool success = DoFieldPut<StaticPrimitiveWrite, Primitive::kPrimBoolean, do_access_check>(self, shadow_frame, inst);
-        POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
-        break;
-      }
-      case Instruction::SPUT_BYTE: {
-        PREAMBLE();
-        bool success = DoFieldPut<StaticPrimitiveWrite, Primitive::kPrimByte, do_access_check>(self, shadow_frame, inst);
-        POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
-        break;
-      }
-      case Instruction::SPUT_CHAR: {
-        PREAMBLE();
-        bool success = DoFieldPut<StaticPrimitiveWrite, Primitive::kPrimChar, do_access_check>(self, shadow_frame, inst);
-        POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
-        break;
-      }
-      case Instruction::SPUT_SHORT: {
-        PREAMBLE();
-        bool success = DoFieldPut<StaticPrimitiveWrite, Primitive::kPrimShort, do_access_check>(self, shadow_frame, inst);
-        POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
-        break;
-      }
-      case Instruction::SPUT: {
-        PREAMBLE();
-        bool success = DoFieldPut<StaticPrimitiveWrite, Primitive::kPrimInt, do_access_check>(self, shadow_frame, inst);
-        POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
-        break;
-      }
-      case Instruction::SPUT_WIDE: {
-        PREAMBLE();
-        bool success = DoFieldPut<StaticPrimitiveWrite, Primitive::kPrimLong, do_access_check>(self, shadow_frame, inst);
-        POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
-        break;
-      }
-      case Instruction::SPUT_OBJECT: {
-        PREAMBLE();
-        bool success = DoFieldPut<StaticObjectWrite, Primitive::kPrimNot, do_access_check>(self, shadow_frame, inst);
-        POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
-        break;
-      }
-      case Instruction::INVOKE_VIRTUAL: {
-        PREAMBLE();
-        bool success = DoInvoke<kVirtual, false, do_access_check>(self, shadow_frame, inst, &result_register);
-        POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_3xx);
-        break;
-      }
-      case Instruction::INVOKE_VIRTUAL_RANGE: {
-        PREAMBLE();
-        bool success = DoInvoke<kVirtual, true, do_access_check>(self, shadow_frame, inst, &result_register);
-        POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_3xx);
-        break;
-      }
-      case Instruction::INVOKE_SUPER: {
-        PREAMBLE();
-        bool success = DoInvoke<kSuper, false, do_access_check>(self, shadow_frame, inst, &result_register);
-        POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_3xx);
-        break;
-      }
-      case Instruction::INVOKE_SUPER_RANGE: {
-        PREAMBLE();
-        bool success = DoInvoke<kSuper, true, do_access_check>(self, shadow_frame, inst, &result_register);
-        POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_3xx);
-        break;
-      }
-      case Instruction::INVOKE_DIRECT: {
-        PREAMBLE();
-        bool success = DoInvoke<kDirect, false, do_access_check>(self, shadow_frame, inst, &result_register);
-        POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_3xx);
-        break;
-      }
-      case Instruction::INVOKE_DIRECT_RANGE: {
-        PREAMBLE();
-        bool success = DoInvoke<kDirect, true, do_access_check>(self, shadow_frame, inst, &result_register);
-        POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_3xx);
-        break;
-      }
-      case Instruction::INVOKE_INTERFACE: {
-        PREAMBLE();
-        bool success = DoInvoke<kInterface, false, do_access_check>(self, shadow_frame, inst, &result_register);
-        POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_3xx);
-        break;
-      }
-      case Instruction::INVOKE_INTERFACE_RANGE: {
-        PREAMBLE();
-        bool success = DoInvoke<kInterface, true, do_access_check>(self, shadow_frame, inst, &result_register);
-        POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_3xx);
-        break;
-      }
-      case Instruction::INVOKE_STATIC: {
-        PREAMBLE();
-        bool success = DoInvoke<kStatic, false, do_access_check>(self, shadow_frame, inst, &result_register);
-        POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_3xx);
-        break;
-      }
-      case Instruction::INVOKE_STATIC_RANGE: {
-        PREAMBLE();
-        bool success = DoInvoke<kStatic, true, do_access_check>(self, shadow_frame, inst, &result_register);
-        POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_3xx);
-        break;
-      }
-      case Instruction::INVOKE_VIRTUAL_QUICK: {
-        PREAMBLE();
-        bool success = DoInvokeVirtualQuick<false>(self, shadow_frame, inst, &result_register);
-        POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_3xx);
-        break;
-      }
-      case Instruction::INVOKE_VIRTUAL_RANGE_QUICK: {
-        PREAMBLE();
-        bool success = DoInvokeVirtualQuick<true>(self, shadow_frame, inst, &result_register);
-        POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_3xx);
-        break;
-      }
-      case Instruction::NEG_INT:
-        PREAMBLE();
-        shadow_frame.SetVReg(inst->VRegA_12x(), -shadow_frame.GetVReg(inst->VRegB_12x()));
-        inst = inst->Next_1xx();
-        break;
-      case Instruction::NOT_INT:
-        PREAMBLE();
-        shadow_frame.SetVReg(inst->VRegA_12x(), ~shadow_frame.GetVReg(inst->VRegB_12x()));
-        inst = inst->Next_1xx();
-        break;
-      case Instruction::NEG_LONG:
-        PREAMBLE();
-        shadow_frame.SetVRegLong(inst->VRegA_12x(), -shadow_frame.GetVRegLong(inst->VRegB_12x()));
-        inst = inst->Next_1xx();
-        break;
-      case Instruction::NOT_LONG:
-        PREAMBLE();
-        shadow_frame.SetVRegLong(inst->VRegA_12x(), ~shadow_frame.GetVRegLong(inst->VRegB_12x()));
-        inst = inst->Next_1xx();
-        break;
-      case Instruction::NEG_FLOAT:
-        PREAMBLE();
-        shadow_frame.SetVRegFloat(inst->VRegA_12x(), -shadow_frame.GetVRegFloat(inst->VRegB_12x()));
-        inst = inst->Next_1xx();
-        break;
-      case Instruction::NEG_DOUBLE:
-        PREAMBLE();
-        shadow_frame.SetVRegDouble(inst->VRegA_12x(), -shadow_frame.GetVRegDouble(inst->VRegB_12x()));
-        inst = inst->Next_1xx();
-        break;
-      case Instruction::INT_TO_LONG:
-        PREAMBLE();
-        shadow_frame.SetVRegLong(inst->VRegA_12x(), shadow_frame.GetVReg(inst->VRegB_12x()));
-        inst = inst->Next_1xx();
-        break;
-      case Instruction::INT_TO_FLOAT:
-        PREAMBLE();
-        shadow_frame.SetVRegFloat(inst->VRegA_12x(), shadow_frame.GetVReg(inst->VRegB_12x()));
-        inst = inst->Next_1xx();
-        break;
-      case Instruction::INT_TO_DOUBLE:
-        PREAMBLE();
-        shadow_frame.SetVRegDouble(inst->VRegA_12x(), shadow_frame.GetVReg(inst->VRegB_12x()));
-        inst = inst->Next_1xx();
-        break;
-      case Instruction::LONG_TO_INT:
-        PREAMBLE();
-        shadow_frame.SetVReg(inst->VRegA_12x(), shadow_frame.GetVRegLong(inst->VRegB_12x()));
-        inst = inst->Next_1xx();
-        break;
-      case Instruction::LONG_TO_FLOAT:
-        PREAMBLE();
-        shadow_frame.SetVRegFloat(inst->VRegA_12x(), shadow_frame.GetVRegLong(inst->VRegB_12x()));
-        inst = inst->Next_1xx();
-        break;
-      case Instruction::LONG_TO_DOUBLE:
-        PREAMBLE();
-        shadow_frame.SetVRegDouble(inst->VRegA_12x(), shadow_frame.GetVRegLong(inst->VRegB_12x()));
-        inst = inst->Next_1xx();
-        break;
-      case Instruction::FLOAT_TO_INT: {
-        PREAMBLE();
-        float val = shadow_frame.GetVRegFloat(inst->VRegB_12x());
-        int32_t result;
-        if (val != val) {
-          result = 0;
-        } else if (val > static_cast<float>(kMaxInt)) {
-          result = kMaxInt;
-        } else if (val < static_cast<float>(kMinInt)) {
-          result = kMinInt;
-        } else {
-          result = val;
-        }
-        shadow_frame.SetVReg(inst->VRegA_12x(), result);
-        inst = inst->Next_1xx();
-        break;
-      }
-      case Instruction::FLOAT_TO_LONG: {
-        PREAMBLE();
-        float val = shadow_frame.GetVRegFloat(inst->VRegB_12x());
-        int64_t result;
-        if (val != val) {
-          result = 0;
-        } else if (val > static_cast<float>(kMaxLong)) {
-          result = kMaxLong;
-        } else if (val < static_cast<float>(kMinLong)) {
-          result = kMinLong;
-        } else {
-          result = val;
-        }
-        shadow_frame.SetVRegLong(inst->VRegA_12x(), result);
-        inst = inst->Next_1xx();
-        break;
-      }
-      case Instruction::FLOAT_TO_DOUBLE:
-        PREAMBLE();
-        shadow_frame.SetVRegDouble(inst->VRegA_12x(), shadow_frame.GetVRegFloat(inst->VRegB_12x()));
-        inst = inst->Next_1xx();
-        break;
-      case Instruction::DOUBLE_TO_INT: {
-        PREAMBLE();
-        double val = shadow_frame.GetVRegDouble(inst->VRegB_12x());
-        int32_t result;
-        if (val != val) {
-          result = 0;
-        } else if (val > static_cast<double>(kMaxInt)) {
-          result = kMaxInt;
-        } else if (val < static_cast<double>(kMinInt)) {
-          result = kMinInt;
-        } else {
-          result = val;
-        }
-        shadow_frame.SetVReg(inst->VRegA_12x(), result);
-        inst = inst->Next_1xx();
-        break;
-      }
-      case Instruction::DOUBLE_TO_LONG: {
-        PREAMBLE();
-        double val = shadow_frame.GetVRegDouble(inst->VRegB_12x());
-        int64_t result;
-        if (val != val) {
-          result = 0;
-        } else if (val > static_cast<double>(kMaxLong)) {
-          result = kMaxLong;
-        } else if (val < static_cast<double>(kMinLong)) {
-          result = kMinLong;
-        } else {
-          result = val;
-        }
-        shadow_frame.SetVRegLong(inst->VRegA_12x(), result);
-        inst = inst->Next_1xx();
-        break;
-      }
-      case Instruction::DOUBLE_TO_FLOAT:
-        PREAMBLE();
-        shadow_frame.SetVRegFloat(inst->VRegA_12x(), shadow_frame.GetVRegDouble(inst->VRegB_12x()));
-        inst = inst->Next_1xx();
-        break;
-      case Instruction::INT_TO_BYTE:
-        PREAMBLE();
-        shadow_frame.SetVReg(inst->VRegA_12x(),
-                             static_cast<int8_t>(shadow_frame.GetVReg(inst->VRegB_12x())));
-        inst = inst->Next_1xx();
-        break;
-      case Instruction::INT_TO_CHAR:
-        PREAMBLE();
-        shadow_frame.SetVReg(inst->VRegA_12x(),
-                             static_cast<uint16_t>(shadow_frame.GetVReg(inst->VRegB_12x())));
-        inst = inst->Next_1xx();
-        break;
-      case Instruction::INT_TO_SHORT:
-        PREAMBLE();
-        shadow_frame.SetVReg(inst->VRegA_12x(),
-                             static_cast<int16_t>(shadow_frame.GetVReg(inst->VRegB_12x())));
-        inst = inst->Next_1xx();
-        break;
-      case Instruction::ADD_INT:
-        PREAMBLE();
-        shadow_frame.SetVReg(inst->VRegA_23x(),
-                             shadow_frame.GetVReg(inst->VRegB_23x()) +
-                             shadow_frame.GetVReg(inst->VRegC_23x()));
-        inst = inst->Next_2xx();
-        break;
-      case Instruction::SUB_INT:
-        PREAMBLE();
-        shadow_frame.SetVReg(inst->VRegA_23x(),
-                             shadow_frame.GetVReg(inst->VRegB_23x()) -
-                             shadow_frame.GetVReg(inst->VRegC_23x()));
-        inst = inst->Next_2xx();
-        break;
-      case Instruction::MUL_INT:
-        PREAMBLE();
-        shadow_frame.SetVReg(inst->VRegA_23x(),
-                             shadow_frame.GetVReg(inst->VRegB_23x()) *
-                             shadow_frame.GetVReg(inst->VRegC_23x()));
-        inst = inst->Next_2xx();
-        break;
-      case Instruction::DIV_INT: {
-        PREAMBLE();
-        bool success = DoIntDivide(shadow_frame, inst->VRegA_23x(),
-                                   shadow_frame.GetVReg(inst->VRegB_23x()),
-                                   shadow_frame.GetVReg(inst->VRegC_23x()));
-        POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
-        break;
-      }
-      case Instruction::REM_INT: {
-        PREAMBLE();
-        bool success = DoIntRemainder(shadow_frame, inst->VRegA_23x(),
-                                      shadow_frame.GetVReg(inst->VRegB_23x()),
-                                      shadow_frame.GetVReg(inst->VRegC_23x()));
-        POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
-        break;
-      }
-      case Instruction::SHL_INT:
-        PREAMBLE();
-        shadow_frame.SetVReg(inst->VRegA_23x(),
-                             shadow_frame.GetVReg(inst->VRegB_23x()) <<
-                             (shadow_frame.GetVReg(inst->VRegC_23x()) & 0x1f));
-        inst = inst->Next_2xx();
-        break;
-      case Instruction::SHR_INT:
-        PREAMBLE();
-        shadow_frame.SetVReg(inst->VRegA_23x(),
-                             shadow_frame.GetVReg(inst->VRegB_23x()) >>
-                             (shadow_frame.GetVReg(inst->VRegC_23x()) & 0x1f));
-        inst = inst->Next_2xx();
-        break;
-      case Instruction::USHR_INT:
-        PREAMBLE();
-        shadow_frame.SetVReg(inst->VRegA_23x(),
-                             static_cast<uint32_t>(shadow_frame.GetVReg(inst->VRegB_23x())) >>
-                             (shadow_frame.GetVReg(inst->VRegC_23x()) & 0x1f));
-        inst = inst->Next_2xx();
-        break;
-      case Instruction::AND_INT:
-        PREAMBLE();
-        shadow_frame.SetVReg(inst->VRegA_23x(),
-                             shadow_frame.GetVReg(inst->VRegB_23x()) &
-                             shadow_frame.GetVReg(inst->VRegC_23x()));
-        inst = inst->Next_2xx();
-        break;
-      case Instruction::OR_INT:
-        PREAMBLE();
-        shadow_frame.SetVReg(inst->VRegA_23x(),
-                             shadow_frame.GetVReg(inst->VRegB_23x()) |
-                             shadow_frame.GetVReg(inst->VRegC_23x()));
-        inst = inst->Next_2xx();
-        break;
-      case Instruction::XOR_INT:
-        PREAMBLE();
-        shadow_frame.SetVReg(inst->VRegA_23x(),
-                             shadow_frame.GetVReg(inst->VRegB_23x()) ^
-                             shadow_frame.GetVReg(inst->VRegC_23x()));
-        inst = inst->Next_2xx();
-        break;
-      case Instruction::ADD_LONG:
-        PREAMBLE();
-        shadow_frame.SetVRegLong(inst->VRegA_23x(),
-                                 shadow_frame.GetVRegLong(inst->VRegB_23x()) +
-                                 shadow_frame.GetVRegLong(inst->VRegC_23x()));
-        inst = inst->Next_2xx();
-        break;
-      case Instruction::SUB_LONG:
-        PREAMBLE();
-        shadow_frame.SetVRegLong(inst->VRegA_23x(),
-                                 shadow_frame.GetVRegLong(inst->VRegB_23x()) -
-                                 shadow_frame.GetVRegLong(inst->VRegC_23x()));
-        inst = inst->Next_2xx();
-        break;
-      case Instruction::MUL_LONG:
-        PREAMBLE();
-        shadow_frame.SetVRegLong(inst->VRegA_23x(),
-                                 shadow_frame.GetVRegLong(inst->VRegB_23x()) *
-                                 shadow_frame.GetVRegLong(inst->VRegC_23x()));
-        inst = inst->Next_2xx();
-        break;
-      case Instruction::DIV_LONG:
-        PREAMBLE();
-        DoLongDivide(shadow_frame, inst->VRegA_23x(),
-                     shadow_frame.GetVRegLong(inst->VRegB_23x()),
+    }
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(INSTANCE_OF) {
+    PREAMBLE();
+    Class* c = ResolveVerifyAndClinit(inst->VRegC_22c(), shadow_frame.GetMethod(),
+                                      self, false, do_access_check);
+    if (UNLIKELY(c == NULL)) {
+      HANDLE_PENDING_EXCEPTION();
+    } else {
+      Object* obj = shadow_frame.GetVRegReference(inst->VRegB_22c());
+      shadow_frame.SetVReg(inst->VRegA_22c(), (obj != NULL && obj->InstanceOf(c)) ? 1 : 0);
+      inst = inst->Next_2xx();
+    }
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(ARRAY_LENGTH) {
+    PREAMBLE();
+    Object* array = shadow_frame.GetVRegReference(inst->VRegB_12x());
+    if (UNLIKELY(array == NULL)) {
+      ThrowNullPointerExceptionFromDexPC(shadow_frame.GetCurrentLocationForThrow());
+      HANDLE_PENDING_EXCEPTION();
+    } else {
+      shadow_frame.SetVReg(inst->VRegA_12x(), array->AsArray()->GetLength());
+      inst = inst->Next_1xx();
+    }
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(NEW_INSTANCE) {
+    PREAMBLE();
+    Object* obj = AllocObjectFromCode(inst->VRegB_21c(), shadow_frame.GetMethod(),
+                                      self, do_access_check);
+    if (UNLIKELY(obj == NULL)) {
+      HANDLE_PENDING_EXCEPTION();
+    } else {
+      shadow_frame.SetVRegReference(inst->VRegA_21c(), obj);
+      inst = inst->Next_2xx();
+    }
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(NEW_ARRAY) {
+    PREAMBLE();
+    int32_t length = shadow_frame.GetVReg(inst->VRegB_22c());
+    Object* obj = AllocArrayFromCode(inst->VRegC_22c(), shadow_frame.GetMethod(),
+                                     length, self, do_access_check);
+    if (UNLIKELY(obj == NULL)) {
+      HANDLE_PENDING_EXCEPTION();
+    } else {
+      shadow_frame.SetVRegReference(inst->VRegA_22c(), obj);
+      inst = inst->Next_2xx();
+    }
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(FILLED_NEW_ARRAY) {
+    PREAMBLE();
+    bool success = DoFilledNewArray<false, do_access_check>(inst, shadow_frame,
+                                                            self, &result_register);
+    POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_3xx);
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(FILLED_NEW_ARRAY_RANGE) {
+    PREAMBLE();
+    bool success = DoFilledNewArray<true, do_access_check>(inst, shadow_frame,
+                                                           self, &result_register);
+    POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_3xx);
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(FILL_ARRAY_DATA) {
+    PREAMBLE();
+    Object* obj = shadow_frame.GetVRegReference(inst->VRegA_31t());
+    if (UNLIKELY(obj == NULL)) {
+      ThrowNullPointerException(NULL, "null array in FILL_ARRAY_DATA");
+      HANDLE_PENDING_EXCEPTION();
+      HANDLE_INSTRUCTION_END();
+    }
+    Array* array = obj->AsArray();
+    DCHECK(array->IsArrayInstance() && !array->IsObjectArray());
+    const uint16_t* payload_addr = reinterpret_cast<const uint16_t*>(inst) + inst->VRegB_31t();
+    const Instruction::ArrayDataPayload* payload =
+        reinterpret_cast<const Instruction::ArrayDataPayload*>(payload_addr);
+    if (UNLIKELY(static_cast<int32_t>(payload->element_count) > array->GetLength())) {
+      self->ThrowNewExceptionF(shadow_frame.GetCurrentLocationForThrow(),
+                               "Ljava/lang/ArrayIndexOutOfBoundsException;",
+                               "failed FILL_ARRAY_DATA; length=%d, index=%d",
+                               array->GetLength(), payload->element_count);
+      HANDLE_PENDING_EXCEPTION();
+      HANDLE_INSTRUCTION_END();
+    }
+    uint32_t size_in_bytes = payload->element_count * payload->element_width;
+    memcpy(array->GetRawData(payload->element_width), payload->data, size_in_bytes);
+    inst = inst->Next_3xx();
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(THROW) {
+    PREAMBLE();
+    Object* exception = shadow_frame.GetVRegReference(inst->VRegA_11x());
+    if (UNLIKELY(exception == NULL)) {
+      ThrowNullPointerException(NULL, "throw with null exception");
+    } else if (do_assignability_check && !exception->GetClass()->IsThrowableClass()) {
+      // This should never happen.
+      self->ThrowNewExceptionF(self->GetCurrentLocationForThrow(),
+                               "Ljava/lang/VirtualMachineError;",
+                               "Throwing '%s' that is not instance of Throwable",
+                               ClassHelper(exception->GetClass()).GetDescriptor());
+    } else {
+      self->SetException(shadow_frame.GetCurrentLocationForThrow(), exception->AsThrowable());
+    }
+    HANDLE_PENDING_EXCEPTION();
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(GOTO) {
+    PREAMBLE();
+    inst = inst->RelativeAt(inst->VRegA_10t());
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(GOTO_16) {
+    PREAMBLE();
+    inst = inst->RelativeAt(inst->VRegA_20t());
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(GOTO_32) {
+    PREAMBLE();
+    inst = inst->RelativeAt(inst->VRegA_30t());
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(PACKED_SWITCH) {
+    PREAMBLE();
+    const uint16_t* switch_data = reinterpret_cast<const uint16_t*>(inst) + inst->VRegB_31t();
+    int32_t test_val = shadow_frame.GetVReg(inst->VRegA_31t());
+    DCHECK_EQ(switch_data[0], static_cast<uint16_t>(Instruction::kPackedSwitchSignature));
+    uint16_t size = switch_data[1];
+    DCHECK_GT(size, 0);
+    const int32_t* keys = reinterpret_cast<const int32_t*>(&switch_data[2]);
+    DCHECK(IsAligned<4>(keys));
+    int32_t first_key = keys[0];
+    const int32_t* targets = reinterpret_cast<const int32_t*>(&switch_data[4]);
+    DCHECK(IsAligned<4>(targets));
+    int32_t index = test_val - first_key;
+    if (index >= 0 && index < size) {
+      inst = inst->RelativeAt(targets[index]);
+    } else {
+      inst = inst->Next_3xx();
+    }
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(SPARSE_SWITCH) {
+    PREAMBLE();
+    inst = DoSparseSwitch(inst, shadow_frame);
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(CMPL_FLOAT) {
+    PREAMBLE();
+    float val1 = shadow_frame.GetVRegFloat(inst->VRegB_23x());
+    float val2 = shadow_frame.GetVRegFloat(inst->VRegC_23x());
+    int32_t result;
+    if (val1 > val2) {
+      result = 1;
+    } else if (val1 == val2) {
+      result = 0;
+    } else {
+      result = -1;
+    }
+    shadow_frame.SetVReg(inst->VRegA_23x(), result);
+    inst = inst->Next_2xx();
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(CMPG_FLOAT) {
+    PREAMBLE();
+    float val1 = shadow_frame.GetVRegFloat(inst->VRegB_23x());
+    float val2 = shadow_frame.GetVRegFloat(inst->VRegC_23x());
+    int32_t result;
+    if (val1 < val2) {
+      result = -1;
+    } else if (val1 == val2) {
+      result = 0;
+    } else {
+      result = 1;
+    }
+    shadow_frame.SetVReg(inst->VRegA_23x(), result);
+    inst = inst->Next_2xx();
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(CMPL_DOUBLE) {
+    PREAMBLE();
+    double val1 = shadow_frame.GetVRegDouble(inst->VRegB_23x());
+    double val2 = shadow_frame.GetVRegDouble(inst->VRegC_23x());
+    int32_t result;
+    if (val1 > val2) {
+      result = 1;
+    } else if (val1 == val2) {
+      result = 0;
+    } else {
+      result = -1;
+    }
+    shadow_frame.SetVReg(inst->VRegA_23x(), result);
+    inst = inst->Next_2xx();
+    HANDLE_INSTRUCTION_END();
+  }
+
+  HANDLE_INSTRUCTION_START(CMPG_DOUBLE) {
+    PREAMBLE();
+    double val1 = shadow_frame.GetVRegDouble(inst->VRegB_23x());
+    double val2 = shadow_frame.GetVRegDouble(inst->VRegC_23x());
+    int32_t result;
+    if (val1 < val2) {
+      result = -1;
+    } else if (val1 == val2) {
+      result = 0;
+    } else {
+      result = 1;
+    }
+    shadow_frame.SetVReg(inst->VRegA_23x(), result);
+    inst = inst->Next_2xx();
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(CMP_LONG) {
+    PREAMBLE();
+    int64_t val1 = shadow_frame.GetVRegLong(inst->VRegB_23x());
+    int64_t val2 = shadow_frame.GetVRegLong(inst->VRegC_23x());
+    int32_t result;
+    if (val1 > val2) {
+      result = 1;
+    } else if (val1 == val2) {
+      result = 0;
+    } else {
+      result = -1;
+    }
+    shadow_frame.SetVReg(inst->VRegA_23x(), result);
+    inst = inst->Next_2xx();
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(IF_EQ) {
+    PREAMBLE();
+    if (shadow_frame.GetVReg(inst->VRegA_22t()) == shadow_frame.GetVReg(inst->VRegB_22t())) {
+      inst = inst->RelativeAt(inst->VRegC_22t());
+    } else {
+      inst = inst->Next_2xx();
+    }
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(IF_NE) {
+    PREAMBLE();
+    if (shadow_frame.GetVReg(inst->VRegA_22t()) != shadow_frame.GetVReg(inst->VRegB_22t())) {
+      inst = inst->RelativeAt(inst->VRegC_22t());
+    } else {
+      inst = inst->Next_2xx();
+    }
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(IF_LT) {
+    PREAMBLE();
+    if (shadow_frame.GetVReg(inst->VRegA_22t()) < shadow_frame.GetVReg(inst->VRegB_22t())) {
+      inst = inst->RelativeAt(inst->VRegC_22t());
+    } else {
+      inst = inst->Next_2xx();
+    }
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(IF_GE) {
+    PREAMBLE();
+    if (shadow_frame.GetVReg(inst->VRegA_22t()) >= shadow_frame.GetVReg(inst->VRegB_22t())) {
+      inst = inst->RelativeAt(inst->VRegC_22t());
+    } else {
+      inst = inst->Next_2xx();
+    }
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(IF_GT) {
+    PREAMBLE();
+    if (shadow_frame.GetVReg(inst->VRegA_22t()) > shadow_frame.GetVReg(inst->VRegB_22t())) {
+      inst = inst->RelativeAt(inst->VRegC_22t());
+    } else {
+      inst = inst->Next_2xx();
+    }
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(IF_LE) {
+    PREAMBLE();
+    if (shadow_frame.GetVReg(inst->VRegA_22t()) <= shadow_frame.GetVReg(inst->VRegB_22t())) {
+      inst = inst->RelativeAt(inst->VRegC_22t());
+    } else {
+      inst = inst->Next_2xx();
+    }
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(IF_EQZ) {
+    PREAMBLE();
+    if (shadow_frame.GetVReg(inst->VRegA_21t()) == 0) {
+      inst = inst->RelativeAt(inst->VRegB_21t());
+    } else {
+      inst = inst->Next_2xx();
+    }
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(IF_NEZ) {
+    PREAMBLE();
+    if (shadow_frame.GetVReg(inst->VRegA_21t()) != 0) {
+      inst = inst->RelativeAt(inst->VRegB_21t());
+    } else {
+      inst = inst->Next_2xx();
+    }
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(IF_LTZ) {
+    PREAMBLE();
+    if (shadow_frame.GetVReg(inst->VRegA_21t()) < 0) {
+      inst = inst->RelativeAt(inst->VRegB_21t());
+    } else {
+      inst = inst->Next_2xx();
+    }
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(IF_GEZ) {
+    PREAMBLE();
+    if (shadow_frame.GetVReg(inst->VRegA_21t()) >= 0) {
+      inst = inst->RelativeAt(inst->VRegB_21t());
+    } else {
+      inst = inst->Next_2xx();
+    }
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(IF_GTZ) {
+    PREAMBLE();
+    if (shadow_frame.GetVReg(inst->VRegA_21t()) > 0) {
+      inst = inst->RelativeAt(inst->VRegB_21t());
+    } else {
+      inst = inst->Next_2xx();
+    }
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(IF_LEZ) {
+    PREAMBLE();
+    if (shadow_frame.GetVReg(inst->VRegA_21t()) <= 0) {
+      inst = inst->RelativeAt(inst->VRegB_21t());
+    } else {
+      inst = inst->Next_2xx();
+    }
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(AGET_BOOLEAN) {
+    PREAMBLE();
+    Object* a = shadow_frame.GetVRegReference(inst->VRegB_23x());
+    if (UNLIKELY(a == NULL)) {
+      ThrowNullPointerExceptionFromDexPC(shadow_frame.GetCurrentLocationForThrow());
+      HANDLE_PENDING_EXCEPTION();
+      HANDLE_INSTRUCTION_END();
+    }
+    int32_t index = shadow_frame.GetVReg(inst->VRegC_23x());
+    BooleanArray* array = a->AsBooleanArray();
+    if (LIKELY(array->IsValidIndex(index))) {
+      shadow_frame.SetVReg(inst->VRegA_23x(), array->GetData()[index]);
+      inst = inst->Next_2xx();
+    } else {
+      HANDLE_PENDING_EXCEPTION();
+    }
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(AGET_BYTE) {
+    PREAMBLE();
+    Object* a = shadow_frame.GetVRegReference(inst->VRegB_23x());
+    if (UNLIKELY(a == NULL)) {
+      ThrowNullPointerExceptionFromDexPC(shadow_frame.GetCurrentLocationForThrow());
+      HANDLE_PENDING_EXCEPTION();
+      HANDLE_INSTRUCTION_END();
+    }
+    int32_t index = shadow_frame.GetVReg(inst->VRegC_23x());
+    ByteArray* array = a->AsByteArray();
+    if (LIKELY(array->IsValidIndex(index))) {
+      shadow_frame.SetVReg(inst->VRegA_23x(), array->GetData()[index]);
+      inst = inst->Next_2xx();
+    } else {
+      HANDLE_PENDING_EXCEPTION();
+    }
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(AGET_CHAR) {
+    PREAMBLE();
+    Object* a = shadow_frame.GetVRegReference(inst->VRegB_23x());
+    if (UNLIKELY(a == NULL)) {
+      ThrowNullPointerExceptionFromDexPC(shadow_frame.GetCurrentLocationForThrow());
+      HANDLE_PENDING_EXCEPTION();
+      HANDLE_INSTRUCTION_END();
+    }
+    int32_t index = shadow_frame.GetVReg(inst->VRegC_23x());
+    CharArray* array = a->AsCharArray();
+    if (LIKELY(array->IsValidIndex(index))) {
+      shadow_frame.SetVReg(inst->VRegA_23x(), array->GetData()[index]);
+      inst = inst->Next_2xx();
+    } else {
+      HANDLE_PENDING_EXCEPTION();
+    }
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(AGET_SHORT) {
+    PREAMBLE();
+    Object* a = shadow_frame.GetVRegReference(inst->VRegB_23x());
+    if (UNLIKELY(a == NULL)) {
+      ThrowNullPointerExceptionFromDexPC(shadow_frame.GetCurrentLocationForThrow());
+      HANDLE_PENDING_EXCEPTION();
+      HANDLE_INSTRUCTION_END();
+    }
+    int32_t index = shadow_frame.GetVReg(inst->VRegC_23x());
+    ShortArray* array = a->AsShortArray();
+    if (LIKELY(array->IsValidIndex(index))) {
+      shadow_frame.SetVReg(inst->VRegA_23x(), array->GetData()[index]);
+      inst = inst->Next_2xx();
+    } else {
+      HANDLE_PENDING_EXCEPTION();
+    }
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(AGET) {
+    PREAMBLE();
+    Object* a = shadow_frame.GetVRegReference(inst->VRegB_23x());
+    if (UNLIKELY(a == NULL)) {
+      ThrowNullPointerExceptionFromDexPC(shadow_frame.GetCurrentLocationForThrow());
+      HANDLE_PENDING_EXCEPTION();
+      HANDLE_INSTRUCTION_END();
+    }
+    int32_t index = shadow_frame.GetVReg(inst->VRegC_23x());
+    IntArray* array = a->AsIntArray();
+    if (LIKELY(array->IsValidIndex(index))) {
+      shadow_frame.SetVReg(inst->VRegA_23x(), array->GetData()[index]);
+      inst = inst->Next_2xx();
+    } else {
+      HANDLE_PENDING_EXCEPTION();
+    }
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(AGET_WIDE) {
+    PREAMBLE();
+    Object* a = shadow_frame.GetVRegReference(inst->VRegB_23x());
+    if (UNLIKELY(a == NULL)) {
+      ThrowNullPointerExceptionFromDexPC(shadow_frame.GetCurrentLocationForThrow());
+      HANDLE_PENDING_EXCEPTION();
+      HANDLE_INSTRUCTION_END();
+    }
+    int32_t index = shadow_frame.GetVReg(inst->VRegC_23x());
+    LongArray* array = a->AsLongArray();
+    if (LIKELY(array->IsValidIndex(index))) {
+      shadow_frame.SetVRegLong(inst->VRegA_23x(), array->GetData()[index]);
+      inst = inst->Next_2xx();
+    } else {
+      HANDLE_PENDING_EXCEPTION();
+    }
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(AGET_OBJECT) {
+    PREAMBLE();
+    Object* a = shadow_frame.GetVRegReference(inst->VRegB_23x());
+    if (UNLIKELY(a == NULL)) {
+      ThrowNullPointerExceptionFromDexPC(shadow_frame.GetCurrentLocationForThrow());
+      HANDLE_PENDING_EXCEPTION();
+      HANDLE_INSTRUCTION_END();
+    }
+    int32_t index = shadow_frame.GetVReg(inst->VRegC_23x());
+    ObjectArray<Object>* array = a->AsObjectArray<Object>();
+    if (LIKELY(array->IsValidIndex(index))) {
+      shadow_frame.SetVRegReference(inst->VRegA_23x(), array->GetWithoutChecks(index));
+      inst = inst->Next_2xx();
+    } else {
+      HANDLE_PENDING_EXCEPTION();
+    }
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(APUT_BOOLEAN) {
+    PREAMBLE();
+    Object* a = shadow_frame.GetVRegReference(inst->VRegB_23x());
+    if (UNLIKELY(a == NULL)) {
+      ThrowNullPointerExceptionFromDexPC(shadow_frame.GetCurrentLocationForThrow());
+      HANDLE_PENDING_EXCEPTION();
+      HANDLE_INSTRUCTION_END();
+    }
+    uint8_t val = shadow_frame.GetVReg(inst->VRegA_23x());
+    int32_t index = shadow_frame.GetVReg(inst->VRegC_23x());
+    BooleanArray* array = a->AsBooleanArray();
+    if (LIKELY(array->IsValidIndex(index))) {
+      array->GetData()[index] = val;
+      inst = inst->Next_2xx();
+    } else {
+      HANDLE_PENDING_EXCEPTION();
+    }
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(APUT_BYTE) {
+    PREAMBLE();
+    Object* a = shadow_frame.GetVRegReference(inst->VRegB_23x());
+    if (UNLIKELY(a == NULL)) {
+      ThrowNullPointerExceptionFromDexPC(shadow_frame.GetCurrentLocationForThrow());
+      HANDLE_PENDING_EXCEPTION();
+      HANDLE_INSTRUCTION_END();
+    }
+    int8_t val = shadow_frame.GetVReg(inst->VRegA_23x());
+    int32_t index = shadow_frame.GetVReg(inst->VRegC_23x());
+    ByteArray* array = a->AsByteArray();
+    if (LIKELY(array->IsValidIndex(index))) {
+      array->GetData()[index] = val;
+      inst = inst->Next_2xx();
+    } else {
+      HANDLE_PENDING_EXCEPTION();
+    }
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(APUT_CHAR) {
+    PREAMBLE();
+    Object* a = shadow_frame.GetVRegReference(inst->VRegB_23x());
+    if (UNLIKELY(a == NULL)) {
+      ThrowNullPointerExceptionFromDexPC(shadow_frame.GetCurrentLocationForThrow());
+      HANDLE_PENDING_EXCEPTION();
+      HANDLE_INSTRUCTION_END();
+    }
+    uint16_t val = shadow_frame.GetVReg(inst->VRegA_23x());
+    int32_t index = shadow_frame.GetVReg(inst->VRegC_23x());
+    CharArray* array = a->AsCharArray();
+    if (LIKELY(array->IsValidIndex(index))) {
+      array->GetData()[index] = val;
+      inst = inst->Next_2xx();
+    } else {
+      HANDLE_PENDING_EXCEPTION();
+    }
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(APUT_SHORT) {
+    PREAMBLE();
+    Object* a = shadow_frame.GetVRegReference(inst->VRegB_23x());
+    if (UNLIKELY(a == NULL)) {
+      ThrowNullPointerExceptionFromDexPC(shadow_frame.GetCurrentLocationForThrow());
+      HANDLE_PENDING_EXCEPTION();
+      HANDLE_INSTRUCTION_END();
+    }
+    int16_t val = shadow_frame.GetVReg(inst->VRegA_23x());
+    int32_t index = shadow_frame.GetVReg(inst->VRegC_23x());
+    ShortArray* array = a->AsShortArray();
+    if (LIKELY(array->IsValidIndex(index))) {
+      array->GetData()[index] = val;
+      inst = inst->Next_2xx();
+    } else {
+      HANDLE_PENDING_EXCEPTION();
+    }
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(APUT) {
+    PREAMBLE();
+    Object* a = shadow_frame.GetVRegReference(inst->VRegB_23x());
+    if (UNLIKELY(a == NULL)) {
+      ThrowNullPointerExceptionFromDexPC(shadow_frame.GetCurrentLocationForThrow());
+      HANDLE_PENDING_EXCEPTION();
+      HANDLE_INSTRUCTION_END();
+    }
+    int32_t val = shadow_frame.GetVReg(inst->VRegA_23x());
+    int32_t index = shadow_frame.GetVReg(inst->VRegC_23x());
+    IntArray* array = a->AsIntArray();
+    if (LIKELY(array->IsValidIndex(index))) {
+      array->GetData()[index] = val;
+      inst = inst->Next_2xx();
+    } else {
+      HANDLE_PENDING_EXCEPTION();
+    }
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(APUT_WIDE) {
+    PREAMBLE();
+    Object* a = shadow_frame.GetVRegReference(inst->VRegB_23x());
+    if (UNLIKELY(a == NULL)) {
+      ThrowNullPointerExceptionFromDexPC(shadow_frame.GetCurrentLocationForThrow());
+      HANDLE_PENDING_EXCEPTION();
+      HANDLE_INSTRUCTION_END();
+    }
+    int64_t val = shadow_frame.GetVRegLong(inst->VRegA_23x());
+    int32_t index = shadow_frame.GetVReg(inst->VRegC_23x());
+    LongArray* array = a->AsLongArray();
+    if (LIKELY(array->IsValidIndex(index))) {
+      array->GetData()[index] = val;
+      inst = inst->Next_2xx();
+    } else {
+      HANDLE_PENDING_EXCEPTION();
+    }
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(APUT_OBJECT) {
+    PREAMBLE();
+    Object* a = shadow_frame.GetVRegReference(inst->VRegB_23x());
+    if (UNLIKELY(a == NULL)) {
+      ThrowNullPointerExceptionFromDexPC(shadow_frame.GetCurrentLocationForThrow());
+      HANDLE_PENDING_EXCEPTION();
+      HANDLE_INSTRUCTION_END();
+    }
+    int32_t index = shadow_frame.GetVReg(inst->VRegC_23x());
+    Object* val = shadow_frame.GetVRegReference(inst->VRegA_23x());
+    ObjectArray<Object>* array = a->AsObjectArray<Object>();
+    if (LIKELY(array->IsValidIndex(index) && array->CheckAssignable(val))) {
+      array->SetWithoutChecks(index, val);
+      inst = inst->Next_2xx();
+    } else {
+      HANDLE_PENDING_EXCEPTION();
+    }
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(IGET_BOOLEAN) {
+    PREAMBLE();
+    bool success = DoFieldGet<InstancePrimitiveRead, Primitive::kPrimBoolean, do_access_check>(self, shadow_frame, inst);
+    POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(IGET_BYTE) {
+    PREAMBLE();
+    bool success = DoFieldGet<InstancePrimitiveRead, Primitive::kPrimByte, do_access_check>(self, shadow_frame, inst);
+    POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(IGET_CHAR) {
+    PREAMBLE();
+    bool success = DoFieldGet<InstancePrimitiveRead, Primitive::kPrimChar, do_access_check>(self, shadow_frame, inst);
+    POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(IGET_SHORT) {
+    PREAMBLE();
+    bool success = DoFieldGet<InstancePrimitiveRead, Primitive::kPrimShort, do_access_check>(self, shadow_frame, inst);
+    POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(IGET) {
+    PREAMBLE();
+    bool success = DoFieldGet<InstancePrimitiveRead, Primitive::kPrimInt, do_access_check>(self, shadow_frame, inst);
+    POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(IGET_WIDE) {
+    PREAMBLE();
+    bool success = DoFieldGet<InstancePrimitiveRead, Primitive::kPrimLong, do_access_check>(self, shadow_frame, inst);
+    POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(IGET_OBJECT) {
+    PREAMBLE();
+    bool success = DoFieldGet<InstanceObjectRead, Primitive::kPrimNot, do_access_check>(self, shadow_frame, inst);
+    POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(IGET_QUICK) {
+    PREAMBLE();
+    bool success = DoIGetQuick<Primitive::kPrimInt>(self, shadow_frame, inst);
+    POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(IGET_WIDE_QUICK) {
+    PREAMBLE();
+    bool success = DoIGetQuick<Primitive::kPrimLong>(self, shadow_frame, inst);
+    POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(IGET_OBJECT_QUICK) {
+    PREAMBLE();
+    bool success = DoIGetQuick<Primitive::kPrimNot>(self, shadow_frame, inst);
+    POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(SGET_BOOLEAN) {
+    PREAMBLE();
+    bool success = DoFieldGet<StaticPrimitiveRead, Primitive::kPrimBoolean, do_access_check>(self, shadow_frame, inst);
+    POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(SGET_BYTE) {
+    PREAMBLE();
+    bool success = DoFieldGet<StaticPrimitiveRead, Primitive::kPrimByte, do_access_check>(self, shadow_frame, inst);
+    POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(SGET_CHAR) {
+    PREAMBLE();
+    bool success = DoFieldGet<StaticPrimitiveRead, Primitive::kPrimChar, do_access_check>(self, shadow_frame, inst);
+    POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(SGET_SHORT) {
+    PREAMBLE();
+    bool success = DoFieldGet<StaticPrimitiveRead, Primitive::kPrimShort, do_access_check>(self, shadow_frame, inst);
+    POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(SGET) {
+    PREAMBLE();
+    bool success = DoFieldGet<StaticPrimitiveRead, Primitive::kPrimInt, do_access_check>(self, shadow_frame, inst);
+    POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(SGET_WIDE) {
+    PREAMBLE();
+    bool success = DoFieldGet<StaticPrimitiveRead, Primitive::kPrimLong, do_access_check>(self, shadow_frame, inst);
+    POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(SGET_OBJECT) {
+    PREAMBLE();
+    bool success = DoFieldGet<StaticObjectRead, Primitive::kPrimNot, do_access_check>(self, shadow_frame, inst);
+    POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(IPUT_BOOLEAN) {
+    PREAMBLE();
+    bool success = DoFieldPut<InstancePrimitiveWrite, Primitive::kPrimBoolean, do_access_check>(self, shadow_frame, inst);
+    POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(IPUT_BYTE) {
+    PREAMBLE();
+    bool success = DoFieldPut<InstancePrimitiveWrite, Primitive::kPrimByte, do_access_check>(self, shadow_frame, inst);
+    POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(IPUT_CHAR) {
+    PREAMBLE();
+    bool success = DoFieldPut<InstancePrimitiveWrite, Primitive::kPrimChar, do_access_check>(self, shadow_frame, inst);
+    POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(IPUT_SHORT) {
+    PREAMBLE();
+    bool success = DoFieldPut<InstancePrimitiveWrite, Primitive::kPrimShort, do_access_check>(self, shadow_frame, inst);
+    POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(IPUT) {
+    PREAMBLE();
+    bool success = DoFieldPut<InstancePrimitiveWrite, Primitive::kPrimInt, do_access_check>(self, shadow_frame, inst);
+    POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(IPUT_WIDE) {
+    PREAMBLE();
+    bool success = DoFieldPut<InstancePrimitiveWrite, Primitive::kPrimLong, do_access_check>(self, shadow_frame, inst);
+    POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(IPUT_OBJECT) {
+    PREAMBLE();
+    bool success = DoFieldPut<InstanceObjectWrite, Primitive::kPrimNot, do_access_check>(self, shadow_frame, inst);
+    POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(IPUT_QUICK) {
+    PREAMBLE();
+    bool success = DoIPutQuick<Primitive::kPrimInt>(self, shadow_frame, inst);
+    POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(IPUT_WIDE_QUICK) {
+    PREAMBLE();
+    bool success = DoIPutQuick<Primitive::kPrimLong>(self, shadow_frame, inst);
+    POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(IPUT_OBJECT_QUICK) {
+    PREAMBLE();
+    bool success = DoIPutQuick<Primitive::kPrimNot>(self, shadow_frame, inst);
+    POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(SPUT_BOOLEAN) {
+    PREAMBLE();
+    bool success = DoFieldPut<StaticPrimitiveWrite, Primitive::kPrimBoolean, do_access_check>(self, shadow_frame, inst);
+    POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(SPUT_BYTE) {
+    PREAMBLE();
+    bool success = DoFieldPut<StaticPrimitiveWrite, Primitive::kPrimByte, do_access_check>(self, shadow_frame, inst);
+    POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(SPUT_CHAR) {
+    PREAMBLE();
+    bool success = DoFieldPut<StaticPrimitiveWrite, Primitive::kPrimChar, do_access_check>(self, shadow_frame, inst);
+    POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(SPUT_SHORT) {
+    PREAMBLE();
+    bool success = DoFieldPut<StaticPrimitiveWrite, Primitive::kPrimShort, do_access_check>(self, shadow_frame, inst);
+    POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(SPUT) {
+    PREAMBLE();
+    bool success = DoFieldPut<StaticPrimitiveWrite, Primitive::kPrimInt, do_access_check>(self, shadow_frame, inst);
+    POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(SPUT_WIDE) {
+    PREAMBLE();
+    bool success = DoFieldPut<StaticPrimitiveWrite, Primitive::kPrimLong, do_access_check>(self, shadow_frame, inst);
+    POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(SPUT_OBJECT) {
+    PREAMBLE();
+    bool success = DoFieldPut<StaticObjectWrite, Primitive::kPrimNot, do_access_check>(self, shadow_frame, inst);
+    POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(INVOKE_VIRTUAL) {
+    PREAMBLE();
+    bool success = DoInvoke<kVirtual, false, do_access_check>(self, shadow_frame, inst, &result_register);
+    POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_3xx);
+    UPDATE_HANDLER_TABLE();
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(INVOKE_VIRTUAL_RANGE) {
+    PREAMBLE();
+    bool success = DoInvoke<kVirtual, true, do_access_check>(self, shadow_frame, inst, &result_register);
+    POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_3xx);
+    UPDATE_HANDLER_TABLE();
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(INVOKE_SUPER) {
+    PREAMBLE();
+    bool success = DoInvoke<kSuper, false, do_access_check>(self, shadow_frame, inst, &result_register);
+    POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_3xx);
+    UPDATE_HANDLER_TABLE();
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(INVOKE_SUPER_RANGE) {
+    PREAMBLE();
+    bool success = DoInvoke<kSuper, true, do_access_check>(self, shadow_frame, inst, &result_register);
+    POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_3xx);
+    UPDATE_HANDLER_TABLE();
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(INVOKE_DIRECT) {
+    PREAMBLE();
+    bool success = DoInvoke<kDirect, false, do_access_check>(self, shadow_frame, inst, &result_register);
+    POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_3xx);
+    UPDATE_HANDLER_TABLE();
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(INVOKE_DIRECT_RANGE) {
+    PREAMBLE();
+    bool success = DoInvoke<kDirect, true, do_access_check>(self, shadow_frame, inst, &result_register);
+    POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_3xx);
+    UPDATE_HANDLER_TABLE();
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(INVOKE_INTERFACE) {
+    PREAMBLE();
+    bool success = DoInvoke<kInterface, false, do_access_check>(self, shadow_frame, inst, &result_register);
+    POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_3xx);
+    UPDATE_HANDLER_TABLE();
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(INVOKE_INTERFACE_RANGE) {
+    PREAMBLE();
+    bool success = DoInvoke<kInterface, true, do_access_check>(self, shadow_frame, inst, &result_register);
+    POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_3xx);
+    UPDATE_HANDLER_TABLE();
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(INVOKE_STATIC) {
+    PREAMBLE();
+    bool success = DoInvoke<kStatic, false, do_access_check>(self, shadow_frame, inst, &result_register);
+    POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_3xx);
+    UPDATE_HANDLER_TABLE();
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(INVOKE_STATIC_RANGE) {
+    PREAMBLE();
+    bool success = DoInvoke<kStatic, true, do_access_check>(self, shadow_frame, inst, &result_register);
+    POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_3xx);
+    UPDATE_HANDLER_TABLE();
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(INVOKE_VIRTUAL_QUICK) {
+    PREAMBLE();
+    bool success = DoInvokeQuick<kVirtual, false>(self, shadow_frame, inst, &result_register);
+    POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_3xx);
+    UPDATE_HANDLER_TABLE();
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(INVOKE_VIRTUAL_RANGE_QUICK) {
+    PREAMBLE();
+    bool success = DoInvokeQuick<kVirtual, true>(self, shadow_frame, inst, &result_register);
+    POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_3xx);
+    UPDATE_HANDLER_TABLE();
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(INVOKE_SUPER_QUICK) {
+    PREAMBLE();
+    bool success = DoInvokeQuick<kSuper, false>(self, shadow_frame, inst, &result_register);
+    POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_3xx);
+    UPDATE_HANDLER_TABLE();
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(INVOKE_SUPER_RANGE_QUICK) {
+    PREAMBLE();
+    bool success = DoInvokeQuick<kSuper, true>(self, shadow_frame, inst, &result_register);
+    POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_3xx);
+    UPDATE_HANDLER_TABLE();
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(NEG_INT)
+    PREAMBLE();
+    shadow_frame.SetVReg(inst->VRegA_12x(), -shadow_frame.GetVReg(inst->VRegB_12x()));
+    inst = inst->Next_1xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(NOT_INT)
+    PREAMBLE();
+    shadow_frame.SetVReg(inst->VRegA_12x(), ~shadow_frame.GetVReg(inst->VRegB_12x()));
+    inst = inst->Next_1xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(NEG_LONG)
+    PREAMBLE();
+    shadow_frame.SetVRegLong(inst->VRegA_12x(), -shadow_frame.GetVRegLong(inst->VRegB_12x()));
+    inst = inst->Next_1xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(NOT_LONG)
+    PREAMBLE();
+    shadow_frame.SetVRegLong(inst->VRegA_12x(), ~shadow_frame.GetVRegLong(inst->VRegB_12x()));
+    inst = inst->Next_1xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(NEG_FLOAT)
+    PREAMBLE();
+    shadow_frame.SetVRegFloat(inst->VRegA_12x(), -shadow_frame.GetVRegFloat(inst->VRegB_12x()));
+    inst = inst->Next_1xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(NEG_DOUBLE)
+    PREAMBLE();
+    shadow_frame.SetVRegDouble(inst->VRegA_12x(), -shadow_frame.GetVRegDouble(inst->VRegB_12x()));
+    inst = inst->Next_1xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(INT_TO_LONG)
+    PREAMBLE();
+    shadow_frame.SetVRegLong(inst->VRegA_12x(), shadow_frame.GetVReg(inst->VRegB_12x()));
+    inst = inst->Next_1xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(INT_TO_FLOAT)
+    PREAMBLE();
+    shadow_frame.SetVRegFloat(inst->VRegA_12x(), shadow_frame.GetVReg(inst->VRegB_12x()));
+    inst = inst->Next_1xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(INT_TO_DOUBLE)
+    PREAMBLE();
+    shadow_frame.SetVRegDouble(inst->VRegA_12x(), shadow_frame.GetVReg(inst->VRegB_12x()));
+    inst = inst->Next_1xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(LONG_TO_INT)
+    PREAMBLE();
+    shadow_frame.SetVReg(inst->VRegA_12x(), shadow_frame.GetVRegLong(inst->VRegB_12x()));
+    inst = inst->Next_1xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(LONG_TO_FLOAT)
+    PREAMBLE();
+    shadow_frame.SetVRegFloat(inst->VRegA_12x(), shadow_frame.GetVRegLong(inst->VRegB_12x()));
+    inst = inst->Next_1xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(LONG_TO_DOUBLE)
+    PREAMBLE();
+    shadow_frame.SetVRegDouble(inst->VRegA_12x(), shadow_frame.GetVRegLong(inst->VRegB_12x()));
+    inst = inst->Next_1xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(FLOAT_TO_INT) {
+    PREAMBLE();
+    float val = shadow_frame.GetVRegFloat(inst->VRegB_12x());
+    int32_t result;
+    if (val != val) {
+      result = 0;
+    } else if (val > static_cast<float>(kMaxInt)) {
+      result = kMaxInt;
+    } else if (val < static_cast<float>(kMinInt)) {
+      result = kMinInt;
+    } else {
+      result = val;
+    }
+    shadow_frame.SetVReg(inst->VRegA_12x(), result);
+    inst = inst->Next_1xx();
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(FLOAT_TO_LONG) {
+    PREAMBLE();
+    float val = shadow_frame.GetVRegFloat(inst->VRegB_12x());
+    int64_t result;
+    if (val != val) {
+      result = 0;
+    } else if (val > static_cast<float>(kMaxLong)) {
+      result = kMaxLong;
+    } else if (val < static_cast<float>(kMinLong)) {
+      result = kMinLong;
+    } else {
+      result = val;
+    }
+    shadow_frame.SetVRegLong(inst->VRegA_12x(), result);
+    inst = inst->Next_1xx();
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(FLOAT_TO_DOUBLE)
+    PREAMBLE();
+    shadow_frame.SetVRegDouble(inst->VRegA_12x(), shadow_frame.GetVRegFloat(inst->VRegB_12x()));
+    inst = inst->Next_1xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(DOUBLE_TO_INT) {
+    PREAMBLE();
+    double val = shadow_frame.GetVRegDouble(inst->VRegB_12x());
+    int32_t result;
+    if (val != val) {
+      result = 0;
+    } else if (val > static_cast<double>(kMaxInt)) {
+      result = kMaxInt;
+    } else if (val < static_cast<double>(kMinInt)) {
+      result = kMinInt;
+    } else {
+      result = val;
+    }
+    shadow_frame.SetVReg(inst->VRegA_12x(), result);
+    inst = inst->Next_1xx();
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(DOUBLE_TO_LONG) {
+    PREAMBLE();
+    double val = shadow_frame.GetVRegDouble(inst->VRegB_12x());
+    int64_t result;
+    if (val != val) {
+      result = 0;
+    } else if (val > static_cast<double>(kMaxLong)) {
+      result = kMaxLong;
+    } else if (val < static_cast<double>(kMinLong)) {
+      result = kMinLong;
+    } else {
+      result = val;
+    }
+    shadow_frame.SetVRegLong(inst->VRegA_12x(), result);
+    inst = inst->Next_1xx();
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(DOUBLE_TO_FLOAT)
+    PREAMBLE();
+    shadow_frame.SetVRegFloat(inst->VRegA_12x(), shadow_frame.GetVRegDouble(inst->VRegB_12x()));
+    inst = inst->Next_1xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(INT_TO_BYTE)
+    PREAMBLE();
+    shadow_frame.SetVReg(inst->VRegA_12x(),
+                         static_cast<int8_t>(shadow_frame.GetVReg(inst->VRegB_12x())));
+    inst = inst->Next_1xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(INT_TO_CHAR)
+    PREAMBLE();
+    shadow_frame.SetVReg(inst->VRegA_12x(),
+                         static_cast<uint16_t>(shadow_frame.GetVReg(inst->VRegB_12x())));
+    inst = inst->Next_1xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(INT_TO_SHORT)
+    PREAMBLE();
+    shadow_frame.SetVReg(inst->VRegA_12x(),
+                         static_cast<int16_t>(shadow_frame.GetVReg(inst->VRegB_12x())));
+    inst = inst->Next_1xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(ADD_INT)
+    PREAMBLE();
+    shadow_frame.SetVReg(inst->VRegA_23x(),
+                         shadow_frame.GetVReg(inst->VRegB_23x()) +
+                         shadow_frame.GetVReg(inst->VRegC_23x()));
+    inst = inst->Next_2xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(SUB_INT)
+    PREAMBLE();
+    shadow_frame.SetVReg(inst->VRegA_23x(),
+                         shadow_frame.GetVReg(inst->VRegB_23x()) -
+                         shadow_frame.GetVReg(inst->VRegC_23x()));
+    inst = inst->Next_2xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(MUL_INT)
+    PREAMBLE();
+    shadow_frame.SetVReg(inst->VRegA_23x(),
+                         shadow_frame.GetVReg(inst->VRegB_23x()) *
+                         shadow_frame.GetVReg(inst->VRegC_23x()));
+    inst = inst->Next_2xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(DIV_INT) {
+    PREAMBLE();
+    bool success = DoIntDivide(shadow_frame, inst->VRegA_23x(),
+                               shadow_frame.GetVReg(inst->VRegB_23x()),
+                               shadow_frame.GetVReg(inst->VRegC_23x()));
+    POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(REM_INT) {
+    PREAMBLE();
+    bool success = DoIntRemainder(shadow_frame, inst->VRegA_23x(),
+                                  shadow_frame.GetVReg(inst->VRegB_23x()),
+                                  shadow_frame.GetVReg(inst->VRegC_23x()));
+    POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(SHL_INT)
+    PREAMBLE();
+    shadow_frame.SetVReg(inst->VRegA_23x(),
+                         shadow_frame.GetVReg(inst->VRegB_23x()) <<
+                         (shadow_frame.GetVReg(inst->VRegC_23x()) & 0x1f));
+    inst = inst->Next_2xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(SHR_INT)
+    PREAMBLE();
+    shadow_frame.SetVReg(inst->VRegA_23x(),
+                         shadow_frame.GetVReg(inst->VRegB_23x()) >>
+                         (shadow_frame.GetVReg(inst->VRegC_23x()) & 0x1f));
+    inst = inst->Next_2xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(USHR_INT)
+    PREAMBLE();
+    shadow_frame.SetVReg(inst->VRegA_23x(),
+                         static_cast<uint32_t>(shadow_frame.GetVReg(inst->VRegB_23x())) >>
+                         (shadow_frame.GetVReg(inst->VRegC_23x()) & 0x1f));
+    inst = inst->Next_2xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(AND_INT)
+    PREAMBLE();
+    shadow_frame.SetVReg(inst->VRegA_23x(),
+                         shadow_frame.GetVReg(inst->VRegB_23x()) &
+                         shadow_frame.GetVReg(inst->VRegC_23x()));
+    inst = inst->Next_2xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(OR_INT)
+    PREAMBLE();
+    shadow_frame.SetVReg(inst->VRegA_23x(),
+                         shadow_frame.GetVReg(inst->VRegB_23x()) |
+                         shadow_frame.GetVReg(inst->VRegC_23x()));
+    inst = inst->Next_2xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(XOR_INT)
+    PREAMBLE();
+    shadow_frame.SetVReg(inst->VRegA_23x(),
+                         shadow_frame.GetVReg(inst->VRegB_23x()) ^
+                         shadow_frame.GetVReg(inst->VRegC_23x()));
+    inst = inst->Next_2xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(ADD_LONG)
+    PREAMBLE();
+    shadow_frame.SetVRegLong(inst->VRegA_23x(),
+                             shadow_frame.GetVRegLong(inst->VRegB_23x()) +
+                             shadow_frame.GetVRegLong(inst->VRegC_23x()));
+    inst = inst->Next_2xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(SUB_LONG)
+    PREAMBLE();
+    shadow_frame.SetVRegLong(inst->VRegA_23x(),
+                             shadow_frame.GetVRegLong(inst->VRegB_23x()) -
+                             shadow_frame.GetVRegLong(inst->VRegC_23x()));
+    inst = inst->Next_2xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(MUL_LONG)
+    PREAMBLE();
+    shadow_frame.SetVRegLong(inst->VRegA_23x(),
+                             shadow_frame.GetVRegLong(inst->VRegB_23x()) *
+                             shadow_frame.GetVRegLong(inst->VRegC_23x()));
+    inst = inst->Next_2xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(DIV_LONG)
+    PREAMBLE();
+    DoLongDivide(shadow_frame, inst->VRegA_23x(),
+                 shadow_frame.GetVRegLong(inst->VRegB_23x()),
+                shadow_frame.GetVRegLong(inst->VRegC_23x()));
+    POSSIBLY_HANDLE_PENDING_EXCEPTION(self->IsExceptionPending(), Next_2xx);
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(REM_LONG)
+    PREAMBLE();
+    DoLongRemainder(shadow_frame, inst->VRegA_23x(),
+                    shadow_frame.GetVRegLong(inst->VRegB_23x()),
                     shadow_frame.GetVRegLong(inst->VRegC_23x()));
-        POSSIBLY_HANDLE_PENDING_EXCEPTION(self->IsExceptionPending(), Next_2xx);
-        break;
-      case Instruction::REM_LONG:
-        PREAMBLE();
-        DoLongRemainder(shadow_frame, inst->VRegA_23x(),
-                        shadow_frame.GetVRegLong(inst->VRegB_23x()),
-                        shadow_frame.GetVRegLong(inst->VRegC_23x()));
-        POSSIBLY_HANDLE_PENDING_EXCEPTION(self->IsExceptionPending(), Next_2xx);
-        break;
-      case Instruction::AND_LONG:
-        PREAMBLE();
-        shadow_frame.SetVRegLong(inst->VRegA_23x(),
-                                 shadow_frame.GetVRegLong(inst->VRegB_23x()) &
-                                 shadow_frame.GetVRegLong(inst->VRegC_23x()));
-        inst = inst->Next_2xx();
-        break;
-      case Instruction::OR_LONG:
-        PREAMBLE();
-        shadow_frame.SetVRegLong(inst->VRegA_23x(),
-                                 shadow_frame.GetVRegLong(inst->VRegB_23x()) |
-                                 shadow_frame.GetVRegLong(inst->VRegC_23x()));
-        inst = inst->Next_2xx();
-        break;
-      case Instruction::XOR_LONG:
-        PREAMBLE();
-        shadow_frame.SetVRegLong(inst->VRegA_23x(),
-                                 shadow_frame.GetVRegLong(inst->VRegB_23x()) ^
-                                 shadow_frame.GetVRegLong(inst->VRegC_23x()));
-        inst = inst->Next_2xx();
-        break;
-      case Instruction::SHL_LONG:
-        PREAMBLE();
-        shadow_frame.SetVRegLong(inst->VRegA_23x(),
-                                 shadow_frame.GetVRegLong(inst->VRegB_23x()) <<
-                                 (shadow_frame.GetVReg(inst->VRegC_23x()) & 0x3f));
-        inst = inst->Next_2xx();
-        break;
-      case Instruction::SHR_LONG:
-        PREAMBLE();
-        shadow_frame.SetVRegLong(inst->VRegA_23x(),
-                                 shadow_frame.GetVRegLong(inst->VRegB_23x()) >>
-                                 (shadow_frame.GetVReg(inst->VRegC_23x()) & 0x3f));
-        inst = inst->Next_2xx();
-        break;
-      case Instruction::USHR_LONG:
-        PREAMBLE();
-        shadow_frame.SetVRegLong(inst->VRegA_23x(),
-                                 static_cast<uint64_t>(shadow_frame.GetVRegLong(inst->VRegB_23x())) >>
-                                 (shadow_frame.GetVReg(inst->VRegC_23x()) & 0x3f));
-        inst = inst->Next_2xx();
-        break;
-      case Instruction::ADD_FLOAT:
-        PREAMBLE();
-        shadow_frame.SetVRegFloat(inst->VRegA_23x(),
-                                  shadow_frame.GetVRegFloat(inst->VRegB_23x()) +
-                                  shadow_frame.GetVRegFloat(inst->VRegC_23x()));
-        inst = inst->Next_2xx();
-        break;
-      case Instruction::SUB_FLOAT:
-        PREAMBLE();
-        shadow_frame.SetVRegFloat(inst->VRegA_23x(),
-                                  shadow_frame.GetVRegFloat(inst->VRegB_23x()) -
-                                  shadow_frame.GetVRegFloat(inst->VRegC_23x()));
-        inst = inst->Next_2xx();
-        break;
-      case Instruction::MUL_FLOAT:
-        PREAMBLE();
-        shadow_frame.SetVRegFloat(inst->VRegA_23x(),
-                                  shadow_frame.GetVRegFloat(inst->VRegB_23x()) *
-                                  shadow_frame.GetVRegFloat(inst->VRegC_23x()));
-        inst = inst->Next_2xx();
-        break;
-      case Instruction::DIV_FLOAT:
-        PREAMBLE();
-        shadow_frame.SetVRegFloat(inst->VRegA_23x(),
-                                  shadow_frame.GetVRegFloat(inst->VRegB_23x()) /
-                                  shadow_frame.GetVRegFloat(inst->VRegC_23x()));
-        inst = inst->Next_2xx();
-        break;
-      case Instruction::REM_FLOAT:
-        PREAMBLE();
-        shadow_frame.SetVRegFloat(inst->VRegA_23x(),
-                                  fmodf(shadow_frame.GetVRegFloat(inst->VRegB_23x()),
-                                        shadow_frame.GetVRegFloat(inst->VRegC_23x())));
-        inst = inst->Next_2xx();
-        break;
-      case Instruction::ADD_DOUBLE:
-        PREAMBLE();
-        shadow_frame.SetVRegDouble(inst->VRegA_23x(),
-                                   shadow_frame.GetVRegDouble(inst->VRegB_23x()) +
-                                   shadow_frame.GetVRegDouble(inst->VRegC_23x()));
-        inst = inst->Next_2xx();
-        break;
-      case Instruction::SUB_DOUBLE:
-        PREAMBLE();
-        shadow_frame.SetVRegDouble(inst->VRegA_23x(),
-                                   shadow_frame.GetVRegDouble(inst->VRegB_23x()) -
-                                   shadow_frame.GetVRegDouble(inst->VRegC_23x()));
-        inst = inst->Next_2xx();
-        break;
-      case Instruction::MUL_DOUBLE:
-        PREAMBLE();
-        shadow_frame.SetVRegDouble(inst->VRegA_23x(),
-                                   shadow_frame.GetVRegDouble(inst->VRegB_23x()) *
-                                   shadow_frame.GetVRegDouble(inst->VRegC_23x()));
-        inst = inst->Next_2xx();
-        break;
-      case Instruction::DIV_DOUBLE:
-        PREAMBLE();
-        shadow_frame.SetVRegDouble(inst->VRegA_23x(),
-                                   shadow_frame.GetVRegDouble(inst->VRegB_23x()) /
-                                   shadow_frame.GetVRegDouble(inst->VRegC_23x()));
-        inst = inst->Next_2xx();
-        break;
-      case Instruction::REM_DOUBLE:
-        PREAMBLE();
-        shadow_frame.SetVRegDouble(inst->VRegA_23x(),
-                                   fmod(shadow_frame.GetVRegDouble(inst->VRegB_23x()),
-                                        shadow_frame.GetVRegDouble(inst->VRegC_23x())));
-        inst = inst->Next_2xx();
-        break;
-      case Instruction::ADD_INT_2ADDR: {
-        PREAMBLE();
-        uint4_t vregA = inst->VRegA_12x();
-        shadow_frame.SetVReg(vregA,
-                             shadow_frame.GetVReg(vregA) +
-                             shadow_frame.GetVReg(inst->VRegB_12x()));
-        inst = inst->Next_1xx();
-        break;
-      }
-      case Instruction::SUB_INT_2ADDR: {
-        PREAMBLE();
-        uint4_t vregA = inst->VRegA_12x();
-        shadow_frame.SetVReg(vregA,
-                             shadow_frame.GetVReg(vregA) -
-                             shadow_frame.GetVReg(inst->VRegB_12x()));
-        inst = inst->Next_1xx();
-        break;
-      }
-      case Instruction::MUL_INT_2ADDR: {
-        PREAMBLE();
-        uint4_t vregA = inst->VRegA_12x();
-        shadow_frame.SetVReg(vregA,
-                             shadow_frame.GetVReg(vregA) *
-                             shadow_frame.GetVReg(inst->VRegB_12x()));
-        inst = inst->Next_1xx();
-        break;
-      }
-      case Instruction::DIV_INT_2ADDR: {
-        PREAMBLE();
-        uint4_t vregA = inst->VRegA_12x();
-        bool success = DoIntDivide(shadow_frame, vregA, shadow_frame.GetVReg(vregA),
-                                   shadow_frame.GetVReg(inst->VRegB_12x()));
-        POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_1xx);
-        break;
-      }
-      case Instruction::REM_INT_2ADDR: {
-        PREAMBLE();
-        uint4_t vregA = inst->VRegA_12x();
-        bool success = DoIntRemainder(shadow_frame, vregA, shadow_frame.GetVReg(vregA),
-                                      shadow_frame.GetVReg(inst->VRegB_12x()));
-        POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_1xx);
-        break;
-      }
-      case Instruction::SHL_INT_2ADDR: {
-        PREAMBLE();
-        uint4_t vregA = inst->VRegA_12x();
-        shadow_frame.SetVReg(vregA,
-                             shadow_frame.GetVReg(vregA) <<
-                             (shadow_frame.GetVReg(inst->VRegB_12x()) & 0x1f));
-        inst = inst->Next_1xx();
-        break;
-      }
-      case Instruction::SHR_INT_2ADDR: {
-        PREAMBLE();
-        uint4_t vregA = inst->VRegA_12x();
-        shadow_frame.SetVReg(vregA,
-                             shadow_frame.GetVReg(vregA) >>
-                             (shadow_frame.GetVReg(inst->VRegB_12x()) & 0x1f));
-        inst = inst->Next_1xx();
-        break;
-      }
-      case Instruction::USHR_INT_2ADDR: {
-        PREAMBLE();
-        uint4_t vregA = inst->VRegA_12x();
-        shadow_frame.SetVReg(vregA,
-                             static_cast<uint32_t>(shadow_frame.GetVReg(vregA)) >>
-                             (shadow_frame.GetVReg(inst->VRegB_12x()) & 0x1f));
-        inst = inst->Next_1xx();
-        break;
-      }
-      case Instruction::AND_INT_2ADDR: {
-        PREAMBLE();
-        uint4_t vregA = inst->VRegA_12x();
-        shadow_frame.SetVReg(vregA,
-                             shadow_frame.GetVReg(vregA) &
-                             shadow_frame.GetVReg(inst->VRegB_12x()));
-        inst = inst->Next_1xx();
-        break;
-      }
-      case Instruction::OR_INT_2ADDR: {
-        PREAMBLE();
-        uint4_t vregA = inst->VRegA_12x();
-        shadow_frame.SetVReg(vregA,
-                             shadow_frame.GetVReg(vregA) |
-                             shadow_frame.GetVReg(inst->VRegB_12x()));
-        inst = inst->Next_1xx();
-        break;
-      }
-      case Instruction::XOR_INT_2ADDR: {
-        PREAMBLE();
-        uint4_t vregA = inst->VRegA_12x();
-        shadow_frame.SetVReg(vregA,
-                             shadow_frame.GetVReg(vregA) ^
-                             shadow_frame.GetVReg(inst->VRegB_12x()));
-        inst = inst->Next_1xx();
-        break;
-      }
-      case Instruction::ADD_LONG_2ADDR: {
-        PREAMBLE();
-        uint4_t vregA = inst->VRegA_12x();
-        shadow_frame.SetVRegLong(vregA,
-                                 shadow_frame.GetVRegLong(vregA) +
-                                 shadow_frame.GetVRegLong(inst->VRegB_12x()));
-        inst = inst->Next_1xx();
-        break;
-      }
-      case Instruction::SUB_LONG_2ADDR: {
-        PREAMBLE();
-        uint4_t vregA = inst->VRegA_12x();
-        shadow_frame.SetVRegLong(vregA,
-                                 shadow_frame.GetVRegLong(vregA) -
-                                 shadow_frame.GetVRegLong(inst->VRegB_12x()));
-        inst = inst->Next_1xx();
-        break;
-      }
-      case Instruction::MUL_LONG_2ADDR: {
-        PREAMBLE();
-        uint4_t vregA = inst->VRegA_12x();
-        shadow_frame.SetVRegLong(vregA,
-                                 shadow_frame.GetVRegLong(vregA) *
-                                 shadow_frame.GetVRegLong(inst->VRegB_12x()));
-        inst = inst->Next_1xx();
-        break;
-      }
-      case Instruction::DIV_LONG_2ADDR: {
-        PREAMBLE();
-        uint4_t vregA = inst->VRegA_12x();
-        DoLongDivide(shadow_frame, vregA, shadow_frame.GetVRegLong(vregA),
+    POSSIBLY_HANDLE_PENDING_EXCEPTION(self->IsExceptionPending(), Next_2xx);
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(AND_LONG)
+    PREAMBLE();
+    shadow_frame.SetVRegLong(inst->VRegA_23x(),
+                             shadow_frame.GetVRegLong(inst->VRegB_23x()) &
+                             shadow_frame.GetVRegLong(inst->VRegC_23x()));
+    inst = inst->Next_2xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(OR_LONG)
+    PREAMBLE();
+    shadow_frame.SetVRegLong(inst->VRegA_23x(),
+                             shadow_frame.GetVRegLong(inst->VRegB_23x()) |
+                             shadow_frame.GetVRegLong(inst->VRegC_23x()));
+    inst = inst->Next_2xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(XOR_LONG)
+    PREAMBLE();
+    shadow_frame.SetVRegLong(inst->VRegA_23x(),
+                             shadow_frame.GetVRegLong(inst->VRegB_23x()) ^
+                             shadow_frame.GetVRegLong(inst->VRegC_23x()));
+    inst = inst->Next_2xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(SHL_LONG)
+    PREAMBLE();
+    shadow_frame.SetVRegLong(inst->VRegA_23x(),
+                             shadow_frame.GetVRegLong(inst->VRegB_23x()) <<
+                             (shadow_frame.GetVReg(inst->VRegC_23x()) & 0x3f));
+    inst = inst->Next_2xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(SHR_LONG)
+    PREAMBLE();
+    shadow_frame.SetVRegLong(inst->VRegA_23x(),
+                             shadow_frame.GetVRegLong(inst->VRegB_23x()) >>
+                             (shadow_frame.GetVReg(inst->VRegC_23x()) & 0x3f));
+    inst = inst->Next_2xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(USHR_LONG)
+    PREAMBLE();
+    shadow_frame.SetVRegLong(inst->VRegA_23x(),
+                             static_cast<uint64_t>(shadow_frame.GetVRegLong(inst->VRegB_23x())) >>
+                             (shadow_frame.GetVReg(inst->VRegC_23x()) & 0x3f));
+    inst = inst->Next_2xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(ADD_FLOAT)
+    PREAMBLE();
+    shadow_frame.SetVRegFloat(inst->VRegA_23x(),
+                              shadow_frame.GetVRegFloat(inst->VRegB_23x()) +
+                              shadow_frame.GetVRegFloat(inst->VRegC_23x()));
+    inst = inst->Next_2xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(SUB_FLOAT)
+    PREAMBLE();
+    shadow_frame.SetVRegFloat(inst->VRegA_23x(),
+                              shadow_frame.GetVRegFloat(inst->VRegB_23x()) -
+                              shadow_frame.GetVRegFloat(inst->VRegC_23x()));
+    inst = inst->Next_2xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(MUL_FLOAT)
+    PREAMBLE();
+    shadow_frame.SetVRegFloat(inst->VRegA_23x(),
+                              shadow_frame.GetVRegFloat(inst->VRegB_23x()) *
+                              shadow_frame.GetVRegFloat(inst->VRegC_23x()));
+    inst = inst->Next_2xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(DIV_FLOAT)
+    PREAMBLE();
+    shadow_frame.SetVRegFloat(inst->VRegA_23x(),
+                              shadow_frame.GetVRegFloat(inst->VRegB_23x()) /
+                              shadow_frame.GetVRegFloat(inst->VRegC_23x()));
+    inst = inst->Next_2xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(REM_FLOAT)
+    PREAMBLE();
+    shadow_frame.SetVRegFloat(inst->VRegA_23x(),
+                              fmodf(shadow_frame.GetVRegFloat(inst->VRegB_23x()),
+                                    shadow_frame.GetVRegFloat(inst->VRegC_23x())));
+    inst = inst->Next_2xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(ADD_DOUBLE)
+    PREAMBLE();
+    shadow_frame.SetVRegDouble(inst->VRegA_23x(),
+                               shadow_frame.GetVRegDouble(inst->VRegB_23x()) +
+                               shadow_frame.GetVRegDouble(inst->VRegC_23x()));
+    inst = inst->Next_2xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(SUB_DOUBLE)
+    PREAMBLE();
+    shadow_frame.SetVRegDouble(inst->VRegA_23x(),
+                               shadow_frame.GetVRegDouble(inst->VRegB_23x()) -
+                               shadow_frame.GetVRegDouble(inst->VRegC_23x()));
+    inst = inst->Next_2xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(MUL_DOUBLE)
+    PREAMBLE();
+    shadow_frame.SetVRegDouble(inst->VRegA_23x(),
+                               shadow_frame.GetVRegDouble(inst->VRegB_23x()) *
+                               shadow_frame.GetVRegDouble(inst->VRegC_23x()));
+    inst = inst->Next_2xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(DIV_DOUBLE)
+    PREAMBLE();
+    shadow_frame.SetVRegDouble(inst->VRegA_23x(),
+                               shadow_frame.GetVRegDouble(inst->VRegB_23x()) /
+                               shadow_frame.GetVRegDouble(inst->VRegC_23x()));
+    inst = inst->Next_2xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(REM_DOUBLE)
+    PREAMBLE();
+    shadow_frame.SetVRegDouble(inst->VRegA_23x(),
+                               fmod(shadow_frame.GetVRegDouble(inst->VRegB_23x()),
+                                    shadow_frame.GetVRegDouble(inst->VRegC_23x())));
+    inst = inst->Next_2xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(ADD_INT_2ADDR) {
+    PREAMBLE();
+    uint4_t vregA = inst->VRegA_12x();
+    shadow_frame.SetVReg(vregA,
+                         shadow_frame.GetVReg(vregA) +
+                         shadow_frame.GetVReg(inst->VRegB_12x()));
+    inst = inst->Next_1xx();
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(SUB_INT_2ADDR) {
+    PREAMBLE();
+    uint4_t vregA = inst->VRegA_12x();
+    shadow_frame.SetVReg(vregA,
+                         shadow_frame.GetVReg(vregA) -
+                         shadow_frame.GetVReg(inst->VRegB_12x()));
+    inst = inst->Next_1xx();
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(MUL_INT_2ADDR) {
+    PREAMBLE();
+    uint4_t vregA = inst->VRegA_12x();
+    shadow_frame.SetVReg(vregA,
+                         shadow_frame.GetVReg(vregA) *
+                         shadow_frame.GetVReg(inst->VRegB_12x()));
+    inst = inst->Next_1xx();
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(DIV_INT_2ADDR) {
+    PREAMBLE();
+    uint4_t vregA = inst->VRegA_12x();
+    bool success = DoIntDivide(shadow_frame, vregA, shadow_frame.GetVReg(vregA),
+                               shadow_frame.GetVReg(inst->VRegB_12x()));
+    POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_1xx);
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(REM_INT_2ADDR) {
+    PREAMBLE();
+    uint4_t vregA = inst->VRegA_12x();
+    bool success = DoIntRemainder(shadow_frame, vregA, shadow_frame.GetVReg(vregA),
+                                  shadow_frame.GetVReg(inst->VRegB_12x()));
+    POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_1xx);
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(SHL_INT_2ADDR) {
+    PREAMBLE();
+    uint4_t vregA = inst->VRegA_12x();
+    shadow_frame.SetVReg(vregA,
+                         shadow_frame.GetVReg(vregA) <<
+                         (shadow_frame.GetVReg(inst->VRegB_12x()) & 0x1f));
+    inst = inst->Next_1xx();
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(SHR_INT_2ADDR) {
+    PREAMBLE();
+    uint4_t vregA = inst->VRegA_12x();
+    shadow_frame.SetVReg(vregA,
+                         shadow_frame.GetVReg(vregA) >>
+                         (shadow_frame.GetVReg(inst->VRegB_12x()) & 0x1f));
+    inst = inst->Next_1xx();
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(USHR_INT_2ADDR) {
+    PREAMBLE();
+    uint4_t vregA = inst->VRegA_12x();
+    shadow_frame.SetVReg(vregA,
+                         static_cast<uint32_t>(shadow_frame.GetVReg(vregA)) >>
+                         (shadow_frame.GetVReg(inst->VRegB_12x()) & 0x1f));
+    inst = inst->Next_1xx();
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(AND_INT_2ADDR) {
+    PREAMBLE();
+    uint4_t vregA = inst->VRegA_12x();
+    shadow_frame.SetVReg(vregA,
+                         shadow_frame.GetVReg(vregA) &
+                         shadow_frame.GetVReg(inst->VRegB_12x()));
+    inst = inst->Next_1xx();
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(OR_INT_2ADDR) {
+    PREAMBLE();
+    uint4_t vregA = inst->VRegA_12x();
+    shadow_frame.SetVReg(vregA,
+                         shadow_frame.GetVReg(vregA) |
+                         shadow_frame.GetVReg(inst->VRegB_12x()));
+    inst = inst->Next_1xx();
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(XOR_INT_2ADDR) {
+    PREAMBLE();
+    uint4_t vregA = inst->VRegA_12x();
+    shadow_frame.SetVReg(vregA,
+                         shadow_frame.GetVReg(vregA) ^
+                         shadow_frame.GetVReg(inst->VRegB_12x()));
+    inst = inst->Next_1xx();
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(ADD_LONG_2ADDR) {
+    PREAMBLE();
+    uint4_t vregA = inst->VRegA_12x();
+    shadow_frame.SetVRegLong(vregA,
+                             shadow_frame.GetVRegLong(vregA) +
+                             shadow_frame.GetVRegLong(inst->VRegB_12x()));
+    inst = inst->Next_1xx();
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(SUB_LONG_2ADDR) {
+    PREAMBLE();
+    uint4_t vregA = inst->VRegA_12x();
+    shadow_frame.SetVRegLong(vregA,
+                             shadow_frame.GetVRegLong(vregA) -
+                             shadow_frame.GetVRegLong(inst->VRegB_12x()));
+    inst = inst->Next_1xx();
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(MUL_LONG_2ADDR) {
+    PREAMBLE();
+    uint4_t vregA = inst->VRegA_12x();
+    shadow_frame.SetVRegLong(vregA,
+                             shadow_frame.GetVRegLong(vregA) *
+                             shadow_frame.GetVRegLong(inst->VRegB_12x()));
+    inst = inst->Next_1xx();
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(DIV_LONG_2ADDR) {
+    PREAMBLE();
+    uint4_t vregA = inst->VRegA_12x();
+    DoLongDivide(shadow_frame, vregA, shadow_frame.GetVRegLong(vregA),
+                shadow_frame.GetVRegLong(inst->VRegB_12x()));
+    POSSIBLY_HANDLE_PENDING_EXCEPTION(self->IsExceptionPending(), Next_1xx);
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(REM_LONG_2ADDR) {
+    PREAMBLE();
+    uint4_t vregA = inst->VRegA_12x();
+    DoLongRemainder(shadow_frame, vregA, shadow_frame.GetVRegLong(vregA),
                     shadow_frame.GetVRegLong(inst->VRegB_12x()));
-        POSSIBLY_HANDLE_PENDING_EXCEPTION(self->IsExceptionPending(), Next_1xx);
-        break;
-      }
-      case Instruction::REM_LONG_2ADDR: {
-        PREAMBLE();
-        uint4_t vregA = inst->VRegA_12x();
-        DoLongRemainder(shadow_frame, vregA, shadow_frame.GetVRegLong(vregA),
-                        shadow_frame.GetVRegLong(inst->VRegB_12x()));
-        POSSIBLY_HANDLE_PENDING_EXCEPTION(self->IsExceptionPending(), Next_1xx);
-        break;
-      }
-      case Instruction::AND_LONG_2ADDR: {
-        PREAMBLE();
-        uint4_t vregA = inst->VRegA_12x();
-        shadow_frame.SetVRegLong(vregA,
-                                 shadow_frame.GetVRegLong(vregA) &
-                                 shadow_frame.GetVRegLong(inst->VRegB_12x()));
-        inst = inst->Next_1xx();
-        break;
-      }
-      case Instruction::OR_LONG_2ADDR: {
-        PREAMBLE();
-        uint4_t vregA = inst->VRegA_12x();
-        shadow_frame.SetVRegLong(vregA,
-                                 shadow_frame.GetVRegLong(vregA) |
-                                 shadow_frame.GetVRegLong(inst->VRegB_12x()));
-        inst = inst->Next_1xx();
-        break;
-      }
-      case Instruction::XOR_LONG_2ADDR: {
-        PREAMBLE();
-        uint4_t vregA = inst->VRegA_12x();
-        shadow_frame.SetVRegLong(vregA,
-                                 shadow_frame.GetVRegLong(vregA) ^
-                                 shadow_frame.GetVRegLong(inst->VRegB_12x()));
-        inst = inst->Next_1xx();
-        break;
-      }
-      case Instruction::SHL_LONG_2ADDR: {
-        PREAMBLE();
-        uint4_t vregA = inst->VRegA_12x();
-        shadow_frame.SetVRegLong(vregA,
-                                 shadow_frame.GetVRegLong(vregA) <<
-                                 (shadow_frame.GetVReg(inst->VRegB_12x()) & 0x3f));
-        inst = inst->Next_1xx();
-        break;
-      }
-      case Instruction::SHR_LONG_2ADDR: {
-        PREAMBLE();
-        uint4_t vregA = inst->VRegA_12x();
-        shadow_frame.SetVRegLong(vregA,
-                                 shadow_frame.GetVRegLong(vregA) >>
-                                 (shadow_frame.GetVReg(inst->VRegB_12x()) & 0x3f));
-        inst = inst->Next_1xx();
-        break;
-      }
-      case Instruction::USHR_LONG_2ADDR: {
-        PREAMBLE();
-        uint4_t vregA = inst->VRegA_12x();
-        shadow_frame.SetVRegLong(vregA,
-                                 static_cast<uint64_t>(shadow_frame.GetVRegLong(vregA)) >>
-                                 (shadow_frame.GetVReg(inst->VRegB_12x()) & 0x3f));
-        inst = inst->Next_1xx();
-        break;
-      }
-      case Instruction::ADD_FLOAT_2ADDR: {
-        PREAMBLE();
-        uint4_t vregA = inst->VRegA_12x();
-        shadow_frame.SetVRegFloat(vregA,
-                                  shadow_frame.GetVRegFloat(vregA) +
-                                  shadow_frame.GetVRegFloat(inst->VRegB_12x()));
-        inst = inst->Next_1xx();
-        break;
-      }
-      case Instruction::SUB_FLOAT_2ADDR: {
-        PREAMBLE();
-        uint4_t vregA = inst->VRegA_12x();
-        shadow_frame.SetVRegFloat(vregA,
-                                  shadow_frame.GetVRegFloat(vregA) -
-                                  shadow_frame.GetVRegFloat(inst->VRegB_12x()));
-        inst = inst->Next_1xx();
-        break;
-      }
-      case Instruction::MUL_FLOAT_2ADDR: {
-        PREAMBLE();
-        uint4_t vregA = inst->VRegA_12x();
-        shadow_frame.SetVRegFloat(vregA,
-                                  shadow_frame.GetVRegFloat(vregA) *
-                                  shadow_frame.GetVRegFloat(inst->VRegB_12x()));
-        inst = inst->Next_1xx();
-        break;
-      }
-      case Instruction::DIV_FLOAT_2ADDR: {
-        PREAMBLE();
-        uint4_t vregA = inst->VRegA_12x();
-        shadow_frame.SetVRegFloat(vregA,
-                                  shadow_frame.GetVRegFloat(vregA) /
-                                  shadow_frame.GetVRegFloat(inst->VRegB_12x()));
-        inst = inst->Next_1xx();
-        break;
-      }
-      case Instruction::REM_FLOAT_2ADDR: {
-        PREAMBLE();
-        uint4_t vregA = inst->VRegA_12x();
-        shadow_frame.SetVRegFloat(vregA,
-                                  fmodf(shadow_frame.GetVRegFloat(vregA),
-                                        shadow_frame.GetVRegFloat(inst->VRegB_12x())));
-        inst = inst->Next_1xx();
-        break;
-      }
-      case Instruction::ADD_DOUBLE_2ADDR: {
-        PREAMBLE();
-        uint4_t vregA = inst->VRegA_12x();
-        shadow_frame.SetVRegDouble(vregA,
-                                   shadow_frame.GetVRegDouble(vregA) +
-                                   shadow_frame.GetVRegDouble(inst->VRegB_12x()));
-        inst = inst->Next_1xx();
-        break;
-      }
-      case Instruction::SUB_DOUBLE_2ADDR: {
-        PREAMBLE();
-        uint4_t vregA = inst->VRegA_12x();
-        shadow_frame.SetVRegDouble(vregA,
-                                   shadow_frame.GetVRegDouble(vregA) -
-                                   shadow_frame.GetVRegDouble(inst->VRegB_12x()));
-        inst = inst->Next_1xx();
-        break;
-      }
-      case Instruction::MUL_DOUBLE_2ADDR: {
-        PREAMBLE();
-        uint4_t vregA = inst->VRegA_12x();
-        shadow_frame.SetVRegDouble(vregA,
-                                   shadow_frame.GetVRegDouble(vregA) *
-                                   shadow_frame.GetVRegDouble(inst->VRegB_12x()));
-        inst = inst->Next_1xx();
-        break;
-      }
-      case Instruction::DIV_DOUBLE_2ADDR: {
-        PREAMBLE();
-        uint4_t vregA = inst->VRegA_12x();
-        shadow_frame.SetVRegDouble(vregA,
-                                   shadow_frame.GetVRegDouble(vregA) /
-                                   shadow_frame.GetVRegDouble(inst->VRegB_12x()));
-        inst = inst->Next_1xx();
-        break;
-      }
-      case Instruction::REM_DOUBLE_2ADDR: {
-        PREAMBLE();
-        uint4_t vregA = inst->VRegA_12x();
-        shadow_frame.SetVRegDouble(vregA,
-                                   fmod(shadow_frame.GetVRegDouble(vregA),
-                                        shadow_frame.GetVRegDouble(inst->VRegB_12x())));
-        inst = inst->Next_1xx();
-        break;
-      }
-      case Instruction::ADD_INT_LIT16:
-        PREAMBLE();
-        shadow_frame.SetVReg(inst->VRegA_22s(),
-                             shadow_frame.GetVReg(inst->VRegB_22s()) +
-                             inst->VRegC_22s());
-        inst = inst->Next_2xx();
-        break;
-      case Instruction::RSUB_INT:
-        PREAMBLE();
-        shadow_frame.SetVReg(inst->VRegA_22s(),
-                             inst->VRegC_22s() -
-                             shadow_frame.GetVReg(inst->VRegB_22s()));
-        inst = inst->Next_2xx();
-        break;
-      case Instruction::MUL_INT_LIT16:
-        PREAMBLE();
-        shadow_frame.SetVReg(inst->VRegA_22s(),
-                             shadow_frame.GetVReg(inst->VRegB_22s()) *
-                             inst->VRegC_22s());
-        inst = inst->Next_2xx();
-        break;
-      case Instruction::DIV_INT_LIT16: {
-        PREAMBLE();
-        bool success = DoIntDivide(shadow_frame, inst->VRegA_22s(),
-                                   shadow_frame.GetVReg(inst->VRegB_22s()), inst->VRegC_22s());
-        POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
-        break;
-      }
-      case Instruction::REM_INT_LIT16: {
-        PREAMBLE();
-        bool success = DoIntRemainder(shadow_frame, inst->VRegA_22s(),
-                                      shadow_frame.GetVReg(inst->VRegB_22s()), inst->VRegC_22s());
-        POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
-        break;
-      }
-      case Instruction::AND_INT_LIT16:
-        PREAMBLE();
-        shadow_frame.SetVReg(inst->VRegA_22s(),
-                             shadow_frame.GetVReg(inst->VRegB_22s()) &
-                             inst->VRegC_22s());
-        inst = inst->Next_2xx();
-        break;
-      case Instruction::OR_INT_LIT16:
-        PREAMBLE();
-        shadow_frame.SetVReg(inst->VRegA_22s(),
-                             shadow_frame.GetVReg(inst->VRegB_22s()) |
-                             inst->VRegC_22s());
-        inst = inst->Next_2xx();
-        break;
-      case Instruction::XOR_INT_LIT16:
-        PREAMBLE();
-        shadow_frame.SetVReg(inst->VRegA_22s(),
-                             shadow_frame.GetVReg(inst->VRegB_22s()) ^
-                             inst->VRegC_22s());
-        inst = inst->Next_2xx();
-        break;
-      case Instruction::ADD_INT_LIT8:
-        PREAMBLE();
-        shadow_frame.SetVReg(inst->VRegA_22b(),
-                             shadow_frame.GetVReg(inst->VRegB_22b()) +
-                             inst->VRegC_22b());
-        inst = inst->Next_2xx();
-        break;
-      case Instruction::RSUB_INT_LIT8:
-        PREAMBLE();
-        shadow_frame.SetVReg(inst->VRegA_22b(),
-                             inst->VRegC_22b() -
-                             shadow_frame.GetVReg(inst->VRegB_22b()));
-        inst = inst->Next_2xx();
-        break;
-      case Instruction::MUL_INT_LIT8:
-        PREAMBLE();
-        shadow_frame.SetVReg(inst->VRegA_22b(),
-                             shadow_frame.GetVReg(inst->VRegB_22b()) *
-                             inst->VRegC_22b());
-        inst = inst->Next_2xx();
-        break;
-      case Instruction::DIV_INT_LIT8: {
-        PREAMBLE();
-        bool success = DoIntDivide(shadow_frame, inst->VRegA_22b(),
-                                   shadow_frame.GetVReg(inst->VRegB_22b()), inst->VRegC_22b());
-        POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
-        break;
-      }
-      case Instruction::REM_INT_LIT8: {
-        PREAMBLE();
-        bool success = DoIntRemainder(shadow_frame, inst->VRegA_22b(),
-                                      shadow_frame.GetVReg(inst->VRegB_22b()), inst->VRegC_22b());
-        POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
-        break;
-      }
-      case Instruction::AND_INT_LIT8:
-        PREAMBLE();
-        shadow_frame.SetVReg(inst->VRegA_22b(),
-                             shadow_frame.GetVReg(inst->VRegB_22b()) &
-                             inst->VRegC_22b());
-        inst = inst->Next_2xx();
-        break;
-      case Instruction::OR_INT_LIT8:
-        PREAMBLE();
-        shadow_frame.SetVReg(inst->VRegA_22b(),
-                             shadow_frame.GetVReg(inst->VRegB_22b()) |
-                             inst->VRegC_22b());
-        inst = inst->Next_2xx();
-        break;
-      case Instruction::XOR_INT_LIT8:
-        PREAMBLE();
-        shadow_frame.SetVReg(inst->VRegA_22b(),
-                             shadow_frame.GetVReg(inst->VRegB_22b()) ^
-                             inst->VRegC_22b());
-        inst = inst->Next_2xx();
-        break;
-      case Instruction::SHL_INT_LIT8:
-        PREAMBLE();
-        shadow_frame.SetVReg(inst->VRegA_22b(),
-                             shadow_frame.GetVReg(inst->VRegB_22b()) <<
-                             (inst->VRegC_22b() & 0x1f));
-        inst = inst->Next_2xx();
-        break;
-      case Instruction::SHR_INT_LIT8:
-        PREAMBLE();
-        shadow_frame.SetVReg(inst->VRegA_22b(),
-                             shadow_frame.GetVReg(inst->VRegB_22b()) >>
-                             (inst->VRegC_22b() & 0x1f));
-        inst = inst->Next_2xx();
-        break;
-      case Instruction::USHR_INT_LIT8:
-        PREAMBLE();
-        shadow_frame.SetVReg(inst->VRegA_22b(),
-                             static_cast<uint32_t>(shadow_frame.GetVReg(inst->VRegB_22b())) >>
-                             (inst->VRegC_22b() & 0x1f));
-        inst = inst->Next_2xx();
-        break;
-      case Instruction::UNUSED_3E ... Instruction::UNUSED_43:
-      case Instruction::UNUSED_EB ... Instruction::UNUSED_FF:
-      case Instruction::UNUSED_79:
-      case Instruction::UNUSED_7A:
-        UnexpectedOpcode(inst, mh);
-    }
+    POSSIBLY_HANDLE_PENDING_EXCEPTION(self->IsExceptionPending(), Next_1xx);
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(AND_LONG_2ADDR) {
+    PREAMBLE();
+    uint4_t vregA = inst->VRegA_12x();
+    shadow_frame.SetVRegLong(vregA,
+                             shadow_frame.GetVRegLong(vregA) &
+                             shadow_frame.GetVRegLong(inst->VRegB_12x()));
+    inst = inst->Next_1xx();
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(OR_LONG_2ADDR) {
+    PREAMBLE();
+    uint4_t vregA = inst->VRegA_12x();
+    shadow_frame.SetVRegLong(vregA,
+                             shadow_frame.GetVRegLong(vregA) |
+                             shadow_frame.GetVRegLong(inst->VRegB_12x()));
+    inst = inst->Next_1xx();
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(XOR_LONG_2ADDR) {
+    PREAMBLE();
+    uint4_t vregA = inst->VRegA_12x();
+    shadow_frame.SetVRegLong(vregA,
+                             shadow_frame.GetVRegLong(vregA) ^
+                             shadow_frame.GetVRegLong(inst->VRegB_12x()));
+    inst = inst->Next_1xx();
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(SHL_LONG_2ADDR) {
+    PREAMBLE();
+    uint4_t vregA = inst->VRegA_12x();
+    shadow_frame.SetVRegLong(vregA,
+                             shadow_frame.GetVRegLong(vregA) <<
+                             (shadow_frame.GetVReg(inst->VRegB_12x()) & 0x3f));
+    inst = inst->Next_1xx();
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(SHR_LONG_2ADDR) {
+    PREAMBLE();
+    uint4_t vregA = inst->VRegA_12x();
+    shadow_frame.SetVRegLong(vregA,
+                             shadow_frame.GetVRegLong(vregA) >>
+                             (shadow_frame.GetVReg(inst->VRegB_12x()) & 0x3f));
+    inst = inst->Next_1xx();
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(USHR_LONG_2ADDR) {
+    PREAMBLE();
+    uint4_t vregA = inst->VRegA_12x();
+    shadow_frame.SetVRegLong(vregA,
+                             static_cast<uint64_t>(shadow_frame.GetVRegLong(vregA)) >>
+                             (shadow_frame.GetVReg(inst->VRegB_12x()) & 0x3f));
+    inst = inst->Next_1xx();
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(ADD_FLOAT_2ADDR) {
+    PREAMBLE();
+    uint4_t vregA = inst->VRegA_12x();
+    shadow_frame.SetVRegFloat(vregA,
+                              shadow_frame.GetVRegFloat(vregA) +
+                              shadow_frame.GetVRegFloat(inst->VRegB_12x()));
+    inst = inst->Next_1xx();
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(SUB_FLOAT_2ADDR) {
+    PREAMBLE();
+    uint4_t vregA = inst->VRegA_12x();
+    shadow_frame.SetVRegFloat(vregA,
+                              shadow_frame.GetVRegFloat(vregA) -
+                              shadow_frame.GetVRegFloat(inst->VRegB_12x()));
+    inst = inst->Next_1xx();
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(MUL_FLOAT_2ADDR) {
+    PREAMBLE();
+    uint4_t vregA = inst->VRegA_12x();
+    shadow_frame.SetVRegFloat(vregA,
+                              shadow_frame.GetVRegFloat(vregA) *
+                              shadow_frame.GetVRegFloat(inst->VRegB_12x()));
+    inst = inst->Next_1xx();
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(DIV_FLOAT_2ADDR) {
+    PREAMBLE();
+    uint4_t vregA = inst->VRegA_12x();
+    shadow_frame.SetVRegFloat(vregA,
+                              shadow_frame.GetVRegFloat(vregA) /
+                              shadow_frame.GetVRegFloat(inst->VRegB_12x()));
+    inst = inst->Next_1xx();
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(REM_FLOAT_2ADDR) {
+    PREAMBLE();
+    uint4_t vregA = inst->VRegA_12x();
+    shadow_frame.SetVRegFloat(vregA,
+                              fmodf(shadow_frame.GetVRegFloat(vregA),
+                                    shadow_frame.GetVRegFloat(inst->VRegB_12x())));
+    inst = inst->Next_1xx();
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(ADD_DOUBLE_2ADDR) {
+    PREAMBLE();
+    uint4_t vregA = inst->VRegA_12x();
+    shadow_frame.SetVRegDouble(vregA,
+                               shadow_frame.GetVRegDouble(vregA) +
+                               shadow_frame.GetVRegDouble(inst->VRegB_12x()));
+    inst = inst->Next_1xx();
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(SUB_DOUBLE_2ADDR) {
+    PREAMBLE();
+    uint4_t vregA = inst->VRegA_12x();
+    shadow_frame.SetVRegDouble(vregA,
+                               shadow_frame.GetVRegDouble(vregA) -
+                               shadow_frame.GetVRegDouble(inst->VRegB_12x()));
+    inst = inst->Next_1xx();
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(MUL_DOUBLE_2ADDR) {
+    PREAMBLE();
+    uint4_t vregA = inst->VRegA_12x();
+    shadow_frame.SetVRegDouble(vregA,
+                               shadow_frame.GetVRegDouble(vregA) *
+                               shadow_frame.GetVRegDouble(inst->VRegB_12x()));
+    inst = inst->Next_1xx();
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(DIV_DOUBLE_2ADDR) {
+    PREAMBLE();
+    uint4_t vregA = inst->VRegA_12x();
+    shadow_frame.SetVRegDouble(vregA,
+                               shadow_frame.GetVRegDouble(vregA) /
+                               shadow_frame.GetVRegDouble(inst->VRegB_12x()));
+    inst = inst->Next_1xx();
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(REM_DOUBLE_2ADDR) {
+    PREAMBLE();
+    uint4_t vregA = inst->VRegA_12x();
+    shadow_frame.SetVRegDouble(vregA,
+                               fmod(shadow_frame.GetVRegDouble(vregA),
+                                    shadow_frame.GetVRegDouble(inst->VRegB_12x())));
+    inst = inst->Next_1xx();
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(ADD_INT_LIT16)
+    PREAMBLE();
+    shadow_frame.SetVReg(inst->VRegA_22s(),
+                         shadow_frame.GetVReg(inst->VRegB_22s()) +
+                         inst->VRegC_22s());
+    inst = inst->Next_2xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(RSUB_INT)
+    PREAMBLE();
+    shadow_frame.SetVReg(inst->VRegA_22s(),
+                         inst->VRegC_22s() -
+                         shadow_frame.GetVReg(inst->VRegB_22s()));
+    inst = inst->Next_2xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(MUL_INT_LIT16)
+    PREAMBLE();
+    shadow_frame.SetVReg(inst->VRegA_22s(),
+                         shadow_frame.GetVReg(inst->VRegB_22s()) *
+                         inst->VRegC_22s());
+    inst = inst->Next_2xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(DIV_INT_LIT16) {
+    PREAMBLE();
+    bool success = DoIntDivide(shadow_frame, inst->VRegA_22s(),
+                               shadow_frame.GetVReg(inst->VRegB_22s()), inst->VRegC_22s());
+    POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(REM_INT_LIT16) {
+    PREAMBLE();
+    bool success = DoIntRemainder(shadow_frame, inst->VRegA_22s(),
+                                  shadow_frame.GetVReg(inst->VRegB_22s()), inst->VRegC_22s());
+    POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(AND_INT_LIT16)
+    PREAMBLE();
+    shadow_frame.SetVReg(inst->VRegA_22s(),
+                         shadow_frame.GetVReg(inst->VRegB_22s()) &
+                         inst->VRegC_22s());
+    inst = inst->Next_2xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(OR_INT_LIT16)
+    PREAMBLE();
+    shadow_frame.SetVReg(inst->VRegA_22s(),
+                         shadow_frame.GetVReg(inst->VRegB_22s()) |
+                         inst->VRegC_22s());
+    inst = inst->Next_2xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(XOR_INT_LIT16)
+    PREAMBLE();
+    shadow_frame.SetVReg(inst->VRegA_22s(),
+                         shadow_frame.GetVReg(inst->VRegB_22s()) ^
+                         inst->VRegC_22s());
+    inst = inst->Next_2xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(ADD_INT_LIT8)
+    PREAMBLE();
+    shadow_frame.SetVReg(inst->VRegA_22b(),
+                         shadow_frame.GetVReg(inst->VRegB_22b()) +
+                         inst->VRegC_22b());
+    inst = inst->Next_2xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(RSUB_INT_LIT8)
+    PREAMBLE();
+    shadow_frame.SetVReg(inst->VRegA_22b(),
+                         inst->VRegC_22b() -
+                         shadow_frame.GetVReg(inst->VRegB_22b()));
+    inst = inst->Next_2xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(MUL_INT_LIT8)
+    PREAMBLE();
+    shadow_frame.SetVReg(inst->VRegA_22b(),
+                         shadow_frame.GetVReg(inst->VRegB_22b()) *
+                         inst->VRegC_22b());
+    inst = inst->Next_2xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(DIV_INT_LIT8) {
+    PREAMBLE();
+    bool success = DoIntDivide(shadow_frame, inst->VRegA_22b(),
+                               shadow_frame.GetVReg(inst->VRegB_22b()), inst->VRegC_22b());
+    POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(REM_INT_LIT8) {
+    PREAMBLE();
+    bool success = DoIntRemainder(shadow_frame, inst->VRegA_22b(),
+                                  shadow_frame.GetVReg(inst->VRegB_22b()), inst->VRegC_22b());
+    POSSIBLY_HANDLE_PENDING_EXCEPTION(!success, Next_2xx);
+    HANDLE_INSTRUCTION_END();
+  }
+  HANDLE_INSTRUCTION_START(AND_INT_LIT8)
+    PREAMBLE();
+    shadow_frame.SetVReg(inst->VRegA_22b(),
+                         shadow_frame.GetVReg(inst->VRegB_22b()) &
+                         inst->VRegC_22b());
+    inst = inst->Next_2xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(OR_INT_LIT8)
+    PREAMBLE();
+    shadow_frame.SetVReg(inst->VRegA_22b(),
+                         shadow_frame.GetVReg(inst->VRegB_22b()) |
+                         inst->VRegC_22b());
+    inst = inst->Next_2xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(XOR_INT_LIT8)
+    PREAMBLE();
+    shadow_frame.SetVReg(inst->VRegA_22b(),
+                         shadow_frame.GetVReg(inst->VRegB_22b()) ^
+                         inst->VRegC_22b());
+    inst = inst->Next_2xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(SHL_INT_LIT8)
+    PREAMBLE();
+    shadow_frame.SetVReg(inst->VRegA_22b(),
+                         shadow_frame.GetVReg(inst->VRegB_22b()) <<
+                         (inst->VRegC_22b() & 0x1f));
+    inst = inst->Next_2xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(SHR_INT_LIT8)
+    PREAMBLE();
+    shadow_frame.SetVReg(inst->VRegA_22b(),
+                         shadow_frame.GetVReg(inst->VRegB_22b()) >>
+                         (inst->VRegC_22b() & 0x1f));
+    inst = inst->Next_2xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(USHR_INT_LIT8)
+    PREAMBLE();
+    shadow_frame.SetVReg(inst->VRegA_22b(),
+                         static_cast<uint32_t>(shadow_frame.GetVReg(inst->VRegB_22b())) >>
+                         (inst->VRegC_22b() & 0x1f));
+    inst = inst->Next_2xx();
+    HANDLE_INSTRUCTION_END();
+  HANDLE_INSTRUCTION_START(UNUSED_3E)
+  HANDLE_INSTRUCTION_START(UNUSED_3F)
+  HANDLE_INSTRUCTION_START(UNUSED_40)
+  HANDLE_INSTRUCTION_START(UNUSED_41)
+  HANDLE_INSTRUCTION_START(UNUSED_42)
+  HANDLE_INSTRUCTION_START(UNUSED_43)
+  HANDLE_INSTRUCTION_START(UNUSED_ED)
+  HANDLE_INSTRUCTION_START(UNUSED_EE)
+  HANDLE_INSTRUCTION_START(UNUSED_EF)
+  HANDLE_INSTRUCTION_START(UNUSED_F0)
+  HANDLE_INSTRUCTION_START(UNUSED_F1)
+  HANDLE_INSTRUCTION_START(UNUSED_F2)
+  HANDLE_INSTRUCTION_START(UNUSED_F3)
+  HANDLE_INSTRUCTION_START(UNUSED_F4)
+  HANDLE_INSTRUCTION_START(UNUSED_F5)
+  HANDLE_INSTRUCTION_START(UNUSED_F6)
+  HANDLE_INSTRUCTION_START(UNUSED_F7)
+  HANDLE_INSTRUCTION_START(UNUSED_F8)
+  HANDLE_INSTRUCTION_START(UNUSED_F9)
+  HANDLE_INSTRUCTION_START(UNUSED_FA)
+  HANDLE_INSTRUCTION_START(UNUSED_FB)
+  HANDLE_INSTRUCTION_START(UNUSED_FC)
+  HANDLE_INSTRUCTION_START(UNUSED_FD)
+  HANDLE_INSTRUCTION_START(UNUSED_FE)
+  HANDLE_INSTRUCTION_START(UNUSED_FF)
+  HANDLE_INSTRUCTION_START(UNUSED_79)
+  HANDLE_INSTRUCTION_START(UNUSED_7A)
+    UnexpectedOpcode(inst, mh);
+
+  // Runs decoded instructions up to the next one that has a handler of its own.
+  decoded_run:
+    inst = Instruction::At(insns + decoded_code->Run(self, shadow_frame, inst->GetDexPc(insns)));
+    HANDLE_INSTRUCTION_END();
+
+  // Instrumentation handlers, only reached through instrumentation_handlers_table.
+#define INSTRUMENTATION_INSTRUCTION_HANDLER(o, code, n, f, r, i, a, v)  \
+  instrumentation_op_##code: {                                          \
+    INSTRUMENTATION_PREAMBLE();                                         \
+    goto op_##code;                                                     \
   }
+#include "dex_instruction_list.h"
+  DEX_INSTRUCTION_LIST(INSTRUMENTATION_INSTRUCTION_HANDLER)
+#undef DEX_INSTRUCTION_LIST
+#undef INSTRUMENTATION_INSTRUCTION_HANDLER
 }  // NOLINT(readability/fn_size)
 
 static JValue Execute(Thread* self, MethodHelper& mh, const DexFile::CodeItem* code_item,
@@ -28,6 +28,8 @@
 #include <stdint.h>
 #include <string.h>
 
+#include <deque>
+
 struct iovec;
 
 namespace art {
@@ -279,7 +281,8 @@ struct JdwpState {
                         int match_count)
       EXCLUSIVE_LOCKS_REQUIRED(event_list_lock_)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
-  void EventFinish(ExpandBuf* pReq);
+  void EventFinish(ExpandBuf* pReq) LOCKS_EXCLUDED(event_send_lock_);
+  void SendEventPacket(ExpandBuf* pReq);
   void FindMatchingEvents(JdwpEventKind eventKind,
                           ModBasket* basket,
                           JdwpEvent** match_list,
@@ -334,6 +337,15 @@ struct JdwpState {
   ConditionVariable event_thread_cond_ GUARDED_BY(event_thread_lock_);
   ObjectId event_thread_id_;
 
+  // Event packets waiting to be sent. Whichever thread finds no other thread sending them sends
+  // them all, and events which don't suspend anything are added to the last packet if it's an
+  // unfinished composite of such events, so a burst of them goes out as a few large packets.
+  Mutex event_send_lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
+  ConditionVariable event_send_cond_ GUARDED_BY(event_send_lock_);
+  std::deque<ExpandBuf*> pending_events_ GUARDED_BY(event_send_lock_);
+  ExpandBuf* open_composite_ GUARDED_BY(event_send_lock_);
+  bool sending_events_ GUARDED_BY(event_send_lock_);
+
   bool ddm_is_active_;
 
   bool should_exit_;
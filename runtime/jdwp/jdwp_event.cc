@@ -170,6 +170,10 @@ JdwpError JdwpState::RegisterEvent(JdwpEvent* pEvent) {
     }
   }
 
+  if (pEvent->eventKind == EK_METHOD_ENTRY || pEvent->eventKind == EK_METHOD_EXIT) {
+    Dbg::EnableMethodEvents();
+  }
+
   /*
    * Add to list.
    */
@@ -222,6 +226,9 @@ void JdwpState::UnregisterEvent(JdwpEvent* pEvent) {
       Dbg::UnconfigureStep(pMod->step.threadId);
     }
   }
+  if (pEvent->eventKind == EK_METHOD_ENTRY || pEvent->eventKind == EK_METHOD_EXIT) {
+    Dbg::DisableMethodEvents();
+  }
 
   --event_list_size_;
   CHECK(event_list_size_ != 0 || event_list_ == NULL);
@@ -639,12 +646,86 @@ static ExpandBuf* eventPrep() {
   return pReq;
 }
 
+// The offsets of the suspend policy and the event count in an event packet.
+static const size_t kEventSuspendPolicyOffset = kJDWPHeaderLen;
+static const size_t kEventCountOffset = kJDWPHeaderLen + 1;
+static const size_t kEventsOffset = kJDWPHeaderLen + 5;
+
+// Composites of events which don't suspend anything aren't added to beyond this size.
+static const size_t kMaxCompositeEventBytes = 16 * 1024;
+
+// Threads posting events which don't suspend anything wait while this many packets are pending,
+// so that a debugger connection which can't keep up slows them down rather than using up memory.
+static const size_t kMaxPendingEventPackets = 4;
+
+static bool CompositeHasRoom(ExpandBuf* composite) {
+  return composite != NULL && expandBufGetLength(composite) < kMaxCompositeEventBytes;
+}
+
+/*
+ * Queue an event packet to be sent to the debugger, and send the queued packets unless another
+ * thread is already doing so.
+ *
+ * Takes ownership of "pReq".
+ */
+void JdwpState::EventFinish(ExpandBuf* pReq) {
+  Thread* self = Thread::Current();
+  {
+    MutexLock mu(self, event_send_lock_);
+    uint8_t* buf = expandBufGetBuffer(pReq);
+    if (buf[kEventSuspendPolicyOffset] == SP_NONE) {
+      while (sending_events_ && pending_events_.size() >= kMaxPendingEventPackets &&
+             !CompositeHasRoom(open_composite_)) {
+        event_send_cond_.Wait(self);
+      }
+      if (CompositeHasRoom(open_composite_)) {
+        // Move the events to the composite, the packet's own header is dropped.
+        size_t length = expandBufGetLength(pReq) - kEventsOffset;
+        memcpy(expandBufAddSpace(open_composite_, length), buf + kEventsOffset, length);
+        uint8_t* composite = expandBufGetBuffer(open_composite_);
+        Set4BE(composite + kEventCountOffset,
+               Get4BE(composite + kEventCountOffset) + Get4BE(buf + kEventCountOffset));
+        expandBufFree(pReq);
+      } else {
+        pending_events_.push_back(pReq);
+        open_composite_ = pReq;
+      }
+    } else {
+      // Events which suspend go out on their own, after those posted before them.
+      pending_events_.push_back(pReq);
+      open_composite_ = NULL;
+    }
+    if (sending_events_) {
+      return;
+    }
+    sending_events_ = true;
+  }
+
+  while (true) {
+    {
+      MutexLock mu(self, event_send_lock_);
+      if (pending_events_.empty()) {
+        sending_events_ = false;
+        event_send_cond_.Broadcast(self);
+        return;
+      }
+      pReq = pending_events_.front();
+      pending_events_.pop_front();
+      if (pReq == open_composite_) {
+        open_composite_ = NULL;
+      }
+      event_send_cond_.Broadcast(self);
+    }
+    SendEventPacket(pReq);
+  }
+}
+
 /*
  * Write the header into the buffer and send the packet off to the debugger.
  *
  * Takes ownership of "pReq" (currently discards it).
  */
-void JdwpState::EventFinish(ExpandBuf* pReq) {
+void JdwpState::SendEventPacket(ExpandBuf* pReq) {
   uint8_t* buf = expandBufGetBuffer(pReq);
 
   Set4BE(buf, expandBufGetLength(pReq));
@@ -1397,18 +1397,7 @@ static JdwpError SF_GetValues(JdwpState*, Request& request, ExpandBuf* pReply)
   int32_t slot_count = request.ReadSigned32("slot count");
 
   expandBufAdd4BE(pReply, slot_count);     /* "int values" */
-  for (int32_t i = 0; i < slot_count; ++i) {
-    uint32_t slot = request.ReadUnsigned32("slot");
-    JDWP::JdwpTag reqSigByte = request.ReadTag();
-
-    VLOG(jdwp) << "    --> slot " << slot << " " << reqSigByte;
-
-    size_t width = Dbg::GetTagWidth(reqSigByte);
-    uint8_t* ptr = expandBufAddSpace(pReply, width+1);
-    Dbg::GetLocalValue(thread_id, frame_id, slot, reqSigByte, ptr, width);
-  }
-
-  return ERR_NONE;
+  return Dbg::GetLocalValues(thread_id, frame_id, slot_count, request, pReply);
 }
 
 /*
@@ -1741,6 +1730,9 @@ void JdwpState::ProcessRequest(Request& request, ExpandBuf* pReply) {
 
   /* tell the VM that GC is okay again */
   self->TransitionFromRunnableToSuspended(old_state);
+
+  /* apply the breakpoints and steps the command set up, before the debugger sees the reply */
+  Dbg::ManageDeoptimization();
 }
 
 }  // namespace JDWP
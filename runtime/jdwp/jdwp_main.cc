@@ -217,6 +217,10 @@ JdwpState::JdwpState(const JdwpOptions* options)
       event_thread_lock_("JDWP event thread lock"),
       event_thread_cond_("JDWP event thread condition variable", event_thread_lock_),
       event_thread_id_(0),
+      event_send_lock_("JDWP event send lock"),
+      event_send_cond_("JDWP event send condition variable", event_send_lock_),
+      open_composite_(NULL),
+      sending_events_(false),
       ddm_is_active_(false),
       should_exit_(false),
       exit_status_(0) {
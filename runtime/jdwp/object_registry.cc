@@ -16,22 +16,93 @@
 
 #include "object_registry.h"
 
-#include "scoped_thread_state_change.h"
+#include "globals.h"
+#include "thread.h"
 
 namespace art {
 
 mirror::Object* const ObjectRegistry::kInvalidObject = reinterpret_cast<mirror::Object*>(1);
 
+// The initial number of slots in the hash set, which must be a power of two.
+static const size_t kInitialSlotCount = 64;
+
 std::ostream& operator<<(std::ostream& os, const ObjectRegistryEntry& rhs) {
-  os << "ObjectRegistryEntry[" << rhs.jni_reference_type
-     << ",reference=" << rhs.jni_reference
+  os << "ObjectRegistryEntry[" << (rhs.is_strong ? "strong" : "weak")
+     << ",object=" << rhs.object
      << ",count=" << rhs.reference_count
      << ",id=" << rhs.id << "]";
   return os;
 }
 
 ObjectRegistry::ObjectRegistry()
-    : lock_("ObjectRegistry lock", kJdwpObjectRegistryLock), next_id_(1) {
+    : lock_("ObjectRegistry lock", kJdwpObjectRegistryLock),
+      slots_(kInitialSlotCount, NULL), live_entry_count_(0), tombstone_count_(0), next_id_(1),
+      allow_new_objects_(true), new_objects_condition_("object registry condition", lock_) {
+}
+
+// Identity hash codes are addresses, drop the bits that object alignment makes zero.
+static size_t SlotIndex(int32_t hash_code, size_t slot_count) {
+  return (static_cast<uint32_t>(hash_code) / kObjectAlignment) & (slot_count - 1);
+}
+
+ObjectRegistryEntry* ObjectRegistry::FindEntry(mirror::Object* o, int32_t hash_code) {
+  for (size_t i = SlotIndex(hash_code, slots_.size()); ; i = (i + 1) & (slots_.size() - 1)) {
+    ObjectRegistryEntry* entry = slots_[i];
+    if (entry == NULL) {
+      return NULL;
+    }
+    if (entry != Tombstone() && entry->identity_hash_code == hash_code && entry->object == o) {
+      return entry;
+    }
+  }
+}
+
+void ObjectRegistry::InsertEntry(ObjectRegistryEntry* entry) {
+  // Keep at least a quarter of the slots empty so that probe sequences stay short.
+  if ((live_entry_count_ + tombstone_count_ + 1) * 4 > slots_.size() * 3) {
+    Rehash(live_entry_count_ * 2 >= slots_.size() ? slots_.size() * 2 : slots_.size());
+  }
+  size_t i = SlotIndex(entry->identity_hash_code, slots_.size());
+  while (IsLive(slots_[i])) {
+    i = (i + 1) & (slots_.size() - 1);
+  }
+  if (slots_[i] == Tombstone()) {
+    --tombstone_count_;
+  }
+  slots_[i] = entry;
+  ++live_entry_count_;
+}
+
+void ObjectRegistry::RemoveEntry(ObjectRegistryEntry* entry) {
+  size_t i = SlotIndex(entry->identity_hash_code, slots_.size());
+  while (slots_[i] != entry) {
+    DCHECK(slots_[i] != NULL) << *entry;
+    i = (i + 1) & (slots_.size() - 1);
+  }
+  slots_[i] = Tombstone();
+  --live_entry_count_;
+  ++tombstone_count_;
+}
+
+void ObjectRegistry::Rehash(size_t new_size) {
+  std::vector<ObjectRegistryEntry*> old_slots(new_size, NULL);
+  old_slots.swap(slots_);
+  for (ObjectRegistryEntry* entry : old_slots) {
+    if (IsLive(entry)) {
+      size_t i = SlotIndex(entry->identity_hash_code, slots_.size());
+      while (slots_[i] != NULL) {
+        i = (i + 1) & (slots_.size() - 1);
+      }
+      slots_[i] = entry;
+    }
+  }
+  tombstone_count_ = 0;
+}
+
+void ObjectRegistry::WaitUntilAllowed(Thread* self) {
+  while (UNLIKELY(!allow_new_objects_)) {
+    new_objects_condition_.WaitHoldingLocks(self);
+  }
 }
 
 JDWP::RefTypeId ObjectRegistry::AddRefType(mirror::Class* c) {
@@ -47,93 +118,75 @@ JDWP::ObjectId ObjectRegistry::InternalAdd(mirror::Object* o) {
     return 0;
   }
 
-  ScopedObjectAccessUnchecked soa(Thread::Current());
-  MutexLock mu(soa.Self(), lock_);
-  ObjectRegistryEntry dummy;
-  dummy.jni_reference_type = JNIWeakGlobalRefType;
-  dummy.jni_reference = NULL;
-  dummy.reference_count = 0;
-  dummy.id = 0;
-  std::pair<object_iterator, bool> result = object_to_entry_.insert(std::make_pair(o, dummy));
-  ObjectRegistryEntry& entry = result.first->second;
-  if (!result.second) {
+  Thread* self = Thread::Current();
+  MutexLock mu(self, lock_);
+  WaitUntilAllowed(self);
+  int32_t hash_code = o->IdentityHashCode();
+  ObjectRegistryEntry* entry = FindEntry(o, hash_code);
+  if (entry != NULL) {
     // This object was already in our map.
-    entry.reference_count += 1;
-    return entry.id;
+    entry->reference_count += 1;
+    return entry->id;
   }
 
   // This object isn't in the registry yet, so add it.
-  JNIEnv* env = soa.Env();
-
-  jobject local_reference = soa.AddLocalReference<jobject>(o);
+  entry = new ObjectRegistryEntry;
+  entry->object = o;
+  entry->is_strong = false;
+  entry->identity_hash_code = hash_code;
+  entry->reference_count = 1;
+  entry->id = next_id_++;
 
-  entry.jni_reference_type = JNIWeakGlobalRefType;
-  entry.jni_reference = env->NewWeakGlobalRef(local_reference);
-  entry.reference_count = 1;
-  entry.id = next_id_++;
+  InsertEntry(entry);
+  id_to_entry_.Put(entry->id, entry);
 
-  id_to_entry_.Put(entry.id, &entry);
-
-  env->DeleteLocalRef(local_reference);
-
-  return entry.id;
+  return entry->id;
 }
 
 bool ObjectRegistry::Contains(mirror::Object* o) {
   Thread* self = Thread::Current();
   MutexLock mu(self, lock_);
-  return (object_to_entry_.find(o) != object_to_entry_.end());
+  WaitUntilAllowed(self);
+  return FindEntry(o, o->IdentityHashCode()) != NULL;
 }
 
 void ObjectRegistry::Clear() {
   Thread* self = Thread::Current();
   MutexLock mu(self, lock_);
-  VLOG(jdwp) << "Object registry contained " << object_to_entry_.size() << " entries";
-
-  // Delete all the JNI references.
-  JNIEnv* env = self->GetJniEnv();
-  for (object_iterator it = object_to_entry_.begin(); it != object_to_entry_.end(); ++it) {
-    ObjectRegistryEntry& entry = (it->second);
-    if (entry.jni_reference_type == JNIWeakGlobalRefType) {
-      env->DeleteWeakGlobalRef(entry.jni_reference);
-    } else {
-      env->DeleteGlobalRef(entry.jni_reference);
-    }
+  VLOG(jdwp) << "Object registry contained " << id_to_entry_.size() << " entries";
+
+  for (id_iterator it = id_to_entry_.begin(); it != id_to_entry_.end(); ++it) {
+    delete it->second;
   }
 
-  // Clear the maps.
-  object_to_entry_.clear();
+  // Clear the hash set and the map.
+  std::vector<ObjectRegistryEntry*>(kInitialSlotCount, NULL).swap(slots_);
+  live_entry_count_ = 0;
+  tombstone_count_ = 0;
   id_to_entry_.clear();
 }
 
 mirror::Object* ObjectRegistry::InternalGet(JDWP::ObjectId id) {
   Thread* self = Thread::Current();
   MutexLock mu(self, lock_);
+  WaitUntilAllowed(self);
   id_iterator it = id_to_entry_.find(id);
   if (it == id_to_entry_.end()) {
     return kInvalidObject;
   }
-  ObjectRegistryEntry& entry = *(it->second);
-  return self->DecodeJObject(entry.jni_reference);
-}
-
-jobject ObjectRegistry::GetJObject(JDWP::ObjectId id) {
-  Thread* self = Thread::Current();
-  MutexLock mu(self, lock_);
-  id_iterator it = id_to_entry_.find(id);
-  CHECK(it != id_to_entry_.end()) << id;
-  ObjectRegistryEntry& entry = *(it->second);
-  return entry.jni_reference;
+  return it->second->object;
 }
 
 void ObjectRegistry::DisableCollection(JDWP::ObjectId id) {
   Thread* self = Thread::Current();
   MutexLock mu(self, lock_);
+  // The object may be unmarked and about to be swept, it mustn't become a root now.
+  WaitUntilAllowed(self);
   id_iterator it = id_to_entry_.find(id);
   if (it == id_to_entry_.end()) {
     return;
   }
-  Promote(*(it->second));
+  it->second->is_strong = true;
 }
 
 void ObjectRegistry::EnableCollection(JDWP::ObjectId id) {
@@ -143,46 +196,18 @@ void ObjectRegistry::EnableCollection(JDWP::ObjectId id) {
   if (it == id_to_entry_.end()) {
     return;
   }
-  Demote(*(it->second));
-}
-
-void ObjectRegistry::Demote(ObjectRegistryEntry& entry) {
-  if (entry.jni_reference_type == JNIGlobalRefType) {
-    Thread* self = Thread::Current();
-    JNIEnv* env = self->GetJniEnv();
-    jobject global = entry.jni_reference;
-    entry.jni_reference = env->NewWeakGlobalRef(entry.jni_reference);
-    entry.jni_reference_type = JNIWeakGlobalRefType;
-    env->DeleteGlobalRef(global);
-  }
-}
-
-void ObjectRegistry::Promote(ObjectRegistryEntry& entry) {
-  if (entry.jni_reference_type == JNIWeakGlobalRefType) {
-    Thread* self = Thread::Current();
-    JNIEnv* env = self->GetJniEnv();
-    jobject weak = entry.jni_reference;
-    entry.jni_reference = env->NewGlobalRef(entry.jni_reference);
-    entry.jni_reference_type = JNIGlobalRefType;
-    env->DeleteWeakGlobalRef(weak);
-  }
+  it->second->is_strong = false;
 }
 
 bool ObjectRegistry::IsCollected(JDWP::ObjectId id) {
   Thread* self = Thread::Current();
   MutexLock mu(self, lock_);
+  WaitUntilAllowed(self);
   id_iterator it = id_to_entry_.find(id);
   if (it == id_to_entry_.end()) {
     return true;  // TODO: can we report that this was an invalid id?
   }
-
-  ObjectRegistryEntry& entry = *(it->second);
-  if (entry.jni_reference_type == JNIWeakGlobalRefType) {
-    JNIEnv* env = self->GetJniEnv();
-    return env->IsSameObject(entry.jni_reference, NULL);  // Has the jweak been collected?
-  } else {
-    return false;  // We hold a strong reference, so we know this is live.
-  }
+  return it->second->object == NULL;
 }
 
 void ObjectRegistry::DisposeObject(JDWP::ObjectId id, uint32_t reference_count) {
@@ -193,19 +218,51 @@ void ObjectRegistry::DisposeObject(JDWP::ObjectId id, uint32_t reference_count)
     return;
   }
 
-  ObjectRegistryEntry& entry = *(it->second);
-  entry.reference_count -= reference_count;
-  if (entry.reference_count <= 0) {
-    JNIEnv* env = self->GetJniEnv();
-    mirror::Object* object = self->DecodeJObject(entry.jni_reference);
-    if (entry.jni_reference_type == JNIWeakGlobalRefType) {
-      env->DeleteWeakGlobalRef(entry.jni_reference);
-    } else {
-      env->DeleteGlobalRef(entry.jni_reference);
+  ObjectRegistryEntry* entry = it->second;
+  entry->reference_count -= reference_count;
+  if (entry->reference_count <= 0) {
+    if (entry->object != NULL) {
+      RemoveEntry(entry);
     }
-    object_to_entry_.erase(object);
-    id_to_entry_.erase(id);
+    id_to_entry_.erase(it);
+    delete entry;
   }
 }
 
+void ObjectRegistry::VisitRoots(RootVisitor* visitor, void* arg) {
+  MutexLock mu(Thread::Current(), lock_);
+  for (ObjectRegistryEntry* entry : slots_) {
+    if (IsLive(entry) && entry->is_strong) {
+      visitor(entry->object, arg);
+    }
+  }
+}
+
+void ObjectRegistry::SweepWeaks(IsMarkedTester is_marked, void* arg) {
+  MutexLock mu(Thread::Current(), lock_);
+  for (ObjectRegistryEntry*& slot : slots_) {
+    ObjectRegistryEntry* entry = slot;
+    if (IsLive(entry) && !entry->is_strong && !is_marked(entry->object, arg)) {
+      // Keep the entry so that its id reports the object as collected, but free up the object's
+      // slot: its address may be reused by a new object.
+      entry->object = NULL;
+      slot = Tombstone();
+      --live_entry_count_;
+      ++tombstone_count_;
+    }
+  }
+}
+
+void ObjectRegistry::DisallowNewObjects() {
+  MutexLock mu(Thread::Current(), lock_);
+  allow_new_objects_ = false;
+}
+
+void ObjectRegistry::AllowNewObjects() {
+  Thread* self = Thread::Current();
+  MutexLock mu(self, lock_);
+  allow_new_objects_ = true;
+  new_objects_condition_.Broadcast(self);
+}
+
 }  // namespace art
@@ -19,23 +19,28 @@
 
 #include <stdint.h>
 
-#include <map>
+#include <vector>
 
+#include "base/mutex.h"
 #include "jdwp/jdwp.h"
 #include "mirror/art_field-inl.h"
 #include "mirror/class.h"
 #include "mirror/class-inl.h"
 #include "mirror/object-inl.h"
+#include "root_visitor.h"
 #include "safe_map.h"
 
 namespace art {
 
 struct ObjectRegistryEntry {
-  // Is jni_reference a weak global or a regular global reference?
-  jobjectRefType jni_reference_type;
+  // The object, or NULL once the GC has collected it.
+  mirror::Object* object;
 
-  // The reference itself.
-  jobject jni_reference;
+  // Has the debugger disabled collection of the object? If so it's a root, otherwise it's weak.
+  bool is_strong;
+
+  // The object's identity hash code, so lookups don't need to compare every object.
+  int32_t identity_hash_code;
 
   // A reference count, so we can implement DisposeObject.
   int32_t reference_count;
@@ -46,10 +51,10 @@ struct ObjectRegistryEntry {
 std::ostream& operator<<(std::ostream& os, const ObjectRegistryEntry& rhs);
 
 // Tracks those objects currently known to the debugger, so we can use consistent ids when
-// referring to them. Normally we keep JNI weak global references to objects, so they can
-// still be garbage collected. The debugger can ask us to retain objects, though, so we can
-// also promote references to regular JNI global references (and demote them back again if
-// the debugger tells us that's okay).
+// referring to them. Normally the registry holds objects weakly, so they can still be garbage
+// collected: the GC sweeps it along with the other system weaks. The debugger can ask us to
+// retain objects, though, in which case they are visited as roots (until the debugger tells us
+// that's no longer needed).
 class ObjectRegistry {
  public:
   ObjectRegistry();
@@ -76,28 +81,58 @@ class ObjectRegistry {
   void DisposeObject(JDWP::ObjectId id, uint32_t reference_count)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
 
+  // Visits the objects whose collection the debugger has disabled.
+  void VisitRoots(RootVisitor* visitor, void* arg);
+
+  // Clears the entries of weakly held objects which are no longer marked. Their ids stay valid
+  // until disposed of, but refer to collected objects.
+  void SweepWeaks(IsMarkedTester is_marked, void* arg);
+
+  // Between marking and sweeping, objects in the registry may be about to be swept, so lookups
+  // and additions wait until the GC allows them again.
+  void DisallowNewObjects() EXCLUSIVE_LOCKS_REQUIRED(Locks::mutator_lock_);
+  void AllowNewObjects() SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
   // Returned by Get when passed an invalid object id.
   static mirror::Object* const kInvalidObject;
 
-  // This is needed to get the jobject instead of the Object*.
-  // Avoid using this and use standard Get when possible.
-  jobject GetJObject(JDWP::ObjectId id) SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
-
  private:
   JDWP::ObjectId InternalAdd(mirror::Object* o) SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
   mirror::Object* InternalGet(JDWP::ObjectId id) SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
-  void Demote(ObjectRegistryEntry& entry) SHARED_LOCKS_REQUIRED(Locks::mutator_lock_, lock_);
-  void Promote(ObjectRegistryEntry& entry) SHARED_LOCKS_REQUIRED(Locks::mutator_lock_, lock_);
+
+  // Waits until the GC allows objects to be looked up or added.
+  void WaitUntilAllowed(Thread* self) EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  // The entries of live objects are also kept in an open addressing hash set keyed by identity
+  // hash code, using linear probing, so that Add and Contains don't walk a tree of pointers.
+  // Entries whose objects are collected or disposed of leave tombstones behind.
+  static ObjectRegistryEntry* Tombstone() {
+    return reinterpret_cast<ObjectRegistryEntry*>(1);
+  }
+  static bool IsLive(const ObjectRegistryEntry* entry) {
+    return entry != NULL && entry != Tombstone();
+  }
+  ObjectRegistryEntry* FindEntry(mirror::Object* o, int32_t hash_code)
+      EXCLUSIVE_LOCKS_REQUIRED(lock_);
+  void InsertEntry(ObjectRegistryEntry* entry) EXCLUSIVE_LOCKS_REQUIRED(lock_);
+  void RemoveEntry(ObjectRegistryEntry* entry) EXCLUSIVE_LOCKS_REQUIRED(lock_);
+  void Rehash(size_t new_size) EXCLUSIVE_LOCKS_REQUIRED(lock_);
 
   Mutex lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
 
-  typedef std::map<mirror::Object*, ObjectRegistryEntry>::iterator object_iterator;
-  std::map<mirror::Object*, ObjectRegistryEntry> object_to_entry_ GUARDED_BY(lock_);
+  // The hash set of entries, whose size is a power of two.
+  std::vector<ObjectRegistryEntry*> slots_ GUARDED_BY(lock_);
+  size_t live_entry_count_ GUARDED_BY(lock_);
+  size_t tombstone_count_ GUARDED_BY(lock_);
 
+  // Owns the entries, including those whose objects have been collected.
   typedef SafeMap<JDWP::ObjectId, ObjectRegistryEntry*>::iterator id_iterator;
   SafeMap<JDWP::ObjectId, ObjectRegistryEntry*> id_to_entry_ GUARDED_BY(lock_);
 
   size_t next_id_ GUARDED_BY(lock_);
+
+  bool allow_new_objects_ GUARDED_BY(lock_);
+  ConditionVariable new_objects_condition_ GUARDED_BY(lock_);
 };
 
 }  // namespace art
@@ -18,6 +18,7 @@
 
 #include <dlfcn.h>
 
+#include <algorithm>
 #include <cstdarg>
 #include <utility>
 #include <vector>
@@ -26,9 +27,14 @@
 #include "base/mutex.h"
 #include "base/stl_util.h"
 #include "base/stringpiece.h"
+#include "base/stringprintf.h"
 #include "class_linker.h"
+#include "common_throws.h"
+#include "cutils/atomic.h"
+#include "cutils/atomic-inline.h"
 #include "dex_file-inl.h"
 #include "gc/accounting/card_table-inl.h"
+#include "gc/heap.h"
 #include "interpreter/interpreter.h"
 #include "invoke_arg_array_builder.h"
 #include "jni.h"
@@ -75,9 +81,6 @@ static const size_t kMonitorsMax = 4096;  // Arbitrary sanity check.
 static const size_t kLocalsInitial = 64;  // Arbitrary.
 static const size_t kLocalsMax = 512;  // Arbitrary sanity check.
 
-static const size_t kPinTableInitial = 16;  // Arbitrary.
-static const size_t kPinTableMax = 1024;  // Arbitrary sanity check.
-
 static size_t gGlobalsInitial = 512;  // Arbitrary.
 static size_t gGlobalsMax = 51200;  // Arbitrary sanity check. (Must fit in 16 bits.)
 
@@ -324,18 +327,16 @@ static jfieldID FindFieldID(const ScopedObjectAccess& soa, jclass jni_class, con
   return soa.EncodeField(field);
 }
 
+// Arrays handed out directly are pinned with the heap, which keeps them both alive and in place
+// without holding up the rest of a collection.
 static void PinPrimitiveArray(const ScopedObjectAccess& soa, const Array* array)
     SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
-  JavaVMExt* vm = soa.Vm();
-  MutexLock mu(soa.Self(), vm->pins_lock);
-  vm->pin_table.Add(array);
+  Runtime::Current()->GetHeap()->PinObject(soa.Self(), array);
 }
 
 static void UnpinPrimitiveArray(const ScopedObjectAccess& soa, const Array* array)
     SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
-  JavaVMExt* vm = soa.Vm();
-  MutexLock mu(soa.Self(), vm->pins_lock);
-  vm->pin_table.Remove(array);
+  Runtime::Current()->GetHeap()->UnpinObject(soa.Self(), array);
 }
 
 static void ThrowAIOOBE(ScopedObjectAccess& soa, Array* array, jsize start,
@@ -2032,18 +2033,11 @@ class JNI {
       *is_copy = JNI_TRUE;
     }
     ScopedObjectAccess soa(env);
-    String* s = soa.Decode<String*>(java_string);
-    size_t byte_count = s->GetUtfLength();
-    char* bytes = new char[byte_count + 1];
-    CHECK(bytes != NULL);  // bionic aborts anyway.
-    const uint16_t* chars = s->GetCharArray()->GetData() + s->GetOffset();
-    ConvertUtf16ToModifiedUtf8(bytes, chars, s->GetLength());
-    bytes[byte_count] = '\0';
-    return bytes;
+    return soa.Env()->utf_cache.GetChars(soa.Decode<String*>(java_string));
   }
 
   static void ReleaseStringUTFChars(JNIEnv* env, jstring, const char* chars) {
-    delete[] chars;
+    JniUtfCache::ReleaseChars(chars);
   }
 
   static jsize GetArrayLength(JNIEnv* env, jarray java_array) {
@@ -2073,6 +2067,49 @@ class JNI {
     array->Set(index, value);
   }
 
+  static void GetObjectArrayRegion(JNIEnv* env, jobjectArray java_array, jsize start,
+                                   jsize length, jobject* buf) {
+    CHECK_NON_NULL_ARGUMENT(GetObjectArrayRegion, java_array);
+    ScopedObjectAccess soa(env);
+    ObjectArray<Object>* array = soa.Decode<ObjectArray<Object>*>(java_array);
+    if (start < 0 || length < 0 || start + length > array->GetLength()) {
+      ThrowAIOOBE(soa, array, start, length, "src");
+      return;
+    }
+    CHECK_NON_NULL_MEMCPY_ARGUMENT(GetObjectArrayRegion, length, buf);
+    for (jsize i = 0; i < length; ++i) {
+      buf[i] = soa.AddLocalReference<jobject>(array->GetWithoutChecks(start + i));
+    }
+  }
+
+  static void SetObjectArrayRegion(JNIEnv* env, jobjectArray java_array, jsize start,
+                                   jsize length, const jobject* buf) {
+    CHECK_NON_NULL_ARGUMENT(SetObjectArrayRegion, java_array);
+    ScopedObjectAccess soa(env);
+    ObjectArray<Object>* array = soa.Decode<ObjectArray<Object>*>(java_array);
+    if (start < 0 || length < 0 || start + length > array->GetLength()) {
+      ThrowAIOOBE(soa, array, start, length, "dst");
+      return;
+    }
+    CHECK_NON_NULL_MEMCPY_ARGUMENT(SetObjectArrayRegion, length, buf);
+    // Every value is assignable to an Object[], only check the stores into other arrays.
+    Class* element_class = array->GetClass()->GetComponentType();
+    bool check_assignable = !element_class->IsObjectClass();
+    jsize stored = 0;
+    for (; stored < length; ++stored) {
+      Object* value = soa.Decode<Object*>(buf[stored]);
+      if (check_assignable && value != NULL && !value->InstanceOf(element_class)) {
+        ThrowArrayStoreException(value->GetClass(), array->GetClass());
+        break;
+      }
+      array->SetPtrWithoutChecks(start + stored, value);
+    }
+    // One card mark for the region, rather than one per element.
+    if (stored != 0) {
+      Runtime::Current()->GetHeap()->WriteBarrierArray(array, start, stored);
+    }
+  }
+
   static jbooleanArray NewBooleanArray(JNIEnv* env, jsize length) {
     ScopedObjectAccess soa(env);
     return NewPrimitiveArray<jbooleanArray, BooleanArray>(soa, length);
@@ -2842,7 +2879,9 @@ JNIEnvExt::JNIEnvExt(Thread* self, JavaVMExt* vm)
       locals(kLocalsInitial, kLocalsMax, kLocal),
       check_jni(false),
       critical(false),
-      monitors("monitors", kMonitorsInitial, kMonitorsMax) {
+      monitors("monitors", kMonitorsInitial, kMonitorsMax),
+      check_jni_skip(0),
+      check_jni_random(static_cast<uint32_t>(reinterpret_cast<uintptr_t>(this)) | 1) {
   functions = unchecked_functions = &gJniNativeInterface;
   if (vm->check_jni) {
     SetCheckJniEnabled(true);
@@ -2856,6 +2895,77 @@ JNIEnvExt::JNIEnvExt(Thread* self, JavaVMExt* vm)
 JNIEnvExt::~JNIEnvExt() {
 }
 
+// The reference count of the UTF-8 returned by JniUtfCache, kept in front of it.
+struct JniUtfCharsHeader {
+  volatile int32_t references;
+  // Keeps the chars as aligned as new[] would, for the word at a time conversion.
+  int32_t unused;
+};
+
+static JniUtfCharsHeader* GetUtfCharsHeader(const char* chars) {
+  return reinterpret_cast<JniUtfCharsHeader*>(const_cast<char*>(chars)) - 1;
+}
+
+JniUtfCache::JniUtfCache() {
+  memset(entries_, 0, sizeof(entries_));
+}
+
+JniUtfCache::~JniUtfCache() {
+  for (size_t i = 0; i < kEntries && entries_[i].string != NULL; ++i) {
+    ReleaseChars(entries_[i].chars);
+  }
+}
+
+char* JniUtfCache::AllocChars(size_t byte_count) {
+  JniUtfCharsHeader* header = new JniUtfCharsHeader[1 + RoundUp(byte_count + 1,
+      sizeof(JniUtfCharsHeader)) / sizeof(JniUtfCharsHeader)];
+  CHECK(header != NULL);  // bionic aborts anyway.
+  header->references = 1;
+  return reinterpret_cast<char*>(header + 1);
+}
+
+void JniUtfCache::ReleaseChars(const char* chars) {
+  JniUtfCharsHeader* header = GetUtfCharsHeader(chars);
+  // android_atomic_dec returns the old value.
+  if (android_atomic_dec(&header->references) == 1) {
+    delete[] header;
+  }
+}
+
+const char* JniUtfCache::GetChars(String* s) {
+  uint32_t gc_epoch = Runtime::Current()->GetHeap()->GetGcEpoch();
+  size_t i = 0;
+  for (; i < kEntries && entries_[i].string != NULL; ++i) {
+    if (entries_[i].string == s && entries_[i].gc_epoch == gc_epoch) {
+      break;
+    }
+  }
+  if (i < kEntries && entries_[i].string != NULL) {
+    Entry hit = entries_[i];
+    memmove(&entries_[1], &entries_[0], i * sizeof(Entry));
+    entries_[0] = hit;
+    android_atomic_inc(&GetUtfCharsHeader(hit.chars)->references);
+    return hit.chars;
+  }
+  size_t byte_count = s->GetUtfLength();
+  char* bytes = AllocChars(byte_count);
+  const uint16_t* chars = s->GetCharArray()->GetData() + s->GetOffset();
+  ConvertUtf16ToModifiedUtf8(bytes, chars, s->GetLength());
+  bytes[byte_count] = '\0';
+  // Entries of a past epoch may be for freed strings, they are never hit again.
+  if (byte_count <= kMaxCachedUtfLength && (gc_epoch & 1) == 0) {
+    if (entries_[kEntries - 1].string != NULL) {
+      ReleaseChars(entries_[kEntries - 1].chars);
+    }
+    memmove(&entries_[1], &entries_[0], (kEntries - 1) * sizeof(Entry));
+    entries_[0].string = s;
+    entries_[0].gc_epoch = gc_epoch;
+    entries_[0].chars = bytes;
+    android_atomic_inc(&GetUtfCharsHeader(bytes)->references);
+  }
+  return bytes;
+}
+
 void JNIEnvExt::SetCheckJniEnabled(bool enabled) {
   check_jni = enabled;
   functions = enabled ? GetCheckJniNativeInterface() : &gJniNativeInterface;
@@ -2996,10 +3106,9 @@ JavaVMExt::JavaVMExt(Runtime* runtime, Runtime::ParsedOptions* options)
       check_jni_abort_hook_data(NULL),
       check_jni(false),
       force_copy(false),  // TODO: add a way to enable this
+      check_jni_rate(options->check_jni_rate_),
       trace(options->jni_trace_),
       work_around_app_jni_bugs(false),
-      pins_lock("JNI pin table lock", kPinTableLock),
-      pin_table("pin table", kPinTableInitial, kPinTableMax),
       globals_lock("JNI global reference table lock"),
       globals(gGlobalsInitial, gGlobalsMax, kGlobal),
       libraries_lock("JNI shared libraries map lock", kLoadLibraryLock),
@@ -3050,10 +3159,7 @@ void JavaVMExt::DumpForSigQuit(std::ostream& os) {
   }
   os << "; workarounds are " << (work_around_app_jni_bugs ? "on" : "off");
   Thread* self = Thread::Current();
-  {
-    MutexLock mu(self, pins_lock);
-    os << "; pins=" << pin_table.Size();
-  }
+  os << "; pins=" << Runtime::Current()->GetHeap()->GetPinnedObjectCount(self);
   {
     ReaderMutexLock mu(self, globals_lock);
     os << "; globals=" << globals.Capacity();
@@ -3111,10 +3217,7 @@ void JavaVMExt::DumpReferenceTables(std::ostream& os) {
     MutexLock mu(self, weak_globals_lock_);
     weak_globals_.Dump(os);
   }
-  {
-    MutexLock mu(self, pins_lock);
-    pin_table.Dump(os);
-  }
+  Runtime::Current()->GetHeap()->DumpPinnedObjects(os);
 }
 
 bool JavaVMExt::LoadNativeLibrary(const std::string& path, ClassLoader* class_loader,
@@ -3259,8 +3362,12 @@ void* JavaVMExt::FindCodeForNativeMethod(ArtMethod* m) {
     CHECK(c->IsInitializing()) << c->GetStatus() << " " << PrettyMethod(m);
   }
 
+  void* native_method = FindLazyNativeMethod(m);
+  if (native_method != NULL) {
+    return native_method;
+  }
+
   std::string detail;
-  void* native_method;
   Thread* self = Thread::Current();
   {
     MutexLock mu(self, libraries_lock);
@@ -3274,26 +3381,91 @@ void* JavaVMExt::FindCodeForNativeMethod(ArtMethod* m) {
   return native_method;
 }
 
+void JavaVMExt::AddLazyNativeMethods(const char* jni_class_name,
+                                     const JNINativeMethod* methods, jint method_count) {
+  LazyNativeMethods lazy_methods;
+  lazy_methods.descriptor = StringPrintf("L%s;", jni_class_name);
+  lazy_methods.methods = methods;
+  lazy_methods.method_count = method_count;
+  std::vector<LazyNativeMethods>::iterator it =
+      std::lower_bound(lazy_native_methods_.begin(), lazy_native_methods_.end(), lazy_methods);
+  CHECK(it == lazy_native_methods_.end() || it->descriptor != lazy_methods.descriptor)
+      << "Native methods of " << jni_class_name << " added twice";
+  lazy_native_methods_.insert(it, lazy_methods);
+}
+
+void* JavaVMExt::FindLazyNativeMethod(ArtMethod* m) {
+  MethodHelper mh(m);
+  LazyNativeMethods key;
+  key.descriptor = mh.GetDeclaringClassDescriptor();
+  std::vector<LazyNativeMethods>::const_iterator it =
+      std::lower_bound(lazy_native_methods_.begin(), lazy_native_methods_.end(), key);
+  if (it == lazy_native_methods_.end() || it->descriptor != key.descriptor) {
+    return NULL;
+  }
+  const char* name = mh.GetName();
+  const std::string signature(mh.GetSignature());
+  for (jint i = 0; i < it->method_count; ++i) {
+    const char* sig = it->methods[i].signature;
+    if (*sig == '!') {
+      ++sig;
+    }
+    if (strcmp(name, it->methods[i].name) == 0 && signature == sig) {
+      VLOG(jni) << "[Binding runtime native method " << PrettyMethod(m) << "]";
+      return it->methods[i].fnPtr;
+    }
+  }
+  return NULL;
+}
+
 void JavaVMExt::VisitRoots(RootVisitor* visitor, void* arg) {
   Thread* self = Thread::Current();
   {
     ReaderMutexLock mu(self, globals_lock);
     globals.VisitRoots(visitor, arg);
   }
-  {
-    MutexLock mu(self, pins_lock);
-    pin_table.VisitRoots(visitor, arg);
-  }
+  // Pinned arrays are visited with the heap's other pinned objects.
   // The weak_globals table is visited by the GC itself (because it mutates the table).
 }
 
 void RegisterNativeMethods(JNIEnv* env, const char* jni_class_name, const JNINativeMethod* methods,
                            jint method_count) {
-  ScopedLocalRef<jclass> c(env, env->FindClass(jni_class_name));
-  if (c.get() == NULL) {
-    LOG(FATAL) << "Couldn't find class: " << jni_class_name;
+  // Binding every method up front would look each of them up while the runtime starts, whether or
+  // not it's ever called. Leave them on the dlsym lookup stub, which binds them on first call.
+  if (kIsDebugBuild) {
+    // Check the tables now rather than when a misspelled method is first called.
+    ScopedLocalRef<jclass> c(env, env->FindClass(jni_class_name));
+    if (c.get() == NULL) {
+      LOG(FATAL) << "Couldn't find class: " << jni_class_name;
+    }
+    ScopedObjectAccess soa(env);
+    Class* klass = soa.Decode<Class*>(c.get());
+    for (jint i = 0; i < method_count; ++i) {
+      const char* name = methods[i].name;
+      const char* sig = methods[i].signature;
+      if (*sig == '!') {
+        ++sig;
+      }
+      ArtMethod* m = klass->FindDirectMethod(name, sig);
+      if (m == NULL) {
+        m = klass->FindVirtualMethod(name, sig);
+      }
+      CHECK(m != NULL && m->IsNative()) << "Bad runtime native method "
+          << PrettyDescriptor(klass) << "." << name << sig;
+    }
   }
-  JNI::RegisterNativeMethods(env, c.get(), methods, method_count, false);
+  reinterpret_cast<JNIEnvExt*>(env)->vm->AddLazyNativeMethods(jni_class_name, methods,
+                                                              method_count);
+}
+
+void GetObjectArrayRegion(JNIEnv* env, jobjectArray array, jsize start, jsize length,
+                          jobject* buf) {
+  JNI::GetObjectArrayRegion(env, array, start, length, buf);
+}
+
+void SetObjectArrayRegion(JNIEnv* env, jobjectArray array, jsize start, jsize length,
+                          const jobject* buf) {
+  JNI::SetObjectArrayRegion(env, array, start, length, buf);
 }
 
 }  // namespace art
@@ -28,6 +28,7 @@
 
 #include <iosfwd>
 #include <string>
+#include <vector>
 
 #ifndef NATIVE_METHOD
 #define NATIVE_METHOD(className, functionName, signature) \
@@ -41,6 +42,7 @@ namespace mirror {
   class ArtField;
   class ArtMethod;
   class ClassLoader;
+  class String;
 }  // namespace mirror
 class ArgArray;
 union JValue;
@@ -61,6 +63,17 @@ void InvokeWithArgArray(const ScopedObjectAccess& soa, mirror::ArtMethod* method
 
 int ThrowNewException(JNIEnv* env, jclass exception_class, const char* msg, jobject cause);
 
+// Like Get<PrimitiveType>ArrayRegion and Set<PrimitiveType>ArrayRegion, for object arrays: one
+// transition to copy a range of elements instead of one per element, and one card mark for the
+// range stored into. The standard function table can't grow without breaking native libraries
+// built against it, so these are only for the runtime's own native code. GetObjectArrayRegion
+// adds a local reference per element. SetObjectArrayRegion throws ArrayStoreException at the
+// first value that isn't assignable, leaving the earlier ones stored.
+void GetObjectArrayRegion(JNIEnv* env, jobjectArray array, jsize start, jsize length,
+                          jobject* buf);
+void SetObjectArrayRegion(JNIEnv* env, jobjectArray array, jsize start, jsize length,
+                          const jobject* buf);
+
 class JavaVMExt : public JavaVM {
  public:
   JavaVMExt(Runtime* runtime, Runtime::ParsedOptions* options);
@@ -83,6 +96,14 @@ class JavaVMExt : public JavaVM {
   void* FindCodeForNativeMethod(mirror::ArtMethod* m)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
 
+  /**
+   * Records the runtime's own native methods of a class, which are bound to
+   * their methods on first call rather than now. Only called while the
+   * runtime starts, before other threads can call native methods.
+   */
+  void AddLazyNativeMethods(const char* jni_class_name, const JNINativeMethod* methods,
+                            jint method_count);
+
   void DumpForSigQuit(std::ostream& os);
 
   void DumpReferenceTables(std::ostream& os)
@@ -110,6 +131,8 @@ class JavaVMExt : public JavaVM {
   // Extra checking.
   bool check_jni;
   bool force_copy;
+  // Check the arguments of one in this many JNI calls, on average, 1 checks them all.
+  uint32_t check_jni_rate;
 
   // Extra diagnostics.
   std::string trace;
@@ -117,10 +140,6 @@ class JavaVMExt : public JavaVM {
   // Used to provide compatibility for apps that assumed direct references.
   bool work_around_app_jni_bugs;
 
-  // Used to hold references to pinned primitive arrays.
-  Mutex pins_lock DEFAULT_MUTEX_ACQUIRED_AFTER;
-  ReferenceTable pin_table GUARDED_BY(pins_lock);
-
   // JNI global references.
   ReaderWriterMutex globals_lock DEFAULT_MUTEX_ACQUIRED_AFTER;
   IndirectReferenceTable globals GUARDED_BY(globals_lock);
@@ -132,6 +151,22 @@ class JavaVMExt : public JavaVM {
   const JNIInvokeInterface* unchecked_functions;
 
  private:
+  struct LazyNativeMethods {
+    std::string descriptor;
+    const JNINativeMethod* methods;
+    jint method_count;
+
+    bool operator<(const LazyNativeMethods& other) const {
+      return descriptor < other.descriptor;
+    }
+  };
+
+  // Returns the code recorded by AddLazyNativeMethods for m, or NULL.
+  void* FindLazyNativeMethod(mirror::ArtMethod* m) SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
+  // Sorted by descriptor, and read without a lock as it doesn't change once the runtime started.
+  std::vector<LazyNativeMethods> lazy_native_methods_;
+
   // TODO: Make the other members of this class also private.
   // JNI weak global references.
   Mutex weak_globals_lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
@@ -140,6 +175,40 @@ class JavaVMExt : public JavaVM {
   ConditionVariable weak_globals_add_condition_ GUARDED_BY(weak_globals_lock_);
 };
 
+// A thread's most recent GetStringUTFChars conversions of short strings, so that native code
+// passing the same strings over and over converts them once. Strings are immutable, an entry
+// stays valid for as long as no garbage collection could have freed its string and reused the
+// address, see Heap::GetGcEpoch. The UTF-8 is reference counted and shared by the cache and every
+// caller it was returned to, which may release it from any thread.
+class JniUtfCache {
+ public:
+  JniUtfCache();
+  ~JniUtfCache();
+
+  // Returns the NUL terminated modified UTF-8 of the string, to be released with ReleaseChars.
+  const char* GetChars(mirror::String* s) SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
+  static void ReleaseChars(const char* chars);
+
+ private:
+  // Longer conversions aren't cached, so that a thread never holds on to much memory.
+  static constexpr size_t kMaxCachedUtfLength = 256;
+  static constexpr size_t kEntries = 8;
+
+  struct Entry {
+    const mirror::String* string;
+    uint32_t gc_epoch;
+    char* chars;
+  };
+
+  static char* AllocChars(size_t byte_count);
+
+  // Most recently used first, unused entries have a NULL string.
+  Entry entries_[kEntries];
+
+  DISALLOW_COPY_AND_ASSIGN(JniUtfCache);
+};
+
 struct JNIEnvExt : public JNIEnv {
   JNIEnvExt(Thread* self, JavaVMExt* vm);
   ~JNIEnvExt();
@@ -187,6 +256,14 @@ struct JNIEnvExt : public JNIEnv {
 
   // Used by -Xcheck:jni.
   const JNINativeInterface* unchecked_functions;
+
+  // Used by -Xjnicheckrate: how many more calls to skip checking the arguments of, and the state
+  // of the generator of those numbers.
+  uint32_t check_jni_skip;
+  uint32_t check_jni_random;
+
+  // Used by GetStringUTFChars.
+  JniUtfCache utf_cache;
 };
 
 const JNINativeInterface* GetCheckJniNativeInterface();
@@ -1291,6 +1291,43 @@ TEST_F(JniInternalTest, GetStringUTFChars_ReleaseStringUTFChars) {
   env_->ReleaseStringUTFChars(s, utf);
 }
 
+TEST_F(JniInternalTest, GetStringUTFChars_Cached) {
+  jstring s = env_->NewStringUTF("h\xc3\xa9llo");
+  ASSERT_TRUE(s != NULL);
+  gc::Heap* heap = Runtime::Current()->GetHeap();
+  uint32_t gc_epoch = heap->GetGcEpoch();
+  const char* utf = env_->GetStringUTFChars(s, NULL);
+  EXPECT_STREQ("h\xc3\xa9llo", utf);
+  // A cache hit shares the conversion, released as many times as it was returned.
+  const char* utf2 = env_->GetStringUTFChars(s, NULL);
+  EXPECT_STREQ("h\xc3\xa9llo", utf2);
+  if (heap->GetGcEpoch() == gc_epoch && (gc_epoch & 1) == 0) {
+    EXPECT_EQ(utf, utf2);
+  }
+  env_->ReleaseStringUTFChars(s, utf);
+  env_->ReleaseStringUTFChars(s, utf2);
+
+  // After a collection the string is converted again.
+  heap->CollectGarbage(false);
+  EXPECT_NE(gc_epoch, heap->GetGcEpoch());
+  utf = env_->GetStringUTFChars(s, NULL);
+  EXPECT_STREQ("h\xc3\xa9llo", utf);
+  env_->ReleaseStringUTFChars(s, utf);
+
+  // Strings that are evicted or too long to cache stay valid until released.
+  std::vector<const char*> utfs;
+  std::vector<jstring> strings;
+  for (size_t i = 0; i < 20; ++i) {
+    std::string chars(i * 30, 'a' + i);
+    strings.push_back(env_->NewStringUTF(chars.c_str()));
+    utfs.push_back(env_->GetStringUTFChars(strings.back(), NULL));
+  }
+  for (size_t i = 0; i < utfs.size(); ++i) {
+    EXPECT_EQ(std::string(i * 30, 'a' + i), utfs[i]);
+    env_->ReleaseStringUTFChars(strings[i], utfs[i]);
+  }
+}
+
 TEST_F(JniInternalTest, GetStringChars_ReleaseStringChars) {
   jstring s = env_->NewStringUTF("hello");
   ASSERT_TRUE(s != NULL);
@@ -1362,6 +1399,50 @@ TEST_F(JniInternalTest, GetObjectArrayElement_SetObjectArrayElement) {
   EXPECT_EXCEPTION(ase_);
 }
 
+TEST_F(JniInternalTest, GetObjectArrayRegion_SetObjectArrayRegion) {
+  jclass java_lang_Class = env_->FindClass("java/lang/Class");
+  ASSERT_TRUE(java_lang_Class != NULL);
+  jclass java_lang_Object = env_->FindClass("java/lang/Object");
+  ASSERT_TRUE(java_lang_Object != NULL);
+
+  jobjectArray array = env_->NewObjectArray(4, java_lang_Class, NULL);
+  ASSERT_TRUE(array != NULL);
+  jobject values[] = { java_lang_Class, NULL, java_lang_Object };
+  SetObjectArrayRegion(env_, array, 1, 3, values);
+  EXPECT_FALSE(env_->ExceptionCheck());
+  jobject elements[4];
+  GetObjectArrayRegion(env_, array, 0, 4, elements);
+  EXPECT_FALSE(env_->ExceptionCheck());
+  EXPECT_TRUE(elements[0] == NULL);
+  EXPECT_TRUE(env_->IsSameObject(elements[1], java_lang_Class));
+  EXPECT_TRUE(elements[2] == NULL);
+  EXPECT_TRUE(env_->IsSameObject(elements[3], java_lang_Object));
+
+  // ArrayIndexOutOfBounds for negative or too-large regions.
+  GetObjectArrayRegion(env_, array, -1, 1, elements);
+  EXPECT_EXCEPTION(aioobe_);
+  GetObjectArrayRegion(env_, array, 2, 3, elements);
+  EXPECT_EXCEPTION(aioobe_);
+  SetObjectArrayRegion(env_, array, 4, 1, values);
+  EXPECT_EXCEPTION(aioobe_);
+
+  // ArrayStoreException thrown for bad types, after storing the values before them.
+  jobject bad_values[] = { NULL, env_->NewStringUTF("not a jclass!"), NULL };
+  SetObjectArrayRegion(env_, array, 1, 3, bad_values);
+  EXPECT_EXCEPTION(ase_);
+  EXPECT_TRUE(env_->GetObjectArrayElement(array, 1) == NULL);
+  EXPECT_TRUE(env_->IsSameObject(env_->GetObjectArrayElement(array, 3), java_lang_Object));
+
+  // No check for an Object[].
+  jobjectArray objects = env_->NewObjectArray(2, java_lang_Object, NULL);
+  ASSERT_TRUE(objects != NULL);
+  SetObjectArrayRegion(env_, objects, 0, 2, bad_values + 1);
+  EXPECT_FALSE(env_->ExceptionCheck());
+  GetObjectArrayRegion(env_, objects, 0, 2, elements);
+  EXPECT_TRUE(env_->IsSameObject(elements[0], bad_values[1]));
+  EXPECT_TRUE(elements[1] == NULL);
+}
+
 #define EXPECT_STATIC_PRIMITIVE_FIELD(type, field_name, sig, value1, value2) \
   do { \
     jfieldID fid = env_->GetStaticFieldID(c, field_name, sig); \
@@ -57,7 +57,7 @@ void Locks::Init() {
     DCHECK(heap_bitmap_lock_ == NULL);
     heap_bitmap_lock_ = new ReaderWriterMutex("heap bitmap lock", kHeapBitmapLock);
     DCHECK(mutator_lock_ == NULL);
-    mutator_lock_ = new ReaderWriterMutex("mutator lock", kMutatorLock);
+    mutator_lock_ = new ReaderWriterMutex("mutator lock", kMutatorLock, true);
     DCHECK(runtime_shutdown_lock_ == NULL);
     runtime_shutdown_lock_ = new Mutex("runtime shutdown lock", kRuntimeShutdownLock);
     DCHECK(thread_list_lock_ == NULL);
@@ -38,7 +38,10 @@ enum LockLevel {
   kAbortLock,
   kJdwpSocketLock,
   kAllocSpaceLock,
+  kRunAllocSpaceBracketLock,
   kMarkSweepMarkStackLock,
+  kTraceChunkLock,
+  kDexCacheOverflowLock,
   kDefaultMutexLevel,
   kMarkSweepLargeObjectLock,
   kPinTableLock,
@@ -17,12 +17,18 @@
 #ifndef ART_RUNTIME_MAPPING_TABLE_H_
 #define ART_RUNTIME_MAPPING_TABLE_H_
 
+#include <algorithm>
+
 #include "base/logging.h"
 #include "leb128.h"
 
 namespace art {
 
 // A utility for processing the raw uleb128 encoded mapping table created by the quick compiler.
+// The total number of entries and the number of pc-to-dex entries are followed by the pc-to-dex
+// and then the dex-to-pc (native pc offset, dex pc) pairs. Each pair is stored as the sleb128
+// differences from the pair before, or from (0, 0) for the first pair of each table. The pairs
+// are in native pc order, so the differences mostly fit in a byte each.
 class MappingTable {
  public:
   explicit MappingTable(const uint8_t* encoded_map) : encoded_table_(encoded_map) {
@@ -54,8 +60,8 @@ class MappingTable {
       DecodeUnsignedLeb128(&table);  // Total_size, unused.
       uint32_t pc_to_dex_size = DecodeUnsignedLeb128(&table);
       for (uint32_t i = 0; i < pc_to_dex_size; ++i) {
-        DecodeUnsignedLeb128(&table);  // Move ptr past native PC.
-        DecodeUnsignedLeb128(&table);  // Move ptr past dex PC.
+        DecodeSignedLeb128(&table);  // Move ptr past native PC delta.
+        DecodeSignedLeb128(&table);  // Move ptr past dex PC delta.
       }
     }
     return table;
@@ -68,8 +74,8 @@ class MappingTable {
         native_pc_offset_(0), dex_pc_(0) {
       if (element == 0) {
         encoded_table_ptr_ = table_->FirstDexToPcPtr();
-        native_pc_offset_ = DecodeUnsignedLeb128(&encoded_table_ptr_);
-        dex_pc_ = DecodeUnsignedLeb128(&encoded_table_ptr_);
+        native_pc_offset_ = DecodeSignedLeb128(&encoded_table_ptr_);
+        dex_pc_ = DecodeSignedLeb128(&encoded_table_ptr_);
       } else {
         DCHECK_EQ(table_->DexToPcSize(), element);
       }
@@ -83,8 +89,8 @@ class MappingTable {
     void operator++() {
       ++element_;
       if (element_ != end_) {  // Avoid reading beyond the end of the table.
-        native_pc_offset_ = DecodeUnsignedLeb128(&encoded_table_ptr_);
-        dex_pc_ = DecodeUnsignedLeb128(&encoded_table_ptr_);
+        native_pc_offset_ += DecodeSignedLeb128(&encoded_table_ptr_);
+        dex_pc_ += DecodeSignedLeb128(&encoded_table_ptr_);
       }
     }
     bool operator==(const DexToPcIterator& rhs) const {
@@ -141,8 +147,8 @@ class MappingTable {
         native_pc_offset_(0), dex_pc_(0) {
       if (element == 0) {
         encoded_table_ptr_ = table_->FirstPcToDexPtr();
-        native_pc_offset_ = DecodeUnsignedLeb128(&encoded_table_ptr_);
-        dex_pc_ = DecodeUnsignedLeb128(&encoded_table_ptr_);
+        native_pc_offset_ = DecodeSignedLeb128(&encoded_table_ptr_);
+        dex_pc_ = DecodeSignedLeb128(&encoded_table_ptr_);
       } else {
         DCHECK_EQ(table_->PcToDexSize(), element);
       }
@@ -156,8 +162,8 @@ class MappingTable {
     void operator++() {
       ++element_;
       if (element_ != end_) {  // Avoid reading beyond the end of the table.
-        native_pc_offset_ = DecodeUnsignedLeb128(&encoded_table_ptr_);
-        dex_pc_ = DecodeUnsignedLeb128(&encoded_table_ptr_);
+        native_pc_offset_ += DecodeSignedLeb128(&encoded_table_ptr_);
+        dex_pc_ += DecodeSignedLeb128(&encoded_table_ptr_);
       }
     }
     bool operator==(const PcToDexIterator& rhs) const {
@@ -187,6 +193,118 @@ class MappingTable {
     return PcToDexIterator(this, size);
   }
 
+  // The catch table follows the dex-to-pc mappings. It starts with the number of pc-to-dex
+  // entries that lie in a try block and the size in bytes of the (native pc offset, handler list
+  // offset) pairs for them that follow. The handler lists come after the pairs, which count their
+  // offsets from the first list. A handler list is a count followed by a (type index + 1 or 0 to
+  // catch all, handler dex pc, handler native pc offset * 2 + 1 if the handler doesn't start
+  // with a move-exception) triple per handler, in the order of the dex file's catch handler.
+  const uint8_t* FirstCatchSitePtr() const {
+    const uint8_t* table = FirstDexToPcPtr();
+    if (table != NULL) {
+      uint32_t dex_to_pc_size = DexToPcSize();
+      for (uint32_t i = 0; i < dex_to_pc_size; ++i) {
+        DecodeSignedLeb128(&table);  // Move ptr past native PC delta.
+        DecodeSignedLeb128(&table);  // Move ptr past dex PC delta.
+      }
+    }
+    return table;
+  }
+
+  // Iterates over the handlers of one entry of the catch table.
+  class CatchHandlerIterator {
+   public:
+    explicit CatchHandlerIterator(const uint8_t* handler_list)
+        : encoded_table_ptr_(handler_list), remaining_(0), type_idx_plus_one_(0), dex_pc_(0),
+          native_pc_offset_and_flag_(0) {
+      if (encoded_table_ptr_ != NULL) {
+        remaining_ = DecodeUnsignedLeb128(&encoded_table_ptr_);
+        Next();
+      }
+    }
+    bool HasNext() const {
+      return dex_pc_ != kNoHandler;
+    }
+    void Next() {
+      if (remaining_ == 0) {
+        dex_pc_ = kNoHandler;
+        return;
+      }
+      --remaining_;
+      type_idx_plus_one_ = DecodeUnsignedLeb128(&encoded_table_ptr_);
+      dex_pc_ = DecodeUnsignedLeb128(&encoded_table_ptr_);
+      native_pc_offset_and_flag_ = DecodeUnsignedLeb128(&encoded_table_ptr_);
+    }
+    bool IsCatchAll() const {
+      return type_idx_plus_one_ == 0;
+    }
+    uint16_t GetHandlerTypeIndex() const {
+      DCHECK(!IsCatchAll());
+      return type_idx_plus_one_ - 1;
+    }
+    uint32_t GetHandlerDexPc() const {
+      return dex_pc_;
+    }
+    uint32_t GetHandlerNativePcOffset() const {
+      return native_pc_offset_and_flag_ >> 1;
+    }
+    bool HasNoMoveException() const {
+      return (native_pc_offset_and_flag_ & 1) != 0;
+    }
+
+   private:
+    static const uint32_t kNoHandler = 0xFFFFFFFF;
+
+    const uint8_t* encoded_table_ptr_;  // Points to encoded data after the current handler.
+    uint32_t remaining_;  // Handlers after the current one.
+    uint32_t type_idx_plus_one_;
+    uint32_t dex_pc_;  // kNoHandler once past the last handler.
+    uint32_t native_pc_offset_and_flag_;
+  };
+
+  // The size in bytes of the encoded table, catch table included.
+  size_t SizeInBytes() const {
+    const uint8_t* table = FirstCatchSitePtr();
+    if (table == NULL) {
+      return 0;
+    }
+    uint32_t catch_sites = DecodeUnsignedLeb128(&table);
+    uint32_t catch_sites_size = DecodeUnsignedLeb128(&table);
+    const uint8_t* const handler_lists = table + catch_sites_size;
+    // Sites share handler lists, so the table ends with whichever list ends last.
+    const uint8_t* end = handler_lists;
+    for (uint32_t i = 0; i < catch_sites; ++i) {
+      DecodeUnsignedLeb128(&table);  // Move ptr past native PC offset.
+      const uint8_t* handler_list = handler_lists + DecodeUnsignedLeb128(&table);
+      uint32_t handlers = DecodeUnsignedLeb128(&handler_list);
+      for (uint32_t j = 0; j < handlers * 3; ++j) {
+        DecodeUnsignedLeb128(&handler_list);
+      }
+      end = std::max(end, handler_list);
+    }
+    return end - encoded_table_;
+  }
+
+  // Returns the handlers of the call at native_pc_offset, which are empty if it isn't in a try
+  // block.
+  CatchHandlerIterator FindCatchHandlers(uint32_t native_pc_offset) const {
+    const uint8_t* table = FirstCatchSitePtr();
+    if (table == NULL) {
+      return CatchHandlerIterator(NULL);
+    }
+    uint32_t catch_sites = DecodeUnsignedLeb128(&table);
+    uint32_t catch_sites_size = DecodeUnsignedLeb128(&table);
+    const uint8_t* const handler_lists = table + catch_sites_size;
+    for (uint32_t i = 0; i < catch_sites; ++i) {
+      uint32_t site_native_pc_offset = DecodeUnsignedLeb128(&table);
+      uint32_t handler_list_offset = DecodeUnsignedLeb128(&table);
+      if (site_native_pc_offset == native_pc_offset) {
+        return CatchHandlerIterator(handler_lists + handler_list_offset);
+      }
+    }
+    return CatchHandlerIterator(NULL);
+  }
+
  private:
   const uint8_t* const encoded_table_;
 };
@@ -30,6 +30,8 @@
 
 namespace art {
 
+bool MemMap::use_huge_pages_ = false;
+
 #if !defined(NDEBUG)
 
 static std::ostream& operator<<(std::ostream& os, map_info_t* rhs) {
@@ -102,6 +104,66 @@ MemMap* MemMap::MapAnonymous(const char* name, byte* addr, size_t byte_count, in
   return new MemMap(name, actual, byte_count, actual, page_aligned_byte_count, prot);
 }
 
+MemMap* MemMap::MapAnonymousAligned(const char* name, size_t byte_count, int prot,
+                                    size_t alignment) {
+  return MapAnonymousAt(name, NULL, byte_count, prot, alignment);
+}
+
+MemMap* MemMap::MapAnonymousHugePages(const char* name, byte* addr, size_t byte_count,
+                                      int prot) {
+  if (!use_huge_pages_ || byte_count < kHugePageSize) {
+    return MapAnonymous(name, addr, byte_count, prot);
+  }
+  // Transparent huge pages only back private anonymous memory, not ashmem.
+  size_t alignment = (addr == NULL) ? kHugePageSize : kPageSize;
+  MemMap* map = MapAnonymousAt(name, addr, byte_count, prot, alignment);
+  if (map != NULL) {
+    map->AdviseHugePages();
+  }
+  return map;
+}
+
+MemMap* MemMap::MapAnonymousAt(const char* name, byte* addr, size_t byte_count, int prot,
+                               size_t alignment) {
+  CHECK(IsPowerOfTwo(alignment)) << alignment;
+  CHECK_EQ(alignment % kPageSize, 0U) << alignment;
+  CHECK_EQ(reinterpret_cast<uintptr_t>(addr) % alignment, 0U) << reinterpret_cast<void*>(addr);
+  if (byte_count == 0) {
+    return new MemMap(name, NULL, 0, NULL, 0, prot);
+  }
+  size_t page_aligned_byte_count = RoundUp(byte_count, kPageSize);
+  // Without a requested address, map enough that an aligned region fits wherever the mapping
+  // lands, then unmap what is left over on either side of it.
+  size_t reserve_byte_count = page_aligned_byte_count;
+  if (addr == NULL) {
+    reserve_byte_count += alignment - kPageSize;
+  }
+  CheckMapRequest(addr, reserve_byte_count);
+  byte* actual = reinterpret_cast<byte*>(mmap(addr, reserve_byte_count, prot,
+                                              MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+  if (actual == MAP_FAILED) {
+    std::string maps;
+    ReadFileToString("/proc/self/maps", &maps);
+    PLOG(ERROR) << "mmap(" << reinterpret_cast<void*>(addr) << ", " << reserve_byte_count
+                << ", " << prot << ", MAP_PRIVATE | MAP_ANONYMOUS, -1, 0) failed for " << name
+                << "\n" << maps;
+    return NULL;
+  }
+  byte* begin = actual;
+  if (addr == NULL) {
+    begin = reinterpret_cast<byte*>(RoundUp(reinterpret_cast<uintptr_t>(actual), alignment));
+    byte* end = begin + page_aligned_byte_count;
+    byte* reserve_end = actual + reserve_byte_count;
+    if (begin != actual) {
+      CHECK_EQ(munmap(actual, begin - actual), 0) << name;
+    }
+    if (end != reserve_end) {
+      CHECK_EQ(munmap(end, reserve_end - end), 0) << name;
+    }
+  }
+  return new MemMap(name, begin, byte_count, begin, page_aligned_byte_count, prot);
+}
+
 MemMap* MemMap::MapFileAtAddress(byte* addr, size_t byte_count,
                                  int prot, int flags, int fd, off_t start, bool reuse) {
   CHECK_NE(0, prot);
@@ -176,6 +238,20 @@ void MemMap::UnMapAtEnd(byte* new_end) {
   size_ -= unmap_size;
 }
 
+bool MemMap::AdviseHugePages() {
+#ifdef MADV_HUGEPAGE
+  if (base_size_ == 0) {
+    return true;
+  }
+  if (madvise(base_begin_, base_size_, MADV_HUGEPAGE) == 0) {
+    return true;
+  }
+  VLOG(heap) << "madvise(" << base_begin_ << ", " << base_size_ << ", MADV_HUGEPAGE) failed for "
+             << name_ << ": " << strerror(errno);
+#endif
+  return false;
+}
+
 bool MemMap::Protect(int prot) {
   if (base_begin_ == NULL && base_size_ == 0) {
     prot_ = prot;
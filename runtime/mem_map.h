@@ -40,6 +40,21 @@ class MemMap {
   // On success, returns returns a MemMap instance.  On failure, returns a NULL;
   static MemMap* MapAnonymous(const char* ashmem_name, byte* addr, size_t byte_count, int prot);
 
+  // Request an anonymous region of length 'byte_count' starting at a multiple of 'alignment', a
+  // power of two multiple of the page size. The region is private anonymous memory rather than
+  // ashmem, so it isn't named in the maps.
+  //
+  // On success, returns returns a MemMap instance.  On failure, returns a NULL;
+  static MemMap* MapAnonymousAligned(const char* name, size_t byte_count, int prot,
+                                     size_t alignment);
+
+  // Request an anonymous region for a large and densely used structure, such as a heap space or
+  // its card table or bitmaps. When huge pages are enabled, the region starts on a huge page
+  // boundary, unless 'addr' asks for another start, and is advised to be backed by huge pages.
+  // Otherwise this is MapAnonymous.
+  static MemMap* MapAnonymousHugePages(const char* name, byte* addr, size_t byte_count,
+                                       int prot);
+
   // Map part of a file, taking care of non-page aligned offsets.  The
   // "start" offset is absolute, not relative.
   //
@@ -84,10 +99,32 @@ class MemMap {
   // Trim by unmapping pages at the end of the map.
   void UnMapAtEnd(byte* new_end);
 
+  // Ask the kernel to back the map with transparent huge pages. Only its huge page aligned parts
+  // can be. Returns false if the kernel has no support for them.
+  bool AdviseHugePages();
+
+  // Whether MapAnonymousHugePages uses huge pages. Set from -XX:UseHugePages before the heap is
+  // created.
+  static void SetUseHugePages(bool use_huge_pages) {
+    use_huge_pages_ = use_huge_pages;
+  }
+
+  static bool UseHugePages() {
+    return use_huge_pages_;
+  }
+
+  // The size of a transparent huge page.
+  static const size_t kHugePageSize = 2 * MB;
+
  private:
   MemMap(const std::string& name, byte* begin, size_t size, void* base_begin, size_t base_size,
          int prot);
 
+  static MemMap* MapAnonymousAt(const char* name, byte* addr, size_t byte_count, int prot,
+                                size_t alignment);
+
+  static bool use_huge_pages_;
+
   std::string name_;
   byte* const begin_;  // Start of data.
   size_t size_;  // Length of data.
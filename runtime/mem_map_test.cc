@@ -31,4 +31,27 @@ TEST_F(MemMapTest, MapAnonymousEmpty) {
   ASSERT_TRUE(map.get() != NULL);
 }
 
+TEST_F(MemMapTest, MapAnonymousAligned) {
+  UniquePtr<MemMap> map(MemMap::MapAnonymousAligned("MapAnonymousAligned",
+                                                    3 * kPageSize,
+                                                    PROT_READ | PROT_WRITE,
+                                                    MemMap::kHugePageSize));
+  ASSERT_TRUE(map.get() != NULL);
+  EXPECT_EQ(0U, reinterpret_cast<uintptr_t>(map->Begin()) % MemMap::kHugePageSize);
+  EXPECT_EQ(3 * kPageSize, map->Size());
+  map->Begin()[map->Size() - 1] = 1;
+}
+
+TEST_F(MemMapTest, MapAnonymousHugePages) {
+  MemMap::SetUseHugePages(true);
+  UniquePtr<MemMap> map(MemMap::MapAnonymousHugePages("MapAnonymousHugePages",
+                                                      NULL,
+                                                      MemMap::kHugePageSize + kPageSize,
+                                                      PROT_READ | PROT_WRITE));
+  MemMap::SetUseHugePages(false);
+  ASSERT_TRUE(map.get() != NULL);
+  EXPECT_EQ(0U, reinterpret_cast<uintptr_t>(map->Begin()) % MemMap::kHugePageSize);
+  EXPECT_EQ(MemMap::kHugePageSize + kPageSize, map->Size());
+}
+
 }  // namespace art
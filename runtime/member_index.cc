@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "member_index.h"
+
+#include <algorithm>
+
+#include "base/stl_util.h"
+#include "mirror/art_field-inl.h"
+#include "mirror/art_method-inl.h"
+#include "mirror/class-inl.h"
+#include "object_utils.h"
+#include "thread.h"
+
+namespace art {
+
+uint32_t MemberNameIndex::Hash(const char* data, size_t length) {
+  uint32_t hash = 0;
+  for (size_t i = 0; i < length; ++i) {
+    hash = hash * 31 + data[i];
+  }
+  // Overloads and accessors often only differ in their last characters.
+  return hash ^ (hash >> 16);
+}
+
+void MemberNameIndex::Sort() {
+  std::sort(entries_.begin(), entries_.end());
+}
+
+MemberCandidates MemberNameIndex::Find(const StringPiece& name) const {
+  const std::pair<uint32_t, uint32_t> first(Hash(name.data(), name.size()), 0);
+  std::vector<std::pair<uint32_t, uint32_t> >::const_iterator begin =
+      std::lower_bound(entries_.begin(), entries_.end(), first);
+  std::vector<std::pair<uint32_t, uint32_t> >::const_iterator end = begin;
+  while (end != entries_.end() && end->first == first.first) {
+    ++end;
+  }
+  return MemberCandidates(begin == end ? NULL : &*begin, end - begin);
+}
+
+MemberIndexTable::MemberIndexTable() : lock_("member index table lock") {
+}
+
+MemberIndexTable::~MemberIndexTable() {
+  STLDeleteValues(&indexes_);
+}
+
+size_t MemberIndexTable::NumMembers(const mirror::Class* klass, MemberKind kind) {
+  switch (kind) {
+    case kDirectMethods:
+      return klass->NumDirectMethods();
+    case kVirtualMethods:
+      return klass->NumVirtualMethods();
+    case kInstanceFields:
+      return klass->NumInstanceFields();
+    case kStaticFields:
+      return klass->NumStaticFields();
+    default:
+      LOG(FATAL) << "Unexpected member kind " << kind;
+      return 0;
+  }
+}
+
+MemberIndexTable::ClassIndex* MemberIndexTable::Build(const mirror::Class* klass) {
+  ClassIndex* index = new ClassIndex;
+  MethodHelper mh;
+  for (size_t i = 0; i < klass->NumDirectMethods(); ++i) {
+    mh.ChangeMethod(klass->GetDirectMethod(i));
+    index->members[kDirectMethods].Add(mh.GetName(), i);
+  }
+  for (size_t i = 0; i < klass->NumVirtualMethods(); ++i) {
+    mh.ChangeMethod(klass->GetVirtualMethod(i));
+    index->members[kVirtualMethods].Add(mh.GetName(), i);
+  }
+  FieldHelper fh;
+  for (size_t i = 0; i < klass->NumInstanceFields(); ++i) {
+    fh.ChangeField(klass->GetInstanceField(i));
+    index->members[kInstanceFields].Add(fh.GetName(), i);
+  }
+  for (size_t i = 0; i < klass->NumStaticFields(); ++i) {
+    fh.ChangeField(klass->GetStaticField(i));
+    index->members[kStaticFields].Add(fh.GetName(), i);
+  }
+  for (size_t kind = 0; kind < kMemberKinds; ++kind) {
+    index->members[kind].Sort();
+  }
+  return index;
+}
+
+MemberCandidates MemberIndexTable::Find(const mirror::Class* klass, MemberKind kind,
+                                        const StringPiece& name) {
+  size_t num_members = NumMembers(klass, kind);
+  // The members of classes being loaded and linked may still change.
+  if (num_members < kMinIndexedMembers || !klass->IsResolved()) {
+    return MemberCandidates(num_members);
+  }
+  Thread* self = Thread::Current();
+  const ClassIndex* index = NULL;
+  {
+    MutexLock mu(self, lock_);
+    SafeMap<const mirror::Class*, const ClassIndex*>::const_iterator it = indexes_.find(klass);
+    if (it != indexes_.end()) {
+      index = it->second;
+    }
+  }
+  if (index == NULL) {
+    // Build outside the lock, threads indexing the same class together keep the first index.
+    ClassIndex* new_index = Build(klass);
+    MutexLock mu(self, lock_);
+    SafeMap<const mirror::Class*, const ClassIndex*>::const_iterator it = indexes_.find(klass);
+    if (it != indexes_.end()) {
+      delete new_index;
+      index = it->second;
+    } else {
+      indexes_.Put(klass, new_index);
+      index = new_index;
+    }
+  }
+  return index->members[kind].Find(name);
+}
+
+}  // namespace art
@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ART_RUNTIME_MEMBER_INDEX_H_
+#define ART_RUNTIME_MEMBER_INDEX_H_
+
+#include <string.h>
+
+#include <utility>
+#include <vector>
+
+#include "base/logging.h"
+#include "base/macros.h"
+#include "base/mutex.h"
+#include "base/stringpiece.h"
+#include "safe_map.h"
+
+namespace art {
+namespace mirror {
+class Class;
+}  // namespace mirror
+
+// The positions, in an array of methods or fields, of the members that may have a given name:
+// those whose names have the same hash, or all of them when the array isn't indexed.
+class MemberCandidates {
+ public:
+  explicit MemberCandidates(size_t num_members)
+      : entries_(NULL), next_(0), end_(num_members) {}
+
+  MemberCandidates(const std::pair<uint32_t, uint32_t>* entries, size_t num_entries)
+      : entries_(entries), next_(0), end_(num_entries) {}
+
+  bool Done() const {
+    return next_ == end_;
+  }
+
+  size_t Next() {
+    DCHECK(!Done());
+    size_t i = next_++;
+    return entries_ == NULL ? i : entries_[i].second;
+  }
+
+ private:
+  const std::pair<uint32_t, uint32_t>* entries_;
+  size_t next_;
+  size_t end_;
+};
+
+// The positions of the members in an array of methods or fields, sorted by the hash of their
+// names.
+class MemberNameIndex {
+ public:
+  MemberNameIndex() {}
+
+  void Add(const char* name, uint32_t position) {
+    entries_.push_back(std::make_pair(Hash(name, strlen(name)), position));
+  }
+
+  // Sorts the members added, the index can be searched after that.
+  void Sort();
+
+  // Returns the positions of the members that may be named name, in increasing order.
+  MemberCandidates Find(const StringPiece& name) const;
+
+ private:
+  static uint32_t Hash(const char* data, size_t length);
+
+  // The hash of a member's name and its position.
+  std::vector<std::pair<uint32_t, uint32_t> > entries_;
+
+  DISALLOW_COPY_AND_ASSIGN(MemberNameIndex);
+};
+
+// Indexes of the members that resolved classes declare, built on the first lookup by name of a
+// class with many members. Classes neither move nor change their members once resolved, so the
+// indexes are kept by class and never invalidated.
+class MemberIndexTable {
+ public:
+  enum MemberKind {
+    kDirectMethods,
+    kVirtualMethods,
+    kInstanceFields,
+    kStaticFields,
+    kMemberKinds,
+  };
+
+  MemberIndexTable();
+  ~MemberIndexTable();
+
+  // Returns the positions, in klass's array of members of the kind, of the members that may be
+  // named name.
+  MemberCandidates Find(const mirror::Class* klass, MemberKind kind, const StringPiece& name)
+      LOCKS_EXCLUDED(lock_) SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
+ private:
+  // Classes with fewer members of a kind have them compared one by one.
+  static constexpr size_t kMinIndexedMembers = 16;
+
+  struct ClassIndex {
+    MemberNameIndex members[kMemberKinds];
+  };
+
+  static size_t NumMembers(const mirror::Class* klass, MemberKind kind)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
+  static ClassIndex* Build(const mirror::Class* klass)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
+  Mutex lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
+
+  // Indexes are only ever added, and read without the lock once found.
+  SafeMap<const mirror::Class*, const ClassIndex*> indexes_ GUARDED_BY(lock_);
+
+  DISALLOW_COPY_AND_ASSIGN(MemberIndexTable);
+};
+
+}  // namespace art
+
+#endif  // ART_RUNTIME_MEMBER_INDEX_H_
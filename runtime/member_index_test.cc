@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "member_index.h"
+
+#include "common_test.h"
+#include "mirror/art_field-inl.h"
+#include "mirror/art_method-inl.h"
+#include "mirror/class-inl.h"
+#include "object_utils.h"
+#include "scoped_thread_state_change.h"
+
+namespace art {
+
+class MemberIndexTest : public CommonTest {};
+
+TEST_F(MemberIndexTest, NameIndex) {
+  MemberNameIndex index;
+  index.Add("toString", 0);
+  index.Add("hashCode", 1);
+  index.Add("toString", 2);
+  index.Add("equals", 3);
+  index.Sort();
+
+  MemberCandidates candidates(index.Find("toString"));
+  ASSERT_FALSE(candidates.Done());
+  EXPECT_EQ(0U, candidates.Next());
+  ASSERT_FALSE(candidates.Done());
+  EXPECT_EQ(2U, candidates.Next());
+  EXPECT_TRUE(candidates.Done());
+
+  candidates = index.Find("equals");
+  ASSERT_FALSE(candidates.Done());
+  EXPECT_EQ(3U, candidates.Next());
+  EXPECT_TRUE(candidates.Done());
+
+  EXPECT_TRUE(index.Find("clone").Done());
+
+  // Without an index every member is a candidate.
+  candidates = MemberCandidates(2);
+  EXPECT_EQ(0U, candidates.Next());
+  EXPECT_EQ(1U, candidates.Next());
+  EXPECT_TRUE(candidates.Done());
+}
+
+TEST_F(MemberIndexTest, FindDeclaredMembers) {
+  ScopedObjectAccess soa(Thread::Current());
+  // String has enough methods and fields to be indexed.
+  mirror::Class* klass = class_linker_->FindSystemClass("Ljava/lang/String;");
+  ASSERT_TRUE(klass != NULL);
+  ASSERT_TRUE(klass->IsResolved());
+  MethodHelper mh;
+  for (size_t i = 0; i < klass->NumDirectMethods(); ++i) {
+    mirror::ArtMethod* method = klass->GetDirectMethod(i);
+    mh.ChangeMethod(method);
+    EXPECT_EQ(method, klass->FindDeclaredDirectMethod(mh.GetName(), mh.GetSignature()))
+        << PrettyMethod(method);
+  }
+  for (size_t i = 0; i < klass->NumVirtualMethods(); ++i) {
+    mirror::ArtMethod* method = klass->GetVirtualMethod(i);
+    mh.ChangeMethod(method);
+    EXPECT_EQ(method, klass->FindDeclaredVirtualMethod(mh.GetName(), mh.GetSignature()))
+        << PrettyMethod(method);
+  }
+  FieldHelper fh;
+  for (size_t i = 0; i < klass->NumStaticFields(); ++i) {
+    mirror::ArtField* field = klass->GetStaticField(i);
+    fh.ChangeField(field);
+    EXPECT_EQ(field, klass->FindDeclaredStaticField(fh.GetName(), fh.GetTypeDescriptor()))
+        << PrettyField(field);
+  }
+  for (size_t i = 0; i < klass->NumInstanceFields(); ++i) {
+    mirror::ArtField* field = klass->GetInstanceField(i);
+    fh.ChangeField(field);
+    EXPECT_EQ(field, klass->FindDeclaredInstanceField(fh.GetName(), fh.GetTypeDescriptor()))
+        << PrettyField(field);
+  }
+
+  EXPECT_TRUE(klass->FindDeclaredVirtualMethod("length", "(I)I") == NULL);
+  EXPECT_TRUE(klass->FindDeclaredVirtualMethod("noSuchMethod", "()I") == NULL);
+  EXPECT_TRUE(klass->FindDeclaredInstanceField("count", "J") == NULL);
+  EXPECT_TRUE(klass->FindVirtualMethod("hashCode", "()I") != NULL);
+}
+
+}  // namespace art
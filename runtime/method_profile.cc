@@ -0,0 +1,196 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "method_profile.h"
+
+#include <stdlib.h>
+
+#include "base/logging.h"
+#include "base/stl_util.h"
+#include "base/stringprintf.h"
+#include "base/unix_file/fd_file.h"
+#include "cutils/atomic-inline.h"
+#include "dex_file.h"
+#include "os.h"
+#include "thread.h"
+#include "UniquePtr.h"
+#include "utils.h"
+
+namespace art {
+
+MethodProfile::MethodProfile()
+    : lock_("method profile lock"),
+      num_bound_dex_files_(0) {
+}
+
+MethodProfile::~MethodProfile() {
+  STLDeleteElements(&dex_files_);
+}
+
+MethodProfile::Counts* MethodProfile::GetCounts(const DexFile& dex_file, uint32_t method_idx) {
+  Counts* counts = FindBoundCounts(dex_file, method_idx);
+  if (LIKELY(counts != NULL)) {
+    return counts;
+  }
+  return LookupCounts(dex_file, method_idx, true);
+}
+
+MethodProfile::Counts* MethodProfile::FindCounts(const DexFile& dex_file, uint32_t method_idx) {
+  Counts* counts = FindBoundCounts(dex_file, method_idx);
+  if (LIKELY(counts != NULL)) {
+    return counts;
+  }
+  return LookupCounts(dex_file, method_idx, false);
+}
+
+MethodProfile::Counts* MethodProfile::FindBoundCounts(const DexFile& dex_file,
+                                                      uint32_t method_idx) {
+  // Dex files are only ever added, so a stale count misses at most the latest ones.
+  const int32_t num_bound = android_atomic_acquire_load(&num_bound_dex_files_);
+  for (int32_t i = 0; i < num_bound; ++i) {
+    DexFileCounts* dex_file_counts = bound_dex_files_[i];
+    // Also check the checksum, in case a closed dex file's DexFile got reused for another one.
+    if (dex_file_counts->dex_file == &dex_file &&
+        dex_file_counts->checksum == dex_file.GetLocationChecksum()) {
+      DCHECK_LT(method_idx, dex_file_counts->counts.size());
+      return &dex_file_counts->counts[method_idx];
+    }
+  }
+  return NULL;
+}
+
+MethodProfile::Counts* MethodProfile::LookupCounts(const DexFile& dex_file, uint32_t method_idx,
+                                                   bool add) {
+  MutexLock mu(Thread::Current(), lock_);
+  // Another thread may have bound the dex file while we were waiting for the lock.
+  Counts* counts = FindBoundCounts(dex_file, method_idx);
+  if (counts != NULL) {
+    return counts;
+  }
+  DexFileCounts* dex_file_counts = FindByLocation(dex_file.GetLocation(),
+                                                  dex_file.GetLocationChecksum());
+  if (dex_file_counts == NULL) {
+    if (!add) {
+      return NULL;
+    }
+    dex_file_counts = new DexFileCounts;
+    dex_file_counts->location = dex_file.GetLocation();
+    dex_file_counts->checksum = dex_file.GetLocationChecksum();
+    dex_file_counts->dex_file = NULL;
+    dex_files_.push_back(dex_file_counts);
+  }
+  if (static_cast<size_t>(num_bound_dex_files_) == kMaxDexFiles) {
+    LOG(WARNING) << "Too many dex files to profile " << dex_file.GetLocation();
+    return NULL;
+  }
+  // Method indices read from a profile file are only trusted up to the dex file's method count.
+  dex_file_counts->dex_file = &dex_file;
+  dex_file_counts->counts.resize(dex_file.NumMethodIds());
+  Publish(dex_file_counts);
+  return &dex_file_counts->counts[method_idx];
+}
+
+MethodProfile::DexFileCounts* MethodProfile::FindByLocation(const std::string& location,
+                                                            uint32_t checksum) {
+  for (DexFileCounts* dex_file_counts : dex_files_) {
+    if (dex_file_counts->dex_file == NULL && dex_file_counts->checksum == checksum &&
+        dex_file_counts->location == location) {
+      return dex_file_counts;
+    }
+  }
+  return NULL;
+}
+
+void MethodProfile::Publish(DexFileCounts* dex_file_counts) {
+  const int32_t num_bound = num_bound_dex_files_;
+  DCHECK_LT(static_cast<size_t>(num_bound), kMaxDexFiles);
+  bound_dex_files_[num_bound] = dex_file_counts;
+  // The entry and its counts must be visible before lookups can reach them.
+  android_atomic_release_store(num_bound + 1, &num_bound_dex_files_);
+}
+
+bool MethodProfile::ReadFromFile(const std::string& filename) {
+  std::string contents;
+  if (!ReadFileToString(filename, &contents)) {
+    return false;
+  }
+  std::vector<std::string> lines;
+  Split(contents, '\n', lines);
+  MutexLock mu(Thread::Current(), lock_);
+  DexFileCounts* dex_file_counts = NULL;
+  for (const std::string& line : lines) {
+    std::vector<std::string> fields;
+    Split(line, ' ', fields);
+    if (fields.size() == 3 && fields[0] == "dex") {
+      const std::string& location = fields[1];
+      const uint32_t checksum = strtoul(fields[2].c_str(), NULL, 16);
+      dex_file_counts = FindByLocation(location, checksum);
+      if (dex_file_counts == NULL) {
+        dex_file_counts = new DexFileCounts;
+        dex_file_counts->location = location;
+        dex_file_counts->checksum = checksum;
+        dex_file_counts->dex_file = NULL;
+        dex_files_.push_back(dex_file_counts);
+      }
+    } else if (fields.size() == 3 && dex_file_counts != NULL) {
+      const uint32_t method_idx = strtoul(fields[0].c_str(), NULL, 10);
+      const uint32_t invocations = strtoul(fields[1].c_str(), NULL, 10);
+      const uint32_t backedges = strtoul(fields[2].c_str(), NULL, 10);
+      if (method_idx >= dex_file_counts->counts.size()) {
+        dex_file_counts->counts.resize(method_idx + 1);
+      }
+      dex_file_counts->counts[method_idx].invocations += invocations;
+      dex_file_counts->counts[method_idx].backedges += backedges;
+    } else {
+      LOG(WARNING) << "Bad line in profile file " << filename << ": " << line;
+      return false;
+    }
+  }
+  return true;
+}
+
+bool MethodProfile::WriteToFile(const std::string& filename) {
+  std::string contents;
+  {
+    MutexLock mu(Thread::Current(), lock_);
+    for (const DexFileCounts* dex_file_counts : dex_files_) {
+      std::string methods;
+      for (size_t i = 0; i < dex_file_counts->counts.size(); ++i) {
+        const Counts& counts = dex_file_counts->counts[i];
+        if (counts.invocations != 0 || counts.backedges != 0) {
+          StringAppendF(&methods, "%zd %u %u\n", i, counts.invocations, counts.backedges);
+        }
+      }
+      if (!methods.empty()) {
+        StringAppendF(&contents, "dex %s %08x\n", dex_file_counts->location.c_str(),
+                      dex_file_counts->checksum);
+        contents += methods;
+      }
+    }
+  }
+  UniquePtr<File> file(OS::CreateEmptyFile(filename.c_str()));
+  if (file.get() == NULL) {
+    PLOG(WARNING) << "Failed to create profile file " << filename;
+    return false;
+  }
+  if (!file->WriteFully(contents.data(), contents.size())) {
+    PLOG(WARNING) << "Failed to write profile file " << filename;
+    return false;
+  }
+  return true;
+}
+
+}  // namespace art
@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ART_RUNTIME_METHOD_PROFILE_H_
+#define ART_RUNTIME_METHOD_PROFILE_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "base/macros.h"
+#include "base/mutex.h"
+
+namespace art {
+
+class DexFile;
+
+// Per method invocation and backedge counts, recorded by the interpreter when the runtime is
+// started with -Xmethod-profile-file and read by dex2oat's --profile-file to decide what to compile.
+//
+// Counts are kept per dex file, identified by location and checksum so that a profile written by
+// one process can be matched against the dex files another process opens. The counts are bumped
+// without synchronization, racing threads may lose increments but hot methods stay hot.
+//
+// The profile file is text, a "dex <location> <checksum>" line for every dex file followed by a
+// "<method_idx> <invocations> <backedges>" line for each of its methods with a count.
+class MethodProfile {
+ public:
+  struct Counts {
+    uint32_t invocations;
+    uint32_t backedges;
+  };
+
+  MethodProfile();
+  ~MethodProfile();
+
+  // Returns the counts of a method, adding the dex file to the profile if it isn't in it yet.
+  Counts* GetCounts(const DexFile& dex_file, uint32_t method_idx) LOCKS_EXCLUDED(lock_);
+
+  // Returns the counts of a method, or NULL if the profile has nothing for its dex file.
+  Counts* FindCounts(const DexFile& dex_file, uint32_t method_idx) LOCKS_EXCLUDED(lock_);
+
+  // Merges the counts of a profile file into this profile. Returns false if the file couldn't be
+  // read or isn't a profile.
+  bool ReadFromFile(const std::string& filename) LOCKS_EXCLUDED(lock_);
+
+  // Writes the methods with counts to a profile file.
+  bool WriteToFile(const std::string& filename) LOCKS_EXCLUDED(lock_);
+
+ private:
+  // Dex files beyond this many are not profiled.
+  static constexpr size_t kMaxDexFiles = 256;
+
+  struct DexFileCounts {
+    std::string location;
+    uint32_t checksum;
+    // NULL for dex files read from a profile file that haven't been looked up yet.
+    const DexFile* dex_file;
+    std::vector<Counts> counts;
+  };
+
+  // Lock free lookup of the dex files already looked up through GetCounts or FindCounts.
+  Counts* FindBoundCounts(const DexFile& dex_file, uint32_t method_idx);
+
+  // Slow path of FindCounts and GetCounts, which matches the dex file against the dex files read
+  // from profile files and, if add is true, adds it to the profile when none matches.
+  Counts* LookupCounts(const DexFile& dex_file, uint32_t method_idx, bool add)
+      LOCKS_EXCLUDED(lock_);
+
+  DexFileCounts* FindByLocation(const std::string& location, uint32_t checksum)
+      EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  // Makes the counts of a dex file visible to lock free lookups.
+  void Publish(DexFileCounts* dex_file_counts) EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  Mutex lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
+
+  // All the dex files of the profile, owned.
+  std::vector<DexFileCounts*> dex_files_ GUARDED_BY(lock_);
+
+  // Dex files with their DexFile known, in the order they were bound. Entries below
+  // num_bound_dex_files_ never change and are read without the lock.
+  DexFileCounts* bound_dex_files_[kMaxDexFiles];
+  volatile int32_t num_bound_dex_files_;
+
+  DISALLOW_COPY_AND_ASSIGN(MethodProfile);
+};
+
+}  // namespace art
+
+#endif  // ART_RUNTIME_METHOD_PROFILE_H_
@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "method_profile.h"
+
+#include "common_test.h"
+
+namespace art {
+
+class MethodProfileTest : public CommonTest {};
+
+TEST_F(MethodProfileTest, Counts) {
+  MethodProfile profile;
+  EXPECT_TRUE(profile.FindCounts(*java_lang_dex_file_, 0) == NULL);
+  MethodProfile::Counts* counts = profile.GetCounts(*java_lang_dex_file_, 1);
+  ASSERT_TRUE(counts != NULL);
+  EXPECT_EQ(0U, counts->invocations);
+  EXPECT_EQ(0U, counts->backedges);
+  ++counts->invocations;
+  EXPECT_EQ(counts, profile.GetCounts(*java_lang_dex_file_, 1));
+  EXPECT_EQ(counts, profile.FindCounts(*java_lang_dex_file_, 1));
+  EXPECT_TRUE(profile.FindCounts(*conscrypt_file_, 1) == NULL);
+}
+
+TEST_F(MethodProfileTest, WriteRead) {
+  ScratchFile file;
+  {
+    MethodProfile profile;
+    profile.GetCounts(*java_lang_dex_file_, 3)->invocations = 10;
+    profile.GetCounts(*java_lang_dex_file_, 3)->backedges = 200;
+    profile.GetCounts(*java_lang_dex_file_, 7)->invocations = 1;
+    // Dex files without counts are left out.
+    profile.GetCounts(*conscrypt_file_, 0);
+    ASSERT_TRUE(profile.WriteToFile(file.GetFilename()));
+  }
+
+  MethodProfile profile;
+  ASSERT_TRUE(profile.ReadFromFile(file.GetFilename()));
+  MethodProfile::Counts* counts = profile.FindCounts(*java_lang_dex_file_, 3);
+  ASSERT_TRUE(counts != NULL);
+  EXPECT_EQ(10U, counts->invocations);
+  EXPECT_EQ(200U, counts->backedges);
+  counts = profile.FindCounts(*java_lang_dex_file_, 7);
+  ASSERT_TRUE(counts != NULL);
+  EXPECT_EQ(1U, counts->invocations);
+  EXPECT_EQ(0U, counts->backedges);
+  counts = profile.FindCounts(*java_lang_dex_file_, 4);
+  ASSERT_TRUE(counts != NULL);
+  EXPECT_EQ(0U, counts->invocations);
+  EXPECT_TRUE(profile.FindCounts(*conscrypt_file_, 0) == NULL);
+}
+
+TEST_F(MethodProfileTest, Accumulate) {
+  ScratchFile file;
+  {
+    MethodProfile profile;
+    profile.GetCounts(*java_lang_dex_file_, 3)->invocations = 10;
+    ASSERT_TRUE(profile.WriteToFile(file.GetFilename()));
+  }
+  {
+    MethodProfile profile;
+    ASSERT_TRUE(profile.ReadFromFile(file.GetFilename()));
+    profile.GetCounts(*java_lang_dex_file_, 3)->invocations += 5;
+    ASSERT_TRUE(profile.WriteToFile(file.GetFilename()));
+  }
+  MethodProfile profile;
+  ASSERT_TRUE(profile.ReadFromFile(file.GetFilename()));
+  ASSERT_TRUE(profile.FindCounts(*java_lang_dex_file_, 3) != NULL);
+  EXPECT_EQ(15U, profile.FindCounts(*java_lang_dex_file_, 3)->invocations);
+}
+
+}  // namespace art
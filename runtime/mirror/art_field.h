@@ -138,7 +138,7 @@ class MANAGED ArtField : public Object {
  private:
   // Field order required by test "ValidateFieldOrderOfJavaCppUnionClasses".
   // The class we are a part of
-  Class* declaring_class_;
+  HeapReference<Class> declaring_class_;
 
   uint32_t access_flags_;
 
@@ -156,6 +156,7 @@ class MANAGED ArtField : public Object {
 
 class MANAGED ArtFieldClass : public Class {
  private:
+  SuperClassDisplay super_class_display_;
   DISALLOW_IMPLICIT_CONSTRUCTORS(ArtFieldClass);
 };
 
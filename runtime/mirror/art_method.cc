@@ -152,6 +152,23 @@ uintptr_t ArtMethod::NativePcOffset(const uintptr_t pc) const {
 
 uint32_t ArtMethod::ToDexPc(const uintptr_t pc) const {
 #if !defined(ART_USE_PORTABLE_COMPILER)
+  Thread* self = Thread::Current();
+  uint32_t dex_pc;
+  if (self != NULL && self->LookupDexPc(this, pc, &dex_pc)) {
+    return dex_pc;
+  }
+  dex_pc = ToDexPcUncached(pc);
+  if (self != NULL) {
+    self->AddDexPc(this, pc, dex_pc);
+  }
+  return dex_pc;
+#else
+  // Compiler LLVM doesn't use the machine pc, we just use dex pc instead.
+  return static_cast<uint32_t>(pc);
+#endif
+}
+
+uint32_t ArtMethod::ToDexPcUncached(const uintptr_t pc) const {
   MappingTable table(GetMappingTable());
   if (table.TotalSize() == 0) {
     DCHECK(IsNative() || IsCalleeSaveMethod() || IsProxyMethod()) << PrettyMethod(this);
@@ -177,10 +194,6 @@ uint32_t ArtMethod::ToDexPc(const uintptr_t pc) const {
              << "(PC " << reinterpret_cast<void*>(pc) << ", code=" << code
              << ") in " << PrettyMethod(this);
   return DexFile::kDexNoIndex;
-#else
-  // Compiler LLVM doesn't use the machine pc, we just use dex pc instead.
-  return static_cast<uint32_t>(pc);
-#endif
 }
 
 uintptr_t ArtMethod::ToNativePc(const uint32_t dex_pc) const {
@@ -243,6 +256,38 @@ uint32_t ArtMethod::FindCatchBlock(Class* exception_type, uint32_t dex_pc,
   return found_dex_pc;
 }
 
+uintptr_t ArtMethod::FindCatchBlockForQuickPc(Class* exception_type, uintptr_t pc,
+                                              uint32_t* handler_dex_pc,
+                                              bool* has_no_move_exception) const {
+  *handler_dex_pc = DexFile::kDexNoIndex;
+  const void* code = Runtime::Current()->GetInstrumentation()->GetQuickCodeFor(this);
+  MappingTable table(GetMappingTable());
+  MappingTable::CatchHandlerIterator it =
+      table.FindCatchHandlers(pc - reinterpret_cast<uintptr_t>(code));
+  ObjectArray<Class>* resolved_types = NULL;
+  for (; it.HasNext(); it.Next()) {
+    if (!it.IsCatchAll()) {
+      if (resolved_types == NULL) {
+        resolved_types = GetDexCacheResolvedTypes();
+      }
+      Class* handler_type = resolved_types->Get(it.GetHandlerTypeIndex());
+      if (handler_type == NULL) {
+        // The verifier should take care of resolving all exception classes early
+        LOG(WARNING) << "Unresolved exception class when finding catch block: "
+            << MethodHelper(this).GetTypeDescriptorFromTypeIdx(it.GetHandlerTypeIndex());
+        continue;
+      }
+      if (!handler_type->IsAssignableFrom(exception_type)) {
+        continue;
+      }
+    }
+    *handler_dex_pc = it.GetHandlerDexPc();
+    *has_no_move_exception = it.HasNoMoveException();
+    return reinterpret_cast<uintptr_t>(code) + it.GetHandlerNativePcOffset();
+  }
+  return 0;
+}
+
 void ArtMethod::Invoke(Thread* self, uint32_t* args, uint32_t args_size, JValue* result,
                        char result_type) {
   if (kIsDebugBuild) {
@@ -250,13 +295,8 @@ void ArtMethod::Invoke(Thread* self, uint32_t* args, uint32_t args_size, JValue*
     CHECK_EQ(kRunnable, self->GetState());
   }
 
-  // Push a transition back into managed code onto the linked list in thread.
-  ManagedStack fragment;
-  self->PushManagedStackFragment(&fragment);
-
-  Runtime* runtime = Runtime::Current();
   // Call the invoke stub, passing everything as arguments.
-  if (UNLIKELY(!runtime->IsStarted())) {
+  if (UNLIKELY(!Runtime::Current()->IsStarted())) {
     LOG(INFO) << "Not invoking " << PrettyMethod(this) << " for a runtime that isn't started";
     if (result != NULL) {
       result->SetJ(0);
@@ -267,21 +307,7 @@ void ArtMethod::Invoke(Thread* self, uint32_t* args, uint32_t args_size, JValue*
       if (kLogInvocationStartAndReturn) {
         LOG(INFO) << StringPrintf("Invoking '%s' code=%p", PrettyMethod(this).c_str(), GetEntryPointFromCompiledCode());
       }
-#ifdef ART_USE_PORTABLE_COMPILER
-      (*art_portable_invoke_stub)(this, args, args_size, self, result, result_type);
-#else
-      (*art_quick_invoke_stub)(this, args, args_size, self, result, result_type);
-#endif
-      if (UNLIKELY(reinterpret_cast<int32_t>(self->GetException(NULL)) == -1)) {
-        // Unusual case where we were running LLVM generated code and an
-        // exception was thrown to force the activations to be removed from the
-        // stack. Continue execution in the interpreter.
-        self->ClearException();
-        ShadowFrame* shadow_frame = self->GetAndClearDeoptimizationShadowFrame(result);
-        self->SetTopOfStack(NULL, 0);
-        self->SetTopOfShadowStack(shadow_frame);
-        interpreter::EnterInterpreterFromDeoptimize(self, shadow_frame, result);
-      }
+      InvokeCompiledCode(self, args, args_size, result, result_type);
       if (kLogInvocationStartAndReturn) {
         LOG(INFO) << StringPrintf("Returned '%s' code=%p", PrettyMethod(this).c_str(), GetEntryPointFromCompiledCode());
       }
@@ -293,6 +319,31 @@ void ArtMethod::Invoke(Thread* self, uint32_t* args, uint32_t args_size, JValue*
       }
     }
   }
+}
+
+void ArtMethod::InvokeCompiledCode(Thread* self, uint32_t* args, uint32_t args_size,
+                                   JValue* result, char result_type) {
+  DCHECK(Runtime::Current()->IsStarted());
+  DCHECK(GetEntryPointFromCompiledCode() != NULL) << PrettyMethod(this);
+  // Push a transition back into managed code onto the linked list in thread.
+  ManagedStack fragment;
+  self->PushManagedStackFragment(&fragment);
+
+#ifdef ART_USE_PORTABLE_COMPILER
+  (*art_portable_invoke_stub)(this, args, args_size, self, result, result_type);
+#else
+  (*art_quick_invoke_stub)(this, args, args_size, self, result, result_type);
+#endif
+  if (UNLIKELY(reinterpret_cast<int32_t>(self->GetException(NULL)) == -1)) {
+    // Unusual case where we were running LLVM generated code and an
+    // exception was thrown to force the activations to be removed from the
+    // stack. Continue execution in the interpreter.
+    self->ClearException();
+    ShadowFrame* shadow_frame = self->GetAndClearDeoptimizationShadowFrame(result);
+    self->SetTopOfStack(NULL, 0);
+    self->SetTopOfShadowStack(shadow_frame);
+    interpreter::EnterInterpreterFromDeoptimize(self, shadow_frame, result);
+  }
 
   // Pop transition.
   self->PopManagedStackFragment(fragment);
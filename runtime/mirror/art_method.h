@@ -130,6 +130,17 @@ class MANAGED ArtMethod : public Object {
     SetAccessFlags(GetAccessFlags() | kAccPreverified);
   }
 
+  // Whether the method matched the instrumentation's method filter, see
+  // Instrumentation::SetMethodFilter.
+  bool IsInstrumented() const {
+    return (GetAccessFlags() & kAccInstrumented) != 0;
+  }
+
+  void SetInstrumented(bool instrumented) {
+    SetAccessFlags(instrumented ? (GetAccessFlags() | kAccInstrumented)
+                                : (GetAccessFlags() & ~kAccInstrumented));
+  }
+
   bool CheckIncompatibleClassChange(InvokeType type) SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
 
   uint16_t GetMethodIndex() const;
@@ -202,6 +213,11 @@ class MANAGED ArtMethod : public Object {
   void Invoke(Thread* self, uint32_t* args, uint32_t args_size, JValue* result, char result_type)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
 
+  // Like Invoke, for callers that know the runtime is started and the method has compiled code,
+  // such as the interpreter's bridge to compiled code.
+  void InvokeCompiledCode(Thread* self, uint32_t* args, uint32_t args_size, JValue* result,
+                          char result_type) SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
   EntryPointFromInterpreter* GetEntryPointFromInterpreter() const {
     return GetFieldPtr<EntryPointFromInterpreter*>(OFFSET_OF_OBJECT_MEMBER(ArtMethod, entry_point_from_interpreter_), false);
   }
@@ -367,6 +383,14 @@ class MANAGED ArtMethod : public Object {
   uint32_t FindCatchBlock(Class* exception_type, uint32_t dex_pc, bool* has_no_move_exception) const
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
 
+  // Like FindCatchBlock, for the call at the native pc of this method's quick compiled code, using
+  // the catch table the compiler wrote after the mapping table instead of the dex file's try items.
+  // Returns the handler's native pc and sets *handler_dex_pc, or returns 0 and sets it to
+  // DexFile::kDexNoIndex when no handler applies.
+  uintptr_t FindCatchBlockForQuickPc(Class* exception_type, uintptr_t pc, uint32_t* handler_dex_pc,
+                                     bool* has_no_move_exception) const
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
   static void SetClass(Class* java_lang_reflect_ArtMethod);
 
   static Class* GetJavaLangReflectArtMethod() {
@@ -378,19 +402,19 @@ class MANAGED ArtMethod : public Object {
  protected:
   // Field order required by test "ValidateFieldOrderOfJavaCppUnionClasses".
   // The class we are a part of
-  Class* declaring_class_;
+  HeapReference<Class> declaring_class_;
 
   // short cuts to declaring_class_->dex_cache_ member for fast compiled code access
-  ObjectArray<StaticStorageBase>* dex_cache_initialized_static_storage_;
+  HeapReference<ObjectArray<StaticStorageBase> > dex_cache_initialized_static_storage_;
 
   // short cuts to declaring_class_->dex_cache_ member for fast compiled code access
-  ObjectArray<ArtMethod>* dex_cache_resolved_methods_;
+  HeapReference<ObjectArray<ArtMethod> > dex_cache_resolved_methods_;
 
   // short cuts to declaring_class_->dex_cache_ member for fast compiled code access
-  ObjectArray<Class>* dex_cache_resolved_types_;
+  HeapReference<ObjectArray<Class> > dex_cache_resolved_types_;
 
   // short cuts to declaring_class_->dex_cache_ member for fast compiled code access
-  ObjectArray<String>* dex_cache_strings_;
+  HeapReference<ObjectArray<String> > dex_cache_strings_;
 
   // Access flags; low 16 bits are defined by spec.
   uint32_t access_flags_;
@@ -443,12 +467,17 @@ class MANAGED ArtMethod : public Object {
   static Class* java_lang_reflect_ArtMethod_;
 
  private:
+  // Converts a native PC to a dex PC by searching the mapping table, ToDexPc caches the result.
+  uint32_t ToDexPcUncached(const uintptr_t pc) const SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
+  friend class art::ImageWriter;  // for recording relocations of oat pointers
   friend struct art::ArtMethodOffsets;  // for verifying offset information
   DISALLOW_IMPLICIT_CONSTRUCTORS(ArtMethod);
 };
 
 class MANAGED ArtMethodClass : public Class {
  private:
+  SuperClassDisplay super_class_display_;
   DISALLOW_IMPLICIT_CONSTRUCTORS(ArtMethodClass);
 };
 
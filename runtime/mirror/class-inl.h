@@ -196,6 +196,11 @@ inline bool Class::IsAssignableFromArray(const Class* src) const {
 inline bool Class::IsSubClass(const Class* klass) const {
   DCHECK(!IsInterface()) << PrettyClass(this);
   DCHECK(!IsArrayClass()) << PrettyClass(this);
+  uint32_t klass_depth = klass->GetSuperClassDepth();
+  if (klass_depth != 0 && klass_depth <= kSuperClassDisplayDepth && GetSuperClassDepth() != 0) {
+    // The entries past the depth of this class are null.
+    return GetSuperClassDisplayEntry(klass_depth) == klass;
+  }
   const Class* current = this;
   do {
     if (current == klass) {
@@ -210,9 +215,19 @@ inline ArtMethod* Class::FindVirtualMethodForInterface(ArtMethod* method) const
   Class* declaring_class = method->GetDeclaringClass();
   DCHECK(declaring_class != NULL) << PrettyClass(this);
   DCHECK(declaring_class->IsInterface()) << PrettyMethod(method);
-  // TODO cache to improve lookup speed
-  int32_t iftable_count = GetIfTableCount();
   IfTable* iftable = GetIfTable();
+  if (UNLIKELY(iftable == NULL)) {
+    return NULL;
+  }
+  ObjectArray<ArtMethod>* imtable = iftable->GetImTable();
+  if (LIKELY(imtable != NULL)) {
+    const size_t index = IfTable::ImtIndex(method->GetDexMethodIndex());
+    if (imtable->Get(index + IfTable::kImtInterfaceMethod) == method) {
+      return imtable->Get(index + IfTable::kImtMethod);
+    }
+  }
+  // Interface method table conflict, or the class doesn't implement the interface.
+  int32_t iftable_count = iftable->Count();
   for (int32_t i = 0; i < iftable_count; i++) {
     if (iftable->GetInterface(i) == declaring_class) {
       return iftable->GetMethodArray(i)->Get(method->GetMethodIndex());
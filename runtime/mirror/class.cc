@@ -259,6 +259,36 @@ void Class::SetReferenceStaticOffsets(uint32_t new_reference_offsets) {
              new_reference_offsets, false);
 }
 
+void Class::SetUpSuperClassDisplay() {
+  DCHECK(!IsInterface()) << PrettyClass(this);
+  DCHECK(!IsPrimitive()) << PrettyClass(this);
+  // The display isn't a field of java.lang.Class, so it is written without SetFieldObject's field
+  // checks. No card is marked: the superclasses are also reachable through super_class_.
+  uint32_t depth = 1;
+  Class* super_class = GetSuperClass();
+  if (super_class != NULL) {
+    uint32_t super_depth = super_class->GetSuperClassDepth();
+    if (super_depth == 0) {
+      // Leave this class without a display, subclass checks walk its superclasses.
+      return;
+    }
+    for (uint32_t i = 1; i <= super_depth && i <= kSuperClassDisplayDepth; ++i) {
+      SetField32(SuperClassDisplayEntryOffset(i),
+                 HeapReference<Class>::Compress(super_class->GetSuperClassDisplayEntry(i)), false);
+    }
+    depth = super_depth + 1;
+  }
+  if (depth <= kSuperClassDisplayDepth) {
+    SetField32(SuperClassDisplayEntryOffset(depth), HeapReference<Class>::Compress(this), false);
+  }
+  // An array is assignable from the arrays of its component's subclasses, which the displays
+  // don't record, so no array is looked up in a display. Its own display is filled in though, for
+  // looking up the superclasses of array objects.
+  if (!IsArrayClass()) {
+    SetField32(SuperClassDepthOffset(), depth, false);
+  }
+}
+
 bool Class::IsInSamePackage(const StringPiece& descriptor1, const StringPiece& descriptor2) {
   size_t i = 0;
   while (descriptor1[i] != '\0' && descriptor1[i] == descriptor2[i]) {
@@ -325,6 +355,18 @@ void Class::SetClassLoader(ClassLoader* new_class_loader) {
   SetFieldObject(OFFSET_OF_OBJECT_MEMBER(Class, class_loader_), new_class_loader, false);
 }
 
+// Returns the positions of the members of the kind that klass declares that may be named name.
+// Once the class linker is up, classes with many members look them up by the hash of the name.
+static MemberCandidates FindMemberCandidates(const Class* klass, MemberIndexTable::MemberKind kind,
+                                             size_t num_members, const StringPiece& name)
+    SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
+  ClassLinker* class_linker = Runtime::Current()->GetClassLinker();
+  if (class_linker == NULL) {
+    return MemberCandidates(num_members);
+  }
+  return class_linker->GetMemberIndexes()->Find(klass, kind, name);
+}
+
 ArtMethod* Class::FindInterfaceMethod(const StringPiece& name, const StringPiece& signature) const {
   // Check the current class before checking the interfaces.
   ArtMethod* method = FindDeclaredVirtualMethod(name, signature);
@@ -364,8 +406,10 @@ ArtMethod* Class::FindInterfaceMethod(const DexCache* dex_cache, uint32_t dex_me
 
 ArtMethod* Class::FindDeclaredDirectMethod(const StringPiece& name, const StringPiece& signature) const {
   MethodHelper mh;
-  for (size_t i = 0; i < NumDirectMethods(); ++i) {
-    ArtMethod* method = GetDirectMethod(i);
+  MemberCandidates candidates(FindMemberCandidates(this, MemberIndexTable::kDirectMethods,
+                                                   NumDirectMethods(), name));
+  while (!candidates.Done()) {
+    ArtMethod* method = GetDirectMethod(candidates.Next());
     mh.ChangeMethod(method);
     if (name == mh.GetName() && signature == mh.GetSignature()) {
       return method;
@@ -409,8 +453,10 @@ ArtMethod* Class::FindDirectMethod(const DexCache* dex_cache, uint32_t dex_metho
 ArtMethod* Class::FindDeclaredVirtualMethod(const StringPiece& name,
                                          const StringPiece& signature) const {
   MethodHelper mh;
-  for (size_t i = 0; i < NumVirtualMethods(); ++i) {
-    ArtMethod* method = GetVirtualMethod(i);
+  MemberCandidates candidates(FindMemberCandidates(this, MemberIndexTable::kVirtualMethods,
+                                                   NumVirtualMethods(), name));
+  while (!candidates.Done()) {
+    ArtMethod* method = GetVirtualMethod(candidates.Next());
     mh.ChangeMethod(method);
     if (name == mh.GetName() && signature == mh.GetSignature()) {
       return method;
@@ -455,8 +501,10 @@ ArtField* Class::FindDeclaredInstanceField(const StringPiece& name, const String
   // Is the field in this class?
   // Interfaces are not relevant because they can't contain instance fields.
   FieldHelper fh;
-  for (size_t i = 0; i < NumInstanceFields(); ++i) {
-    ArtField* f = GetInstanceField(i);
+  MemberCandidates candidates(FindMemberCandidates(this, MemberIndexTable::kInstanceFields,
+                                                   NumInstanceFields(), name));
+  while (!candidates.Done()) {
+    ArtField* f = GetInstanceField(candidates.Next());
     fh.ChangeField(f);
     if (name == fh.GetName() && type == fh.GetTypeDescriptor()) {
       return f;
@@ -504,8 +552,10 @@ ArtField* Class::FindInstanceField(const DexCache* dex_cache, uint32_t dex_field
 ArtField* Class::FindDeclaredStaticField(const StringPiece& name, const StringPiece& type) {
   DCHECK(type != NULL);
   FieldHelper fh;
-  for (size_t i = 0; i < NumStaticFields(); ++i) {
-    ArtField* f = GetStaticField(i);
+  MemberCandidates candidates(FindMemberCandidates(this, MemberIndexTable::kStaticFields,
+                                                   NumStaticFields(), name));
+  while (!candidates.Done()) {
+    ArtField* f = GetStaticField(candidates.Next());
     fh.ChangeField(f);
     if (name == fh.GetName() && type == fh.GetTypeDescriptor()) {
       return f;
@@ -59,6 +59,7 @@ namespace art {
 
 struct ClassClassOffsets;
 struct ClassOffsets;
+class ImageWriter;
 class StringPiece;
 
 namespace mirror {
@@ -277,6 +278,10 @@ class MANAGED Class : public StaticStorageBase {
     SetField32(OFFSET_OF_OBJECT_MEMBER(Class, primitive_type_), new_type, false);
   }
 
+  static MemberOffset PrimitiveTypeOffset() {
+    return MemberOffset(OFFSETOF_MEMBER(Class, primitive_type_));
+  }
+
   // Returns true if the class is a primitive type.
   bool IsPrimitive() const {
     return GetPrimitiveType() != Primitive::kPrimNot;
@@ -355,6 +360,10 @@ class MANAGED Class : public StaticStorageBase {
     SetFieldObject(OFFSET_OF_OBJECT_MEMBER(Class, component_type_), new_component_type, false);
   }
 
+  static MemberOffset ComponentTypeOffset() {
+    return MemberOffset(OFFSETOF_MEMBER(Class, component_type_));
+  }
+
   size_t GetComponentSize() const {
     return Primitive::ComponentSize(GetComponentType()->GetPrimitiveType());
   }
@@ -630,6 +639,10 @@ class MANAGED Class : public StaticStorageBase {
     SetField32(OFFSET_OF_OBJECT_MEMBER(Class, num_reference_instance_fields_), new_num, false);
   }
 
+  static MemberOffset ReferenceInstanceOffsetsOffset() {
+    return MemberOffset(OFFSETOF_MEMBER(Class, reference_instance_offsets_));
+  }
+
   uint32_t GetReferenceInstanceOffsets() const {
     DCHECK(IsResolved() || IsErroneous());
     return GetField32(OFFSET_OF_OBJECT_MEMBER(Class, reference_instance_offsets_), false);
@@ -638,11 +651,49 @@ class MANAGED Class : public StaticStorageBase {
   void SetReferenceInstanceOffsets(uint32_t new_reference_offsets)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
 
-  // Beginning of static field data
+  // Beginning of static field data, after the superclass display.
   static MemberOffset FieldsOffset() {
+    return MemberOffset(OFFSETOF_MEMBER(Class, fields_) + kSuperClassDisplaySize);
+  }
+
+  // The size of a class object without static fields.
+  static size_t MinimumClassSize() {
+    return FieldsOffset().Uint32Value();
+  }
+
+  // The superclass display is the word at SuperClassDepthOffset followed by
+  // kSuperClassDisplayDepth references: the superclasses of a class by depth and then the class
+  // itself, java.lang.Object being at depth 1. The entry of depth d is d references past the
+  // depth word, so whether a class is a subclass of one of depth d is a single load and compare.
+  // It sits between the Java fields and the static fields, as libcore fixes java.lang.Class.
+  static constexpr size_t kSuperClassDisplayDepth = 7;
+  static constexpr size_t kSuperClassDisplaySize =
+      sizeof(uint32_t) + kSuperClassDisplayDepth * kHeapReferenceSize;
+
+  static MemberOffset SuperClassDepthOffset() {
     return OFFSET_OF_OBJECT_MEMBER(Class, fields_);
   }
 
+  static MemberOffset SuperClassDisplayEntryOffset(uint32_t depth) {
+    DCHECK_GE(depth, 1U);
+    DCHECK_LE(depth, static_cast<uint32_t>(kSuperClassDisplayDepth));
+    return MemberOffset(SuperClassDepthOffset().Uint32Value() + depth * kHeapReferenceSize);
+  }
+
+  // The depth of the class in the superclass display, or 0 when other classes can't be looked
+  // up in its display: interfaces, arrays, primitive types and classes not linked yet. Classes
+  // deeper than kSuperClassDisplayDepth have a depth but no entry of their own.
+  uint32_t GetSuperClassDepth() const {
+    return GetField32(SuperClassDepthOffset(), false);
+  }
+
+  Class* GetSuperClassDisplayEntry(uint32_t depth) const {
+    return GetFieldObject<Class*>(SuperClassDisplayEntryOffset(depth), false);
+  }
+
+  // Fills in the superclass display once the superclass is linked.
+  void SetUpSuperClassDisplay() SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
   // Returns the number of static fields containing reference types.
   size_t NumReferenceStaticFields() const {
     DCHECK(IsResolved() || IsErroneous());
@@ -765,18 +816,18 @@ class MANAGED Class : public StaticStorageBase {
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
 
   // defining class loader, or NULL for the "bootstrap" system loader
-  ClassLoader* class_loader_;
+  HeapReference<ClassLoader> class_loader_;
 
   // For array classes, the component class object for instanceof/checkcast
   // (for String[][][], this will be String[][]). NULL for non-array classes.
-  Class* component_type_;
+  HeapReference<Class> component_type_;
 
   // DexCache of resolved constant pool entries (will be NULL for classes generated by the
   // runtime such as arrays and primitive classes).
-  DexCache* dex_cache_;
+  HeapReference<DexCache> dex_cache_;
 
   // static, private, and <init> methods
-  ObjectArray<ArtMethod>* direct_methods_;
+  HeapReference<ObjectArray<ArtMethod> > direct_methods_;
 
   // instance fields
   //
@@ -788,7 +839,7 @@ class MANAGED Class : public StaticStorageBase {
   // All instance fields that refer to objects are guaranteed to be at
   // the beginning of the field list.  num_reference_instance_fields_
   // specifies the number of reference fields.
-  ObjectArray<ArtField>* ifields_;
+  HeapReference<ObjectArray<ArtField> > ifields_;
 
   // The interface table (iftable_) contains pairs of a interface class and an array of the
   // interface methods. There is one pair per interface supported by this class.  That means one
@@ -801,28 +852,28 @@ class MANAGED Class : public StaticStorageBase {
   //
   // For every interface a concrete class implements, we create an array of the concrete vtable_
   // methods for the methods in the interface.
-  IfTable* iftable_;
+  HeapReference<IfTable> iftable_;
 
   // descriptor for the class such as "java.lang.Class" or "[C". Lazily initialized by ComputeName
-  String* name_;
+  HeapReference<String> name_;
 
   // Static fields
-  ObjectArray<ArtField>* sfields_;
+  HeapReference<ObjectArray<ArtField> > sfields_;
 
   // The superclass, or NULL if this is java.lang.Object, an interface or primitive type.
-  Class* super_class_;
+  HeapReference<Class> super_class_;
 
   // If class verify fails, we must return same error on subsequent tries.
-  Class* verify_error_class_;
+  HeapReference<Class> verify_error_class_;
 
   // Virtual methods defined in this class; invoked through vtable.
-  ObjectArray<ArtMethod>* virtual_methods_;
+  HeapReference<ObjectArray<ArtMethod> > virtual_methods_;
 
   // Virtual method table (vtable), for use by "invoke-virtual".  The vtable from the superclass is
   // copied in, and virtual methods from our class either replace those from the super or are
   // appended. For abstract classes, methods may be created in the vtable that aren't in
   // virtual_ methods_ for miranda methods.
-  ObjectArray<ArtMethod>* vtable_;
+  HeapReference<ObjectArray<ArtMethod> > vtable_;
 
   // Access flags; low 16 bits are defined by VM spec.
   uint32_t access_flags_;
@@ -871,20 +922,32 @@ class MANAGED Class : public StaticStorageBase {
   // values are kept in a table in gDvm.
   // InitiatingLoaderList initiating_loader_list_;
 
-  // Location of first static field.
+  // Location of the superclass display, which the static fields follow.
   uint32_t fields_[0];
 
   // java.lang.Class
   static Class* java_lang_Class_;
 
+  friend class art::ImageWriter;  // for resetting the status of app image classes
   friend struct art::ClassOffsets;  // for verifying offset information
   DISALLOW_IMPLICIT_CONSTRUCTORS(Class);
 };
 
 std::ostream& operator<<(std::ostream& os, const Class::Status& rhs);
 
+// The superclass display, for the mirrors of classes with static fields to start with.
+class MANAGED SuperClassDisplay {
+ private:
+  uint32_t depth_;
+  HeapReference<Class> classes_[Class::kSuperClassDisplayDepth];
+  DISALLOW_IMPLICIT_CONSTRUCTORS(SuperClassDisplay);
+};
+COMPILE_ASSERT(sizeof(SuperClassDisplay) == Class::kSuperClassDisplaySize,
+               super_class_display_size_must_match);
+
 class MANAGED ClassClass : public Class {
  private:
+  SuperClassDisplay super_class_display_;
   int64_t serialVersionUID_;
   friend struct art::ClassClassOffsets;  // for verifying offset information
   DISALLOW_IMPLICIT_CONSTRUCTORS(ClassClass);
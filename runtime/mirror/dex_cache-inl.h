@@ -25,6 +25,14 @@ namespace mirror {
 inline ArtMethod* DexCache::GetResolvedMethod(uint32_t method_idx) const
     SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
   ArtMethod* method = GetResolvedMethods()->Get(method_idx);
+  if (UNLIKELY(method == NULL || method->IsRuntimeMethod()) &&
+      IsReadOnlyArray(GetResolvedMethods())) {
+    // The image fills unresolved entries with the resolution trampoline.
+    ArtMethod* overflow = down_cast<ArtMethod*>(GetOverflowEntry(GetResolvedMethods(), method_idx));
+    if (overflow != NULL) {
+      return overflow;
+    }
+  }
   // Hide resolution trampoline methods from the caller
   if (method != NULL && method->IsRuntimeMethod()) {
     DCHECK(method == Runtime::Current()->GetResolutionMethod());
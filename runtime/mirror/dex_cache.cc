@@ -27,10 +27,16 @@
 #include "object_array-inl.h"
 #include "runtime.h"
 #include "string.h"
+#include "thread.h"
 
 namespace art {
 namespace mirror {
 
+const byte* DexCache::read_only_arrays_begin_ = NULL;
+const byte* DexCache::read_only_arrays_end_ = NULL;
+ReaderWriterMutex* DexCache::overflow_lock_ = NULL;
+SafeMap<std::pair<const Object*, uint32_t>, Object*>* DexCache::overflow_ = NULL;
+
 void DexCache::Init(const DexFile* dex_file,
                     String* location,
                     ObjectArray<String>* strings,
@@ -70,6 +76,10 @@ void DexCache::Fixup(ArtMethod* trampoline) {
   // Fixup the resolve methods array to contain trampoline for resolution.
   CHECK(trampoline != NULL);
   ObjectArray<ArtMethod>* resolved_methods = GetResolvedMethods();
+  if (IsReadOnlyArray(resolved_methods)) {
+    // The image writer left no null entries.
+    return;
+  }
   size_t length = resolved_methods->GetLength();
   for (size_t i = 0; i < length; i++) {
     if (resolved_methods->GetWithoutChecks(i) == NULL) {
@@ -78,5 +88,41 @@ void DexCache::Fixup(ArtMethod* trampoline) {
   }
 }
 
+void DexCache::SetReadOnlyArrays(const byte* begin, const byte* end) {
+  // Only the boot image has read-only arrays, but tests create several runtimes in turn.
+  if (overflow_lock_ == NULL) {
+    overflow_lock_ = new ReaderWriterMutex("dex cache overflow lock", kDexCacheOverflowLock);
+    overflow_ = new SafeMap<std::pair<const Object*, uint32_t>, Object*>;
+  }
+  overflow_->clear();
+  read_only_arrays_begin_ = begin;
+  read_only_arrays_end_ = end;
+}
+
+Object* DexCache::GetOverflowEntry(const Object* array, uint32_t index) {
+  ReaderMutexLock mu(Thread::Current(), *overflow_lock_);
+  auto it = overflow_->find(std::make_pair(array, index));
+  return it != overflow_->end() ? it->second : NULL;
+}
+
+void DexCache::SetOverflowEntry(const Object* array, uint32_t index, Object* value) {
+  WriterMutexLock mu(Thread::Current(), *overflow_lock_);
+  if (value == NULL) {
+    overflow_->erase(std::make_pair(array, index));
+  } else {
+    overflow_->Overwrite(std::make_pair(array, index), value);
+  }
+}
+
+void DexCache::VisitOverflowRoots(RootVisitor* visitor, void* arg) {
+  if (overflow_lock_ == NULL) {
+    return;
+  }
+  ReaderMutexLock mu(Thread::Current(), *overflow_lock_);
+  for (const auto& entry : *overflow_) {
+    visitor(entry.second, arg);
+  }
+}
+
 }  // namespace mirror
 }  // namespace art
@@ -18,9 +18,12 @@
 #define ART_RUNTIME_MIRROR_DEX_CACHE_H_
 
 #include "art_method.h"
+#include "base/mutex.h"
 #include "class.h"
 #include "object.h"
 #include "object_array.h"
+#include "root_visitor.h"
+#include "safe_map.h"
 #include "string.h"
 
 namespace art {
@@ -37,6 +40,7 @@ class Class;
 
 class MANAGED DexCacheClass : public Class {
  private:
+  SuperClassDisplay super_class_display_;
   DISALLOW_IMPLICIT_CONSTRUCTORS(DexCacheClass);
 };
 
@@ -92,22 +96,22 @@ class MANAGED DexCache : public Object {
 
   String* GetResolvedString(uint32_t string_idx) const
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
-    return GetStrings()->Get(string_idx);
+    return GetEntry(GetStrings(), string_idx);
   }
 
   void SetResolvedString(uint32_t string_idx, String* resolved)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
-    GetStrings()->Set(string_idx, resolved);
+    SetEntry(GetStrings(), string_idx, resolved);
   }
 
   Class* GetResolvedType(uint32_t type_idx) const
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
-    return GetResolvedTypes()->Get(type_idx);
+    return GetEntry(GetResolvedTypes(), type_idx);
   }
 
   void SetResolvedType(uint32_t type_idx, Class* resolved)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
-    GetResolvedTypes()->Set(type_idx, resolved);
+    SetEntry(GetResolvedTypes(), type_idx, resolved);
   }
 
   ArtMethod* GetResolvedMethod(uint32_t method_idx) const
@@ -115,19 +119,36 @@ class MANAGED DexCache : public Object {
 
   void SetResolvedMethod(uint32_t method_idx, ArtMethod* resolved)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
-    GetResolvedMethods()->Set(method_idx, resolved);
+    SetEntry(GetResolvedMethods(), method_idx, resolved);
   }
 
   ArtField* GetResolvedField(uint32_t field_idx) const
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
-    return GetResolvedFields()->Get(field_idx);
+    return GetEntry(GetResolvedFields(), field_idx);
   }
 
   void SetResolvedField(uint32_t field_idx, ArtField* resolved)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
-    GetResolvedFields()->Set(field_idx, resolved);
+    SetEntry(GetResolvedFields(), field_idx, resolved);
   }
 
+  // The strings, resolved types, methods and fields arrays of the boot image's dex caches may lie
+  // in [begin, end), which the image space maps read-only so that its pages stay shared between
+  // processes. What the image left unresolved goes to an overflow table when it is resolved at
+  // runtime, which the getters look up when the entry in the array is null. Compiled code reads
+  // the arrays directly and takes its slow path for these entries every time.
+  static void SetReadOnlyArrays(const byte* begin, const byte* end);
+
+  static bool IsReadOnlyArray(const Object* array) {
+    const byte* address = reinterpret_cast<const byte*>(array);
+    return address >= read_only_arrays_begin_ && address < read_only_arrays_end_;
+  }
+
+  // Visits the entries of the overflow table. They are otherwise reachable too, through the class
+  // table, the intern table and the classes the methods and fields belong to.
+  static void VisitOverflowRoots(RootVisitor* visitor, void* arg)
+      LOCKS_EXCLUDED(overflow_lock_);
+
   ObjectArray<String>* GetStrings() const
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
     return GetFieldObject< ObjectArray<String>* >(StringsOffset(), false);
@@ -164,15 +185,46 @@ class MANAGED DexCache : public Object {
   }
 
  private:
-  Object* dex_;
-  ObjectArray<StaticStorageBase>* initialized_static_storage_;
-  String* location_;
-  ObjectArray<ArtField>* resolved_fields_;
-  ObjectArray<ArtMethod>* resolved_methods_;
-  ObjectArray<Class>* resolved_types_;
-  ObjectArray<String>* strings_;
+  HeapReference<Object> dex_;
+  HeapReference<ObjectArray<StaticStorageBase> > initialized_static_storage_;
+  HeapReference<String> location_;
+  HeapReference<ObjectArray<ArtField> > resolved_fields_;
+  HeapReference<ObjectArray<ArtMethod> > resolved_methods_;
+  HeapReference<ObjectArray<Class> > resolved_types_;
+  HeapReference<ObjectArray<String> > strings_;
   uint32_t dex_file_;
 
+  template <class T>
+  static T* GetEntry(const ObjectArray<T>* array, uint32_t index)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
+    T* entry = array->Get(index);
+    if (UNLIKELY(entry == NULL) && IsReadOnlyArray(array)) {
+      entry = down_cast<T*>(GetOverflowEntry(array, index));
+    }
+    return entry;
+  }
+
+  template <class T>
+  static void SetEntry(ObjectArray<T>* array, uint32_t index, T* value)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
+    if (UNLIKELY(IsReadOnlyArray(array))) {
+      SetOverflowEntry(array, index, value);
+    } else {
+      array->Set(index, value);
+    }
+  }
+
+  static Object* GetOverflowEntry(const Object* array, uint32_t index)
+      LOCKS_EXCLUDED(overflow_lock_);
+  static void SetOverflowEntry(const Object* array, uint32_t index, Object* value)
+      LOCKS_EXCLUDED(overflow_lock_);
+
+  static const byte* read_only_arrays_begin_;
+  static const byte* read_only_arrays_end_;
+  static ReaderWriterMutex* overflow_lock_;
+  // Entries of the read-only arrays resolved at runtime, by array and index.
+  static SafeMap<std::pair<const Object*, uint32_t>, Object*>* overflow_ GUARDED_BY(overflow_lock_);
+
   friend struct art::DexCacheOffsets;  // for verifying offset information
   DISALLOW_IMPLICIT_CONSTRUCTORS(DexCache);
 };
@@ -56,10 +56,37 @@ class MANAGED IfTable : public ObjectArray<Object> {
     Set((i * kMax) + kMethodArray, new_ma);
   }
 
+  // Count of interfaces, the interface method table slot makes the length odd and is rounded off.
   size_t Count() const {
     return GetLength() / kMax;
   }
 
+  // Whether there is a slot for an interface method table, which there is unless the iftable
+  // belongs to an interface.
+  bool HasImTableSlot() const {
+    return GetLength() % kMax != 0;
+  }
+
+  // Returns the interface method table, or NULL if the iftable has none. Interfaces, classes
+  // without interface methods and classes that aren't initialized yet don't have one.
+  ObjectArray<ArtMethod>* GetImTable() const SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
+    if (!HasImTableSlot()) {
+      return NULL;
+    }
+    return down_cast<ObjectArray<ArtMethod>*>(Get(GetLength() - 1));
+  }
+
+  void SetImTable(ObjectArray<ArtMethod>* imtable) SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
+    DCHECK(HasImTableSlot());
+    DCHECK(Get(GetLength() - 1) == NULL);
+    Set(GetLength() - 1, imtable);
+  }
+
+  // Index of the first interface method table entry of an interface method's slot.
+  static size_t ImtIndex(uint32_t dex_method_idx) {
+    return (dex_method_idx % kImtSize) * kImtMax;
+  }
+
   enum {
     // Points to the interface class.
     kInterface   = 0,
@@ -69,6 +96,16 @@ class MANAGED IfTable : public ObjectArray<Object> {
     kMax         = 2,
   };
 
+  // The interface method table is hashed by the interface method's dex method index. Each slot
+  // holds the interface method and its implementation, slots claimed by more than one interface
+  // method are left empty and those methods are found by searching the iftable.
+  static constexpr size_t kImtSize = 64;
+  enum {
+    kImtInterfaceMethod = 0,
+    kImtMethod          = 1,
+    kImtMax             = 2,
+  };
+
  private:
   DISALLOW_IMPLICIT_CONSTRUCTORS(IfTable);
 };
@@ -21,6 +21,7 @@
 #include "base/logging.h"
 #include "base/macros.h"
 #include "cutils/atomic-inline.h"
+#include "object_reference.h"
 #include "offsets.h"
 
 namespace art {
@@ -83,6 +84,9 @@ class MANAGED Object {
 
   Object* Clone(Thread* self) SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
 
+  // The object's address. Objects don't move, so the hash needs no room in the lock word and
+  // hashing never inflates a thin lock. The quick compiler inlines System.identityHashCode as a
+  // move of the reference on the same assumption.
   int32_t IdentityHashCode() const {
 #ifdef MOVING_GARBAGE_COLLECTOR
     // TODO: we'll need to use the Object's internal concept of identity
@@ -174,7 +178,8 @@ class MANAGED Object {
   // Accessors for Java type fields
   template<class T>
   T GetFieldObject(MemberOffset field_offset, bool is_volatile) const {
-    T result = reinterpret_cast<T>(GetField32(field_offset, is_volatile));
+    T result = reinterpret_cast<T>(
+        HeapReference<Object>::Decompress(GetField32(field_offset, is_volatile)));
     VerifyObject(result);
     return result;
   }
@@ -182,7 +187,8 @@ class MANAGED Object {
   void SetFieldObject(MemberOffset field_offset, const Object* new_value, bool is_volatile,
                       bool this_is_valid = true) SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
     VerifyObject(new_value);
-    SetField32(field_offset, reinterpret_cast<uint32_t>(new_value), is_volatile, this_is_valid);
+    SetField32(field_offset, HeapReference<Object>::Compress(new_value), is_volatile,
+               this_is_valid);
     if (new_value != NULL) {
       CheckFieldAssignment(field_offset, new_value);
       WriteBarrierField(this, field_offset, new_value);
@@ -253,7 +259,7 @@ class MANAGED Object {
   // Write barrier called post update to a reference bearing field.
   static void WriteBarrierField(const Object* dst, MemberOffset offset, const Object* new_value);
 
-  Class* klass_;
+  HeapReference<Class> klass_;
 
   uint32_t monitor_;
 
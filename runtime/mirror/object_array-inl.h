@@ -24,13 +24,14 @@
 #include "mirror/class.h"
 #include "runtime.h"
 #include "thread.h"
+#include "utils.h"
 
 namespace art {
 namespace mirror {
 
 template<class T>
 inline ObjectArray<T>* ObjectArray<T>::Alloc(Thread* self, Class* object_array_class, int32_t length) {
-  Array* array = Array::Alloc(self, object_array_class, length, sizeof(Object*));
+  Array* array = Array::Alloc(self, object_array_class, length, sizeof(HeapReference<Object>));
   if (UNLIKELY(array == NULL)) {
     return NULL;
   } else {
@@ -43,7 +44,7 @@ inline T* ObjectArray<T>::Get(int32_t i) const {
   if (UNLIKELY(!IsValidIndex(i))) {
     return NULL;
   }
-  MemberOffset data_offset(DataOffset(sizeof(Object*)).Int32Value() + i * sizeof(Object*));
+  MemberOffset data_offset(OffsetOfElement(i));
   return GetFieldObject<T*>(data_offset, false);
 }
 
@@ -62,7 +63,7 @@ inline bool ObjectArray<T>::CheckAssignable(T* object) {
 template<class T>
 inline void ObjectArray<T>::Set(int32_t i, T* object) {
   if (LIKELY(IsValidIndex(i) && CheckAssignable(object))) {
-    MemberOffset data_offset(DataOffset(sizeof(Object*)).Int32Value() + i * sizeof(Object*));
+    MemberOffset data_offset(OffsetOfElement(i));
     SetFieldObject(data_offset, object, false);
   } else {
     DCHECK(Thread::Current()->IsExceptionPending());
@@ -72,21 +73,21 @@ inline void ObjectArray<T>::Set(int32_t i, T* object) {
 template<class T>
 inline void ObjectArray<T>::SetWithoutChecks(int32_t i, T* object) {
   DCHECK(IsValidIndex(i));
-  MemberOffset data_offset(DataOffset(sizeof(Object*)).Int32Value() + i * sizeof(Object*));
+  MemberOffset data_offset(OffsetOfElement(i));
   SetFieldObject(data_offset, object, false);
 }
 
 template<class T>
 inline void ObjectArray<T>::SetPtrWithoutChecks(int32_t i, T* object) {
   DCHECK(IsValidIndex(i));
-  MemberOffset data_offset(DataOffset(sizeof(Object*)).Int32Value() + i * sizeof(Object*));
-  SetFieldPtr(data_offset, object, false);
+  MemberOffset data_offset(OffsetOfElement(i));
+  SetField32(data_offset, HeapReference<Object>::Compress(object), false);
 }
 
 template<class T>
 inline T* ObjectArray<T>::GetWithoutChecks(int32_t i) const {
   DCHECK(IsValidIndex(i));
-  MemberOffset data_offset(DataOffset(sizeof(Object*)).Int32Value() + i * sizeof(Object*));
+  MemberOffset data_offset(OffsetOfElement(i));
   return GetFieldObject<T*>(data_offset, false);
 }
 
@@ -98,20 +99,18 @@ inline void ObjectArray<T>::Copy(const ObjectArray<T>* src, int src_pos,
       src->IsValidIndex(src_pos+length-1) &&
       dst->IsValidIndex(dst_pos) &&
       dst->IsValidIndex(dst_pos+length-1)) {
-    MemberOffset src_offset(DataOffset(sizeof(Object*)).Int32Value() + src_pos * sizeof(Object*));
-    MemberOffset dst_offset(DataOffset(sizeof(Object*)).Int32Value() + dst_pos * sizeof(Object*));
+    MemberOffset src_offset(OffsetOfElement(src_pos));
+    MemberOffset dst_offset(OffsetOfElement(dst_pos));
     Class* array_class = dst->GetClass();
     gc::Heap* heap = Runtime::Current()->GetHeap();
-    if (array_class == src->GetClass()) {
-      // No need for array store checks if arrays are of the same type
-      for (size_t i = 0; i < length; i++) {
-        Object* object = src->GetFieldObject<Object*>(src_offset, false);
-        heap->VerifyObject(object);
-        // directly set field, we do a bulk write barrier at the end
-        dst->SetField32(dst_offset, reinterpret_cast<uint32_t>(object), false, true);
-        src_offset = MemberOffset(src_offset.Uint32Value() + sizeof(Object*));
-        dst_offset = MemberOffset(dst_offset.Uint32Value() + sizeof(Object*));
-      }
+    Class* src_class = src->GetClass();
+    if (array_class == src_class ||
+        array_class->GetComponentType()->IsAssignableFrom(src_class->GetComponentType())) {
+      // No need for array store checks, move the references in bulk keeping each one atomic and
+      // do a bulk write barrier at the end.
+      byte* dst_bytes = reinterpret_cast<byte*>(dst) + dst_offset.Uint32Value();
+      const byte* src_bytes = reinterpret_cast<const byte*>(src) + src_offset.Uint32Value();
+      MemmoveWords(dst_bytes, src_bytes, length * sizeof(HeapReference<Object>));
     } else {
       Class* element_class = array_class->GetComponentType();
       CHECK(!element_class->IsPrimitive());
@@ -119,13 +118,14 @@ inline void ObjectArray<T>::Copy(const ObjectArray<T>* src, int src_pos,
         Object* object = src->GetFieldObject<Object*>(src_offset, false);
         if (object != NULL && !object->InstanceOf(element_class)) {
           dst->ThrowArrayStoreException(object);
-          return;
+          // Still mark the card for the elements already copied.
+          break;
         }
         heap->VerifyObject(object);
         // directly set field, we do a bulk write barrier at the end
-        dst->SetField32(dst_offset, reinterpret_cast<uint32_t>(object), false, true);
-        src_offset = MemberOffset(src_offset.Uint32Value() + sizeof(Object*));
-        dst_offset = MemberOffset(dst_offset.Uint32Value() + sizeof(Object*));
+        dst->SetField32(dst_offset, HeapReference<Object>::Compress(object), false, true);
+        src_offset = MemberOffset(src_offset.Uint32Value() + sizeof(HeapReference<Object>));
+        dst_offset = MemberOffset(dst_offset.Uint32Value() + sizeof(HeapReference<Object>));
       }
     }
     heap->WriteBarrierArray(dst, dst_pos, length);
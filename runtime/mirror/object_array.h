@@ -55,6 +55,12 @@ class MANAGED ObjectArray : public Array {
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
 
  private:
+  // Elements are compressed references, the same size whatever the width of a pointer.
+  static MemberOffset OffsetOfElement(int32_t i) {
+    return MemberOffset(DataOffset(sizeof(HeapReference<Object>)).Int32Value() +
+                        i * sizeof(HeapReference<Object>));
+  }
+
   DISALLOW_IMPLICIT_CONSTRUCTORS(ObjectArray);
 };
 
@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ART_RUNTIME_MIRROR_OBJECT_REFERENCE_H_
+#define ART_RUNTIME_MIRROR_OBJECT_REFERENCE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "base/logging.h"
+#include "base/macros.h"
+
+namespace art {
+namespace mirror {
+
+class Object;
+
+// The address heap references are compressed against. Where pointers are 32 bits this is zero
+// and a compressed reference is the object's address, which is what compiled code, the image
+// writer and JNI assume. Where they are wider, references are offsets from the start of the
+// heap reservation, so the whole heap must lie within 4GB of it.
+static constexpr uintptr_t kHeapReferenceBase = sizeof(void*) == sizeof(uint32_t) ? 0 :
+    static_cast<uintptr_t>(ART_BASE_ADDRESS);
+
+// A reference from one managed object to another, as stored in the heap: a 32-bit value however
+// wide a native pointer is, so object layout and the density of arrays of references are the same
+// on every host. Null is stored as zero, which no object can have: the image header is at the
+// start of the heap.
+template<class MirrorType>
+class HeapReference {
+ public:
+  static uint32_t Compress(const MirrorType* mirror_ptr) {
+    if (mirror_ptr == NULL) {
+      return 0;
+    }
+    uintptr_t offset = reinterpret_cast<uintptr_t>(mirror_ptr) - kHeapReferenceBase;
+    DCHECK_EQ(offset, static_cast<uint32_t>(offset)) << mirror_ptr;
+    return static_cast<uint32_t>(offset);
+  }
+
+  static MirrorType* Decompress(uint32_t reference) {
+    if (reference == 0) {
+      return NULL;
+    }
+    return reinterpret_cast<MirrorType*>(kHeapReferenceBase + reference);
+  }
+
+  static HeapReference<MirrorType> FromMirrorPtr(const MirrorType* mirror_ptr) {
+    return HeapReference<MirrorType>(mirror_ptr);
+  }
+
+  MirrorType* AsMirrorPtr() const {
+    return Decompress(reference_);
+  }
+
+  void Assign(const MirrorType* other) {
+    reference_ = Compress(other);
+  }
+
+  void Clear() {
+    reference_ = 0;
+  }
+
+  bool IsNull() const {
+    return reference_ == 0;
+  }
+
+ private:
+  explicit HeapReference(const MirrorType* mirror_ptr) : reference_(Compress(mirror_ptr)) {}
+
+  // The compressed reference.
+  uint32_t reference_;
+};
+
+// The size of a reference field or array element, for code that lays out or addresses objects
+// without a HeapReference at hand, such as the compilers.
+static constexpr size_t kHeapReferenceSize = sizeof(uint32_t);
+COMPILE_ASSERT(sizeof(HeapReference<Object>) == kHeapReferenceSize,
+               heap_references_must_be_kHeapReferenceSize);
+
+}  // namespace mirror
+}  // namespace art
+
+#endif  // ART_RUNTIME_MIRROR_OBJECT_REFERENCE_H_
@@ -132,6 +132,26 @@ TEST_F(ObjectTest, AllocObjectArray) {
   EXPECT_EQ(class_linker_->FindSystemClass("Ljava/io/Serializable;"), oa_ch.GetDirectInterface(1));
 }
 
+TEST_F(ObjectTest, HeapReference) {
+  ScopedObjectAccess soa(Thread::Current());
+  SirtRef<ObjectArray<Object> > oa(soa.Self(),
+                                   class_linker_->AllocObjectArray<Object>(soa.Self(), 2));
+  HeapReference<Object> ref = HeapReference<Object>::FromMirrorPtr(oa.get());
+  EXPECT_FALSE(ref.IsNull());
+  EXPECT_EQ(oa.get(), ref.AsMirrorPtr());
+  ref.Assign(NULL);
+  EXPECT_TRUE(ref.IsNull());
+  EXPECT_TRUE(ref.AsMirrorPtr() == NULL);
+
+  // Elements are stored compressed, one reference size apart.
+  EXPECT_EQ(kHeapReferenceSize, sizeof(ref));
+  oa->Set(1, oa.get());
+  const HeapReference<Object>* elements =
+      reinterpret_cast<const HeapReference<Object>*>(oa->GetRawData(kHeapReferenceSize));
+  EXPECT_TRUE(elements[0].IsNull());
+  EXPECT_EQ(oa.get(), elements[1].AsMirrorPtr());
+}
+
 TEST_F(ObjectTest, AllocArray) {
   ScopedObjectAccess soa(Thread::Current());
   Class* c = class_linker_->FindSystemClass("[I");
@@ -284,7 +304,7 @@ TEST_F(ObjectTest, StaticFieldFromCode) {
   uint32_t field_idx = dex_file->GetIndexForFieldId(*field_id);
 
   ArtField* field = FindFieldFromCode(field_idx, clinit, Thread::Current(), StaticObjectRead,
-                                      sizeof(Object*), true);
+                                      kHeapReferenceSize, true);
   Object* s0 = field->GetObj(klass);
   EXPECT_TRUE(s0 != NULL);
 
@@ -335,6 +355,13 @@ TEST_F(ObjectTest, StringEqualsUtf8) {
   SirtRef<String> empty(soa.Self(), String::AllocFromModifiedUtf8(soa.Self(), ""));
   EXPECT_TRUE(empty->Equals(""));
   EXPECT_FALSE(empty->Equals("a"));
+
+  // Characters outside ASCII are decoded around the ASCII ones.
+  SirtRef<String> mixed(soa.Self(), String::AllocFromModifiedUtf8(soa.Self(), "h\xe1\x88\xb4i"));
+  EXPECT_EQ(3, mixed->GetLength());
+  EXPECT_TRUE(mixed->Equals("h\xe1\x88\xb4i"));
+  EXPECT_FALSE(mixed->Equals("h\xe1\x88\xb5i"));
+  EXPECT_FALSE(mixed->Equals("h\xe1\x88\xb4"));
 }
 
 TEST_F(ObjectTest, StringEquals) {
@@ -351,6 +378,14 @@ TEST_F(ObjectTest, StringEquals) {
   SirtRef<String> empty(soa.Self(), String::AllocFromModifiedUtf8(soa.Self(), ""));
   EXPECT_TRUE(empty->Equals(""));
   EXPECT_FALSE(empty->Equals("a"));
+  EXPECT_FALSE(empty->Equals(string.get()));
+
+  const uint16_t utf16[] = { 'a', 'n', 'd', 'r', 'o', 'i', 'd' };
+  SirtRef<String> string_3(soa.Self(), String::AllocFromUtf16(soa.Self(), 7, utf16));
+  EXPECT_TRUE(string->Equals(string_3.get()));
+  EXPECT_EQ(string->GetHashCode(), string_3->GetHashCode());
+  EXPECT_TRUE(string->Equals(utf16, 0, 7));
+  EXPECT_FALSE(string->Equals(utf16, 1, 6));
 }
 
 TEST_F(ObjectTest, StringCompareTo) {
@@ -369,6 +404,37 @@ TEST_F(ObjectTest, StringCompareTo) {
   EXPECT_GT(0, string_5->CompareTo(string.get()));
 }
 
+// Strings long enough for the eight-chars-at-a-time comparisons, differing in every position.
+TEST_F(ObjectTest, StringCompareToLong) {
+  ScopedObjectAccess soa(Thread::Current());
+  const char* chars = "abcdefghijklmnopqrstuvwxyz0123456789";
+  SirtRef<String> string(soa.Self(), String::AllocFromModifiedUtf8(soa.Self(), chars));
+  for (size_t i = 0; i < strlen(chars); ++i) {
+    std::string other(chars);
+    other[i] = 'A';
+    SirtRef<String> string_2(soa.Self(), String::AllocFromModifiedUtf8(soa.Self(),
+                                                                       other.c_str()));
+    EXPECT_EQ(chars[i] - 'A', string->CompareTo(string_2.get())) << i;
+    EXPECT_EQ('A' - chars[i], string_2->CompareTo(string.get())) << i;
+    other.resize(i);
+    SirtRef<String> prefix(soa.Self(), String::AllocFromModifiedUtf8(soa.Self(), other.c_str()));
+    EXPECT_EQ(static_cast<int32_t>(strlen(chars) - i), string->CompareTo(prefix.get())) << i;
+  }
+}
+
+TEST_F(ObjectTest, StringFastIndexOf) {
+  ScopedObjectAccess soa(Thread::Current());
+  const char* chars = "abcdefghijklmnopqrstuvwxyz0123456789abcdefghijklmnopqrstuvwxyz";
+  SirtRef<String> string(soa.Self(), String::AllocFromModifiedUtf8(soa.Self(), chars));
+  for (int32_t i = 0; i < 36; ++i) {
+    EXPECT_EQ(i, string->FastIndexOf(chars[i], 0)) << i;
+    EXPECT_EQ(i, string->FastIndexOf(chars[i], i)) << i;
+    EXPECT_EQ(i < 26 ? i + 36 : -1, string->FastIndexOf(chars[i], i + 1)) << i;
+  }
+  EXPECT_EQ(-1, string->FastIndexOf('A', -1));
+  EXPECT_EQ(-1, string->FastIndexOf('a', 100));
+}
+
 TEST_F(ObjectTest, StringLength) {
   ScopedObjectAccess soa(Thread::Current());
   SirtRef<String> string(soa.Self(), String::AllocFromModifiedUtf8(soa.Self(), "android"));
@@ -16,6 +16,12 @@
 
 #include "string.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
 #include "array.h"
 #include "class-inl.h"
 #include "gc/accounting/card_table-inl.h"
@@ -25,6 +31,7 @@
 #include "sirt_ref.h"
 #include "thread.h"
 #include "utf.h"
+#include "utils.h"
 
 namespace art {
 namespace mirror {
@@ -51,6 +58,27 @@ int32_t String::FastIndexOf(int32_t ch, int32_t start) const {
   const uint16_t* chars = GetCharArray()->GetData() + GetOffset();
   const uint16_t* p = chars + start;
   const uint16_t* end = chars + count;
+  // Compare eight chars at a time, leaving the last few and the search of a matching group of
+  // eight to the loop below.
+#if defined(__SSE2__)
+  const __m128i wanted = _mm_set1_epi16(static_cast<int16_t>(ch));
+  for (; end - p >= 8; p += 8) {
+    __m128i eq = _mm_cmpeq_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)), wanted);
+    int mask = _mm_movemask_epi8(eq);
+    if (mask != 0) {
+      // Two mask bits per char.
+      return (p - chars) + CTZ(mask) / 2;
+    }
+  }
+#elif defined(__ARM_NEON__)
+  const uint16x8_t wanted = vdupq_n_u16(static_cast<uint16_t>(ch));
+  for (; end - p >= 8; p += 8) {
+    uint64x2_t eq = vreinterpretq_u64_u16(vceqq_u16(vld1q_u16(p), wanted));
+    if ((vgetq_lane_u64(eq, 0) | vgetq_lane_u64(eq, 1)) != 0) {
+      break;
+    }
+  }
+#endif
   while (p < end) {
     if (*p++ == ch) {
       return (p - 1) - chars;
@@ -122,14 +150,11 @@ String* String::AllocFromUtf16(Thread* self,
   if (string == NULL) {
     return NULL;
   }
-  // TODO: use 16-bit wide memset variant
   CharArray* array = const_cast<CharArray*>(string->GetCharArray());
   if (array == NULL) {
     return NULL;
   }
-  for (int i = 0; i < utf16_length; i++) {
-    array->Set(i, utf16_data_in[i]);
-  }
+  memcpy(array->GetData(), utf16_data_in, utf16_length * sizeof(uint16_t));
   if (hash_code != 0) {
     string->SetHashCode(hash_code);
   } else {
@@ -192,12 +217,9 @@ bool String::Equals(const String* that) const {
   } else {
     // Note: don't short circuit on hash code as we're presumably here as the
     // hash code was already equal
-    for (int32_t i = 0; i < that->GetLength(); ++i) {
-      if (this->CharAt(i) != that->CharAt(i)) {
-        return false;
-      }
-    }
-    return true;
+    const uint16_t* this_chars = GetCharArray()->GetData() + GetOffset();
+    const uint16_t* that_chars = that->GetCharArray()->GetData() + that->GetOffset();
+    return memcmp(this_chars, that_chars, GetLength() * sizeof(uint16_t)) == 0;
   }
 }
 
@@ -205,19 +227,24 @@ bool String::Equals(const uint16_t* that_chars, int32_t that_offset, int32_t tha
   if (this->GetLength() != that_length) {
     return false;
   } else {
-    for (int32_t i = 0; i < that_length; ++i) {
-      if (this->CharAt(i) != that_chars[that_offset + i]) {
-        return false;
-      }
-    }
-    return true;
+    const uint16_t* this_chars = GetCharArray()->GetData() + GetOffset();
+    return memcmp(this_chars, that_chars + that_offset, that_length * sizeof(uint16_t)) == 0;
   }
 }
 
 bool String::Equals(const char* modified_utf8) const {
+  const uint16_t* chars = GetCharArray()->GetData() + GetOffset();
   for (int32_t i = 0; i < GetLength(); ++i) {
-    uint16_t ch = GetUtf16FromUtf8(&modified_utf8);
-    if (ch == '\0' || ch != CharAt(i)) {
+    // ASCII needs no decoding, and a '\0' terminator never matches a character.
+    uint8_t byte = *modified_utf8;
+    uint16_t ch;
+    if (LIKELY((byte & 0x80) == 0)) {
+      ch = byte;
+      ++modified_utf8;
+    } else {
+      ch = GetUtf16FromUtf8(&modified_utf8);
+    }
+    if (ch == '\0' || ch != chars[i]) {
       return false;
     }
   }
@@ -225,10 +252,11 @@ bool String::Equals(const char* modified_utf8) const {
 }
 
 bool String::Equals(const StringPiece& modified_utf8) const {
+  const uint16_t* chars = GetCharArray()->GetData() + GetOffset();
   const char* p = modified_utf8.data();
   for (int32_t i = 0; i < GetLength(); ++i) {
     uint16_t ch = GetUtf16FromUtf8(&p);
-    if (ch != CharAt(i)) {
+    if (ch != chars[i]) {
       return false;
     }
   }
@@ -250,7 +278,20 @@ extern "C" uint32_t __memcmp16(const uint16_t* s0, const uint16_t* s1, size_t co
 #define MemCmp16 __memcmp16
 #else
 static uint32_t MemCmp16(const uint16_t* s0, const uint16_t* s1, size_t count) {
-  for (size_t i = 0; i < count; i++) {
+  size_t i = 0;
+#if defined(__SSE2__)
+  // Eight chars at a time, then the first mismatching one of a group.
+  for (; count - i >= 8; i += 8) {
+    __m128i eq = _mm_cmpeq_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(s0 + i)),
+                                 _mm_loadu_si128(reinterpret_cast<const __m128i*>(s1 + i)));
+    int mask = _mm_movemask_epi8(eq);
+    if (mask != 0xffff) {
+      i += CTZ(~mask) / 2;
+      return static_cast<int32_t>(s0[i]) - static_cast<int32_t>(s1[i]);
+    }
+  }
+#endif
+  for (; i < count; i++) {
     if (s0[i] != s1[i]) {
       return static_cast<int32_t>(s0[i]) - static_cast<int32_t>(s1[i]);
     }
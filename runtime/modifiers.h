@@ -46,6 +46,9 @@ static const uint32_t kAccConstructor = 0x00010000;  // method (dex only) <init>
 static const uint32_t kAccDeclaredSynchronized = 0x00020000;  // method (dex only)
 static const uint32_t kAccClassIsProxy = 0x00040000;  // class (dex only)
 static const uint32_t kAccPreverified = 0x00080000;  // method (dex only)
+static const uint32_t kAccFastNative = 0x00100000;  // method (compiler only)
+static const uint32_t kAccCriticalNative = 0x00200000;  // method (compiler only)
+static const uint32_t kAccInstrumented = 0x00400000;  // method (runtime only)
 
 // Special runtime-only flags.
 // Note: if only kAccClassIsReference is set, we have a soft reference.
@@ -16,6 +16,9 @@
 
 #include "monitor.h"
 
+#include <unistd.h>
+
+#include <algorithm>
 #include <vector>
 
 #include "base/mutex.h"
@@ -49,15 +52,25 @@ namespace art {
  *
  * The two states of an Object's lock are referred to as "thin" and
  * "fat".  A lock may transition from the "thin" state to the "fat"
- * state and this transition is referred to as inflation.  Once a lock
- * has been inflated it remains in the "fat" state indefinitely.
+ * state and this transition is referred to as inflation.  An inflated
+ * lock remains in the "fat" state until the GC finds its monitor idle
+ * and deflates it back to an unlocked thin lock.
  *
  * The lock value itself is stored in Object.lock.  The LSB of the
  * lock encodes its state.  When cleared, the lock is in the "thin"
  * state and its bits are formatted as follows:
  *
- *    [31 ---- 19] [18 ---- 3] [2 ---- 1] [0]
- *     lock count   thread id  hash state  0
+ *    [31] [30 ---- 19] [18 ---- 3] [2 ---- 1] [0]
+ *   biased lock count   thread id  hash state  0
+ *
+ * With -XX:UseBiasedLocking, the runtime biases an unlocked thin lock
+ * toward the first thread to take it.  While the biased bit is set, the
+ * lock count is the number of times that thread holds the lock, zero
+ * meaning unlocked, and only that thread writes the lock word, without
+ * atomic operations.  Another thread wanting the lock revokes the bias,
+ * with all threads suspended, and then inflates the lock so that it is
+ * not biased again.  Compiled code only handles unbiased thin locks
+ * inline and leaves biased ones to the runtime.
  *
  * When set, the lock is in the "fat" state and its bits are formatted
  * as follows:
@@ -96,12 +109,28 @@ namespace art {
  * Lock recursion count field.  Contains a count of the number of times
  * a lock has been recursively acquired.
  */
-#define LW_LOCK_COUNT_MASK 0x1fff
+#define LW_LOCK_COUNT_MASK 0xfff
 #define LW_LOCK_COUNT_SHIFT 19
 #define LW_LOCK_COUNT(x) (((x) >> LW_LOCK_COUNT_SHIFT) & LW_LOCK_COUNT_MASK)
 
+// Bounds of the number of times a thread blocking on a fat lock retries it before sleeping.
+static const int32_t kMinSpinLimit = 16;
+static const int32_t kMaxSpinLimit = 4096;
+
+// Number of times a thread spinning on a thin lock polls it before it starts yielding.
+static const uint32_t kThinLockSpins = 64;
+
 bool (*Monitor::is_sensitive_thread_hook_)() = NULL;
 uint32_t Monitor::lock_profiling_threshold_ = 0;
+AtomicInteger Monitor::contention_histogram_[Monitor::kContentionHistogramBuckets];
+bool Monitor::use_biased_locking_ = false;
+bool Monitor::can_spin_ = false;
+
+// Does the thread hold the thin lock? A lock biased toward a thread it doesn't hold has a zero
+// count.
+static inline bool IsThinLockHeldBy(uint32_t thin, uint32_t thread_id) {
+  return LW_LOCK_OWNER(thin) == thread_id && (!LW_BIASED(thin) || LW_LOCK_COUNT(thin) != 0);
+}
 
 bool Monitor::IsSensitiveThread() {
   if (is_sensitive_thread_hook_ != NULL) {
@@ -110,9 +139,44 @@ bool Monitor::IsSensitiveThread() {
   return false;
 }
 
-void Monitor::Init(uint32_t lock_profiling_threshold, bool (*is_sensitive_thread_hook)()) {
+void Monitor::Init(uint32_t lock_profiling_threshold, bool use_biased_locking,
+                   bool (*is_sensitive_thread_hook)()) {
   lock_profiling_threshold_ = lock_profiling_threshold;
+  use_biased_locking_ = use_biased_locking;
   is_sensitive_thread_hook_ = is_sensitive_thread_hook;
+  // Spinning only pays off when the owner can run at the same time.
+  can_spin_ = sysconf(_SC_NPROCESSORS_ONLN) > 1;
+}
+
+void Monitor::RecordContention(uint64_t wait_ns) {
+  // Bucket i > 0 counts waits of [2^(i-1), 2^i) microseconds, the last one everything longer.
+  uint64_t wait_us = wait_ns / 1000;
+  size_t bucket = 0;
+  while (wait_us != 0 && bucket < kContentionHistogramBuckets - 1) {
+    wait_us >>= 1;
+    ++bucket;
+  }
+  ++contention_histogram_[bucket];
+}
+
+void Monitor::DumpForSigQuit(std::ostream& os) {
+  int32_t total = 0;
+  for (size_t i = 0; i < kContentionHistogramBuckets; ++i) {
+    total += contention_histogram_[i];
+  }
+  os << "Monitor contention: " << total << " contended acquires";
+  for (size_t i = 0; i < kContentionHistogramBuckets; ++i) {
+    int32_t count = contention_histogram_[i];
+    if (count != 0) {
+      if (i == kContentionHistogramBuckets - 1) {
+        os << "; >=" << PrettyDuration(static_cast<uint64_t>(1000) << (i - 1));
+      } else {
+        os << "; <" << PrettyDuration(static_cast<uint64_t>(1000) << i);
+      }
+      os << ": " << count;
+    }
+  }
+  os << "\n";
 }
 
 Monitor::Monitor(Thread* owner, mirror::Object* obj)
@@ -121,12 +185,15 @@ Monitor::Monitor(Thread* owner, mirror::Object* obj)
       lock_count_(0),
       obj_(obj),
       wait_set_(NULL),
+      wake_set_(NULL),
+      spin_limit_(kMinSpinLimit),
       locking_method_(NULL),
       locking_dex_pc_(0) {
   monitor_lock_.Lock(owner);
   // Propagate the lock state.
   uint32_t thin = *obj->GetRawLockWordAddress();
-  lock_count_ = LW_LOCK_COUNT(thin);
+  // A biased lock counts every hold, an unbiased one only the recursive ones.
+  lock_count_ = LW_BIASED(thin) ? LW_LOCK_COUNT(thin) - 1 : LW_LOCK_COUNT(thin);
   thin &= LW_HASH_STATE_MASK << LW_HASH_STATE_SHIFT;
   thin |= reinterpret_cast<uint32_t>(this) | LW_SHAPE_FAT;
   // Publish the updated lock word.
@@ -164,29 +231,69 @@ void Monitor::AppendToWaitSet(Thread* thread) {
 }
 
 /*
- * Unlinks a thread from a monitor's wait set.  The monitor lock must
- * be held by the caller of this routine.
+ * Links a list of threads, usually a single one, into a monitor's wake
+ * set.  The monitor lock must be held by the caller of this routine.
  */
-void Monitor::RemoveFromWaitSet(Thread *thread) {
+void Monitor::AppendToWakeSet(Thread* threads) {
   DCHECK(owner_ == Thread::Current());
-  DCHECK(thread != NULL);
-  if (wait_set_ == NULL) {
-    return;
-  }
-  if (wait_set_ == thread) {
-    wait_set_ = thread->wait_next_;
-    thread->wait_next_ = NULL;
+  DCHECK(threads != NULL);
+  if (wake_set_ == NULL) {
+    wake_set_ = threads;
     return;
   }
 
-  Thread* t = wait_set_;
+  // push_back.
+  Thread* t = wake_set_;
   while (t->wait_next_ != NULL) {
-    if (t->wait_next_ == thread) {
-      t->wait_next_ = thread->wait_next_;
+    t = t->wait_next_;
+  }
+  t->wait_next_ = threads;
+}
+
+/*
+ * Unlinks a thread from a monitor's wait set, or from its wake set if
+ * it was notified but woke up on its own.  The monitor lock must be
+ * held by the caller of this routine.
+ */
+void Monitor::RemoveFromWaitSet(Thread *thread) {
+  DCHECK(owner_ == Thread::Current());
+  DCHECK(thread != NULL);
+  Thread** sets[] = { &wait_set_, &wake_set_ };
+  for (size_t i = 0; i < arraysize(sets); ++i) {
+    Thread*& set = *sets[i];
+    if (set == NULL) {
+      continue;
+    }
+    if (set == thread) {
+      set = thread->wait_next_;
       thread->wait_next_ = NULL;
       return;
     }
-    t = t->wait_next_;
+
+    Thread* t = set;
+    while (t->wait_next_ != NULL) {
+      if (t->wait_next_ == thread) {
+        t->wait_next_ = thread->wait_next_;
+        thread->wait_next_ = NULL;
+        return;
+      }
+      t = t->wait_next_;
+    }
+  }
+}
+
+void Monitor::WakeNotifiedThread(Thread* self) {
+  while (wake_set_ != NULL) {
+    Thread* thread = wake_set_;
+    wake_set_ = thread->wait_next_;
+    thread->wait_next_ = NULL;
+
+    // Threads that woke up from a timeout or an interrupt are already on their way to the monitor.
+    MutexLock mu(self, *thread->wait_mutex_);
+    if (thread->wait_monitor_ != NULL) {
+      thread->wait_cond_->Signal(self);
+      return;
+    }
   }
 }
 
@@ -200,7 +307,10 @@ void Monitor::Lock(Thread* self) {
     return;
   }
 
+  bool contended = false;
   if (!monitor_lock_.TryLock(self)) {
+    contended = true;
+    ++num_contenders_;
     uint64_t waitStart = 0;
     uint64_t waitEnd = 0;
     uint32_t wait_threshold = lock_profiling_threshold_;
@@ -208,17 +318,16 @@ void Monitor::Lock(Thread* self) {
     uint32_t current_locking_dex_pc = 0;
     {
       ScopedThreadStateChange tsc(self, kBlocked);
-      if (wait_threshold != 0) {
-        waitStart = NanoTime() / 1000;
-      }
+      waitStart = NanoTime() / 1000;
       current_locking_method = locking_method_;
       current_locking_dex_pc = locking_dex_pc_;
 
-      monitor_lock_.Lock(self);
-      if (wait_threshold != 0) {
-        waitEnd = NanoTime() / 1000;
+      if (!SpinLock(self)) {
+        monitor_lock_.Lock(self);
       }
+      waitEnd = NanoTime() / 1000;
     }
+    RecordContention((waitEnd - waitStart) * 1000);
 
     if (wait_threshold != 0) {
       uint64_t wait_ms = (waitEnd - waitStart) / 1000;
@@ -239,6 +348,9 @@ void Monitor::Lock(Thread* self) {
   }
   owner_ = self;
   DCHECK_EQ(lock_count_, 0);
+  if (contended) {
+    --num_contenders_;
+  }
 
   // When debugging, save the current monitor holder for future
   // acquisition failures to use in sampled logging.
@@ -247,6 +359,23 @@ void Monitor::Lock(Thread* self) {
   }
 }
 
+bool Monitor::SpinLock(Thread* self) {
+  if (!can_spin_) {
+    return false;
+  }
+  // The limit adapts to how long owners hold the lock: it grows while owners let go within it and
+  // shrinks while they don't. Racy updates only cost a poorer guess.
+  int32_t spin_limit = spin_limit_;
+  for (int32_t i = 0; i < spin_limit; ++i) {
+    if (owner_ == NULL && monitor_lock_.TryLock(self)) {
+      spin_limit_ = std::min(spin_limit * 2, kMaxSpinLimit);
+      return true;
+    }
+  }
+  spin_limit_ = std::max(spin_limit / 2, kMinSpinLimit);
+  return false;
+}
+
 static void ThrowIllegalMonitorStateExceptionF(const char* fmt, ...)
                                               __attribute__((format(printf, 1, 2)));
 
@@ -344,12 +473,13 @@ bool Monitor::Unlock(Thread* self, bool for_wait) {
       owner_ = NULL;
       locking_method_ = NULL;
       locking_dex_pc_ = 0;
+      WakeNotifiedThread(self);
       monitor_lock_.Unlock(self);
     } else {
       --lock_count_;
     }
   } else if (for_wait) {
-    // Wait should have already cleared the fields.
+    // Wait should have already cleared the fields and woken a notified thread.
     DCHECK_EQ(lock_count_, 0);
     DCHECK(owner == NULL);
     DCHECK(locking_method_ == NULL);
@@ -430,6 +560,7 @@ void Monitor::WaitWithLock(Thread* self, int64_t ms, int32_t ns,
    * not order sensitive as we hold the pthread mutex.
    */
   AppendToWaitSet(self);
+  ++num_contenders_;
   int prev_lock_count = lock_count_;
   lock_count_ = 0;
   owner_ = NULL;
@@ -437,6 +568,9 @@ void Monitor::WaitWithLock(Thread* self, int64_t ms, int32_t ns,
   locking_method_ = NULL;
   uintptr_t saved_dex_pc = locking_dex_pc_;
   locking_dex_pc_ = 0;
+  // Wake a notified thread here, rather than when releasing the monitor lock below, as that is
+  // done holding our own wait_mutex_.
+  WakeNotifiedThread(self);
 
   /*
    * Update thread state. If the GC wakes up, it'll ignore us, knowing
@@ -506,6 +640,7 @@ void Monitor::WaitWithLock(Thread* self, int64_t ms, int32_t ns,
   locking_method_ = saved_method;
   locking_dex_pc_ = saved_dex_pc;
   RemoveFromWaitSet(self);
+  --num_contenders_;
 
   if (was_interrupted) {
     /*
@@ -538,7 +673,8 @@ void Monitor::Notify(Thread* self) {
 }
 
 void Monitor::NotifyWithLock(Thread* self) {
-  // Signal the first waiting thread in the wait set.
+  // Move the first thread in the wait set that is still waiting to the wake set, it is woken as
+  // the monitor is released.
   while (wait_set_ != NULL) {
     Thread* thread = wait_set_;
     wait_set_ = thread->wait_next_;
@@ -547,7 +683,7 @@ void Monitor::NotifyWithLock(Thread* self) {
     // Check to see if the thread is still waiting.
     MutexLock mu(self, *thread->wait_mutex_);
     if (thread->wait_monitor_ != NULL) {
-      thread->wait_cond_->Signal(self);
+      AppendToWakeSet(thread);
       return;
     }
   }
@@ -565,12 +701,11 @@ void Monitor::NotifyAll(Thread* self) {
 }
 
 void Monitor::NotifyAllWithLock() {
-  // Signal all threads in the wait set.
-  while (wait_set_ != NULL) {
-    Thread* thread = wait_set_;
-    wait_set_ = thread->wait_next_;
-    thread->wait_next_ = NULL;
-    thread->Notify();
+  // Move all threads in the wait set to the wake set, they are woken one by one as the monitor is
+  // released.
+  if (wait_set_ != NULL) {
+    AppendToWakeSet(wait_set_);
+    wait_set_ = NULL;
   }
 }
 
@@ -582,7 +717,7 @@ void Monitor::Inflate(Thread* self, mirror::Object* obj) {
   DCHECK(self != NULL);
   DCHECK(obj != NULL);
   DCHECK_EQ(LW_SHAPE(*obj->GetRawLockWordAddress()), LW_SHAPE_THIN);
-  DCHECK_EQ(LW_LOCK_OWNER(*obj->GetRawLockWordAddress()), static_cast<int32_t>(self->GetThinLockId()));
+  DCHECK(IsThinLockHeldBy(*obj->GetRawLockWordAddress(), self->GetThinLockId()));
 
   // Allocate and acquire a new monitor.
   Monitor* m = new Monitor(self, obj);
@@ -591,6 +726,46 @@ void Monitor::Inflate(Thread* self, mirror::Object* obj) {
   Runtime::Current()->GetMonitorList()->Add(m);
 }
 
+void Monitor::RevokeBias(Thread* self, mirror::Object* obj) {
+  volatile int32_t* thinp = obj->GetRawLockWordAddress();
+  VLOG(monitor) << StringPrintf("monitor: thread %d revoking bias of lock %p toward thread %d",
+                                self->GetThinLockId(), thinp, LW_LOCK_OWNER(*thinp));
+  // The owner may be in the middle of updating the lock word until it is suspended.
+  self->monitor_enter_object_ = obj;
+  self->TransitionFromRunnableToSuspended(kBlocked);
+  ThreadList* thread_list = Runtime::Current()->GetThreadList();
+  thread_list->SuspendAll();
+  // Another thread may have revoked the bias first.
+  const uint32_t thin = *thinp;
+  if (LW_SHAPE(thin) == LW_SHAPE_THIN && LW_BIASED(thin)) {
+    uint32_t new_thin = thin & (LW_HASH_STATE_MASK << LW_HASH_STATE_SHIFT);
+    if (LW_LOCK_COUNT(thin) != 0) {
+      new_thin |= (LW_LOCK_OWNER(thin) << LW_LOCK_OWNER_SHIFT) |
+          ((LW_LOCK_COUNT(thin) - 1) << LW_LOCK_COUNT_SHIFT);
+    }
+    // Resuming the threads publishes the store.
+    *thinp = new_thin;
+  }
+  thread_list->ResumeAll();
+  self->monitor_enter_object_ = NULL;
+  self->TransitionFromSuspendedToRunnable();
+}
+
+bool Monitor::Deflate(Monitor* monitor) {
+  // With all other threads suspended nobody can be between reading the lock word and locking the
+  // monitor, everybody else using the monitor is counted.
+  if (monitor->owner_ != NULL || monitor->num_contenders_ != 0) {
+    return false;
+  }
+  DCHECK(monitor->wait_set_ == NULL);
+  DCHECK(monitor->wake_set_ == NULL);
+  mirror::Object* obj = monitor->obj_;
+  VLOG(monitor) << "monitor: deflating monitor " << monitor << " for object " << obj;
+  delete monitor;
+  *obj->GetRawLockWordAddress() &= LW_HASH_STATE_MASK << LW_HASH_STATE_SHIFT;
+  return true;
+}
+
 void Monitor::MonitorEnter(Thread* self, mirror::Object* obj) {
   volatile int32_t* thinp = obj->GetRawLockWordAddress();
   uint32_t sleepDelayNs;
@@ -601,8 +776,27 @@ void Monitor::MonitorEnter(Thread* self, mirror::Object* obj) {
   DCHECK(self != NULL);
   DCHECK(obj != NULL);
   uint32_t threadId = self->GetThinLockId();
+  // Set once we revoked a bias, so that we inflate the lock rather than bias it again.
+  bool revoked_bias = false;
  retry:
   thin = *thinp;
+  if (LW_SHAPE(thin) == LW_SHAPE_THIN && LW_BIASED(thin)) {
+    if (LW_LOCK_OWNER(thin) == threadId) {
+      if (LIKELY(LW_LOCK_COUNT(thin) != LW_LOCK_COUNT_MASK)) {
+        // The lock is biased toward us, nobody else writes the lock word.
+        *thinp = thin + (1 << LW_LOCK_COUNT_SHIFT);
+        return;
+      }
+      // Out of count bits. Drop the bias, after which the recursive acquire below inflates the
+      // lock.
+      newThin = (thin & ~(1U << LW_BIASED_SHIFT)) - (1 << LW_LOCK_COUNT_SHIFT);
+      android_atomic_release_store(newThin, thinp);
+    } else {
+      RevokeBias(self, obj);
+      revoked_bias = true;
+    }
+    goto retry;
+  }
   if (LW_SHAPE(thin) == LW_SHAPE_THIN) {
     /*
      * The lock is a thin lock.  The owner field is used to
@@ -626,11 +820,20 @@ void Monitor::MonitorEnter(Thread* self, mirror::Object* obj) {
       // The lock is unowned. Install the thread id of the calling thread into the owner field.
       // This is the common case: compiled code will have tried this before calling back into
       // the runtime.
+      const bool bias = use_biased_locking_ && !revoked_bias;
       newThin = thin | (threadId << LW_LOCK_OWNER_SHIFT);
+      if (bias) {
+        // The first hold, counted in the lock count of a biased lock.
+        newThin |= (1U << LW_BIASED_SHIFT) | (1 << LW_LOCK_COUNT_SHIFT);
+      }
       if (android_atomic_acquire_cas(thin, newThin, thinp) != 0) {
         // The acquire failed. Try again.
         goto retry;
       }
+      if (revoked_bias) {
+        // The lock is shared, keep it from being biased again.
+        Inflate(self, obj);
+      }
     } else {
       VLOG(monitor) << StringPrintf("monitor: thread %d spin on lock %p (a %s) owned by %d",
                                     threadId, thinp, PrettyTypeOf(obj).c_str(), LW_LOCK_OWNER(thin));
@@ -638,12 +841,19 @@ void Monitor::MonitorEnter(Thread* self, mirror::Object* obj) {
       self->monitor_enter_object_ = obj;
       self->TransitionFromRunnableToSuspended(kBlocked);
       // Spin until the thin lock is released or inflated.
+      const uint64_t spin_start = NanoTime();
+      uint32_t spins = 0;
       sleepDelayNs = 0;
       for (;;) {
         thin = *thinp;
         // Check the shape of the lock word. Another thread
         // may have inflated the lock while we were waiting.
-        if (LW_SHAPE(thin) == LW_SHAPE_THIN) {
+        if (LW_SHAPE(thin) == LW_SHAPE_THIN && LW_BIASED(thin)) {
+          // The lock was released and then biased toward another thread, revoke the bias.
+          self->monitor_enter_object_ = NULL;
+          self->TransitionFromSuspendedToRunnable();
+          goto retry;
+        } else if (LW_SHAPE(thin) == LW_SHAPE_THIN) {
           if (LW_LOCK_OWNER(thin) == 0) {
             // The lock has been released. Install the thread id of the
             // calling thread into the owner field.
@@ -652,6 +862,10 @@ void Monitor::MonitorEnter(Thread* self, mirror::Object* obj) {
               // The acquire succeed. Break out of the loop and proceed to inflate the lock.
               break;
             }
+          } else if (can_spin_ && spins < kThinLockSpins) {
+            // The owner is likely running on another processor and about to release the lock,
+            // poll again before giving up the processor.
+            ++spins;
           } else {
             // The lock has not been released. Yield so the owning thread can run.
             if (sleepDelayNs == 0) {
@@ -677,6 +891,7 @@ void Monitor::MonitorEnter(Thread* self, mirror::Object* obj) {
         }
       }
       VLOG(monitor) << StringPrintf("monitor: thread %d spin on lock %p done", threadId, thinp);
+      RecordContention(NanoTime() - spin_start);
       // We have acquired the thin lock. Let the runtime know that we are no longer waiting.
       self->monitor_enter_object_ = NULL;
       self->TransitionFromSuspendedToRunnable();
@@ -706,7 +921,14 @@ bool Monitor::MonitorExit(Thread* self, mirror::Object* obj) {
    * examining its state.
    */
   uint32_t thin = *thinp;
-  if (LW_SHAPE(thin) == LW_SHAPE_THIN) {
+  if (LW_SHAPE(thin) == LW_SHAPE_THIN && LW_BIASED(thin)) {
+    if (!IsThinLockHeldBy(thin, self->GetThinLockId())) {
+      FailedUnlock(obj, self, NULL, NULL);
+      return false;
+    }
+    // Keep the bias, only we write the lock word.
+    *thinp = thin - (1 << LW_LOCK_COUNT_SHIFT);
+  } else if (LW_SHAPE(thin) == LW_SHAPE_THIN) {
     /*
      * The lock is thin.  We must ensure that the lock is owned
      * by the given thread before unlocking it.
@@ -764,7 +986,7 @@ void Monitor::Wait(Thread* self, mirror::Object *obj, int64_t ms, int32_t ns,
   uint32_t thin = *thinp;
   if (LW_SHAPE(thin) == LW_SHAPE_THIN) {
     // Make sure that 'self' holds the lock.
-    if (LW_LOCK_OWNER(thin) != self->GetThinLockId()) {
+    if (!IsThinLockHeldBy(thin, self->GetThinLockId())) {
       ThrowIllegalMonitorStateExceptionF("object not locked by thread before wait()");
       return;
     }
@@ -787,7 +1009,7 @@ void Monitor::Notify(Thread* self, mirror::Object *obj) {
   // waiting on an object forces lock fattening.
   if (LW_SHAPE(thin) == LW_SHAPE_THIN) {
     // Make sure that 'self' holds the lock.
-    if (LW_LOCK_OWNER(thin) != self->GetThinLockId()) {
+    if (!IsThinLockHeldBy(thin, self->GetThinLockId())) {
       ThrowIllegalMonitorStateExceptionF("object not locked by thread before notify()");
       return;
     }
@@ -808,7 +1030,7 @@ void Monitor::NotifyAll(Thread* self, mirror::Object *obj) {
   // waiting on an object forces lock fattening.
   if (LW_SHAPE(thin) == LW_SHAPE_THIN) {
     // Make sure that 'self' holds the lock.
-    if (LW_LOCK_OWNER(thin) != self->GetThinLockId()) {
+    if (!IsThinLockHeldBy(thin, self->GetThinLockId())) {
       ThrowIllegalMonitorStateExceptionF("object not locked by thread before notifyAll()");
       return;
     }
@@ -824,6 +1046,9 @@ void Monitor::NotifyAll(Thread* self, mirror::Object *obj) {
 
 uint32_t Monitor::GetThinLockId(uint32_t raw_lock_word) {
   if (LW_SHAPE(raw_lock_word) == LW_SHAPE_THIN) {
+    if (LW_BIASED(raw_lock_word) && LW_LOCK_COUNT(raw_lock_word) == 0) {
+      return 0;
+    }
     return LW_LOCK_OWNER(raw_lock_word);
   } else {
     Thread* owner = LW_MONITOR(raw_lock_word)->owner_;
@@ -1021,13 +1246,29 @@ void MonitorList::Add(Monitor* m) {
 }
 
 void MonitorList::SweepMonitorList(IsMarkedTester is_marked, void* arg) {
-  MutexLock mu(Thread::Current(), monitor_list_lock_);
+  Thread* self = Thread::Current();
+  // Monitors can only be deflated while no thread can be on its way to locking one.
+  const bool deflate = Locks::mutator_lock_->IsExclusiveHeld(self);
+  MutexLock mu(self, monitor_list_lock_);
   for (auto it = list_.begin(); it != list_.end(); ) {
     Monitor* m = *it;
     if (!is_marked(m->GetObject(), arg)) {
       VLOG(monitor) << "freeing monitor " << m << " belonging to unmarked object " << m->GetObject();
       delete m;
       it = list_.erase(it);
+    } else if (deflate && Monitor::Deflate(m)) {
+      it = list_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void MonitorList::DeflateMonitors() {
+  MutexLock mu(Thread::Current(), monitor_list_lock_);
+  for (auto it = list_.begin(); it != list_.end(); ) {
+    if (Monitor::Deflate(*it)) {
+      it = list_.erase(it);
     } else {
       ++it;
     }
@@ -1037,10 +1278,11 @@ void MonitorList::SweepMonitorList(IsMarkedTester is_marked, void* arg) {
 MonitorInfo::MonitorInfo(mirror::Object* o) : owner(NULL), entry_count(0) {
   uint32_t lock_word = *o->GetRawLockWordAddress();
   if (LW_SHAPE(lock_word) == LW_SHAPE_THIN) {
-    uint32_t owner_thin_lock_id = LW_LOCK_OWNER(lock_word);
+    uint32_t owner_thin_lock_id = Monitor::GetThinLockId(lock_word);
     if (owner_thin_lock_id != 0) {
       owner = Runtime::Current()->GetThreadList()->FindThreadByThinLockId(owner_thin_lock_id);
-      entry_count = 1 + LW_LOCK_COUNT(lock_word);
+      // A biased lock counts every hold, an unbiased one only the recursive ones.
+      entry_count = (LW_BIASED(lock_word) ? 0 : 1) + LW_LOCK_COUNT(lock_word);
     }
     // Thin locks have no waiters.
   } else {
@@ -1051,6 +1293,9 @@ MonitorInfo::MonitorInfo(mirror::Object* o) : owner(NULL), entry_count(0) {
     for (Thread* waiter = monitor->wait_set_; waiter != NULL; waiter = waiter->wait_next_) {
       waiters.push_back(waiter);
     }
+    for (Thread* waiter = monitor->wake_set_; waiter != NULL; waiter = waiter->wait_next_) {
+      waiters.push_back(waiter);
+    }
   }
 }
 
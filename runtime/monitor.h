@@ -24,6 +24,7 @@
 #include <list>
 #include <vector>
 
+#include "atomic_integer.h"
 #include "base/mutex.h"
 #include "root_visitor.h"
 #include "thread_state.h"
@@ -55,6 +56,13 @@ namespace art {
 #define LW_LOCK_OWNER_SHIFT 3
 #define LW_LOCK_OWNER(x) (((x) >> LW_LOCK_OWNER_SHIFT) & LW_LOCK_OWNER_MASK)
 
+/*
+ * Bias field.  Set when a thin lock is biased toward the thread in its
+ * owner field, which then takes and releases it without atomic operations.
+ */
+#define LW_BIASED_SHIFT 31
+#define LW_BIASED(x) (((x) >> LW_BIASED_SHIFT) & 0x1)
+
 namespace mirror {
   class ArtMethod;
   class Object;
@@ -67,7 +75,8 @@ class Monitor {
   ~Monitor();
 
   static bool IsSensitiveThread();
-  static void Init(uint32_t lock_profiling_threshold, bool (*is_sensitive_thread_hook)());
+  static void Init(uint32_t lock_profiling_threshold, bool use_biased_locking,
+                   bool (*is_sensitive_thread_hook)());
 
   static uint32_t GetThinLockId(uint32_t raw_lock_word)
       NO_THREAD_SAFETY_ANALYSIS;  // Reading lock owner without holding lock is racy.
@@ -102,6 +111,9 @@ class Monitor {
 
   static bool IsValidLockWord(int32_t lock_word);
 
+  // Dumps the histogram of how long threads waited for contended monitors.
+  static void DumpForSigQuit(std::ostream& os);
+
   mirror::Object* GetObject();
 
  private:
@@ -109,11 +121,34 @@ class Monitor {
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
 
   void AppendToWaitSet(Thread* thread) EXCLUSIVE_LOCKS_REQUIRED(monitor_lock_);
+  void AppendToWakeSet(Thread* threads) EXCLUSIVE_LOCKS_REQUIRED(monitor_lock_);
+  // Unlinks thread from the wait set or, once notified, the wake set.
   void RemoveFromWaitSet(Thread* thread) EXCLUSIVE_LOCKS_REQUIRED(monitor_lock_);
 
+  // Wakes the first thread in the wake set that is still waiting, as the monitor is about to be
+  // released.
+  void WakeNotifiedThread(Thread* self) EXCLUSIVE_LOCKS_REQUIRED(monitor_lock_);
+
   static void Inflate(Thread* self, mirror::Object* obj)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
 
+  // Takes away the bias of a thin lock biased toward another thread, leaving it held as often as
+  // the owner holds it. Suspends all threads to do so.
+  static void RevokeBias(Thread* self, mirror::Object* obj)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
+  // Frees an idle monitor, turning its object's lock back into an unlocked thin lock. Returns
+  // false, leaving the monitor alone, if a thread owns it, waits on it or is blocked on it.
+  // Requires all other threads to be suspended.
+  static bool Deflate(Monitor* monitor) NO_THREAD_SAFETY_ANALYSIS;
+
+  // Counts a contended acquire that waited for wait_ns in the contention histogram.
+  static void RecordContention(uint64_t wait_ns);
+
+  // Retries monitor_lock_ for a while before the caller blocks on it. Returns true if it got the
+  // lock.
+  bool SpinLock(Thread* self) NO_THREAD_SAFETY_ANALYSIS;
+
   void LogContentionEvent(Thread* self, uint32_t wait_ms, uint32_t sample_percent,
                           const char* owner_filename, uint32_t owner_line_number)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
@@ -149,6 +184,10 @@ class Monitor {
 
   static bool (*is_sensitive_thread_hook_)();
   static uint32_t lock_profiling_threshold_;
+  static const size_t kContentionHistogramBuckets = 24;
+  static AtomicInteger contention_histogram_[kContentionHistogramBuckets];
+  static bool use_biased_locking_;
+  static bool can_spin_;
 
   Mutex monitor_lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
 
@@ -164,6 +203,18 @@ class Monitor {
   // Threads currently waiting on this monitor.
   Thread* wait_set_ GUARDED_BY(monitor_lock_);
 
+  // Threads notified while the monitor was held, still waiting. They are woken one per release
+  // of the monitor rather than by the notify, so that they don't wake only to block on the
+  // monitor behind the notifier, and each woken thread wakes the next when it lets go.
+  Thread* wake_set_ GUARDED_BY(monitor_lock_);
+
+  // Threads blocked on monitor_lock_ or in a wait, which hold onto the monitor without owning it,
+  // so that it can't be deflated.
+  AtomicInteger num_contenders_;
+
+  // Number of times a contender retries monitor_lock_ before blocking on it.
+  volatile int32_t spin_limit_;
+
   // Method and dex pc where the lock owner acquired the lock, used when lock
   // sampling is enabled. locking_method_ may be null if the lock is currently
   // unlocked, or if the lock is acquired by the system when the stack is empty.
@@ -182,8 +233,12 @@ class MonitorList {
   ~MonitorList();
 
   void Add(Monitor* m);
+  // Frees the monitors of unmarked objects. When all other threads are suspended, also deflates
+  // the idle monitors of marked ones.
   void SweepMonitorList(IsMarkedTester is_marked, void* arg)
       SHARED_LOCKS_REQUIRED(Locks::heap_bitmap_lock_);
+  // Deflates every idle monitor, for collectors that sweep with the mutators running.
+  void DeflateMonitors() EXCLUSIVE_LOCKS_REQUIRED(Locks::mutator_lock_);
   void DisallowNewMonitors();
   void AllowNewMonitors();
  private:
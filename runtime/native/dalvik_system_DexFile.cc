@@ -96,19 +96,20 @@ static jint DexFile_openDexFileNative(JNIEnv* env, jclass, jstring javaSourceNam
   }
   ScopedObjectAccess soa(env);
 
-  uint32_t dex_location_checksum;
-  if (!DexFile::GetChecksum(dex_location, &dex_location_checksum)) {
-    LOG(WARNING) << "Failed to compute checksum: " << dex_location;
-    ThrowLocation throw_location = soa.Self()->GetCurrentLocationForThrow();
-    soa.Self()->ThrowNewExceptionF(throw_location, "Ljava/io/IOException;",
-                                   "Unable to get checksum of dex file: %s", dex_location.c_str());
-  }
-
   ClassLinker* linker = Runtime::Current()->GetClassLinker();
   const DexFile* dex_file;
   if (outputName.c_str() == NULL) {
-    dex_file = linker->FindDexFileInOatFileFromDexLocation(dex_location, dex_location_checksum);
+    // The checksum is only computed once an oat file is found, which may vouch for it.
+    dex_file = linker->FindDexFileInOatFileFromDexLocation(dex_location);
   } else {
+    uint32_t dex_location_checksum;
+    if (!DexFile::GetChecksum(dex_location, &dex_location_checksum)) {
+      LOG(WARNING) << "Failed to compute checksum: " << dex_location;
+      ThrowLocation throw_location = soa.Self()->GetCurrentLocationForThrow();
+      soa.Self()->ThrowNewExceptionF(throw_location, "Ljava/io/IOException;",
+                                     "Unable to get checksum of dex file: %s",
+                                     dex_location.c_str());
+    }
     std::string oat_location(outputName.c_str());
     dex_file = linker->FindOrCreateOatFileForDexLocation(dex_location, dex_location_checksum, oat_location);
   }
@@ -20,6 +20,8 @@
 #include "class_linker.h"
 #include "common_throws.h"
 #include "debugger.h"
+#include "gc/allocation_sampler.h"
+#include "gc/heap.h"
 #include "gc/space/dlmalloc_space.h"
 #include "gc/space/large_object_space.h"
 #include "gc/space/space-inl.h"
@@ -40,6 +42,7 @@ static jobjectArray VMDebug_getVmFeatureList(JNIEnv* env, jclass) {
   features.push_back("method-sample-profiling");
   features.push_back("hprof-heap-dump");
   features.push_back("hprof-heap-dump-streaming");
+  features.push_back("allocation-sampling");
   return toStringArray(env, features);
 }
 
@@ -51,6 +54,26 @@ static void VMDebug_stopAllocCounting(JNIEnv*, jclass) {
   Runtime::Current()->SetStatsEnabled(false);
 }
 
+static void VMDebug_startAllocationSampling(JNIEnv* env, jclass, jint intervalBytes) {
+  ScopedObjectAccess soa(env);
+  size_t interval_bytes = (intervalBytes > 0) ? intervalBytes :
+      gc::AllocationSampler::kDefaultIntervalBytes;
+  Runtime::Current()->GetHeap()->GetAllocationSampler()->Start(interval_bytes);
+}
+
+static void VMDebug_stopAllocationSampling(JNIEnv*, jclass) {
+  Runtime::Current()->GetHeap()->GetAllocationSampler()->Stop();
+}
+
+static void VMDebug_resetAllocationSamples(JNIEnv*, jclass) {
+  Runtime::Current()->GetHeap()->GetAllocationSampler()->Reset();
+}
+
+static void VMDebug_dumpAllocationSamples(JNIEnv* env, jclass) {
+  ScopedObjectAccess soa(env);
+  Runtime::Current()->GetHeap()->GetAllocationSampler()->Dump(LOG(INFO));
+}
+
 static jint VMDebug_getAllocCount(JNIEnv*, jclass, jint kind) {
   return Runtime::Current()->GetStat(kind);
 }
@@ -201,11 +224,11 @@ static void VMDebug_dumpHprofData(JNIEnv* env, jclass, jstring javaFilename, job
     }
   }
 
-  hprof::DumpHeap(filename.c_str(), fd, false);
+  hprof::DumpHeap(filename.c_str(), fd, false, Runtime::Current()->GetHprofOptions());
 }
 
 static void VMDebug_dumpHprofDataDdms(JNIEnv*, jclass) {
-  hprof::DumpHeap("[DDMS]", -1, true);
+  hprof::DumpHeap("[DDMS]", -1, true, hprof::DumpOptions());
 }
 
 static void VMDebug_dumpReferenceTables(JNIEnv* env, jclass) {
@@ -306,6 +329,7 @@ static void VMDebug_getHeapSpaceStats(JNIEnv* env, jclass, jlongArray data) {
 static JNINativeMethod gMethods[] = {
   NATIVE_METHOD(VMDebug, countInstancesOfClass, "(Ljava/lang/Class;Z)J"),
   NATIVE_METHOD(VMDebug, crash, "()V"),
+  NATIVE_METHOD(VMDebug, dumpAllocationSamples, "()V"),
   NATIVE_METHOD(VMDebug, dumpHprofData, "(Ljava/lang/String;Ljava/io/FileDescriptor;)V"),
   NATIVE_METHOD(VMDebug, dumpHprofDataDdms, "()V"),
   NATIVE_METHOD(VMDebug, dumpReferenceTables, "()V"),
@@ -321,14 +345,17 @@ static JNINativeMethod gMethods[] = {
   NATIVE_METHOD(VMDebug, lastDebuggerActivity, "()J"),
   NATIVE_METHOD(VMDebug, printLoadedClasses, "(I)V"),
   NATIVE_METHOD(VMDebug, resetAllocCount, "(I)V"),
+  NATIVE_METHOD(VMDebug, resetAllocationSamples, "()V"),
   NATIVE_METHOD(VMDebug, resetInstructionCount, "()V"),
   NATIVE_METHOD(VMDebug, startAllocCounting, "()V"),
+  NATIVE_METHOD(VMDebug, startAllocationSampling, "(I)V"),
   NATIVE_METHOD(VMDebug, startEmulatorTracing, "()V"),
   NATIVE_METHOD(VMDebug, startInstructionCounting, "()V"),
   NATIVE_METHOD(VMDebug, startMethodTracingDdmsImpl, "(IIZI)V"),
   NATIVE_METHOD(VMDebug, startMethodTracingFd, "(Ljava/lang/String;Ljava/io/FileDescriptor;II)V"),
   NATIVE_METHOD(VMDebug, startMethodTracingFilename, "(Ljava/lang/String;II)V"),
   NATIVE_METHOD(VMDebug, stopAllocCounting, "()V"),
+  NATIVE_METHOD(VMDebug, stopAllocationSampling, "()V"),
   NATIVE_METHOD(VMDebug, stopEmulatorTracing, "()V"),
   NATIVE_METHOD(VMDebug, stopInstructionCounting, "()V"),
   NATIVE_METHOD(VMDebug, stopMethodTracing, "()V"),
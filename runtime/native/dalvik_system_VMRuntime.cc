@@ -15,6 +15,7 @@
  */
 
 #include <limits.h>
+#include <unistd.h>
 
 #include "class_linker.h"
 #include "common_throws.h"
@@ -27,6 +28,8 @@
 #include "mirror/class-inl.h"
 #include "mirror/object.h"
 #include "mirror/object-inl.h"
+#include "mirror/object_array-inl.h"
+#include "mirror/string.h"
 #include "object_utils.h"
 #include "scoped_thread_state_change.h"
 #include "thread.h"
@@ -158,6 +161,30 @@ static void VMRuntime_setTargetSdkVersion(JNIEnv* env, jobject, jint targetSdkVe
   }
 }
 
+// Loads the named boot class path classes on a thread per core, for the zygote to call with its
+// list of preloaded classes before it initializes them one at a time.
+static jint VMRuntime_preloadClasses(JNIEnv* env, jobject, jobjectArray javaClassNames) {
+  std::vector<std::string> descriptors;
+  {
+    ScopedObjectAccess soa(env);
+    mirror::ObjectArray<mirror::String>* class_names =
+        soa.Decode<mirror::ObjectArray<mirror::String>*>(javaClassNames);
+    if (class_names == NULL) {
+      ThrowNullPointerException(NULL, "classNames == null");
+      return 0;
+    }
+    for (int32_t i = 0; i < class_names->GetLength(); ++i) {
+      mirror::String* class_name = class_names->Get(i);
+      if (class_name != NULL) {
+        descriptors.push_back(DotToDescriptor(class_name->ToModifiedUtf8().c_str()));
+      }
+    }
+  }
+  size_t thread_count = sysconf(_SC_NPROCESSORS_CONF);
+  return Runtime::Current()->GetClassLinker()->PreloadClasses(static_cast<JNIEnvExt*>(env)->self,
+                                                              descriptors, thread_count);
+}
+
 static void VMRuntime_registerNativeAllocation(JNIEnv* env, jobject, jint bytes) {
   ScopedObjectAccess soa(env);
   if (bytes < 0) {
@@ -218,6 +245,7 @@ static JNINativeMethod gMethods[] = {
   NATIVE_METHOD(VMRuntime, nativeSetTargetHeapMinFree, "(I)I"),
   NATIVE_METHOD(VMRuntime, nativeSetTargetHeapConcurrentStart, "(I)I"),
   NATIVE_METHOD(VMRuntime, newNonMovableArray, "(Ljava/lang/Class;I)Ljava/lang/Object;"),
+  NATIVE_METHOD(VMRuntime, preloadClasses, "([Ljava/lang/String;)I"),
   NATIVE_METHOD(VMRuntime, properties, "()[Ljava/lang/String;"),
   NATIVE_METHOD(VMRuntime, setTargetSdkVersion, "(I)V"),
   NATIVE_METHOD(VMRuntime, registerNativeAllocation, "(I)V"),
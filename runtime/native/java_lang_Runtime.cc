@@ -32,7 +32,7 @@ static void Runtime_gc(JNIEnv*, jclass) {
       LOG(INFO) << "Explicit GC skipped.";
       return;
   }
-  Runtime::Current()->GetHeap()->CollectGarbage(false);
+  Runtime::Current()->GetHeap()->RequestExplicitGc(Thread::Current());
 }
 
 static void Runtime_nativeExit(JNIEnv*, jclass, jint status) {
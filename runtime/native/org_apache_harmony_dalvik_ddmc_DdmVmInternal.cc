@@ -30,6 +30,16 @@ static void DdmVmInternal_enableRecentAllocations(JNIEnv*, jclass, jboolean enab
   Dbg::SetAllocTrackingEnabled(enable);
 }
 
+static jbyteArray DdmVmInternal_getGcEvents(JNIEnv* env, jclass) {
+  ScopedObjectAccess soa(env);
+  return Dbg::GetGcEvents();
+}
+
+static jbyteArray DdmVmInternal_getStartupTimeline(JNIEnv* env, jclass) {
+  ScopedObjectAccess soa(env);
+  return Dbg::GetStartupTimeline();
+}
+
 static jbyteArray DdmVmInternal_getRecentAllocations(JNIEnv* env, jclass) {
   ScopedObjectAccess soa(env);
   return Dbg::GetRecentAllocations();
@@ -160,9 +170,11 @@ static void DdmVmInternal_threadNotify(JNIEnv*, jclass, jboolean enable) {
 
 static JNINativeMethod gMethods[] = {
   NATIVE_METHOD(DdmVmInternal, enableRecentAllocations, "(Z)V"),
+  NATIVE_METHOD(DdmVmInternal, getGcEvents, "()[B"),
   NATIVE_METHOD(DdmVmInternal, getRecentAllocations, "()[B"),
   NATIVE_METHOD(DdmVmInternal, getRecentAllocationStatus, "()Z"),
   NATIVE_METHOD(DdmVmInternal, getStackTraceById, "(I)[Ljava/lang/StackTraceElement;"),
+  NATIVE_METHOD(DdmVmInternal, getStartupTimeline, "()[B"),
   NATIVE_METHOD(DdmVmInternal, getThreadStats, "()[B"),
   NATIVE_METHOD(DdmVmInternal, heapInfoNotify, "(I)Z"),
   NATIVE_METHOD(DdmVmInternal, heapSegmentNotify, "(IIZ)Z"),
@@ -0,0 +1,211 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "numa.h"
+
+#include <ctype.h>
+#include <dirent.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "base/logging.h"
+#include "base/stringprintf.h"
+#include "utils.h"
+
+namespace art {
+
+// From <linux/mempolicy.h>, which neither bionic nor glibc export.
+static constexpr int kMpolPreferred = 1;
+static constexpr unsigned kMpolMfMove = 1 << 1;
+
+std::vector<int> Numa::node_ids_;
+std::vector<std::vector<int> > Numa::node_cpus_;
+std::vector<size_t> Numa::cpu_nodes_;
+
+void Numa::Init() {
+  node_ids_.clear();
+  node_cpus_.clear();
+  cpu_nodes_.clear();
+  std::vector<int> node_ids;
+  DIR* d = opendir("/sys/devices/system/node");
+  if (d != NULL) {
+    dirent* e;
+    while ((e = readdir(d)) != NULL) {
+      char* end;
+      if (strncmp(e->d_name, "node", 4) == 0 && isdigit(e->d_name[4])) {
+        int node_id = strtol(e->d_name + 4, &end, 10);
+        if (*end == '\0') {
+          node_ids.push_back(node_id);
+        }
+      }
+    }
+    closedir(d);
+  }
+  std::sort(node_ids.begin(), node_ids.end());
+  for (size_t i = 0; i < node_ids.size(); ++i) {
+    std::string cpu_list;
+    std::vector<int> cpus;
+    if (!ReadFileToString(StringPrintf("/sys/devices/system/node/node%d/cpulist", node_ids[i]),
+                          &cpu_list) ||
+        !ParseCpuList(cpu_list, &cpus)) {
+      LOG(WARNING) << "Failed to read the CPUs of NUMA node " << node_ids[i];
+      continue;
+    }
+    if (cpus.empty()) {
+      // A node with memory only, no thread can be local to it.
+      continue;
+    }
+    for (size_t j = 0; j < cpus.size(); ++j) {
+      if (static_cast<size_t>(cpus[j]) >= cpu_nodes_.size()) {
+        cpu_nodes_.resize(cpus[j] + 1, 0);
+      }
+      cpu_nodes_[cpus[j]] = node_cpus_.size();
+    }
+    node_ids_.push_back(node_ids[i]);
+    node_cpus_.push_back(cpus);
+  }
+  if (node_cpus_.size() < 2) {
+    node_ids_.clear();
+    node_cpus_.clear();
+    cpu_nodes_.clear();
+  }
+  VLOG(heap) << "Found " << NumNodes() << " NUMA node(s)";
+}
+
+const std::vector<int>& Numa::NodeCpus(size_t node) {
+  static const std::vector<int> no_cpus;
+  if (node_cpus_.empty()) {
+    return no_cpus;
+  }
+  DCHECK_LT(node, node_cpus_.size());
+  return node_cpus_[node];
+}
+
+size_t Numa::CurrentNode() {
+#if defined(__linux__) && defined(__NR_getcpu)
+  if (!cpu_nodes_.empty()) {
+    unsigned cpu;
+    if (syscall(__NR_getcpu, &cpu, NULL, NULL) == 0 && cpu < cpu_nodes_.size()) {
+      return cpu_nodes_[cpu];
+    }
+  }
+#endif
+  return 0;
+}
+
+bool Numa::PreferNode(void* begin, size_t byte_count, size_t node) {
+  DCHECK_EQ(reinterpret_cast<uintptr_t>(begin) % kPageSize, 0U);
+  if (node_ids_.empty()) {
+    return true;
+  }
+  DCHECK_LT(node, node_ids_.size());
+#if defined(__linux__) && defined(__NR_mbind)
+  const size_t kMaskBits = sizeof(unsigned long) * kBitsPerByte;  // NOLINT(runtime/int)
+  if (static_cast<size_t>(node_ids_[node]) >= kMaskBits) {
+    LOG(WARNING) << "NUMA node id " << node_ids_[node] << " is out of range";
+    return false;
+  }
+  unsigned long mask = 1UL << node_ids_[node];  // NOLINT(runtime/int)
+  // The kernel ignores the last bit of the mask length it is given.
+  if (syscall(__NR_mbind, begin, byte_count, kMpolPreferred, &mask, kMaskBits + 1,
+              kMpolMfMove) != 0) {
+    PLOG(WARNING) << "mbind(" << begin << ", " << byte_count << ") to node " << node_ids_[node]
+                  << " failed";
+    return false;
+  }
+  return true;
+#else
+  LOG(WARNING) << "Can't place " << byte_count << " bytes on NUMA node " << node;
+  return false;
+#endif
+}
+
+bool Numa::CountResidentPages(const byte* begin, const byte* end,
+                              std::vector<size_t>* pages_per_node) {
+  pages_per_node->assign(NumNodes(), 0);
+  if (node_ids_.empty()) {
+    return false;
+  }
+#if defined(__linux__) && defined(__NR_move_pages)
+  static const size_t kBatch = 64;
+  void* pages[kBatch];
+  int status[kBatch];
+  for (const byte* page = begin; page < end; ) {
+    size_t count = 0;
+    for (; count < kBatch && page < end; ++count, page += kPageSize) {
+      pages[count] = const_cast<byte*>(page);
+    }
+    // Without target nodes move_pages only reports where each page is, or -ENOENT if it isn't.
+    if (syscall(__NR_move_pages, 0, count, pages, NULL, status, 0) != 0) {
+      PLOG(WARNING) << "move_pages failed";
+      return false;
+    }
+    for (size_t i = 0; i < count; ++i) {
+      std::vector<int>::const_iterator it =
+          std::find(node_ids_.begin(), node_ids_.end(), status[i]);
+      if (status[i] >= 0 && it != node_ids_.end()) {
+        ++(*pages_per_node)[it - node_ids_.begin()];
+      }
+    }
+  }
+  return true;
+#else
+  LOG(WARNING) << "Can't tell the NUMA nodes of " << reinterpret_cast<const void*>(begin) << "-"
+               << reinterpret_cast<const void*>(end);
+  return false;
+#endif
+}
+
+bool Numa::ParseCpuList(const std::string& cpu_list, std::vector<int>* cpus) {
+  cpus->clear();
+  std::vector<std::string> ranges;
+  Split(cpu_list, ',', ranges);
+  for (size_t i = 0; i < ranges.size(); ++i) {
+    std::string range(ranges[i]);
+    // sysfs ends the list with a newline.
+    range.erase(range.find_last_not_of(" \n") + 1);
+    if (range.empty()) {
+      continue;
+    }
+    const char* p = range.c_str();
+    char* end;
+    long first = strtol(p, &end, 10);  // NOLINT(runtime/int)
+    long last = first;  // NOLINT(runtime/int)
+    if (end == p || first < 0) {
+      return false;
+    }
+    if (*end == '-') {
+      p = end + 1;
+      last = strtol(p, &end, 10);
+      if (end == p || last < first) {
+        return false;
+      }
+    }
+    if (*end != '\0') {
+      return false;
+    }
+    for (long cpu = first; cpu <= last; ++cpu) {  // NOLINT(runtime/int)
+      cpus->push_back(cpu);
+    }
+  }
+  return true;
+}
+
+}  // namespace art
@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ART_RUNTIME_NUMA_H_
+#define ART_RUNTIME_NUMA_H_
+
+#include <stddef.h>
+
+#include <string>
+#include <vector>
+
+#include "base/macros.h"
+#include "globals.h"
+
+namespace art {
+
+// The NUMA nodes of the host with CPUs, as sysfs lists them, and the memory policy calls the heap
+// uses to place its pages on them. Nodes are numbered densely from zero in the order of their
+// kernel ids. Until Init finds more than one node, or where the kernel has no NUMA support,
+// there is a single node and the calls do nothing.
+class Numa {
+ public:
+  // Reads the topology. Must be called before any thread other than the main thread uses Numa.
+  static void Init();
+
+  static size_t NumNodes() {
+    return node_cpus_.empty() ? 1 : node_cpus_.size();
+  }
+
+  // The CPUs of node, empty if there is a single node.
+  static const std::vector<int>& NodeCpus(size_t node);
+
+  // The node of the CPU the calling thread is running on.
+  static size_t CurrentNode();
+
+  // Asks the kernel to place the pages of [begin, begin + byte_count) on node, migrating the ones
+  // already resident elsewhere. begin must be page aligned.
+  static bool PreferNode(void* begin, size_t byte_count, size_t node);
+
+  // Counts the pages of [begin, end) resident on each node into pages_per_node, which is resized
+  // to NumNodes(). Returns false if the kernel can't tell.
+  static bool CountResidentPages(const byte* begin, const byte* end,
+                                 std::vector<size_t>* pages_per_node);
+
+  // Parses a sysfs cpu list such as "0-3,8,10-11". Returns false if it is malformed.
+  static bool ParseCpuList(const std::string& cpu_list, std::vector<int>* cpus);
+
+ private:
+  // Kernel node id of each node.
+  static std::vector<int> node_ids_;
+  static std::vector<std::vector<int> > node_cpus_;
+  // Node of each CPU.
+  static std::vector<size_t> cpu_nodes_;
+
+  DISALLOW_IMPLICIT_CONSTRUCTORS(Numa);
+};
+
+}  // namespace art
+
+#endif  // ART_RUNTIME_NUMA_H_
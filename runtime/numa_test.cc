@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "numa.h"
+
+#include "gtest/gtest.h"
+
+namespace art {
+
+class NumaTest : public testing::Test {};
+
+TEST_F(NumaTest, ParseCpuList) {
+  std::vector<int> cpus;
+  ASSERT_TRUE(Numa::ParseCpuList("0-3,8,10-11\n", &cpus));
+  ASSERT_EQ(7U, cpus.size());
+  EXPECT_EQ(0, cpus[0]);
+  EXPECT_EQ(3, cpus[3]);
+  EXPECT_EQ(8, cpus[4]);
+  EXPECT_EQ(10, cpus[5]);
+  EXPECT_EQ(11, cpus[6]);
+
+  ASSERT_TRUE(Numa::ParseCpuList("\n", &cpus));
+  EXPECT_TRUE(cpus.empty());
+
+  EXPECT_FALSE(Numa::ParseCpuList("3-1", &cpus));
+  EXPECT_FALSE(Numa::ParseCpuList("0-", &cpus));
+  EXPECT_FALSE(Numa::ParseCpuList("a", &cpus));
+}
+
+TEST_F(NumaTest, Topology) {
+  Numa::Init();
+  ASSERT_GE(Numa::NumNodes(), 1U);
+  EXPECT_LT(Numa::CurrentNode(), Numa::NumNodes());
+  if (Numa::NumNodes() > 1) {
+    for (size_t node = 0; node < Numa::NumNodes(); ++node) {
+      EXPECT_FALSE(Numa::NodeCpus(node).empty());
+    }
+  }
+}
+
+}  // namespace art
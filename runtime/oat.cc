@@ -22,7 +22,7 @@
 namespace art {
 
 const uint8_t OatHeader::kOatMagic[] = { 'o', 'a', 't', '\n' };
-const uint8_t OatHeader::kOatVersion[] = { '0', '0', '8', '\0' };
+const uint8_t OatHeader::kOatVersion[] = { '0', '1', '8', '\0' };
 
 OatHeader::OatHeader() {
   memset(this, 0, sizeof(*this));
@@ -64,6 +64,9 @@ OatHeader::OatHeader(InstructionSet instruction_set,
   portable_to_interpreter_bridge_offset_ = 0;
   quick_resolution_trampoline_offset_ = 0;
   quick_to_interpreter_bridge_offset_ = 0;
+  dex_location_mtime_ = 0;
+  dex_location_size_ = 0;
+  dex_location_inode_ = 0;
 }
 
 bool OatHeader::IsValid() const {
@@ -92,6 +95,30 @@ void OatHeader::UpdateChecksum(const void* data, size_t length) {
   adler32_checksum_ = adler32(adler32_checksum_, bytes, length);
 }
 
+void OatHeader::SetDexLocationStat(const struct stat& dex_location_stat) {
+  DCHECK(IsValid());
+  DCHECK_EQ(dex_location_size_, 0U);
+  CHECK_NE(dex_location_stat.st_size, 0);
+
+  dex_location_mtime_ = static_cast<uint32_t>(dex_location_stat.st_mtime);
+  UpdateChecksum(&dex_location_mtime_, sizeof(dex_location_mtime_));
+  dex_location_size_ = static_cast<uint32_t>(dex_location_stat.st_size);
+  UpdateChecksum(&dex_location_size_, sizeof(dex_location_size_));
+  dex_location_inode_ = static_cast<uint32_t>(dex_location_stat.st_ino);
+  UpdateChecksum(&dex_location_inode_, sizeof(dex_location_inode_));
+}
+
+bool OatHeader::MatchesDexLocationStat(const struct stat& dex_location_stat) const {
+  DCHECK(IsValid());
+  // An empty file can't hold a dex file, so a zero size means nothing was recorded.
+  if (dex_location_size_ == 0) {
+    return false;
+  }
+  return dex_location_mtime_ == static_cast<uint32_t>(dex_location_stat.st_mtime)
+      && dex_location_size_ == static_cast<uint32_t>(dex_location_stat.st_size)
+      && dex_location_inode_ == static_cast<uint32_t>(dex_location_stat.st_ino);
+}
+
 InstructionSet OatHeader::GetInstructionSet() const {
   CHECK(IsValid());
   return instruction_set_;
@@ -17,6 +17,8 @@
 #ifndef ART_RUNTIME_OAT_H_
 #define ART_RUNTIME_OAT_H_
 
+#include <sys/stat.h>
+
 #include <vector>
 
 #include "base/macros.h"
@@ -73,6 +75,13 @@ class PACKED(4) OatHeader {
   uint32_t GetQuickToInterpreterBridgeOffset() const;
   void SetQuickToInterpreterBridgeOffset(uint32_t offset);
 
+  // Records the mtime, size and inode of the file at the location of the single dex file the
+  // oat file was compiled from, so that a later load can tell it is unchanged without reading
+  // its checksum out of the zip.
+  void SetDexLocationStat(const struct stat& dex_location_stat);
+  // Returns true if a stat was recorded and dex_location_stat matches it.
+  bool MatchesDexLocationStat(const struct stat& dex_location_stat) const;
+
   InstructionSet GetInstructionSet() const;
   uint32_t GetImageFileLocationOatChecksum() const;
   uint32_t GetImageFileLocationOatDataBegin() const;
@@ -96,6 +105,11 @@ class PACKED(4) OatHeader {
   uint32_t quick_resolution_trampoline_offset_;
   uint32_t quick_to_interpreter_bridge_offset_;
 
+  // Zero when not recorded, see SetDexLocationStat.
+  uint32_t dex_location_mtime_;
+  uint32_t dex_location_size_;
+  uint32_t dex_location_inode_;
+
   uint32_t image_file_location_oat_checksum_;
   uint32_t image_file_location_oat_data_begin_;
   uint32_t image_file_location_size_;
@@ -106,6 +120,11 @@ class PACKED(4) OatHeader {
 
 class PACKED(4) OatMethodOffsets {
  public:
+  // Set in code_offset_ for code stored deflated, which is inflated into executable memory when
+  // the method is first called. The rest of code_offset_ is then the offset of the code's size
+  // and of the size of its raw deflate stream, as uint32_ts, followed by the stream.
+  static constexpr uint32_t kCompressedCodeFlag = 0x80000000U;
+
   OatMethodOffsets();
 
   OatMethodOffsets(uint32_t code_offset,
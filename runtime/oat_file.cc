@@ -17,6 +17,8 @@
 #include "oat_file.h"
 
 #include <dlfcn.h>
+#include <sys/mman.h>
+#include <zlib.h>
 
 #include "base/stl_util.h"
 #include "base/unix_file/fd_file.h"
@@ -27,6 +29,7 @@
 #include "mirror/class.h"
 #include "mirror/object-inl.h"
 #include "os.h"
+#include "thread.h"
 #include "utils.h"
 #include "vmap_table.h"
 
@@ -83,12 +86,33 @@ OatFile* OatFile::Open(const std::string& filename,
   if (file.get() == NULL) {
     return NULL;
   }
-  return OpenElfFile(file.get(), location, requested_base, false, executable);
+  return OpenElfFile(file.get(), location, requested_base, 0, false, executable);
+}
+
+OatFile* OatFile::OpenRelocated(const std::string& filename,
+                                const std::string& location,
+                                byte* requested_base,
+                                ptrdiff_t load_bias,
+                                bool executable) {
+  CHECK(!filename.empty()) << location;
+  CheckLocation(filename);
+#ifdef ART_USE_PORTABLE_COMPILER
+  // dlopen can't be asked to load at an offset from the linked address.
+  if (executable) {
+    LOG(WARNING) << "Cannot relocate portable oat file " << filename;
+    return NULL;
+  }
+#endif
+  UniquePtr<File> file(OS::OpenFileForReading(filename.c_str()));
+  if (file.get() == NULL) {
+    return NULL;
+  }
+  return OpenElfFile(file.get(), location, requested_base, load_bias, false, executable);
 }
 
 OatFile* OatFile::OpenWritable(File* file, const std::string& location) {
   CheckLocation(location);
-  return OpenElfFile(file, location, NULL, true, false);
+  return OpenElfFile(file, location, NULL, 0, true, false);
 }
 
 OatFile* OatFile::OpenDlopen(const std::string& elf_filename,
@@ -105,10 +129,11 @@ OatFile* OatFile::OpenDlopen(const std::string& elf_filename,
 OatFile* OatFile::OpenElfFile(File* file,
                               const std::string& location,
                               byte* requested_base,
+                              ptrdiff_t load_bias,
                               bool writable,
                               bool executable) {
   UniquePtr<OatFile> oat_file(new OatFile(location));
-  bool success = oat_file->ElfFileOpen(file, requested_base, writable, executable);
+  bool success = oat_file->ElfFileOpen(file, requested_base, load_bias, writable, executable);
   if (!success) {
     return NULL;
   }
@@ -116,12 +141,14 @@ OatFile* OatFile::OpenElfFile(File* file,
 }
 
 OatFile::OatFile(const std::string& location)
-    : location_(location), begin_(NULL), end_(NULL), dlopen_handle_(NULL) {
+    : location_(location), begin_(NULL), end_(NULL), dlopen_handle_(NULL),
+      inflated_code_lock_("oat file inflated code lock"), inflated_code_top_(NULL) {
   CHECK(!location_.empty());
 }
 
 OatFile::~OatFile() {
   STLDeleteValues(&oat_dex_files_);
+  STLDeleteElements(&inflated_code_maps_);
   if (dlopen_handle_ != NULL) {
     dlclose(dlopen_handle_);
   }
@@ -163,7 +190,8 @@ bool OatFile::Dlopen(const std::string& elf_filename, byte* requested_base) {
   return Setup();
 }
 
-bool OatFile::ElfFileOpen(File* file, byte* requested_base, bool writable, bool executable) {
+bool OatFile::ElfFileOpen(File* file, byte* requested_base, ptrdiff_t load_bias, bool writable,
+                          bool executable) {
   elf_file_.reset(ElfFile::Open(file, writable, true));
   if (elf_file_.get() == NULL) {
     if (writable) {
@@ -171,7 +199,7 @@ bool OatFile::ElfFileOpen(File* file, byte* requested_base, bool writable, bool
     }
     return false;
   }
-  bool loaded = elf_file_->Load(executable);
+  bool loaded = elf_file_->Load(executable, load_bias);
   if (!loaded) {
     LOG(WARNING) << "Failed to load ELF file " << file->GetPath();
     return false;
@@ -300,11 +328,35 @@ bool OatFile::Setup() {
       return false;
     }
 
+    const uint32_t* class_def_index_pointer = reinterpret_cast<const uint32_t*>(oat);
+    if (oat + sizeof(*class_def_index_pointer) > End()) {
+      LOG(ERROR) << "In oat file " << GetLocation() << " found OatDexFile # " << i
+                 << " for "<< dex_file_location
+                 << " truncated before class def index";
+      return false;
+    }
+    uint32_t class_def_index_entries = *class_def_index_pointer;
+    if (!IsPowerOfTwo(class_def_index_entries) ||
+        class_def_index_entries <= header->class_defs_size_) {
+      LOG(ERROR) << "In oat file " << GetLocation() << " found OatDexFile # " << i
+                 << " for "<< dex_file_location
+                 << " with invalid class def index size " << class_def_index_entries;
+      return false;
+    }
+    oat += sizeof(*class_def_index_pointer) * (1 + class_def_index_entries * 2);
+    if (oat > End()) {
+      LOG(ERROR) << "In oat file " << GetLocation() << " found OatDexFile # " << i
+                 << " for "<< dex_file_location
+                 << " with truncated class def index";
+      return false;
+    }
+
     oat_dex_files_.Put(dex_file_location, new OatDexFile(this,
                                                          dex_file_location,
                                                          dex_file_checksum,
                                                          dex_file_pointer,
-                                                         methods_offsets_pointer));
+                                                         methods_offsets_pointer,
+                                                         class_def_index_pointer));
   }
   return true;
 }
@@ -360,12 +412,14 @@ OatFile::OatDexFile::OatDexFile(const OatFile* oat_file,
                                 const std::string& dex_file_location,
                                 uint32_t dex_file_location_checksum,
                                 const byte* dex_file_pointer,
-                                const uint32_t* oat_class_offsets_pointer)
+                                const uint32_t* oat_class_offsets_pointer,
+                                const uint32_t* class_def_index_pointer)
     : oat_file_(oat_file),
       dex_file_location_(dex_file_location),
       dex_file_location_checksum_(dex_file_location_checksum),
       dex_file_pointer_(dex_file_pointer),
-      oat_class_offsets_pointer_(oat_class_offsets_pointer) {}
+      oat_class_offsets_pointer_(oat_class_offsets_pointer),
+      class_def_index_pointer_(class_def_index_pointer) {}
 
 OatFile::OatDexFile::~OatDexFile() {}
 
@@ -374,8 +428,13 @@ size_t OatFile::OatDexFile::FileSize() const {
 }
 
 const DexFile* OatFile::OatDexFile::OpenDexFile() const {
-  return DexFile::Open(dex_file_pointer_, FileSize(), dex_file_location_,
-                       dex_file_location_checksum_);
+  const DexFile* dex_file = DexFile::Open(dex_file_pointer_, FileSize(), dex_file_location_,
+                                          dex_file_location_checksum_);
+  if (dex_file != NULL) {
+    // Class lookups probe the mapped table rather than building one.
+    dex_file->SetClassDefIndex(class_def_index_pointer_);
+  }
+  return dex_file;
 }
 
 const OatFile::OatClass* OatFile::OatDexFile::GetOatClass(uint16_t class_def_index) const {
@@ -386,17 +445,32 @@ const OatFile::OatClass* OatFile::OatDexFile::GetOatClass(uint16_t class_def_ind
   mirror::Class::Status status = *reinterpret_cast<const mirror::Class::Status*>(oat_class_pointer);
 
   const byte* methods_pointer = oat_class_pointer + sizeof(status);
+  uint32_t num_verification_dependencies = 0;
+  const uint16_t* verification_dependencies_pointer = NULL;
+  if (status == mirror::Class::kStatusRetryVerificationAtRuntime) {
+    num_verification_dependencies = *reinterpret_cast<const uint32_t*>(methods_pointer);
+    methods_pointer += sizeof(num_verification_dependencies);
+    verification_dependencies_pointer = reinterpret_cast<const uint16_t*>(methods_pointer);
+    methods_pointer += RoundUp(num_verification_dependencies * sizeof(uint16_t), sizeof(uint32_t));
+  }
   CHECK_LT(methods_pointer, oat_file_->End()) << oat_file_->GetLocation();
 
   return new OatClass(oat_file_,
                       status,
+                      num_verification_dependencies,
+                      verification_dependencies_pointer,
                       reinterpret_cast<const OatMethodOffsets*>(methods_pointer));
 }
 
 OatFile::OatClass::OatClass(const OatFile* oat_file,
                             mirror::Class::Status status,
+                            uint32_t num_verification_dependencies,
+                            const uint16_t* verification_dependencies_pointer,
                             const OatMethodOffsets* methods_pointer)
-    : oat_file_(oat_file), status_(status), methods_pointer_(methods_pointer) {}
+    : oat_file_(oat_file), status_(status),
+      num_verification_dependencies_(num_verification_dependencies),
+      verification_dependencies_pointer_(verification_dependencies_pointer),
+      methods_pointer_(methods_pointer) {}
 
 OatFile::OatClass::~OatClass() {}
 
@@ -414,7 +488,8 @@ const OatFile::OatMethod OatFile::OatClass::GetOatMethod(uint32_t method_index)
       oat_method_offsets.fp_spill_mask_,
       oat_method_offsets.mapping_table_offset_,
       oat_method_offsets.vmap_table_offset_,
-      oat_method_offsets.gc_map_offset_);
+      oat_method_offsets.gc_map_offset_,
+      oat_file_);
 }
 
 OatFile::OatMethod::OatMethod(const byte* base,
@@ -424,7 +499,8 @@ OatFile::OatMethod::OatMethod(const byte* base,
                               const uint32_t fp_spill_mask,
                               const uint32_t mapping_table_offset,
                               const uint32_t vmap_table_offset,
-                              const uint32_t gc_map_offset)
+                              const uint32_t gc_map_offset,
+                              const OatFile* oat_file)
   : begin_(base),
     code_offset_(code_offset),
     frame_size_in_bytes_(frame_size_in_bytes),
@@ -432,7 +508,8 @@ OatFile::OatMethod::OatMethod(const byte* base,
     fp_spill_mask_(fp_spill_mask),
     mapping_table_offset_(mapping_table_offset),
     vmap_table_offset_(vmap_table_offset),
-    native_gc_map_offset_(gc_map_offset) {
+    native_gc_map_offset_(gc_map_offset),
+    oat_file_(oat_file) {
 #ifndef NDEBUG
   if (mapping_table_offset_ != 0) {  // implies non-native, non-stub code
     if (vmap_table_offset_ == 0) {
@@ -453,6 +530,10 @@ OatFile::OatMethod::OatMethod(const byte* base,
 OatFile::OatMethod::~OatMethod() {}
 
 const void* OatFile::OatMethod::GetCode() const {
+  if (IsCodeCompressed()) {
+    CHECK(oat_file_ != NULL);
+    return oat_file_->InflateCode(code_offset_ & ~OatMethodOffsets::kCompressedCodeFlag);
+  }
   return GetOatPointer<const void*>(code_offset_);
 }
 
@@ -464,6 +545,11 @@ uint32_t OatFile::OatMethod::GetCodeSize() const {
   // store it somewhere, such as the OatMethod.
   return 0;
 #else
+  if (IsCodeCompressed()) {
+    // The size of the inflated code comes first, no need to inflate it.
+    return GetOatPointer<const uint32_t*>(code_offset_ &
+                                          ~OatMethodOffsets::kCompressedCodeFlag)[0];
+  }
   uintptr_t code = reinterpret_cast<uint32_t>(GetCode());
 
   if (code == 0) {
@@ -477,7 +563,8 @@ uint32_t OatFile::OatMethod::GetCodeSize() const {
 
 void OatFile::OatMethod::LinkMethod(mirror::ArtMethod* method) const {
   CHECK(method != NULL);
-  method->SetEntryPointFromCompiledCode(GetCode());
+  // Compressed code is left for the caller to point at the resolution trampoline.
+  method->SetEntryPointFromCompiledCode(IsCodeCompressed() ? NULL : GetCode());
   method->SetFrameSizeInBytes(frame_size_in_bytes_);
   method->SetCoreSpillMask(core_spill_mask_);
   method->SetFpSpillMask(fp_spill_mask_);
@@ -486,4 +573,57 @@ void OatFile::OatMethod::LinkMethod(mirror::ArtMethod* method) const {
   method->SetNativeGcMap(GetNativeGcMap());  // Used by native methods in work around JNI mode.
 }
 
+const void* OatFile::InflateCode(uint32_t offset) const {
+  MutexLock mu(Thread::Current(), inflated_code_lock_);
+  SafeMap<uint32_t, const void*>::const_iterator it = inflated_code_.find(offset);
+  if (it != inflated_code_.end()) {
+    return it->second;
+  }
+  const byte* compressed_code = Begin() + offset;
+  CHECK_LT(compressed_code, End()) << GetLocation();
+  const uint32_t code_size = reinterpret_cast<const uint32_t*>(compressed_code)[0];
+  const uint32_t compressed_size = reinterpret_cast<const uint32_t*>(compressed_code)[1];
+  compressed_code += 2 * sizeof(uint32_t);
+  CHECK_LE(compressed_code + compressed_size, End()) << GetLocation();
+
+  // Copies are laid out like code in the oat file, with their size right before them, and aligned
+  // for every instruction set.
+  const size_t kInflatedCodeAlignment = 16;
+  const size_t size = kInflatedCodeAlignment + RoundUp(code_size, kInflatedCodeAlignment);
+  byte* begin = inflated_code_top_;
+  if (inflated_code_maps_.empty() || begin + size > inflated_code_maps_.back()->End()) {
+    // Cold code is inflated a method at a time, a few pages at once keeps the number of maps down.
+    const size_t kInflatedCodeMapSize = 16 * kPageSize;
+    MemMap* map = MemMap::MapAnonymous("oat inflated code", NULL,
+                                       RoundUp(std::max(size, kInflatedCodeMapSize), kPageSize),
+                                       PROT_READ | PROT_WRITE | PROT_EXEC);
+    CHECK(map != NULL) << "Failed to map memory to inflate code of " << GetLocation();
+    inflated_code_maps_.push_back(map);
+    begin = map->Begin();
+  }
+  inflated_code_top_ = begin + size;
+  byte* code = begin + kInflatedCodeAlignment;
+  reinterpret_cast<uint32_t*>(code)[-1] = code_size;
+
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  CHECK_EQ(inflateInit2(&stream, -MAX_WBITS), Z_OK);
+  stream.next_in = const_cast<Bytef*>(compressed_code);
+  stream.avail_in = compressed_size;
+  stream.next_out = code;
+  stream.avail_out = code_size;
+  int result = inflate(&stream, Z_FINISH);
+  inflateEnd(&stream);
+  CHECK(result == Z_STREAM_END && stream.avail_out == 0)
+      << "Failed to inflate code at offset " << offset << " of " << GetLocation() << ": "
+      << result;
+  __builtin___clear_cache(reinterpret_cast<char*>(code), reinterpret_cast<char*>(code + code_size));
+
+  // Thumb2 code is entered with the low bit of its address set.
+  const void* entry_point =
+      code + ((GetOatHeader().GetInstructionSet() == kThumb2) ? 1 : 0);
+  inflated_code_.Put(offset, entry_point);
+  return entry_point;
+}
+
 }  // namespace art
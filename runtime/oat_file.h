@@ -20,12 +20,14 @@
 #include <string>
 #include <vector>
 
+#include "base/mutex.h"
 #include "dex_file.h"
 #include "invoke_type.h"
 #include "mem_map.h"
 #include "mirror/art_method.h"
 #include "oat.h"
 #include "os.h"
+#include "safe_map.h"
 
 namespace art {
 
@@ -47,6 +49,14 @@ class OatFile {
                        byte* requested_base,
                        bool executable);
 
+  // Open an oat file linked at requested_base, loading it load_bias bytes away. The caller is
+  // responsible for patching the absolute addresses in the loaded code. Returns NULL on failure.
+  static OatFile* OpenRelocated(const std::string& filename,
+                                const std::string& location,
+                                byte* requested_base,
+                                ptrdiff_t load_bias,
+                                bool executable);
+
   // Open an oat file from an already opened File.
   // Does not use dlopen underneath so cannot be used for runtime use
   // where relocations may be required. Currently used from
@@ -94,6 +104,12 @@ class OatFile {
       return native_gc_map_offset_;
     }
 
+    // Is the code stored deflated? GetCode inflates it, once per oat file, so callers that only
+    // link the method leave it to the resolution trampoline to do on the method's first call.
+    bool IsCodeCompressed() const {
+      return (code_offset_ & OatMethodOffsets::kCompressedCodeFlag) != 0;
+    }
+
     const void* GetCode() const;
     uint32_t GetCodeSize() const;
 
@@ -117,7 +133,8 @@ class OatFile {
               const uint32_t fp_spill_mask,
               const uint32_t mapping_table_offset,
               const uint32_t vmap_table_offset,
-              const uint32_t gc_map_offset);
+              const uint32_t gc_map_offset,
+              const OatFile* oat_file = NULL);
 
    private:
     template<class T>
@@ -138,6 +155,9 @@ class OatFile {
     uint32_t vmap_table_offset_;
     uint32_t native_gc_map_offset_;
 
+    // The oat file that inflates compressed code, NULL for methods made up by tests.
+    const OatFile* oat_file_;
+
     friend class OatClass;
   };
 
@@ -150,15 +170,30 @@ class OatFile {
     // methods. note that runtime created methods such as miranda
     // methods are not included.
     const OatMethod GetOatMethod(uint32_t method_index) const;
+
+    // Type indices which were unresolved when the class soft failed compile time verification,
+    // only recorded if those were its only failures. None for classes without a record.
+    size_t NumVerificationDependencies() const {
+      return num_verification_dependencies_;
+    }
+    uint16_t GetVerificationDependency(size_t i) const {
+      DCHECK_LT(i, num_verification_dependencies_);
+      return verification_dependencies_pointer_[i];
+    }
+
     ~OatClass();
 
    private:
     OatClass(const OatFile* oat_file,
              mirror::Class::Status status,
+             uint32_t num_verification_dependencies,
+             const uint16_t* verification_dependencies_pointer,
              const OatMethodOffsets* methods_pointer);
 
     const OatFile* oat_file_;
     const mirror::Class::Status status_;
+    const uint32_t num_verification_dependencies_;
+    const uint16_t* verification_dependencies_pointer_;
     const OatMethodOffsets* methods_pointer_;
 
     friend class OatDexFile;
@@ -185,6 +220,12 @@ class OatFile {
     // Returns the OatClass for the class specified by the given DexFile class_def_index.
     const OatClass* GetOatClass(uint16_t class_def_index) const;
 
+    // Returns the persisted descriptor to class def index table, in the layout of
+    // DexFile::BuildClassDefIndex. Dex files opened with OpenDexFile already use it.
+    const uint32_t* GetClassDefIndex() const {
+      return class_def_index_pointer_;
+    }
+
     ~OatDexFile();
 
    private:
@@ -192,13 +233,15 @@ class OatFile {
                const std::string& dex_file_location,
                uint32_t dex_file_checksum,
                const byte* dex_file_pointer,
-               const uint32_t* oat_class_offsets_pointer);
+               const uint32_t* oat_class_offsets_pointer,
+               const uint32_t* class_def_index_pointer);
 
     const OatFile* oat_file_;
     std::string dex_file_location_;
     uint32_t dex_file_location_checksum_;
     const byte* dex_file_pointer_;
     const uint32_t* oat_class_offsets_pointer_;
+    const uint32_t* class_def_index_pointer_;
 
     friend class OatFile;
     DISALLOW_COPY_AND_ASSIGN(OatDexFile);
@@ -224,17 +267,22 @@ class OatFile {
   static OatFile* OpenElfFile(File* file,
                               const std::string& location,
                               byte* requested_base,
+                              ptrdiff_t load_bias,
                               bool writable,
                               bool executable);
 
   explicit OatFile(const std::string& filename);
   bool Dlopen(const std::string& elf_filename, byte* requested_base);
-  bool ElfFileOpen(File* file, byte* requested_base, bool writable, bool executable);
+  bool ElfFileOpen(File* file, byte* requested_base, ptrdiff_t load_bias, bool writable,
+                   bool executable);
   bool Setup();
 
   const byte* Begin() const;
   const byte* End() const;
 
+  // Returns the executable copy of the compressed code at offset, inflating it on first use.
+  const void* InflateCode(uint32_t offset) const LOCKS_EXCLUDED(inflated_code_lock_);
+
   // The oat file name.
   //
   // The image will embed this to link its associated oat file.
@@ -258,6 +306,15 @@ class OatFile {
   typedef SafeMap<std::string, const OatDexFile*> Table;
   Table oat_dex_files_;
 
+  // Inflated copies of compressed code by the offset of the compressed code, so that methods
+  // sharing code share the copy. Copies are never freed while the oat file is open, a thread
+  // may be running them.
+  mutable Mutex inflated_code_lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
+  mutable SafeMap<uint32_t, const void*> inflated_code_ GUARDED_BY(inflated_code_lock_);
+  // Executable memory holding the copies, allocated from the bottom up in the last map.
+  mutable std::vector<MemMap*> inflated_code_maps_ GUARDED_BY(inflated_code_lock_);
+  mutable byte* inflated_code_top_ GUARDED_BY(inflated_code_lock_);
+
   friend class OatClass;
   friend class OatDexFile;
   friend class OatDumper;  // For GetBase and GetLimit
@@ -30,8 +30,7 @@ namespace mirror {
 class Object;
 }  // namespace mirror
 
-// Maintain a table of references.  Used for JNI monitor references and
-// JNI pinned array references.
+// Maintain a table of references.  Used for JNI monitor references.
 //
 // None of the functions are synchronized.
 class ReferenceTable {
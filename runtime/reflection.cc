@@ -33,10 +33,64 @@
 
 namespace art {
 
+mirror::ArtMethod* DecodeReflectedMethod(const ScopedObjectAccess& soa, jobject java_method) {
+  mirror::ArtField* f =
+      soa.DecodeField(WellKnownClasses::java_lang_reflect_AbstractMethod_artMethod);
+  mirror::ArtMethod* m = f->GetObject(soa.Decode<mirror::Object*>(java_method))->AsArtMethod();
+  DCHECK(m != NULL);
+  return m;
+}
+
+mirror::ArtField* DecodeReflectedField(const ScopedObjectAccess& soa, jobject java_field) {
+  mirror::ArtField* f = soa.DecodeField(WellKnownClasses::java_lang_reflect_Field_artField);
+  mirror::ArtField* field = f->GetObject(soa.Decode<mirror::Object*>(java_field))->AsArtField();
+  DCHECK(field != NULL);
+  return field;
+}
+
+// Unboxes the reflective arguments straight into the array the method is invoked with, checking
+// them against the method's parameter types.
+static bool BuildArgArrayFromObjectArray(mirror::Object* receiver,
+                                         mirror::ObjectArray<mirror::Object>* args,
+                                         MethodHelper& mh, ArgArray* arg_array)
+    SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
+  const DexFile::TypeList* classes = mh.GetParameterTypeList();
+  uint32_t classes_size = classes == NULL ? 0 : classes->Size();
+  uint32_t arg_count = (args != NULL) ? args->GetLength() : 0;
+  if (arg_count != classes_size) {
+    ThrowIllegalArgumentException(NULL,
+                                  StringPrintf("Wrong number of arguments; expected %d, got %d",
+                                               classes_size, arg_count).c_str());
+    return false;
+  }
+  if (receiver != NULL) {
+    arg_array->Append(reinterpret_cast<int32_t>(receiver));
+  }
+  const char* shorty = mh.GetShorty();
+  for (uint32_t i = 0; i < arg_count; ++i) {
+    mirror::Object* arg = args->Get(i);
+    mirror::Class* dst_class = mh.GetClassFromTypeIdx(classes->GetTypeItem(i).type_idx_);
+    if (shorty[i + 1] == 'L' && (arg == NULL || arg->InstanceOf(dst_class))) {
+      // The common case for references needs no unboxing.
+      arg_array->Append(reinterpret_cast<int32_t>(arg));
+      continue;
+    }
+    JValue value;
+    if (!UnboxPrimitiveForArgument(arg, dst_class, value, mh.GetMethod(), i)) {
+      return false;
+    }
+    if (shorty[i + 1] == 'J' || shorty[i + 1] == 'D') {
+      arg_array->AppendWide(value.GetJ());
+    } else {
+      arg_array->Append(value.GetI());
+    }
+  }
+  return true;
+}
+
 jobject InvokeMethod(const ScopedObjectAccess& soa, jobject javaMethod, jobject javaReceiver,
                      jobject javaArgs) {
-  jmethodID mid = soa.Env()->FromReflectedMethod(javaMethod);
-  mirror::ArtMethod* m = soa.DecodeMethod(mid);
+  mirror::ArtMethod* m = DecodeReflectedMethod(soa, javaMethod);
 
   mirror::Class* declaring_class = m->GetDeclaringClass();
   if (!Runtime::Current()->GetClassLinker()->EnsureInitialized(declaring_class, true, true)) {
@@ -53,39 +107,20 @@ jobject InvokeMethod(const ScopedObjectAccess& soa, jobject javaMethod, jobject
 
     // Find the actual implementation of the virtual method.
     m = receiver->GetClass()->FindVirtualMethodForVirtualOrInterface(m);
-    mid = soa.EncodeMethod(m);
   }
 
-  // Get our arrays of arguments and their types, and check they're the same size.
-  mirror::ObjectArray<mirror::Object>* objects =
-      soa.Decode<mirror::ObjectArray<mirror::Object>*>(javaArgs);
+  // Translate javaArgs to the array of arguments the method is invoked with.
   MethodHelper mh(m);
-  const DexFile::TypeList* classes = mh.GetParameterTypeList();
-  uint32_t classes_size = classes == NULL ? 0 : classes->Size();
-  uint32_t arg_count = (objects != NULL) ? objects->GetLength() : 0;
-  if (arg_count != classes_size) {
-    ThrowIllegalArgumentException(NULL,
-                                  StringPrintf("Wrong number of arguments; expected %d, got %d",
-                                               classes_size, arg_count).c_str());
+  ArgArray arg_array(mh.GetShorty(), mh.GetShortyLength());
+  if (!BuildArgArrayFromObjectArray(receiver,
+                                    soa.Decode<mirror::ObjectArray<mirror::Object>*>(javaArgs),
+                                    mh, &arg_array)) {
     return NULL;
   }
 
-  // Translate javaArgs to a jvalue[].
-  UniquePtr<jvalue[]> args(new jvalue[arg_count]);
-  JValue* decoded_args = reinterpret_cast<JValue*>(args.get());
-  for (uint32_t i = 0; i < arg_count; ++i) {
-    mirror::Object* arg = objects->Get(i);
-    mirror::Class* dst_class = mh.GetClassFromTypeIdx(classes->GetTypeItem(i).type_idx_);
-    if (!UnboxPrimitiveForArgument(arg, dst_class, decoded_args[i], m, i)) {
-      return NULL;
-    }
-    if (!dst_class->IsPrimitive()) {
-      args[i].l = soa.AddLocalReference<jobject>(arg);
-    }
-  }
-
   // Invoke the method.
-  JValue value(InvokeWithJValues(soa, javaReceiver, mid, args.get()));
+  JValue value;
+  InvokeWithArgArray(soa, m, &arg_array, &value, mh.GetShorty()[0]);
 
   // Wrap any exception with "Ljava/lang/reflect/InvocationTargetException;" and return early.
   if (soa.Self()->IsExceptionPending()) {
@@ -323,7 +358,8 @@ static bool UnboxPrimitive(const ThrowLocation* throw_location, mirror::Object*
   }
 
   JValue boxed_value;
-  std::string src_descriptor(ClassHelper(o->GetClass()).GetDescriptor());
+  ClassHelper kh(o->GetClass());
+  StringPiece src_descriptor(kh.GetDescriptor());
   mirror::Class* src_class = NULL;
   ClassLinker* class_linker = Runtime::Current()->GetClassLinker();
   mirror::ArtField* primitive_field = o->GetClass()->GetIFields()->Get(0);
@@ -352,11 +388,12 @@ static bool UnboxPrimitive(const ThrowLocation* throw_location, mirror::Object*
     src_class = class_linker->FindPrimitiveClass('S');
     boxed_value.SetS(primitive_field->GetShort(o));
   } else {
+    std::string src_class_name(PrettyDescriptor(kh.GetDescriptor()));
     ThrowIllegalArgumentException(throw_location,
                                   StringPrintf("%s has type %s, got %s",
                                                UnboxingFailureKind(m, index, f).c_str(),
                                                PrettyDescriptor(dst_class).c_str(),
-                                               PrettyDescriptor(src_descriptor.c_str()).c_str()).c_str());
+                                               src_class_name.c_str()).c_str());
     return false;
   }
 
@@ -51,6 +51,13 @@ bool ConvertPrimitiveValue(const ThrowLocation* throw_location, bool unbox_for_r
 jobject InvokeMethod(const ScopedObjectAccess& soa, jobject method, jobject receiver, jobject args)
     SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
 
+// Return the ArtMethod of a java.lang.reflect.AbstractMethod and the ArtField of a
+// java.lang.reflect.Field, reading the field directly rather than through JNI.
+mirror::ArtMethod* DecodeReflectedMethod(const ScopedObjectAccess& soa, jobject java_method)
+    SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+mirror::ArtField* DecodeReflectedField(const ScopedObjectAccess& soa, jobject java_field)
+    SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
 bool VerifyObjectInClass(mirror::Object* o, mirror::Class* c)
     SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
 
@@ -26,6 +26,7 @@
 #include <cstdio>
 #include <cstdlib>
 #include <limits>
+#include <sstream>
 #include <vector>
 
 #include "arch/arm/registers_arm.h"
@@ -34,14 +35,21 @@
 #include "atomic.h"
 #include "class_linker.h"
 #include "debugger.h"
+#include "fault_handler.h"
 #include "gc/accounting/card_table-inl.h"
 #include "gc/heap.h"
+#include "gc/space/image_space.h"
 #include "gc/space/space.h"
+#include "hot_method_compiler.h"
 #include "image.h"
 #include "instrumentation.h"
 #include "intern_table.h"
+#include "interpreter/decoded_code.h"
 #include "invoke_arg_array_builder.h"
 #include "jni_internal.h"
+#include "method_profile.h"
+#include "mem_map.h"
+#include "numa.h"
 #include "mirror/art_field-inl.h"
 #include "mirror/art_method-inl.h"
 #include "mirror/array.h"
@@ -50,11 +58,14 @@
 #include "mirror/throwable.h"
 #include "monitor.h"
 #include "oat_file.h"
+#include "os.h"
 #include "ScopedLocalRef.h"
 #include "scoped_thread_state_change.h"
 #include "signal_catcher.h"
 #include "signal_set.h"
 #include "sirt_ref.h"
+#include "startup_page_profile.h"
+#include "startup_timeline.h"
 #include "thread.h"
 #include "thread_list.h"
 #include "trace.h"
@@ -96,6 +107,15 @@ Runtime::Runtime()
       method_trace_(0),
       method_trace_file_size_(0),
       instrumentation_(),
+      method_profile_(NULL),
+      hot_method_threshold_(0),
+      hot_method_code_cache_size_(0),
+      hot_method_compiler_(NULL),
+      startup_page_profile_(NULL),
+      startup_timeline_(NULL),
+      log_startup_timeline_(false),
+      decoded_code_cache_(NULL),
+      max_stack_trace_depth_(0),
       use_compile_time_class_path_(false),
       main_thread_group_(NULL),
       system_thread_group_(NULL),
@@ -124,9 +144,19 @@ Runtime::~Runtime() {
   // Make sure our internal threads are dead before we start tearing down things they're using.
   Dbg::StopJdwp();
   delete signal_catcher_;
+  delete hot_method_compiler_;
+  delete startup_page_profile_;
 
   // Make sure all other non-daemon threads have terminated, and all daemon threads are suspended.
   delete thread_list_;
+  if (method_profile_ != NULL) {
+    if (!method_profile_file_.empty()) {
+      method_profile_->WriteToFile(method_profile_file_);
+    }
+    delete method_profile_;
+  }
+  delete decoded_code_cache_;
+  delete startup_timeline_;
   delete monitor_list_;
   delete class_linker_;
   delete heap_;
@@ -228,6 +258,10 @@ void Runtime::Abort() {
 
 bool Runtime::PreZygoteFork() {
   heap_->PreZygoteFork();
+  // The zygote must fork with a single thread.
+  if (startup_page_profile_ != NULL) {
+    startup_page_profile_->Stop();
+  }
   return true;
 }
 
@@ -329,21 +363,33 @@ Runtime::ParsedOptions* Runtime::ParsedOptions::Create(const Options& options, b
   if (class_path_string != NULL) {
     parsed->class_path_string_ = class_path_string;
   }
+  parsed->image_relocation_delta_ = 0;
   // -Xcheck:jni is off by default for regular builds but on by default in debug builds.
   parsed->check_jni_ = kIsDebugBuild;
+  parsed->check_jni_rate_ = 1;
 
   parsed->heap_initial_size_ = gc::Heap::kDefaultInitialSize;
   parsed->heap_maximum_size_ = gc::Heap::kDefaultMaximumSize;
   parsed->heap_min_free_ = gc::Heap::kDefaultMinFree;
   parsed->heap_max_free_ = gc::Heap::kDefaultMaxFree;
   parsed->heap_target_utilization_ = gc::Heap::kDefaultTargetUtilization;
+  parsed->heap_target_gc_cpu_fraction_ = 0.0;  // 0 means the fixed target utilization.
+  parsed->heap_pause_budget_ms_ = 0;  // 0 means no pause budget.
+  parsed->soft_ref_lru_policy_ms_per_mb_ = gc::Heap::kDefaultSoftReferenceMsPerMb;
   parsed->heap_growth_limit_ = 0;  // 0 means no growth limit.
   // Default to number of processors minus one since the main GC thread also does work.
+  // The heap verifiers, when enabled, check every card.
+  parsed->heap_verification_sampling_ = 1;
   parsed->parallel_gc_threads_ = sysconf(_SC_NPROCESSORS_CONF) - 1;
   // Only the main GC thread, no workers.
   parsed->conc_gc_threads_ = 0;
+  // Cleared references are enqueued on the GC thread.
+  parsed->reference_enqueue_threads_ = 0;
   parsed->stack_size_ = 0;  // 0 means default.
   parsed->low_memory_mode_ = false;
+  parsed->use_run_alloc_space_ = false;
+  parsed->use_huge_pages_ = false;
+  parsed->use_numa_ = false;
 
   parsed->is_compiler_ = false;
   parsed->is_zygote_ = false;
@@ -354,8 +400,12 @@ Runtime::ParsedOptions* Runtime::ParsedOptions::Create(const Options& options, b
   parsed->long_pause_log_threshold_ = gc::Heap::kDefaultLongPauseLogThreshold;
   parsed->long_gc_log_threshold_ = gc::Heap::kDefaultLongGCLogThreshold;
   parsed->ignore_max_footprint_ = false;
+  parsed->dump_gc_performance_on_shutdown_ = false;
+  parsed->log_startup_timeline_ = false;
+  parsed->track_zygote_dirty_pages_ = false;
 
   parsed->lock_profiling_threshold_ = 0;
+  parsed->use_biased_locking_ = false;
   parsed->hook_is_sensitive_thread_ = NULL;
 
   parsed->hook_vfprintf_ = vfprintf;
@@ -386,6 +436,12 @@ Runtime::ParsedOptions* Runtime::ParsedOptions::Create(const Options& options, b
   parsed->method_trace_file_ = "/data/method-trace-file.bin";
   parsed->method_trace_file_size_ = 10 * MB;
 
+  parsed->hot_method_threshold_ = 0;
+  parsed->hot_method_code_cache_size_ = 2 * MB;
+  parsed->interpreter_decode_threshold_ = 0;
+
+  parsed->max_stack_trace_depth_ = 0;
+
   for (size_t i = 0; i < options.size(); ++i) {
     const std::string option(options[i].first);
     if (true && options[0].first == "-Xzygote") {
@@ -410,6 +466,10 @@ Runtime::ParsedOptions* Runtime::ParsedOptions::Create(const Options& options, b
       parsed->image_ = option.substr(strlen("-Ximage:")).data();
     } else if (StartsWith(option, "-Xcheck:jni")) {
       parsed->check_jni_ = true;
+    } else if (StartsWith(option, "-Xjnicheckrate:")) {
+      // Implies -Xcheck:jni, cheap enough to leave on where apps run for real.
+      parsed->check_jni_ = true;
+      parsed->check_jni_rate_ = ParseIntegerOrDie(option);
     } else if (StartsWith(option, "-Xrunjdwp:") || StartsWith(option, "-agentlib:jdwp=")) {
       std::string tail(option.substr(option[1] == 'X' ? 10 : 15));
       if (tail == "help" || !Dbg::ParseJdwpOptions(tail)) {
@@ -486,12 +546,76 @@ Runtime::ParsedOptions* Runtime::ParsedOptions::Create(const Options& options, b
         return NULL;
       }
       parsed->heap_target_utilization_ = value;
+    } else if (StartsWith(option, "-XX:HeapTargetGcCpuFraction=")) {
+      std::istringstream iss(option.substr(strlen("-XX:HeapTargetGcCpuFraction=")));
+      double value;
+      iss >> value;
+      const bool sane_val = iss.eof() && (value >= 0.0) && (value <= 0.5);
+      if (!sane_val) {
+        if (ignore_unrecognized) {
+          continue;
+        }
+        LOG(FATAL) << "Invalid option '" << option << "'";
+        return NULL;
+      }
+      parsed->heap_target_gc_cpu_fraction_ = value;
+    } else if (StartsWith(option, "-XX:HeapPauseBudget=")) {
+      std::istringstream iss(option.substr(strlen("-XX:HeapPauseBudget=")));
+      size_t value;
+      iss >> value;
+      if (iss.fail() || !iss.eof()) {
+        if (ignore_unrecognized) {
+          continue;
+        }
+        LOG(FATAL) << "Invalid option '" << option << "'";
+        return NULL;
+      }
+      parsed->heap_pause_budget_ms_ = value;
+    } else if (StartsWith(option, "-XX:SoftRefLRUPolicyMSPerMB=")) {
+      std::istringstream iss(option.substr(strlen("-XX:SoftRefLRUPolicyMSPerMB=")));
+      size_t value;
+      iss >> value;
+      if (iss.fail() || !iss.eof()) {
+        if (ignore_unrecognized) {
+          continue;
+        }
+        LOG(FATAL) << "Invalid option '" << option << "'";
+        return NULL;
+      }
+      parsed->soft_ref_lru_policy_ms_per_mb_ = value;
+    } else if (StartsWith(option, "-XX:HeapVerificationSampling=")) {
+      parsed->heap_verification_sampling_ = ParseMemoryOption(
+          option.substr(strlen("-XX:HeapVerificationSampling=")).c_str(), 1024);
     } else if (StartsWith(option, "-XX:ParallelGCThreads=")) {
       parsed->parallel_gc_threads_ =
           ParseMemoryOption(option.substr(strlen("-XX:ParallelGCThreads=")).c_str(), 1024);
     } else if (StartsWith(option, "-XX:ConcGCThreads=")) {
       parsed->conc_gc_threads_ =
           ParseMemoryOption(option.substr(strlen("-XX:ConcGCThreads=")).c_str(), 1024);
+    } else if (StartsWith(option, "-XX:ReferenceEnqueueThreads=")) {
+      parsed->reference_enqueue_threads_ = ParseMemoryOption(
+          option.substr(strlen("-XX:ReferenceEnqueueThreads=")).c_str(), 1024);
+    } else if (StartsWith(option, "-XX:GcThreadCpus=")) {
+      // A comma separated list of CPUs, e.g. the big cores of a big.LITTLE system.
+      std::vector<std::string> cpus;
+      Split(option.substr(strlen("-XX:GcThreadCpus=")), ',', cpus);
+      parsed->gc_thread_cpus_.clear();
+      for (size_t i = 0; i < cpus.size(); ++i) {
+        char* end;
+        long cpu = strtol(cpus[i].c_str(), &end, 10);  // NOLINT(runtime/int)
+        if (*end != '\0' || cpu < 0) {
+          parsed->gc_thread_cpus_.clear();
+          break;
+        }
+        parsed->gc_thread_cpus_.push_back(cpu);
+      }
+      if (parsed->gc_thread_cpus_.empty()) {
+        if (ignore_unrecognized) {
+          continue;
+        }
+        LOG(FATAL) << "Failed to parse " << option;
+        return NULL;
+      }
     } else if (StartsWith(option, "-Xss")) {
       size_t size = ParseMemoryOption(option.substr(strlen("-Xss")).c_str(), 1);
       if (size == 0) {
@@ -511,8 +635,32 @@ Runtime::ParsedOptions* Runtime::ParsedOptions::Create(const Options& options, b
               ParseMemoryOption(option.substr(strlen("-XX:LongGCLogThreshold")).c_str(), 1024);
     } else if (option == "-XX:IgnoreMaxFootprint") {
       parsed->ignore_max_footprint_ = true;
+    } else if (option == "-XX:DumpGCPerformanceOnShutdown") {
+      parsed->dump_gc_performance_on_shutdown_ = true;
+    } else if (option == "-XX:TrackZygoteDirtyPages") {
+      parsed->track_zygote_dirty_pages_ = true;
     } else if (option == "-XX:LowMemoryMode") {
       parsed->low_memory_mode_ = true;
+    } else if (option == "-XX:UseRunAllocSpace") {
+      parsed->use_run_alloc_space_ = true;
+    } else if (option == "-XX:UseHugePages") {
+      parsed->use_huge_pages_ = true;
+    } else if (option == "-XX:UseNuma") {
+      parsed->use_numa_ = true;
+    } else if (option == "-XX:HprofCompress") {
+      parsed->hprof_options_.compress = true;
+    } else if (option == "-XX:HprofDedupArrays") {
+      parsed->hprof_options_.dedup_primitive_arrays = true;
+    } else if (StartsWith(option, "-XX:HprofMaxArrayBytes=")) {
+      size_t size = ParseMemoryOption(option.substr(strlen("-XX:HprofMaxArrayBytes=")).c_str(), 1);
+      if (size == 0) {
+        if (ignore_unrecognized) {
+          continue;
+        }
+        LOG(FATAL) << "Failed to parse " << option;
+        return NULL;
+      }
+      parsed->hprof_options_.max_primitive_array_bytes = size;
     } else if (StartsWith(option, "-D")) {
       parsed->properties_.push_back(option.substr(strlen("-D")));
     } else if (StartsWith(option, "-Xjnitrace:")) {
@@ -571,6 +719,8 @@ Runtime::ParsedOptions* Runtime::ParsedOptions::Create(const Options& options, b
       // Silently ignored for backwards compatibility.
     } else if (StartsWith(option, "-Xlockprofthreshold:")) {
       parsed->lock_profiling_threshold_ = ParseIntegerOrDie(option);
+    } else if (option == "-XX:UseBiasedLocking") {
+      parsed->use_biased_locking_ = true;
     } else if (StartsWith(option, "-Xstacktracefile:")) {
       parsed->stack_trace_file_ = option.substr(strlen("-Xstacktracefile:"));
     } else if (option == "sensitiveThread") {
@@ -592,6 +742,46 @@ Runtime::ParsedOptions* Runtime::ParsedOptions::Create(const Options& options, b
       parsed->method_trace_file_ = option.substr(strlen("-Xmethod-trace-file:"));
     } else if (StartsWith(option, "-Xmethod-trace-file-size:")) {
       parsed->method_trace_file_size_ = ParseIntegerOrDie(option);
+    } else if (StartsWith(option, "-Xmethod-trace-filter:")) {
+      Trace::SetDefaultMethodFilter(option.substr(strlen("-Xmethod-trace-filter:")));
+    } else if (StartsWith(option, "-Xmethod-trace-min-duration:")) {
+      Trace::SetDefaultMinDuration(ParseIntegerOrDie(option));
+    } else if (StartsWith(option, "-Xmethod-profile-file:")) {
+      parsed->method_profile_file_ = option.substr(strlen("-Xmethod-profile-file:"));
+    } else if (option == "-Xstartup-timeline") {
+      parsed->log_startup_timeline_ = true;
+    } else if (StartsWith(option, "-Xstartup-page-profile:")) {
+      parsed->startup_page_profile_file_ = option.substr(strlen("-Xstartup-page-profile:"));
+    } else if (StartsWith(option, "-Ximage-relocation-delta:")) {
+      // A page aligned number of bytes, possibly negative, to move the boot image by.
+      const char* begin = option.c_str() + strlen("-Ximage-relocation-delta:");
+      char* end;
+      long delta = strtol(begin, &end, 0);  // NOLINT(runtime/int)
+      if (begin == end || *end != '\0' || !IsAligned<kPageSize>(delta)) {
+        if (ignore_unrecognized) {
+          continue;
+        }
+        LOG(FATAL) << "Failed to parse " << option;
+        return NULL;
+      }
+      parsed->image_relocation_delta_ = delta;
+    } else if (StartsWith(option, "-Xhot-method-threshold:")) {
+      parsed->hot_method_threshold_ = ParseIntegerOrDie(option);
+    } else if (StartsWith(option, "-Xinterpreter-decode-threshold:")) {
+      parsed->interpreter_decode_threshold_ = ParseIntegerOrDie(option);
+    } else if (StartsWith(option, "-Xstack-trace-depth:")) {
+      parsed->max_stack_trace_depth_ = ParseIntegerOrDie(option);
+    } else if (StartsWith(option, "-Xhot-method-code-cache-size:")) {
+      size_t size =
+          ParseMemoryOption(option.substr(strlen("-Xhot-method-code-cache-size:")).c_str(), 1024);
+      if (size == 0) {
+        if (ignore_unrecognized) {
+          continue;
+        }
+        LOG(FATAL) << "Failed to parse " << option;
+        return NULL;
+      }
+      parsed->hot_method_code_cache_size_ = size;
     } else if (option == "-Xprofile:threadcpuclock") {
       Trace::SetDefaultClockSource(kProfilerClockSourceThreadCpu);
     } else if (option == "-Xprofile:wallclock") {
@@ -721,24 +911,37 @@ bool Runtime::Start() {
   InitNativeMethods();
 
   // Initialize well known thread group values that may be accessed threads while attaching.
+  startup_timeline_->StartPhase("InitThreadGroups");
   InitThreadGroups(self);
 
   Thread::FinishStartup();
 
   if (is_zygote_) {
+    startup_timeline_->StartPhase("InitZygote");
     if (!InitZygote()) {
+      startup_timeline_->EndPhase();
       return false;
     }
   } else {
+    startup_timeline_->StartPhase("DidForkFromZygote");
     DidForkFromZygote();
   }
 
+  startup_timeline_->StartPhase("StartDaemonThreads");
   StartDaemonThreads();
 
+  startup_timeline_->StartPhase("CreateSystemClassLoader");
   system_class_loader_ = CreateSystemClassLoader();
 
   self->GetJniEnv()->locals.AssertEmpty();
 
+  startup_timeline_->EndPhase();
+  if (log_startup_timeline_ || VLOG_IS_ON(startup)) {
+    std::ostringstream os;
+    startup_timeline_->Dump(os);
+    LOG(INFO) << os.str();
+  }
+
   VLOG(startup) << "Runtime::Start exiting";
 
   finished_starting_ = true;
@@ -793,9 +996,20 @@ void Runtime::DidForkFromZygote() {
 
   // Create the thread pool.
   heap_->CreateThreadPool();
+  if (heap_->GetThreadPool() != NULL && !gc_thread_cpus_.empty()) {
+    heap_->GetThreadPool()->SetWorkerCpus(gc_thread_cpus_);
+  } else if (heap_->GetThreadPool() != NULL && heap_->IsNumaEnabled()) {
+    heap_->GetThreadPool()->SetWorkerNumaNodes();
+  }
 
   StartSignalCatcher();
 
+  // Started after the fork so that every application compiles its own hot methods.
+  if (hot_method_threshold_ != 0) {
+    hot_method_compiler_ = HotMethodCompiler::Create(hot_method_threshold_,
+                                                     hot_method_code_cache_size_);
+  }
+
   // Start the JDWP thread. If the command-line debugger flags specified "suspend=y",
   // this will pause the runtime, so we probably want this to come last.
   Dbg::StartJdwp();
@@ -829,16 +1043,20 @@ void Runtime::StartDaemonThreads() {
 bool Runtime::Init(const Options& raw_options, bool ignore_unrecognized) {
   CHECK_EQ(sysconf(_SC_PAGE_SIZE), kPageSize);
 
+  startup_timeline_ = new StartupTimeline;
+  startup_timeline_->StartPhase("ParseOptions");
   UniquePtr<ParsedOptions> options(ParsedOptions::Create(raw_options, ignore_unrecognized));
   if (options.get() == NULL) {
     LOG(ERROR) << "Failed to parse options";
     return false;
   }
   VLOG(startup) << "Runtime::Init -verbose:startup enabled";
+  log_startup_timeline_ = options->log_startup_timeline_;
 
   QuasiAtomic::Startup();
 
-  Monitor::Init(options->lock_profiling_threshold_, options->hook_is_sensitive_thread_);
+  Monitor::Init(options->lock_profiling_threshold_, options->use_biased_locking_,
+                options->hook_is_sensitive_thread_);
 
   host_prefix_ = options->host_prefix_;
   boot_class_path_string_ = options->boot_class_path_string_;
@@ -846,6 +1064,11 @@ bool Runtime::Init(const Options& raw_options, bool ignore_unrecognized) {
   properties_ = options->properties_;
 
   is_compiler_ = options->is_compiler_;
+  // dex2oat compiles everything it wants ahead of time.
+  hot_method_threshold_ = is_compiler_ ? 0 : options->hot_method_threshold_;
+  hot_method_code_cache_size_ = options->hot_method_code_cache_size_;
+  max_stack_trace_depth_ = options->max_stack_trace_depth_;
+  gc_thread_cpus_ = options->gc_thread_cpus_;
   is_zygote_ = options->is_zygote_;
   is_concurrent_gc_enabled_ = options->is_concurrent_gc_enabled_;
   is_explicit_gc_disabled_ = options->is_explicit_gc_disabled_;
@@ -864,6 +1087,7 @@ bool Runtime::Init(const Options& raw_options, bool ignore_unrecognized) {
 
   default_stack_size_ = options->stack_size_;
   stack_trace_file_ = options->stack_trace_file_;
+  hprof_options_ = options->hprof_options_;
 
   monitor_list_ = new MonitorList;
   thread_list_ = new ThreadList;
@@ -874,6 +1098,9 @@ bool Runtime::Init(const Options& raw_options, bool ignore_unrecognized) {
     GetInstrumentation()->ForceInterpretOnly();
   }
 
+  MemMap::SetUseHugePages(options->use_huge_pages_);
+  // Maps the boot image and oat file.
+  startup_timeline_->StartPhase("CreateHeap");
   heap_ = new gc::Heap(options->heap_initial_size_,
                        options->heap_growth_limit_,
                        options->heap_min_free_,
@@ -881,16 +1108,39 @@ bool Runtime::Init(const Options& raw_options, bool ignore_unrecognized) {
                        options->heap_target_utilization_,
                        options->heap_maximum_size_,
                        options->image_,
+                       options->image_relocation_delta_,
                        options->is_concurrent_gc_enabled_,
                        options->parallel_gc_threads_,
                        options->conc_gc_threads_,
                        options->low_memory_mode_,
                        options->long_pause_log_threshold_,
                        options->long_gc_log_threshold_,
-                       options->ignore_max_footprint_);
+                       options->ignore_max_footprint_,
+                       options->use_run_alloc_space_,
+                       options->dump_gc_performance_on_shutdown_,
+                       options->track_zygote_dirty_pages_);
+  heap_->SetTargetGcCpuFraction(options->heap_target_gc_cpu_fraction_);
+  if (options->heap_pause_budget_ms_ != 0) {
+    heap_->SetPauseBudget(MsToNs(options->heap_pause_budget_ms_));
+  }
+  heap_->SetSoftReferenceMsPerMb(options->soft_ref_lru_policy_ms_per_mb_);
+  heap_->SetReferenceEnqueueThreads(options->reference_enqueue_threads_);
+  heap_->SetVerificationSampling(options->heap_verification_sampling_);
+  if (!options->startup_page_profile_file_.empty() && !is_compiler_ &&
+      heap_->GetImageSpace() != NULL) {
+    // Started as soon as the boot image is mapped so that its reads overlap the rest of startup.
+    startup_page_profile_ = StartupPageProfile::Start(options->startup_page_profile_file_,
+                                                      heap_->GetImageSpace()->GetImageHeader());
+  }
+  if (options->use_numa_) {
+    Numa::Init();
+    heap_->EnableNuma();
+  }
 
+  startup_timeline_->StartPhase("AttachMainThread");
   BlockSignals();
   InitPlatformSignalHandlers();
+  FaultManager::Init();
 
   java_vm_ = new JavaVMExt(this, options.get());
 
@@ -909,6 +1159,7 @@ bool Runtime::Init(const Options& raw_options, bool ignore_unrecognized) {
   // Now we're attached, we can take the heap locks and validate the heap.
   GetHeap()->EnableObjectValidation();
 
+  startup_timeline_->StartPhase("CreateClassLinker");
   CHECK_GE(GetHeap()->GetContinuousSpaces().size(), 1U);
   if (GetHeap()->GetContinuousSpaces()[0]->IsImageSpace()) {
     class_linker_ = ClassLinker::CreateFromImage(intern_table_);
@@ -929,12 +1180,33 @@ bool Runtime::Init(const Options& raw_options, bool ignore_unrecognized) {
                  false, false, 0);
   }
 
+  if (!options->method_profile_file_.empty()) {
+    method_profile_file_ = options->method_profile_file_;
+    method_profile_ = new MethodProfile;
+    // Keep accumulating into the counts of earlier runs.
+    if (OS::FileExists(method_profile_file_.c_str()) &&
+        !method_profile_->ReadFromFile(method_profile_file_)) {
+      LOG(WARNING) << "Ignoring bad method profile file " << method_profile_file_;
+      delete method_profile_;
+      method_profile_ = new MethodProfile;
+    }
+  }
+  if (method_profile_ == NULL && hot_method_threshold_ != 0) {
+    // The hot method compiler works off the interpreter's counts.
+    method_profile_ = new MethodProfile;
+  }
+  if (options->interpreter_decode_threshold_ != 0 && !is_compiler_) {
+    decoded_code_cache_ =
+        new interpreter::DecodedCodeCache(options->interpreter_decode_threshold_);
+  }
+
   // Pre-allocate an OutOfMemoryError for the double-OOME case.
   self->ThrowNewException(ThrowLocation(), "Ljava/lang/OutOfMemoryError;",
                           "OutOfMemoryError thrown while trying to throw OutOfMemoryError; no stack available");
   pre_allocated_OutOfMemoryError_ = self->GetException(NULL);
   self->ClearException();
 
+  startup_timeline_->EndPhase();
   VLOG(startup) << "Runtime::Init exiting";
   return true;
 }
@@ -949,15 +1221,18 @@ void Runtime::InitNativeMethods() {
 
   // First set up JniConstants, which is used by both the runtime's built-in native
   // methods and libcore.
+  startup_timeline_->StartPhase("InitWellKnownClasses");
   JniConstants::init(env);
   WellKnownClasses::Init(env);
 
   // Then set up the native methods provided by the runtime itself.
+  startup_timeline_->StartPhase("RegisterNativeMethods");
   RegisterRuntimeNativeMethods(env);
 
   // Then set up libcore, which is just a regular JNI library with a regular JNI_OnLoad.
   // Most JNI libraries can just use System.loadLibrary, but libcore can't because it's
   // the library that implements System.loadLibrary!
+  startup_timeline_->StartPhase("LoadLibcore");
   {
     std::string mapped_name(StringPrintf(OS_SHARED_LIB_FORMAT_STR, "javacore"));
     std::string reason;
@@ -969,7 +1244,9 @@ void Runtime::InitNativeMethods() {
   }
 
   // Initialize well known classes that may invoke runtime native methods.
+  startup_timeline_->StartPhase("LateInitWellKnownClasses");
   WellKnownClasses::LateInit(env);
+  startup_timeline_->EndPhase();
 
   VLOG(startup) << "Runtime::InitNativeMethods exiting";
 }
@@ -1036,6 +1313,8 @@ void Runtime::DumpForSigQuit(std::ostream& os) {
   GetInternTable()->DumpForSigQuit(os);
   GetJavaVM()->DumpForSigQuit(os);
   GetHeap()->DumpForSigQuit(os);
+  Monitor::DumpForSigQuit(os);
+  Trace::DumpForSigQuit(os);
   os << "\n";
 
   thread_list_->DumpForSigQuit(os);
@@ -1150,6 +1429,9 @@ void Runtime::VisitConcurrentRoots(RootVisitor* visitor, void* arg, bool only_di
 
 void Runtime::VisitNonThreadRoots(RootVisitor* visitor, void* arg) {
   java_vm_->VisitRoots(visitor, arg);
+  heap_->VisitPinnedObjects(visitor, arg);
+  heap_->VisitPendingReferences(visitor, arg);
+  Dbg::VisitRoots(visitor, arg);
   if (pre_allocated_OutOfMemoryError_ != NULL) {
     visitor(pre_allocated_OutOfMemoryError_, arg);
   }
@@ -1227,12 +1509,20 @@ mirror::ArtMethod* Runtime::CreateCalleeSaveMethod(InstructionSet instruction_se
     uint32_t all_spills = (1 << art::mips::S0) | (1 << art::mips::S1);
     uint32_t core_spills = ref_spills | (type == kRefsAndArgs ? arg_spills : 0) |
                            (type == kSaveAll ? all_spills : 0) | (1 << art::mips::RA);
+    uint32_t fp_all_spills = (1 << art::mips::F20) | (1 << art::mips::F21) |
+                             (1 << art::mips::F22) | (1 << art::mips::F23) |
+                             (1 << art::mips::F24) | (1 << art::mips::F25) |
+                             (1 << art::mips::F26) | (1 << art::mips::F27) |
+                             (1 << art::mips::F28) | (1 << art::mips::F29) |
+                             (1 << art::mips::F30) | (1 << art::mips::F31);
+    uint32_t fp_spills = type == kSaveAll ? fp_all_spills : 0;
     size_t frame_size = RoundUp((__builtin_popcount(core_spills) /* gprs */ +
+                                __builtin_popcount(fp_spills) /* fprs */ +
                                 (type == kRefsAndArgs ? 0 : 3) + 1 /* Method* */) *
                                 kPointerSize, kStackAlignment);
     method->SetFrameSizeInBytes(frame_size);
     method->SetCoreSpillMask(core_spills);
-    method->SetFpSpillMask(0);
+    method->SetFpSpillMask(fp_spills);
   } else if (instruction_set == kX86) {
     uint32_t ref_spills = (1 << art::x86::EBP) | (1 << art::x86::ESI) | (1 << art::x86::EDI);
     uint32_t arg_spills = (1 << art::x86::ECX) | (1 << art::x86::EDX) | (1 << art::x86::EBX);
@@ -1253,12 +1543,14 @@ void Runtime::DisallowNewSystemWeaks() {
   monitor_list_->DisallowNewMonitors();
   intern_table_->DisallowNewInterns();
   java_vm_->DisallowNewWeakGlobals();
+  Dbg::DisallowNewObjectRegistryObjects();
 }
 
 void Runtime::AllowNewSystemWeaks() {
   monitor_list_->AllowNewMonitors();
   intern_table_->AllowNewInterns();
   java_vm_->AllowNewWeakGlobals();
+  Dbg::AllowNewObjectRegistryObjects();
 }
 
 void Runtime::SetCalleeSaveMethod(mirror::ArtMethod* method, CalleeSaveType type) {
@@ -29,6 +29,7 @@
 #include "base/stringpiece.h"
 #include "gc/heap.h"
 #include "globals.h"
+#include "hprof/hprof.h"
 #include "instruction_set.h"
 #include "instrumentation.h"
 #include "jobject_comparator.h"
@@ -42,6 +43,9 @@ namespace art {
 namespace gc {
   class Heap;
 }
+namespace interpreter {
+  class DecodedCodeCache;
+}
 namespace mirror {
   class ArtMethod;
   class ClassLoader;
@@ -52,10 +56,14 @@ namespace mirror {
 }  // namespace mirror
 class ClassLinker;
 class DexFile;
+class HotMethodCompiler;
 class InternTable;
+class MethodProfile;
 struct JavaVMExt;
 class MonitorList;
 class SignalCatcher;
+class StartupPageProfile;
+class StartupTimeline;
 class ThreadList;
 class Trace;
 
@@ -93,7 +101,9 @@ class Runtime {
     std::string class_path_string_;
     std::string host_prefix_;
     std::string image_;
+    ptrdiff_t image_relocation_delta_;
     bool check_jni_;
+    size_t check_jni_rate_;
     std::string jni_trace_;
     bool is_compiler_;
     bool is_zygote_;
@@ -103,21 +113,41 @@ class Runtime {
     size_t long_pause_log_threshold_;
     size_t long_gc_log_threshold_;
     bool ignore_max_footprint_;
+    bool dump_gc_performance_on_shutdown_;
+    bool log_startup_timeline_;
+    bool track_zygote_dirty_pages_;
     size_t heap_initial_size_;
     size_t heap_maximum_size_;
     size_t heap_growth_limit_;
     size_t heap_min_free_;
     size_t heap_max_free_;
     double heap_target_utilization_;
+    double heap_target_gc_cpu_fraction_;
+    size_t heap_pause_budget_ms_;
+    size_t soft_ref_lru_policy_ms_per_mb_;
+    size_t heap_verification_sampling_;
     size_t parallel_gc_threads_;
     size_t conc_gc_threads_;
+    size_t reference_enqueue_threads_;
+    std::vector<int> gc_thread_cpus_;
     size_t stack_size_;
     bool low_memory_mode_;
+    bool use_run_alloc_space_;
+    bool use_huge_pages_;
+    bool use_numa_;
     size_t lock_profiling_threshold_;
+    bool use_biased_locking_;
     std::string stack_trace_file_;
+    hprof::DumpOptions hprof_options_;
     bool method_trace_;
     std::string method_trace_file_;
     size_t method_trace_file_size_;
+    std::string method_profile_file_;
+    std::string startup_page_profile_file_;
+    size_t hot_method_threshold_;
+    size_t hot_method_code_cache_size_;
+    size_t interpreter_decode_threshold_;
+    size_t max_stack_trace_depth_;
     bool (*hook_is_sensitive_thread_)();
     jint (*hook_vfprintf_)(FILE* stream, const char* format, va_list ap);
     void (*hook_exit_)(jint status);
@@ -390,6 +420,42 @@ class Runtime {
     return &instrumentation_;
   }
 
+  // Returns the profile the interpreter records method counts into, or NULL if not profiling.
+  MethodProfile* GetMethodProfile() const {
+    return method_profile_;
+  }
+
+  // Interpreted methods whose invocation and backedge counts reach this many are compiled in the
+  // background, 0 when hot methods aren't compiled.
+  size_t GetHotMethodThreshold() const {
+    return hot_method_threshold_;
+  }
+
+  // Returns the compiler of hot methods, or NULL if it isn't running.
+  HotMethodCompiler* GetHotMethodCompiler() const {
+    return hot_method_compiler_;
+  }
+
+  // Returns the phases of startup, with their times and page faults.
+  StartupTimeline* GetStartupTimeline() const {
+    return startup_timeline_;
+  }
+
+  // Returns the interpreter's cache of pre-decoded hot methods, or NULL if it isn't in use.
+  interpreter::DecodedCodeCache* GetDecodedCodeCache() const {
+    return decoded_code_cache_;
+  }
+
+  // The most frames a stack trace records, counted from the top of the stack, 0 for no limit.
+  size_t GetMaxStackTraceDepth() const {
+    return max_stack_trace_depth_;
+  }
+
+  // How the heap dumps requested through VMDebug are encoded.
+  const hprof::DumpOptions& GetHprofOptions() const {
+    return hprof_options_;
+  }
+
   bool UseCompileTimeClassPath() const {
     return use_compile_time_class_path_;
   }
@@ -462,6 +528,8 @@ class Runtime {
   SignalCatcher* signal_catcher_;
   std::string stack_trace_file_;
 
+  hprof::DumpOptions hprof_options_;
+
   JavaVMExt* java_vm_;
 
   mirror::Throwable* pre_allocated_OutOfMemoryError_;
@@ -503,6 +571,28 @@ class Runtime {
   size_t method_trace_file_size_;
   instrumentation::Instrumentation instrumentation_;
 
+  // Written out to method_profile_file_ on shutdown, if there is one.
+  MethodProfile* method_profile_;
+  std::string method_profile_file_;
+
+  size_t hot_method_threshold_;
+  size_t hot_method_code_cache_size_;
+  HotMethodCompiler* hot_method_compiler_;
+
+  // Records or replays the boot image pages startup touches, stopped before the zygote forks.
+  StartupPageProfile* startup_page_profile_;
+
+  StartupTimeline* startup_timeline_;
+  // Whether to log the startup timeline once startup finishes.
+  bool log_startup_timeline_;
+
+  interpreter::DecodedCodeCache* decoded_code_cache_;
+
+  size_t max_stack_trace_depth_;
+
+  // CPUs the GC's thread pool workers are pinned to, none if empty.
+  std::vector<int> gc_thread_cpus_;
+
   typedef SafeMap<jobject, std::vector<const DexFile*>, JobjectComparator> CompileTimeClassPaths;
   CompileTimeClassPaths compile_time_class_paths_;
   bool use_compile_time_class_path_;
@@ -47,6 +47,8 @@ TEST_F(RuntimeTest, ParsedOptions) {
   options.push_back(std::make_pair("-Xmx4k", null));
   options.push_back(std::make_pair("-Xss1m", null));
   options.push_back(std::make_pair("-XX:HeapTargetUtilization=0.75", null));
+  options.push_back(std::make_pair("-XX:HprofCompress", null));
+  options.push_back(std::make_pair("-XX:HprofMaxArrayBytes=64k", null));
   options.push_back(std::make_pair("-Dfoo=bar", null));
   options.push_back(std::make_pair("-Dbaz=qux", null));
   options.push_back(std::make_pair("-verbose:gc,class,jni", null));
@@ -65,6 +67,9 @@ TEST_F(RuntimeTest, ParsedOptions) {
   EXPECT_EQ(4 * KB, parsed->heap_maximum_size_);
   EXPECT_EQ(1 * MB, parsed->stack_size_);
   EXPECT_EQ(0.75, parsed->heap_target_utilization_);
+  EXPECT_TRUE(parsed->hprof_options_.compress);
+  EXPECT_FALSE(parsed->hprof_options_.dedup_primitive_arrays);
+  EXPECT_EQ(64 * KB, parsed->hprof_options_.max_primitive_array_bytes);
   EXPECT_EQ("host_prefix", parsed->host_prefix_);
   EXPECT_TRUE(test_vfprintf == parsed->hook_vfprintf_);
   EXPECT_TRUE(test_exit == parsed->hook_exit_);
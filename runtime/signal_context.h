@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ART_RUNTIME_SIGNAL_CONTEXT_H_
+#define ART_RUNTIME_SIGNAL_CONTEXT_H_
+
+#include <signal.h>
+
+#if defined(HAVE_ANDROID_OS)
+#include <asm/sigcontext.h>
+#elif defined(__linux__)
+#include <ucontext.h>
+#endif
+
+namespace art {
+
+#if defined(HAVE_ANDROID_OS)
+// Bionic has no ucontext_t, this is the kernel's layout of the context given to SA_SIGINFO
+// handlers.
+struct KernelUContext {
+  unsigned long uc_flags;  // NOLINT(runtime/int)
+  KernelUContext* uc_link;
+  stack_t uc_stack;
+  struct sigcontext uc_mcontext;
+};
+typedef struct sigcontext MachineContext;
+#else
+typedef ucontext_t KernelUContext;
+typedef mcontext_t MachineContext;
+#endif
+
+}  // namespace art
+
+#endif  // ART_RUNTIME_SIGNAL_CONTEXT_H_
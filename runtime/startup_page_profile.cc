@@ -0,0 +1,208 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "startup_page_profile.h"
+
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "base/logging.h"
+#include "base/stringprintf.h"
+#include "base/unix_file/fd_file.h"
+#include "image.h"
+#include "os.h"
+#include "UniquePtr.h"
+#include "utils.h"
+
+namespace art {
+
+StartupPageProfile::StartupPageProfile(uint32_t checksum)
+    : checksum_(checksum),
+      running_(false),
+      stop_(false) {
+}
+
+StartupPageProfile::~StartupPageProfile() {
+  Stop();
+}
+
+StartupPageProfile* StartupPageProfile::Start(const std::string& filename,
+                                              const ImageHeader& image_header) {
+  UniquePtr<StartupPageProfile> profile(new StartupPageProfile(image_header.GetOatChecksum()));
+  profile->AddMapping(image_header.GetImageBegin(), image_header.GetImageSize());
+  profile->AddMapping(image_header.GetOatFileBegin(),
+                      image_header.GetOatFileEnd() - image_header.GetOatFileBegin());
+  if (!OS::FileExists(filename.c_str())) {
+    profile->record_filename_ = filename;
+  } else if (!profile->ReadFromFile(filename)) {
+    // The boot image changed since the profile was recorded.
+    LOG(INFO) << "Recording startup page profile " << filename << " again";
+    profile->record_filename_ = filename;
+  }
+  CHECK_PTHREAD_CALL(pthread_create, (&profile->pthread_, NULL, &Run, profile.get()),
+                     "startup page profile thread");
+  profile->running_ = true;
+  return profile.release();
+}
+
+void StartupPageProfile::Stop() {
+  if (running_) {
+    stop_ = true;
+    CHECK_PTHREAD_CALL(pthread_join, (pthread_, NULL), "startup page profile shutdown");
+    running_ = false;
+  }
+}
+
+void* StartupPageProfile::Run(void* arg) {
+  // The thread only looks at memory mappings, it doesn't attach to the runtime.
+  StartupPageProfile* profile = reinterpret_cast<StartupPageProfile*>(arg);
+  if (profile->record_filename_.empty()) {
+    size_t num_pages = profile->Prefetch();
+    VLOG(startup) << "Prefetched " << num_pages << " startup pages";
+    return NULL;
+  }
+  for (size_t i = 0; i < kMaxSamples && !profile->stop_; ++i) {
+    profile->Sample();
+    usleep(kSampleIntervalUs);
+  }
+  profile->WriteToFile(profile->record_filename_);
+  return NULL;
+}
+
+void StartupPageProfile::AddMapping(byte* begin, size_t size) {
+  DCHECK(IsAligned<kPageSize>(begin)) << reinterpret_cast<void*>(begin);
+  Mapping mapping;
+  mapping.begin = begin;
+  mapping.size = size;
+  mapping.seen.resize(RoundUp(size, kPageSize) / kPageSize);
+  mappings_.push_back(mapping);
+}
+
+size_t StartupPageProfile::Sample() {
+  // Ranges from earlier samples are never extended, so that they stay in first touch order.
+  const size_t first_new_range = ranges_.size();
+  size_t num_added = 0;
+  std::vector<unsigned char> residency;
+  for (size_t i = 0; i < mappings_.size(); ++i) {
+    Mapping& mapping = mappings_[i];
+    const size_t num_pages = mapping.seen.size();
+    if (num_pages == 0) {
+      continue;
+    }
+    residency.resize(num_pages);
+    if (mincore(mapping.begin, num_pages * kPageSize, &residency[0]) != 0) {
+      PLOG(WARNING) << "mincore failed for " << reinterpret_cast<void*>(mapping.begin);
+      continue;
+    }
+    for (size_t page = 0; page < num_pages; ++page) {
+      if ((residency[page] & 1) == 0 || mapping.seen[page]) {
+        continue;
+      }
+      mapping.seen[page] = true;
+      ++num_added;
+      if (ranges_.size() > first_new_range && ranges_.back().mapping == i &&
+          ranges_.back().first_page + ranges_.back().num_pages == page) {
+        ++ranges_.back().num_pages;
+      } else {
+        Range range;
+        range.mapping = i;
+        range.first_page = page;
+        range.num_pages = 1;
+        ranges_.push_back(range);
+      }
+    }
+  }
+  return num_added;
+}
+
+size_t StartupPageProfile::Prefetch() const {
+  size_t num_advised = 0;
+  for (const Range& range : ranges_) {
+    const Mapping& mapping = mappings_[range.mapping];
+    if (madvise(mapping.begin + range.first_page * kPageSize, range.num_pages * kPageSize,
+                MADV_WILLNEED) == 0) {
+      num_advised += range.num_pages;
+    }
+  }
+  return num_advised;
+}
+
+bool StartupPageProfile::ReadFromFile(const std::string& filename) {
+  std::string contents;
+  if (!ReadFileToString(filename, &contents)) {
+    return false;
+  }
+  std::vector<std::string> lines;
+  Split(contents, '\n', lines);
+  std::vector<Range> ranges;
+  size_t num_mappings = 0;
+  bool checksum_ok = false;
+  for (const std::string& line : lines) {
+    std::vector<std::string> fields;
+    Split(line, ' ', fields);
+    if (fields.size() == 2 && fields[0] == "checksum") {
+      checksum_ok = strtoul(fields[1].c_str(), NULL, 16) == checksum_;
+    } else if (fields.size() == 2 && fields[0] == "mapping") {
+      if (num_mappings == mappings_.size() ||
+          strtoul(fields[1].c_str(), NULL, 10) != mappings_[num_mappings].size) {
+        return false;
+      }
+      ++num_mappings;
+    } else if (fields.size() == 3) {
+      Range range;
+      range.mapping = strtoul(fields[0].c_str(), NULL, 10);
+      range.first_page = strtoul(fields[1].c_str(), NULL, 10);
+      range.num_pages = strtoul(fields[2].c_str(), NULL, 10);
+      if (range.mapping >= num_mappings ||
+          range.first_page + range.num_pages > mappings_[range.mapping].seen.size()) {
+        LOG(WARNING) << "Bad range in startup page profile " << filename << ": " << line;
+        return false;
+      }
+      ranges.push_back(range);
+    } else {
+      LOG(WARNING) << "Bad line in startup page profile " << filename << ": " << line;
+      return false;
+    }
+  }
+  if (!checksum_ok || num_mappings != mappings_.size()) {
+    return false;
+  }
+  ranges_.swap(ranges);
+  return true;
+}
+
+bool StartupPageProfile::WriteToFile(const std::string& filename) const {
+  std::string contents(StringPrintf("checksum %08x\n", checksum_));
+  for (const Mapping& mapping : mappings_) {
+    StringAppendF(&contents, "mapping %zd\n", mapping.size);
+  }
+  for (const Range& range : ranges_) {
+    StringAppendF(&contents, "%u %u %u\n", range.mapping, range.first_page, range.num_pages);
+  }
+  UniquePtr<File> file(OS::CreateEmptyFile(filename.c_str()));
+  if (file.get() == NULL) {
+    PLOG(WARNING) << "Failed to create startup page profile " << filename;
+    return false;
+  }
+  if (!file->WriteFully(contents.data(), contents.size())) {
+    PLOG(WARNING) << "Failed to write startup page profile " << filename;
+    return false;
+  }
+  return true;
+}
+
+}  // namespace art
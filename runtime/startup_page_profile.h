@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ART_RUNTIME_STARTUP_PAGE_PROFILE_H_
+#define ART_RUNTIME_STARTUP_PAGE_PROFILE_H_
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "base/macros.h"
+#include "globals.h"
+
+namespace art {
+
+class ImageHeader;
+
+// The pages of the boot image and oat file that startup touches, in the order they were first
+// found resident. When the runtime is started with -Xstartup-page-profile and the profile file
+// doesn't exist yet, a thread records it by sampling mincore(2) over the mappings. When the file
+// exists, the thread instead madvise(MADV_WILLNEED)s the recorded ranges in order, so that reads
+// of the files run ahead of the main thread's page faults. Recording is only meaningful when the
+// files aren't in the page cache yet, as on the first start after boot.
+//
+// The profile file is text, a "checksum <oat checksum>" line identifying the boot image, a
+// "mapping <size>" line for each mapping, then a "<mapping> <first page> <pages>" line for each
+// range of pages in first touch order.
+class StartupPageProfile {
+ public:
+  struct Range {
+    uint32_t mapping;
+    uint32_t first_page;
+    uint32_t num_pages;
+  };
+
+  explicit StartupPageProfile(uint32_t checksum);
+  ~StartupPageProfile();
+
+  // Records or replays the profile of the boot image in filename on a new thread.
+  static StartupPageProfile* Start(const std::string& filename, const ImageHeader& image_header);
+
+  // Waits for the thread, recording stops early and what was recorded is written out.
+  void Stop();
+
+  // Adds a page aligned mapping to record or replay, mappings are numbered in the order added.
+  void AddMapping(byte* begin, size_t size);
+
+  // Adds the pages found resident since the last sample to the ranges. Returns the number of
+  // pages added.
+  size_t Sample();
+
+  // Advises the kernel that the pages of the ranges will be needed, in order. Returns the number
+  // of pages advised.
+  size_t Prefetch() const;
+
+  // Reads the ranges of a profile file whose checksum and mappings match this profile's. Returns
+  // false if the file couldn't be read or doesn't match.
+  bool ReadFromFile(const std::string& filename);
+
+  // Writes the ranges to a profile file.
+  bool WriteToFile(const std::string& filename) const;
+
+  const std::vector<Range>& GetRanges() const {
+    return ranges_;
+  }
+
+ private:
+  // How often and for how long startup is sampled.
+  static constexpr uint32_t kSampleIntervalUs = 20 * 1000;
+  static constexpr size_t kMaxSamples = 500;
+
+  struct Mapping {
+    byte* begin;
+    size_t size;
+    // Whether each page was already found resident.
+    std::vector<bool> seen;
+  };
+
+  static void* Run(void* arg);
+
+  const uint32_t checksum_;
+  std::vector<Mapping> mappings_;
+  std::vector<Range> ranges_;
+
+  // Where to write the ranges when recording, empty when replaying.
+  std::string record_filename_;
+  pthread_t pthread_;
+  bool running_;
+  volatile bool stop_;
+
+  DISALLOW_COPY_AND_ASSIGN(StartupPageProfile);
+};
+
+}  // namespace art
+
+#endif  // ART_RUNTIME_STARTUP_PAGE_PROFILE_H_
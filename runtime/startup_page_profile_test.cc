@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "startup_page_profile.h"
+
+#include "common_test.h"
+#include "mem_map.h"
+#include "UniquePtr.h"
+
+namespace art {
+
+class StartupPageProfileTest : public CommonTest {};
+
+TEST_F(StartupPageProfileTest, SampleWriteRead) {
+  UniquePtr<MemMap> map(MemMap::MapAnonymous("StartupPageProfileTest", NULL, 4 * kPageSize,
+                                             PROT_READ | PROT_WRITE));
+  ASSERT_TRUE(map.get() != NULL);
+  StartupPageProfile profile(0x1234);
+  profile.AddMapping(map->Begin(), map->Size());
+  EXPECT_EQ(0U, profile.Sample());
+
+  map->Begin()[2 * kPageSize] = 1;
+  EXPECT_EQ(1U, profile.Sample());
+  // Pages found together are merged, but never into the ranges of earlier samples.
+  map->Begin()[0] = 1;
+  map->Begin()[kPageSize] = 1;
+  map->Begin()[2 * kPageSize] = 2;
+  EXPECT_EQ(2U, profile.Sample());
+  EXPECT_EQ(0U, profile.Sample());
+  ASSERT_EQ(2U, profile.GetRanges().size());
+  EXPECT_EQ(2U, profile.GetRanges()[0].first_page);
+  EXPECT_EQ(1U, profile.GetRanges()[0].num_pages);
+  EXPECT_EQ(0U, profile.GetRanges()[1].first_page);
+  EXPECT_EQ(2U, profile.GetRanges()[1].num_pages);
+  EXPECT_EQ(3U, profile.Prefetch());
+
+  ScratchFile file;
+  ASSERT_TRUE(profile.WriteToFile(file.GetFilename()));
+  StartupPageProfile read_profile(0x1234);
+  read_profile.AddMapping(map->Begin(), map->Size());
+  ASSERT_TRUE(read_profile.ReadFromFile(file.GetFilename()));
+  ASSERT_EQ(2U, read_profile.GetRanges().size());
+  EXPECT_EQ(0U, read_profile.GetRanges()[0].mapping);
+  EXPECT_EQ(2U, read_profile.GetRanges()[0].first_page);
+  EXPECT_EQ(2U, read_profile.GetRanges()[1].num_pages);
+
+  // Profiles of another boot image, or of mappings of other sizes, are ignored.
+  StartupPageProfile other_checksum(0x4321);
+  other_checksum.AddMapping(map->Begin(), map->Size());
+  EXPECT_FALSE(other_checksum.ReadFromFile(file.GetFilename()));
+  StartupPageProfile other_size(0x1234);
+  other_size.AddMapping(map->Begin(), kPageSize);
+  EXPECT_FALSE(other_size.ReadFromFile(file.GetFilename()));
+}
+
+}  // namespace art
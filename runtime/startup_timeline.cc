@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "startup_timeline.h"
+
+#include <sys/resource.h>
+
+#include <iomanip>
+#include <ostream>
+
+#include "base/logging.h"
+#include "thread.h"
+#include "utils.h"
+
+namespace art {
+
+StartupTimeline::StartupTimeline()
+    : lock_("startup timeline lock"),
+      timings_("Startup", true, false),
+      in_phase_(false) {
+}
+
+void StartupTimeline::GetFaults(uint64_t* minor_faults, uint64_t* major_faults) {
+  // Faults of the whole process, startup's other threads rarely fault.
+  rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    PLOG(WARNING) << "getrusage failed";
+    *minor_faults = 0;
+    *major_faults = 0;
+    return;
+  }
+  *minor_faults = usage.ru_minflt;
+  *major_faults = usage.ru_majflt;
+}
+
+void StartupTimeline::StartPhase(const char* label) {
+  MutexLock mu(Thread::Current(), lock_);
+  if (in_phase_) {
+    EndPhaseLocked();
+  }
+  in_phase_ = true;
+  current_.label = label;
+  current_.start_ns = NanoTime();
+  current_.duration_ns = 0;
+  GetFaults(&current_.minor_faults, &current_.major_faults);
+  timings_.StartSplit(label);
+}
+
+void StartupTimeline::EndPhase() {
+  MutexLock mu(Thread::Current(), lock_);
+  if (in_phase_) {
+    EndPhaseLocked();
+  }
+}
+
+void StartupTimeline::EndPhaseLocked() {
+  DCHECK(in_phase_);
+  timings_.EndSplit();
+  uint64_t minor_faults;
+  uint64_t major_faults;
+  GetFaults(&minor_faults, &major_faults);
+  current_.duration_ns = timings_.GetSplits().back().first;
+  current_.minor_faults = minor_faults - current_.minor_faults;
+  current_.major_faults = major_faults - current_.major_faults;
+  phases_.push_back(current_);
+  in_phase_ = false;
+}
+
+void StartupTimeline::GetPhases(std::vector<Phase>* phases) const {
+  MutexLock mu(Thread::Current(), lock_);
+  *phases = phases_;
+}
+
+void StartupTimeline::Dump(std::ostream& os) const {
+  std::vector<Phase> phases;
+  GetPhases(&phases);
+  uint64_t total_ns = 0;
+  uint64_t total_minor_faults = 0;
+  uint64_t total_major_faults = 0;
+  for (const Phase& phase : phases) {
+    os << "Startup: " << std::setw(10) << PrettyDuration(phase.duration_ns) << " "
+       << std::setw(6) << phase.minor_faults << " minor " << std::setw(4) << phase.major_faults
+       << " major faults " << phase.label << "\n";
+    total_ns += phase.duration_ns;
+    total_minor_faults += phase.minor_faults;
+    total_major_faults += phase.major_faults;
+  }
+  os << "Startup: end, " << PrettyDuration(total_ns) << ", " << total_minor_faults << " minor "
+     << total_major_faults << " major faults\n";
+}
+
+}  // namespace art
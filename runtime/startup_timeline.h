@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ART_RUNTIME_STARTUP_TIMELINE_H_
+#define ART_RUNTIME_STARTUP_TIMELINE_H_
+
+#include <stdint.h>
+
+#include <iosfwd>
+#include <vector>
+
+#include "base/macros.h"
+#include "base/mutex.h"
+#include "base/timing_logger.h"
+
+namespace art {
+
+// The phases of runtime startup, with how long each took and the page faults the process took
+// during it. Runtime::Init and Runtime::Start mark the phases on the main thread. The timeline is
+// logged once startup finishes with -Xstartup-timeline or -verbose:startup, and DDMS reads it
+// through DdmVmInternal.getStartupTimeline().
+class StartupTimeline {
+ public:
+  struct Phase {
+    // A string literal.
+    const char* label;
+    // On the monotonic clock.
+    uint64_t start_ns;
+    uint64_t duration_ns;
+    uint64_t minor_faults;
+    uint64_t major_faults;
+  };
+
+  StartupTimeline();
+
+  // Ends the phase in progress, if there is one, and starts a new one.
+  void StartPhase(const char* label) LOCKS_EXCLUDED(lock_);
+
+  // Ends the phase in progress, if there is one.
+  void EndPhase() LOCKS_EXCLUDED(lock_);
+
+  // Copies the phases that have ended, in order.
+  void GetPhases(std::vector<Phase>* phases) const LOCKS_EXCLUDED(lock_);
+
+  void Dump(std::ostream& os) const LOCKS_EXCLUDED(lock_);
+
+ private:
+  static void GetFaults(uint64_t* minor_faults, uint64_t* major_faults);
+
+  void EndPhaseLocked() EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  // Phases are read by DDM while startup may still add to them.
+  mutable Mutex lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
+
+  // Times the phases, also marking them for systrace.
+  base::TimingLogger timings_ GUARDED_BY(lock_);
+
+  std::vector<Phase> phases_ GUARDED_BY(lock_);
+
+  bool in_phase_ GUARDED_BY(lock_);
+
+  // The phase in progress, its faults are the counts at its start until it ends.
+  Phase current_ GUARDED_BY(lock_);
+
+  DISALLOW_COPY_AND_ASSIGN(StartupTimeline);
+};
+
+}  // namespace art
+
+#endif  // ART_RUNTIME_STARTUP_TIMELINE_H_
@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "startup_timeline.h"
+
+#include <sstream>
+
+#include "common_test.h"
+#include "mem_map.h"
+#include "UniquePtr.h"
+
+namespace art {
+
+class StartupTimelineTest : public CommonTest {};
+
+TEST_F(StartupTimelineTest, Phases) {
+  StartupTimeline timeline;
+  timeline.EndPhase();
+  timeline.StartPhase("First");
+  // Touch fresh memory so that the phase takes faults.
+  UniquePtr<MemMap> map(MemMap::MapAnonymous("StartupTimelineTest", NULL, 4 * kPageSize,
+                                             PROT_READ | PROT_WRITE));
+  ASSERT_TRUE(map.get() != NULL);
+  for (size_t i = 0; i < 4; ++i) {
+    map->Begin()[i * kPageSize] = 1;
+  }
+  timeline.StartPhase("Second");
+  timeline.EndPhase();
+  timeline.StartPhase("Unfinished");
+
+  std::vector<StartupTimeline::Phase> phases;
+  timeline.GetPhases(&phases);
+  ASSERT_EQ(2U, phases.size());
+  EXPECT_STREQ("First", phases[0].label);
+  EXPECT_GE(phases[0].minor_faults + phases[0].major_faults, 4U);
+  EXPECT_STREQ("Second", phases[1].label);
+  EXPECT_GE(phases[1].start_ns, phases[0].start_ns + phases[0].duration_ns);
+
+  std::ostringstream os;
+  timeline.Dump(os);
+  EXPECT_NE(std::string::npos, os.str().find("First"));
+  EXPECT_EQ(std::string::npos, os.str().find("Unfinished"));
+  timeline.EndPhase();
+}
+
+}  // namespace art
@@ -76,6 +76,7 @@ inline void Thread::TransitionFromRunnableToSuspended(ThreadState new_state) {
   // If we toggled the checkpoint flag we must have cleared it.
   uint16_t flag_change = new_state_and_flags.as_struct.flags ^ old_state_and_flags.as_struct.flags;
   if (UNLIKELY((flag_change & kCheckpointRequest) != 0)) {
+    UpdateSuspendPollPage();
     RunCheckpointFunction();
   }
   // Release share on mutator_lock_.
@@ -121,6 +122,7 @@ inline ThreadState Thread::TransitionFromSuspendedToRunnable() {
       Locks::mutator_lock_->SharedUnlock(this);
     }
   } while (UNLIKELY(!done));
+  ++roots_generation_;
   return static_cast<ThreadState>(old_state);
 }
 
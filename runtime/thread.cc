@@ -21,6 +21,7 @@
 #include <cutils/trace.h>
 #include <pthread.h>
 #include <signal.h>
+#include <sys/mman.h>
 #include <sys/resource.h>
 #include <sys/time.h>
 
@@ -63,6 +64,8 @@
 #include "stack_indirect_reference_table.h"
 #include "thread-inl.h"
 #include "thread_list.h"
+#include "thread_stack_cache.h"
+#include "trace.h"
 #include "utils.h"
 #include "verifier/dex_gc_map.h"
 #include "verifier/method_verifier.h"
@@ -74,6 +77,11 @@ namespace art {
 bool Thread::is_started_ = false;
 pthread_key_t Thread::pthread_key_self_;
 ConditionVariable* Thread::resume_cond_ = NULL;
+ThreadStackCache* Thread::stack_cache_ = NULL;
+byte* Thread::poll_pages_ = NULL;
+
+// How many finished threads' stacks are kept for new threads.
+static constexpr size_t kMaxCachedThreadStacks = 4;
 
 static const char* kThreadNameDuringStartup = "<native thread without managed peer>";
 
@@ -138,6 +146,7 @@ void* Thread::CreateCallback(void* arg) {
   Runtime* runtime = Runtime::Current();
   if (runtime == NULL) {
     LOG(ERROR) << "Thread attaching to non-existent runtime: " << *self;
+    stack_cache_->Release();
     return NULL;
   }
   {
@@ -178,6 +187,7 @@ void* Thread::CreateCallback(void* arg) {
   // Detach and delete self.
   Runtime::Current()->GetThreadList()->Unregister(self);
 
+  stack_cache_->Release();
   return NULL;
 }
 
@@ -218,7 +228,7 @@ static size_t FixStackSize(size_t stack_size) {
   // It's likely that callers are trying to ensure they have at least a certain amount of
   // stack space, so we should add our reserved space on top of what they requested, rather
   // than implicitly take it away from them.
-  stack_size += Thread::kStackOverflowReservedBytes;
+  stack_size += Thread::kStackOverflowProtectedBytes + Thread::kStackOverflowReservedBytes;
 
   // Some systems require the stack size to be a multiple of the system page size, so round up.
   stack_size = RoundUp(stack_size, kPageSize);
@@ -257,13 +267,9 @@ void Thread::CreateNativeThread(JNIEnv* env, jobject java_peer, size_t stack_siz
   env->SetIntField(java_peer, WellKnownClasses::java_lang_Thread_nativePeer,
                    reinterpret_cast<jint>(child_thread));
 
-  pthread_t new_pthread;
-  pthread_attr_t attr;
-  CHECK_PTHREAD_CALL(pthread_attr_init, (&attr), "new thread");
-  CHECK_PTHREAD_CALL(pthread_attr_setdetachstate, (&attr, PTHREAD_CREATE_DETACHED), "PTHREAD_CREATE_DETACHED");
-  CHECK_PTHREAD_CALL(pthread_attr_setstacksize, (&attr, stack_size), stack_size);
-  int pthread_create_result = pthread_create(&new_pthread, &attr, Thread::CreateCallback, child_thread);
-  CHECK_PTHREAD_CALL(pthread_attr_destroy, (&attr), "new thread");
+  // Short-lived threads reuse the stacks of ones that have finished.
+  int pthread_create_result = stack_cache_->CreateThread(self, stack_size, Thread::CreateCallback,
+                                                         child_thread);
 
   if (pthread_create_result != 0) {
     // pthread_create(3) failed, so clean up.
@@ -425,7 +431,7 @@ void Thread::InitStackHwm() {
   stack_begin_ = reinterpret_cast<byte*>(stack_base);
   stack_size_ = stack_size;
 
-  if (stack_size_ <= kStackOverflowReservedBytes) {
+  if (stack_size_ <= kStackOverflowProtectedBytes + kStackOverflowReservedBytes) {
     LOG(FATAL) << "Attempt to attach a thread with a too-small stack (" << stack_size_ << " bytes)";
   }
 
@@ -463,6 +469,11 @@ void Thread::InitStackHwm() {
   // Set stack_end_ to the bottom of the stack saving space of stack overflows
   ResetDefaultStackEnd();
 
+  if (!ProtectStackGuard(true)) {
+    // Probes of compiled code then fault only where the kernel stops growing the stack.
+    VLOG(threads) << "No protected region at " << reinterpret_cast<void*>(stack_begin_);
+  }
+
   // Sanity check.
   int stack_variable;
   CHECK_GT(&stack_variable, reinterpret_cast<void*>(stack_end_));
@@ -511,10 +522,23 @@ uint64_t Thread::GetCpuMicroTime() const {
 
 void Thread::AtomicSetFlag(ThreadFlag flag) {
   android_atomic_or(flag, &state_and_flags_.as_int);
+  UpdateSuspendPollPage();
 }
 
 void Thread::AtomicClearFlag(ThreadFlag flag) {
   android_atomic_and(-1 ^ flag, &state_and_flags_.as_int);
+  UpdateSuspendPollPage();
+}
+
+void Thread::UpdateSuspendPollPage() {
+  const byte* trigger_page = GetSuspendTriggerPage();
+  suspend_poll_page_ = TestAllFlags() ? trigger_page : poll_pages_;
+  ANDROID_MEMBAR_FULL();
+  // A racing update may have read the flags before they were set and stored after this one.
+  // Clearing the flags can't be lost that way: the next poll faults and updates again.
+  if (TestAllFlags()) {
+    suspend_poll_page_ = trigger_page;
+  }
 }
 
 // Attempt to rectify locks so that we dump thread list with required locks before exiting.
@@ -580,7 +604,11 @@ bool Thread::RequestCheckpoint(Closure* function) {
   new_state_and_flags.as_struct.flags |= kCheckpointRequest;
   int succeeded = android_atomic_cmpxchg(old_state_and_flags.as_int, new_state_and_flags.as_int,
                                          &state_and_flags_.as_int);
-  return succeeded == 0;
+  if (succeeded != 0) {
+    return false;
+  }
+  UpdateSuspendPollPage();
+  return true;
 }
 
 void Thread::FullSuspendCheck() {
@@ -768,9 +796,23 @@ void Thread::DumpState(std::ostream& os, const Thread* thread, pid_t tid) {
   if (thread != NULL) {
     os << "  | stack=" << reinterpret_cast<void*>(thread->stack_begin_) << "-" << reinterpret_cast<void*>(thread->stack_end_)
        << " stackSize=" << PrettySize(thread->stack_size_) << "\n";
+    os << "  | heapAllocated=" << PrettySize(thread->heap_bytes_allocated_)
+       << " allocRate=" << PrettySize(thread->heap_allocation_rate_) << "/s\n";
   }
 }
 
+size_t Thread::UpdateHeapAllocationRate(uint64_t ms_delta) {
+  DCHECK_NE(ms_delta, 0U);
+  const size_t allocated = heap_bytes_allocated_;
+  const size_t rate = static_cast<uint64_t>(allocated - heap_bytes_allocated_at_last_gc_) * 1000 /
+      ms_delta;
+  heap_bytes_allocated_at_last_gc_ = allocated;
+  // Half of a burst carries over to the next interval, so the GC after a burst is still scheduled
+  // for the thread allocating at that rate again.
+  heap_allocation_rate_ = std::max(rate, heap_allocation_rate_ / 2);
+  return heap_allocation_rate_;
+}
+
 void Thread::DumpState(std::ostream& os) const {
   Thread::DumpState(os, this, GetTid());
 }
@@ -919,6 +961,17 @@ void Thread::Startup() {
                                          *Locks::thread_suspend_count_lock_);
   }
 
+  if (stack_cache_ == NULL) {
+    stack_cache_ = new ThreadStackCache(kMaxCachedThreadStacks);
+  }
+
+  void* poll_pages = mmap(NULL, 2 * kPageSize, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (poll_pages == MAP_FAILED) {
+    PLOG(FATAL) << "Failed to map the suspend poll pages";
+  }
+  poll_pages_ = reinterpret_cast<byte*>(poll_pages);
+  CHECK_EQ(mprotect(poll_pages_ + kPageSize, kPageSize, PROT_NONE), 0);
+
   // Allocate a TLS slot.
   CHECK_PTHREAD_CALL(pthread_key_create, (&Thread::pthread_key_self_, Thread::ThreadExitCallback), "self key");
 
@@ -948,6 +1001,8 @@ void Thread::Shutdown() {
     delete resume_cond_;
     resume_cond_ = NULL;
   }
+  munmap(poll_pages_, 2 * kPageSize);
+  poll_pages_ = NULL;
 }
 
 Thread::Thread(bool daemon)
@@ -963,7 +1018,15 @@ Thread::Thread(bool daemon)
       stack_begin_(NULL),
       stack_size_(0),
       stack_trace_sample_(NULL),
+      trace_sample_buffer_(NULL),
+      trace_buffer_pos_(NULL),
+      trace_buffer_end_(NULL),
       trace_clock_base_(0),
+      trace_cpu_clock_(),
+      alloc_sample_bytes_left_(0),
+      roots_generation_(0),
+      roots_scan_id_(0),
+      roots_scan_generation_(0),
       thin_lock_id_(0),
       tid_(0),
       wait_mutex_(new Mutex("a thread wait mutex")),
@@ -987,11 +1050,31 @@ Thread::Thread(bool daemon)
       no_thread_suspension_(0),
       last_no_thread_suspension_cause_(NULL),
       checkpoint_function_(0),
-      thread_exit_check_count_(0) {
+      thread_exit_check_count_(0),
+      heap_bytes_allocated_(0),
+      heap_bytes_allocated_at_last_gc_(0),
+      heap_allocation_rate_(0),
+      thread_local_alloc_stack_top_(NULL),
+      thread_local_alloc_stack_end_(NULL),
+      osr_vregs_(NULL),
+      osr_dex_pc_(0),
+      suspend_poll_page_(poll_pages_),
+      stack_trace_scratch_(new std::vector<std::pair<mirror::ArtMethod*, uint32_t> >),
+      last_internal_stack_trace_(NULL) {
   CHECK_EQ((sizeof(Thread) % 4), 0U) << sizeof(Thread);
   state_and_flags_.as_struct.flags = 0;
   state_and_flags_.as_struct.state = kNative;
   memset(&held_mutexes_[0], 0, sizeof(held_mutexes_));
+  memset(&thread_local_alloc_cache_[0], 0, sizeof(thread_local_alloc_cache_));
+  memset(&thread_local_runs_[0], 0, sizeof(thread_local_runs_));
+  memset(&interface_dispatch_cache_[0], 0, sizeof(interface_dispatch_cache_));
+  memset(&interpreter_cache_[0], 0, sizeof(interpreter_cache_));
+  memset(&catch_block_cache_[0], 0, sizeof(catch_block_cache_));
+  memset(&dex_pc_cache_[0], 0, sizeof(dex_pc_cache_));
+}
+
+void Thread::ClearDexPcCache() {
+  memset(&dex_pc_cache_[0], 0, sizeof(dex_pc_cache_));
 }
 
 bool Thread::IsStillStarting() const {
@@ -1053,6 +1136,9 @@ void Thread::Destroy() {
   if (jni_env_ != NULL) {
     jni_env_->monitors.VisitRoots(MonitorExitVisitor, self);
   }
+
+  // Hand any cached allocation chunks back to the alloc space.
+  Runtime::Current()->GetHeap()->RevokeThreadLocalAllocCache(self);
 }
 
 Thread::~Thread() {
@@ -1079,12 +1165,43 @@ Thread::~Thread() {
 
   delete debug_invoke_req_;
   delete instrumentation_stack_;
+  delete stack_trace_scratch_;
   delete name_;
   delete stack_trace_sample_;
+  delete trace_sample_buffer_;
+
+  // The stack may be handed to another thread, which expects it to be accessible.
+  if (stack_begin_ != NULL) {
+    ProtectStackGuard(false);
+  }
 
   TearDownAlternateSignalStack();
 }
 
+bool Thread::ProtectStackGuard(bool protect) {
+  if (!IsAligned<kPageSize>(stack_begin_)) {
+    return false;
+  }
+  int prot = protect ? PROT_NONE : (PROT_READ | PROT_WRITE);
+  if (mprotect(stack_begin_, kStackOverflowProtectedBytes, prot) == 0) {
+    return true;
+  }
+  if (!protect || errno != ENOMEM) {
+    return false;
+  }
+  // The main thread's stack is only mapped as far as it has grown. Map the region where the stack
+  // would grow to, unless something else is already there, which stops the growth short of it.
+  void* guard = mmap(stack_begin_, kStackOverflowProtectedBytes, PROT_NONE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (guard == stack_begin_) {
+    return true;
+  }
+  if (guard != MAP_FAILED) {
+    munmap(guard, kStackOverflowProtectedBytes);
+  }
+  return false;
+}
+
 void Thread::HandleUncaughtExceptions(ScopedObjectAccess& soa) {
   if (!IsExceptionPending()) {
     return;
@@ -1241,139 +1358,98 @@ void Thread::NotifyLocked(Thread* self) {
   }
 }
 
-class CountStackDepthVisitor : public StackVisitor {
+// Records the (method, dex pc) of each frame below the exception's constructor, up to max_depth.
+class CaptureStackTraceVisitor : public StackVisitor {
  public:
-  explicit CountStackDepthVisitor(Thread* thread)
+  CaptureStackTraceVisitor(Thread* thread, size_t max_depth,
+                           std::vector<std::pair<mirror::ArtMethod*, uint32_t> >* frames)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_)
-      : StackVisitor(thread, NULL),
-        depth_(0), skip_depth_(0), skipping_(true) {}
+      : StackVisitor(thread, NULL), max_depth_(max_depth), frames_(frames), skipping_(true) {}
 
   bool VisitFrame() SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
-    // We want to skip frames up to and including the exception's constructor.
-    // Note we also skip the frame if it doesn't have a method (namely the callee
-    // save frame)
     mirror::ArtMethod* m = GetMethod();
-    if (skipping_ && !m->IsRuntimeMethod() &&
-        !mirror::Throwable::GetJavaLangThrowable()->IsAssignableFrom(m->GetDeclaringClass())) {
-      skipping_ = false;
+    // Ignore runtime frames (in particular callee save).
+    if (m->IsRuntimeMethod()) {
+      return true;
     }
-    if (!skipping_) {
-      if (!m->IsRuntimeMethod()) {  // Ignore runtime frames (in particular callee save).
-        ++depth_;
+    // We want to skip frames up to and including the exception's constructor.
+    if (skipping_) {
+      if (mirror::Throwable::GetJavaLangThrowable()->IsAssignableFrom(m->GetDeclaringClass())) {
+        return true;
       }
-    } else {
-      ++skip_depth_;
+      skipping_ = false;
+    }
+    if (frames_->size() == max_depth_) {
+      return false;
     }
+    frames_->push_back(std::make_pair(m, m->IsProxyMethod() ? DexFile::kDexNoIndex : GetDexPc()));
     return true;
   }
 
-  int GetDepth() const {
-    return depth_;
-  }
-
-  int GetSkipDepth() const {
-    return skip_depth_;
-  }
-
  private:
-  uint32_t depth_;
-  uint32_t skip_depth_;
+  const size_t max_depth_;
+  std::vector<std::pair<mirror::ArtMethod*, uint32_t> >* const frames_;
   bool skipping_;
 };
 
-class BuildInternalStackTraceVisitor : public StackVisitor {
- public:
-  explicit BuildInternalStackTraceVisitor(Thread* self, Thread* thread, int skip_depth)
-      : StackVisitor(thread, NULL), self_(self),
-        skip_depth_(skip_depth), count_(0), dex_pc_trace_(NULL), method_trace_(NULL) {}
-
-  bool Init(int depth)
-      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
-    // Allocate method trace with an extra slot that will hold the PC trace
-    SirtRef<mirror::ObjectArray<mirror::Object> >
-        method_trace(self_,
-                     Runtime::Current()->GetClassLinker()->AllocObjectArray<mirror::Object>(self_,
-                                                                                            depth + 1));
-    if (method_trace.get() == NULL) {
-      return false;
-    }
-    mirror::IntArray* dex_pc_trace = mirror::IntArray::Alloc(self_, depth);
-    if (dex_pc_trace == NULL) {
-      return false;
-    }
-    // Save PC trace in last element of method trace, also places it into the
-    // object graph.
-    method_trace->Set(depth, dex_pc_trace);
-    // Set the Object*s and assert that no thread suspension is now possible.
-    const char* last_no_suspend_cause =
-        self_->StartAssertNoThreadSuspension("Building internal stack trace");
-    CHECK(last_no_suspend_cause == NULL) << last_no_suspend_cause;
-    method_trace_ = method_trace.get();
-    dex_pc_trace_ = dex_pc_trace;
-    return true;
+// Is trace an internal stack trace of exactly the given frames?
+static bool InternalStackTraceEquals(mirror::ObjectArray<mirror::Object>* trace,
+    const std::vector<std::pair<mirror::ArtMethod*, uint32_t> >& frames)
+    SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
+  int32_t depth = frames.size();
+  if (trace->GetLength() != depth + 1) {
+    return false;
   }
-
-  virtual ~BuildInternalStackTraceVisitor() {
-    if (method_trace_ != NULL) {
-      self_->EndAssertNoThreadSuspension(NULL);
+  mirror::IntArray* dex_pc_trace = down_cast<mirror::IntArray*>(trace->Get(depth));
+  for (int32_t i = 0; i < depth; ++i) {
+    if (trace->Get(i) != frames[i].first ||
+        static_cast<uint32_t>(dex_pc_trace->Get(i)) != frames[i].second) {
+      return false;
     }
   }
+  return true;
+}
 
-  bool VisitFrame() SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
-    if (method_trace_ == NULL || dex_pc_trace_ == NULL) {
-      return true;  // We're probably trying to fillInStackTrace for an OutOfMemoryError.
-    }
-    if (skip_depth_ > 0) {
-      skip_depth_--;
-      return true;
-    }
-    mirror::ArtMethod* m = GetMethod();
-    if (m->IsRuntimeMethod()) {
-      return true;  // Ignore runtime frames (in particular callee save).
-    }
-    method_trace_->Set(count_, m);
-    dex_pc_trace_->Set(count_, m->IsProxyMethod() ? DexFile::kDexNoIndex : GetDexPc());
-    ++count_;
-    return true;
+jobject Thread::CreateInternalStackTrace(const ScopedObjectAccessUnchecked& soa) const {
+  // Capture the frames in one walk into the calling thread's scratch buffer, then allocate the
+  // trace at its exact size.
+  Thread* self = soa.Self();
+  std::vector<std::pair<mirror::ArtMethod*, uint32_t> >& frames = *self->stack_trace_scratch_;
+  frames.clear();
+  size_t max_depth = Runtime::Current()->GetMaxStackTraceDepth();
+  CaptureStackTraceVisitor capture_visitor(const_cast<Thread*>(this),
+                                           max_depth != 0 ? max_depth : frames.max_size(),
+                                           &frames);
+  capture_visitor.WalkStack();
+
+  // Internal stack traces are never modified, so one with the same frames can be shared.
+  mirror::ObjectArray<mirror::Object>* last_trace = self->last_internal_stack_trace_;
+  if (last_trace != NULL && InternalStackTraceEquals(last_trace, frames)) {
+    return soa.AddLocalReference<jobjectArray>(last_trace);
+  }
+
+  // Allocate the method trace with an extra slot that will hold the PC trace. Failing either
+  // allocation throws an OutOfMemoryError, whose constructor reuses the scratch buffer, so the
+  // frames must not be read after a failure.
+  int32_t depth = frames.size();
+  ClassLinker* class_linker = Runtime::Current()->GetClassLinker();
+  SirtRef<mirror::ObjectArray<mirror::Object> >
+      method_trace(self, class_linker->AllocObjectArray<mirror::Object>(self, depth + 1));
+  if (method_trace.get() == NULL) {
+    return NULL;  // We're probably trying to fillInStackTrace for an OutOfMemoryError.
   }
-
-  mirror::ObjectArray<mirror::Object>* GetInternalStackTrace() const {
-    return method_trace_;
+  mirror::IntArray* dex_pc_trace = mirror::IntArray::Alloc(self, depth);
+  if (dex_pc_trace == NULL) {
+    return NULL;
   }
-
- private:
-  Thread* const self_;
-  // How many more frames to skip.
-  int32_t skip_depth_;
-  // Current position down stack trace.
-  uint32_t count_;
-  // Array of dex PC values.
-  mirror::IntArray* dex_pc_trace_;
-  // An array of the methods on the stack, the last entry is a reference to the PC trace.
-  mirror::ObjectArray<mirror::Object>* method_trace_;
-};
-
-jobject Thread::CreateInternalStackTrace(const ScopedObjectAccessUnchecked& soa) const {
-  // Compute depth of stack
-  CountStackDepthVisitor count_visitor(const_cast<Thread*>(this));
-  count_visitor.WalkStack();
-  int32_t depth = count_visitor.GetDepth();
-  int32_t skip_depth = count_visitor.GetSkipDepth();
-
-  // Build internal stack trace.
-  BuildInternalStackTraceVisitor build_trace_visitor(soa.Self(), const_cast<Thread*>(this),
-                                                     skip_depth);
-  if (!build_trace_visitor.Init(depth)) {
-    return NULL;  // Allocation failed.
-  }
-  build_trace_visitor.WalkStack();
-  mirror::ObjectArray<mirror::Object>* trace = build_trace_visitor.GetInternalStackTrace();
-  if (kIsDebugBuild) {
-    for (int32_t i = 0; i < trace->GetLength(); ++i) {
-      CHECK(trace->Get(i) != NULL);
-    }
+  for (int32_t i = 0; i < depth; ++i) {
+    method_trace->Set(i, frames[i].first);
+    dex_pc_trace->Set(i, frames[i].second);
   }
-  return soa.AddLocalReference<jobjectArray>(trace);
+  // Save PC trace in last element of method trace, also places it into the object graph.
+  method_trace->Set(depth, dex_pc_trace);
+  self->last_internal_stack_trace_ = method_trace.get();
+  return soa.AddLocalReference<jobjectArray>(method_trace.get());
 }
 
 jobjectArray Thread::InternalStackTraceToStackTraceElementArray(JNIEnv* env, jobject internal,
@@ -1656,6 +1732,7 @@ static const EntryPointInfo gThreadEntryPointInfo[] = {
   QUICK_ENTRY_POINT_INFO(pJniMethodEndSynchronized),
   QUICK_ENTRY_POINT_INFO(pJniMethodEndWithReference),
   QUICK_ENTRY_POINT_INFO(pJniMethodEndWithReferenceSynchronized),
+  QUICK_ENTRY_POINT_INFO(pJniMethodFastEndWithReference),
   QUICK_ENTRY_POINT_INFO(pLockObject),
   QUICK_ENTRY_POINT_INFO(pUnlockObject),
   QUICK_ENTRY_POINT_INFO(pCmpgDouble),
@@ -1717,6 +1794,7 @@ void Thread::DumpThreadOffset(std::ostream& os, uint32_t offset, size_t size_of_
   DO_THREAD_OFFSET(self_);
   DO_THREAD_OFFSET(stack_end_);
   DO_THREAD_OFFSET(suspend_count_);
+  DO_THREAD_OFFSET(suspend_poll_page_);
   DO_THREAD_OFFSET(thin_lock_id_);
   // DO_THREAD_OFFSET(top_of_managed_stack_);
   // DO_THREAD_OFFSET(top_of_managed_stack_pc_);
@@ -1739,6 +1817,27 @@ void Thread::DumpThreadOffset(std::ostream& os, uint32_t offset, size_t size_of_
   os << offset;
 }
 
+uint32_t Thread::FindCatchBlock(const mirror::ArtMethod* method, mirror::Class* exception_class,
+                                uint32_t dex_pc, bool* has_no_move_exception) {
+  const size_t index = CatchBlockCacheIndex(method, exception_class, dex_pc);
+  if (catch_block_cache_[index].method != method ||
+      catch_block_cache_[index].exception_class != exception_class ||
+      catch_block_cache_[index].dex_pc != dex_pc) {
+    bool no_move_exception = false;
+    catch_block_cache_[index].handler_dex_pc =
+        method->FindCatchBlock(exception_class, dex_pc, &no_move_exception);
+    catch_block_cache_[index].has_no_move_exception = no_move_exception;
+    catch_block_cache_[index].method = method;
+    catch_block_cache_[index].exception_class = exception_class;
+    catch_block_cache_[index].dex_pc = dex_pc;
+  }
+  uint32_t handler_dex_pc = catch_block_cache_[index].handler_dex_pc;
+  if (handler_dex_pc != DexFile::kDexNoIndex) {
+    *has_no_move_exception = catch_block_cache_[index].has_no_move_exception;
+  }
+  return handler_dex_pc;
+}
+
 static const bool kDebugExceptionDelivery = false;
 class CatchBlockStackVisitor : public StackVisitor {
  public:
@@ -1790,11 +1889,26 @@ class CatchBlockStackVisitor : public StackVisitor {
     uint32_t dex_pc = DexFile::kDexNoIndex;
     if (method->IsNative()) {
       native_method_count_++;
+#if !defined(ART_USE_PORTABLE_COMPILER)
+    } else if (!IsShadowFrame()) {
+      // Compiled code comes with a table of the handlers of each call in a try block, look the
+      // handler up by native pc without mapping it to a dex pc and back.
+      uint32_t found_dex_pc;
+      uintptr_t handler_pc = method->FindCatchBlockForQuickPc(to_find_, GetCurrentQuickFramePc(),
+                                                              &found_dex_pc, &clear_exception_);
+      if (found_dex_pc != DexFile::kDexNoIndex) {
+        handler_dex_pc_ = found_dex_pc;
+        handler_quick_frame_pc_ = handler_pc;
+        handler_quick_frame_ = GetCurrentQuickFrame();
+        return false;  // End stack walk.
+      }
+      return true;  // Continue stack walk.
+#endif
     } else {
       dex_pc = GetDexPc();
     }
     if (dex_pc != DexFile::kDexNoIndex) {
-      uint32_t found_dex_pc = method->FindCatchBlock(to_find_, dex_pc, &clear_exception_);
+      uint32_t found_dex_pc = self_->FindCatchBlock(method, to_find_, dex_pc, &clear_exception_);
       if (found_dex_pc != DexFile::kDexNoIndex) {
         handler_dex_pc_ = found_dex_pc;
         handler_quick_frame_pc_ = method->ToNativePc(found_dex_pc);
@@ -2042,12 +2156,11 @@ class ReferenceMapVisitor : public StackVisitor {
         const uint8_t* reg_bitmap = dex_gc_map.FindBitMap(dex_pc);
         DCHECK(reg_bitmap != NULL);
         num_regs = std::min(dex_gc_map.RegWidth() * 8, num_regs);
-        for (size_t reg = 0; reg < num_regs; ++reg) {
-          if (TestBitmap(reg, reg_bitmap)) {
-            mirror::Object* ref = shadow_frame->GetVRegReference(reg);
-            if (ref != NULL) {
-              visitor_(ref, reg, this);
-            }
+        for (size_t reg = NextReference(reg_bitmap, 0, num_regs); reg < num_regs;
+             reg = NextReference(reg_bitmap, reg + 1, num_regs)) {
+          mirror::Object* ref = shadow_frame->GetVRegReference(reg);
+          if (ref != NULL) {
+            visitor_(ref, reg, this);
           }
         }
       }
@@ -2070,27 +2183,33 @@ class ReferenceMapVisitor : public StackVisitor {
           uint32_t core_spills = m->GetCoreSpillMask();
           uint32_t fp_spills = m->GetFpSpillMask();
           size_t frame_size = m->GetFrameSizeInBytes();
+          // Decode the promoted registers once for the frame rather than searching the vmap table
+          // for every reference.
+          uint16_t promoted_vregs[VmapTable::kMaxPromotedCoreRegisters];
+          uint32_t promoted_regs[VmapTable::kMaxPromotedCoreRegisters];
+          size_t num_promoted = vmap_table.DecodeCoreRegisters(core_spills, promoted_vregs,
+                                                               promoted_regs);
           // For all dex registers in the bitmap
           mirror::ArtMethod** cur_quick_frame = GetCurrentQuickFrame();
           DCHECK(cur_quick_frame != NULL);
-          for (size_t reg = 0; reg < num_regs; ++reg) {
-            // Does this register hold a reference?
-            if (TestBitmap(reg, reg_bitmap)) {
-              uint32_t vmap_offset;
-              mirror::Object* ref;
-              if (vmap_table.IsInContext(reg, kReferenceVReg, &vmap_offset)) {
-                uintptr_t val = GetGPR(vmap_table.ComputeRegister(core_spills, vmap_offset,
-                                                                  kReferenceVReg));
-                ref = reinterpret_cast<mirror::Object*>(val);
-              } else {
-                ref = reinterpret_cast<mirror::Object*>(GetVReg(cur_quick_frame, code_item,
-                                                                core_spills, fp_spills, frame_size,
-                                                                reg));
-              }
-
-              if (ref != NULL) {
-                visitor_(ref, reg, this);
-              }
+          for (size_t reg = NextReference(reg_bitmap, 0, num_regs); reg < num_regs;
+               reg = NextReference(reg_bitmap, reg + 1, num_regs)) {
+            size_t promoted_index = 0;
+            while (promoted_index < num_promoted && promoted_vregs[promoted_index] != reg) {
+              ++promoted_index;
+            }
+            mirror::Object* ref;
+            if (promoted_index < num_promoted) {
+              uintptr_t val = GetGPR(promoted_regs[promoted_index]);
+              ref = reinterpret_cast<mirror::Object*>(val);
+            } else {
+              ref = reinterpret_cast<mirror::Object*>(GetVReg(cur_quick_frame, code_item,
+                                                              core_spills, fp_spills, frame_size,
+                                                              reg));
+            }
+
+            if (ref != NULL) {
+              visitor_(ref, reg, this);
             }
           }
         }
@@ -2100,8 +2219,18 @@ class ReferenceMapVisitor : public StackVisitor {
   }
 
  private:
-  static bool TestBitmap(int reg, const uint8_t* reg_vector) {
-    return ((reg_vector[reg / 8] >> (reg % 8)) & 0x01) != 0;
+  // Returns the first register from 'reg' on that holds a reference according to 'reg_vector',
+  // or 'num_regs' if there is none. Whole bytes without references are skipped at once.
+  static size_t NextReference(const uint8_t* reg_vector, size_t reg, size_t num_regs) {
+    while (reg < num_regs) {
+      uint32_t bits = reg_vector[reg / 8] >> (reg % 8);
+      if (bits != 0) {
+        reg += CTZ(bits);
+        return std::min(reg, num_regs);
+      }
+      reg = RoundUp(reg + 1, 8);
+    }
+    return num_regs;
   }
 
   // Visitor for when we visit a root.
@@ -2199,6 +2328,9 @@ void Thread::VisitRoots(RootVisitor* visitor, void* arg) {
     visitor(exception_, arg);
   }
   throw_location_.VisitRoots(visitor, arg);
+  if (last_internal_stack_trace_ != NULL) {
+    visitor(last_internal_stack_trace_, arg);
+  }
   if (class_loader_override_ != NULL) {
     visitor(class_loader_override_, arg);
   }
@@ -2238,8 +2370,9 @@ void Thread::VerifyStackImpl() {
 
 // Set the stack end to that to be used during a stack overflow
 void Thread::SetStackEndForStackOverflow() {
-  // During stack overflow we allow use of the full stack.
-  if (stack_end_ == stack_begin_) {
+  // During stack overflow we allow use of the full stack, down to the protected region. The
+  // probes compiled code makes in it then are skipped, see FaultManager.
+  if (IsHandlingStackOverflow()) {
     // However, we seem to have already extended to use the full stack.
     LOG(ERROR) << "Need to increase kStackOverflowReservedBytes (currently "
                << kStackOverflowReservedBytes << ")?";
@@ -2247,7 +2380,7 @@ void Thread::SetStackEndForStackOverflow() {
     LOG(FATAL) << "Recursive stack overflow.";
   }
 
-  stack_end_ = stack_begin_;
+  stack_end_ = stack_begin_ + kStackOverflowProtectedBytes;
 }
 
 std::ostream& operator<<(std::ostream& os, const Thread& thread) {
@@ -24,6 +24,8 @@
 #include <iosfwd>
 #include <list>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "base/macros.h"
 #include "entrypoints/interpreter/interpreter_entrypoints.h"
@@ -63,6 +65,7 @@ class Closure;
 class Context;
 struct DebugInvokeReq;
 class DexFile;
+class Instruction;
 struct JavaVMExt;
 struct JNIEnvExt;
 class Monitor;
@@ -72,6 +75,8 @@ class ScopedObjectAccessUnchecked;
 class ShadowFrame;
 class Thread;
 class ThreadList;
+class ThreadStackCache;
+class TraceSampleBuffer;
 
 // Thread priorities. These must match the Thread.MIN_PRIORITY,
 // Thread.NORM_PRIORITY, and Thread.MAX_PRIORITY constants.
@@ -84,7 +89,9 @@ enum ThreadPriority {
 enum ThreadFlag {
   kSuspendRequest   = 1,  // If set implies that suspend_count_ > 0 and the Thread should enter the
                           // safepoint handler.
-  kCheckpointRequest = 2  // Request that the thread do some checkpoint work and then continue.
+  kCheckpointRequest = 2,  // Request that the thread do some checkpoint work and then continue.
+  kInstrumentationRequest = 4  // The instrumentation changed while the thread wasn't looking, the
+                               // interpreter picks its handlers again at the next suspend check.
 };
 
 class PACKED(4) Thread {
@@ -92,6 +99,27 @@ class PACKED(4) Thread {
   // Space to throw a StackOverflowError in.
   static const size_t kStackOverflowReservedBytes = 16 * KB;
 
+  // Inaccessible region at the bottom of the stack, below the reserved space. Compiled code
+  // probes below the stack pointer on entry instead of comparing it with the stack end, and the
+  // FaultManager turns a probe that hits this region into a StackOverflowError.
+  static const size_t kStackOverflowProtectedBytes = 4 * KB;
+
+  // How far below the stack pointer compiled code probes. Methods whose frames are smaller than
+  // the protected region can't step over it, and leave the reserved space below their frames.
+  static const size_t kStackOverflowProbeBytes =
+      kStackOverflowReservedBytes + kStackOverflowProtectedBytes;
+
+  // Number of size brackets in the thread-local allocation cache, see
+  // DlMallocSpace::AllocThreadLocal.
+  static const size_t kThreadLocalAllocBracketCount = 16;
+
+  // Number of run alloc space size brackets for which a thread owns its current run.
+  static const size_t kThreadLocalRunBracketCount = 8;
+  static const size_t kInterfaceDispatchCacheSize = 64;
+  static const size_t kInterpreterCacheSize = 256;
+  static const size_t kCatchBlockCacheSize = 64;
+  static const size_t kDexPcCacheSize = 256;
+
   // Creates a new native thread corresponding to the given managed peer.
   // Used to implement Thread.start.
   static void CreateNativeThread(JNIEnv* env, jobject peer, size_t stack_size, bool daemon);
@@ -256,6 +284,10 @@ class PACKED(4) Thread {
     return tid_;
   }
 
+  pthread_t GetPthreadSelf() const {
+    return pthread_self_;
+  }
+
   // Returns the java.lang.Thread's name, or NULL if this Thread* doesn't have a peer.
   mirror::String* GetThreadName(const ScopedObjectAccessUnchecked& ts) const
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
@@ -283,6 +315,141 @@ class PACKED(4) Thread {
     return &stats_;
   }
 
+  // Counts bytes this thread allocated in the heap. Only called by the thread itself.
+  void RecordHeapAllocation(size_t bytes) {
+    heap_bytes_allocated_ += bytes;
+  }
+
+  // Bytes this thread has allocated in the heap, wrapping around at the size of size_t.
+  size_t GetHeapBytesAllocated() const {
+    return heap_bytes_allocated_;
+  }
+
+  // The rate in bytes per second this thread allocated at between the last two GCs.
+  size_t GetHeapAllocationRate() const {
+    return heap_allocation_rate_;
+  }
+
+  // Called by the heap as a GC starts, ms_delta after the previous one. Returns the updated rate.
+  size_t UpdateHeapAllocationRate(uint64_t ms_delta);
+
+  // Records a newly allocated object in this thread's segment of the heap's allocation stack.
+  // Returns false if the thread has no segment or it is full.
+  bool PushOnThreadLocalAllocationStack(mirror::Object* obj) {
+    if (thread_local_alloc_stack_top_ < thread_local_alloc_stack_end_) {
+      *thread_local_alloc_stack_top_++ = obj;
+      return true;
+    }
+    return false;
+  }
+
+  void SetThreadLocalAllocationStack(mirror::Object** start, mirror::Object** end) {
+    thread_local_alloc_stack_top_ = start;
+    thread_local_alloc_stack_end_ = end;
+  }
+
+  // Drops the thread's segment, leaving its unused slots NULL. Only safe while the thread can't
+  // allocate, the heap does it before the allocation stack is swapped out or emptied.
+  void RevokeThreadLocalAllocationStack() {
+    thread_local_alloc_stack_top_ = NULL;
+    thread_local_alloc_stack_end_ = NULL;
+  }
+
+  // Head of the free list of pre-allocated alloc space chunks for the given size bracket.
+  void* GetThreadLocalAllocCache(size_t bracket) const {
+    DCHECK_LT(bracket, kThreadLocalAllocBracketCount);
+    return thread_local_alloc_cache_[bracket];
+  }
+
+  void SetThreadLocalAllocCache(size_t bracket, void* head) {
+    DCHECK_LT(bracket, kThreadLocalAllocBracketCount);
+    thread_local_alloc_cache_[bracket] = head;
+  }
+
+  // The run alloc space run the thread allocates from for the given size bracket.
+  void* GetThreadLocalRun(size_t bracket) const {
+    DCHECK_LT(bracket, kThreadLocalRunBracketCount);
+    return thread_local_runs_[bracket];
+  }
+
+  void SetThreadLocalRun(size_t bracket, void* run) {
+    DCHECK_LT(bracket, kThreadLocalRunBracketCount);
+    thread_local_runs_[bracket] = run;
+  }
+
+  // Returns the implementation of interface_method in klass if this thread dispatched it recently,
+  // otherwise NULL.
+  mirror::ArtMethod* LookupInterfaceDispatch(const mirror::Class* klass,
+                                             const mirror::ArtMethod* interface_method) const {
+    const size_t index = InterfaceDispatchIndex(klass, interface_method);
+    if (interface_dispatch_cache_[index].klass == klass &&
+        interface_dispatch_cache_[index].interface_method == interface_method) {
+      return interface_dispatch_cache_[index].method;
+    }
+    return NULL;
+  }
+
+  void AddInterfaceDispatch(const mirror::Class* klass, const mirror::ArtMethod* interface_method,
+                            mirror::ArtMethod* method) {
+    const size_t index = InterfaceDispatchIndex(klass, interface_method);
+    interface_dispatch_cache_[index].klass = klass;
+    interface_dispatch_cache_[index].interface_method = interface_method;
+    interface_dispatch_cache_[index].method = method;
+  }
+
+  // Makes the next call into compiled code continue at the loop header at dex_pc with the
+  // Dalvik registers in vregs, instead of starting at the beginning of the method. The compiled
+  // code clears the request when it takes it.
+  void SetOsrEntry(const uint32_t* vregs, uint32_t dex_pc) {
+    osr_vregs_ = vregs;
+    osr_dex_pc_ = dex_pc;
+  }
+
+  // Returns the field or method the interpreter resolved for a field access or invoke
+  // instruction if this thread executed it recently, otherwise NULL.
+  const void* LookupInterpreterCache(const Instruction* inst) const {
+    const size_t index = InterpreterCacheIndex(inst);
+    if (interpreter_cache_[index].inst == inst) {
+      return interpreter_cache_[index].value;
+    }
+    return NULL;
+  }
+
+  void AddInterpreterCache(const Instruction* inst, const void* value) {
+    const size_t index = InterpreterCacheIndex(inst);
+    interpreter_cache_[index].inst = inst;
+    interpreter_cache_[index].value = value;
+  }
+
+  // Sets *dex_pc to the dex pc the native pc in method's compiled code maps to and returns true if
+  // this thread mapped it recently, otherwise returns false.
+  bool LookupDexPc(const mirror::ArtMethod* method, uintptr_t pc, uint32_t* dex_pc) const {
+    const size_t index = DexPcCacheIndex(method, pc);
+    if (dex_pc_cache_[index].pc == pc && dex_pc_cache_[index].method == method) {
+      *dex_pc = dex_pc_cache_[index].dex_pc;
+      return true;
+    }
+    return false;
+  }
+
+  void AddDexPc(const mirror::ArtMethod* method, uintptr_t pc, uint32_t dex_pc) {
+    const size_t index = DexPcCacheIndex(method, pc);
+    dex_pc_cache_[index].method = method;
+    dex_pc_cache_[index].pc = pc;
+    dex_pc_cache_[index].dex_pc = dex_pc;
+  }
+
+  // Forgets the native to dex pc mappings of compiled code that is about to be freed. Only called
+  // while the thread is suspended.
+  void ClearDexPcCache();
+
+  // Returns the dex pc of the handler in method for an exception of exception_class thrown at
+  // dex_pc, or DexFile::kDexNoIndex if there is none, like ArtMethod::FindCatchBlock but answering
+  // repeated lookups from this thread's cache.
+  uint32_t FindCatchBlock(const mirror::ArtMethod* method, mirror::Class* exception_class,
+                          uint32_t dex_pc, bool* has_no_move_exception)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
   bool IsStillStarting() const;
 
   bool IsExceptionPending() const {
@@ -439,6 +606,24 @@ class PACKED(4) Thread {
     return ThreadOffset(OFFSETOF_MEMBER(Thread, state_and_flags_));
   }
 
+  static ThreadOffset OsrVRegsOffset() {
+    return ThreadOffset(OFFSETOF_MEMBER(Thread, osr_vregs_));
+  }
+
+  static ThreadOffset OsrDexPcOffset() {
+    return ThreadOffset(OFFSETOF_MEMBER(Thread, osr_dex_pc_));
+  }
+
+  static ThreadOffset SuspendPollPageOffset() {
+    return ThreadOffset(OFFSETOF_VOLATILE_MEMBER(Thread, suspend_poll_page_));
+  }
+
+  // The inaccessible page the suspend polls of compiled code read while a suspend or checkpoint
+  // request is pending.
+  static const byte* GetSuspendTriggerPage() {
+    return poll_pages_ + kPageSize;
+  }
+
   // Size of stack less any space reserved for stack overflow
   size_t GetStackSize() const {
     return stack_size_ - (stack_end_ - stack_begin_);
@@ -454,12 +639,12 @@ class PACKED(4) Thread {
   // Set the stack end to that to be used during regular execution
   void ResetDefaultStackEnd() {
     // Our stacks grow down, so we want stack_end_ to be near there, but reserving enough room
-    // to throw a StackOverflowError.
-    stack_end_ = stack_begin_ + kStackOverflowReservedBytes;
+    // above the protected region to throw a StackOverflowError.
+    stack_end_ = stack_begin_ + kStackOverflowProtectedBytes + kStackOverflowReservedBytes;
   }
 
   bool IsHandlingStackOverflow() const {
-    return stack_end_ == stack_begin_;
+    return stack_end_ == stack_begin_ + kStackOverflowProtectedBytes;
   }
 
   static ThreadOffset StackEndOffset() {
@@ -560,10 +745,78 @@ class PACKED(4) Thread {
     stack_trace_sample_ = sample;
   }
 
+  TraceSampleBuffer* GetTraceSampleBuffer() const {
+    return trace_sample_buffer_;
+  }
+
+  void SetTraceSampleBuffer(TraceSampleBuffer* buffer) {
+    trace_sample_buffer_ = buffer;
+  }
+
+  // The part of the method trace's buffer this thread records its events into.
+  uint8_t* GetTraceBufferPos() const {
+    return trace_buffer_pos_;
+  }
+
+  uint8_t* GetTraceBufferEnd() const {
+    return trace_buffer_end_;
+  }
+
+  void SetTraceBuffer(uint8_t* pos, uint8_t* end) {
+    trace_buffer_pos_ = pos;
+    trace_buffer_end_ = end;
+  }
+
+  void SetTraceBufferPos(uint8_t* pos) {
+    trace_buffer_pos_ = pos;
+  }
+
+  // Bytes this thread may allocate before its next allocation is sampled.
+  ssize_t GetAllocSampleBytesLeft() const {
+    return alloc_sample_bytes_left_;
+  }
+
+  void SetAllocSampleBytesLeft(ssize_t bytes_left) {
+    alloc_sample_bytes_left_ = bytes_left;
+  }
+
+  // Notes that the collection identified by 'scan_id' scanned the roots of this thread while it
+  // was suspended.
+  void SetRootsScanned(uint32_t scan_id) {
+    roots_scan_id_ = scan_id;
+    roots_scan_generation_ = roots_generation_;
+  }
+
+  // Returns true if the collection identified by 'scan_id' scanned the roots of this thread while
+  // it was suspended, and since then the thread hasn't been runnable nor been resumed by a
+  // ResumeAll, so its roots can't have changed.
+  bool AreRootsUnchangedSinceScan(uint32_t scan_id) const {
+    return roots_scan_id_ == scan_id && roots_scan_generation_ == roots_generation_;
+  }
+
+  // Called when another thread changes the roots of this suspended thread, such as a debugger
+  // setting a local. ResumeAll calls it for every thread it resumes, which covers the changes
+  // made while all threads are suspended.
+  void NoteRootsChanged() {
+    ++roots_generation_;
+  }
+
   uint64_t GetTraceClockBase() const {
     return trace_clock_base_;
   }
 
+  // The thread CPU time the method trace last read from the kernel, the cycle counter then, and
+  // the last estimate of the CPU time made from the two.
+  struct TraceCpuClock {
+    uint64_t sample_cycles;
+    uint64_t sample_us;
+    uint64_t last_us;
+  };
+
+  TraceCpuClock* GetTraceCpuClock() {
+    return &trace_cpu_clock_;
+  }
+
   void SetTraceClockBase(uint64_t clock_base) {
     trace_clock_base_ = clock_base;
   }
@@ -590,6 +843,10 @@ class PACKED(4) Thread {
 
   void AtomicClearFlag(ThreadFlag flag);
 
+  // Points the suspend polls at the trigger page if a flag is set, and at a readable page if not.
+  // Called after every change of the flags.
+  void UpdateSuspendPollPage();
+
  private:
   // We have no control over the size of 'bool', but want our boolean fields
   // to be 4-byte quantities.
@@ -609,6 +866,9 @@ class PACKED(4) Thread {
   ThreadState SetStateUnsafe(ThreadState new_state) {
     ThreadState old_state = GetState();
     state_and_flags_.as_struct.state = new_state;
+    if (new_state == kRunnable) {
+      ++roots_generation_;
+    }
     return old_state;
   }
   friend class SignalCatcher;  // For SetStateUnsafe.
@@ -639,6 +899,9 @@ class PACKED(4) Thread {
   void InitTid();
   void InitPthreadKeySelf();
   void InitStackHwm();
+  // Makes the protected region at the bottom of the stack inaccessible, or accessible again.
+  // Returns false if that isn't possible, as for a main thread stack that hasn't grown that far.
+  bool ProtectStackGuard(bool protect);
 
   void SetUpAlternateSignalStack();
   void TearDownAlternateSignalStack();
@@ -650,9 +913,16 @@ class PACKED(4) Thread {
   // Has Thread::Startup been called?
   static bool is_started_;
 
+  // Stacks of threads created by CreateNativeThread. Never freed: a thread may release its stack
+  // after the runtime has shut down.
+  static ThreadStackCache* stack_cache_;
+
   // TLS key used to retrieve the Thread*.
   static pthread_key_t pthread_key_self_;
 
+  // A readable page followed by the suspend trigger page, see suspend_poll_page_.
+  static byte* poll_pages_;
+
   // Used to notify threads that they should attempt to resume, they will suspend again if
   // their suspend count is > 0.
   static ConditionVariable* resume_cond_ GUARDED_BY(Locks::thread_suspend_count_lock_);
@@ -717,9 +987,31 @@ class PACKED(4) Thread {
   // Pointer to previous stack trace captured by sampling profiler.
   std::vector<mirror::ArtMethod*>* stack_trace_sample_;
 
+  // Samples recorded by this thread's SIGPROF handler for the sampling profiler. Only freed with
+  // the thread, so that a late signal never writes to freed memory.
+  TraceSampleBuffer* volatile trace_sample_buffer_;
+
+  // Next free byte and end of the chunk of the method trace's buffer this thread records into.
+  uint8_t* trace_buffer_pos_;
+  uint8_t* trace_buffer_end_;
+
   // The clock base used for tracing.
   uint64_t trace_clock_base_;
 
+  TraceCpuClock trace_cpu_clock_;
+
+  // Countdown to the next allocation sample taken by the heap's AllocationSampler.
+  ssize_t alloc_sample_bytes_left_;
+
+  // Bumped each time the thread becomes runnable, as its roots may change from then on, and
+  // whenever another thread may have changed them.
+  uint32_t roots_generation_;
+
+  // The collection that last scanned the roots of this thread while it was suspended, and the
+  // roots generation at the time.
+  uint32_t roots_scan_id_;
+  uint32_t roots_scan_generation_;
+
   // Thin lock thread id. This is a small integer used by the thin lock implementation.
   // This is not to be confused with the native thread's tid, nor is it the value returned
   // by java.lang.Thread.getId --- this is a distinct value, used only for locking. One
@@ -812,6 +1104,114 @@ class PACKED(4) Thread {
   // How many times has our pthread key's destructor been called?
   uint32_t thread_exit_check_count_;
 
+  // Bytes allocated in the heap by this thread, and how many of them were allocated when the last
+  // GC started. Plain counters, as only this thread writes the first and only the GC the second.
+  size_t heap_bytes_allocated_;
+  size_t heap_bytes_allocated_at_last_gc_;
+
+  // Allocation rate in bytes per second, see UpdateHeapAllocationRate.
+  size_t heap_allocation_rate_;
+
+  // The segment of the heap's allocation stack this thread records its allocations in: the next
+  // free slot and the end of the segment.
+  mirror::Object** thread_local_alloc_stack_top_;
+  mirror::Object** thread_local_alloc_stack_end_;
+
+  // Free lists of alloc space chunks handed out to this thread in bulk, indexed by size bracket.
+  // Chunks are linked through their first word and are only touched by the owning thread, except
+  // when the heap revokes them while the thread can't allocate.
+  void* thread_local_alloc_cache_[kThreadLocalAllocBracketCount];
+
+  // Current runs of the run alloc space owned by this thread, indexed by size bracket.
+  void* thread_local_runs_[kThreadLocalRunBracketCount];
+
+  static size_t InterfaceDispatchIndex(const mirror::Class* klass,
+                                       const mirror::ArtMethod* interface_method) {
+    // Objects are 8 byte aligned, drop the bits that are always zero.
+    const uintptr_t hash = (reinterpret_cast<uintptr_t>(klass) >> 3) ^
+        (reinterpret_cast<uintptr_t>(interface_method) >> 3);
+    return (hash ^ (hash >> 6)) & (kInterfaceDispatchCacheSize - 1);
+  }
+
+  // Direct mapped cache of interface dispatch targets, keyed by receiver class and interface
+  // method. Classes and methods are never unloaded or moved, so entries don't need to be visited
+  // by the GC nor invalidated.
+  struct InterfaceDispatchEntry {
+    const mirror::Class* klass;
+    const mirror::ArtMethod* interface_method;
+    mirror::ArtMethod* method;
+  };
+  InterfaceDispatchEntry interface_dispatch_cache_[kInterfaceDispatchCacheSize];
+
+  static size_t InterpreterCacheIndex(const Instruction* inst) {
+    // Dex instructions are 2 byte aligned.
+    const uintptr_t hash = reinterpret_cast<uintptr_t>(inst) >> 1;
+    return (hash ^ (hash >> 8)) & (kInterpreterCacheSize - 1);
+  }
+
+  // Direct mapped cache of what field access and invoke instructions resolved to, keyed by the
+  // address of the instruction. Dex files stay mapped and fields and methods are never unloaded
+  // or moved, so like the interface dispatch cache it needs no visiting nor invalidation.
+  struct InterpreterCacheEntry {
+    const Instruction* inst;
+    const void* value;
+  };
+  InterpreterCacheEntry interpreter_cache_[kInterpreterCacheSize];
+
+  // Pending on-stack replacement request, see SetOsrEntry. NULL vregs when there is none.
+  const uint32_t* osr_vregs_;
+  uint32_t osr_dex_pc_;
+
+  // The page compiled code loads from to check for suspension on x86, where testing the flags
+  // takes a load, a compare and a branch. The load faults while a request is pending, and the
+  // FaultManager turns the fault into a call of the suspend check entrypoint.
+  const byte* volatile suspend_poll_page_;
+
+  static size_t CatchBlockCacheIndex(const mirror::ArtMethod* method,
+                                     const mirror::Class* exception_class, uint32_t dex_pc) {
+    const uintptr_t hash = (reinterpret_cast<uintptr_t>(method) >> 3) ^
+        (reinterpret_cast<uintptr_t>(exception_class) >> 3) ^ dex_pc;
+    return (hash ^ (hash >> 6)) & (kCatchBlockCacheSize - 1);
+  }
+
+  // Direct mapped cache of catch block lookups, so that exceptions thrown and caught over and over
+  // don't search the method's try items and check the handlers' types each time. Handler types
+  // are resolved by the verifier and methods and classes are never unloaded or moved, so an
+  // answer never changes and entries need no visiting nor invalidation.
+  struct CatchBlockCacheEntry {
+    const mirror::ArtMethod* method;
+    const mirror::Class* exception_class;
+    uint32_t dex_pc;
+    uint32_t handler_dex_pc;
+    bool32_t has_no_move_exception;
+  };
+  CatchBlockCacheEntry catch_block_cache_[kCatchBlockCacheSize];
+
+  static size_t DexPcCacheIndex(const mirror::ArtMethod* method, uintptr_t pc) {
+    // Return addresses are at least 2 byte aligned.
+    const uintptr_t hash = (pc >> 1) ^ (reinterpret_cast<uintptr_t>(method) >> 3);
+    return (hash ^ (hash >> 8)) & (kDexPcCacheSize - 1);
+  }
+
+  // Direct mapped cache of the dex pcs native pcs in compiled code map to, keyed by method and
+  // native pc, so that walking the same frames over and over, as GC root scanning, exception
+  // delivery and stack traces do, doesn't scan the mapping table each time. Oat code is never
+  // unloaded and the hot method compiler clears every thread's cache before it frees code.
+  struct DexPcCacheEntry {
+    const mirror::ArtMethod* method;
+    uintptr_t pc;
+    uint32_t dex_pc;
+  };
+  DexPcCacheEntry dex_pc_cache_[kDexPcCacheSize];
+
+  // The (method, dex pc) frames of the stack trace being built, kept between traces so capturing
+  // one doesn't allocate. Stored as a pointer since std::vector is not PACKED.
+  std::vector<std::pair<mirror::ArtMethod*, uint32_t> >* stack_trace_scratch_;
+
+  // The internal stack trace this thread built last. The next one with the same frames, as when
+  // the same exception is thrown over and over, shares it rather than allocating its own.
+  mirror::ObjectArray<mirror::Object>* last_internal_stack_trace_;
+
   friend class ScopedThreadStateChange;
 
   DISALLOW_COPY_AND_ASSIGN(Thread);
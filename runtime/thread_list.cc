@@ -20,11 +20,13 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include "base/histogram-inl.h"
 #include "base/mutex.h"
 #include "base/mutex-inl.h"
 #include "base/timing_logger.h"
 #include "debugger.h"
 #include "thread.h"
+#include "trace.h"
 #include "utils.h"
 
 namespace art {
@@ -32,7 +34,11 @@ namespace art {
 ThreadList::ThreadList()
     : allocated_ids_lock_("allocated thread ids lock"),
       suspend_all_count_(0), debug_suspend_all_count_(0),
-      thread_exit_cond_("thread exit condition variable", *Locks::thread_list_lock_) {
+      thread_exit_cond_("thread exit condition variable", *Locks::thread_list_lock_),
+      suspend_all_stats_lock_("suspend all stats lock"),
+      time_to_safepoint_histogram_("time to safepoint", 50),
+      long_suspend_all_count_(0), max_time_to_safepoint_(0), max_time_to_safepoint_tid_(0),
+      max_time_to_safepoint_method_(NULL), max_time_to_safepoint_dex_pc_(0) {
 }
 
 ThreadList::~ThreadList() {
@@ -67,6 +73,7 @@ pid_t ThreadList::GetLockOwner() {
 }
 
 void ThreadList::DumpForSigQuit(std::ostream& os) {
+  DumpSuspendAllStats(os);
   {
     MutexLock mu(Thread::Current(), *Locks::thread_list_lock_);
     DumpLocked(os);
@@ -233,6 +240,7 @@ void ThreadList::SuspendAll() {
     Locks::thread_suspend_count_lock_->AssertNotHeld(self);
     CHECK_NE(self->GetState(), kRunnable);
   }
+  const uint64_t start_time = NanoTime();
   {
     MutexLock mu(self, *Locks::thread_list_lock_);
     {
@@ -251,10 +259,20 @@ void ThreadList::SuspendAll() {
   }
 
   // Block on the mutator lock until all Runnable threads release their share of access.
+  pid_t straggler_tid = 0;
 #if HAVE_TIMED_RWLOCK
-  // Timeout if we wait more than 30 seconds.
-  if (UNLIKELY(!Locks::mutator_lock_->ExclusiveLockWithTimeout(self, 30 * 1000, 0))) {
-    UnsafeLogFatalForThreadSuspendAllTimeout(self);
+  // Wait in steps past the log threshold, noting a thread that is still running each time, so
+  // that the slowest thread can be reported. Timeout if we wait more than 30 seconds.
+  const uint64_t threshold = kDefaultLongSuspendAllLogThreshold;
+  const uint64_t one_ms = MsToNs(1);
+  if (UNLIKELY(!Locks::mutator_lock_->ExclusiveLockWithTimeout(self, threshold / one_ms,
+                                                               threshold % one_ms))) {
+    do {
+      straggler_tid = FindRunnableThread(self);
+      if (NanoTime() - start_time > MsToNs(30 * 1000)) {
+        UnsafeLogFatalForThreadSuspendAllTimeout(self);
+      }
+    } while (!Locks::mutator_lock_->ExclusiveLockWithTimeout(self, 1, 0));
   }
 #else
   Locks::mutator_lock_->ExclusiveLock(self);
@@ -263,9 +281,90 @@ void ThreadList::SuspendAll() {
   // Debug check that all threads are suspended.
   AssertThreadsAreSuspended(self, self);
 
+  RecordTimeToSafepoint(self, NanoTime() - start_time, straggler_tid);
+
   VLOG(threads) << *self << " SuspendAll complete";
 }
 
+pid_t ThreadList::FindRunnableThread(Thread* self) {
+  MutexLock mu(self, *Locks::thread_list_lock_);
+  for (const auto& thread : list_) {
+    // Racy as the thread may be changing state, but this is only used for diagnostics.
+    if (thread != self && thread->GetState() == kRunnable) {
+      return thread->GetTid();
+    }
+  }
+  return 0;
+}
+
+void ThreadList::RecordTimeToSafepoint(Thread* self, uint64_t time_to_safepoint,
+                                       pid_t straggler_tid) {
+  const bool is_long = time_to_safepoint > kDefaultLongSuspendAllLogThreshold;
+  // All threads are suspended, so the straggler's stack shows where it reached the safepoint.
+  mirror::ArtMethod* method = NULL;
+  uint32_t dex_pc = 0;
+  std::string straggler_name;
+  if (is_long && straggler_tid != 0) {
+    MutexLock mu(self, *Locks::thread_list_lock_);
+    for (const auto& thread : list_) {
+      if (thread->GetTid() == straggler_tid) {
+        method = thread->GetCurrentMethod(&dex_pc);
+        std::ostringstream oss;
+        oss << *thread;
+        straggler_name = oss.str();
+        break;
+      }
+    }
+  }
+  {
+    MutexLock mu(self, suspend_all_stats_lock_);
+    time_to_safepoint_histogram_.AddValue(time_to_safepoint / 1000);
+    if (is_long) {
+      ++long_suspend_all_count_;
+    }
+    if (time_to_safepoint > max_time_to_safepoint_) {
+      max_time_to_safepoint_ = time_to_safepoint;
+      max_time_to_safepoint_tid_ = straggler_name.empty() ? 0 : straggler_tid;
+      max_time_to_safepoint_method_ = method;
+      max_time_to_safepoint_dex_pc_ = dex_pc;
+    }
+  }
+  if (is_long) {
+    std::ostringstream oss;
+    oss << "Suspending all threads took " << PrettyDuration(time_to_safepoint);
+    if (!straggler_name.empty()) {
+      oss << ", slowest thread " << straggler_name;
+      if (method != NULL) {
+        oss << " stopped at " << PrettyMethod(method) << " dex pc " << dex_pc;
+      }
+    }
+    LOG(INFO) << oss.str();
+  }
+}
+
+void ThreadList::DumpSuspendAllStats(std::ostream& os) {
+  MutexLock mu(Thread::Current(), suspend_all_stats_lock_);
+  if (time_to_safepoint_histogram_.SampleSize() == 0) {
+    return;
+  }
+  os << "Suspend all: " << time_to_safepoint_histogram_.SampleSize() << " times, "
+     << long_suspend_all_count_ << " longer than "
+     << PrettyDuration(kDefaultLongSuspendAllLogThreshold) << "\n";
+  Histogram<uint64_t>::CumulativeData data;
+  time_to_safepoint_histogram_.CreateHistogram(data);
+  time_to_safepoint_histogram_.PrintConfidenceIntervals(os, 0.99, data);
+  if (max_time_to_safepoint_tid_ != 0) {
+    os << "Slowest suspend all took " << PrettyDuration(max_time_to_safepoint_)
+       << " waiting for tid=" << max_time_to_safepoint_tid_;
+    if (max_time_to_safepoint_method_ != NULL) {
+      os << " stopped at " << PrettyMethod(max_time_to_safepoint_method_)
+         << " dex pc " << max_time_to_safepoint_dex_pc_;
+    }
+    os << "\n";
+  }
+  os << "\n";
+}
+
 void ThreadList::ResumeAll() {
   Thread* self = Thread::Current();
 
@@ -285,6 +384,9 @@ void ThreadList::ResumeAll() {
       if (thread == self) {
         continue;
       }
+      // Whoever suspended everything may have changed the roots of the others, such as their
+      // instrumentation stacks, so a collection can't rely on an earlier scan of them.
+      thread->NoteRootsChanged();
       thread->ModifySuspendCount(self, -1, false);
     }
 
@@ -540,6 +642,7 @@ void ThreadList::Unregister(Thread* self) {
     // Note: we don't take the thread_suspend_count_lock_ here as to be suspending a thread other
     // than yourself you need to hold the thread_list_lock_ (see Thread::ModifySuspendCount).
     if (!self->IsSuspended()) {
+      Trace::RetireThreadBuffer(self);
       list_.remove(self);
       delete self;
       self = NULL;
@@ -17,8 +17,10 @@
 #ifndef ART_RUNTIME_THREAD_LIST_H_
 #define ART_RUNTIME_THREAD_LIST_H_
 
+#include "base/histogram.h"
 #include "base/mutex.h"
 #include "root_visitor.h"
+#include "utils.h"
 
 #include <bitset>
 #include <list>
@@ -28,17 +30,23 @@ class Closure;
 class Thread;
 class TimingLogger;
 
+namespace mirror {
+  class ArtMethod;
+}  // namespace mirror
+
 class ThreadList {
  public:
   static const uint32_t kMaxThreadId = 0xFFFF;
   static const uint32_t kInvalidId = 0;
   static const uint32_t kMainId = 1;
+  // SuspendAll calls that take longer than this to reach a safepoint are logged.
+  static constexpr uint64_t kDefaultLongSuspendAllLogThreshold = MsToNs(1);
 
   explicit ThreadList();
   ~ThreadList();
 
   void DumpForSigQuit(std::ostream& os)
-      LOCKS_EXCLUDED(Locks::thread_list_lock_)
+      LOCKS_EXCLUDED(Locks::thread_list_lock_, suspend_all_stats_lock_)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
   void DumpLocked(std::ostream& os)  // For thread suspend timeout dumps.
       EXCLUSIVE_LOCKS_REQUIRED(Locks::thread_list_lock_)
@@ -57,7 +65,13 @@ class ThreadList {
   void SuspendAll()
       EXCLUSIVE_LOCK_FUNCTION(Locks::mutator_lock_)
       LOCKS_EXCLUDED(Locks::thread_list_lock_,
-                     Locks::thread_suspend_count_lock_);
+                     Locks::thread_suspend_count_lock_,
+                     suspend_all_stats_lock_);
+
+  // Dumps the distribution of SuspendAll time-to-safepoint and its worst case.
+  void DumpSuspendAllStats(std::ostream& os)
+      LOCKS_EXCLUDED(suspend_all_stats_lock_)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
 
   // Run a checkpoint on threads, running threads are not suspended but run the checkpoint inside
   // of the suspend check. Returns how many checkpoints we should expect to run.
@@ -122,6 +136,16 @@ class ThreadList {
       LOCKS_EXCLUDED(Locks::thread_list_lock_,
                      Locks::thread_suspend_count_lock_);
 
+  // Returns the tid of a thread other than self that is still runnable, or 0 if there are none.
+  pid_t FindRunnableThread(Thread* self) LOCKS_EXCLUDED(Locks::thread_list_lock_);
+
+  // Records how long a SuspendAll took to reach a safepoint, logging it along with where the
+  // slowest thread stopped if it took too long. 'straggler_tid' is a thread that was still
+  // runnable shortly before all threads suspended, or 0 if none was seen.
+  void RecordTimeToSafepoint(Thread* self, uint64_t time_to_safepoint, pid_t straggler_tid)
+      EXCLUSIVE_LOCKS_REQUIRED(Locks::mutator_lock_)
+      LOCKS_EXCLUDED(Locks::thread_list_lock_, suspend_all_stats_lock_);
+
   mutable Mutex allocated_ids_lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
   std::bitset<kMaxThreadId> allocated_ids_ GUARDED_BY(allocated_ids_lock_);
 
@@ -135,6 +159,17 @@ class ThreadList {
   // Signaled when threads terminate. Used to determine when all non-daemons have terminated.
   ConditionVariable thread_exit_cond_ GUARDED_BY(Locks::thread_list_lock_);
 
+  Mutex suspend_all_stats_lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
+  // Time from SuspendAll requesting suspension until all threads are suspended, in microseconds.
+  Histogram<uint64_t> time_to_safepoint_histogram_ GUARDED_BY(suspend_all_stats_lock_);
+  // Number of SuspendAll calls over kDefaultLongSuspendAllLogThreshold.
+  size_t long_suspend_all_count_ GUARDED_BY(suspend_all_stats_lock_);
+  // The slowest SuspendAll so far, and where its slowest thread reached the safepoint.
+  uint64_t max_time_to_safepoint_ GUARDED_BY(suspend_all_stats_lock_);
+  pid_t max_time_to_safepoint_tid_ GUARDED_BY(suspend_all_stats_lock_);
+  const mirror::ArtMethod* max_time_to_safepoint_method_ GUARDED_BY(suspend_all_stats_lock_);
+  uint32_t max_time_to_safepoint_dex_pc_ GUARDED_BY(suspend_all_stats_lock_);
+
   friend class Thread;
 
   DISALLOW_COPY_AND_ASSIGN(ThreadList);
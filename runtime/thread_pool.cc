@@ -16,8 +16,13 @@
 
 #include "thread_pool.h"
 
+#include <sched.h>
+
+#include <ostream>
+
 #include "base/casts.h"
 #include "base/stl_util.h"
+#include "numa.h"
 #include "runtime.h"
 #include "thread.h"
 
@@ -29,7 +34,10 @@ ThreadPoolWorker::ThreadPoolWorker(ThreadPool* thread_pool, const std::string& n
                                    size_t stack_size)
     : thread_pool_(thread_pool),
       name_(name),
-      stack_size_(stack_size) {
+      stack_size_(stack_size),
+      thread_(NULL),
+      tid_(0),
+      busy_ns_(0) {
   const char* reason = "new thread pool worker thread";
   pthread_attr_t attr;
   CHECK_PTHREAD_CALL(pthread_attr_init, (&attr), reason);
@@ -47,8 +55,10 @@ void ThreadPoolWorker::Run() {
   Task* task = NULL;
   thread_pool_->creation_barier_.Wait(self);
   while ((task = thread_pool_->GetTask(self)) != NULL) {
+    const uint64_t start = NanoTime();
     task->Run(self);
     task->Finalize();
+    busy_ns_ += NanoTime() - start;
   }
 }
 
@@ -56,15 +66,22 @@ void* ThreadPoolWorker::Callback(void* arg) {
   ThreadPoolWorker* worker = reinterpret_cast<ThreadPoolWorker*>(arg);
   Runtime* runtime = Runtime::Current();
   CHECK(runtime->AttachCurrentThread(worker->name_.c_str(), true, NULL, false));
+  worker->thread_ = Thread::Current();
+  worker->tid_ = GetTid();
   // Do work until its time to shut down.
   worker->Run();
   runtime->DetachCurrentThread();
   return NULL;
 }
 
-void ThreadPool::AddTask(Thread* self, Task* task) {
+void ThreadPool::AddTask(Thread* self, Task* task, TaskPriority priority) {
   MutexLock mu(self, task_queue_lock_);
-  tasks_.push_back(task);
+  ThreadPoolWorker* worker = (priority == kTaskPriorityNormal) ? FindWorker(self) : NULL;
+  if (worker != NULL) {
+    worker->local_tasks_.push_back(task);
+  } else {
+    tasks_[priority].push_back(task);
+  }
   // If we have any waiters, signal one.
   if (started_ && waiting_count_ != 0) {
     task_queue_condition_.Signal(self);
@@ -82,7 +99,10 @@ ThreadPool::ThreadPool(size_t num_threads)
     total_wait_time_(0),
     // Add one since the caller of constructor waits on the barrier too.
     creation_barier_(num_threads + 1),
-    max_active_workers_(num_threads) {
+    max_active_workers_(num_threads),
+    tasks_run_(0),
+    tasks_stolen_(0),
+    idle_ns_(0) {
   Thread* self = Thread::Current();
   while (GetThreadCount() < num_threads) {
     const std::string name = StringPrintf("Thread pool worker %zu", GetThreadCount());
@@ -98,6 +118,52 @@ void ThreadPool::SetMaxActiveWorkers(size_t threads) {
   max_active_workers_ = threads;
 }
 
+#if defined(__linux__)
+void ThreadPool::PinWorker(ThreadPoolWorker* worker, const std::vector<int>& cpus) {
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  for (size_t i = 0; i < cpus.size(); ++i) {
+    CPU_SET(cpus[i], &cpu_set);
+  }
+  if (sched_setaffinity(worker->tid_, sizeof(cpu_set), &cpu_set) != 0) {
+    PLOG(WARNING) << "Failed to pin " << worker->name_ << " to CPU " << cpus[0]
+                  << (cpus.size() > 1 ? " and others" : "");
+  }
+}
+#endif
+
+void ThreadPool::SetWorkerCpus(const std::vector<int>& cpus) {
+  CHECK(!cpus.empty());
+#if defined(__linux__)
+  for (size_t i = 0; i < threads_.size(); ++i) {
+    PinWorker(threads_[i], std::vector<int>(1, cpus[i % cpus.size()]));
+  }
+#endif
+}
+
+void ThreadPool::SetWorkerNumaNodes() {
+  const size_t num_nodes = Numa::NumNodes();
+  if (num_nodes == 1) {
+    return;
+  }
+#if defined(__linux__)
+  for (size_t i = 0; i < threads_.size(); ++i) {
+    PinWorker(threads_[i], Numa::NodeCpus(i % num_nodes));
+  }
+#endif
+}
+
+void ThreadPool::DumpStats(std::ostream& os) {
+  uint64_t busy_ns = 0;
+  for (size_t i = 0; i < threads_.size(); ++i) {
+    busy_ns += threads_[i]->busy_ns_;
+  }
+  MutexLock mu(Thread::Current(), task_queue_lock_);
+  os << GetThreadCount() << " workers, " << tasks_run_ << " tasks run, " << tasks_stolen_
+     << " stolen, busy " << PrettyDuration(busy_ns) << ", idle " << PrettyDuration(idle_ns_)
+     << "\n";
+}
+
 ThreadPool::~ThreadPool() {
   {
     Thread* self = Thread::Current();
@@ -140,14 +206,17 @@ Task* ThreadPool::GetTask(Thread* self) {
     }
 
     ++waiting_count_;
-    if (waiting_count_ == GetThreadCount() && tasks_.empty()) {
+    if (waiting_count_ == GetThreadCount() && !HasTasksLocked()) {
       // We may be done, lets broadcast to the completion condition.
       completion_condition_.Broadcast(self);
     }
-    const uint64_t wait_start = kMeasureWaitTime ? NanoTime() : 0;
+    const uint64_t wait_start = NanoTime();
     task_queue_condition_.Wait(self);
+    const uint64_t wait_end = NanoTime();
+    if (started_) {
+      idle_ns_ += wait_end - wait_start;
+    }
     if (kMeasureWaitTime) {
-      const uint64_t wait_end = NanoTime();
       total_wait_time_ += wait_end - std::max(wait_start, start_time_);
     }
     --waiting_count_;
@@ -162,15 +231,61 @@ Task* ThreadPool::TryGetTask(Thread* self) {
   return TryGetTaskLocked(self);
 }
 
-Task* ThreadPool::TryGetTaskLocked(Thread* self) {
-  if (started_ && !tasks_.empty()) {
-    Task* task = tasks_.front();
-    tasks_.pop_front();
-    return task;
+ThreadPoolWorker* ThreadPool::FindWorker(Thread* self) const {
+  for (size_t i = 0; i < threads_.size(); ++i) {
+    if (threads_[i]->thread_ == self) {
+      return threads_[i];
+    }
   }
   return NULL;
 }
 
+bool ThreadPool::HasTasksLocked() const {
+  for (size_t priority = 0; priority < kNumTaskPriorities; ++priority) {
+    if (!tasks_[priority].empty()) {
+      return true;
+    }
+  }
+  for (size_t i = 0; i < threads_.size(); ++i) {
+    if (!threads_[i]->local_tasks_.empty()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+Task* ThreadPool::TryGetTaskLocked(Thread* self) {
+  if (!started_) {
+    return NULL;
+  }
+  ThreadPoolWorker* worker = FindWorker(self);
+  Task* task = NULL;
+  for (int priority = kTaskPriorityHigh; priority >= 0 && task == NULL; --priority) {
+    if (priority == kTaskPriorityNormal && worker != NULL && !worker->local_tasks_.empty()) {
+      task = worker->local_tasks_.back();
+      worker->local_tasks_.pop_back();
+    } else if (!tasks_[priority].empty()) {
+      task = tasks_[priority].front();
+      tasks_[priority].pop_front();
+    } else if (priority == kTaskPriorityNormal) {
+      // Steal the oldest task another worker added.
+      for (size_t i = 0; i < threads_.size(); ++i) {
+        ThreadPoolWorker* victim = threads_[i];
+        if (victim != worker && !victim->local_tasks_.empty()) {
+          task = victim->local_tasks_.front();
+          victim->local_tasks_.pop_front();
+          ++tasks_stolen_;
+          break;
+        }
+      }
+    }
+  }
+  if (task != NULL) {
+    ++tasks_run_;
+  }
+  return task;
+}
+
 void ThreadPool::Wait(Thread* self, bool do_work, bool may_hold_locks) {
   if (do_work) {
     Task* task = NULL;
@@ -181,7 +296,7 @@ void ThreadPool::Wait(Thread* self, bool do_work, bool may_hold_locks) {
   }
   // Wait until each thread is waiting and the task list is empty.
   MutexLock mu(self, task_queue_lock_);
-  while (!shutting_down_ && (waiting_count_ != GetThreadCount() || !tasks_.empty())) {
+  while (!shutting_down_ && (waiting_count_ != GetThreadCount() || HasTasksLocked())) {
     if (!may_hold_locks) {
       completion_condition_.Wait(self);
     } else {
@@ -192,7 +307,14 @@ void ThreadPool::Wait(Thread* self, bool do_work, bool may_hold_locks) {
 
 size_t ThreadPool::GetTaskCount(Thread* self) {
   MutexLock mu(self, task_queue_lock_);
-  return tasks_.size();
+  size_t count = 0;
+  for (size_t priority = 0; priority < kNumTaskPriorities; ++priority) {
+    count += tasks_[priority].size();
+  }
+  for (size_t i = 0; i < threads_.size(); ++i) {
+    count += threads_[i]->local_tasks_.size();
+  }
+  return count;
 }
 
 WorkStealingWorker::WorkStealingWorker(ThreadPool* thread_pool, const std::string& name,
@@ -17,7 +17,10 @@
 #ifndef ART_RUNTIME_THREAD_POOL_H_
 #define ART_RUNTIME_THREAD_POOL_H_
 
+#include <sys/types.h>
+
 #include <deque>
+#include <iosfwd>
 #include <vector>
 
 #include "barrier.h"
@@ -29,6 +32,14 @@ namespace art {
 
 class ThreadPool;
 
+// Workers take the oldest queued task of the highest priority.
+enum TaskPriority {
+  kTaskPriorityLow,
+  kTaskPriorityNormal,
+  kTaskPriorityHigh,
+};
+static const size_t kNumTaskPriorities = kTaskPriorityHigh + 1;
+
 class Task : public Closure {
  public:
   // Called when references reaches 0.
@@ -54,6 +65,15 @@ class ThreadPoolWorker {
   const std::string name_;
   const size_t stack_size_;
   pthread_t pthread_;
+  // The worker's thread, set before the pool's constructor returns.
+  Thread* thread_;
+  pid_t tid_;
+  // Normal priority tasks added by the worker's own tasks. The worker runs the newest first,
+  // while its cache is still warm, and other workers steal the oldest. Guarded by the pool's
+  // task_queue_lock_.
+  std::deque<Task*> local_tasks_;
+  // Time spent running tasks, only written by the worker.
+  volatile uint64_t busy_ns_;
 
  private:
   friend class ThreadPool;
@@ -74,8 +94,9 @@ class ThreadPool {
   void StopWorkers(Thread* self);
 
   // Add a new task, the first available started worker will process it. Does not delete the task
-  // after running it, it is the caller's responsibility.
-  void AddTask(Thread* self, Task* task);
+  // after running it, it is the caller's responsibility. Normal priority tasks added by a worker
+  // go to its own queue, see ThreadPoolWorker::local_tasks_.
+  void AddTask(Thread* self, Task* task, TaskPriority priority = kTaskPriorityNormal);
 
   explicit ThreadPool(size_t num_threads);
   virtual ~ThreadPool();
@@ -94,6 +115,18 @@ class ThreadPool {
   // thread count of the thread pool.
   void SetMaxActiveWorkers(size_t threads);
 
+  // Pins worker i to CPU cpus[i % cpus.size()], for example to keep the workers on the big cores
+  // of a big.LITTLE system. Does nothing where threads can't be pinned.
+  void SetWorkerCpus(const std::vector<int>& cpus);
+
+  // Pins worker i to the CPUs of NUMA node i % Numa::NumNodes(), so that every node has its share
+  // of the workers. Does nothing where there is a single node.
+  void SetWorkerNumaNodes();
+
+  // Dumps how many tasks the workers ran and stole, and how long they were busy running tasks
+  // and idle while the pool was started.
+  void DumpStats(std::ostream& os);
+
  protected:
   // Get a task to run, blocks if there are no tasks left
   virtual Task* GetTask(Thread* self);
@@ -102,6 +135,13 @@ class ThreadPool {
   Task* TryGetTask(Thread* self);
   Task* TryGetTaskLocked(Thread* self) EXCLUSIVE_LOCKS_REQUIRED(task_queue_lock_);
 
+  // Returns the worker running on self, or NULL if self isn't one of ours.
+  ThreadPoolWorker* FindWorker(Thread* self) const;
+
+  static void PinWorker(ThreadPoolWorker* worker, const std::vector<int>& cpus);
+
+  bool HasTasksLocked() const EXCLUSIVE_LOCKS_REQUIRED(task_queue_lock_);
+
   // Are we shutting down?
   bool IsShuttingDown() const EXCLUSIVE_LOCKS_REQUIRED(task_queue_lock_) {
     return shutting_down_;
@@ -114,7 +154,8 @@ class ThreadPool {
   volatile bool shutting_down_ GUARDED_BY(task_queue_lock_);
   // How many worker threads are waiting on the condition.
   volatile size_t waiting_count_ GUARDED_BY(task_queue_lock_);
-  std::deque<Task*> tasks_ GUARDED_BY(task_queue_lock_);
+  // Tasks by priority, other than the ones in the workers' own queues.
+  std::deque<Task*> tasks_[kNumTaskPriorities] GUARDED_BY(task_queue_lock_);
   // TODO: make this immutable/const?
   std::vector<ThreadPoolWorker*> threads_;
   // Work balance detection.
@@ -122,6 +163,10 @@ class ThreadPool {
   uint64_t total_wait_time_;
   Barrier creation_barier_;
   size_t max_active_workers_ GUARDED_BY(task_queue_lock_);
+  // Statistics for DumpStats.
+  uint64_t tasks_run_ GUARDED_BY(task_queue_lock_);
+  uint64_t tasks_stolen_ GUARDED_BY(task_queue_lock_);
+  uint64_t idle_ns_ GUARDED_BY(task_queue_lock_);
 
  private:
   friend class ThreadPoolWorker;
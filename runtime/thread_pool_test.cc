@@ -16,6 +16,7 @@
 
 
 #include <string>
+#include <vector>
 
 #include "atomic_integer.h"
 #include "common_test.h"
@@ -138,4 +139,40 @@ TEST_F(ThreadPoolTest, RecursiveTest) {
   EXPECT_EQ((1 << depth) - 1, count);
 }
 
+class RecordTask : public Task {
+ public:
+  RecordTask(std::vector<int>* order, int id) : order_(order), id_(id) {}
+
+  void Run(Thread* /* self */) {
+    order_->push_back(id_);
+  }
+
+  void Finalize() {
+    delete this;
+  }
+
+ private:
+  std::vector<int>* const order_;
+  const int id_;
+};
+
+// Test that queued tasks run highest priority first.
+TEST_F(ThreadPoolTest, Priorities) {
+  Thread* self = Thread::Current();
+  // A single worker runs the tasks one at a time.
+  ThreadPool thread_pool(1);
+  std::vector<int> order;
+  thread_pool.AddTask(self, new RecordTask(&order, 0), kTaskPriorityLow);
+  thread_pool.AddTask(self, new RecordTask(&order, 1));
+  thread_pool.AddTask(self, new RecordTask(&order, 2), kTaskPriorityHigh);
+  thread_pool.AddTask(self, new RecordTask(&order, 3));
+  thread_pool.StartWorkers(self);
+  thread_pool.Wait(self, false, false);
+  ASSERT_EQ(4U, order.size());
+  EXPECT_EQ(2, order[0]);
+  EXPECT_EQ(1, order[1]);
+  EXPECT_EQ(3, order[2]);
+  EXPECT_EQ(0, order[3]);
+}
+
 }  // namespace art
@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "thread_stack_cache.h"
+
+#include <errno.h>
+#include <sys/mman.h>
+
+#include "globals.h"
+#include "mem_map.h"
+#include "thread.h"
+#include "UniquePtr.h"
+
+namespace art {
+
+ThreadStackCache::ThreadStackCache(size_t max_cached_stacks)
+    : max_cached_stacks_(max_cached_stacks),
+      lock_("thread stack cache lock") {
+  CHECK_GT(max_cached_stacks, 0U);
+}
+
+ThreadStackCache::~ThreadStackCache() {
+  MutexLock mu(Thread::Current(), lock_);
+  CHECK(running_.empty());
+  for (size_t i = 0; i < released_.size(); i++) {
+    CHECK_PTHREAD_CALL(pthread_join, (released_[i].thread, NULL), "thread stack cache shutdown");
+    delete released_[i].stack;
+  }
+}
+
+int ThreadStackCache::CreateThread(Thread* self, size_t stack_size,
+                                   void* (*start_routine)(void*), void* arg) {
+  DCHECK_EQ(stack_size % kPageSize, 0U);
+  MutexLock mu(self, lock_);
+  UniquePtr<MemMap> stack;
+  for (std::deque<ReleasedStack>::iterator it = released_.begin(); it != released_.end(); ++it) {
+    if (it->stack->Size() == stack_size + kPageSize) {
+      // The thread released its stack just before returning, so this won't wait for long.
+      CHECK_PTHREAD_CALL(pthread_join, (it->thread, NULL), "reused thread stack");
+      stack.reset(it->stack);
+      released_.erase(it);
+      break;
+    }
+  }
+  if (stack.get() == NULL) {
+    stack.reset(MemMap::MapAnonymous("thread stack", NULL, stack_size + kPageSize,
+                                     PROT_READ | PROT_WRITE));
+    if (stack.get() == NULL) {
+      return ENOMEM;
+    }
+    if (mprotect(stack->Begin(), kPageSize, PROT_NONE) != 0) {
+      PLOG(FATAL) << "Failed to protect thread stack guard page";
+    }
+  }
+  pthread_attr_t attr;
+  CHECK_PTHREAD_CALL(pthread_attr_init, (&attr), "new thread");
+  CHECK_PTHREAD_CALL(pthread_attr_setstack, (&attr, stack->Begin() + kPageSize, stack_size),
+                     stack_size);
+  pthread_t thread;
+  int result = pthread_create(&thread, &attr, start_routine, arg);
+  CHECK_PTHREAD_CALL(pthread_attr_destroy, (&attr), "new thread");
+  if (result == 0) {
+    // The new thread can't release its stack before it is recorded, that needs lock_.
+    running_[thread] = stack.release();
+  }
+  return result;
+}
+
+void ThreadStackCache::Release() {
+  pthread_t thread = pthread_self();
+  // The calling thread may have been detached from the runtime already.
+  MutexLock mu(NULL, lock_);
+  std::map<pthread_t, MemMap*>::iterator it = running_.find(thread);
+  CHECK(it != running_.end());
+  if (released_.size() == max_cached_stacks_) {
+    const ReleasedStack& oldest = released_.front();
+    CHECK_PTHREAD_CALL(pthread_join, (oldest.thread, NULL), "evicted thread stack");
+    delete oldest.stack;
+    released_.pop_front();
+  }
+  ReleasedStack released = { it->second, thread };
+  released_.push_back(released);
+  running_.erase(it);
+}
+
+}  // namespace art
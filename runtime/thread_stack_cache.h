@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ART_RUNTIME_THREAD_STACK_CACHE_H_
+#define ART_RUNTIME_THREAD_STACK_CACHE_H_
+
+#include <pthread.h>
+
+#include <deque>
+#include <map>
+
+#include "base/macros.h"
+#include "base/mutex.h"
+#include "locks.h"
+
+namespace art {
+
+class MemMap;
+class Thread;
+
+// Creates threads on stacks it maps itself, and keeps the stacks of the ones that have finished
+// so that the next thread wanting a stack of the same size runs on one of those instead of
+// mapping a new stack and guard page. Threads it creates are joinable; it joins them once they
+// have handed their stacks back.
+class ThreadStackCache {
+ public:
+  explicit ThreadStackCache(size_t max_cached_stacks);
+
+  // Joins the threads whose stacks are cached and unmaps the stacks. Every thread created must
+  // have released its stack.
+  ~ThreadStackCache();
+
+  // Creates a thread calling start_routine(arg) on a stack of stack_size bytes, a multiple of
+  // the page size, with a guard page below it. Returns the result of pthread_create, or ENOMEM
+  // if no stack could be mapped.
+  int CreateThread(Thread* self, size_t stack_size, void* (*start_routine)(void*), void* arg)
+      LOCKS_EXCLUDED(lock_);
+
+  // Hands the stack of the calling thread, which must have been created by CreateThread, to
+  // later threads. It is only reused once the thread has exited, so the thread may go on using
+  // it until its start routine returns, but mustn't do anything that needs a runtime.
+  void Release() LOCKS_EXCLUDED(lock_);
+
+ private:
+  // The stack of a thread that has released it, and may not have exited yet.
+  struct ReleasedStack {
+    MemMap* stack;
+    pthread_t thread;
+  };
+
+  const size_t max_cached_stacks_;
+  Mutex lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
+  std::map<pthread_t, MemMap*> running_ GUARDED_BY(lock_);
+  // Oldest first.
+  std::deque<ReleasedStack> released_ GUARDED_BY(lock_);
+
+  DISALLOW_COPY_AND_ASSIGN(ThreadStackCache);
+};
+
+}  // namespace art
+
+#endif  // ART_RUNTIME_THREAD_STACK_CACHE_H_
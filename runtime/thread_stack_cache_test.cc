@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "thread_stack_cache.h"
+
+#include "atomic_integer.h"
+#include "common_test.h"
+
+namespace art {
+
+class ThreadStackCacheTest : public CommonTest {};
+
+struct StackProbe {
+  ThreadStackCache* cache;
+  uintptr_t local_address;
+  AtomicInteger done;
+};
+
+static void* ProbeStack(void* arg) {
+  StackProbe* probe = reinterpret_cast<StackProbe*>(arg);
+  int local;
+  probe->local_address = reinterpret_cast<uintptr_t>(&local);
+  probe->cache->Release();
+  probe->done = 1;
+  return NULL;
+}
+
+static uintptr_t RunProbe(ThreadStackCache* cache, size_t stack_size) {
+  StackProbe probe;
+  probe.cache = cache;
+  probe.local_address = 0;
+  probe.done = 0;
+  EXPECT_EQ(0, cache->CreateThread(Thread::Current(), stack_size, ProbeStack, &probe));
+  while (probe.done == 0) {
+    usleep(1000);
+  }
+  return probe.local_address;
+}
+
+TEST_F(ThreadStackCacheTest, ReusesStack) {
+  const size_t stack_size = 64 * KB;
+  ThreadStackCache cache(1);
+  uintptr_t first = RunProbe(&cache, stack_size);
+  uintptr_t second = RunProbe(&cache, stack_size);
+  // Both locals are near the top of their stacks, so on different stacks they would be at least
+  // a stack apart, however the stacks were placed.
+  uintptr_t distance = (first > second) ? first - second : second - first;
+  EXPECT_LT(distance, stack_size / 2);
+}
+
+}  // namespace art
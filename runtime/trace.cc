@@ -16,14 +16,21 @@
 
 #include "trace.h"
 
+#include <errno.h>
+#include <signal.h>
 #include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
 
 #include "base/stl_util.h"
 #include "base/unix_file/fd_file.h"
 #include "class_linker.h"
 #include "common_throws.h"
+#include "cycle_clock.h"
 #include "debugger.h"
 #include "dex_file-inl.h"
+#include "gc/heap.h"
 #include "instrumentation.h"
 #include "mirror/art_method-inl.h"
 #include "mirror/class-inl.h"
@@ -34,6 +41,8 @@
 #include "os.h"
 #include "scoped_thread_state_change.h"
 #include "ScopedLocalRef.h"
+#include "signal_context.h"
+#include "stack.h"
 #include "thread.h"
 #include "thread_list.h"
 #if !defined(ART_USE_PORTABLE_COMPILER)
@@ -84,29 +93,6 @@ enum TraceAction {
     kTraceMethodActionMask = 0x03,  // two bits
 };
 
-class BuildStackTraceVisitor : public StackVisitor {
- public:
-  explicit BuildStackTraceVisitor(Thread* thread) : StackVisitor(thread, NULL),
-      method_trace_(Trace::AllocStackTrace()) {}
-
-  bool VisitFrame() {
-    mirror::ArtMethod* m = GetMethod();
-    // Ignore runtime frames (in particular callee save).
-    if (!m->IsRuntimeMethod()) {
-      method_trace_->push_back(m);
-    }
-    return true;
-  }
-
-  // Returns a stack trace where the topmost frame corresponds with the first element of the vector.
-  std::vector<mirror::ArtMethod*>* GetStackTrace() const {
-    return method_trace_;
-  }
-
- private:
-  std::vector<mirror::ArtMethod*>* const method_trace_;
-};
-
 static const char     kTraceTokenChar             = '*';
 static const uint16_t kTraceHeaderLength          = 32;
 static const uint32_t kTraceMagicValue            = 0x574f4c53;
@@ -114,6 +100,10 @@ static const uint16_t kTraceVersionSingleClock    = 2;
 static const uint16_t kTraceVersionDualClock      = 3;
 static const uint16_t kTraceRecordSizeSingleClock = 10;  // using v2
 static const uint16_t kTraceRecordSizeDualClock   = 14;  // using v3 with two timestamps
+// Records per chunk of the buffer a thread claims at a time.
+static const size_t   kTraceChunkRecords          = 1024;
+// How often the streaming thread writes out filled chunks.
+static const int64_t  kTraceFlushIntervalMs       = 500;
 
 #if defined(HAVE_POSIX_CLOCKS)
 ProfilerClockSource Trace::default_clock_source_ = kProfilerClockSourceDual;
@@ -122,6 +112,8 @@ ProfilerClockSource Trace::default_clock_source_ = kProfilerClockSourceWall;
 #endif
 
 Trace* volatile Trace::the_trace_ = NULL;
+std::vector<std::string> Trace::default_method_filter_;
+uint32_t Trace::default_min_duration_us_ = 0;
 pthread_t Trace::sampling_pthread_ = 0U;
 UniquePtr<std::vector<mirror::ArtMethod*> > Trace::temp_stack_trace_;
 
@@ -163,6 +155,25 @@ void Trace::SetDefaultClockSource(ProfilerClockSource clock_source) {
 #endif
 }
 
+void Trace::SetDefaultMethodFilter(const std::string& filter) {
+  default_method_filter_.clear();
+  Split(filter, ',', default_method_filter_);
+}
+
+void Trace::SetDefaultMinDuration(uint32_t min_duration_us) {
+  default_min_duration_us_ = min_duration_us;
+}
+
+bool TraceMethodFilter::Matches(const mirror::ArtMethod* method) const {
+  std::string name(PrettyMethod(method, false));
+  for (const std::string& prefix : prefixes_) {
+    if (StartsWith(name, prefix.c_str())) {
+      return true;
+    }
+  }
+  return false;
+}
+
 static uint16_t GetTraceVersion(ProfilerClockSource clock_source) {
   return (clock_source == kProfilerClockSourceDual) ? kTraceVersionDualClock
                                                     : kTraceVersionSingleClock;
@@ -185,7 +196,7 @@ bool Trace::UseWallClock() {
 
 static void MeasureClockOverhead(Trace* trace) {
   if (trace->UseThreadCpuClock()) {
-    Thread::Current()->GetCpuMicroTime();
+    trace->ReadThreadCpuClock(Thread::Current());
   }
   if (trace->UseWallClock()) {
     MicroTime();
@@ -238,31 +249,233 @@ static void Append8LE(uint8_t* buf, uint64_t val) {
   *buf++ = static_cast<uint8_t>(val >> 56);
 }
 
-static void GetSample(Thread* thread, void* arg) SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
-  BuildStackTraceVisitor build_trace_visitor(thread);
-  build_trace_visitor.WalkStack();
-  std::vector<mirror::ArtMethod*>* stack_trace = build_trace_visitor.GetStackTrace();
+// True while the sampling profiler wants SIGPROF handlers to record samples.
+static volatile bool gSampleSignalsEnabled = false;
+
+// Reads the pc and stack pointer the signal interrupted. Returns false on hosts whose context
+// layout we don't know.
+static bool GetInterruptedPcAndSp(void* raw_context, uintptr_t* pc, uintptr_t* sp) {
+#if defined(HAVE_ANDROID_OS)
+  const MachineContext& context = reinterpret_cast<KernelUContext*>(raw_context)->uc_mcontext;
+#if defined(__arm__)
+  *pc = context.arm_pc;
+  *sp = context.arm_sp;
+  return true;
+#elif defined(__i386__)
+  *pc = context.eip;
+  *sp = context.esp;
+  return true;
+#elif defined(__mips__)
+  *pc = context.sc_pc;
+  *sp = context.sc_regs[29];
+  return true;
+#else
+  return false;
+#endif
+#elif defined(__linux__) && defined(__i386__)
+  const MachineContext& context = reinterpret_cast<KernelUContext*>(raw_context)->uc_mcontext;
+  *pc = context.gregs[REG_EIP];
+  *sp = context.gregs[REG_ESP];
+  return true;
+#else
+  UNUSED(raw_context);
+  UNUSED(pc);
+  UNUSED(sp);
+  return false;
+#endif
+}
+
+// Checks that a word read off the stack in a signal handler points to an ArtMethod, using only
+// lock-free reads. The class is read directly as the accessors may verify the object.
+static bool IsSampledMethod(const mirror::ArtMethod* method) {
+  if (method == NULL || !IsAligned<kObjectAlignment>(method) ||
+      Runtime::Current()->GetHeap()->FindContinuousSpaceFromObject(method, true) == NULL) {
+    return false;
+  }
+  const byte* raw_addr = reinterpret_cast<const byte*>(method) +
+      mirror::Object::ClassOffset().Int32Value();
+  const mirror::Class* klass =
+      reinterpret_cast<const mirror::HeapReference<mirror::Class>*>(raw_addr)->AsMirrorPtr();
+  return klass != NULL && klass == mirror::ArtMethod::GetJavaLangReflectArtMethod();
+}
+
+static bool IsOnThreadStack(Thread* self, const void* addr) {
+  const byte* stack_low = self->GetStackEnd();
+  const byte* stack_high = stack_low + self->GetStackSize();
+  return stack_low <= addr && addr < stack_high;
+}
+
+// Walks the calling thread's stack from inside its signal handler. Unlike StackVisitor this
+// neither allocates nor locks, and it gives up rather than aborts on anything that doesn't look
+// like a frame. If 'top_quick_frame' is non-NULL it replaces the top of the innermost fragment.
+static bool WalkStackForSample(Thread* self, mirror::ArtMethod** top_quick_frame,
+                               TraceSampleBuffer::Sample* sample) NO_THREAD_SAFETY_ANALYSIS {
+  size_t depth = 0;
+  for (const ManagedStack* fragment = self->GetManagedStack(); fragment != NULL;
+       fragment = fragment->GetLink()) {
+    mirror::ArtMethod** frame = fragment->GetTopQuickFrame();
+    ShadowFrame* shadow_frame = fragment->GetTopShadowFrame();
+    if (top_quick_frame != NULL) {
+      frame = top_quick_frame;
+      shadow_frame = NULL;
+      top_quick_frame = NULL;
+    }
+    if (frame != NULL) {
+      while (true) {
+        if (!IsOnThreadStack(self, frame)) {
+          return false;
+        }
+        mirror::ArtMethod* method = *frame;
+        if (method == NULL) {
+          break;  // Bottom of the fragment.
+        }
+        if (!IsSampledMethod(method)) {
+          return false;
+        }
+        if (!method->IsRuntimeMethod()) {
+          if (depth == TraceSampleBuffer::kMaxDepth) {
+            break;
+          }
+          sample->methods[depth++] = method;
+        }
+        size_t frame_size = method->GetFrameSizeInBytes();
+        if (frame_size == 0) {
+          return false;
+        }
+        frame = reinterpret_cast<mirror::ArtMethod**>(reinterpret_cast<byte*>(frame) + frame_size);
+      }
+    } else {
+      for (; shadow_frame != NULL; shadow_frame = shadow_frame->GetLink()) {
+        mirror::ArtMethod* method = shadow_frame->GetMethod();
+        if (!IsSampledMethod(method)) {
+          return false;
+        }
+        if (depth == TraceSampleBuffer::kMaxDepth) {
+          break;
+        }
+        sample->methods[depth++] = method;
+      }
+    }
+  }
+  sample->depth = depth;
+  return true;
+}
+
+// Finds the innermost quick frame of a runnable thread. Compiled code doesn't publish its frames,
+// so when the interrupted stack pointer holds the Method* of a method whose code contains the
+// interrupted pc, that is the top frame. Otherwise the thread is in a prologue, a stub or runtime
+// code, and the published top frame is used if it is still live above the stack pointer.
+static mirror::ArtMethod** FindTopQuickFrame(Thread* self, void* raw_context)
+    NO_THREAD_SAFETY_ANALYSIS {
+  uintptr_t pc;
+  uintptr_t sp;
+  if (!GetInterruptedPcAndSp(raw_context, &pc, &sp) ||
+      !IsOnThreadStack(self, reinterpret_cast<void*>(sp))) {
+    return NULL;
+  }
+  mirror::ArtMethod** frame = reinterpret_cast<mirror::ArtMethod**>(sp);
+  mirror::ArtMethod* method = *frame;
+  if (IsSampledMethod(method) && !method->IsRuntimeMethod() && method->IsWithinCode(pc)) {
+    return frame;
+  }
+  mirror::ArtMethod** published = self->GetManagedStack()->GetTopQuickFrame();
+  if (published != NULL && reinterpret_cast<uintptr_t>(published) > sp) {
+    return published;
+  }
+  return NULL;
+}
+
+// SIGPROF handler, run by the thread being sampled. Only async-signal-safe work happens here:
+// the stack walk reads memory, the clocks are clock_gettime and the ring is lock free.
+static void HandleSampleSignal(int, siginfo_t*, void* raw_context) NO_THREAD_SAFETY_ANALYSIS {
+  int saved_errno = errno;
+  Thread* self = Thread::Current();
+  TraceSampleBuffer* buffer = (self != NULL) ? self->GetTraceSampleBuffer() : NULL;
+  if (buffer != NULL && gSampleSignalsEnabled) {
+    TraceSampleBuffer::Sample* sample = buffer->BeginWrite();
+    mirror::ArtMethod** top_quick_frame = NULL;
+    bool ok = (sample != NULL);
+    if (ok && self->GetState() == kRunnable &&
+        self->GetManagedStack()->GetTopShadowFrame() == NULL) {
+      top_quick_frame = FindTopQuickFrame(self, raw_context);
+      ok = (top_quick_frame != NULL);
+    }
+    if (ok && WalkStackForSample(self, top_quick_frame, sample)) {
+      sample->thread_cpu_us = self->GetCpuMicroTime();
+      sample->wall_us = MicroTime();
+      buffer->EndWrite();
+    } else {
+      buffer->DropSample();
+    }
+  }
+  errno = saved_errno;
+}
+
+static void InstallSampleSignalHandler() {
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  sigemptyset(&action.sa_mask);
+  action.sa_sigaction = HandleSampleSignal;
+  // Use the three-argument sa_sigaction handler, and restart interrupted system calls since the
+  // state of a thread may change between its being chosen for a sample and the signal arriving.
+  action.sa_flags = SA_SIGINFO | SA_RESTART | SA_ONSTACK;
+  int rc = sigaction(SIGPROF, &action, NULL);
+  CHECK_EQ(rc, 0);
+}
+
+// Drains the samples a thread took since the last interval and asks it for another one. Only
+// runnable threads are signalled: the stacks of the others can't change until they next run and
+// their last sample already describes them.
+static void SampleThread(Thread* thread, void* arg) SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
+  if (thread == Thread::Current()) {
+    return;  // The sampling thread itself.
+  }
   Trace* the_trace = reinterpret_cast<Trace*>(arg);
-  the_trace->CompareAndUpdateStackTrace(thread, stack_trace);
+  TraceSampleBuffer* buffer = thread->GetTraceSampleBuffer();
+  if (buffer == NULL) {
+    buffer = new TraceSampleBuffer;
+    // Publish the initialized buffer to the thread's signal handler.
+    ANDROID_MEMBAR_STORE();
+    thread->SetTraceSampleBuffer(buffer);
+  }
+  the_trace->DrainSamples(thread, buffer);
+  if (thread->GetState() == kRunnable) {
+    pthread_kill(thread->GetPthreadSelf(), SIGPROF);
+  }
 }
 
 static void ClearThreadStackTraceAndClockBase(Thread* thread, void* arg) {
   thread->SetTraceClockBase(0);
+  TraceSampleBuffer* buffer = thread->GetTraceSampleBuffer();
+  if (buffer != NULL) {
+    buffer->Discard();
+  }
   std::vector<mirror::ArtMethod*>* stack_trace = thread->GetStackTraceSample();
   thread->SetStackTraceSample(NULL);
   delete stack_trace;
 }
 
+void Trace::DrainSamples(Thread* thread, TraceSampleBuffer* buffer) {
+  const TraceSampleBuffer::Sample* sample;
+  while ((sample = buffer->BeginRead()) != NULL) {
+    std::vector<mirror::ArtMethod*>* stack_trace = AllocStackTrace();
+    stack_trace->assign(sample->methods, sample->methods + sample->depth);
+    uint32_t thread_clock_diff = 0;
+    uint32_t wall_clock_diff = 0;
+    ComputeClockDiffs(thread, sample->thread_cpu_us, sample->wall_us,
+                      &thread_clock_diff, &wall_clock_diff);
+    buffer->EndRead();
+    CompareAndUpdateStackTrace(thread, stack_trace, thread_clock_diff, wall_clock_diff);
+  }
+}
+
 void Trace::CompareAndUpdateStackTrace(Thread* thread,
-                                       std::vector<mirror::ArtMethod*>* stack_trace) {
+                                       std::vector<mirror::ArtMethod*>* stack_trace,
+                                       uint32_t thread_clock_diff, uint32_t wall_clock_diff) {
   CHECK_EQ(pthread_self(), sampling_pthread_);
   std::vector<mirror::ArtMethod*>* old_stack_trace = thread->GetStackTraceSample();
   // Update the thread's stack trace sample.
   thread->SetStackTraceSample(stack_trace);
-  // Read timer clocks to use for all events in this trace.
-  uint32_t thread_clock_diff = 0;
-  uint32_t wall_clock_diff = 0;
-  ReadClocks(thread, &thread_clock_diff, &wall_clock_diff);
   if (old_stack_trace == NULL) {
     // If there's no previous stack trace sample for this thread, log an entry event for all
     // methods in the trace.
@@ -306,21 +519,22 @@ void* Trace::RunSamplingThread(void* arg) {
     usleep(interval_us);
     ATRACE_BEGIN("Profile sampling");
     Thread* self = Thread::Current();
-    Trace* the_trace;
     {
-      MutexLock mu(self, *Locks::trace_lock_);
-      the_trace = the_trace_;
+      // Stop deletes the trace with all threads suspended, so it stays valid while we're
+      // runnable.
+      ScopedObjectAccess soa(self);
+      Trace* the_trace;
+      {
+        MutexLock mu(self, *Locks::trace_lock_);
+        the_trace = the_trace_;
+      }
       if (the_trace == NULL) {
+        ATRACE_END();
         break;
       }
-    }
-
-    runtime->GetThreadList()->SuspendAll();
-    {
       MutexLock mu(self, *Locks::thread_list_lock_);
-      runtime->GetThreadList()->ForEach(GetSample, the_trace);
+      runtime->GetThreadList()->ForEach(SampleThread, the_trace);
     }
-    runtime->GetThreadList()->ResumeAll();
     ATRACE_END();
   }
 
@@ -338,6 +552,10 @@ void Trace::Start(const char* trace_filename, int trace_fd, int buffer_size, int
       return;
     }
   }
+  if (direct_to_ddms && (flags & (kTraceStreaming | kTraceFlightRecorder)) != 0) {
+    LOG(WARNING) << "Streaming and flight recorder tracing need a trace file, ignoring them";
+    flags &= ~(kTraceStreaming | kTraceFlightRecorder);
+  }
   Runtime* runtime = Runtime::Current();
   runtime->GetThreadList()->SuspendAll();
 
@@ -372,13 +590,23 @@ void Trace::Start(const char* trace_filename, int trace_fd, int buffer_size, int
         runtime->SetStatsEnabled(true);
       }
 
-
+      if ((flags & kTraceStreaming) != 0) {
+        CHECK_PTHREAD_CALL(pthread_create, (&the_trace_->flush_pthread_, NULL, &RunFlushThread,
+                                            the_trace_),
+                                            "Trace flush thread");
+      }
 
       if (sampling_enabled) {
+        InstallSampleSignalHandler();
+        gSampleSignalsEnabled = true;
         CHECK_PTHREAD_CALL(pthread_create, (&sampling_pthread_, NULL, &RunSamplingThread,
                                             reinterpret_cast<void*>(interval_us)),
                                             "Sampling profiler thread");
       } else {
+        if (the_trace_->method_filter_.get() != NULL) {
+          // Before the listener, so that only the matching methods get the stubs.
+          runtime->GetInstrumentation()->SetMethodFilter(the_trace_->method_filter_.get());
+        }
         runtime->GetInstrumentation()->AddListener(the_trace_,
                                                    instrumentation::Instrumentation::kMethodEntered |
                                                    instrumentation::Instrumentation::kMethodExited |
@@ -391,6 +619,7 @@ void Trace::Start(const char* trace_filename, int trace_fd, int buffer_size, int
 
 void Trace::Stop() {
   Runtime* runtime = Runtime::Current();
+  gSampleSignalsEnabled = false;
   runtime->GetThreadList()->SuspendAll();
   Trace* the_trace = NULL;
   pthread_t sampling_pthread = 0U;
@@ -416,6 +645,9 @@ void Trace::Stop() {
                                                     instrumentation::Instrumentation::kMethodEntered |
                                                     instrumentation::Instrumentation::kMethodExited |
                                                     instrumentation::Instrumentation::kMethodUnwind);
+      if (the_trace->method_filter_.get() != NULL) {
+        runtime->GetInstrumentation()->SetMethodFilter(NULL);
+      }
     }
     delete the_trace;
   }
@@ -443,10 +675,27 @@ TracingMode Trace::GetMethodTracingMode() {
   }
 }
 
+static size_t GetChunkSize(int buffer_size, ProfilerClockSource clock_source) {
+  size_t record_size = GetRecordSize(clock_source);
+  size_t buffer_records = (static_cast<size_t>(std::max(buffer_size, 0)) > kTraceHeaderLength) ?
+      (buffer_size - kTraceHeaderLength) / record_size : 0;
+  return std::max(std::min(buffer_records, kTraceChunkRecords), static_cast<size_t>(1)) *
+      record_size;
+}
+
 Trace::Trace(File* trace_file, int buffer_size, int flags, bool sampling_enabled)
     : trace_file_(trace_file), buf_(new uint8_t[buffer_size]()), flags_(flags),
       sampling_enabled_(sampling_enabled), clock_source_(default_clock_source_),
-      buffer_size_(buffer_size), start_time_(MicroTime()), cur_offset_(0),  overflow_(false) {
+      estimate_thread_cpu_clock_(UseThreadCpuClock() && CycleClock::Init()),
+      buffer_size_(buffer_size),
+      method_filter_(default_method_filter_.empty() ?
+                     NULL : new TraceMethodFilter(default_method_filter_)),
+      min_duration_us_(default_min_duration_us_), start_time_(MicroTime()),
+      chunk_size_(GetChunkSize(buffer_size, clock_source_)),
+      chunk_lock_(new Mutex("trace chunk lock", kTraceChunkLock)),
+      flush_cond_(new ConditionVariable("trace flush condition variable", *chunk_lock_)),
+      flush_pthread_(0U), flush_thread_stop_(false), stream_offset_(kTraceHeaderLength),
+      streamed_records_(0), stream_error_(false), overflow_(false) {
   // Set up the beginning of the trace.
   uint16_t trace_version = GetTraceVersion(clock_source_);
   memset(buf_.get(), 0, kTraceHeaderLength);
@@ -459,13 +708,21 @@ Trace::Trace(File* trace_file, int buffer_size, int flags, bool sampling_enabled
     Append2LE(buf_.get() + 16, record_size);
   }
 
-  // Update current offset.
-  cur_offset_ = kTraceHeaderLength;
+  // Carve the rest of the buffer into chunks for threads to record into.
+  for (size_t offset = kTraceHeaderLength; offset + chunk_size_ <= static_cast<size_t>(buffer_size);
+       offset += chunk_size_) {
+    free_chunks_.push_back(buf_.get() + offset);
+  }
+}
+
+Trace::~Trace() {
+  flush_cond_.reset();
+  delete chunk_lock_;
 }
 
 static void DumpBuf(uint8_t* buf, size_t buf_size, ProfilerClockSource clock_source)
     SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
-  uint8_t* ptr = buf + kTraceHeaderLength;
+  uint8_t* ptr = buf;
   uint8_t* end = buf + buf_size;
 
   while (ptr < end) {
@@ -477,19 +734,149 @@ static void DumpBuf(uint8_t* buf, size_t buf_size, ProfilerClockSource clock_sou
   }
 }
 
-void Trace::FinishTracing() {
-  // Compute elapsed time.
-  uint64_t elapsed = MicroTime() - start_time_;
+void* Trace::RunFlushThread(void* arg) {
+  Trace* trace = reinterpret_cast<Trace*>(arg);
+  // The streaming thread only does I/O, so it stays detached from the runtime.
+  MutexLock mu(NULL, *trace->chunk_lock_);
+  while (!trace->flush_thread_stop_) {
+    if (trace->filled_chunks_.empty()) {
+      trace->flush_cond_->TimedWait(NULL, kTraceFlushIntervalMs, 0);
+    }
+    trace->WriteFilledChunksLocked(NULL);
+  }
+  return NULL;
+}
 
-  size_t final_offset = cur_offset_;
-  uint32_t clock_overhead_ns = GetClockOverheadNanoSeconds(this);
+void Trace::StopFlushThread() {
+  {
+    MutexLock mu(Thread::Current(), *chunk_lock_);
+    flush_thread_stop_ = true;
+    flush_cond_->Signal(Thread::Current());
+  }
+  CHECK_PTHREAD_CALL(pthread_join, (flush_pthread_, NULL), "trace flush thread shutdown");
+  flush_pthread_ = 0U;
+}
 
-  if ((flags_ & kTraceCountAllocs) != 0) {
-    Runtime::Current()->SetStatsEnabled(false);
+// Writes all of a buffer at the given offset of the file.
+static bool PWriteFully(File* file, const uint8_t* buf, size_t byte_count, int64_t offset) {
+  while (byte_count > 0) {
+    int64_t bytes_written = file->Write(reinterpret_cast<const char*>(buf), byte_count, offset);
+    if (bytes_written <= 0) {
+      return false;
+    }
+    buf += bytes_written;
+    byte_count -= bytes_written;
+    offset += bytes_written;
   }
+  return true;
+}
 
-  std::set<mirror::ArtMethod*> visited_methods;
-  GetVisitedMethods(final_offset, &visited_methods);
+void Trace::WriteFilledChunksLocked(Thread* self) {
+  while (!filled_chunks_.empty()) {
+    Chunk chunk = filled_chunks_.front();
+    filled_chunks_.pop_front();
+    // Don't hold up recording threads while writing. Only one thread streams at a time.
+    chunk_lock_->ExclusiveUnlock(self);
+    GetVisitedMethods(chunk, &streamed_methods_);
+    streamed_records_ += chunk.size / GetRecordSize(clock_source_);
+    if (!PWriteFully(trace_file_.get(), chunk.begin, chunk.size, stream_offset_)) {
+      if (!stream_error_) {
+        PLOG(ERROR) << "Trace data write failed";
+      }
+      stream_error_ = true;
+    }
+    stream_offset_ += chunk.size;
+    chunk_lock_->ExclusiveLock(self);
+    free_chunks_.push_back(chunk.begin);
+  }
+}
+
+uint8_t* Trace::SwapThreadChunk(Thread* thread) {
+  if (overflow_ && (flags_ & (kTraceStreaming | kTraceFlightRecorder)) == 0) {
+    return NULL;  // Nothing will be freed, don't bother taking the lock.
+  }
+  Thread* self = Thread::Current();
+  MutexLock mu(self, *chunk_lock_);
+  RetireThreadChunkLocked(thread);
+  uint8_t* chunk;
+  if (!free_chunks_.empty()) {
+    chunk = free_chunks_.front();
+    free_chunks_.pop_front();
+  } else if ((flags_ & kTraceFlightRecorder) != 0 && !filled_chunks_.empty()) {
+    // Overwrite the oldest events.
+    chunk = filled_chunks_.front().begin;
+    filled_chunks_.pop_front();
+    overflow_ = true;
+  } else {
+    overflow_ = true;
+    return NULL;
+  }
+  thread->SetTraceBuffer(chunk, chunk + chunk_size_);
+  return chunk;
+}
+
+void Trace::RetireThreadChunkLocked(Thread* thread) {
+  uint8_t* pos = thread->GetTraceBufferPos();
+  if (pos == NULL) {
+    return;
+  }
+  Chunk chunk;
+  chunk.begin = thread->GetTraceBufferEnd() - chunk_size_;
+  chunk.size = pos - chunk.begin;
+  thread->SetTraceBuffer(NULL, NULL);
+  if (chunk.size == 0) {
+    free_chunks_.push_back(chunk.begin);
+  } else {
+    filled_chunks_.push_back(chunk);
+    if ((flags_ & kTraceStreaming) != 0) {
+      flush_cond_->Signal(Thread::Current());
+    }
+  }
+}
+
+void Trace::RetireThreadChunkCallback(Thread* thread, void* arg) {
+  Trace* trace = reinterpret_cast<Trace*>(arg);
+  MutexLock mu(Thread::Current(), *trace->chunk_lock_);
+  trace->RetireThreadChunkLocked(thread);
+}
+
+void Trace::RetireThreadBuffer(Thread* thread) NO_THREAD_SAFETY_ANALYSIS {
+  // Stop clears the_trace_ before it collects chunks while holding the thread_list_lock_, so a
+  // trace seen here can't be deleted before the chunk is handed over.
+  Trace* the_trace = the_trace_;
+  if (the_trace != NULL) {
+    RetireThreadChunkCallback(thread, the_trace);
+  }
+}
+
+void Trace::GetThreadChunkCallback(Thread* thread, void* arg) {
+  uint8_t* pos = thread->GetTraceBufferPos();
+  if (pos != NULL) {
+    std::pair<Trace*, std::vector<Chunk>*>* args =
+        reinterpret_cast<std::pair<Trace*, std::vector<Chunk>*>*>(arg);
+    Chunk chunk;
+    chunk.begin = thread->GetTraceBufferEnd() - args->first->chunk_size_;
+    chunk.size = pos - chunk.begin;
+    if (chunk.size != 0) {
+      args->second->push_back(chunk);
+    }
+  }
+}
+
+void Trace::GetRecordedChunks(std::vector<Chunk>* chunks) {
+  Thread* self = Thread::Current();
+  {
+    MutexLock mu(self, *chunk_lock_);
+    chunks->assign(filled_chunks_.begin(), filled_chunks_.end());
+  }
+  std::pair<Trace*, std::vector<Chunk>*> args(this, chunks);
+  MutexLock mu(self, *Locks::thread_list_lock_);
+  Runtime::Current()->GetThreadList()->ForEach(GetThreadChunkCallback, &args);
+}
+
+std::string Trace::GetHeader(uint64_t elapsed, size_t num_records,
+                             const std::set<mirror::ArtMethod*>& visited_methods) {
+  uint32_t clock_overhead_ns = GetClockOverheadNanoSeconds(this);
 
   std::ostringstream os;
 
@@ -506,7 +893,6 @@ void Trace::FinishTracing() {
     os << StringPrintf("clock=wall\n");
   }
   os << StringPrintf("elapsed-time-usec=%llu\n", elapsed);
-  size_t num_records = (final_offset - kTraceHeaderLength) / GetRecordSize(clock_source_);
   os << StringPrintf("num-method-calls=%zd\n", num_records);
   os << StringPrintf("clock-call-overhead-nsec=%d\n", clock_overhead_ns);
   os << StringPrintf("vm=art\n");
@@ -520,23 +906,137 @@ void Trace::FinishTracing() {
   os << StringPrintf("%cmethods\n", kTraceTokenChar);
   DumpMethodList(os, visited_methods);
   os << StringPrintf("%cend\n", kTraceTokenChar);
+  return os.str();
+}
 
-  std::string header(os.str());
+bool Trace::WriteTraceFile(const std::string& header, const std::vector<Chunk>& chunks) {
+  if ((flags_ & kTraceFlightRecorder) != 0) {
+    // Each dump replaces the previous one.
+    if (trace_file_->SetLength(0) != 0 || lseek(trace_file_->Fd(), 0, SEEK_SET) != 0) {
+      return false;
+    }
+  }
+  if (!trace_file_->WriteFully(header.c_str(), header.length()) ||
+      !trace_file_->WriteFully(buf_.get(), kTraceHeaderLength)) {
+    return false;
+  }
+  for (const Chunk& chunk : chunks) {
+    if (!trace_file_->WriteFully(chunk.begin, chunk.size)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Inserts 'header' at the start of the first 'data_size' bytes of the file.
+static bool PrependToFile(File* file, const std::string& header, int64_t data_size) {
+  const size_t kBlockSize = 64 * KB;
+  UniquePtr<uint8_t[]> block(new uint8_t[kBlockSize]);
+  int64_t shift = header.length();
+  for (int64_t end = data_size; end > 0; ) {
+    int64_t byte_count = std::min(end, static_cast<int64_t>(kBlockSize));
+    end -= byte_count;
+    if (file->Read(reinterpret_cast<char*>(block.get()), byte_count, end) != byte_count ||
+        !PWriteFully(file, block.get(), byte_count, end + shift)) {
+      return false;
+    }
+  }
+  return PWriteFully(file, reinterpret_cast<const uint8_t*>(header.c_str()), shift, 0) &&
+      file->SetLength(data_size + shift) == 0;
+}
+
+void Trace::DumpForSigQuit(std::ostream& os) {
+  Trace* the_trace;
+  {
+    MutexLock mu(Thread::Current(), *Locks::trace_lock_);
+    the_trace = the_trace_;
+  }
+  if (the_trace == NULL || (the_trace->flags_ & kTraceFlightRecorder) == 0) {
+    return;
+  }
+  // All threads are suspended, so their chunks are stable.
+  std::vector<Chunk> chunks;
+  the_trace->GetRecordedChunks(&chunks);
+  std::set<mirror::ArtMethod*> visited_methods;
+  size_t record_bytes = 0;
+  for (const Chunk& chunk : chunks) {
+    the_trace->GetVisitedMethods(chunk, &visited_methods);
+    record_bytes += chunk.size;
+  }
+  std::string header(the_trace->GetHeader(MicroTime() - the_trace->start_time_,
+                                          record_bytes / GetRecordSize(the_trace->clock_source_),
+                                          visited_methods));
+  if (the_trace->WriteTraceFile(header, chunks)) {
+    os << "Method trace flight recorder written to " << the_trace->trace_file_->GetPath() << "\n";
+  } else {
+    os << "Method trace flight recorder write failed: " << strerror(errno) << "\n";
+  }
+}
+
+void Trace::FinishTracing() {
+  // Compute elapsed time.
+  uint64_t elapsed = MicroTime() - start_time_;
+
+  if ((flags_ & kTraceCountAllocs) != 0) {
+    Runtime::Current()->SetStatsEnabled(false);
+  }
+
+  const bool streaming = (flags_ & kTraceStreaming) != 0;
+  if (streaming) {
+    StopFlushThread();
+  }
+  {
+    MutexLock mu(Thread::Current(), *Locks::thread_list_lock_);
+    Runtime::Current()->GetThreadList()->ForEach(RetireThreadChunkCallback, this);
+  }
+  std::vector<Chunk> chunks;
+  {
+    MutexLock mu(Thread::Current(), *chunk_lock_);
+    if (streaming) {
+      WriteFilledChunksLocked(Thread::Current());
+    } else {
+      chunks.assign(filled_chunks_.begin(), filled_chunks_.end());
+    }
+  }
+
+  std::set<mirror::ArtMethod*> visited_methods;
+  visited_methods.swap(streamed_methods_);
+  size_t num_records = streamed_records_;
+  for (const Chunk& chunk : chunks) {
+    GetVisitedMethods(chunk, &visited_methods);
+    num_records += chunk.size / GetRecordSize(clock_source_);
+  }
+
+  std::string header(GetHeader(elapsed, num_records, visited_methods));
   if (trace_file_.get() == NULL) {
-    iovec iov[2];
+    std::vector<iovec> iov(chunks.size() + 2);
     iov[0].iov_base = reinterpret_cast<void*>(const_cast<char*>(header.c_str()));
     iov[0].iov_len = header.length();
     iov[1].iov_base = buf_.get();
-    iov[1].iov_len = final_offset;
-    Dbg::DdmSendChunkV(CHUNK_TYPE("MPSE"), iov, 2);
+    iov[1].iov_len = kTraceHeaderLength;
+    for (size_t i = 0; i < chunks.size(); ++i) {
+      iov[i + 2].iov_base = chunks[i].begin;
+      iov[i + 2].iov_len = chunks[i].size;
+    }
+    Dbg::DdmSendChunkV(CHUNK_TYPE("MPSE"), &iov[0], iov.size());
     const bool kDumpTraceInfo = false;
     if (kDumpTraceInfo) {
       LOG(INFO) << "Trace sent:\n" << header;
-      DumpBuf(buf_.get(), final_offset, clock_source_);
+      for (const Chunk& chunk : chunks) {
+        DumpBuf(chunk.begin, chunk.size, clock_source_);
+      }
     }
   } else {
-    if (!trace_file_->WriteFully(header.c_str(), header.length()) ||
-        !trace_file_->WriteFully(buf_.get(), final_offset)) {
+    bool success;
+    if (streaming) {
+      // Records went out as they were filled, put the headers in front of them.
+      success = !stream_error_ &&
+          PWriteFully(trace_file_.get(), buf_.get(), kTraceHeaderLength, 0) &&
+          PrependToFile(trace_file_.get(), header, stream_offset_);
+    } else {
+      success = WriteTraceFile(header, chunks);
+    }
+    if (!success) {
       std::string detail(StringPrintf("Trace data write failed: %s", strerror(errno)));
       PLOG(ERROR) << detail;
       ThrowRuntimeException("%s", detail.c_str());
@@ -566,6 +1066,9 @@ void Trace::MethodExited(Thread* thread, mirror::Object* this_object,
   uint32_t thread_clock_diff = 0;
   uint32_t wall_clock_diff = 0;
   ReadClocks(thread, &thread_clock_diff, &wall_clock_diff);
+  if (min_duration_us_ != 0 && DropShortCall(thread, method, thread_clock_diff, wall_clock_diff)) {
+    return;
+  }
   LogMethodTraceEvent(thread, method, instrumentation::Instrumentation::kMethodExited,
                       thread_clock_diff, wall_clock_diff);
 }
@@ -586,35 +1089,64 @@ void Trace::ExceptionCaught(Thread* thread, const ThrowLocation& throw_location,
 }
 
 void Trace::ReadClocks(Thread* thread, uint32_t* thread_clock_diff, uint32_t* wall_clock_diff) {
+  ComputeClockDiffs(thread, UseThreadCpuClock() ? ReadThreadCpuClock(thread) : 0,
+                    UseWallClock() ? MicroTime() : 0, thread_clock_diff, wall_clock_diff);
+}
+
+// How long the thread CPU clock is estimated from the cycle counter before it is read again. The
+// cycles also count while the thread is descheduled, this bounds the error that adds.
+static constexpr uint64_t kThreadCpuClockResyncUs = 1000;
+
+uint64_t Trace::ReadThreadCpuClock(Thread* thread) {
+  if (!estimate_thread_cpu_clock_) {
+    return thread->GetCpuMicroTime();
+  }
+  Thread::TraceCpuClock* clock = thread->GetTraceCpuClock();
+  uint64_t now = CycleClock::Now();
+  uint64_t elapsed_us = CycleClock::CyclesToMicros(now - clock->sample_cycles);
+  uint64_t cpu_us;
+  if (UNLIKELY(clock->sample_cycles == 0 || elapsed_us >= kThreadCpuClockResyncUs)) {
+    cpu_us = thread->GetCpuMicroTime();
+    clock->sample_cycles = now;
+    clock->sample_us = cpu_us;
+  } else {
+    cpu_us = clock->sample_us + elapsed_us;
+  }
+  // An estimate may run ahead of the kernel's clock, never let the time go backwards.
+  cpu_us = std::max(cpu_us, clock->last_us);
+  clock->last_us = cpu_us;
+  return cpu_us;
+}
+
+void Trace::ComputeClockDiffs(Thread* thread, uint64_t thread_cpu_us, uint64_t wall_us,
+                              uint32_t* thread_clock_diff, uint32_t* wall_clock_diff) {
   if (UseThreadCpuClock()) {
     uint64_t clock_base = thread->GetTraceClockBase();
     if (UNLIKELY(clock_base == 0)) {
       // First event, record the base time in the map.
-      uint64_t time = thread->GetCpuMicroTime();
-      thread->SetTraceClockBase(time);
+      thread->SetTraceClockBase(thread_cpu_us);
     } else {
-      *thread_clock_diff = thread->GetCpuMicroTime() - clock_base;
+      *thread_clock_diff = thread_cpu_us - clock_base;
     }
   }
   if (UseWallClock()) {
-    *wall_clock_diff = MicroTime() - start_time_;
+    *wall_clock_diff = (wall_us > start_time_) ? wall_us - start_time_ : 0;
   }
 }
 
 void Trace::LogMethodTraceEvent(Thread* thread, const mirror::ArtMethod* method,
                                 instrumentation::Instrumentation::InstrumentationEvent event,
                                 uint32_t thread_clock_diff, uint32_t wall_clock_diff) {
-  // Advance cur_offset_ atomically.
-  int32_t new_offset;
-  int32_t old_offset;
-  do {
-    old_offset = cur_offset_;
-    new_offset = old_offset + GetRecordSize(clock_source_);
-    if (new_offset > buffer_size_) {
-      overflow_ = true;
+  // Claim space in the thread's own chunk, only taking a lock when it's full.
+  size_t record_size = GetRecordSize(clock_source_);
+  uint8_t* ptr = thread->GetTraceBufferPos();
+  if (UNLIKELY(ptr == NULL || ptr + record_size > thread->GetTraceBufferEnd())) {
+    ptr = SwapThreadChunk(thread);
+    if (ptr == NULL) {
       return;
     }
-  } while (android_atomic_release_cas(old_offset, new_offset, &cur_offset_) != 0);
+  }
+  thread->SetTraceBufferPos(ptr + record_size);
 
   TraceAction action = kTraceMethodEnter;
   switch (event) {
@@ -634,7 +1166,6 @@ void Trace::LogMethodTraceEvent(Thread* thread, const mirror::ArtMethod* method,
   uint32_t method_value = EncodeTraceMethodAndAction(method, action);
 
   // Write data
-  uint8_t* ptr = buf_.get() + old_offset;
   Append2LE(ptr, thread->GetTid());
   Append4LE(ptr + 2, method_value);
   ptr += 6;
@@ -648,10 +1179,34 @@ void Trace::LogMethodTraceEvent(Thread* thread, const mirror::ArtMethod* method,
   }
 }
 
-void Trace::GetVisitedMethods(size_t buf_size,
+bool Trace::DropShortCall(Thread* thread, const mirror::ArtMethod* method,
+                          uint32_t thread_clock_diff, uint32_t wall_clock_diff) {
+  size_t record_size = GetRecordSize(clock_source_);
+  uint8_t* pos = thread->GetTraceBufferPos();
+  // The entry event must be in the thread's current chunk, other chunks may be written already.
+  if (pos == NULL || static_cast<size_t>(pos - (thread->GetTraceBufferEnd() - chunk_size_)) <
+      record_size) {
+    return false;
+  }
+  uint8_t* entry = pos - record_size;
+  uint32_t method_value = entry[2] | (entry[3] << 8) | (entry[4] << 16) | (entry[5] << 24);
+  if (method_value != EncodeTraceMethodAndAction(method, kTraceMethodEnter)) {
+    return false;
+  }
+  // The first clock of a record is the thread CPU clock if it is used, else the wall clock.
+  uint32_t entry_time = entry[6] | (entry[7] << 8) | (entry[8] << 16) | (entry[9] << 24);
+  uint32_t exit_time = UseThreadCpuClock() ? thread_clock_diff : wall_clock_diff;
+  if (exit_time - entry_time >= min_duration_us_) {
+    return false;
+  }
+  thread->SetTraceBufferPos(entry);
+  return true;
+}
+
+void Trace::GetVisitedMethods(const Chunk& chunk,
                               std::set<mirror::ArtMethod*>* visited_methods) {
-  uint8_t* ptr = buf_.get() + kTraceHeaderLength;
-  uint8_t* end = buf_.get() + buf_size;
+  uint8_t* ptr = chunk.begin;
+  uint8_t* end = chunk.begin + chunk.size;
 
   while (ptr < end) {
     uint32_t tmid = ptr[2] | (ptr[3] << 8) | (ptr[4] << 16) | (ptr[5] << 24);
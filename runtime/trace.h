@@ -17,12 +17,15 @@
 #ifndef ART_RUNTIME_TRACE_H_
 #define ART_RUNTIME_TRACE_H_
 
+#include <deque>
 #include <ostream>
 #include <set>
 #include <string>
 #include <vector>
 
 #include "base/macros.h"
+#include "base/mutex.h"
+#include "cutils/atomic-inline.h"
 #include "globals.h"
 #include "instrumentation.h"
 #include "os.h"
@@ -48,14 +51,116 @@ enum TracingMode {
   kSampleProfilingActive,
 };
 
+// A ring of stack samples owned by one thread. The thread's own SIGPROF handler is the only
+// producer and the sampling profiler thread the only consumer, so the ring is lock free and safe
+// to fill from a signal handler. When the consumer falls behind, new samples are dropped.
+class TraceSampleBuffer {
+ public:
+  static const size_t kCapacity = 16;
+  static const size_t kMaxDepth = 128;
+
+  struct Sample {
+    uint64_t thread_cpu_us;
+    uint64_t wall_us;
+    size_t depth;
+    // Innermost frame first, runtime methods excluded.
+    mirror::ArtMethod* methods[kMaxDepth];
+  };
+
+  TraceSampleBuffer() : head_(0), tail_(0), dropped_(0) {}
+
+  // Producer: returns the slot to fill, or NULL when the ring is full.
+  Sample* BeginWrite() {
+    if (head_ - tail_ == kCapacity) {
+      return NULL;
+    }
+    return &samples_[head_ % kCapacity];
+  }
+
+  // Producer: publishes the slot returned by BeginWrite.
+  void EndWrite() {
+    ANDROID_MEMBAR_STORE();
+    head_ = head_ + 1;
+  }
+
+  // Producer: records a sample that couldn't be taken.
+  void DropSample() {
+    dropped_ = dropped_ + 1;
+  }
+
+  // Consumer: returns the oldest published sample, or NULL when the ring is empty.
+  const Sample* BeginRead() {
+    if (tail_ == head_) {
+      return NULL;
+    }
+    ANDROID_MEMBAR_FULL();
+    return &samples_[tail_ % kCapacity];
+  }
+
+  // Consumer: releases the slot returned by BeginRead back to the producer.
+  void EndRead() {
+    ANDROID_MEMBAR_FULL();
+    tail_ = tail_ + 1;
+  }
+
+  // Consumer: throws away all published samples.
+  void Discard() {
+    ANDROID_MEMBAR_FULL();
+    tail_ = head_;
+  }
+
+  uint32_t GetDroppedCount() const {
+    return dropped_;
+  }
+
+ private:
+  // Count of samples ever published, only written by the producer.
+  volatile uint32_t head_;
+  // Count of samples ever consumed, only written by the consumer.
+  volatile uint32_t tail_;
+  volatile uint32_t dropped_;
+  Sample samples_[kCapacity];
+
+  DISALLOW_COPY_AND_ASSIGN(TraceSampleBuffer);
+};
+
+// The methods a method trace records: those whose name, as in "java.lang.String.charAt", starts
+// with one of the prefixes. A prefix can name a package, a class or a single method.
+class TraceMethodFilter : public instrumentation::InstrumentationMethodFilter {
+ public:
+  explicit TraceMethodFilter(const std::vector<std::string>& prefixes) : prefixes_(prefixes) {}
+
+  virtual bool Matches(const mirror::ArtMethod* method) const
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
+ private:
+  const std::vector<std::string> prefixes_;
+
+  DISALLOW_COPY_AND_ASSIGN(TraceMethodFilter);
+};
+
 class Trace : public instrumentation::InstrumentationListener {
  public:
   enum TraceFlag {
     kTraceCountAllocs = 1,
+    // Write filled buffers to the trace file while tracing runs, so a trace isn't cut off once
+    // buffer_size bytes of events have been recorded. Requires a trace file.
+    kTraceStreaming = 2,
+    // Keep only the most recent buffer_size bytes of events, overwriting the oldest ones. The
+    // trace file is written on SIGQUIT as well as on Stop. Requires a trace file.
+    kTraceFlightRecorder = 4,
   };
 
   static void SetDefaultClockSource(ProfilerClockSource clock_source);
 
+  // Limits the method traces started later to the methods matching a comma separated list of
+  // TraceMethodFilter prefixes, or to all methods when empty. Sample profiling isn't filtered.
+  static void SetDefaultMethodFilter(const std::string& filter);
+
+  // Leaves out of the method traces started later the calls that take less than min_duration_us
+  // and record no events of their own, which are most of the events of a trace.
+  static void SetDefaultMinDuration(uint32_t min_duration_us);
+
   static void Start(const char* trace_filename, int trace_fd, int buffer_size, int flags,
                     bool direct_to_ddms, bool sampling_enabled, int interval_us)
   LOCKS_EXCLUDED(Locks::mutator_lock_,
@@ -66,10 +171,27 @@ class Trace : public instrumentation::InstrumentationListener {
   static void Shutdown() LOCKS_EXCLUDED(Locks::trace_lock_);
   static TracingMode GetMethodTracingMode() LOCKS_EXCLUDED(Locks::trace_lock_);
 
+  // Hands the events an exiting thread has buffered to the trace.
+  static void RetireThreadBuffer(Thread* thread)
+      EXCLUSIVE_LOCKS_REQUIRED(Locks::thread_list_lock_);
+
+  // Writes the events kept by a flight recorder trace to its file.
+  static void DumpForSigQuit(std::ostream& os)
+      EXCLUSIVE_LOCKS_REQUIRED(Locks::mutator_lock_)
+      LOCKS_EXCLUDED(Locks::trace_lock_, Locks::thread_list_lock_);
+
   bool UseWallClock();
   bool UseThreadCpuClock();
 
-  void CompareAndUpdateStackTrace(Thread* thread, std::vector<mirror::ArtMethod*>* stack_trace)
+  // Returns the thread's CPU time in microseconds.
+  uint64_t ReadThreadCpuClock(Thread* thread);
+
+  void CompareAndUpdateStackTrace(Thread* thread, std::vector<mirror::ArtMethod*>* stack_trace,
+                                  uint32_t thread_clock_diff, uint32_t wall_clock_diff)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
+  // Turns the samples a thread's signal handler has recorded into trace events.
+  void DrainSamples(Thread* thread, TraceSampleBuffer* buffer)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
 
   virtual void MethodEntered(Thread* thread, mirror::Object* this_object,
@@ -95,21 +217,57 @@ class Trace : public instrumentation::InstrumentationListener {
   static void FreeStackTrace(std::vector<mirror::ArtMethod*>* stack_trace);
 
  private:
+  // A run of records in buf_, filled by a single thread.
+  struct Chunk {
+    uint8_t* begin;
+    size_t size;
+  };
+
   explicit Trace(File* trace_file, int buffer_size, int flags, bool sampling_enabled);
+  ~Trace();
 
   // The sampling interval in microseconds is passed as an argument.
   static void* RunSamplingThread(void* arg) LOCKS_EXCLUDED(Locks::trace_lock_);
 
+  // Streaming thread that writes filled chunks to the trace file.
+  static void* RunFlushThread(void* arg);
+  void StopFlushThread() LOCKS_EXCLUDED(chunk_lock_);
+  void WriteFilledChunksLocked(Thread* self) EXCLUSIVE_LOCKS_REQUIRED(chunk_lock_);
+
+  // Gives the thread a new chunk to record into, returning NULL if there's none to spare.
+  uint8_t* SwapThreadChunk(Thread* thread) LOCKS_EXCLUDED(chunk_lock_);
+  void RetireThreadChunkLocked(Thread* thread) EXCLUSIVE_LOCKS_REQUIRED(chunk_lock_);
+  static void RetireThreadChunkCallback(Thread* thread, void* arg) NO_THREAD_SAFETY_ANALYSIS;
+  static void GetThreadChunkCallback(Thread* thread, void* arg) NO_THREAD_SAFETY_ANALYSIS;
+
+  // Returns the chunks holding records, oldest first, leaving threads their current chunks.
+  void GetRecordedChunks(std::vector<Chunk>* chunks)
+      LOCKS_EXCLUDED(Locks::thread_list_lock_, chunk_lock_);
+
+  std::string GetHeader(uint64_t elapsed, size_t num_records,
+                        const std::set<mirror::ArtMethod*>& visited_methods)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+  bool WriteTraceFile(const std::string& header, const std::vector<Chunk>& chunks);
+
   void FinishTracing() SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
 
   void ReadClocks(Thread* thread, uint32_t* thread_clock_diff, uint32_t* wall_clock_diff);
 
+  // Like ReadClocks, but for clock values read earlier, such as in a signal handler.
+  void ComputeClockDiffs(Thread* thread, uint64_t thread_cpu_us, uint64_t wall_us,
+                         uint32_t* thread_clock_diff, uint32_t* wall_clock_diff);
+
   void LogMethodTraceEvent(Thread* thread, const mirror::ArtMethod* method,
                            instrumentation::Instrumentation::InstrumentationEvent event,
                            uint32_t thread_clock_diff, uint32_t wall_clock_diff);
 
+  // Removes the entry event of the method if it is the thread's last one and the method returns
+  // within min_duration_us_ of it, and returns whether it did.
+  bool DropShortCall(Thread* thread, const mirror::ArtMethod* method,
+                     uint32_t thread_clock_diff, uint32_t wall_clock_diff);
+
   // Methods to output traced methods and threads.
-  void GetVisitedMethods(size_t end_offset, std::set<mirror::ArtMethod*>* visited_methods);
+  void GetVisitedMethods(const Chunk& chunk, std::set<mirror::ArtMethod*>* visited_methods);
   void DumpMethodList(std::ostream& os, const std::set<mirror::ArtMethod*>& visited_methods)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
   void DumpThreadList(std::ostream& os) LOCKS_EXCLUDED(Locks::thread_list_lock_);
@@ -120,6 +278,10 @@ class Trace : public instrumentation::InstrumentationListener {
   // The default profiler clock source.
   static ProfilerClockSource default_clock_source_;
 
+  // See SetDefaultMethodFilter and SetDefaultMinDuration.
+  static std::vector<std::string> default_method_filter_;
+  static uint32_t default_min_duration_us_;
+
   // Sampling thread, non-zero when sampling.
   static pthread_t sampling_pthread_;
 
@@ -140,14 +302,43 @@ class Trace : public instrumentation::InstrumentationListener {
 
   const ProfilerClockSource clock_source_;
 
+  // True if the thread CPU clock is estimated from the cycle counter between reads of the kernel's
+  // clock, see ReadThreadCpuClock.
+  const bool estimate_thread_cpu_clock_;
+
   // Size of buf_.
   const int buffer_size_;
 
+  // The methods traced, NULL for all of them.
+  UniquePtr<TraceMethodFilter> method_filter_;
+
+  const uint32_t min_duration_us_;
+
   // Time trace was created.
   const uint64_t start_time_;
 
-  // Offset into buf_.
-  volatile int32_t cur_offset_;
+  // Size of the chunks of buf_ that threads record events into, a whole number of records.
+  const size_t chunk_size_;
+
+  // Guards the chunk lists and the streaming thread's state.
+  Mutex* chunk_lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
+  UniquePtr<ConditionVariable> flush_cond_;
+
+  // Chunks no thread is recording into.
+  std::deque<uint8_t*> free_chunks_ GUARDED_BY(chunk_lock_);
+
+  // Chunks given back by threads, oldest first. When streaming, they're waiting to be written.
+  std::deque<Chunk> filled_chunks_ GUARDED_BY(chunk_lock_);
+
+  // Streaming thread, non-zero when streaming.
+  pthread_t flush_pthread_;
+  bool flush_thread_stop_ GUARDED_BY(chunk_lock_);
+
+  // When streaming, the file offset of the next chunk and the methods seen in written chunks.
+  int64_t stream_offset_;
+  size_t streamed_records_;
+  std::set<mirror::ArtMethod*> streamed_methods_;
+  bool stream_error_;
 
   // Did we overflow the buffer recording traces?
   bool overflow_;
@@ -16,16 +16,60 @@
 
 #include "utf.h"
 
+#include <string.h>
+
 #include "base/logging.h"
 #include "mirror/array.h"
 #include "mirror/object-inl.h"
 
 namespace art {
 
+// Most strings are ASCII. The fast paths below check 8 bytes, or 4 UTF-16 chars, at a time with
+// plain 64-bit arithmetic, which leaves the widening and narrowing loops simple enough for the
+// compiler to vectorize, and fall back to a char at a time at the first char that isn't ASCII.
+static const uint64_t kLowBytes = UINT64_C(0x0101010101010101);
+static const uint64_t kHighBits = UINT64_C(0x8080808080808080);
+static const uint64_t kLowChars = UINT64_C(0x0001000100010001);
+static const uint64_t kNonAsciiChars = UINT64_C(0xff80ff80ff80ff80);
+
+// Whether all 8 bytes of word are in [1, 0x7f]. A byte out of the range either has its high bit
+// set or, being 0, sets it when 1 is subtracted; bytes above a 0 may then borrow, which is
+// harmless as the word is rejected anyway.
+static inline bool IsAsciiWord(uint64_t word) {
+  return (((word - kLowBytes) | word) & kHighBits) == 0;
+}
+
+// Whether all 4 chars of word are in [1, 0x7f], which modified UTF-8 encodes in a single byte.
+static inline bool IsAsciiChars(uint64_t word) {
+  return (((word - kLowChars) | word) & kNonAsciiChars) == 0;
+}
+
+// Reads the 8 bytes at the 8-byte aligned p. As they don't cross a page, this can read past the
+// terminating NUL of a string that ends in them.
+static inline uint64_t LoadAlignedWord(const char* p) {
+  DCHECK_EQ(reinterpret_cast<uintptr_t>(p) % sizeof(uint64_t), 0U);
+  uint64_t word;
+  memcpy(&word, p, sizeof(word));
+  return word;
+}
+
+static inline bool IsWordAligned(const char* p) {
+  return reinterpret_cast<uintptr_t>(p) % sizeof(uint64_t) == 0;
+}
+
 size_t CountModifiedUtf8Chars(const char* utf8) {
   size_t len = 0;
-  int ic;
-  while ((ic = *utf8++) != '\0') {
+  for (;;) {
+    if (IsWordAligned(utf8)) {
+      while (IsAsciiWord(LoadAlignedWord(utf8))) {
+        utf8 += sizeof(uint64_t);
+        len += sizeof(uint64_t);
+      }
+    }
+    int ic = *utf8++;
+    if (ic == '\0') {
+      break;
+    }
     len++;
     if ((ic & 0x80) == 0) {
       // one-byte encoding
@@ -45,12 +89,44 @@ size_t CountModifiedUtf8Chars(const char* utf8) {
 
 void ConvertModifiedUtf8ToUtf16(uint16_t* utf16_data_out, const char* utf8_data_in) {
   while (*utf8_data_in != '\0') {
-    *utf16_data_out++ = GetUtf16FromUtf8(&utf8_data_in);
+    // Most strings are ASCII, which is copied without decoding.
+    uint8_t ch = *utf8_data_in;
+    if (LIKELY((ch & 0x80) == 0)) {
+      *utf16_data_out++ = ch;
+      ++utf8_data_in;
+      if (IsWordAligned(utf8_data_in)) {
+        while (IsAsciiWord(LoadAlignedWord(utf8_data_in))) {
+          const uint8_t* in = reinterpret_cast<const uint8_t*>(utf8_data_in);
+          for (size_t i = 0; i < sizeof(uint64_t); ++i) {
+            utf16_data_out[i] = in[i];
+          }
+          utf16_data_out += sizeof(uint64_t);
+          utf8_data_in += sizeof(uint64_t);
+        }
+      }
+    } else {
+      *utf16_data_out++ = GetUtf16FromUtf8(&utf8_data_in);
+    }
   }
 }
 
 void ConvertUtf16ToModifiedUtf8(char* utf8_out, const uint16_t* utf16_in, size_t char_count) {
-  while (char_count--) {
+  const size_t kCharsPerWord = sizeof(uint64_t) / sizeof(uint16_t);
+  while (char_count != 0) {
+    if (char_count >= kCharsPerWord) {
+      uint64_t word;
+      memcpy(&word, utf16_in, sizeof(word));
+      if (IsAsciiChars(word)) {
+        for (size_t i = 0; i < kCharsPerWord; ++i) {
+          utf8_out[i] = utf16_in[i];
+        }
+        utf8_out += kCharsPerWord;
+        utf16_in += kCharsPerWord;
+        char_count -= kCharsPerWord;
+        continue;
+      }
+    }
+    --char_count;
     uint16_t ch = *utf16_in++;
     if (ch > 0 && ch <= 0x7f) {
       *utf8_out++ = ch;
@@ -69,19 +145,25 @@ void ConvertUtf16ToModifiedUtf8(char* utf8_out, const uint16_t* utf16_in, size_t
 
 int32_t ComputeUtf16Hash(const mirror::CharArray* chars, int32_t offset,
                          size_t char_count) {
-  int32_t hash = 0;
-  for (size_t i = 0; i < char_count; i++) {
-    hash = hash * 31 + chars->Get(offset + i);
-  }
-  return hash;
+  DCHECK_LE(offset + char_count, static_cast<size_t>(chars->GetLength()));
+  return ComputeUtf16Hash(chars->GetData() + offset, char_count);
 }
 
 int32_t ComputeUtf16Hash(const uint16_t* chars, size_t char_count) {
-  int32_t hash = 0;
+  // hash * 31 + c, four chars at a time: hash * 31^4 + c0 * 31^3 + c1 * 31^2 + c2 * 31 + c3. The
+  // four products are independent, unlike the steps of the one char loop, and unsigned arithmetic
+  // wraps around as the Java int arithmetic does.
+  uint32_t hash = 0;
+  while (char_count >= 4) {
+    hash = hash * (31 * 31 * 31 * 31) + chars[0] * (31 * 31 * 31) + chars[1] * (31 * 31) +
+        chars[2] * 31 + chars[3];
+    chars += 4;
+    char_count -= 4;
+  }
   while (char_count--) {
     hash = hash * 31 + *chars++;
   }
-  return hash;
+  return static_cast<int32_t>(hash);
 }
 
 
@@ -138,7 +220,19 @@ int CompareModifiedUtf8ToUtf16AsCodePointValues(const char* utf8_1, const uint16
 
 size_t CountUtf8Bytes(const uint16_t* chars, size_t char_count) {
   size_t result = 0;
-  while (char_count--) {
+  const size_t kCharsPerWord = sizeof(uint64_t) / sizeof(uint16_t);
+  while (char_count != 0) {
+    if (char_count >= kCharsPerWord) {
+      uint64_t word;
+      memcpy(&word, chars, sizeof(word));
+      if (IsAsciiChars(word)) {
+        result += kCharsPerWord;
+        chars += kCharsPerWord;
+        char_count -= kCharsPerWord;
+        continue;
+      }
+    }
+    --char_count;
     uint16_t ch = *chars++;
     if (ch > 0 && ch <= 0x7f) {
       ++result;
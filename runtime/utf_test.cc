@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "utf.h"
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace art {
+
+// Encodes chars as modified UTF-8 one char at a time, as the conversions did before they had an
+// ASCII fast path.
+static std::string EncodeSlowly(const std::vector<uint16_t>& chars) {
+  std::string result;
+  for (size_t i = 0; i < chars.size(); ++i) {
+    uint16_t ch = chars[i];
+    if (ch > 0 && ch <= 0x7f) {
+      result += static_cast<char>(ch);
+    } else if (ch > 0x7ff) {
+      result += static_cast<char>((ch >> 12) | 0xe0);
+      result += static_cast<char>(((ch >> 6) & 0x3f) | 0x80);
+      result += static_cast<char>((ch & 0x3f) | 0x80);
+    } else {
+      result += static_cast<char>((ch >> 6) | 0xc0);
+      result += static_cast<char>((ch & 0x3f) | 0x80);
+    }
+  }
+  return result;
+}
+
+static int32_t HashSlowly(const std::vector<uint16_t>& chars) {
+  uint32_t hash = 0;
+  for (size_t i = 0; i < chars.size(); ++i) {
+    hash = hash * 31 + chars[i];
+  }
+  return static_cast<int32_t>(hash);
+}
+
+// ASCII runs of various lengths broken up by two- and three-byte chars and embedded NULs, which
+// modified UTF-8 encodes in two bytes.
+static std::vector<uint16_t> MixedChars(size_t length, size_t seed) {
+  static const uint16_t kNonAscii[] = { 0x00e9, 0x0000, 0x20ac, 0x07ff, 0x0080, 0xffff };
+  std::vector<uint16_t> chars;
+  for (size_t i = 0; i < length; ++i) {
+    size_t n = (i * 7 + seed) % 23;
+    if (n == 0) {
+      chars.push_back(kNonAscii[(i + seed) % arraysize(kNonAscii)]);
+    } else {
+      chars.push_back('a' + n);
+    }
+  }
+  return chars;
+}
+
+TEST(UtfTest, MixedContent) {
+  for (size_t length = 0; length < 80; ++length) {
+    for (size_t seed = 0; seed < 23; ++seed) {
+      std::vector<uint16_t> chars(MixedChars(length, seed));
+      std::string expected(EncodeSlowly(chars));
+      // Try every alignment of the UTF-8, the fast paths read aligned words.
+      for (size_t misalignment = 0; misalignment < sizeof(uint64_t); ++misalignment) {
+        std::string buffer(misalignment, 'x');
+        buffer += expected;
+        const char* utf8 = buffer.c_str() + misalignment;
+        ASSERT_EQ(length, CountModifiedUtf8Chars(utf8));
+        std::vector<uint16_t> utf16(length + 1, 0xdead);
+        ConvertModifiedUtf8ToUtf16(&utf16[0], utf8);
+        ASSERT_EQ(0xdead, utf16[length]);
+        utf16.pop_back();
+        ASSERT_TRUE(chars == utf16);
+      }
+      ASSERT_EQ(expected.size(), CountUtf8Bytes(chars.empty() ? NULL : &chars[0], length));
+      std::string utf8(expected.size(), '\0');
+      if (length != 0) {
+        ConvertUtf16ToModifiedUtf8(&utf8[0], &chars[0], length);
+      }
+      ASSERT_EQ(expected, utf8);
+      ASSERT_EQ(HashSlowly(chars), ComputeUtf16Hash(chars.empty() ? NULL : &chars[0], length));
+    }
+  }
+}
+
+TEST(UtfTest, Hash) {
+  const uint16_t kHello[] = { 'h', 'e', 'l', 'l', 'o' };
+  EXPECT_EQ(99162322, ComputeUtf16Hash(kHello, arraysize(kHello)));
+  EXPECT_EQ(0, ComputeUtf16Hash(kHello, 0));
+}
+
+}  // namespace art
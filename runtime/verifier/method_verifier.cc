@@ -47,12 +47,22 @@ namespace verifier {
 static const bool gDebugVerify = false;
 // TODO: Add a constant to method_verifier to turn on verbose logging?
 
+// The maps for the compiler are kept by dex2oat and by runtimes that compile hot methods.
+static bool RecordsCompilerData() {
+  Runtime* runtime = Runtime::Current();
+  return runtime->IsCompiler() || runtime->GetHotMethodThreshold() != 0;
+}
+
 void PcToRegisterLineTable::Init(RegisterTrackingMode mode, InstructionFlags* flags,
                                  uint32_t insns_size, uint16_t registers_size,
                                  MethodVerifier* verifier) {
   DCHECK_GT(insns_size, 0U);
   register_lines_.reset(new RegisterLine*[insns_size]());
   size_ = insns_size;
+  // Find the interesting instructions first, marking them with a non-NULL line, so that the lines
+  // can be allocated at once.
+  RegisterLine* const kInteresting = reinterpret_cast<RegisterLine*>(1);
+  size_t num_lines = 0;
   for (uint32_t i = 0; i < insns_size; i++) {
     bool interesting = false;
     switch (mode) {
@@ -69,16 +79,28 @@ void PcToRegisterLineTable::Init(RegisterTrackingMode mode, InstructionFlags* fl
         break;
     }
     if (interesting) {
-      register_lines_[i] = RegisterLine::Create(registers_size, verifier);
+      register_lines_[i] = kInteresting;
+      num_lines++;
+    }
+  }
+  const size_t line_size = RegisterLine::ComputeSize(registers_size);
+  line_storage_.reset(new uint8_t[num_lines * line_size]);
+  uint8_t* storage = line_storage_.get();
+  for (uint32_t i = 0; i < insns_size; i++) {
+    if (register_lines_[i] != NULL) {
+      register_lines_[i] = RegisterLine::Create(registers_size, verifier, storage);
+      storage += line_size;
     }
   }
 }
 
 PcToRegisterLineTable::~PcToRegisterLineTable() {
   for (size_t i = 0; i < size_; i++) {
-    delete register_lines_[i];
-    if (kIsDebugBuild) {
-      register_lines_[i] = nullptr;
+    if (register_lines_[i] != NULL) {
+      register_lines_[i]->~RegisterLine();
+      if (kIsDebugBuild) {
+        register_lines_[i] = nullptr;
+      }
     }
   }
 }
@@ -139,6 +161,10 @@ MethodVerifier::FailureKind MethodVerifier::VerifyClass(const DexFile* dex_file,
   }
   size_t error_count = 0;
   bool hard_fail = false;
+  // Unresolved types of all methods, not only the failing ones, as a type that resolves at
+  // runtime may as well make a method fail that didn't at compile time.
+  std::set<uint16_t> unresolved_types;
+  bool unresolved_types_complete = Runtime::Current()->IsCompiler();
   ClassLinker* linker = Runtime::Current()->GetClassLinker();
   int64_t previous_direct_method_idx = -1;
   while (it.HasNextDirectMethod()) {
@@ -166,7 +192,9 @@ MethodVerifier::FailureKind MethodVerifier::VerifyClass(const DexFile* dex_file,
                                                       it.GetMethodCodeItem(),
                                                       method,
                                                       it.GetMemberAccessFlags(),
-                                                      allow_soft_failures);
+                                                      allow_soft_failures,
+                                                      &unresolved_types,
+                                                      &unresolved_types_complete);
     if (result != kNoFailure) {
       if (result == kHardFailure) {
         hard_fail = true;
@@ -208,7 +236,9 @@ MethodVerifier::FailureKind MethodVerifier::VerifyClass(const DexFile* dex_file,
                                                       it.GetMethodCodeItem(),
                                                       method,
                                                       it.GetMemberAccessFlags(),
-                                                      allow_soft_failures);
+                                                      allow_soft_failures,
+                                                      &unresolved_types,
+                                                      &unresolved_types_complete);
     if (result != kNoFailure) {
       if (result == kHardFailure) {
         hard_fail = true;
@@ -227,6 +257,10 @@ MethodVerifier::FailureKind MethodVerifier::VerifyClass(const DexFile* dex_file,
   if (error_count == 0) {
     return kNoFailure;
   } else {
+    if (!hard_fail && unresolved_types_complete && !unresolved_types.empty()) {
+      ClassReference ref(dex_file, dex_file->GetIndexForClassDef(*class_def));
+      SetVerificationDependencies(ref, unresolved_types);
+    }
     return hard_fail ? kHardFailure : kSoftFailure;
   }
 }
@@ -239,16 +273,24 @@ MethodVerifier::FailureKind MethodVerifier::VerifyMethod(uint32_t method_idx,
                                                          const DexFile::CodeItem* code_item,
                                                          mirror::ArtMethod* method,
                                                          uint32_t method_access_flags,
-                                                         bool allow_soft_failures) {
+                                                         bool allow_soft_failures,
+                                                         std::set<uint16_t>* unresolved_types,
+                                                         bool* unresolved_types_complete) {
   MethodVerifier::FailureKind result = kNoFailure;
   uint64_t start_ns = NanoTime();
 
   MethodVerifier verifier_(dex_file, dex_cache, class_loader, class_def, code_item, method_idx,
                            method, method_access_flags, true, allow_soft_failures);
+  // Only the compiler reads the lines after verification, see VerifyCodeFlow.
+  verifier_.track_merge_points_only_ = !Runtime::Current()->IsCompiler();
   if (verifier_.Verify()) {
     // Verification completed, however failures may be pending that didn't cause the verification
     // to hard fail.
     CHECK(!verifier_.have_pending_hard_failure_);
+    if (*unresolved_types_complete) {
+      *unresolved_types_complete = !verifier_.have_non_missing_class_failure_ &&
+          verifier_.reg_types_.GetUnresolvedTypes(*dex_file, unresolved_types);
+    }
     if (verifier_.failures_.size() != 0) {
       if (VLOG_IS_ON(verifier)) {
           verifier_.DumpFailures(VLOG_STREAM(verifier) << "Soft verification failures in "
@@ -313,15 +355,27 @@ MethodVerifier::MethodVerifier(const DexFile* dex_file, mirror::DexCache* dex_ca
       monitor_enter_dex_pcs_(NULL),
       have_pending_hard_failure_(false),
       have_pending_runtime_throw_failure_(false),
+      have_non_missing_class_failure_(false),
       new_instance_count_(0),
       monitor_enter_count_(0),
       can_load_classes_(can_load_classes),
       allow_soft_failures_(allow_soft_failures),
       has_check_casts_(false),
-      has_virtual_or_interface_invokes_(false) {
+      has_virtual_or_interface_invokes_(false),
+      for_hot_method_compiler_(false),
+      track_merge_points_only_(false) {
   DCHECK(class_def != NULL);
 }
 
+bool MethodVerifier::VerifyMethodForCompilation(mirror::ArtMethod* m) {
+  MethodHelper mh(m);
+  MethodVerifier verifier(&mh.GetDexFile(), mh.GetDexCache(), mh.GetClassLoader(),
+                          &mh.GetClassDef(), mh.GetCodeItem(), m->GetDexMethodIndex(),
+                          m, m->GetAccessFlags(), false, true);
+  verifier.for_hot_method_compiler_ = true;
+  return verifier.Verify();
+}
+
 void MethodVerifier::FindLocksAtDexPc(mirror::ArtMethod* m, uint32_t dex_pc,
                                       std::vector<uint32_t>& monitor_enter_dex_pcs) {
   MethodHelper mh(m);
@@ -397,7 +451,8 @@ mirror::ArtMethod* MethodVerifier::FindInvokedMethodAtDexPc(uint32_t dex_pc) {
     return NULL;
   }
   const Instruction* inst = Instruction::At(code_item_->insns_ + dex_pc);
-  const bool is_range = (inst->Opcode() == Instruction::INVOKE_VIRTUAL_RANGE_QUICK);
+  const bool is_range = (inst->Opcode() == Instruction::INVOKE_VIRTUAL_RANGE_QUICK ||
+                         inst->Opcode() == Instruction::INVOKE_SUPER_RANGE_QUICK);
   return GetQuickInvokedMethod(inst, register_line, is_range);
 }
 
@@ -430,6 +485,9 @@ bool MethodVerifier::Verify() {
 }
 
 std::ostream& MethodVerifier::Fail(VerifyError error) {
+  if (error != VERIFY_ERROR_NO_CLASS) {
+    have_non_missing_class_failure_ = true;
+  }
   switch (error) {
     case VERIFY_ERROR_NO_CLASS:
     case VERIFY_ERROR_NO_FIELD:
@@ -1017,7 +1075,7 @@ bool MethodVerifier::VerifyCodeFlow() {
                  << " insns_size=" << insns_size << ")";
   }
   /* Create and initialize table holding register status */
-  reg_table_.Init(kTrackCompilerInterestPoints,
+  reg_table_.Init(track_merge_points_only_ ? kTrackRegsBranches : kTrackCompilerInterestPoints,
                   insn_flags_.get(),
                   insns_size,
                   registers_size,
@@ -1042,9 +1100,9 @@ bool MethodVerifier::VerifyCodeFlow() {
   }
 
   // Compute information for compiler.
-  if (Runtime::Current()->IsCompiler()) {
+  if (Runtime::Current()->IsCompiler() || for_hot_method_compiler_) {
     MethodReference ref(dex_file_, dex_method_idx_);
-    bool compile = IsCandidateForCompilation(ref, method_access_flags_);
+    bool compile = for_hot_method_compiler_ || IsCandidateForCompilation(ref, method_access_flags_);
     if (compile) {
       /* Generate a register map and add it to the method. */
       const std::vector<uint8_t>* dex_gc_map = GenerateLengthPrefixedGcMap();
@@ -2539,8 +2597,11 @@ bool MethodVerifier::CodeFlowVerifyInstruction(uint32_t* start_guess) {
       VerifyIPutQuick(inst, reg_types_.JavaLangObject(false), false);
       break;
     case Instruction::INVOKE_VIRTUAL_QUICK:
-    case Instruction::INVOKE_VIRTUAL_RANGE_QUICK: {
-      bool is_range = (inst->Opcode() == Instruction::INVOKE_VIRTUAL_RANGE_QUICK);
+    case Instruction::INVOKE_VIRTUAL_RANGE_QUICK:
+    case Instruction::INVOKE_SUPER_QUICK:
+    case Instruction::INVOKE_SUPER_RANGE_QUICK: {
+      bool is_range = (inst->Opcode() == Instruction::INVOKE_VIRTUAL_RANGE_QUICK ||
+                       inst->Opcode() == Instruction::INVOKE_SUPER_RANGE_QUICK);
       mirror::ArtMethod* called_method = VerifyInvokeVirtualQuickArgs(inst, is_range);
       if (called_method != NULL) {
         const char* descriptor = MethodHelper(called_method).GetReturnTypeDescriptor();
@@ -2564,8 +2625,6 @@ bool MethodVerifier::CodeFlowVerifyInstruction(uint32_t* start_guess) {
     case Instruction::UNUSED_43:
     case Instruction::UNUSED_79:
     case Instruction::UNUSED_7A:
-    case Instruction::UNUSED_EB:
-    case Instruction::UNUSED_EC:
     case Instruction::UNUSED_ED:
     case Instruction::UNUSED_EE:
     case Instruction::UNUSED_EF:
@@ -3099,7 +3158,9 @@ mirror::ArtMethod* MethodVerifier::GetQuickInvokedMethod(const Instruction* inst
                                                               RegisterLine* reg_line,
                                                               bool is_range) {
   DCHECK(inst->Opcode() == Instruction::INVOKE_VIRTUAL_QUICK ||
-         inst->Opcode() == Instruction::INVOKE_VIRTUAL_RANGE_QUICK);
+         inst->Opcode() == Instruction::INVOKE_VIRTUAL_RANGE_QUICK ||
+         inst->Opcode() == Instruction::INVOKE_SUPER_QUICK ||
+         inst->Opcode() == Instruction::INVOKE_SUPER_RANGE_QUICK);
   const RegType& actual_arg_type = reg_line->GetInvocationThis(inst, is_range);
   if (actual_arg_type.IsConflict()) {  // GetInvocationThis failed.
     return NULL;
@@ -3107,7 +3168,15 @@ mirror::ArtMethod* MethodVerifier::GetQuickInvokedMethod(const Instruction* inst
     return NULL;
   }
   mirror::Class* this_class = NULL;
-  if (!actual_arg_type.IsUnresolvedTypes()) {
+  if (inst->Opcode() == Instruction::INVOKE_SUPER_QUICK ||
+      inst->Opcode() == Instruction::INVOKE_SUPER_RANGE_QUICK) {
+    // Dispatched in the vtable of the super class of the method's class, whatever "this" is.
+    const RegType& declaring_class = GetDeclaringClass();
+    if (declaring_class.IsUnresolvedTypes()) {
+      return NULL;
+    }
+    this_class = declaring_class.GetClass()->GetSuperClass();
+  } else if (!actual_arg_type.IsUnresolvedTypes()) {
     this_class = actual_arg_type.GetClass();
   } else {
     const std::string& descriptor(actual_arg_type.GetDescriptor());
@@ -4076,7 +4145,7 @@ void MethodVerifier::VerifyLengthPrefixedGcMap(const std::vector<uint8_t>& data)
 }
 
 void MethodVerifier::SetDexGcMap(MethodReference ref, const std::vector<uint8_t>* gc_map) {
-  DCHECK(Runtime::Current()->IsCompiler());
+  DCHECK(RecordsCompilerData());
   {
     WriterMutexLock mu(Thread::Current(), *dex_gc_maps_lock_);
     DexGcMapTable::iterator it = dex_gc_maps_->find(ref);
@@ -4091,7 +4160,7 @@ void MethodVerifier::SetDexGcMap(MethodReference ref, const std::vector<uint8_t>
 
 
 void  MethodVerifier::SetSafeCastMap(MethodReference ref, const MethodSafeCastSet* cast_set) {
-  DCHECK(Runtime::Current()->IsCompiler());
+  DCHECK(RecordsCompilerData());
   WriterMutexLock mu(Thread::Current(), *safecast_map_lock_);
   SafeCastMap::iterator it = safecast_map_->find(ref);
   if (it != safecast_map_->end()) {
@@ -4103,7 +4172,7 @@ void  MethodVerifier::SetSafeCastMap(MethodReference ref, const MethodSafeCastSe
 }
 
 bool MethodVerifier::IsSafeCast(MethodReference ref, uint32_t pc) {
-  DCHECK(Runtime::Current()->IsCompiler());
+  DCHECK(RecordsCompilerData());
   ReaderMutexLock mu(Thread::Current(), *safecast_map_lock_);
   SafeCastMap::const_iterator it = safecast_map_->find(ref);
   if (it == safecast_map_->end()) {
@@ -4116,7 +4185,7 @@ bool MethodVerifier::IsSafeCast(MethodReference ref, uint32_t pc) {
 }
 
 const std::vector<uint8_t>* MethodVerifier::GetDexGcMap(MethodReference ref) {
-  DCHECK(Runtime::Current()->IsCompiler());
+  DCHECK(RecordsCompilerData());
   ReaderMutexLock mu(Thread::Current(), *dex_gc_maps_lock_);
   DexGcMapTable::const_iterator it = dex_gc_maps_->find(ref);
   CHECK(it != dex_gc_maps_->end())
@@ -4127,7 +4196,7 @@ const std::vector<uint8_t>* MethodVerifier::GetDexGcMap(MethodReference ref) {
 
 void  MethodVerifier::SetDevirtMap(MethodReference ref,
                                    const PcToConcreteMethodMap* devirt_map) {
-  DCHECK(Runtime::Current()->IsCompiler());
+  DCHECK(RecordsCompilerData());
   WriterMutexLock mu(Thread::Current(), *devirt_maps_lock_);
   DevirtualizationMapTable::iterator it = devirt_maps_->find(ref);
   if (it != devirt_maps_->end()) {
@@ -4141,7 +4210,7 @@ void  MethodVerifier::SetDevirtMap(MethodReference ref,
 
 const MethodReference* MethodVerifier::GetDevirtMap(const MethodReference& ref,
                                                                     uint32_t dex_pc) {
-  DCHECK(Runtime::Current()->IsCompiler());
+  DCHECK(RecordsCompilerData());
   ReaderMutexLock mu(Thread::Current(), *devirt_maps_lock_);
   DevirtualizationMapTable::const_iterator it = devirt_maps_->find(ref);
   if (it == devirt_maps_->end()) {
@@ -4229,8 +4298,11 @@ MethodVerifier::DevirtualizationMapTable* MethodVerifier::devirt_maps_ = NULL;
 ReaderWriterMutex* MethodVerifier::rejected_classes_lock_ = NULL;
 MethodVerifier::RejectedClassesTable* MethodVerifier::rejected_classes_ = NULL;
 
+ReaderWriterMutex* MethodVerifier::verification_dependencies_lock_ = NULL;
+MethodVerifier::VerificationDependenciesTable* MethodVerifier::verification_dependencies_ = NULL;
+
 void MethodVerifier::Init() {
-  if (Runtime::Current()->IsCompiler()) {
+  if (RecordsCompilerData()) {
     dex_gc_maps_lock_ = new ReaderWriterMutex("verifier GC maps lock");
     Thread* self = Thread::Current();
     {
@@ -4256,12 +4328,18 @@ void MethodVerifier::Init() {
       WriterMutexLock mu(self, *rejected_classes_lock_);
       rejected_classes_ = new MethodVerifier::RejectedClassesTable;
     }
+
+    verification_dependencies_lock_ = new ReaderWriterMutex("verifier dependencies lock");
+    {
+      WriterMutexLock mu(self, *verification_dependencies_lock_);
+      verification_dependencies_ = new MethodVerifier::VerificationDependenciesTable;
+    }
   }
   art::verifier::RegTypeCache::Init();
 }
 
 void MethodVerifier::Shutdown() {
-  if (Runtime::Current()->IsCompiler()) {
+  if (RecordsCompilerData()) {
     Thread* self = Thread::Current();
     {
       WriterMutexLock mu(self, *dex_gc_maps_lock_);
@@ -4297,12 +4375,21 @@ void MethodVerifier::Shutdown() {
     }
     delete rejected_classes_lock_;
     rejected_classes_lock_ = NULL;
+
+    {
+      WriterMutexLock mu(self, *verification_dependencies_lock_);
+      STLDeleteValues(verification_dependencies_);
+      delete verification_dependencies_;
+      verification_dependencies_ = NULL;
+    }
+    delete verification_dependencies_lock_;
+    verification_dependencies_lock_ = NULL;
   }
   verifier::RegTypeCache::ShutDown();
 }
 
 void MethodVerifier::AddRejectedClass(ClassReference ref) {
-  DCHECK(Runtime::Current()->IsCompiler());
+  DCHECK(RecordsCompilerData());
   {
     WriterMutexLock mu(Thread::Current(), *rejected_classes_lock_);
     rejected_classes_->insert(ref);
@@ -4311,10 +4398,32 @@ void MethodVerifier::AddRejectedClass(ClassReference ref) {
 }
 
 bool MethodVerifier::IsClassRejected(ClassReference ref) {
-  DCHECK(Runtime::Current()->IsCompiler());
+  DCHECK(RecordsCompilerData());
   ReaderMutexLock mu(Thread::Current(), *rejected_classes_lock_);
   return (rejected_classes_->find(ref) != rejected_classes_->end());
 }
 
+void MethodVerifier::SetVerificationDependencies(ClassReference ref,
+                                                 const std::set<uint16_t>& unresolved_types) {
+  DCHECK(RecordsCompilerData());
+  const std::vector<uint16_t>* type_idxs =
+      new std::vector<uint16_t>(unresolved_types.begin(), unresolved_types.end());
+  WriterMutexLock mu(Thread::Current(), *verification_dependencies_lock_);
+  // A class may be verified again, as the super class of a class being verified.
+  VerificationDependenciesTable::iterator it = verification_dependencies_->find(ref);
+  if (it != verification_dependencies_->end()) {
+    delete it->second;
+    verification_dependencies_->erase(it);
+  }
+  verification_dependencies_->Put(ref, type_idxs);
+}
+
+const std::vector<uint16_t>* MethodVerifier::GetVerificationDependencies(ClassReference ref) {
+  DCHECK(RecordsCompilerData());
+  ReaderMutexLock mu(Thread::Current(), *verification_dependencies_lock_);
+  VerificationDependenciesTable::const_iterator it = verification_dependencies_->find(ref);
+  return (it != verification_dependencies_->end()) ? it->second : NULL;
+}
+
 }  // namespace verifier
 }  // namespace art
@@ -107,7 +107,8 @@ enum RegisterTrackingMode {
 };
 
 // A mapping from a dex pc to the register line statuses as they are immediately prior to the
-// execution of that instruction.
+// execution of that instruction. The lines of a method all have the same size and are carved out
+// of a single allocation, rather than allocated one by one.
 class PcToRegisterLineTable {
  public:
   PcToRegisterLineTable() : size_(0) {}
@@ -127,6 +128,8 @@ class PcToRegisterLineTable {
  private:
   UniquePtr<RegisterLine*[]> register_lines_;
   size_t size_;
+  // Backing store of the lines.
+  UniquePtr<uint8_t[]> line_storage_;
 };
 
 // The verifier
@@ -191,6 +194,12 @@ class MethodVerifier {
   // by using the check-cast elision peephole optimization in the verifier
   static bool IsSafeCast(MethodReference ref, uint32_t pc) LOCKS_EXCLUDED(safecast_map_lock_);
 
+  // Verifies again a method of an already verified class, recording the GC, safe cast and
+  // devirtualization maps the compiler needs to compile it while the application runs. Returns
+  // false if the method fails verification.
+  static bool VerifyMethodForCompilation(mirror::ArtMethod* m)
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
   // Fills 'monitor_enter_dex_pcs' with the dex pcs of the monitor-enter instructions corresponding
   // to the locks held at 'dex_pc' in method 'm'.
   static void FindLocksAtDexPc(mirror::ArtMethod* m, uint32_t dex_pc,
@@ -213,6 +222,13 @@ class MethodVerifier {
   static bool IsClassRejected(ClassReference ref)
       LOCKS_EXCLUDED(rejected_classes_lock_);
 
+  // Returns the type indices a class soft failed verification on at compile time, if its only
+  // failures were those types being unresolved. While all of these types still fail to resolve,
+  // runtime verification would end the same way, with the class verified and its methods
+  // checking access. Returns NULL if the class has no such record.
+  static const std::vector<uint16_t>* GetVerificationDependencies(ClassReference ref)
+      LOCKS_EXCLUDED(verification_dependencies_lock_);
+
   bool CanLoadClasses() const {
     return can_load_classes_;
   }
@@ -262,7 +278,8 @@ class MethodVerifier {
                                   const DexFile::ClassDef* class_def_idx,
                                   const DexFile::CodeItem* code_item,
                                   mirror::ArtMethod* method, uint32_t method_access_flags,
-                                  bool allow_soft_failures)
+                                  bool allow_soft_failures, std::set<uint16_t>* unresolved_types,
+                                  bool* unresolved_types_complete)
           SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
 
   void FindLocksAtDexPc() SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
@@ -664,6 +681,14 @@ class MethodVerifier {
   static void AddRejectedClass(ClassReference ref)
       LOCKS_EXCLUDED(rejected_classes_lock_);
 
+  typedef SafeMap<ClassReference, const std::vector<uint16_t>*> VerificationDependenciesTable;
+  static ReaderWriterMutex* verification_dependencies_lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
+  static VerificationDependenciesTable* verification_dependencies_
+      GUARDED_BY(verification_dependencies_lock_);
+  static void SetVerificationDependencies(ClassReference ref,
+                                          const std::set<uint16_t>& unresolved_types)
+      LOCKS_EXCLUDED(verification_dependencies_lock_);
+
   RegTypeCache reg_types_;
 
   PcToRegisterLineTable reg_table_;
@@ -709,6 +734,9 @@ class MethodVerifier {
   // to be unreachable. This is set by Fail and used to ensure we don't process unreachable
   // instructions that would hard fail the verification.
   bool have_pending_runtime_throw_failure_;
+  // Was there a failure other than a class failing to resolve? Verification dependencies can only
+  // stand in for methods whose failures are all unresolved classes.
+  bool have_non_missing_class_failure_;
 
   // Info message log use primarily for verifier diagnostics.
   std::ostringstream info_messages_;
@@ -729,6 +757,15 @@ class MethodVerifier {
   // Indicates if the method being verified contains at least one invoke-virtual/range
   // or invoke-interface/range.
   bool has_virtual_or_interface_invokes_;
+
+  // Set when the runtime's hot method compiler is about to compile the method, the compiler maps
+  // are then recorded even though the runtime isn't the compiler.
+  bool for_hot_method_compiler_;
+
+  // Set when nothing reads the register lines once the method is verified. Lines are then only
+  // kept at branch targets, where the data flow merges; the others are re-derived into work_line_
+  // as the flow goes.
+  bool track_merge_points_only_;
 };
 std::ostream& operator<<(std::ostream& os, const MethodVerifier::FailureKind& rhs);
 
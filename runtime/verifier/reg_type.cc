@@ -882,36 +882,48 @@ const RegType& RegType::Merge(const RegType& incoming_type, RegTypeCache* reg_ty
       return SelectNonConstant(*this, incoming_type);  // 0 MERGE ref => ref
     } else if (IsJavaLangObject() || incoming_type.IsJavaLangObject()) {
       return reg_types->JavaLangObject(false);  // Object MERGE ref => Object
-    } else if (IsUnresolvedTypes() || incoming_type.IsUnresolvedTypes()) {
-      // We know how to merge an unresolved type with itself, 0 or Object. In this case we
-      // have two sub-classes and don't know how to merge. Create a new string-based unresolved
-      // type that reflects our lack of knowledge and that allows the rest of the unresolved
-      // mechanics to continue.
-      return reg_types->FromUnresolvedMerge(*this, incoming_type);
-    } else if (IsUninitializedTypes() || incoming_type.IsUninitializedTypes()) {
-      // Something that is uninitialized hasn't had its constructor called. Mark any merge
-      // of this type with something that is initialized as conflicting. The cases of a merge
-      // with itself, 0 or Object are handled above.
-      return reg_types->Conflict();
-    } else {  // Two reference types, compute Join
-      mirror::Class* c1 = GetClass();
-      mirror::Class* c2 = incoming_type.GetClass();
-      DCHECK(c1 != NULL && !c1->IsPrimitive());
-      DCHECK(c2 != NULL && !c2->IsPrimitive());
-      mirror::Class* join_class = ClassJoin(c1, c2);
-      if (c1 == join_class && !IsPreciseReference()) {
-        return *this;
-      } else if (c2 == join_class && !incoming_type.IsPreciseReference()) {
-        return incoming_type;
-      } else {
-        return reg_types->FromClass(ClassHelper(join_class).GetDescriptor(), join_class, false);
+    } else {
+      const RegType* merged = reg_types->FindMerge(*this, incoming_type);
+      if (merged == NULL) {
+        merged = &MergeReferences(incoming_type, reg_types);
+        reg_types->AddMerge(*this, incoming_type, *merged);
       }
+      return *merged;
     }
   } else {
     return reg_types->Conflict();  // Unexpected types => Conflict
   }
 }
 
+const RegType& RegType::MergeReferences(const RegType& incoming_type,
+                                        RegTypeCache* reg_types) const {
+  if (IsUnresolvedTypes() || incoming_type.IsUnresolvedTypes()) {
+    // We know how to merge an unresolved type with itself, 0 or Object. In this case we
+    // have two sub-classes and don't know how to merge. Create a new string-based unresolved
+    // type that reflects our lack of knowledge and that allows the rest of the unresolved
+    // mechanics to continue.
+    return reg_types->FromUnresolvedMerge(*this, incoming_type);
+  } else if (IsUninitializedTypes() || incoming_type.IsUninitializedTypes()) {
+    // Something that is uninitialized hasn't had its constructor called. Mark any merge
+    // of this type with something that is initialized as conflicting. The cases of a merge
+    // with itself, 0 or Object are handled above.
+    return reg_types->Conflict();
+  } else {  // Two reference types, compute Join
+    mirror::Class* c1 = GetClass();
+    mirror::Class* c2 = incoming_type.GetClass();
+    DCHECK(c1 != NULL && !c1->IsPrimitive());
+    DCHECK(c2 != NULL && !c2->IsPrimitive());
+    mirror::Class* join_class = ClassJoin(c1, c2);
+    if (c1 == join_class && !IsPreciseReference()) {
+      return *this;
+    } else if (c2 == join_class && !incoming_type.IsPreciseReference()) {
+      return incoming_type;
+    } else {
+      return reg_types->FromClass(ClassHelper(join_class).GetDescriptor(), join_class, false);
+    }
+  }
+}
+
 // See comment in reg_type.h
 mirror::Class* RegType::ClassJoin(mirror::Class* s, mirror::Class* t) {
   DCHECK(!s->IsPrimitive()) << PrettyClass(s);
@@ -288,6 +288,10 @@ class RegType {
   friend class RegTypeCache;
 
  private:
+  // Merge of two non-zero reference types neither of which is Object, which reg_types memoizes.
+  const RegType& MergeReferences(const RegType& incoming_type, RegTypeCache* reg_types) const
+      SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
   DISALLOW_COPY_AND_ASSIGN(RegType);
 };
 
@@ -28,6 +28,8 @@ namespace verifier {
 bool RegTypeCache::primitive_initialized_ = false;
 uint16_t RegTypeCache::primitive_start_ = 0;
 uint16_t RegTypeCache::primitive_count_ = 0;
+ReaderWriterMutex* RegTypeCache::java_classes_lock_ = NULL;
+RegTypeCache::JavaClassTable* RegTypeCache::java_classes_ = NULL;
 
 static bool MatchingPrecisionForClass(RegType* entry, bool precise)
     SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
@@ -131,13 +133,45 @@ bool RegTypeCache::MatchDescriptor(size_t idx, const char* descriptor, bool prec
   return true;
 }
 
+static bool IsJavaDescriptor(const char* descriptor) {
+  return strncmp(descriptor, "Ljava/", strlen("Ljava/")) == 0;
+}
+
+mirror::Class* RegTypeCache::LookupJavaClass(const char* descriptor) {
+  if (!IsJavaDescriptor(descriptor)) {
+    return NULL;
+  }
+  ReaderMutexLock mu(Thread::Current(), *java_classes_lock_);
+  JavaClassTable::const_iterator it = java_classes_->find(StringPiece(descriptor));
+  return (it != java_classes_->end()) ? it->second : NULL;
+}
+
+void RegTypeCache::AddJavaClass(const char* descriptor, mirror::Class* klass) {
+  if (!IsJavaDescriptor(descriptor) || klass->GetClassLoader() != NULL) {
+    return;
+  }
+  // Key by the descriptor in the class' own dex file, boot dex files are never closed.
+  const StringPiece key(ClassHelper(klass).GetDescriptor());
+  WriterMutexLock mu(Thread::Current(), *java_classes_lock_);
+  if (java_classes_->find(key) == java_classes_->end()) {
+    java_classes_->Put(key, klass);
+  }
+}
+
 mirror::Class* RegTypeCache::ResolveClass(const char* descriptor, mirror::ClassLoader* loader) {
   // Class was not found, must create new type.
   // Try resolving class
   ClassLinker* class_linker = Runtime::Current()->GetClassLinker();
   mirror::Class* klass = NULL;
   if (can_load_classes_) {
+    klass = LookupJavaClass(descriptor);
+    if (klass != NULL) {
+      return klass;
+    }
     klass = class_linker->FindClass(descriptor, loader);
+    if (klass != NULL) {
+      AddJavaClass(descriptor, klass);
+    }
   } else {
     klass = class_linker->LookupClass(descriptor, loader);
     if (klass != NULL && !klass->IsLoaded()) {
@@ -257,6 +291,10 @@ void RegTypeCache::ShutDown() {
     DoubleHiType::Destroy();
     RegTypeCache::primitive_initialized_ = false;
     RegTypeCache::primitive_count_ = 0;
+    delete java_classes_;
+    java_classes_ = NULL;
+    delete java_classes_lock_;
+    java_classes_lock_ = NULL;
   }
 }
 
@@ -510,6 +548,26 @@ const RegType& RegTypeCache::GetComponentType(const RegType& array, mirror::Clas
   }
 }
 
+bool RegTypeCache::GetUnresolvedTypes(const DexFile& dex_file,
+                                      std::set<uint16_t>* type_idxs) const {
+  for (size_t i = primitive_count_; i < entries_.size(); i++) {
+    const RegType* cur_entry = entries_[i];
+    if (!cur_entry->IsUnresolvedReference()) {
+      continue;
+    }
+    const DexFile::StringId* string_id = dex_file.FindStringId(cur_entry->GetDescriptor().c_str());
+    if (string_id == NULL) {
+      return false;
+    }
+    const DexFile::TypeId* type_id = dex_file.FindTypeId(dex_file.GetIndexForStringId(*string_id));
+    if (type_id == NULL) {
+      return false;
+    }
+    type_idxs->insert(dex_file.GetIndexForTypeId(*type_id));
+  }
+  return true;
+}
+
 void RegTypeCache::Dump(std::ostream& os) {
   for (size_t i = 0; i < entries_.size(); i++) {
     RegType* cur_entry = entries_[i];
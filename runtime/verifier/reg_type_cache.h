@@ -19,11 +19,15 @@
 
 #include "base/casts.h"
 #include "base/macros.h"
+#include "base/mutex.h"
 #include "base/stl_util.h"
+#include "base/stringpiece.h"
 #include "reg_type.h"
 #include "runtime.h"
+#include "safe_map.h"
 
 #include <stdint.h>
+#include <set>
 #include <vector>
 
 namespace art {
@@ -49,6 +53,8 @@ class RegTypeCache {
       CreatePrimitiveTypes();
       CHECK_EQ(RegTypeCache::primitive_count_, kNumPrimitives);
       RegTypeCache::primitive_initialized_ = true;
+      java_classes_lock_ = new ReaderWriterMutex("verifier java classes lock");
+      java_classes_ = new JavaClassTable;
     }
   }
   static void ShutDown();
@@ -73,6 +79,15 @@ class RegTypeCache {
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
   const RegType& FromUnresolvedSuperClass(const RegType& child)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+  // Reference merges already computed by this cache, see RegType::Merge. Branchy methods merge
+  // the same pairs over and over, and unresolved merges are costly to find again.
+  const RegType* FindMerge(const RegType& left, const RegType& right) const {
+    MergeTable::const_iterator it = merges_.find(MergeKey(left, right));
+    return it == merges_.end() ? NULL : &GetFromId(it->second);
+  }
+  void AddMerge(const RegType& left, const RegType& right, const RegType& merged) {
+    merges_.Put(MergeKey(left, right), merged.GetId());
+  }
   const RegType& JavaLangString() SHARED_LOCKS_REQUIRED(Locks::mutator_lock_) {
     // String is final and therefore always precise.
     return From(NULL, "Ljava/lang/String;", true);
@@ -143,6 +158,9 @@ class RegTypeCache {
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
   void Dump(std::ostream& os) SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
   const RegType& RegTypeFromPrimitiveType(Primitive::Type) const;
+  // Adds the type indices in dex_file of the unresolved references, returns false if one of them
+  // isn't a type of dex_file.
+  bool GetUnresolvedTypes(const DexFile& dex_file, std::set<uint16_t>* type_idxs) const;
 
  private:
   std::vector<RegType*> entries_;
@@ -150,6 +168,26 @@ class RegTypeCache {
   static uint16_t primitive_start_;
   static uint16_t primitive_count_;
   static void CreatePrimitiveTypes() SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
+  // java.* classes resolved by any cache, keyed by their descriptor. Only the boot class loader
+  // may define java.* classes, so whatever the loader they resolve to the same class, and caches
+  // which may load classes copy them from here instead of resolving them again. Grows as classes
+  // are resolved, so it is read-mostly once the common java.lang types are in.
+  typedef SafeMap<StringPiece, mirror::Class*> JavaClassTable;
+  static ReaderWriterMutex* java_classes_lock_;
+  static JavaClassTable* java_classes_ GUARDED_BY(java_classes_lock_);
+  static mirror::Class* LookupJavaClass(const char* descriptor)
+      LOCKS_EXCLUDED(java_classes_lock_);
+  static void AddJavaClass(const char* descriptor, mirror::Class* klass)
+      LOCKS_EXCLUDED(java_classes_lock_) SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
+
+  // Merged type ids keyed by the ids of the types merged, the left one in the upper half.
+  typedef SafeMap<uint32_t, uint16_t> MergeTable;
+  static uint32_t MergeKey(const RegType& left, const RegType& right) {
+    return (static_cast<uint32_t>(left.GetId()) << 16) | right.GetId();
+  }
+  MergeTable merges_;
+
   // Whether or not we're allowed to load classes.
   const bool can_load_classes_;
   mirror::Class* ResolveClass(const char* descriptor, mirror::ClassLoader* loader)
@@ -448,6 +448,22 @@ TEST_F(RegTypeReferenceTest, JavalangObject) {
   EXPECT_TRUE(ref_type_3.Equals(ref_type_2));
   EXPECT_EQ(ref_type.GetId(), ref_type_3.GetId());
 }
+TEST_F(RegTypeReferenceTest, SharedJavaClasses) {
+  // java.* classes resolved by one cache are copied into others rather than resolved again, but
+  // each cache still gets its own entry for them.
+  ScopedObjectAccess soa(Thread::Current());
+  RegTypeCache cache(true);
+  const RegType& ref_type = cache.FromDescriptor(NULL, "Ljava/lang/Runtime;", false);
+  EXPECT_TRUE(ref_type.IsReference());
+  RegTypeCache cache_2(true);
+  const RegType& ref_type_2 = cache_2.FromDescriptor(NULL, "Ljava/lang/Runtime;", false);
+  EXPECT_TRUE(ref_type_2.IsReference());
+  EXPECT_EQ(ref_type.GetClass(), ref_type_2.GetClass());
+  EXPECT_NE(&ref_type, &ref_type_2);
+  const RegType& unresolved = cache_2.FromDescriptor(NULL, "Ljava/lang/DoesNotExist;", false);
+  EXPECT_TRUE(unresolved.IsUnresolvedReference());
+}
+
 TEST_F(RegTypeReferenceTest, Merging) {
   // Tests merging logic
   // String and object , LUB is object.
@@ -469,6 +485,12 @@ TEST_F(RegTypeReferenceTest, Merging) {
   std::set<uint16_t> merged_ids = (down_cast<UnresolvedMergedType*>(&merged_nonconst))->GetMergedTypes();
   EXPECT_EQ(ref_type_0.GetId(), *(merged_ids.begin()));
   EXPECT_EQ(ref_type_1.GetId(), *((++merged_ids.begin())));
+
+  // Merging the pair again finds the earlier result without adding to the cache.
+  const size_t cache_size = cache_new.GetCacheSize();
+  EXPECT_TRUE(ref_type_1.Merge(ref_type_0, &cache_new).Equals(merged));
+  EXPECT_TRUE(ref_type_0.Merge(ref_type_1, &cache_new).Equals(merged));
+  EXPECT_EQ(cache_size, cache_new.GetCacheSize());
 }
 
 
@@ -23,6 +23,7 @@
 #include "reg_type.h"
 #include "safe_map.h"
 #include "UniquePtr.h"
+#include "utils.h"
 
 namespace art {
 namespace verifier {
@@ -56,6 +57,18 @@ class RegisterLine {
     return rl;
   }
 
+  // The bytes a line of num_regs registers takes, rounded up so that lines can be laid out back to
+  // back in a single allocation.
+  static size_t ComputeSize(size_t num_regs) {
+    return RoundUp(sizeof(RegisterLine) + (num_regs * sizeof(uint16_t)), sizeof(uint64_t));
+  }
+
+  // Creates a line in storage of ComputeSize(num_regs) bytes owned by the caller, who destroys the
+  // line with ~RegisterLine rather than delete.
+  static RegisterLine* Create(size_t num_regs, MethodVerifier* verifier, void* storage) {
+    return new (storage) RegisterLine(num_regs, verifier);
+  }
+
   // Implement category-1 "move" instructions. Copy a 32-bit value from "vsrc" to "vdst".
   void CopyRegister1(uint32_t vdst, uint32_t vsrc, TypeCategory cat)
       SHARED_LOCKS_REQUIRED(Locks::mutator_lock_);
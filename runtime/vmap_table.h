@@ -25,6 +25,9 @@ namespace art {
 
 class VmapTable {
  public:
+  // The most dex registers that can be promoted to core registers, one per spill mask bit.
+  static const size_t kMaxPromotedCoreRegisters = 32;
+
   explicit VmapTable(const uint8_t* table) : table_(table) {
   }
 
@@ -45,6 +48,16 @@ class VmapTable {
     return DecodeUnsignedLeb128(&table);
   }
 
+  // The size in bytes of the encoded table.
+  size_t SizeInBytes() const {
+    const uint8_t* table = table_;
+    size_t size = DecodeUnsignedLeb128(&table);
+    for (size_t i = 0; i < size; ++i) {
+      DecodeUnsignedLeb128(&table);
+    }
+    return table - table_;
+  }
+
   // Is the dex register 'vreg' in the context or on the stack? Should not be called when the
   // 'kind' is unknown or constant.
   bool IsInContext(size_t vreg, VRegKind kind, uint32_t* vmap_offset) const {
@@ -74,6 +87,37 @@ class VmapTable {
     return false;
   }
 
+  // Decodes all the dex registers promoted to core registers at once, for callers that would
+  // otherwise call IsInContext and ComputeRegister for many registers of the same frame. Fills in
+  // 'vregs' with the dex registers and 'regs' with the matching core registers, and returns the
+  // number of entries, at most kMaxPromotedCoreRegisters.
+  size_t DecodeCoreRegisters(uint32_t core_spill_mask, uint16_t* vregs, uint32_t* regs) const {
+    const uint8_t* table = table_;
+    size_t end = DecodeUnsignedLeb128(&table);
+    size_t count = 0;
+    uint32_t reg = 0;
+    for (size_t i = 0; i < end; ++i) {
+      uint16_t entry = DecodeUnsignedLeb128(&table);
+      // 0xffff is the marker for LR (return PC on x86), following it are spilled float registers.
+      if (entry == 0xffff) {
+        break;
+      }
+      // Core registers appear in the vmap in the order of the spill mask, as in ComputeRegister.
+      DCHECK_NE(core_spill_mask, 0u);
+      while ((core_spill_mask & 1) == 0) {
+        core_spill_mask >>= 1;
+        ++reg;
+      }
+      DCHECK_LT(count, kMaxPromotedCoreRegisters);
+      vregs[count] = entry;
+      regs[count] = reg;
+      ++count;
+      core_spill_mask >>= 1;
+      ++reg;
+    }
+    return count;
+  }
+
   // Compute the register number that corresponds to the entry in the vmap (vmap_offset, computed
   // by IsInContext above). If the kind is floating point then the result will be a floating point
   // register number, otherwise it will be an integer register number.
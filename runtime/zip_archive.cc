@@ -20,12 +20,14 @@
 
 #include <fcntl.h>
 #include <stdio.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 
 #include "base/stringprintf.h"
 #include "base/unix_file/fd_file.h"
+#include "utils.h"
 #include "UniquePtr.h"
 
 namespace art {
@@ -49,7 +51,30 @@ bool ZipEntry::ExtractToFile(File& file) {
   return true;
 }
 
+MemMap* ZipEntry::MapDirectlyFromFile(const char* entry_filename) {
+  if (zip_entry_->method != kCompressStored) {
+    return NULL;
+  }
+  // Callers such as DexFile need the data word aligned, which zipalign guarantees.
+  if (!IsAligned<4>(zip_entry_->offset)) {
+    VLOG(startup) << "Zip: not mapping unaligned entry '" << entry_filename << "'";
+    return NULL;
+  }
+  CHECK_EQ(zip_entry_->compressed_length, zip_entry_->uncompressed_length);
+  MemMap* map = MemMap::MapFile(GetUncompressedLength(), PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                                GetFileDescriptor(handle_), zip_entry_->offset);
+  if (map == NULL) {
+    LOG(WARNING) << "Zip: failed to map stored entry '" << entry_filename << "', extracting it";
+  }
+  return map;
+}
+
 MemMap* ZipEntry::ExtractToMemMap(const char* entry_filename) {
+  MemMap* direct_map = MapDirectlyFromFile(entry_filename);
+  if (direct_map != NULL) {
+    return direct_map;
+  }
+
   std::string name(entry_filename);
   name += " extracted in memory from ";
   name += entry_filename;
@@ -38,6 +38,9 @@ class MemMap;
 class ZipEntry {
  public:
   bool ExtractToFile(File& file);
+  // Returns the contents of the entry in a private, writable map. Stored entries whose data is
+  // word aligned within the archive are mapped straight from the archive file, so their pages stay
+  // clean and shared with the page cache until written. Other entries are inflated or copied.
   MemMap* ExtractToMemMap(const char* entry_filename);
 
   uint32_t GetUncompressedLength();
@@ -47,6 +50,8 @@ class ZipEntry {
   ZipEntry(ZipArchiveHandle handle,
            ::ZipEntry* zip_entry) : handle_(handle), zip_entry_(zip_entry) {}
 
+  MemMap* MapDirectlyFromFile(const char* entry_filename);
+
   ZipArchiveHandle handle_;
   ::ZipEntry* const zip_entry_;
 
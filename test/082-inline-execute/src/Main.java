@@ -35,6 +35,22 @@ public class Main {
     test_String_indexOf();
     test_String_isEmpty();
     test_String_length();
+    test_System_identityHashCode();
+  }
+
+  public static void test_System_identityHashCode() {
+    Assert.assertEquals(System.identityHashCode(null), 0);
+    Object o = new Object();
+    int hash = System.identityHashCode(o);
+    Assert.assertEquals(System.identityHashCode(o), hash);
+    Assert.assertEquals(o.hashCode(), hash);
+    // Locking must not change the hash, nor hashing the lock.
+    synchronized (o) {
+      Assert.assertEquals(System.identityHashCode(o), hash);
+    }
+    Assert.assertEquals(System.identityHashCode(o), hash);
+    String s = "hash";
+    Assert.assertEquals(System.identityHashCode(s), System.identityHashCode(s));
   }
 
   public static void test_String_length() {
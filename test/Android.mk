@@ -25,6 +25,7 @@ TEST_DEX_DIRECTORIES := \
 	AllFields \
 	CreateMethodSignature \
 	ExceptionHandle \
+	FieldGaps \
 	Interfaces \
 	Main \
 	MyClass \
@@ -93,6 +94,9 @@ define build-art-test-dex
 endef
 $(foreach dir,$(TEST_DEX_DIRECTORIES), $(eval $(call build-art-test-dex,art-test-dex,$(dir),$(ART_NATIVETEST_OUT))))
 $(foreach dir,$(TEST_OAT_DIRECTORIES), $(eval $(call build-art-test-dex,oat-test-dex,$(dir),$(ART_TEST_OUT))))
+# Run by the benchmark targets in build/Android.benchmark.mk rather than by test-art.
+$(eval $(call build-art-test-dex,art-benchmark-dex,Benchmarks,$(ART_TEST_OUT)))
+$(eval $(call build-art-test-dex,art-benchmark-dex,GcBenchmark,$(ART_TEST_OUT)))
 
 ########################################################################
 
@@ -0,0 +1,325 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+import dalvik.system.PathClassLoader;
+
+import java.util.Arrays;
+import java.util.List;
+
+// Micro-benchmarks of the runtime's hot paths, run by "make art-benchmarks".
+//
+// Usage: Benchmarks <configuration> [<benchmark name>...]
+//
+// Prints one tab separated line per benchmark: the configuration, the benchmark name, the
+// iterations per run and the median and minimum nanoseconds per iteration over the runs.
+class Benchmarks {
+
+    // Each run is grown until it takes at least this long, to keep timer noise down.
+    private static final long MIN_RUN_NS = 100 * 1000 * 1000;
+    private static final int RUNS = 5;
+
+    abstract static class Benchmark {
+        final String name;
+
+        Benchmark(String name) {
+            this.name = name;
+        }
+
+        abstract void run(int iterations) throws Exception;
+    }
+
+    // 4096 chars of mostly ASCII, broken up by two and three byte chars and NULs, which modified
+    // UTF-8 encodes in two bytes. Converting it exercises both the runtime's ASCII fast paths and
+    // its char at a time paths.
+    private static final String MIXED_STRING = makeMixedString(4096);
+
+    private static String makeMixedString(int length) {
+        StringBuilder sb = new StringBuilder(length);
+        String nonAscii = "\u00e9\u0000\u20ac\u07ff";
+        for (int i = 0; sb.length() < length; i++) {
+            if (i % 256 < 64 && i % 23 == 0) {
+                sb.append(nonAscii.charAt(i % nonAscii.length()));
+            } else {
+                sb.append((char) ('a' + i % 26));
+            }
+        }
+        return sb.toString();
+    }
+
+    // Written by the benchmarks so that their work can't be optimized away.
+    static Object sinkObject;
+    static int sinkInt;
+
+    public static void main(String[] args) throws Exception {
+        if (args.length < 1) {
+            System.err.println("Usage: Benchmarks <configuration> [<benchmark name>...]");
+            System.exit(1);
+        }
+        System.loadLibrary("artbenchmark");
+        String configuration = args[0];
+        List<String> selected = Arrays.asList(args).subList(1, args.length);
+        System.out.println("configuration\tbenchmark\titerations\tmedian_ns\tmin_ns");
+        for (Benchmark benchmark : BENCHMARKS) {
+            if (selected.isEmpty() || selected.contains(benchmark.name)) {
+                measure(configuration, benchmark);
+            }
+        }
+    }
+
+    private static void measure(String configuration, Benchmark benchmark) throws Exception {
+        // Warm up, and find an iteration count that gives long enough runs.
+        int iterations = 1;
+        while (true) {
+            long start = System.nanoTime();
+            benchmark.run(iterations);
+            long elapsed = System.nanoTime() - start;
+            if (elapsed >= MIN_RUN_NS || iterations >= (1 << 30)) {
+                break;
+            }
+            iterations *= 2;
+        }
+        double[] nsPerIteration = new double[RUNS];
+        for (int i = 0; i < RUNS; i++) {
+            long start = System.nanoTime();
+            benchmark.run(iterations);
+            nsPerIteration[i] = (System.nanoTime() - start) / (double) iterations;
+        }
+        Arrays.sort(nsPerIteration);
+        System.out.println(configuration + "\t" + benchmark.name + "\t" + iterations + "\t" +
+                           nsPerIteration[RUNS / 2] + "\t" + nsPerIteration[0]);
+    }
+
+    private static final Benchmark[] BENCHMARKS = {
+        new Benchmark("AllocObject") {
+            void run(int iterations) {
+                for (int i = 0; i < iterations; i++) {
+                    sinkObject = new Object();
+                }
+            }
+        },
+        new Benchmark("AllocIntArray16") {
+            void run(int iterations) {
+                for (int i = 0; i < iterations; i++) {
+                    sinkObject = new int[16];
+                }
+            }
+        },
+        new Benchmark("GcPause") {
+            // A live heap of small objects, for the collector to trace.
+            private final Object[] live = new Object[100 * 1000];
+            {
+                for (int i = 0; i < live.length; i++) {
+                    live[i] = new Object();
+                }
+            }
+
+            void run(int iterations) {
+                for (int i = 0; i < iterations; i++) {
+                    System.gc();
+                }
+            }
+        },
+        new Benchmark("MonitorEnterExit") {
+            private final Object lock = new Object();
+
+            void run(int iterations) {
+                int count = 0;
+                for (int i = 0; i < iterations; i++) {
+                    synchronized (lock) {
+                        count++;
+                    }
+                }
+                sinkInt = count;
+            }
+        },
+        new Benchmark("JniStaticCall") {
+            void run(int iterations) {
+                for (int i = 0; i < iterations; i++) {
+                    nativeNop();
+                }
+            }
+        },
+        new Benchmark("JniCallWithArgs") {
+            void run(int iterations) {
+                int sum = 0;
+                for (int i = 0; i < iterations; i++) {
+                    sum += nativeAdd(i, sum);
+                }
+                sinkInt = sum;
+            }
+        },
+        new Benchmark("VirtualCall") {
+            private final Shape shape = new Square(3);
+
+            void run(int iterations) {
+                int sum = 0;
+                for (int i = 0; i < iterations; i++) {
+                    sum += shape.area();
+                }
+                sinkInt = sum;
+            }
+        },
+        new Benchmark("InterfaceCall") {
+            private final Measurable measurable = new Square(3);
+
+            void run(int iterations) {
+                int sum = 0;
+                for (int i = 0; i < iterations; i++) {
+                    sum += measurable.size();
+                }
+                sinkInt = sum;
+            }
+        },
+        new Benchmark("StringCharAt") {
+            private final String string = "The quick brown fox jumps over the lazy dog";
+
+            void run(int iterations) {
+                int sum = 0;
+                for (int i = 0; i < iterations; i++) {
+                    sum += string.charAt(i & 31);
+                }
+                sinkInt = sum;
+            }
+        },
+        new Benchmark("StringIndexOf") {
+            private final String string = "The quick brown fox jumps over the lazy dog";
+
+            void run(int iterations) {
+                int sum = 0;
+                for (int i = 0; i < iterations; i++) {
+                    sum += string.indexOf('z');
+                }
+                sinkInt = sum;
+            }
+        },
+        new Benchmark("StringCompareTo") {
+            private final String a = "The quick brown fox jumps over the lazy dog";
+            private final String b = "The quick brown fox jumps over the lazy cat";
+
+            void run(int iterations) {
+                int sum = 0;
+                for (int i = 0; i < iterations; i++) {
+                    sum += a.compareTo(b);
+                }
+                sinkInt = sum;
+            }
+        },
+        new Benchmark("StringEquals") {
+            private final String a = "The quick brown fox jumps over the lazy dog";
+            private final String b = new String(a);
+
+            void run(int iterations) {
+                int count = 0;
+                for (int i = 0; i < iterations; i++) {
+                    if (a.equals(b)) {
+                        count++;
+                    }
+                }
+                sinkInt = count;
+            }
+        },
+        new Benchmark("JniNewStringUtf") {
+            private boolean prepared;
+
+            void run(int iterations) {
+                if (!prepared) {
+                    nativeSetUtf(MIXED_STRING);
+                    prepared = true;
+                }
+                int length = 0;
+                for (int i = 0; i < iterations; i++) {
+                    length += nativeNewStringUtf();
+                }
+                sinkInt = length;
+            }
+        },
+        new Benchmark("JniGetStringUtfChars") {
+            void run(int iterations) {
+                int sum = 0;
+                for (int i = 0; i < iterations; i++) {
+                    sum += nativeGetStringUtfChars(MIXED_STRING);
+                }
+                sinkInt = sum;
+            }
+        },
+        new Benchmark("StringInternLong") {
+            // A fresh string each time, so that interning it computes its hash code.
+            private final char[] chars = MIXED_STRING.toCharArray();
+
+            void run(int iterations) {
+                for (int i = 0; i < iterations; i++) {
+                    sinkObject = new String(chars).intern();
+                }
+            }
+        },
+        new Benchmark("ClassLoading") {
+            // Loads a class through a new class loader each time, so that it's loaded afresh.
+            private final String classPath = System.getProperty("java.class.path");
+            private final ClassLoader parent = ClassLoader.getSystemClassLoader().getParent();
+
+            void run(int iterations) throws Exception {
+                for (int i = 0; i < iterations; i++) {
+                    ClassLoader loader = new PathClassLoader(classPath, parent);
+                    sinkObject = loader.loadClass("Benchmarks$Square");
+                }
+            }
+        },
+        new Benchmark("ArithmeticLoop") {
+            // A mix of the operations interpreted code spends its time on.
+            private final int[] values = new int[256];
+
+            void run(int iterations) {
+                int hash = 0;
+                for (int i = 0; i < iterations; i++) {
+                    int value = values[i & 255] + i;
+                    hash = hash * 31 + (value ^ (value >>> 7));
+                    values[i & 255] = hash;
+                }
+                sinkInt = hash;
+            }
+        },
+    };
+
+    abstract static class Shape {
+        abstract int area();
+    }
+
+    interface Measurable {
+        int size();
+    }
+
+    static class Square extends Shape implements Measurable {
+        private final int side;
+
+        Square(int side) {
+            this.side = side;
+        }
+
+        int area() {
+            return side * side;
+        }
+
+        public int size() {
+            return side;
+        }
+    }
+
+    private static native void nativeNop();
+    private static native int nativeAdd(int a, int b);
+    private static native void nativeSetUtf(String s);
+    private static native int nativeNewStringUtf();
+    private static native int nativeGetStringUtfChars(String s);
+}
@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "jni.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Natives that do as little as possible, to time the JNI transitions around them.
+
+extern "C" JNIEXPORT void JNICALL Java_Benchmarks_nativeNop(JNIEnv*, jclass) {
+}
+
+extern "C" JNIEXPORT jint JNICALL Java_Benchmarks_nativeAdd(JNIEnv*, jclass, jint a, jint b) {
+  return a + b;
+}
+
+// Natives that convert strings, to time the runtime's modified UTF-8 conversions.
+
+static char* gUtf = NULL;
+
+extern "C" JNIEXPORT void JNICALL Java_Benchmarks_nativeSetUtf(JNIEnv* env, jclass, jstring s) {
+  const char* utf = env->GetStringUTFChars(s, NULL);
+  free(gUtf);
+  gUtf = strdup(utf);
+  env->ReleaseStringUTFChars(s, utf);
+}
+
+extern "C" JNIEXPORT jint JNICALL Java_Benchmarks_nativeNewStringUtf(JNIEnv* env, jclass) {
+  jstring s = env->NewStringUTF(gUtf);
+  jint length = env->GetStringLength(s);
+  env->DeleteLocalRef(s);
+  return length;
+}
+
+extern "C" JNIEXPORT jint JNICALL Java_Benchmarks_nativeGetStringUtfChars(JNIEnv* env, jclass,
+                                                                          jstring s) {
+  const char* utf = env->GetStringUTFChars(s, NULL);
+  jint first = utf[0];
+  env->ReleaseStringUTFChars(s, utf);
+  return first;
+}
@@ -0,0 +1,35 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+class FieldGaps {
+    // One reference after the object header leaves the long unaligned, so a word of padding
+    // goes in front of it.
+    static class Padded {
+        Object o;
+        long j;
+    }
+
+    // Fits in the padding, so instances are no bigger than Padded's.
+    static class PaddedBoolean extends Padded {
+        boolean z;
+    }
+
+    // Only the first goes in the padding.
+    static class PaddedInts extends Padded {
+        int a;
+        int b;
+    }
+}
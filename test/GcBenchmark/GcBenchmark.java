@@ -0,0 +1,208 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+import java.util.Random;
+
+// Allocation stress for the garbage collector, run by "make art-gc-benchmarks".
+//
+// Usage: GcBenchmark <configuration> <profile> [<name>=<value>...]
+//
+// A profile describes an allocation pattern: how fast to allocate, how big the objects are, how
+// many of them survive, how many references they hold and how many are arrays large enough for
+// the large object space. Any of its values can be overridden on the command line, e.g.
+// "GcBenchmark host mixed survivalPercent=50 seconds=30". Objects that survive replace random
+// members of a fixed size live set, so the live heap stays the same size while it keeps changing.
+//
+// Prints one tab separated line with the configuration, the profile, how much was allocated, the
+// allocation throughput and the longest time a batch of allocations took, which bounds what the
+// mutator saw of GC pauses. The collectors' own pause percentiles are logged by the runtime when
+// it shuts down, when it is started with -XX:DumpGCPerformanceOnShutdown.
+class GcBenchmark {
+
+    // Allocations are timed in batches to keep the cost of reading the clock down.
+    private static final int BATCH = 256;
+
+    static class Profile {
+        String name;
+        int seconds = 10;
+        // Allocation rate to throttle to, or 0 to allocate as fast as possible.
+        int kbPerMs = 0;
+        // Object sizes are spread logarithmically between the two, which favors small objects.
+        int minBytes = 16;
+        int maxBytes = 256;
+        int survivalPercent = 5;
+        int liveSetObjects = 64 * 1024;
+        // References from each surviving object to other members of the live set.
+        int referencesPerObject = 0;
+        // Of every thousand allocations, how many are large arrays, and how big they are. The
+        // runtime puts primitive arrays of three pages or more in the large object space.
+        int largeArrayPerMille = 0;
+        int largeArrayBytes = 64 * 1024;
+
+        Profile(String name) {
+            this.name = name;
+        }
+
+        void set(String key, int value) {
+            if (key.equals("seconds")) {
+                seconds = value;
+            } else if (key.equals("kbPerMs")) {
+                kbPerMs = value;
+            } else if (key.equals("minBytes")) {
+                minBytes = value;
+            } else if (key.equals("maxBytes")) {
+                maxBytes = value;
+            } else if (key.equals("survivalPercent")) {
+                survivalPercent = value;
+            } else if (key.equals("liveSetObjects")) {
+                liveSetObjects = value;
+            } else if (key.equals("referencesPerObject")) {
+                referencesPerObject = value;
+            } else if (key.equals("largeArrayPerMille")) {
+                largeArrayPerMille = value;
+            } else if (key.equals("largeArrayBytes")) {
+                largeArrayBytes = value;
+            } else {
+                throw new IllegalArgumentException("Unknown profile value " + key);
+            }
+        }
+    }
+
+    static Profile getProfile(String name) {
+        Profile profile = new Profile(name);
+        if (name.equals("young")) {
+            // Almost everything dies young: the best case for sticky and partial collections.
+            profile.survivalPercent = 1;
+        } else if (name.equals("mixed")) {
+            profile.maxBytes = 1024;
+            profile.survivalPercent = 10;
+        } else if (name.equals("graph")) {
+            // Small objects that survive and point at each other, so marking dominates.
+            profile.minBytes = 16;
+            profile.maxBytes = 64;
+            profile.survivalPercent = 25;
+            profile.liveSetObjects = 256 * 1024;
+            profile.referencesPerObject = 4;
+        } else if (name.equals("large")) {
+            profile.survivalPercent = 5;
+            profile.largeArrayPerMille = 20;
+            profile.largeArrayBytes = 256 * 1024;
+        } else if (name.equals("throttled")) {
+            // A steady allocation rate, where pauses matter more than throughput.
+            profile.maxBytes = 1024;
+            profile.survivalPercent = 10;
+            profile.kbPerMs = 16;
+        } else {
+            throw new IllegalArgumentException("Unknown profile " + name);
+        }
+        return profile;
+    }
+
+    // A surviving object, with the payload that gives it its size and references into the live
+    // set.
+    static class Node {
+        final byte[] payload;
+        final Node[] references;
+
+        Node(int bytes, int references) {
+            payload = new byte[bytes];
+            this.references = references == 0 ? null : new Node[references];
+        }
+    }
+
+    // Written by the benchmark so that its allocations can't be optimized away.
+    static Object sink;
+
+    public static void main(String[] args) {
+        if (args.length < 2) {
+            System.err.println(
+                "Usage: GcBenchmark <configuration> <profile> [<name>=<value>...]");
+            System.exit(1);
+        }
+        String configuration = args[0];
+        Profile profile = getProfile(args[1]);
+        for (int i = 2; i < args.length; i++) {
+            int equals = args[i].indexOf('=');
+            if (equals == -1) {
+                throw new IllegalArgumentException("Expected <name>=<value>, got " + args[i]);
+            }
+            String value = args[i].substring(equals + 1);
+            profile.set(args[i].substring(0, equals), Integer.parseInt(value));
+        }
+        run(configuration, profile);
+    }
+
+    private static void run(String configuration, Profile profile) {
+        Random random = new Random(42);
+        Node[] liveSet = new Node[profile.liveSetObjects];
+        double logMin = Math.log(profile.minBytes);
+        double logRange = Math.log(profile.maxBytes) - logMin;
+
+        long allocations = 0;
+        long allocatedBytes = 0;
+        long maxBatchNs = 0;
+        long start = System.nanoTime();
+        long end = start + profile.seconds * 1000L * 1000L * 1000L;
+        long now = start;
+        while (now < end) {
+            long batchStart = now;
+            for (int i = 0; i < BATCH; i++) {
+                if (random.nextInt(1000) < profile.largeArrayPerMille) {
+                    sink = new byte[profile.largeArrayBytes];
+                    allocatedBytes += profile.largeArrayBytes;
+                    allocations++;
+                    continue;
+                }
+                int bytes = (int) Math.exp(logMin + random.nextDouble() * logRange);
+                boolean survives = random.nextInt(100) < profile.survivalPercent;
+                Node node = new Node(bytes, survives ? profile.referencesPerObject : 0);
+                allocatedBytes += bytes;
+                allocations++;
+                if (survives) {
+                    Node[] references = node.references;
+                    for (int j = 0; references != null && j < references.length; j++) {
+                        references[j] = liveSet[random.nextInt(liveSet.length)];
+                    }
+                    liveSet[random.nextInt(liveSet.length)] = node;
+                } else {
+                    sink = node;
+                }
+            }
+            now = System.nanoTime();
+            maxBatchNs = Math.max(maxBatchNs, now - batchStart);
+            if (profile.kbPerMs != 0) {
+                // Sleep off any lead over the target rate.
+                long targetNs = allocatedBytes * 1000L * 1000L / (profile.kbPerMs * 1024L);
+                long leadMs = (targetNs - (now - start)) / (1000L * 1000L);
+                if (leadMs > 0) {
+                    try {
+                        Thread.sleep(leadMs);
+                    } catch (InterruptedException e) {
+                        throw new AssertionError(e);
+                    }
+                    now = System.nanoTime();
+                }
+            }
+        }
+        long elapsedNs = now - start;
+        System.out.println("configuration\tprofile\tseconds\tallocations\tallocated_mb\t" +
+                           "mb_per_s\tmax_batch_ns");
+        System.out.println(configuration + "\t" + profile.name + "\t" + (elapsedNs / 1e9) + "\t" +
+                           allocations + "\t" + (allocatedBytes / (1024.0 * 1024.0)) + "\t" +
+                           (allocatedBytes / (1024.0 * 1024.0)) / (elapsedNs / 1e9) + "\t" +
+                           maxBatchNs);
+    }
+}
@@ -0,0 +1,139 @@
+#!/usr/bin/env python
+#
+# Copyright (C) 2013 The Android Open Source Project
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Times a dex2oat command line over several runs and thread counts.
+
+Usage: dex2oat-benchmark.py [--runs=N] [--threads=1,2,4] [--output=FILE] -- <dex2oat command>
+
+Each run passes -j<threads> and --timing-report to dex2oat. The JSON report gives, for each thread
+count, the median time of each phase and of each timing split dex2oat reported, along with the
+median total time and the largest peak RSS. "make art-dex2oat-benchmark" runs it on the boot class
+path.
+"""
+
+import json
+import multiprocessing
+import optparse
+import os
+import subprocess
+import sys
+import tempfile
+
+
+# The phases the timing splits add up to. Splits of the image writer nest in "dex2oat ImageWriter".
+_PHASES = [
+  ('Resolve', ['Resolve Types', 'Resolve MethodsAndFields']),
+  ('Verify', ['Verify Dex File']),
+  ('InitializeClasses', ['InitializeNoClinit']),
+  ('Compile', ['Compile Dex File']),
+  ('WriteElf', ['dex2oat OatWriter', 'dex2oat OatFile copy', 'dex2oat ElfStripper']),
+  ('WriteImage', ['dex2oat ImageWriter', 'PatchOatCodeAndMethods', 'RecordImageAllocations',
+                  'OrderImageObjects', 'AssignImageOffsets', 'CalculateAppImageObjectOffsets',
+                  'CopyAndFixupObjects']),
+]
+
+
+def ReadTimingReport(filename):
+  """Returns the "<name>\t<value>" lines of a dex2oat timing report as a dict."""
+  report = {}
+  for line in open(filename):
+    name, value = line.rstrip('\n').split('\t')
+    report[name] = int(value)
+  return report
+
+
+def Median(values):
+  values = sorted(values)
+  return values[len(values) // 2]
+
+
+def RunDex2oat(command, threads, report_filename):
+  args = [arg for arg in command
+          if not arg.startswith('-j') and not arg.startswith('--timing-report=')]
+  args += ['-j%d' % threads, '--timing-report=%s' % report_filename]
+  with open(os.devnull, 'w') as devnull:
+    status = subprocess.call(args, stdout=devnull)
+  if status != 0:
+    sys.stderr.write('dex2oat failed with status %d: %s\n' % (status, ' '.join(args)))
+    sys.exit(1)
+  return ReadTimingReport(report_filename)
+
+
+def Summarize(reports):
+  splits = {}
+  for report in reports:
+    for name, value in report.items():
+      if name not in ('total', 'threads', 'peak_rss_kb'):
+        splits.setdefault(name, []).append(value)
+  phases = {}
+  for phase, labels in _PHASES:
+    phases[phase] = Median([sum(report.get(label, 0) for label in labels) for report in reports])
+  return {
+    'runs': len(reports),
+    'total_ns': Median([report['total'] for report in reports]),
+    'peak_rss_kb': max(report.get('peak_rss_kb', 0) for report in reports),
+    'phases_ns': phases,
+    'splits_ns': dict((name, Median(values)) for name, values in splits.items()),
+  }
+
+
+def main():
+  parser = optparse.OptionParser(usage='%prog [options] -- <dex2oat command line>')
+  parser.add_option('--runs', type='int', default=5, help='runs per thread count')
+  parser.add_option('--threads', default=None,
+                    help='comma separated thread counts, by default powers of two up to the '
+                         'number of processors')
+  parser.add_option('--output', default=None, help='write the report here, not to stdout')
+  options, command = parser.parse_args()
+  if not command:
+    parser.error('missing dex2oat command line')
+
+  if options.threads:
+    thread_counts = [int(threads) for threads in options.threads.split(',')]
+  else:
+    processors = multiprocessing.cpu_count()
+    thread_counts = []
+    threads = 1
+    while threads < processors:
+      thread_counts.append(threads)
+      threads *= 2
+    thread_counts.append(processors)
+
+  fd, report_filename = tempfile.mkstemp(prefix='dex2oat-timing-')
+  os.close(fd)
+  results = []
+  try:
+    for threads in thread_counts:
+      reports = []
+      for run in range(options.runs):
+        sys.stderr.write('threads %d, run %d of %d\n' % (threads, run + 1, options.runs))
+        reports.append(RunDex2oat(command, threads, report_filename))
+      summary = Summarize(reports)
+      summary['threads'] = threads
+      results.append(summary)
+  finally:
+    os.remove(report_filename)
+
+  report = json.dumps({'command': command, 'results': results}, indent=2, sort_keys=True)
+  if options.output:
+    with open(options.output, 'w') as output:
+      output.write(report + '\n')
+  else:
+    print(report)
+
+
+if __name__ == '__main__':
+  main()